@@ -120,6 +120,11 @@ ifeq (${MAX3421_HOST},1)
   CMAKE_DEFSYM +=	-DMAX3421_HOST=1
 endif
 
+# compile tinyusb as a single translation unit
+ifeq (${AMALGAMATE},1)
+  CMAKE_DEFSYM +=	-DAMALGAMATE=1
+endif
+
 # Log level is mapped to TUSB DEBUG option
 ifneq ($(LOG),)
   CMAKE_DEFSYM +=	-DLOG=$(LOG)
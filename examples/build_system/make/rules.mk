@@ -24,6 +24,12 @@ vpath %.c . $(TOP)
 vpath %.s . $(TOP)
 vpath %.S . $(TOP)
 
+# Amalgamated build: tinyusb sources (core, class and port driver) are compiled as a single translation unit
+ifeq ($(AMALGAMATE),1)
+TINYUSB_AMALGAMATE_SRC := $(filter src/%,$(SRC_C))
+SRC_C := $(filter-out src/%,$(SRC_C)) $(BUILD)/tinyusb_all.c
+endif
+
 include ${TOP}/examples/build_system/make/toolchain/$(TOOLCHAIN)_rules.mk
 
 # ---------------------------------------
@@ -49,6 +55,12 @@ else
 	@$(MKDIR) -p $@
 endif
 
+ifeq ($(AMALGAMATE),1)
+$(BUILD)/tinyusb_all.c: $(addprefix $(TOP)/,$(TINYUSB_AMALGAMATE_SRC)) $(TOP)/tools/amalgamate.py | $(OBJ_DIRS)
+	@echo GEN $(notdir $@)
+	@$(PYTHON) $(TOP)/tools/amalgamate.py -r $(TOP) -o $@ $(addprefix $(TOP)/,$(TINYUSB_AMALGAMATE_SRC))
+endif
+
 # UF2 generation, iMXRT need to strip to text only before conversion
 ifneq ($(FAMILY),imxrt)
 $(BUILD)/$(PROJECT).uf2: $(BUILD)/$(PROJECT).hex
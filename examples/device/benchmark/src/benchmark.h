@@ -0,0 +1,65 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <stdint.h>
+
+// Keep in sync with test/hil/benchmark.py
+
+// Vendor control requests (bmRequestType = vendor, recipient = device)
+enum {
+  BENCH_REQ_SET_MODE  = 0x01, // wValue = mode, wIndex = target
+  BENCH_REQ_GET_STATS = 0x02, // IN, returns bench_stats_t
+};
+
+enum {
+  BENCH_MODE_ECHO = 0,
+  BENCH_MODE_SINK,
+  BENCH_MODE_SOURCE,
+};
+
+enum {
+  BENCH_TARGET_CDC = 0,
+  BENCH_TARGET_VENDOR,
+  BENCH_TARGET_COUNT
+};
+
+// All fields are little endian counters which wrap around, host uses the difference of 2 readings
+typedef struct {
+  uint32_t time_ms;
+  uint32_t loop_count; // main loop iterations
+  uint32_t cdc_rx;
+  uint32_t cdc_tx;
+  uint32_t vendor_rx;
+  uint32_t vendor_tx;
+  uint32_t msc_rx;     // WRITE10 payload bytes
+  uint32_t msc_tx;     // READ10 payload bytes
+} bench_stats_t;
+
+extern bench_stats_t bench_stats;
+
+#endif
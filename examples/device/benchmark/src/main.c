@@ -0,0 +1,240 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* Throughput benchmark firmware, used by test/hil/benchmark.py
+ * Each of CDC and Vendor bulk interface can run in one of following mode, selected by host
+ * with vendor control request BENCH_REQ_SET_MODE (wValue = mode, wIndex = target)
+ * - ECHO   : received data is sent back, used for round-trip latency
+ * - SINK   : received data is discarded, used for OUT throughput
+ * - SOURCE : data is sent as fast as possible, used for IN throughput
+ * MSC exposes a large virtual disk whose data is generated on-the-fly and writes are discarded.
+ *
+ * BENCH_REQ_GET_STATS returns bench_stats_t: byte counters of all interfaces and main loop
+ * iteration count (loop rate drops when stack is busy, host estimates cpu load from it).
+ */
+
+#include "bsp/board_api.h"
+#include "tusb.h"
+#include "benchmark.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF PROTYPES
+//--------------------------------------------------------------------+
+
+/* Blink pattern
+ * - 250 ms  : device not mounted
+ * - 1000 ms : device mounted
+ * - 2500 ms : device is suspended
+ */
+enum {
+  BLINK_NOT_MOUNTED = 250,
+  BLINK_MOUNTED = 1000,
+  BLINK_SUSPENDED = 2500,
+};
+
+static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
+
+static uint8_t bench_mode[BENCH_TARGET_COUNT] = { BENCH_MODE_ECHO, BENCH_MODE_ECHO };
+static uint8_t source_buf[CFG_TUD_CDC_EP_BUFSIZE];
+
+bench_stats_t bench_stats;
+
+void led_blinking_task(void);
+void cdc_task(void);
+void vendor_task(void);
+
+/*------------- MAIN -------------*/
+int main(void) {
+  board_init();
+
+  // data pattern for SOURCE mode, host checks nothing but it is easier to spot in a bus analyzer
+  for (size_t i = 0; i < sizeof(source_buf); i++) {
+    source_buf[i] = (uint8_t) i;
+  }
+
+  // init device stack on configured roothub port
+  tusb_rhport_init_t dev_init = {
+    .role = TUSB_ROLE_DEVICE,
+    .speed = TUSB_SPEED_AUTO
+  };
+  tusb_init(BOARD_TUD_RHPORT, &dev_init);
+
+  if (board_init_after_tusb) {
+    board_init_after_tusb();
+  }
+
+  while (1) {
+    tud_task(); // tinyusb device task
+    led_blinking_task();
+
+    cdc_task();
+    vendor_task();
+
+    bench_stats.loop_count++;
+  }
+}
+
+//--------------------------------------------------------------------+
+// Device callbacks
+//--------------------------------------------------------------------+
+
+// Invoked when device is mounted
+void tud_mount_cb(void) {
+  blink_interval_ms = BLINK_MOUNTED;
+}
+
+// Invoked when device is unmounted
+void tud_umount_cb(void) {
+  blink_interval_ms = BLINK_NOT_MOUNTED;
+}
+
+// Invoked when usb bus is suspended
+// remote_wakeup_en : if host allow us  to perform remote wakeup
+// Within 7ms, device must draw an average of current less than 2.5 mA from bus
+void tud_suspend_cb(bool remote_wakeup_en) {
+  (void) remote_wakeup_en;
+  blink_interval_ms = BLINK_SUSPENDED;
+}
+
+// Invoked when usb bus is resumed
+void tud_resume_cb(void) {
+  blink_interval_ms = tud_mounted() ? BLINK_MOUNTED : BLINK_NOT_MOUNTED;
+}
+
+//--------------------------------------------------------------------+
+// Vendor control request
+//--------------------------------------------------------------------+
+
+// Invoked when a control transfer occurred on an interface of this class
+// Driver response accordingly to the request and the transfer stage (setup/data/ack)
+// return false to stall control endpoint (e.g unsupported request)
+bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const* request) {
+  static bench_stats_t stats_snapshot;
+
+  // nothing to with DATA & ACK stage
+  if (stage != CONTROL_STAGE_SETUP) return true;
+  if (request->bmRequestType_bit.type != TUSB_REQ_TYPE_VENDOR) return false;
+
+  switch (request->bRequest) {
+    case BENCH_REQ_SET_MODE:
+      if (request->wIndex >= BENCH_TARGET_COUNT || request->wValue > BENCH_MODE_SOURCE) return false;
+      bench_mode[request->wIndex] = (uint8_t) request->wValue;
+      return tud_control_status(rhport, request);
+
+    case BENCH_REQ_GET_STATS:
+      // snapshot since data stage is sent after this callback returns
+      stats_snapshot = bench_stats;
+      stats_snapshot.time_ms = board_millis();
+      return tud_control_xfer(rhport, request, &stats_snapshot, sizeof(stats_snapshot));
+
+    default: break;
+  }
+
+  // stall unknown request
+  return false;
+}
+
+//--------------------------------------------------------------------+
+// USB CDC
+//--------------------------------------------------------------------+
+void cdc_task(void) {
+  uint8_t buf[CFG_TUD_CDC_EP_BUFSIZE];
+
+  switch (bench_mode[BENCH_TARGET_CDC]) {
+    case BENCH_MODE_ECHO:
+      if (tud_cdc_available()) {
+        // only read as much as can be written back, the rest will be echoed in next loop
+        uint32_t const count = tud_cdc_read(buf, tu_min32(sizeof(buf), tud_cdc_write_available()));
+        bench_stats.cdc_rx += count;
+        bench_stats.cdc_tx += tud_cdc_write(buf, count);
+        tud_cdc_write_flush();
+      }
+      break;
+
+    case BENCH_MODE_SINK:
+      if (tud_cdc_available()) {
+        bench_stats.cdc_rx += tud_cdc_read(buf, sizeof(buf));
+      }
+      break;
+
+    case BENCH_MODE_SOURCE:
+      // connected() check for DTR bit, don't fill the FIFO if nobody is reading
+      if (tud_cdc_connected() && tud_cdc_write_available()) {
+        bench_stats.cdc_tx += tud_cdc_write(source_buf, tu_min32(sizeof(source_buf), tud_cdc_write_available()));
+        tud_cdc_write_flush();
+      }
+      break;
+
+    default: break;
+  }
+}
+
+//--------------------------------------------------------------------+
+// USB Vendor
+//--------------------------------------------------------------------+
+void vendor_task(void) {
+  uint8_t buf[CFG_TUD_CDC_EP_BUFSIZE];
+
+  switch (bench_mode[BENCH_TARGET_VENDOR]) {
+    case BENCH_MODE_ECHO:
+      if (tud_vendor_available()) {
+        uint32_t const count = tud_vendor_read(buf, tu_min32(sizeof(buf), tud_vendor_write_available()));
+        bench_stats.vendor_rx += count;
+        bench_stats.vendor_tx += tud_vendor_write(buf, count);
+        tud_vendor_write_flush();
+      }
+      break;
+
+    case BENCH_MODE_SINK:
+      if (tud_vendor_available()) {
+        bench_stats.vendor_rx += tud_vendor_read(buf, sizeof(buf));
+      }
+      break;
+
+    case BENCH_MODE_SOURCE:
+      if (tud_vendor_mounted() && tud_vendor_write_available()) {
+        bench_stats.vendor_tx += tud_vendor_write(source_buf, tu_min32(sizeof(source_buf), tud_vendor_write_available()));
+        tud_vendor_write_flush();
+      }
+      break;
+
+    default: break;
+  }
+}
+
+//--------------------------------------------------------------------+
+// BLINKING TASK
+//--------------------------------------------------------------------+
+void led_blinking_task(void) {
+  static uint32_t start_ms = 0;
+  static bool led_state = false;
+
+  // Blink every interval ms
+  if (board_millis() - start_ms < blink_interval_ms) return; // not enough time
+  start_ms += blink_interval_ms;
+
+  board_led_write(led_state);
+  led_state = 1 - led_state; // toggle
+}
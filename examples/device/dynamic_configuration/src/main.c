@@ -50,6 +50,7 @@ static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
 void led_blinking_task(void);
 void cdc_task(void);
 void midi_task(void);
+void button_task(void);
 
 /*------------- MAIN -------------*/
 int main(void)
@@ -73,6 +74,7 @@ int main(void)
     led_blinking_task();
     cdc_task();
     midi_task();
+    button_task();
   }
 }
 
@@ -208,6 +210,40 @@ void midi_task(void)
   if (note_pos >= sizeof(note_sequence)) note_pos = 0;
 }
 
+//--------------------------------------------------------------------+
+// BUTTON TASK
+//--------------------------------------------------------------------+
+
+// Switch configuration when button changes without re-initializing the stack: device is disconnected and
+// connected again shortly after, host then re-enumerates it with descriptors of the new mode
+void button_task(void)
+{
+  static uint32_t btn_prev = 0;
+  static uint32_t start_ms = 0;
+  static bool reconnect = false;
+
+  if (reconnect) {
+    // keep disconnected long enough for host to notice
+    if (board_millis() - start_ms < 20) return;
+    reconnect = false;
+    tud_connect();
+    return;
+  }
+
+  // poll every 50 ms to debounce
+  if (board_millis() - start_ms < 50) return;
+  start_ms = board_millis();
+
+  // mode of the current enumeration is picked up by tud_descriptor_device_cb(), only react on changes
+  uint32_t const btn = board_button_read();
+  if (btn != btn_prev) {
+    btn_prev = btn;
+    if (tud_mounted() && tud_reconfigure()) {
+      reconnect = true;
+    }
+  }
+}
+
 //--------------------------------------------------------------------+
 // BLINKING TASK
 //--------------------------------------------------------------------+
@@ -39,6 +39,7 @@
 // Configuration mode
 // 0 : enumerated as CDC/MIDI. Board button is not pressed when enumerating
 // 1 : enumerated as MSC. Board button is pressed when enumerating
+// Changing button state while running switches configuration with tud_reconfigure()
 static uint32_t mode = 0;
 
 //--------------------------------------------------------------------+
@@ -47,10 +47,20 @@
 #define ETH_PAD_SIZE                    0
 #define LWIP_IP_ACCEPT_UDP_PORT(p)      ((p) == PP_NTOHS(67))
 
-#define TCP_MSS                         (1500 /*mtu*/ - 20 /*iphdr*/ - 20 /*tcphhr*/)
+/* Ethernet frame size including header, shared with TinyUSB. Can be raised for jumbo frames e.g 8192 */
+#ifndef CFG_TUD_NET_MTU
+#define CFG_TUD_NET_MTU                 1514
+#endif
+
+#define TCP_MSS                         (CFG_TUD_NET_MTU - 14 /*ethhdr*/ - 20 /*iphdr*/ - 20 /*tcphhr*/)
 #define TCP_SND_BUF                     (4 * TCP_MSS)
 #define TCP_WND                         (4 * TCP_MSS)
 
+#if CFG_TUD_NET_MTU > 1514
+/* heap must hold outgoing jumbo segments, default MEM_SIZE (1600) only fits a standard one */
+#define MEM_SIZE                        (TCP_SND_BUF + 1024)
+#endif
+
 #define ETHARP_SUPPORT_STATIC_ENTRIES   1
 
 #define LWIP_HTTPD_CGI                  0
@@ -60,6 +70,7 @@
 #define LWIP_SINGLE_NETIF               1
 
 #define PBUF_POOL_SIZE                  4
+#define LWIP_SUPPORT_CUSTOM_PBUF        1
 
 #define HTTPD_USE_CUSTOM_FSDATA         0
 
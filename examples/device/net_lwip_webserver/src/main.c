@@ -52,6 +52,7 @@ try changing the first byte of tud_network_mac_address[] below from 0x02 to 0x00
 #include "lwip/ethip6.h"
 #include "lwip/init.h"
 #include "lwip/timeouts.h"
+#include "netif/ethernet.h"
 
 #ifdef INCLUDE_IPERF
   #include "lwip/apps/lwiperf.h"
@@ -103,6 +104,22 @@ static err_t linkoutput_fn(struct netif *netif, struct pbuf *p) {
 
     /* if the network driver can accept another packet, we make it happen */
     if (tud_network_can_xmit(p->tot_len)) {
+#if CFG_TUD_NCM && CFG_TUD_NCM_IN_SG_N
+      /* pass the pbuf chain without copying, pbuf is kept until tud_network_xmit_sg_done_cb() */
+      tud_network_iovec_t iov[8];
+      uint8_t count = 0;
+      struct pbuf *q;
+      for (q = p; q != NULL && count < TU_ARRAY_SIZE(iov); q = q->next) {
+        iov[count].base = q->payload;
+        iov[count].len = q->len;
+        count++;
+      }
+      if (q == NULL) {
+        pbuf_ref(p);
+        tud_network_xmit_sg(iov, count, p);
+        return ERR_OK;
+      }
+#endif
       tud_network_xmit(p, 0 /* unused for this example */);
       return ERR_OK;
     }
@@ -124,7 +141,7 @@ static err_t ip6_output_fn(struct netif *netif, struct pbuf *p, const ip6_addr_t
 
 static err_t netif_init_cb(struct netif *netif) {
   LWIP_ASSERT("netif != NULL", (netif != NULL));
-  netif->mtu = CFG_TUD_NET_MTU;
+  netif->mtu = CFG_TUD_NET_MTU - SIZEOF_ETH_HDR; // lwip mtu excludes Ethernet header
   netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP | NETIF_FLAG_UP;
   netif->state = NULL;
   netif->name[0] = 'E';
@@ -163,13 +180,54 @@ bool dns_query_proc(const char *name, ip4_addr_t *addr) {
   return false;
 }
 
+#if CFG_TUD_NCM && LWIP_SUPPORT_CUSTOM_PBUF
+/* zero-copy receive: the pbuf references the datagram inside the NCM NTB until lwip frees it,
+   meanwhile the driver continues with the next datagrams and NTBs */
+typedef struct {
+  struct pbuf_custom pc;
+  const uint8_t *datagram;
+} ncm_pbuf_t;
+
+static ncm_pbuf_t ncm_pbuf[PBUF_POOL_SIZE];
+
+static void ncm_pbuf_free(struct pbuf *p) {
+  ncm_pbuf_t *np = (ncm_pbuf_t *) p;
+  tud_network_recv_unref(np->datagram);
+  np->datagram = NULL;
+}
+
+static struct pbuf *ncm_pbuf_alloc(const uint8_t *src, uint16_t size) {
+  for (size_t i = 0; i < TU_ARRAY_SIZE(ncm_pbuf); i++) {
+    ncm_pbuf_t *np = &ncm_pbuf[i];
+    if (np->datagram == NULL) {
+      /* driver refuses if this would pin its last receive NTB */
+      if (!tud_network_recv_ref(src)) return NULL;
+      np->datagram = src;
+      np->pc.custom_free_function = ncm_pbuf_free;
+      return pbuf_alloced_custom(PBUF_RAW, size, PBUF_REF, &np->pc, (void *) (uintptr_t) src, size);
+    }
+  }
+  return NULL;
+}
+#endif
+
 bool tud_network_recv_cb(const uint8_t *src, uint16_t size) {
   /* this shouldn't happen, but if we get another packet before
   parsing the previous, we must signal our inability to accept it */
   if (received_frame) return false;
 
   if (size) {
-    struct pbuf *p = pbuf_alloc(PBUF_RAW, size, PBUF_POOL);
+    struct pbuf *p = NULL;
+
+#if CFG_TUD_NCM && LWIP_SUPPORT_CUSTOM_PBUF
+    p = ncm_pbuf_alloc(src, size);
+    if (p) {
+      received_frame = p;
+      return true;
+    }
+#endif
+
+    p = pbuf_alloc(PBUF_RAW, size, PBUF_POOL);
 
     if (p) {
       /* pbuf_alloc() has already initialized struct; all we need to do is copy the data */
@@ -191,6 +249,12 @@ uint16_t tud_network_xmit_cb(uint8_t *dst, void *ref, uint16_t arg) {
   return pbuf_copy_partial(p, dst, p->tot_len, 0);
 }
 
+#if CFG_TUD_NCM && CFG_TUD_NCM_IN_SG_N
+void tud_network_xmit_sg_done_cb(void *ref) {
+  pbuf_free((struct pbuf *) ref);
+}
+#endif
+
 static void service_traffic(void) {
   /* handle any packet received by tud_network_recv_cb() */
   if (received_frame) {
@@ -110,7 +110,7 @@ extern "C" {
 // Can be set to smaller values if wNtbOutMaxDatagrams==1
 #define CFG_TUD_NCM_OUT_NTB_MAX_SIZE (2 * TCP_MSS + 100)
 
-// Number of NCM transfer blocks for reception side
+// Number of NCM transfer blocks for reception side, zero-copy receive into lwip pbufs requires at least 2
 #ifndef CFG_TUD_NCM_OUT_NTB_N
   #define CFG_TUD_NCM_OUT_NTB_N 1
 #endif
@@ -0,0 +1,357 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2026 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* Raw throughput benchmark of attached mass storage drives, no filesystem involved. For each transfer size and
+ * queue depth, sequential and random READ(10) (and WRITE(10) if enabled) are issued for MSC_BENCH_DURATION_MS
+ * with tuh_msc_read10()/tuh_msc_write10(). Queue depth is the number of commands kept outstanding, commands
+ * beyond the first are queued by the msc driver (CFG_TUH_MSC_CMD_QUEUE_N) so that next CBW is sent right after
+ * previous CSW. One line per case is printed, fields are space separated key=value for HIL collection:
+ *
+ *   msc_bench begin daddr=1 vid=0781 pid=5581 block_count=60063744 block_size=512
+ *   msc_bench test=seq_read size=4096 qd=1 bytes=1093632 ms=1000 kBps=1093 iops=267
+ *   msc_bench end daddr=1 errors=0
+ *
+ * WARNING: write tests overwrite drive content, they are only built with MSC_BENCH_WRITE=1
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bsp/board_api.h"
+#include "tusb.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF PROTYPES
+//--------------------------------------------------------------------+
+
+// Duration of each test case
+#ifndef MSC_BENCH_DURATION_MS
+#define MSC_BENCH_DURATION_MS   1000
+#endif
+
+// Buffer shared by all outstanding commands of a case, case with size * qd larger than this is skipped
+#ifndef MSC_BENCH_BUFSIZE
+#define MSC_BENCH_BUFSIZE       (16*1024)
+#endif
+
+// Write tests destroy data on the drive
+#ifndef MSC_BENCH_WRITE
+#define MSC_BENCH_WRITE         0
+#endif
+
+// Max outstanding commands per device: one in progress and the rest queued by the driver
+#define MSC_BENCH_QD_MAX        (1 + CFG_TUH_MSC_CMD_QUEUE_N)
+
+enum {
+  TEST_SEQ_READ = 0,
+  TEST_RAND_READ,
+#if MSC_BENCH_WRITE
+  TEST_SEQ_WRITE,
+  TEST_RAND_WRITE,
+#endif
+  TEST_COUNT
+};
+
+static const char* const test_name[] = { "seq_read", "rand_read", "seq_write", "rand_write" };
+static const uint32_t xfer_size[] = { 512, 4096, 16384 };
+static const uint8_t queue_depth[] = { 1, 2, 4 };
+
+typedef struct {
+  uint8_t daddr;
+  uint8_t test;
+  uint8_t size_idx;
+  uint8_t qd_idx;
+  bool running;
+
+  uint8_t inflight;
+  uint8_t free_slot;  // bitmap of buffer slots not used by outstanding commands
+  bool stopping;      // duration elapsed or error, wait for outstanding commands
+  uint32_t errors;
+
+  uint32_t block_size;
+  uint32_t lba_max;   // number of addressable blocks by READ/WRITE (10)
+  uint32_t lba_next;
+  uint32_t rand_state;
+
+  uint32_t start_ms;
+  uint32_t bytes;
+  uint32_t cmds;
+} msc_bench_t;
+
+static msc_bench_t _bench;
+static volatile uint32_t _pending_mask; // devices mounted but not benchmarked yet
+
+CFG_TUH_MEM_SECTION static uint8_t _bench_buf[MSC_BENCH_BUFSIZE] CFG_TUH_MEM_ALIGN;
+
+void led_blinking_task(void);
+static void bench_task(void);
+
+/*------------- MAIN -------------*/
+int main(void) {
+  board_init();
+
+  printf("TinyUSB Host MassStorage Benchmark Example\r\n");
+
+  // init host stack on configured roothub port
+  tusb_rhport_init_t host_init = {
+    .role = TUSB_ROLE_HOST,
+    .speed = TUSB_SPEED_AUTO
+  };
+  tusb_init(BOARD_TUH_RHPORT, &host_init);
+
+  if (board_init_after_tusb) {
+    board_init_after_tusb();
+  }
+
+  while (1) {
+    // tinyusb host task
+    tuh_task();
+
+    bench_task();
+    led_blinking_task();
+  }
+
+  return 0;
+}
+
+//--------------------------------------------------------------------+
+// Benchmark
+//--------------------------------------------------------------------+
+
+static uint32_t xorshift32(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline bool test_is_write(uint8_t test) {
+  return test >= 2;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline bool test_is_rand(uint8_t test) {
+  return test & 1;
+}
+
+static bool bench_complete_cb(uint8_t daddr, tuh_msc_complete_data_t const* cb_data);
+
+// Keep queue depth of commands outstanding, called from task and from complete callback
+static void bench_submit(void) {
+  uint32_t const size = xfer_size[_bench.size_idx];
+  uint8_t const qd = queue_depth[_bench.qd_idx];
+  uint16_t const block_count = (uint16_t) (size / _bench.block_size);
+
+  while (!_bench.stopping && _bench.inflight < qd) {
+    uint32_t lba;
+    if (test_is_rand(_bench.test)) {
+      lba = (xorshift32(&_bench.rand_state) % (_bench.lba_max / block_count)) * block_count;
+    } else {
+      if (_bench.lba_next + block_count > _bench.lba_max) {
+        _bench.lba_next = 0;
+      }
+      lba = _bench.lba_next;
+      _bench.lba_next += block_count;
+    }
+
+    uint8_t const slot = (uint8_t) __builtin_ctz(_bench.free_slot);
+    uint8_t* buf = _bench_buf + slot * size;
+
+    bool ok;
+    if (test_is_write(_bench.test)) {
+      ok = tuh_msc_write10(_bench.daddr, 0, buf, lba, block_count, bench_complete_cb, slot);
+    } else {
+      ok = tuh_msc_read10(_bench.daddr, 0, buf, lba, block_count, bench_complete_cb, slot);
+    }
+
+    if (!ok) {
+      // driver queue is shallower than requested depth, continue with what is outstanding
+      if (_bench.inflight == 0) {
+        _bench.errors++;
+        _bench.stopping = true;
+      }
+      break;
+    }
+
+    _bench.free_slot &= (uint8_t) ~(1u << slot);
+    _bench.inflight++;
+  }
+}
+
+static bool bench_complete_cb(uint8_t daddr, tuh_msc_complete_data_t const* cb_data) {
+  if (!_bench.running || daddr != _bench.daddr) {
+    return true;
+  }
+
+  _bench.inflight--;
+  _bench.free_slot |= (uint8_t) (1u << cb_data->user_arg);
+
+  if (cb_data->csw->status == MSC_CSW_STATUS_PASSED) {
+    _bench.bytes += cb_data->cbw->total_bytes;
+    _bench.cmds++;
+  } else {
+    _bench.errors++;
+    _bench.stopping = true;
+  }
+
+  if (board_millis() - _bench.start_ms >= MSC_BENCH_DURATION_MS) {
+    _bench.stopping = true;
+  }
+
+  bench_submit();
+  return true;
+}
+
+// advance: queue depth -> transfer size -> test
+static void bench_advance(void) {
+  if (++_bench.qd_idx >= TU_ARRAY_SIZE(queue_depth)) {
+    _bench.qd_idx = 0;
+    if (++_bench.size_idx >= TU_ARRAY_SIZE(xfer_size)) {
+      _bench.size_idx = 0;
+      _bench.test++;
+    }
+  }
+}
+
+// Skip to next case that fits buffer, driver queue and block size, return false if all are done
+static bool bench_next_case(void) {
+  while (_bench.test < TEST_COUNT) {
+    uint32_t const size = xfer_size[_bench.size_idx];
+    uint8_t const qd = queue_depth[_bench.qd_idx];
+    uint32_t const block_count = size / _bench.block_size;
+
+    if (block_count > 0 && block_count <= UINT16_MAX && size * qd <= MSC_BENCH_BUFSIZE &&
+        qd <= MSC_BENCH_QD_MAX && _bench.lba_max >= block_count) {
+      return true;
+    }
+
+    bench_advance();
+  }
+
+  return false;
+}
+
+static void bench_start_device(uint8_t daddr) {
+  uint16_t vid, pid;
+  tuh_vid_pid_get(daddr, &vid, &pid);
+
+  uint64_t const block_count = tuh_msc_get_block_count64(daddr, 0);
+
+  tu_memclr(&_bench, sizeof(_bench));
+  _bench.daddr = daddr;
+  _bench.block_size = tuh_msc_get_block_size(daddr, 0);
+  _bench.lba_max = (block_count > UINT32_MAX) ? UINT32_MAX : (uint32_t) block_count;
+
+  printf("msc_bench begin daddr=%u vid=%04x pid=%04x block_count=%lu block_size=%lu\r\n", daddr, vid, pid,
+         (unsigned long) _bench.lba_max, (unsigned long) _bench.block_size);
+}
+
+static void bench_task(void) {
+  if (_bench.daddr == 0) {
+    if (_pending_mask == 0) {
+      return;
+    }
+    uint8_t const daddr = (uint8_t) __builtin_ctz(_pending_mask);
+    _pending_mask &= ~(1u << daddr);
+    bench_start_device(daddr);
+  }
+
+  if (!_bench.running) {
+    if (_bench.errors || !bench_next_case()) {
+      printf("msc_bench end daddr=%u errors=%lu\r\n", _bench.daddr, (unsigned long) _bench.errors);
+      _bench.daddr = 0;
+      return;
+    }
+
+    if (test_is_write(_bench.test)) {
+      for (uint32_t i = 0; i < MSC_BENCH_BUFSIZE; i++) {
+        _bench_buf[i] = (uint8_t) i;
+      }
+    }
+
+    _bench.running = true;
+    _bench.stopping = false;
+    _bench.inflight = 0;
+    _bench.free_slot = (uint8_t) ((1u << queue_depth[_bench.qd_idx]) - 1);
+    _bench.lba_next = 0;
+    _bench.rand_state = 0x2545F491u;
+    _bench.bytes = 0;
+    _bench.cmds = 0;
+    _bench.start_ms = board_millis();
+
+    bench_submit();
+  }
+
+  if (_bench.stopping && _bench.inflight == 0) {
+    uint32_t ms = board_millis() - _bench.start_ms;
+    if (ms == 0) {
+      ms = 1;
+    }
+
+    printf("msc_bench test=%s size=%lu qd=%u bytes=%lu ms=%lu kBps=%lu iops=%lu\r\n", test_name[_bench.test],
+           (unsigned long) xfer_size[_bench.size_idx], queue_depth[_bench.qd_idx], (unsigned long) _bench.bytes,
+           (unsigned long) ms, (unsigned long) (_bench.bytes / ms), (unsigned long) (_bench.cmds * 1000u / ms));
+
+    _bench.running = false;
+    bench_advance();
+  }
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB Callbacks
+//--------------------------------------------------------------------+
+
+void tuh_msc_mount_cb(uint8_t dev_addr) {
+  _pending_mask |= 1u << dev_addr;
+}
+
+void tuh_msc_umount_cb(uint8_t dev_addr) {
+  _pending_mask &= ~(1u << dev_addr);
+
+  if (_bench.daddr == dev_addr) {
+    // unplugged before all cases are done, count as error
+    printf("msc_bench end daddr=%u errors=%lu\r\n", dev_addr, (unsigned long) (_bench.errors + 1));
+    tu_memclr(&_bench, sizeof(_bench));
+  }
+}
+
+//--------------------------------------------------------------------+
+// Blinking Task
+//--------------------------------------------------------------------+
+void led_blinking_task(void) {
+  const uint32_t interval_ms = 1000;
+  static uint32_t start_ms = 0;
+
+  static bool led_state = false;
+
+  // Blink every interval ms
+  if (board_millis() - start_ms < interval_ms) return; // not enough time
+  start_ms += interval_ms;
+
+  board_led_write(led_state);
+  led_state = 1 - led_state; // toggle
+}
@@ -52,6 +52,7 @@ static CLI_UINT cli_buffer[BYTES_TO_CLI_UINTS(CLI_BUFFER_SIZE)];
 //------------- Elm Chan FatFS -------------//
 static FATFS fatfs[CFG_TUH_DEVICE_MAX]; // for simplicity only support 1 LUN per device
 static volatile bool _disk_busy[CFG_TUH_DEVICE_MAX];
+static uint8_t _disk_status[CFG_TUH_DEVICE_MAX]; // csw status of last disk io
 
 // define the buffer to be place in USB/DMA memory with correct alignment/cache line size
 CFG_TUH_MEM_SECTION static struct {
@@ -189,7 +190,7 @@ static void wait_for_disk_io(BYTE pdrv)
 
 static bool disk_io_complete(uint8_t dev_addr, tuh_msc_complete_data_t const * cb_data)
 {
-  (void) dev_addr; (void) cb_data;
+  _disk_status[dev_addr-1] = cb_data->csw->status;
   _disk_busy[dev_addr-1] = false;
   return true;
 }
@@ -221,10 +222,14 @@ DRESULT disk_read (
 	uint8_t const lun = 0;
 
 	_disk_busy[pdrv] = true;
-	tuh_msc_read10(dev_addr, lun, buff, sector, (uint16_t) count, disk_io_complete, 0);
+	// cached read completes immediately on hit, retry if previous op (e.g bypass) is still in progress
+	while (!tuh_msc_cache_read(dev_addr, lun, buff, sector, count, disk_io_complete, 0)) {
+	  if (!tuh_msc_mounted(dev_addr)) return RES_NOTRDY;
+	  tuh_task();
+	}
 	wait_for_disk_io(pdrv);
 
-	return RES_OK;
+	return _disk_status[pdrv] ? RES_ERROR : RES_OK;
 }
 
 #if FF_FS_READONLY == 0
@@ -240,10 +245,14 @@ DRESULT disk_write (
 	uint8_t const lun = 0;
 
 	_disk_busy[pdrv] = true;
-	tuh_msc_write10(dev_addr, lun, buff, sector, (uint16_t) count, disk_io_complete, 0);
+	// write is kept in cache until line is evicted or CTRL_SYNC
+	while (!tuh_msc_cache_write(dev_addr, lun, buff, sector, count, disk_io_complete, 0)) {
+	  if (!tuh_msc_mounted(dev_addr)) return RES_NOTRDY;
+	  tuh_task();
+	}
 	wait_for_disk_io(pdrv);
 
-	return RES_OK;
+	return _disk_status[pdrv] ? RES_ERROR : RES_OK;
 }
 
 #endif
@@ -259,8 +268,14 @@ DRESULT disk_ioctl (
   switch ( cmd )
   {
     case CTRL_SYNC:
-      // nothing to do since we do blocking
-      return RES_OK;
+      // write back cached blocks
+      _disk_busy[pdrv] = true;
+      while (!tuh_msc_cache_flush(dev_addr, disk_io_complete, 0)) {
+        if (!tuh_msc_mounted(dev_addr)) return RES_NOTRDY;
+        tuh_task();
+      }
+      wait_for_disk_io(pdrv);
+      return _disk_status[pdrv] ? RES_ERROR : RES_OK;
 
     case GET_SECTOR_COUNT:
       *((DWORD*) buff) = (WORD) tuh_msc_get_block_count(dev_addr, lun);
@@ -113,6 +113,14 @@
 //------------- MSC -------------//
 #define CFG_TUH_MSC_MAXLUN    4 // typical for most card reader
 
+// Queue next SCSI command (e.g read-ahead) while one is in progress
+#define CFG_TUH_MSC_CMD_QUEUE_N  2
+
+// Block cache for FatFS single sector access: 8 lines of 8 sectors (32KB)
+#define CFG_TUH_MSC_CACHE_LINE_N       8
+#define CFG_TUH_MSC_CACHE_LINE_BLOCKS  8
+#define CFG_TUH_MSC_CACHE_BLOCK_SIZE   512
+
 #ifdef __cplusplus
  }
 #endif
@@ -298,6 +298,13 @@ function(family_add_tinyusb TARGET OPT_MCU RTOS)
 
 endfunction()
 
+# Compile tinyusb as a single translation unit (AMALGAMATE=1), port sources must already be added
+function(family_amalgamate_tinyusb TARGET)
+  if (AMALGAMATE STREQUAL "1" AND TARGET ${TARGET}-tinyusb)
+    tinyusb_amalgamate(${TARGET}-tinyusb)
+  endif ()
+endfunction()
+
 # Add bin/hex output
 function(family_add_bin_hex TARGET)
   if (CMAKE_C_COMPILER_ID STREQUAL "IAR")
@@ -333,16 +340,19 @@ endfunction()
 # Configure device example with RTOS
 function(family_configure_device_example TARGET RTOS)
   family_configure_example(${TARGET} ${RTOS})
+  family_amalgamate_tinyusb(${TARGET})
 endfunction()
 
 # Configure host example with RTOS
 function(family_configure_host_example TARGET RTOS)
   family_configure_example(${TARGET} ${RTOS})
+  family_amalgamate_tinyusb(${TARGET})
 endfunction()
 
 # Configure host + device example with RTOS
 function(family_configure_dual_usb_example TARGET RTOS)
   family_configure_example(${TARGET} ${RTOS})
+  family_amalgamate_tinyusb(${TARGET})
 endfunction()
 
 function(family_example_missing_dependency TARGET DEPENDENCY)
@@ -40,6 +40,15 @@ USBD_IRQHandler(void)
   tud_int_handler(0);
 }
 
+#if CFG_TUD_PIC32MZ_DMA
+void __attribute__((interrupt(IPL2AUTO), vector(_USB_DMA_VECTOR), no_fpu))
+USBD_DMA_IRQHandler(void)
+{
+  IFS4CLR = _IFS4_USBDMAIF_MASK;
+  tud_int_handler(0);
+}
+#endif
+
 TU_ATTR_WEAK void button_init(void)
 {
 }
@@ -70,6 +79,13 @@ void board_init(void)
   IPC33CLR = _IPC33_USBIS_MASK;
   IPC33SET = (0 << _IPC33_USBIS_POSITION);
 
+#if CFG_TUD_PIC32MZ_DMA
+  // USB DMA interrupt at the same priority, enabled by dcd_int_enable()
+  IPC33CLR = _IPC33_USBDMAIP_MASK;
+  IPC33SET = (2 << _IPC33_USBDMAIP_POSITION);
+  IFS4CLR = _IFS4_USBDMAIF_MASK;
+#endif
+
   USBCRCONbits.USBIE = 0;
   IFS4CLR = _IFS4_USBIF_MASK;
   IEC4SET = _IEC4_USBIE_MASK;
@@ -49,6 +49,8 @@ add_library(tinyusb_common_base INTERFACE)
 target_sources(tinyusb_common_base INTERFACE
 	${TOP}/src/tusb.c
 	${TOP}/src/common/tusb_fifo.c
+	${TOP}/src/common/tusb_mempool.c
+	${TOP}/src/common/tusb_rfifo.c
 	)
 
 target_include_directories(tinyusb_common_base INTERFACE
@@ -109,10 +111,14 @@ target_sources(tinyusb_host_base INTERFACE
 		${TOP}/src/portable/raspberrypi/rp2040/rp2040_usb.c
 		${TOP}/src/host/usbh.c
 		${TOP}/src/host/hub.c
+		${TOP}/src/class/audio/audio_host.c
 		${TOP}/src/class/cdc/cdc_host.c
 		${TOP}/src/class/hid/hid_host.c
+		${TOP}/src/class/midi/midi_host.c
 		${TOP}/src/class/msc/msc_host.c
+		${TOP}/src/class/net/ncm_host.c
 		${TOP}/src/class/vendor/vendor_host.c
+		${TOP}/src/class/video/video_host.c
 		)
 
 # Sometimes have to do host specific actions in mostly common functions
@@ -339,6 +345,8 @@ function(suppress_tinyusb_warnings)
 			set(CONVERSION_WARNING_FILES
 				${PICO_TINYUSB_PATH}/src/tusb.c
 				${PICO_TINYUSB_PATH}/src/common/tusb_fifo.c
+				${PICO_TINYUSB_PATH}/src/common/tusb_mempool.c
+				${PICO_TINYUSB_PATH}/src/common/tusb_rfifo.c
 				${PICO_TINYUSB_PATH}/src/device/usbd.c
 				${PICO_TINYUSB_PATH}/src/device/usbd_control.c
 				${PICO_TINYUSB_PATH}/src/host/usbh.c
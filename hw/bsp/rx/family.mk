@@ -21,6 +21,7 @@ LDFLAGS_GCC += -specs=nosys.specs -specs=nano.specs
 SRC_C += \
 	src/portable/renesas/rusb2/dcd_rusb2.c \
 	src/portable/renesas/rusb2/hcd_rusb2.c \
+	src/portable/renesas/rusb2/rusb2_common.c \
 	$(MCU_DIR)/vects.c
 
 INC += \
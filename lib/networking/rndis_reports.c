@@ -251,9 +251,15 @@ void rndis_class_set_handler(uint8_t *data, int size)
         m->Status = RNDIS_STATUS_SUCCESS;
         m->DeviceFlags = RNDIS_DF_CONNECTIONLESS;
         m->Medium = RNDIS_MEDIUM_802_3;
-        m->MaxPacketsPerTransfer = 1;
+        m->MaxPacketsPerTransfer = CFG_TUD_RNDIS_PACKETS_PER_TRANSFER;
+#if CFG_TUD_RNDIS_PACKETS_PER_TRANSFER > 1
+        /* messages are aligned to 4 bytes, must match the driver packet buffer */
+        m->MaxTransferSize = CFG_TUD_RNDIS_PACKETS_PER_TRANSFER * (TU_DIV_CEIL(CFG_TUD_NET_MTU + sizeof(rndis_data_packet_t), 4) * 4);
+        m->PacketAlignmentFactor = 2;
+#else
         m->MaxTransferSize = CFG_TUD_NET_MTU + sizeof(rndis_data_packet_t);
         m->PacketAlignmentFactor = 0;
+#endif
         m->AfListOffset = 0;
         m->AfListSize = 0;
         rndis_state = rndis_initialized;
@@ -304,6 +304,29 @@ tu_static CFG_TUD_MEM_SECTION struct {
 } int_ep_buf[CFG_TUD_AUDIO];
 #endif
 
+// Parameters of AS interfaces are only needed for software coding and flow control
+#if (CFG_TUD_AUDIO_ENABLE_EP_IN && (CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL || CFG_TUD_AUDIO_ENABLE_ENCODING)) || (CFG_TUD_AUDIO_ENABLE_EP_OUT && CFG_TUD_AUDIO_ENABLE_DECODING)
+  #define USE_AS_PARAMS 1
+#else
+  #define USE_AS_PARAMS 0
+#endif
+
+// Alternate setting of an AS interface, parsed once in audiod_open()
+typedef struct
+{
+#if USE_AS_PARAMS
+  uint32_t formats;// bmFormats of Class-Specific AS Interface Descriptor(4.9.2)
+#endif
+  uint16_t desc_offset;// Offset of Standard AS Interface Descriptor (4.9.1) from AC interface descriptor
+  uint8_t itf;
+  uint8_t alt;
+#if USE_AS_PARAMS
+  uint8_t format_type;
+  uint8_t n_channels;
+  uint8_t n_bytes_per_sample;// bSubslotSize of Type I Format Type Descriptor(2.3.1.6)
+#endif
+} audiod_as_alt_t;
+
 typedef struct
 {
   uint8_t rhport;
@@ -311,7 +334,7 @@ typedef struct
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN
   uint8_t ep_in;            // TX audio data EP.
-  uint16_t ep_in_sz;        // Current size of TX EP
+  uint16_t ep_in_sz;        // Current size of TX EP per (micro)frame, including high-bandwidth transactions
   uint8_t ep_in_as_intf_num;// Corresponding Standard AS Interface Descriptor (4.9.1) belonging to output terminal to which this EP belongs - 0 is invalid (this fits to UAC2 specification since AS interfaces can not have interface number equal to zero)
 #endif
 
@@ -334,6 +357,15 @@ typedef struct
 
   uint16_t desc_length;// Length of audio function descriptor
 
+  uint8_t n_as_alt;// Number of alternate settings of all AS interfaces, only first CFG_TUD_AUDIO_N_AS_ALT_MAX are in as_alt[]
+  audiod_as_alt_t as_alt[CFG_TUD_AUDIO_N_AS_ALT_MAX];
+
+  // Index built in audiod_open() for control request lookup
+  uint8_t itf_num_ac;         // Interface number of AC interface, AS interfaces follow contiguously (IAD)
+  uint8_t n_as_itf;           // Number of AS interfaces
+  uint32_t ep_bitmap;         // Streaming EPs, bit is epnum + 16 * dir
+  uint32_t entity_bitmap[8];  // Entity IDs defined in class-specific AC interface descriptors
+
 #if CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
   struct {
     uint32_t value;    // Feedback value for asynchronous mode (in 16.16 format).
@@ -354,10 +386,22 @@ typedef struct
 
       struct {
         uint32_t nom_value;    // In 16.16 format
+  #if CFG_TUSB_FIFO_32BIT
+        uint64_t fifo_lvl_avg; // In 32.16 format
+  #else
         uint32_t fifo_lvl_avg; // In 16.16 format
-        uint16_t fifo_lvl_thr; // fifo level threshold
+  #endif
+        tu_fifo_size_t fifo_lvl_thr; // fifo level threshold
         uint16_t rate_const[2];// pre-computed feedback/fifo_depth rate
       } fifo_count;
+
+      struct {
+        uint64_t phase;      // Predicted counter value at SOF in 32.16 format, modulo 2^48
+        uint64_t period;     // Estimated counter cycles per frame in 16.16 format
+        uint32_t sample_freq;
+        uint32_t mclk_freq;
+        bool started;        // phase is seeded from first capture
+      } pll;
     } compute;
 
   } feedback;
@@ -378,9 +422,14 @@ typedef struct
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL
   uint32_t sample_rate_tx;
-  uint16_t packet_sz_tx[3];
+  uint16_t packet_sz_tx[3];// small, nominal and large packet size (per support FIFO if encoding), all zero if flow control is not active
+  tu_fifo_size_t fifo_lvl_tx[2]; // FIFO level below (above) which a small (large) packet is sent
+  uint16_t frac_rem_tx;    // Fractional part of samples per packet is frac_rem_tx / frac_div_tx
+  uint16_t frac_div_tx;
+  uint16_t frac_acc_tx;    // Accumulated fractional part, a large packet is scheduled when it reaches frac_div_tx
   uint8_t bclock_id_tx;
   uint8_t interval_tx;
+  uint8_t ctrl_blackout_tx;
 #endif
 
 // Encoding parameters - parameters are set when alternate AS interface is set by host
@@ -407,6 +456,8 @@ typedef struct
 // EP Transfer buffers and FIFOs
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT && !CFG_TUD_AUDIO_ENABLE_DECODING
   tu_fifo_t ep_out_ff;
+  uint8_t *ep_out_sw_buf;    // driver's own EP OUT FIFO buffer, restored when application buffer is removed
+  tu_fifo_size_t ep_out_sw_buf_sz;
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && !CFG_TUD_AUDIO_ENABLE_ENCODING
@@ -522,6 +573,11 @@ TU_ATTR_WEAK TU_ATTR_FAST_FUNC void tud_audio_feedback_interval_isr(uint8_t func
   (void) frame_number;
   (void) interval_shift;
 }
+
+TU_ATTR_WEAK TU_ATTR_FAST_FUNC uint32_t tud_audio_feedback_capture_cb(uint8_t func_id) {
+  (void) func_id;
+  return 0;
+}
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_INTERRUPT_EP
@@ -619,15 +675,19 @@ static uint16_t audiod_encode_type_I_pcm(uint8_t rhport, audiod_function_t *audi
 static bool audiod_get_interface(uint8_t rhport, tusb_control_request_t const *p_request);
 static bool audiod_set_interface(uint8_t rhport, tusb_control_request_t const *p_request);
 
-static bool audiod_get_AS_interface_index_global(uint8_t itf, uint8_t *func_id, uint8_t *idxItf, uint8_t const **pp_desc_int);
-static bool audiod_get_AS_interface_index(uint8_t itf, audiod_function_t *audio, uint8_t *idxItf, uint8_t const **pp_desc_int);
+static bool audiod_parse_index(audiod_function_t *audio);
+static bool audiod_get_AS_interface_index_global(uint8_t itf, uint8_t *func_id, uint8_t *idxItf);
+static bool audiod_get_AS_interface_index(uint8_t itf, audiod_function_t const *audio, uint8_t *idxItf);
 static bool audiod_verify_entity_exists(uint8_t itf, uint8_t entityID, uint8_t *func_id);
 static bool audiod_verify_itf_exists(uint8_t itf, uint8_t *func_id);
-static bool audiod_verify_ep_exists(uint8_t ep, uint8_t *func_id);
+static bool audiod_verify_ep_exists(uint8_t rhport, uint8_t ep, uint8_t *func_id);
 static uint8_t audiod_get_audio_fct_idx(audiod_function_t *audio);
 
-#if (CFG_TUD_AUDIO_ENABLE_EP_IN && (CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL || CFG_TUD_AUDIO_ENABLE_ENCODING)) || (CFG_TUD_AUDIO_ENABLE_EP_OUT && CFG_TUD_AUDIO_ENABLE_DECODING)
-static void audiod_parse_for_AS_params(audiod_function_t *audio, uint8_t const *p_desc, uint8_t const *p_desc_end, uint8_t const as_itf);
+static void audiod_parse_AS_alt_table(audiod_function_t *audio);
+static bool audiod_get_AS_alt(audiod_function_t const *audio, uint8_t itf, uint8_t alt, audiod_as_alt_t *as_alt);
+
+#if USE_AS_PARAMS
+static void audiod_parse_for_AS_params(audiod_as_alt_t *as_alt, uint8_t const *p_desc, uint8_t const *p_desc_end);
 
 static inline uint8_t tu_desc_subtype(void const *desc) {
   return ((uint8_t const *) desc)[2];
@@ -636,12 +696,12 @@ static inline uint8_t tu_desc_subtype(void const *desc) {
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL
 static bool audiod_calc_tx_packet_sz(audiod_function_t *audio);
-static uint16_t audiod_tx_packet_size(const uint16_t *norminal_size, uint16_t data_count, uint16_t fifo_depth, uint16_t max_size);
+static uint16_t audiod_tx_packet_size(audiod_function_t *audio, tu_fifo_size_t data_count, uint16_t max_size);
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT && CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
 static bool audiod_set_fb_params_freq(audiod_function_t *audio, uint32_t sample_freq, uint32_t mclk_freq);
-static void audiod_fb_fifo_count_update(audiod_function_t *audio, uint16_t lvl_new);
+static void audiod_fb_fifo_count_update(audiod_function_t *audio, tu_fifo_size_t lvl_new);
 #endif
 
 bool tud_audio_n_mounted(uint8_t func_id) {
@@ -657,18 +717,119 @@ bool tud_audio_n_mounted(uint8_t func_id) {
 
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT && !CFG_TUD_AUDIO_ENABLE_DECODING
 
-uint16_t tud_audio_n_available(uint8_t func_id) {
+  #if CFG_TUD_AUDIO_ENABLE_EP_OUT_ASRC
+// Fractional resampler: each output frame is interpolated between prev and next input frame at phase (Q16),
+// phase advances by step per output frame. Input frames are fetched from EP OUT FIFO in small blocks.
+    #define ASRC_BLOCK_FRAMES 8
+    #define ASRC_STEP_ONE     0x10000u
+    // ppm to Q16: ppm * 65536 / 10^6
+    #define ASRC_STEP_MAX     ((int32_t) (((uint32_t) CFG_TUD_AUDIO_EP_OUT_ASRC_PPM_MAX * 4295u) >> 16))
+
+typedef struct {
+  uint32_t phase;   // Q16 position between prev and next
+  int32_t err_avg;  // low-pass filtered fill level error in frames, Q8
+  int32_t prev[CFG_TUD_AUDIO_EP_OUT_ASRC_CHANNELS_MAX];
+  int32_t next[CFG_TUD_AUDIO_EP_OUT_ASRC_CHANNELS_MAX];
+  uint8_t n_channels;
+  uint8_t n_bytes_per_sample;
+  uint8_t blk_idx;  // next unused frame in blk
+  uint8_t blk_cnt;  // number of frames in blk
+  TU_ATTR_ALIGNED(4) uint8_t blk[ASRC_BLOCK_FRAMES * CFG_TUD_AUDIO_EP_OUT_ASRC_CHANNELS_MAX * 4];
+} audiod_asrc_t;
+
+static audiod_asrc_t _audiod_asrc[CFG_TUD_AUDIO];
+
+static void audiod_asrc_reset(audiod_asrc_t *asrc) {
+  asrc->phase = 2 * ASRC_STEP_ONE;// fetch two frames first
+  asrc->err_avg = 0;
+  asrc->blk_idx = 0;
+  asrc->blk_cnt = 0;
+  tu_memclr(asrc->next, sizeof(asrc->next));
+}
+
+bool tud_audio_n_asrc_config(uint8_t func_id, uint8_t n_channels, uint8_t n_bytes_per_sample) {
+  TU_VERIFY(func_id < CFG_TUD_AUDIO);
+  TU_VERIFY(n_channels && n_channels <= CFG_TUD_AUDIO_EP_OUT_ASRC_CHANNELS_MAX);
+  TU_VERIFY(n_bytes_per_sample == 2 || n_bytes_per_sample == 4);
+  audiod_asrc_t *asrc = &_audiod_asrc[func_id];
+  asrc->n_channels = n_channels;
+  asrc->n_bytes_per_sample = n_bytes_per_sample;
+  audiod_asrc_reset(asrc);
+  return true;
+}
+
+uint16_t tud_audio_n_read_asrc(uint8_t func_id, void *buffer, uint16_t n_frames) {
+  TU_VERIFY(func_id < CFG_TUD_AUDIO && _audiod_fct[func_id].p_desc != NULL, 0);
+  audiod_asrc_t *asrc = &_audiod_asrc[func_id];
+  TU_VERIFY(asrc->n_channels, 0);
+  tu_fifo_t *ff = &_audiod_fct[func_id].ep_out_ff;
+
+  uint8_t const n_ch = asrc->n_channels;
+  bool const is_16bit = (asrc->n_bytes_per_sample == 2);
+  uint16_t const frame_sz = (uint16_t) (n_ch * asrc->n_bytes_per_sample);
+
+  // Rate control: consume faster when FIFO is above half filled, slower when below
+  int32_t const target = (int32_t) (tu_fifo_depth(ff) / frame_sz / 2);
+  TU_VERIFY(target > 0, 0);
+  int32_t const err = (int32_t) (tu_fifo_count(ff) / frame_sz) - target;
+  asrc->err_avg += ((err << 8) - asrc->err_avg) >> 5;
+  int32_t adj = (asrc->err_avg * ASRC_STEP_MAX) / (target << 8);
+  if (adj > ASRC_STEP_MAX) adj = ASRC_STEP_MAX;
+  if (adj < -ASRC_STEP_MAX) adj = -ASRC_STEP_MAX;
+  uint32_t const step = (uint32_t) ((int32_t) ASRC_STEP_ONE + adj);
+
+  int16_t *dst16 = (int16_t *) buffer;
+  int32_t *dst32 = (int32_t *) buffer;
+  uint16_t n_out;
+
+  for (n_out = 0; n_out < n_frames; n_out++) {
+    // Advance input
+    while (asrc->phase >= ASRC_STEP_ONE) {
+      if (asrc->blk_idx == asrc->blk_cnt) {
+        asrc->blk_idx = 0;
+        asrc->blk_cnt = (uint8_t) (tu_fifo_read_n(ff, asrc->blk, (tu_fifo_size_t) (ASRC_BLOCK_FRAMES * frame_sz)) / frame_sz);
+        if (asrc->blk_cnt == 0) return n_out;// underrun
+      }
+      uint8_t const *src = &asrc->blk[asrc->blk_idx++ * frame_sz];
+      for (uint8_t ch = 0; ch < n_ch; ch++) {
+        asrc->prev[ch] = asrc->next[ch];
+        asrc->next[ch] = is_16bit ? ((int16_t const *) (uintptr_t) src)[ch] : ((int32_t const *) (uintptr_t) src)[ch];
+      }
+      asrc->phase -= ASRC_STEP_ONE;
+    }
+
+    // Interpolate, 16-bit uses Q15 fraction to stay within 32-bit multiply
+    uint32_t const frac = asrc->phase;
+    for (uint8_t ch = 0; ch < n_ch; ch++) {
+      int32_t const prev = asrc->prev[ch];
+      if (is_16bit) {
+        *dst16++ = (int16_t) (prev + (((asrc->next[ch] - prev) * (int32_t) (frac >> 1)) >> 15));
+      } else {
+        *dst32++ = (int32_t) (prev + ((((int64_t) asrc->next[ch] - prev) * (int64_t) frac) >> 16));
+      }
+    }
+    asrc->phase += step;
+  }
+
+  return n_out;
+}
+  #endif
+
+uint32_t tud_audio_n_available(uint8_t func_id) {
   TU_VERIFY(func_id < CFG_TUD_AUDIO && _audiod_fct[func_id].p_desc != NULL);
   return tu_fifo_count(&_audiod_fct[func_id].ep_out_ff);
 }
 
-uint16_t tud_audio_n_read(uint8_t func_id, void *buffer, uint16_t bufsize) {
+uint32_t tud_audio_n_read(uint8_t func_id, void *buffer, uint32_t bufsize) {
   TU_VERIFY(func_id < CFG_TUD_AUDIO && _audiod_fct[func_id].p_desc != NULL);
-  return tu_fifo_read_n(&_audiod_fct[func_id].ep_out_ff, buffer, bufsize);
+  return tu_fifo_read_n(&_audiod_fct[func_id].ep_out_ff, buffer, (tu_fifo_size_t) tu_min32(bufsize, TU_FIFO_SIZE_MAX));
 }
 
 bool tud_audio_n_clear_ep_out_ff(uint8_t func_id) {
   TU_VERIFY(func_id < CFG_TUD_AUDIO && _audiod_fct[func_id].p_desc != NULL);
+  #if CFG_TUD_AUDIO_ENABLE_EP_OUT_ASRC
+  audiod_asrc_reset(&_audiod_asrc[func_id]);
+  #endif
   return tu_fifo_clear(&_audiod_fct[func_id].ep_out_ff);
 }
 
@@ -677,6 +838,23 @@ tu_fifo_t *tud_audio_n_get_ep_out_ff(uint8_t func_id) {
   return NULL;
 }
 
+bool tud_audio_n_set_ep_out_ff_buffer(uint8_t func_id, void *buffer, uint32_t bufsize) {
+  TU_VERIFY(func_id < CFG_TUD_AUDIO);
+  audiod_function_t *audio = &_audiod_fct[func_id];
+  // FIFO must not be swapped while a packet is received into it
+  TU_VERIFY(!audio->ep_out || !usbd_edpt_busy(audio->rhport, audio->ep_out));
+
+  if (buffer == NULL) {
+    buffer = audio->ep_out_sw_buf;
+    bufsize = audio->ep_out_sw_buf_sz;
+  }
+  TU_VERIFY(buffer && bufsize && bufsize <= TU_FIFO_SIZE_MAX);
+
+  // keep mutex, tu_fifo_config() does not touch it
+  return tu_fifo_config(&audio->ep_out_ff, buffer, (tu_fifo_size_t) bufsize, 1, true);
+}
+
+
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_DECODING && CFG_TUD_AUDIO_ENABLE_EP_OUT
@@ -686,14 +864,14 @@ bool tud_audio_n_clear_rx_support_ff(uint8_t func_id, uint8_t ff_idx) {
   return tu_fifo_clear(&_audiod_fct[func_id].rx_supp_ff[ff_idx]);
 }
 
-uint16_t tud_audio_n_available_support_ff(uint8_t func_id, uint8_t ff_idx) {
+uint32_t tud_audio_n_available_support_ff(uint8_t func_id, uint8_t ff_idx) {
   TU_VERIFY(func_id < CFG_TUD_AUDIO && _audiod_fct[func_id].p_desc != NULL && ff_idx < _audiod_fct[func_id].n_rx_supp_ff);
   return tu_fifo_count(&_audiod_fct[func_id].rx_supp_ff[ff_idx]);
 }
 
-uint16_t tud_audio_n_read_support_ff(uint8_t func_id, uint8_t ff_idx, void *buffer, uint16_t bufsize) {
+uint32_t tud_audio_n_read_support_ff(uint8_t func_id, uint8_t ff_idx, void *buffer, uint32_t bufsize) {
   TU_VERIFY(func_id < CFG_TUD_AUDIO && _audiod_fct[func_id].p_desc != NULL && ff_idx < _audiod_fct[func_id].n_rx_supp_ff);
-  return tu_fifo_read_n(&_audiod_fct[func_id].rx_supp_ff[ff_idx], buffer, bufsize);
+  return tu_fifo_read_n(&_audiod_fct[func_id].rx_supp_ff[ff_idx], buffer, (tu_fifo_size_t) tu_min32(bufsize, TU_FIFO_SIZE_MAX));
 }
 
 tu_fifo_t *tud_audio_n_get_rx_support_ff(uint8_t func_id, uint8_t ff_idx) {
@@ -709,11 +887,10 @@ tu_fifo_t *tud_audio_n_get_rx_support_ff(uint8_t func_id, uint8_t ff_idx) {
 
 static bool audiod_rx_done_cb(uint8_t rhport, audiod_function_t *audio, uint16_t n_bytes_received) {
   uint8_t idxItf = 0;
-  uint8_t const *dummy2;
   uint8_t idx_audio_fct = 0;
 
   idx_audio_fct = audiod_get_audio_fct_idx(audio);
-  TU_VERIFY(audiod_get_AS_interface_index(audio->ep_out_as_intf_num, audio, &idxItf, &dummy2));
+  TU_VERIFY(audiod_get_AS_interface_index(audio->ep_out_as_intf_num, audio, &idxItf));
 
   // Call a weak callback here - a possibility for user to get informed an audio packet was received and data gets now loaded into EP FIFO (or decoded into support RX software FIFO)
   TU_VERIFY(tud_audio_rx_done_pre_read_cb(rhport, n_bytes_received, idx_audio_fct, audio->ep_out, audio->alt_setting[idxItf]));
@@ -781,50 +958,72 @@ static bool audiod_rx_done_cb(uint8_t rhport, audiod_function_t *audio, uint16_t
 
 #endif//CFG_TUD_AUDIO_ENABLE_EP_OUT
 
+#if (CFG_TUD_AUDIO_ENABLE_DECODING && CFG_TUD_AUDIO_ENABLE_EP_OUT) || (CFG_TUD_AUDIO_ENABLE_ENCODING && CFG_TUD_AUDIO_ENABLE_EP_IN)
+// Copy n_blocks of n_units each, advancing dst/src by given step (in units) after every block.
+// Inlined with constant n_units so that the inner loop of common layouts is fully unrolled.
+#define AUDIOD_COPY_BLOCKS_DEF(_name, _type)                                                                   \
+  TU_ATTR_ALWAYS_INLINE static inline void _name(_type *dst, uint_fast16_t dst_step, _type const *src,         \
+                                                 uint_fast16_t src_step, uint_fast16_t n_units, uint_fast16_t n_blocks) { \
+    while (n_blocks--) {                                                                                        \
+      for (uint_fast16_t i = 0; i < n_units; i++) {                                                            \
+        dst[i] = src[i];                                                                                        \
+      }                                                                                                         \
+      dst += dst_step;                                                                                          \
+      src += src_step;                                                                                          \
+    }                                                                                                           \
+  }
+
+AUDIOD_COPY_BLOCKS_DEF(audiod_copy_blocks32, uint32_t)
+AUDIOD_COPY_BLOCKS_DEF(audiod_copy_blocks16, uint16_t)
+AUDIOD_COPY_BLOCKS_DEF(audiod_copy_blocks8, uint8_t)
+
+// Copy n_blocks of block_sz bytes with dst_step/src_step byte distance between blocks.
+// A block is all channels of one FIFO for one sample: the widest access allowed by block size is used, since
+// FIFO buffers, linear buffers and FIFO depth are aligned to block size (see set_interface)
+static void audiod_interleaved_copy(uint8_t *dst, uint16_t dst_step, uint8_t const *src, uint16_t src_step,
+                                    uint16_t block_sz, uint16_t n_blocks) {
+  if (dst_step == block_sz && src_step == block_sz) {
+    // only one FIFO is used, nothing to interleave
+    memcpy(dst, src, (size_t) block_sz * n_blocks);
+  } else if (0 == (block_sz & 3u)) {
+    uint32_t *dst32 = (uint32_t *) (uintptr_t) dst;
+    uint32_t const *src32 = (uint32_t const *) (uintptr_t) src;
+    dst_step /= 4;
+    src_step /= 4;
+    switch (block_sz) {
+      case 4:  audiod_copy_blocks32(dst32, dst_step, src32, src_step, 1, n_blocks); break; // 16-bit stereo
+      case 8:  audiod_copy_blocks32(dst32, dst_step, src32, src_step, 2, n_blocks); break; // 32-bit stereo, 16-bit 4ch
+      case 16: audiod_copy_blocks32(dst32, dst_step, src32, src_step, 4, n_blocks); break; // 32-bit 4ch, 16-bit 8ch
+      case 32: audiod_copy_blocks32(dst32, dst_step, src32, src_step, 8, n_blocks); break; // 32-bit 8ch
+      default: audiod_copy_blocks32(dst32, dst_step, src32, src_step, block_sz / 4u, n_blocks); break;
+    }
+  } else if (0 == (block_sz & 1u)) {
+    uint16_t *dst16 = (uint16_t *) (uintptr_t) dst;
+    uint16_t const *src16 = (uint16_t const *) (uintptr_t) src;
+    dst_step /= 2;
+    src_step /= 2;
+    switch (block_sz) {
+      case 2:  audiod_copy_blocks16(dst16, dst_step, src16, src_step, 1, n_blocks); break; // 8-bit stereo, 16-bit mono
+      case 6:  audiod_copy_blocks16(dst16, dst_step, src16, src_step, 3, n_blocks); break; // 24-bit stereo
+      default: audiod_copy_blocks16(dst16, dst_step, src16, src_step, block_sz / 2u, n_blocks); break;
+    }
+  } else {
+    audiod_copy_blocks8(dst, dst_step, src, src_step, block_sz, n_blocks);
+  }
+}
+#endif
+
 // The following functions are used in case CFG_TUD_AUDIO_ENABLE_DECODING != 0
 #if CFG_TUD_AUDIO_ENABLE_DECODING && CFG_TUD_AUDIO_ENABLE_EP_OUT
 
 // Decoding according to 2.3.1.5 Audio Streams
 
-// Helper function
-static inline void *audiod_interleaved_copy_bytes_fast_decode(uint16_t const nBytesPerSample, void *dst, const void *dst_end, void *src, uint8_t const n_ff_used) {
-  // Due to one FIFO contains 2 channels, data always aligned to (nBytesPerSample * 2)
-  uint16_t *dst16 = dst;
-  uint16_t *src16 = src;
-  const uint16_t *dst_end16 = dst_end;
-  uint32_t *dst32 = dst;
-  uint32_t *src32 = src;
-  const uint32_t *dst_end32 = dst_end;
-
-  if (nBytesPerSample == 1) {
-    while (dst16 < dst_end16) {
-      *dst16++ = *src16++;
-      src16 += n_ff_used - 1;
-    }
-    return src16;
-  } else if (nBytesPerSample == 2) {
-    while (dst32 < dst_end32) {
-      *dst32++ = *src32++;
-      src32 += n_ff_used - 1;
-    }
-    return src32;
-  } else if (nBytesPerSample == 3) {
-    while (dst16 < dst_end16) {
-      *dst16++ = *src16++;
-      *dst16++ = *src16++;
-      *dst16++ = *src16++;
-      src16 += 3 * (n_ff_used - 1);
-    }
-    return src16;
-  } else// nBytesPerSample == 4
-  {
-    while (dst32 < dst_end32) {
-      *dst32++ = *src32++;
-      *dst32++ = *src32++;
-      src32 += 2 * (n_ff_used - 1);
-    }
-    return src32;
-  }
+// Helper function: de-interleave blocks (all channels of one FIFO) from src into FIFO's linear part dst
+static inline void *audiod_interleaved_copy_bytes_fast_decode(uint16_t const nBytesPerBlock, void *dst, const void *dst_end, void *src, uint8_t const n_ff_used) {
+  uint16_t const n_blocks = (uint16_t) (((uint8_t const *) dst_end - (uint8_t const *) dst) / nBytesPerBlock);
+  uint16_t const src_step = (uint16_t) (nBytesPerBlock * n_ff_used);
+  audiod_interleaved_copy(dst, nBytesPerBlock, src, src_step, nBytesPerBlock, n_blocks);
+  return (uint8_t *) src + (uint32_t) n_blocks * src_step;
 }
 
 static bool audiod_decode_type_I_pcm(uint8_t rhport, audiod_function_t *audio, uint16_t n_bytes_received) {
@@ -833,6 +1032,7 @@ static bool audiod_decode_type_I_pcm(uint8_t rhport, audiod_function_t *audio, u
   // Determine amount of samples
   uint8_t const n_ff_used = audio->n_ff_used_rx;
   uint16_t const nBytesPerFFToRead = n_bytes_received / n_ff_used;
+  uint16_t const nBytesPerBlock = (uint16_t) (audio->n_channels_per_ff_rx * audio->n_bytes_per_sample_rx);
   uint8_t cnt_ff;
 
   // Decode
@@ -845,16 +1045,16 @@ static bool audiod_decode_type_I_pcm(uint8_t rhport, audiod_function_t *audio, u
     tu_fifo_get_write_info(&audio->rx_supp_ff[cnt_ff], &info);
 
     if (info.len_lin != 0) {
-      info.len_lin = tu_min16(nBytesPerFFToRead, info.len_lin);
+      info.len_lin = (tu_fifo_size_t) tu_min32(nBytesPerFFToRead, info.len_lin);
       src = &audio->lin_buf_out[cnt_ff * audio->n_channels_per_ff_rx * audio->n_bytes_per_sample_rx];
       dst_end = info.ptr_lin + info.len_lin;
-      src = audiod_interleaved_copy_bytes_fast_decode(audio->n_bytes_per_sample_rx, info.ptr_lin, dst_end, src, n_ff_used);
+      src = audiod_interleaved_copy_bytes_fast_decode(nBytesPerBlock, info.ptr_lin, dst_end, src, n_ff_used);
 
       // Handle wrapped part of FIFO
-      info.len_wrap = tu_min16(nBytesPerFFToRead - info.len_lin, info.len_wrap);
+      info.len_wrap = (tu_fifo_size_t) tu_min32(nBytesPerFFToRead - info.len_lin, info.len_wrap);
       if (info.len_wrap != 0) {
         dst_end = info.ptr_wrap + info.len_wrap;
-        audiod_interleaved_copy_bytes_fast_decode(audio->n_bytes_per_sample_rx, info.ptr_wrap, dst_end, src, n_ff_used);
+        audiod_interleaved_copy_bytes_fast_decode(nBytesPerBlock, info.ptr_wrap, dst_end, src, n_ff_used);
       }
       tu_fifo_advance_write_pointer(&audio->rx_supp_ff[cnt_ff], info.len_lin + info.len_wrap);
     }
@@ -890,9 +1090,9 @@ static bool audiod_decode_type_I_pcm(uint8_t rhport, audiod_function_t *audio, u
  * \param[in]       len: # of array elements to copy
  * \return          Number of bytes actually written
  */
-uint16_t tud_audio_n_write(uint8_t func_id, const void *data, uint16_t len) {
+uint32_t tud_audio_n_write(uint8_t func_id, const void *data, uint32_t len) {
   TU_VERIFY(func_id < CFG_TUD_AUDIO && _audiod_fct[func_id].p_desc != NULL);
-  return tu_fifo_write_n(&_audiod_fct[func_id].ep_in_ff, data, len);
+  return tu_fifo_write_n(&_audiod_fct[func_id].ep_in_ff, data, (tu_fifo_size_t) tu_min32(len, TU_FIFO_SIZE_MAX));
 }
 
 bool tud_audio_n_clear_ep_in_ff(uint8_t func_id)// Delete all content in the EP IN FIFO
@@ -910,19 +1110,16 @@ tu_fifo_t *tud_audio_n_get_ep_in_ff(uint8_t func_id) {
 
 #if CFG_TUD_AUDIO_ENABLE_ENCODING && CFG_TUD_AUDIO_ENABLE_EP_IN
 
-uint16_t tud_audio_n_flush_tx_support_ff(uint8_t func_id)// Force all content in the support TX FIFOs to be written into linear buffer and schedule a transmit
+uint32_t tud_audio_n_flush_tx_support_ff(uint8_t func_id)// Force all content in the support TX FIFOs to be written into linear buffer and schedule a transmit
 {
   TU_VERIFY(func_id < CFG_TUD_AUDIO && _audiod_fct[func_id].p_desc != NULL);
   audiod_function_t *audio = &_audiod_fct[func_id];
 
-  uint16_t n_bytes_copied = tu_fifo_count(&audio->tx_supp_ff[0]);
+  tu_fifo_size_t const count_before = tu_fifo_count(&audio->tx_supp_ff[0]);
 
   TU_VERIFY(audiod_tx_done_cb(audio->rhport, audio));
 
-  n_bytes_copied -= tu_fifo_count(&audio->tx_supp_ff[0]);
-  n_bytes_copied = n_bytes_copied * audio->tx_supp_ff[0].item_size;
-
-  return n_bytes_copied;
+  return (uint32_t) (count_before - tu_fifo_count(&audio->tx_supp_ff[0])) * audio->tx_supp_ff[0].item_size;
 }
 
 bool tud_audio_n_clear_tx_support_ff(uint8_t func_id, uint8_t ff_idx) {
@@ -930,9 +1127,9 @@ bool tud_audio_n_clear_tx_support_ff(uint8_t func_id, uint8_t ff_idx) {
   return tu_fifo_clear(&_audiod_fct[func_id].tx_supp_ff[ff_idx]);
 }
 
-uint16_t tud_audio_n_write_support_ff(uint8_t func_id, uint8_t ff_idx, const void *data, uint16_t len) {
+uint32_t tud_audio_n_write_support_ff(uint8_t func_id, uint8_t ff_idx, const void *data, uint32_t len) {
   TU_VERIFY(func_id < CFG_TUD_AUDIO && _audiod_fct[func_id].p_desc != NULL && ff_idx < _audiod_fct[func_id].n_tx_supp_ff);
-  return tu_fifo_write_n(&_audiod_fct[func_id].tx_supp_ff[ff_idx], data, len);
+  return tu_fifo_write_n(&_audiod_fct[func_id].tx_supp_ff[ff_idx], data, (tu_fifo_size_t) tu_min32(len, TU_FIFO_SIZE_MAX));
 }
 
 tu_fifo_t *tud_audio_n_get_tx_support_ff(uint8_t func_id, uint8_t ff_idx) {
@@ -973,10 +1170,9 @@ bool tud_audio_int_n_write(uint8_t func_id, const audio_interrupt_data_t *data)
 #if CFG_TUD_AUDIO_ENABLE_EP_IN
 static bool audiod_tx_done_cb(uint8_t rhport, audiod_function_t *audio) {
   uint8_t idxItf;
-  uint8_t const *dummy2;
 
   uint8_t idx_audio_fct = audiod_get_audio_fct_idx(audio);
-  TU_VERIFY(audiod_get_AS_interface_index(audio->ep_in_as_intf_num, audio, &idxItf, &dummy2));
+  TU_VERIFY(audiod_get_AS_interface_index(audio->ep_in_as_intf_num, audio, &idxItf));
 
   // Only send something if current alternate interface is not 0 as in this case nothing is to be sent due to UAC2 specifications
   if (audio->alt_setting[idxItf] == 0) return false;
@@ -1028,10 +1224,9 @@ static bool audiod_tx_done_cb(uint8_t rhport, audiod_function_t *audio) {
   #else
     // No support FIFOs, if no linear buffer required schedule transmit, else put data into linear buffer and schedule
     #if CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL
-  // packet_sz_tx is based on total packet size, here we want size for each support buffer.
-  n_bytes_tx = audiod_tx_packet_size(audio->packet_sz_tx, tu_fifo_count(&audio->ep_in_ff), audio->ep_in_ff.depth, audio->ep_in_sz);
+  n_bytes_tx = audiod_tx_packet_size(audio, tu_fifo_count(&audio->ep_in_ff), audio->ep_in_sz);
     #else
-  n_bytes_tx = tu_min16(tu_fifo_count(&audio->ep_in_ff), audio->ep_in_sz);// Limit up to max packet size, more can not be done for ISO
+  n_bytes_tx = (uint16_t) tu_min32(tu_fifo_count(&audio->ep_in_ff), audio->ep_in_sz);// Limit up to max packet size, more can not be done for ISO
     #endif
     #if USE_LINEAR_BUFFER_TX
   tu_fifo_read_n(&audio->ep_in_ff, audio->lin_buf_in, n_bytes_tx);
@@ -1069,45 +1264,12 @@ range [-1, +1)
  * does not change the number of bytes per sample.
  * */
 
-// Helper function
-static inline void *audiod_interleaved_copy_bytes_fast_encode(uint16_t const nBytesPerSample, void *src, const void *src_end, void *dst, uint8_t const n_ff_used) {
-  // Due to one FIFO contains 2 channels, data always aligned to (nBytesPerSample * 2)
-  uint16_t *dst16 = dst;
-  uint16_t *src16 = src;
-  const uint16_t *src_end16 = src_end;
-  uint32_t *dst32 = dst;
-  uint32_t *src32 = src;
-  const uint32_t *src_end32 = src_end;
-
-  if (nBytesPerSample == 1) {
-    while (src16 < src_end16) {
-      *dst16++ = *src16++;
-      dst16 += n_ff_used - 1;
-    }
-    return dst16;
-  } else if (nBytesPerSample == 2) {
-    while (src32 < src_end32) {
-      *dst32++ = *src32++;
-      dst32 += n_ff_used - 1;
-    }
-    return dst32;
-  } else if (nBytesPerSample == 3) {
-    while (src16 < src_end16) {
-      *dst16++ = *src16++;
-      *dst16++ = *src16++;
-      *dst16++ = *src16++;
-      dst16 += 3 * (n_ff_used - 1);
-    }
-    return dst16;
-  } else// nBytesPerSample == 4
-  {
-    while (src32 < src_end32) {
-      *dst32++ = *src32++;
-      *dst32++ = *src32++;
-      dst32 += 2 * (n_ff_used - 1);
-    }
-    return dst32;
-  }
+// Helper function: interleave blocks (all channels of one FIFO) from FIFO's linear part src into dst
+static inline void *audiod_interleaved_copy_bytes_fast_encode(uint16_t const nBytesPerBlock, void *src, const void *src_end, void *dst, uint8_t const n_ff_used) {
+  uint16_t const n_blocks = (uint16_t) (((uint8_t const *) src_end - (uint8_t const *) src) / nBytesPerBlock);
+  uint16_t const dst_step = (uint16_t) (nBytesPerBlock * n_ff_used);
+  audiod_interleaved_copy(dst, dst_step, src, nBytesPerBlock, nBytesPerBlock, n_blocks);
+  return (uint8_t *) dst + (uint32_t) n_blocks * dst_step;
 }
 
 static uint16_t audiod_encode_type_I_pcm(uint8_t rhport, audiod_function_t *audio) {
@@ -1119,31 +1281,29 @@ static uint16_t audiod_encode_type_I_pcm(uint8_t rhport, audiod_function_t *audi
 
   // Determine amount of samples
   uint8_t const n_ff_used = audio->n_ff_used_tx;
-  uint16_t nBytesPerFFToSend = tu_fifo_count(&audio->tx_supp_ff[0]);
+  tu_fifo_size_t ff_count = tu_fifo_count(&audio->tx_supp_ff[0]);
   uint8_t cnt_ff;
 
   for (cnt_ff = 1; cnt_ff < n_ff_used; cnt_ff++) {
-    uint16_t const count = tu_fifo_count(&audio->tx_supp_ff[cnt_ff]);
-    if (count < nBytesPerFFToSend) {
-      nBytesPerFFToSend = count;
+    tu_fifo_size_t const count = tu_fifo_count(&audio->tx_supp_ff[cnt_ff]);
+    if (count < ff_count) {
+      ff_count = count;
     }
   }
 
+  uint16_t const nSlotSize = (uint16_t) (audio->n_channels_per_ff_tx * audio->n_bytes_per_sample_tx);
+
   #if CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL
-  const uint16_t norm_packet_sz_tx[3] = {audio->packet_sz_tx[0] / n_ff_used,
-                                         audio->packet_sz_tx[1] / n_ff_used,
-                                         audio->packet_sz_tx[2] / n_ff_used};
-  // packet_sz_tx is based on total packet size, here we want size for each support buffer.
-  nBytesPerFFToSend = audiod_tx_packet_size(norm_packet_sz_tx, nBytesPerFFToSend, audio->tx_supp_ff[0].depth, audio->ep_in_sz / n_ff_used);
+  // packet_sz_tx is already the size for each support buffer.
+  uint16_t const nBytesPerFFToSend = audiod_tx_packet_size(audio, ff_count, audio->ep_in_sz / n_ff_used);
   // Check if there is enough data
   if (nBytesPerFFToSend == 0) return 0;
   #else
   // Check if there is enough data
-  if (nBytesPerFFToSend == 0) return 0;
+  if (ff_count == 0) return 0;
   // Limit to maximum sample number - THIS IS A POSSIBLE ERROR SOURCE IF TOO MANY SAMPLE WOULD NEED TO BE SENT BUT CAN NOT!
-  nBytesPerFFToSend = tu_min16(nBytesPerFFToSend, audio->ep_in_sz / n_ff_used);
+  uint16_t nBytesPerFFToSend = (uint16_t) tu_min32(ff_count, audio->ep_in_sz / n_ff_used);
   // Round to full number of samples (flooring)
-  uint16_t const nSlotSize = audio->n_channels_per_ff_tx * audio->n_bytes_per_sample_tx;
   nBytesPerFFToSend = (nBytesPerFFToSend / nSlotSize) * nSlotSize;
   #endif
 
@@ -1159,17 +1319,17 @@ static uint16_t audiod_encode_type_I_pcm(uint8_t rhport, audiod_function_t *audi
     tu_fifo_get_read_info(&audio->tx_supp_ff[cnt_ff], &info);
 
     if (info.len_lin != 0) {
-      info.len_lin = tu_min16(nBytesPerFFToSend, info.len_lin);// Limit up to desired length
+      info.len_lin = (tu_fifo_size_t) tu_min32(nBytesPerFFToSend, info.len_lin);// Limit up to desired length
       src_end = (uint8_t *) info.ptr_lin + info.len_lin;
-      dst = audiod_interleaved_copy_bytes_fast_encode(audio->n_bytes_per_sample_tx, info.ptr_lin, src_end, dst, n_ff_used);
+      dst = audiod_interleaved_copy_bytes_fast_encode(nSlotSize, info.ptr_lin, src_end, dst, n_ff_used);
 
       // Limit up to desired length
-      info.len_wrap = tu_min16(nBytesPerFFToSend - info.len_lin, info.len_wrap);
+      info.len_wrap = (tu_fifo_size_t) tu_min32(nBytesPerFFToSend - info.len_lin, info.len_wrap);
 
       // Handle wrapped part of FIFO
       if (info.len_wrap != 0) {
         src_end = (uint8_t *) info.ptr_wrap + info.len_wrap;
-        audiod_interleaved_copy_bytes_fast_encode(audio->n_bytes_per_sample_tx, info.ptr_wrap, src_end, dst, n_ff_used);
+        audiod_interleaved_copy_bytes_fast_encode(nSlotSize, info.ptr_wrap, src_end, dst, n_ff_used);
       }
 
       tu_fifo_advance_read_pointer(&audio->tx_supp_ff[cnt_ff], info.len_lin + info.len_wrap);
@@ -1322,6 +1482,8 @@ void audiod_init(void) {
   #if CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ > 0
       case 0:
         tu_fifo_config(&audio->ep_out_ff, ep_out_sw_buf.buf_1, CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ, 1, true);
+        audio->ep_out_sw_buf = ep_out_sw_buf.buf_1;
+        audio->ep_out_sw_buf_sz = CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ;
     #if CFG_FIFO_MUTEX
         tu_fifo_config_mutex(&audio->ep_out_ff, NULL, osal_mutex_create(&ep_out_ff_mutex_rd_1));
     #endif
@@ -1330,6 +1492,8 @@ void audiod_init(void) {
   #if CFG_TUD_AUDIO > 1 && CFG_TUD_AUDIO_FUNC_2_EP_OUT_SW_BUF_SZ > 0
       case 1:
         tu_fifo_config(&audio->ep_out_ff, ep_out_sw_buf.buf_2, CFG_TUD_AUDIO_FUNC_2_EP_OUT_SW_BUF_SZ, 1, true);
+        audio->ep_out_sw_buf = ep_out_sw_buf.buf_2;
+        audio->ep_out_sw_buf_sz = CFG_TUD_AUDIO_FUNC_2_EP_OUT_SW_BUF_SZ;
     #if CFG_FIFO_MUTEX
         tu_fifo_config_mutex(&audio->ep_out_ff, NULL, osal_mutex_create(&ep_out_ff_mutex_rd_2));
     #endif
@@ -1338,6 +1502,8 @@ void audiod_init(void) {
   #if CFG_TUD_AUDIO > 2 && CFG_TUD_AUDIO_FUNC_3_EP_OUT_SW_BUF_SZ > 0
       case 2:
         tu_fifo_config(&audio->ep_out_ff, ep_out_sw_buf.buf_3, CFG_TUD_AUDIO_FUNC_3_EP_OUT_SW_BUF_SZ, 1, true);
+        audio->ep_out_sw_buf = ep_out_sw_buf.buf_3;
+        audio->ep_out_sw_buf_sz = CFG_TUD_AUDIO_FUNC_3_EP_OUT_SW_BUF_SZ;
     #if CFG_FIFO_MUTEX
         tu_fifo_config_mutex(&audio->ep_out_ff, NULL, osal_mutex_create(&ep_out_ff_mutex_rd_3));
     #endif
@@ -1608,6 +1774,10 @@ uint16_t audiod_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc, uint
 #endif
       }
 
+      // Parse all alternate settings of AS interfaces once, SET_INTERFACE only needs to look them up
+      audiod_parse_AS_alt_table(&_audiod_fct[i]);
+      TU_ASSERT(audiod_parse_index(&_audiod_fct[i]), 0);
+
 #ifdef TUP_DCD_EDPT_ISO_ALLOC
       {
   #if CFG_TUD_AUDIO_ENABLE_EP_IN
@@ -1641,12 +1811,12 @@ uint16_t audiod_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc, uint
                 if (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN) {
   #if CFG_TUD_AUDIO_ENABLE_EP_IN
                   ep_in = desc_ep->bEndpointAddress;
-                  ep_in_size = TU_MAX(tu_edpt_packet_size(desc_ep), ep_in_size);
+                  ep_in_size = TU_MAX(tu_edpt_interval_size(desc_ep), ep_in_size);
   #endif
                 } else {
   #if CFG_TUD_AUDIO_ENABLE_EP_OUT
                   ep_out = desc_ep->bEndpointAddress;
-                  ep_out_size = TU_MAX(tu_edpt_packet_size(desc_ep), ep_out_size);
+                  ep_out_size = TU_MAX(tu_edpt_interval_size(desc_ep), ep_out_size);
   #endif
                 }
               }
@@ -1682,16 +1852,7 @@ uint16_t audiod_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc, uint
         uint8_t const *p_desc_end = p_desc + _audiod_fct[i].desc_length - TUD_AUDIO_DESC_IAD_LEN;
         // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
         while (p_desc_end - p_desc > 0) {
-          if (tu_desc_type(p_desc) == TUSB_DESC_ENDPOINT) {
-            tusb_desc_endpoint_t const *desc_ep = (tusb_desc_endpoint_t const *) p_desc;
-            if (desc_ep->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS) {
-              if (desc_ep->bmAttributes.usage == 0) {
-                if (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN) {
-                  _audiod_fct[i].interval_tx = desc_ep->bInterval;
-                }
-              }
-            }
-          } else if (tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE && tu_desc_subtype(p_desc) == AUDIO_CS_AC_INTERFACE_OUTPUT_TERMINAL) {
+          if (tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE && tu_desc_subtype(p_desc) == AUDIO_CS_AC_INTERFACE_OUTPUT_TERMINAL) {
             if (tu_unaligned_read16(p_desc + 4) == AUDIO_TERM_TYPE_USB_STREAMING) {
               _audiod_fct[i].bclock_id_tx = p_desc[8];
             }
@@ -1742,9 +1903,8 @@ static bool audiod_get_interface(uint8_t rhport, tusb_control_request_t const *p
 
   // Find index of audio streaming interface
   uint8_t func_id, idxItf;
-  uint8_t const *dummy;
 
-  TU_VERIFY(audiod_get_AS_interface_index_global(itf, &func_id, &idxItf, &dummy));
+  TU_VERIFY(audiod_get_AS_interface_index_global(itf, &func_id, &idxItf));
   TU_VERIFY(tud_control_xfer(rhport, p_request, &_audiod_fct[func_id].alt_setting[idxItf], 1));
 
   TU_LOG2("  Get itf: %u - current alt: %u\r\n", itf, _audiod_fct[func_id].alt_setting[idxItf]);
@@ -1758,8 +1918,7 @@ static bool audiod_set_interface(uint8_t rhport, tusb_control_request_t const *p
   // Here we need to do the following:
 
   // 1. Find the audio driver assigned to the given interface to be set
-  // Since one audio driver interface has to be able to cover an unknown number of interfaces (AC, AS + its alternate settings), the best memory efficient way to solve this is to always search through the descriptors.
-  // The audio driver is mapped to an audio function by a reference pointer to the corresponding AC interface of this audio function which serves as a starting point for searching
+  // AS interfaces and their alternate settings are indexed in audiod_open(), see audiod_parse_index() and audiod_parse_AS_alt_table()
 
   // 2. Close EPs which are currently open
   // To do so it is not necessary to know the current active alternate interface since we already save the current EP addresses - we simply close them
@@ -1773,8 +1932,7 @@ static bool audiod_set_interface(uint8_t rhport, tusb_control_request_t const *p
 
   // Find index of audio streaming interface and index of interface
   uint8_t func_id, idxItf;
-  uint8_t const *p_desc;
-  TU_VERIFY(audiod_get_AS_interface_index_global(itf, &func_id, &idxItf, &p_desc));
+  TU_VERIFY(audiod_get_AS_interface_index_global(itf, &func_id, &idxItf));
 
   audiod_function_t *audio = &_audiod_fct[func_id];
 
@@ -1843,171 +2001,184 @@ static bool audiod_set_interface(uint8_t rhport, tusb_control_request_t const *p
   // Save current alternative interface setting
   audio->alt_setting[idxItf] = alt;
 
-  // Open new EP if necessary - EPs are only to be closed or opened for AS interfaces - Look for AS interface with correct alternate interface
+  // Open new EP if necessary - EPs are only to be closed or opened for AS interfaces - Look up AS interface with correct alternate interface
   // Get pointer at end
   uint8_t const *p_desc_end = audio->p_desc + audio->desc_length - TUD_AUDIO_DESC_IAD_LEN;
 
-  // p_desc starts at required interface with alternate setting zero
-  // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
-  while (p_desc_end - p_desc > 0) {
-    // Find correct interface
-    if (tu_desc_type(p_desc) == TUSB_DESC_INTERFACE && ((tusb_desc_interface_t const *) p_desc)->bInterfaceNumber == itf && ((tusb_desc_interface_t const *) p_desc)->bAlternateSetting == alt) {
-#if (CFG_TUD_AUDIO_ENABLE_EP_IN && (CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL || CFG_TUD_AUDIO_ENABLE_ENCODING)) || (CFG_TUD_AUDIO_ENABLE_EP_OUT && CFG_TUD_AUDIO_ENABLE_DECODING)
-      uint8_t const *p_desc_parse_for_params = p_desc;
-#endif
-      // From this point forward follow the EP descriptors associated to the current alternate setting interface - Open EPs if necessary
-      uint8_t foundEPs = 0, nEps = ((tusb_desc_interface_t const *) p_desc)->bNumEndpoints;
-      // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
-      while (foundEPs < nEps && (p_desc_end - p_desc > 0)) {
-        if (tu_desc_type(p_desc) == TUSB_DESC_ENDPOINT) {
-          tusb_desc_endpoint_t const *desc_ep = (tusb_desc_endpoint_t const *) p_desc;
+  audiod_as_alt_t as_alt;
+  if (audiod_get_AS_alt(audio, itf, alt, &as_alt)) {
+    uint8_t const *p_desc = audio->p_desc + as_alt.desc_offset;
+
+    // From this point forward follow the EP descriptors associated to the current alternate setting interface - Open EPs if necessary
+    uint8_t foundEPs = 0, nEps = ((tusb_desc_interface_t const *) p_desc)->bNumEndpoints;
+    // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
+    while (foundEPs < nEps && (p_desc_end - p_desc > 0)) {
+      if (tu_desc_type(p_desc) == TUSB_DESC_ENDPOINT) {
+        tusb_desc_endpoint_t const *desc_ep = (tusb_desc_endpoint_t const *) p_desc;
 #ifdef TUP_DCD_EDPT_ISO_ALLOC
-          TU_ASSERT(usbd_edpt_iso_activate(rhport, desc_ep));
+        TU_ASSERT(usbd_edpt_iso_activate(rhport, desc_ep));
 #else
-          TU_ASSERT(usbd_edpt_open(rhport, desc_ep));
+        TU_ASSERT(usbd_edpt_open(rhport, desc_ep));
 #endif
-          uint8_t const ep_addr = desc_ep->bEndpointAddress;
+        uint8_t const ep_addr = desc_ep->bEndpointAddress;
 
-          //TODO: We need to set EP non busy since this is not taken care of right now in ep_close() - THIS IS A WORKAROUND!
-          usbd_edpt_clear_stall(rhport, ep_addr);
+        //TODO: We need to set EP non busy since this is not taken care of right now in ep_close() - THIS IS A WORKAROUND!
+        usbd_edpt_clear_stall(rhport, ep_addr);
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN
-          if (tu_edpt_dir(ep_addr) == TUSB_DIR_IN && desc_ep->bmAttributes.usage == 0x00)// Check if usage is data EP
-          {
-            // Save address
-            audio->ep_in = ep_addr;
-            audio->ep_in_as_intf_num = itf;
-            audio->ep_in_sz = tu_edpt_packet_size(desc_ep);
-
-            // If software encoding is enabled, parse for the corresponding parameters - doing this here means only AS interfaces with EPs get scanned for parameters
+        if (tu_edpt_dir(ep_addr) == TUSB_DIR_IN && desc_ep->bmAttributes.usage == 0x00)// Check if usage is data EP
+        {
+          // Save address
+          audio->ep_in = ep_addr;
+          audio->ep_in_as_intf_num = itf;
+          audio->ep_in_sz = tu_edpt_interval_size(desc_ep); // all transactions of a high-bandwidth micro-frame
+
+          // If software encoding is enabled, take the corresponding parameters parsed for this alternate setting
   #if CFG_TUD_AUDIO_ENABLE_ENCODING || CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL
-            audiod_parse_for_AS_params(audio, p_desc_parse_for_params, p_desc_end, itf);
+          audio->n_channels_tx = as_alt.n_channels;
+          audio->format_type_tx = (audio_format_type_t) as_alt.format_type;
+          audio->n_bytes_per_sample_tx = as_alt.n_bytes_per_sample;
+    #if CFG_TUD_AUDIO_ENABLE_TYPE_I_ENCODING
+          audio->format_type_I_tx = (audio_data_format_type_I_t) as_alt.formats;
+    #endif
+    #if CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL
+          audio->interval_tx = desc_ep->bInterval;
+    #endif
 
-              // Reconfigure size of support FIFOs - this is necessary to avoid samples to get split in case of a wrap
+            // Reconfigure size of support FIFOs - this is necessary to avoid samples to get split in case of a wrap
     #if CFG_TUD_AUDIO_ENABLE_ENCODING && CFG_TUD_AUDIO_ENABLE_TYPE_I_ENCODING
-            const uint16_t active_fifo_depth = (uint16_t) ((audio->tx_supp_ff_sz_max / (audio->n_channels_per_ff_tx * audio->n_bytes_per_sample_tx)) * (audio->n_channels_per_ff_tx * audio->n_bytes_per_sample_tx));
-            for (uint8_t cnt = 0; cnt < audio->n_tx_supp_ff; cnt++) {
-              tu_fifo_config(&audio->tx_supp_ff[cnt], audio->tx_supp_ff[cnt].buffer, active_fifo_depth, 1, true);
-            }
-            audio->n_ff_used_tx = audio->n_channels_tx / audio->n_channels_per_ff_tx;
-            TU_ASSERT(audio->n_ff_used_tx <= audio->n_tx_supp_ff);
+          const uint16_t active_fifo_depth = (uint16_t) ((audio->tx_supp_ff_sz_max / (audio->n_channels_per_ff_tx * audio->n_bytes_per_sample_tx)) * (audio->n_channels_per_ff_tx * audio->n_bytes_per_sample_tx));
+          for (uint8_t cnt = 0; cnt < audio->n_tx_supp_ff; cnt++) {
+            tu_fifo_config(&audio->tx_supp_ff[cnt], audio->tx_supp_ff[cnt].buffer, active_fifo_depth, 1, true);
+          }
+          audio->n_ff_used_tx = audio->n_channels_tx / audio->n_channels_per_ff_tx;
+          TU_ASSERT(audio->n_ff_used_tx <= audio->n_tx_supp_ff);
     #endif
   #endif
 
-            // Schedule first transmit if alternate interface is not zero i.e. streaming is disabled - in case no sample data is available a ZLP is loaded
-            // It is necessary to trigger this here since the refill is done with an RX FIFO empty interrupt which can only trigger if something was in there
-            TU_VERIFY(audiod_tx_done_cb(rhport, &_audiod_fct[func_id]));
-          }
+          // Schedule first transmit if alternate interface is not zero i.e. streaming is disabled - in case no sample data is available a ZLP is loaded
+          // It is necessary to trigger this here since the refill is done with an RX FIFO empty interrupt which can only trigger if something was in there
+          TU_VERIFY(audiod_tx_done_cb(rhport, &_audiod_fct[func_id]));
+        }
 #endif// CFG_TUD_AUDIO_ENABLE_EP_IN
 
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT
 
-          if (tu_edpt_dir(ep_addr) == TUSB_DIR_OUT)// Checking usage not necessary
-          {
-            // Save address
-            audio->ep_out = ep_addr;
-            audio->ep_out_as_intf_num = itf;
-            audio->ep_out_sz = tu_edpt_packet_size(desc_ep);
+        if (tu_edpt_dir(ep_addr) == TUSB_DIR_OUT)// Checking usage not necessary
+        {
+          // Save address
+          audio->ep_out = ep_addr;
+          audio->ep_out_as_intf_num = itf;
+          audio->ep_out_sz = tu_edpt_interval_size(desc_ep);
 
   #if CFG_TUD_AUDIO_ENABLE_DECODING
-            audiod_parse_for_AS_params(audio, p_desc_parse_for_params, p_desc_end, itf);
+          audio->n_channels_rx = as_alt.n_channels;
+          audio->format_type_rx = (audio_format_type_t) as_alt.format_type;
+    #if CFG_TUD_AUDIO_ENABLE_TYPE_I_DECODING
+          audio->format_type_I_rx = (audio_data_format_type_I_t) as_alt.formats;
+          audio->n_bytes_per_sample_rx = as_alt.n_bytes_per_sample;
+    #endif
 
-              // Reconfigure size of support FIFOs - this is necessary to avoid samples to get split in case of a wrap
+            // Reconfigure size of support FIFOs - this is necessary to avoid samples to get split in case of a wrap
     #if CFG_TUD_AUDIO_ENABLE_TYPE_I_DECODING
-            const uint16_t active_fifo_depth = (audio->rx_supp_ff_sz_max / audio->n_bytes_per_sample_rx) * audio->n_bytes_per_sample_rx;
-            for (uint8_t cnt = 0; cnt < audio->n_rx_supp_ff; cnt++) {
-              tu_fifo_config(&audio->rx_supp_ff[cnt], audio->rx_supp_ff[cnt].buffer, active_fifo_depth, 1, true);
-            }
-            audio->n_ff_used_rx = audio->n_channels_rx / audio->n_channels_per_ff_rx;
-            TU_ASSERT(audio->n_ff_used_rx <= audio->n_rx_supp_ff);
+          const uint16_t active_fifo_depth = (uint16_t) ((audio->rx_supp_ff_sz_max / (audio->n_channels_per_ff_rx * audio->n_bytes_per_sample_rx)) * (audio->n_channels_per_ff_rx * audio->n_bytes_per_sample_rx));
+          for (uint8_t cnt = 0; cnt < audio->n_rx_supp_ff; cnt++) {
+            tu_fifo_config(&audio->rx_supp_ff[cnt], audio->rx_supp_ff[cnt].buffer, active_fifo_depth, 1, true);
+          }
+          audio->n_ff_used_rx = audio->n_channels_rx / audio->n_channels_per_ff_rx;
+          TU_ASSERT(audio->n_ff_used_rx <= audio->n_rx_supp_ff);
     #endif
   #endif
 
-            // Prepare for incoming data
+          // Prepare for incoming data
   #if USE_LINEAR_BUFFER_RX
-            TU_VERIFY(usbd_edpt_xfer(rhport, audio->ep_out, audio->lin_buf_out, audio->ep_out_sz), false);
+          TU_VERIFY(usbd_edpt_xfer(rhport, audio->ep_out, audio->lin_buf_out, audio->ep_out_sz), false);
   #else
-            TU_VERIFY(usbd_edpt_xfer_fifo(rhport, audio->ep_out, &audio->ep_out_ff, audio->ep_out_sz), false);
+          TU_VERIFY(usbd_edpt_xfer_fifo(rhport, audio->ep_out, &audio->ep_out_ff, audio->ep_out_sz), false);
   #endif
-          }
+        }
 
   #if CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
-          if (tu_edpt_dir(ep_addr) == TUSB_DIR_IN && desc_ep->bmAttributes.usage == 1)// Check if usage is explicit data feedback
-          {
-            audio->ep_fb = ep_addr;
-            audio->feedback.frame_shift = desc_ep->bInterval - 1;
-          }
+        if (tu_edpt_dir(ep_addr) == TUSB_DIR_IN && desc_ep->bmAttributes.usage == 1)// Check if usage is explicit data feedback
+        {
+          audio->ep_fb = ep_addr;
+          audio->feedback.frame_shift = desc_ep->bInterval - 1;
+    #if CFG_TUD_AUDIO_FEEDBACK_ISR_CALLBACK
+          usbd_edpt_isr_callback(rhport, ep_addr, true);
+    #endif
+        }
   #endif
 #endif// CFG_TUD_AUDIO_ENABLE_EP_OUT
 
-          foundEPs += 1;
-        }
-        p_desc = tu_desc_next(p_desc);
+        foundEPs += 1;
       }
+      p_desc = tu_desc_next(p_desc);
+    }
 
-      TU_VERIFY(foundEPs == nEps);
+    TU_VERIFY(foundEPs == nEps);
 
-      // Invoke one callback for a final set interface
-      TU_VERIFY(tud_audio_set_itf_cb(rhport, p_request));
+    // Invoke one callback for a final set interface
+    TU_VERIFY(tud_audio_set_itf_cb(rhport, p_request));
 
 #if CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
-      // Prepare feedback computation if endpoint is available
-      if (audio->ep_fb != 0) {
-        audio_feedback_params_t fb_param;
-
-        tud_audio_feedback_params_cb(func_id, alt, &fb_param);
-        audio->feedback.compute_method = fb_param.method;
-
-        if (TUSB_SPEED_FULL == tud_speed_get())
-          audio->feedback.format_correction = tud_audio_feedback_format_correction_cb(func_id);
-
-        // Minimal/Maximum value in 16.16 format for full speed (1ms per frame) or high speed (125 us per frame)
-        uint32_t const frame_div = (TUSB_SPEED_FULL == tud_speed_get()) ? 1000 : 8000;
-        audio->feedback.min_value = ((fb_param.sample_freq - 1) / frame_div) << 16;
-        audio->feedback.max_value = (fb_param.sample_freq / frame_div + 1) << 16;
-
-        switch (fb_param.method) {
-          case AUDIO_FEEDBACK_METHOD_FREQUENCY_FIXED:
-          case AUDIO_FEEDBACK_METHOD_FREQUENCY_FLOAT:
-          case AUDIO_FEEDBACK_METHOD_FREQUENCY_POWER_OF_2:
-            audiod_set_fb_params_freq(audio, fb_param.sample_freq, fb_param.frequency.mclk_freq);
-            break;
-
-          case AUDIO_FEEDBACK_METHOD_FIFO_COUNT: {
-            // Initialize the threshold level to half filled
-            uint16_t fifo_lvl_thr;
+    // Prepare feedback computation if endpoint is available
+    if (audio->ep_fb != 0) {
+      audio_feedback_params_t fb_param;
+
+      tud_audio_feedback_params_cb(func_id, alt, &fb_param);
+      audio->feedback.compute_method = fb_param.method;
+
+      if (TUSB_SPEED_FULL == tud_speed_get())
+        audio->feedback.format_correction = tud_audio_feedback_format_correction_cb(func_id);
+
+      // Minimal/Maximum value in 16.16 format for full speed (1ms per frame) or high speed (125 us per frame)
+      uint32_t const frame_div = (TUSB_SPEED_FULL == tud_speed_get()) ? 1000 : 8000;
+      audio->feedback.min_value = ((fb_param.sample_freq - 1) / frame_div) << 16;
+      audio->feedback.max_value = (fb_param.sample_freq / frame_div + 1) << 16;
+
+      switch (fb_param.method) {
+        case AUDIO_FEEDBACK_METHOD_FREQUENCY_FIXED:
+        case AUDIO_FEEDBACK_METHOD_FREQUENCY_FLOAT:
+        case AUDIO_FEEDBACK_METHOD_FREQUENCY_POWER_OF_2:
+          audiod_set_fb_params_freq(audio, fb_param.sample_freq, fb_param.frequency.mclk_freq);
+          break;
+
+        case AUDIO_FEEDBACK_METHOD_FIFO_COUNT: {
+          // Initialize the threshold level to half filled
+          tu_fifo_size_t fifo_lvl_thr;
   #if CFG_TUD_AUDIO_ENABLE_DECODING
-            fifo_lvl_thr = tu_fifo_depth(&audio->rx_supp_ff[0]) / 2;
+          fifo_lvl_thr = tu_fifo_depth(&audio->rx_supp_ff[0]) / 2;
   #else
-            fifo_lvl_thr = tu_fifo_depth(&audio->ep_out_ff) / 2;
-  #endif
-            audio->feedback.compute.fifo_count.fifo_lvl_thr = fifo_lvl_thr;
-            audio->feedback.compute.fifo_count.fifo_lvl_avg = ((uint32_t) fifo_lvl_thr) << 16;
-            // Avoid 64bit division
-            uint32_t nominal = ((fb_param.sample_freq / 100) << 16) / (frame_div / 100);
-            audio->feedback.compute.fifo_count.nom_value = nominal;
-            audio->feedback.compute.fifo_count.rate_const[0] = (uint16_t) ((audio->feedback.max_value - nominal) / fifo_lvl_thr);
-            audio->feedback.compute.fifo_count.rate_const[1] = (uint16_t) ((nominal - audio->feedback.min_value) / fifo_lvl_thr);
-            // On HS feedback is more sensitive since packet size can vary every MSOF, could cause instability
-            if (tud_speed_get() == TUSB_SPEED_HIGH) {
-              audio->feedback.compute.fifo_count.rate_const[0] /= 8;
-              audio->feedback.compute.fifo_count.rate_const[1] /= 8;
-            }
-          } break;
+          fifo_lvl_thr = tu_fifo_depth(&audio->ep_out_ff) / 2;
+  #endif
+          audio->feedback.compute.fifo_count.fifo_lvl_thr = fifo_lvl_thr;
+          audio->feedback.compute.fifo_count.fifo_lvl_avg = ((uint32_t) fifo_lvl_thr) << 16;
+          // Avoid 64bit division
+          uint32_t nominal = ((fb_param.sample_freq / 100) << 16) / (frame_div / 100);
+          audio->feedback.compute.fifo_count.nom_value = nominal;
+          audio->feedback.compute.fifo_count.rate_const[0] = (uint16_t) ((audio->feedback.max_value - nominal) / fifo_lvl_thr);
+          audio->feedback.compute.fifo_count.rate_const[1] = (uint16_t) ((nominal - audio->feedback.min_value) / fifo_lvl_thr);
+          // On HS feedback is more sensitive since packet size can vary every MSOF, could cause instability
+          if (tud_speed_get() == TUSB_SPEED_HIGH) {
+            audio->feedback.compute.fifo_count.rate_const[0] /= 8;
+            audio->feedback.compute.fifo_count.rate_const[1] /= 8;
+          }
+        } break;
+
+        case AUDIO_FEEDBACK_METHOD_SOF_CAPTURE:
+          // Start with nominal cycles per frame, SOF ISR is invoked per frame (1 ms) for high speed as well
+          audio->feedback.compute.pll.period = ((uint64_t) fb_param.frequency.mclk_freq << 16) / 1000;
+          audio->feedback.compute.pll.sample_freq = fb_param.sample_freq;
+          audio->feedback.compute.pll.mclk_freq = fb_param.frequency.mclk_freq;
+          audio->feedback.compute.pll.started = false;
+          break;
 
-          // nothing to do
-          default:
-            break;
-        }
+        // nothing to do
+        default:
+          break;
       }
-#endif// CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
-
-      // We are done - abort loop
-      break;
     }
-
-    // Moving forward
-    p_desc = tu_desc_next(p_desc);
+#endif// CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
   }
 
 #if CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
@@ -2017,7 +2188,8 @@ static bool audiod_set_interface(uint8_t rhport, tusb_control_request_t const *p
     if (_audiod_fct[i].ep_fb != 0 &&
         (_audiod_fct[i].feedback.compute_method == AUDIO_FEEDBACK_METHOD_FREQUENCY_FIXED ||
          _audiod_fct[i].feedback.compute_method == AUDIO_FEEDBACK_METHOD_FREQUENCY_FLOAT ||
-         _audiod_fct[i].feedback.compute_method == AUDIO_FEEDBACK_METHOD_FREQUENCY_POWER_OF_2)) {
+         _audiod_fct[i].feedback.compute_method == AUDIO_FEEDBACK_METHOD_FREQUENCY_POWER_OF_2 ||
+         _audiod_fct[i].feedback.compute_method == AUDIO_FEEDBACK_METHOD_SOF_CAPTURE)) {
       enable_sof = true;
       break;
     }
@@ -2026,7 +2198,9 @@ static bool audiod_set_interface(uint8_t rhport, tusb_control_request_t const *p
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL
-  audiod_calc_tx_packet_sz(audio);
+  if (audio->ep_in) {
+    audiod_calc_tx_packet_sz(audio);
+  }
 #endif
 
   tud_control_status(rhport, p_request);
@@ -2054,6 +2228,9 @@ static bool audiod_control_complete(uint8_t rhport, tusb_control_request_t const
           uint8_t ctrlSel = TU_U16_HIGH(p_request->wValue);
           if (_audiod_fct[func_id].bclock_id_tx == entityID && ctrlSel == AUDIO_CS_CTRL_SAM_FREQ && p_request->bRequest == AUDIO_CS_REQ_CUR) {
             _audiod_fct[func_id].sample_rate_tx = tu_unaligned_read32(_audiod_fct[func_id].ctrl_buf);
+            if (_audiod_fct[func_id].ep_in) {
+              audiod_calc_tx_packet_sz(&_audiod_fct[func_id]);
+            }
           }
 #endif
 
@@ -2072,7 +2249,7 @@ static bool audiod_control_complete(uint8_t rhport, tusb_control_request_t const
         uint8_t ep = TU_U16_LOW(p_request->wIndex);
 
         // Check if entity is present and get corresponding driver index
-        TU_VERIFY(audiod_verify_ep_exists(ep, &func_id));
+        TU_VERIFY(audiod_verify_ep_exists(rhport, ep, &func_id));
 
         // Invoke callback
         return tud_audio_set_req_ep_cb(rhport, p_request, _audiod_fct[func_id].ctrl_buf);
@@ -2144,7 +2321,7 @@ static bool audiod_control_request(uint8_t rhport, tusb_control_request_t const
         uint8_t ep = TU_U16_LOW(p_request->wIndex);
 
         // Find index of audio driver structure and verify EP really exists
-        TU_VERIFY(audiod_verify_ep_exists(ep, &func_id));
+        TU_VERIFY(audiod_verify_ep_exists(rhport, ep, &func_id));
 
         // In case we got a get request invoke callback - callback needs to answer as defined in UAC2 specification page 89 - 5. Requests
         if (p_request->bmRequestType_bit.direction == TUSB_DIR_IN) {
@@ -2183,70 +2360,70 @@ bool audiod_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint3
   (void) result;
   (void) xferred_bytes;
 
-  // Search for interface belonging to given end point address and proceed as required
-  for (uint8_t func_id = 0; func_id < CFG_TUD_AUDIO; func_id++) {
-    audiod_function_t *audio = &_audiod_fct[func_id];
+  // Audio function owning the end point, recorded in audiod_parse_index()
+  uint8_t const func_id = usbd_edpt_instance(rhport, ep_addr);
+  TU_VERIFY(func_id < CFG_TUD_AUDIO);
+  audiod_function_t *audio = &_audiod_fct[func_id];
 
 #if CFG_TUD_AUDIO_ENABLE_INTERRUPT_EP
 
-    // Data transmission of control interrupt finished
-    if (audio->ep_int == ep_addr) {
-      // According to USB2 specification, maximum payload of interrupt EP is 8 bytes on low speed, 64 bytes on full speed, and 1024 bytes on high speed (but only if an alternate interface other than 0 is used - see specification p. 49)
-      // In case there is nothing to send we have to return a NAK - this is taken care of by PHY ???
-      // In case of an erroneous transmission a retransmission is conducted - this is taken care of by PHY ???
+  // Data transmission of control interrupt finished
+  if (audio->ep_int == ep_addr) {
+    // According to USB2 specification, maximum payload of interrupt EP is 8 bytes on low speed, 64 bytes on full speed, and 1024 bytes on high speed (but only if an alternate interface other than 0 is used - see specification p. 49)
+    // In case there is nothing to send we have to return a NAK - this is taken care of by PHY ???
+    // In case of an erroneous transmission a retransmission is conducted - this is taken care of by PHY ???
 
-      // I assume here, that things above are handled by PHY
-      // All transmission is done - what remains to do is to inform job was completed
+    // I assume here, that things above are handled by PHY
+    // All transmission is done - what remains to do is to inform job was completed
 
-      tud_audio_int_done_cb(rhport);
-      return true;
-    }
+    tud_audio_int_done_cb(rhport);
+    return true;
+  }
 
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN
 
-    // Data transmission of audio packet finished
-    if (audio->ep_in == ep_addr && audio->alt_setting != 0) {
-      // USB 2.0, section 5.6.4, third paragraph, states "An isochronous endpoint must specify its required bus access period. However, an isochronous endpoint must be prepared to handle poll rates faster than the one specified."
-      // That paragraph goes on to say "An isochronous IN endpoint must return a zero-length packet whenever data is requested at a faster interval than the specified interval and data is not available."
-      // This can only be solved reliably if we load a ZLP after every IN transmission since we can not say if the host requests samples earlier than we declared! Once all samples are collected we overwrite the loaded ZLP.
+  // Data transmission of audio packet finished
+  if (audio->ep_in == ep_addr && audio->alt_setting != 0) {
+    // USB 2.0, section 5.6.4, third paragraph, states "An isochronous endpoint must specify its required bus access period. However, an isochronous endpoint must be prepared to handle poll rates faster than the one specified."
+    // That paragraph goes on to say "An isochronous IN endpoint must return a zero-length packet whenever data is requested at a faster interval than the specified interval and data is not available."
+    // This can only be solved reliably if we load a ZLP after every IN transmission since we can not say if the host requests samples earlier than we declared! Once all samples are collected we overwrite the loaded ZLP.
 
-      // Check if there is data to load into EPs buffer - if not load it with ZLP
-      // Be aware - we as a device are not able to know if the host polls for data with a faster rate as we stated this in the descriptors. Therefore we always have to put something into the EPs buffer. However, once we did that, there is no way of aborting this or replacing what we put into the buffer before!
-      // This is the only place where we can fill something into the EPs buffer!
+    // Check if there is data to load into EPs buffer - if not load it with ZLP
+    // Be aware - we as a device are not able to know if the host polls for data with a faster rate as we stated this in the descriptors. Therefore we always have to put something into the EPs buffer. However, once we did that, there is no way of aborting this or replacing what we put into the buffer before!
+    // This is the only place where we can fill something into the EPs buffer!
 
-      // Load new data
-      TU_VERIFY(audiod_tx_done_cb(rhport, audio));
+    // Load new data
+    TU_VERIFY(audiod_tx_done_cb(rhport, audio));
 
-      // Transmission of ZLP is done by audiod_tx_done_cb()
-      return true;
-    }
+    // Transmission of ZLP is done by audiod_tx_done_cb()
+    return true;
+  }
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT
 
-    // New audio packet received
-    if (audio->ep_out == ep_addr) {
-      TU_VERIFY(audiod_rx_done_cb(rhport, audio, (uint16_t) xferred_bytes));
-      return true;
-    }
+  // New audio packet received
+  if (audio->ep_out == ep_addr) {
+    TU_VERIFY(audiod_rx_done_cb(rhport, audio, (uint16_t) xferred_bytes));
+    return true;
+  }
 
 
   #if CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
-    // Transmission of feedback EP finished
-    if (audio->ep_fb == ep_addr) {
-      tud_audio_fb_done_cb(func_id);
-
-      // Schedule a transmit with the new value if EP is not busy
-      if (usbd_edpt_claim(rhport, audio->ep_fb)) {
-        // Schedule next transmission - value is changed bytud_audio_n_fb_set() in the meantime or the old value gets sent
-        return audiod_fb_send(audio);
-      }
+  // Transmission of feedback EP finished
+  if (audio->ep_fb == ep_addr) {
+    tud_audio_fb_done_cb(func_id);
+
+    // Schedule a transmit with the new value if EP is not busy
+    if (usbd_edpt_claim(rhport, audio->ep_fb)) {
+      // Schedule next transmission - value is changed bytud_audio_n_fb_set() in the meantime or the old value gets sent
+      return audiod_fb_send(audio);
     }
+  }
   #endif
 #endif
-  }
 
   return false;
 }
@@ -2282,14 +2459,19 @@ static bool audiod_set_fb_params_freq(audiod_function_t *audio, uint32_t sample_
   return true;
 }
 
-static void audiod_fb_fifo_count_update(audiod_function_t *audio, uint16_t lvl_new) {
+static void audiod_fb_fifo_count_update(audiod_function_t *audio, tu_fifo_size_t lvl_new) {
   /* Low-pass (averaging) filter */
+  #if CFG_TUSB_FIFO_32BIT
+  uint64_t lvl = audio->feedback.compute.fifo_count.fifo_lvl_avg;
+  lvl = (lvl * 63 + ((uint64_t) lvl_new << 16)) >> 6;
+  #else
   uint32_t lvl = audio->feedback.compute.fifo_count.fifo_lvl_avg;
   lvl = (uint32_t) (((uint64_t) lvl * 63 + ((uint32_t) lvl_new << 16)) >> 6);
+  #endif
   audio->feedback.compute.fifo_count.fifo_lvl_avg = lvl;
 
-  uint32_t const ff_lvl = lvl >> 16;
-  uint16_t const ff_thr = audio->feedback.compute.fifo_count.fifo_lvl_thr;
+  uint32_t const ff_lvl = (uint32_t) (lvl >> 16);
+  tu_fifo_size_t const ff_thr = audio->feedback.compute.fifo_count.fifo_lvl_thr;
   uint16_t const *rate = audio->feedback.compute.fifo_count.rate_const;
 
   uint32_t feedback;
@@ -2344,6 +2526,48 @@ uint32_t tud_audio_feedback_update(uint8_t func_id, uint32_t cycles) {
   return feedback;
 }
 
+// Track f_m cycles per frame from the counter captured at each SOF with a 2nd order PLL: the predicted phase follows
+// the captured counter and the period is integrated from the phase error, so capture jitter is filtered without drift
+TU_ATTR_FAST_FUNC static void audiod_fb_pll_update(audiod_function_t *audio, uint32_t counter) {
+  uint64_t const phase_mask = (1ULL << 48) - 1;
+  uint64_t const captured = (uint64_t) counter << 16;
+
+  if (!audio->feedback.compute.pll.started) {
+    audio->feedback.compute.pll.phase = captured;
+    audio->feedback.compute.pll.started = true;
+    return;
+  }
+
+  uint64_t const period = audio->feedback.compute.pll.period;
+  uint64_t const phase = (audio->feedback.compute.pll.phase + period) & phase_mask;
+
+  // Phase error, sign extended from 48 bit
+  int64_t const err = ((int64_t) ((captured - phase) << 16)) / 65536;
+  int64_t const err_max = (int64_t) (period >> 1);
+
+  if (err > err_max || err < -err_max) {
+    // Missed SOF or counter glitch: re-seed phase, keep period
+    audio->feedback.compute.pll.phase = captured;
+    return;
+  }
+
+  audio->feedback.compute.pll.phase = (phase + (uint64_t) (err / (1 << CFG_TUD_AUDIO_FEEDBACK_PLL_KP_SHIFT))) & phase_mask;
+  audio->feedback.compute.pll.period = (uint64_t) ((int64_t) period + err / (1 << CFG_TUD_AUDIO_FEEDBACK_PLL_KI_SHIFT));
+}
+
+// feedback = cycles per frame * f_s / f_m in 16.16 format, per microframe for high speed
+TU_ATTR_FAST_FUNC static uint32_t audiod_fb_pll_value(audiod_function_t *audio) {
+  uint8_t const hs_shift = (TUSB_SPEED_HIGH == tud_speed_get()) ? 3 : 0;
+  uint64_t const fb64 = (audio->feedback.compute.pll.period * audio->feedback.compute.pll.sample_freq) /
+                        ((uint64_t) audio->feedback.compute.pll.mclk_freq << hs_shift);
+  uint32_t feedback = (uint32_t) fb64;
+
+  if (feedback > audio->feedback.max_value) feedback = audio->feedback.max_value;
+  if (feedback < audio->feedback.min_value) feedback = audio->feedback.min_value;
+
+  return feedback;
+}
+
 bool tud_audio_n_fb_set(uint8_t func_id, uint32_t feedback) {
   TU_VERIFY(func_id < CFG_TUD_AUDIO && _audiod_fct[func_id].p_desc != NULL);
 
@@ -2374,10 +2598,18 @@ TU_ATTR_FAST_FUNC void audiod_sof_isr(uint8_t rhport, uint32_t frame_count) {
     audiod_function_t *audio = &_audiod_fct[i];
 
     if (audio->ep_fb != 0) {
+      bool const sof_capture = (audio->feedback.compute_method == AUDIO_FEEDBACK_METHOD_SOF_CAPTURE);
+      if (sof_capture) {
+        audiod_fb_pll_update(audio, tud_audio_feedback_capture_cb(i));
+      }
+
       // HS shift need to be adjusted since SOF event is generated for frame only
       uint8_t const hs_adjust = (TUSB_SPEED_HIGH == tud_speed_get()) ? 3 : 0;
       uint32_t const interval = 1UL << (audio->feedback.frame_shift - hs_adjust);
       if (0 == (frame_count & (interval - 1))) {
+        if (sof_capture) {
+          tud_audio_n_fb_set(i, audiod_fb_pll_value(audio));
+        }
         tud_audio_feedback_interval_isr(i, frame_count, audio->feedback.frame_shift);
       }
     }
@@ -2412,7 +2644,7 @@ bool tud_audio_buffer_and_schedule_control_xfer(uint8_t rhport, tusb_control_req
       uint8_t ep = TU_U16_LOW(p_request->wIndex);
 
       // Find index of audio driver structure and verify EP really exists
-      TU_VERIFY(audiod_verify_ep_exists(ep, &func_id));
+      TU_VERIFY(audiod_verify_ep_exists(rhport, ep, &func_id));
     } break;
 
     // Unknown/Unsupported recipient
@@ -2435,6 +2667,9 @@ bool tud_audio_buffer_and_schedule_control_xfer(uint8_t rhport, tusb_control_req
     uint8_t ctrlSel = TU_U16_HIGH(p_request->wValue);
     if (_audiod_fct[func_id].bclock_id_tx == entityID && ctrlSel == AUDIO_CS_CTRL_SAM_FREQ && p_request->bRequest == AUDIO_CS_REQ_CUR) {
       _audiod_fct[func_id].sample_rate_tx = tu_unaligned_read32(_audiod_fct[func_id].ctrl_buf);
+      if (_audiod_fct[func_id].ep_in) {
+        audiod_calc_tx_packet_sz(&_audiod_fct[func_id]);
+      }
     }
   }
 #endif
@@ -2443,45 +2678,62 @@ bool tud_audio_buffer_and_schedule_control_xfer(uint8_t rhport, tusb_control_req
   return tud_control_xfer(rhport, p_request, (void *) _audiod_fct[func_id].ctrl_buf, len);
 }
 
-// This helper function finds for a given audio function and AS interface number the index of the attached driver structure, the index of the interface in the audio function
-// (e.g. the std. AS interface with interface number 15 is the first AS interface for the given audio function and thus gets index zero), and
-// finally a pointer to the std. AS interface, where the pointer always points to the first alternate setting i.e. alternate interface zero.
-static bool audiod_get_AS_interface_index(uint8_t itf, audiod_function_t *audio, uint8_t *idxItf, uint8_t const **pp_desc_int) {
-  if (audio->p_desc) {
-    // Get pointer at end
-    uint8_t const *p_desc_end = audio->p_desc + audio->desc_length - TUD_AUDIO_DESC_IAD_LEN;
+// Build index of interfaces, entities and streaming EPs of an audio function, so that control requests are looked up
+// without walking the descriptors
+static bool audiod_parse_index(audiod_function_t *audio) {
+  audio->itf_num_ac = ((tusb_desc_interface_t const *) audio->p_desc)->bInterfaceNumber;
+  audio->n_as_itf = 0;
+  audio->ep_bitmap = 0;
+  tu_memclr(audio->entity_bitmap, sizeof(audio->entity_bitmap));
 
-    // Advance past AC descriptors
-    uint8_t const *p_desc = tu_desc_next(audio->p_desc);
-    p_desc += ((audio_desc_cs_ac_interface_t const *) p_desc)->wTotalLength;
+  // Entities are defined in class specific AC descriptors
+  uint8_t const *p_desc = tu_desc_next(audio->p_desc);// Points to CS AC descriptor
+  uint8_t const *p_desc_end = ((audio_desc_cs_ac_interface_t const *) p_desc)->wTotalLength + p_desc;
+  p_desc = tu_desc_next(p_desc);// Get past CS AC descriptor
 
-    uint8_t tmp = 0;
-    // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
-    while (p_desc_end - p_desc > 0) {
-      // We assume the number of alternate settings is increasing thus we return the index of alternate setting zero!
-      if (tu_desc_type(p_desc) == TUSB_DESC_INTERFACE && ((tusb_desc_interface_t const *) p_desc)->bAlternateSetting == 0) {
-        if (((tusb_desc_interface_t const *) p_desc)->bInterfaceNumber == itf) {
-          *idxItf = tmp;
-          *pp_desc_int = p_desc;
-          return true;
-        }
-        // Increase index, bytes read, and pointer
-        tmp++;
-      }
-      p_desc = tu_desc_next(p_desc);
+  // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
+  while (p_desc_end - p_desc > 0) {
+    uint8_t const entity_id = p_desc[3];// Entity IDs are always at offset 3
+    audio->entity_bitmap[entity_id >> 5] |= TU_BIT(entity_id & 0x1f);
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // AS interfaces and streaming EPs
+  p_desc_end = audio->p_desc + audio->desc_length - TUD_AUDIO_DESC_IAD_LEN;
+
+  // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
+  while (p_desc_end - p_desc > 0) {
+    if (tu_desc_type(p_desc) == TUSB_DESC_INTERFACE && ((tusb_desc_interface_t const *) p_desc)->bAlternateSetting == 0) {
+      // Interfaces of a function are contiguous (IAD), index of AS interface is its offset from first AS interface
+      TU_ASSERT(((tusb_desc_interface_t const *) p_desc)->bInterfaceNumber == audio->itf_num_ac + 1 + audio->n_as_itf);
+      audio->n_as_itf++;
+    } else if (tu_desc_type(p_desc) == TUSB_DESC_ENDPOINT) {
+      uint8_t const ep_addr = ((tusb_desc_endpoint_t const *) p_desc)->bEndpointAddress;
+      audio->ep_bitmap |= TU_BIT(tu_edpt_number(ep_addr) + 16 * tu_edpt_dir(ep_addr));
+      usbd_edpt_instance_set(audio->rhport, ep_addr, audiod_get_audio_fct_idx(audio));
     }
+    p_desc = tu_desc_next(p_desc);
   }
-  return false;
+
+  return true;
+}
+
+// This helper function finds for a given audio function and AS interface number the index of the interface in the audio function
+// (e.g. the std. AS interface with interface number 15 is the first AS interface for the given audio function and thus gets index zero)
+static bool audiod_get_AS_interface_index(uint8_t itf, audiod_function_t const *audio, uint8_t *idxItf) {
+  TU_VERIFY(audio->p_desc && itf > audio->itf_num_ac);
+  uint8_t const idx = (uint8_t) (itf - audio->itf_num_ac - 1);
+  TU_VERIFY(idx < audio->n_as_itf);
+  *idxItf = idx;
+  return true;
 }
 
-// This helper function finds for a given AS interface number the index of the attached driver structure, the index of the interface in the audio function
-// (e.g. the std. AS interface with interface number 15 is the first AS interface for the given audio function and thus gets index zero), and
-// finally a pointer to the std. AS interface, where the pointer always points to the first alternate setting i.e. alternate interface zero.
-static bool audiod_get_AS_interface_index_global(uint8_t itf, uint8_t *func_id, uint8_t *idxItf, uint8_t const **pp_desc_int) {
+// This helper function finds for a given AS interface number the index of the attached driver structure and the index of the interface in the audio function
+static bool audiod_get_AS_interface_index_global(uint8_t itf, uint8_t *func_id, uint8_t *idxItf) {
   // Loop over audio driver interfaces
   uint8_t i;
   for (i = 0; i < CFG_TUD_AUDIO; i++) {
-    if (audiod_get_AS_interface_index(itf, &_audiod_fct[i], idxItf, pp_desc_int)) {
+    if (audiod_get_AS_interface_index(itf, &_audiod_fct[i], idxItf)) {
       *func_id = i;
       return true;
     }
@@ -2495,20 +2747,11 @@ static bool audiod_verify_entity_exists(uint8_t itf, uint8_t entityID, uint8_t *
   uint8_t i;
   for (i = 0; i < CFG_TUD_AUDIO; i++) {
     // Look for the correct driver by checking if the unique standard AC interface number fits
-    if (_audiod_fct[i].p_desc && ((tusb_desc_interface_t const *) _audiod_fct[i].p_desc)->bInterfaceNumber == itf) {
-      // Get pointers after class specific AC descriptors and end of AC descriptors - entities are defined in between
-      uint8_t const *p_desc = tu_desc_next(_audiod_fct[i].p_desc);// Points to CS AC descriptor
-      uint8_t const *p_desc_end = ((audio_desc_cs_ac_interface_t const *) p_desc)->wTotalLength + p_desc;
-      p_desc = tu_desc_next(p_desc);// Get past CS AC descriptor
-
-      // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
-      while (p_desc_end - p_desc > 0) {
-        if (p_desc[3] == entityID)// Entity IDs are always at offset 3
-        {
-          *func_id = i;
-          return true;
-        }
-        p_desc = tu_desc_next(p_desc);
+    audiod_function_t const *audio = &_audiod_fct[i];
+    if (audio->p_desc && audio->itf_num_ac == itf) {
+      if (tu_bit_test(audio->entity_bitmap[entityID >> 5], entityID & 0x1f)) {
+        *func_id = i;
+        return true;
       }
     }
   }
@@ -2518,62 +2761,100 @@ static bool audiod_verify_entity_exists(uint8_t itf, uint8_t entityID, uint8_t *
 static bool audiod_verify_itf_exists(uint8_t itf, uint8_t *func_id) {
   uint8_t i;
   for (i = 0; i < CFG_TUD_AUDIO; i++) {
-    if (_audiod_fct[i].p_desc) {
-      // Get pointer at beginning and end
-      uint8_t const *p_desc = _audiod_fct[i].p_desc;
-      uint8_t const *p_desc_end = _audiod_fct[i].p_desc + _audiod_fct[i].desc_length - TUD_AUDIO_DESC_IAD_LEN;
-      // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
-      while (p_desc_end - p_desc > 0) {
-        if (tu_desc_type(p_desc) == TUSB_DESC_INTERFACE && ((tusb_desc_interface_t const *) _audiod_fct[i].p_desc)->bInterfaceNumber == itf) {
-          *func_id = i;
-          return true;
-        }
-        p_desc = tu_desc_next(p_desc);
-      }
+    audiod_function_t const *audio = &_audiod_fct[i];
+    // AC interface and AS interfaces following it
+    if (audio->p_desc && itf >= audio->itf_num_ac && itf <= audio->itf_num_ac + audio->n_as_itf) {
+      *func_id = i;
+      return true;
     }
   }
   return false;
 }
 
-static bool audiod_verify_ep_exists(uint8_t ep, uint8_t *func_id) {
-  uint8_t i;
-  for (i = 0; i < CFG_TUD_AUDIO; i++) {
-    if (_audiod_fct[i].p_desc) {
-      // Get pointer at end
-      uint8_t const *p_desc_end = _audiod_fct[i].p_desc + _audiod_fct[i].desc_length;
-
-      // Advance past AC descriptors - EP we look for are streaming EPs
-      uint8_t const *p_desc = tu_desc_next(_audiod_fct[i].p_desc);
-      p_desc += ((audio_desc_cs_ac_interface_t const *) p_desc)->wTotalLength;
-
-      // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
-      while (p_desc_end - p_desc > 0) {
-        if (tu_desc_type(p_desc) == TUSB_DESC_ENDPOINT && ((tusb_desc_endpoint_t const *) p_desc)->bEndpointAddress == ep) {
-          *func_id = i;
-          return true;
-        }
-        p_desc = tu_desc_next(p_desc);
+static bool audiod_verify_ep_exists(uint8_t rhport, uint8_t ep, uint8_t *func_id) {
+  uint8_t const i = usbd_edpt_instance(rhport, ep);
+  TU_VERIFY(i < CFG_TUD_AUDIO);
+  audiod_function_t const *audio = &_audiod_fct[i];
+  TU_VERIFY(audio->p_desc && tu_bit_test(audio->ep_bitmap, (uint8_t) (tu_edpt_number(ep) + 16 * tu_edpt_dir(ep))));
+  *func_id = i;
+  return true;
+}
+
+// Parse alternate setting whose Standard AS Interface Descriptor (4.9.1) is p_desc
+static void audiod_parse_AS_alt(audiod_function_t const *audio, uint8_t const *p_desc, uint8_t const *p_desc_end, audiod_as_alt_t *as_alt) {
+  tu_memclr(as_alt, sizeof(audiod_as_alt_t));
+  as_alt->desc_offset = (uint16_t) (p_desc - audio->p_desc);
+  as_alt->itf = ((tusb_desc_interface_t const *) p_desc)->bInterfaceNumber;
+  as_alt->alt = ((tusb_desc_interface_t const *) p_desc)->bAlternateSetting;
+#if USE_AS_PARAMS
+  audiod_parse_for_AS_params(as_alt, p_desc, p_desc_end);
+#else
+  (void) p_desc_end;
+#endif
+}
+
+static inline bool audiod_is_AS_itf_desc(uint8_t const *p_desc) {
+  return tu_desc_type(p_desc) == TUSB_DESC_INTERFACE &&
+         ((tusb_desc_interface_t const *) p_desc)->bInterfaceClass == TUSB_CLASS_AUDIO &&
+         ((tusb_desc_interface_t const *) p_desc)->bInterfaceSubClass == AUDIO_SUBCLASS_STREAMING;
+}
+
+// Parse all alternate settings of the AS interfaces of an audio function into as_alt[]
+static void audiod_parse_AS_alt_table(audiod_function_t *audio) {
+  uint8_t const *p_desc = audio->p_desc;
+  uint8_t const *p_desc_end = p_desc + audio->desc_length - TUD_AUDIO_DESC_IAD_LEN;
+
+  audio->n_as_alt = 0;
+  // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
+  while (p_desc_end - p_desc > 0) {
+    if (audiod_is_AS_itf_desc(p_desc)) {
+      if (audio->n_as_alt < CFG_TUD_AUDIO_N_AS_ALT_MAX) {
+        audiod_parse_AS_alt(audio, p_desc, p_desc_end, &audio->as_alt[audio->n_as_alt]);
+      }
+      if (audio->n_as_alt < UINT8_MAX) {
+        audio->n_as_alt++;
       }
     }
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  if (audio->n_as_alt > CFG_TUD_AUDIO_N_AS_ALT_MAX) {
+    TU_LOG2("  Audio: %u AS alternate settings, only %u cached (CFG_TUD_AUDIO_N_AS_ALT_MAX)\r\n", audio->n_as_alt, CFG_TUD_AUDIO_N_AS_ALT_MAX);
   }
-  return false;
 }
 
-#if (CFG_TUD_AUDIO_ENABLE_EP_IN && (CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL || CFG_TUD_AUDIO_ENABLE_ENCODING)) || (CFG_TUD_AUDIO_ENABLE_EP_OUT && CFG_TUD_AUDIO_ENABLE_DECODING)
-// p_desc points to the AS interface of alternate setting zero
-// itf is the interface number of the corresponding interface - we check if the interface belongs to EP in or EP out to see if it is a TX or RX parameter
-// Currently, only AS interfaces with an EP (in or out) are supposed to be parsed for!
-static void audiod_parse_for_AS_params(audiod_function_t *audio, uint8_t const *p_desc, uint8_t const *p_desc_end, uint8_t const as_itf) {
-  #if CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_ENABLE_EP_OUT
-  if (as_itf != audio->ep_in_as_intf_num && as_itf != audio->ep_out_as_intf_num) return;// Abort, this interface has no EP, this driver does not support this currently
-  #endif
-  #if CFG_TUD_AUDIO_ENABLE_EP_IN && !CFG_TUD_AUDIO_ENABLE_EP_OUT
-  if (as_itf != audio->ep_in_as_intf_num) return;
-  #endif
-  #if !CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_ENABLE_EP_OUT
-  if (as_itf != audio->ep_out_as_intf_num) return;
-  #endif
+// Get parameters of alternate setting alt of AS interface itf
+static bool audiod_get_AS_alt(audiod_function_t const *audio, uint8_t itf, uint8_t alt, audiod_as_alt_t *as_alt) {
+  uint8_t const n_cached = tu_min8(audio->n_as_alt, CFG_TUD_AUDIO_N_AS_ALT_MAX);
+  for (uint8_t i = 0; i < n_cached; i++) {
+    if (audio->as_alt[i].itf == itf && audio->as_alt[i].alt == alt) {
+      *as_alt = audio->as_alt[i];
+      return true;
+    }
+  }
+
+  // Not cached, table was too small: fall back to search in descriptor
+  TU_VERIFY(audio->n_as_alt > CFG_TUD_AUDIO_N_AS_ALT_MAX);
 
+  uint8_t const *p_desc = audio->p_desc;
+  uint8_t const *p_desc_end = p_desc + audio->desc_length - TUD_AUDIO_DESC_IAD_LEN;
+  // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
+  while (p_desc_end - p_desc > 0) {
+    if (audiod_is_AS_itf_desc(p_desc) && ((tusb_desc_interface_t const *) p_desc)->bInterfaceNumber == itf &&
+        ((tusb_desc_interface_t const *) p_desc)->bAlternateSetting == alt) {
+      audiod_parse_AS_alt(audio, p_desc, p_desc_end, as_alt);
+      return true;
+    }
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  return false;
+}
+
+#if USE_AS_PARAMS
+// p_desc points to the Standard AS Interface Descriptor (4.9.1) of an alternate setting
+// Parameters of all alternate settings are parsed since it is not known yet, which one has an EP (in or out)
+static void audiod_parse_for_AS_params(audiod_as_alt_t *as_alt, uint8_t const *p_desc, uint8_t const *p_desc_end) {
   p_desc = tu_desc_next(p_desc);// Exclude standard AS interface descriptor of current alternate interface descriptor
   // Condition modified from p_desc < p_desc_end to prevent gcc>=12 strict-overflow warning
   while (p_desc_end - p_desc > 0) {
@@ -2582,54 +2863,16 @@ static void audiod_parse_for_AS_params(audiod_function_t *audio, uint8_t const *
 
     // Look for a Class-Specific AS Interface Descriptor(4.9.2) to verify format type and format and also to get number of physical channels
     if (tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE && tu_desc_subtype(p_desc) == AUDIO_CS_AS_INTERFACE_AS_GENERAL) {
-  #if CFG_TUD_AUDIO_ENABLE_EP_IN
-      if (as_itf == audio->ep_in_as_intf_num) {
-        audio->n_channels_tx = ((audio_desc_cs_as_interface_t const *) p_desc)->bNrChannels;
-        audio->format_type_tx = (audio_format_type_t) (((audio_desc_cs_as_interface_t const *) p_desc)->bFormatType);
-
-    #if CFG_TUD_AUDIO_ENABLE_TYPE_I_ENCODING
-        audio->format_type_I_tx = (audio_data_format_type_I_t) (((audio_desc_cs_as_interface_t const *) p_desc)->bmFormats);
-    #endif
-      }
-  #endif
-
-  #if CFG_TUD_AUDIO_ENABLE_EP_OUT && CFG_TUD_AUDIO_ENABLE_DECODING
-      if (as_itf == audio->ep_out_as_intf_num) {
-        audio->n_channels_rx = ((audio_desc_cs_as_interface_t const *) p_desc)->bNrChannels;
-        audio->format_type_rx = ((audio_desc_cs_as_interface_t const *) p_desc)->bFormatType;
-    #if CFG_TUD_AUDIO_ENABLE_TYPE_I_DECODING
-        audio->format_type_I_rx = ((audio_desc_cs_as_interface_t const *) p_desc)->bmFormats;
-    #endif
-      }
-  #endif
+      audio_desc_cs_as_interface_t const *desc_cs = (audio_desc_cs_as_interface_t const *) p_desc;
+      as_alt->n_channels = desc_cs->bNrChannels;
+      as_alt->format_type = desc_cs->bFormatType;
+      as_alt->formats = desc_cs->bmFormats;
     }
 
     // Look for a Type I Format Type Descriptor(2.3.1.6 - Audio Formats)
-  #if CFG_TUD_AUDIO_ENABLE_TYPE_I_ENCODING || CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL || CFG_TUD_AUDIO_ENABLE_TYPE_I_DECODING
     if (tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE && tu_desc_subtype(p_desc) == AUDIO_CS_AS_INTERFACE_FORMAT_TYPE && ((audio_desc_type_I_format_t const *) p_desc)->bFormatType == AUDIO_FORMAT_TYPE_I) {
-    #if CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_ENABLE_EP_OUT
-      if (as_itf != audio->ep_in_as_intf_num && as_itf != audio->ep_out_as_intf_num) break;// Abort loop, this interface has no EP, this driver does not support this currently
-    #endif
-    #if CFG_TUD_AUDIO_ENABLE_EP_IN && !CFG_TUD_AUDIO_ENABLE_EP_OUT
-      if (as_itf != audio->ep_in_as_intf_num) break;
-    #endif
-    #if !CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_ENABLE_EP_OUT
-      if (as_itf != audio->ep_out_as_intf_num) break;
-    #endif
-
-    #if CFG_TUD_AUDIO_ENABLE_EP_IN
-      if (as_itf == audio->ep_in_as_intf_num) {
-        audio->n_bytes_per_sample_tx = ((audio_desc_type_I_format_t const *) p_desc)->bSubslotSize;
-      }
-    #endif
-
-    #if CFG_TUD_AUDIO_ENABLE_EP_OUT && CFG_TUD_AUDIO_ENABLE_DECODING
-      if (as_itf == audio->ep_out_as_intf_num) {
-        audio->n_bytes_per_sample_rx = ((audio_desc_type_I_format_t const *) p_desc)->bSubslotSize;
-      }
-    #endif
+      as_alt->n_bytes_per_sample = ((audio_desc_type_I_format_t const *) p_desc)->bSubslotSize;
     }
-  #endif
 
     // Other format types are not supported yet
 
@@ -2640,7 +2883,14 @@ static void audiod_parse_for_AS_params(audiod_function_t *audio, uint8_t const *
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL
 
+// Pre-compute packet sizes, FIFO thresholds and fractional schedule for current alternate setting and sample rate,
+// invoked when either changes so that audiod_tx_packet_size() is cheap for every packet
 static bool audiod_calc_tx_packet_sz(audiod_function_t *audio) {
+  tu_memclr(audio->packet_sz_tx, sizeof(audio->packet_sz_tx));
+  audio->frac_rem_tx = 0;
+  audio->frac_acc_tx = 0;
+  audio->ctrl_blackout_tx = 0;
+
   TU_VERIFY(audio->format_type_tx == AUDIO_FORMAT_TYPE_I);
   TU_VERIFY(audio->n_channels_tx);
   TU_VERIFY(audio->n_bytes_per_sample_tx);
@@ -2648,23 +2898,43 @@ static bool audiod_calc_tx_packet_sz(audiod_function_t *audio) {
   TU_VERIFY(audio->sample_rate_tx);
 
   const uint8_t interval = (tud_speed_get() == TUSB_SPEED_FULL) ? audio->interval_tx : 1 << (audio->interval_tx - 1);
+  const uint16_t frame_div = (tud_speed_get() == TUSB_SPEED_FULL) ? 1000 : 8000;
 
-  const uint16_t sample_normimal = (uint16_t) (audio->sample_rate_tx * interval / ((tud_speed_get() == TUSB_SPEED_FULL) ? 1000 : 8000));
-  const uint16_t sample_reminder = (uint16_t) (audio->sample_rate_tx * interval % ((tud_speed_get() == TUSB_SPEED_FULL) ? 1000 : 8000));
+  const uint16_t sample_normimal = (uint16_t) (audio->sample_rate_tx * interval / frame_div);
+  const uint16_t sample_reminder = (uint16_t) (audio->sample_rate_tx * interval % frame_div);
 
-  const uint16_t packet_sz_tx_min = (uint16_t) ((sample_normimal - 1) * audio->n_channels_tx * audio->n_bytes_per_sample_tx);
-  const uint16_t packet_sz_tx_norm = (uint16_t) (sample_normimal * audio->n_channels_tx * audio->n_bytes_per_sample_tx);
-  const uint16_t packet_sz_tx_max = (uint16_t) ((sample_normimal + 1) * audio->n_channels_tx * audio->n_bytes_per_sample_tx);
+  uint16_t packet_sz_tx_min = (uint16_t) ((sample_normimal - 1) * audio->n_channels_tx * audio->n_bytes_per_sample_tx);
+  uint16_t packet_sz_tx_norm = (uint16_t) (sample_normimal * audio->n_channels_tx * audio->n_bytes_per_sample_tx);
+  uint16_t packet_sz_tx_max = (uint16_t) ((sample_normimal + 1) * audio->n_channels_tx * audio->n_bytes_per_sample_tx);
 
   // Endpoint size must larger than packet size
   TU_ASSERT(packet_sz_tx_max <= audio->ep_in_sz);
 
+  #if CFG_TUD_AUDIO_ENABLE_ENCODING
+  // packet_sz_tx is based on total packet size, here we want size for each support buffer.
+  uint8_t const n_ff_used = audio->n_ff_used_tx;
+  TU_VERIFY(n_ff_used);
+  packet_sz_tx_min /= n_ff_used;
+  packet_sz_tx_norm /= n_ff_used;
+  packet_sz_tx_max /= n_ff_used;
+  tu_fifo_size_t const fifo_depth = audio->tx_supp_ff[0].depth;
+  #else
+  tu_fifo_size_t const fifo_depth = audio->ep_in_ff.depth;
+  #endif
+
+  // Flow control need a FIFO size of at least 4*Navg
+  TU_VERIFY(packet_sz_tx_norm && packet_sz_tx_norm <= (uint64_t) fifo_depth * 4);
+
   // Frmt20.pdf 2.3.1.1 USB Packets
   if (sample_reminder) {
     // All virtual frame packets must either contain INT(nav) audio slots (small VFP) or INT(nav)+1 (large VFP) audio slots
     audio->packet_sz_tx[0] = packet_sz_tx_norm;
     audio->packet_sz_tx[1] = packet_sz_tx_norm;
     audio->packet_sz_tx[2] = packet_sz_tx_max;
+
+    // Nominal sequence: one large VFP every frame_div / sample_reminder packets e.g 44.1k at FS: 9x 44 then 1x 45 samples
+    audio->frac_rem_tx = sample_reminder;
+    audio->frac_div_tx = frame_div;
   } else {
     // In the case where nav = INT(nav), ni may vary between INT(nav)-1 (small VFP), INT(nav)
     // (medium VFP) and INT(nav)+1 (large VFP).
@@ -2673,42 +2943,60 @@ static bool audiod_calc_tx_packet_sz(audiod_function_t *audio) {
     audio->packet_sz_tx[2] = packet_sz_tx_max;
   }
 
+  // Keep FIFO level around half filled, within one slot
+  uint16_t const slot_size = (uint16_t) (packet_sz_tx_max - packet_sz_tx_norm);
+  tu_fifo_size_t const fifo_half = fifo_depth / 2;
+  audio->fifo_lvl_tx[0] = (fifo_half > slot_size) ? (tu_fifo_size_t) (fifo_half - slot_size) : 0;
+  audio->fifo_lvl_tx[1] = (tu_fifo_size_t) (fifo_half + slot_size);
+
   return true;
 }
 
-static uint16_t audiod_tx_packet_size(const uint16_t *norminal_size, uint16_t data_count, uint16_t fifo_depth, uint16_t max_depth) {
-  // Flow control need a FIFO size of at least 4*Navg
-  if (norminal_size[1] && norminal_size[1] <= fifo_depth * 4) {
-    // Use blackout to prioritize normal size packet
-    static int ctrl_blackout = 0;
-    uint16_t packet_size;
-    uint16_t slot_size = norminal_size[2] - norminal_size[1];
-    if (data_count < norminal_size[0]) {
-      // If you get here frequently, then your I2S clock deviation is too big !
-      packet_size = 0;
-    } else if (data_count < fifo_depth / 2 - slot_size && !ctrl_blackout) {
-      packet_size = norminal_size[0];
-      ctrl_blackout = 10;
-    } else if (data_count > fifo_depth / 2 + slot_size && !ctrl_blackout) {
-      packet_size = norminal_size[2];
-      if (norminal_size[0] == norminal_size[1]) {
-        // nav > INT(nav), eg. 44.1k, 88.2k
-        ctrl_blackout = 0;
-      } else {
-        // nav = INT(nav), eg. 48k, 96k
-        ctrl_blackout = 10;
-      }
+static uint16_t audiod_tx_packet_size(audiod_function_t *audio, tu_fifo_size_t data_count, uint16_t max_size) {
+  uint16_t const *packet_sz = audio->packet_sz_tx;
+
+  // Flow control not active for current alternate setting
+  if (packet_sz[1] == 0) {
+    return (uint16_t) tu_min32(data_count, max_size);
+  }
+
+  // Use blackout to prioritize normal size packet
+  uint16_t packet_size;
+  if (data_count < packet_sz[0]) {
+    // If you get here frequently, then your I2S clock deviation is too big !
+    packet_size = 0;
+  } else if (data_count < audio->fifo_lvl_tx[0] && !audio->ctrl_blackout_tx) {
+    packet_size = packet_sz[0];
+    audio->ctrl_blackout_tx = 10;
+  } else if (data_count > audio->fifo_lvl_tx[1] && !audio->ctrl_blackout_tx) {
+    packet_size = packet_sz[2];
+    if (packet_sz[0] == packet_sz[1]) {
+      // nav > INT(nav), eg. 44.1k, 88.2k
+      audio->ctrl_blackout_tx = 0;
     } else {
-      packet_size = norminal_size[1];
-      if (ctrl_blackout) {
-        ctrl_blackout--;
-      }
+      // nav = INT(nav), eg. 48k, 96k
+      audio->ctrl_blackout_tx = 10;
     }
-    // Normally this cap is not necessary
-    return tu_min16(packet_size, max_depth);
   } else {
-    return tu_min16(data_count, max_depth);
+    packet_size = packet_sz[1];
+    if (audio->ctrl_blackout_tx) {
+      audio->ctrl_blackout_tx--;
+    }
+
+    // nav > INT(nav): follow the nominal sequence of small and large packets, a large packet is postponed until enough data is available
+    if (audio->frac_rem_tx) {
+      uint16_t const acc = (uint16_t) (audio->frac_acc_tx + audio->frac_rem_tx);
+      if (acc < audio->frac_div_tx) {
+        audio->frac_acc_tx = acc;
+      } else if (data_count >= packet_sz[2]) {
+        audio->frac_acc_tx = (uint16_t) (acc - audio->frac_div_tx);
+        packet_size = packet_sz[2];
+      }
+    }
   }
+
+  // Normally this cap is not necessary
+  return tu_min16(packet_size, max_size);
 }
 
 #endif
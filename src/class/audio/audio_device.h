@@ -83,7 +83,8 @@
 #endif
 #endif
 
-// End point sizes IN BYTES - Limits: Full Speed <= 1023, High Speed <= 1024
+// End point sizes IN BYTES - Limits: Full Speed <= 1023, High Speed <= 1024 per transaction and up to 3072 per
+// micro-frame with high-bandwidth endpoint (see TUD_AUDIO_EP_SIZE_HB())
 #ifndef CFG_TUD_AUDIO_ENABLE_EP_IN
 #define CFG_TUD_AUDIO_ENABLE_EP_IN 0   // TX
 #endif
@@ -187,11 +188,49 @@
 #define CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL  1
 #endif
 
+// Number of alternate settings of Standard AS Interface Descriptors (4.9.1) per audio function, whose parameters are
+// parsed once when the function is opened. SET_INTERFACE for alternate settings beyond this number falls back to parsing the descriptor.
+#ifndef CFG_TUD_AUDIO_N_AS_ALT_MAX
+#define CFG_TUD_AUDIO_N_AS_ALT_MAX  8
+#endif
+
 // Enable/disable feedback EP (required for asynchronous RX applications)
 #ifndef CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
 #define CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP                    0                             // Feedback - 0 or 1
 #endif
 
+// Handle feedback EP completion in USB ISR so that next feedback value is queued without waiting for usbd task.
+// tud_audio_fb_done_cb() is then invoked in ISR context.
+#ifndef CFG_TUD_AUDIO_FEEDBACK_ISR_CALLBACK
+#define CFG_TUD_AUDIO_FEEDBACK_ISR_CALLBACK                 0                             // 0 or 1
+#endif
+
+// Enable fractional resampler between EP OUT FIFO and application, see tud_audio_n_read_asrc(). Rate is adjusted
+// from FIFO fill level so that the stream follows local clock even if host does not honor feedback
+#ifndef CFG_TUD_AUDIO_ENABLE_EP_OUT_ASRC
+#define CFG_TUD_AUDIO_ENABLE_EP_OUT_ASRC                    0                             // 0 or 1
+#endif
+
+#ifndef CFG_TUD_AUDIO_EP_OUT_ASRC_CHANNELS_MAX
+#define CFG_TUD_AUDIO_EP_OUT_ASRC_CHANNELS_MAX              2
+#endif
+
+// Maximum rate deviation applied by resampler in ppm
+#ifndef CFG_TUD_AUDIO_EP_OUT_ASRC_PPM_MAX
+#define CFG_TUD_AUDIO_EP_OUT_ASRC_PPM_MAX                   2000
+#endif
+
+// Loop gains of the PLL used by AUDIO_FEEDBACK_METHOD_SOF_CAPTURE as power of 2 shifts: phase error is corrected by
+// 2^-KP and clock period by 2^-KI per frame. Default is a critically damped loop with ~7 ms time constant, higher
+// values filter more jitter but take longer to lock.
+#ifndef CFG_TUD_AUDIO_FEEDBACK_PLL_KP_SHIFT
+#define CFG_TUD_AUDIO_FEEDBACK_PLL_KP_SHIFT                 4
+#endif
+
+#ifndef CFG_TUD_AUDIO_FEEDBACK_PLL_KI_SHIFT
+#define CFG_TUD_AUDIO_FEEDBACK_PLL_KI_SHIFT                 9
+#endif
+
 // Enable/disable conversion from 16.16 to 10.14 format on full-speed devices. See tud_audio_n_fb_set().
 // Can be override by tud_audio_feedback_format_correction_cb()
 #ifndef CFG_TUD_AUDIO_ENABLE_FEEDBACK_FORMAT_CORRECTION
@@ -369,29 +408,45 @@ extern "C" {
 bool     tud_audio_n_mounted    (uint8_t func_id);
 
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT && !CFG_TUD_AUDIO_ENABLE_DECODING
-uint16_t tud_audio_n_available                    (uint8_t func_id);
-uint16_t tud_audio_n_read                         (uint8_t func_id, void* buffer, uint16_t bufsize);
+uint32_t tud_audio_n_available                    (uint8_t func_id);
+uint32_t tud_audio_n_read                         (uint8_t func_id, void* buffer, uint32_t bufsize);
 bool     tud_audio_n_clear_ep_out_ff              (uint8_t func_id);                          // Delete all content in the EP OUT FIFO
 tu_fifo_t*   tud_audio_n_get_ep_out_ff            (uint8_t func_id);
+
+// Use an application owned ring buffer as EP OUT FIFO, e.g the circular DMA buffer of an I2S/SAI codec.
+// Received packets are placed directly into it and the FIFO count feedback method observes its fill level.
+// Application consumes from it with tu_fifo_get_read_info()/tu_fifo_advance_read_pointer() on
+// tud_audio_n_get_ep_out_ff() as the DMA progresses. Buffer must meet the same memory requirements as
+// CFG_TUD_AUDIO_FUNC_x_EP_OUT_SW_BUF_SZ buffer (CFG_TUD_MEM_SECTION & CFG_TUD_MEM_ALIGN when linear buffer is
+// not used). Call while streaming is stopped (alternate setting 0), NULL restores driver's own buffer.
+bool     tud_audio_n_set_ep_out_ff_buffer         (uint8_t func_id, void* buffer, uint32_t bufsize);
+
+#if CFG_TUD_AUDIO_ENABLE_EP_OUT_ASRC
+// Set stream format for resampler (16 or 32 bit PCM), typically in tud_audio_set_itf_cb(). Resampler state is reset.
+bool     tud_audio_n_asrc_config                  (uint8_t func_id, uint8_t n_channels, uint8_t n_bytes_per_sample);
+// Read n_frames of resampled audio from EP OUT FIFO. Input rate is adjusted (linear interpolation) to keep the FIFO
+// half filled, call at the pace of local (codec) clock. Return number of frames read, less than n_frames on underrun.
+uint16_t tud_audio_n_read_asrc                    (uint8_t func_id, void* buffer, uint16_t n_frames);
+#endif
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT && CFG_TUD_AUDIO_ENABLE_DECODING
 bool     tud_audio_n_clear_rx_support_ff          (uint8_t func_id, uint8_t ff_idx);       // Delete all content in the support RX FIFOs
-uint16_t tud_audio_n_available_support_ff         (uint8_t func_id, uint8_t ff_idx);
-uint16_t tud_audio_n_read_support_ff              (uint8_t func_id, uint8_t ff_idx, void* buffer, uint16_t bufsize);
+uint32_t tud_audio_n_available_support_ff         (uint8_t func_id, uint8_t ff_idx);
+uint32_t tud_audio_n_read_support_ff              (uint8_t func_id, uint8_t ff_idx, void* buffer, uint32_t bufsize);
 tu_fifo_t* tud_audio_n_get_rx_support_ff          (uint8_t func_id, uint8_t ff_idx);
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && !CFG_TUD_AUDIO_ENABLE_ENCODING
-uint16_t tud_audio_n_write                        (uint8_t func_id, const void * data, uint16_t len);
+uint32_t tud_audio_n_write                        (uint8_t func_id, const void * data, uint32_t len);
 bool     tud_audio_n_clear_ep_in_ff               (uint8_t func_id);                          // Delete all content in the EP IN FIFO
 tu_fifo_t*   tud_audio_n_get_ep_in_ff             (uint8_t func_id);
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_ENABLE_ENCODING
-uint16_t tud_audio_n_flush_tx_support_ff          (uint8_t func_id);      // Force all content in the support TX FIFOs to be written into EP SW FIFO
+uint32_t tud_audio_n_flush_tx_support_ff          (uint8_t func_id);      // Force all content in the support TX FIFOs to be written into EP SW FIFO
 bool     tud_audio_n_clear_tx_support_ff          (uint8_t func_id, uint8_t ff_idx);
-uint16_t tud_audio_n_write_support_ff             (uint8_t func_id, uint8_t ff_idx, const void * data, uint16_t len);
+uint32_t tud_audio_n_write_support_ff             (uint8_t func_id, uint8_t ff_idx, const void * data, uint32_t len);
 tu_fifo_t* tud_audio_n_get_tx_support_ff          (uint8_t func_id, uint8_t ff_idx);
 #endif
 
@@ -409,31 +464,36 @@ static inline bool         tud_audio_mounted                (void);
 // RX API
 
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT && !CFG_TUD_AUDIO_ENABLE_DECODING
-static inline uint16_t     tud_audio_available              (void);
+static inline uint32_t     tud_audio_available              (void);
 static inline bool         tud_audio_clear_ep_out_ff        (void);                       // Delete all content in the EP OUT FIFO
-static inline uint16_t     tud_audio_read                   (void* buffer, uint16_t bufsize);
+static inline uint32_t     tud_audio_read                   (void* buffer, uint32_t bufsize);
 static inline tu_fifo_t*   tud_audio_get_ep_out_ff          (void);
+static inline bool         tud_audio_set_ep_out_ff_buffer   (void* buffer, uint32_t bufsize);
+#if CFG_TUD_AUDIO_ENABLE_EP_OUT_ASRC
+static inline bool         tud_audio_asrc_config            (uint8_t n_channels, uint8_t n_bytes_per_sample);
+static inline uint16_t     tud_audio_read_asrc              (void* buffer, uint16_t n_frames);
+#endif
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT && CFG_TUD_AUDIO_ENABLE_DECODING
 static inline bool     tud_audio_clear_rx_support_ff        (uint8_t ff_idx);
-static inline uint16_t tud_audio_available_support_ff       (uint8_t ff_idx);
-static inline uint16_t tud_audio_read_support_ff            (uint8_t ff_idx, void* buffer, uint16_t bufsize);
+static inline uint32_t tud_audio_available_support_ff       (uint8_t ff_idx);
+static inline uint32_t tud_audio_read_support_ff            (uint8_t ff_idx, void* buffer, uint32_t bufsize);
 static inline tu_fifo_t* tud_audio_get_rx_support_ff        (uint8_t ff_idx);
 #endif
 
 // TX API
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && !CFG_TUD_AUDIO_ENABLE_ENCODING
-static inline uint16_t tud_audio_write                      (const void * data, uint16_t len);
+static inline uint32_t tud_audio_write                      (const void * data, uint32_t len);
 static inline bool 	   tud_audio_clear_ep_in_ff             (void);
 static inline tu_fifo_t* tud_audio_get_ep_in_ff             (void);
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_ENABLE_ENCODING
-static inline uint16_t tud_audio_flush_tx_support_ff        (void);
+static inline uint32_t tud_audio_flush_tx_support_ff        (void);
 static inline uint16_t tud_audio_clear_tx_support_ff        (uint8_t ff_idx);
-static inline uint16_t tud_audio_write_support_ff           (uint8_t ff_idx, const void * data, uint16_t len);
+static inline uint32_t tud_audio_write_support_ff           (uint8_t ff_idx, const void * data, uint32_t len);
 static inline tu_fifo_t* tud_audio_get_tx_support_ff        (uint8_t ff_idx);
 #endif
 
@@ -490,6 +550,14 @@ void tud_audio_fb_done_cb(uint8_t func_id);
 // Determined by the user itself and set by use of tud_audio_n_fb_set(). The feedback value may be determined e.g. from some fill status of some FIFO buffer.
 // Advantage: No ISR interrupt is enabled, hence the CPU need not to handle an ISR every 1ms or 125us and thus less CPU load.
 // Disadvantage: typically a larger FIFO is needed to compensate for jitter (e.g. 6 frames), i.e. a larger delay is introduced.
+//
+// Option 4 - AUDIO_FEEDBACK_METHOD_SOF_CAPTURE
+// A free running counter clocked by f_m (MCLK or I2S bit/frame clock) is latched by hardware at every SOF, e.g STM32 timer with ITR
+// connected to OTG SOF or a RP2040 PIO state machine waiting for SOF. The driver reads the latched value with tud_audio_feedback_capture_cb()
+// from within the SOF ISR and tracks the number of f_m cycles per frame with a fixed-point PLL, see CFG_TUD_AUDIO_FEEDBACK_PLL_KP_SHIFT.
+// Advantage: capture is not affected by interrupt latency and the PLL filters the remaining jitter, hence a stable and precise feedback
+// value with the smallest FIFO and delay. No drift since phase error is regulated.
+// Disadvantage: SOF ISR every frame, requires MCU support for capturing a timer at SOF.
 
 
 // This function is used to provide data rate feedback from an asynchronous sink. Feedback value will be sent at FB endpoint interval till it's changed.
@@ -525,7 +593,8 @@ enum {
   AUDIO_FEEDBACK_METHOD_FREQUENCY_FIXED,
   AUDIO_FEEDBACK_METHOD_FREQUENCY_FLOAT,
   AUDIO_FEEDBACK_METHOD_FREQUENCY_POWER_OF_2, // For driver internal use only
-  AUDIO_FEEDBACK_METHOD_FIFO_COUNT
+  AUDIO_FEEDBACK_METHOD_FIFO_COUNT,
+  AUDIO_FEEDBACK_METHOD_SOF_CAPTURE
 };
 
 typedef struct {
@@ -534,7 +603,7 @@ typedef struct {
 
   union {
     struct {
-      uint32_t mclk_freq; // Main clock frequency in Hz i.e. master clock to which sample clock is based on
+      uint32_t mclk_freq; // Main clock frequency in Hz i.e. master clock to which sample clock is based on, or counter frequency of SOF capture
     }frequency;
 
   };
@@ -549,6 +618,10 @@ void tud_audio_feedback_params_cb(uint8_t func_id, uint8_t alt_itf, audio_feedba
 // interval_shift: number of bit shift i.e log2(interval) from Feedback endpoint descriptor
 TU_ATTR_FAST_FUNC void tud_audio_feedback_interval_isr(uint8_t func_id, uint32_t frame_number, uint8_t interval_shift);
 
+// Callback in ISR context, invoked at every SOF (frame) when feedback method is AUDIO_FEEDBACK_METHOD_SOF_CAPTURE.
+// Return value of the free running f_m counter captured by hardware at this SOF, should be placed in RAM if possible
+TU_ATTR_FAST_FUNC uint32_t tud_audio_feedback_capture_cb(uint8_t func_id);
+
 // (Full-Speed only) Callback to set feedback format correction is applied or not,
 // default to CFG_TUD_AUDIO_ENABLE_FEEDBACK_FORMAT_CORRECTION if not implemented.
 bool tud_audio_feedback_format_correction_cb(uint8_t func_id);
@@ -595,12 +668,12 @@ static inline bool tud_audio_mounted(void)
 
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT && !CFG_TUD_AUDIO_ENABLE_DECODING
 
-static inline uint16_t tud_audio_available(void)
+static inline uint32_t tud_audio_available(void)
 {
   return tud_audio_n_available(0);
 }
 
-static inline uint16_t tud_audio_read(void* buffer, uint16_t bufsize)
+static inline uint32_t tud_audio_read(void* buffer, uint32_t bufsize)
 {
   return tud_audio_n_read(0, buffer, bufsize);
 }
@@ -615,6 +688,23 @@ static inline tu_fifo_t* tud_audio_get_ep_out_ff(void)
   return tud_audio_n_get_ep_out_ff(0);
 }
 
+static inline bool tud_audio_set_ep_out_ff_buffer(void* buffer, uint32_t bufsize)
+{
+  return tud_audio_n_set_ep_out_ff_buffer(0, buffer, bufsize);
+}
+
+#if CFG_TUD_AUDIO_ENABLE_EP_OUT_ASRC
+static inline bool tud_audio_asrc_config(uint8_t n_channels, uint8_t n_bytes_per_sample)
+{
+  return tud_audio_n_asrc_config(0, n_channels, n_bytes_per_sample);
+}
+
+static inline uint16_t tud_audio_read_asrc(void* buffer, uint16_t n_frames)
+{
+  return tud_audio_n_read_asrc(0, buffer, n_frames);
+}
+#endif
+
 #endif
 
 #if CFG_TUD_AUDIO_ENABLE_EP_OUT && CFG_TUD_AUDIO_ENABLE_DECODING
@@ -624,12 +714,12 @@ static inline bool tud_audio_clear_rx_support_ff(uint8_t ff_idx)
   return tud_audio_n_clear_rx_support_ff(0, ff_idx);
 }
 
-static inline uint16_t tud_audio_available_support_ff(uint8_t ff_idx)
+static inline uint32_t tud_audio_available_support_ff(uint8_t ff_idx)
 {
   return tud_audio_n_available_support_ff(0, ff_idx);
 }
 
-static inline uint16_t tud_audio_read_support_ff(uint8_t ff_idx, void* buffer, uint16_t bufsize)
+static inline uint32_t tud_audio_read_support_ff(uint8_t ff_idx, void* buffer, uint32_t bufsize)
 {
   return tud_audio_n_read_support_ff(0, ff_idx, buffer, bufsize);
 }
@@ -645,7 +735,7 @@ static inline tu_fifo_t* tud_audio_get_rx_support_ff(uint8_t ff_idx)
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && !CFG_TUD_AUDIO_ENABLE_ENCODING
 
-static inline uint16_t tud_audio_write(const void * data, uint16_t len)
+static inline uint32_t tud_audio_write(const void * data, uint32_t len)
 {
   return tud_audio_n_write(0, data, len);
 }
@@ -664,7 +754,7 @@ static inline tu_fifo_t* tud_audio_get_ep_in_ff(void)
 
 #if CFG_TUD_AUDIO_ENABLE_EP_IN && CFG_TUD_AUDIO_ENABLE_ENCODING
 
-static inline uint16_t tud_audio_flush_tx_support_ff(void)
+static inline uint32_t tud_audio_flush_tx_support_ff(void)
 {
   return tud_audio_n_flush_tx_support_ff(0);
 }
@@ -674,7 +764,7 @@ static inline uint16_t tud_audio_clear_tx_support_ff(uint8_t ff_idx)
   return tud_audio_n_clear_tx_support_ff(0, ff_idx);
 }
 
-static inline uint16_t tud_audio_write_support_ff(uint8_t ff_idx, const void * data, uint16_t len)
+static inline uint32_t tud_audio_write_support_ff(uint8_t ff_idx, const void * data, uint32_t len)
 {
   return tud_audio_n_write_support_ff(0, ff_idx, data, len);
 }
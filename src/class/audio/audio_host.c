@@ -0,0 +1,817 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (CFG_TUH_ENABLED && CFG_TUH_AUDIO)
+
+#include "host/usbh.h"
+#include "host/usbh_pvt.h"
+
+#include "audio_host.h"
+
+// Level where CFG_TUSB_DEBUG must be at least for this driver is logged
+#ifndef CFG_TUH_AUDIO_LOG_LEVEL
+  #define CFG_TUH_AUDIO_LOG_LEVEL   CFG_TUH_LOG_LEVEL
+#endif
+
+#define TU_LOG_DRV(...)   TU_LOG(CFG_TUH_AUDIO_LOG_LEVEL, __VA_ARGS__)
+
+/* Audio Class 2.0 host driver
+ * - One Audio Control interface and at most one streaming interface per direction: IN for capture (microphone), OUT
+ *   for playback (speaker). Only Type I PCM formats are supported.
+ * - Each direction streams one service interval packet per transfer with 2 endpoint buffers: the next transfer is
+ *   queued from the other buffer before the completed one is copied to/from the FIFO.
+ * - OUT packet size is derived from the sample rate with a fractional accumulator, or from the explicit feedback
+ *   endpoint for asynchronous sinks.
+ * - Since there is no HCD API to close an endpoint, data endpoint is opened once with the largest packet size among
+ *   alternate settings so that switching format later does not need to re-open it.
+ */
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+typedef struct {
+  uint8_t alt;
+  uint8_t channels;
+  uint8_t subslot_size;
+  uint8_t bit_resolution;
+  uint16_t ep_size;
+  bool has_feedback;
+} audioh_alt_t;
+
+typedef struct {
+  uint8_t itf_num;
+  uint8_t terminal_link;
+  uint8_t clock_id;       // clock source connected to terminal, 0 if unknown
+  bool clock_programmable;
+
+  uint8_t alt_count;
+  uint8_t alt_cur;        // index of streaming alt in alt[]
+  bool running;
+  bool ep_opened;
+  bool fb_opened;
+  uint8_t buf_idx;        // buffer of in-flight transfer
+
+  uint16_t tx_len[2];     // prepared length of OUT buffers
+  uint32_t sample_rate;
+  uint32_t nominal;       // samples per (micro)frame, 16.16
+  uint32_t rate;          // samples per service interval, 16.16
+  uint32_t rate_acc;      // fractional part of sample accumulator
+
+  tusb_desc_endpoint_t desc_ep;    // data endpoint with largest packet size
+  tusb_desc_endpoint_t desc_ep_fb; // explicit feedback endpoint (OUT direction only)
+  audioh_alt_t alt[CFG_TUH_AUDIO_ALT_MAX];
+} audioh_stream_t;
+
+typedef struct {
+  uint8_t daddr;
+  uint8_t ac_itf;
+  uint8_t itf_count;  // number of interfaces in this function, including Audio Control
+  bool mounted;
+
+  audioh_stream_t stream[2]; // indexed by tusb_dir_t
+
+  tu_fifo_t rx_ff;
+  tu_fifo_t tx_ff;
+  uint8_t rx_ff_buf[CFG_TUH_AUDIO_RX_BUFSIZE];
+  uint8_t tx_ff_buf[CFG_TUH_AUDIO_TX_BUFSIZE];
+} audioh_interface_t;
+
+typedef struct {
+  TUH_EPBUF_DEF(rx0, CFG_TUH_AUDIO_EP_IN_SZ_MAX);
+  TUH_EPBUF_DEF(rx1, CFG_TUH_AUDIO_EP_IN_SZ_MAX);
+  TUH_EPBUF_DEF(tx0, CFG_TUH_AUDIO_EP_OUT_SZ_MAX);
+  TUH_EPBUF_DEF(tx1, CFG_TUH_AUDIO_EP_OUT_SZ_MAX);
+  TUH_EPBUF_TYPE_DEF(uint32_t, fb);
+  TUH_EPBUF_TYPE_DEF(uint32_t, sam_freq);
+} audioh_epbuf_t;
+
+static audioh_interface_t audioh_data[CFG_TUH_AUDIO];
+CFG_TUH_MEM_SECTION static audioh_epbuf_t audioh_epbuf[CFG_TUH_AUDIO];
+
+// stages of tuh_audio_stream_start(), carried in user_data with index and direction
+enum {
+  START_STAGE_SET_SAM_FREQ = 0,
+  START_STAGE_RUN,
+};
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+
+static inline audioh_interface_t* get_itf(uint8_t idx) {
+  TU_ASSERT(idx < CFG_TUH_AUDIO, NULL);
+  audioh_interface_t* p_audio = &audioh_data[idx];
+
+  return (p_audio->daddr != 0) ? p_audio : NULL;
+}
+
+static inline uint8_t* get_epbuf(uint8_t idx, tusb_dir_t dir, uint8_t buf_idx) {
+  audioh_epbuf_t* epbuf = &audioh_epbuf[idx];
+  if (dir == TUSB_DIR_IN) {
+    return buf_idx ? epbuf->rx1 : epbuf->rx0;
+  } else {
+    return buf_idx ? epbuf->tx1 : epbuf->tx0;
+  }
+}
+
+static inline uint16_t get_epbuf_size(tusb_dir_t dir) {
+  return (dir == TUSB_DIR_IN) ? CFG_TUH_AUDIO_EP_IN_SZ_MAX : CFG_TUH_AUDIO_EP_OUT_SZ_MAX;
+}
+
+static audioh_alt_t const* get_alt_by_num(audioh_stream_t const* stream, uint8_t alt) {
+  for (uint8_t i = 0; i < stream->alt_count; i++) {
+    if (stream->alt[i].alt == alt) return &stream->alt[i];
+  }
+  return NULL;
+}
+
+static void start_process(tuh_xfer_t* xfer);
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+
+uint8_t tuh_audio_itf_get_index(uint8_t daddr, uint8_t itf_num) {
+  for (uint8_t i = 0; i < CFG_TUH_AUDIO; i++) {
+    audioh_interface_t const* p_audio = &audioh_data[i];
+    if (p_audio->daddr == daddr && p_audio->ac_itf == itf_num) return i;
+  }
+
+  return TUSB_INDEX_INVALID_8;
+}
+
+bool tuh_audio_mounted(uint8_t idx) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio);
+  return p_audio->mounted;
+}
+
+uint8_t tuh_audio_alt_count(uint8_t idx, tusb_dir_t dir) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio, 0);
+  return p_audio->stream[dir].alt_count;
+}
+
+bool tuh_audio_alt_get_info(uint8_t idx, tusb_dir_t dir, uint8_t n, tuh_audio_alt_info_t* info) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio && info);
+  audioh_stream_t const* stream = &p_audio->stream[dir];
+  TU_VERIFY(n < stream->alt_count);
+
+  audioh_alt_t const* alt = &stream->alt[n];
+  info->alt            = alt->alt;
+  info->channels       = alt->channels;
+  info->subslot_size   = alt->subslot_size;
+  info->bit_resolution = alt->bit_resolution;
+  info->ep_size        = alt->ep_size;
+  info->has_feedback   = alt->has_feedback;
+
+  return true;
+}
+
+bool tuh_audio_streaming(uint8_t idx, tusb_dir_t dir) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio);
+  return p_audio->stream[dir].running;
+}
+
+bool tuh_audio_stream_start(uint8_t idx, tusb_dir_t dir, uint8_t alt, uint32_t sample_rate) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio && p_audio->mounted && sample_rate);
+  audioh_stream_t* stream = &p_audio->stream[dir];
+  TU_VERIFY(!stream->running);
+
+  audioh_alt_t const* p_alt = get_alt_by_num(stream, alt);
+  TU_VERIFY(p_alt);
+  // packet must fit into endpoint buffer
+  TU_VERIFY(p_alt->ep_size <= get_epbuf_size(dir));
+
+  TU_LOG_DRV("[%u] Audio start %s alt = %u, rate = %lu\r\n", p_audio->daddr, dir ? "IN" : "OUT", alt,
+             (unsigned long) sample_rate);
+
+  stream->alt_cur     = (uint8_t) (p_alt - stream->alt);
+  stream->sample_rate = sample_rate;
+
+  uintptr_t const user_data = ((uintptr_t) idx << 16) | ((uintptr_t) dir << 8) | START_STAGE_SET_SAM_FREQ;
+  return tuh_interface_set(p_audio->daddr, stream->itf_num, alt, start_process, user_data);
+}
+
+static void stop_complete(tuh_xfer_t* xfer) {
+  TU_LOG_DRV("[%u] Audio stop: result = %u\r\n", xfer->daddr, xfer->result);
+  (void) xfer;
+}
+
+bool tuh_audio_stream_stop(uint8_t idx, tusb_dir_t dir) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio && p_audio->mounted);
+  audioh_stream_t* stream = &p_audio->stream[dir];
+  TU_VERIFY(stream->alt_count);
+
+  // in-flight transfer is not re-submitted on completion
+  stream->running = false;
+  return tuh_interface_set(p_audio->daddr, stream->itf_num, 0, stop_complete, 0);
+}
+
+//--------------------------------------------------------------------+
+// Read API
+//--------------------------------------------------------------------+
+
+uint32_t tuh_audio_read_available(uint8_t idx) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio, 0);
+  return tu_fifo_count(&p_audio->rx_ff);
+}
+
+uint32_t tuh_audio_read(uint8_t idx, void* buffer, uint32_t bufsize) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio, 0);
+  return tu_fifo_read_n(&p_audio->rx_ff, buffer, (tu_fifo_size_t) tu_min32(bufsize, TU_FIFO_SIZE_MAX));
+}
+
+bool tuh_audio_read_clear(uint8_t idx) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio);
+  return tu_fifo_clear(&p_audio->rx_ff);
+}
+
+//--------------------------------------------------------------------+
+// Write API
+//--------------------------------------------------------------------+
+
+uint32_t tuh_audio_write_available(uint8_t idx) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio, 0);
+  return tu_fifo_remaining(&p_audio->tx_ff);
+}
+
+uint32_t tuh_audio_write(uint8_t idx, void const* buffer, uint32_t bufsize) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio, 0);
+  return tu_fifo_write_n(&p_audio->tx_ff, buffer, (tu_fifo_size_t) tu_min32(bufsize, TU_FIFO_SIZE_MAX));
+}
+
+bool tuh_audio_write_clear(uint8_t idx) {
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio);
+  return tu_fifo_clear(&p_audio->tx_ff);
+}
+
+//--------------------------------------------------------------------+
+// Streaming
+//--------------------------------------------------------------------+
+
+// ISO bInterval is 2^(bInterval-1) frames (full speed) or micro-frames (high speed)
+TU_ATTR_ALWAYS_INLINE static inline uint8_t interval_shift(tusb_desc_endpoint_t const* desc_ep) {
+  return (uint8_t) (tu_min8(tu_max8(desc_ep->bInterval, 1), 16) - 1);
+}
+
+// Compute nominal samples per (micro)frame in 16.16 format, this is also format of the feedback value
+static void stream_compute_rate(audioh_stream_t* stream, tusb_speed_t speed) {
+  uint32_t const units = (speed == TUSB_SPEED_HIGH) ? 8000 : 1000;
+  uint32_t const rate  = stream->sample_rate;
+
+  stream->nominal  = ((rate / units) << 16) + (((rate % units) << 16) / units);
+  stream->rate     = stream->nominal << interval_shift(&stream->desc_ep);
+  stream->rate_acc = 0;
+}
+
+// Convert received feedback to 16.16 samples per (micro)frame, 0 if value is not sane
+static uint32_t feedback_decode(audioh_stream_t const* stream, tusb_speed_t speed, uint32_t raw, uint32_t len) {
+  uint32_t value;
+  if (len == 3) {
+    // full speed is 10.14 format in 3 bytes
+    value = (raw & 0x00FFFFFFu) << ((speed == TUSB_SPEED_HIGH) ? 0 : 2);
+  } else if (len == 4) {
+    // high speed is 16.16 format, some full speed devices send it as well
+    value = raw;
+  } else {
+    return 0;
+  }
+
+  // accept value within +/- 25% of nominal
+  uint32_t const margin = stream->nominal >> 2;
+  if (value < stream->nominal - margin || value > stream->nominal + margin) return 0;
+
+  return value;
+}
+
+// prepare next OUT packet into buffer, pad with silence if FIFO does not have enough data
+static void stream_prepare_tx(audioh_interface_t* p_audio, uint8_t idx, uint8_t buf_idx) {
+  audioh_stream_t* stream = &p_audio->stream[TUSB_DIR_OUT];
+  audioh_alt_t const* alt = &stream->alt[stream->alt_cur];
+  uint8_t* buf = get_epbuf(idx, TUSB_DIR_OUT, buf_idx);
+
+  uint16_t const frame_size = (uint16_t) (alt->channels * alt->subslot_size);
+  if (frame_size == 0) {
+    stream->tx_len[buf_idx] = 0;
+    return;
+  }
+
+  stream->rate_acc += stream->rate;
+  uint32_t const samples = stream->rate_acc >> 16;
+  stream->rate_acc &= 0xFFFFu;
+
+  uint16_t const max_len = (uint16_t) ((tu_min16(alt->ep_size, CFG_TUH_AUDIO_EP_OUT_SZ_MAX) / frame_size) * frame_size);
+  uint16_t const len = (uint16_t) tu_min32(samples * frame_size, max_len);
+
+  tu_fifo_size_t const count = tu_fifo_read_n(&p_audio->tx_ff, buf, len);
+  if (count < len) {
+    tu_memclr(buf + count, len - count);
+  }
+
+  stream->tx_len[buf_idx] = len;
+}
+
+static void stream_submit(audioh_interface_t* p_audio, uint8_t idx, tusb_dir_t dir) {
+  audioh_stream_t* stream = &p_audio->stream[dir];
+  uint8_t const ep_addr = stream->desc_ep.bEndpointAddress;
+  uint8_t* buf = get_epbuf(idx, dir, stream->buf_idx);
+  uint16_t const len = (dir == TUSB_DIR_IN) ? stream->alt[stream->alt_cur].ep_size : stream->tx_len[stream->buf_idx];
+
+  TU_ASSERT(usbh_edpt_xfer(p_audio->daddr, ep_addr, buf, len),);
+}
+
+static void stream_submit_feedback(audioh_interface_t* p_audio, uint8_t idx) {
+  audioh_stream_t* stream = &p_audio->stream[TUSB_DIR_OUT];
+  uint8_t const ep_addr = stream->desc_ep_fb.bEndpointAddress;
+  uint16_t const len = tu_min16(tu_edpt_packet_size(&stream->desc_ep_fb), 4);
+
+  audioh_epbuf[idx].fb = 0;
+  TU_ASSERT(usbh_edpt_xfer(p_audio->daddr, ep_addr, (uint8_t*) &audioh_epbuf[idx].fb, len),);
+}
+
+// start isochronous transfers, a transfer may still be in-flight if stream is restarted quickly
+static void stream_kick(audioh_interface_t* p_audio, uint8_t idx, tusb_dir_t dir) {
+  audioh_stream_t* stream = &p_audio->stream[dir];
+  uint8_t const daddr = p_audio->daddr;
+
+  if (usbh_edpt_busy(daddr, stream->desc_ep.bEndpointAddress)) {
+    // completion of in-flight transfer will continue with the other buffer
+    if (dir == TUSB_DIR_OUT) {
+      stream_prepare_tx(p_audio, idx, stream->buf_idx ^ 1);
+    }
+  } else {
+    stream->buf_idx = 0;
+    if (dir == TUSB_DIR_OUT) {
+      stream_prepare_tx(p_audio, idx, 0);
+    }
+    stream_submit(p_audio, idx, dir);
+    if (dir == TUSB_DIR_OUT) {
+      stream_prepare_tx(p_audio, idx, 1);
+    }
+  }
+
+  if (dir == TUSB_DIR_OUT && stream->alt[stream->alt_cur].has_feedback &&
+      !usbh_edpt_busy(daddr, stream->desc_ep_fb.bEndpointAddress)) {
+    stream_submit_feedback(p_audio, idx);
+  }
+}
+
+static void start_complete(audioh_interface_t* p_audio, uint8_t idx, tusb_dir_t dir, bool success) {
+  audioh_stream_t* stream = &p_audio->stream[dir];
+  TU_LOG_DRV("  Audio start %s\r\n", success ? "OK" : "Failed");
+
+  if (success) {
+    stream_compute_rate(stream, tuh_speed_get(p_audio->daddr));
+    stream->running = true;
+    stream_kick(p_audio, idx, dir);
+  }
+
+  if (tuh_audio_stream_start_cb) {
+    tuh_audio_stream_start_cb(idx, dir, success);
+  }
+}
+
+static void start_process(tuh_xfer_t* xfer) {
+  uint8_t const idx = (uint8_t) (xfer->user_data >> 16);
+  tusb_dir_t const dir = (tusb_dir_t) ((xfer->user_data >> 8) & 0xFF);
+  uint8_t const stage = (uint8_t) (xfer->user_data & 0xFF);
+
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_VERIFY(p_audio,);
+  audioh_stream_t* stream = &p_audio->stream[dir];
+
+  if (xfer->result != XFER_RESULT_SUCCESS) {
+    start_complete(p_audio, idx, dir, false);
+    return;
+  }
+
+  switch (stage) {
+    case START_STAGE_SET_SAM_FREQ:
+      if (stream->clock_id && stream->clock_programmable) {
+        TU_LOG_DRV("  Set Sampling Frequency of Clock %u\r\n", stream->clock_id);
+        audioh_epbuf[idx].sam_freq = tu_htole32(stream->sample_rate);
+
+        tusb_control_request_t const request = {
+          .bmRequestType_bit = {
+            .recipient = TUSB_REQ_RCPT_INTERFACE,
+            .type      = TUSB_REQ_TYPE_CLASS,
+            .direction = TUSB_DIR_OUT
+          },
+          .bRequest = AUDIO_CS_REQ_CUR,
+          .wValue   = tu_htole16((uint16_t) (AUDIO_CS_CTRL_SAM_FREQ << 8)),
+          .wIndex   = tu_htole16((uint16_t) ((stream->clock_id << 8) | p_audio->ac_itf)),
+          .wLength  = tu_htole16(4)
+        };
+
+        tuh_xfer_t new_xfer = {
+          .daddr       = p_audio->daddr,
+          .ep_addr     = 0,
+          .setup       = &request,
+          .buffer      = (uint8_t*) &audioh_epbuf[idx].sam_freq,
+          .complete_cb = start_process,
+          .user_data   = (xfer->user_data & ~(uintptr_t) 0xFF) | START_STAGE_RUN
+        };
+
+        if (!tuh_control_xfer(&new_xfer)) {
+          start_complete(p_audio, idx, dir, false);
+        }
+        break;
+      }
+      TU_ATTR_FALLTHROUGH;
+
+    case START_STAGE_RUN: {
+      // endpoints are opened once and kept open for all later start/stop
+      if (!stream->ep_opened) {
+        stream->ep_opened = tuh_edpt_open(p_audio->daddr, &stream->desc_ep);
+      }
+
+      if (stream->ep_opened && stream->alt[stream->alt_cur].has_feedback && !stream->fb_opened) {
+        stream->fb_opened = tuh_edpt_open(p_audio->daddr, &stream->desc_ep_fb);
+      }
+
+      bool const ok = stream->ep_opened && (stream->fb_opened || !stream->alt[stream->alt_cur].has_feedback);
+      start_complete(p_audio, idx, dir, ok);
+      break;
+    }
+
+    default: break;
+  }
+}
+
+//--------------------------------------------------------------------+
+// CLASS-USBH API
+//--------------------------------------------------------------------+
+
+bool audioh_init(void) {
+  TU_LOG_DRV("sizeof(audioh_interface_t) = %u\r\n", sizeof(audioh_interface_t));
+  tu_memclr(audioh_data, sizeof(audioh_data));
+  for (size_t i = 0; i < CFG_TUH_AUDIO; i++) {
+    audioh_interface_t* p_audio = &audioh_data[i];
+    tu_fifo_config(&p_audio->rx_ff, p_audio->rx_ff_buf, CFG_TUH_AUDIO_RX_BUFSIZE, 1, false);
+    tu_fifo_config(&p_audio->tx_ff, p_audio->tx_ff_buf, CFG_TUH_AUDIO_TX_BUFSIZE, 1, false);
+  }
+
+  return true;
+}
+
+bool audioh_deinit(void) {
+  return true;
+}
+
+void audioh_close(uint8_t daddr) {
+  for (uint8_t idx = 0; idx < CFG_TUH_AUDIO; idx++) {
+    audioh_interface_t* p_audio = &audioh_data[idx];
+    if (p_audio->daddr == daddr) {
+      TU_LOG_DRV("  AUDIOh close addr = %u index = %u\r\n", daddr, idx);
+
+      if (p_audio->mounted && tuh_audio_umount_cb) {
+        tuh_audio_umount_cb(idx);
+      }
+
+      p_audio->daddr     = 0;
+      p_audio->ac_itf    = 0;
+      p_audio->itf_count = 0;
+      p_audio->mounted   = false;
+      tu_memclr(p_audio->stream, sizeof(p_audio->stream));
+      tu_fifo_clear(&p_audio->rx_ff);
+      tu_fifo_clear(&p_audio->tx_ff);
+    }
+  }
+}
+
+bool audioh_xfer_cb(uint8_t daddr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes) {
+  for (uint8_t idx = 0; idx < CFG_TUH_AUDIO; idx++) {
+    audioh_interface_t* p_audio = &audioh_data[idx];
+    if (p_audio->daddr != daddr) continue;
+
+    audioh_stream_t* stream_in  = &p_audio->stream[TUSB_DIR_IN];
+    audioh_stream_t* stream_out = &p_audio->stream[TUSB_DIR_OUT];
+
+    // isochronous error is not retried, packet is treated as lost and streaming continues
+    if (event != XFER_RESULT_SUCCESS) {
+      xferred_bytes = 0;
+    }
+
+    if (stream_in->alt_count && ep_addr == stream_in->desc_ep.bEndpointAddress) {
+      uint8_t const done_idx = stream_in->buf_idx;
+
+      // queue next packet into the other buffer first, then process the completed one
+      if (stream_in->running) {
+        stream_in->buf_idx ^= 1;
+        stream_submit(p_audio, idx, TUSB_DIR_IN);
+      }
+
+      // drop whole packet if FIFO does not have enough room, so that sample frames stay aligned
+      if (xferred_bytes && tu_fifo_remaining(&p_audio->rx_ff) >= xferred_bytes) {
+        tu_fifo_write_n(&p_audio->rx_ff, get_epbuf(idx, TUSB_DIR_IN, done_idx), (tu_fifo_size_t) xferred_bytes);
+        if (tuh_audio_rx_cb) {
+          tuh_audio_rx_cb(idx, (uint16_t) xferred_bytes);
+        }
+      }
+      return true;
+    }
+
+    if (stream_out->alt_count && ep_addr == stream_out->desc_ep.bEndpointAddress) {
+      uint8_t const done_idx = stream_out->buf_idx;
+
+      // other buffer is already prepared: send it, then refill the completed one
+      if (stream_out->running) {
+        stream_out->buf_idx ^= 1;
+        stream_submit(p_audio, idx, TUSB_DIR_OUT);
+        stream_prepare_tx(p_audio, idx, done_idx);
+      }
+
+      if (tuh_audio_tx_complete_cb) {
+        tuh_audio_tx_complete_cb(idx, (uint16_t) xferred_bytes);
+      }
+      return true;
+    }
+
+    if (stream_out->fb_opened && ep_addr == stream_out->desc_ep_fb.bEndpointAddress) {
+      tusb_speed_t const speed = tuh_speed_get(daddr);
+      uint32_t const value = feedback_decode(stream_out, speed, tu_le32toh(audioh_epbuf[idx].fb), xferred_bytes);
+      if (value) {
+        stream_out->rate = value << interval_shift(&stream_out->desc_ep);
+      }
+
+      if (stream_out->running && stream_out->alt[stream_out->alt_cur].has_feedback) {
+        stream_submit_feedback(p_audio, idx);
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//--------------------------------------------------------------------+
+// Enumeration
+//--------------------------------------------------------------------+
+
+// Clock entity or terminal parsed from Audio Control interface
+typedef struct {
+  uint8_t id;
+  uint8_t subtype;
+  uint8_t source;   // clock source for terminal/selector/multiplier, bmControls for clock source
+} audioh_entity_t;
+
+static audioh_entity_t const* find_entity(audioh_entity_t const* entity, uint8_t count, uint8_t id) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (entity[i].id == id) return &entity[i];
+  }
+  return NULL;
+}
+
+// Follow terminal -> clock selector (first pin) / multiplier -> clock source
+static void resolve_clock(audioh_stream_t* stream, audioh_entity_t const* entity, uint8_t count) {
+  audioh_entity_t const* ent = find_entity(entity, count, stream->terminal_link);
+
+  for (uint8_t hop = 0; ent && hop < count; hop++) {
+    if (ent->subtype == AUDIO_CS_AC_INTERFACE_CLOCK_SOURCE) {
+      stream->clock_id = ent->id;
+      stream->clock_programmable =
+        (((ent->source >> AUDIO_CLOCK_SOURCE_CTRL_CLK_FRQ_POS) & 0x03) == AUDIO_CTRL_RW);
+      return;
+    }
+    ent = find_entity(entity, count, ent->source);
+  }
+}
+
+static void parse_ac_entity(audioh_entity_t* entity, uint8_t* count, uint8_t const* p_desc) {
+  TU_VERIFY(*count < CFG_TUH_AUDIO_ENTITY_MAX,);
+  audioh_entity_t* ent = &entity[*count];
+
+  switch (p_desc[2]) {
+    case AUDIO_CS_AC_INTERFACE_INPUT_TERMINAL: {
+      audio_desc_input_terminal_t const* desc = (audio_desc_input_terminal_t const*) p_desc;
+      ent->id     = desc->bTerminalID;
+      ent->source = desc->bCSourceID;
+      break;
+    }
+
+    case AUDIO_CS_AC_INTERFACE_OUTPUT_TERMINAL: {
+      audio_desc_output_terminal_t const* desc = (audio_desc_output_terminal_t const*) p_desc;
+      ent->id     = desc->bTerminalID;
+      ent->source = desc->bCSourceID;
+      break;
+    }
+
+    case AUDIO_CS_AC_INTERFACE_CLOCK_SOURCE: {
+      audio_desc_clock_source_t const* desc = (audio_desc_clock_source_t const*) p_desc;
+      ent->id     = desc->bClockID;
+      ent->source = desc->bmControls;
+      break;
+    }
+
+    case AUDIO_CS_AC_INTERFACE_CLOCK_SELECTOR: {
+      audio_desc_clock_selector_t const* desc = (audio_desc_clock_selector_t const*) p_desc;
+      ent->id     = desc->bClockID;
+      ent->source = desc->baCSourceID;
+      break;
+    }
+
+    case AUDIO_CS_AC_INTERFACE_CLOCK_MULTIPLIER: {
+      audio_desc_clock_multiplier_t const* desc = (audio_desc_clock_multiplier_t const*) p_desc;
+      ent->id     = desc->bClockID;
+      ent->source = desc->bCSourceID;
+      break;
+    }
+
+    default: return; // other units are not needed for streaming
+  }
+
+  ent->subtype = p_desc[2];
+  (*count)++;
+}
+
+// Parse an alternate setting of streaming interface, return pointer to the next interface descriptor
+static uint8_t const* parse_as_alt(audioh_interface_t* p_audio, tusb_desc_interface_t const* desc_itf,
+                                   uint8_t const* p_end, audioh_entity_t const* entity, uint8_t entity_count) {
+  audioh_alt_t alt = { .alt = desc_itf->bAlternateSetting };
+  uint8_t terminal_link = 0;
+  uint8_t format_type = AUDIO_FORMAT_TYPE_UNDEFINED;
+  tusb_desc_endpoint_t const* desc_ep = NULL;
+  tusb_desc_endpoint_t const* desc_ep_fb = NULL;
+
+  uint8_t const* p_desc = tu_desc_next(desc_itf);
+  while (p_desc < p_end && tu_desc_type(p_desc) != TUSB_DESC_INTERFACE && tu_desc_len(p_desc)) {
+    if (tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE) {
+      if (p_desc[2] == AUDIO_CS_AS_INTERFACE_AS_GENERAL) {
+        audio_desc_cs_as_interface_t const* desc = (audio_desc_cs_as_interface_t const*) p_desc;
+        terminal_link = desc->bTerminalLink;
+        format_type   = desc->bFormatType;
+        alt.channels  = desc->bNrChannels;
+      } else if (p_desc[2] == AUDIO_CS_AS_INTERFACE_FORMAT_TYPE) {
+        audio_desc_type_I_format_t const* desc = (audio_desc_type_I_format_t const*) p_desc;
+        alt.subslot_size   = desc->bSubslotSize;
+        alt.bit_resolution = desc->bBitResolution;
+      }
+    } else if (tu_desc_type(p_desc) == TUSB_DESC_ENDPOINT) {
+      tusb_desc_endpoint_t const* ep = (tusb_desc_endpoint_t const*) p_desc;
+      if (ep->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS) {
+        if (ep->bmAttributes.usage == (TUSB_ISO_EP_ATT_EXPLICIT_FB >> 4)) {
+          desc_ep_fb = ep;
+        } else {
+          desc_ep = ep;
+        }
+      }
+    }
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // zero-bandwidth alternate or unsupported format
+  if (desc_ep == NULL || format_type != AUDIO_FORMAT_TYPE_I || alt.channels == 0 || alt.subslot_size == 0) {
+    return p_desc;
+  }
+
+  tusb_dir_t const dir = tu_edpt_dir(desc_ep->bEndpointAddress);
+  audioh_stream_t* stream = &p_audio->stream[dir];
+
+  if (stream->alt_count == 0) {
+    stream->itf_num       = desc_itf->bInterfaceNumber;
+    stream->terminal_link = terminal_link;
+    resolve_clock(stream, entity, entity_count);
+  } else if (stream->itf_num != desc_itf->bInterfaceNumber) {
+    TU_LOG_DRV("  Only one streaming interface per direction is supported\r\n");
+    return p_desc;
+  }
+
+  if (stream->alt_count >= CFG_TUH_AUDIO_ALT_MAX) {
+    TU_LOG_DRV("  Alt %u skipped, CFG_TUH_AUDIO_ALT_MAX = %u\r\n", alt.alt, CFG_TUH_AUDIO_ALT_MAX);
+    return p_desc;
+  }
+
+  alt.ep_size = tu_edpt_packet_size(desc_ep);
+  if (stream->alt_count == 0 || alt.ep_size > tu_edpt_packet_size(&stream->desc_ep)) {
+    stream->desc_ep = *desc_ep;
+  }
+
+  if (dir == TUSB_DIR_OUT && desc_ep_fb) {
+    alt.has_feedback   = true;
+    stream->desc_ep_fb = *desc_ep_fb;
+  }
+
+  TU_LOG_DRV("  %s alt %u: %u ch, %u bytes/%u bits, ep size = %u%s\r\n", dir ? "IN" : "OUT", alt.alt, alt.channels,
+             alt.subslot_size, alt.bit_resolution, alt.ep_size, alt.has_feedback ? ", feedback" : "");
+  stream->alt[stream->alt_count++] = alt;
+
+  return p_desc;
+}
+
+bool audioh_open(uint8_t rhport, uint8_t daddr, tusb_desc_interface_t const *itf_desc, uint16_t max_len) {
+  (void) rhport;
+
+  // only Audio Class 2.0, starting with Audio Control interface
+  TU_VERIFY(TUSB_CLASS_AUDIO           == itf_desc->bInterfaceClass &&
+            AUDIO_SUBCLASS_CONTROL     == itf_desc->bInterfaceSubClass &&
+            AUDIO_INT_PROTOCOL_CODE_V2 == itf_desc->bInterfaceProtocol);
+
+  audioh_interface_t* p_audio = NULL;
+  uint8_t idx;
+  for (idx = 0; idx < CFG_TUH_AUDIO; idx++) {
+    if (audioh_data[idx].daddr == 0) {
+      p_audio = &audioh_data[idx];
+      break;
+    }
+  }
+  TU_VERIFY(p_audio);
+
+  TU_LOG_DRV("AUDIO opening Interface %u (addr = %u)\r\n", itf_desc->bInterfaceNumber, daddr);
+  tu_memclr(p_audio->stream, sizeof(p_audio->stream));
+  p_audio->daddr     = daddr;
+  p_audio->ac_itf    = itf_desc->bInterfaceNumber;
+  p_audio->itf_count = 1;
+
+  uint8_t const* p_end  = ((uint8_t const*) itf_desc) + max_len;
+  uint8_t const* p_desc = tu_desc_next(itf_desc);
+
+  //------------- Audio Control: collect clock entities & terminals -------------//
+  audioh_entity_t entity[CFG_TUH_AUDIO_ENTITY_MAX];
+  uint8_t entity_count = 0;
+
+  while (p_desc < p_end && tu_desc_type(p_desc) != TUSB_DESC_INTERFACE && tu_desc_len(p_desc)) {
+    // interrupt endpoint is not used
+    if (tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE) {
+      parse_ac_entity(entity, &entity_count, p_desc);
+    }
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  //------------- Audio Streaming interfaces -------------//
+  while (p_desc < p_end && tu_desc_len(p_desc)) {
+    if (tu_desc_type(p_desc) != TUSB_DESC_INTERFACE) {
+      p_desc = tu_desc_next(p_desc);
+      continue;
+    }
+
+    tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*) p_desc;
+
+    // function may also have other interface such as MIDI streaming: it is bound to this driver but not used
+    uint8_t const itf_offset = (uint8_t) (desc_itf->bInterfaceNumber - p_audio->ac_itf);
+    p_audio->itf_count = tu_max8(p_audio->itf_count, (uint8_t) (itf_offset + 1));
+
+    if (TUSB_CLASS_AUDIO == desc_itf->bInterfaceClass && AUDIO_SUBCLASS_STREAMING == desc_itf->bInterfaceSubClass) {
+      p_desc = parse_as_alt(p_audio, desc_itf, p_end, entity, entity_count);
+    } else {
+      p_desc = tu_desc_next(p_desc);
+    }
+  }
+
+  return true;
+}
+
+bool audioh_set_config(uint8_t daddr, uint8_t itf_num) {
+  uint8_t const idx = tuh_audio_itf_get_index(daddr, itf_num);
+  audioh_interface_t* p_audio = get_itf(idx);
+  TU_ASSERT(p_audio);
+
+  TU_LOG_DRV("AUDIOh Set Configure complete\r\n");
+  p_audio->mounted = true;
+  if (tuh_audio_mount_cb) {
+    tuh_audio_mount_cb(idx);
+  }
+
+  // notify usbh that driver enumeration is complete, skip all interfaces of this function
+  usbh_driver_set_config_complete(daddr, (uint8_t) (itf_num + p_audio->itf_count - 1));
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_AUDIO_HOST_H_
+#define _TUSB_AUDIO_HOST_H_
+
+#include "audio.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+
+// Max number of alternate settings (with an endpoint) parsed per streaming interface, others are ignored
+#ifndef CFG_TUH_AUDIO_ALT_MAX
+#define CFG_TUH_AUDIO_ALT_MAX       4
+#endif
+
+// Max number of clock entities and terminals parsed from the Audio Control interface
+#ifndef CFG_TUH_AUDIO_ENTITY_MAX
+#define CFG_TUH_AUDIO_ENTITY_MAX    8
+#endif
+
+// IN (microphone) endpoint buffer size, 2 buffers are used per interface.
+// Default is one full-speed packet of 48 KHz stereo 16-bit plus one extra sample frame
+#ifndef CFG_TUH_AUDIO_EP_IN_SZ_MAX
+#define CFG_TUH_AUDIO_EP_IN_SZ_MAX  196
+#endif
+
+// OUT (speaker) endpoint buffer size, 2 buffers are used per interface
+#ifndef CFG_TUH_AUDIO_EP_OUT_SZ_MAX
+#define CFG_TUH_AUDIO_EP_OUT_SZ_MAX 196
+#endif
+
+// RX FIFO size, holding samples received from device until read by application
+#ifndef CFG_TUH_AUDIO_RX_BUFSIZE
+#define CFG_TUH_AUDIO_RX_BUFSIZE    (4*CFG_TUH_AUDIO_EP_IN_SZ_MAX)
+#endif
+
+// TX FIFO size, holding samples written by application until sent to device
+#ifndef CFG_TUH_AUDIO_TX_BUFSIZE
+#define CFG_TUH_AUDIO_TX_BUFSIZE    (4*CFG_TUH_AUDIO_EP_OUT_SZ_MAX)
+#endif
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+
+// Format of an alternate setting of a streaming interface (Type I PCM only)
+typedef struct {
+  uint8_t alt;            // bAlternateSetting
+  uint8_t channels;       // bNrChannels
+  uint8_t subslot_size;   // bytes per sample of a channel: 1, 2, 3 or 4
+  uint8_t bit_resolution; // valid bits in a subslot
+  uint16_t ep_size;       // data endpoint max packet size
+  bool has_feedback;      // explicit feedback endpoint (asynchronous OUT)
+} tuh_audio_alt_info_t;
+
+// Get Interface index from device address + interface number (Audio Control interface)
+// return TUSB_INDEX_INVALID_8 (0xFF) if not found
+uint8_t tuh_audio_itf_get_index(uint8_t daddr, uint8_t itf_num);
+
+// Check if a interface is mounted
+bool tuh_audio_mounted(uint8_t idx);
+
+// Number of usable alternate settings of streaming direction: TUSB_DIR_IN for capture (microphone),
+// TUSB_DIR_OUT for playback (speaker). 0 if function has no streaming interface for that direction
+uint8_t tuh_audio_alt_count(uint8_t idx, tusb_dir_t dir);
+
+// Get format of the n-th usable alternate setting of streaming direction
+bool tuh_audio_alt_get_info(uint8_t idx, tusb_dir_t dir, uint8_t n, tuh_audio_alt_info_t* info);
+
+// Start streaming: select alternate setting (bAlternateSetting, not n) and set sample rate of the clock source
+// connected to the streaming terminal, then keep isochronous transfers running.
+// Requests are asynchronous, tuh_audio_stream_start_cb() is invoked with the result.
+bool tuh_audio_stream_start(uint8_t idx, tusb_dir_t dir, uint8_t alt, uint32_t sample_rate);
+
+// Stop streaming: isochronous transfers are not re-submitted and alternate setting 0 (zero bandwidth) is selected
+bool tuh_audio_stream_stop(uint8_t idx, tusb_dir_t dir);
+
+// Check if streaming direction is running
+bool tuh_audio_streaming(uint8_t idx, tusb_dir_t dir);
+
+//--------------------------------------------------------------------+
+// Read API (capture)
+//--------------------------------------------------------------------+
+
+// Get the number of bytes available for reading
+uint32_t tuh_audio_read_available(uint8_t idx);
+
+// Read samples, interleaved by channel as received
+uint32_t tuh_audio_read(uint8_t idx, void* buffer, uint32_t bufsize);
+
+// Clear the received FIFO
+bool tuh_audio_read_clear(uint8_t idx);
+
+//--------------------------------------------------------------------+
+// Write API (playback)
+//--------------------------------------------------------------------+
+
+// Get the number of bytes available for writing
+uint32_t tuh_audio_write_available(uint8_t idx);
+
+// Write samples, interleaved by channel. Silence is sent when FIFO underruns
+uint32_t tuh_audio_write(uint8_t idx, void const* buffer, uint32_t bufsize);
+
+// Clear the transmit FIFO
+bool tuh_audio_write_clear(uint8_t idx);
+
+//--------------------------------------------------------------------+
+// AUDIO APPLICATION CALLBACKS
+//--------------------------------------------------------------------+
+
+// Invoked when a device with Audio Class 2 function is mounted
+// idx is index of audio function in the internal pool.
+TU_ATTR_WEAK extern void tuh_audio_mount_cb(uint8_t idx);
+
+// Invoked when a device with Audio Class 2 function is unmounted
+TU_ATTR_WEAK extern void tuh_audio_umount_cb(uint8_t idx);
+
+// Invoked when tuh_audio_stream_start() is complete, streaming is running if success is true
+TU_ATTR_WEAK extern void tuh_audio_stream_start_cb(uint8_t idx, tusb_dir_t dir, bool success);
+
+// Invoked when a packet is received and copied to RX FIFO
+TU_ATTR_WEAK extern void tuh_audio_rx_cb(uint8_t idx, uint16_t xferred_bytes);
+
+// Invoked when a packet is sent, application can refill TX FIFO
+TU_ATTR_WEAK extern void tuh_audio_tx_complete_cb(uint8_t idx, uint16_t xferred_bytes);
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+bool audioh_init       (void);
+bool audioh_deinit     (void);
+bool audioh_open       (uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t max_len);
+bool audioh_set_config (uint8_t dev_addr, uint8_t itf_num);
+bool audioh_xfer_cb    (uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void audioh_close      (uint8_t dev_addr);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_AUDIO_HOST_H_ */
@@ -37,22 +37,51 @@
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
+TU_VERIFY_STATIC(CFG_TUD_BTH_DATA_RX_BUFSIZE % CFG_TUD_BTH_DATA_EPSIZE == 0,
+                 "CFG_TUD_BTH_DATA_RX_BUFSIZE must be multiple of CFG_TUD_BTH_DATA_EPSIZE");
+
+#if CFG_TUD_BTH_TX_QUEUE_SIZE
+enum {
+  BTD_LANE_EVENT = 0,
+  BTD_LANE_ACL,
+  BTD_LANE_COUNT
+};
+
+typedef struct {
+  void *data;
+  uint16_t len;
+} btd_tx_pkt_t;
+#endif
+
 typedef struct {
   uint8_t itf_num;
   uint8_t ep_ev;
   uint8_t ep_acl_in;
   uint16_t ep_acl_in_pkt_sz;
   uint8_t ep_acl_out;
-  uint8_t ep_voice[2];  // Not used yet
+  uint8_t ep_voice[2];
   uint8_t ep_voice_size[2][CFG_TUD_BTH_ISO_ALT_COUNT];
+  uint8_t iso_alt;
+  uint8_t iso_alt_count;
+  tusb_desc_interface_t const *iso_itf_desc; // first alternate setting of isochronous interface
 
   // Previous amount of bytes sent when issuing ZLP
   uint32_t prev_xferred_bytes;
+
+#if CFG_TUD_BTH_TX_QUEUE_SIZE
+  // queued packet stays in fifo until transmitted, busy is only modified in usbd task
+  tu_fifo_t tx_ff[BTD_LANE_COUNT];
+  btd_tx_pkt_t tx_ff_buf[BTD_LANE_COUNT][CFG_TUD_BTH_TX_QUEUE_SIZE];
+  bool tx_busy[BTD_LANE_COUNT];
+#endif
 } btd_interface_t;
 
 typedef struct {
-  TUD_EPBUF_DEF(epout_buf, CFG_TUD_BTH_DATA_EPSIZE);
+  TUD_EPBUF_DEF(epout_buf, CFG_TUD_BTH_DATA_RX_BUFSIZE);
   TUD_EPBUF_TYPE_DEF(bt_hci_cmd_t, hci_cmd);
+#if CFG_TUD_BTH_ISO_ALT_COUNT
+  TUD_EPBUF_DEF(voice_out_buf, CFG_TUD_BTH_ISO_EPSIZE);
+#endif
 } btd_epbuf_t;
 
 //--------------------------------------------------------------------+
@@ -61,6 +90,58 @@ typedef struct {
 static btd_interface_t _btd_itf;
 CFG_TUD_MEM_SECTION static btd_epbuf_t _btd_epbuf;
 
+#if CFG_TUD_BTH_TX_QUEUE_SIZE
+
+// Submit packet at head of lane if its endpoint is idle, must be called in usbd task
+static void bt_tx_kick(uint8_t rhport, uint8_t lane)
+{
+  btd_tx_pkt_t pkt;
+  uint8_t const ep = (lane == BTD_LANE_ACL) ? _btd_itf.ep_acl_in : _btd_itf.ep_ev;
+
+  if (_btd_itf.tx_busy[lane] || !tu_fifo_peek(&_btd_itf.tx_ff[lane], &pkt)) return;
+
+  _btd_itf.tx_busy[lane] = true;
+  if (!usbd_edpt_xfer(rhport, ep, pkt.data, pkt.len)) {
+    // drop packet, it will be never sent
+    _btd_itf.tx_busy[lane] = false;
+    (void) tu_fifo_read(&_btd_itf.tx_ff[lane], &pkt);
+    TU_BREAKPOINT();
+  }
+}
+
+static void bt_tx_kick_deferred(void *param)
+{
+  uint8_t const lane = (uint8_t) (uintptr_t) param;
+  bt_tx_kick(0, lane);
+}
+
+// Packet at head of lane is transmitted, release it and submit the next one
+static void bt_tx_done(uint8_t rhport, uint8_t lane)
+{
+  btd_tx_pkt_t pkt;
+  (void) tu_fifo_read(&_btd_itf.tx_ff[lane], &pkt);
+  _btd_itf.tx_busy[lane] = false;
+  bt_tx_kick(rhport, lane);
+}
+
+static bool bt_tx_data(uint8_t ep, void *data, uint16_t len)
+{
+  uint8_t const lane = (ep == _btd_itf.ep_acl_in) ? BTD_LANE_ACL : BTD_LANE_EVENT;
+  btd_tx_pkt_t const pkt = { .data = data, .len = len };
+
+  TU_VERIFY(ep != 0);
+  TU_VERIFY(tu_fifo_write(&_btd_itf.tx_ff[lane], &pkt));
+
+  // Only the first packet needs to be kicked, following ones are submitted on completion of previous one
+  if (tu_fifo_count(&_btd_itf.tx_ff[lane]) == 1) {
+    usbd_defer_func(bt_tx_kick_deferred, (void*) (uintptr_t) lane, false);
+  }
+
+  return true;
+}
+
+#else
+
 static bool bt_tx_data(uint8_t ep, void *data, uint16_t len)
 {
   uint8_t const rhport = 0;
@@ -73,6 +154,53 @@ static bool bt_tx_data(uint8_t ep, void *data, uint16_t len)
   return true;
 }
 
+#endif
+
+#if CFG_TUD_BTH_ISO_ALT_COUNT
+// Open voice endpoints with size of alternate setting, 0 is zero bandwidth setting
+static bool bt_iso_set_alt(uint8_t rhport, uint8_t alt)
+{
+  TU_VERIFY(alt < _btd_itf.iso_alt_count);
+
+#ifndef TUP_DCD_EDPT_ISO_ALLOC
+  if (_btd_itf.iso_alt) {
+    usbd_edpt_close(rhport, _btd_itf.ep_voice[TUSB_DIR_OUT]);
+    usbd_edpt_close(rhport, _btd_itf.ep_voice[TUSB_DIR_IN]);
+  }
+#endif
+  _btd_itf.iso_alt = 0;
+
+  if (alt) {
+    // alternate settings are consecutive, each has an interface and 2 endpoint descriptors
+    uint8_t const *p_desc = (uint8_t const *) _btd_itf.iso_itf_desc;
+    for (uint8_t i = 0; i < alt; i++) {
+      p_desc = tu_desc_next(tu_desc_next(tu_desc_next(p_desc)));
+    }
+    TU_ASSERT(((tusb_desc_interface_t const *) p_desc)->bAlternateSetting == alt);
+
+    for (uint8_t i = 0; i < 2; i++) {
+      p_desc = tu_desc_next(p_desc);
+      tusb_desc_endpoint_t const *desc_ep = (tusb_desc_endpoint_t const *) p_desc;
+      TU_ASSERT(tu_edpt_packet_size(desc_ep) <= CFG_TUD_BTH_ISO_EPSIZE);
+#ifdef TUP_DCD_EDPT_ISO_ALLOC
+      TU_ASSERT(usbd_edpt_iso_activate(rhport, desc_ep));
+#else
+      TU_ASSERT(usbd_edpt_open(rhport, desc_ep));
+#endif
+    }
+    _btd_itf.iso_alt = alt;
+
+    // Prepare for incoming voice data
+    TU_ASSERT(usbd_edpt_xfer(rhport, _btd_itf.ep_voice[TUSB_DIR_OUT], _btd_epbuf.voice_out_buf,
+                             _btd_itf.ep_voice_size[TUSB_DIR_OUT][alt]));
+  }
+
+  if (tud_bt_sco_alt_set_cb) tud_bt_sco_alt_set_cb(alt);
+
+  return true;
+}
+#endif
+
 //--------------------------------------------------------------------+
 // READ API
 //--------------------------------------------------------------------+
@@ -92,11 +220,43 @@ bool tud_bt_acl_data_send(void *event, uint16_t event_len)
   return bt_tx_data(_btd_itf.ep_acl_in, event, event_len);
 }
 
+bool tud_bt_sco_data_send(void *sco_data, uint16_t data_len)
+{
+#if CFG_TUD_BTH_ISO_ALT_COUNT
+  uint8_t const rhport = 0;
+  uint8_t const ep = _btd_itf.ep_voice[TUSB_DIR_IN];
+
+  TU_VERIFY(_btd_itf.iso_alt && data_len <= _btd_itf.ep_voice_size[TUSB_DIR_IN][_btd_itf.iso_alt]);
+  TU_VERIFY(usbd_edpt_claim(rhport, ep));
+  if (!usbd_edpt_xfer(rhport, ep, sco_data, data_len)) {
+    usbd_edpt_release(rhport, ep);
+    return false;
+  }
+  return true;
+#else
+  (void) sco_data;
+  (void) data_len;
+  return false;
+#endif
+}
+
+uint8_t tud_bt_sco_alt(void)
+{
+  return _btd_itf.iso_alt;
+}
+
 //--------------------------------------------------------------------+
 // USBD Driver API
 //--------------------------------------------------------------------+
 void btd_init(void) {
   tu_memclr(&_btd_itf, sizeof(_btd_itf));
+
+#if CFG_TUD_BTH_TX_QUEUE_SIZE
+  for (uint8_t lane = 0; lane < BTD_LANE_COUNT; lane++) {
+    tu_fifo_config(&_btd_itf.tx_ff[lane], _btd_itf.tx_ff_buf[lane], CFG_TUD_BTH_TX_QUEUE_SIZE,
+                   sizeof(btd_tx_pkt_t), false);
+  }
+#endif
 }
 
 bool btd_deinit(void) {
@@ -106,6 +266,16 @@ bool btd_deinit(void) {
 void btd_reset(uint8_t rhport)
 {
   (void)rhport;
+
+  // Pending packets are dropped, the endpoints are closed by usbd
+#if CFG_TUD_BTH_TX_QUEUE_SIZE
+  for (uint8_t lane = 0; lane < BTD_LANE_COUNT; lane++) {
+    tu_fifo_clear(&_btd_itf.tx_ff[lane]);
+    _btd_itf.tx_busy[lane] = false;
+  }
+#endif
+  _btd_itf.iso_alt = 0;
+  _btd_itf.prev_xferred_bytes = 0;
 }
 
 uint16_t btd_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc, uint16_t max_len)
@@ -152,9 +322,10 @@ uint16_t btd_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc, uint16_
   itf_desc = (tusb_desc_interface_t const *)tu_desc_next(tu_desc_next(desc_ep));
 
   // Prepare for incoming data from host
-  TU_ASSERT(usbd_edpt_xfer(rhport, _btd_itf.ep_acl_out, _btd_epbuf.epout_buf, CFG_TUD_BTH_DATA_EPSIZE), 0);
+  TU_ASSERT(usbd_edpt_xfer(rhport, _btd_itf.ep_acl_out, _btd_epbuf.epout_buf, CFG_TUD_BTH_DATA_RX_BUFSIZE), 0);
 
   drv_len = hci_itf_size;
+  _btd_itf.iso_itf_desc = itf_desc;
 
   // Ensure this is still BT Primary Controller
   TU_ASSERT(TUSB_CLASS_WIRELESS_CONTROLLER == itf_desc->bInterfaceClass &&
@@ -179,6 +350,7 @@ uint16_t btd_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc, uint16_
   // Store endpoint size for alternative
   _btd_itf.ep_voice_size[dir][itf_desc->bAlternateSetting] = (uint8_t) tu_edpt_packet_size(desc_ep);
   drv_len += iso_alt_itf_size;
+  _btd_itf.iso_alt_count = 1;
 
   for (int i = 1; i < CFG_TUD_BTH_ISO_ALT_COUNT && drv_len + iso_alt_itf_size <= max_len; ++i) {
     // Make sure rest of alternatives matches
@@ -207,7 +379,21 @@ uint16_t btd_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc, uint16_
               _btd_itf.ep_voice[dir] == desc_ep->bEndpointAddress, 0);
     _btd_itf.ep_voice_size[dir][itf_desc->bAlternateSetting] = (uint8_t) tu_edpt_packet_size(desc_ep);
     drv_len += iso_alt_itf_size;
+    _btd_itf.iso_alt_count++;
+  }
+
+#ifdef TUP_DCD_EDPT_ISO_ALLOC
+  // reserve hardware resource for the largest alternate setting, activated by SET_INTERFACE
+  for (uint8_t d = 0; d < 2; d++) {
+    uint16_t largest = 0;
+    for (uint8_t alt = 0; alt < _btd_itf.iso_alt_count; alt++) {
+      largest = tu_max16(largest, _btd_itf.ep_voice_size[d][alt]);
+    }
+    if (largest) {
+      TU_ASSERT(usbd_edpt_iso_alloc(rhport, _btd_itf.ep_voice[d], largest), 0);
+    }
   }
+#endif
 
   return drv_len;
 }
@@ -231,9 +417,20 @@ bool btd_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t c
     }
     else if (request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_INTERFACE)
     {
-      if (request->bRequest == TUSB_REQ_SET_INTERFACE && _btd_itf.itf_num + 1 == request->wIndex)
+      if (request->bmRequestType_bit.type == TUSB_REQ_TYPE_STANDARD && _btd_itf.itf_num + 1 == request->wIndex)
       {
-        // TODO: Set interface it would involve changing size of endpoint size
+#if CFG_TUD_BTH_ISO_ALT_COUNT
+        if (request->bRequest == TUSB_REQ_SET_INTERFACE)
+        {
+          TU_VERIFY(bt_iso_set_alt(rhport, (uint8_t) request->wValue));
+          return tud_control_status(rhport, request);
+        }
+        else if (request->bRequest == TUSB_REQ_GET_INTERFACE)
+        {
+          return tud_control_xfer(rhport, request, &_btd_itf.iso_alt, 1);
+        }
+#endif
+        return false;
       }
       else
       {
@@ -263,14 +460,17 @@ bool btd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result,
   // received new data from host
   if (ep_addr == _btd_itf.ep_acl_out)
   {
-    if (tud_bt_acl_data_received_cb) tud_bt_acl_data_received_cb(_btd_epbuf.epout_buf, xferred_bytes);
+    if (tud_bt_acl_data_received_cb) tud_bt_acl_data_received_cb(_btd_epbuf.epout_buf, (uint16_t) xferred_bytes);
 
     // prepare for next data
-    TU_ASSERT(usbd_edpt_xfer(rhport, _btd_itf.ep_acl_out, _btd_epbuf.epout_buf, CFG_TUD_BTH_DATA_EPSIZE));
+    TU_ASSERT(usbd_edpt_xfer(rhport, _btd_itf.ep_acl_out, _btd_epbuf.epout_buf, CFG_TUD_BTH_DATA_RX_BUFSIZE));
   }
   else if (ep_addr == _btd_itf.ep_ev)
   {
     if (tud_bt_event_sent_cb) tud_bt_event_sent_cb((uint16_t)xferred_bytes);
+#if CFG_TUD_BTH_TX_QUEUE_SIZE
+    bt_tx_done(rhport, BTD_LANE_EVENT);
+#endif
   }
   else if (ep_addr == _btd_itf.ep_acl_in)
   {
@@ -280,15 +480,39 @@ bool btd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result,
       _btd_itf.prev_xferred_bytes = xferred_bytes;
 
       // Send zero-length packet
+#if CFG_TUD_BTH_TX_QUEUE_SIZE
+      // lane is still busy, ZLP goes ahead of queued packets
+      TU_ASSERT(usbd_edpt_xfer(rhport, ep_addr, NULL, 0));
+#else
       tud_bt_acl_data_send(NULL, 0);
-    } else if (tud_bt_acl_data_sent_cb) {
+#endif
+    } else {
       if (xferred_bytes == 0) {
         xferred_bytes = _btd_itf.prev_xferred_bytes;
         _btd_itf.prev_xferred_bytes = 0;
       }
-      tud_bt_acl_data_sent_cb((uint16_t)xferred_bytes);
+      if (tud_bt_acl_data_sent_cb) tud_bt_acl_data_sent_cb((uint16_t)xferred_bytes);
+#if CFG_TUD_BTH_TX_QUEUE_SIZE
+      bt_tx_done(rhport, BTD_LANE_ACL);
+#endif
+    }
+  }
+#if CFG_TUD_BTH_ISO_ALT_COUNT
+  else if (ep_addr == _btd_itf.ep_voice[TUSB_DIR_OUT])
+  {
+    if (tud_bt_sco_data_received_cb) tud_bt_sco_data_received_cb(_btd_epbuf.voice_out_buf, (uint16_t) xferred_bytes);
+
+    // prepare for next data, unless host switched to zero bandwidth setting
+    if (_btd_itf.iso_alt) {
+      TU_ASSERT(usbd_edpt_xfer(rhport, ep_addr, _btd_epbuf.voice_out_buf,
+                               _btd_itf.ep_voice_size[TUSB_DIR_OUT][_btd_itf.iso_alt]));
     }
   }
+  else if (ep_addr == _btd_itf.ep_voice[TUSB_DIR_IN])
+  {
+    if (tud_bt_sco_data_sent_cb) tud_bt_sco_data_sent_cb((uint16_t) xferred_bytes);
+  }
+#endif
 
   return true;
 }
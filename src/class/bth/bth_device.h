@@ -47,6 +47,25 @@
 #define CFG_TUD_BTH_HISTORICAL_COMPATIBLE 0
 #endif
 
+// Number of Event and ACL packets (each) that can be queued for transmission. Events and ACL data are queued in
+// separated lanes so that events are not held back by ACL traffic. 0 means only one packet of each kind can be sent
+// at a time and tud_bt_event_send()/tud_bt_acl_data_send() fail while it is in progress.
+#ifndef CFG_TUD_BTH_TX_QUEUE_SIZE
+#define CFG_TUD_BTH_TX_QUEUE_SIZE 0
+#endif
+
+// Size of ACL OUT transfer, must be multiple of CFG_TUD_BTH_DATA_EPSIZE. A larger buffer receives multiple packets
+// per transfer: ACL data is delivered when buffer is full or with a short packet. Note: without zero-length packet
+// from host, ACL packet ending on packet boundary is only delivered with the next one.
+#ifndef CFG_TUD_BTH_DATA_RX_BUFSIZE
+#define CFG_TUD_BTH_DATA_RX_BUFSIZE CFG_TUD_BTH_DATA_EPSIZE
+#endif
+
+// Largest isochronous (SCO/eSCO voice) endpoint size of all alternate settings
+#ifndef CFG_TUD_BTH_ISO_EPSIZE
+#define CFG_TUD_BTH_ISO_EPSIZE 64
+#endif
+
 typedef struct TU_ATTR_PACKED
 {
   uint16_t op_code;
@@ -73,7 +92,7 @@ TU_ATTR_WEAK void tud_bt_hci_cmd_cb(void *hci_cmd, size_t cmd_len);
 // Detailed format is described in Bluetooth core specification Vol 2,
 // Part E, 5.4.2.
 // Length is from 4 bytes, (12 bits for Handle, 4 bits for flags
-// and 16 bits for data total length) to endpoint size.
+// and 16 bits for data total length) to CFG_TUD_BTH_DATA_RX_BUFSIZE.
 TU_ATTR_WEAK void tud_bt_acl_data_received_cb(void *acl_data, uint16_t data_len);
 
 // Called when event sent with tud_bt_event_send() was delivered to BT stack.
@@ -85,6 +104,18 @@ TU_ATTR_WEAK void tud_bt_event_sent_cb(uint16_t sent_bytes);
 // Controller can release/reuse buffer with ACL packet at this point.
 TU_ATTR_WEAK void tud_bt_acl_data_sent_cb(uint16_t sent_bytes);
 
+// Invoked when host selects alternate setting of the isochronous (voice) interface. 0 means no SCO/eSCO
+// connection (zero bandwidth), otherwise voice endpoints are opened with the size of this alternate setting.
+TU_ATTR_WEAK void tud_bt_sco_alt_set_cb(uint8_t alt);
+
+// Invoked when SCO data was received over isochronous endpoint from Bluetooth host.
+// Detailed format is described in Bluetooth core specification Vol 4, Part E, 5.4.3.
+TU_ATTR_WEAK void tud_bt_sco_data_received_cb(void *sco_data, uint16_t data_len);
+
+// Called when SCO data sent with tud_bt_sco_data_send() was transmitted.
+// Controller can release/reuse buffer with SCO packet at this point.
+TU_ATTR_WEAK void tud_bt_sco_data_sent_cb(uint16_t sent_bytes);
+
 // Bluetooth controller calls this function when it wants to send even packet
 // as described in Bluetooth core specification Vol 2, Part E, 5.4.4.
 // Event has at least 2 bytes, first is Event code second contains parameter
@@ -100,6 +131,14 @@ bool tud_bt_event_send(void *event, uint16_t event_len);
 // and must not be reused till tud_bt_acl_data_sent_cb() is called.
 bool tud_bt_acl_data_send(void *acl_data, uint16_t data_len);
 
+// Bluetooth controller calls this to send SCO data over isochronous endpoint, at most
+// endpoint size of current alternate setting. Buffer must not be reused till
+// tud_bt_sco_data_sent_cb() is called.
+bool tud_bt_sco_data_send(void *sco_data, uint16_t data_len);
+
+// Current alternate setting of isochronous (voice) interface
+uint8_t tud_bt_sco_alt(void);
+
 //--------------------------------------------------------------------+
 // Internal Class Driver API
 //--------------------------------------------------------------------+
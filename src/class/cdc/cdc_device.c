@@ -46,6 +46,7 @@
 #define BULK_PACKET_SIZE (TUD_OPT_HIGH_SPEED ? 512 : 64)
 
 typedef struct {
+  uint8_t rhport;
   uint8_t itf_num;
   uint8_t ep_notif;
   uint8_t ep_in;
@@ -54,6 +55,12 @@ typedef struct {
   // Bit 0:  DTR (Data Terminal Ready), Bit 1: RTS (Request to Send)
   uint8_t line_state;
 
+  #if CFG_TUD_CDC_TX_FLUSH_IDLE_MS
+  // TX auto flush: SOF accumulates idle time since last write
+  volatile bool tx_flush_armed;
+  volatile uint32_t tx_idle_us;
+  #endif
+
   /*------------- From this point, data is not cleared by bus reset -------------*/
   char wanted_char;
   TU_ATTR_ALIGNED(4) cdc_line_coding_t line_coding;
@@ -71,34 +78,59 @@ typedef struct {
 
 #define ITF_MEM_RESET_SIZE   offsetof(cdcd_interface_t, wanted_char)
 
+#if CFG_TUD_EPBUF_POOL_SIZE
+// drawn from usbd endpoint buffer pool when opened, released on reset
+typedef struct {
+  uint8_t* epout;
+  uint8_t* epin;
+} cdcd_epbuf_t;
+#else
 typedef struct {
   TUD_EPBUF_DEF(epout, CFG_TUD_CDC_EP_BUFSIZE);
   TUD_EPBUF_DEF(epin, CFG_TUD_CDC_EP_BUFSIZE);
 } cdcd_epbuf_t;
+#endif
 
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
 //--------------------------------------------------------------------+
 static cdcd_interface_t _cdcd_itf[CFG_TUD_CDC];
+#if CFG_TUD_EPBUF_POOL_SIZE
+static cdcd_epbuf_t _cdcd_epbuf[CFG_TUD_CDC];
+#else
 CFG_TUD_MEM_SECTION static cdcd_epbuf_t _cdcd_epbuf[CFG_TUD_CDC];
+#endif
 
 static tud_cdc_configure_fifo_t _cdcd_fifo_cfg;
 
+// Minimum OUT transfer: a whole packet, or the endpoint buffer if it is smaller
+#define OUT_XFER_MIN     TU_MIN(CFG_TUD_CDC_EP_BUFSIZE, BULK_PACKET_SIZE)
+
+// Length of next OUT transfer: as many whole packets as both endpoint buffer and rx fifo can take.
+// Transfer spans multiple packets and is completed early by a short packet.
+static uint16_t _out_xfer_len(tu_fifo_size_t available) {
+  uint16_t len = (uint16_t) TU_MIN(available, CFG_TUD_CDC_EP_BUFSIZE);
+  if (len >= BULK_PACKET_SIZE) {
+    len = (uint16_t) (len - len % BULK_PACKET_SIZE);
+  }
+  return len;
+}
+
 static bool _prep_out_transaction(uint8_t itf) {
-  const uint8_t rhport = 0;
   cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
   cdcd_epbuf_t* p_epbuf = &_cdcd_epbuf[itf];
+  const uint8_t rhport = p_cdc->rhport;
 
   // Skip if usb is not ready yet
-  TU_VERIFY(tud_ready() && p_cdc->ep_out);
+  TU_VERIFY(tud_rhport_ready(rhport) && p_cdc->ep_out);
 
-  uint16_t available = tu_fifo_remaining(&p_cdc->rx_ff);
+  tu_fifo_size_t available = tu_fifo_remaining(&p_cdc->rx_ff);
 
   // Prepare for incoming data but only allow what we can store in the ring buffer.
   // TODO Actually we can still carry out the transfer, keeping count of received bytes
   // and slowly move it to the FIFO when read().
   // This pre-check reduces endpoint claiming
-  TU_VERIFY(available >= CFG_TUD_CDC_EP_BUFSIZE);
+  TU_VERIFY(available >= OUT_XFER_MIN);
 
   // claim endpoint
   TU_VERIFY(usbd_edpt_claim(rhport, p_cdc->ep_out));
@@ -106,8 +138,8 @@ static bool _prep_out_transaction(uint8_t itf) {
   // fifo can be changed before endpoint is claimed
   available = tu_fifo_remaining(&p_cdc->rx_ff);
 
-  if (available >= CFG_TUD_CDC_EP_BUFSIZE) {
-    return usbd_edpt_xfer(rhport, p_cdc->ep_out, p_epbuf->epout, CFG_TUD_CDC_EP_BUFSIZE);
+  if (available >= OUT_XFER_MIN) {
+    return usbd_edpt_xfer(rhport, p_cdc->ep_out, p_epbuf->epout, _out_xfer_len(available));
   } else {
     // Release endpoint since we don't make any transfer
     usbd_edpt_release(rhport, p_cdc->ep_out);
@@ -126,12 +158,12 @@ bool tud_cdc_configure_fifo(const tud_cdc_configure_fifo_t* cfg) {
 }
 
 bool tud_cdc_n_ready(uint8_t itf) {
-  return tud_ready() && _cdcd_itf[itf].ep_in != 0 && _cdcd_itf[itf].ep_out != 0;
+  return tud_rhport_ready(_cdcd_itf[itf].rhport) && _cdcd_itf[itf].ep_in != 0 && _cdcd_itf[itf].ep_out != 0;
 }
 
 bool tud_cdc_n_connected(uint8_t itf) {
   // DTR (bit 0) active  is considered as connected
-  return tud_ready() && tu_bit_test(_cdcd_itf[itf].line_state, 0);
+  return tud_rhport_ready(_cdcd_itf[itf].rhport) && tu_bit_test(_cdcd_itf[itf].line_state, 0);
 }
 
 uint8_t tud_cdc_n_get_line_state(uint8_t itf) {
@@ -155,7 +187,7 @@ uint32_t tud_cdc_n_available(uint8_t itf) {
 
 uint32_t tud_cdc_n_read(uint8_t itf, void* buffer, uint32_t bufsize) {
   cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
-  uint32_t num_read = tu_fifo_read_n(&p_cdc->rx_ff, buffer, (uint16_t) TU_MIN(bufsize, UINT16_MAX));
+  uint32_t num_read = tu_fifo_read_n(&p_cdc->rx_ff, buffer, (tu_fifo_size_t) TU_MIN(bufsize, TU_FIFO_SIZE_MAX));
   _prep_out_transaction(itf);
   return num_read;
 }
@@ -170,12 +202,23 @@ void tud_cdc_n_read_flush(uint8_t itf) {
   _prep_out_transaction(itf);
 }
 
+uint32_t tud_cdc_n_read_info(uint8_t itf, tu_fifo_buffer_info_t* info) {
+  tu_fifo_get_read_info(&_cdcd_itf[itf].rx_ff, info);
+  return (uint32_t) info->len_lin + info->len_wrap;
+}
+
+void tud_cdc_n_read_advance(uint8_t itf, uint32_t count) {
+  cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
+  tu_fifo_advance_read_pointer(&p_cdc->rx_ff, (tu_fifo_size_t) TU_MIN(count, tu_fifo_count(&p_cdc->rx_ff)));
+  _prep_out_transaction(itf);
+}
+
 //--------------------------------------------------------------------+
 // WRITE API
 //--------------------------------------------------------------------+
-uint32_t tud_cdc_n_write(uint8_t itf, const void* buffer, uint32_t bufsize) {
+// New data is in TX FIFO: send it once there is a packet worth
+static void _tx_written(uint8_t itf) {
   cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
-  uint16_t ret = tu_fifo_write_n(&p_cdc->tx_ff, buffer, (uint16_t) TU_MIN(bufsize, UINT16_MAX));
 
   // flush if queue more than packet size
   if (tu_fifo_count(&p_cdc->tx_ff) >= BULK_PACKET_SIZE
@@ -186,28 +229,49 @@ uint32_t tud_cdc_n_write(uint8_t itf, const void* buffer, uint32_t bufsize) {
     tud_cdc_n_write_flush(itf);
   }
 
+  #if CFG_TUD_CDC_TX_FLUSH_IDLE_MS
+  // restart idle time, remaining data is flushed by SOF if nothing else is written
+  p_cdc->tx_idle_us = 0;
+  p_cdc->tx_flush_armed = !tu_fifo_empty(&p_cdc->tx_ff);
+  #endif
+}
+
+uint32_t tud_cdc_n_write(uint8_t itf, const void* buffer, uint32_t bufsize) {
+  cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
+  uint32_t ret = tu_fifo_write_n(&p_cdc->tx_ff, buffer, (tu_fifo_size_t) TU_MIN(bufsize, TU_FIFO_SIZE_MAX));
+  _tx_written(itf);
   return ret;
 }
 
+uint32_t tud_cdc_n_write_info(uint8_t itf, tu_fifo_buffer_info_t* info) {
+  tu_fifo_get_write_info(&_cdcd_itf[itf].tx_ff, info);
+  return (uint32_t) info->len_lin + info->len_wrap;
+}
+
+void tud_cdc_n_write_advance(uint8_t itf, uint32_t count) {
+  cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
+  tu_fifo_advance_write_pointer(&p_cdc->tx_ff, (tu_fifo_size_t) TU_MIN(count, tu_fifo_remaining(&p_cdc->tx_ff)));
+  _tx_written(itf);
+}
+
 uint32_t tud_cdc_n_write_flush(uint8_t itf) {
   cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
   cdcd_epbuf_t* p_epbuf = &_cdcd_epbuf[itf];
 
-  // Skip if usb is not ready yet
-  TU_VERIFY(tud_ready(), 0);
+  // Skip if usb is not ready yet or interface is not opened
+  const uint8_t rhport = p_cdc->rhport;
+  TU_VERIFY(tud_rhport_ready(rhport) && p_cdc->ep_in, 0);
 
   // No data to send
   if (!tu_fifo_count(&p_cdc->tx_ff)) {
     return 0;
   }
 
-  const uint8_t rhport = 0;
-
   // Claim the endpoint
   TU_VERIFY(usbd_edpt_claim(rhport, p_cdc->ep_in), 0);
 
   // Pull data from FIFO
-  const uint16_t count = tu_fifo_read_n(&p_cdc->tx_ff, p_epbuf->epin, CFG_TUD_CDC_EP_BUFSIZE);
+  const uint16_t count = (uint16_t) tu_fifo_read_n(&p_cdc->tx_ff, p_epbuf->epin, CFG_TUD_CDC_EP_BUFSIZE);
 
   if (count) {
     TU_ASSERT(usbd_edpt_xfer(rhport, p_cdc->ep_in, p_epbuf->epin, count), 0);
@@ -228,6 +292,13 @@ bool tud_cdc_n_write_clear(uint8_t itf) {
   return tu_fifo_clear(&_cdcd_itf[itf].tx_ff);
 }
 
+#if CFG_TUD_CDC_TX_FLUSH_IDLE_MS
+// deferred from cdcd_sof() when TX idle time expired
+static void _tx_idle_flush(void* param) {
+  tud_cdc_n_write_flush((uint8_t) (uintptr_t) param);
+}
+#endif
+
 //--------------------------------------------------------------------+
 // USBD Driver API
 //--------------------------------------------------------------------+
@@ -288,10 +359,15 @@ bool cdcd_deinit(void) {
 }
 
 void cdcd_reset(uint8_t rhport) {
-  (void) rhport;
+  #if CFG_TUD_CDC_TX_FLUSH_IDLE_MS
+  usbd_sof_enable(rhport, SOF_CONSUMER_CDC, false);
+  #endif
 
   for (uint8_t i = 0; i < CFG_TUD_CDC; i++) {
     cdcd_interface_t* p_cdc = &_cdcd_itf[i];
+    if (CFG_TUD_RHPORT_NUM > 1 && p_cdc->ep_in && p_cdc->rhport != rhport) {
+      continue; // opened on other controller
+    }
 
     tu_memclr(p_cdc, ITF_MEM_RESET_SIZE);
     if (!_cdcd_fifo_cfg.rx_persistent) {
@@ -301,6 +377,12 @@ void cdcd_reset(uint8_t rhport) {
       tu_fifo_clear(&p_cdc->tx_ff);
     }
     tu_fifo_set_overwritable(&p_cdc->tx_ff, true);
+
+    #if CFG_TUD_EPBUF_POOL_SIZE
+    usbd_epbuf_free(_cdcd_epbuf[i].epout);
+    usbd_epbuf_free(_cdcd_epbuf[i].epin);
+    tu_varclr(&_cdcd_epbuf[i]);
+    #endif
   }
 }
 
@@ -321,6 +403,7 @@ uint16_t cdcd_open(uint8_t rhport, const tusb_desc_interface_t* itf_desc, uint16
   TU_ASSERT(cdc_id < CFG_TUD_CDC, 0);
 
   //------------- Control Interface -------------//
+  p_cdc->rhport = rhport;
   p_cdc->itf_num = itf_desc->bInterfaceNumber;
 
   uint16_t drv_len = sizeof(tusb_desc_interface_t);
@@ -350,8 +433,18 @@ uint16_t cdcd_open(uint8_t rhport, const tusb_desc_interface_t* itf_desc, uint16
     drv_len += tu_desc_len(p_desc);
     p_desc = tu_desc_next(p_desc);
 
+    #if CFG_TUD_EPBUF_POOL_SIZE
+    // released in cdcd_reset() even if open fails
+    cdcd_epbuf_t* p_epbuf = &_cdcd_epbuf[cdc_id];
+    p_epbuf->epout = (uint8_t*) usbd_epbuf_alloc(CFG_TUD_CDC_EP_BUFSIZE);
+    p_epbuf->epin = (uint8_t*) usbd_epbuf_alloc(CFG_TUD_CDC_EP_BUFSIZE);
+    TU_ASSERT(p_epbuf->epout && p_epbuf->epin, 0);
+    #endif
+
     // Open endpoint pair
     TU_ASSERT(usbd_open_edpt_pair(rhport, p_desc, 2, TUSB_XFER_BULK, &p_cdc->ep_out, &p_cdc->ep_in), 0);
+    usbd_edpt_instance_set(rhport, p_cdc->ep_out, cdc_id);
+    usbd_edpt_instance_set(rhport, p_cdc->ep_in, cdc_id);
 
     drv_len += 2 * sizeof(tusb_desc_endpoint_t);
   }
@@ -359,6 +452,12 @@ uint16_t cdcd_open(uint8_t rhport, const tusb_desc_interface_t* itf_desc, uint16
   // Prepare for incoming data
   _prep_out_transaction(cdc_id);
 
+  #if CFG_TUD_CDC_TX_FLUSH_IDLE_MS
+  // SOF is used to measure TX idle time. It is kept enabled since tud_cdc_n_write() may be called
+  // from other tasks, where changing SOF consumers is not safe
+  usbd_sof_enable(rhport, SOF_CONSUMER_CDC, true);
+  #endif
+
   return drv_len;
 }
 
@@ -375,7 +474,7 @@ bool cdcd_control_xfer_cb(uint8_t rhport, uint8_t stage, const tusb_control_requ
   // Identify which interface to use
   for (itf = 0; itf < CFG_TUD_CDC; itf++) {
     p_cdc = &_cdcd_itf[itf];
-    if (p_cdc->itf_num == request->wIndex) {
+    if (p_cdc->rhport == rhport && p_cdc->itf_num == request->wIndex) {
       break;
     }
   }
@@ -447,17 +546,10 @@ bool cdcd_control_xfer_cb(uint8_t rhport, uint8_t stage, const tusb_control_requ
 bool cdcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes) {
   (void) result;
 
-  uint8_t itf;
-  cdcd_interface_t* p_cdc;
-
   // Identify which interface to use
-  for (itf = 0; itf < CFG_TUD_CDC; itf++) {
-    p_cdc = &_cdcd_itf[itf];
-    if ((ep_addr == p_cdc->ep_out) || (ep_addr == p_cdc->ep_in)) {
-      break;
-    }
-  }
+  uint8_t const itf = usbd_edpt_instance(rhport, ep_addr);
   TU_ASSERT(itf < CFG_TUD_CDC);
+  cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
   cdcd_epbuf_t* p_epbuf = &_cdcd_epbuf[itf];
 
   // Received new data
@@ -507,4 +599,25 @@ bool cdcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_
   return true;
 }
 
+#if CFG_TUD_CDC_TX_FLUSH_IDLE_MS
+// SOF handler in ISR context: accumulate idle time of TX FIFO, one SOF is 1ms on Full-Speed
+// and 125us (microframe) on High-Speed
+void cdcd_sof(uint8_t rhport, uint32_t frame_count) {
+  (void) frame_count;
+
+  uint32_t const period_us = (tud_rhport_speed_get(rhport) == TUSB_SPEED_HIGH) ? 125 : 1000;
+
+  for (uint8_t itf = 0; itf < CFG_TUD_CDC; itf++) {
+    cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
+    if (p_cdc->tx_flush_armed && p_cdc->rhport == rhport) {
+      p_cdc->tx_idle_us += period_us;
+      if (p_cdc->tx_idle_us >= CFG_TUD_CDC_TX_FLUSH_IDLE_MS * 1000u) {
+        p_cdc->tx_flush_armed = false;
+        usbd_defer_func(_tx_idle_flush, (void*) (uintptr_t) itf, true);
+      }
+    }
+  }
+}
+#endif
+
 #endif
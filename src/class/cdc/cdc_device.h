@@ -37,10 +37,18 @@
   #define CFG_TUD_CDC_EP_BUFSIZE    CFG_TUD_CDC_EPSIZE
 #endif
 
+// Endpoint buffer size, a multiple of bulk packet size (e.g 4096) allows multi-packet transfers
+// for higher throughput. OUT transfer completes early with a short packet.
 #ifndef CFG_TUD_CDC_EP_BUFSIZE
   #define CFG_TUD_CDC_EP_BUFSIZE    (TUD_OPT_HIGH_SPEED ? 512 : 64)
 #endif
 
+// Automatically flush TX FIFO when no data is written for this time (in milliseconds), measured with SOF.
+// 0 disables auto flush: data less than a packet is only sent with tud_cdc_n_write_flush()
+#ifndef CFG_TUD_CDC_TX_FLUSH_IDLE_MS
+  #define CFG_TUD_CDC_TX_FLUSH_IDLE_MS 0
+#endif
+
 #ifdef __cplusplus
  extern "C" {
 #endif
@@ -94,6 +102,13 @@ void tud_cdc_n_read_flush(uint8_t itf);
 // Get a byte from FIFO without removing it
 bool tud_cdc_n_peek(uint8_t itf, uint8_t* ui8);
 
+// Zero-copy read: get linear and wrapped part of received data in RX FIFO e.g to be sent by UART TX DMA directly.
+// Data stays in FIFO until released with tud_cdc_n_read_advance(). Return number of bytes available
+uint32_t tud_cdc_n_read_info(uint8_t itf, tu_fifo_buffer_info_t* info);
+
+// Release count bytes obtained by tud_cdc_n_read_info() and receive more from host
+void tud_cdc_n_read_advance(uint8_t itf, uint32_t count);
+
 // Write bytes to TX FIFO, data may remain in the FIFO for a while
 uint32_t tud_cdc_n_write(uint8_t itf, void const* buffer, uint32_t bufsize);
 
@@ -107,6 +122,14 @@ TU_ATTR_ALWAYS_INLINE static inline uint32_t tud_cdc_n_write_str(uint8_t itf, ch
   return tud_cdc_n_write(itf, str, strlen(str));
 }
 
+// Zero-copy write: get linear and wrapped part of free space in TX FIFO e.g to be filled by UART RX DMA directly.
+// Return number of bytes that can be written
+uint32_t tud_cdc_n_write_info(uint8_t itf, tu_fifo_buffer_info_t* info);
+
+// Commit count bytes written into the space obtained by tud_cdc_n_write_info(), sent the same way as tud_cdc_n_write()
+// Note: same as other API it must not be called in interrupt context, defer UART DMA completion to a task/main loop
+void tud_cdc_n_write_advance(uint8_t itf, uint32_t count);
+
 // Force sending data if possible, return number of forced bytes
 uint32_t tud_cdc_n_write_flush(uint8_t itf);
 
@@ -160,6 +183,14 @@ TU_ATTR_ALWAYS_INLINE static inline bool tud_cdc_peek(uint8_t* ui8) {
   return tud_cdc_n_peek(0, ui8);
 }
 
+TU_ATTR_ALWAYS_INLINE static inline uint32_t tud_cdc_read_info(tu_fifo_buffer_info_t* info) {
+  return tud_cdc_n_read_info(0, info);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void tud_cdc_read_advance(uint32_t count) {
+  tud_cdc_n_read_advance(0, count);
+}
+
 TU_ATTR_ALWAYS_INLINE static inline uint32_t tud_cdc_write_char(char ch) {
   return tud_cdc_n_write_char(0, ch);
 }
@@ -172,6 +203,14 @@ TU_ATTR_ALWAYS_INLINE static inline uint32_t tud_cdc_write_str(char const* str)
   return tud_cdc_n_write_str(0, str);
 }
 
+TU_ATTR_ALWAYS_INLINE static inline uint32_t tud_cdc_write_info(tu_fifo_buffer_info_t* info) {
+  return tud_cdc_n_write_info(0, info);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void tud_cdc_write_advance(uint32_t count) {
+  tud_cdc_n_write_advance(0, count);
+}
+
 TU_ATTR_ALWAYS_INLINE static inline uint32_t tud_cdc_write_flush(void) {
   return tud_cdc_n_write_flush(0);
 }
@@ -218,6 +257,7 @@ void     cdcd_reset           (uint8_t rhport);
 uint16_t cdcd_open            (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t max_len);
 bool     cdcd_control_xfer_cb (uint8_t rhport, uint8_t stage, tusb_control_request_t const * request);
 bool     cdcd_xfer_cb         (uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
+void     cdcd_sof             (uint8_t rhport, uint32_t frame_count);
 
 #ifdef __cplusplus
  }
@@ -73,13 +73,13 @@ typedef struct {
     tu_edpt_stream_t rx;
 
     uint8_t tx_ff_buf[CFG_TUH_CDC_TX_BUFSIZE];
-    uint8_t rx_ff_buf[CFG_TUH_CDC_TX_BUFSIZE];
+    uint8_t rx_ff_buf[CFG_TUH_CDC_RX_BUFSIZE];
   } stream;
 } cdch_interface_t;
 
 typedef struct {
   TUH_EPBUF_DEF(tx, CFG_TUH_CDC_TX_EPSIZE);
-  TUH_EPBUF_DEF(rx, CFG_TUH_CDC_TX_EPSIZE);
+  TUH_EPBUF_DEF(rx, CFG_TUH_CDC_RX_EPSIZE);
 } cdch_epbuf_t;
 
 static cdch_interface_t cdch_data[CFG_TUH_CDC];
@@ -239,16 +239,9 @@ static inline cdch_interface_t* get_itf(uint8_t idx) {
   return (p_cdc->daddr != 0) ? p_cdc : NULL;
 }
 
+// interface index is recorded when endpoint is opened, see open_edpt()
 static inline uint8_t get_idx_by_ep_addr(uint8_t daddr, uint8_t ep_addr) {
-  for(uint8_t i=0; i<CFG_TUH_CDC; i++) {
-    cdch_interface_t* p_cdc = &cdch_data[i];
-    if ( (p_cdc->daddr == daddr) &&
-         (ep_addr == p_cdc->ep_notif || ep_addr == p_cdc->stream.rx.ep_addr || ep_addr == p_cdc->stream.tx.ep_addr)) {
-      return i;
-    }
-  }
-
-  return TUSB_INDEX_INVALID_8;
+  return usbh_edpt_instance(daddr, ep_addr);
 }
 
 static cdch_interface_t* make_new_itf(uint8_t daddr, tusb_desc_interface_t const *itf_desc) {
@@ -360,6 +353,13 @@ bool tuh_cdc_write_clear(uint8_t idx) {
   return tu_edpt_stream_clear(&p_cdc->stream.tx);
 }
 
+bool tuh_cdc_write_set_watermark(uint8_t idx, uint16_t level) {
+  cdch_interface_t* p_cdc = get_itf(idx);
+  TU_VERIFY(p_cdc);
+
+  return tu_edpt_stream_set_watermark(&p_cdc->stream.tx, level);
+}
+
 uint32_t tuh_cdc_write_available(uint8_t idx) {
   cdch_interface_t* p_cdc = get_itf(idx);
   TU_VERIFY(p_cdc);
@@ -401,6 +401,39 @@ bool tuh_cdc_read_clear (uint8_t idx) {
   return ret;
 }
 
+bool tuh_cdc_read_set_fifo(uint8_t idx, void* buffer, uint16_t bufsize) {
+  cdch_interface_t* p_cdc = get_itf(idx);
+  TU_VERIFY(p_cdc);
+  tu_edpt_stream_t* rx = &p_cdc->stream.rx;
+
+  if (buffer == NULL) {
+    buffer = p_cdc->stream.rx_ff_buf;
+    bufsize = CFG_TUH_CDC_RX_BUFSIZE;
+  }
+  TU_VERIFY(bufsize);
+
+  // stop on-going transfer since it may receive directly into current fifo
+  if (usbh_edpt_busy(p_cdc->daddr, rx->ep_addr)) {
+    TU_VERIFY(tuh_edpt_abort_xfer(p_cdc->daddr, rx->ep_addr));
+  }
+
+  TU_VERIFY(tu_edpt_stream_set_fifo(rx, buffer, bufsize));
+  tu_edpt_stream_set_zero_copy(rx, true);
+
+  if (p_cdc->mounted) {
+    tu_edpt_stream_read_xfer(p_cdc->daddr, rx);
+  }
+
+  return true;
+}
+
+bool tuh_cdc_read_set_watermark(uint8_t idx, uint16_t level) {
+  cdch_interface_t* p_cdc = get_itf(idx);
+  TU_VERIFY(p_cdc);
+
+  return tu_edpt_stream_set_watermark(&p_cdc->stream.rx, level);
+}
+
 //--------------------------------------------------------------------+
 // Control Endpoint API
 //--------------------------------------------------------------------+
@@ -666,6 +699,14 @@ void cdch_close(uint8_t daddr) {
       p_cdc->mounted = false;
       tu_edpt_stream_close(&p_cdc->stream.tx);
       tu_edpt_stream_close(&p_cdc->stream.rx);
+      tu_edpt_stream_set_watermark(&p_cdc->stream.tx, 0);
+      tu_edpt_stream_set_watermark(&p_cdc->stream.rx, 0);
+
+      // application fifo may not be valid anymore
+      if (p_cdc->stream.rx.ff.buffer != p_cdc->stream.rx_ff_buf) {
+        tu_edpt_stream_set_fifo(&p_cdc->stream.rx, p_cdc->stream.rx_ff_buf, CFG_TUH_CDC_RX_BUFSIZE);
+        tu_edpt_stream_set_zero_copy(&p_cdc->stream.rx, true);
+      }
     }
   }
 }
@@ -679,6 +720,8 @@ bool cdch_xfer_cb(uint8_t daddr, uint8_t ep_addr, xfer_result_t event, uint32_t
   TU_ASSERT(p_cdc);
 
   if ( ep_addr == p_cdc->stream.tx.ep_addr ) {
+    tu_edpt_stream_write_xfer_complete(&p_cdc->stream.tx, xferred_bytes);
+
     // invoke tx complete callback to possibly refill tx fifo
     if (tuh_cdc_tx_complete_cb) {
       tuh_cdc_tx_complete_cb(idx);
@@ -689,25 +732,32 @@ bool cdch_xfer_cb(uint8_t daddr, uint8_t ep_addr, xfer_result_t event, uint32_t
       // - xferred_bytes is multiple of EP Packet size and not zero
       tu_edpt_stream_write_zlp_if_needed(daddr, &p_cdc->stream.tx, xferred_bytes);
     }
+
+    if (tuh_cdc_tx_watermark_cb && tu_edpt_stream_watermark_reached(&p_cdc->stream.tx)) {
+      tuh_cdc_tx_watermark_cb(idx);
+    }
   } else if ( ep_addr == p_cdc->stream.rx.ep_addr ) {
     #if CFG_TUH_CDC_FTDI
     if (p_cdc->serial_drid == SERIAL_DRIVER_FTDI) {
-      // FTDI reserve 2 bytes for status
-      // uint8_t status[2] = {p_cdc->stream.rx.ep_buf[0], p_cdc->stream.rx.ep_buf[1]};
-      tu_edpt_stream_read_xfer_complete_offset(&p_cdc->stream.rx, xferred_bytes, 2);
+      // FTDI reserve 2 bytes for status at the start of every packet
+      tu_edpt_stream_read_xfer_complete_strip(&p_cdc->stream.rx, xferred_bytes, 2);
     }else
     #endif
     {
       tu_edpt_stream_read_xfer_complete(&p_cdc->stream.rx, xferred_bytes);
     }
 
+    // re-arm first to keep receiving while application processes data, read() will re-arm later if fifo is full
+    tu_edpt_stream_read_xfer(daddr, &p_cdc->stream.rx);
+
     // invoke receive callback
     if (tuh_cdc_rx_cb) {
       tuh_cdc_rx_cb(idx);
     }
 
-    // prepare for next transfer if needed
-    tu_edpt_stream_read_xfer(daddr, &p_cdc->stream.rx);
+    if (tuh_cdc_rx_watermark_cb && tu_edpt_stream_watermark_reached(&p_cdc->stream.rx)) {
+      tuh_cdc_rx_watermark_cb(idx);
+    }
   }else if ( ep_addr == p_cdc->ep_notif ) {
     // TODO handle notification endpoint
   }else {
@@ -721,11 +771,17 @@ bool cdch_xfer_cb(uint8_t daddr, uint8_t ep_addr, xfer_result_t event, uint32_t
 // Enumeration
 //--------------------------------------------------------------------+
 
+static bool open_edpt(cdch_interface_t* p_cdc, tusb_desc_endpoint_t const* desc_ep) {
+  TU_ASSERT(tuh_edpt_open(p_cdc->daddr, desc_ep));
+  usbh_edpt_instance_set(p_cdc->daddr, desc_ep->bEndpointAddress, (uint8_t) (p_cdc - cdch_data));
+  return true;
+}
+
 static bool open_ep_stream_pair(cdch_interface_t* p_cdc, tusb_desc_endpoint_t const* desc_ep) {
   for (size_t i = 0; i < 2; i++) {
     TU_ASSERT(TUSB_DESC_ENDPOINT == desc_ep->bDescriptorType &&
               TUSB_XFER_BULK == desc_ep->bmAttributes.xfer);
-    TU_ASSERT(tuh_edpt_open(p_cdc->daddr, desc_ep));
+    TU_ASSERT(open_edpt(p_cdc, desc_ep));
 
     if (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN) {
       tu_edpt_stream_open(&p_cdc->stream.rx, desc_ep);
@@ -833,7 +889,7 @@ static bool acm_open(uint8_t daddr, tusb_desc_interface_t const* itf_desc, uint1
     TU_ASSERT(TUSB_DESC_ENDPOINT == tu_desc_type(p_desc));
     tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
 
-    TU_ASSERT(tuh_edpt_open(daddr, desc_ep));
+    TU_ASSERT(open_edpt(p_cdc, desc_ep));
     p_cdc->ep_notif = desc_ep->bEndpointAddress;
 
     p_desc = tu_desc_next(p_desc);
@@ -1520,7 +1576,7 @@ static bool ch34x_open(uint8_t daddr, tusb_desc_interface_t const* itf_desc, uin
   // Interrupt endpoint: not used for now
   TU_ASSERT(TUSB_DESC_ENDPOINT == tu_desc_type(desc_ep) &&
             TUSB_XFER_INTERRUPT == desc_ep->bmAttributes.xfer);
-  TU_ASSERT(tuh_edpt_open(daddr, desc_ep));
+  TU_ASSERT(open_edpt(p_cdc, desc_ep));
   p_cdc->ep_notif = desc_ep->bEndpointAddress;
 
   return true;
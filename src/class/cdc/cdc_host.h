@@ -115,6 +115,9 @@ uint32_t tuh_cdc_write_flush(uint8_t idx);
 // Clear the transmit FIFO
 bool tuh_cdc_write_clear(uint8_t idx);
 
+// Set TX FIFO watermark in bytes for tuh_cdc_tx_watermark_cb(), 0 to disable. Best called in tuh_cdc_mount_cb()
+bool tuh_cdc_write_set_watermark(uint8_t idx, uint16_t level);
+
 //--------------------------------------------------------------------+
 // Read API
 //--------------------------------------------------------------------+
@@ -131,6 +134,15 @@ bool tuh_cdc_peek(uint8_t idx, uint8_t* ch);
 // Clear the received FIFO
 bool tuh_cdc_read_clear (uint8_t idx);
 
+// Replace RX FIFO with application buffer e.g a larger one for high baudrate, bufsize should be at least bulk endpoint
+// size. Best called in tuh_cdc_mount_cb(), data in current FIFO is discarded. Buffer must be valid until interface is
+// unmounted, NULL to revert to internal FIFO of CFG_TUH_CDC_RX_BUFSIZE.
+bool tuh_cdc_read_set_fifo(uint8_t idx, void* buffer, uint16_t bufsize);
+
+// Set RX FIFO watermark in bytes for tuh_cdc_rx_watermark_cb(), 0 to disable. Best called in tuh_cdc_mount_cb(),
+// after tuh_cdc_read_set_fifo() if used
+bool tuh_cdc_read_set_watermark(uint8_t idx, uint16_t level);
+
 //--------------------------------------------------------------------+
 // Control Endpoint (Request) API
 // Each Function will make a USB control transfer request to/from device
@@ -188,6 +200,12 @@ TU_ATTR_WEAK extern void tuh_cdc_rx_cb(uint8_t idx);
 // Invoked when a TX is complete and therefore space becomes available in TX buffer
 TU_ATTR_WEAK extern void tuh_cdc_tx_complete_cb(uint8_t idx);
 
+// Invoked once when RX FIFO has at least watermark bytes, again only after it is read below watermark
+TU_ATTR_WEAK extern void tuh_cdc_rx_watermark_cb(uint8_t idx);
+
+// Invoked once when TX FIFO has at least watermark bytes free, again only after it is written below watermark
+TU_ATTR_WEAK extern void tuh_cdc_tx_watermark_cb(uint8_t idx);
+
 //--------------------------------------------------------------------+
 // Internal Class Driver API
 //--------------------------------------------------------------------+
@@ -57,6 +57,13 @@ typedef struct {
   bool flashing_in_progress;
   uint16_t block;
   uint16_t length;
+  uint16_t transfer_size; // wTransferSize of functional descriptor
+
+#if CFG_TUD_DFU_DNLOAD_PIPELINE
+  uint8_t buf_idx;       // buffer receiving next block, the other one may still be flashed by application
+  bool block_pending;    // block received but not passed to tud_dfu_download_cb() yet
+  bool manifest_pending; // zero-length DNLOAD received while last block is still being flashed
+#endif
 } dfu_state_ctx_t;
 
 // Only a single dfu state is allowed
@@ -64,12 +71,132 @@ static dfu_state_ctx_t _dfu_ctx;
 
 CFG_TUD_MEM_SECTION static struct {
   TUD_EPBUF_DEF(transfer_buf, CFG_TUD_DFU_XFER_BUFSIZE);
+#if CFG_TUD_DFU_DNLOAD_PIPELINE
+  TUD_EPBUF_DEF(transfer_buf2, CFG_TUD_DFU_XFER_BUFSIZE);
+#endif
 } _dfu_epbuf;
 
+#if CFG_TUD_DFU_DECOMPRESS
+TU_VERIFY_STATIC(CFG_TUD_DFU_DECOMPRESS_WINDOW_BITS >= 4 && CFG_TUD_DFU_DECOMPRESS_WINDOW_BITS <= 15 &&
+                 CFG_TUD_DFU_DECOMPRESS_LOOKAHEAD_BITS >= 3 &&
+                 CFG_TUD_DFU_DECOMPRESS_LOOKAHEAD_BITS < CFG_TUD_DFU_DECOMPRESS_WINDOW_BITS,
+                 "invalid heatshrink window/lookahead bits");
+
+enum {
+  DECOMP_WINDOW_SIZE = 1u << CFG_TUD_DFU_DECOMPRESS_WINDOW_BITS
+};
+
+// heatshrink token: tag bit 1 is followed by 8-bit literal, 0 by backref (offset - 1) then (count - 1), MSB first
+enum {
+  DECOMP_TAG = 0,
+  DECOMP_LITERAL,
+  DECOMP_INDEX,
+  DECOMP_COUNT,
+  DECOMP_COPY
+};
+
+static struct {
+  uint32_t bits;         // bits read from received block but not decoded yet, MSB first
+  uint8_t bit_count;
+  uint8_t phase;         // next part of token to decode
+  bool manifest_pending; // trailing partial block is flashed before manifestation
+  uint16_t in_pos;       // next byte of received block in transfer buffer
+  uint16_t head;         // next write position in window
+  uint16_t offset;       // backref offset from head
+  uint16_t count;        // backref bytes left to copy
+  uint16_t out_len;      // decompressed bytes in out buffer
+  uint16_t out_block;    // block number of out buffer
+  uint8_t window[DECOMP_WINDOW_SIZE];
+  uint8_t out[CFG_TUD_DFU_XFER_BUFSIZE];
+} _dfu_decomp;
+
+static void decomp_reset(void) {
+  tu_memclr(&_dfu_decomp, sizeof(_dfu_decomp));
+}
+
+static bool decomp_get_bits(uint8_t count, uint16_t* value) {
+  while (_dfu_decomp.bit_count < count) {
+    if (_dfu_decomp.in_pos >= _dfu_ctx.length) {
+      return false; // continue with next received block
+    }
+    _dfu_decomp.bits = (_dfu_decomp.bits << 8) | _dfu_epbuf.transfer_buf[_dfu_decomp.in_pos++];
+    _dfu_decomp.bit_count += 8;
+  }
+
+  _dfu_decomp.bit_count -= count;
+  *value = (uint16_t) ((_dfu_decomp.bits >> _dfu_decomp.bit_count) & TU_GENMASK(count - 1, 0));
+  return true;
+}
+
+static void decomp_output(uint8_t byte) {
+  _dfu_decomp.window[_dfu_decomp.head] = byte;
+  _dfu_decomp.head = (_dfu_decomp.head + 1) & (DECOMP_WINDOW_SIZE - 1);
+  _dfu_decomp.out[_dfu_decomp.out_len++] = byte;
+}
+
+// Decompress received block into out buffer, return true if out buffer is full and ready for flashing, false if
+// received block is consumed. A token can span two blocks, remaining bits of the last block are padding.
+static bool decomp_fill(void) {
+  while (_dfu_decomp.out_len < CFG_TUD_DFU_XFER_BUFSIZE) {
+    uint16_t value;
+    switch (_dfu_decomp.phase) {
+      case DECOMP_TAG:
+        if (!decomp_get_bits(1, &value)) return false;
+        _dfu_decomp.phase = value ? DECOMP_LITERAL : DECOMP_INDEX;
+        break;
+
+      case DECOMP_LITERAL:
+        if (!decomp_get_bits(8, &value)) return false;
+        decomp_output((uint8_t) value);
+        _dfu_decomp.phase = DECOMP_TAG;
+        break;
+
+      case DECOMP_INDEX:
+        if (!decomp_get_bits(CFG_TUD_DFU_DECOMPRESS_WINDOW_BITS, &value)) return false;
+        _dfu_decomp.offset = (uint16_t) (value + 1);
+        _dfu_decomp.phase = DECOMP_COUNT;
+        break;
+
+      case DECOMP_COUNT:
+        if (!decomp_get_bits(CFG_TUD_DFU_DECOMPRESS_LOOKAHEAD_BITS, &value)) return false;
+        _dfu_decomp.count = (uint16_t) (value + 1);
+        _dfu_decomp.phase = DECOMP_COPY;
+        break;
+
+      case DECOMP_COPY:
+      default:
+        decomp_output(_dfu_decomp.window[(_dfu_decomp.head - _dfu_decomp.offset) & (DECOMP_WINDOW_SIZE - 1)]);
+        if (--_dfu_decomp.count == 0) {
+          _dfu_decomp.phase = DECOMP_TAG;
+        }
+        break;
+    }
+  }
+
+  return true;
+}
+#endif
+
 static void reset_state(void) {
   _dfu_ctx.state = DFU_IDLE;
   _dfu_ctx.status = DFU_STATUS_OK;
   _dfu_ctx.flashing_in_progress = false;
+#if CFG_TUD_DFU_DNLOAD_PIPELINE
+  _dfu_ctx.block_pending = false;
+  _dfu_ctx.manifest_pending = false;
+#endif
+#if CFG_TUD_DFU_DECOMPRESS
+  decomp_reset();
+#endif
+}
+
+// buffer to receive next download block
+TU_ATTR_ALWAYS_INLINE static inline uint8_t* dnload_buf(void) {
+#if CFG_TUD_DFU_DNLOAD_PIPELINE
+  return _dfu_ctx.buf_idx ? _dfu_epbuf.transfer_buf2 : _dfu_epbuf.transfer_buf;
+#else
+  return _dfu_epbuf.transfer_buf;
+#endif
 }
 
 static bool reply_getstatus(uint8_t rhport, const tusb_control_request_t* request, dfu_state_t state, dfu_status_t status, uint32_t timeout);
@@ -190,9 +317,13 @@ uint16_t dfu_moded_open(uint8_t rhport, const tusb_desc_interface_t* itf_desc, u
 
   _dfu_ctx.attrs = func_desc->bAttributes;
 
-  // CFG_TUD_DFU_XFER_BUFSIZE has to be set to the buffer size used in TUD_DFU_DESCRIPTOR
+  // CFG_TUD_DFU_XFER_BUFSIZE has to be set to the buffer size used in TUD_DFU_DESCRIPTOR, except for upload-only
+  // interface with tud_dfu_upload_ptr_cb() which does not use transfer buffer
   const uint16_t transfer_size = tu_le16toh( tu_unaligned_read16((const uint8_t*) func_desc + offsetof(tusb_desc_dfu_functional_t, wTransferSize)) );
-  TU_ASSERT(transfer_size <= CFG_TUD_DFU_XFER_BUFSIZE, drv_len);
+  _dfu_ctx.transfer_size = transfer_size;
+  if ((_dfu_ctx.attrs & DFU_ATTR_CAN_DOWNLOAD) || !tud_dfu_upload_ptr_cb) {
+    TU_ASSERT(transfer_size <= CFG_TUD_DFU_XFER_BUFSIZE, drv_len);
+  }
 
   return drv_len;
 }
@@ -267,6 +398,17 @@ bool dfu_moded_control_xfer_cb(uint8_t rhport, uint8_t stage, const tusb_control
       case DFU_REQUEST_UPLOAD:
         if (stage == CONTROL_STAGE_SETUP) {
           TU_VERIFY(_dfu_ctx.attrs & DFU_ATTR_CAN_UPLOAD);
+
+          if (tud_dfu_upload_ptr_cb) {
+            // zero-copy: data stage is sent directly from application memory
+            TU_VERIFY(request->wLength <= tu_max16(_dfu_ctx.transfer_size, CFG_TUD_DFU_XFER_BUFSIZE));
+            const uint8_t* data = NULL;
+            const uint16_t xfer_len = tud_dfu_upload_ptr_cb(_dfu_ctx.alt, request->wValue, &data, request->wLength);
+            TU_VERIFY(xfer_len <= request->wLength);
+
+            return tud_control_xfer(rhport, request, (void*) (uintptr_t) data, xfer_len);
+          }
+
           TU_VERIFY(tud_dfu_upload_cb);
           TU_VERIFY(request->wLength <= CFG_TUD_DFU_XFER_BUFSIZE);
 
@@ -283,8 +425,26 @@ bool dfu_moded_control_xfer_cb(uint8_t rhport, uint8_t stage, const tusb_control
           TU_VERIFY(_dfu_ctx.state == DFU_IDLE || _dfu_ctx.state == DFU_DNLOAD_IDLE);
           TU_VERIFY(request->wLength <= CFG_TUD_DFU_XFER_BUFSIZE);
 
+#if CFG_TUD_DFU_DNLOAD_PIPELINE
+          // application may still be flashing previous block from the other buffer
+          if (request->wLength) {
+            _dfu_ctx.block_pending = true;
+          } else if (_dfu_ctx.flashing_in_progress) {
+            _dfu_ctx.manifest_pending = true; // manifest once last block is finished
+          } else {
+            _dfu_ctx.flashing_in_progress = true;
+          }
+#else
           // set to true for both download and manifest
           _dfu_ctx.flashing_in_progress = true;
+#endif
+
+#if CFG_TUD_DFU_DECOMPRESS
+          if (_dfu_ctx.state == DFU_IDLE) {
+            decomp_reset(); // start of new image
+          }
+          _dfu_decomp.in_pos = 0;
+#endif
 
           // save block and length for flashing
           _dfu_ctx.block = request->wValue;
@@ -293,7 +453,7 @@ bool dfu_moded_control_xfer_cb(uint8_t rhport, uint8_t stage, const tusb_control
           if (request->wLength) {
             // Download with payload -> transition to DOWNLOAD SYNC
             _dfu_ctx.state = DFU_DNLOAD_SYNC;
-            return tud_control_xfer(rhport, request, _dfu_epbuf.transfer_buf, request->wLength);
+            return tud_control_xfer(rhport, request, dnload_buf(), request->wLength);
           } else {
             // Download is complete -> transition to MANIFEST SYNC
             _dfu_ctx.state = DFU_MANIFEST_SYNC;
@@ -330,6 +490,35 @@ bool dfu_moded_control_xfer_cb(uint8_t rhport, uint8_t stage, const tusb_control
 }
 
 void tud_dfu_finish_flashing(uint8_t status) {
+#if CFG_TUD_DFU_DECOMPRESS
+  if (status == DFU_STATUS_OK && _dfu_ctx.state == DFU_DNBUSY) {
+    // out block is flashed, rest of received block is decompressed on next GETSTATUS
+    _dfu_decomp.out_len = 0;
+    _dfu_decomp.out_block++;
+    _dfu_ctx.state = DFU_DNLOAD_SYNC;
+    return;
+  }
+
+  if (status == DFU_STATUS_OK && _dfu_decomp.manifest_pending) {
+    // trailing partial block is flashed, manifestation can start
+    _dfu_decomp.manifest_pending = false;
+    _dfu_decomp.out_len = 0;
+    tud_dfu_manifest_cb(_dfu_ctx.alt);
+    return;
+  }
+#endif
+
+#if CFG_TUD_DFU_DNLOAD_PIPELINE
+  if (status == DFU_STATUS_OK && _dfu_ctx.manifest_pending) {
+    // last block is flashed, manifestation can start. If host has not polled yet, it is started on GETSTATUS
+    _dfu_ctx.manifest_pending = false;
+    if (_dfu_ctx.state == DFU_MANIFEST) {
+      tud_dfu_manifest_cb(_dfu_ctx.alt);
+    }
+    return;
+  }
+#endif
+
   _dfu_ctx.flashing_in_progress = false;
 
   if (status == DFU_STATUS_OK) {
@@ -353,6 +542,13 @@ static bool process_download_get_status(uint8_t rhport, uint8_t stage, const tus
     dfu_state_t next_state;
     uint32_t timeout;
 
+#if CFG_TUD_DFU_DECOMPRESS
+    // decompress until out buffer is full, nothing to flash if received block is consumed before that
+    if (_dfu_ctx.flashing_in_progress && !decomp_fill()) {
+      _dfu_ctx.flashing_in_progress = false;
+    }
+#endif
+
     if (_dfu_ctx.flashing_in_progress) {
       next_state = DFU_DNBUSY;
       timeout = tud_dfu_get_timeout_cb(_dfu_ctx.alt, (uint8_t)next_state);
@@ -363,12 +559,33 @@ static bool process_download_get_status(uint8_t rhport, uint8_t stage, const tus
 
     return reply_getstatus(rhport, request, next_state, _dfu_ctx.status, timeout);
   } else if (stage == CONTROL_STAGE_ACK) {
+#if CFG_TUD_DFU_DNLOAD_PIPELINE
     if (_dfu_ctx.flashing_in_progress) {
+      // previous block is not finished yet, received block is passed on next GETSTATUS
       _dfu_ctx.state = DFU_DNBUSY;
+    } else {
+      _dfu_ctx.state = DFU_DNLOAD_IDLE;
+      if (_dfu_ctx.block_pending) {
+        // hand received buffer to application, next block is received into the other one
+        uint8_t const* data = dnload_buf();
+        _dfu_ctx.block_pending = false;
+        _dfu_ctx.flashing_in_progress = true;
+        _dfu_ctx.buf_idx ^= 1;
+        tud_dfu_download_cb(_dfu_ctx.alt, _dfu_ctx.block, data, _dfu_ctx.length);
+      }
+    }
+#else
+    if (_dfu_ctx.flashing_in_progress) {
+      _dfu_ctx.state = DFU_DNBUSY;
+  #if CFG_TUD_DFU_DECOMPRESS
+      tud_dfu_download_cb(_dfu_ctx.alt, _dfu_decomp.out_block, _dfu_decomp.out, CFG_TUD_DFU_XFER_BUFSIZE);
+  #else
       tud_dfu_download_cb(_dfu_ctx.alt, _dfu_ctx.block, _dfu_epbuf.transfer_buf, _dfu_ctx.length);
+  #endif
     } else {
       _dfu_ctx.state = DFU_DNLOAD_IDLE;
     }
+#endif
   }
 
   return true;
@@ -392,7 +609,19 @@ static bool process_manifest_get_status(uint8_t rhport, uint8_t stage, const tus
   } else if (stage == CONTROL_STAGE_ACK) {
     if (_dfu_ctx.flashing_in_progress) {
       _dfu_ctx.state = DFU_MANIFEST;
-      tud_dfu_manifest_cb(_dfu_ctx.alt);
+#if CFG_TUD_DFU_DNLOAD_PIPELINE
+      // otherwise started by tud_dfu_finish_flashing() of last block
+      if (!_dfu_ctx.manifest_pending)
+#elif CFG_TUD_DFU_DECOMPRESS
+      if (_dfu_decomp.out_len) {
+        // flash trailing partial block first, manifestation is started by tud_dfu_finish_flashing()
+        _dfu_decomp.manifest_pending = true;
+        tud_dfu_download_cb(_dfu_ctx.alt, _dfu_decomp.out_block, _dfu_decomp.out, _dfu_decomp.out_len);
+      } else
+#endif
+      {
+        tud_dfu_manifest_cb(_dfu_ctx.alt);
+      }
     } else {
       _dfu_ctx.state = DFU_IDLE;
     }
@@ -41,6 +41,34 @@
   #error "CFG_TUD_DFU_XFER_BUFSIZE must be defined, it has to be set to the buffer size used in TUD_DFU_DESCRIPTOR"
 #endif
 
+// Double buffered download: next block is received while application is still flashing the previous one.
+// GETSTATUS after a block is answered with dfuDNLOAD_IDLE once it is passed to tud_dfu_download_cb(), dfuDNBUSY
+// (with bwPollTimeout from tud_dfu_get_timeout_cb()) is only reported if previous block is not finished yet.
+// Requires a second CFG_TUD_DFU_XFER_BUFSIZE buffer
+#ifndef CFG_TUD_DFU_DNLOAD_PIPELINE
+  #define CFG_TUD_DFU_DNLOAD_PIPELINE   0
+#endif
+
+// Streaming decompression of downloaded image: DNLOAD blocks carry a heatshrink compressed stream which is decoded
+// into plain blocks of CFG_TUD_DFU_XFER_BUFSIZE bytes (numbered from 0, last one may be shorter) before passed to
+// tud_dfu_download_cb(). Image must be compressed with the same window and lookahead e.g 'heatshrink -e -w 8 -l 4'.
+// Requires a window of 2^WINDOW_BITS bytes and a CFG_TUD_DFU_XFER_BUFSIZE output buffer.
+#ifndef CFG_TUD_DFU_DECOMPRESS
+  #define CFG_TUD_DFU_DECOMPRESS   0
+#endif
+
+#ifndef CFG_TUD_DFU_DECOMPRESS_WINDOW_BITS
+  #define CFG_TUD_DFU_DECOMPRESS_WINDOW_BITS    8
+#endif
+
+#ifndef CFG_TUD_DFU_DECOMPRESS_LOOKAHEAD_BITS
+  #define CFG_TUD_DFU_DECOMPRESS_LOOKAHEAD_BITS 4
+#endif
+
+#if CFG_TUD_DFU_DECOMPRESS && CFG_TUD_DFU_DNLOAD_PIPELINE
+  #error "CFG_TUD_DFU_DECOMPRESS cannot be used with CFG_TUD_DFU_DNLOAD_PIPELINE"
+#endif
+
 //--------------------------------------------------------------------+
 // Application API
 //--------------------------------------------------------------------+
@@ -64,6 +92,10 @@ uint32_t tud_dfu_get_timeout_cb(uint8_t alt, uint8_t state);
 // Invoked when received DFU_DNLOAD (wLength>0) following by DFU_GETSTATUS (state=DFU_DNBUSY) requests
 // This callback could be returned before flashing op is complete (async).
 // Once finished flashing, application must call tud_dfu_finish_flashing()
+// With CFG_TUD_DFU_DNLOAD_PIPELINE, data stays valid until tud_dfu_finish_flashing() while next block is received
+// into the other buffer
+// With CFG_TUD_DFU_DECOMPRESS, data is decompressed and block_num counts decompressed blocks. A received block can
+// expand to several blocks, trailing partial block is passed on zero-length DNLOAD before tud_dfu_manifest_cb()
 void tud_dfu_download_cb (uint8_t alt, uint16_t block_num, uint8_t const *data, uint16_t length);
 
 // Invoked when download process is complete, received DFU_DNLOAD (wLength=0) following by DFU_GETSTATUS (state=Manifest)
@@ -76,6 +108,13 @@ void tud_dfu_manifest_cb(uint8_t alt);
 // Return the number of written bytes
 TU_ATTR_WEAK uint16_t tud_dfu_upload_cb(uint8_t alt, uint16_t block_num, uint8_t* data, uint16_t length);
 
+// Optional: invoked when received DFU_UPLOAD request, tud_dfu_upload_cb() is not used if this is implemented.
+// Application points *data to up to length bytes (e.g memory-mapped XIP flash) which is sent without copying to the
+// transfer buffer, memory must stay valid until data stage is complete. Return the number of bytes.
+// For upload-only interface (no DFU_ATTR_CAN_DOWNLOAD), wTransferSize can be larger than CFG_TUD_DFU_XFER_BUFSIZE.
+// Data stage goes straight from memory with a single transfer when CFG_TUD_CONTROL_XFER_DIRECT is enabled.
+TU_ATTR_WEAK uint16_t tud_dfu_upload_ptr_cb(uint8_t alt, uint16_t block_num, uint8_t const** data, uint16_t length);
+
 // Invoked when a DFU_DETACH request is received
 TU_ATTR_WEAK void tud_dfu_detach_cb(void);
 
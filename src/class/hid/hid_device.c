@@ -40,6 +40,7 @@
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
 typedef struct {
+  uint8_t rhport;
   uint8_t itf_num;
   uint8_t ep_in;
   uint8_t ep_out;       // optional Out endpoint
@@ -52,6 +53,15 @@ typedef struct {
   // TODO save hid descriptor since host can specifically request this after enumeration
   // Note: HID descriptor may be not available from application after enumeration
   const tusb_hid_descriptor_hid_t*hid_descriptor;
+
+#if CFG_TUD_HID_SOF_SYNC
+  bool sync_enabled;
+  uint16_t sync_lead_us;
+  uint16_t sync_delay_us; // delay of deferred tud_hid_report_due_cb()
+  uint16_t poll_interval; // IN endpoint polling interval in (micro)frames
+  uint16_t poll_phase;    // sof_count of (micro)frame in which host polls IN endpoint
+  uint16_t sof_count;     // (micro)frames since sync is enabled, modulo poll_interval
+#endif
 } hidd_interface_t;
 
 typedef struct {
@@ -63,10 +73,40 @@ typedef struct {
 static hidd_interface_t _hidd_itf[CFG_TUD_HID];
 CFG_TUD_MEM_SECTION static hidd_epbuf_t _hidd_epbuf[CFG_TUD_HID];
 
+#if CFG_TUD_HID_REPORT_QUEUE_N
+enum {
+  HIDD_REPORT_KIND_RAW = 0,
+  HIDD_REPORT_KIND_MOUSE, // hid_mouse_report_t layout, deltas can be accumulated
+};
+
+typedef struct {
+  uint16_t len; // including report ID
+  uint8_t report_id;
+  uint8_t kind;
+  uint8_t data[CFG_TUD_HID_EP_BUFSIZE];
+} hidd_report_entry_t;
+
+typedef struct {
+  hidd_report_entry_t entry[CFG_TUD_HID_REPORT_QUEUE_N];
+  uint8_t rd;    // oldest entry
+  uint8_t count;
+
+  /*------------- From this point, data is not cleared by bus reset -------------*/
+  uint8_t mode;  // hid_report_queue_mode_t
+
+  #if OSAL_MUTEX_REQUIRED
+  OSAL_MUTEX_DEF(mutexdef);
+  osal_mutex_t mutex;
+  #endif
+} hidd_report_queue_t;
+
+static hidd_report_queue_t _hidd_queue[CFG_TUD_HID];
+#endif
+
 /*------------- Helpers -------------*/
-TU_ATTR_ALWAYS_INLINE static inline uint8_t get_index_by_itfnum(uint8_t itf_num) {
+TU_ATTR_ALWAYS_INLINE static inline uint8_t get_index_by_itfnum(uint8_t rhport, uint8_t itf_num) {
   for (uint8_t i = 0; i < CFG_TUD_HID; i++) {
-    if (itf_num == _hidd_itf[i].itf_num) {
+    if (rhport == _hidd_itf[i].rhport && itf_num == _hidd_itf[i].itf_num) {
       return i;
     }
   }
@@ -101,20 +141,149 @@ TU_ATTR_WEAK void tud_hid_report_failed_cb(uint8_t instance, hid_report_type_t r
   (void) xferred_bytes;
 }
 
+#if CFG_TUD_HID_SOF_SYNC
+TU_ATTR_WEAK void tud_hid_report_due_cb(uint8_t instance, uint16_t delay_us) {
+  (void) instance;
+  (void) delay_us;
+}
+#endif
+
+//--------------------------------------------------------------------+
+// Report Queue
+//--------------------------------------------------------------------+
+#if CFG_TUD_HID_REPORT_QUEUE_N
+
+TU_ATTR_ALWAYS_INLINE static inline void queue_lock(hidd_report_queue_t *q) {
+  #if OSAL_MUTEX_REQUIRED
+  osal_mutex_lock(q->mutex, OSAL_TIMEOUT_WAIT_FOREVER);
+  #else
+  (void) q;
+  #endif
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void queue_unlock(hidd_report_queue_t *q) {
+  #if OSAL_MUTEX_REQUIRED
+  osal_mutex_unlock(q->mutex);
+  #else
+  (void) q;
+  #endif
+}
+
+// add a delta to a int8_t field, return false if it would overflow
+static bool accumulate_i8(int8_t *acc, int8_t delta) {
+  int16_t const sum = (int16_t) (*acc + delta);
+  TU_VERIFY(sum >= INT8_MIN && sum <= INT8_MAX);
+  *acc = (int8_t) sum;
+  return true;
+}
+
+// merge new mouse report into queued one, both must have same buttons and not overflow
+static bool coalesce_mouse(hidd_report_entry_t *e, hid_mouse_report_t const *report) {
+  hid_mouse_report_t merged;
+  memcpy(&merged, e->data + (e->report_id ? 1 : 0), sizeof(merged));
+
+  TU_VERIFY(merged.buttons == report->buttons);
+  TU_VERIFY(accumulate_i8(&merged.x, report->x) && accumulate_i8(&merged.y, report->y) &&
+            accumulate_i8(&merged.wheel, report->wheel) && accumulate_i8(&merged.pan, report->pan));
+
+  memcpy(e->data + (e->report_id ? 1 : 0), &merged, sizeof(merged));
+  return true;
+}
+
+static bool queue_put(hidd_report_queue_t *q, uint8_t report_id, void const *report, uint16_t len, uint8_t kind) {
+  if (q->mode == HID_REPORT_QUEUE_COALESCE) {
+    // newest queued report with same ID
+    for (uint8_t i = q->count; i > 0; i--) {
+      hidd_report_entry_t *e = &q->entry[(q->rd + i - 1) % CFG_TUD_HID_REPORT_QUEUE_N];
+      if (e->report_id == report_id) {
+        if (e->kind == kind && kind == HIDD_REPORT_KIND_MOUSE) {
+          if (coalesce_mouse(e, (hid_mouse_report_t const *) report)) {
+            return true;
+          }
+          break; // queue as new report
+        }
+        e->kind = kind;
+        e->len = (uint16_t) ((report_id ? 1 : 0) + len);
+        memcpy(e->data + (report_id ? 1 : 0), report, len);
+        return true;
+      }
+    }
+  }
+
+  TU_VERIFY(q->count < CFG_TUD_HID_REPORT_QUEUE_N);
+  hidd_report_entry_t *e = &q->entry[(q->rd + q->count) % CFG_TUD_HID_REPORT_QUEUE_N];
+  e->report_id = report_id;
+  e->kind = kind;
+  e->len = (uint16_t) ((report_id ? 1 : 0) + len);
+  e->data[0] = report_id;
+  memcpy(e->data + (report_id ? 1 : 0), report, len);
+  q->count++;
+
+  return true;
+}
+
+// submit oldest queued report if endpoint is idle, must be called with queue locked
+static void queue_pump(uint8_t instance) {
+  hidd_report_queue_t *q = &_hidd_queue[instance];
+  hidd_interface_t *p_hid = &_hidd_itf[instance];
+  const uint8_t rhport = p_hid->rhport;
+
+  if (q->count == 0 || !usbd_edpt_claim(rhport, p_hid->ep_in)) {
+    return;
+  }
+
+  hidd_report_entry_t *e = &q->entry[q->rd];
+  memcpy(_hidd_epbuf[instance].epin, e->data, e->len);
+  q->rd = (uint8_t) ((q->rd + 1) % CFG_TUD_HID_REPORT_QUEUE_N);
+  q->count--;
+
+  usbd_edpt_xfer(rhport, p_hid->ep_in, _hidd_epbuf[instance].epin, e->len);
+}
+
+static bool hidd_report_queued(uint8_t instance, uint8_t report_id, void const *report, uint16_t len, uint8_t kind) {
+  TU_VERIFY(instance < CFG_TUD_HID);
+  TU_VERIFY(usbd_rhport_armable(_hidd_itf[instance].rhport) && _hidd_itf[instance].ep_in);
+  TU_VERIFY((report_id ? 1u : 0u) + len <= CFG_TUD_HID_EP_BUFSIZE);
+  hidd_report_queue_t *q = &_hidd_queue[instance];
+
+  queue_lock(q);
+  bool const ret = queue_put(q, report_id, report, len, kind);
+  queue_pump(instance);
+  queue_unlock(q);
+
+  return ret;
+}
+
+bool tud_hid_n_report_queue_mode(uint8_t instance, hid_report_queue_mode_t mode) {
+  TU_VERIFY(instance < CFG_TUD_HID);
+  _hidd_queue[instance].mode = (uint8_t) mode;
+  return true;
+}
+
+uint8_t tud_hid_n_report_queued(uint8_t instance) {
+  TU_VERIFY(instance < CFG_TUD_HID, 0);
+  return _hidd_queue[instance].count;
+}
+
+#endif
+
 //--------------------------------------------------------------------+
 // APPLICATION API
 //--------------------------------------------------------------------+
 bool tud_hid_n_ready(uint8_t instance) {
-  uint8_t const rhport = 0;
+  uint8_t const rhport = _hidd_itf[instance].rhport;
   uint8_t const ep_in = _hidd_itf[instance].ep_in;
-  return tud_ready() && (ep_in != 0) && !usbd_edpt_busy(rhport, ep_in);
+  return usbd_rhport_armable(rhport) && (ep_in != 0) && !usbd_edpt_busy(rhport, ep_in);
 }
 
 bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len) {
+  #if CFG_TUD_HID_REPORT_QUEUE_N
+  return hidd_report_queued(instance, report_id, report, len, HIDD_REPORT_KIND_RAW);
+  #else
   TU_VERIFY(instance < CFG_TUD_HID);
-  const uint8_t rhport = 0;
   hidd_interface_t *p_hid = &_hidd_itf[instance];
   hidd_epbuf_t *p_epbuf = &_hidd_epbuf[instance];
+  const uint8_t rhport = p_hid->rhport;
 
   // claim endpoint
   TU_VERIFY(usbd_edpt_claim(rhport, p_hid->ep_in));
@@ -129,7 +298,70 @@ bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, u
   }
 
   return usbd_edpt_xfer(rhport, p_hid->ep_in, p_epbuf->epin, len);
+  #endif
+}
+
+#if CFG_TUD_HID_SOF_SYNC
+bool tud_hid_n_sof_sync(uint8_t instance, bool enabled, uint16_t lead_us) {
+  TU_VERIFY(instance < CFG_TUD_HID);
+  hidd_interface_t *p_hid = &_hidd_itf[instance];
+  TU_VERIFY(p_hid->ep_in && p_hid->poll_interval);
+
+  if (enabled && !p_hid->sync_enabled) {
+    p_hid->sof_count = 0;
+  }
+  p_hid->sync_lead_us = lead_us;
+  p_hid->sync_enabled = enabled;
+
+  // SOF is needed as long as any instance on this port is synced
+  bool sof_en = false;
+  for (uint8_t i = 0; i < CFG_TUD_HID; i++) {
+    if (_hidd_itf[i].sync_enabled && _hidd_itf[i].rhport == p_hid->rhport) {
+      sof_en = true;
+    }
+  }
+  usbd_sof_enable(p_hid->rhport, SOF_CONSUMER_HID, sof_en);
+
+  return true;
 }
+#endif
+
+#if CFG_TUD_CONTROL_FAST
+bool tud_hid_n_get_report_fast(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                               void const* report, uint16_t len) {
+  TU_VERIFY(instance < CFG_TUD_HID);
+  hidd_interface_t const* p_hid = &_hidd_itf[instance];
+  TU_VERIFY(p_hid->ep_in);
+
+  tusb_control_request_t const request = {
+    .bmRequestType_bit = {
+      .recipient = TUSB_REQ_RCPT_INTERFACE,
+      .type      = TUSB_REQ_TYPE_CLASS,
+      .direction = TUSB_DIR_IN
+    },
+    .bRequest = HID_REQ_CONTROL_GET_REPORT,
+    .wValue   = tu_u16((uint8_t) report_type, report_id),
+    .wIndex   = p_hid->itf_num,
+    .wLength  = 0
+  };
+
+  if (report == NULL) {
+    usbd_control_fast_clear(p_hid->rhport, &request);
+    return true;
+  }
+
+  // same layout as control GET_REPORT response
+  uint8_t buf[CFG_TUD_CONTROL_FAST_SIZE];
+  uint16_t xferlen = 0;
+  if (report_id != HID_REPORT_TYPE_INVALID) {
+    buf[xferlen++] = report_id;
+  }
+  TU_VERIFY(0 == tu_memcpy_s(buf + xferlen, sizeof(buf) - xferlen, report, len));
+  xferlen = (uint16_t) (xferlen + len);
+
+  return usbd_control_fast_set(p_hid->rhport, &request, buf, xferlen);
+}
+#endif
 
 uint8_t tud_hid_n_interface_protocol(uint8_t instance) {
   return _hidd_itf[instance].itf_protocol;
@@ -163,7 +395,11 @@ bool tud_hid_n_mouse_report(uint8_t instance, uint8_t report_id,
     .pan = horizontal
   };
 
+  #if CFG_TUD_HID_REPORT_QUEUE_N
+  return hidd_report_queued(instance, report_id, &report, sizeof(report), HIDD_REPORT_KIND_MOUSE);
+  #else
   return tud_hid_n_report(instance, report_id, &report, sizeof(report));
+  #endif
 }
 
 bool tud_hid_n_abs_mouse_report(uint8_t instance, uint8_t report_id,
@@ -198,16 +434,40 @@ bool tud_hid_n_gamepad_report(uint8_t instance, uint8_t report_id,
 // USBD-CLASS API
 //--------------------------------------------------------------------+
 void hidd_init(void) {
+  #if CFG_TUD_HID_REPORT_QUEUE_N
+  tu_memclr(_hidd_queue, sizeof(_hidd_queue));
+  #if OSAL_MUTEX_REQUIRED
+  for (uint8_t i = 0; i < CFG_TUD_HID; i++) {
+    _hidd_queue[i].mutex = osal_mutex_create(&_hidd_queue[i].mutexdef);
+  }
+  #endif
+  #endif
+
   hidd_reset(0);
 }
 
 bool hidd_deinit(void) {
+  #if CFG_TUD_HID_REPORT_QUEUE_N && OSAL_MUTEX_REQUIRED
+  for (uint8_t i = 0; i < CFG_TUD_HID; i++) {
+    if (_hidd_queue[i].mutex) {
+      osal_mutex_delete(_hidd_queue[i].mutex);
+      _hidd_queue[i].mutex = NULL;
+    }
+  }
+  #endif
   return true;
 }
 
 void hidd_reset(uint8_t rhport) {
-  (void)rhport;
-  tu_memclr(_hidd_itf, sizeof(_hidd_itf));
+  for (uint8_t i = 0; i < CFG_TUD_HID; i++) {
+    if (CFG_TUD_RHPORT_NUM > 1 && _hidd_itf[i].ep_in && _hidd_itf[i].rhport != rhport) {
+      continue; // opened on other controller
+    }
+    tu_varclr(&_hidd_itf[i]);
+    #if CFG_TUD_HID_REPORT_QUEUE_N
+    tu_memclr(&_hidd_queue[i], offsetof(hidd_report_queue_t, mode));
+    #endif
+  }
 }
 
 uint16_t hidd_open(uint8_t rhport, tusb_desc_interface_t const *desc_itf, uint16_t max_len) {
@@ -236,10 +496,36 @@ uint16_t hidd_open(uint8_t rhport, tusb_desc_interface_t const *desc_itf, uint16
   p_desc = tu_desc_next(p_desc);
   TU_ASSERT(HID_DESC_TYPE_HID == tu_desc_type(p_desc), 0);
   p_hid->hid_descriptor = (tusb_hid_descriptor_hid_t const *)p_desc;
+  p_hid->rhport = rhport;
 
   //------------- Endpoint Descriptor -------------//
   p_desc = tu_desc_next(p_desc);
   TU_ASSERT(usbd_open_edpt_pair(rhport, p_desc, desc_itf->bNumEndpoints, TUSB_XFER_INTERRUPT, &p_hid->ep_out, &p_hid->ep_in), 0);
+  usbd_edpt_instance_set(rhport, p_hid->ep_in, hid_id);
+  if (p_hid->ep_out) {
+    usbd_edpt_instance_set(rhport, p_hid->ep_out, hid_id);
+  }
+
+#if CFG_TUD_HID_SOF_SYNC
+  // polling interval of IN endpoint in (micro)frames: 2^(bInterval-1) for high speed, bInterval ms otherwise
+  uint8_t const *p_ep = p_desc;
+  for (uint8_t i = 0; i < desc_itf->bNumEndpoints; i++) {
+    tusb_desc_endpoint_t const *desc_ep = (tusb_desc_endpoint_t const *) p_ep;
+    if (desc_ep->bEndpointAddress == p_hid->ep_in) {
+      uint8_t const interval = tu_max8(desc_ep->bInterval, 1);
+      p_hid->poll_interval = (tud_rhport_speed_get(rhport) == TUSB_SPEED_HIGH) ?
+                             (uint16_t) (1u << (tu_min8(interval, 16) - 1)) : interval;
+    }
+    p_ep = tu_desc_next(p_ep);
+  }
+#endif
+
+#if CFG_TUD_HID_ISR_CALLBACK
+  usbd_edpt_isr_callback(rhport, p_hid->ep_in, true);
+  if (p_hid->ep_out) {
+    usbd_edpt_isr_callback(rhport, p_hid->ep_out, true);
+  }
+#endif
 
   if (desc_itf->bInterfaceSubClass == HID_SUBCLASS_BOOT) {
     p_hid->itf_protocol = desc_itf->bInterfaceProtocol;
@@ -265,7 +551,7 @@ uint16_t hidd_open(uint8_t rhport, tusb_desc_interface_t const *desc_itf, uint16
 bool hidd_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request) {
   TU_VERIFY(request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_INTERFACE);
 
-  uint8_t const hid_itf = get_index_by_itfnum((uint8_t)request->wIndex);
+  uint8_t const hid_itf = get_index_by_itfnum(rhport, (uint8_t)request->wIndex);
   TU_VERIFY(hid_itf < CFG_TUD_HID);
   hidd_interface_t *p_hid = &_hidd_itf[hid_itf];
   hidd_epbuf_t *p_epbuf = &_hidd_epbuf[hid_itf];
@@ -374,26 +660,32 @@ bool hidd_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t
 }
 
 bool hidd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes) {
-  uint8_t instance;
-  hidd_interface_t *p_hid;
-
   // Identify which interface to use
-  for (instance = 0; instance < CFG_TUD_HID; instance++) {
-    p_hid = &_hidd_itf[instance];
-    if ((ep_addr == p_hid->ep_out) || (ep_addr == p_hid->ep_in)) {
-      break;
-    }
-  }
+  uint8_t const instance = usbd_edpt_instance(rhport, ep_addr);
   TU_ASSERT(instance < CFG_TUD_HID);
+  hidd_interface_t *p_hid = &_hidd_itf[instance];
   hidd_epbuf_t *p_epbuf = &_hidd_epbuf[instance];
 
   if (ep_addr == p_hid->ep_in) {
     // Input report
     if (XFER_RESULT_SUCCESS == result) {
+      #if CFG_TUD_HID_SOF_SYNC
+      // report is taken in a polled (micro)frame, track host polling phase. Without CFG_TUD_HID_ISR_CALLBACK it is
+      // off by the usbd task latency (if that crosses a SOF)
+      p_hid->poll_phase = p_hid->sof_count;
+      #endif
       tud_hid_report_complete_cb(instance, p_epbuf->epin, (uint16_t) xferred_bytes);
     } else {
       tud_hid_report_failed_cb(instance, HID_REPORT_TYPE_INPUT, p_epbuf->epin, (uint16_t) xferred_bytes);
     }
+
+    #if CFG_TUD_HID_REPORT_QUEUE_N
+    // re-arm with next queued report (if callback has not already sent one)
+    hidd_report_queue_t *q = &_hidd_queue[instance];
+    queue_lock(q);
+    queue_pump(instance);
+    queue_unlock(q);
+    #endif
   } else {
     // Output report
     if (XFER_RESULT_SUCCESS == result) {
@@ -409,4 +701,47 @@ bool hidd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_
   return true;
 }
 
+#if CFG_TUD_HID_SOF_SYNC
+#if !CFG_TUD_HID_ISR_CALLBACK
+// deferred from hidd_sof()
+static void hidd_report_due(void *param) {
+  uint8_t const instance = (uint8_t) (uintptr_t) param;
+  if (_hidd_itf[instance].sync_enabled) {
+    tud_hid_report_due_cb(instance, _hidd_itf[instance].sync_delay_us);
+  }
+}
+#endif
+
+// SOF handler in ISR context: invoke tud_hid_report_due_cb() ceil(lead_us/frame) (micro)frames before the polled one
+void hidd_sof(uint8_t rhport, uint32_t frame_count) {
+  (void) frame_count;
+
+  uint32_t const period_us = (tud_rhport_speed_get(rhport) == TUSB_SPEED_HIGH) ? 125 : 1000;
+
+  for (uint8_t i = 0; i < CFG_TUD_HID; i++) {
+    hidd_interface_t *p_hid = &_hidd_itf[i];
+    if (!p_hid->sync_enabled || p_hid->rhport != rhport) {
+      continue;
+    }
+
+    uint16_t const interval = p_hid->poll_interval;
+    p_hid->sof_count = (uint16_t) ((p_hid->sof_count + 1u) % interval);
+
+    uint32_t const lead_frames = tu_div_ceil(p_hid->sync_lead_us, period_us);
+    uint16_t const due = (uint16_t) ((p_hid->poll_phase + interval - (lead_frames % interval)) % interval);
+    if (p_hid->sof_count != due) {
+      continue;
+    }
+
+    uint16_t const delay_us = (uint16_t) (lead_frames * period_us - p_hid->sync_lead_us);
+    #if CFG_TUD_HID_ISR_CALLBACK
+    tud_hid_report_due_cb(i, delay_us);
+    #else
+    p_hid->sync_delay_us = delay_us;
+    usbd_defer_func(hidd_report_due, (void *) (uintptr_t) i, true);
+    #endif
+  }
+}
+#endif
+
 #endif
@@ -47,11 +47,40 @@
   #define CFG_TUD_HID_EP_BUFSIZE     64
 #endif
 
+// Handle interrupt endpoint completion directly in USB ISR instead of usbd task for lowest report latency.
+// tud_hid_report_complete_cb(), tud_hid_report_failed_cb() and tud_hid_set_report_cb() for OUT endpoint are then
+// invoked in ISR context and must not block.
+#ifndef CFG_TUD_HID_ISR_CALLBACK
+  #define CFG_TUD_HID_ISR_CALLBACK   0
+#endif
+
+// Number of input reports queued per instance while IN endpoint is busy, 0 disables the queue and
+// tud_hid_n_report() fails if endpoint is busy. Queue is pumped from transfer completion.
+#ifndef CFG_TUD_HID_REPORT_QUEUE_N
+  #define CFG_TUD_HID_REPORT_QUEUE_N 0
+#endif
+
+#if CFG_TUD_HID_REPORT_QUEUE_N && CFG_TUD_HID_ISR_CALLBACK
+  #error "CFG_TUD_HID_REPORT_QUEUE_N is not supported with CFG_TUD_HID_ISR_CALLBACK"
+#endif
+
+// SOF-aligned input: tud_hid_report_due_cb() is invoked a configurable time ahead of the (micro)frame in which host
+// polls the IN endpoint, so that application can sample its sensors as late as possible before submitting report.
+#ifndef CFG_TUD_HID_SOF_SYNC
+  #define CFG_TUD_HID_SOF_SYNC       0
+#endif
+
+typedef enum {
+  HID_REPORT_QUEUE_FIFO = 0, // every report is queued
+  HID_REPORT_QUEUE_COALESCE, // queued report with same ID is updated: mouse deltas are accumulated (if buttons
+                             // are unchanged), other reports are replaced by the latest state
+} hid_report_queue_mode_t;
+
 //--------------------------------------------------------------------+
 // Application API (Multiple Instances) i.e. CFG_TUD_HID > 1
 //--------------------------------------------------------------------+
 
-// Check if the interface is ready to use
+// Check if the interface is ready to use, also while suspended after tud_remote_wakeup() is called
 bool tud_hid_n_ready(uint8_t instance);
 
 // Get interface supported protocol (bInterfaceProtocol) check out hid_interface_protocol_enum_t for possible values
@@ -60,9 +89,32 @@ uint8_t tud_hid_n_interface_protocol(uint8_t instance);
 // Get current active protocol: HID_PROTOCOL_BOOT (0) or HID_PROTOCOL_REPORT (1)
 uint8_t tud_hid_n_get_protocol(uint8_t instance);
 
-// Send report to host
+// Send report to host. With CFG_TUD_HID_REPORT_QUEUE_N, report is queued if endpoint is busy
 bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const* report, uint16_t len);
 
+#if CFG_TUD_HID_REPORT_QUEUE_N
+// Set report queue mode, kept across bus reset
+bool tud_hid_n_report_queue_mode(uint8_t instance, hid_report_queue_mode_t mode);
+
+// Number of reports waiting in queue
+uint8_t tud_hid_n_report_queued(uint8_t instance);
+#endif
+
+#if CFG_TUD_HID_SOF_SYNC
+// Enable/disable tud_hid_report_due_cb() lead_us microseconds before the (micro)frame in which host polls IN endpoint.
+// Polling phase is learned from completed input reports, until the first one it is assumed to be frame 0 of interval.
+// Must be called from task context e.g in tud_mount_cb(), disabled by bus reset.
+bool tud_hid_n_sof_sync(uint8_t instance, bool enabled, uint16_t lead_us);
+#endif
+
+#if CFG_TUD_CONTROL_FAST
+// Set precomputed GET_REPORT response (Report ID is prepended if not zero) which is answered in ISR without invoking
+// tud_hid_get_report_cb(). NULL report removes it. Must be called from task context after mounted, cleared by bus
+// reset. Response is limited to CFG_TUD_CONTROL_FAST_SIZE bytes
+bool tud_hid_n_get_report_fast(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                               void const* report, uint16_t len);
+#endif
+
 // KEYBOARD: convenient helper to send keyboard report if application
 // use template layout report as defined by hid_keyboard_report_t
 bool tud_hid_n_keyboard_report(uint8_t instance, uint8_t report_id, uint8_t modifier, const uint8_t keycode[6]);
@@ -98,6 +150,19 @@ TU_ATTR_ALWAYS_INLINE static inline bool tud_hid_report(uint8_t report_id, void
   return tud_hid_n_report(0, report_id, report, len);
 }
 
+#if CFG_TUD_HID_SOF_SYNC
+TU_ATTR_ALWAYS_INLINE static inline bool tud_hid_sof_sync(bool enabled, uint16_t lead_us) {
+  return tud_hid_n_sof_sync(0, enabled, lead_us);
+}
+#endif
+
+#if CFG_TUD_CONTROL_FAST
+TU_ATTR_ALWAYS_INLINE static inline bool tud_hid_get_report_fast(uint8_t report_id, hid_report_type_t report_type,
+                                                                void const* report, uint16_t len) {
+  return tud_hid_n_get_report_fast(0, report_id, report_type, report, len);
+}
+#endif
+
 TU_ATTR_ALWAYS_INLINE static inline bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, const uint8_t keycode[6]) {
   return tud_hid_n_keyboard_report(0, report_id, modifier, keycode);
 }
@@ -148,6 +213,14 @@ void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_
 // Invoked when a transfer wasn't successful
 void tud_hid_report_failed_cb(uint8_t instance, hid_report_type_t report_type, uint8_t const* report, uint16_t xferred_bytes);
 
+#if CFG_TUD_HID_SOF_SYNC
+// Invoked (with CFG_TUD_HID_SOF_SYNC) at the SOF ceil(lead_us/frame) (micro)frames before host polls IN endpoint.
+// delay_us is the time from that SOF to the requested lead point, application with a timer can wait for it to sample
+// even later, or sample right away. Report is then sent with tud_hid_n_report().
+// Invoked in ISR context with CFG_TUD_HID_ISR_CALLBACK, otherwise deferred to usbd task.
+void tud_hid_report_due_cb(uint8_t instance, uint16_t delay_us);
+#endif
+
 /* --------------------------------------------------------------------+
  * HID Report Descriptor Template
  *
@@ -623,6 +696,7 @@ void     hidd_reset           (uint8_t rhport);
 uint16_t hidd_open            (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t max_len);
 bool     hidd_control_xfer_cb (uint8_t rhport, uint8_t stage, tusb_control_request_t const * request);
 bool     hidd_xfer_cb         (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void     hidd_sof             (uint8_t rhport, uint32_t frame_count);
 
 #ifdef __cplusplus
  }
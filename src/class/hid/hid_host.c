@@ -58,6 +58,10 @@ typedef struct {
 
   uint16_t epin_size;
   uint16_t epout_size;
+
+  #if CFG_TUH_HID_RX_RING_N
+  bool rx_auto;
+  #endif
 } hidh_interface_t;
 
 typedef struct {
@@ -68,6 +72,23 @@ typedef struct {
 static hidh_interface_t _hidh_itf[CFG_TUH_HID];
 CFG_TUH_MEM_SECTION static hidh_epbuf_t _hidh_epbuf[CFG_TUH_HID];
 
+#if CFG_TUH_HID_RX_RING_N
+TU_VERIFY_STATIC((CFG_TUH_HID_RX_RING_N & (CFG_TUH_HID_RX_RING_N - 1)) == 0 && CFG_TUH_HID_RX_RING_N <= 128,
+                 "CFG_TUH_HID_RX_RING_N must be power of 2 and not more than 128");
+
+// Received reports in auto receive mode. Single producer (usbh task in xfer_cb) advances wr,
+// single consumer (application) advances rd, both are free running.
+typedef struct {
+  volatile uint8_t wr;
+  volatile uint8_t rd;
+  uint16_t len[CFG_TUH_HID_RX_RING_N];
+  uint8_t data[CFG_TUH_HID_RX_RING_N][CFG_TUH_HID_EPIN_BUFSIZE];
+  uint32_t dropped;
+} hidh_rx_ring_t;
+
+static hidh_rx_ring_t _hidh_rx_ring[CFG_TUH_HID];
+#endif
+
 static uint8_t _hidh_default_protocol = HID_PROTOCOL_BOOT;
 
 //--------------------------------------------------------------------+
@@ -83,16 +104,9 @@ TU_ATTR_ALWAYS_INLINE static inline hidh_epbuf_t* get_hid_epbuf(uint8_t idx) {
   return &_hidh_epbuf[idx];
 }
 
-// Get instance ID by endpoint address
-static uint8_t get_idx_by_epaddr(uint8_t daddr, uint8_t ep_addr) {
-  for (uint8_t idx = 0; idx < CFG_TUH_HID; idx++) {
-    hidh_interface_t const* p_hid = &_hidh_itf[idx];
-    if (p_hid->daddr == daddr &&
-        (p_hid->ep_in == ep_addr || p_hid->ep_out == ep_addr)) {
-      return idx;
-    }
-  }
-  return TUSB_INDEX_INVALID_8;
+// Get instance ID by endpoint address, recorded when endpoint is opened
+TU_ATTR_ALWAYS_INLINE static inline uint8_t get_idx_by_epaddr(uint8_t daddr, uint8_t ep_addr) {
+  return usbh_edpt_instance(daddr, ep_addr);
 }
 
 static hidh_interface_t* find_new_itf(void) {
@@ -370,12 +384,96 @@ bool tuh_hid_receive_report(uint8_t daddr, uint8_t idx) {
 
   return true;
 }
+
 bool tuh_hid_receive_abort(uint8_t dev_addr, uint8_t idx) {
   hidh_interface_t* p_hid = get_hid_itf(dev_addr, idx);
   TU_VERIFY(p_hid);
+  #if CFG_TUH_HID_RX_RING_N
+  p_hid->rx_auto = false;
+  #endif
   return tuh_edpt_abort_xfer(dev_addr, p_hid->ep_in);
 }
 
+#if CFG_TUH_HID_RX_RING_N
+bool tuh_hid_receive_auto(uint8_t dev_addr, uint8_t idx, bool enabled) {
+  hidh_interface_t* p_hid = get_hid_itf(dev_addr, idx);
+  TU_VERIFY(p_hid && p_hid->mounted);
+
+  p_hid->rx_auto = enabled;
+  if (!enabled) return true;
+
+  // endpoint may already be armed by application
+  if (usbh_edpt_busy(dev_addr, p_hid->ep_in)) return true;
+  if (!tuh_hid_receive_report(dev_addr, idx)) {
+    p_hid->rx_auto = false;
+    return false;
+  }
+  return true;
+}
+
+uint8_t tuh_hid_receive_ring_count(uint8_t dev_addr, uint8_t idx) {
+  TU_VERIFY(get_hid_itf(dev_addr, idx), 0);
+  hidh_rx_ring_t const* ring = &_hidh_rx_ring[idx];
+  return (uint8_t) (ring->wr - ring->rd);
+}
+
+uint16_t tuh_hid_receive_ring_read(uint8_t dev_addr, uint8_t idx, void* buffer, uint16_t bufsize) {
+  TU_VERIFY(get_hid_itf(dev_addr, idx), 0);
+  hidh_rx_ring_t* ring = &_hidh_rx_ring[idx];
+
+  uint8_t const rd = ring->rd;
+  if (rd == ring->wr) return 0;
+
+  uint8_t const slot = rd & (CFG_TUH_HID_RX_RING_N - 1);
+  uint16_t const len = ring->len[slot];
+  memcpy(buffer, ring->data[slot], tu_min16(len, bufsize));
+  ring->rd = (uint8_t) (rd + 1);
+
+  return len;
+}
+
+uint32_t tuh_hid_receive_ring_dropped(uint8_t dev_addr, uint8_t idx, bool reset) {
+  TU_VERIFY(get_hid_itf(dev_addr, idx), 0);
+  hidh_rx_ring_t* ring = &_hidh_rx_ring[idx];
+  uint32_t const dropped = ring->dropped;
+  if (reset) ring->dropped = 0;
+  return dropped;
+}
+
+// Queue received report and re-arm endpoint, return false if auto receive is not enabled
+static bool rx_ring_received(hidh_interface_t* p_hid, uint8_t idx, xfer_result_t result, uint16_t len) {
+  if (!p_hid->rx_auto) return false;
+
+  uint8_t const daddr = p_hid->daddr;
+  hidh_rx_ring_t* ring = &_hidh_rx_ring[idx];
+  uint8_t count = (uint8_t) (ring->wr - ring->rd);
+
+  if (result == XFER_RESULT_SUCCESS) {
+    if (count < CFG_TUH_HID_RX_RING_N) {
+      uint8_t const slot = ring->wr & (CFG_TUH_HID_RX_RING_N - 1);
+      memcpy(ring->data[slot], get_hid_epbuf(idx)->epin, len);
+      ring->len[slot] = len;
+      ring->wr = (uint8_t) (ring->wr + 1);
+      count++;
+    } else {
+      ring->dropped++;
+    }
+  }
+
+  // re-arm before notifying so that next report is received while application processes this one
+  if (result == XFER_RESULT_STALLED || !tuh_hid_receive_report(daddr, idx)) {
+    TU_LOG_DRV("  HID auto receive stopped (%u, %u)\r\n", daddr, idx);
+    p_hid->rx_auto = false;
+  }
+
+  if (result == XFER_RESULT_SUCCESS && tuh_hid_receive_ring_cb) {
+    tuh_hid_receive_ring_cb(daddr, idx, count);
+  }
+
+  return true;
+}
+#endif
+
 bool tuh_hid_send_ready(uint8_t dev_addr, uint8_t idx) {
   hidh_interface_t* p_hid = get_hid_itf(dev_addr, idx);
   TU_VERIFY(p_hid);
@@ -426,6 +524,9 @@ bool tuh_hid_send_report(uint8_t daddr, uint8_t idx, uint8_t report_id, const vo
 bool hidh_init(void) {
   TU_LOG_DRV("sizeof(hidh_interface_t) = %u\r\n", sizeof(hidh_interface_t));
   tu_memclr(_hidh_itf, sizeof(_hidh_itf));
+  #if CFG_TUH_HID_RX_RING_N
+  tu_memclr(_hidh_rx_ring, sizeof(_hidh_rx_ring));
+  #endif
   return true;
 }
 
@@ -446,6 +547,9 @@ bool hidh_xfer_cb(uint8_t daddr, uint8_t ep_addr, xfer_result_t result, uint32_t
   if (dir == TUSB_DIR_IN) {
     TU_LOG_DRV("  Get Report callback (%u, %u)\r\n", daddr, idx);
     TU_LOG3_MEM(epbuf->epin, xferred_bytes, 2);
+    #if CFG_TUH_HID_RX_RING_N
+    if (rx_ring_received(p_hid, idx, result, (uint16_t) xferred_bytes)) return true;
+    #endif
     tuh_hid_report_received_cb(daddr, idx, epbuf->epin, (uint16_t) xferred_bytes);
   } else {
     if (tuh_hid_report_sent_cb) {
@@ -463,6 +567,9 @@ void hidh_close(uint8_t daddr) {
       TU_LOG_DRV("  HIDh close addr = %u index = %u\r\n", daddr, i);
       if (tuh_hid_umount_cb) tuh_hid_umount_cb(daddr, i);
       tu_memclr(p_hid, sizeof(hidh_interface_t));
+      #if CFG_TUH_HID_RX_RING_N
+      tu_memclr(&_hidh_rx_ring[i], sizeof(hidh_rx_ring_t));
+      #endif
     }
   }
 }
@@ -500,6 +607,7 @@ bool hidh_open(uint8_t rhport, uint8_t daddr, tusb_desc_interface_t const* desc_
   for (int i = 0; i < desc_itf->bNumEndpoints; i++) {
     TU_ASSERT(TUSB_DESC_ENDPOINT == desc_ep->bDescriptorType);
     TU_ASSERT(tuh_edpt_open(daddr, desc_ep));
+    usbh_edpt_instance_set(daddr, desc_ep->bEndpointAddress, (uint8_t) (p_hid - _hidh_itf));
 
     if (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN) {
       p_hid->ep_in = desc_ep->bEndpointAddress;
@@ -761,4 +869,279 @@ uint8_t tuh_hid_parse_report_descriptor(tuh_hid_report_info_t* report_info_arr,
   return report_num;
 }
 
+//--------------------------------------------------------------------+
+// Report Field Compiler
+//--------------------------------------------------------------------+
+
+enum {
+  HID_FIELD_USAGE_MAX  = 16, // local usages buffered per main item
+  HID_FIELD_STACK_MAX  = 2,  // push/pop depth
+  HID_FIELD_OFFSET_MAX = 16, // number of (report id, type) tracked for bit offset
+};
+
+typedef struct {
+  uint16_t usage_page;
+  uint8_t  report_id;
+  uint8_t  report_size;
+  uint16_t report_count;
+  int32_t  logical_min;
+  int32_t  logical_max;
+} hidh_field_global_t;
+
+typedef struct {
+  uint8_t  report_id;
+  uint8_t  report_type;
+  uint16_t bit_count;
+} hidh_field_offset_t;
+
+static uint32_t item_data_u32(uint8_t const* data, uint8_t size) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < size; i++) {
+    value |= ((uint32_t) data[i]) << (8 * i);
+  }
+  return value;
+}
+
+static int32_t item_data_i32(uint8_t const* data, uint8_t size) {
+  uint32_t const value = item_data_u32(data, size);
+  if (size == 0 || size == 4) return (int32_t) value;
+  uint32_t const sign = 1u << (8 * size - 1);
+  return (int32_t) ((value ^ sign) - sign);
+}
+
+static uint16_t* field_offset_get(hidh_field_offset_t* offset_arr, uint8_t* offset_num, uint8_t report_id, uint8_t report_type) {
+  for (uint8_t i = 0; i < *offset_num; i++) {
+    if (offset_arr[i].report_id == report_id && offset_arr[i].report_type == report_type) {
+      return &offset_arr[i].bit_count;
+    }
+  }
+
+  TU_VERIFY(*offset_num < HID_FIELD_OFFSET_MAX, NULL);
+  hidh_field_offset_t* entry = &offset_arr[(*offset_num)++];
+  entry->report_id = report_id;
+  entry->report_type = report_type;
+  entry->bit_count = 0;
+  return &entry->bit_count;
+}
+
+uint16_t tuh_hid_parse_report_fields(tuh_hid_report_field_t* field_arr, uint16_t arr_count,
+                                     uint8_t const* desc_report, uint16_t desc_len) {
+  hidh_field_global_t global;
+  hidh_field_global_t stack[HID_FIELD_STACK_MAX];
+  uint8_t stack_depth = 0;
+
+  hidh_field_offset_t offset_arr[HID_FIELD_OFFSET_MAX];
+  uint8_t offset_num = 0;
+
+  // local items, cleared after each main item
+  uint32_t usages[HID_FIELD_USAGE_MAX];
+  uint8_t usage_num = 0;
+  uint32_t usage_min = 0, usage_max = 0;
+  bool has_usage_min = false, has_usage_max = false;
+
+  uint16_t field_num = 0;
+
+  tu_memclr(&global, sizeof(global));
+  tu_memclr(field_arr, arr_count * sizeof(tuh_hid_report_field_t));
+
+  while (desc_len) {
+    uint8_t const header = *desc_report++;
+    desc_len--;
+
+    // long item: bDataSize, bLongItemTag followed by data, not defined by HID 1.11 so just skip
+    if (header == 0xFE) {
+      TU_VERIFY(desc_len >= 2, field_num);
+      uint16_t const long_len = (uint16_t) (2u + desc_report[0]);
+      TU_VERIFY(desc_len >= long_len, field_num);
+      desc_report += long_len;
+      desc_len -= long_len;
+      continue;
+    }
+
+    uint8_t const size = (header & 0x03) == 3 ? 4 : (header & 0x03);
+    uint8_t const type = (header >> 2) & 0x03;
+    uint8_t const tag = header >> 4;
+    TU_VERIFY(desc_len >= size, field_num);
+
+    uint32_t const data = item_data_u32(desc_report, size);
+
+    switch (type) {
+      case RI_TYPE_MAIN: {
+        uint8_t report_type = HID_REPORT_TYPE_INVALID;
+        switch (tag) {
+          case RI_MAIN_INPUT: report_type = HID_REPORT_TYPE_INPUT; break;
+          case RI_MAIN_OUTPUT: report_type = HID_REPORT_TYPE_OUTPUT; break;
+          case RI_MAIN_FEATURE: report_type = HID_REPORT_TYPE_FEATURE; break;
+          default: break; // collection & end collection only consume local items
+        }
+
+        if (report_type != HID_REPORT_TYPE_INVALID) {
+          uint16_t* bit_count = field_offset_get(offset_arr, &offset_num, global.report_id, report_type);
+          TU_VERIFY(bit_count != NULL, field_num);
+
+          uint8_t const flags = (uint8_t) data;
+          uint16_t const bit_offset = *bit_count;
+          *bit_count = (uint16_t) (*bit_count + global.report_size * global.report_count);
+
+          // padding, no usage or element wider than extractor supports
+          bool const skip = (flags & HID_CONSTANT) || global.report_size == 0 || global.report_size > 32 ||
+                            global.report_count == 0 || (usage_num == 0 && !has_usage_min);
+
+          if (!skip) {
+            tuh_hid_report_field_t field;
+            field.report_id = global.report_id;
+            field.report_type = report_type;
+            field.flags = flags;
+            field.bit_size = global.report_size;
+            field.usage_page = global.usage_page;
+            field.logical_min = global.logical_min;
+            field.logical_max = global.logical_max;
+
+            // logical maximum must have been unsigned if it's less than non-negative minimum e.g 0x00-0xFF in 1 byte
+            if (field.logical_min >= 0 && field.logical_max < field.logical_min && global.report_size < 32) {
+              field.logical_max = (int32_t) (((uint32_t) field.logical_max) & ((1u << global.report_size) - 1));
+            }
+
+            if ((flags & HID_VARIABLE) && usage_num > 0) {
+              // one field per usage, last usage applies to the rest of elements
+              uint16_t elem = 0;
+              for (uint8_t i = 0; i < usage_num && elem < global.report_count && field_num < arr_count; i++) {
+                uint16_t const remain = (uint16_t) (global.report_count - elem);
+                field.bit_offset = (uint16_t) (bit_offset + elem * global.report_size);
+                field.count = (i == usage_num - 1) ? remain : 1;
+                if (usages[i] >> 16) field.usage_page = (uint16_t) (usages[i] >> 16);
+                field.usage_min = field.usage_max = (uint16_t) usages[i];
+                field_arr[field_num++] = field;
+                field.usage_page = global.usage_page;
+                elem = (uint16_t) (elem + field.count);
+              }
+            } else if (field_num < arr_count) {
+              uint32_t const first = has_usage_min ? usage_min : usages[0];
+              uint32_t const last = has_usage_max ? usage_max : (has_usage_min ? usage_min : usages[usage_num - 1]);
+              field.bit_offset = bit_offset;
+              field.count = global.report_count;
+              if (first >> 16) field.usage_page = (uint16_t) (first >> 16);
+              field.usage_min = (uint16_t) first;
+              field.usage_max = (uint16_t) last;
+              field_arr[field_num++] = field;
+            }
+          }
+        }
+
+        usage_num = 0;
+        has_usage_min = has_usage_max = false;
+        break;
+      }
+
+      case RI_TYPE_GLOBAL:
+        switch (tag) {
+          case RI_GLOBAL_USAGE_PAGE: global.usage_page = (uint16_t) data; break;
+          case RI_GLOBAL_LOGICAL_MIN: global.logical_min = item_data_i32(desc_report, size); break;
+          case RI_GLOBAL_LOGICAL_MAX: global.logical_max = item_data_i32(desc_report, size); break;
+          case RI_GLOBAL_REPORT_ID: global.report_id = (uint8_t) data; break;
+          case RI_GLOBAL_REPORT_SIZE: global.report_size = (uint8_t) tu_min32(data, 0xff); break;
+          case RI_GLOBAL_REPORT_COUNT: global.report_count = (uint16_t) tu_min32(data, 0xffff); break;
+
+          case RI_GLOBAL_PUSH:
+            TU_VERIFY(stack_depth < HID_FIELD_STACK_MAX, field_num);
+            stack[stack_depth++] = global;
+            break;
+
+          case RI_GLOBAL_POP:
+            TU_VERIFY(stack_depth > 0, field_num);
+            global = stack[--stack_depth];
+            break;
+
+          default: break;
+        }
+        break;
+
+      case RI_TYPE_LOCAL:
+        switch (tag) {
+          case RI_LOCAL_USAGE:
+            // extended usage (4 bytes) has usage page in high word
+            if (usage_num < HID_FIELD_USAGE_MAX) {
+              usages[usage_num++] = data;
+            }
+            break;
+
+          case RI_LOCAL_USAGE_MIN:
+            usage_min = data;
+            has_usage_min = true;
+            break;
+
+          case RI_LOCAL_USAGE_MAX:
+            usage_max = data;
+            has_usage_max = true;
+            break;
+
+          default: break;
+        }
+        break;
+
+      default: break;
+    }
+
+    desc_report += size;
+    desc_len -= size;
+  }
+
+  for (uint16_t i = 0; i < field_num; i++) {
+    tuh_hid_report_field_t const* f = &field_arr[i];
+    TU_LOG_DRV("%u: id = %u, type = %u, offset = %u, size = %u x %u, usage = %04X:%04X-%04X\r\n", i,
+               f->report_id, f->report_type, f->bit_offset, f->bit_size, f->count, f->usage_page, f->usage_min, f->usage_max);
+    (void) f;
+  }
+
+  return field_num;
+}
+
+tuh_hid_report_field_t const* tuh_hid_field_find(tuh_hid_report_field_t const* field_arr, uint16_t field_count,
+                                                 uint8_t report_type, uint16_t usage_page, uint16_t usage) {
+  for (uint16_t i = 0; i < field_count; i++) {
+    tuh_hid_report_field_t const* f = &field_arr[i];
+    if (f->report_type == report_type && f->usage_page == usage_page &&
+        f->usage_min <= usage && usage <= f->usage_max) {
+      return f;
+    }
+  }
+  return NULL;
+}
+
+uint32_t tuh_hid_field_get_raw(tuh_hid_report_field_t const* field, uint16_t idx, uint8_t const* report, uint16_t len) {
+  if (field->report_id) {
+    TU_VERIFY(len > 0, 0);
+    report++;
+    len--;
+  }
+
+  uint8_t const bit_size = field->bit_size;
+  uint32_t const bit_pos = field->bit_offset + (uint32_t) idx * bit_size;
+  TU_VERIFY(idx < field->count && bit_pos + bit_size <= 8u * len, 0);
+
+  uint8_t const* p = report + (bit_pos >> 3);
+  uint8_t const shift = (uint8_t) (bit_pos & 7);
+  uint8_t const nbytes = (uint8_t) ((shift + bit_size + 7) >> 3);
+
+  // at most 5 bytes: 32-bit element that is not byte-aligned
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < nbytes && i < 4; i++) {
+    value |= ((uint32_t) p[i]) << (8 * i);
+  }
+  value >>= shift;
+  if (nbytes > 4) {
+    value |= ((uint32_t) p[4]) << (32 - shift);
+  }
+
+  return (bit_size < 32) ? (value & ((1u << bit_size) - 1)) : value;
+}
+
+int32_t tuh_hid_field_get(tuh_hid_report_field_t const* field, uint16_t idx, uint8_t const* report, uint16_t len) {
+  uint32_t const value = tuh_hid_field_get_raw(field, idx, report, len);
+  if (field->logical_min >= 0 || field->bit_size >= 32) return (int32_t) value;
+
+  uint32_t const sign = 1u << (field->bit_size - 1);
+  return (int32_t) ((value ^ sign) - sign);
+}
+
 #endif
@@ -46,6 +46,12 @@ extern "C" {
 #define CFG_TUH_HID_EPOUT_BUFSIZE 64
 #endif
 
+// Number of input reports buffered per interface when auto receive is enabled with
+// tuh_hid_receive_auto(). Must be power of 2, 0 to disable auto receive support.
+#ifndef CFG_TUH_HID_RX_RING_N
+#define CFG_TUH_HID_RX_RING_N 0
+#endif
+
 
 typedef struct {
   uint8_t report_id;
@@ -57,6 +63,24 @@ typedef struct {
 //  uint8_t out_len;     // length of OUT report
 } tuh_hid_report_info_t;
 
+// Field of a report, compiled from report descriptor by tuh_hid_parse_report_fields().
+// A Variable main item with explicit usages is split into one field per usage, so that
+// e.g X/Y/Wheel of a joystick can be looked up directly. Array and usage range items are
+// kept as a single field with count elements.
+typedef struct {
+  uint8_t  report_id;   // 0 if descriptor does not use report ID
+  uint8_t  report_type; // hid_report_type_t
+  uint8_t  flags;       // data bits of main item e.g HID_VARIABLE, HID_RELATIVE
+  uint8_t  bit_size;    // size of each element in bits (1-32)
+  uint16_t bit_offset;  // offset of 1st element in bits, not counting report ID byte
+  uint16_t count;       // number of elements
+  uint16_t usage_page;
+  uint16_t usage_min;   // usage of 1st element (variable) or usage range (array)
+  uint16_t usage_max;
+  int32_t  logical_min;
+  int32_t  logical_max;
+} tuh_hid_report_field_t;
+
 //--------------------------------------------------------------------+
 // Interface API
 //--------------------------------------------------------------------+
@@ -88,6 +112,24 @@ bool tuh_hid_mounted(uint8_t dev_addr, uint8_t idx);
 TU_ATTR_UNUSED uint8_t tuh_hid_parse_report_descriptor(tuh_hid_report_info_t* reports_info_arr, uint8_t arr_count,
                                                        uint8_t const* desc_report, uint16_t desc_len);
 
+// Compile report descriptor into an array of fields (input, output and feature) and return number of fields.
+// Intended to be called once in tuh_hid_mount_cb(), reports can then be decoded with tuh_hid_field_get()
+// without walking the descriptor again. Constant (padding) items are not listed.
+uint16_t tuh_hid_parse_report_fields(tuh_hid_report_field_t* field_arr, uint16_t arr_count,
+                                     uint8_t const* desc_report, uint16_t desc_len);
+
+// Find field of specified report type that contains usage (page, usage), return NULL if not found
+tuh_hid_report_field_t const* tuh_hid_field_find(tuh_hid_report_field_t const* field_arr, uint16_t field_count,
+                                                 uint8_t report_type, uint16_t usage_page, uint16_t usage);
+
+// Extract element idx of field from report as received by tuh_hid_report_received_cb() i.e including
+// report ID byte if field has one. Caller should check report ID (1st byte) matches field->report_id.
+// Return 0 if element is out of report.
+uint32_t tuh_hid_field_get_raw(tuh_hid_report_field_t const* field, uint16_t idx, uint8_t const* report, uint16_t len);
+
+// Same as tuh_hid_field_get_raw() but value is sign-extended when logical minimum is negative
+int32_t tuh_hid_field_get(tuh_hid_report_field_t const* field, uint16_t idx, uint8_t const* report, uint16_t len);
+
 //--------------------------------------------------------------------+
 // Control Endpoint API
 //--------------------------------------------------------------------+
@@ -129,6 +171,24 @@ bool tuh_hid_receive_report(uint8_t dev_addr, uint8_t idx);
 // Abort receiving report on Interrupt Endpoint
 bool tuh_hid_receive_abort(uint8_t dev_addr, uint8_t idx);
 
+#if CFG_TUH_HID_RX_RING_N
+// Enable/disable auto receive. When enabled, driver re-arms the interrupt IN endpoint as soon as a report
+// is received and queues reports into a per-interface ring of CFG_TUH_HID_RX_RING_N entries instead of
+// invoking tuh_hid_report_received_cb(). Application drains the ring with tuh_hid_receive_ring_read().
+// Reports arriving while the ring is full are dropped and counted. Auto receive is stopped on stall.
+bool tuh_hid_receive_auto(uint8_t dev_addr, uint8_t idx, bool enabled);
+
+// Number of reports in receive ring
+uint8_t tuh_hid_receive_ring_count(uint8_t dev_addr, uint8_t idx);
+
+// Pop the oldest report from receive ring, report is truncated to bufsize.
+// Return length of report (including report ID byte if any), 0 if ring is empty
+uint16_t tuh_hid_receive_ring_read(uint8_t dev_addr, uint8_t idx, void* buffer, uint16_t bufsize);
+
+// Number of reports dropped because receive ring was full, optionally reset the counter
+uint32_t tuh_hid_receive_ring_dropped(uint8_t dev_addr, uint8_t idx, bool reset);
+#endif
+
 // Check if HID interface is ready to send report
 bool tuh_hid_send_ready(uint8_t dev_addr, uint8_t idx);
 
@@ -154,6 +214,10 @@ TU_ATTR_WEAK void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t idx);
 // Note: if there is report ID (composite), it is 1st byte of report
 void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t idx, uint8_t const* report, uint16_t len);
 
+// Invoked when a report is queued into receive ring in auto receive mode, count is number of reports in ring.
+// Application can drain the ring here or later e.g once per main loop for all interfaces.
+TU_ATTR_WEAK void tuh_hid_receive_ring_cb(uint8_t dev_addr, uint8_t idx, uint8_t count);
+
 // Invoked when sent report to device successfully via interrupt endpoint
 TU_ATTR_WEAK void tuh_hid_report_sent_cb(uint8_t dev_addr, uint8_t idx, uint8_t const* report, uint16_t len);
 
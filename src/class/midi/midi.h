@@ -52,9 +52,71 @@ typedef enum
 
 typedef enum
 {
-  MIDI_CS_ENDPOINT_GENERAL = 0x01
+  MIDI_CS_ENDPOINT_GENERAL     = 0x01,
+  MIDI_CS_ENDPOINT_GENERAL_2_0 = 0x02, // USB MIDI 2.0 endpoint with associated group terminal blocks
 } midi_cs_endpoint_subtype_t;
 
+//------------- USB MIDI 2.0 -------------//
+
+// Group Terminal Block descriptors are requested by GET_DESCRIPTOR (interface recipient) with wValue's high byte
+// as descriptor type and low byte as alternate setting (1)
+enum
+{
+  MIDI_DESC_TYPE_CS_GR_TRM_BLOCK = 0x26
+};
+
+typedef enum
+{
+  MIDI_GR_TRM_BLOCK_HEADER = 0x01,
+  MIDI_GR_TRM_BLOCK        = 0x02
+} midi_gr_trm_block_subtype_t;
+
+typedef enum
+{
+  MIDI_GR_TRM_BLOCK_TYPE_BIDIRECTIONAL = 0x00,
+  MIDI_GR_TRM_BLOCK_TYPE_IN_ONLY       = 0x01,
+  MIDI_GR_TRM_BLOCK_TYPE_OUT_ONLY      = 0x02
+} midi_gr_trm_block_type_t;
+
+typedef enum
+{
+  MIDI_GR_TRM_PROTOCOL_UNKNOWN       = 0x00, // unknown, or use MIDI-CI
+  MIDI_GR_TRM_PROTOCOL_MIDI_1_0_64   = 0x01, // MIDI 1.0, up to 64 bits UMP
+  MIDI_GR_TRM_PROTOCOL_MIDI_1_0_128  = 0x03, // MIDI 1.0, up to 128 bits UMP
+  MIDI_GR_TRM_PROTOCOL_MIDI_2_0      = 0x11,
+  MIDI_GR_TRM_PROTOCOL_MIDI_2_0_JRTS = 0x12, // MIDI 2.0 with jitter reduction timestamps
+} midi_gr_trm_protocol_t;
+
+// Universal MIDI Packet message type, upper 4 bits of the first 32-bit word
+typedef enum
+{
+  MIDI_UMP_MT_UTILITY     = 0x0,
+  MIDI_UMP_MT_SYSTEM      = 0x1,
+  MIDI_UMP_MT_MIDI1_VOICE = 0x2, // MIDI 1.0 channel voice
+  MIDI_UMP_MT_DATA_64     = 0x3, // SysEx7
+  MIDI_UMP_MT_MIDI2_VOICE = 0x4, // MIDI 2.0 channel voice
+  MIDI_UMP_MT_DATA_128    = 0x5, // SysEx8 and mixed data set
+  MIDI_UMP_MT_FLEX_DATA   = 0xD,
+  MIDI_UMP_MT_STREAM      = 0xF,
+} midi_ump_message_type_t;
+
+// Number of 32-bit words of an UMP from its first word, also defined for reserved message types
+TU_ATTR_ALWAYS_INLINE static inline uint8_t midi_ump_word_count(uint32_t word0) {
+  switch (word0 >> 28) {
+    case 0x0: case 0x1: case 0x2: case 0x6: case 0x7:
+      return 1;
+
+    case 0x3: case 0x4: case 0x8: case 0x9: case 0xA:
+      return 2;
+
+    case 0xB: case 0xC:
+      return 3;
+
+    default:
+      return 4;
+  }
+}
+
 typedef enum
 {
   MIDI_JACK_EMBEDDED = 0x01,
@@ -201,6 +263,34 @@ typedef struct TU_ATTR_PACKED
     uint8_t  iElement;          \
  }
 
+/// MIDI 2.0 Group Terminal Block Header Descriptor
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  bLength;            ///< Size of this descriptor in bytes: 5
+  uint8_t  bDescriptorType;    ///< MIDI_DESC_TYPE_CS_GR_TRM_BLOCK
+  uint8_t  bDescriptorSubType; ///< MIDI_GR_TRM_BLOCK_HEADER
+  uint16_t wTotalLength;       ///< Header and all following Group Terminal Block descriptors
+} midi_desc_gr_trm_block_header_t;
+
+/// MIDI 2.0 Group Terminal Block Descriptor
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  bLength;            ///< Size of this descriptor in bytes: 13
+  uint8_t  bDescriptorType;    ///< MIDI_DESC_TYPE_CS_GR_TRM_BLOCK
+  uint8_t  bDescriptorSubType; ///< MIDI_GR_TRM_BLOCK
+  uint8_t  bGrpTrmBlkID;       ///< Referenced by class specific endpoint descriptor
+  uint8_t  bGrpTrmBlkType;     ///< midi_gr_trm_block_type_t
+  uint8_t  nGroupTrm;          ///< First group (0-based)
+  uint8_t  nNumGroupTrm;       ///< Number of groups
+  uint8_t  iBlockItem;         ///< string descriptor
+  uint8_t  bMIDIProtocol;      ///< midi_gr_trm_protocol_t
+  uint16_t wMaxInputBandwidth; ///< 4KB/s unit, 0 is unknown
+  uint16_t wMaxOutputBandwidth;
+} midi_desc_gr_trm_block_t;
+
+TU_VERIFY_STATIC(sizeof(midi_desc_gr_trm_block_header_t) == 5, "size is not correct");
+TU_VERIFY_STATIC(sizeof(midi_desc_gr_trm_block_t) == 13, "size is not correct");
+
 /** @} */
 
 #ifdef __cplusplus
@@ -46,10 +46,14 @@ typedef struct {
   uint8_t total;
 } midid_stream_t;
 
+// Event packets are 4 bytes, fifo must hold whole packets so that they are never split at wrap around
+TU_VERIFY_STATIC((CFG_TUD_MIDI_RX_BUFSIZE % 4) == 0 && (CFG_TUD_MIDI_TX_BUFSIZE % 4) == 0,
+                 "CFG_TUD_MIDI_RX_BUFSIZE and CFG_TUD_MIDI_TX_BUFSIZE must be multiple of 4");
+
 typedef struct {
   uint8_t itf_num;
-  uint8_t ep_in;
-  uint8_t ep_out;
+  uint8_t alt;          // current alternate setting of MIDI streaming interface, 1 is UMP
+  bool ump_capable;     // MIDI streaming interface has alternate setting 1 (USB MIDI 2.0)
 
   // For Stream read()/write() API
   // Messages are always 4 bytes long, queue them for reading and writing so the
@@ -58,19 +62,17 @@ typedef struct {
   midid_stream_t stream_read;
 
   /*------------- From this point, data is not cleared by bus reset -------------*/
-  // FIFO
-  tu_fifo_t rx_ff;
-  tu_fifo_t tx_ff;
-  uint8_t rx_ff_buf[CFG_TUD_MIDI_RX_BUFSIZE];
-  uint8_t tx_ff_buf[CFG_TUD_MIDI_TX_BUFSIZE];
-
-  #if CFG_FIFO_MUTEX
-  osal_mutex_def_t rx_ff_mutex;
-  osal_mutex_def_t tx_ff_mutex;
-  #endif
+  // Endpoint stream with FIFO
+  struct {
+    tu_edpt_stream_t rx;
+    tu_edpt_stream_t tx;
+
+    uint8_t rx_ff_buf[CFG_TUD_MIDI_RX_BUFSIZE];
+    uint8_t tx_ff_buf[CFG_TUD_MIDI_TX_BUFSIZE];
+  } ep_stream;
 } midid_interface_t;
 
-#define ITF_MEM_RESET_SIZE   offsetof(midid_interface_t, rx_ff)
+#define ITF_MEM_RESET_SIZE   offsetof(midid_interface_t, ep_stream)
 
 // Endpoint Transfer buffer
 CFG_TUD_MEM_SECTION static struct {
@@ -85,33 +87,7 @@ static midid_interface_t _midid_itf[CFG_TUD_MIDI];
 
 bool tud_midi_n_mounted (uint8_t itf) {
   midid_interface_t* midi = &_midid_itf[itf];
-  return midi->ep_in && midi->ep_out;
-}
-
-static void _prep_out_transaction(uint8_t idx) {
-  const uint8_t rhport = 0;
-  midid_interface_t* p_midi = &_midid_itf[idx];
-  uint16_t available = tu_fifo_remaining(&p_midi->rx_ff);
-
-  // Prepare for incoming data but only allow what we can store in the ring buffer.
-  // TODO Actually we can still carry out the transfer, keeping count of received bytes
-  // and slowly move it to the FIFO when read().
-  // This pre-check reduces endpoint claiming
-  TU_VERIFY(available >= CFG_TUD_MIDI_EP_BUFSIZE, );
-
-  // claim endpoint
-  TU_VERIFY(usbd_edpt_claim(rhport, p_midi->ep_out), );
-
-  // fifo can be changed before endpoint is claimed
-  available = tu_fifo_remaining(&p_midi->rx_ff);
-
-  if ( available >= CFG_TUD_MIDI_EP_BUFSIZE )  {
-    usbd_edpt_xfer(rhport, p_midi->ep_out, _midid_epbuf[idx].epout, CFG_TUD_MIDI_EP_BUFSIZE);
-  }else
-  {
-    // Release endpoint since we don't make any transfer
-    usbd_edpt_release(rhport, p_midi->ep_out);
-  }
+  return midi->ep_stream.rx.ep_addr && midi->ep_stream.tx.ep_addr;
 }
 
 //--------------------------------------------------------------------+
@@ -125,7 +101,7 @@ uint32_t tud_midi_n_available(uint8_t itf, uint8_t cable_num)
   const midid_stream_t* stream = &midi->stream_read;
 
   // when using with packet API stream total & index are both zero
-  return tu_fifo_count(&midi->rx_ff) + (uint8_t) (stream->total - stream->index);
+  return tu_edpt_stream_read_available(&midi->ep_stream.rx) + (uint8_t) (stream->total - stream->index);
 }
 
 uint32_t tud_midi_n_stream_read(uint8_t itf, uint8_t cable_num, void* buffer, uint32_t bufsize)
@@ -201,11 +177,33 @@ uint32_t tud_midi_n_stream_read(uint8_t itf, uint8_t cable_num, void* buffer, ui
 bool tud_midi_n_packet_read (uint8_t itf, uint8_t packet[4])
 {
   midid_interface_t* midi = &_midid_itf[itf];
-  TU_VERIFY(midi->ep_out);
+  TU_VERIFY(midi->ep_stream.rx.ep_addr);
+
+  const uint8_t rhport = 0;
+  return 4 == tu_edpt_stream_read(rhport, &midi->ep_stream.rx, packet, 4);
+}
+
+uint32_t tud_midi_n_packet_peek_n(uint8_t itf, uint8_t const** packets)
+{
+  midid_interface_t* midi = &_midid_itf[itf];
+  TU_VERIFY(midi->ep_stream.rx.ep_addr, 0);
+
+  // packets are never split at wrap around since fifo depth is multiple of 4
+  tu_fifo_buffer_info_t info;
+  tu_fifo_get_read_info(&midi->ep_stream.rx.ff, &info);
+  *packets = (uint8_t const*) info.ptr_lin;
+
+  return info.len_lin / 4;
+}
+
+void tud_midi_n_packet_consume(uint8_t itf, uint32_t count)
+{
+  midid_interface_t* midi = &_midid_itf[itf];
+  TU_VERIFY(midi->ep_stream.rx.ep_addr, );
 
-  const uint32_t num_read = tu_fifo_read_n(&midi->rx_ff, packet, 4);
-  _prep_out_transaction(itf);
-  return (num_read == 4);
+  const uint8_t rhport = 0;
+  tu_fifo_advance_read_pointer(&midi->ep_stream.rx.ff, (uint16_t) (count * 4));
+  tu_edpt_stream_read_xfer(rhport, &midi->ep_stream.rx);
 }
 
 //--------------------------------------------------------------------+
@@ -213,39 +211,72 @@ bool tud_midi_n_packet_read (uint8_t itf, uint8_t packet[4])
 //--------------------------------------------------------------------+
 
 static uint32_t write_flush(uint8_t idx) {
-  midid_interface_t* midi = &_midid_itf[idx];
+  const uint8_t rhport = 0;
+  return tu_edpt_stream_write_xfer(rhport, &_midid_itf[idx].ep_stream.tx);
+}
 
-  if (!tu_fifo_count(&midi->tx_ff)) {
-    return 0; // No data to send
-  }
+// Fast path for on-going SysEx: pack data bytes 3 at a time directly into tx fifo (which is also the endpoint buffer
+// with zero-copy). Stop at any status byte or when less than 3 bytes left, those are handled by the byte parser.
+// Return number of consumed bytes
+static uint32_t sysex_write_fast(midid_interface_t* midi, const uint8_t* buffer, uint32_t bufsize) {
+  tu_fifo_t* ff = &midi->ep_stream.tx.ff;
+  const uint8_t header = midi->stream_write.buffer[0]; // cable number | MIDI_CIN_SYSEX_START
 
-  const uint8_t rhport = 0;
+  tu_fifo_buffer_info_t info;
+  tu_fifo_get_write_info(ff, &info);
 
-  // skip if previous transfer not complete
-  TU_VERIFY( usbd_edpt_claim(rhport, midi->ep_in), 0 );
+  uint32_t i = 0;
+  uint16_t written = 0;
+  bool stop = false;
 
-  uint16_t count = tu_fifo_read_n(&midi->tx_ff, _midid_epbuf[idx].epin, CFG_TUD_MIDI_EP_BUFSIZE);
+  // fifo depth is multiple of 4, packet is never split between linear and wrapped region
+  for (uint8_t region = 0; region < 2 && !stop; region++) {
+    uint8_t* dst = (uint8_t*) (region ? info.ptr_wrap : info.ptr_lin);
+    tu_fifo_size_t len = region ? info.len_wrap : info.len_lin;
 
-  if (count) {
-    TU_ASSERT( usbd_edpt_xfer(rhport, midi->ep_in, _midid_epbuf[idx].epin, count), 0 );
-    return count;
-  }else {
-    // Release endpoint since we don't make any transfer
-    usbd_edpt_release(rhport, midi->ep_in);
-    return 0;
+    while (len >= 4) {
+      if ((bufsize - i) < 3 || ((buffer[i] | buffer[i + 1] | buffer[i + 2]) & 0x80)) {
+        stop = true;
+        break;
+      }
+      dst[0] = header;
+      dst[1] = buffer[i];
+      dst[2] = buffer[i + 1];
+      dst[3] = buffer[i + 2];
+
+      dst += 4;
+      len -= 4;
+      i += 3;
+      written += 4;
+    }
   }
+
+  tu_fifo_advance_write_pointer(ff, written);
+  return i;
 }
 
 uint32_t tud_midi_n_stream_write(uint8_t itf, uint8_t cable_num, const uint8_t* buffer, uint32_t bufsize)
 {
   midid_interface_t* midi = &_midid_itf[itf];
-  TU_VERIFY(midi->ep_in, 0);
+  TU_VERIFY(midi->ep_stream.tx.ep_addr, 0);
 
   midid_stream_t* stream = &midi->stream_write;
+  tu_fifo_t* tx_ff = &midi->ep_stream.tx.ff;
 
   uint32_t i = 0;
-  while ( (i < bufsize) && (tu_fifo_remaining(&midi->tx_ff) >= 4) )
+  while ( (i < bufsize) && (tu_fifo_remaining(tx_ff) >= 4) )
   {
+    // bulk of a SysEx (e.g sample or firmware dump) is packed without parsing byte by byte
+    if ( stream->index == 0 && (stream->buffer[0] & 0xF) == MIDI_CIN_SYSEX_START )
+    {
+      const uint32_t count = sysex_write_fast(midi, buffer + i, bufsize - i);
+      if ( count )
+      {
+        i += count;
+        continue;
+      }
+    }
+
     const uint8_t data = buffer[i];
     i++;
 
@@ -341,7 +372,7 @@ uint32_t tud_midi_n_stream_write(uint8_t itf, uint8_t cable_num, const uint8_t*
         stream->buffer[idx] = 0;
       }
 
-      const uint16_t count = tu_fifo_write_n(&midi->tx_ff, stream->buffer, 4);
+      const uint16_t count = (uint16_t) tu_fifo_write_n(tx_ff, stream->buffer, 4);
 
       // complete current event packet, reset stream
       stream->index = stream->total = 0;
@@ -358,18 +389,123 @@ uint32_t tud_midi_n_stream_write(uint8_t itf, uint8_t cable_num, const uint8_t*
 
 bool tud_midi_n_packet_write (uint8_t itf, const uint8_t packet[4]) {
   midid_interface_t* midi = &_midid_itf[itf];
-  TU_VERIFY(midi->ep_in);
+  TU_VERIFY(midi->ep_stream.tx.ep_addr);
 
-  if (tu_fifo_remaining(&midi->tx_ff) < 4) {
+  if (tu_fifo_remaining(&midi->ep_stream.tx.ff) < 4) {
     return false;
   }
 
-  tu_fifo_write_n(&midi->tx_ff, packet, 4);
+  tu_fifo_write_n(&midi->ep_stream.tx.ff, packet, 4);
   write_flush(itf);
 
   return true;
 }
 
+//--------------------------------------------------------------------+
+// UMP API
+//--------------------------------------------------------------------+
+
+// UMP words are little endian on the bus. Fifo depth and transfers are multiple of 4, words are never split between
+// linear and wrapped region
+static void ump_copy_le(void* dst, const void* src, uint32_t len) {
+#if TU_BYTE_ORDER == TU_LITTLE_ENDIAN
+  memcpy(dst, src, len);
+#else
+  uint8_t* dst8 = (uint8_t*) dst;
+  const uint8_t* src8 = (const uint8_t*) src;
+  for (uint32_t i = 0; i < len; i += 4) {
+    tu_unaligned_write32(dst8 + i, tu_htole32(tu_unaligned_read32(src8 + i)));
+  }
+#endif
+}
+
+static uint32_t ump_fifo_word(const tu_fifo_buffer_info_t* info, uint32_t idx) {
+  const uint32_t offset = idx * 4;
+  const uint8_t* p = (offset < info->len_lin) ? ((const uint8_t*) info->ptr_lin + offset)
+                                              : ((const uint8_t*) info->ptr_wrap + (offset - info->len_lin));
+  return tu_le32toh(tu_unaligned_read32(p));
+}
+
+// copy len bytes from fifo linear then wrapped region
+static void ump_fifo_read(const tu_fifo_buffer_info_t* info, uint8_t* dst, uint32_t len) {
+  const uint32_t lin_len = tu_min32(len, info->len_lin);
+  ump_copy_le(dst, info->ptr_lin, lin_len);
+  if (len > lin_len) {
+    ump_copy_le(dst + lin_len, info->ptr_wrap, len - lin_len);
+  }
+}
+
+// copy len bytes to fifo linear then wrapped region
+static void ump_fifo_write(const tu_fifo_buffer_info_t* info, const uint8_t* src, uint32_t len) {
+  const uint32_t lin_len = tu_min32(len, info->len_lin);
+  ump_copy_le(info->ptr_lin, src, lin_len);
+  if (len > lin_len) {
+    ump_copy_le(info->ptr_wrap, src + lin_len, len - lin_len);
+  }
+}
+
+bool tud_midi_n_ump_active(uint8_t itf) {
+  const midid_interface_t* midi = &_midid_itf[itf];
+  return midi->ep_stream.rx.ep_addr && midi->alt == 1;
+}
+
+uint32_t tud_midi_n_ump_read(uint8_t itf, uint32_t* words, uint32_t max_words) {
+  midid_interface_t* midi = &_midid_itf[itf];
+  TU_VERIFY(midi->ep_stream.rx.ep_addr, 0);
+
+  tu_fifo_t* ff = &midi->ep_stream.rx.ff;
+  tu_fifo_buffer_info_t info;
+  tu_fifo_get_read_info(ff, &info);
+
+  // find whole UMPs, the last one may still be in transfer
+  const uint32_t avail = ((uint32_t) info.len_lin + info.len_wrap) / 4;
+  uint32_t count = 0;
+  while (count < avail) {
+    const uint32_t next = count + midi_ump_word_count(ump_fifo_word(&info, count));
+    if (next > avail || next > max_words) {
+      break;
+    }
+    count = next;
+  }
+
+  if (count) {
+    const uint8_t rhport = 0;
+    ump_fifo_read(&info, (uint8_t*) words, count * 4);
+    tu_fifo_advance_read_pointer(ff, (tu_fifo_size_t) (count * 4));
+    tu_edpt_stream_read_xfer(rhport, &midi->ep_stream.rx);
+  }
+
+  return count;
+}
+
+uint32_t tud_midi_n_ump_write(uint8_t itf, const uint32_t* words, uint32_t count) {
+  midid_interface_t* midi = &_midid_itf[itf];
+  TU_VERIFY(midi->ep_stream.tx.ep_addr, 0);
+
+  tu_fifo_t* ff = &midi->ep_stream.tx.ff;
+  tu_fifo_buffer_info_t info;
+  tu_fifo_get_write_info(ff, &info);
+
+  // only whole UMPs that fit
+  const uint32_t space = tu_min32(((uint32_t) info.len_lin + info.len_wrap) / 4, count);
+  uint32_t written = 0;
+  while (written < space) {
+    const uint32_t next = written + midi_ump_word_count(words[written]);
+    if (next > space) {
+      break;
+    }
+    written = next;
+  }
+
+  if (written) {
+    ump_fifo_write(&info, (const uint8_t*) words, written * 4);
+    tu_fifo_advance_write_pointer(ff, (tu_fifo_size_t) (written * 4));
+    write_flush(itf);
+  }
+
+  return written;
+}
+
 //--------------------------------------------------------------------+
 // USBD Driver API
 //--------------------------------------------------------------------+
@@ -379,39 +515,22 @@ void midid_init(void) {
   for (uint8_t i = 0; i < CFG_TUD_MIDI; i++) {
     midid_interface_t* midi = &_midid_itf[i];
 
-    // config fifo
-    tu_fifo_config(&midi->rx_ff, midi->rx_ff_buf, CFG_TUD_MIDI_RX_BUFSIZE, 1, false); // true, true
-    tu_fifo_config(&midi->tx_ff, midi->tx_ff_buf, CFG_TUD_MIDI_TX_BUFSIZE, 1, false); // OBVS.
+    tu_edpt_stream_init(&midi->ep_stream.rx, false, false, false,
+                        midi->ep_stream.rx_ff_buf, CFG_TUD_MIDI_RX_BUFSIZE,
+                        _midid_epbuf[i].epout, CFG_TUD_MIDI_EP_BUFSIZE);
 
-    #if CFG_FIFO_MUTEX
-    osal_mutex_t mutex_rd = osal_mutex_create(&midi->rx_ff_mutex);
-    osal_mutex_t mutex_wr = osal_mutex_create(&midi->tx_ff_mutex);
-    TU_ASSERT(mutex_wr != NULL && mutex_wr != NULL, );
-
-    tu_fifo_config_mutex(&midi->rx_ff, NULL, mutex_rd);
-    tu_fifo_config_mutex(&midi->tx_ff, mutex_wr, NULL);
-    #endif
+    tu_edpt_stream_init(&midi->ep_stream.tx, false, true, false,
+                        midi->ep_stream.tx_ff_buf, CFG_TUD_MIDI_TX_BUFSIZE,
+                        _midid_epbuf[i].epin, CFG_TUD_MIDI_EP_BUFSIZE);
   }
 }
 
 bool midid_deinit(void) {
-  #if CFG_FIFO_MUTEX
   for(uint8_t i=0; i<CFG_TUD_MIDI; i++) {
     midid_interface_t* midi = &_midid_itf[i];
-    osal_mutex_t mutex_rd = midi->rx_ff.mutex_rd;
-    osal_mutex_t mutex_wr = midi->tx_ff.mutex_wr;
-
-    if (mutex_rd) {
-      osal_mutex_delete(mutex_rd);
-      tu_fifo_config_mutex(&midi->rx_ff, NULL, NULL);
-    }
-
-    if (mutex_wr) {
-      osal_mutex_delete(mutex_wr);
-      tu_fifo_config_mutex(&midi->tx_ff, NULL, NULL);
-    }
+    tu_edpt_stream_deinit(&midi->ep_stream.rx);
+    tu_edpt_stream_deinit(&midi->ep_stream.tx);
   }
-  #endif
 
   return true;
 }
@@ -424,8 +543,10 @@ void midid_reset(uint8_t rhport)
   {
     midid_interface_t* midi = &_midid_itf[i];
     tu_memclr(midi, ITF_MEM_RESET_SIZE);
-    tu_fifo_clear(&midi->rx_ff);
-    tu_fifo_clear(&midi->tx_ff);
+    tu_edpt_stream_clear(&midi->ep_stream.rx);
+    tu_edpt_stream_clear(&midi->ep_stream.tx);
+    tu_edpt_stream_close(&midi->ep_stream.rx);
+    tu_edpt_stream_close(&midi->ep_stream.tx);
   }
 }
 
@@ -458,7 +579,7 @@ uint16_t midid_open(uint8_t rhport, const tusb_desc_interface_t* desc_itf, uint1
   midid_interface_t * p_midi = NULL;
   uint8_t idx;
   for(idx=0; idx<CFG_TUD_MIDI; idx++) {
-    if ( _midid_itf[idx].ep_in == 0 && _midid_itf[idx].ep_out == 0 ) {
+    if ( _midid_itf[idx].ep_stream.rx.ep_addr == 0 && _midid_itf[idx].ep_stream.tx.ep_addr == 0 ) {
       p_midi = &_midid_itf[idx];
       break;
     }
@@ -478,14 +599,15 @@ uint16_t midid_open(uint8_t rhport, const tusb_desc_interface_t* desc_itf, uint1
   {
     if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
     {
-      TU_ASSERT(usbd_edpt_open(rhport, (const tusb_desc_endpoint_t*) p_desc), 0);
-      uint8_t ep_addr = ((const tusb_desc_endpoint_t*) p_desc)->bEndpointAddress;
+      const tusb_desc_endpoint_t* desc_ep = (const tusb_desc_endpoint_t*) p_desc;
+      TU_ASSERT(usbd_edpt_open(rhport, desc_ep), 0);
+      usbd_edpt_instance_set(rhport, desc_ep->bEndpointAddress, idx);
 
-      if (tu_edpt_dir(ep_addr) == TUSB_DIR_IN)
+      if (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN)
       {
-        p_midi->ep_in = ep_addr;
+        tu_edpt_stream_open(&p_midi->ep_stream.tx, desc_ep);
       } else {
-        p_midi->ep_out = ep_addr;
+        tu_edpt_stream_open(&p_midi->ep_stream.rx, desc_ep);
       }
 
       // Class Specific MIDI Stream endpoint descriptor
@@ -499,8 +621,33 @@ uint16_t midid_open(uint8_t rhport, const tusb_desc_interface_t* desc_itf, uint1
     p_desc   = tu_desc_next(p_desc);
   }
 
+  // Alternate setting 1 is USB MIDI 2.0 (UMP), its endpoints must be the same as alternate setting 0
+  while ( (drv_len < max_len) && TUSB_DESC_INTERFACE == tu_desc_type(p_desc) )
+  {
+    const tusb_desc_interface_t* desc_alt = (const tusb_desc_interface_t*) p_desc;
+    if ( desc_alt->bInterfaceNumber != desc_midi->bInterfaceNumber ) break;
+    TU_ASSERT(desc_alt->bAlternateSetting == 1, 0);
+    p_midi->ump_capable = true;
+
+    drv_len += tu_desc_len(p_desc);
+    p_desc   = tu_desc_next(p_desc);
+
+    while ( (drv_len < max_len) && TUSB_DESC_INTERFACE != tu_desc_type(p_desc) &&
+            TUSB_DESC_INTERFACE_ASSOCIATION != tu_desc_type(p_desc) )
+    {
+      if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+      {
+        const uint8_t ep_addr = ((const tusb_desc_endpoint_t*) p_desc)->bEndpointAddress;
+        TU_ASSERT(ep_addr == p_midi->ep_stream.rx.ep_addr || ep_addr == p_midi->ep_stream.tx.ep_addr, 0);
+      }
+
+      drv_len += tu_desc_len(p_desc);
+      p_desc   = tu_desc_next(p_desc);
+    }
+  }
+
   // Prepare for incoming data
-  _prep_out_transaction(idx);
+  tu_edpt_stream_read_xfer(rhport, &p_midi->ep_stream.rx);
 
   return drv_len;
 }
@@ -509,30 +656,77 @@ uint16_t midid_open(uint8_t rhport, const tusb_desc_interface_t* desc_itf, uint1
 // Driver response accordingly to the request and the transfer stage (setup/data/ack)
 // return false to stall control endpoint (e.g unsupported request)
 bool midid_control_xfer_cb(uint8_t rhport, uint8_t stage, const tusb_control_request_t* request) {
-  (void) rhport; (void) stage; (void) request;
-  return false; // driver doesn't support any request yet
+  // only standard requests to MIDI streaming interface
+  TU_VERIFY(request->bmRequestType_bit.type == TUSB_REQ_TYPE_STANDARD &&
+            request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_INTERFACE);
+
+  uint8_t idx;
+  for (idx = 0; idx < CFG_TUD_MIDI; idx++) {
+    if (_midid_itf[idx].ep_stream.rx.ep_addr && _midid_itf[idx].itf_num == tu_u16_low(request->wIndex)) break;
+  }
+  TU_VERIFY(idx < CFG_TUD_MIDI);
+  midid_interface_t* p_midi = &_midid_itf[idx];
+
+  if (stage != CONTROL_STAGE_SETUP) return true;
+
+  switch (request->bRequest) {
+    case TUSB_REQ_GET_INTERFACE:
+      return tud_control_xfer(rhport, request, &p_midi->alt, 1);
+
+    case TUSB_REQ_SET_INTERFACE: {
+      const uint8_t alt = tu_u16_low(request->wValue);
+      TU_VERIFY(alt == 0 || (alt == 1 && p_midi->ump_capable));
+
+      if (alt != p_midi->alt) {
+        // data of the other protocol is dropped
+        p_midi->alt = alt;
+        tu_memclr(&p_midi->stream_write, sizeof(midid_stream_t));
+        tu_memclr(&p_midi->stream_read, sizeof(midid_stream_t));
+        tu_edpt_stream_clear(&p_midi->ep_stream.rx);
+        tu_edpt_stream_clear(&p_midi->ep_stream.tx);
+        tu_edpt_stream_read_xfer(rhport, &p_midi->ep_stream.rx);
+
+        if (tud_midi_ump_mode_cb) {
+          tud_midi_ump_mode_cb(idx, alt == 1);
+        }
+      }
+
+      return tud_control_status(rhport, request);
+    }
+
+    case TUSB_REQ_GET_DESCRIPTOR: {
+      // Group Terminal Block descriptors of alternate setting 1
+      TU_VERIFY(p_midi->ump_capable && tu_u16_high(request->wValue) == MIDI_DESC_TYPE_CS_GR_TRM_BLOCK &&
+                tu_u16_low(request->wValue) == 1);
+
+      static const uint8_t gtb_default[] = {
+        TUD_MIDI2_DESC_GTB(0, 0, 1, MIDI_GR_TRM_PROTOCOL_MIDI_2_0)
+      };
+
+      const uint8_t* desc = tud_midi_descriptor_gtb_cb ? tud_midi_descriptor_gtb_cb(idx) : gtb_default;
+      TU_VERIFY(desc);
+      const uint16_t total_len = tu_le16toh(tu_unaligned_read16(desc + offsetof(midi_desc_gr_trm_block_header_t, wTotalLength)));
+
+      return tud_control_xfer(rhport, request, (void*) (uintptr_t) desc, total_len);
+    }
+
+    default:
+      return false;
+  }
 }
 
 bool midid_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
 {
   (void) result;
-  (void) rhport;
-
-  uint8_t idx;
-  midid_interface_t* p_midi;
 
   // Identify which interface to use
-  for (idx = 0; idx < CFG_TUD_MIDI; idx++) {
-    p_midi = &_midid_itf[idx];
-    if ((ep_addr == p_midi->ep_out) || (ep_addr == p_midi->ep_in)) {
-      break;
-    }
-  }
+  uint8_t const idx = usbd_edpt_instance(rhport, ep_addr);
   TU_ASSERT(idx < CFG_TUD_MIDI);
+  midid_interface_t* p_midi = &_midid_itf[idx];
 
   // receive new data
-  if (ep_addr == p_midi->ep_out) {
-    tu_fifo_write_n(&p_midi->rx_ff, _midid_epbuf[idx].epout, (uint16_t)xferred_bytes);
+  if (ep_addr == p_midi->ep_stream.rx.ep_addr) {
+    tu_edpt_stream_read_xfer_complete(&p_midi->ep_stream.rx, xferred_bytes);
 
     // invoke receive callback if available
     if (tud_midi_rx_cb) {
@@ -540,18 +734,14 @@ bool midid_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32
     }
 
     // prepare for next
-    // TODO for now ep_out is not used by public API therefore there is no race condition,
-    // and does not need to claim like ep_in
-    _prep_out_transaction(idx);
-  } else if (ep_addr == p_midi->ep_in) {
-    if (0 == write_flush(idx)) {
+    tu_edpt_stream_read_xfer(rhport, &p_midi->ep_stream.rx);
+  } else if (ep_addr == p_midi->ep_stream.tx.ep_addr) {
+    tu_edpt_stream_write_xfer_complete(&p_midi->ep_stream.tx, xferred_bytes);
+
+    if (0 == tu_edpt_stream_write_xfer(rhport, &p_midi->ep_stream.tx)) {
       // If there is no data left, a ZLP should be sent if
       // xferred_bytes is multiple of EP size and not zero
-      if (!tu_fifo_count(&p_midi->tx_ff) && xferred_bytes && (0 == (xferred_bytes % CFG_TUD_MIDI_EP_BUFSIZE))) {
-        if (usbd_edpt_claim(rhport, p_midi->ep_in)) {
-          usbd_edpt_xfer(rhport, p_midi->ep_in, NULL, 0);
-        }
-      }
+      tu_edpt_stream_write_zlp_if_needed(rhport, &p_midi->ep_stream.tx, xferred_bytes);
     }
   }
 
@@ -75,6 +75,27 @@ bool     tud_midi_n_packet_read  (uint8_t itf, uint8_t packet[4]);
 // Write event packet            (4 bytes)
 bool     tud_midi_n_packet_write (uint8_t itf, uint8_t const packet[4]);
 
+// Get received event packets in place without copying, return number of contiguous packets (4 bytes each)
+// pointed by *packets. Must be followed by tud_midi_n_packet_consume() when done with (some of) them
+uint32_t tud_midi_n_packet_peek_n (uint8_t itf, uint8_t const** packets);
+
+// Remove packets obtained by tud_midi_n_packet_peek_n() from receive FIFO
+void     tud_midi_n_packet_consume (uint8_t itf, uint32_t count);
+
+//------------- USB MIDI 2.0 -------------//
+// Universal MIDI Packets (UMP) are used once host selects alternate setting 1 (see TUD_MIDI2_DESCRIPTOR), byte stream
+// and event packet API above are for alternate setting 0 (MIDI 1.0) only.
+
+// Check if host selected alternate setting 1 i.e UMP is used
+bool     tud_midi_n_ump_active   (uint8_t itf);
+
+// Read whole UMPs (1 to 4 words each) up to max_words, return number of words read
+uint32_t tud_midi_n_ump_read     (uint8_t itf, uint32_t* words, uint32_t max_words);
+
+// Write whole UMPs from count words as many as fit in fifo, return number of words written. A partial UMP at the end
+// of words is not written. Written data is sent with as large bulk transfers as endpoint buffer allows
+uint32_t tud_midi_n_ump_write    (uint8_t itf, uint32_t const* words, uint32_t count);
+
 //--------------------------------------------------------------------+
 // Application API (Single Interface)
 //--------------------------------------------------------------------+
@@ -87,6 +108,10 @@ static inline uint32_t tud_midi_stream_write (uint8_t cable_num, uint8_t const*
 static inline bool     tud_midi_packet_read  (uint8_t packet[4]);
 static inline bool     tud_midi_packet_write (uint8_t const packet[4]);
 
+static inline bool     tud_midi_ump_active   (void);
+static inline uint32_t tud_midi_ump_read     (uint32_t* words, uint32_t max_words);
+static inline uint32_t tud_midi_ump_write    (uint32_t const* words, uint32_t count);
+
 //------------- Deprecated API name  -------------//
 // TODO remove after 0.10.0 release
 
@@ -120,6 +145,15 @@ static inline bool tud_midi_receive(uint8_t packet[4])
 //--------------------------------------------------------------------+
 TU_ATTR_WEAK void tud_midi_rx_cb(uint8_t itf);
 
+// Invoked when host selects alternate setting of MIDI streaming interface, active is true for UMP (alternate 1).
+// Receive and transmit fifo are cleared
+TU_ATTR_WEAK void tud_midi_ump_mode_cb(uint8_t itf, bool active);
+
+// Invoked when received GET_DESCRIPTOR request of Group Terminal Block descriptors (USB MIDI 2.0)
+// Application return pointer to descriptors starting with header e.g TUD_MIDI2_DESC_GTB(). If not implemented, a
+// bidirectional block of group 1 with MIDI 2.0 protocol is used. Contents must exist long enough for transfer to complete
+TU_ATTR_WEAK uint8_t const* tud_midi_descriptor_gtb_cb(uint8_t itf);
+
 //--------------------------------------------------------------------+
 // Inline Functions
 //--------------------------------------------------------------------+
@@ -154,6 +188,21 @@ static inline bool tud_midi_packet_write (uint8_t const packet[4])
   return tud_midi_n_packet_write(0, packet);
 }
 
+static inline bool tud_midi_ump_active (void)
+{
+  return tud_midi_n_ump_active(0);
+}
+
+static inline uint32_t tud_midi_ump_read (uint32_t* words, uint32_t max_words)
+{
+  return tud_midi_n_ump_read(0, words, max_words);
+}
+
+static inline uint32_t tud_midi_ump_write (uint32_t const* words, uint32_t count)
+{
+  return tud_midi_n_ump_write(0, words, count);
+}
+
 //--------------------------------------------------------------------+
 // Internal Class Driver API
 //--------------------------------------------------------------------+
@@ -0,0 +1,421 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (CFG_TUH_ENABLED && CFG_TUH_MIDI)
+
+#include "host/usbh.h"
+#include "host/usbh_pvt.h"
+
+#include "midi_host.h"
+
+// Level where CFG_TUSB_DEBUG must be at least for this driver is logged
+#ifndef CFG_TUH_MIDI_LOG_LEVEL
+  #define CFG_TUH_MIDI_LOG_LEVEL   CFG_TUH_LOG_LEVEL
+#endif
+
+#define TU_LOG_DRV(...)   TU_LOG(CFG_TUH_MIDI_LOG_LEVEL, __VA_ARGS__)
+
+// packets are never split at fifo wrap around
+TU_VERIFY_STATIC((CFG_TUH_MIDI_RX_BUFSIZE % 4) == 0 && (CFG_TUH_MIDI_TX_BUFSIZE % 4) == 0,
+                 "MIDI FIFO size must be multiple of 4");
+
+//--------------------------------------------------------------------+
+// Host MIDI Interface
+//--------------------------------------------------------------------+
+
+typedef struct {
+  uint8_t daddr;
+  uint8_t itf_num;   // first interface: Audio Control if present, otherwise MIDI Streaming
+  uint8_t itf_count;
+  bool mounted;
+
+  uint8_t rx_cable_count;
+  uint8_t tx_cable_count;
+
+  struct {
+    tu_edpt_stream_t tx;
+    tu_edpt_stream_t rx;
+
+    uint8_t tx_ff_buf[CFG_TUH_MIDI_TX_BUFSIZE];
+    uint8_t rx_ff_buf[CFG_TUH_MIDI_RX_BUFSIZE];
+  } stream;
+} midih_interface_t;
+
+typedef struct {
+  TUH_EPBUF_DEF(tx, CFG_TUH_MIDI_TX_EPSIZE);
+  TUH_EPBUF_DEF(rx, CFG_TUH_MIDI_RX_EPSIZE);
+} midih_epbuf_t;
+
+static midih_interface_t midih_data[CFG_TUH_MIDI];
+CFG_TUH_MEM_SECTION static midih_epbuf_t midih_epbuf[CFG_TUH_MIDI];
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+
+static inline midih_interface_t* get_itf(uint8_t idx) {
+  TU_ASSERT(idx < CFG_TUH_MIDI, NULL);
+  midih_interface_t* p_midi = &midih_data[idx];
+
+  return (p_midi->daddr != 0) ? p_midi : NULL;
+}
+
+static inline uint8_t get_idx_by_ep_addr(uint8_t daddr, uint8_t ep_addr) {
+  for (uint8_t i = 0; i < CFG_TUH_MIDI; i++) {
+    midih_interface_t* p_midi = &midih_data[i];
+    if ((p_midi->daddr == daddr) &&
+        (ep_addr == p_midi->stream.rx.ep_addr || ep_addr == p_midi->stream.tx.ep_addr)) {
+      return i;
+    }
+  }
+
+  return TUSB_INDEX_INVALID_8;
+}
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+
+uint8_t tuh_midi_itf_get_index(uint8_t daddr, uint8_t itf_num) {
+  for (uint8_t i = 0; i < CFG_TUH_MIDI; i++) {
+    midih_interface_t const* p_midi = &midih_data[i];
+    if (p_midi->daddr == daddr && p_midi->itf_num <= itf_num && itf_num < p_midi->itf_num + p_midi->itf_count) {
+      return i;
+    }
+  }
+
+  return TUSB_INDEX_INVALID_8;
+}
+
+bool tuh_midi_mounted(uint8_t idx) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi);
+  return p_midi->mounted;
+}
+
+uint8_t tuh_midi_get_rx_cable_count(uint8_t idx) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi, 0);
+  return p_midi->rx_cable_count;
+}
+
+uint8_t tuh_midi_get_tx_cable_count(uint8_t idx) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi, 0);
+  return p_midi->tx_cable_count;
+}
+
+//--------------------------------------------------------------------+
+// Read
+//--------------------------------------------------------------------+
+
+uint32_t tuh_midi_read_available(uint8_t idx) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi, 0);
+
+  return tu_edpt_stream_read_available(&p_midi->stream.rx) / 4;
+}
+
+uint32_t tuh_midi_packet_read_n(uint8_t idx, uint8_t* buffer, uint32_t max_packets) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi && buffer, 0);
+
+  // only whole packets, fifo always holds multiple of 4 bytes
+  uint32_t const count = tu_min32(max_packets, tu_edpt_stream_read_available(&p_midi->stream.rx) / 4);
+  TU_VERIFY(count, 0);
+
+  return tu_edpt_stream_read(p_midi->daddr, &p_midi->stream.rx, buffer, count * 4) / 4;
+}
+
+bool tuh_midi_packet_read(uint8_t idx, uint8_t packet[4]) {
+  return 1 == tuh_midi_packet_read_n(idx, packet, 1);
+}
+
+uint32_t tuh_midi_packet_peek_n(uint8_t idx, uint8_t const** packets) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi && packets, 0);
+
+  // packets are never split at wrap around since fifo depth is multiple of 4
+  tu_fifo_buffer_info_t info;
+  tu_fifo_get_read_info(&p_midi->stream.rx.ff, &info);
+  *packets = (uint8_t const*) info.ptr_lin;
+
+  return info.len_lin / 4;
+}
+
+void tuh_midi_packet_consume(uint8_t idx, uint32_t count) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi, );
+
+  tu_fifo_advance_read_pointer(&p_midi->stream.rx.ff, (uint16_t) (count * 4));
+  tu_edpt_stream_read_xfer(p_midi->daddr, &p_midi->stream.rx);
+}
+
+bool tuh_midi_read_clear(uint8_t idx) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi);
+
+  bool ret = tu_edpt_stream_clear(&p_midi->stream.rx);
+  tu_edpt_stream_read_xfer(p_midi->daddr, &p_midi->stream.rx);
+  return ret;
+}
+
+//--------------------------------------------------------------------+
+// Write
+//--------------------------------------------------------------------+
+
+uint32_t tuh_midi_write_available(uint8_t idx) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi, 0);
+
+  return tu_edpt_stream_write_available(p_midi->daddr, &p_midi->stream.tx) / 4;
+}
+
+uint32_t tuh_midi_packet_write_n(uint8_t idx, uint8_t const* buffer, uint32_t n_packets) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi && p_midi->mounted && buffer, 0);
+  tu_edpt_stream_t* tx = &p_midi->stream.tx;
+
+  // only whole packets so that fifo never holds a partial one
+  uint32_t const count = tu_min32(n_packets, tu_edpt_stream_write_available(p_midi->daddr, tx) / 4);
+  TU_VERIFY(count, 0);
+
+  uint32_t const written = tu_edpt_stream_write(p_midi->daddr, tx, buffer, count * 4) / 4;
+
+  // send right away for latency, packets written while endpoint is busy are sent together on completion
+  tu_edpt_stream_write_xfer(p_midi->daddr, tx);
+
+  return written;
+}
+
+bool tuh_midi_packet_write(uint8_t idx, uint8_t const packet[4]) {
+  return 1 == tuh_midi_packet_write_n(idx, packet, 1);
+}
+
+uint32_t tuh_midi_write_flush(uint8_t idx) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi, 0);
+
+  return tu_edpt_stream_write_xfer(p_midi->daddr, &p_midi->stream.tx);
+}
+
+bool tuh_midi_write_clear(uint8_t idx) {
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_VERIFY(p_midi);
+
+  return tu_edpt_stream_clear(&p_midi->stream.tx);
+}
+
+//--------------------------------------------------------------------+
+// CLASS-USBH API
+//--------------------------------------------------------------------+
+
+bool midih_init(void) {
+  TU_LOG_DRV("sizeof(midih_interface_t) = %u\r\n", sizeof(midih_interface_t));
+  tu_memclr(midih_data, sizeof(midih_data));
+  for (size_t i = 0; i < CFG_TUH_MIDI; i++) {
+    midih_interface_t* p_midi = &midih_data[i];
+    midih_epbuf_t* epbuf = &midih_epbuf[i];
+    tu_edpt_stream_init(&p_midi->stream.tx, true, true, false,
+                        p_midi->stream.tx_ff_buf, CFG_TUH_MIDI_TX_BUFSIZE,
+                        epbuf->tx, CFG_TUH_MIDI_TX_EPSIZE);
+
+    tu_edpt_stream_init(&p_midi->stream.rx, true, false, false,
+                        p_midi->stream.rx_ff_buf, CFG_TUH_MIDI_RX_BUFSIZE,
+                        epbuf->rx, CFG_TUH_MIDI_RX_EPSIZE);
+  }
+
+  return true;
+}
+
+bool midih_deinit(void) {
+  for (size_t i = 0; i < CFG_TUH_MIDI; i++) {
+    midih_interface_t* p_midi = &midih_data[i];
+    tu_edpt_stream_deinit(&p_midi->stream.tx);
+    tu_edpt_stream_deinit(&p_midi->stream.rx);
+  }
+  return true;
+}
+
+void midih_close(uint8_t daddr) {
+  for (uint8_t idx = 0; idx < CFG_TUH_MIDI; idx++) {
+    midih_interface_t* p_midi = &midih_data[idx];
+    if (p_midi->daddr == daddr) {
+      TU_LOG_DRV("  MIDIh close addr = %u index = %u\r\n", daddr, idx);
+
+      if (tuh_midi_umount_cb) {
+        tuh_midi_umount_cb(idx);
+      }
+
+      p_midi->daddr = 0;
+      p_midi->mounted = false;
+      p_midi->rx_cable_count = 0;
+      p_midi->tx_cable_count = 0;
+      tu_edpt_stream_close(&p_midi->stream.tx);
+      tu_edpt_stream_close(&p_midi->stream.rx);
+    }
+  }
+}
+
+bool midih_xfer_cb(uint8_t daddr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes) {
+  // TODO handle stall response, retry failed transfer ...
+  TU_ASSERT(event == XFER_RESULT_SUCCESS);
+
+  uint8_t const idx = get_idx_by_ep_addr(daddr, ep_addr);
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_ASSERT(p_midi);
+
+  if (ep_addr == p_midi->stream.rx.ep_addr) {
+    // drop trailing bytes of a malformed transfer to keep fifo aligned to packets
+    uint32_t const num_packets = xferred_bytes / 4;
+    tu_edpt_stream_read_xfer_complete(&p_midi->stream.rx, num_packets * 4);
+
+    // re-arm first to keep receiving while application processes packets, read() will re-arm later if fifo is full
+    tu_edpt_stream_read_xfer(daddr, &p_midi->stream.rx);
+
+    if (num_packets && tuh_midi_rx_cb) {
+      tuh_midi_rx_cb(idx, num_packets);
+    }
+  } else {
+    tu_edpt_stream_write_xfer_complete(&p_midi->stream.tx, xferred_bytes);
+
+    if (tuh_midi_tx_cb) {
+      tuh_midi_tx_cb(idx, xferred_bytes / 4);
+    }
+
+    if (0 == tu_edpt_stream_write_xfer(daddr, &p_midi->stream.tx)) {
+      // If there is no data left, a ZLP should be sent if
+      // xferred_bytes is multiple of EP size and not zero
+      tu_edpt_stream_write_zlp_if_needed(daddr, &p_midi->stream.tx, xferred_bytes);
+    }
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Enumeration
+//--------------------------------------------------------------------+
+
+bool midih_open(uint8_t rhport, uint8_t daddr, tusb_desc_interface_t const *itf_desc, uint16_t max_len) {
+  (void) rhport;
+  TU_VERIFY(TUSB_CLASS_AUDIO == itf_desc->bInterfaceClass);
+
+  uint8_t const* p_end  = ((uint8_t const*) itf_desc) + max_len;
+  uint8_t const* p_desc = (uint8_t const*) itf_desc;
+  uint8_t const itf_num = itf_desc->bInterfaceNumber;
+  uint8_t itf_count = 1;
+
+  // Audio Control v1 (usbh binds it together with the following MIDI Streaming interface), skip its descriptors
+  if (AUDIO_SUBCLASS_CONTROL == itf_desc->bInterfaceSubClass) {
+    TU_VERIFY(AUDIO_FUNC_PROTOCOL_CODE_UNDEF == itf_desc->bInterfaceProtocol);
+
+    p_desc = tu_desc_next(p_desc);
+    while (p_desc < p_end && TUSB_DESC_INTERFACE != tu_desc_type(p_desc)) {
+      p_desc = tu_desc_next(p_desc);
+    }
+    TU_VERIFY(p_desc < p_end);
+
+    itf_desc = (tusb_desc_interface_t const*) p_desc;
+    TU_VERIFY(TUSB_CLASS_AUDIO == itf_desc->bInterfaceClass);
+    itf_count = 2;
+  }
+
+  TU_VERIFY(AUDIO_SUBCLASS_MIDI_STREAMING == itf_desc->bInterfaceSubClass);
+
+  midih_interface_t* p_midi = NULL;
+  uint8_t idx;
+  for (idx = 0; idx < CFG_TUH_MIDI; idx++) {
+    if (midih_data[idx].daddr == 0) {
+      p_midi = &midih_data[idx];
+      break;
+    }
+  }
+  TU_VERIFY(p_midi);
+
+  TU_LOG_DRV("MIDI opening Interface %u (addr = %u)\r\n", itf_desc->bInterfaceNumber, daddr);
+  p_midi->daddr     = daddr;
+  p_midi->itf_num   = itf_num;
+  p_midi->itf_count = itf_count;
+
+  // MIDI Streaming: jacks then endpoints, each followed by class-specific endpoint with its embedded jacks
+  tu_edpt_stream_t* last_stream = NULL;
+  p_desc = tu_desc_next(p_desc);
+  while (p_desc < p_end && TUSB_DESC_INTERFACE != tu_desc_type(p_desc)) {
+    uint8_t const desc_type = tu_desc_type(p_desc);
+
+    if (TUSB_DESC_ENDPOINT == desc_type) {
+      tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+      // most devices use bulk, some use interrupt endpoints
+      TU_ASSERT(TUSB_XFER_BULK == desc_ep->bmAttributes.xfer || TUSB_XFER_INTERRUPT == desc_ep->bmAttributes.xfer);
+      TU_ASSERT(tuh_edpt_open(daddr, desc_ep));
+
+      last_stream = (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN) ? &p_midi->stream.rx : &p_midi->stream.tx;
+      tu_edpt_stream_open(last_stream, desc_ep);
+    } else if (TUSB_DESC_CS_ENDPOINT == desc_type && last_stream &&
+               MIDI_CS_ENDPOINT_GENERAL == p_desc[2] && tu_desc_len(p_desc) >= 4) {
+      uint8_t const num_jack = p_desc[3]; // bNumEmbMIDIJack
+      if (last_stream == &p_midi->stream.rx) {
+        p_midi->rx_cable_count = num_jack;
+      } else {
+        p_midi->tx_cable_count = num_jack;
+      }
+    }
+
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  TU_LOG_DRV("  cables rx = %u, tx = %u\r\n", p_midi->rx_cable_count, p_midi->tx_cable_count);
+  TU_ASSERT(p_midi->stream.rx.ep_addr || p_midi->stream.tx.ep_addr);
+
+  return true;
+}
+
+bool midih_set_config(uint8_t daddr, uint8_t itf_num) {
+  uint8_t const idx = tuh_midi_itf_get_index(daddr, itf_num);
+  midih_interface_t* p_midi = get_itf(idx);
+  TU_ASSERT(p_midi);
+
+  TU_LOG_DRV("MIDIh Set Configure complete\r\n");
+  p_midi->mounted = true;
+  if (tuh_midi_mount_cb) {
+    tuh_midi_mount_cb(idx, p_midi->rx_cable_count, p_midi->tx_cable_count);
+  }
+
+  // keep IN endpoint armed from now on
+  if (p_midi->stream.rx.ep_addr) {
+    tu_edpt_stream_read_xfer(daddr, &p_midi->stream.rx);
+  }
+
+  // notify usbh that driver enumeration is complete, skip all interfaces of this function
+  usbh_driver_set_config_complete(daddr, (uint8_t) (p_midi->itf_num + p_midi->itf_count - 1));
+
+  return true;
+}
+
+#endif
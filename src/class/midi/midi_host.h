@@ -0,0 +1,157 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_MIDI_HOST_H_
+#define _TUSB_MIDI_HOST_H_
+
+#include "class/audio/audio.h"
+#include "midi.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+
+// RX FIFO size, must be multiple of 4 and at least endpoint size so that IN endpoint is always armed.
+// Transfers are received directly into FIFO (multiple packets per transfer) when possible
+#ifndef CFG_TUH_MIDI_RX_BUFSIZE
+#define CFG_TUH_MIDI_RX_BUFSIZE (2*USBH_EPSIZE_BULK_MAX)
+#endif
+
+// RX endpoint buffer size, used when transfer can not be received into FIFO directly
+#ifndef CFG_TUH_MIDI_RX_EPSIZE
+#define CFG_TUH_MIDI_RX_EPSIZE  USBH_EPSIZE_BULK_MAX
+#endif
+
+// TX FIFO size, must be multiple of 4
+#ifndef CFG_TUH_MIDI_TX_BUFSIZE
+#define CFG_TUH_MIDI_TX_BUFSIZE USBH_EPSIZE_BULK_MAX
+#endif
+
+// TX endpoint buffer size, used when FIFO can not be sent directly
+#ifndef CFG_TUH_MIDI_TX_EPSIZE
+#define CFG_TUH_MIDI_TX_EPSIZE  USBH_EPSIZE_BULK_MAX
+#endif
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+
+// Get Interface index from device address + interface number (Audio Control or MIDI Streaming interface)
+// return TUSB_INDEX_INVALID_8 (0xFF) if not found
+uint8_t tuh_midi_itf_get_index(uint8_t daddr, uint8_t itf_num);
+
+// Check if a interface is mounted
+bool tuh_midi_mounted(uint8_t idx);
+
+// Number of virtual cables (embedded jacks) of IN endpoint i.e from device to host
+uint8_t tuh_midi_get_rx_cable_count(uint8_t idx);
+
+// Number of virtual cables (embedded jacks) of OUT endpoint i.e from host to device
+uint8_t tuh_midi_get_tx_cable_count(uint8_t idx);
+
+// Cable number of an event packet, used to route packets
+TU_ATTR_ALWAYS_INLINE static inline uint8_t tuh_midi_packet_cable(uint8_t const packet[4]) {
+  return (uint8_t) (packet[0] >> 4);
+}
+
+//--------------------------------------------------------------------+
+// Read API
+//--------------------------------------------------------------------+
+
+// Get the number of event packets (4 bytes) available for reading
+uint32_t tuh_midi_read_available(uint8_t idx);
+
+// Read up to max_packets event packets (4 bytes each) into buffer, return number of packets read
+uint32_t tuh_midi_packet_read_n(uint8_t idx, uint8_t* buffer, uint32_t max_packets);
+
+// Read an event packet
+bool tuh_midi_packet_read(uint8_t idx, uint8_t packet[4]);
+
+// Get received event packets in place without copying, return number of contiguous packets (4 bytes each)
+// pointed by *packets. Must be followed by tuh_midi_packet_consume() when done with (some of) them
+uint32_t tuh_midi_packet_peek_n(uint8_t idx, uint8_t const** packets);
+
+// Remove packets obtained by tuh_midi_packet_peek_n() from receive FIFO
+void tuh_midi_packet_consume(uint8_t idx, uint32_t count);
+
+// Clear the received FIFO
+bool tuh_midi_read_clear(uint8_t idx);
+
+//--------------------------------------------------------------------+
+// Write API
+//--------------------------------------------------------------------+
+
+// Get the number of event packets (4 bytes) that can be written
+uint32_t tuh_midi_write_available(uint8_t idx);
+
+// Write up to n_packets event packets (4 bytes each) from buffer, return number of packets written.
+// Transfer is started right away if endpoint is idle, otherwise packets are sent together when it completes
+uint32_t tuh_midi_packet_write_n(uint8_t idx, uint8_t const* buffer, uint32_t n_packets);
+
+// Write an event packet
+bool tuh_midi_packet_write(uint8_t idx, uint8_t const packet[4]);
+
+// Start transfer of written packets if endpoint is idle, return number of bytes queued for transfer
+uint32_t tuh_midi_write_flush(uint8_t idx);
+
+// Clear the transmit FIFO
+bool tuh_midi_write_clear(uint8_t idx);
+
+//--------------------------------------------------------------------+
+// MIDI APPLICATION CALLBACKS
+//--------------------------------------------------------------------+
+
+// Invoked when a device with MIDI Streaming interface is mounted
+TU_ATTR_WEAK extern void tuh_midi_mount_cb(uint8_t idx, uint8_t num_cables_rx, uint8_t num_cables_tx);
+
+// Invoked when a device with MIDI Streaming interface is unmounted
+TU_ATTR_WEAK extern void tuh_midi_umount_cb(uint8_t idx);
+
+// Invoked when event packets are received, IN endpoint is already re-armed
+TU_ATTR_WEAK extern void tuh_midi_rx_cb(uint8_t idx, uint32_t num_packets);
+
+// Invoked when a transfer is complete, application can write more packets
+TU_ATTR_WEAK extern void tuh_midi_tx_cb(uint8_t idx, uint32_t num_packets);
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+bool midih_init       (void);
+bool midih_deinit     (void);
+bool midih_open       (uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t max_len);
+bool midih_set_config (uint8_t dev_addr, uint8_t itf_num);
+bool midih_xfer_cb    (uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void midih_close      (uint8_t dev_addr);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_MIDI_HOST_H_ */
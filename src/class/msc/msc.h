@@ -58,7 +58,8 @@ typedef enum
 {
   MSC_PROTOCOL_CBI              = 0 ,  ///< Control/Bulk/Interrupt protocol (with command completion interrupt)
   MSC_PROTOCOL_CBI_NO_INTERRUPT = 1 ,  ///< Control/Bulk/Interrupt protocol (without command completion interrupt)
-  MSC_PROTOCOL_BOT              = 0x50 ///< Bulk-Only Transport
+  MSC_PROTOCOL_BOT              = 0x50, ///< Bulk-Only Transport
+  MSC_PROTOCOL_UAS              = 0x62  ///< USB Attached SCSI, BOT shall be provided as alternate setting 0
 }msc_protocol_type_t;
 
 /// MassStorage Class-Specific Control Request
@@ -103,6 +104,125 @@ typedef struct TU_ATTR_PACKED
 
 TU_VERIFY_STATIC(sizeof(msc_csw_t) == 13, "size is not correct");
 
+//--------------------------------------------------------------------+
+// USB Attached SCSI (UAS)
+//--------------------------------------------------------------------+
+
+/// Pipe Usage descriptor type, follows each endpoint descriptor of UAS interface
+enum {
+  MSC_UAS_DESC_PIPE_USAGE = 0x24
+};
+
+/// UAS Pipe ID of Pipe Usage descriptor
+typedef enum {
+  MSC_UAS_PIPE_COMMAND  = 1, ///< Bulk OUT: Command and Task Management IU
+  MSC_UAS_PIPE_STATUS   = 2, ///< Bulk IN: Sense, Response, Read Ready and Write Ready IU
+  MSC_UAS_PIPE_DATA_IN  = 3, ///< Bulk IN: data from device
+  MSC_UAS_PIPE_DATA_OUT = 4  ///< Bulk OUT: data to device
+} msc_uas_pipe_id_t;
+
+typedef struct TU_ATTR_PACKED {
+  uint8_t bLength;
+  uint8_t bDescriptorType; ///< MSC_UAS_DESC_PIPE_USAGE
+  uint8_t bPipeID;         ///< Values from \ref msc_uas_pipe_id_t
+  uint8_t bReserved;
+} msc_uas_desc_pipe_usage_t;
+
+TU_VERIFY_STATIC(sizeof(msc_uas_desc_pipe_usage_t) == 4, "size is not correct");
+
+/// UAS Information Unit ID
+typedef enum {
+  MSC_UAS_IU_COMMAND     = 0x01,
+  MSC_UAS_IU_SENSE       = 0x03,
+  MSC_UAS_IU_RESPONSE    = 0x04,
+  MSC_UAS_IU_TASK_MGMT   = 0x05,
+  MSC_UAS_IU_READ_READY  = 0x06,
+  MSC_UAS_IU_WRITE_READY = 0x07
+} msc_uas_iu_id_t;
+
+/// Task attribute of Command IU
+typedef enum {
+  MSC_UAS_TASK_ATTR_SIMPLE        = 0,
+  MSC_UAS_TASK_ATTR_HEAD_OF_QUEUE = 1,
+  MSC_UAS_TASK_ATTR_ORDERED       = 2,
+  MSC_UAS_TASK_ATTR_ACA           = 4
+} msc_uas_task_attr_t;
+
+/// Header common to all IUs, multi-byte fields of IUs are big-endian
+typedef struct TU_ATTR_PACKED {
+  uint8_t  iu_id;     ///< Values from \ref msc_uas_iu_id_t
+  uint8_t  reserved;
+  uint16_t tag;       ///< Tag of the command, Read/Write Ready, Sense and Response IU echo it
+} msc_uas_iu_header_t;
+
+/// Command IU, sent on command pipe
+typedef struct TU_ATTR_PACKED {
+  msc_uas_iu_header_t header;
+  uint8_t task_attr;    ///< Bit 2:0 task attribute from \ref msc_uas_task_attr_t, bit 6:3 command priority
+  uint8_t reserved5;
+  uint8_t add_cdb_len;  ///< Bit 7:2 number of dwords of CDB beyond 16 bytes
+  uint8_t reserved7;
+  uint8_t lun[8];       ///< SAM logical unit number, single level LUN is in lun[1]
+  uint8_t cdb[16];
+} msc_uas_command_iu_t;
+
+TU_VERIFY_STATIC(sizeof(msc_uas_command_iu_t) == 32, "size is not correct");
+
+/// Sense IU, received on status pipe when command is complete. Sense data follows
+typedef struct TU_ATTR_PACKED {
+  msc_uas_iu_header_t header;
+  uint16_t status_qualifier;
+  uint8_t  status;      ///< SCSI status: 0 is GOOD, 2 is CHECK CONDITION
+  uint8_t  reserved7[7];
+  uint16_t sense_len;   ///< Bytes of sense data following this header, up to 252
+} msc_uas_sense_iu_t;
+
+TU_VERIFY_STATIC(sizeof(msc_uas_sense_iu_t) == 16, "size is not correct");
+
+/// Response IU, received on status pipe for task management or when a command IU is rejected
+typedef struct TU_ATTR_PACKED {
+  msc_uas_iu_header_t header;
+  uint8_t add_response_info[3];
+  uint8_t response_code;
+} msc_uas_response_iu_t;
+
+TU_VERIFY_STATIC(sizeof(msc_uas_response_iu_t) == 8, "size is not correct");
+
+/// Task Management IU, sent on command pipe
+typedef struct TU_ATTR_PACKED {
+  msc_uas_iu_header_t header;
+  uint8_t  function;    ///< Values from \ref msc_uas_tmf_t
+  uint8_t  reserved5;
+  uint16_t task_tag;    ///< Tag of the command to manage (ABORT TASK, QUERY TASK)
+  uint8_t  lun[8];
+} msc_uas_task_mgmt_iu_t;
+
+TU_VERIFY_STATIC(sizeof(msc_uas_task_mgmt_iu_t) == 16, "size is not correct");
+
+/// Task Management Function
+typedef enum {
+  MSC_UAS_TMF_ABORT_TASK          = 0x01,
+  MSC_UAS_TMF_ABORT_TASK_SET      = 0x02,
+  MSC_UAS_TMF_CLEAR_TASK_SET      = 0x04,
+  MSC_UAS_TMF_LOGICAL_UNIT_RESET  = 0x08,
+  MSC_UAS_TMF_IT_NEXUS_RESET      = 0x10,
+  MSC_UAS_TMF_CLEAR_ACA           = 0x40,
+  MSC_UAS_TMF_QUERY_TASK          = 0x80,
+  MSC_UAS_TMF_QUERY_TASK_SET      = 0x81,
+  MSC_UAS_TMF_QUERY_ASYNC_EVENT   = 0x82
+} msc_uas_tmf_t;
+
+/// Response code of Response IU
+typedef enum {
+  MSC_UAS_RESPONSE_TMF_COMPLETE      = 0x00,
+  MSC_UAS_RESPONSE_INVALID_IU        = 0x02,
+  MSC_UAS_RESPONSE_TMF_NOT_SUPPORTED = 0x04,
+  MSC_UAS_RESPONSE_TMF_FAILED        = 0x05,
+  MSC_UAS_RESPONSE_TMF_SUCCEEDED     = 0x08,
+  MSC_UAS_RESPONSE_INCORRECT_LUN     = 0x09,
+  MSC_UAS_RESPONSE_OVERLAPPED_TAG    = 0x0A
+} msc_uas_response_code_t;
+
 //--------------------------------------------------------------------+
 // SCSI Constant
 //--------------------------------------------------------------------+
@@ -121,8 +241,31 @@ typedef enum
   SCSI_CMD_READ_FORMAT_CAPACITY         = 0x23, ///< The command allows the Host to request a list of the possible format capacities for an installed writable media. This command also has the capability to report the writable capacity for a media when it is installed
   SCSI_CMD_READ_10                      = 0x28, ///< The READ (10) command requests that the device server read the specified logical block(s) and transfer them to the data-in buffer.
   SCSI_CMD_WRITE_10                     = 0x2A, ///< The WRITE (10) command requests that the device server transfer the specified logical block(s) from the data-out buffer and write them.
+  SCSI_CMD_READ_16                      = 0x88, ///< Same as READ (10) with 64-bit LBA and 32-bit block count
+  SCSI_CMD_WRITE_16                     = 0x8A, ///< Same as WRITE (10) with 64-bit LBA and 32-bit block count
+  SCSI_CMD_SERVICE_ACTION_IN_16         = 0x9E, ///< Service action (e.g READ CAPACITY (16)) is specified in 2nd byte
+  SCSI_CMD_UNMAP                        = 0x42, ///< Logical blocks in parameter list no longer hold valid data, device can e.g erase flash (TRIM)
+  SCSI_CMD_SYNCHRONIZE_CACHE_10         = 0x35, ///< Write cached data of the specified logical blocks (all to the last one if count is 0) to the medium
 }scsi_cmd_type_t;
 
+/// SCSI Vital Product Data page code of INQUIRY with EVPD bit set
+enum {
+  SCSI_VPD_PAGE_SUPPORTED            = 0x00,
+  SCSI_VPD_PAGE_BLOCK_LIMITS         = 0xB0,
+  SCSI_VPD_PAGE_LOGICAL_PROVISIONING = 0xB2,
+};
+
+/// SCSI Mode Page code of MODE SENSE
+enum {
+  SCSI_MODE_PAGE_CACHING = 0x08,
+  SCSI_MODE_PAGE_ALL     = 0x3F,
+};
+
+/// SCSI Service Action for \ref SCSI_CMD_SERVICE_ACTION_IN_16
+enum {
+  SCSI_SERVICE_ACTION_READ_CAPACITY_16 = 0x10,
+};
+
 /// SCSI Sense Key
 typedef enum
 {
@@ -274,6 +417,22 @@ typedef struct TU_ATTR_PACKED
 
 TU_VERIFY_STATIC( sizeof(scsi_mode_sense6_resp_t) == 4, "size is not correct");
 
+// Caching mode page, follows mode parameter header
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t page_code;   ///< \ref SCSI_MODE_PAGE_CACHING
+  uint8_t page_length; ///< 0x12
+
+  uint8_t read_cache_disable  : 1;
+  uint8_t multiplication      : 1;
+  uint8_t write_cache_enable  : 1;
+  uint8_t                     : 5;
+
+  uint8_t reserved[17];
+} scsi_mode_page_caching_t;
+
+TU_VERIFY_STATIC( sizeof(scsi_mode_page_caching_t) == 20, "size is not correct");
+
 typedef struct TU_ATTR_PACKED
 {
   uint8_t cmd_code; ///< SCSI OpCode for \ref SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL
@@ -375,6 +534,85 @@ typedef struct TU_ATTR_PACKED
 TU_VERIFY_STATIC(sizeof(scsi_read10_t) == 10, "size is not correct");
 TU_VERIFY_STATIC(sizeof(scsi_write10_t) == 10, "size is not correct");
 
+/// SCSI Read Capacity 16 Command, required for media with more than 2^32 blocks
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  cmd_code                 ; ///< SCSI OpCode for \ref SCSI_CMD_SERVICE_ACTION_IN_16
+  uint8_t  service_action           ; ///< SCSI_SERVICE_ACTION_READ_CAPACITY_16
+  uint64_t lba                      ;
+  uint32_t alloc_length             ; ///< Number of response bytes host has allocated
+  uint8_t  partial_medium_indicator ;
+  uint8_t  control                  ;
+} scsi_read_capacity16_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_read_capacity16_t) == 16, "size is not correct");
+
+/// SCSI Read Capacity 16 Response Data
+typedef struct TU_ATTR_PACKED
+{
+  uint64_t last_lba   ; ///< The last Logical Block Address of the device
+  uint32_t block_size ; ///< Block size in bytes
+  uint8_t  reserved[20];
+} scsi_read_capacity16_resp_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_read_capacity16_resp_t) == 32, "size is not correct");
+
+/// SCSI Read 16 Command
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  cmd_code     ; ///< SCSI OpCode
+  uint8_t  flags        ;
+  uint64_t lba          ; ///< The first Logical Block Address (LBA) accessed by this command
+  uint32_t block_count  ; ///< Number of Blocks used by this command
+  uint8_t  group_number ;
+  uint8_t  control      ;
+} scsi_read16_t, scsi_write16_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_read16_t) == 16, "size is not correct");
+TU_VERIFY_STATIC(sizeof(scsi_write16_t) == 16, "size is not correct");
+
+/// SCSI Unmap Command
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  cmd_code        ; ///< SCSI OpCode for \ref SCSI_CMD_UNMAP
+  uint8_t  anchor          ;
+  uint8_t  reserved[4]     ;
+  uint8_t  group_number    ;
+  uint16_t param_list_len  ; ///< Length of parameter list (header + block descriptors) in data-out
+  uint8_t  control         ;
+} scsi_unmap_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_unmap_t) == 10, "size is not correct");
+
+/// SCSI Unmap Parameter List Header, followed by block descriptors
+typedef struct TU_ATTR_PACKED
+{
+  uint16_t data_len      ; ///< Bytes following this field
+  uint16_t block_desc_len; ///< Bytes of block descriptors
+  uint8_t  reserved[4]   ;
+} scsi_unmap_param_header_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_unmap_param_header_t) == 8, "size is not correct");
+
+/// SCSI Unmap Block Descriptor
+typedef struct TU_ATTR_PACKED
+{
+  uint64_t lba         ; ///< First Logical Block Address to unmap
+  uint32_t block_count ; ///< Number of blocks to unmap, can be zero
+  uint8_t  reserved[4] ;
+} scsi_unmap_block_desc_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_unmap_block_desc_t) == 16, "size is not correct");
+
+// 64-bit fields (LBA) are Big Endian as the rest of SCSI
+TU_ATTR_ALWAYS_INLINE static inline uint64_t msc_htonll(uint64_t u64) {
+  #if TU_BYTE_ORDER == TU_LITTLE_ENDIAN
+  return (((uint64_t) tu_htonl((uint32_t) u64)) << 32) | tu_htonl((uint32_t) (u64 >> 32));
+  #else
+  return u64;
+  #endif
+}
+
 #ifdef __cplusplus
  }
 #endif
@@ -52,10 +52,30 @@ enum {
   MSC_STAGE_NEED_RESET,
 };
 
+enum {
+  MSC_EPBUF_COUNT = CFG_TUD_MSC_DOUBLE_BUFFER ? 2 : 1
+};
+
+#if CFG_TUD_MSC_UAS
+TU_VERIFY_STATIC(CFG_TUD_MSC_UAS_CMD_QUEUE_N > 0 && CFG_TUD_MSC_UAS_CMD_QUEUE_N < 255,
+                 "CFG_TUD_MSC_UAS_CMD_QUEUE_N must be 1-254");
+
+// Command IU is 32 bytes for CDB up to 16 bytes, Task Management IU is 16 bytes
+#define UAS_CMD_IU_MAX  64
+
+// Command IU received from host, executed in order
+typedef struct {
+  uint16_t tag;
+  uint8_t  lun;
+  uint8_t  cdb[16];
+} mscd_uas_cmd_t;
+#endif
+
 typedef struct {
   TU_ATTR_ALIGNED(4) msc_cbw_t cbw;
   TU_ATTR_ALIGNED(4) msc_csw_t csw;
 
+  uint8_t  rhport;
   uint8_t  itf_num;
   uint8_t  ep_in;
   uint8_t  ep_out;
@@ -66,31 +86,110 @@ typedef struct {
   uint32_t total_len;   // byte to be transferred, can be smaller than total_bytes in cbw
   uint32_t xferred_len; // numbered of bytes transferred so far in the Data Stage
 
+  // READ10/WRITE10 data stage buffers
+  // - READ10 : epbuf_idx is the buffer to send next, epbuf_len[] is the prefetched bytes (negative if failed)
+  // - WRITE10: epbuf_idx is the oldest buffer to consume, epbuf_len[] is the received bytes not consumed yet
+  uint8_t  epbuf_idx;
+  uint8_t  xfer_idx;    // buffer used by the queued WRITE10 transfer
+  uint16_t xfer_len;    // length of the queued WRITE10 transfer, 0 if none
+  int32_t  epbuf_len[MSC_EPBUF_COUNT];
+
+  uint8_t  pending_io;  // waiting for tud_msc_async_io_done()
+
+  // end of the last READ10/16 for sequential read detection
+  bool     read_end_valid;
+  uint8_t  read_end_lun;
+  uint32_t read_end_lba;
+
   // Sense Response Data
   uint8_t sense_key;
   uint8_t add_sense_code;
   uint8_t add_sense_qualifier;
+
+  #if CFG_TUD_MSC_UAS
+  // USB Attached SCSI (alternate 1): ep_in/ep_out above are switched to its data pipes
+  bool     uas;
+  uint8_t  ep_bot_in;
+  uint8_t  ep_bot_out;
+  uint8_t  ep_uas_in;
+  uint8_t  ep_uas_out;
+  uint8_t  ep_cmd;
+  uint8_t  ep_status;
+
+  uint8_t  uas_ready;        // Read/Write Ready IU to send for data stage, 0 if none
+  bool     uas_resp_pending; // Response IU to send
+  uint8_t  uas_resp_code;
+  uint16_t uas_resp_tag;
+
+  uint8_t  uas_rd;
+  uint8_t  uas_count;
+  mscd_uas_cmd_t uas_queue[CFG_TUD_MSC_UAS_CMD_QUEUE_N];
+  #endif
 }mscd_interface_t;
 
 static mscd_interface_t _mscd_itf;
 
 CFG_TUD_MEM_SECTION static struct {
   TUD_EPBUF_DEF(buf, CFG_TUD_MSC_EP_BUFSIZE);
+  #if CFG_TUD_MSC_DOUBLE_BUFFER
+  TUD_EPBUF_DEF(buf2, CFG_TUD_MSC_EP_BUFSIZE);
+  #endif
+  #if CFG_TUD_MSC_UAS
+  TUD_EPBUF_DEF(uas_cmd, UAS_CMD_IU_MAX);
+  TUD_EPBUF_DEF(uas_status, sizeof(msc_uas_sense_iu_t) + sizeof(scsi_sense_fixed_resp_t));
+  #endif
 } _mscd_epbuf;
 
+TU_ATTR_ALWAYS_INLINE static inline uint8_t* get_epbuf(uint8_t idx) {
+  #if CFG_TUD_MSC_DOUBLE_BUFFER
+  return idx ? _mscd_epbuf.buf2 : _mscd_epbuf.buf;
+  #else
+  (void) idx;
+  return _mscd_epbuf.buf;
+  #endif
+}
+
+TU_ATTR_ALWAYS_INLINE static inline uint8_t next_epbuf(uint8_t idx) {
+  return (uint8_t) ((idx + 1) % MSC_EPBUF_COUNT);
+}
+
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
 //--------------------------------------------------------------------+
+static int32_t proc_unmap(uint8_t lun, uint8_t const* buf, uint32_t len);
 static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buffer, uint32_t bufsize);
 static void proc_read10_cmd(uint8_t rhport, mscd_interface_t* p_msc);
+static void proc_read10_begin(uint8_t rhport, mscd_interface_t* p_msc);
+
+static void proc_read10_result(uint8_t rhport, mscd_interface_t* p_msc, int32_t nbytes);
 
 static void proc_write10_cmd(uint8_t rhport, mscd_interface_t* p_msc);
+static bool write10_queue_next(uint8_t rhport, mscd_interface_t* p_msc);
 static void proc_write10_new_data(uint8_t rhport, mscd_interface_t* p_msc, uint32_t xferred_bytes);
+static void proc_write10_data(uint8_t rhport, mscd_interface_t* p_msc, bool has_result, int32_t result);
+
+static void proc_stage_status(uint8_t rhport, mscd_interface_t* p_msc);
+
+#if CFG_TUD_MSC_UAS
+static uint16_t uas_open(uint8_t rhport, mscd_interface_t* p_msc, tusb_desc_interface_t const* itf_desc, uint16_t max_len);
+static void uas_select(uint8_t rhport, mscd_interface_t* p_msc, bool uas);
+static void uas_xfer_cb(uint8_t rhport, mscd_interface_t* p_msc, uint8_t ep_addr, uint32_t xferred_bytes);
+static void uas_status_kick(uint8_t rhport, mscd_interface_t* p_msc);
+#endif
 
 TU_ATTR_ALWAYS_INLINE static inline bool is_data_in(uint8_t dir) {
   return tu_bit_test(dir, 7);
 }
 
+TU_ATTR_ALWAYS_INLINE static inline bool is_uas(mscd_interface_t const* p_msc) {
+  #if CFG_TUD_MSC_UAS
+  return p_msc->uas;
+  #else
+  (void) p_msc;
+  return false;
+  #endif
+}
+
 static inline bool send_csw(uint8_t rhport, mscd_interface_t* p_msc) {
   // Data residue is always = host expect - actual transferred
   p_msc->csw.data_residue = p_msc->cbw.total_bytes - p_msc->xferred_len;
@@ -117,8 +216,8 @@ static void fail_scsi_op(uint8_t rhport, mscd_interface_t* p_msc, uint8_t status
     tud_msc_set_sense(p_cbw->lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
   }
 
-  // If there is data stage and not yet complete, stall it
-  if (p_cbw->total_bytes && p_csw->data_residue) {
+  // If there is data stage and not yet complete, stall it. UAS reports the failure with Sense IU only
+  if (p_cbw->total_bytes && p_csw->data_residue && !is_uas(p_msc)) {
     if (is_data_in(p_cbw->dir)) {
       usbd_edpt_stall(rhport, p_msc->ep_in);
     } else {
@@ -127,29 +226,106 @@ static void fail_scsi_op(uint8_t rhport, mscd_interface_t* p_msc, uint8_t status
   }
 }
 
-static inline uint32_t rdwr10_get_lba(uint8_t const command[]) {
-  // use offsetof to avoid pointer to the odd/unaligned address
+// Prepare status and data stage of the SCSI op in cbw
+static void proc_scsi_op_begin(mscd_interface_t* p_msc) {
+  msc_cbw_t const * p_cbw = &p_msc->cbw;
+  msc_csw_t       * p_csw = &p_msc->csw;
+
+  p_csw->signature    = MSC_CSW_SIGNATURE;
+  p_csw->tag          = p_cbw->tag;
+  p_csw->data_residue = 0;
+  p_csw->status       = MSC_CSW_STATUS_PASSED;
+
+  p_msc->stage = MSC_STAGE_DATA;
+  p_msc->total_len = p_cbw->total_bytes;
+  p_msc->xferred_len = 0;
+
+  p_msc->epbuf_idx = 0;
+  p_msc->xfer_len = 0;
+  p_msc->pending_io = 0;
+  tu_varclr(&p_msc->epbuf_len);
+}
+
+// Invoke complete callback of the SCSI op after its status is sent
+static void proc_scsi_op_complete(msc_cbw_t const* p_cbw) {
+  switch (p_cbw->command[0]) {
+    case SCSI_CMD_READ_10:
+    case SCSI_CMD_READ_16:
+      if (tud_msc_read10_complete_cb) {
+        tud_msc_read10_complete_cb(p_cbw->lun);
+      }
+      break;
+
+    case SCSI_CMD_WRITE_10:
+    case SCSI_CMD_WRITE_16:
+      if (tud_msc_write10_complete_cb) {
+        tud_msc_write10_complete_cb(p_cbw->lun);
+      }
+      break;
+
+    default:
+      if (tud_msc_scsi_complete_cb) {
+        tud_msc_scsi_complete_cb(p_cbw->lun, p_cbw->command);
+      }
+      break;
+  }
+}
+
+// READ10/READ16 and WRITE10/WRITE16 share the same data stage and callbacks
+static inline bool is_read_cmd(uint8_t opcode) {
+  return SCSI_CMD_READ_10 == opcode || SCSI_CMD_READ_16 == opcode;
+}
+
+static inline bool is_write_cmd(uint8_t opcode) {
+  return SCSI_CMD_WRITE_10 == opcode || SCSI_CMD_WRITE_16 == opcode;
+}
+
+static inline bool is_rdwr16_cmd(uint8_t opcode) {
+  return SCSI_CMD_READ_16 == opcode || SCSI_CMD_WRITE_16 == opcode;
+}
+
+static inline uint64_t rdwr_get_lba(uint8_t const command[]) {
+  // use offsetof to avoid pointer to the odd/unaligned address, lba is in Big Endian
+  if (is_rdwr16_cmd(command[0])) {
+    uint64_t lba;
+    memcpy(&lba, command + offsetof(scsi_write16_t, lba), sizeof(lba));
+    return msc_htonll(lba);
+  }
   const uint32_t lba = tu_unaligned_read32(command + offsetof(scsi_write10_t, lba));
-  return tu_ntohl(lba); // lba is in Big Endian
+  return tu_ntohl(lba);
 }
 
-static inline uint16_t rdwr10_get_blockcount(msc_cbw_t const* cbw) {
+static inline uint32_t rdwr_get_blockcount(msc_cbw_t const* cbw) {
+  if (is_rdwr16_cmd(cbw->command[0])) {
+    return tu_ntohl(tu_unaligned_read32(cbw->command + offsetof(scsi_write16_t, block_count)));
+  }
   uint16_t const block_count = tu_unaligned_read16(cbw->command + offsetof(scsi_write10_t, block_count));
   return tu_ntohs(block_count);
 }
 
-static inline uint16_t rdwr10_get_blocksize(msc_cbw_t const* cbw) {
+static inline uint32_t rdwr_get_blocksize(msc_cbw_t const* cbw) {
   // first extract block count in the command
-  uint16_t const block_count = rdwr10_get_blockcount(cbw);
+  uint32_t const block_count = rdwr_get_blockcount(cbw);
   if (block_count == 0) {
     return 0; // invalid block count
   }
-  return (uint16_t) (cbw->total_bytes / block_count);
+  return cbw->total_bytes / block_count;
 }
 
-static uint8_t rdwr10_validate_cmd(msc_cbw_t const* cbw) {
+// read/write callbacks use 32-bit lba, blocks of READ16/WRITE16 must be within it
+static bool rdwr_lba_in_range(msc_cbw_t const* cbw) {
+  uint64_t const lba = rdwr_get_lba(cbw->command);
+  if (lba > UINT32_MAX || lba + rdwr_get_blockcount(cbw) > ((uint64_t) UINT32_MAX) + 1) {
+    TU_LOG_DRV("  SCSI LBA out of range\r\n");
+    tud_msc_set_sense(cbw->lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x21, 0x00);
+    return false;
+  }
+  return true;
+}
+
+static uint8_t rdwr_validate_cmd(msc_cbw_t const* cbw) {
   uint8_t status = MSC_CSW_STATUS_PASSED;
-  uint16_t const block_count = rdwr10_get_blockcount(cbw);
+  uint32_t const block_count = rdwr_get_blockcount(cbw);
 
   if (cbw->total_bytes == 0) {
     if (block_count) {
@@ -159,10 +335,10 @@ static uint8_t rdwr10_validate_cmd(msc_cbw_t const* cbw) {
       // no data transfer, only exist in complaint test suite
     }
   } else {
-    if (SCSI_CMD_READ_10 == cbw->command[0] && !is_data_in(cbw->dir)) {
+    if (is_read_cmd(cbw->command[0]) && !is_data_in(cbw->dir)) {
       TU_LOG_DRV("  SCSI case 10 (Ho <> Di)\r\n");
       status = MSC_CSW_STATUS_PHASE_ERROR;
-    } else if (SCSI_CMD_WRITE_10 == cbw->command[0] && is_data_in(cbw->dir)) {
+    } else if (is_write_cmd(cbw->command[0]) && is_data_in(cbw->dir)) {
       TU_LOG_DRV("  SCSI case 8 (Hi <> Do)\r\n");
       status = MSC_CSW_STATUS_PHASE_ERROR;
     } else if (0 == block_count) {
@@ -171,6 +347,8 @@ static uint8_t rdwr10_validate_cmd(msc_cbw_t const* cbw) {
     } else if (cbw->total_bytes / block_count == 0) {
       TU_LOG_DRV(" Computed block size = 0. SCSI case 7 Hi < Di (READ10) or case 13 Ho < Do (WRIT10)\r\n");
       status = MSC_CSW_STATUS_PHASE_ERROR;
+    } else if (!rdwr_lba_in_range(cbw)) {
+      status = MSC_CSW_STATUS_FAILED;
     }
   }
 
@@ -193,7 +371,12 @@ TU_ATTR_UNUSED tu_static tu_lookup_entry_t const _msc_scsi_cmd_lookup[] = {
   { .key = SCSI_CMD_REQUEST_SENSE                , .data = "Request Sense" },
   { .key = SCSI_CMD_READ_FORMAT_CAPACITY         , .data = "Read Format Capacity" },
   { .key = SCSI_CMD_READ_10                      , .data = "Read10" },
-  { .key = SCSI_CMD_WRITE_10                     , .data = "Write10" }
+  { .key = SCSI_CMD_WRITE_10                     , .data = "Write10" },
+  { .key = SCSI_CMD_READ_16                      , .data = "Read16" },
+  { .key = SCSI_CMD_WRITE_16                     , .data = "Write16" },
+  { .key = SCSI_CMD_SERVICE_ACTION_IN_16         , .data = "Service Action In16" },
+  { .key = SCSI_CMD_UNMAP                        , .data = "Unmap" },
+  { .key = SCSI_CMD_SYNCHRONIZE_CACHE_10         , .data = "Synchronize Cache10" }
 };
 
 TU_ATTR_UNUSED tu_static tu_lookup_table_t const _msc_scsi_cmd_table = {
@@ -219,6 +402,53 @@ static inline void set_sense_medium_not_present(uint8_t lun) {
   tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x3A, 0x00);
 }
 
+// Write back cached blocks with tud_msc_sync_cache_cb(), block_count 0 is up to the last block
+static bool sync_cache(uint8_t lun, uint32_t lba, uint32_t block_count) {
+  if (tud_msc_sync_cache_cb(lun, lba, block_count)) {
+    return true;
+  }
+
+  // set default sense if not set by callback: MEDIUM ERROR, WRITE ERROR
+  if (_mscd_itf.sense_key == 0) {
+    tud_msc_set_sense(lun, SCSI_SENSE_MEDIUM_ERROR, 0x0C, 0x00);
+  }
+  return false;
+}
+
+// Process result of an asynchronous read10/write10 callback in usbd task
+static void proc_async_io_done(void* bytes_io) {
+  mscd_interface_t* p_msc = &_mscd_itf;
+  uint8_t const rhport = p_msc->rhport;
+  int32_t const nbytes = (int32_t) (intptr_t) bytes_io;
+
+  // skip if command is aborted (e.g BOT reset) while waiting
+  TU_VERIFY(p_msc->stage == MSC_STAGE_DATA,);
+
+  if (is_read_cmd(p_msc->cbw.command[0])) {
+    if (usbd_edpt_busy(rhport, p_msc->ep_in)) {
+      // prefetched while previous transfer is still on the bus, picked up when it is complete
+      p_msc->epbuf_len[p_msc->epbuf_idx] = nbytes;
+    } else {
+      proc_read10_result(rhport, p_msc, nbytes);
+    }
+  } else if (is_write_cmd(p_msc->cbw.command[0])) {
+    proc_write10_data(rhport, p_msc, true, nbytes);
+  } else {
+    // should not happen
+  }
+
+  proc_stage_status(rhport, p_msc);
+}
+
+bool tud_msc_async_io_done(int32_t bytes_io, bool in_isr) {
+  // skip if there is no pending io
+  TU_VERIFY(_mscd_itf.pending_io);
+  _mscd_itf.pending_io = 0;
+
+  usbd_defer_func(proc_async_io_done, (void*) (intptr_t) bytes_io, in_isr);
+  return true;
+}
+
 //--------------------------------------------------------------------+
 // USBD Driver API
 //--------------------------------------------------------------------+
@@ -231,7 +461,9 @@ bool mscd_deinit(void) {
 }
 
 void mscd_reset(uint8_t rhport) {
-  (void) rhport;
+  if (CFG_TUD_RHPORT_NUM > 1 && _mscd_itf.ep_in && _mscd_itf.rhport != rhport) {
+    return; // opened on other controller
+  }
   tu_memclr(&_mscd_itf, sizeof(mscd_interface_t));
 }
 
@@ -240,15 +472,24 @@ uint16_t mscd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint1
   TU_VERIFY(TUSB_CLASS_MSC    == itf_desc->bInterfaceClass &&
             MSC_SUBCLASS_SCSI == itf_desc->bInterfaceSubClass &&
             MSC_PROTOCOL_BOT  == itf_desc->bInterfaceProtocol, 0);
-  uint16_t const drv_len = sizeof(tusb_desc_interface_t) + 2*sizeof(tusb_desc_endpoint_t);
+  uint16_t drv_len = sizeof(tusb_desc_interface_t) + 2*sizeof(tusb_desc_endpoint_t);
   TU_ASSERT(max_len >= drv_len, 0); // Max length must be at least 1 interface + 2 endpoints
 
   mscd_interface_t * p_msc = &_mscd_itf;
+  TU_VERIFY(p_msc->ep_in == 0, 0); // single interface, may be opened on other controller
+  p_msc->rhport = rhport;
   p_msc->itf_num = itf_desc->bInterfaceNumber;
 
   // Open endpoint pair
   TU_ASSERT(usbd_open_edpt_pair(rhport, tu_desc_next(itf_desc), 2, TUSB_XFER_BULK, &p_msc->ep_out, &p_msc->ep_in), 0);
 
+  #if CFG_TUD_MSC_UAS
+  p_msc->ep_bot_in  = p_msc->ep_in;
+  p_msc->ep_bot_out = p_msc->ep_out;
+  drv_len = (uint16_t) (drv_len + uas_open(rhport, p_msc, (tusb_desc_interface_t const*) ((uintptr_t) itf_desc + drv_len),
+                                           (uint16_t) (max_len - drv_len)));
+  #endif
+
   // Prepare for Command Block Wrapper
   TU_ASSERT(prepare_cbw(rhport, p_msc), drv_len);
 
@@ -305,6 +546,29 @@ bool mscd_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t
     return true;
   }
 
+  #if CFG_TUD_MSC_UAS
+  // Alternate 1 is UAS
+  if (TUSB_REQ_TYPE_STANDARD == request->bmRequestType_bit.type &&
+      TUSB_REQ_RCPT_INTERFACE == request->bmRequestType_bit.recipient) {
+    switch (request->bRequest) {
+      case TUSB_REQ_GET_INTERFACE: {
+        uint8_t alternate = p_msc->uas ? 1 : 0;
+        tud_control_xfer(rhport, request, &alternate, 1);
+        return true;
+      }
+
+      case TUSB_REQ_SET_INTERFACE:
+        TU_VERIFY(request->wValue == 0 || (request->wValue == 1 && p_msc->ep_cmd));
+        TU_LOG_DRV("  MSC Set Interface %s\r\n", request->wValue ? "UAS" : "BOT");
+        uas_select(rhport, p_msc, request->wValue == 1);
+        tud_control_status(rhport, request);
+        return true;
+
+      default: return false;
+    }
+  }
+  #endif
+
   // From this point only handle class request only
   TU_VERIFY(request->bmRequestType_bit.type == TUSB_REQ_TYPE_CLASS);
 
@@ -341,13 +605,22 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
 
   mscd_interface_t* p_msc = &_mscd_itf;
   msc_cbw_t * p_cbw = &p_msc->cbw;
-  msc_csw_t * p_csw = &p_msc->csw;
+  TU_VERIFY(p_msc->rhport == rhport);
+
+  #if CFG_TUD_MSC_UAS
+  // command & status pipe, data pipes are processed below in the same way as BOT
+  if (p_msc->uas && (ep_addr == p_msc->ep_cmd || ep_addr == p_msc->ep_status)) {
+    uas_xfer_cb(rhport, p_msc, ep_addr, xferred_bytes);
+    return true;
+  }
+  #endif
 
   switch (p_msc->stage) {
     case MSC_STAGE_CMD:
       //------------- new CBW received -------------//
-      // Complete IN while waiting for CMD is usually Status of previous SCSI op, ignore it
-      if (ep_addr != p_msc->ep_out) {
+      // Complete IN while waiting for CMD is usually Status of previous SCSI op, ignore it.
+      // UAS commands come from command pipe
+      if (ep_addr != p_msc->ep_out || is_uas(p_msc)) {
         return true;
       }
 
@@ -367,25 +640,18 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
       TU_LOG_DRV("  SCSI Command [Lun%u]: %s\r\n", p_cbw->lun, tu_lookup_find(&_msc_scsi_cmd_table, p_cbw->command[0]));
       //TU_LOG_MEM(MSC_DEBUG, p_cbw, xferred_bytes, 2);
 
-      p_csw->signature    = MSC_CSW_SIGNATURE;
-      p_csw->tag          = p_cbw->tag;
-      p_csw->data_residue = 0;
-      p_csw->status       = MSC_CSW_STATUS_PASSED;
-
       /*------------- Parse command and prepare DATA -------------*/
-      p_msc->stage = MSC_STAGE_DATA;
-      p_msc->total_len = p_cbw->total_bytes;
-      p_msc->xferred_len = 0;
+      proc_scsi_op_begin(p_msc);
 
-      // Read10 or Write10
-      if ((SCSI_CMD_READ_10 == p_cbw->command[0]) || (SCSI_CMD_WRITE_10 == p_cbw->command[0])) {
-        uint8_t const status = rdwr10_validate_cmd(p_cbw);
+      // Read10/16 or Write10/16
+      if (is_read_cmd(p_cbw->command[0]) || is_write_cmd(p_cbw->command[0])) {
+        uint8_t const status = rdwr_validate_cmd(p_cbw);
 
         if (status != MSC_CSW_STATUS_PASSED) {
           fail_scsi_op(rhport, p_msc, status);
         } else if (p_cbw->total_bytes) {
-          if (SCSI_CMD_READ_10 == p_cbw->command[0]) {
-            proc_read10_cmd(rhport, p_msc);
+          if (is_read_cmd(p_cbw->command[0])) {
+            proc_read10_begin(rhport, p_msc);
           } else {
             proc_write10_cmd(rhport, p_msc);
           }
@@ -447,23 +713,30 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
       TU_LOG_DRV("  SCSI Data [Lun%u]\r\n", p_cbw->lun);
       //TU_LOG_MEM(MSC_DEBUG, _mscd_epbuf.buf, xferred_bytes, 2);
 
-      if (SCSI_CMD_READ_10 == p_cbw->command[0]) {
+      if (is_read_cmd(p_cbw->command[0])) {
         p_msc->xferred_len += xferred_bytes;
 
         if ( p_msc->xferred_len >= p_msc->total_len ) {
           // Data Stage is complete
           p_msc->stage = MSC_STAGE_STATUS;
-        }else {
+        } else if (!p_msc->pending_io) {
           proc_read10_cmd(rhport, p_msc);
+        } else {
+          // prefetch is waiting for tud_msc_async_io_done()
         }
-      } else if (SCSI_CMD_WRITE_10 == p_cbw->command[0]) {
+      } else if (is_write_cmd(p_cbw->command[0])) {
         proc_write10_new_data(rhport, p_msc, xferred_bytes);
       } else {
         p_msc->xferred_len += xferred_bytes;
 
         // OUT transfer, invoke callback if needed
         if ( !is_data_in(p_cbw->dir) ) {
-          int32_t cb_result = tud_msc_scsi_cb(p_cbw->lun, p_cbw->command, _mscd_epbuf.buf, (uint16_t) p_msc->total_len);
+          int32_t cb_result;
+          if (SCSI_CMD_UNMAP == p_cbw->command[0] && tud_msc_unmap_cb) {
+            cb_result = proc_unmap(p_cbw->lun, _mscd_epbuf.buf, p_msc->xferred_len);
+          } else {
+            cb_result = tud_msc_scsi_cb(p_cbw->lun, p_cbw->command, _mscd_epbuf.buf, (uint16_t) p_msc->total_len);
+          }
 
           if ( cb_result < 0 ) {
             // unsupported command
@@ -490,32 +763,14 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
 
     case MSC_STAGE_STATUS_SENT:
       // Wait for the Status phase to complete
-      if ((ep_addr == p_msc->ep_in) && (xferred_bytes == sizeof(msc_csw_t))) {
-        TU_LOG_DRV("  SCSI Status [Lun%u] = %u\r\n", p_cbw->lun, p_csw->status);
-        // TU_LOG_MEM(MSC_DEBUG, p_csw, xferred_bytes, 2);
+      if ((ep_addr == p_msc->ep_in) && (xferred_bytes == sizeof(msc_csw_t)) && !is_uas(p_msc)) {
+        TU_LOG_DRV("  SCSI Status [Lun%u] = %u\r\n", p_cbw->lun, p_msc->csw.status);
+        // TU_LOG_MEM(MSC_DEBUG, &p_msc->csw, xferred_bytes, 2);
 
         // Invoke complete callback if defined
         // Note: There is racing issue with samd51 + qspi flash testing with arduino
         // if complete_cb() is invoked after queuing the status.
-        switch (p_cbw->command[0]) {
-          case SCSI_CMD_READ_10:
-            if (tud_msc_read10_complete_cb) {
-              tud_msc_read10_complete_cb(p_cbw->lun);
-            }
-            break;
-
-          case SCSI_CMD_WRITE_10:
-            if (tud_msc_write10_complete_cb) {
-              tud_msc_write10_complete_cb(p_cbw->lun);
-            }
-            break;
-
-          default:
-            if (tud_msc_scsi_complete_cb) {
-              tud_msc_scsi_complete_cb(p_cbw->lun, p_cbw->command);
-            }
-            break;
-        }
+        proc_scsi_op_complete(p_cbw);
 
         TU_ASSERT(prepare_cbw(rhport, p_msc));
       } else {
@@ -527,6 +782,22 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
     default: break;
   }
 
+  proc_stage_status(rhport, p_msc);
+
+  return true;
+}
+
+// Send status (CSW) if data stage is complete
+static void proc_stage_status(uint8_t rhport, mscd_interface_t* p_msc) {
+  msc_cbw_t const* p_cbw = &p_msc->cbw;
+
+  #if CFG_TUD_MSC_UAS
+  if (p_msc->uas) {
+    uas_status_kick(rhport, p_msc);
+    return;
+  }
+  #endif
+
   if (p_msc->stage == MSC_STAGE_STATUS) {
     // skip status if epin is currently stalled, will do it when received Clear Stall request
     if (!usbd_edpt_stalled(rhport, p_msc->ep_in)) {
@@ -535,7 +806,7 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
         // TU_LOG(MSC_DEBUG, "  SCSI case 5 (Hi > Di): %lu > %lu\r\n", p_cbw->total_bytes, p_msc->xferred_len);
         usbd_edpt_stall(rhport, p_msc->ep_in);
       } else {
-        TU_ASSERT(send_csw(rhport, p_msc));
+        TU_ASSERT(send_csw(rhport, p_msc),);
       }
     }
 
@@ -549,14 +820,120 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
     }
     #endif
   }
-
-  return true;
 }
 
 /*------------------------------------------------------------------*/
 /* SCSI Command Process
  *------------------------------------------------------------------*/
 
+// Get capacity from application, false with sense set if unit is not ready
+static bool get_capacity(uint8_t lun, uint32_t* block_count, uint16_t* block_size) {
+  *block_count = 0;
+  *block_size = 0;
+  tud_msc_capacity_cb(lun, block_count, block_size);
+
+  // Invalid block size/count from callback, possibly unit is not ready
+  // stall this request, set sense key to NOT READY
+  if (*block_count == 0 || *block_size == 0) {
+    // set default sense if not set by callback
+    if (_mscd_itf.sense_key == 0) {
+      set_sense_medium_not_present(lun);
+    }
+    return false;
+  }
+
+  return true;
+}
+
+// Vital product data pages for logical block provisioning, return -1 for other pages
+static int32_t proc_inquiry_vpd(uint8_t page_code, uint8_t* buffer, uint32_t bufsize) {
+  uint8_t page[64];
+  uint16_t page_len;
+  tu_memclr(page, sizeof(page));
+  page[1] = page_code;
+
+  switch (page_code) {
+    case SCSI_VPD_PAGE_SUPPORTED:
+      page_len = 3;
+      page[4] = SCSI_VPD_PAGE_SUPPORTED;
+      page[5] = SCSI_VPD_PAGE_BLOCK_LIMITS;
+      page[6] = SCSI_VPD_PAGE_LOGICAL_PROVISIONING;
+      break;
+
+    case SCSI_VPD_PAGE_BLOCK_LIMITS: {
+      // maximum unmap lba count (no limit) and block descriptor count (parameter list must fit in buffer)
+      uint32_t const max_desc = (CFG_TUD_MSC_EP_BUFSIZE - sizeof(scsi_unmap_param_header_t)) / sizeof(scsi_unmap_block_desc_t);
+      page_len = 0x3c;
+      tu_unaligned_write32(page + 20, tu_htonl(UINT32_MAX));
+      tu_unaligned_write32(page + 24, tu_htonl(max_desc));
+      break;
+    }
+
+    case SCSI_VPD_PAGE_LOGICAL_PROVISIONING:
+      page_len = 4;
+      page[5] = 0x80; // LBPU: UNMAP is supported
+      page[6] = 0x02; // thin provisioned
+      break;
+
+    default:
+      return -1;
+  }
+
+  tu_unaligned_write16(page + 2, tu_htons(page_len));
+
+  int32_t const resplen = 4 + page_len;
+  TU_VERIFY(0 == tu_memcpy_s(buffer, bufsize, page, (size_t) resplen), -1);
+  return resplen;
+}
+
+// Invoke tud_msc_unmap_cb() for each block descriptor of UNMAP parameter list. Negative if failed with sense set
+static int32_t proc_unmap(uint8_t lun, uint8_t const* buf, uint32_t len) {
+  scsi_unmap_param_header_t header;
+  if (len < sizeof(header)) {
+    return 0; // no block descriptor
+  }
+  memcpy(&header, buf, sizeof(header));
+
+  uint32_t const desc_len = tu_ntohs(header.block_desc_len);
+  if (desc_len > len - sizeof(header)) {
+    // Invalid field in parameter list
+    tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x26, 0x00);
+    return -1;
+  }
+
+  uint32_t block_count;
+  uint16_t block_size;
+  if (!get_capacity(lun, &block_count, &block_size)) {
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < desc_len / sizeof(scsi_unmap_block_desc_t); i++) {
+    scsi_unmap_block_desc_t desc;
+    memcpy(&desc, buf + sizeof(header) + i * sizeof(desc), sizeof(desc));
+
+    uint64_t const lba = msc_htonll(desc.lba);
+    uint32_t const count = tu_ntohl(desc.block_count);
+    if (count == 0) {
+      continue;
+    }
+
+    if (lba >= block_count || count > block_count - lba) {
+      // LBA out of range
+      tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x21, 0x00);
+      return -1;
+    }
+
+    if (!tud_msc_unmap_cb(lun, (uint32_t) lba, count)) {
+      if (_mscd_itf.sense_key == 0) {
+        set_sense_medium_not_present(lun);
+      }
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
 // return response's length (copied to buffer). Negative if it is not an built-in command or indicate Failed status (CSW)
 // In case of a failed status, sense key must be set for reason of failure
 static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buffer, uint32_t bufsize) {
@@ -579,11 +956,17 @@ static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_
       }
       break;
 
-    case SCSI_CMD_START_STOP_UNIT:
+    case SCSI_CMD_START_STOP_UNIT: {
+      scsi_start_stop_unit_t const* start_stop = (scsi_start_stop_unit_t const*)scsi_cmd;
       resplen = 0;
 
+      // write back cache before stopping or ejecting unless host asks not to
+      if (tud_msc_sync_cache_cb && !start_stop->start && !start_stop->no_flush && !sync_cache(lun, 0, 0)) {
+        resplen = -1;
+        break;
+      }
+
       if (tud_msc_start_stop_cb) {
-        scsi_start_stop_unit_t const* start_stop = (scsi_start_stop_unit_t const*)scsi_cmd;
         if (!tud_msc_start_stop_cb(lun, start_stop->power_condition, start_stop->start, start_stop->load_eject)) {
           // Failed status response
           resplen = -1;
@@ -594,6 +977,17 @@ static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_
           }
         }
       }
+    }
+    break;
+
+    case SCSI_CMD_SYNCHRONIZE_CACHE_10:
+      if (!tud_msc_sync_cache_cb) {
+        resplen = -1; // passed to application
+      } else {
+        uint32_t const lba = tu_ntohl(tu_unaligned_read32(scsi_cmd + 2));
+        uint16_t const block_count = tu_ntohs(tu_unaligned_read16(scsi_cmd + 7));
+        resplen = sync_cache(lun, lba, block_count) ? 0 : -1;
+      }
       break;
 
     case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
@@ -616,21 +1010,10 @@ static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_
 
     case SCSI_CMD_READ_CAPACITY_10: {
       uint32_t block_count;
-      uint32_t block_size;
-      uint16_t block_size_u16;
-
-      tud_msc_capacity_cb(lun, &block_count, &block_size_u16);
-      block_size = (uint32_t)block_size_u16;
+      uint16_t block_size;
 
-      // Invalid block size/count from callback, possibly unit is not ready
-      // stall this request, set sense key to NOT READY
-      if (block_count == 0 || block_size == 0) {
+      if (!get_capacity(lun, &block_count, &block_size)) {
         resplen = -1;
-
-        // set default sense if not set by callback
-        if (p_msc->sense_key == 0) {
-          set_sense_medium_not_present(lun);
-        }
       } else {
         scsi_read_capacity10_resp_t read_capa10;
 
@@ -643,6 +1026,30 @@ static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_
     }
     break;
 
+    case SCSI_CMD_SERVICE_ACTION_IN_16: {
+      uint32_t block_count;
+      uint16_t block_size;
+
+      if ((scsi_cmd[1] & 0x1f) != SCSI_SERVICE_ACTION_READ_CAPACITY_16) {
+        resplen = -1; // other service actions are passed to application
+      } else if (!get_capacity(lun, &block_count, &block_size)) {
+        resplen = -1;
+      } else {
+        scsi_read_capacity16_resp_t read_capa16;
+        tu_memclr(&read_capa16, sizeof(read_capa16));
+
+        read_capa16.last_lba = msc_htonll(block_count-1);
+        read_capa16.block_size = tu_htonl(block_size);
+        if (tud_msc_unmap_cb) {
+          read_capa16.reserved[2] = 0x80; // LBPME: logical block provisioning (UNMAP) is enabled
+        }
+
+        resplen = sizeof(read_capa16);
+        TU_VERIFY(0 == tu_memcpy_s(buffer, bufsize, &read_capa16, (size_t) resplen));
+      }
+    }
+    break;
+
     case SCSI_CMD_READ_FORMAT_CAPACITY: {
       scsi_read_format_capacity_data_t read_fmt_capa =
       {
@@ -655,17 +1062,8 @@ static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_
       uint32_t block_count;
       uint16_t block_size;
 
-      tud_msc_capacity_cb(lun, &block_count, &block_size);
-
-      // Invalid block size/count from callback, possibly unit is not ready
-      // stall this request, set sense key to NOT READY
-      if (block_count == 0 || block_size == 0) {
+      if (!get_capacity(lun, &block_count, &block_size)) {
         resplen = -1;
-
-        // set default sense if not set by callback
-        if (p_msc->sense_key == 0) {
-          set_sense_medium_not_present(lun);
-        }
       } else {
         read_fmt_capa.block_num = tu_htonl(block_count);
         read_fmt_capa.block_size_u16 = tu_htons(block_size);
@@ -676,7 +1074,18 @@ static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_
     }
     break;
 
+    case SCSI_CMD_UNMAP:
+      // parameter list with data is processed in data stage, there is nothing to unmap without it
+      resplen = tud_msc_unmap_cb ? 0 : -1;
+      break;
+
     case SCSI_CMD_INQUIRY: {
+      if ((scsi_cmd[1] & 0x01) && tud_msc_unmap_cb) {
+        // EVPD: pages required by host to use UNMAP, others (e.g serial number) are passed to application
+        resplen = proc_inquiry_vpd(scsi_cmd[2], buffer, bufsize);
+        break;
+      }
+
       scsi_inquiry_resp_t inquiry_rsp =
       {
         .is_removable = 1,
@@ -690,6 +1099,11 @@ static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_
       memset(inquiry_rsp.product_id , ' ', sizeof(inquiry_rsp.product_id));
       memset(inquiry_rsp.product_rev, ' ', sizeof(inquiry_rsp.product_rev));
 
+      if (tud_msc_unmap_cb) {
+        // SPC-3 so that host asks READ CAPACITY (16) and VPD pages to find out UNMAP support
+        inquiry_rsp.version = 5;
+      }
+
       tud_msc_inquiry_cb(lun, inquiry_rsp.vendor_id, inquiry_rsp.product_id, inquiry_rsp.product_rev);
 
       resplen = sizeof(inquiry_rsp);
@@ -714,8 +1128,26 @@ static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_
 
       mode_resp.write_protected = !writable;
 
+      scsi_mode_sense6_t const* mode_sense = (scsi_mode_sense6_t const*) scsi_cmd;
+      bool const has_caching = tud_msc_sync_cache_cb &&
+                               (mode_sense->page_code == SCSI_MODE_PAGE_CACHING || mode_sense->page_code == SCSI_MODE_PAGE_ALL);
+      if (has_caching) {
+        mode_resp.data_len += sizeof(scsi_mode_page_caching_t);
+      }
+
       resplen = sizeof(mode_resp);
       TU_VERIFY(0 == tu_memcpy_s(buffer, bufsize, &mode_resp, (size_t) resplen));
+
+      if (has_caching) {
+        scsi_mode_page_caching_t caching;
+        tu_memclr(&caching, sizeof(caching));
+        caching.page_code = SCSI_MODE_PAGE_CACHING;
+        caching.page_length = sizeof(scsi_mode_page_caching_t) - 2;
+        caching.write_cache_enable = (mode_sense->page_control != 1); // WCE is not changeable
+
+        TU_VERIFY(0 == tu_memcpy_s(buffer + resplen, bufsize - (uint32_t) resplen, &caching, sizeof(caching)));
+        resplen += (int32_t) sizeof(caching);
+      }
     }
     break;
 
@@ -751,21 +1183,97 @@ static int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_
   return resplen;
 }
 
-static void proc_read10_cmd(uint8_t rhport, mscd_interface_t* p_msc) {
+// Invoke application to read data at position (in bytes) of the data stage into buffer
+static int32_t read10_invoke_cb(mscd_interface_t const* p_msc, uint32_t pos, uint8_t* buffer) {
   msc_cbw_t const* p_cbw = &p_msc->cbw;
 
-  // block size already verified not zero
-  uint16_t const block_sz = rdwr10_get_blocksize(p_cbw);
+  // block size already verified not zero, lba within 32-bit
+  uint32_t const block_sz = rdwr_get_blocksize(p_cbw);
 
   // Adjust lba with transferred bytes
-  uint32_t const lba = rdwr10_get_lba(p_cbw->command) + (p_msc->xferred_len / block_sz);
+  uint32_t const lba = (uint32_t) rdwr_get_lba(p_cbw->command) + (pos / block_sz);
 
   // remaining bytes capped at class buffer
-  int32_t nbytes = (int32_t)tu_min32(CFG_TUD_MSC_EP_BUFSIZE, p_cbw->total_bytes - p_msc->xferred_len);
+  uint32_t const nbytes = tu_min32(CFG_TUD_MSC_EP_BUFSIZE, p_cbw->total_bytes - pos);
 
   // Application can consume smaller bytes
-  uint32_t const offset = p_msc->xferred_len % block_sz;
-  nbytes = tud_msc_read10_cb(p_cbw->lun, lba, offset, _mscd_epbuf.buf, (uint32_t)nbytes);
+  uint32_t const offset = pos % block_sz;
+  return tud_msc_read10_cb(p_cbw->lun, lba, offset, buffer, nbytes);
+}
+
+// Start data stage of a READ10/16, hint application of the next blocks if it continues the previous read
+static void proc_read10_begin(uint8_t rhport, mscd_interface_t* p_msc) {
+  msc_cbw_t const* p_cbw = &p_msc->cbw;
+  uint32_t const lba = (uint32_t) rdwr_get_lba(p_cbw->command);
+  uint32_t const block_count = rdwr_get_blockcount(p_cbw);
+  uint64_t const end_lba = (uint64_t) lba + block_count; // within 32-bit + 1, verified by rdwr_lba_in_range()
+
+  bool const sequential = p_msc->read_end_valid && p_msc->read_end_lun == p_cbw->lun && p_msc->read_end_lba == lba;
+  p_msc->read_end_valid = (end_lba <= UINT32_MAX);
+  p_msc->read_end_lun = p_cbw->lun;
+  p_msc->read_end_lba = (uint32_t) end_lba;
+
+  if (sequential && p_msc->read_end_valid && tud_msc_read_ahead_cb) {
+    tud_msc_read_ahead_cb(p_cbw->lun, p_msc->read_end_lba, block_count);
+  }
+
+  proc_read10_cmd(rhport, p_msc);
+}
+
+// Zero-copy READ10/16: transfer directly from memory mapped medium provided by tud_msc_read10_ptr_cb().
+// Return false if application reads with tud_msc_read10_cb() instead
+static bool proc_read10_ptr(uint8_t rhport, mscd_interface_t* p_msc) {
+  msc_cbw_t const* p_cbw = &p_msc->cbw;
+  uint32_t const pos = p_msc->xferred_len;
+  uint32_t const block_sz = rdwr_get_blocksize(p_cbw);
+  uint32_t const lba = (uint32_t) rdwr_get_lba(p_cbw->command) + (pos / block_sz);
+
+  // remaining bytes capped at what can be submitted with a single transfer
+  uint32_t const xfer_max = (CFG_TUD_EDPT_XFER_LARGE ? UINT32_MAX : TUP_DCD_EDPT_XFER_MAX);
+  uint32_t const bufsize = tu_min32(xfer_max, p_cbw->total_bytes - pos);
+
+  void const* buffer = NULL;
+  int32_t const nbytes = tud_msc_read10_ptr_cb(p_cbw->lun, lba, pos % block_sz, &buffer, bufsize);
+
+  if (nbytes == TUD_MSC_RET_UNMAPPED) {
+    return false;
+  } else if (nbytes > 0 && buffer != NULL) {
+    uint32_t const xfer_len = tu_min32((uint32_t) nbytes, bufsize);
+    TU_ASSERT(usbd_edpt_xfer(rhport, p_msc->ep_in, (uint8_t*) (uintptr_t) buffer, xfer_len), true);
+  } else {
+    // busy or error, async is not supported
+    proc_read10_result(rhport, p_msc, (nbytes == TUD_MSC_RET_ASYNC || nbytes > 0) ? TUD_MSC_RET_ERROR : nbytes);
+  }
+
+  return true;
+}
+
+static void proc_read10_cmd(uint8_t rhport, mscd_interface_t* p_msc) {
+  uint8_t const idx = p_msc->epbuf_idx;
+  int32_t nbytes;
+
+  if (p_msc->epbuf_len[idx]) {
+    // data (or error) is already prefetched while previous transfer was on the bus
+    nbytes = p_msc->epbuf_len[idx];
+    p_msc->epbuf_len[idx] = 0;
+  } else if (tud_msc_read10_ptr_cb && proc_read10_ptr(rhport, p_msc)) {
+    return;
+  } else {
+    nbytes = read10_invoke_cb(p_msc, p_msc->xferred_len, get_epbuf(idx));
+  }
+
+  if (nbytes == TUD_MSC_RET_ASYNC) {
+    // result will be provided by tud_msc_async_io_done()
+    p_msc->pending_io = 1;
+  } else {
+    proc_read10_result(rhport, p_msc, nbytes);
+  }
+}
+
+// process result of read10 callback for current buffer
+static void proc_read10_result(uint8_t rhport, mscd_interface_t* p_msc, int32_t nbytes) {
+  msc_cbw_t const* p_cbw = &p_msc->cbw;
+  uint8_t const idx = p_msc->epbuf_idx;
 
   if (nbytes < 0) {
     // negative means error -> endpoint is stalled & status in CSW set to failed
@@ -779,7 +1287,22 @@ static void proc_read10_cmd(uint8_t rhport, mscd_interface_t* p_msc) {
     // zero means not ready -> simulate an transfer complete so that this driver callback will fired again
     dcd_event_xfer_complete(rhport, p_msc->ep_in, 0, XFER_RESULT_SUCCESS, false);
   } else {
-    TU_ASSERT(usbd_edpt_xfer(rhport, p_msc->ep_in, _mscd_epbuf.buf, (uint16_t) nbytes),);
+    TU_ASSERT(usbd_edpt_xfer(rhport, p_msc->ep_in, get_epbuf(idx), (uint16_t) nbytes),);
+
+    #if CFG_TUD_MSC_DOUBLE_BUFFER
+    // prefetch next chunk into the other buffer while this one is on the bus.
+    // If application is not ready (return 0), it is invoked again when this transfer is complete
+    uint32_t const next_pos = p_msc->xferred_len + (uint32_t) nbytes;
+    p_msc->epbuf_idx = next_epbuf(idx);
+    if (next_pos < p_msc->total_len) {
+      int32_t const ret = read10_invoke_cb(p_msc, next_pos, get_epbuf(p_msc->epbuf_idx));
+      if (ret == TUD_MSC_RET_ASYNC) {
+        p_msc->pending_io = 1;
+      } else {
+        p_msc->epbuf_len[p_msc->epbuf_idx] = ret;
+      }
+    }
+    #endif
   }
 }
 
@@ -799,62 +1322,487 @@ static void proc_write10_cmd(uint8_t rhport, mscd_interface_t* p_msc) {
     return;
   }
 
+  TU_ASSERT(write10_queue_next(rhport, p_msc),);
+}
+
+// Queue reception of next WRITE10 chunk if there is a free buffer and no transfer is queued yet
+static bool write10_queue_next(uint8_t rhport, mscd_interface_t* p_msc) {
+  if (p_msc->xfer_len) {
+    return true; // already queued
+  }
+
+  // bytes received so far = consumed + pending in buffers
+  uint32_t pos = p_msc->xferred_len;
+  for (uint8_t i = 0; i < MSC_EPBUF_COUNT; i++) {
+    pos += (uint32_t) p_msc->epbuf_len[i];
+  }
+  if (pos >= p_msc->total_len) {
+    return true; // all data is received
+  }
+
+  // buffers are consumed in order: receive into the oldest one if empty, otherwise the next one
+  uint8_t idx = p_msc->epbuf_idx;
+  if (p_msc->epbuf_len[idx]) {
+    idx = next_epbuf(idx);
+    if (p_msc->epbuf_len[idx]) {
+      return true; // all buffers are in use
+    }
+  }
+
   // remaining bytes capped at class buffer
-  uint16_t nbytes = (uint16_t)tu_min32(CFG_TUD_MSC_EP_BUFSIZE, p_cbw->total_bytes - p_msc->xferred_len);
+  p_msc->xfer_idx = idx;
+  p_msc->xfer_len = (uint16_t) tu_min32(CFG_TUD_MSC_EP_BUFSIZE, p_msc->total_len - pos);
 
   // Write10 callback will be called later when usb transfer complete
-  TU_ASSERT(usbd_edpt_xfer(rhport, p_msc->ep_out, _mscd_epbuf.buf, nbytes),);
+  return usbd_edpt_xfer(rhport, p_msc->ep_out, get_epbuf(idx), p_msc->xfer_len);
 }
 
 // process new data arrived from WRITE10
 static void proc_write10_new_data(uint8_t rhport, mscd_interface_t* p_msc, uint32_t xferred_bytes) {
+  // complete event without a queued transfer is a simulated one to retry pending data
+  if (p_msc->xfer_len) {
+    p_msc->epbuf_len[p_msc->xfer_idx] = (int32_t) xferred_bytes;
+    p_msc->xfer_len = 0;
+  }
+
+  // keep receiving from host while application consumes data (if there is a free buffer)
+  TU_ASSERT(write10_queue_next(rhport, p_msc),);
+
+  if (!p_msc->pending_io) {
+    proc_write10_data(rhport, p_msc, false, 0);
+  }
+}
+
+// Invoke write10 callback to consume received data in order.
+// If has_result is true, result is the return of an asynchronous callback for the oldest buffer
+static void proc_write10_data(uint8_t rhport, mscd_interface_t* p_msc, bool has_result, int32_t result) {
   msc_cbw_t const* p_cbw = &p_msc->cbw;
 
-  // block size already verified not zero
-  uint16_t const block_sz = rdwr10_get_blocksize(p_cbw);
+  // block size already verified not zero, lba within 32-bit
+  uint32_t const block_sz = rdwr_get_blocksize(p_cbw);
 
-  // Adjust lba with transferred bytes
-  uint32_t const lba = rdwr10_get_lba(p_cbw->command) + (p_msc->xferred_len / block_sz);
+  while (p_msc->epbuf_len[p_msc->epbuf_idx] > 0) {
+    uint8_t* buffer = get_epbuf(p_msc->epbuf_idx);
+    uint32_t const buf_len = (uint32_t) p_msc->epbuf_len[p_msc->epbuf_idx];
+    int32_t nbytes;
 
-  // Invoke callback to consume new data
-  uint32_t const offset = p_msc->xferred_len % block_sz;
-  int32_t nbytes = tud_msc_write10_cb(p_cbw->lun, lba, offset, _mscd_epbuf.buf, xferred_bytes);
+    if (has_result) {
+      nbytes = result;
+      has_result = false;
+    } else if (is_uas(p_msc) && p_msc->csw.status != MSC_CSW_STATUS_PASSED) {
+      // already failed: discard the rest of data announced by Write Ready IU
+      nbytes = (int32_t) buf_len;
+    } else {
+      // Adjust lba with transferred bytes
+      uint32_t const lba = (uint32_t) rdwr_get_lba(p_cbw->command) + (p_msc->xferred_len / block_sz);
 
-  if (nbytes < 0) {
-    // negative means error -> failed this scsi op
-    TU_LOG_DRV("  tud_msc_write10_cb() return -1\r\n");
+      // Invoke callback to consume new data
+      uint32_t const offset = p_msc->xferred_len % block_sz;
+      nbytes = tud_msc_write10_cb(p_cbw->lun, lba, offset, buffer, buf_len);
 
-    // update actual byte before failed
-    p_msc->xferred_len += xferred_bytes;
+      if (nbytes == TUD_MSC_RET_ASYNC) {
+        // result will be provided by tud_msc_async_io_done()
+        p_msc->pending_io = 1;
+        return;
+      }
+    }
 
-    // Set sense
-    set_sense_medium_not_present(p_cbw->lun);
+    if (nbytes < 0) {
+      // negative means error -> failed this scsi op
+      TU_LOG_DRV("  tud_msc_write10_cb() return -1\r\n");
 
-    fail_scsi_op(rhport, p_msc, MSC_CSW_STATUS_FAILED);
-  } else {
-    // Application consume less than what we got (including zero)
-    if ((uint32_t)nbytes < xferred_bytes) {
-      uint32_t const left_over = xferred_bytes - (uint32_t)nbytes;
-      if (nbytes > 0) {
-        p_msc->xferred_len += (uint16_t)nbytes;
-        memmove(_mscd_epbuf.buf, _mscd_epbuf.buf + nbytes, left_over);
+      // update actual byte before failed
+      p_msc->xferred_len += buf_len;
+      p_msc->epbuf_len[p_msc->epbuf_idx] = 0;
+
+      // Set sense
+      set_sense_medium_not_present(p_cbw->lun);
+
+      if (is_uas(p_msc)) {
+        // host sends all data announced by Write Ready IU without stall: receive it, report failure in Sense IU
+        p_msc->csw.status = MSC_CSW_STATUS_FAILED;
+        p_msc->epbuf_idx = next_epbuf(p_msc->epbuf_idx);
+        TU_ASSERT(write10_queue_next(rhport, p_msc),);
+        continue;
       }
 
-      // simulate an transfer complete with adjusted parameters --> callback will be invoked with adjusted parameter
-      dcd_event_xfer_complete(rhport, p_msc->ep_out, left_over, XFER_RESULT_SUCCESS, false);
-    } else {
-      // Application consume all bytes in our buffer
-      p_msc->xferred_len += xferred_bytes;
+      fail_scsi_op(rhport, p_msc, MSC_CSW_STATUS_FAILED);
+      return;
+    }
+
+    // application cannot consume more than what we got
+    uint32_t const consumed = tu_min32((uint32_t) nbytes, buf_len);
+    p_msc->xferred_len += consumed;
+
+    if (consumed < buf_len) {
+      // Application consume less than what we got (including zero), keep the rest for later
+      uint32_t const left_over = buf_len - consumed;
+      if (consumed > 0) {
+        memmove(buffer, buffer + consumed, left_over);
+      }
+      p_msc->epbuf_len[p_msc->epbuf_idx] = (int32_t) left_over;
+      break;
+    }
+
+    // buffer is fully consumed: move to the next one and use this for receiving
+    p_msc->epbuf_len[p_msc->epbuf_idx] = 0;
+    p_msc->epbuf_idx = next_epbuf(p_msc->epbuf_idx);
+    TU_ASSERT(write10_queue_next(rhport, p_msc),);
+  }
 
-      if (p_msc->xferred_len >= p_msc->total_len) {
-        // Data Stage is complete
-        p_msc->stage = MSC_STAGE_STATUS;
+  if (p_msc->epbuf_len[p_msc->epbuf_idx]) {
+    // pending data is retried when the queued transfer complete. If there is none,
+    // simulate an transfer complete so that this driver callback will fired again
+    if (!p_msc->xfer_len) {
+      dcd_event_xfer_complete(rhport, p_msc->ep_out, 0, XFER_RESULT_SUCCESS, false);
+    }
+  } else if (p_msc->xferred_len >= p_msc->total_len) {
+    // Data Stage is complete. Force Unit Access: data must be on the medium before status
+    if (tud_msc_sync_cache_cb && (p_cbw->command[1] & 0x08) && p_msc->csw.status == MSC_CSW_STATUS_PASSED &&
+        !sync_cache(p_cbw->lun, (uint32_t) rdwr_get_lba(p_cbw->command), rdwr_get_blockcount(p_cbw))) {
+      p_msc->csw.status = MSC_CSW_STATUS_FAILED;
+    }
+    p_msc->stage = MSC_STAGE_STATUS;
+  }
+}
+
+//--------------------------------------------------------------------+
+// USB Attached SCSI (UAS)
+// Command IUs are queued as they arrive on command pipe and executed one at a time with the BOT data stage code on
+// UAS data pipes. Without streams, device announces data stage with Read/Write Ready IU and ends the command with
+// Sense IU on status pipe.
+//--------------------------------------------------------------------+
+#if CFG_TUD_MSC_UAS
+
+// Alternate 1 with UAS protocol follows BOT alternate: open its 4 pipes, return its length or 0 if there is none
+static uint16_t uas_open(uint8_t rhport, mscd_interface_t* p_msc, tusb_desc_interface_t const* itf_desc, uint16_t max_len) {
+  TU_VERIFY(max_len >= sizeof(tusb_desc_interface_t) && TUSB_DESC_INTERFACE == itf_desc->bDescriptorType &&
+            itf_desc->bInterfaceNumber == p_msc->itf_num && itf_desc->bAlternateSetting == 1 &&
+            MSC_SUBCLASS_SCSI == itf_desc->bInterfaceSubClass && MSC_PROTOCOL_UAS == itf_desc->bInterfaceProtocol &&
+            itf_desc->bNumEndpoints == 4, 0);
+
+  uint8_t const* p_desc = tu_desc_next(itf_desc);
+  uint8_t const* desc_end = (uint8_t const*) itf_desc + max_len;
+  tusb_desc_endpoint_t const* desc_ep = NULL;
+  uint8_t pipe_mask = 0;
+
+  while (p_desc < desc_end && TUSB_DESC_INTERFACE != tu_desc_type(p_desc) &&
+         TUSB_DESC_INTERFACE_ASSOCIATION != tu_desc_type(p_desc)) {
+    if (TUSB_DESC_ENDPOINT == tu_desc_type(p_desc)) {
+      desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+      TU_ASSERT(TUSB_XFER_BULK == desc_ep->bmAttributes.xfer && usbd_edpt_open(rhport, desc_ep), 0);
+    } else if (MSC_UAS_DESC_PIPE_USAGE == tu_desc_type(p_desc) && desc_ep) {
+      uint8_t const ep_addr = desc_ep->bEndpointAddress;
+      uint8_t const pipe_id = ((msc_uas_desc_pipe_usage_t const*) p_desc)->bPipeID;
+      switch (pipe_id) {
+        case MSC_UAS_PIPE_COMMAND:  p_msc->ep_cmd     = ep_addr; break;
+        case MSC_UAS_PIPE_STATUS:   p_msc->ep_status  = ep_addr; break;
+        case MSC_UAS_PIPE_DATA_IN:  p_msc->ep_uas_in  = ep_addr; break;
+        case MSC_UAS_PIPE_DATA_OUT: p_msc->ep_uas_out = ep_addr; break;
+        default: break;
+      }
+      pipe_mask |= (uint8_t) TU_BIT(pipe_id & 0x07);
+      desc_ep = NULL;
+    }
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  uint8_t const all_pipes = (uint8_t) (TU_BIT(MSC_UAS_PIPE_COMMAND) | TU_BIT(MSC_UAS_PIPE_STATUS) |
+                                       TU_BIT(MSC_UAS_PIPE_DATA_IN) | TU_BIT(MSC_UAS_PIPE_DATA_OUT));
+  TU_ASSERT((pipe_mask & all_pipes) == all_pipes, 0);
+
+  return (uint16_t) (p_desc - (uint8_t const*) itf_desc);
+}
+
+// Receive next command IU if there is room in the queue and no Response IU is waiting for status pipe
+static void uas_cmd_arm(uint8_t rhport, mscd_interface_t* p_msc) {
+  if (p_msc->uas_count < CFG_TUD_MSC_UAS_CMD_QUEUE_N && !p_msc->uas_resp_pending &&
+      usbd_edpt_ready(rhport, p_msc->ep_cmd)) {
+    TU_ASSERT(usbd_edpt_xfer(rhport, p_msc->ep_cmd, _mscd_epbuf.uas_cmd, UAS_CMD_IU_MAX),);
+  }
+}
+
+static void uas_select(uint8_t rhport, mscd_interface_t* p_msc, bool uas) {
+  proc_bot_reset(p_msc);
+  p_msc->uas = uas;
+  p_msc->uas_ready = 0;
+  p_msc->uas_resp_pending = false;
+  p_msc->uas_rd = 0;
+  p_msc->uas_count = 0;
+
+  // data stage code works on ep_in/ep_out
+  p_msc->ep_in  = uas ? p_msc->ep_uas_in : p_msc->ep_bot_in;
+  p_msc->ep_out = uas ? p_msc->ep_uas_out : p_msc->ep_bot_out;
+
+  if (uas) {
+    uas_cmd_arm(rhport, p_msc);
+  } else if (usbd_edpt_ready(rhport, p_msc->ep_out)) {
+    // CBW may still be queued from before UAS was selected
+    TU_ASSERT(prepare_cbw(rhport, p_msc),);
+  }
+}
+
+static void uas_response(mscd_interface_t* p_msc, uint16_t tag, uint8_t code) {
+  p_msc->uas_resp_pending = true;
+  p_msc->uas_resp_tag = tag;
+  p_msc->uas_resp_code = code;
+}
+
+// Remove queued commands (not started yet) with tag, or all of them
+static void uas_queue_drop(mscd_interface_t* p_msc, bool all, uint16_t tag) {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < p_msc->uas_count; i++) {
+    mscd_uas_cmd_t const* cmd = &p_msc->uas_queue[(p_msc->uas_rd + i) % CFG_TUD_MSC_UAS_CMD_QUEUE_N];
+    if (!all && cmd->tag != tag) {
+      p_msc->uas_queue[(p_msc->uas_rd + count) % CFG_TUD_MSC_UAS_CMD_QUEUE_N] = *cmd;
+      count++;
+    }
+  }
+  p_msc->uas_count = count;
+}
+
+// Command in progress can not be aborted, it is completed normally
+static void uas_task_mgmt(mscd_interface_t* p_msc, msc_uas_task_mgmt_iu_t const* tmf) {
+  uint8_t code = MSC_UAS_RESPONSE_TMF_COMPLETE;
+
+  switch (tmf->function) {
+    case MSC_UAS_TMF_ABORT_TASK:
+      uas_queue_drop(p_msc, false, tu_ntohs(tmf->task_tag));
+      break;
+
+    case MSC_UAS_TMF_ABORT_TASK_SET:
+    case MSC_UAS_TMF_CLEAR_TASK_SET:
+    case MSC_UAS_TMF_LOGICAL_UNIT_RESET:
+    case MSC_UAS_TMF_IT_NEXUS_RESET:
+      uas_queue_drop(p_msc, true, 0);
+      break;
+
+    default:
+      code = MSC_UAS_RESPONSE_TMF_NOT_SUPPORTED;
+      break;
+  }
+
+  TU_LOG_DRV("  UAS Task Management 0x%02X\r\n", tmf->function);
+  uas_response(p_msc, tu_ntohs(tmf->header.tag), code);
+}
+
+// Allocation length of a data-in command by CDB group, 0 if not known (response is not truncated)
+static uint32_t uas_alloc_length(uint8_t const cdb[16]) {
+  switch (cdb[0] >> 5) {
+    case 0: return cdb[4];
+    case 1:
+    case 2: return tu_ntohs(tu_unaligned_read16(cdb + 7));
+    case 4: return tu_ntohl(tu_unaligned_read32(cdb + 10));
+    case 5: return tu_ntohl(tu_unaligned_read32(cdb + 6));
+    default: return 0;
+  }
+}
+
+// Data-out length of commands other than WRITE10/16 (parameter list), 0 for data-in or no-data commands
+static uint32_t uas_data_out_length(uint8_t const cdb[16]) {
+  switch (cdb[0]) {
+    case SCSI_CMD_MODE_SELECT_6: return cdb[4];
+    case SCSI_CMD_UNMAP:         return tu_ntohs(tu_unaligned_read16(cdb + offsetof(scsi_unmap_t, param_list_len)));
+    default:                     return 0;
+  }
+}
+
+// Execute SCSI command in cbw. Unlike BOT, host does not tell data length and direction: READ/WRITE length is
+// computed from capacity, MODE SELECT (6) and UNMAP use their parameter list length, other commands are data-in
+// or no-data
+static void uas_scsi_command(uint8_t rhport, mscd_interface_t* p_msc) {
+  msc_cbw_t* p_cbw = &p_msc->cbw;
+  uint8_t const opcode = p_cbw->command[0];
+  uint32_t const out_len = uas_data_out_length(p_cbw->command);
+
+  TU_LOG_DRV("  SCSI Command [Lun%u]: %s\r\n", p_cbw->lun, tu_lookup_find(&_msc_scsi_cmd_table, opcode));
+
+  if (is_read_cmd(opcode) || is_write_cmd(opcode)) {
+    uint32_t block_count = 0;
+    uint16_t block_size = 0;
+    tud_msc_capacity_cb(p_cbw->lun, &block_count, &block_size);
+
+    uint64_t const total_bytes = (uint64_t) rdwr_get_blockcount(p_cbw) * block_size;
+    p_cbw->dir = is_read_cmd(opcode) ? TUSB_DIR_IN_MASK : TUSB_DIR_OUT;
+    p_cbw->total_bytes = (uint32_t) total_bytes;
+    proc_scsi_op_begin(p_msc);
+
+    if (block_size == 0) {
+      if (p_msc->sense_key == 0) {
+        set_sense_medium_not_present(p_cbw->lun);
+      }
+      fail_scsi_op(rhport, p_msc, MSC_CSW_STATUS_FAILED);
+    } else if (total_bytes > UINT32_MAX) {
+      // Invalid field in CDB
+      tud_msc_set_sense(p_cbw->lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x24, 0x00);
+      fail_scsi_op(rhport, p_msc, MSC_CSW_STATUS_FAILED);
+    } else if (!rdwr_lba_in_range(p_cbw)) {
+      fail_scsi_op(rhport, p_msc, MSC_CSW_STATUS_FAILED);
+    } else if (p_cbw->total_bytes == 0) {
+      p_msc->stage = MSC_STAGE_STATUS;
+    } else {
+      p_msc->uas_ready = is_read_cmd(opcode) ? MSC_UAS_IU_READ_READY : MSC_UAS_IU_WRITE_READY;
+      if (is_read_cmd(opcode)) {
+        proc_read10_begin(rhport, p_msc);
       } else {
-        // prepare to receive more data from host
         proc_write10_cmd(rhport, p_msc);
       }
     }
+  } else if (out_len) {
+    p_cbw->dir = TUSB_DIR_OUT;
+    p_cbw->total_bytes = out_len;
+    proc_scsi_op_begin(p_msc);
+
+    if (out_len > CFG_TUD_MSC_EP_BUFSIZE) {
+      tud_msc_set_sense(p_cbw->lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x24, 0x00);
+      fail_scsi_op(rhport, p_msc, MSC_CSW_STATUS_FAILED);
+    } else {
+      // data is processed (e.g passed to tud_msc_scsi_cb()) when received
+      p_msc->uas_ready = MSC_UAS_IU_WRITE_READY;
+      TU_ASSERT(usbd_edpt_xfer(rhport, p_msc->ep_out, _mscd_epbuf.buf, (uint16_t) p_msc->total_len),);
+    }
+  } else {
+    p_cbw->dir = TUSB_DIR_IN_MASK;
+    p_cbw->total_bytes = 0;
+    proc_scsi_op_begin(p_msc);
+
+    int32_t resplen = proc_builtin_scsi(p_cbw->lun, p_cbw->command, _mscd_epbuf.buf, CFG_TUD_MSC_EP_BUFSIZE);
+    if ((resplen < 0) && (p_msc->sense_key == 0)) {
+      resplen = tud_msc_scsi_cb(p_cbw->lun, p_cbw->command, _mscd_epbuf.buf, CFG_TUD_MSC_EP_BUFSIZE);
+    }
+
+    if (resplen < 0) {
+      TU_LOG_DRV("  SCSI unsupported or failed command\r\n");
+      fail_scsi_op(rhport, p_msc, MSC_CSW_STATUS_FAILED);
+    } else if (resplen == 0) {
+      p_msc->stage = MSC_STAGE_STATUS;
+    } else {
+      uint32_t const alloc_len = uas_alloc_length(p_cbw->command);
+      p_cbw->total_bytes = alloc_len ? tu_min32((uint32_t) resplen, alloc_len) : (uint32_t) resplen;
+      p_msc->total_len = p_cbw->total_bytes;
+      p_msc->uas_ready = MSC_UAS_IU_READ_READY;
+      TU_ASSERT(usbd_edpt_xfer(rhport, p_msc->ep_in, _mscd_epbuf.buf, (uint16_t) p_msc->total_len),);
+    }
+  }
+
+  // failed before data stage: no Ready IU
+  if (p_msc->stage != MSC_STAGE_DATA) {
+    p_msc->uas_ready = 0;
+  }
+}
+
+// Start next queued command if no command is in progress
+static void uas_cmd_next(uint8_t rhport, mscd_interface_t* p_msc) {
+  if (p_msc->stage != MSC_STAGE_CMD || p_msc->uas_count == 0) {
+    return;
+  }
+
+  mscd_uas_cmd_t const* cmd = &p_msc->uas_queue[p_msc->uas_rd];
+  msc_cbw_t* p_cbw = &p_msc->cbw;
+
+  tu_memclr(p_cbw, sizeof(msc_cbw_t));
+  p_cbw->signature = MSC_CBW_SIGNATURE;
+  p_cbw->tag       = cmd->tag;
+  p_cbw->lun       = cmd->lun;
+  p_cbw->cmd_len   = sizeof(p_cbw->command);
+  memcpy(p_cbw->command, cmd->cdb, sizeof(p_cbw->command));
+
+  p_msc->uas_rd = (uint8_t) ((p_msc->uas_rd + 1) % CFG_TUD_MSC_UAS_CMD_QUEUE_N);
+  p_msc->uas_count--;
+  uas_cmd_arm(rhport, p_msc);
+
+  uas_scsi_command(rhport, p_msc);
+}
+
+static void uas_cmd_received(uint8_t rhport, mscd_interface_t* p_msc, uint32_t xferred_bytes) {
+  uint8_t const* buf = _mscd_epbuf.uas_cmd;
+  msc_uas_iu_header_t const* header = (msc_uas_iu_header_t const*) buf;
+
+  if (xferred_bytes >= sizeof(msc_uas_command_iu_t) && MSC_UAS_IU_COMMAND == header->iu_id) {
+    msc_uas_command_iu_t const* iu = (msc_uas_command_iu_t const*) buf;
+    mscd_uas_cmd_t* cmd = &p_msc->uas_queue[(p_msc->uas_rd + p_msc->uas_count) % CFG_TUD_MSC_UAS_CMD_QUEUE_N];
+    cmd->tag = tu_ntohs(iu->header.tag);
+    cmd->lun = iu->lun[1];
+    memcpy(cmd->cdb, iu->cdb, sizeof(cmd->cdb));
+    p_msc->uas_count++;
+  } else if (xferred_bytes >= sizeof(msc_uas_task_mgmt_iu_t) && MSC_UAS_IU_TASK_MGMT == header->iu_id) {
+    uas_task_mgmt(p_msc, (msc_uas_task_mgmt_iu_t const*) buf);
+  } else if (xferred_bytes >= sizeof(msc_uas_iu_header_t)) {
+    TU_LOG_DRV("  UAS invalid IU 0x%02X\r\n", header->iu_id);
+    uas_response(p_msc, tu_ntohs(header->tag), MSC_UAS_RESPONSE_INVALID_IU);
+  }
+
+  uas_cmd_arm(rhport, p_msc);
+  uas_cmd_next(rhport, p_msc);
+}
+
+// Send next IU on status pipe: Response IU first, then Ready IU of data stage and Sense IU when command is done
+static void uas_status_kick(uint8_t rhport, mscd_interface_t* p_msc) {
+  if (!usbd_edpt_ready(rhport, p_msc->ep_status)) {
+    return; // sent when current IU is complete
+  }
+
+  uint8_t* buf = _mscd_epbuf.uas_status;
+  msc_uas_iu_header_t* header = (msc_uas_iu_header_t*) buf;
+  uint16_t len;
+
+  if (p_msc->uas_resp_pending) {
+    msc_uas_response_iu_t* resp = (msc_uas_response_iu_t*) buf;
+    tu_memclr(resp, sizeof(msc_uas_response_iu_t));
+    resp->header.iu_id  = MSC_UAS_IU_RESPONSE;
+    resp->header.tag    = tu_htons(p_msc->uas_resp_tag);
+    resp->response_code = p_msc->uas_resp_code;
+    p_msc->uas_resp_pending = false;
+    len = sizeof(msc_uas_response_iu_t);
+  } else if (p_msc->uas_ready) {
+    header->iu_id    = p_msc->uas_ready;
+    header->reserved = 0;
+    header->tag      = tu_htons((uint16_t) p_msc->cbw.tag);
+    p_msc->uas_ready = 0;
+    len = sizeof(msc_uas_iu_header_t);
+  } else if (p_msc->stage == MSC_STAGE_STATUS) {
+    msc_uas_sense_iu_t* sense = (msc_uas_sense_iu_t*) buf;
+    tu_memclr(sense, sizeof(msc_uas_sense_iu_t));
+    sense->header.iu_id = MSC_UAS_IU_SENSE;
+    sense->header.tag   = tu_htons((uint16_t) p_msc->cbw.tag);
+    len = sizeof(msc_uas_sense_iu_t);
+
+    TU_LOG_DRV("  SCSI Status [Lun%u] = %u\r\n", p_msc->cbw.lun, p_msc->csw.status);
+    if (p_msc->csw.status != MSC_CSW_STATUS_PASSED) {
+      // CHECK CONDITION with sense data, same as REQUEST SENSE which also clears it
+      uint8_t const cmd_sense[16] = { SCSI_CMD_REQUEST_SENSE, 0, 0, 0, sizeof(scsi_sense_fixed_resp_t) };
+      int32_t const sense_len = proc_builtin_scsi(p_msc->cbw.lun, cmd_sense, buf + sizeof(msc_uas_sense_iu_t),
+                                                  sizeof(scsi_sense_fixed_resp_t));
+      sense->status = 2;
+      if (sense_len > 0) {
+        sense->sense_len = tu_htons((uint16_t) sense_len);
+        len = (uint16_t) (len + sense_len);
+      }
+    }
+    p_msc->stage = MSC_STAGE_STATUS_SENT;
+  } else {
+    return;
+  }
+
+  TU_ASSERT(usbd_edpt_xfer(rhport, p_msc->ep_status, buf, len),);
+}
+
+static void uas_xfer_cb(uint8_t rhport, mscd_interface_t* p_msc, uint8_t ep_addr, uint32_t xferred_bytes) {
+  if (ep_addr == p_msc->ep_cmd) {
+    uas_cmd_received(rhport, p_msc, xferred_bytes);
+  } else if (p_msc->stage == MSC_STAGE_STATUS_SENT) {
+    // Sense IU is sent (only one IU is in flight), command is complete
+    p_msc->stage = MSC_STAGE_CMD;
+    proc_scsi_op_complete(&p_msc->cbw);
+    uas_cmd_next(rhport, p_msc);
+  } else {
+    // Ready or Response IU is sent
   }
+
+  uas_cmd_arm(rhport, p_msc);
+  uas_status_kick(rhport, p_msc);
 }
 
 #endif
+
+#endif
@@ -50,6 +50,32 @@
 
 TU_VERIFY_STATIC(CFG_TUD_MSC_EP_BUFSIZE < UINT16_MAX, "Size is not correct");
 
+// Use 2 buffers of CFG_TUD_MSC_EP_BUFSIZE for READ10/WRITE10 so that application can read/write the next chunk
+// while the current one is transferring on the bus. This doubles the RAM usage of the endpoint buffer.
+#ifndef CFG_TUD_MSC_DOUBLE_BUFFER
+  #define CFG_TUD_MSC_DOUBLE_BUFFER 0
+#endif
+
+// Support USB Attached SCSI (UAS) as alternate setting 1 of the interface, see TUD_MSC_UAS_DESCRIPTOR().
+// Host can queue several commands, they are executed in order with the same callbacks as Bulk-Only Transport.
+// Only the 4 pipes model without streams (full/high speed) is supported.
+#ifndef CFG_TUD_MSC_UAS
+  #define CFG_TUD_MSC_UAS 0
+#endif
+
+// Number of UAS commands received from host and waiting for execution
+#ifndef CFG_TUD_MSC_UAS_CMD_QUEUE_N
+  #define CFG_TUD_MSC_UAS_CMD_QUEUE_N 4
+#endif
+
+// Special return values of tud_msc_read10_cb() and tud_msc_write10_cb()
+enum {
+  TUD_MSC_RET_BUSY  = 0,   // Busy e.g disk I/O is not ready, callback is invoked again later
+  TUD_MSC_RET_ERROR = -1,  // Error e.g invalid address
+  TUD_MSC_RET_ASYNC = -16, // I/O is started asynchronously, tud_msc_async_io_done() must be called when complete
+  TUD_MSC_RET_UNMAPPED = -17, // tud_msc_read10_ptr_cb() only: data is not memory mapped, use tud_msc_read10_cb()
+};
+
 //--------------------------------------------------------------------+
 // Application API
 //--------------------------------------------------------------------+
@@ -57,11 +83,16 @@ TU_VERIFY_STATIC(CFG_TUD_MSC_EP_BUFSIZE < UINT16_MAX, "Size is not correct");
 // Set SCSI sense response
 bool tud_msc_set_sense(uint8_t lun, uint8_t sense_key, uint8_t add_sense_code, uint8_t add_sense_qualifier);
 
+// Complete an asynchronous I/O started by tud_msc_read10_cb() or tud_msc_write10_cb() which returned TUD_MSC_RET_ASYNC.
+// bytes_io has the same meaning as the callback return value: number of read/written bytes, 0 for busy (callback is
+// invoked again) or negative for error. Can be called in interrupt context (e.g DMA complete) with in_isr = true.
+bool tud_msc_async_io_done(int32_t bytes_io, bool in_isr);
+
 //--------------------------------------------------------------------+
 // Application Callbacks (WEAK is optional)
 //--------------------------------------------------------------------+
 
-// Invoked when received SCSI READ10 command
+// Invoked when received SCSI READ10 or READ16 command
 // - Address = lba * BLOCK_SIZE + offset
 //   - offset is only needed if CFG_TUD_MSC_EP_BUFSIZE is smaller than BLOCK_SIZE.
 //
@@ -73,9 +104,15 @@ bool tud_msc_set_sense(uint8_t lun, uint8_t sense_key, uint8_t add_sense_code, u
 //
 //   - read < 0       : Indicate application error e.g invalid address. This request will be STALLed
 //                      and return failed status in command status wrapper phase.
+//
+//   - TUD_MSC_RET_ASYNC: Indicate read is started asynchronously, buffer must stay valid and application must call
+//                      tud_msc_async_io_done() with the actual read result when complete.
+//
+// - With CFG_TUD_MSC_DOUBLE_BUFFER, callback is invoked for the next chunk while the previous one is still
+//   transferring. Returning 0 in this case only delays the read until the transfer is complete.
 int32_t tud_msc_read10_cb (uint8_t lun, uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize);
 
-// Invoked when received SCSI WRITE10 command
+// Invoked when received SCSI WRITE10 or WRITE16 command
 // - Address = lba * BLOCK_SIZE + offset
 //   - offset is only needed if CFG_TUD_MSC_EP_BUFSIZE is smaller than BLOCK_SIZE.
 //
@@ -88,6 +125,11 @@ int32_t tud_msc_read10_cb (uint8_t lun, uint32_t lba, uint32_t offset, void* buf
 //   - write < 0       : Indicate application error e.g invalid address. This request will be STALLed
 //                       and return failed status in command status wrapper phase.
 //
+//   - TUD_MSC_RET_ASYNC: Indicate write is started asynchronously, buffer must stay valid and application must call
+//                       tud_msc_async_io_done() with the actual written result when complete.
+//
+// - With CFG_TUD_MSC_DOUBLE_BUFFER, the next chunk is received from host while application is writing this one.
+//
 // TODO change buffer to const uint8_t*
 int32_t tud_msc_write10_cb (uint8_t lun, uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize);
 
@@ -99,14 +141,16 @@ void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16
 // return true allowing host to read/write this LUN e.g SD card inserted
 bool tud_msc_test_unit_ready_cb(uint8_t lun);
 
-// Invoked when received SCSI_CMD_READ_CAPACITY_10 and SCSI_CMD_READ_FORMAT_CAPACITY to determine the disk size
-// Application update block count and block size
+// Invoked when received SCSI_CMD_READ_CAPACITY_10, READ_CAPACITY_16 and SCSI_CMD_READ_FORMAT_CAPACITY to determine
+// the disk size. Application update block count and block size e.g 4096 for native 4K block media, which cuts
+// per-block overhead when CFG_TUD_MSC_EP_BUFSIZE is a multiple of it
 void tud_msc_capacity_cb(uint8_t lun, uint32_t* block_count, uint16_t* block_size);
 
 /**
  * Invoked when received an SCSI command not in built-in list below.
- * - READ_CAPACITY10, READ_FORMAT_CAPACITY, INQUIRY, TEST_UNIT_READY, START_STOP_UNIT, MODE_SENSE6, REQUEST_SENSE
- * - READ10 and WRITE10 has their own callbacks
+ * - READ_CAPACITY10, READ_CAPACITY16, READ_FORMAT_CAPACITY, INQUIRY, TEST_UNIT_READY, START_STOP_UNIT, MODE_SENSE6,
+ *   REQUEST_SENSE
+ * - READ10/16, WRITE10/16 and UNMAP (if tud_msc_unmap_cb() is implemented) has their own callbacks
  *
  * \param[in]   lun         Logical unit number
  * \param[in]   scsi_cmd    SCSI command contents which application must examine to response accordingly
@@ -118,6 +162,9 @@ void tud_msc_capacity_cb(uint8_t lun, uint32_t* block_count, uint16_t* block_siz
  * \return      Actual bytes processed, can be zero for no-data command.
  * \retval      negative    Indicate error e.g unsupported command, tinyusb will \b STALL the corresponding
  *                          endpoint and return failed status in command status wrapper phase.
+ *
+ * \note With UAS (CFG_TUD_MSC_UAS) the transfer direction is not sent by host: commands other than MODE SELECT (6)
+ *       and UNMAP are handled as data-in or no-data commands.
  */
 int32_t tud_msc_scsi_cb (uint8_t lun, uint8_t const scsi_cmd[16], void* buffer, uint16_t bufsize);
 
@@ -140,6 +187,22 @@ TU_ATTR_WEAK int32_t tud_msc_request_sense_cb(uint8_t lun, void* buffer, uint16_
 // Invoked when Read10 command is complete
 TU_ATTR_WEAK void tud_msc_read10_complete_cb(uint8_t lun);
 
+// Optional zero-copy alternative of tud_msc_read10_cb() for memory mapped medium e.g RAM disk or XIP flash.
+// Data is transferred straight from the medium without copying into CFG_TUD_MSC_EP_BUFSIZE buffer, and a whole
+// multi-block request can be sent with a single transfer.
+// - Set *buffer to address lba * BLOCK_SIZE + offset and return number of contiguous bytes there (up to bufsize).
+//   Data must stay valid until transferred and be accessible by the controller (DMA), cache is cleaned by DCD.
+//   If less than bufsize, it must be multiple of endpoint packet size and callback is invoked again for the rest.
+// - Return 0 (busy) or negative (error) as tud_msc_read10_cb(), or TUD_MSC_RET_UNMAPPED to read this chunk with
+//   tud_msc_read10_cb() e.g LUN is not memory mapped.
+TU_ATTR_WEAK int32_t tud_msc_read10_ptr_cb(uint8_t lun, uint32_t lba, uint32_t offset, void const** buffer,
+                                           uint32_t bufsize);
+
+// Invoked when a READ10/16 command starts where the previous one of the same LUN ended i.e host reads sequentially.
+// block_count blocks from lba are likely requested next and can be prefetched into application cache while the
+// current command is transferring. Only a hint, tud_msc_read10_cb() is invoked for them as usual
+TU_ATTR_WEAK void tud_msc_read_ahead_cb(uint8_t lun, uint32_t lba, uint32_t block_count);
+
 // Invoke when Write10 command is complete, can be used to flush flash caching
 TU_ATTR_WEAK void tud_msc_write10_complete_cb(uint8_t lun);
 
@@ -149,6 +212,18 @@ TU_ATTR_WEAK void tud_msc_scsi_complete_cb(uint8_t lun, uint8_t const scsi_cmd[1
 // Invoked to check if device is writable as part of SCSI WRITE10
 TU_ATTR_WEAK bool tud_msc_is_writable_cb(uint8_t lun);
 
+// Invoked for each block range of SCSI UNMAP command: blocks no longer hold valid data and can be erased e.g TRIM
+// of eMMC/flash. Implementing this callback reports logical block provisioning to host so that it can issue UNMAP.
+// Return false if failed, application can set sense with tud_msc_set_sense()
+TU_ATTR_WEAK bool tud_msc_unmap_cb(uint8_t lun, uint32_t lba, uint32_t block_count);
+
+// Invoked to write cached data of block range to the medium, block_count 0 means up to the last block. Implementing
+// this callback enables write-back caching: tud_msc_write10_cb() can return as soon as data is in application cache
+// (status is sent without waiting for the medium), write cache is reported enabled in MODE SENSE caching page and the
+// callback is invoked for SYNCHRONIZE CACHE (10), START STOP UNIT (stop) and WRITE10/16 with Force Unit Access.
+// Return false if failed, application can set sense with tud_msc_set_sense()
+TU_ATTR_WEAK bool tud_msc_sync_cache_cb(uint8_t lun, uint32_t lba, uint32_t block_count);
+
 //--------------------------------------------------------------------+
 // Internal Class Driver API
 //--------------------------------------------------------------------+
@@ -50,6 +50,41 @@ enum {
   MSC_STAGE_STATUS,
 };
 
+// SCSI command, block transfer (tuh_msc_read/write) can be split into several commands (chunks)
+typedef struct {
+  msc_cbw_t cbw;          // CBW of command (current chunk)
+  uint8_t* buffer;        // data of current chunk
+  void* user_buffer;      // data reported to complete callback
+  tuh_msc_complete_cb_t complete_cb;
+  uintptr_t complete_arg;
+
+  uint64_t lba;           // LBA of next chunk
+  uint32_t block_remain;  // blocks left after current chunk, 0 if last chunk or not a block transfer
+} msch_cmd_t;
+
+#if CFG_TUH_MSC_UAS
+TU_VERIFY_STATIC(CFG_TUH_MSC_UAS_TAG_N > 0 && CFG_TUH_MSC_UAS_TAG_N < 255, "CFG_TUH_MSC_UAS_TAG_N must be 1-254");
+
+enum {
+  UAS_SLOT_FREE = 0,
+  UAS_SLOT_CMD,      // waiting for command pipe
+  UAS_SLOT_SENDING,  // command IU in progress
+  UAS_SLOT_SENT,     // waiting for Read/Write Ready or Sense IU
+  UAS_SLOT_READY,    // Ready IU received, waiting for data pipe
+  UAS_SLOT_DATA,     // data phase in progress
+};
+
+// Tagged command, tag is slot index + 1
+typedef struct {
+  msch_cmd_t cmd;
+  uint32_t xferred;  // data bytes of current chunk
+  volatile uint8_t state;
+} msch_uas_slot_t;
+
+// Sense IU with the largest sense data allowed
+#define UAS_STATUS_IU_MAX  (sizeof(msc_uas_sense_iu_t) + 252)
+#endif
+
 typedef struct {
   uint8_t itf_num;
   uint8_t ep_in;
@@ -60,25 +95,53 @@ typedef struct {
   volatile bool mounted;    // Enumeration is complete
 
   // SCSI command data
-  uint8_t stage;
-  void* buffer;
-  tuh_msc_complete_cb_t complete_cb;
-  uintptr_t complete_arg;
+  volatile uint8_t stage;
+  msch_cmd_t cmd;
+
+  #if CFG_TUH_MSC_CMD_QUEUE_N
+  msch_cmd_t queue[CFG_TUH_MSC_CMD_QUEUE_N];
+  uint8_t queue_rd;
+  uint8_t queue_count;
+  #endif
 
   struct {
     uint32_t block_size;
-    uint32_t block_count;
+    uint64_t block_count;
   } capacity[CFG_TUH_MSC_MAXLUN];
+
+  #if CFG_TUH_MSC_UAS
+  struct {
+    uint8_t alt;          // alternate setting with UAS protocol, 0 if not supported
+    volatile bool active; // alternate is selected, BOT stage & endpoints are not used
+    bool status_busy;     // status pipe is armed
+    uint8_t cmd_slot;     // slot whose command IU is being sent
+    uint8_t ep_cmd;
+    uint8_t ep_status;
+    uint8_t ep_data_in;
+    uint8_t ep_data_out;
+    msch_uas_slot_t slot[CFG_TUH_MSC_UAS_TAG_N];
+  } uas;
+  #endif
 } msch_interface_t;
 
 typedef struct {
   TUH_EPBUF_TYPE_DEF(msc_cbw_t, cbw);
   TUH_EPBUF_TYPE_DEF(msc_csw_t, csw);
+  #if CFG_TUH_MSC_UAS
+  TUH_EPBUF_TYPE_DEF(msc_uas_command_iu_t, uas_cmd);
+  TUH_EPBUF_DEF(uas_status, UAS_STATUS_IU_MAX);
+  #endif
 } msch_epbuf_t;
 
 static msch_interface_t _msch_itf[CFG_TUH_DEVICE_MAX];
 CFG_TUH_MEM_SECTION static msch_epbuf_t _msch_epbuf[CFG_TUH_DEVICE_MAX];
 
+#if OSAL_MUTEX_REQUIRED
+// protect stage & command queue, commands can be submitted by application outside of usbh task
+static OSAL_MUTEX_DEF(_msch_mutexdef);
+static osal_mutex_t _msch_mutex;
+#endif
+
 TU_ATTR_ALWAYS_INLINE static inline msch_interface_t* get_itf(uint8_t daddr) {
   return &_msch_itf[daddr - 1];
 }
@@ -87,6 +150,18 @@ TU_ATTR_ALWAYS_INLINE static inline msch_epbuf_t* get_epbuf(uint8_t daddr) {
   return &_msch_epbuf[daddr - 1];
 }
 
+TU_ATTR_ALWAYS_INLINE static inline void msch_lock(void) {
+  #if OSAL_MUTEX_REQUIRED
+  osal_mutex_lock(_msch_mutex, OSAL_TIMEOUT_WAIT_FOREVER);
+  #endif
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void msch_unlock(void) {
+  #if OSAL_MUTEX_REQUIRED
+  osal_mutex_unlock(_msch_mutex);
+  #endif
+}
+
 //--------------------------------------------------------------------+
 // PUBLIC API
 //--------------------------------------------------------------------+
@@ -96,6 +171,11 @@ uint8_t tuh_msc_get_maxlun(uint8_t dev_addr) {
 }
 
 uint32_t tuh_msc_get_block_count(uint8_t dev_addr, uint8_t lun) {
+  uint64_t const block_count = tuh_msc_get_block_count64(dev_addr, lun);
+  return (block_count > UINT32_MAX) ? UINT32_MAX : (uint32_t) block_count;
+}
+
+uint64_t tuh_msc_get_block_count64(uint8_t dev_addr, uint8_t lun) {
   msch_interface_t* p_msc = get_itf(dev_addr);
   return p_msc->capacity[lun].block_count;
 }
@@ -112,7 +192,25 @@ bool tuh_msc_mounted(uint8_t dev_addr) {
 
 bool tuh_msc_ready(uint8_t dev_addr) {
   msch_interface_t* p_msc = get_itf(dev_addr);
-  return p_msc->mounted && !usbh_edpt_busy(dev_addr, p_msc->ep_in) && !usbh_edpt_busy(dev_addr, p_msc->ep_out);
+  #if CFG_TUH_MSC_UAS
+  if (p_msc->uas.active) {
+    for (uint8_t i = 0; i < CFG_TUH_MSC_UAS_TAG_N; i++) {
+      if (p_msc->uas.slot[i].state == UAS_SLOT_FREE) return p_msc->mounted;
+    }
+    return false;
+  }
+  #endif
+  return p_msc->mounted && p_msc->stage == MSC_STAGE_IDLE &&
+         !usbh_edpt_busy(dev_addr, p_msc->ep_in) && !usbh_edpt_busy(dev_addr, p_msc->ep_out);
+}
+
+bool tuh_msc_is_uas(uint8_t dev_addr) {
+  #if CFG_TUH_MSC_UAS
+  return get_itf(dev_addr)->uas.active;
+  #else
+  (void) dev_addr;
+  return false;
+  #endif
 }
 
 //--------------------------------------------------------------------+
@@ -125,20 +223,13 @@ static inline void cbw_init(msc_cbw_t* cbw, uint8_t lun) {
   cbw->lun       = lun;
 }
 
-bool tuh_msc_scsi_command(uint8_t daddr, msc_cbw_t const* cbw, void* data,
-                          tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
-  msch_interface_t* p_msc = get_itf(daddr);
-  TU_VERIFY(p_msc->configured);
+// Send CBW of current command, stage must already be set to MSC_STAGE_CMD
+static bool cmd_xfer(uint8_t daddr, msch_interface_t* p_msc) {
+  msch_epbuf_t* epbuf = get_epbuf(daddr);
 
   // claim endpoint
   TU_VERIFY(usbh_edpt_claim(daddr, p_msc->ep_out));
-  msch_epbuf_t* epbuf = get_epbuf(daddr);
-
-  epbuf->cbw = *cbw;
-  p_msc->buffer = data;
-  p_msc->complete_cb = complete_cb;
-  p_msc->complete_arg = arg;
-  p_msc->stage = MSC_STAGE_CMD;
+  epbuf->cbw = p_msc->cmd.cbw;
 
   if (!usbh_edpt_xfer(daddr, p_msc->ep_out, (uint8_t*) &epbuf->cbw, sizeof(msc_cbw_t))) {
     usbh_edpt_release(daddr, p_msc->ep_out);
@@ -148,6 +239,124 @@ bool tuh_msc_scsi_command(uint8_t daddr, msc_cbw_t const* cbw, void* data,
   return true;
 }
 
+#if CFG_TUH_MSC_UAS
+static bool uas_slot_start(msch_interface_t* p_msc, msch_cmd_t const* cmd);
+static void uas_cmd_kick(uint8_t daddr, msch_interface_t* p_msc);
+#endif
+
+// Start command if device is idle (UAS: a tag is free), otherwise queue it if possible
+static bool cmd_submit(uint8_t daddr, msch_cmd_t const* cmd) {
+  msch_interface_t* p_msc = get_itf(daddr);
+
+  msch_lock();
+  #if CFG_TUH_MSC_UAS
+  if (p_msc->uas.active) {
+    if (uas_slot_start(p_msc, cmd)) {
+      msch_unlock();
+      uas_cmd_kick(daddr, p_msc);
+      return true;
+    }
+  } else
+  #endif
+  if (p_msc->stage == MSC_STAGE_IDLE) {
+    p_msc->cmd = *cmd;
+    p_msc->stage = MSC_STAGE_CMD;
+    msch_unlock();
+
+    if (!cmd_xfer(daddr, p_msc)) {
+      p_msc->stage = MSC_STAGE_IDLE;
+      return false;
+    }
+    return true;
+  }
+
+  bool queued = false;
+  #if CFG_TUH_MSC_CMD_QUEUE_N
+  if (p_msc->queue_count < CFG_TUH_MSC_CMD_QUEUE_N) {
+    uint8_t const wr = (uint8_t) ((p_msc->queue_rd + p_msc->queue_count) % CFG_TUH_MSC_CMD_QUEUE_N);
+    p_msc->queue[wr] = *cmd;
+    p_msc->queue_count++;
+    queued = true;
+  }
+  #endif
+  msch_unlock();
+
+  return queued;
+}
+
+// Prepare CBW of next chunk of a block transfer: READ/WRITE (10) if possible, (16) otherwise
+static void cmd_block_next(msch_interface_t* p_msc, msch_cmd_t* cmd) {
+  msc_cbw_t* cbw = &cmd->cbw;
+  uint32_t const block_size = p_msc->capacity[cbw->lun].block_size;
+  bool const is_read = (cbw->dir & TUSB_DIR_IN_MASK) != 0;
+
+  uint32_t const chunk_max = tu_max32(CFG_TUH_MSC_XFER_MAX / block_size, 1);
+  uint32_t const block_count = tu_min32(cmd->block_remain, chunk_max);
+  uint64_t const lba = cmd->lba;
+
+  cbw->total_bytes = block_count * block_size;
+  tu_memclr(cbw->command, sizeof(cbw->command));
+
+  if (block_count <= UINT16_MAX && (lba + block_count - 1) <= UINT32_MAX) {
+    scsi_read10_t const cmd10 = {
+        .cmd_code    = is_read ? SCSI_CMD_READ_10 : SCSI_CMD_WRITE_10,
+        .lba         = tu_htonl((uint32_t) lba),
+        .block_count = tu_htons((uint16_t) block_count)
+    };
+    cbw->cmd_len = sizeof(scsi_read10_t);
+    memcpy(cbw->command, &cmd10, sizeof(cmd10));
+  } else {
+    scsi_read16_t const cmd16 = {
+        .cmd_code    = is_read ? SCSI_CMD_READ_16 : SCSI_CMD_WRITE_16,
+        .lba         = msc_htonll(lba),
+        .block_count = tu_htonl(block_count)
+    };
+    cbw->cmd_len = sizeof(scsi_read16_t);
+    memcpy(cbw->command, &cmd16, sizeof(cmd16));
+  }
+
+  cmd->lba += block_count;
+  cmd->block_remain -= block_count;
+}
+
+static bool block_xfer(uint8_t dev_addr, uint8_t lun, void* buffer, uint64_t lba, uint32_t block_count,
+                       bool is_read, tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
+  msch_interface_t* p_msc = get_itf(dev_addr);
+  TU_VERIFY(p_msc->mounted && lun < CFG_TUH_MSC_MAXLUN && p_msc->capacity[lun].block_size && block_count);
+
+  msch_cmd_t cmd = {
+      .buffer       = (uint8_t*) buffer,
+      .user_buffer  = buffer,
+      .complete_cb  = complete_cb,
+      .complete_arg = arg,
+      .lba          = lba,
+      .block_remain = block_count
+  };
+  cbw_init(&cmd.cbw, lun);
+  cmd.cbw.dir = is_read ? TUSB_DIR_IN_MASK : TUSB_DIR_OUT;
+  cmd_block_next(p_msc, &cmd);
+
+  return cmd_submit(dev_addr, &cmd);
+}
+
+bool tuh_msc_scsi_command(uint8_t daddr, msc_cbw_t const* cbw, void* data,
+                          tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
+  msch_interface_t* p_msc = get_itf(daddr);
+  TU_VERIFY(p_msc->configured);
+
+  msch_cmd_t const cmd = {
+      .cbw          = *cbw,
+      .buffer       = (uint8_t*) data,
+      .user_buffer  = data,
+      .complete_cb  = complete_cb,
+      .complete_arg = arg,
+      .lba          = 0,
+      .block_remain = 0
+  };
+
+  return cmd_submit(daddr, &cmd);
+}
+
 bool tuh_msc_read_capacity(uint8_t dev_addr, uint8_t lun, scsi_read_capacity10_resp_t* response,
                            tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
   msch_interface_t* p_msc = get_itf(dev_addr);
@@ -221,48 +430,754 @@ bool tuh_msc_request_sense(uint8_t dev_addr, uint8_t lun, void* response,
 
 bool tuh_msc_read10(uint8_t dev_addr, uint8_t lun, void* buffer, uint32_t lba, uint16_t block_count,
                     tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
-  msch_interface_t* p_msc = get_itf(dev_addr);
-  TU_VERIFY(p_msc->mounted);
+  return block_xfer(dev_addr, lun, buffer, lba, block_count, true, complete_cb, arg);
+}
 
-  msc_cbw_t cbw;
-  cbw_init(&cbw, lun);
+bool tuh_msc_write10(uint8_t dev_addr, uint8_t lun, void const* buffer, uint32_t lba, uint16_t block_count,
+                     tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
+  return block_xfer(dev_addr, lun, (void*) (uintptr_t) buffer, lba, block_count, false, complete_cb, arg);
+}
+
+bool tuh_msc_read(uint8_t dev_addr, uint8_t lun, void* buffer, uint64_t lba, uint32_t block_count,
+                  tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
+  return block_xfer(dev_addr, lun, buffer, lba, block_count, true, complete_cb, arg);
+}
 
-  cbw.total_bytes = block_count * p_msc->capacity[lun].block_size;
-  cbw.dir = TUSB_DIR_IN_MASK;
-  cbw.cmd_len = sizeof(scsi_read10_t);
+bool tuh_msc_write(uint8_t dev_addr, uint8_t lun, void const* buffer, uint64_t lba, uint32_t block_count,
+                   tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
+  return block_xfer(dev_addr, lun, (void*) (uintptr_t) buffer, lba, block_count, false, complete_cb, arg);
+}
 
-  scsi_read10_t const cmd_read10 = {
-      .cmd_code    = SCSI_CMD_READ_10,
-      .lba         = tu_htonl(lba),
-      .block_count = tu_htons(block_count)
-  };
-  memcpy(cbw.command, &cmd_read10, cbw.cmd_len);
+//--------------------------------------------------------------------+
+// Block Cache
+//--------------------------------------------------------------------+
+#if CFG_TUH_MSC_CACHE_LINE_N
 
-  return tuh_msc_scsi_command(dev_addr, &cbw, buffer, complete_cb, arg);
+TU_VERIFY_STATIC(CFG_TUH_MSC_CACHE_LINE_BLOCKS > 0 && CFG_TUH_MSC_CACHE_LINE_BLOCKS <= 32,
+                 "CFG_TUH_MSC_CACHE_LINE_BLOCKS must be 1-32");
+TU_VERIFY_STATIC(CFG_TUH_MSC_CACHE_LINE_N < 255, "CFG_TUH_MSC_CACHE_LINE_N is too large");
+
+#define CACHE_LINE_BYTES  (CFG_TUH_MSC_CACHE_LINE_BLOCKS * CFG_TUH_MSC_CACHE_BLOCK_SIZE)
+
+enum {
+  CACHE_LINE_IDLE = 0,
+  CACHE_LINE_FILLING,
+  CACHE_LINE_WRITING,
+};
+
+enum {
+  CACHE_OP_NONE = 0,
+  CACHE_OP_READ,
+  CACHE_OP_WRITE,
+  CACHE_OP_FLUSH,
+  CACHE_OP_BYPASS,
+};
+
+typedef struct {
+  uint64_t lba;       // first block, aligned to line size
+  uint32_t valid;     // bit per block
+  uint32_t dirty;     // bit per block, subset of valid
+  uint32_t io_mask;   // blocks being written back
+  uint32_t last_use;  // for LRU
+  uint8_t daddr;      // 0 if line is free
+  uint8_t lun;
+  uint8_t state;
+} msch_cache_line_t;
+
+// Application request in progress, processed block by block as lines become available
+typedef struct {
+  uint8_t type;
+  uint8_t lun;
+  bool failed;
+  uint8_t* buffer;    // data of next block
+  void* user_buffer;
+  uint64_t lba;       // next block
+  uint32_t remain;
+  uint32_t block_count;
+  tuh_msc_complete_cb_t complete_cb;
+  uintptr_t complete_arg;
+
+  uint64_t read_next; // block following previous read, for sequential detection
+} msch_cache_op_t;
+
+typedef struct {
+  TUH_EPBUF_DEF(data, CACHE_LINE_BYTES);
+} msch_cache_buf_t;
+
+static msch_cache_line_t _msch_cache_line[CFG_TUH_MSC_CACHE_LINE_N];
+static msch_cache_op_t _msch_cache_op[CFG_TUH_DEVICE_MAX];
+CFG_TUH_MEM_SECTION static msch_cache_buf_t _msch_cache_buf[CFG_TUH_MSC_CACHE_LINE_N];
+static uint32_t _msch_cache_tick;
+
+static bool cache_io_complete(uint8_t daddr, tuh_msc_complete_data_t const* cb_data);
+
+TU_ATTR_ALWAYS_INLINE static inline uint64_t cache_line_lba(uint64_t lba) {
+  return lba - (lba % CFG_TUH_MSC_CACHE_LINE_BLOCKS);
 }
 
-bool tuh_msc_write10(uint8_t dev_addr, uint8_t lun, void const* buffer, uint32_t lba, uint16_t block_count,
-                     tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
-  msch_interface_t* p_msc = get_itf(dev_addr);
-  TU_VERIFY(p_msc->mounted);
+static msch_cache_line_t* cache_line_find(uint8_t daddr, uint8_t lun, uint64_t line_lba) {
+  for (uint8_t i = 0; i < CFG_TUH_MSC_CACHE_LINE_N; i++) {
+    msch_cache_line_t* line = &_msch_cache_line[i];
+    if (line->daddr == daddr && line->lun == lun && line->lba == line_lba) return line;
+  }
+  return NULL;
+}
+
+// Check if any line of device is being filled or written back
+static bool cache_io_pending(uint8_t daddr) {
+  for (uint8_t i = 0; i < CFG_TUH_MSC_CACHE_LINE_N; i++) {
+    msch_cache_line_t const* line = &_msch_cache_line[i];
+    if (line->daddr == daddr && line->state != CACHE_LINE_IDLE) return true;
+  }
+  return false;
+}
 
+static bool cache_overlap(uint8_t daddr, uint8_t lun, uint64_t lba, uint32_t block_count) {
+  for (uint8_t i = 0; i < CFG_TUH_MSC_CACHE_LINE_N; i++) {
+    msch_cache_line_t const* line = &_msch_cache_line[i];
+    if (line->daddr == daddr && line->lun == lun &&
+        line->lba < lba + block_count && lba < line->lba + CFG_TUH_MSC_CACHE_LINE_BLOCKS) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Get least recently used idle line, free line is preferred. Return NULL if all lines are busy
+static msch_cache_line_t* cache_line_victim(bool clean_only) {
+  msch_cache_line_t* victim = NULL;
+  for (uint8_t i = 0; i < CFG_TUH_MSC_CACHE_LINE_N; i++) {
+    msch_cache_line_t* line = &_msch_cache_line[i];
+    if (line->daddr == 0) return line;
+    if (line->state != CACHE_LINE_IDLE || (clean_only && line->dirty)) continue;
+    if (victim == NULL || (int32_t) (line->last_use - victim->last_use) < 0) victim = line;
+  }
+  return victim;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline uint8_t cache_line_index(msch_cache_line_t const* line) {
+  return (uint8_t) (line - _msch_cache_line);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline uint8_t* cache_line_data(msch_cache_line_t const* line) {
+  return _msch_cache_buf[cache_line_index(line)].data;
+}
+
+static void cache_line_assign(msch_cache_line_t* line, uint8_t daddr, uint8_t lun, uint64_t line_lba) {
+  line->daddr = daddr;
+  line->lun = lun;
+  line->lba = line_lba;
+  line->valid = 0;
+  line->dirty = 0;
+  line->last_use = _msch_cache_tick;
+}
+
+// Read whole line (clipped to capacity) from device, line must not be dirty
+static bool cache_line_fill(msch_cache_line_t* line) {
+  uint64_t const total = get_itf(line->daddr)->capacity[line->lun].block_count;
+  TU_VERIFY(line->lba < total);
+  uint64_t const avail = total - line->lba;
+  uint32_t const count = (avail < CFG_TUH_MSC_CACHE_LINE_BLOCKS) ? (uint32_t) avail : CFG_TUH_MSC_CACHE_LINE_BLOCKS;
+
+  line->state = CACHE_LINE_FILLING;
+  line->valid = 0;
+  if (!tuh_msc_read(line->daddr, line->lun, cache_line_data(line), line->lba, count,
+                    cache_io_complete, cache_line_index(line))) {
+    line->state = CACHE_LINE_IDLE;
+    return false;
+  }
+  return true;
+}
+
+// Write back the first contiguous run of dirty blocks
+static bool cache_line_writeback(msch_cache_line_t* line) {
+  uint32_t const dirty = line->dirty;
+  uint8_t start = 0;
+  while (!(dirty & TU_BIT(start))) start++;
+  uint8_t end = start;
+  while (end < CFG_TUH_MSC_CACHE_LINE_BLOCKS && (dirty & TU_BIT(end))) end++;
+
+  uint32_t const count = (uint32_t) (end - start);
+  line->io_mask = (count == 32) ? UINT32_MAX : (uint32_t) ((TU_BIT(count) - 1) << start);
+  line->state = CACHE_LINE_WRITING;
+
+  if (!tuh_msc_write(line->daddr, line->lun, cache_line_data(line) + start * CFG_TUH_MSC_CACHE_BLOCK_SIZE,
+                     line->lba + start, count, cache_io_complete, cache_line_index(line))) {
+    line->state = CACHE_LINE_IDLE;
+    return false;
+  }
+  return true;
+}
+
+static void cache_op_complete(uint8_t daddr, msch_cache_op_t* op, bool passed) {
   msc_cbw_t cbw;
-  cbw_init(&cbw, lun);
+  cbw_init(&cbw, op->lun);
+  uint64_t const total_bytes = (uint64_t) op->block_count * CFG_TUH_MSC_CACHE_BLOCK_SIZE;
+  cbw.total_bytes = (total_bytes > UINT32_MAX) ? UINT32_MAX : (uint32_t) total_bytes;
+  cbw.dir = (op->type == CACHE_OP_READ) ? TUSB_DIR_IN_MASK : TUSB_DIR_OUT;
+
+  msc_csw_t const csw = {
+      .signature    = MSC_CSW_SIGNATURE,
+      .tag          = cbw.tag,
+      .data_residue = passed ? 0 : (uint32_t) tu_min32(op->remain, UINT32_MAX / CFG_TUH_MSC_CACHE_BLOCK_SIZE) * CFG_TUH_MSC_CACHE_BLOCK_SIZE,
+      .status       = passed ? MSC_CSW_STATUS_PASSED : MSC_CSW_STATUS_FAILED
+  };
 
-  cbw.total_bytes = block_count * p_msc->capacity[lun].block_size;
-  cbw.dir         = TUSB_DIR_OUT;
-  cbw.cmd_len     = sizeof(scsi_write10_t);
+  tuh_msc_complete_data_t const cb_data = {
+      .cbw = &cbw,
+      .csw = &csw,
+      .scsi_data = op->user_buffer,
+      .user_arg = op->complete_arg
+  };
+  tuh_msc_complete_cb_t const complete_cb = op->complete_cb;
 
-  scsi_write10_t const cmd_write10 = {
-      .cmd_code    = SCSI_CMD_WRITE_10,
-      .lba         = tu_htonl(lba),
-      .block_count = tu_htons(block_count)
+  op->type = CACHE_OP_NONE;
+  if (complete_cb) {
+    complete_cb(daddr, &cb_data);
+  }
+}
+
+// Prefetch lines following line_lba if they are not cached, only clean lines are evicted
+static void cache_read_ahead(uint8_t daddr, uint8_t lun, uint64_t line_lba) {
+  for (uint8_t i = 0; i < CFG_TUH_MSC_CACHE_READ_AHEAD; i++) {
+    line_lba += CFG_TUH_MSC_CACHE_LINE_BLOCKS;
+    if (cache_line_find(daddr, lun, line_lba)) continue;
+
+    msch_cache_line_t* line = cache_line_victim(true);
+    if (line == NULL) return;
+
+    cache_line_assign(line, daddr, lun, line_lba);
+    if (!cache_line_fill(line)) {
+      // end of media or command queue is full
+      line->daddr = 0;
+      return;
+    }
+  }
+}
+
+// Process current operation as far as possible, return when waiting for a line io or operation is complete
+static void cache_op_run(uint8_t daddr) {
+  msch_cache_op_t* op = &_msch_cache_op[daddr - 1];
+
+  if (op->type == CACHE_OP_FLUSH) {
+    for (uint8_t i = 0; i < CFG_TUH_MSC_CACHE_LINE_N; i++) {
+      msch_cache_line_t* line = &_msch_cache_line[i];
+      if (line->daddr != daddr) continue;
+      if (line->state != CACHE_LINE_IDLE) return; // wait for line io
+      if (line->dirty && !op->failed) {
+        // submission can fail if device is busy with other command, wait if it is our io
+        if (cache_line_writeback(line) || cache_io_pending(daddr)) return;
+        op->failed = true;
+      }
+    }
+    cache_op_complete(daddr, op, !op->failed);
+    return;
+  }
+
+  if (op->type != CACHE_OP_READ && op->type != CACHE_OP_WRITE) return;
+
+  while (op->remain && !op->failed) {
+    uint64_t const line_lba = cache_line_lba(op->lba);
+    uint32_t const bit = (uint32_t) TU_BIT(op->lba - line_lba);
+    msch_cache_line_t* line = cache_line_find(daddr, op->lun, line_lba);
+
+    if (op->type == CACHE_OP_READ && line && (line->valid & bit) && line->state != CACHE_LINE_FILLING) {
+      // hit
+      memcpy(op->buffer, cache_line_data(line) + (op->lba - line_lba) * CFG_TUH_MSC_CACHE_BLOCK_SIZE,
+             CFG_TUH_MSC_CACHE_BLOCK_SIZE);
+    } else if (line && line->state != CACHE_LINE_IDLE) {
+      return; // wait for line io
+    } else if (op->type == CACHE_OP_READ) {
+      // miss: write back dirty blocks first since fill overwrites the whole line
+      bool const sequential = (op->lba == op->read_next);
+
+      if (line == NULL) {
+        line = cache_line_victim(false);
+        if (line == NULL) return; // all lines are busy, wait
+        if (line->daddr && line->dirty) {
+          if (cache_line_writeback(line) || cache_io_pending(daddr)) return;
+          op->failed = true;
+          break;
+        }
+        cache_line_assign(line, daddr, op->lun, line_lba);
+      } else if (line->dirty) {
+        if (cache_line_writeback(line) || cache_io_pending(daddr)) return;
+        op->failed = true;
+        break;
+      }
+
+      if (!cache_line_fill(line)) {
+        line->daddr = 0;
+        if (cache_io_pending(daddr)) return;
+        op->failed = true;
+        break;
+      }
+
+      if (sequential) cache_read_ahead(daddr, op->lun, line_lba);
+      return;
+    } else {
+      // write: allocate without fill, block becomes valid & dirty
+      if (line == NULL) {
+        line = cache_line_victim(false);
+        if (line == NULL) return;
+        if (line->daddr && line->dirty) {
+          if (cache_line_writeback(line) || cache_io_pending(daddr)) return;
+          op->failed = true;
+          break;
+        }
+        cache_line_assign(line, daddr, op->lun, line_lba);
+      }
+
+      memcpy(cache_line_data(line) + (op->lba - line_lba) * CFG_TUH_MSC_CACHE_BLOCK_SIZE, op->buffer,
+             CFG_TUH_MSC_CACHE_BLOCK_SIZE);
+      line->valid |= bit;
+      line->dirty |= bit;
+    }
+
+    line->last_use = ++_msch_cache_tick;
+    op->buffer += CFG_TUH_MSC_CACHE_BLOCK_SIZE;
+    op->lba++;
+    op->remain--;
+    if (op->type == CACHE_OP_READ) op->read_next = op->lba;
+  }
+
+  cache_op_complete(daddr, op, !op->failed);
+}
+
+static bool cache_io_complete(uint8_t daddr, tuh_msc_complete_data_t const* cb_data) {
+  msch_cache_line_t* line = &_msch_cache_line[cb_data->user_arg];
+  msch_cache_op_t* op = &_msch_cache_op[daddr - 1];
+  bool const passed = (cb_data->csw->status == MSC_CSW_STATUS_PASSED);
+
+  // failed prefetch does not affect current operation, failed write back or fill of its line does
+  if (!passed && (op->type == CACHE_OP_READ || op->type == CACHE_OP_WRITE || op->type == CACHE_OP_FLUSH)) {
+    if (line->state == CACHE_LINE_WRITING || (line->lun == op->lun && line->lba == cache_line_lba(op->lba))) {
+      op->failed = true;
+    }
+  }
+
+  if (line->state == CACHE_LINE_FILLING) {
+    if (passed) {
+      uint32_t const count = cb_data->cbw->total_bytes / CFG_TUH_MSC_CACHE_BLOCK_SIZE;
+      line->valid = (count >= 32) ? UINT32_MAX : (uint32_t) (TU_BIT(count) - 1);
+    } else {
+      line->daddr = 0;
+    }
+  } else if (line->state == CACHE_LINE_WRITING) {
+    if (passed) line->dirty &= ~line->io_mask;
+    line->io_mask = 0;
+  }
+  line->state = CACHE_LINE_IDLE;
+
+  // continue write back of remaining dirty runs when flushing
+  if (passed && op->type == CACHE_OP_FLUSH && line->dirty && cache_line_writeback(line)) {
+    return true;
+  }
+
+  cache_op_run(daddr);
+  return true;
+}
+
+static bool cache_bypass_complete(uint8_t daddr, tuh_msc_complete_data_t const* cb_data) {
+  msch_cache_op_t* op = &_msch_cache_op[daddr - 1];
+  tuh_msc_complete_data_t user_data = *cb_data;
+  user_data.user_arg = op->complete_arg;
+  tuh_msc_complete_cb_t const complete_cb = op->complete_cb;
+
+  op->type = CACHE_OP_NONE;
+  if (complete_cb) {
+    complete_cb(daddr, &user_data);
+  }
+  return true;
+}
+
+static bool cache_xfer(uint8_t daddr, uint8_t lun, void* buffer, uint64_t lba, uint32_t block_count,
+                       uint8_t type, tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
+  msch_interface_t* p_msc = get_itf(daddr);
+  TU_VERIFY(p_msc->mounted && lun < CFG_TUH_MSC_MAXLUN && block_count);
+  msch_cache_op_t* op = &_msch_cache_op[daddr - 1];
+  TU_VERIFY(op->type == CACHE_OP_NONE);
+
+  bool const is_read = (type == CACHE_OP_READ);
+
+  op->lun = lun;
+  op->failed = false;
+  op->buffer = (uint8_t*) buffer;
+  op->user_buffer = buffer;
+  op->lba = lba;
+  op->remain = block_count;
+  op->block_count = block_count;
+  op->complete_cb = complete_cb;
+  op->complete_arg = arg;
+
+  // large request or not cacheable block size: transfer directly
+  if (p_msc->capacity[lun].block_size != CFG_TUH_MSC_CACHE_BLOCK_SIZE ||
+      (block_count >= CFG_TUH_MSC_CACHE_LINE_BLOCKS && !cache_overlap(daddr, lun, lba, block_count))) {
+    op->type = CACHE_OP_BYPASS;
+    bool const ret = is_read ? tuh_msc_read(daddr, lun, buffer, lba, block_count, cache_bypass_complete, 0)
+                             : tuh_msc_write(daddr, lun, buffer, lba, block_count, cache_bypass_complete, 0);
+    if (!ret) {
+      op->type = CACHE_OP_NONE;
+    } else if (is_read) {
+      op->read_next = lba + block_count;
+    }
+    return ret;
+  }
+
+  op->type = type;
+  cache_op_run(daddr);
+  return true;
+}
+
+bool tuh_msc_cache_read(uint8_t dev_addr, uint8_t lun, void* buffer, uint64_t lba, uint32_t block_count,
+                        tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
+  return cache_xfer(dev_addr, lun, buffer, lba, block_count, CACHE_OP_READ, complete_cb, arg);
+}
+
+bool tuh_msc_cache_write(uint8_t dev_addr, uint8_t lun, void const* buffer, uint64_t lba, uint32_t block_count,
+                         tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
+  return cache_xfer(dev_addr, lun, (void*) (uintptr_t) buffer, lba, block_count, CACHE_OP_WRITE, complete_cb, arg);
+}
+
+bool tuh_msc_cache_flush(uint8_t dev_addr, tuh_msc_complete_cb_t complete_cb, uintptr_t arg) {
+  TU_VERIFY(get_itf(dev_addr)->mounted);
+  msch_cache_op_t* op = &_msch_cache_op[dev_addr - 1];
+  TU_VERIFY(op->type == CACHE_OP_NONE);
+
+  op->type = CACHE_OP_FLUSH;
+  op->lun = 0;
+  op->failed = false;
+  op->user_buffer = NULL;
+  op->remain = 0;
+  op->block_count = 0;
+  op->complete_cb = complete_cb;
+  op->complete_arg = arg;
+
+  cache_op_run(dev_addr);
+  return true;
+}
+
+// Drop all lines of a device (dirty data is lost since device is gone)
+static void cache_close(uint8_t daddr) {
+  for (uint8_t i = 0; i < CFG_TUH_MSC_CACHE_LINE_N; i++) {
+    if (_msch_cache_line[i].daddr == daddr) {
+      tu_memclr(&_msch_cache_line[i], sizeof(msch_cache_line_t));
+    }
+  }
+  tu_memclr(&_msch_cache_op[daddr - 1], sizeof(msch_cache_op_t));
+}
+
+#endif
+
+//--------------------------------------------------------------------+
+// USB Attached SCSI (UAS)
+// Without streams each command IU is answered on the status pipe with Read/Write Ready IU when device wants
+// to move its data, then with Sense IU when it is complete. Data pipes carry one command's data at a time,
+// but up to CFG_TUH_MSC_UAS_TAG_N commands are queued inside the device.
+//--------------------------------------------------------------------+
+#if CFG_TUH_MSC_UAS
+
+// Put command into a free tag slot, must be called with msch_lock() held
+static bool uas_slot_start(msch_interface_t* p_msc, msch_cmd_t const* cmd) {
+  for (uint8_t i = 0; i < CFG_TUH_MSC_UAS_TAG_N; i++) {
+    msch_uas_slot_t* slot = &p_msc->uas.slot[i];
+    if (slot->state == UAS_SLOT_FREE) {
+      slot->cmd = *cmd;
+      slot->xferred = 0;
+      slot->state = UAS_SLOT_CMD;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool uas_slot_waiting(msch_interface_t const* p_msc) {
+  for (uint8_t i = 0; i < CFG_TUH_MSC_UAS_TAG_N; i++) {
+    if (p_msc->uas.slot[i].state == UAS_SLOT_CMD) return true;
+  }
+  return false;
+}
+
+// Command, Ready or Sense IU is still expected from device
+static bool uas_slot_outstanding(msch_interface_t const* p_msc) {
+  for (uint8_t i = 0; i < CFG_TUH_MSC_UAS_TAG_N; i++) {
+    if (p_msc->uas.slot[i].state >= UAS_SLOT_SENT) return true;
+  }
+  return false;
+}
+
+// Command of slot is done: continue with next chunk of block transfer, or report to application
+// and refill slot from command queue
+static void uas_slot_done(uint8_t daddr, msch_interface_t* p_msc, msch_uas_slot_t* slot, uint8_t status) {
+  msch_cmd_t* cmd = &slot->cmd;
+
+  if (cmd->block_remain && status == MSC_CSW_STATUS_PASSED) {
+    cmd->buffer += cmd->cbw.total_bytes;
+    cmd_block_next(p_msc, cmd);
+    slot->xferred = 0;
+    slot->state = UAS_SLOT_CMD;
+    uas_cmd_kick(daddr, p_msc);
+    return;
+  }
+
+  // no residue in UAS, it is what data pipe did not transfer
+  msc_cbw_t const cbw_done = cmd->cbw;
+  msc_csw_t const csw_done = {
+      .signature    = MSC_CSW_SIGNATURE,
+      .tag          = cbw_done.tag,
+      .data_residue = cbw_done.total_bytes - tu_min32(slot->xferred, cbw_done.total_bytes),
+      .status       = status
+  };
+  tuh_msc_complete_data_t const cb_data = {
+      .cbw = &cbw_done,
+      .csw = &csw_done,
+      .scsi_data = cmd->user_buffer,
+      .user_arg = cmd->complete_arg
   };
-  memcpy(cbw.command, &cmd_write10, cbw.cmd_len);
+  tuh_msc_complete_cb_t const complete_cb = cmd->complete_cb;
+
+  msch_lock();
+  slot->state = UAS_SLOT_FREE;
+  #if CFG_TUH_MSC_CMD_QUEUE_N
+  if (p_msc->queue_count) {
+    slot->cmd = p_msc->queue[p_msc->queue_rd];
+    slot->xferred = 0;
+    slot->state = UAS_SLOT_CMD;
+    p_msc->queue_rd = (uint8_t) ((p_msc->queue_rd + 1) % CFG_TUH_MSC_CMD_QUEUE_N);
+    p_msc->queue_count--;
+  }
+  #endif
+  bool const refilled = (slot->state == UAS_SLOT_CMD);
+  msch_unlock();
+
+  if (refilled) {
+    uas_cmd_kick(daddr, p_msc);
+  }
+
+  if (complete_cb) {
+    complete_cb(daddr, &cb_data);
+  }
+}
+
+// Send command IU of a slot waiting for command pipe. If pipe is busy, its completion kicks again.
+// Can be called from application and usbh task: slot is marked before pipe is claimed, and waiting slots
+// are checked again after releasing pipe, so that no command is left behind.
+static void uas_cmd_kick(uint8_t daddr, msch_interface_t* p_msc) {
+  msch_epbuf_t* epbuf = get_epbuf(daddr);
+  uint8_t const ep_cmd = p_msc->uas.ep_cmd;
+  msch_uas_slot_t* slot = NULL;
+  uint8_t idx = 0;
+
+  while (slot == NULL) {
+    if (!usbh_edpt_claim(daddr, ep_cmd)) return;
+
+    msch_lock();
+    for (idx = 0; idx < CFG_TUH_MSC_UAS_TAG_N; idx++) {
+      if (p_msc->uas.slot[idx].state == UAS_SLOT_CMD) {
+        slot = &p_msc->uas.slot[idx];
+        slot->state = UAS_SLOT_SENDING;
+        p_msc->uas.cmd_slot = idx;
+        break;
+      }
+    }
+    msch_unlock();
+
+    if (slot == NULL) {
+      usbh_edpt_release(daddr, ep_cmd);
+      msch_lock();
+      bool const waiting = uas_slot_waiting(p_msc);
+      msch_unlock();
+      if (!waiting) return;
+    }
+  }
+
+  msc_cbw_t const* cbw = &slot->cmd.cbw;
+  msc_uas_command_iu_t* iu = &epbuf->uas_cmd;
+  tu_memclr(iu, sizeof(msc_uas_command_iu_t));
+  iu->header.iu_id = MSC_UAS_IU_COMMAND;
+  iu->header.tag   = tu_htons((uint16_t) (idx + 1));
+  iu->task_attr    = MSC_UAS_TASK_ATTR_SIMPLE;
+  iu->lun[1]       = cbw->lun;
+  memcpy(iu->cdb, cbw->command, sizeof(iu->cdb));
+
+  if (!usbh_edpt_xfer(daddr, ep_cmd, (uint8_t*) iu, sizeof(msc_uas_command_iu_t))) {
+    usbh_edpt_release(daddr, ep_cmd);
+    TU_LOG_DRV("  MSCh UAS failed to send command IU\r\n");
+    uas_slot_done(daddr, p_msc, slot, MSC_CSW_STATUS_FAILED);
+  }
+}
+
+static void uas_status_arm(uint8_t daddr, msch_interface_t* p_msc) {
+  if (p_msc->uas.status_busy) return;
+  msch_epbuf_t* epbuf = get_epbuf(daddr);
+  p_msc->uas.status_busy = usbh_edpt_xfer(daddr, p_msc->uas.ep_status, epbuf->uas_status, UAS_STATUS_IU_MAX);
+  TU_ASSERT(p_msc->uas.status_busy,);
+}
+
+// Start data phase of slots whose Ready IU is received, one at a time per pipe
+static void uas_data_kick(uint8_t daddr, msch_interface_t* p_msc, bool is_in) {
+  uint8_t const ep_data = is_in ? p_msc->uas.ep_data_in : p_msc->uas.ep_data_out;
+  if (usbh_edpt_busy(daddr, ep_data)) return;
+
+  for (uint8_t i = 0; i < CFG_TUH_MSC_UAS_TAG_N; i++) {
+    msch_uas_slot_t* slot = &p_msc->uas.slot[i];
+    if (slot->state != UAS_SLOT_READY || ((slot->cmd.cbw.dir & TUSB_DIR_IN_MASK) != 0) != is_in) continue;
+
+    slot->state = UAS_SLOT_DATA;
+    if (usbh_edpt_xfer(daddr, ep_data, slot->cmd.buffer, slot->cmd.cbw.total_bytes)) return;
+
+    uas_slot_done(daddr, p_msc, slot, MSC_CSW_STATUS_FAILED);
+  }
+}
+
+static void uas_status_process(uint8_t daddr, msch_interface_t* p_msc, uint32_t xferred_bytes) {
+  uint8_t const* status = get_epbuf(daddr)->uas_status;
+  TU_VERIFY(xferred_bytes >= sizeof(msc_uas_iu_header_t),);
+
+  msc_uas_iu_header_t const* header = (msc_uas_iu_header_t const*) status;
+  uint16_t const tag = tu_ntohs(header->tag);
+  TU_VERIFY(tag > 0 && tag <= CFG_TUH_MSC_UAS_TAG_N,);
+
+  msch_uas_slot_t* slot = &p_msc->uas.slot[tag - 1];
+  // IU of a command that is not waiting for one (e.g completed after an error) is dropped
+  TU_VERIFY(slot->state == UAS_SLOT_SENT,);
+
+  switch (header->iu_id) {
+    case MSC_UAS_IU_READ_READY:
+    case MSC_UAS_IU_WRITE_READY: {
+      bool const is_in = (header->iu_id == MSC_UAS_IU_READ_READY);
+      if (((slot->cmd.cbw.dir & TUSB_DIR_IN_MASK) != 0) != is_in ||
+          slot->cmd.cbw.total_bytes == 0 || slot->cmd.buffer == NULL) {
+        uas_slot_done(daddr, p_msc, slot, MSC_CSW_STATUS_PHASE_ERROR);
+        break;
+      }
+      slot->state = UAS_SLOT_READY;
+      uas_data_kick(daddr, p_msc, is_in);
+      break;
+    }
+
+    case MSC_UAS_IU_SENSE: {
+      TU_VERIFY(xferred_bytes >= sizeof(msc_uas_sense_iu_t),);
+      msc_uas_sense_iu_t const* sense = (msc_uas_sense_iu_t const*) status;
+      uas_slot_done(daddr, p_msc, slot, sense->status == 0 ? MSC_CSW_STATUS_PASSED : MSC_CSW_STATUS_FAILED);
+      break;
+    }
+
+    case MSC_UAS_IU_RESPONSE:
+      // command IU is rejected e.g invalid IU or incorrect LUN
+      TU_LOG_DRV("  MSCh UAS response code %u for tag %u\r\n",
+                 ((msc_uas_response_iu_t const*) status)->response_code, tag);
+      uas_slot_done(daddr, p_msc, slot, MSC_CSW_STATUS_FAILED);
+      break;
+
+    default:
+      break;
+  }
+}
+
+static bool uas_xfer_cb(uint8_t daddr, msch_interface_t* p_msc, uint8_t ep_addr, xfer_result_t event,
+                        uint32_t xferred_bytes) {
+  if (ep_addr == p_msc->uas.ep_cmd) {
+    msch_uas_slot_t* slot = &p_msc->uas.slot[p_msc->uas.cmd_slot];
+    if (event == XFER_RESULT_SUCCESS) {
+      slot->state = UAS_SLOT_SENT;
+      uas_status_arm(daddr, p_msc);
+    } else {
+      uas_slot_done(daddr, p_msc, slot, MSC_CSW_STATUS_FAILED);
+    }
+    uas_cmd_kick(daddr, p_msc);
+  } else if (ep_addr == p_msc->uas.ep_status) {
+    p_msc->uas.status_busy = false;
+    if (event == XFER_RESULT_SUCCESS) {
+      uas_status_process(daddr, p_msc, xferred_bytes);
+    } else {
+      // status pipe is broken, nothing can complete: fail all outstanding commands
+      for (uint8_t i = 0; i < CFG_TUH_MSC_UAS_TAG_N; i++) {
+        msch_uas_slot_t* slot = &p_msc->uas.slot[i];
+        if (slot->state >= UAS_SLOT_SENT) {
+          uas_slot_done(daddr, p_msc, slot, MSC_CSW_STATUS_FAILED);
+        }
+      }
+    }
+    if (uas_slot_outstanding(p_msc)) {
+      uas_status_arm(daddr, p_msc);
+    }
+  } else {
+    bool const is_in = (ep_addr == p_msc->uas.ep_data_in);
+    for (uint8_t i = 0; i < CFG_TUH_MSC_UAS_TAG_N; i++) {
+      msch_uas_slot_t* slot = &p_msc->uas.slot[i];
+      if (slot->state != UAS_SLOT_DATA || ((slot->cmd.cbw.dir & TUSB_DIR_IN_MASK) != 0) != is_in) continue;
+
+      if (event == XFER_RESULT_SUCCESS) {
+        // Sense IU follows on status pipe
+        slot->xferred = xferred_bytes;
+        slot->state = UAS_SLOT_SENT;
+      } else {
+        uas_slot_done(daddr, p_msc, slot, MSC_CSW_STATUS_FAILED);
+      }
+      break;
+    }
+    uas_data_kick(daddr, p_msc, is_in);
+  }
+
+  return true;
+}
 
-  return tuh_msc_scsi_command(dev_addr, &cbw, (void*) (uintptr_t) buffer, complete_cb, arg);
+// UAS is an alternate setting of the BOT interface (BOT must be alternate 0). Look for an alternate with UAS
+// protocol and 4 bulk endpoints identified by Pipe Usage descriptors, open its endpoints that are not shared
+// with BOT. Alternate is selected in set_config, BOT is kept if anything is missing.
+static void uas_open(uint8_t daddr, msch_interface_t* p_msc, tusb_desc_interface_t const* desc_itf, uint16_t max_len) {
+  uint8_t const* p_desc = (uint8_t const*) desc_itf;
+  uint8_t const* desc_end = p_desc + max_len;
+  tusb_desc_interface_t const* uas_itf = NULL;
+  tusb_desc_endpoint_t const* ep_desc = NULL;
+  tusb_desc_endpoint_t const* pipe_ep[4] = { NULL, NULL, NULL, NULL };
+
+  for (p_desc = tu_desc_next(p_desc); p_desc < desc_end; p_desc = tu_desc_next(p_desc)) {
+    uint8_t const desc_type = tu_desc_type(p_desc);
+    if (desc_type == TUSB_DESC_INTERFACE) {
+      if (uas_itf) break; // end of UAS alternate
+      tusb_desc_interface_t const* itf = (tusb_desc_interface_t const*) p_desc;
+      if (itf->bInterfaceNumber == desc_itf->bInterfaceNumber && itf->bAlternateSetting &&
+          itf->bInterfaceSubClass == MSC_SUBCLASS_SCSI && itf->bInterfaceProtocol == MSC_PROTOCOL_UAS &&
+          itf->bNumEndpoints == 4) {
+        uas_itf = itf;
+      }
+    } else if (uas_itf && desc_type == TUSB_DESC_ENDPOINT) {
+      ep_desc = (tusb_desc_endpoint_t const*) p_desc;
+    } else if (uas_itf && ep_desc && desc_type == MSC_UAS_DESC_PIPE_USAGE) {
+      uint8_t const pipe_id = ((msc_uas_desc_pipe_usage_t const*) p_desc)->bPipeID;
+      if (pipe_id >= MSC_UAS_PIPE_COMMAND && pipe_id <= MSC_UAS_PIPE_DATA_OUT) {
+        pipe_ep[pipe_id - 1] = ep_desc;
+      }
+      ep_desc = NULL;
+    }
+  }
+  TU_VERIFY(uas_itf,);
+
+  for (uint8_t i = 0; i < 4; i++) {
+    // command & data-out pipes are OUT, status & data-in pipes are IN
+    tusb_dir_t const dir = (i == MSC_UAS_PIPE_COMMAND - 1 || i == MSC_UAS_PIPE_DATA_OUT - 1) ? TUSB_DIR_OUT : TUSB_DIR_IN;
+    TU_VERIFY(pipe_ep[i] && TUSB_XFER_BULK == pipe_ep[i]->bmAttributes.xfer &&
+              dir == tu_edpt_dir(pipe_ep[i]->bEndpointAddress),);
+  }
+
+  for (uint8_t i = 0; i < 4; i++) {
+    uint8_t const ep_addr = pipe_ep[i]->bEndpointAddress;
+    if (ep_addr != p_msc->ep_in && ep_addr != p_msc->ep_out) {
+      TU_ASSERT(tuh_edpt_open(daddr, pipe_ep[i]),);
+    }
+  }
+
+  p_msc->uas.ep_cmd      = pipe_ep[MSC_UAS_PIPE_COMMAND - 1]->bEndpointAddress;
+  p_msc->uas.ep_status   = pipe_ep[MSC_UAS_PIPE_STATUS - 1]->bEndpointAddress;
+  p_msc->uas.ep_data_in  = pipe_ep[MSC_UAS_PIPE_DATA_IN - 1]->bEndpointAddress;
+  p_msc->uas.ep_data_out = pipe_ep[MSC_UAS_PIPE_DATA_OUT - 1]->bEndpointAddress;
+  p_msc->uas.alt         = uas_itf->bAlternateSetting;
 }
 
+#endif
+
 #if 0
 // MSC interface Reset (not used now)
 bool tuh_msc_reset(uint8_t dev_addr) {
@@ -288,6 +1203,15 @@ bool msch_init(void) {
   TU_LOG_DRV("sizeof(msch_interface_t) = %u\r\n", sizeof(msch_interface_t));
   TU_LOG_DRV("sizeof(msch_epbuf_t) = %u\r\n", sizeof(msch_epbuf_t));
   tu_memclr(_msch_itf, sizeof(_msch_itf));
+  #if CFG_TUH_MSC_CACHE_LINE_N
+  tu_memclr(_msch_cache_line, sizeof(_msch_cache_line));
+  tu_memclr(_msch_cache_op, sizeof(_msch_cache_op));
+  #endif
+  #if OSAL_MUTEX_REQUIRED
+  if (_msch_mutex == NULL) {
+    _msch_mutex = osal_mutex_create(&_msch_mutexdef);
+  }
+  #endif
   return true;
 }
 
@@ -310,6 +1234,10 @@ void msch_close(uint8_t dev_addr) {
   }
 
   tu_memclr(p_msc, sizeof(msch_interface_t));
+
+  #if CFG_TUH_MSC_CACHE_LINE_N
+  cache_close(dev_addr);
+  #endif
 }
 
 bool msch_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes) {
@@ -318,15 +1246,23 @@ bool msch_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32
   msc_cbw_t const * cbw = &epbuf->cbw;
   msc_csw_t       * csw = &epbuf->csw;
 
+  msch_cmd_t* cmd = &p_msc->cmd;
+
+  #if CFG_TUH_MSC_UAS
+  if (p_msc->uas.active) {
+    return uas_xfer_cb(dev_addr, p_msc, ep_addr, event, xferred_bytes);
+  }
+  #endif
+
   switch (p_msc->stage) {
     case MSC_STAGE_CMD:
       // Must be Command Block
       TU_ASSERT(ep_addr == p_msc->ep_out && event == XFER_RESULT_SUCCESS && xferred_bytes == sizeof(msc_cbw_t));
-      if (cbw->total_bytes && p_msc->buffer) {
+      if (cbw->total_bytes && cmd->buffer) {
         // Data stage if any
         p_msc->stage = MSC_STAGE_DATA;
         uint8_t const ep_data = (cbw->dir & TUSB_DIR_IN_MASK) ? p_msc->ep_in : p_msc->ep_out;
-        TU_ASSERT(usbh_edpt_xfer(dev_addr, ep_data, p_msc->buffer, (uint16_t) cbw->total_bytes));
+        TU_ASSERT(usbh_edpt_xfer(dev_addr, ep_data, cmd->buffer, cbw->total_bytes));
         break;
       }
 
@@ -338,20 +1274,54 @@ bool msch_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32
       TU_ASSERT(usbh_edpt_xfer(dev_addr, p_msc->ep_in, (uint8_t*) csw, (uint16_t) sizeof(msc_csw_t)));
       break;
 
-    case MSC_STAGE_STATUS:
-      // SCSI op is complete
+    case MSC_STAGE_STATUS: {
+      // continue with next chunk of block transfer without notifying application
+      if (cmd->block_remain && event == XFER_RESULT_SUCCESS && csw->status == MSC_CSW_STATUS_PASSED) {
+        cmd->buffer += cbw->total_bytes;
+        cmd_block_next(p_msc, cmd);
+        p_msc->stage = MSC_STAGE_CMD;
+        TU_ASSERT(cmd_xfer(dev_addr, p_msc));
+        break;
+      }
+
+      // SCSI op is complete, keep a copy for callback since next queued command reuses endpoint buffers
+      msc_cbw_t const cbw_done = *cbw;
+      msc_csw_t const csw_done = *csw;
+      tuh_msc_complete_data_t const cb_data = {
+          .cbw = &cbw_done,
+          .csw = &csw_done,
+          .scsi_data = cmd->user_buffer,
+          .user_arg = cmd->complete_arg
+      };
+      tuh_msc_complete_cb_t const complete_cb = cmd->complete_cb;
+
       p_msc->stage = MSC_STAGE_IDLE;
 
-      if (p_msc->complete_cb) {
-        tuh_msc_complete_data_t const cb_data = {
-            .cbw = cbw,
-            .csw = csw,
-            .scsi_data = p_msc->buffer,
-            .user_arg = p_msc->complete_arg
-        };
-        p_msc->complete_cb(dev_addr, &cb_data);
+      #if CFG_TUH_MSC_CMD_QUEUE_N
+      // start next queued command right away
+      while (1) {
+        msch_lock();
+        bool const has_next = (p_msc->stage == MSC_STAGE_IDLE) && p_msc->queue_count;
+        if (has_next) {
+          p_msc->cmd = p_msc->queue[p_msc->queue_rd];
+          p_msc->queue_rd = (uint8_t) ((p_msc->queue_rd + 1) % CFG_TUH_MSC_CMD_QUEUE_N);
+          p_msc->queue_count--;
+          p_msc->stage = MSC_STAGE_CMD;
+        }
+        msch_unlock();
+
+        if (!has_next || cmd_xfer(dev_addr, p_msc)) break;
+
+        TU_LOG_DRV("  MSCh failed to start queued command, dropped\r\n");
+        p_msc->stage = MSC_STAGE_IDLE;
+      }
+      #endif
+
+      if (complete_cb) {
+        complete_cb(dev_addr, &cb_data);
       }
       break;
+    }
 
       // unknown state
     default:
@@ -364,10 +1334,16 @@ bool msch_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32
 //--------------------------------------------------------------------+
 // MSC Enumeration
 //--------------------------------------------------------------------+
+static bool config_get_maxlun(uint8_t daddr, uint8_t itf_num);
 static void config_get_maxlun_complete(tuh_xfer_t* xfer);
+#if CFG_TUH_MSC_UAS
+static void config_set_uas_complete(tuh_xfer_t* xfer);
+#endif
 static bool config_test_unit_ready_complete(uint8_t dev_addr, tuh_msc_complete_data_t const* cb_data);
 static bool config_request_sense_complete(uint8_t dev_addr, tuh_msc_complete_data_t const* cb_data);
 static bool config_read_capacity_complete(uint8_t dev_addr, tuh_msc_complete_data_t const* cb_data);
+static bool config_read_capacity16_complete(uint8_t dev_addr, tuh_msc_complete_data_t const* cb_data);
+static void config_mount_complete(uint8_t dev_addr);
 
 bool msch_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const* desc_itf, uint16_t max_len) {
   (void) rhport;
@@ -397,6 +1373,10 @@ bool msch_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const* de
 
   p_msc->itf_num = desc_itf->bInterfaceNumber;
 
+  #if CFG_TUH_MSC_UAS
+  uas_open(dev_addr, p_msc, desc_itf, max_len);
+  #endif
+
   return true;
 }
 
@@ -405,6 +1385,39 @@ bool msch_set_config(uint8_t daddr, uint8_t itf_num) {
   TU_ASSERT(p_msc->itf_num == itf_num);
   p_msc->configured = true;
 
+  #if CFG_TUH_MSC_UAS
+  if (p_msc->uas.alt) {
+    TU_LOG_DRV("MSC Set Interface UAS alt %u\r\n", p_msc->uas.alt);
+    TU_ASSERT(tuh_interface_set(daddr, itf_num, p_msc->uas.alt, config_set_uas_complete, 0));
+    return true;
+  }
+  #endif
+
+  return config_get_maxlun(daddr, itf_num);
+}
+
+#if CFG_TUH_MSC_UAS
+static void config_set_uas_complete(tuh_xfer_t* xfer) {
+  uint8_t const daddr = xfer->daddr;
+  msch_interface_t* p_msc = get_itf(daddr);
+
+  if (XFER_RESULT_SUCCESS != xfer->result) {
+    // device stays in alternate 0
+    TU_LOG_DRV("  UAS alternate rejected, use Bulk-Only\r\n");
+    TU_ASSERT(config_get_maxlun(daddr, p_msc->itf_num),);
+    return;
+  }
+
+  // UAS has no GET MAX LUN, only LUN 0 is used since REPORT LUNS is not issued
+  p_msc->uas.active = true;
+  p_msc->max_lun = 1;
+
+  TU_LOG_DRV("SCSI Test Unit Ready\r\n");
+  tuh_msc_test_unit_ready(daddr, 0, config_test_unit_ready_complete, 0);
+}
+#endif
+
+static bool config_get_maxlun(uint8_t daddr, uint8_t itf_num) {
   //------------- Get Max Lun -------------//
   TU_LOG_DRV("MSC Get Max Lun\r\n");
   tusb_control_request_t const request = {
@@ -492,9 +1505,53 @@ static bool config_read_capacity_complete(uint8_t dev_addr, tuh_msc_complete_dat
 
   // Capacity response field: Block size and Last LBA are both Big-Endian
   scsi_read_capacity10_resp_t* resp = (scsi_read_capacity10_resp_t*) (uintptr_t) enum_buf;
-  p_msc->capacity[cbw->lun].block_count = tu_ntohl(resp->last_lba) + 1;
+  uint32_t const last_lba = tu_ntohl(resp->last_lba);
+
+  if (last_lba == UINT32_MAX) {
+    // media has more than 2^32 blocks, need READ CAPACITY (16)
+    TU_LOG_DRV("SCSI Read Capacity 16\r\n");
+    msc_cbw_t cbw16;
+    cbw_init(&cbw16, cbw->lun);
+    cbw16.total_bytes = sizeof(scsi_read_capacity16_resp_t);
+    cbw16.dir         = TUSB_DIR_IN_MASK;
+    cbw16.cmd_len     = sizeof(scsi_read_capacity16_t);
+
+    scsi_read_capacity16_t const cmd_capacity16 = {
+        .cmd_code       = SCSI_CMD_SERVICE_ACTION_IN_16,
+        .service_action = SCSI_SERVICE_ACTION_READ_CAPACITY_16,
+        .alloc_length   = tu_htonl(sizeof(scsi_read_capacity16_resp_t))
+    };
+    memcpy(cbw16.command, &cmd_capacity16, cbw16.cmd_len);
+
+    TU_ASSERT(tuh_msc_scsi_command(dev_addr, &cbw16, enum_buf, config_read_capacity16_complete, 0));
+    return true;
+  }
+
+  p_msc->capacity[cbw->lun].block_count = (uint64_t) last_lba + 1;
+  p_msc->capacity[cbw->lun].block_size  = tu_ntohl(resp->block_size);
+
+  config_mount_complete(dev_addr);
+  return true;
+}
+
+static bool config_read_capacity16_complete(uint8_t dev_addr, tuh_msc_complete_data_t const* cb_data) {
+  msc_cbw_t const* cbw = cb_data->cbw;
+  msc_csw_t const* csw = cb_data->csw;
+  TU_ASSERT(csw->status == 0);
+  msch_interface_t* p_msc = get_itf(dev_addr);
+  uint8_t* enum_buf = usbh_get_enum_buf();
+
+  scsi_read_capacity16_resp_t const* resp = (scsi_read_capacity16_resp_t const*) (uintptr_t) enum_buf;
+  p_msc->capacity[cbw->lun].block_count = msc_htonll(resp->last_lba) + 1;
   p_msc->capacity[cbw->lun].block_size  = tu_ntohl(resp->block_size);
 
+  config_mount_complete(dev_addr);
+  return true;
+}
+
+static void config_mount_complete(uint8_t dev_addr) {
+  msch_interface_t* p_msc = get_itf(dev_addr);
+
   // Mark enumeration is complete
   p_msc->mounted = true;
   if (tuh_msc_mount_cb) {
@@ -503,8 +1560,6 @@ static bool config_read_capacity_complete(uint8_t dev_addr, tuh_msc_complete_dat
 
   // notify usbh that driver enumeration is complete
   usbh_driver_set_config_complete(dev_addr, p_msc->itf_num);
-
-  return true;
 }
 
 #endif
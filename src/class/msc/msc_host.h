@@ -41,6 +41,53 @@
 #define CFG_TUH_MSC_MAXLUN  4
 #endif
 
+// Number of SCSI commands that can be queued per device while another one is in progress. Next command's
+// CBW is sent right after previous CSW is received. 0 means busy device rejects new command.
+#ifndef CFG_TUH_MSC_CMD_QUEUE_N
+#define CFG_TUH_MSC_CMD_QUEUE_N  0
+#endif
+
+// Max data bytes of a single READ/WRITE command, larger tuh_msc_read()/tuh_msc_write() are split into
+// several commands. Without CFG_TUH_EDPT_XFER_LARGE, it is limited by what hcd can transfer at once.
+#ifndef CFG_TUH_MSC_XFER_MAX
+  #if CFG_TUH_EDPT_XFER_LARGE
+    #define CFG_TUH_MSC_XFER_MAX  (256u*1024u)
+  #else
+    #define CFG_TUH_MSC_XFER_MAX  TUP_HCD_EDPT_XFER_MAX
+  #endif
+#endif
+
+// Block cache used by tuh_msc_cache_read/write(): number of cache lines shared by all devices, 0 to disable.
+// Each line holds CFG_TUH_MSC_CACHE_LINE_BLOCKS consecutive blocks of CFG_TUH_MSC_CACHE_BLOCK_SIZE bytes.
+#ifndef CFG_TUH_MSC_CACHE_LINE_N
+#define CFG_TUH_MSC_CACHE_LINE_N  0
+#endif
+
+#ifndef CFG_TUH_MSC_CACHE_LINE_BLOCKS
+#define CFG_TUH_MSC_CACHE_LINE_BLOCKS  8
+#endif
+
+#ifndef CFG_TUH_MSC_CACHE_BLOCK_SIZE
+#define CFG_TUH_MSC_CACHE_BLOCK_SIZE  512
+#endif
+
+// Number of lines prefetched when sequential read is detected. Prefetch are queued SCSI commands, therefore
+// this is also limited by CFG_TUH_MSC_CMD_QUEUE_N
+#ifndef CFG_TUH_MSC_CACHE_READ_AHEAD
+#define CFG_TUH_MSC_CACHE_READ_AHEAD  1
+#endif
+
+// Use USB Attached SCSI (UAS) if device has an alternate setting for it, Bulk-Only Transport is used otherwise
+// or when device rejects the alternate. Only the 4 pipes model without streams (full/high speed) is supported.
+#ifndef CFG_TUH_MSC_UAS
+#define CFG_TUH_MSC_UAS  0
+#endif
+
+// Number of tagged UAS commands outstanding per device, further commands are held in CFG_TUH_MSC_CMD_QUEUE_N
+#ifndef CFG_TUH_MSC_UAS_TAG_N
+#define CFG_TUH_MSC_UAS_TAG_N  4
+#endif
+
 typedef struct {
   msc_cbw_t const* cbw; // SCSI command
   msc_csw_t const* csw; // SCSI status
@@ -58,21 +105,28 @@ typedef bool (*tuh_msc_complete_cb_t)(uint8_t dev_addr, tuh_msc_complete_data_t
 // This function true after tuh_msc_mounted_cb() and false after tuh_msc_unmounted_cb()
 bool tuh_msc_mounted(uint8_t dev_addr);
 
-// Check if the interface is currently ready or busy transferring data
+// Check if the interface is currently ready or busy transferring data.
+// With UAS, ready means another command can be started without queueing
 bool tuh_msc_ready(uint8_t dev_addr);
 
+// Check if device is driven with USB Attached SCSI instead of Bulk-Only Transport
+bool tuh_msc_is_uas(uint8_t dev_addr);
+
 // Get Max Lun
 uint8_t tuh_msc_get_maxlun(uint8_t dev_addr);
 
-// Get number of block
+// Get number of block, saturated to UINT32_MAX for media larger than 2^32 blocks
 uint32_t tuh_msc_get_block_count(uint8_t dev_addr, uint8_t lun);
 
+// Get number of block (64-bit)
+uint64_t tuh_msc_get_block_count64(uint8_t dev_addr, uint8_t lun);
+
 // Get block size in bytes
 uint32_t tuh_msc_get_block_size(uint8_t dev_addr, uint8_t lun);
 
 // Perform a full SCSI command (cbw, data, csw) in non-blocking manner.
 // Complete callback is invoked when SCSI op is complete.
-// return true if success, false if there is already pending operation.
+// return true if success, false if there is already pending operation (and command queue is full if enabled).
 // NOTE: buffer must be accessible by USB/DMA controller, aligned correctly and multiple of cache line if enabled
 bool tuh_msc_scsi_command(uint8_t daddr, msc_cbw_t const* cbw, void* data, tuh_msc_complete_cb_t complete_cb, uintptr_t arg);
 
@@ -100,6 +154,35 @@ bool tuh_msc_read10(uint8_t dev_addr, uint8_t lun, void * buffer, uint32_t lba,
 // NOTE: buffer must be accessible by USB/DMA controller, aligned correctly and multiple of cache line if enabled
 bool tuh_msc_write10(uint8_t dev_addr, uint8_t lun, void const * buffer, uint32_t lba, uint16_t block_count, tuh_msc_complete_cb_t complete_cb, uintptr_t arg);
 
+// Read n blocks starting from LBA to buffer. READ (10) or READ (16) is used depending on LBA, transfer
+// larger than CFG_TUH_MSC_XFER_MAX is split into multiple commands. Complete callback is invoked once
+// when all blocks are read or a command fails, cbw/csw in callback are of the last command.
+// NOTE: buffer must be accessible by USB/DMA controller, aligned correctly and multiple of cache line if enabled
+bool tuh_msc_read(uint8_t dev_addr, uint8_t lun, void* buffer, uint64_t lba, uint32_t block_count,
+                  tuh_msc_complete_cb_t complete_cb, uintptr_t arg);
+
+// Write n blocks starting from LBA to device, same as tuh_msc_read() but with WRITE (10) or WRITE (16)
+// NOTE: buffer must be accessible by USB/DMA controller, aligned correctly and multiple of cache line if enabled
+bool tuh_msc_write(uint8_t dev_addr, uint8_t lun, void const* buffer, uint64_t lba, uint32_t block_count,
+                   tuh_msc_complete_cb_t complete_cb, uintptr_t arg);
+
+#if CFG_TUH_MSC_CACHE_LINE_N
+// Cached version of tuh_msc_read()/tuh_msc_write(). Small requests are served from cache lines (LRU),
+// sequential reads trigger read-ahead of next lines and writes are kept in cache (write-back) until the
+// line is evicted or tuh_msc_cache_flush() is called. Requests of at least a line that do not overlap any
+// cached line bypass the cache. Only one cached operation per device can be in progress.
+// Complete callback may be invoked before this function returns if request is served from cache entirely.
+// Note: must be called from the same thread as tuh_task(), device with other block size is not cached.
+bool tuh_msc_cache_read(uint8_t dev_addr, uint8_t lun, void* buffer, uint64_t lba, uint32_t block_count,
+                        tuh_msc_complete_cb_t complete_cb, uintptr_t arg);
+
+bool tuh_msc_cache_write(uint8_t dev_addr, uint8_t lun, void const* buffer, uint64_t lba, uint32_t block_count,
+                         tuh_msc_complete_cb_t complete_cb, uintptr_t arg);
+
+// Write back all dirty blocks of device, complete callback is invoked when done (csw status failed on error)
+bool tuh_msc_cache_flush(uint8_t dev_addr, tuh_msc_complete_cb_t complete_cb, uintptr_t arg);
+#endif
+
 // Perform SCSI Read Capacity 10 command
 // Complete callback is invoked when SCSI op is complete.
 // Note: during enumeration, host stack already carried out this request. Application can retrieve capacity by
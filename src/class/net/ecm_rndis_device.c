@@ -40,9 +40,21 @@ extern void rndis_class_set_handler(uint8_t *data, int size); /* found in ./misc
 #define CFG_TUD_NET_PACKET_PREFIX_LEN sizeof(rndis_data_packet_t)
 #define CFG_TUD_NET_PACKET_SUFFIX_LEN 0
 
-#define NETD_PACKET_SIZE  (CFG_TUD_NET_PACKET_PREFIX_LEN + CFG_TUD_NET_MTU + CFG_TUD_NET_PACKET_PREFIX_LEN)
+#if CFG_TUD_RNDIS_PACKETS_PER_TRANSFER > 1
+  // aggregated RNDIS messages are aligned to 4 bytes, must match MaxTransferSize in rndis_reports.c
+  #define NETD_RNDIS_MSG_ALIGN(_len)  (TU_DIV_CEIL(_len, 4) * 4)
+  #define NETD_PACKET_SIZE  (CFG_TUD_RNDIS_PACKETS_PER_TRANSFER * NETD_RNDIS_MSG_ALIGN(CFG_TUD_NET_PACKET_PREFIX_LEN + CFG_TUD_NET_MTU))
+#else
+  #define NETD_RNDIS_MSG_ALIGN(_len)  (_len)
+  #define NETD_PACKET_SIZE  (CFG_TUD_NET_PACKET_PREFIX_LEN + CFG_TUD_NET_MTU + CFG_TUD_NET_PACKET_PREFIX_LEN)
+#endif
 #define NETD_CONTROL_SIZE 120
 
+// size of a full sized packet in transmit/receive buffer
+#define NETD_PACKET_MSG_SIZE  NETD_RNDIS_MSG_ALIGN(CFG_TUD_NET_PACKET_PREFIX_LEN + CFG_TUD_NET_MTU)
+
+TU_VERIFY_STATIC(NETD_PACKET_SIZE <= UINT16_MAX, "RNDIS transfer size too large");
+
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
@@ -56,6 +68,27 @@ typedef struct {
 
   bool ecm_mode;
 
+  // Reception ring: rx_count received transfers starting at rx_rd, next one is received after them
+  uint8_t rx_rd;
+  uint8_t rx_count;
+  bool rx_armed;    // OUT transfer in progress
+  bool rx_held;     // packet of rx_rd is passed to tud_network_recv_cb(), waiting for tud_network_recv_renew()
+  bool rx_in_cb;    // within tud_network_recv_cb()
+  uint16_t rx_ofs;  // offset of the next RNDIS message in transfer of rx_rd, 0 if none
+  uint16_t rx_len[CFG_TUD_ECM_RNDIS_OUT_PACKET_N];
+
+  // Transmission ring: tx_count transfers starting at tx_rd, the first one is being sent
+  uint8_t tx_rd;
+  uint8_t tx_count;
+  uint8_t tx_npkt;  // packets in the last transfer which is still open for aggregation, 0 if closed
+  uint16_t tx_max;  // MaxTransferSize from host's REMOTE_NDIS_INITIALIZE_MSG, 0 if unknown
+  uint16_t tx_len[CFG_TUD_ECM_RNDIS_IN_PACKET_N];
+#if CFG_TUD_RNDIS_IN_FLUSH_TIMEOUT_US
+  volatile bool tx_hold;           // open transfer is held back while IN endpoint is idle, timed by SOF
+  volatile uint32_t tx_hold_us;
+  bool tx_sof_enabled;
+#endif
+
   // Endpoint descriptor use to open/close when receiving SetInterface
   // TODO since configuration descriptor may not be long-lived memory, we should
   // keep a copy of endpoint attribute instead
@@ -68,8 +101,13 @@ typedef struct ecm_notify_struct {
 } ecm_notify_t;
 
 typedef struct {
-  TUD_EPBUF_DEF(rx, NETD_PACKET_SIZE);
-  TUD_EPBUF_DEF(tx, NETD_PACKET_SIZE);
+  struct {
+    TUD_EPBUF_DEF(buf, NETD_PACKET_SIZE);
+  } rx[CFG_TUD_ECM_RNDIS_OUT_PACKET_N];
+
+  struct {
+    TUD_EPBUF_DEF(buf, NETD_PACKET_SIZE);
+  } tx[CFG_TUD_ECM_RNDIS_IN_PACKET_N];
 
   TUD_EPBUF_DEF(notify, sizeof(ecm_notify_t));
   TUD_EPBUF_DEF(ctrl, NETD_CONTROL_SIZE);
@@ -80,17 +118,143 @@ typedef struct {
 //--------------------------------------------------------------------+
 static netd_interface_t _netd_itf;
 CFG_TUD_MEM_SECTION static netd_epbuf_t _netd_epbuf;
-static bool can_xmit;
+
+static bool handle_incoming_packet(uint8_t* buf, uint32_t len);
+
+// receive into the next free buffer
+static void rx_arm(void) {
+  if (_netd_itf.rx_armed || _netd_itf.rx_count >= CFG_TUD_ECM_RNDIS_OUT_PACKET_N || 0 == _netd_itf.ep_out) {
+    return;
+  }
+  uint8_t const idx = (uint8_t) ((_netd_itf.rx_rd + _netd_itf.rx_count) % CFG_TUD_ECM_RNDIS_OUT_PACKET_N);
+  _netd_itf.rx_armed = usbd_edpt_xfer(0, _netd_itf.ep_out, _netd_epbuf.rx[idx].buf, NETD_PACKET_SIZE);
+}
+
+static void rx_release(void) {
+  _netd_itf.rx_held = false;
+  if (_netd_itf.rx_ofs) {
+    return; // more RNDIS messages in this transfer
+  }
+  _netd_itf.rx_rd = (uint8_t) ((_netd_itf.rx_rd + 1) % CFG_TUD_ECM_RNDIS_OUT_PACKET_N);
+  _netd_itf.rx_count--;
+  rx_arm();
+}
+
+// offset of the RNDIS message following the one at ofs in the same transfer, 0 if none
+static uint16_t rx_next_msg(uint8_t const* buf, uint16_t len, uint16_t ofs) {
+#if CFG_TUD_RNDIS_PACKETS_PER_TRANSFER > 1
+  if (!_netd_itf.ecm_mode && len >= sizeof(rndis_data_packet_t)) {
+    uint32_t const msg_len = tu_le32toh(((rndis_data_packet_t const*) ((void const*) buf))->MessageLength);
+    // messages are aligned as requested by PacketAlignmentFactor
+    if (msg_len && 0 == (msg_len & 3) && msg_len + sizeof(rndis_data_packet_t) <= len) {
+      return (uint16_t) (ofs + msg_len);
+    }
+  }
+#else
+  (void) buf; (void) len; (void) ofs;
+#endif
+  return 0;
+}
+
+// pass received packets to application one at a time
+static void rx_deliver(void) {
+  if (_netd_itf.rx_in_cb) {
+    return; // tud_network_recv_renew() called from tud_network_recv_cb(), continued by the caller
+  }
+  _netd_itf.rx_in_cb = true;
+  while (!_netd_itf.rx_held && _netd_itf.rx_count) {
+    uint8_t const idx = _netd_itf.rx_rd;
+    uint16_t const ofs = _netd_itf.rx_ofs;
+    uint8_t* buf = _netd_epbuf.rx[idx].buf + ofs;
+    uint16_t const len = (uint16_t) (_netd_itf.rx_len[idx] - ofs);
+
+    _netd_itf.rx_ofs = rx_next_msg(buf, len, ofs);
+    _netd_itf.rx_held = true;
+    if (!handle_incoming_packet(buf, len) && _netd_itf.rx_held) {
+      /* if a buffer was never handled by user code, we must renew on the user's behalf */
+      rx_release();
+    }
+  }
+  _netd_itf.rx_in_cb = false;
+}
 
 void tud_network_recv_renew(void) {
-  usbd_edpt_xfer(0, _netd_itf.ep_out, _netd_epbuf.rx, NETD_PACKET_SIZE);
+  if (_netd_itf.rx_held) {
+    rx_release();
+  } else {
+    rx_arm();
+  }
+  rx_deliver();
+}
+
+#if CFG_TUD_RNDIS_IN_FLUSH_TIMEOUT_US
+// SOF is only requested while a transfer is held back, must be called from task context
+static void tx_sof_enable(bool en) {
+  if (_netd_itf.tx_sof_enabled != en) {
+    _netd_itf.tx_sof_enabled = en;
+    usbd_sof_enable(0, SOF_CONSUMER_RNDIS, en);
+  }
+}
+#endif
+
+// send the oldest queued transfer if IN endpoint is idle. Unless flush is set, the last transfer which is still open
+// for aggregation is held back until the hold time expires
+static void tx_start(bool flush) {
+  if (0 == _netd_itf.tx_count || usbd_edpt_busy(0, _netd_itf.ep_in)) {
+    return;
+  }
+
+#if CFG_TUD_RNDIS_IN_FLUSH_TIMEOUT_US
+  if (_netd_itf.tx_count == 1 && _netd_itf.tx_npkt && !flush) {
+    if (!_netd_itf.tx_hold) {
+      _netd_itf.tx_hold_us = 0;
+      _netd_itf.tx_hold = true;
+      tx_sof_enable(true);
+    }
+    return;
+  }
+  _netd_itf.tx_hold = false;
+  tx_sof_enable(false);
+#else
+  (void) flush;
+#endif
+
+  if (!usbd_edpt_claim(0, _netd_itf.ep_in)) {
+    return;
+  }
+  if (_netd_itf.tx_count == 1) {
+    _netd_itf.tx_npkt = 0; // no more packets appended to the transfer being sent
+  }
+  uint8_t const idx = _netd_itf.tx_rd;
+  if (!usbd_edpt_xfer(0, _netd_itf.ep_in, _netd_epbuf.tx[idx].buf, _netd_itf.tx_len[idx])) {
+    usbd_edpt_release(0, _netd_itf.ep_in);
+  }
 }
 
-static void do_in_xfer(uint8_t *buf, uint16_t len) {
-  can_xmit = false;
-  usbd_edpt_xfer(0, _netd_itf.ep_in, buf, len);
+#if CFG_TUD_RNDIS_IN_FLUSH_TIMEOUT_US
+// deferred from netd_sof() when hold time of the open transfer expired
+static void tx_flush_func(void* param) {
+  (void) param;
+  tx_start(true);
 }
 
+// SOF handler in ISR context: accumulate hold time of the open transfer, one SOF is 1ms on Full-Speed and
+// 125us on High-Speed
+void netd_sof(uint8_t rhport, uint32_t frame_count) {
+  (void) frame_count;
+
+  if (!_netd_itf.tx_hold) {
+    return;
+  }
+
+  _netd_itf.tx_hold_us += (tud_rhport_speed_get(rhport) == TUSB_SPEED_HIGH) ? 125 : 1000;
+  if (_netd_itf.tx_hold_us >= CFG_TUD_RNDIS_IN_FLUSH_TIMEOUT_US) {
+    _netd_itf.tx_hold = false;
+    usbd_defer_func(tx_flush_func, NULL, true);
+  }
+}
+#endif
+
 void netd_report(uint8_t *buf, uint16_t len) {
   const uint8_t rhport = 0;
   len = tu_min16(len, sizeof(ecm_notify_t));
@@ -113,6 +277,9 @@ bool netd_deinit(void) {
 
 void netd_reset(uint8_t rhport) {
   (void) rhport;
+#if CFG_TUD_RNDIS_IN_FLUSH_TIMEOUT_US
+  usbd_sof_enable(rhport, SOF_CONSUMER_RNDIS, false);
+#endif
   netd_init();
 }
 
@@ -183,11 +350,8 @@ uint16_t netd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint1
 
     tud_network_init_cb();
 
-    // we are ready to transmit a packet
-    can_xmit = true;
-
     // prepare for incoming packets
-    tud_network_recv_renew();
+    rx_arm();
   }
 
   drv_len += 2*sizeof(tusb_desc_endpoint_t);
@@ -260,8 +424,7 @@ bool netd_control_xfer_cb (uint8_t rhport, uint8_t stage, tusb_control_request_t
                 // TODO should be merge with RNDIS's after endpoint opened
                 // Also should have opposite callback for application to disable network !!
                 tud_network_init_cb();
-                can_xmit = true; // we are ready to transmit a packet
-                tud_network_recv_renew(); // prepare for incoming packets
+                rx_arm(); // prepare for incoming packets
               }
             } else {
               // TODO close the endpoint pair
@@ -309,6 +472,12 @@ bool netd_control_xfer_cb (uint8_t rhport, uint8_t stage, tusb_control_request_t
         request->bmRequestType_bit.direction == TUSB_DIR_OUT &&
         _netd_itf.itf_num == request->wIndex) {
       if (!_netd_itf.ecm_mode) {
+        rndis_initialize_msg_t const* init = (rndis_initialize_msg_t const*) ((void const*) _netd_epbuf.ctrl);
+        if (request->wLength >= sizeof(rndis_initialize_msg_t) &&
+            REMOTE_NDIS_INITIALIZE_MSG == tu_le32toh(init->MessageType)) {
+          // limits size of (aggregated) transfers to host, buffer is overwritten by the response
+          _netd_itf.tx_max = (uint16_t) tu_min32(tu_le32toh(init->MaxTransferSize), NETD_PACKET_SIZE);
+        }
         rndis_class_set_handler(_netd_epbuf.ctrl, request->wLength);
       }
     }
@@ -317,8 +486,9 @@ bool netd_control_xfer_cb (uint8_t rhport, uint8_t stage, tusb_control_request_t
   return true;
 }
 
-static void handle_incoming_packet(uint32_t len) {
-  uint8_t* pnt = _netd_epbuf.rx;
+// return false if the packet was not accepted by application
+static bool handle_incoming_packet(uint8_t* buf, uint32_t len) {
+  uint8_t* pnt = buf;
   uint32_t size = 0;
 
   if (_netd_itf.ecm_mode) {
@@ -328,26 +498,27 @@ static void handle_incoming_packet(uint32_t len) {
     if (len >= sizeof(rndis_data_packet_t)) {
       if ((r->MessageType == REMOTE_NDIS_PACKET_MSG) && (r->MessageLength <= len)) {
         if ((r->DataOffset + offsetof(rndis_data_packet_t, DataOffset) + r->DataLength) <= len) {
-          pnt = &_netd_epbuf.rx[r->DataOffset + offsetof(rndis_data_packet_t, DataOffset)];
+          pnt = &buf[r->DataOffset + offsetof(rndis_data_packet_t, DataOffset)];
           size = r->DataLength;
         }
       }
     }
   }
 
-  if (!tud_network_recv_cb(pnt, (uint16_t)size)) {
-    /* if a buffer was never handled by user code, we must renew on the user's behalf */
-    tud_network_recv_renew();
-  }
+  return tud_network_recv_cb(pnt, (uint16_t)size);
 }
 
 bool netd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes) {
-  (void)rhport;
   (void)result;
 
   /* new packet received */
   if (ep_addr == _netd_itf.ep_out) {
-    handle_incoming_packet(xferred_bytes);
+    uint8_t const idx = (uint8_t) ((_netd_itf.rx_rd + _netd_itf.rx_count) % CFG_TUD_ECM_RNDIS_OUT_PACKET_N);
+    _netd_itf.rx_len[idx] = (uint16_t) xferred_bytes;
+    _netd_itf.rx_armed = false;
+    _netd_itf.rx_count++;
+    rx_arm();
+    rx_deliver();
   }
 
   /* data transmission finished */
@@ -355,10 +526,13 @@ bool netd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_
     /* TinyUSB requires the class driver to implement ZLP (since ZLP usage is class-specific) */
 
     if (xferred_bytes && (0 == (xferred_bytes % CFG_TUD_NET_ENDPOINT_SIZE))) {
-      do_in_xfer(NULL, 0); /* a ZLP is needed */
+      usbd_edpt_xfer(rhport, _netd_itf.ep_in, NULL, 0); /* a ZLP is needed */
     } else {
       /* we're finally finished */
-      can_xmit = true;
+      _netd_itf.tx_rd = (uint8_t) ((_netd_itf.tx_rd + 1) % CFG_TUD_ECM_RNDIS_IN_PACKET_N);
+      _netd_itf.tx_count--;
+      usbd_edpt_release(rhport, _netd_itf.ep_in);
+      tx_start(true); // packets aggregated meanwhile are sent right away
     }
   }
 
@@ -371,31 +545,63 @@ bool netd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_
   return true;
 }
 
+// true if the last queued transfer is open and has room for another full sized packet
+static bool tx_can_append(void) {
+  if (0 == _netd_itf.tx_npkt) {
+    return false;
+  }
+  uint8_t const idx = (uint8_t) ((_netd_itf.tx_rd + _netd_itf.tx_count - 1) % CFG_TUD_ECM_RNDIS_IN_PACKET_N);
+  uint16_t const limit = _netd_itf.tx_max ? _netd_itf.tx_max : NETD_PACKET_SIZE;
+  return _netd_itf.tx_len[idx] + NETD_PACKET_MSG_SIZE <= limit;
+}
+
 bool tud_network_can_xmit(uint16_t size) {
   (void)size;
-  return can_xmit;
+  return _netd_itf.ep_in && (tx_can_append() || _netd_itf.tx_count < CFG_TUD_ECM_RNDIS_IN_PACKET_N);
 }
 
 void tud_network_xmit(void *ref, uint16_t arg) {
-  if (!can_xmit) {
+  if (!tud_network_can_xmit(0)) {
     return;
   }
 
+  uint8_t idx;
+  uint16_t ofs;
+  if (tx_can_append()) {
+    idx = (uint8_t) ((_netd_itf.tx_rd + _netd_itf.tx_count - 1) % CFG_TUD_ECM_RNDIS_IN_PACKET_N);
+    ofs = _netd_itf.tx_len[idx];
+  } else {
+    idx = (uint8_t) ((_netd_itf.tx_rd + _netd_itf.tx_count) % CFG_TUD_ECM_RNDIS_IN_PACKET_N);
+    ofs = 0;
+    _netd_itf.tx_npkt = 0;
+    _netd_itf.tx_count++;
+  }
+
+  uint8_t* tx_buf = _netd_epbuf.tx[idx].buf + ofs;
   uint16_t len = (_netd_itf.ecm_mode) ? 0 : CFG_TUD_NET_PACKET_PREFIX_LEN;
-  uint8_t* data = _netd_epbuf.tx + len;
+  uint8_t* data = tx_buf + len;
 
   len += tud_network_xmit_cb(data, ref, arg);
 
   if (!_netd_itf.ecm_mode) {
-    rndis_data_packet_t *hdr = (rndis_data_packet_t *) ((void*) _netd_epbuf.tx);
+    rndis_data_packet_t *hdr = (rndis_data_packet_t *) ((void*) tx_buf);
     memset(hdr, 0, sizeof(rndis_data_packet_t));
     hdr->MessageType = REMOTE_NDIS_PACKET_MSG;
-    hdr->MessageLength = len;
     hdr->DataOffset = sizeof(rndis_data_packet_t) - offsetof(rndis_data_packet_t, DataOffset);
     hdr->DataLength = len - sizeof(rndis_data_packet_t);
+
+    // pad to the alignment of the next aggregated message
+    uint16_t const msg_len = (uint16_t) NETD_RNDIS_MSG_ALIGN(len);
+    memset(tx_buf + len, 0, (size_t) (msg_len - len));
+    len = msg_len;
+    hdr->MessageLength = len;
+
+    // keep transfer open for more packets, up to the count announced in MaxPacketsPerTransfer
+    _netd_itf.tx_npkt = (_netd_itf.tx_npkt + 1u < CFG_TUD_RNDIS_PACKETS_PER_TRANSFER) ? (uint8_t) (_netd_itf.tx_npkt + 1u) : 0;
   }
 
-  do_in_xfer(_netd_epbuf.tx, len);
+  _netd_itf.tx_len[idx] = (uint16_t) (ofs + len);
+  tx_start(false);
 }
 
 #endif
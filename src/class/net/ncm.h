@@ -78,6 +78,40 @@
   #define CFG_TUD_NCM_OUT_MAX_DATAGRAMS_PER_NTB 6
 #endif
 
+// Hold-off time in microseconds for a partially filled transmission NTB, measured with SOF.
+// While the IN endpoint is idle the driver waits up to this time for more datagrams before sending
+// the NTB. 0 sends immediately (lowest latency), a few hundred us improve packing on bulk traffic.
+// Can be changed at runtime with tud_network_ncm_flush_config()
+#ifndef CFG_TUD_NCM_IN_FLUSH_TIMEOUT_US
+  #define CFG_TUD_NCM_IN_FLUSH_TIMEOUT_US 0
+#endif
+
+// Number of scatter-gather segments per transmission NTB for tud_network_xmit_sg(), 0 disables it.
+// Requires CFG_TUD_EDPT_XFER_SG. Each datagram sent in place takes up to 2 segments plus 1 for the NTB tail
+#ifndef CFG_TUD_NCM_IN_SG_N
+  #define CFG_TUD_NCM_IN_SG_N 0
+#endif
+
+#if CFG_TUD_NCM_IN_SG_N && !CFG_TUD_EDPT_XFER_SG
+  #error "CFG_TUD_NCM_IN_SG_N requires CFG_TUD_EDPT_XFER_SG"
+#endif
+
+// NTB size in bytes from which a held transmission NTB is sent without waiting for the hold-off
+// time to expire. 0 means the NTB is held until it is full or the hold-off time expires
+#ifndef CFG_TUD_NCM_IN_FLUSH_THRESHOLD
+  #define CFG_TUD_NCM_IN_FLUSH_THRESHOLD 0
+#endif
+
+// Support 32-bit NTB format (NTH32/NDP32) in addition to the 16-bit format, selected by host with SET_NTB_FORMAT.
+// Required for NTBs larger than 64KB, which also need CFG_TUD_EDPT_XFER_LARGE if the DCD can't transfer them at once
+#ifndef CFG_TUD_NCM_NTB32
+  #define CFG_TUD_NCM_NTB32 0
+#endif
+
+#if !CFG_TUD_NCM_NTB32 && (CFG_TUD_NCM_IN_NTB_MAX_SIZE > UINT16_MAX || CFG_TUD_NCM_OUT_NTB_MAX_SIZE > UINT16_MAX)
+  #error "NTB larger than 64KB requires CFG_TUD_NCM_NTB32"
+#endif
+
 // Table 6.2 Class-Specific Request Codes for Network Control Model subclass
 typedef enum
 {
@@ -103,6 +137,16 @@ typedef enum
 #define NDP16_SIGNATURE_NCM0 0x304D434E
 #define NDP16_SIGNATURE_NCM1 0x314D434E
 
+#define NTH32_SIGNATURE 0x686D636E
+#define NDP32_SIGNATURE_NCM0 0x306D636E
+#define NDP32_SIGNATURE_NCM1 0x316D636E
+
+// bmNtbFormatsSupported and SET_NTB_FORMAT wValue
+#define NCM_NTB_FORMAT_SUPPORTED_16   0x01
+#define NCM_NTB_FORMAT_SUPPORTED_32   0x02
+#define NCM_NTB_FORMAT_16             0x00
+#define NCM_NTB_FORMAT_32             0x01
+
 typedef struct TU_ATTR_PACKED {
   uint16_t wLength;
   uint16_t bmNtbFormatsSupported;
@@ -138,12 +182,48 @@ typedef struct TU_ATTR_PACKED {
   //ndp16_datagram_t datagram[];
 } ndp16_t;
 
+typedef struct TU_ATTR_PACKED {
+  uint32_t dwSignature;
+  uint16_t wHeaderLength;
+  uint16_t wSequence;
+  uint32_t dwBlockLength;
+  uint32_t dwNdpIndex;
+} nth32_t;
+
+typedef struct TU_ATTR_PACKED {
+  uint32_t dwDatagramIndex;
+  uint32_t dwDatagramLength;
+} ndp32_datagram_t;
+
+typedef struct TU_ATTR_PACKED {
+  uint32_t dwSignature;
+  uint16_t wLength;
+  uint16_t wReserved6;
+  uint32_t dwNextNdpIndex;
+  uint32_t dwReserved12;
+  //ndp32_datagram_t datagram[];
+} ndp32_t;
+
+// SET_NTB_INPUT_SIZE / GET_NTB_INPUT_SIZE data, wNtbInMaxDatagrams is optional (wLength 4 or 8)
+typedef struct TU_ATTR_PACKED {
+  uint32_t dwNtbInMaxSize;
+  uint16_t wNtbInMaxDatagrams;
+  uint16_t wReserved;
+} ncm_ntb_input_size_t;
+
 typedef union TU_ATTR_PACKED {
   struct {
     nth16_t nth;
     ndp16_t ndp;
     ndp16_datagram_t ndp_datagram[CFG_TUD_NCM_IN_MAX_DATAGRAMS_PER_NTB + 1];
   };
+#if CFG_TUD_NCM_NTB32
+  struct {
+    nth32_t nth32;
+    ndp32_t ndp32;
+    ndp32_datagram_t ndp32_datagram[CFG_TUD_NCM_IN_MAX_DATAGRAMS_PER_NTB + 1];
+  };
+#endif
   uint8_t data[CFG_TUD_NCM_IN_NTB_MAX_SIZE];
 } xmit_ntb_t;
 
@@ -152,6 +232,11 @@ typedef union TU_ATTR_PACKED {
     nth16_t nth;
     // only the header is at a guaranteed position
   };
+#if CFG_TUD_NCM_NTB32
+  struct {
+    nth32_t nth32;
+  };
+#endif
   uint8_t data[CFG_TUD_NCM_OUT_NTB_MAX_SIZE];
 } recv_ntb_t;
 
@@ -161,4 +246,83 @@ typedef struct {
   uint32_t uplink;
 } ncm_notify_t;
 
+//--------------------------------------------------------------------+
+// NTB16 parsing (used by both device and host driver)
+//--------------------------------------------------------------------+
+
+// Datagram pointer list of the first NDP16 of a NTB, terminated by a zero entry
+TU_ATTR_ALWAYS_INLINE static inline const ndp16_datagram_t *ncm_ntb16_datagram_list(const uint8_t *ntb) {
+  const nth16_t *nth16 = (const nth16_t *) ntb;
+  return (const ndp16_datagram_t *) (ntb + nth16->wNdpIndex + sizeof(ndp16_t));
+}
+
+// Validate a received NTB16 of len bytes: header, first NDP16 and all datagrams must be within the NTB
+// and the NTB must not be larger than max_size. Multiple NDPs (wNextNdpIndex != 0) are not supported
+static inline bool ncm_ntb16_validate(const uint8_t *ntb, uint32_t len, uint32_t max_size) {
+  const nth16_t *nth16 = (const nth16_t *) ntb;
+  const uint32_t min_ndp_len = sizeof(ndp16_t) + 2 * sizeof(ndp16_datagram_t);
+
+  // check header
+  TU_VERIFY(len >= sizeof(nth16_t) + min_ndp_len);
+  TU_VERIFY(nth16->wHeaderLength == sizeof(nth16_t) && nth16->dwSignature == NTH16_SIGNATURE);
+  TU_VERIFY(nth16->wBlockLength <= len && nth16->wBlockLength <= max_size);
+  TU_VERIFY(nth16->wNdpIndex >= sizeof(nth16_t) && nth16->wNdpIndex <= len - min_ndp_len);
+
+  // check (first) NDP16
+  const ndp16_t *ndp16 = (const ndp16_t *) (ntb + nth16->wNdpIndex);
+  TU_VERIFY(ndp16->wLength >= min_ndp_len && nth16->wNdpIndex + ndp16->wLength <= len);
+  TU_VERIFY(ndp16->dwSignature == NDP16_SIGNATURE_NCM0 || ndp16->dwSignature == NDP16_SIGNATURE_NCM1);
+  TU_VERIFY(ndp16->wNextNdpIndex == 0);
+
+  // datagram list must be terminated by a zero entry, all datagrams must be within NTB
+  const ndp16_datagram_t *datagram = ncm_ntb16_datagram_list(ntb);
+  const uint16_t max_ndx = (uint16_t) ((ndp16->wLength - sizeof(ndp16_t)) / sizeof(ndp16_datagram_t));
+  TU_VERIFY(datagram[max_ndx - 1].wDatagramIndex == 0 && datagram[max_ndx - 1].wDatagramLength == 0);
+
+  for (uint16_t i = 0; datagram[i].wDatagramIndex != 0 && datagram[i].wDatagramLength != 0; i++) {
+    TU_VERIFY((uint32_t) datagram[i].wDatagramIndex + datagram[i].wDatagramLength <= len);
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// NTB32 parsing
+//--------------------------------------------------------------------+
+
+// Datagram pointer list of the first NDP32 of a NTB, terminated by a zero entry
+TU_ATTR_ALWAYS_INLINE static inline const ndp32_datagram_t *ncm_ntb32_datagram_list(const uint8_t *ntb) {
+  const nth32_t *nth32 = (const nth32_t *) ntb;
+  return (const ndp32_datagram_t *) (ntb + nth32->dwNdpIndex + sizeof(ndp32_t));
+}
+
+// Same as ncm_ntb16_validate() for a NTB32
+static inline bool ncm_ntb32_validate(const uint8_t *ntb, uint32_t len, uint32_t max_size) {
+  const nth32_t *nth32 = (const nth32_t *) ntb;
+  const uint32_t min_ndp_len = sizeof(ndp32_t) + 2 * sizeof(ndp32_datagram_t);
+
+  // check header
+  TU_VERIFY(len >= sizeof(nth32_t) + min_ndp_len);
+  TU_VERIFY(nth32->wHeaderLength == sizeof(nth32_t) && nth32->dwSignature == NTH32_SIGNATURE);
+  TU_VERIFY(nth32->dwBlockLength <= len && nth32->dwBlockLength <= max_size);
+  TU_VERIFY(nth32->dwNdpIndex >= sizeof(nth32_t) && nth32->dwNdpIndex <= len - min_ndp_len);
+
+  // check (first) NDP32
+  const ndp32_t *ndp32 = (const ndp32_t *) (ntb + nth32->dwNdpIndex);
+  TU_VERIFY(ndp32->wLength >= min_ndp_len && nth32->dwNdpIndex + ndp32->wLength <= len);
+  TU_VERIFY(ndp32->dwSignature == NDP32_SIGNATURE_NCM0 || ndp32->dwSignature == NDP32_SIGNATURE_NCM1);
+  TU_VERIFY(ndp32->dwNextNdpIndex == 0);
+
+  // datagram list must be terminated by a zero entry, all datagrams must be within NTB
+  const ndp32_datagram_t *datagram = ncm_ntb32_datagram_list(ntb);
+  const uint16_t max_ndx = (uint16_t) ((ndp32->wLength - sizeof(ndp32_t)) / sizeof(ndp32_datagram_t));
+  TU_VERIFY(datagram[max_ndx - 1].dwDatagramIndex == 0 && datagram[max_ndx - 1].dwDatagramLength == 0);
+
+  for (uint16_t i = 0; datagram[i].dwDatagramIndex != 0 && datagram[i].dwDatagramLength != 0; i++) {
+    TU_VERIFY(datagram[i].dwDatagramIndex <= len && datagram[i].dwDatagramLength <= len - datagram[i].dwDatagramIndex);
+  }
+
+  return true;
+}
+
 #endif
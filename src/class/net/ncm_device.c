@@ -72,6 +72,19 @@
 // calculate alignment of xmit datagrams within an NTB
 #define XMIT_ALIGN_OFFSET(x) ((TUD_NCM_ALIGNMENT - ((x) & (TUD_NCM_ALIGNMENT - 1))) & (TUD_NCM_ALIGNMENT - 1))
 
+// smallest NTB header (NTH, NDP with one datagram and terminator) of the supported formats
+#if CFG_TUD_NCM_NTB32
+  #define XMIT_NTB_MIN_HEADER_LEN (sizeof(nth32_t) + sizeof(ndp32_t) + 2 * sizeof(ndp32_datagram_t))
+#else
+  #define XMIT_NTB_MIN_HEADER_LEN (sizeof(nth16_t) + sizeof(ndp16_t) + 2 * sizeof(ndp16_datagram_t))
+#endif
+
+// a full sized frame (CFG_TUD_NET_MTU, possibly jumbo) must fit into one NTB in both directions
+TU_VERIFY_STATIC(CFG_TUD_NCM_IN_NTB_MAX_SIZE >= XMIT_NTB_MIN_HEADER_LEN + CFG_TUD_NET_MTU,
+                 "CFG_TUD_NCM_IN_NTB_MAX_SIZE is too small for CFG_TUD_NET_MTU");
+TU_VERIFY_STATIC(CFG_TUD_NCM_OUT_NTB_MAX_SIZE >= XMIT_NTB_MIN_HEADER_LEN + CFG_TUD_NET_MTU,
+                 "CFG_TUD_NCM_OUT_NTB_MAX_SIZE is too small for CFG_TUD_NET_MTU");
+
 //-----------------------------------------------------------------------------
 //
 // Module global things
@@ -79,6 +92,19 @@
 #define XMIT_NTB_N CFG_TUD_NCM_IN_NTB_N
 #define RECV_NTB_N CFG_TUD_NCM_OUT_NTB_N
 
+#if CFG_TUD_NCM_IN_SG_N
+// scatter-gather state of an xmit NTB.  The NTB buffer is used as staging area for headers and copied parts,
+// datagram parts on packet size boundaries are referenced in place.
+typedef struct {
+  tu_xfer_sg_t list[CFG_TUD_NCM_IN_SG_N];               // closed segments
+  uint8_t count;                                        // number of entries in \a list
+  uint8_t ref_count;                                    // number of entries in \a ref
+  uint32_t stage_len;                                   // used bytes of NTB buffer
+  uint32_t stage_start;                                 // start of the open staging segment in NTB buffer
+  void *ref[CFG_TUD_NCM_IN_MAX_DATAGRAMS_PER_NTB];      // refs of tud_network_xmit_sg() waiting for completion
+} xmit_sg_t;
+#endif
+
 typedef struct {
   // general
   uint8_t ep_in;        // endpoint for outgoing datagrams (naming is a little bit confusing)
@@ -87,6 +113,7 @@ typedef struct {
   uint8_t itf_num;      // interface number
   uint8_t itf_data_alt; // ==0 -> no endpoints, i.e. no network traffic, ==1 -> normal operation with two endpoints (spec, chapter 5.3)
   uint8_t rhport;       // storage of \a rhport because some callbacks are done without it
+  uint8_t ntb_format;   // NCM_NTB_FORMAT_16 or NCM_NTB_FORMAT_32, selected by host with SET_NTB_FORMAT
 
   // recv handling
   recv_ntb_t *recv_free_ntb[RECV_NTB_N];                // free list of recv NTBs
@@ -102,6 +129,20 @@ typedef struct {
   xmit_ntb_t *xmit_glue_ntb;                            // buffer for the running transfer glue logic -> driver
   uint16_t xmit_sequence;                               // NTB sequence counter
   uint16_t xmit_glue_ntb_datagram_ndx;                  // index into \a xmit_glue_ntb_datagram
+  uint32_t xmit_glue_ntb_len;                           // block length of \a xmit_glue_ntb, written to NTH when the NTB is closed
+  uint32_t xmit_ntb_in_size;                            // NTB size limit, dwNtbInMaxSize or set by host with SET_NTB_INPUT_SIZE
+  uint16_t xmit_max_datagrams;                          // datagrams per NTB, limited by host with SET_NTB_INPUT_SIZE
+  #if CFG_TUD_NCM_IN_SG_N
+  xmit_sg_t xmit_sg[XMIT_NTB_N];                        // scatter-gather state, same index as ncm_epbuf.xmit
+  #endif
+
+  // xmit flush handling (hold-off of a partially filled glue NTB)
+  volatile bool xmit_flush_armed;                       // glue NTB is held, SOF accumulates \a xmit_flush_elapsed_us
+  volatile bool xmit_flush_expired;                     // hold-off time of current glue NTB expired
+  uint32_t xmit_flush_elapsed_us;                       // time since first datagram has been put into glue NTB
+  bool xmit_flush_sof_enabled;                          // SOF is requested for hold-off timing
+
+  tud_network_ncm_stats_t stats;                        // driver statistics
 
   // notification handling
   enum {
@@ -112,6 +153,8 @@ typedef struct {
   bool notification_xmit_is_running;                    // notification is currently transmitted
 
   // misc
+  ncm_ntb_input_size_t ctrl_ntb_input_size;             // data of {GET,SET}_NTB_INPUT_SIZE
+  uint16_t ctrl_ntb_format;                             // data of GET_NTB_FORMAT
   bool tud_network_recv_renew_active;                   // tud_network_recv_renew() is active (avoid recursive invocations)
   bool tud_network_recv_renew_process_again;            // tud_network_recv_renew() should process again
 } ncm_interface_t;
@@ -131,6 +174,19 @@ typedef struct {
 static ncm_interface_t ncm_interface;
 CFG_TUD_MEM_SECTION static ncm_epbuf_t ncm_epbuf;
 
+// references of glue logic onto recv NTBs (zero-copy datagrams), kept across bus reset because the
+// glue logic may still hold datagrams.  A referenced NTB is not reused until all references are dropped.
+static uint8_t recv_ntb_ref[RECV_NTB_N];
+
+// flush policy is configured by application and kept across bus reset
+static struct {
+  uint32_t timeout_us;
+  uint16_t threshold;
+} ncm_flush_cfg = {
+  .timeout_us = CFG_TUD_NCM_IN_FLUSH_TIMEOUT_US,
+  .threshold = CFG_TUD_NCM_IN_FLUSH_THRESHOLD
+};
+
 /**
  * This is the NTB parameter structure
  *
@@ -139,7 +195,7 @@ CFG_TUD_MEM_SECTION static ncm_epbuf_t ncm_epbuf;
  */
 TU_ATTR_ALIGNED(4) static const ntb_parameters_t ntb_parameters = {
   .wLength                  = sizeof(ntb_parameters_t),
-  .bmNtbFormatsSupported    = 0x01,// 16-bit NTB supported
+  .bmNtbFormatsSupported    = NCM_NTB_FORMAT_SUPPORTED_16 | (CFG_TUD_NCM_NTB32 ? NCM_NTB_FORMAT_SUPPORTED_32 : 0),
   .dwNtbInMaxSize           = CFG_TUD_NCM_IN_NTB_MAX_SIZE,
   .wNdbInDivisor            = 1,
   .wNdbInPayloadRemainder   = 0,
@@ -279,7 +335,7 @@ static xmit_ntb_t *xmit_get_free_ntb(void) {
  * Put a filled NTB into the ready list
  */
 static void xmit_put_ntb_into_ready_list(xmit_ntb_t *ready_ntb) {
-  TU_LOG_DRV("xmit_put_ntb_into_ready_list(%p) %d\n", ready_ntb, ready_ntb->nth.wBlockLength);
+  TU_LOG_DRV("xmit_put_ntb_into_ready_list(%p)\n", ready_ntb);
 
   for (int i = 0; i < XMIT_NTB_N; ++i) {
     if (ncm_interface.xmit_ready_ntb[i] == NULL) {
@@ -290,6 +346,61 @@ static void xmit_put_ntb_into_ready_list(xmit_ntb_t *ready_ntb) {
   TU_LOG_DRV("(EE) xmit_put_ntb_into_ready_list: ready list full\n");// this should not happen
 } // xmit_put_ntb_into_ready_list
 
+/**
+ * Size limit of xmit NTBs in the selected format
+ */
+static uint32_t xmit_ntb_max_size(void) {
+  if (ncm_interface.ntb_format == NCM_NTB_FORMAT_16) {
+    return tu_min32(ncm_interface.xmit_ntb_in_size, UINT16_MAX);
+  }
+  return ncm_interface.xmit_ntb_in_size;
+} // xmit_ntb_max_size
+
+/**
+ * Write block length of the glue NTB into its NTH, done when the glue logic is done with it
+ */
+static void xmit_close_glue_ntb(void) {
+  xmit_ntb_t *ntb = ncm_interface.xmit_glue_ntb;
+  #if CFG_TUD_NCM_NTB32
+  if (ncm_interface.ntb_format == NCM_NTB_FORMAT_32) {
+    ntb->nth32.dwBlockLength = ncm_interface.xmit_glue_ntb_len;
+    return;
+  }
+  #endif
+  ntb->nth.wBlockLength = (uint16_t) ncm_interface.xmit_glue_ntb_len;
+} // xmit_close_glue_ntb
+
+/**
+ * Block length of a closed NTB
+ */
+static uint32_t xmit_ntb_block_length(const xmit_ntb_t *ntb) {
+  #if CFG_TUD_NCM_NTB32
+  if (ncm_interface.ntb_format == NCM_NTB_FORMAT_32) {
+    return ntb->nth32.dwBlockLength;
+  }
+  #endif
+  return ntb->nth.wBlockLength;
+} // xmit_ntb_block_length
+
+/**
+ * Add the datagram at \a index to the datagram list of the glue NTB
+ */
+static void xmit_add_datagram(xmit_ntb_t *ntb, uint32_t index, uint16_t length) {
+  uint16_t const ndx = ncm_interface.xmit_glue_ntb_datagram_ndx;
+  #if CFG_TUD_NCM_NTB32
+  if (ncm_interface.ntb_format == NCM_NTB_FORMAT_32) {
+    ntb->ndp32_datagram[ndx].dwDatagramIndex = index;
+    ntb->ndp32_datagram[ndx].dwDatagramLength = length;
+  } else
+  #endif
+  {
+    ntb->ndp_datagram[ndx].wDatagramIndex = (uint16_t) index;
+    ntb->ndp_datagram[ndx].wDatagramLength = length;
+  }
+  ncm_interface.xmit_glue_ntb_datagram_ndx += 1;
+  ncm_interface.stats.xmit_datagram++;
+} // xmit_add_datagram
+
 /**
  * Get the next NTB from the ready list (and remove it from the list).
  * If the ready list is empty, return NULL.
@@ -305,6 +416,61 @@ static xmit_ntb_t *xmit_get_next_ready_ntb(void) {
   return r;
 } // xmit_get_next_ready_ntb
 
+#if CFG_TUD_NCM_IN_SG_N
+/**
+ * Get scatter-gather state of \a ntb
+ */
+static xmit_sg_t *xmit_sg_get(const xmit_ntb_t *ntb) {
+  for (int i = 0; i < XMIT_NTB_N; ++i) {
+    if (ntb == &ncm_epbuf.xmit[i].ntb) {
+      return &ncm_interface.xmit_sg[i];
+    }
+  }
+  return NULL;
+} // xmit_sg_get
+
+/**
+ * Append \a len bytes to the open staging segment, \a src == NULL only reserves (padding)
+ */
+static void xmit_sg_stage(xmit_ntb_t *ntb, xmit_sg_t *sg, const uint8_t *src, uint16_t len) {
+  if (src != NULL) {
+    memcpy(ntb->data + sg->stage_len, src, len);
+  }
+  sg->stage_len += len;
+  ncm_interface.xmit_glue_ntb_len += len;
+} // xmit_sg_stage
+
+/**
+ * Close the open staging segment (if not empty) and add it to the segment list
+ */
+static void xmit_sg_close_stage(xmit_ntb_t *ntb, xmit_sg_t *sg) {
+  if (sg->stage_len > sg->stage_start) {
+    sg->list[sg->count].buffer = ntb->data + sg->stage_start;
+    sg->list[sg->count].len = (uint32_t) (sg->stage_len - sg->stage_start);
+    sg->count++;
+    sg->stage_start = sg->stage_len;
+  }
+} // xmit_sg_close_stage
+
+/**
+ * Buffers of \a ntb are not used anymore, notify the glue logic
+ */
+static void xmit_sg_done(xmit_ntb_t *ntb) {
+  if (ntb == NULL) { // can happen due to ZLPs
+    return;
+  }
+
+  xmit_sg_t *sg = xmit_sg_get(ntb);
+  for (uint8_t i = 0; i < sg->ref_count; ++i) {
+    if (tud_network_xmit_sg_done_cb) {
+      tud_network_xmit_sg_done_cb(sg->ref[i]);
+    }
+  }
+  sg->ref_count = 0;
+  sg->count = 0;
+} // xmit_sg_done
+#endif
+
 /**
  * Transmit a ZLP if required
  *
@@ -334,6 +500,50 @@ static bool xmit_insert_required_zlp(uint8_t rhport, uint32_t xferred_bytes) {
   return true;
 } // xmit_insert_required_zlp
 
+/**
+ * Request or release SOF which is used for timing the hold-off of the glue NTB.
+ * Must be called from task context.
+ */
+static void xmit_flush_sof_enable(uint8_t rhport, bool en) {
+  if (ncm_interface.xmit_flush_sof_enabled != en) {
+    ncm_interface.xmit_flush_sof_enabled = en;
+    usbd_sof_enable(rhport, SOF_CONSUMER_NCM, en);
+  }
+} // xmit_flush_sof_enable
+
+/**
+ * Check if the partially filled glue NTB should be held back to pack more datagrams into it.
+ * If so, the hold-off timer is armed.
+ */
+static bool xmit_flush_hold_glue_ntb(uint8_t rhport) {
+  if (ncm_flush_cfg.timeout_us == 0 || ncm_interface.xmit_flush_expired) {
+    return false;
+  }
+  if (ncm_interface.xmit_glue_ntb_datagram_ndx >= ncm_interface.xmit_max_datagrams) {
+    ncm_interface.stats.xmit_flush_full++;
+    return false;
+  }
+  if (ncm_flush_cfg.threshold != 0 && ncm_interface.xmit_glue_ntb_len >= ncm_flush_cfg.threshold) {
+    ncm_interface.stats.xmit_flush_threshold++;
+    return false;
+  }
+
+  if (!ncm_interface.xmit_flush_armed) {
+    xmit_flush_sof_enable(rhport, true);
+    ncm_interface.xmit_flush_armed = true;
+  }
+  return true;
+} // xmit_flush_hold_glue_ntb
+
+/**
+ * Reset hold-off timer, done whenever a new glue NTB is started
+ */
+static void xmit_flush_reset(void) {
+  ncm_interface.xmit_flush_armed = false;
+  ncm_interface.xmit_flush_expired = false;
+  ncm_interface.xmit_flush_elapsed_us = 0;
+} // xmit_flush_reset
+
 /**
  * Start transmission if it there is a waiting packet and if can be done from interface side.
  */
@@ -357,27 +567,63 @@ static void xmit_start_if_possible(uint8_t rhport) {
   if (ncm_interface.xmit_tinyusb_ntb == NULL) {
     if (ncm_interface.xmit_glue_ntb == NULL || ncm_interface.xmit_glue_ntb_datagram_ndx == 0) {
       // -> really nothing is waiting
+      xmit_flush_sof_enable(rhport, false);
       return;
     }
+    if (xmit_flush_hold_glue_ntb(rhport)) {
+      // -> wait for more datagrams, threshold or hold-off timeout
+      return;
+    }
+    if (ncm_interface.xmit_flush_expired) {
+      ncm_interface.stats.xmit_flush_timeout++;
+    } else if (ncm_flush_cfg.timeout_us == 0) {
+      ncm_interface.stats.xmit_flush_idle++;
+    }
+    xmit_close_glue_ntb();
     ncm_interface.xmit_tinyusb_ntb = ncm_interface.xmit_glue_ntb;
     ncm_interface.xmit_glue_ntb = NULL;
+    xmit_flush_reset();
   }
 
-  #if CFG_TUD_NCM_LOG_LEVEL >= 3
-  {
-    uint16_t len = ncm_interface.xmit_tinyusb_ntb->nth.wBlockLength;
-    TU_LOG_BUF(3, ncm_interface.xmit_tinyusb_ntb->data[i], len);
+  if (ncm_interface.xmit_glue_ntb == NULL) {
+    xmit_flush_sof_enable(rhport, false);
   }
+  ncm_interface.stats.xmit_ntb++;
+
+  uint32_t const ntb_len = xmit_ntb_block_length(ncm_interface.xmit_tinyusb_ntb);
+
+  #if CFG_TUD_NCM_LOG_LEVEL >= 3
+  TU_LOG_BUF(3, ncm_interface.xmit_tinyusb_ntb->data, ntb_len);
   #endif
 
   if (ncm_interface.xmit_glue_ntb_datagram_ndx != 1) {
-    TU_LOG_DRV(">> %d %d\n", ncm_interface.xmit_tinyusb_ntb->nth.wBlockLength, ncm_interface.xmit_glue_ntb_datagram_ndx);
+    TU_LOG_DRV(">> %lu %d\n", (unsigned long) ntb_len, ncm_interface.xmit_glue_ntb_datagram_ndx);
+  }
+
+  #if CFG_TUD_NCM_IN_SG_N
+  {
+    xmit_sg_t *sg = xmit_sg_get(ncm_interface.xmit_tinyusb_ntb);
+    if (sg->count != 0) {
+      // datagrams are referenced in place: send staging area and referenced buffers
+      xmit_sg_close_stage(ncm_interface.xmit_tinyusb_ntb, sg);
+      usbd_edpt_xfer_sg(0, ncm_interface.ep_in, sg->list, sg->count);
+      return;
+    }
   }
+  #endif
 
   // Kick off an endpoint transfer
-  usbd_edpt_xfer(0, ncm_interface.ep_in, ncm_interface.xmit_tinyusb_ntb->data, ncm_interface.xmit_tinyusb_ntb->nth.wBlockLength);
+  usbd_edpt_xfer(0, ncm_interface.ep_in, ncm_interface.xmit_tinyusb_ntb->data, ntb_len);
 } // xmit_start_if_possible
 
+/**
+ * Deferred from netd_sof() when the hold-off time of the glue NTB expired
+ */
+static void xmit_flush_timeout_func(void *param) {
+  (void) param;
+  xmit_start_if_possible(ncm_interface.rhport);
+} // xmit_flush_timeout_func
+
 /**
  * check if a new datagram fits into the current NTB
  */
@@ -387,10 +633,10 @@ static bool xmit_requested_datagram_fits_into_current_ntb(uint16_t datagram_size
   if (ncm_interface.xmit_glue_ntb == NULL) {
     return false;
   }
-  if (ncm_interface.xmit_glue_ntb_datagram_ndx >= CFG_TUD_NCM_IN_MAX_DATAGRAMS_PER_NTB) {
+  if (ncm_interface.xmit_glue_ntb_datagram_ndx >= ncm_interface.xmit_max_datagrams) {
     return false;
   }
-  if (ncm_interface.xmit_glue_ntb->nth.wBlockLength + datagram_size + XMIT_ALIGN_OFFSET(datagram_size) > CFG_TUD_NCM_IN_NTB_MAX_SIZE) {
+  if (ncm_interface.xmit_glue_ntb_len + datagram_size + XMIT_ALIGN_OFFSET(datagram_size) > xmit_ntb_max_size()) {
     return false;
   }
   return true;
@@ -404,8 +650,12 @@ static bool xmit_setup_next_glue_ntb(void) {
 
   if (ncm_interface.xmit_glue_ntb != NULL) {
     // put NTB into waiting list (the new datagram did not fit in)
+    xmit_close_glue_ntb();
     xmit_put_ntb_into_ready_list(ncm_interface.xmit_glue_ntb);
+    ncm_interface.xmit_glue_ntb = NULL;
+    ncm_interface.stats.xmit_flush_full++;
   }
+  xmit_flush_reset();
 
   ncm_interface.xmit_glue_ntb = xmit_get_free_ntb();// get next buffer (if any)
   if (ncm_interface.xmit_glue_ntb == NULL) {
@@ -417,19 +667,48 @@ static bool xmit_setup_next_glue_ntb(void) {
 
   xmit_ntb_t *ntb = ncm_interface.xmit_glue_ntb;
 
-  // Fill in NTB header
-  ntb->nth.dwSignature = NTH16_SIGNATURE;
-  ntb->nth.wHeaderLength = sizeof(ntb->nth);
-  ntb->nth.wSequence = ncm_interface.xmit_sequence++;
-  ntb->nth.wBlockLength = sizeof(ntb->nth) + sizeof(ntb->ndp) + sizeof(ntb->ndp_datagram);
-  ntb->nth.wNdpIndex = sizeof(ntb->nth);
-
-  // Fill in NDP16 header and terminator
-  ntb->ndp.dwSignature = NDP16_SIGNATURE_NCM0;
-  ntb->ndp.wLength = sizeof(ntb->ndp) + sizeof(ntb->ndp_datagram);
-  ntb->ndp.wNextNdpIndex = 0;
+  #if CFG_TUD_NCM_NTB32
+  if (ncm_interface.ntb_format == NCM_NTB_FORMAT_32) {
+    // Fill in NTB header
+    ntb->nth32.dwSignature = NTH32_SIGNATURE;
+    ntb->nth32.wHeaderLength = sizeof(ntb->nth32);
+    ntb->nth32.wSequence = ncm_interface.xmit_sequence++;
+    ntb->nth32.dwNdpIndex = sizeof(ntb->nth32);
+
+    // Fill in NDP32 header and terminator
+    ntb->ndp32.dwSignature = NDP32_SIGNATURE_NCM0;
+    ntb->ndp32.wLength = sizeof(ntb->ndp32) + sizeof(ntb->ndp32_datagram);
+    ntb->ndp32.wReserved6 = 0;
+    ntb->ndp32.dwNextNdpIndex = 0;
+    ntb->ndp32.dwReserved12 = 0;
+
+    memset(ntb->ndp32_datagram, 0, sizeof(ntb->ndp32_datagram));
+    ncm_interface.xmit_glue_ntb_len = sizeof(ntb->nth32) + sizeof(ntb->ndp32) + sizeof(ntb->ndp32_datagram);
+  } else
+  #endif
+  {
+    // Fill in NTB header
+    ntb->nth.dwSignature = NTH16_SIGNATURE;
+    ntb->nth.wHeaderLength = sizeof(ntb->nth);
+    ntb->nth.wSequence = ncm_interface.xmit_sequence++;
+    ntb->nth.wNdpIndex = sizeof(ntb->nth);
+
+    // Fill in NDP16 header and terminator
+    ntb->ndp.dwSignature = NDP16_SIGNATURE_NCM0;
+    ntb->ndp.wLength = sizeof(ntb->ndp) + sizeof(ntb->ndp_datagram);
+    ntb->ndp.wNextNdpIndex = 0;
+
+    memset(ntb->ndp_datagram, 0, sizeof(ntb->ndp_datagram));
+    ncm_interface.xmit_glue_ntb_len = sizeof(ntb->nth) + sizeof(ntb->ndp) + sizeof(ntb->ndp_datagram);
+  }
 
-  memset(ntb->ndp_datagram, 0, sizeof(ntb->ndp_datagram));
+  #if CFG_TUD_NCM_IN_SG_N
+  xmit_sg_t *sg = xmit_sg_get(ntb);
+  sg->count = 0;
+  sg->ref_count = 0;
+  sg->stage_len = ncm_interface.xmit_glue_ntb_len;
+  sg->stage_start = 0;
+  #endif
   return true;
 } // xmit_setup_next_glue_ntb
 
@@ -485,6 +764,31 @@ static void recv_put_ntb_into_free_list(recv_ntb_t *free_ntb) {
   TU_LOG_DRV("(EE) recv_put_ntb_into_free_list - no entry in free list\n");// this should not happen
 } // recv_put_ntb_into_free_list
 
+/**
+ * Get the index of the recv NTB which contains \a datagram, -1 if there is none
+ */
+static int recv_ntb_index(const uint8_t *datagram) {
+  for (int i = 0; i < RECV_NTB_N; ++i) {
+    const uint8_t *data = ncm_epbuf.recv[i].ntb.data;
+    if (datagram >= data && datagram < data + CFG_TUD_NCM_OUT_NTB_MAX_SIZE) {
+      return i;
+    }
+  }
+  return -1;
+} // recv_ntb_index
+
+/**
+ * The driver is done with \a ntb: put it into the free list unless the glue logic holds references onto it.
+ * Otherwise the last tud_network_recv_unref() frees it.
+ */
+static void recv_release_ntb(recv_ntb_t *ntb) {
+  if (recv_ntb_ref[recv_ntb_index(ntb->data)] == 0) {
+    recv_put_ntb_into_free_list(ntb);
+  } else {
+    TU_LOG_DRV("  recv_release_ntb: %p still referenced\n", ntb);
+  }
+} // recv_release_ntb
+
 /**
  * \a ready_ntb holds a validated NTB,
  * put this buffer into the waiting list.
@@ -539,78 +843,25 @@ static void recv_try_to_start_new_reception(uint8_t rhport) {
  *    \a ndp16->wNextNdpIndex != 0 is not supported
  */
 static bool recv_validate_datagram(const recv_ntb_t *ntb, uint32_t len) {
-  const nth16_t *nth16 = &(ntb->nth);
-
   TU_LOG_DRV("recv_validate_datagram(%p, %d)\n", ntb, (int) len);
 
-  // check header
-  if (nth16->wHeaderLength != sizeof(nth16_t)) {
-    TU_LOG_DRV("(EE) ill nth16 length: %d\n", nth16->wHeaderLength);
-    return false;
-  }
-  if (nth16->dwSignature != NTH16_SIGNATURE) {
-    TU_LOG_DRV("(EE) ill signature: 0x%08x\n", (unsigned) nth16->dwSignature);
-    return false;
-  }
-  if (len < sizeof(nth16_t) + sizeof(ndp16_t) + 2 * sizeof(ndp16_datagram_t)) {
-    TU_LOG_DRV("(EE) ill min len: %lu\n", len);
-    return false;
-  }
-  if (nth16->wBlockLength > len) {
-    TU_LOG_DRV("(EE) ill block length: %d > %lu\n", nth16->wBlockLength, len);
-    return false;
-  }
-  if (nth16->wBlockLength > CFG_TUD_NCM_OUT_NTB_MAX_SIZE) {
-    TU_LOG_DRV("(EE) ill block length2: %d > %d\n", nth16->wBlockLength, CFG_TUD_NCM_OUT_NTB_MAX_SIZE);
-    return false;
-  }
-  if (nth16->wNdpIndex < sizeof(nth16) || nth16->wNdpIndex > len - (sizeof(ndp16_t) + 2 * sizeof(ndp16_datagram_t))) {
-    TU_LOG_DRV("(EE) ill position of first ndp: %d (%lu)\n", nth16->wNdpIndex, len);
-    return false;
-  }
-
-  // check (first) NDP(16)
-  const ndp16_t *ndp16 = (const ndp16_t *) (ntb->data + nth16->wNdpIndex);
-
-  if (ndp16->wLength < sizeof(ndp16_t) + 2 * sizeof(ndp16_datagram_t)) {
-    TU_LOG_DRV("(EE) ill ndp16 length: %d\n", ndp16->wLength);
-    return false;
-  }
-  if (ndp16->dwSignature != NDP16_SIGNATURE_NCM0 && ndp16->dwSignature != NDP16_SIGNATURE_NCM1) {
-    TU_LOG_DRV("(EE) ill signature: 0x%08x\n", (unsigned) ndp16->dwSignature);
-    return false;
-  }
-  if (ndp16->wNextNdpIndex != 0) {
-    TU_LOG_DRV("(EE) cannot handle wNextNdpIndex!=0 (%d)\n", ndp16->wNextNdpIndex);
-    return false;
+  bool valid;
+  #if CFG_TUD_NCM_NTB32
+  if (ncm_interface.ntb_format == NCM_NTB_FORMAT_32) {
+    valid = ncm_ntb32_validate(ntb->data, len, CFG_TUD_NCM_OUT_NTB_MAX_SIZE);
+  } else
+  #endif
+  {
+    valid = ncm_ntb16_validate(ntb->data, len, CFG_TUD_NCM_OUT_NTB_MAX_SIZE);
   }
 
-  const ndp16_datagram_t *ndp16_datagram = (const ndp16_datagram_t *) (ntb->data + nth16->wNdpIndex + sizeof(ndp16_t));
-  int ndx = 0;
-  uint16_t max_ndx = (uint16_t) ((ndp16->wLength - sizeof(ndp16_t)) / sizeof(ndp16_datagram_t));
-
-  if (max_ndx > 2) { // number of datagrams in NTB > 1
-    TU_LOG_DRV("<< %d (%d)\n", max_ndx - 1, ntb->nth.wBlockLength);
-  }
-  if (ndp16_datagram[max_ndx - 1].wDatagramIndex != 0 || ndp16_datagram[max_ndx - 1].wDatagramLength != 0) {
-    TU_LOG_DRV("  max_ndx != 0\n");
+  if (!valid) {
+    TU_LOG_DRV("(EE) ill NTB: len %lu, block length %d, ndp index %d\n", (unsigned long) len, ntb->nth.wBlockLength, ntb->nth.wNdpIndex);
     return false;
   }
-  while (ndp16_datagram[ndx].wDatagramIndex != 0 && ndp16_datagram[ndx].wDatagramLength != 0) {
-    TU_LOG_DRV("  << %d %d\n", ndp16_datagram[ndx].wDatagramIndex, ndp16_datagram[ndx].wDatagramLength);
-    if (ndp16_datagram[ndx].wDatagramIndex > len) {
-      TU_LOG_DRV("(EE) ill start of datagram[%d]: %d (%lu)\n", ndx, ndp16_datagram[ndx].wDatagramIndex, len);
-      return false;
-    }
-    if (ndp16_datagram[ndx].wDatagramIndex + ndp16_datagram[ndx].wDatagramLength > len) {
-      TU_LOG_DRV("(EE) ill end of datagram[%d]: %d (%lu)\n", ndx, ndp16_datagram[ndx].wDatagramIndex + ndp16_datagram[ndx].wDatagramLength, len);
-      return false;
-    }
-    ++ndx;
-  }
 
   #if CFG_TUD_NCM_LOG_LEVEL >= 3
-  TU_LOG_BUF(3, ntb->data[i], len);
+  TU_LOG_BUF(3, ntb->data, len);
   #endif
 
   // -> ntb contains a valid packet structure
@@ -618,6 +869,24 @@ static bool recv_validate_datagram(const recv_ntb_t *ntb, uint32_t len) {
   return true;
 } // recv_validate_datagram
 
+/**
+ * Get position of datagram \a ndx of a validated NTB, false if the end of the datagram list is reached
+ */
+static bool recv_get_datagram(const recv_ntb_t *ntb, uint16_t ndx, uint32_t *index, uint16_t *length) {
+  #if CFG_TUD_NCM_NTB32
+  if (ncm_interface.ntb_format == NCM_NTB_FORMAT_32) {
+    const ndp32_datagram_t *ndp32_datagram = ncm_ntb32_datagram_list(ntb->data);
+    *index = ndp32_datagram[ndx].dwDatagramIndex;
+    *length = (uint16_t) tu_min32(ndp32_datagram[ndx].dwDatagramLength, UINT16_MAX);
+    return *index != 0 && *length != 0;
+  }
+  #endif
+  const ndp16_datagram_t *ndp16_datagram = ncm_ntb16_datagram_list(ntb->data);
+  *index = ndp16_datagram[ndx].wDatagramIndex;
+  *length = ndp16_datagram[ndx].wDatagramLength;
+  return *index != 0 && *length != 0;
+} // recv_get_datagram
+
 /**
  * Transfer the next (pending) datagram to the glue logic and return receive buffer if empty.
  */
@@ -631,29 +900,22 @@ static void recv_transfer_datagram_to_glue_logic(void) {
   }
 
   if (ncm_interface.recv_glue_ntb != NULL) {
-    const ndp16_datagram_t *ndp16_datagram = (ndp16_datagram_t *) (ncm_interface.recv_glue_ntb->data + ncm_interface.recv_glue_ntb->nth.wNdpIndex + sizeof(ndp16_t));
+    uint32_t datagramIndex;
+    uint16_t datagramLength;
 
-    if (ndp16_datagram[ncm_interface.recv_glue_ntb_datagram_ndx].wDatagramIndex == 0) {
-      TU_LOG_DRV("(EE) SOMETHING WENT WRONG 1\n");
-    } else if (ndp16_datagram[ncm_interface.recv_glue_ntb_datagram_ndx].wDatagramLength == 0) {
-      TU_LOG_DRV("(EE) SOMETHING WENT WRONG 2\n");
+    if (!recv_get_datagram(ncm_interface.recv_glue_ntb, ncm_interface.recv_glue_ntb_datagram_ndx, &datagramIndex, &datagramLength)) {
+      TU_LOG_DRV("(EE) SOMETHING WENT WRONG\n");
     } else {
-      uint16_t datagramIndex = ndp16_datagram[ncm_interface.recv_glue_ntb_datagram_ndx].wDatagramIndex;
-      uint16_t datagramLength = ndp16_datagram[ncm_interface.recv_glue_ntb_datagram_ndx].wDatagramLength;
-
-      TU_LOG_DRV("  recv[%d] - %d %d\n", ncm_interface.recv_glue_ntb_datagram_ndx, datagramIndex, datagramLength);
+      TU_LOG_DRV("  recv[%d] - %lu %d\n", ncm_interface.recv_glue_ntb_datagram_ndx, (unsigned long) datagramIndex, datagramLength);
       if (tud_network_recv_cb(ncm_interface.recv_glue_ntb->data + datagramIndex, datagramLength)) {
         // send datagram successfully to glue logic
         TU_LOG_DRV("    OK\n");
-        datagramIndex = ndp16_datagram[ncm_interface.recv_glue_ntb_datagram_ndx + 1].wDatagramIndex;
-        datagramLength = ndp16_datagram[ncm_interface.recv_glue_ntb_datagram_ndx + 1].wDatagramLength;
-
-        if (datagramIndex != 0 && datagramLength != 0) {
+        if (recv_get_datagram(ncm_interface.recv_glue_ntb, ncm_interface.recv_glue_ntb_datagram_ndx + 1, &datagramIndex, &datagramLength)) {
           // -> next datagram
           ++ncm_interface.recv_glue_ntb_datagram_ndx;
         } else {
           // end of datagrams reached
-          recv_put_ntb_into_free_list(ncm_interface.recv_glue_ntb);
+          recv_release_ntb(ncm_interface.recv_glue_ntb);
           ncm_interface.recv_glue_ntb = NULL;
         }
       }
@@ -674,13 +936,14 @@ static void recv_transfer_datagram_to_glue_logic(void) {
 bool tud_network_can_xmit(uint16_t size) {
   TU_LOG_DRV("tud_network_can_xmit(%d)\n", size);
 
-  TU_ASSERT(size <= CFG_TUD_NCM_IN_NTB_MAX_SIZE - (sizeof(nth16_t) + sizeof(ndp16_t) + 2 * sizeof(ndp16_datagram_t)), false);
+  TU_ASSERT(XMIT_NTB_MIN_HEADER_LEN + size <= CFG_TUD_NCM_IN_NTB_MAX_SIZE, false);
 
   if (xmit_requested_datagram_fits_into_current_ntb(size) || xmit_setup_next_glue_ntb()) {
     // -> everything is fine
     return true;
   }
   xmit_start_if_possible(ncm_interface.rhport);
+  ncm_interface.stats.xmit_blocked++;
   TU_LOG_DRV("(II) tud_network_can_xmit: request blocked\n");// could happen if all xmit buffers are full (but should happen rarely)
   return false;
 } // tud_network_can_xmit
@@ -700,16 +963,20 @@ void tud_network_xmit(void *ref, uint16_t arg) {
   xmit_ntb_t *ntb = ncm_interface.xmit_glue_ntb;
 
   // copy new datagram to the end of the current NTB
-  uint16_t size = tud_network_xmit_cb(ntb->data + ntb->nth.wBlockLength, ref, arg);
+  #if CFG_TUD_NCM_IN_SG_N
+  xmit_sg_t *sg = xmit_sg_get(ntb);
+  uint16_t size = tud_network_xmit_cb(ntb->data + sg->stage_len, ref, arg);
+  sg->stage_len += (uint16_t) (size + XMIT_ALIGN_OFFSET(size));
+  #else
+  uint16_t size = tud_network_xmit_cb(ntb->data + ncm_interface.xmit_glue_ntb_len, ref, arg);
+  #endif
 
   // correct NTB internals
-  ntb->ndp_datagram[ncm_interface.xmit_glue_ntb_datagram_ndx].wDatagramIndex = ntb->nth.wBlockLength;
-  ntb->ndp_datagram[ncm_interface.xmit_glue_ntb_datagram_ndx].wDatagramLength = size;
-  ncm_interface.xmit_glue_ntb_datagram_ndx += 1;
+  xmit_add_datagram(ntb, ncm_interface.xmit_glue_ntb_len, size);
 
-  ntb->nth.wBlockLength += (uint16_t) (size + XMIT_ALIGN_OFFSET(size));
+  ncm_interface.xmit_glue_ntb_len += (uint16_t) (size + XMIT_ALIGN_OFFSET(size));
 
-  if (ntb->nth.wBlockLength > CFG_TUD_NCM_IN_NTB_MAX_SIZE) {
+  if (ncm_interface.xmit_glue_ntb_len > CFG_TUD_NCM_IN_NTB_MAX_SIZE) {
     TU_LOG_DRV("(EE) tud_network_xmit: buffer overflow\n"); // must not happen (really)
     return;
   }
@@ -717,6 +984,73 @@ void tud_network_xmit(void *ref, uint16_t arg) {
   xmit_start_if_possible(ncm_interface.rhport);
 } // tud_network_xmit
 
+#if CFG_TUD_NCM_IN_SG_N
+/**
+ * Put a datagram described by a scatter-gather list into a waiting NTB.
+ * The transfer stream is split at endpoint packet size boundaries: a buffer part which starts and ends
+ * on a boundary is referenced in place, everything else (NTB header, unaligned head and tail of buffers)
+ * is copied into the NTB buffer.  Segments in the list have thus a length multiple of the packet size
+ * (except the last one) as required by usbd_edpt_xfer_sg().
+ */
+void tud_network_xmit_sg(const tud_network_iovec_t *iov, uint8_t count, void *ref) {
+  TU_LOG_DRV("tud_network_xmit_sg(%p, %d, %p)\n", iov, count, ref);
+
+  if (ncm_interface.xmit_glue_ntb == NULL) {
+    TU_LOG_DRV("(EE) tud_network_xmit_sg: no buffer\n");// must not happen (really)
+    return;
+  }
+
+  xmit_ntb_t *ntb = ncm_interface.xmit_glue_ntb;
+  xmit_sg_t *sg = xmit_sg_get(ntb);
+  uint16_t const mps = CFG_TUD_NET_ENDPOINT_SIZE;
+  uint32_t const datagram_index = ncm_interface.xmit_glue_ntb_len;
+  bool in_place = false;
+
+  for (uint8_t i = 0; i < count; ++i) {
+    const uint8_t *src = (const uint8_t *) iov[i].base;
+    uint16_t len = iov[i].len;
+    uint16_t const head = (uint16_t) ((mps - ncm_interface.xmit_glue_ntb_len % mps) % mps);
+
+    // closed staging + in place segment, one spare entry for the final staging segment
+    if (len >= head + mps && sg->count + 3 <= CFG_TUD_NCM_IN_SG_N) {
+      xmit_sg_stage(ntb, sg, src, head);
+      src += head;
+      len -= head;
+      xmit_sg_close_stage(ntb, sg);
+
+      uint16_t const n = (uint16_t) (len - len % mps);
+      sg->list[sg->count].buffer = (uint8_t *) (uintptr_t) src;
+      sg->list[sg->count].len = n;
+      sg->count++;
+      ncm_interface.xmit_glue_ntb_len += n;
+      src += n;
+      len -= n;
+      in_place = true;
+    }
+    xmit_sg_stage(ntb, sg, src, len);
+  }
+
+  uint16_t const size = (uint16_t) (ncm_interface.xmit_glue_ntb_len - datagram_index);
+  xmit_add_datagram(ntb, datagram_index, size);
+
+  xmit_sg_stage(ntb, sg, NULL, XMIT_ALIGN_OFFSET(size));
+
+  if (in_place) {
+    sg->ref[sg->ref_count++] = ref;
+  } else if (tud_network_xmit_sg_done_cb) {
+    // everything copied, buffers are already free
+    tud_network_xmit_sg_done_cb(ref);
+  }
+
+  if (ncm_interface.xmit_glue_ntb_len > CFG_TUD_NCM_IN_NTB_MAX_SIZE) {
+    TU_LOG_DRV("(EE) tud_network_xmit_sg: buffer overflow\n"); // must not happen (really)
+    return;
+  }
+
+  xmit_start_if_possible(ncm_interface.rhport);
+} // tud_network_xmit_sg
+#endif
+
 /**
  * Keep the receive logic busy and transfer pending packets to the glue logic.
  * Avoid recursive calls due to wrong expectations of the net glue logic,
@@ -745,6 +1079,79 @@ void tud_network_recv_renew(void) {
   recv_try_to_start_new_reception(ncm_interface.rhport);
 } // tud_network_recv_renew
 
+/**
+ * Take a reference onto the NTB holding \a datagram, so that the datagram remains valid after
+ * tud_network_recv_renew() (zero-copy receive).
+ * The last unreferenced recv NTB is never pinned, otherwise reception would stall: in this case the
+ * call fails and the glue logic has to copy the datagram.
+ */
+bool tud_network_recv_ref(const uint8_t *datagram) {
+  int const ndx = recv_ntb_index(datagram);
+  TU_ASSERT(ndx >= 0);
+  TU_ASSERT(recv_ntb_ref[ndx] < UINT8_MAX);
+
+  if (recv_ntb_ref[ndx] == 0) {
+    int pinned = 0;
+    for (int i = 0; i < RECV_NTB_N; ++i) {
+      if (recv_ntb_ref[i] != 0) {
+        ++pinned;
+      }
+    }
+    if (pinned + 1 >= RECV_NTB_N) {
+      TU_LOG_DRV("  tud_network_recv_ref: last free NTB, refused\n");
+      return false;
+    }
+  }
+
+  ++recv_ntb_ref[ndx];
+  return true;
+} // tud_network_recv_ref
+
+/**
+ * Drop a reference taken with tud_network_recv_ref().
+ * If the driver is done with the NTB, it is returned to the free list and reception is restarted.
+ */
+void tud_network_recv_unref(const uint8_t *datagram) {
+  int const ndx = recv_ntb_index(datagram);
+  TU_ASSERT(ndx >= 0 && recv_ntb_ref[ndx] != 0,);
+
+  if (--recv_ntb_ref[ndx] != 0) {
+    return;
+  }
+
+  recv_ntb_t *ntb = &ncm_epbuf.recv[ndx].ntb;
+  if (ntb == ncm_interface.recv_glue_ntb) {
+    // datagrams left in this NTB, recv_transfer_datagram_to_glue_logic() releases it
+    return;
+  }
+  recv_put_ntb_into_free_list(ntb);
+  recv_try_to_start_new_reception(ncm_interface.rhport);
+} // tud_network_recv_unref
+
+/**
+ * Configure hold-off time and size threshold for partially filled xmit NTBs.
+ * A pending held NTB is checked against the new settings immediately.
+ */
+void tud_network_ncm_flush_config(uint32_t timeout_us, uint16_t threshold) {
+  TU_LOG_DRV("tud_network_ncm_flush_config(%lu, %u)\n", (unsigned long) timeout_us, threshold);
+
+  ncm_flush_cfg.timeout_us = timeout_us;
+  ncm_flush_cfg.threshold = threshold;
+  xmit_start_if_possible(ncm_interface.rhport);
+} // tud_network_ncm_flush_config
+
+/**
+ * Get driver statistics
+ */
+void tud_network_ncm_stats(tud_network_ncm_stats_t *stats, bool reset) {
+  if (stats != NULL) {
+    *stats = ncm_interface.stats;
+  }
+  if (reset) {
+    tu_memclr(&ncm_interface.stats, sizeof(ncm_interface.stats));
+  }
+} // tud_network_ncm_stats
+
 /**
  * Same as tud_network_recv_renew() but knows \a rhport
  */
@@ -767,12 +1174,18 @@ void netd_init(void) {
   TU_LOG_DRV("netd_init()\n");
 
   memset(&ncm_interface, 0, sizeof(ncm_interface));
+  ncm_interface.ntb_format = NCM_NTB_FORMAT_16;
+  ncm_interface.xmit_ntb_in_size = CFG_TUD_NCM_IN_NTB_MAX_SIZE;
+  ncm_interface.xmit_max_datagrams = CFG_TUD_NCM_IN_MAX_DATAGRAMS_PER_NTB;
 
   for (int i = 0; i < XMIT_NTB_N; ++i) {
     ncm_interface.xmit_free_ntb[i] = &ncm_epbuf.xmit[i].ntb;
   }
   for (int i = 0; i < RECV_NTB_N; ++i) {
-    ncm_interface.recv_free_ntb[i] = &ncm_epbuf.recv[i].ntb;
+    if (recv_ntb_ref[i] == 0) {
+      // NTBs still referenced by glue logic are freed by tud_network_recv_unref()
+      ncm_interface.recv_free_ntb[i] = &ncm_epbuf.recv[i].ntb;
+    }
   }
 } // netd_init
 
@@ -788,7 +1201,14 @@ bool netd_deinit(void) {
  * In this driver this is the same as netd_init()
  */
 void netd_reset(uint8_t rhport) {
-  (void) rhport;
+  xmit_flush_sof_enable(rhport, false);
+
+  #if CFG_TUD_NCM_IN_SG_N
+  // return buffers of NTBs which are dropped
+  for (int i = 0; i < XMIT_NTB_N; ++i) {
+    xmit_sg_done(&ncm_epbuf.xmit[i].ntb);
+  }
+  #endif
 
   netd_init();
 } // netd_reset
@@ -858,9 +1278,11 @@ bool netd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_
     if (!recv_validate_datagram(ncm_interface.recv_tinyusb_ntb, xferred_bytes)) {
       // verification failed: ignore NTB and return it to free
       TU_LOG_DRV("(EE) VALIDATION FAILED. WHAT CAN WE DO IN THIS CASE?\n");
+      ncm_interface.stats.recv_invalid++;
     } else {
       // packet ok -> put it into ready list
       recv_put_ntb_into_ready_list(ncm_interface.recv_tinyusb_ntb);
+      ncm_interface.stats.recv_ntb++;
     }
     ncm_interface.recv_tinyusb_ntb = NULL;
     tud_network_recv_renew_r(rhport);
@@ -869,6 +1291,9 @@ bool netd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_
     // - free the transmitted NTB buffer
     // - insert ZLPs when necessary
     // - if there is another transmit NTB waiting, try to start transmission
+    #if CFG_TUD_NCM_IN_SG_N
+    xmit_sg_done(ncm_interface.xmit_tinyusb_ntb);
+    #endif
     xmit_put_ntb_into_free_list(ncm_interface.xmit_tinyusb_ntb);
     ncm_interface.xmit_tinyusb_ntb = NULL;
     if (!xmit_insert_required_zlp(rhport, xferred_bytes)) {
@@ -882,11 +1307,52 @@ bool netd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_
   return true;
 } // netd_xfer_cb
 
+/**
+ * SOF handler, called in ISR context.
+ * Accumulates hold-off time of the glue NTB, one SOF is 1ms on Full-Speed and 125us on High-Speed.
+ */
+void netd_sof(uint8_t rhport, uint32_t frame_count) {
+  (void) rhport;
+  (void) frame_count;
+
+  if (!ncm_interface.xmit_flush_armed) {
+    return;
+  }
+
+  ncm_interface.xmit_flush_elapsed_us += (tud_speed_get() == TUSB_SPEED_HIGH) ? 125 : 1000;
+  if (ncm_interface.xmit_flush_elapsed_us >= ncm_flush_cfg.timeout_us) {
+    ncm_interface.xmit_flush_armed = false;
+    ncm_interface.xmit_flush_expired = true;
+    usbd_defer_func(xmit_flush_timeout_func, NULL, true);
+  }
+} // netd_sof
+
+/**
+ * Apply data of SET_NTB_INPUT_SIZE: the host may reduce size and number of datagrams of xmit NTBs.
+ * A size which can't hold a full sized datagram is refused.
+ */
+static bool ntb_input_size_set(const ncm_ntb_input_size_t *input_size, uint16_t len) {
+  TU_LOG_DRV("ntb_input_size_set(%lu)\n", (unsigned long) input_size->dwNtbInMaxSize);
+
+  TU_VERIFY(input_size->dwNtbInMaxSize >= XMIT_NTB_MIN_HEADER_LEN + CFG_TUD_NET_MTU, false);
+  ncm_interface.xmit_ntb_in_size = tu_min32(input_size->dwNtbInMaxSize, CFG_TUD_NCM_IN_NTB_MAX_SIZE);
+
+  ncm_interface.xmit_max_datagrams = CFG_TUD_NCM_IN_MAX_DATAGRAMS_PER_NTB;
+  if (len >= 8 && input_size->wNtbInMaxDatagrams != 0) {
+    ncm_interface.xmit_max_datagrams = tu_min16(input_size->wNtbInMaxDatagrams, CFG_TUD_NCM_IN_MAX_DATAGRAMS_PER_NTB);
+  }
+  return true;
+} // ntb_input_size_set
+
 /**
  * Respond to TinyUSB control requests.
  * At startup transmission of notification packets are done here.
  */
 bool netd_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request) {
+  if (stage == CONTROL_STAGE_DATA && request->bmRequestType_bit.type == TUSB_REQ_TYPE_CLASS &&
+      request->bRequest == NCM_SET_NTB_INPUT_SIZE) {
+    return ntb_input_size_set(&ncm_interface.ctrl_ntb_input_size, request->wLength);
+  }
   if (stage != CONTROL_STAGE_SETUP) {
     return true;
   }
@@ -927,6 +1393,32 @@ bool netd_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t
           tud_control_xfer(rhport, request, (void *) (uintptr_t) &ntb_parameters, sizeof(ntb_parameters));
         } break;
 
+        case NCM_GET_NTB_FORMAT: {
+          ncm_interface.ctrl_ntb_format = ncm_interface.ntb_format;
+          tud_control_xfer(rhport, request, &ncm_interface.ctrl_ntb_format, sizeof(ncm_interface.ctrl_ntb_format));
+        } break;
+
+        case NCM_SET_NTB_FORMAT: {
+          // format can only be changed while there is no network traffic
+          TU_VERIFY(request->wValue == NCM_NTB_FORMAT_16 || (CFG_TUD_NCM_NTB32 && request->wValue == NCM_NTB_FORMAT_32), false);
+          TU_VERIFY(ncm_interface.itf_data_alt == 0 && ncm_interface.xmit_glue_ntb == NULL, false);
+          ncm_interface.ntb_format = (uint8_t) request->wValue;
+          tud_control_status(rhport, request);
+        } break;
+
+        case NCM_GET_NTB_INPUT_SIZE: {
+          ncm_interface.ctrl_ntb_input_size.dwNtbInMaxSize = ncm_interface.xmit_ntb_in_size;
+          ncm_interface.ctrl_ntb_input_size.wNtbInMaxDatagrams = ncm_interface.xmit_max_datagrams;
+          ncm_interface.ctrl_ntb_input_size.wReserved = 0;
+          tud_control_xfer(rhport, request, &ncm_interface.ctrl_ntb_input_size, sizeof(ncm_interface.ctrl_ntb_input_size));
+        } break;
+
+        case NCM_SET_NTB_INPUT_SIZE: {
+          // 4 bytes, or 8 if wNtbInMaxDatagrams is supported (bmNetworkCapabilities D5), applied in data stage
+          TU_VERIFY(request->wLength == 4 || request->wLength == 8, false);
+          tud_control_xfer(rhport, request, &ncm_interface.ctrl_ntb_input_size, request->wLength);
+        } break;
+
           // unsupported request
         default:
           return false;
@@ -0,0 +1,852 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (CFG_TUH_ENABLED && CFG_TUH_NCM)
+
+#include "host/usbh.h"
+#include "host/usbh_pvt.h"
+
+#include "ncm.h"
+#include "ncm_host.h"
+
+// Level where CFG_TUSB_DEBUG must be at least for this driver is logged
+#ifndef CFG_TUH_NCM_LOG_LEVEL
+  #define CFG_TUH_NCM_LOG_LEVEL   CFG_TUH_LOG_LEVEL
+#endif
+
+#define TU_LOG_DRV(...)   TU_LOG(CFG_TUH_NCM_LOG_LEVEL, __VA_ARGS__)
+
+// NCM 1.0 Table 6-3: dwNtbInMaxSize set by host must be at least 2048
+TU_VERIFY_STATIC(CFG_TUH_NCM_RX_NTB_SIZE >= 2048 && CFG_TUH_NCM_RX_NTB_SIZE <= UINT16_MAX, "NCM RX NTB size must be 2048..65535");
+TU_VERIFY_STATIC(CFG_TUH_NCM_TX_NTB_SIZE <= UINT16_MAX, "NCM TX NTB size must not exceed 65535");
+
+//--------------------------------------------------------------------+
+// Host NCM Interface
+//--------------------------------------------------------------------+
+
+// Transmit NTB: header followed by the fixed-size datagram pointer table, datagrams are appended after that
+typedef struct TU_ATTR_PACKED {
+  nth16_t nth;
+  ndp16_t ndp;
+  ndp16_datagram_t datagram[CFG_TUH_NCM_TX_MAX_DATAGRAMS_PER_NTB + 1];
+} ncmh_tx_header_t;
+
+enum {
+  NCMH_NOTIF_SIZE = 16, // notification header + CONNECTION_SPEED_CHANGE data
+  NCMH_CTRL_SIZE  = 32  // NTB parameters or MAC address string
+};
+
+typedef struct {
+  uint8_t daddr;
+  uint8_t itf_num;       // communication interface
+  uint8_t itf_data;      // data interface
+  uint8_t data_alt;      // alternate setting of data interface with endpoints
+  uint8_t mac_str_index; // iMACAddress
+
+  bool is_ecm;
+  bool mounted;          // data interface is active
+  bool link_up;
+
+  uint8_t ep_notif;
+  uint8_t ep_in;
+  uint8_t ep_out;
+  uint16_t ep_out_mps;
+
+  uint8_t mac[6];
+
+  // NTB parameters, for ECM: rx_ntb_size is frame buffer size and datagrams are not aggregated
+  uint16_t rx_ntb_size;
+  uint16_t tx_ntb_size;
+  uint16_t tx_divisor;
+  uint16_t tx_remainder;
+  uint16_t tx_ndp_index;
+  uint8_t  tx_max_datagrams;
+
+  // receive: ring of buffers filled by IN endpoint in order, consumed by glue logic in order
+  struct {
+    uint16_t len[CFG_TUH_NCM_RX_NTB_N];
+    uint8_t rd;            // buffer being processed by glue logic
+    uint8_t count;         // buffers holding received data
+    uint16_t datagram_ndx; // datagram of buffer rd passed to glue logic next (NCM)
+    bool busy;             // transfer on-going into buffer (rd + count)
+    bool delivered;        // datagram is passed to glue logic, waiting for tuh_network_recv_renew()
+    bool renew;            // tuh_network_recv_renew() is called
+    bool in_cb;            // inside tuh_network_recv_cb()
+  } rx;
+
+  // transmit: ring of buffers, the last one is open for aggregation until it is sent
+  struct {
+    uint16_t len[CFG_TUH_NCM_TX_NTB_N];
+    uint8_t rd;            // buffer being sent (if busy)
+    uint8_t count;         // buffers holding data to send
+    uint8_t datagram_ndx;  // number of datagrams in open buffer
+    uint16_t sequence;
+    bool open;             // last buffer accepts more datagrams
+    bool busy;
+    bool zlp;              // transfer of buffer rd needs a terminating ZLP
+  } tx;
+
+  tuh_ncm_stats_t stats;
+} ncmh_interface_t;
+
+typedef struct {
+  TUH_EPBUF_DEF(buf, CFG_TUH_NCM_RX_NTB_SIZE);
+} ncmh_rx_ntb_t;
+
+typedef struct {
+  TUH_EPBUF_DEF(buf, CFG_TUH_NCM_TX_NTB_SIZE);
+} ncmh_tx_ntb_t;
+
+typedef struct {
+  ncmh_rx_ntb_t rx[CFG_TUH_NCM_RX_NTB_N];
+  ncmh_tx_ntb_t tx[CFG_TUH_NCM_TX_NTB_N];
+  TUH_EPBUF_DEF(notif, NCMH_NOTIF_SIZE);
+  TUH_EPBUF_DEF(ctrl, NCMH_CTRL_SIZE);
+} ncmh_epbuf_t;
+
+static ncmh_interface_t ncmh_data[CFG_TUH_NCM];
+CFG_TUH_MEM_SECTION static ncmh_epbuf_t ncmh_epbuf[CFG_TUH_NCM];
+
+// stages of set config, carried in user_data with index
+enum {
+  CONFIG_GET_MAC_ADDRESS = 0,
+  CONFIG_GET_NTB_PARAMETERS,
+  CONFIG_SET_NTB_INPUT_SIZE,
+  CONFIG_SET_PACKET_FILTER,
+  CONFIG_SET_DATA_INTERFACE,
+  CONFIG_COMPLETE,
+};
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+
+static inline ncmh_interface_t* get_itf(uint8_t idx) {
+  TU_ASSERT(idx < CFG_TUH_NCM, NULL);
+  ncmh_interface_t* p_ncm = &ncmh_data[idx];
+
+  return (p_ncm->daddr != 0) ? p_ncm : NULL;
+}
+
+static inline uint8_t get_idx_by_ep_addr(uint8_t daddr, uint8_t ep_addr) {
+  for (uint8_t i = 0; i < CFG_TUH_NCM; i++) {
+    ncmh_interface_t const* p_ncm = &ncmh_data[i];
+    if ((p_ncm->daddr == daddr) &&
+        (ep_addr == p_ncm->ep_notif || ep_addr == p_ncm->ep_in || ep_addr == p_ncm->ep_out)) {
+      return i;
+    }
+  }
+
+  return TUSB_INDEX_INVALID_8;
+}
+
+static void rx_process(ncmh_interface_t* p_ncm, uint8_t idx);
+static void tx_start(ncmh_interface_t* p_ncm, uint8_t idx);
+static void config_process(tuh_xfer_t* xfer);
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+
+uint8_t tuh_ncm_itf_get_index(uint8_t daddr, uint8_t itf_num) {
+  for (uint8_t i = 0; i < CFG_TUH_NCM; i++) {
+    ncmh_interface_t const* p_ncm = &ncmh_data[i];
+    if (p_ncm->daddr == daddr && p_ncm->itf_num == itf_num) return i;
+  }
+
+  return TUSB_INDEX_INVALID_8;
+}
+
+bool tuh_ncm_mounted(uint8_t idx) {
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_VERIFY(p_ncm);
+  return p_ncm->mounted;
+}
+
+bool tuh_ncm_is_ecm(uint8_t idx) {
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_VERIFY(p_ncm);
+  return p_ncm->is_ecm;
+}
+
+bool tuh_ncm_get_mac_addr(uint8_t idx, uint8_t mac[6]) {
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_VERIFY(p_ncm && mac);
+  memcpy(mac, p_ncm->mac, 6);
+  return true;
+}
+
+bool tuh_ncm_link_up(uint8_t idx) {
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_VERIFY(p_ncm);
+  return p_ncm->link_up;
+}
+
+bool tuh_ncm_get_stats(uint8_t idx, tuh_ncm_stats_t* stats, bool reset) {
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_VERIFY(p_ncm);
+  if (stats) {
+    *stats = p_ncm->stats;
+  }
+  if (reset) {
+    tu_memclr(&p_ncm->stats, sizeof(p_ncm->stats));
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Receive (device -> driver -> glue logic)
+//--------------------------------------------------------------------+
+
+static inline uint8_t* rx_buf(uint8_t idx, uint8_t n) {
+  return ncmh_epbuf[idx].rx[n].buf;
+}
+
+// Keep IN endpoint armed as long as there is a free buffer
+static void rx_start(ncmh_interface_t* p_ncm, uint8_t idx) {
+  if (!p_ncm->mounted || p_ncm->rx.busy || p_ncm->rx.count >= CFG_TUH_NCM_RX_NTB_N) {
+    return;
+  }
+
+  uint8_t const n = (uint8_t) ((p_ncm->rx.rd + p_ncm->rx.count) % CFG_TUH_NCM_RX_NTB_N);
+  p_ncm->rx.busy = true;
+  if (!usbh_edpt_xfer(p_ncm->daddr, p_ncm->ep_in, rx_buf(idx, n), p_ncm->rx_ntb_size)) {
+    p_ncm->rx.busy = false;
+  }
+}
+
+static void rx_complete(ncmh_interface_t* p_ncm, uint8_t idx, uint32_t xferred_bytes) {
+  uint8_t const n = (uint8_t) ((p_ncm->rx.rd + p_ncm->rx.count) % CFG_TUH_NCM_RX_NTB_N);
+  uint8_t const* buf = rx_buf(idx, n);
+  p_ncm->rx.busy = false;
+
+  if (xferred_bytes == 0) {
+    return; // failed transfer or ZLP, buffer is re-used
+  }
+
+  if (p_ncm->is_ecm) {
+    // a transfer is an Ethernet frame
+    p_ncm->rx.len[n] = (uint16_t) xferred_bytes;
+    p_ncm->rx.count++;
+    p_ncm->stats.recv_ntb++;
+  } else if (!ncm_ntb16_validate(buf, xferred_bytes, p_ncm->rx_ntb_size)) {
+    TU_LOG_DRV("  NCM invalid NTB, len = %lu\r\n", (unsigned long) xferred_bytes);
+    p_ncm->stats.recv_invalid++;
+  } else {
+    p_ncm->stats.recv_ntb++;
+    ndp16_datagram_t const* datagram = ncm_ntb16_datagram_list(buf);
+    if (datagram[0].wDatagramIndex != 0 && datagram[0].wDatagramLength != 0) {
+      p_ncm->rx.len[n] = (uint16_t) xferred_bytes;
+      p_ncm->rx.count++;
+    }
+  }
+}
+
+// Glue logic is done with delivered datagram: move to next one, release buffer if it was the last
+static void rx_advance(ncmh_interface_t* p_ncm, uint8_t idx) {
+  bool release = true;
+
+  if (!p_ncm->is_ecm) {
+    ndp16_datagram_t const* datagram = ncm_ntb16_datagram_list(rx_buf(idx, p_ncm->rx.rd));
+    uint16_t const next = (uint16_t) (p_ncm->rx.datagram_ndx + 1);
+    if (datagram[next].wDatagramIndex != 0 && datagram[next].wDatagramLength != 0) {
+      p_ncm->rx.datagram_ndx = next;
+      release = false;
+    }
+  }
+
+  if (release) {
+    p_ncm->rx.rd = (uint8_t) ((p_ncm->rx.rd + 1) % CFG_TUH_NCM_RX_NTB_N);
+    p_ncm->rx.count--;
+    p_ncm->rx.datagram_ndx = 0;
+  }
+}
+
+static void rx_deliver(ncmh_interface_t* p_ncm, uint8_t idx) {
+  uint8_t const* buf = rx_buf(idx, p_ncm->rx.rd);
+  uint8_t const* src = buf;
+  uint16_t size = p_ncm->rx.len[p_ncm->rx.rd];
+
+  if (!p_ncm->is_ecm) {
+    ndp16_datagram_t const* datagram = &ncm_ntb16_datagram_list(buf)[p_ncm->rx.datagram_ndx];
+    src = buf + datagram->wDatagramIndex;
+    size = datagram->wDatagramLength;
+  }
+
+  // glue logic may call tuh_network_recv_renew() within callback, it is processed after return
+  p_ncm->rx.in_cb = true;
+  if (tuh_network_recv_cb(idx, src, size)) {
+    p_ncm->rx.delivered = true;
+    p_ncm->stats.recv_datagram++;
+  }
+  p_ncm->rx.in_cb = false;
+}
+
+static void rx_process(ncmh_interface_t* p_ncm, uint8_t idx) {
+  if (p_ncm->rx.in_cb) {
+    return;
+  }
+
+  do {
+    if (p_ncm->rx.renew && p_ncm->rx.delivered) {
+      p_ncm->rx.delivered = false;
+      rx_advance(p_ncm, idx);
+    }
+    p_ncm->rx.renew = false;
+
+    rx_start(p_ncm, idx);
+
+    if (!p_ncm->rx.delivered && p_ncm->rx.count) {
+      rx_deliver(p_ncm, idx);
+    }
+  } while (p_ncm->rx.renew);
+}
+
+void tuh_network_recv_renew(uint8_t idx) {
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_VERIFY(p_ncm && p_ncm->mounted,);
+
+  p_ncm->rx.renew = true;
+  rx_process(p_ncm, idx);
+}
+
+//--------------------------------------------------------------------+
+// Transmit (glue logic -> driver -> device)
+//--------------------------------------------------------------------+
+
+static inline uint8_t* tx_buf(uint8_t idx, uint8_t n) {
+  return ncmh_epbuf[idx].tx[n].buf;
+}
+
+// Offset of next datagram in NTB: first offset >= len with offset % wNdpOutDivisor == wNdpOutPayloadRemainder
+static inline uint16_t tx_datagram_offset(ncmh_interface_t const* p_ncm, uint16_t len) {
+  uint32_t const div = p_ncm->tx_divisor;
+  uint32_t offset = (len / div) * div + p_ncm->tx_remainder;
+  if (offset < len) {
+    offset += div;
+  }
+  return (uint16_t) tu_min32(offset, UINT16_MAX);
+}
+
+static bool tx_fits(ncmh_interface_t const* p_ncm, uint8_t n, uint16_t size) {
+  if (p_ncm->is_ecm) {
+    return p_ncm->tx.datagram_ndx == 0; // one frame per transfer
+  }
+  TU_VERIFY(p_ncm->tx.datagram_ndx < p_ncm->tx_max_datagrams);
+  return (uint32_t) tx_datagram_offset(p_ncm, p_ncm->tx.len[n]) + size <= p_ncm->tx_ntb_size;
+}
+
+static void tx_open_ntb(ncmh_interface_t* p_ncm, uint8_t idx, uint8_t n) {
+  p_ncm->tx.open = true;
+  p_ncm->tx.datagram_ndx = 0;
+
+  if (p_ncm->is_ecm) {
+    p_ncm->tx.len[n] = 0;
+    return;
+  }
+
+  // NTH16, then NDP16 with datagram table terminated by zero entry
+  uint8_t* buf = tx_buf(idx, n);
+  ncmh_tx_header_t* hdr = (ncmh_tx_header_t*) buf;
+  uint16_t const ndp_len = (uint16_t) (sizeof(ndp16_t) + (p_ncm->tx_max_datagrams + 1) * sizeof(ndp16_datagram_t));
+  ndp16_t* ndp = (ndp16_t*) (buf + p_ncm->tx_ndp_index);
+
+  hdr->nth.dwSignature   = NTH16_SIGNATURE;
+  hdr->nth.wHeaderLength = sizeof(nth16_t);
+  hdr->nth.wSequence     = p_ncm->tx.sequence++;
+  hdr->nth.wNdpIndex     = p_ncm->tx_ndp_index;
+
+  ndp->dwSignature   = NDP16_SIGNATURE_NCM0;
+  ndp->wLength       = ndp_len;
+  ndp->wNextNdpIndex = 0;
+  tu_memclr(buf + p_ncm->tx_ndp_index + sizeof(ndp16_t), ndp_len - sizeof(ndp16_t));
+
+  p_ncm->tx.len[n] = (uint16_t) (p_ncm->tx_ndp_index + ndp_len);
+}
+
+// Send next buffer if endpoint is idle. While a transfer is on-going, datagrams are aggregated into open buffer
+static void tx_start(ncmh_interface_t* p_ncm, uint8_t idx) {
+  if (!p_ncm->mounted || p_ncm->tx.busy || p_ncm->tx.count == 0) {
+    return;
+  }
+
+  uint8_t const n = p_ncm->tx.rd;
+  if (p_ncm->tx.count == 1) {
+    if (p_ncm->tx.open && p_ncm->tx.datagram_ndx == 0) {
+      return; // nothing written yet
+    }
+    p_ncm->tx.open = false;
+  }
+
+  uint8_t* buf = tx_buf(idx, n);
+  uint16_t const len = p_ncm->tx.len[n];
+  if (!p_ncm->is_ecm) {
+    ((nth16_t*) buf)->wBlockLength = len;
+  }
+
+  // short packet or ZLP terminates transfer, not needed if NTB has max size (NCM 1.0 3.8.2)
+  p_ncm->tx.zlp = (len % p_ncm->ep_out_mps == 0) && (p_ncm->is_ecm || len < p_ncm->tx_ntb_size);
+  p_ncm->tx.busy = true;
+  if (!usbh_edpt_xfer(p_ncm->daddr, p_ncm->ep_out, buf, len)) {
+    p_ncm->tx.busy = false;
+  }
+}
+
+static void tx_complete(ncmh_interface_t* p_ncm, uint8_t idx) {
+  if (p_ncm->tx.zlp) {
+    p_ncm->tx.zlp = false;
+    if (usbh_edpt_xfer(p_ncm->daddr, p_ncm->ep_out, NULL, 0)) {
+      return;
+    }
+  }
+
+  p_ncm->tx.busy = false;
+  p_ncm->tx.rd = (uint8_t) ((p_ncm->tx.rd + 1) % CFG_TUH_NCM_TX_NTB_N);
+  p_ncm->tx.count--;
+  p_ncm->stats.xmit_ntb++;
+
+  tx_start(p_ncm, idx);
+}
+
+bool tuh_network_can_xmit(uint8_t idx, uint16_t size) {
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_VERIFY(p_ncm && p_ncm->mounted);
+
+  uint16_t const max_size = p_ncm->is_ecm ? p_ncm->tx_ntb_size :
+                            (uint16_t) (p_ncm->tx_ntb_size - tx_datagram_offset(p_ncm, (uint16_t) (p_ncm->tx_ndp_index +
+                             sizeof(ndp16_t) + (p_ncm->tx_max_datagrams + 1) * sizeof(ndp16_datagram_t))));
+  TU_ASSERT(size <= max_size);
+
+  if (p_ncm->tx.count) {
+    uint8_t const last = (uint8_t) ((p_ncm->tx.rd + p_ncm->tx.count - 1) % CFG_TUH_NCM_TX_NTB_N);
+    if (p_ncm->tx.open && tx_fits(p_ncm, last, size)) {
+      return true;
+    }
+  }
+
+  if (p_ncm->tx.count < CFG_TUH_NCM_TX_NTB_N) {
+    // close current buffer (if any), it is sent when endpoint is idle
+    uint8_t const n = (uint8_t) ((p_ncm->tx.rd + p_ncm->tx.count) % CFG_TUH_NCM_TX_NTB_N);
+    p_ncm->tx.count++;
+    tx_open_ntb(p_ncm, idx, n);
+    return true;
+  }
+
+  tx_start(p_ncm, idx);
+  p_ncm->stats.xmit_blocked++;
+  return false;
+}
+
+void tuh_network_xmit(uint8_t idx, void* ref, uint16_t arg) {
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_VERIFY(p_ncm && p_ncm->mounted && p_ncm->tx.open && p_ncm->tx.count,);
+
+  uint8_t const n = (uint8_t) ((p_ncm->tx.rd + p_ncm->tx.count - 1) % CFG_TUH_NCM_TX_NTB_N);
+  uint8_t* buf = tx_buf(idx, n);
+
+  if (p_ncm->is_ecm) {
+    p_ncm->tx.len[n] = tuh_network_xmit_cb(idx, buf, ref, arg);
+    p_ncm->tx.datagram_ndx = 1;
+    p_ncm->tx.open = false;
+  } else {
+    uint16_t const offset = tx_datagram_offset(p_ncm, p_ncm->tx.len[n]);
+    tu_memclr(buf + p_ncm->tx.len[n], offset - p_ncm->tx.len[n]);
+    uint16_t const size = tuh_network_xmit_cb(idx, buf + offset, ref, arg);
+
+    ndp16_datagram_t* datagram = (ndp16_datagram_t*) (buf + p_ncm->tx_ndp_index + sizeof(ndp16_t));
+    datagram[p_ncm->tx.datagram_ndx].wDatagramIndex  = offset;
+    datagram[p_ncm->tx.datagram_ndx].wDatagramLength = size;
+    p_ncm->tx.datagram_ndx++;
+    p_ncm->tx.len[n] = (uint16_t) (offset + size);
+  }
+  p_ncm->stats.xmit_datagram++;
+
+  tx_start(p_ncm, idx);
+}
+
+//--------------------------------------------------------------------+
+// Notification
+//--------------------------------------------------------------------+
+
+static void notif_complete(ncmh_interface_t* p_ncm, uint8_t idx, uint32_t xferred_bytes) {
+  uint8_t const* buf = ncmh_epbuf[idx].notif;
+
+  if (xferred_bytes >= 8) {
+    tusb_control_request_t const* notif = (tusb_control_request_t const*) buf;
+    switch (notif->bRequest) {
+      case CDC_NOTIF_NETWORK_CONNECTION: {
+        bool const link_up = (tu_le16toh(notif->wValue) != 0);
+        TU_LOG_DRV("  NCM link %s\r\n", link_up ? "up" : "down");
+        if (link_up != p_ncm->link_up) {
+          p_ncm->link_up = link_up;
+          if (tuh_ncm_link_cb) {
+            tuh_ncm_link_cb(idx, link_up);
+          }
+        }
+        break;
+      }
+
+      case CDC_NOTIF_CONNECTION_SPEED_CHANGE:
+        if (xferred_bytes >= 16) {
+          TU_LOG_DRV("  NCM speed down = %lu, up = %lu\r\n", (unsigned long) tu_unaligned_read32(buf + 8),
+                     (unsigned long) tu_unaligned_read32(buf + 12));
+        }
+        break;
+
+      default: break;
+    }
+  }
+
+  usbh_edpt_xfer(p_ncm->daddr, p_ncm->ep_notif, ncmh_epbuf[idx].notif, NCMH_NOTIF_SIZE);
+}
+
+//--------------------------------------------------------------------+
+// CLASS-USBH API
+//--------------------------------------------------------------------+
+
+bool ncmh_init(void) {
+  TU_LOG_DRV("sizeof(ncmh_interface_t) = %u\r\n", sizeof(ncmh_interface_t));
+  tu_memclr(ncmh_data, sizeof(ncmh_data));
+  return true;
+}
+
+bool ncmh_deinit(void) {
+  return true;
+}
+
+void ncmh_close(uint8_t daddr) {
+  for (uint8_t idx = 0; idx < CFG_TUH_NCM; idx++) {
+    ncmh_interface_t* p_ncm = &ncmh_data[idx];
+    if (p_ncm->daddr == daddr) {
+      TU_LOG_DRV("  NCMh close addr = %u index = %u\r\n", daddr, idx);
+
+      if (p_ncm->mounted && tuh_ncm_umount_cb) {
+        tuh_ncm_umount_cb(idx);
+      }
+
+      tu_memclr(p_ncm, sizeof(ncmh_interface_t));
+    }
+  }
+}
+
+bool ncmh_xfer_cb(uint8_t daddr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes) {
+  uint8_t const idx = get_idx_by_ep_addr(daddr, ep_addr);
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_ASSERT(p_ncm);
+
+  if (event != XFER_RESULT_SUCCESS) {
+    // counted as lost NTB, transfer is not retried on stall
+    TU_LOG_DRV("  NCM xfer failed ep = 0x%02x\r\n", ep_addr);
+    xferred_bytes = 0;
+  }
+
+  if (ep_addr == p_ncm->ep_in) {
+    rx_complete(p_ncm, idx, xferred_bytes);
+    if (event == XFER_RESULT_STALLED) {
+      p_ncm->rx.busy = true; // stop receiving
+    }
+    rx_process(p_ncm, idx);
+  } else if (ep_addr == p_ncm->ep_out) {
+    if (event != XFER_RESULT_SUCCESS) {
+      p_ncm->tx.zlp = false;
+    }
+    tx_complete(p_ncm, idx);
+  } else if (ep_addr == p_ncm->ep_notif) {
+    if (event == XFER_RESULT_SUCCESS) {
+      notif_complete(p_ncm, idx, xferred_bytes);
+    }
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Enumeration
+//--------------------------------------------------------------------+
+
+bool ncmh_open(uint8_t rhport, uint8_t daddr, tusb_desc_interface_t const *itf_desc, uint16_t max_len) {
+  (void) rhport;
+
+  TU_VERIFY(TUSB_CLASS_CDC == itf_desc->bInterfaceClass &&
+            (CDC_COMM_SUBCLASS_NETWORK_CONTROL_MODEL == itf_desc->bInterfaceSubClass ||
+             CDC_COMM_SUBCLASS_ETHERNET_CONTROL_MODEL == itf_desc->bInterfaceSubClass));
+
+  ncmh_interface_t* p_ncm = NULL;
+  for (uint8_t idx = 0; idx < CFG_TUH_NCM; idx++) {
+    if (ncmh_data[idx].daddr == 0) {
+      p_ncm = &ncmh_data[idx];
+      break;
+    }
+  }
+  TU_VERIFY(p_ncm);
+
+  TU_LOG_DRV("NCM opening Interface %u (addr = %u)\r\n", itf_desc->bInterfaceNumber, daddr);
+  tu_memclr(p_ncm, sizeof(ncmh_interface_t));
+  p_ncm->daddr   = daddr;
+  p_ncm->itf_num = itf_desc->bInterfaceNumber;
+  p_ncm->is_ecm  = (CDC_COMM_SUBCLASS_ETHERNET_CONTROL_MODEL == itf_desc->bInterfaceSubClass);
+
+  uint8_t const* p_end  = ((uint8_t const*) itf_desc) + max_len;
+  uint8_t const* p_desc = tu_desc_next(itf_desc);
+  bool in_data_itf = false;
+
+  while (p_desc < p_end) {
+    switch (tu_desc_type(p_desc)) {
+      case TUSB_DESC_CS_INTERFACE:
+        // Ethernet Networking Functional Descriptor: iMACAddress
+        if (!in_data_itf && CDC_FUNC_DESC_ETHERNET_NETWORKING == p_desc[2] && tu_desc_len(p_desc) >= 13) {
+          p_ncm->mac_str_index = p_desc[3];
+        }
+        break;
+
+      case TUSB_DESC_INTERFACE: {
+        tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*) p_desc;
+        TU_ASSERT(TUSB_CLASS_CDC_DATA == desc_itf->bInterfaceClass);
+        in_data_itf = true;
+        p_ncm->itf_data = desc_itf->bInterfaceNumber;
+        if (desc_itf->bNumEndpoints) {
+          p_ncm->data_alt = desc_itf->bAlternateSetting;
+        }
+        break;
+      }
+
+      case TUSB_DESC_ENDPOINT: {
+        tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+        TU_ASSERT(tuh_edpt_open(daddr, desc_ep));
+
+        if (!in_data_itf) {
+          TU_ASSERT(TUSB_XFER_INTERRUPT == desc_ep->bmAttributes.xfer);
+          p_ncm->ep_notif = desc_ep->bEndpointAddress;
+        } else {
+          TU_ASSERT(TUSB_XFER_BULK == desc_ep->bmAttributes.xfer);
+          if (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN) {
+            p_ncm->ep_in = desc_ep->bEndpointAddress;
+          } else {
+            p_ncm->ep_out     = desc_ep->bEndpointAddress;
+            p_ncm->ep_out_mps = tu_edpt_packet_size(desc_ep);
+          }
+        }
+        break;
+      }
+
+      default: break;
+    }
+
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  TU_ASSERT(p_ncm->ep_in && p_ncm->ep_out && p_ncm->ep_out_mps);
+
+  // default NTB parameters, updated with GET_NTB_PARAMETERS
+  p_ncm->rx_ntb_size      = CFG_TUH_NCM_RX_NTB_SIZE;
+  p_ncm->tx_ntb_size      = CFG_TUH_NCM_TX_NTB_SIZE;
+  p_ncm->tx_divisor       = 4;
+  p_ncm->tx_remainder     = 0;
+  p_ncm->tx_ndp_index     = sizeof(nth16_t);
+  p_ncm->tx_max_datagrams = p_ncm->is_ecm ? 1 : CFG_TUH_NCM_TX_MAX_DATAGRAMS_PER_NTB;
+
+  return true;
+}
+
+// Class request to communication interface, continue config process with next stage
+static bool ncm_request(ncmh_interface_t* p_ncm, uint8_t idx, tusb_dir_t dir, uint8_t bRequest, uint16_t wValue,
+                        uint16_t wLength, uint8_t stage) {
+  tusb_control_request_t const request = {
+    .bmRequestType_bit = {
+      .recipient = TUSB_REQ_RCPT_INTERFACE,
+      .type      = TUSB_REQ_TYPE_CLASS,
+      .direction = dir
+    },
+    .bRequest = bRequest,
+    .wValue   = tu_htole16(wValue),
+    .wIndex   = tu_htole16((uint16_t) p_ncm->itf_num),
+    .wLength  = tu_htole16(wLength)
+  };
+
+  tuh_xfer_t xfer = {
+    .daddr       = p_ncm->daddr,
+    .ep_addr     = 0,
+    .setup       = &request,
+    .buffer      = wLength ? ncmh_epbuf[idx].ctrl : NULL,
+    .complete_cb = config_process,
+    .user_data   = ((uintptr_t) idx << 8) | stage
+  };
+
+  return tuh_control_xfer(&xfer);
+}
+
+static void parse_mac_string(ncmh_interface_t* p_ncm, uint8_t const* desc_str, uint32_t len) {
+  // 12 hex digits in UTF-16LE after 2-byte header
+  TU_VERIFY(len >= 2 + 24 && desc_str[0] >= 2 + 24,);
+
+  for (uint8_t i = 0; i < 12; i++) {
+    uint8_t const ch = desc_str[2 + 2 * i];
+    uint8_t nibble;
+    if (ch >= '0' && ch <= '9') {
+      nibble = (uint8_t) (ch - '0');
+    } else if (ch >= 'A' && ch <= 'F') {
+      nibble = (uint8_t) (ch - 'A' + 10);
+    } else if (ch >= 'a' && ch <= 'f') {
+      nibble = (uint8_t) (ch - 'a' + 10);
+    } else {
+      return;
+    }
+    p_ncm->mac[i / 2] = (uint8_t) ((i & 1) ? (p_ncm->mac[i / 2] | nibble) : (nibble << 4));
+  }
+
+  TU_LOG_DRV("  MAC %02X:%02X:%02X:%02X:%02X:%02X\r\n", p_ncm->mac[0], p_ncm->mac[1], p_ncm->mac[2],
+             p_ncm->mac[3], p_ncm->mac[4], p_ncm->mac[5]);
+}
+
+static void parse_ntb_parameters(ncmh_interface_t* p_ncm, ntb_parameters_t const* param) {
+  uint32_t const in_max  = tu_le32toh(param->dwNtbInMaxSize);
+  uint32_t const out_max = tu_le32toh(param->dwNtbOutMaxSize);
+  uint16_t const divisor = tu_le16toh(param->wNdbOutDivisor);
+  uint16_t const align   = tu_le16toh(param->wNdbOutAlignment);
+  uint16_t const max_datagrams = tu_le16toh(param->wNtbOutMaxDatagrams);
+
+  if (in_max) {
+    p_ncm->rx_ntb_size = (uint16_t) tu_min32(in_max, CFG_TUH_NCM_RX_NTB_SIZE);
+  }
+  if (out_max) {
+    p_ncm->tx_ntb_size = (uint16_t) tu_min32(out_max, CFG_TUH_NCM_TX_NTB_SIZE);
+  }
+  // divisor and alignment are power of 2, keep default for bogus value
+  if (divisor && divisor <= 512 && tu_le16toh(param->wNdbOutPayloadRemainder) < divisor) {
+    p_ncm->tx_divisor   = divisor;
+    p_ncm->tx_remainder = tu_le16toh(param->wNdbOutPayloadRemainder);
+  }
+  if (align > 4 && align <= 64) {
+    p_ncm->tx_ndp_index = (uint16_t) ((sizeof(nth16_t) + align - 1) & ~(align - 1u));
+  }
+  if (max_datagrams && max_datagrams < p_ncm->tx_max_datagrams) {
+    p_ncm->tx_max_datagrams = (uint8_t) max_datagrams;
+  }
+
+  TU_LOG_DRV("  NTB in = %u, out = %u, divisor = %u, max datagrams = %u\r\n", p_ncm->rx_ntb_size, p_ncm->tx_ntb_size,
+             p_ncm->tx_divisor, p_ncm->tx_max_datagrams);
+}
+
+static void config_complete(ncmh_interface_t* p_ncm, uint8_t idx, bool success) {
+  TU_LOG_DRV("NCMh Set Configure %s\r\n", success ? "complete" : "failed");
+
+  if (success) {
+    p_ncm->mounted = true;
+    if (p_ncm->ep_notif) {
+      usbh_edpt_xfer(p_ncm->daddr, p_ncm->ep_notif, ncmh_epbuf[idx].notif, NCMH_NOTIF_SIZE);
+    }
+    rx_start(p_ncm, idx);
+
+    if (tuh_ncm_mount_cb) {
+      tuh_ncm_mount_cb(idx);
+    }
+  }
+
+  // notify usbh that driver enumeration is complete, skip data interface
+  usbh_driver_set_config_complete(p_ncm->daddr, p_ncm->itf_data);
+}
+
+static void config_process(tuh_xfer_t* xfer) {
+  uint8_t const idx   = (uint8_t) (xfer->user_data >> 8);
+  uint8_t const stage = (uint8_t) (xfer->user_data & 0xFF);
+
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_VERIFY(p_ncm,);
+  bool const success = (xfer->result == XFER_RESULT_SUCCESS);
+  uint8_t* ctrl = ncmh_epbuf[idx].ctrl;
+
+  switch (stage) {
+    case CONFIG_GET_MAC_ADDRESS:
+      if (p_ncm->mac_str_index) {
+        TU_ASSERT(tuh_descriptor_get_string(p_ncm->daddr, p_ncm->mac_str_index, 0x0409, ctrl, NCMH_CTRL_SIZE,
+                                            config_process, ((uintptr_t) idx << 8) | CONFIG_GET_NTB_PARAMETERS),);
+        break;
+      }
+      TU_ATTR_FALLTHROUGH;
+
+    case CONFIG_GET_NTB_PARAMETERS:
+      if (success && p_ncm->mac_str_index) {
+        parse_mac_string(p_ncm, ctrl, xfer->actual_len);
+      }
+      if (!p_ncm->is_ecm) {
+        TU_ASSERT(ncm_request(p_ncm, idx, TUSB_DIR_IN, NCM_GET_NTB_PARAMETERS, 0, sizeof(ntb_parameters_t),
+                              CONFIG_SET_NTB_INPUT_SIZE),);
+        break;
+      }
+      TU_ATTR_FALLTHROUGH;
+
+    case CONFIG_SET_NTB_INPUT_SIZE:
+      if (!p_ncm->is_ecm) {
+        if (success) {
+          parse_ntb_parameters(p_ncm, (ntb_parameters_t const*) ctrl);
+        }
+        // limit NTB size of device to our receive buffer
+        tu_unaligned_write32(ctrl, tu_htole32(p_ncm->rx_ntb_size));
+        TU_ASSERT(ncm_request(p_ncm, idx, TUSB_DIR_OUT, NCM_SET_NTB_INPUT_SIZE, 0, 4, CONFIG_SET_PACKET_FILTER),);
+        break;
+      }
+      TU_ATTR_FALLTHROUGH;
+
+    case CONFIG_SET_PACKET_FILTER: {
+      // directed, broadcast and all multicast: optional request, result is ignored
+      uint16_t const filter = TU_BIT(1) | TU_BIT(2) | TU_BIT(3);
+      TU_ASSERT(ncm_request(p_ncm, idx, TUSB_DIR_OUT, CDC_REQUEST_SET_ETHERNET_PACKET_FILTER, filter, 0,
+                            CONFIG_SET_DATA_INTERFACE),);
+      break;
+    }
+
+    case CONFIG_SET_DATA_INTERFACE:
+      TU_ASSERT(tuh_interface_set(p_ncm->daddr, p_ncm->itf_data, p_ncm->data_alt, config_process,
+                                  ((uintptr_t) idx << 8) | CONFIG_COMPLETE),);
+      break;
+
+    case CONFIG_COMPLETE:
+      config_complete(p_ncm, idx, success);
+      break;
+
+    default: break;
+  }
+}
+
+bool ncmh_set_config(uint8_t daddr, uint8_t itf_num) {
+  uint8_t const idx = tuh_ncm_itf_get_index(daddr, itf_num);
+  ncmh_interface_t* p_ncm = get_itf(idx);
+  TU_ASSERT(p_ncm);
+
+  // fake transfer to kick-off process
+  tuh_xfer_t xfer;
+  xfer.daddr      = daddr;
+  xfer.result     = XFER_RESULT_SUCCESS;
+  xfer.actual_len = 0;
+  xfer.user_data  = ((uintptr_t) idx << 8) | CONFIG_GET_MAC_ADDRESS;
+  config_process(&xfer);
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_NCM_HOST_H_
+#define _TUSB_NCM_HOST_H_
+
+#include "class/cdc/cdc.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+
+// Size of each receive buffer: max NTB size requested from NCM device with SET_NTB_INPUT_SIZE,
+// or max Ethernet frame for ECM device. NCM requires at least 2048
+#ifndef CFG_TUH_NCM_RX_NTB_SIZE
+#define CFG_TUH_NCM_RX_NTB_SIZE   3200
+#endif
+
+// Number of receive buffers, IN endpoint is kept armed while one is processed by application
+#ifndef CFG_TUH_NCM_RX_NTB_N
+#define CFG_TUH_NCM_RX_NTB_N      2
+#endif
+
+// Size of each transmit buffer (limited by dwNtbOutMaxSize of NCM device), must hold at least one frame
+#ifndef CFG_TUH_NCM_TX_NTB_SIZE
+#define CFG_TUH_NCM_TX_NTB_SIZE   3200
+#endif
+
+// Number of transmit buffers, datagrams are aggregated into a buffer while the previous one is sent
+#ifndef CFG_TUH_NCM_TX_NTB_N
+#define CFG_TUH_NCM_TX_NTB_N      2
+#endif
+
+// Max datagrams put into a transmit NTB (also limited by wNtbOutMaxDatagrams of NCM device)
+#ifndef CFG_TUH_NCM_TX_MAX_DATAGRAMS_PER_NTB
+#define CFG_TUH_NCM_TX_MAX_DATAGRAMS_PER_NTB 8
+#endif
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+
+typedef struct {
+  uint32_t xmit_ntb;         // NTBs (frames for ECM) sent to device
+  uint32_t xmit_datagram;    // datagrams sent to device
+  uint32_t xmit_blocked;     // tuh_network_can_xmit() refused, no free buffer
+  uint32_t recv_ntb;         // valid NTBs (frames for ECM) received from device
+  uint32_t recv_datagram;    // datagrams passed to tuh_network_recv_cb()
+  uint32_t recv_invalid;     // NTBs received from device and dropped by validation
+} tuh_ncm_stats_t;
+
+// Get Interface index from device address + interface number (Communication interface)
+// return TUSB_INDEX_INVALID_8 (0xFF) if not found
+uint8_t tuh_ncm_itf_get_index(uint8_t daddr, uint8_t itf_num);
+
+// Check if a interface is mounted
+bool tuh_ncm_mounted(uint8_t idx);
+
+// Check if interface is an ECM device (one frame per transfer) instead of NCM
+bool tuh_ncm_is_ecm(uint8_t idx);
+
+// Get MAC address of the device as reported by iMACAddress string
+bool tuh_ncm_get_mac_addr(uint8_t idx, uint8_t mac[6]);
+
+// Network connection state reported by device with notification, false until the first notification
+bool tuh_ncm_link_up(uint8_t idx);
+
+// Get driver statistics, optionally clear them afterwards
+bool tuh_ncm_get_stats(uint8_t idx, tuh_ncm_stats_t* stats, bool reset);
+
+//--------------------------------------------------------------------+
+// Network glue API, same contract as tud_network_*() of device networking drivers
+//--------------------------------------------------------------------+
+
+// indicate to network driver that client has finished with the datagram provided to tuh_network_recv_cb(),
+// datagram is valid until then
+void tuh_network_recv_renew(uint8_t idx);
+
+// poll network driver for its ability to accept another datagram to transmit
+bool tuh_network_can_xmit(uint8_t idx, uint16_t size);
+
+// if tuh_network_can_xmit() returns true, tuh_network_xmit() can be called once
+void tuh_network_xmit(uint8_t idx, void* ref, uint16_t arg);
+
+// client must provide this: return false if the datagram was not accepted, tuh_network_recv_renew() must be called
+// later to get it again
+bool tuh_network_recv_cb(uint8_t idx, const uint8_t* src, uint16_t size);
+
+// client must provide this: copy from network stack packet pointer to dst, return number of copied bytes
+uint16_t tuh_network_xmit_cb(uint8_t idx, uint8_t* dst, void* ref, uint16_t arg);
+
+//--------------------------------------------------------------------+
+// NCM APPLICATION CALLBACKS
+//--------------------------------------------------------------------+
+
+// Invoked when a network device is mounted (data interface is active)
+TU_ATTR_WEAK extern void tuh_ncm_mount_cb(uint8_t idx);
+
+// Invoked when a network device is unmounted
+TU_ATTR_WEAK extern void tuh_ncm_umount_cb(uint8_t idx);
+
+// Invoked when device reports a change of network connection
+TU_ATTR_WEAK extern void tuh_ncm_link_cb(uint8_t idx, bool link_up);
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+bool ncmh_init       (void);
+bool ncmh_deinit     (void);
+bool ncmh_open       (uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t max_len);
+bool ncmh_set_config (uint8_t dev_addr, uint8_t itf_num);
+bool ncmh_xfer_cb    (uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void ncmh_close      (uint8_t dev_addr);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_NCM_HOST_H_ */
@@ -38,11 +38,37 @@
 /* declared here, NOT in usb_descriptors.c, so that the driver can intelligently ZLP as needed */
 #define CFG_TUD_NET_ENDPOINT_SIZE (TUD_OPT_HIGH_SPEED ? 512 : 64)
 
-/* Maximum Transmission Unit (in bytes) of the network, including Ethernet header */
+/* Maximum Transmission Unit (in bytes) of the network, including Ethernet header. Should also be used as
+   wMaxSegmentSize of the ECM/NCM descriptor, host takes its MTU from there. Point-to-point USB link is not limited
+   to Ethernet frame size: jumbo frames e.g 9014 cut per packet overhead (Linux cdc_ncm accepts up to 8192).
+   NCM transfer block sizes must be raised accordingly */
 #ifndef CFG_TUD_NET_MTU
 #define CFG_TUD_NET_MTU           1514
 #endif
 
+/* ECM/RNDIS: number of packet buffers for reception. With more than one, the OUT endpoint is re-armed while the
+   application still holds the previous packet, received packets are passed to tud_network_recv_cb() in order */
+#ifndef CFG_TUD_ECM_RNDIS_OUT_PACKET_N
+#define CFG_TUD_ECM_RNDIS_OUT_PACKET_N 1
+#endif
+
+/* ECM/RNDIS: number of packet buffers for transmission, tud_network_can_xmit() accepts a packet while one is free */
+#ifndef CFG_TUD_ECM_RNDIS_IN_PACKET_N
+#define CFG_TUD_ECM_RNDIS_IN_PACKET_N  1
+#endif
+
+/* RNDIS: maximum number of REMOTE_NDIS_PACKET_MSG aggregated in one bulk transfer in both directions, each packet
+   buffer is enlarged to hold as many full sized messages. 1 to disable aggregation */
+#ifndef CFG_TUD_RNDIS_PACKETS_PER_TRANSFER
+#define CFG_TUD_RNDIS_PACKETS_PER_TRANSFER 1
+#endif
+
+/* RNDIS: a partially aggregated transfer is held back for up to this time while IN endpoint is idle, waiting for
+   more packets. 0 to send immediately. Packets queued while IN endpoint is busy are always aggregated */
+#ifndef CFG_TUD_RNDIS_IN_FLUSH_TIMEOUT_US
+#define CFG_TUD_RNDIS_IN_FLUSH_TIMEOUT_US  0
+#endif
+
 
 // Table 4.3 Data Class Interface Protocol Codes
 typedef enum
@@ -78,6 +104,47 @@ bool tud_network_recv_cb(const uint8_t *src, uint16_t size);
 // client must provide this: copy from network stack packet pointer to dst
 uint16_t tud_network_xmit_cb(uint8_t *dst, void *ref, uint16_t arg);
 
+//------------- NCM -------------//
+
+typedef struct {
+  uint32_t xmit_ntb;              // NTBs sent to host
+  uint32_t xmit_datagram;         // datagrams sent to host
+  uint32_t xmit_flush_full;       // NTBs sent because next datagram did not fit
+  uint32_t xmit_flush_idle;       // partial NTBs sent immediately since hold-off is disabled or host is waiting
+  uint32_t xmit_flush_threshold;  // held NTBs sent because flush threshold is reached
+  uint32_t xmit_flush_timeout;    // held NTBs sent because hold-off time expired
+  uint32_t xmit_blocked;          // tud_network_can_xmit() refused, no free NTB
+  uint32_t recv_ntb;              // valid NTBs received from host
+  uint32_t recv_invalid;          // NTBs received from host and dropped by validation
+} tud_network_ncm_stats_t;
+
+// Configure transmission packing: a partially filled NTB is held back for up to timeout_us (0 = send
+// immediately) while IN endpoint is idle, unless it already reaches threshold bytes (0 = no threshold).
+void tud_network_ncm_flush_config(uint32_t timeout_us, uint16_t threshold);
+
+// Get driver statistics, optionally clear them afterwards
+void tud_network_ncm_stats(tud_network_ncm_stats_t* stats, bool reset);
+
+// Scatter-gather list element of a datagram for tud_network_xmit_sg()
+typedef struct {
+  const void *base;
+  uint16_t len;
+} tud_network_iovec_t;
+
+// Scatter-gather variant of tud_network_xmit(), allowed once if tud_network_can_xmit() returns true for the
+// total length. Parts of the buffers at packet size boundaries are sent in place, the rest is copied into the NTB.
+// Buffers must be kept valid until tud_network_xmit_sg_done_cb(ref) is invoked. Requires CFG_TUD_NCM_IN_SG_N
+void tud_network_xmit_sg(const tud_network_iovec_t *iov, uint8_t count, void *ref);
+
+// Invoked when buffers passed to tud_network_xmit_sg() are not used anymore (WEAK is optional)
+TU_ATTR_WEAK void tud_network_xmit_sg_done_cb(void *ref);
+
+// Zero-copy receive: called within tud_network_recv_cb() to keep the datagram (src) valid after
+// tud_network_recv_renew(), e.g to wrap it into a PBUF_REF pbuf. Returns false if the datagram has to be
+// copied (last free receive NTB). Must be released with tud_network_recv_unref() from tud_task() context.
+bool tud_network_recv_ref(const uint8_t *datagram);
+void tud_network_recv_unref(const uint8_t *datagram);
+
 //------------- ECM/RNDIS -------------//
 
 // client must provide this: initialize any network state back to the beginning
@@ -97,6 +164,7 @@ uint16_t netd_open            (uint8_t rhport, tusb_desc_interface_t const * itf
 bool     netd_control_xfer_cb (uint8_t rhport, uint8_t stage, tusb_control_request_t const * request);
 bool     netd_xfer_cb         (uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
 void     netd_report          (uint8_t *buf, uint16_t len);
+void     netd_sof             (uint8_t rhport, uint32_t frame_count);
 
 #ifdef __cplusplus
  }
@@ -91,6 +91,20 @@ tu_static char logMsg[150];
 #define CFG_TUD_USBTMC_INT_EP_SIZE 2
 #endif
 
+// Send the bulk IN data directly from the application buffer instead of copying it packet by packet into the
+// endpoint buffer. Only the first packet, which carries the message header, is copied. Application buffers must then
+// satisfy the controller DMA requirements (CFG_TUD_MEM_SECTION, CFG_TUD_MEM_ALIGN).
+#ifndef CFG_TUD_USBTMC_TX_ZERO_COPY
+#define CFG_TUD_USBTMC_TX_ZERO_COPY 0
+#endif
+
+// Largest bulk IN transfer queued at once after the header packet, must be a multiple of the max packet size
+#if CFG_TUD_USBTMC_TX_ZERO_COPY
+#define USBTMCD_TX_XFER_MAX ((UINT16_MAX / USBTMCD_BUFFER_SIZE) * USBTMCD_BUFFER_SIZE)
+#else
+#define USBTMCD_TX_XFER_MAX USBTMCD_BUFFER_SIZE
+#endif
+
 /*
  * The state machine does not allow simultaneous reading and writing. This is
  * consistent with USBTMC.
@@ -104,6 +118,7 @@ typedef enum
   STATE_RCV,     // Bulk-out is receiving DEV_DEP message
   STATE_TX_REQUESTED,
   STATE_TX_INITIATED,
+  STATE_TX_WAIT_DATA, // application buffer is sent, waiting for the rest of the message (TransferSize)
   STATE_TX_SHORTED,
   STATE_CLEARING,
   STATE_ABORTING_BULK_IN,
@@ -133,6 +148,7 @@ typedef struct
   uint32_t ep_bulk_out_wMaxPacketSize;
   uint32_t transfer_size_remaining; // also used for requested length for bulk IN.
   uint32_t transfer_size_sent;      // To keep track of data bytes that have been queued in FIFO (not header bytes)
+  uint32_t transfer_size_pending;   // bulk IN bytes of TransferSize not yet supplied by the application
 
   uint8_t lastBulkOutTag; // used for aborts (mostly)
   uint8_t lastBulkInTag; // used for aborts (mostly)
@@ -171,14 +187,12 @@ tu_static uint8_t termChar;
 
 tu_static uint8_t termCharRequested = false;
 
-#if OSAL_MUTEX_REQUIRED
-static OSAL_MUTEX_DEF(usbtmcLockBuffer);
-#endif
-osal_mutex_t usbtmcLock;
+// Our own private lock, mostly for the state variable. Only held for a few instructions, a spinlock is much cheaper
+// than a mutex for every bulk message and never blocks the usbd task.
+static OSAL_SPINLOCK_DEF(usbtmcLock, usbd_int_set);
 
-// Our own private lock, mostly for the state variable.
-#define criticalEnter() do { (void) osal_mutex_lock(usbtmcLock,OSAL_TIMEOUT_WAIT_FOREVER); } while (0)
-#define criticalLeave() do { (void) osal_mutex_unlock(usbtmcLock); } while (0)
+#define criticalEnter() osal_spin_lock(&usbtmcLock, false)
+#define criticalLeave() osal_spin_unlock(&usbtmcLock, false)
 
 static bool atomicChangeState(usbtmcd_state_enum expectedState, usbtmcd_state_enum newState)
 {
@@ -197,6 +211,41 @@ static bool atomicChangeState(usbtmcd_state_enum expectedState, usbtmcd_state_en
   return ret;
 }
 
+// Queue next bulk IN transfer from application buffer, after the header packet has been sent
+static bool bulkIn_queue_next(uint8_t rhport)
+{
+  uint32_t const xferLen = tu_min32(usbtmc_state.transfer_size_remaining, USBTMCD_TX_XFER_MAX);
+  uint8_t *buf = usbtmc_epbuf.epin;
+
+  if (xferLen > 0u)
+  {
+#if CFG_TUD_USBTMC_TX_ZERO_COPY
+    buf = (uint8_t*)(uintptr_t) usbtmc_state.devInBuffer;
+#else
+    // Copy buffer to ensure alignment correctness
+    memcpy(buf, usbtmc_state.devInBuffer, xferLen);
+#endif
+  }
+
+  usbtmc_state.devInBuffer += xferLen;
+  usbtmc_state.transfer_size_remaining -= xferLen;
+  usbtmc_state.transfer_size_sent += xferLen;
+
+  if (usbtmc_state.transfer_size_remaining == 0u)
+  {
+    usbtmc_state.devInBuffer = NULL;
+    // last transfer of the message: short packet (or ZLP) ends it
+    if ((usbtmc_state.transfer_size_pending == 0u) &&
+        (((xferLen % usbtmc_state.ep_bulk_in_wMaxPacketSize) != 0u) || (xferLen == 0u)))
+    {
+      usbtmc_state.state = STATE_TX_SHORTED;
+    }
+  }
+
+  TU_VERIFY(usbd_edpt_xfer(rhport, usbtmc_state.ep_bulk_in, buf, (uint16_t) xferLen));
+  return true;
+}
+
 // called from app
 // We keep a reference to the buffer, so it MUST not change until the app is
 // notified that the transfer is complete.
@@ -208,20 +257,35 @@ bool tud_usbtmc_transmit_dev_msg_data(
     const void * data, size_t len,
     bool endOfMessage,
     bool usingTermChar)
+{
+  return tud_usbtmc_transmit_dev_msg_data_partial(data, len, len, endOfMessage, usingTermChar);
+}
+
+bool tud_usbtmc_transmit_dev_msg_data_partial(
+    const void * data, size_t len, size_t totalLen,
+    bool endOfMessage,
+    bool usingTermChar)
 {
   const unsigned int txBufLen = USBTMCD_BUFFER_SIZE;
+  const size_t headerLen = sizeof(usbtmc_msg_dev_dep_msg_in_header_t);
 
 #ifndef NDEBUG
   TU_ASSERT(len > 0u);
-  TU_ASSERT(len <= usbtmc_state.transfer_size_remaining);
+  TU_ASSERT(totalLen <= usbtmc_state.transfer_size_remaining);
   TU_ASSERT(usbtmc_state.transfer_size_sent == 0u);
-  if(usingTermChar)
+  if(usingTermChar && (len == totalLen))
   {
     TU_ASSERT(usbtmc_state.capabilities->bmDevCapabilities.canEndBulkInOnTermChar);
     TU_ASSERT(termCharRequested);
     TU_ASSERT(((uint8_t const*)data)[len-1u] == termChar);
   }
 #endif
+  TU_ASSERT(len <= totalLen);
+  // rest of the message is sent without header, data so far must end on a packet boundary
+  if (len < totalLen)
+  {
+    TU_ASSERT(((headerLen + len) % usbtmc_state.ep_bulk_in_wMaxPacketSize) == 0u);
+  }
 
   TU_VERIFY(usbtmc_state.state == STATE_TX_REQUESTED);
   usbtmc_msg_dev_dep_msg_in_header_t *hdr = (usbtmc_msg_dev_dep_msg_in_header_t*)usbtmc_epbuf.epin;
@@ -229,28 +293,46 @@ bool tud_usbtmc_transmit_dev_msg_data(
   hdr->header.MsgID = USBTMC_MSGID_DEV_DEP_MSG_IN;
   hdr->header.bTag = usbtmc_state.lastBulkInTag;
   hdr->header.bTagInverse = (uint8_t)~(usbtmc_state.lastBulkInTag);
-  hdr->TransferSize = len;
+  hdr->TransferSize = totalLen;
   hdr->bmTransferAttributes.EOM = endOfMessage;
   hdr->bmTransferAttributes.UsingTermChar = usingTermChar;
 
   // Copy in the header
-  const size_t headerLen = sizeof(*hdr);
-  const size_t dataLen = ((headerLen + hdr->TransferSize) <= txBufLen) ?
-                            len : (txBufLen - headerLen);
+  const size_t dataLen = ((headerLen + len) <= txBufLen) ? len : (txBufLen - headerLen);
   const size_t packetLen = headerLen + dataLen;
 
   memcpy((uint8_t*)(usbtmc_epbuf.epin) + headerLen, data, dataLen);
   usbtmc_state.transfer_size_remaining = len - dataLen;
   usbtmc_state.transfer_size_sent = dataLen;
+  usbtmc_state.transfer_size_pending = totalLen - len;
   usbtmc_state.devInBuffer = (uint8_t const*) data + (dataLen);
 
-  bool stateChanged =
-      atomicChangeState(STATE_TX_REQUESTED, (packetLen >= txBufLen) ? STATE_TX_INITIATED : STATE_TX_SHORTED);
+  bool const shorted = (packetLen < txBufLen) && (usbtmc_state.transfer_size_pending == 0u);
+  bool stateChanged = atomicChangeState(STATE_TX_REQUESTED, shorted ? STATE_TX_SHORTED : STATE_TX_INITIATED);
   TU_VERIFY(stateChanged);
   TU_VERIFY(usbd_edpt_xfer(usbtmc_state.rhport, usbtmc_state.ep_bulk_in, usbtmc_epbuf.epin, (uint16_t)packetLen));
   return true;
 }
 
+bool tud_usbtmc_transmit_dev_msg_data_more(const void * data, size_t len)
+{
+  TU_ASSERT(len > 0u);
+  TU_ASSERT(len <= usbtmc_state.transfer_size_pending);
+  if (len < usbtmc_state.transfer_size_pending)
+  {
+    TU_ASSERT((len % usbtmc_state.ep_bulk_in_wMaxPacketSize) == 0u);
+  }
+
+  // Fail if previous data is still being sent or the transfer has been aborted
+  TU_VERIFY(atomicChangeState(STATE_TX_WAIT_DATA, STATE_TX_INITIATED));
+
+  usbtmc_state.devInBuffer = (uint8_t const*) data;
+  usbtmc_state.transfer_size_remaining = len;
+  usbtmc_state.transfer_size_pending -= len;
+
+  return bulkIn_queue_next(usbtmc_state.rhport);
+}
+
 bool tud_usbtmc_transmit_notification_data(const void * data, size_t len)
 {
 #ifndef NDEBUG
@@ -281,13 +363,10 @@ void usbtmcd_init_cb(void)
   }
 #endif
 
-  usbtmcLock = osal_mutex_create(&usbtmcLockBuffer);
+  osal_spin_init(&usbtmcLock);
 }
 
 bool usbtmcd_deinit(void) {
-  #if OSAL_MUTEX_REQUIRED
-  osal_mutex_delete(usbtmcLock);
-  #endif
   return true;
 }
 
@@ -553,6 +632,7 @@ bool usbtmcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint
 
     case STATE_TX_REQUESTED:
     case STATE_TX_INITIATED:
+    case STATE_TX_WAIT_DATA:
     case STATE_ABORTING_BULK_IN:
     case STATE_ABORTING_BULK_IN_SHORTED:
     case STATE_ABORTING_BULK_IN_ABORTED:
@@ -569,28 +649,17 @@ bool usbtmcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint
       break;
 
     case STATE_TX_INITIATED:
-      if(usbtmc_state.transfer_size_remaining >= USBTMCD_BUFFER_SIZE)
+      if((usbtmc_state.transfer_size_remaining == 0u) && (usbtmc_state.transfer_size_pending > 0u))
       {
-        // Copy buffer to ensure alignment correctness
-        memcpy(usbtmc_epbuf.epin, usbtmc_state.devInBuffer, USBTMCD_BUFFER_SIZE);
-        TU_VERIFY(usbd_edpt_xfer(rhport, usbtmc_state.ep_bulk_in, usbtmc_epbuf.epin, USBTMCD_BUFFER_SIZE));
-        usbtmc_state.devInBuffer += USBTMCD_BUFFER_SIZE;
-        usbtmc_state.transfer_size_remaining -= USBTMCD_BUFFER_SIZE;
-        usbtmc_state.transfer_size_sent += USBTMCD_BUFFER_SIZE;
-      }
-      else // last packet
-      {
-        size_t packetLen = usbtmc_state.transfer_size_remaining;
-        memcpy(usbtmc_epbuf.epin, usbtmc_state.devInBuffer, usbtmc_state.transfer_size_remaining);
-          usbtmc_state.transfer_size_sent += sizeof(usbtmc_state.transfer_size_remaining);
-        usbtmc_state.transfer_size_remaining = 0;
-        usbtmc_state.devInBuffer = NULL;
-        TU_VERIFY( usbd_edpt_xfer(rhport, usbtmc_state.ep_bulk_in, usbtmc_epbuf.epin, (uint16_t)packetLen) );
-        if(((packetLen % usbtmc_state.ep_bulk_in_wMaxPacketSize) != 0) || (packetLen == 0 ))
+        // Application buffer is sent, wait for it to supply the rest of the message
+        TU_VERIFY(atomicChangeState(STATE_TX_INITIATED, STATE_TX_WAIT_DATA));
+        if (tud_usbtmc_msgBulkIn_more_cb)
         {
-          usbtmc_state.state = STATE_TX_SHORTED;
+          tud_usbtmc_msgBulkIn_more_cb(usbtmc_state.transfer_size_pending);
         }
+        return true;
       }
+      TU_VERIFY(bulkIn_queue_next(rhport));
       return true;
 
     case STATE_ABORTING_BULK_IN:
@@ -734,25 +803,28 @@ bool usbtmcd_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request
     TU_VERIFY(request->wLength == sizeof(rsp));
     TU_VERIFY(request->wIndex == usbtmc_state.ep_bulk_in);
     // wValue is the requested bTag to abort
-    if((usbtmc_state.state == STATE_TX_REQUESTED || usbtmc_state.state == STATE_TX_INITIATED) &&
-        usbtmc_state.lastBulkInTag == (request->wValue & 0x7Fu))
+    usbtmcd_state_enum const oldState = usbtmc_state.state;
+    bool const txInProgress = (oldState == STATE_TX_REQUESTED || oldState == STATE_TX_INITIATED ||
+                               oldState == STATE_TX_WAIT_DATA);
+    if(txInProgress && usbtmc_state.lastBulkInTag == (request->wValue & 0x7Fu))
     {
       rsp.USBTMC_status = USBTMC_STATUS_SUCCESS;
     usbtmc_state.transfer_size_remaining = 0u;
+    usbtmc_state.transfer_size_pending = 0u;
       // Check if we've queued a short packet
       criticalEnter();
       usbtmc_state.state = ((usbtmc_state.transfer_size_sent % usbtmc_state.ep_bulk_in_wMaxPacketSize) == 0) ?
               STATE_ABORTING_BULK_IN : STATE_ABORTING_BULK_IN_SHORTED;
       criticalLeave();
-      if(usbtmc_state.transfer_size_sent  == 0)
+      if((usbtmc_state.transfer_size_sent  == 0) || (oldState == STATE_TX_WAIT_DATA))
       {
-        // Send short packet, nothing is in the buffer yet
+        // Send short packet, nothing is in the buffer yet (or waiting for app data, no transfer in progress)
         TU_VERIFY( usbd_edpt_xfer(rhport, usbtmc_state.ep_bulk_in, usbtmc_epbuf.epin,(uint16_t)0u));
         usbtmc_state.state = STATE_ABORTING_BULK_IN_SHORTED;
       }
       TU_VERIFY(tud_usbtmc_initiate_abort_bulk_in_cb(&(rsp.USBTMC_status)));
     }
-    else if((usbtmc_state.state == STATE_TX_REQUESTED || usbtmc_state.state == STATE_TX_INITIATED))
+    else if(txInProgress)
     { // FIXME: Unsure how to check  if the OUT endpoint fifo is non-empty....
       rsp.USBTMC_status = USBTMC_STATUS_TRANSFER_NOT_IN_PROGRESS;
     }
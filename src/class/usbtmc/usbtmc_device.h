@@ -63,6 +63,9 @@ void tud_usbtmc_bulkOut_clearFeature_cb(void); // Notice to clear and abort the
 
 bool tud_usbtmc_msgBulkIn_request_cb(usbtmc_msg_request_dev_dep_in const * request);
 bool tud_usbtmc_msgBulkIn_complete_cb(void);
+// Data passed to tud_usbtmc_transmit_dev_msg_data_partial/more() has been sent, the buffer may be reused. Call
+// tud_usbtmc_transmit_dev_msg_data_more() to supply the next pending bytes of the message.
+TU_ATTR_WEAK void tud_usbtmc_msgBulkIn_more_cb(size_t pending);
 void tud_usbtmc_bulkIn_clearFeature_cb(void); // Notice to clear and abort the pending BULK out transfer
 
 bool tud_usbtmc_initiate_abort_bulk_in_cb(uint8_t *tmcResult);
@@ -94,6 +97,16 @@ bool tud_usbtmc_transmit_dev_msg_data(
     const void * data, size_t len,
     bool endOfMessage, bool usingTermChar);
 
+// Same as above, but only the first len bytes of a totalLen bytes message (TransferSize) are available now, which
+// allows large responses to be produced incrementally. The rest is supplied with tud_usbtmc_transmit_dev_msg_data_more()
+// in tud_usbtmc_msgBulkIn_more_cb(). Every chunk but the last must end on a packet boundary i.e
+// (header + len) for this first chunk and len for the following ones are multiple of bulk IN max packet size.
+bool tud_usbtmc_transmit_dev_msg_data_partial(
+    const void * data, size_t len, size_t totalLen,
+    bool endOfMessage, bool usingTermChar);
+
+bool tud_usbtmc_transmit_dev_msg_data_more(const void * data, size_t len);
+
 // Buffers a notification to be sent to the host. The data starts
 // with the bNotify1 field, see the USBTMC Specification, Table 13.
 //
@@ -48,6 +48,13 @@
 #define VS_STATE_COMMITTED    1     /* Ready for streaming or Streaming via bulk endpoint */
 #define VS_STATE_STREAMING    2     /* Streaming via isochronous endpoint */
 
+#define VS_SLICE_NONE         0     /* No frame is produced by slices */
+#define VS_SLICE_OPEN         1     /* Frame is begun, slices are appended */
+#define VS_SLICE_END          2     /* Frame is ended, remaining data to be sent */
+#define VS_SLICE_LAST         3     /* Last payload of the frame is submitted */
+
+#define VS_CLOCK_FREQUENCY    27000000u /* dwClockFrequency, same as MPEG-2 system time clock */
+
 typedef struct {
   tusb_desc_interface_t            std;
   tusb_desc_video_control_header_t ctl;
@@ -108,10 +115,25 @@ typedef struct TU_ATTR_PACKED {
     uint16_t cur;    /* Offset of the current settings */
     uint16_t ep[2];  /* Offset of endpoint descriptors. 0: streaming, 1: still capture */
   } desc;
+  struct {
+    uint16_t fmt[CFG_TUD_VIDEO_STREAMING_FORMAT_MAX];     /* Offset of format descriptor bFormatIndex - 1, 0 if not indexed */
+    uint16_t frm[CFG_TUD_VIDEO_STREAMING_FRAME_MAX];      /* Offset of frame descriptors, frame_base[] + bFrameIndex - 1 */
+    uint8_t  frm_base[CFG_TUD_VIDEO_STREAMING_FORMAT_MAX]; /* Index in frm[] of first frame of the format */
+  } index;
   uint8_t *buffer;   /* frame buffer. assume linear buffer. no support for stride access */
   uint32_t bufsize;  /* frame buffer size */
   uint32_t offset;   /* offset for the next payload transfer */
   uint32_t max_payload_transfer_size;
+  uint32_t xfer_max; /* max bytes per transfer of a frame */
+  uint32_t payload_rem; /* bytes left of the payload being sent, 0: next transfer begins a payload */
+  tusb_video_payload_header_t hdr; /* header of the next payload */
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+  uint32_t pts;      /* presentation time of the current frame */
+#endif
+  uint8_t  bulk;     /* 1: streaming via bulk endpoint */
+  uint8_t  inplace;  /* 1: payload headers are reserved in frame buffer, no copy to endpoint buffer */
+  uint8_t  slice_state; /* VS_SLICE_xxx, frame produced by tud_video_n_frame_begin/append/end */
+  uint16_t slice_fill;  /* bytes of the payload in endpoint buffer including header */
   uint8_t  error_code;/* error code */
   uint8_t  state;    /* 0:probing 1:committed 2:streaming */
 
@@ -122,6 +144,31 @@ typedef struct {
   TUD_EPBUF_DEF(buf, CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE);
 } videod_streaming_epbuf_t;
 
+#if CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE
+// queue level is reported in uint8_t count/count_max
+TU_VERIFY_STATIC(CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE <= UINT8_MAX, "Video frame queue depth must not exceed 255");
+
+typedef struct {
+  uint8_t *buffer;
+  uint32_t bufsize;
+  uint8_t  inplace;
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+  uint32_t pts;
+#endif
+} videod_frame_entry_t;
+#endif
+
+/* frame queue of streaming interface, kept across bus reset */
+typedef struct {
+  uint8_t  policy;    /* tud_video_frame_queue_policy_t */
+  uint8_t  count_max; /* high-water of queued frames */
+  uint32_t dropped;   /* number of frames dropped by policy */
+#if CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE
+  tu_fifo_t ff;
+  videod_frame_entry_t ff_buf[CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE];
+#endif
+} videod_frame_queue_t;
+
 /* video control interface */
 typedef struct TU_ATTR_PACKED {
   const uint8_t*beg;                     /* The head of the first video control interface descriptor */
@@ -139,6 +186,16 @@ static videod_interface_t _videod_itf[CFG_TUD_VIDEO];
 
 static videod_streaming_interface_t _videod_streaming_itf[CFG_TUD_VIDEO_STREAMING];
 CFG_TUD_MEM_SECTION static videod_streaming_epbuf_t _videod_streaming_epbuf[CFG_TUD_VIDEO_STREAMING];
+static videod_frame_queue_t _videod_frame_queue[CFG_TUD_VIDEO_STREAMING];
+
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+/* source time clock latched with SOF counter on every SOF */
+static volatile struct {
+  uint32_t stc;
+  uint16_t sof;   /* 11-bit SOF counter */
+  uint8_t  count; /* incremented on every SOF, to read stc and sof consistently */
+} _videod_scr;
+#endif
 
 static uint8_t const _cap_get     = 0x1u; /* support for GET */
 static uint8_t const _cap_get_set = 0x3u; /* support for GET and SET */
@@ -225,9 +282,24 @@ static videod_streaming_interface_t* _get_instance_streaming(uint_fast8_t ctl_id
   if (!ctl->beg) return NULL;
   videod_streaming_interface_t *stm = &_videod_streaming_itf[ctl->stm[stm_idx]];
   if (!stm->desc.beg) return NULL;
+  /* unused entries of stm[] are 0, do not alias the streaming interface of another control */
+  if (stm->index_vc != ctl_idx || stm->index_vs != stm_idx) return NULL;
   return stm;
 }
 
+static videod_frame_queue_t* _get_frame_queue(videod_streaming_interface_t const *stm) {
+  return &_videod_frame_queue[stm - _videod_streaming_itf];
+}
+
+/** Discard queued frames, e.g when streaming parameters are changed */
+static void _frame_queue_clear(videod_streaming_interface_t const *stm) {
+#if CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE
+  tu_fifo_clear(&_get_frame_queue(stm)->ff);
+#else
+  (void) stm;
+#endif
+}
+
 static tusb_desc_vc_itf_t const* _get_desc_vc(videod_interface_t const *self) {
   return (tusb_desc_vc_itf_t const *)(self->beg + self->cur);
 }
@@ -422,6 +494,96 @@ static inline void const *_find_desc_frame(void const *beg, void const *end, uin
   return end;
 }
 
+/** Index format and frame descriptors of the streaming interface so that
+ *  probe and commit requests do not walk the descriptors each time. */
+static void _index_vs_descriptors(videod_streaming_interface_t *stm)
+{
+  uint8_t const *desc = _videod_itf[stm->index_vc].beg;
+  void const *vs  = desc + stm->desc.beg;
+  void const *end = _end_of_streaming_descriptor(vs);
+  uint_fast8_t fmtnum = 0;
+  uint_fast8_t nfrm = 0;
+
+  tu_memclr(&stm->index, sizeof(stm->index));
+  for (void const *cur = _find_desc(tu_desc_next(vs), end, TUSB_DESC_CS_INTERFACE); cur < end;
+       cur = _find_desc(tu_desc_next(cur), end, TUSB_DESC_CS_INTERFACE)) {
+    uint8_t const *p = (uint8_t const *)cur;
+    uint16_t const ofs = (uint16_t)(p - desc);
+    switch (p[2]) {
+      case VIDEO_CS_ITF_VS_FORMAT_UNCOMPRESSED:
+      case VIDEO_CS_ITF_VS_FORMAT_MJPEG:
+      case VIDEO_CS_ITF_VS_FORMAT_DV:
+      case VIDEO_CS_ITF_VS_FORMAT_FRAME_BASED:
+        fmtnum = p[3];
+        if (!fmtnum || CFG_TUD_VIDEO_STREAMING_FORMAT_MAX < fmtnum) {
+          fmtnum = 0;
+          break;
+        }
+        stm->index.fmt[fmtnum - 1]      = ofs;
+        stm->index.frm_base[fmtnum - 1] = (uint8_t)nfrm;
+        nfrm += ((tusb_desc_cs_video_fmt_t const *)cur)->bNumFrameDescriptors;
+        break;
+
+      case VIDEO_CS_ITF_VS_FRAME_UNCOMPRESSED:
+      case VIDEO_CS_ITF_VS_FRAME_MJPEG:
+      case VIDEO_CS_ITF_VS_FRAME_FRAME_BASED:
+        if (fmtnum && p[3]) {
+          uint_fast16_t const idx = (uint_fast16_t)stm->index.frm_base[fmtnum - 1] + p[3] - 1;
+          uint_fast8_t const nfrm_fmt = ((tusb_desc_cs_video_fmt_t const *)(desc + stm->index.fmt[fmtnum - 1]))->bNumFrameDescriptors;
+          if (p[3] <= nfrm_fmt && idx < CFG_TUD_VIDEO_STREAMING_FRAME_MAX) {
+            stm->index.frm[idx] = ofs;
+          }
+        }
+        break;
+
+      default: break;
+    }
+  }
+}
+
+/** Get the format descriptor with the specified format number.
+ *
+ * @retval NULL did not found format descriptor */
+static tusb_desc_cs_video_fmt_t const *_get_desc_format(videod_streaming_interface_t const *stm, uint_fast8_t fmtnum)
+{
+  uint8_t const *desc = _videod_itf[stm->index_vc].beg;
+  if (fmtnum && fmtnum <= CFG_TUD_VIDEO_STREAMING_FORMAT_MAX && stm->index.fmt[fmtnum - 1]) {
+    return (tusb_desc_cs_video_fmt_t const *)(desc + stm->index.fmt[fmtnum - 1]);
+  }
+  /* not indexed */
+  void const *vs  = desc + stm->desc.beg;
+  void const *end = _end_of_streaming_descriptor(vs);
+  void const *fmt = _find_desc_format(tu_desc_next(vs), end, fmtnum);
+  return (fmt < end) ? (tusb_desc_cs_video_fmt_t const *)fmt : NULL;
+}
+
+/** Get the frame descriptor with the specified frame number of the format.
+ *
+ * @retval NULL did not found frame descriptor */
+static tusb_desc_cs_video_frm_t const *_get_desc_frame(videod_streaming_interface_t const *stm,
+                                                       tusb_desc_cs_video_fmt_t const *fmt, uint_fast8_t frmnum)
+{
+  uint8_t const *desc = _videod_itf[stm->index_vc].beg;
+  uint_fast8_t const fmtnum = fmt->bFormatIndex;
+  if (frmnum && fmtnum && fmtnum <= CFG_TUD_VIDEO_STREAMING_FORMAT_MAX &&
+      stm->index.fmt[fmtnum - 1] == (uint16_t)((uint8_t const *)fmt - desc)) {
+    uint_fast16_t const idx = (uint_fast16_t)stm->index.frm_base[fmtnum - 1] + frmnum - 1;
+    if (idx < CFG_TUD_VIDEO_STREAMING_FRAME_MAX && stm->index.frm[idx]) {
+      return (tusb_desc_cs_video_frm_t const *)(desc + stm->index.frm[idx]);
+    }
+  }
+  /* not indexed */
+  void const *end = _end_of_streaming_descriptor(desc + stm->desc.beg);
+  void const *frm = _find_desc_frame(tu_desc_next(fmt), end, frmnum);
+  return (frm < end) ? (tusb_desc_cs_video_frm_t const *)frm : NULL;
+}
+
+/** Return true if a whole frame is sent as one payload */
+static inline bool _is_frame_payload(videod_streaming_interface_t const *stm)
+{
+  return CFG_TUD_VIDEO_STREAMING_BULK_FRAME_PAYLOAD && stm->bulk;
+}
+
 /** Set uniquely determined values to variables that have not been set
  *
  * @param[in,out] param       Target */
@@ -442,7 +604,7 @@ static bool _update_streaming_parameters(videod_streaming_interface_t const *stm
   param->wPFrameRate      = 0;
   param->wCompWindowSize  = 1; /* GOP size? */
   param->wDelay           = 0; /* milliseconds */
-  param->dwClockFrequency = 27000000; /* same as MPEG-2 system time clock  */
+  param->dwClockFrequency = VS_CLOCK_FREQUENCY;
   param->bmFramingInfo    = 0x3; /* enables FrameID and EndOfFrame */
   param->bPreferedVersion = 1;
   param->bMinVersion      = 1;
@@ -450,9 +612,8 @@ static bool _update_streaming_parameters(videod_streaming_interface_t const *stm
   param->bUsage           = 0;
   param->bBitDepthLuma    = 8;
 
-  void const *end = _end_of_streaming_descriptor(vs);
-  tusb_desc_cs_video_fmt_t const *fmt = _find_desc_format(tu_desc_next(vs), end, fmtnum);
-  TU_ASSERT(fmt != end);
+  tusb_desc_cs_video_fmt_t const *fmt = _get_desc_format(stm, fmtnum);
+  TU_ASSERT(fmt);
 
   switch (fmt->bDescriptorSubType) {
     case VIDEO_CS_ITF_VS_FORMAT_UNCOMPRESSED:
@@ -475,8 +636,8 @@ static bool _update_streaming_parameters(videod_streaming_interface_t const *stm
     frmnum = 1;
     param->bFrameIndex = 1;
   }
-  tusb_desc_cs_video_frm_t const *frm = _find_desc_frame(tu_desc_next(fmt), end, frmnum);
-  TU_ASSERT(frm != end);
+  tusb_desc_cs_video_frm_t const *frm = _get_desc_frame(stm, fmt, frmnum);
+  TU_ASSERT(frm);
 
   /* Set the parameters determined by the frame  */
   uint_fast32_t frame_size = param->dwMaxVideoFrameSize;
@@ -511,8 +672,10 @@ static bool _update_streaming_parameters(videod_streaming_interface_t const *stm
   }
   uint_fast32_t interval_ms = interval / 10000;
   TU_ASSERT(interval_ms);
-  uint_fast32_t payload_size = (frame_size + interval_ms - 1) / interval_ms + 2;
-  if (CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE < payload_size) {
+  uint_fast32_t payload_size = (frame_size + interval_ms - 1) / interval_ms + TUD_VIDEO_PAYLOAD_HEADER_LEN;
+  if (_is_frame_payload(stm)) {
+    payload_size = frame_size + TUD_VIDEO_PAYLOAD_HEADER_LEN;
+  } else if (CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE < payload_size) {
     payload_size = CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE;
   }
   param->dwMaxPayloadTransferSize = payload_size;
@@ -548,7 +711,7 @@ static bool _negotiate_streaming_parameters(videod_streaming_interface_t const *
     param->wCompQuality     = 1; /* 1 to 10000 */
     param->wCompWindowSize  = 1; /* GOP size? */
     param->wDelay           = 0; /* milliseconds */
-    param->dwClockFrequency = 27000000; /* same as MPEG-2 system time clock  */
+    param->dwClockFrequency = VS_CLOCK_FREQUENCY;
     param->bmFramingInfo    = 0x3; /* enables FrameID and EndOfFrame */
     param->bPreferedVersion = 1;
     param->bMinVersion      = 1;
@@ -560,10 +723,8 @@ static bool _negotiate_streaming_parameters(videod_streaming_interface_t const *
 
   uint_fast8_t frmnum = param->bFrameIndex;
   if (!frmnum) {
-    tusb_desc_vs_itf_t const *vs = _get_desc_vs(stm);
-    TU_ASSERT(vs);
-    void const *end = _end_of_streaming_descriptor(vs);
-    tusb_desc_cs_video_fmt_t const *fmt = _find_desc_format(tu_desc_next(vs), end, fmtnum);
+    tusb_desc_cs_video_fmt_t const *fmt = _get_desc_format(stm, fmtnum);
+    TU_VERIFY(fmt);
     switch (request) {
       case VIDEO_REQUEST_GET_MAX:
         frmnum = fmt->bNumFrameDescriptors;
@@ -594,7 +755,8 @@ static bool _negotiate_streaming_parameters(videod_streaming_interface_t const *
     }
     param->bFrameIndex = (uint8_t)frmnum;
     /* Set the parameters determined by the frame */
-    tusb_desc_cs_video_frm_t const *frm = _find_desc_frame(tu_desc_next(fmt), end, frmnum);
+    tusb_desc_cs_video_frm_t const *frm = _get_desc_frame(stm, fmt, frmnum);
+    TU_VERIFY(frm);
     uint_fast32_t frame_size;
     switch (fmt->bDescriptorSubType) {
       case VIDEO_CS_ITF_VS_FORMAT_UNCOMPRESSED:
@@ -616,11 +778,10 @@ static bool _negotiate_streaming_parameters(videod_streaming_interface_t const *
   }
 
   if (!param->dwFrameInterval) {
-    tusb_desc_vs_itf_t const *vs = _get_desc_vs(stm);
-    TU_ASSERT(vs);
-    void const *end = _end_of_streaming_descriptor(vs);
-    tusb_desc_cs_video_fmt_t const *fmt = _find_desc_format(tu_desc_next(vs), end, fmtnum);
-    tusb_desc_cs_video_frm_t const *frm = _find_desc_frame(tu_desc_next(fmt), end, frmnum);
+    tusb_desc_cs_video_fmt_t const *fmt = _get_desc_format(stm, fmtnum);
+    TU_VERIFY(fmt);
+    tusb_desc_cs_video_frm_t const *frm = _get_desc_frame(stm, fmt, frmnum);
+    TU_VERIFY(frm);
 
     uint_fast32_t interval, interval_ms;
     switch (request) {
@@ -669,12 +830,12 @@ static bool _negotiate_streaming_parameters(videod_streaming_interface_t const *
     } else {
       uint_fast32_t frame_size = param->dwMaxVideoFrameSize;
       uint_fast32_t payload_size;
-      if (!interval_ms) {
-        payload_size = frame_size + 2;
+      if (!interval_ms || _is_frame_payload(stm)) {
+        payload_size = frame_size + TUD_VIDEO_PAYLOAD_HEADER_LEN;
       } else {
-        payload_size = (frame_size + interval_ms - 1) / interval_ms + 2;
+        payload_size = (frame_size + interval_ms - 1) / interval_ms + TUD_VIDEO_PAYLOAD_HEADER_LEN;
       }
-      if (CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE < payload_size) {
+      if (!_is_frame_payload(stm) && CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE < payload_size) {
         payload_size = CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE;
       }
       param->dwMaxPayloadTransferSize = payload_size;
@@ -755,6 +916,7 @@ static bool _init_vs_configuration(videod_streaming_interface_t *stm) {
   stm->max_payload_transfer_size = 0;
   video_probe_and_commit_control_t *param = &stm->probe_commit_payload;
   tu_memclr(param, sizeof(*param));
+  _index_vs_descriptors(stm);
   return _update_streaming_parameters(stm, param);
 }
 
@@ -787,6 +949,8 @@ static bool _open_vs_itf(uint8_t rhport, videod_streaming_interface_t *stm, uint
   stm->buffer  = NULL;
   stm->bufsize = 0;
   stm->offset  = 0;
+  stm->slice_state = VS_SLICE_NONE;
+  _frame_queue_clear(stm);
 
   /* Find a alternate interface */
   uint8_t const *beg = desc + stm->desc.beg;
@@ -828,24 +992,169 @@ static bool _open_vs_itf(uint8_t rhport, videod_streaming_interface_t *stm, uint
   return true;
 }
 
-/** Prepare the next packet payload. */
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+/** Return the current value of the source time clock */
+static uint32_t _stc_now(void) {
+  return tud_video_stc_cb ? tud_video_stc_cb() : _videod_scr.stc;
+}
+#endif
+
+/** Write the payload header from the template, with current SCR if enabled */
+static void _write_payload_header(videod_streaming_interface_t const *stm, uint8_t *dst) {
+  memcpy(dst, &stm->hdr, sizeof(stm->hdr));
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+  uint32_t stc;
+  uint16_t sof;
+  uint8_t  count;
+  do {
+    count = _videod_scr.count;
+    stc   = _videod_scr.stc;
+    sof   = _videod_scr.sof;
+  } while (count != _videod_scr.count);
+  tu_unaligned_write32(dst + 2, tu_htole32(stm->pts));
+  tu_unaligned_write32(dst + 6, tu_htole32(stc));
+  tu_unaligned_write16(dst + 10, tu_htole16(sof));
+#endif
+}
+
+/** Prepare the next transfer in endpoint buffer.
+ *  A payload larger than the endpoint buffer (bulk) is sent in several transfers, header is only in the first one. */
 static uint_fast16_t _prepare_in_payload(videod_streaming_interface_t *stm, uint8_t* ep_buf) {
-  uint_fast16_t remaining = stm->bufsize - stm->offset;
-  uint_fast16_t hdr_len   = ep_buf[0];
-  uint_fast16_t pkt_len   = stm->max_payload_transfer_size;
+  uint32_t remaining = stm->bufsize - stm->offset;
+  uint32_t hdr_len   = 0;
+  if (!stm->payload_rem) {
+    /* beginning of a payload */
+    hdr_len = TUD_VIDEO_PAYLOAD_HEADER_LEN;
+    stm->payload_rem = stm->max_payload_transfer_size;
+    TU_ASSERT(stm->payload_rem > hdr_len);
+    _write_payload_header(stm, ep_buf);
+    if (hdr_len + remaining <= stm->payload_rem) {
+      ((tusb_video_payload_header_t*) ep_buf)->EndOfFrame = 1;
+    }
+  }
+  uint32_t pkt_len = tu_min32(stm->payload_rem, stm->xfer_max);
   if (hdr_len + remaining < pkt_len) {
     pkt_len = hdr_len + remaining;
   }
-  TU_ASSERT(pkt_len >= hdr_len);
-  uint_fast16_t data_len = pkt_len - hdr_len;
+  uint_fast16_t data_len = (uint_fast16_t) (pkt_len - hdr_len);
   memcpy(&ep_buf[hdr_len], stm->buffer + stm->offset, data_len);
   stm->offset += data_len;
-  remaining -= data_len;
-  if (!remaining) {
-    tusb_video_payload_header_t *hdr = (tusb_video_payload_header_t*) ep_buf;
-    hdr->EndOfFrame = 1;
+  stm->payload_rem = (remaining > data_len) ? (stm->payload_rem - pkt_len) : 0;
+  return (uint_fast16_t) (hdr_len + data_len);
+}
+
+/** Submit the next transfer of the frame.
+ *  Without reserved headers: one payload is copied to the endpoint buffer.
+ *  With reserved headers: one or more payloads are sent directly from the frame buffer. */
+static bool _submit_in_payload(uint8_t rhport, uint8_t ep_addr, videod_streaming_interface_t *stm, uint8_t *ep_buf) {
+  if (stm->inplace) {
+    uint8_t *buf = stm->buffer + stm->offset;
+    uint32_t len = tu_min32(stm->bufsize - stm->offset, stm->xfer_max);
+    uint32_t const payload_size = stm->max_payload_transfer_size;
+    if (stm->xfer_max < payload_size) {
+      /* do not run into the next payload, its header must start a transfer */
+      len = tu_min32(len, payload_size - stm->offset % payload_size);
+    }
+    stm->offset += len;
+    return usbd_edpt_xfer(rhport, ep_addr, buf, len);
   }
-  return hdr_len + data_len;
+  uint_fast16_t pkt_len = _prepare_in_payload(stm, ep_buf);
+  return usbd_edpt_xfer(rhport, ep_addr, ep_buf, (uint16_t) pkt_len);
+}
+
+/** Write header of every payload into frame buffer and compute the transfer size.
+ *  Bulk payloads ending on a packet boundary are sent back-to-back in one transfer, host splits them
+ *  by dwMaxPayloadTransferSize. Isochronous payloads are sent one per transfer (service interval). */
+static bool _prepare_inplace_headers(videod_streaming_interface_t *stm, tusb_desc_endpoint_t const *ep,
+                                     tusb_video_payload_header_t const *hdr_tmpl) {
+  uint32_t const payload_size = stm->max_payload_transfer_size;
+  uint_fast8_t const hdr_len = hdr_tmpl->bHeaderLength;
+  TU_VERIFY(payload_size > hdr_len);
+  /* last payload must be able to hold its header */
+  uint32_t const last_len = stm->bufsize % payload_size;
+  TU_VERIFY(!last_len || last_len >= hdr_len);
+
+  stm->xfer_max = payload_size;
+  if (TUSB_XFER_BULK == ep->bmAttributes.xfer) {
+    uint32_t const xfer_max = (CFG_TUD_EDPT_XFER_LARGE ? UINT32_MAX : TUP_DCD_EDPT_XFER_MAX);
+    uint16_t const mps = tu_edpt_packet_size(ep);
+    if (xfer_max < payload_size) {
+      /* payload spans several transfers of whole packets */
+      stm->xfer_max = xfer_max - (xfer_max % mps);
+    } else if (0 == (payload_size % mps)) {
+      stm->xfer_max = xfer_max - (xfer_max % payload_size);
+    }
+  }
+
+  for (uint32_t ofs = 0; ofs < stm->bufsize; ofs += payload_size) {
+    tusb_video_payload_header_t *hdr = (tusb_video_payload_header_t*) (stm->buffer + ofs);
+    _write_payload_header(stm, stm->buffer + ofs);
+    if (stm->bufsize - ofs <= payload_size) {
+      hdr->EndOfFrame = 1;
+    }
+  }
+  return true;
+}
+
+/** Return the streaming endpoint descriptor of the current settings */
+static tusb_desc_endpoint_t const* _get_streaming_ep(videod_streaming_interface_t const *stm) {
+  uint8_t const *desc = _videod_itf[stm->index_vc].beg;
+  for (uint_fast8_t i = 0; i < TU_ARRAY_SIZE(stm->desc.ep); ++i) {
+    uint_fast16_t ofs_ep = stm->desc.ep[i];
+    if (!ofs_ep) continue;
+    return (tusb_desc_endpoint_t const*) (desc + ofs_ep);
+  }
+  return NULL;
+}
+
+/** Copy appended slice into the payload and submit it when full or at the end of frame.
+ *  Payload which is not full yet is kept in endpoint buffer until more data is appended. */
+static bool _slice_pump(uint8_t rhport, videod_streaming_interface_t *stm) {
+  if (VS_SLICE_LAST == stm->slice_state) return true; /* wait for completion of the last payload */
+  tusb_desc_endpoint_t const *ep = _get_streaming_ep(stm);
+  TU_VERIFY(ep);
+  uint8_t const ep_addr = ep->bEndpointAddress;
+  /* endpoint is busy, continued on transfer complete */
+  if (!usbd_edpt_claim(rhport, ep_addr)) return true;
+
+  uint8_t *ep_buf = _videod_streaming_epbuf[stm - _videod_streaming_itf].buf;
+  uint_fast16_t const pkt_len = (uint_fast16_t) stm->max_payload_transfer_size;
+  bool slice_done = false;
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+  if (stm->slice_fill == stm->hdr.bHeaderLength) {
+    _write_payload_header(stm, ep_buf); /* refresh SCR of the new payload */
+  }
+#endif
+  if (stm->buffer) {
+    uint32_t const len = tu_min32(stm->bufsize - stm->offset, pkt_len - stm->slice_fill);
+    memcpy(&ep_buf[stm->slice_fill], stm->buffer + stm->offset, len);
+    stm->offset     += len;
+    stm->slice_fill += (uint16_t) len;
+    if (stm->offset == stm->bufsize) {
+      stm->buffer  = NULL;
+      stm->bufsize = 0;
+      stm->offset  = 0;
+      slice_done   = true;
+    }
+  }
+
+  bool const last = (VS_SLICE_END == stm->slice_state) && !stm->buffer;
+  if (last) {
+    ((tusb_video_payload_header_t*) ep_buf)->EndOfFrame = 1;
+    stm->slice_state = VS_SLICE_LAST;
+  }
+  if (last || stm->slice_fill == pkt_len) {
+    uint16_t const xfer_len = stm->slice_fill;
+    stm->slice_fill = ep_buf[0];
+    TU_ASSERT(usbd_edpt_xfer(rhport, ep_addr, ep_buf, xfer_len));
+  } else {
+    usbd_edpt_release(rhport, ep_addr);
+  }
+
+  if (slice_done && tud_video_frame_append_complete_cb) {
+    tud_video_frame_append_complete_cb(stm->index_vc, stm->index_vs);
+  }
+  return true;
 }
 
 /** Handle a standard request to the video control interface. */
@@ -1014,7 +1323,6 @@ static int handle_video_stm_cs_req(uint8_t rhport, uint8_t stage,
                                    uint_fast8_t stm_idx) {
   (void)rhport;
   videod_streaming_interface_t *stm = &_videod_streaming_itf[stm_idx];
-  videod_streaming_epbuf_t *stm_epbuf = &_videod_streaming_epbuf[stm_idx];
 
   uint8_t const ctrl_sel = TU_U16_HIGH(request->wValue);
   TU_LOG_DRV("%s_Control(%s)\r\n", tu_str_video_vs_control_selector[ctrl_sel], tu_lookup_find(&tu_table_video_request, request->bRequest));
@@ -1113,10 +1421,17 @@ static int handle_video_stm_cs_req(uint8_t rhport, uint8_t stage,
               stm->buffer  = NULL;
               stm->bufsize = 0;
               stm->offset  = 0;
+              stm->slice_state = VS_SLICE_NONE;
+              _frame_queue_clear(stm);
+              stm->payload_rem = 0;
               /* initialize payload header */
-              tusb_video_payload_header_t *hdr = (tusb_video_payload_header_t*)stm_epbuf->buf;
-              hdr->bHeaderLength = sizeof(*hdr);
+              tusb_video_payload_header_t *hdr = &stm->hdr;
+              hdr->bHeaderLength = TUD_VIDEO_PAYLOAD_HEADER_LEN;
               hdr->bmHeaderInfo  = 0;
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+              hdr->PresentationTime     = 1;
+              hdr->SourceClockReference = 1;
+#endif
             }
           }
           return VIDEO_ERROR_NONE;
@@ -1212,41 +1527,228 @@ bool tud_video_n_streaming(uint_fast8_t ctl_idx, uint_fast8_t stm_idx)
   return true;
 }
 
-bool tud_video_n_frame_xfer(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, void *buffer, size_t bufsize) {
+/** Return the max bytes per transfer from the endpoint buffer.
+ *  Payload larger than endpoint buffer is sent in transfers of whole packets. */
+static uint32_t _epbuf_xfer_max(videod_streaming_interface_t const *stm, tusb_desc_endpoint_t const *ep) {
+  uint32_t const payload_size = stm->max_payload_transfer_size;
+  if (payload_size <= CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE) return payload_size;
+  uint16_t const mps = tu_edpt_packet_size(ep);
+  return (uint32_t) (CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE - (CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE % mps));
+}
+
+/** Start transmitting a frame, endpoint must be claimed by the caller */
+static bool _frame_start(uint8_t rhport, videod_streaming_interface_t *stm, tusb_desc_endpoint_t const *ep,
+                         uint8_t *buffer, uint32_t bufsize, bool inplace) {
+  videod_streaming_epbuf_t *stm_epbuf = &_videod_streaming_epbuf[stm - _videod_streaming_itf];
+  /* update the packet header */
+  tusb_video_payload_header_t *hdr = &stm->hdr;
+  hdr->FrameID   ^= 1;
+  hdr->EndOfFrame = 0;
+  /* update the packet data */
+  stm->buffer      = buffer;
+  stm->bufsize     = bufsize;
+  stm->offset      = 0;
+  stm->payload_rem = 0;
+  stm->inplace     = inplace ? 1 : 0;
+  if (!inplace) {
+    stm->xfer_max = _epbuf_xfer_max(stm, ep);
+    TU_ASSERT(stm->xfer_max);
+  } else if (!_prepare_inplace_headers(stm, ep, hdr)) {
+    hdr->FrameID ^= 1;
+    stm->buffer  = NULL;
+    stm->bufsize = 0;
+    return false;
+  }
+  TU_ASSERT( _submit_in_payload(rhport, ep->bEndpointAddress, stm, stm_epbuf->buf) );
+  return true;
+}
+
+static void _frame_drop(videod_streaming_interface_t const *stm, void *buffer) {
+  _get_frame_queue(stm)->dropped++;
+  if (tud_video_frame_dropped_cb) {
+    tud_video_frame_dropped_cb(stm->index_vc, stm->index_vs, buffer);
+  }
+}
+
+/** Start the next queued frame if no frame is being transmitted */
+static void _frame_queue_pump(uint8_t rhport, videod_streaming_interface_t *stm) {
+#if CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE
+  videod_frame_queue_t *q = _get_frame_queue(stm);
+  tusb_desc_endpoint_t const *ep = _get_streaming_ep(stm);
+  if (!ep) return;
+  uint8_t const ep_addr = ep->bEndpointAddress;
+
+  while (!stm->buffer && !stm->slice_state && !tu_fifo_empty(&q->ff)) {
+    /* endpoint is busy, the frame is started on transfer complete */
+    if (!usbd_edpt_claim(rhport, ep_addr)) return;
+    videod_frame_entry_t entry;
+    if (stm->buffer || stm->slice_state || !tu_fifo_read(&q->ff, &entry)) {
+      usbd_edpt_release(rhport, ep_addr);
+      return;
+    }
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+    stm->pts = entry.pts;
+#endif
+    if (_frame_start(rhport, stm, ep, entry.buffer, entry.bufsize, entry.inplace)) return;
+    usbd_edpt_release(rhport, ep_addr);
+    _frame_drop(stm, entry.buffer);
+  }
+#else
+  (void) rhport; (void) stm;
+#endif
+}
+
+static bool _frame_xfer(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, void *buffer, size_t bufsize, bool inplace) {
   TU_ASSERT(ctl_idx < CFG_TUD_VIDEO);
   TU_ASSERT(stm_idx < CFG_TUD_VIDEO_STREAMING);
 
   if (!buffer || !bufsize) return false;
   videod_streaming_interface_t *stm = _get_instance_streaming(ctl_idx, stm_idx);
-  videod_streaming_epbuf_t *stm_epbuf = &_videod_streaming_epbuf[ctl_idx];
 
-  if (!stm || !stm->desc.ep[0] || stm->buffer) return false;
+  if (!stm || !stm->desc.ep[0]) return false;
   if (stm->state == VS_STATE_PROBING) return false;
 
   /* Find EP address */
-  uint8_t const *desc = _videod_itf[stm->index_vc].beg;
-  uint8_t ep_addr = 0;
-  for (uint_fast8_t i = 0; i < CFG_TUD_VIDEO_STREAMING; ++i) {
-    uint_fast16_t ofs_ep = stm->desc.ep[i];
-    if (!ofs_ep) continue;
-    ep_addr = _desc_ep_addr(desc + ofs_ep);
-    break;
+  tusb_desc_endpoint_t const *ep = _get_streaming_ep(stm);
+  if (!ep) return false;
+  videod_frame_queue_t *q = _get_frame_queue(stm);
+
+#if CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE
+  if (tu_fifo_full(&q->ff)) {
+    if (TUD_VIDEO_FRAME_QUEUE_BLOCK == q->policy) return false;
+    if (TUD_VIDEO_FRAME_QUEUE_DROP_NEWEST == q->policy) {
+      _frame_drop(stm, buffer);
+      return true;
+    }
+    videod_frame_entry_t oldest;
+    if (tu_fifo_read(&q->ff, &oldest)) {
+      _frame_drop(stm, oldest.buffer);
+    }
   }
-  if (!ep_addr) return false;
+  videod_frame_entry_t const entry = { .buffer = (uint8_t*) buffer, .bufsize = bufsize, .inplace = inplace ? 1 : 0,
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+                                       .pts = _stc_now()
+#endif
+  };
+  TU_VERIFY(tu_fifo_write(&q->ff, &entry));
+  _frame_queue_pump(0, stm);
+  q->count_max = (uint8_t) tu_max32(q->count_max, tu_fifo_count(&q->ff));
+  return true;
+#else
+  if (stm->buffer || stm->slice_state) {
+    if (TUD_VIDEO_FRAME_QUEUE_BLOCK == q->policy) return false;
+    _frame_drop(stm, buffer);
+    return true;
+  }
+  TU_VERIFY( usbd_edpt_claim(0, ep->bEndpointAddress) );
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+  stm->pts = _stc_now();
+#endif
+  if (!_frame_start(0, stm, ep, (uint8_t*) buffer, bufsize, inplace)) {
+    usbd_edpt_release(0, ep->bEndpointAddress);
+    return false;
+  }
+  return true;
+#endif
+}
+
+bool tud_video_n_frame_xfer(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, void *buffer, size_t bufsize) {
+  return _frame_xfer(ctl_idx, stm_idx, buffer, bufsize, false);
+}
+
+bool tud_video_n_frame_xfer_inplace(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, void *buffer, size_t bufsize) {
+  return _frame_xfer(ctl_idx, stm_idx, buffer, bufsize, true);
+}
+
+bool tud_video_n_frame_begin(uint_fast8_t ctl_idx, uint_fast8_t stm_idx) {
+  TU_ASSERT(ctl_idx < CFG_TUD_VIDEO);
+  TU_ASSERT(stm_idx < CFG_TUD_VIDEO_STREAMING);
+  videod_streaming_interface_t *stm = _get_instance_streaming(ctl_idx, stm_idx);
+
+  if (!stm || !stm->desc.ep[0] || stm->buffer || stm->slice_state) return false;
+  if (stm->state == VS_STATE_PROBING) return false;
+
+  /* payload is assembled in endpoint buffer */
+  if (CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE < stm->max_payload_transfer_size) return false;
 
-  TU_VERIFY( usbd_edpt_claim(0, ep_addr) );
   /* update the packet header */
-  tusb_video_payload_header_t *hdr = (tusb_video_payload_header_t*)stm_epbuf->buf;
+  uint8_t *ep_buf = _videod_streaming_epbuf[stm - _videod_streaming_itf].buf;
+  tusb_video_payload_header_t *hdr = &stm->hdr;
   hdr->FrameID   ^= 1;
   hdr->EndOfFrame = 0;
-  /* update the packet data */
-  stm->buffer     = (uint8_t*)buffer;
-  stm->bufsize    = bufsize;
-  uint_fast16_t pkt_len = _prepare_in_payload(stm, stm_epbuf->buf);
-  TU_ASSERT( usbd_edpt_xfer(0, ep_addr, stm_epbuf->buf, (uint16_t) pkt_len), 0);
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+  stm->pts = _stc_now();
+#endif
+  _write_payload_header(stm, ep_buf);
+  stm->inplace     = 0;
+  stm->slice_fill  = hdr->bHeaderLength;
+  stm->slice_state = VS_SLICE_OPEN;
   return true;
 }
 
+bool tud_video_n_frame_append(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, void const *buffer, size_t bufsize) {
+  TU_ASSERT(ctl_idx < CFG_TUD_VIDEO);
+  TU_ASSERT(stm_idx < CFG_TUD_VIDEO_STREAMING);
+  if (!buffer || !bufsize) return false;
+  videod_streaming_interface_t *stm = _get_instance_streaming(ctl_idx, stm_idx);
+
+  /* previous slice is not consumed yet */
+  if (!stm || VS_SLICE_OPEN != stm->slice_state || stm->buffer) return false;
+  stm->buffer  = (uint8_t*) (uintptr_t) buffer;
+  stm->bufsize = bufsize;
+  stm->offset  = 0;
+  return _slice_pump(0, stm);
+}
+
+bool tud_video_n_frame_end(uint_fast8_t ctl_idx, uint_fast8_t stm_idx) {
+  TU_ASSERT(ctl_idx < CFG_TUD_VIDEO);
+  TU_ASSERT(stm_idx < CFG_TUD_VIDEO_STREAMING);
+  videod_streaming_interface_t *stm = _get_instance_streaming(ctl_idx, stm_idx);
+
+  if (!stm || VS_SLICE_OPEN != stm->slice_state) return false;
+  stm->slice_state = VS_SLICE_END;
+  return _slice_pump(0, stm);
+}
+
+bool tud_video_n_frame_queue_policy(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, tud_video_frame_queue_policy_t policy) {
+  TU_ASSERT(ctl_idx < CFG_TUD_VIDEO);
+  TU_ASSERT(stm_idx < CFG_TUD_VIDEO_STREAMING);
+  TU_VERIFY(policy <= TUD_VIDEO_FRAME_QUEUE_DROP_OLDEST);
+  videod_streaming_interface_t *stm = _get_instance_streaming(ctl_idx, stm_idx);
+  TU_VERIFY(stm);
+  _get_frame_queue(stm)->policy = (uint8_t) policy;
+  return true;
+}
+
+bool tud_video_n_frame_queue_stats(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, tud_video_frame_queue_stats_t *stats, bool clear) {
+  TU_ASSERT(ctl_idx < CFG_TUD_VIDEO);
+  TU_ASSERT(stm_idx < CFG_TUD_VIDEO_STREAMING);
+  TU_VERIFY(stats);
+  videod_streaming_interface_t *stm = _get_instance_streaming(ctl_idx, stm_idx);
+  TU_VERIFY(stm);
+  videod_frame_queue_t *q = _get_frame_queue(stm);
+  stats->dropped   = q->dropped;
+  stats->count_max = q->count_max;
+#if CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE
+  stats->count     = (uint8_t) tu_fifo_count(&q->ff);
+#else
+  stats->count     = 0;
+#endif
+  if (clear) {
+    q->dropped   = 0;
+    q->count_max = 0;
+  }
+  return true;
+}
+
+uint32_t tud_video_n_payload_size(uint_fast8_t ctl_idx, uint_fast8_t stm_idx) {
+  TU_ASSERT(ctl_idx < CFG_TUD_VIDEO, 0);
+  TU_ASSERT(stm_idx < CFG_TUD_VIDEO_STREAMING, 0);
+  videod_streaming_interface_t *stm = _get_instance_streaming(ctl_idx, stm_idx);
+  if (!stm || stm->state == VS_STATE_PROBING) return 0;
+  return stm->max_payload_transfer_size;
+}
+
 //--------------------------------------------------------------------+
 // USBD Driver API
 //--------------------------------------------------------------------+
@@ -1258,6 +1760,12 @@ void videod_init(void) {
   for (uint_fast8_t i = 0; i < CFG_TUD_VIDEO_STREAMING; ++i) {
     videod_streaming_interface_t *stm = &_videod_streaming_itf[i];
     tu_memclr(stm, sizeof(videod_streaming_interface_t));
+    videod_frame_queue_t *q = &_videod_frame_queue[i];
+    tu_memclr(q, sizeof(videod_frame_queue_t));
+    q->policy = CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE_POLICY;
+#if CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE
+    tu_fifo_config(&q->ff, q->ff_buf, CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE, sizeof(videod_frame_entry_t), false);
+#endif
   }
 }
 
@@ -1267,6 +1775,9 @@ bool videod_deinit(void) {
 
 void videod_reset(uint8_t rhport) {
   (void) rhport;
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+  usbd_sof_enable(rhport, SOF_CONSUMER_VIDEO, false);
+#endif
   for (uint_fast8_t i = 0; i < CFG_TUD_VIDEO; ++i) {
     videod_interface_t* ctl = &_videod_itf[i];
     tu_memclr(ctl, sizeof(*ctl));
@@ -1274,6 +1785,7 @@ void videod_reset(uint8_t rhport) {
   for (uint_fast8_t i = 0; i < CFG_TUD_VIDEO_STREAMING; ++i) {
     videod_streaming_interface_t *stm = &_videod_streaming_itf[i];
     tu_memclr(stm, sizeof(videod_streaming_interface_t));
+    _frame_queue_clear(stm);
   }
 }
 
@@ -1319,6 +1831,11 @@ uint16_t videod_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uin
     cur = _next_desc_itf(cur, end);
     stm->desc.end = (uint16_t) ((uintptr_t)cur - (uintptr_t)itf_desc);
     stm->state = VS_STATE_PROBING;
+    {
+      /* Bulk streaming endpoint has no alternate settings, isochronous one is in alternate settings */
+      void const *ep = _find_desc_ep((uint8_t const*)itf_desc + stm->desc.beg, cur);
+      stm->bulk = (ep < cur && TUSB_XFER_BULK == ((tusb_desc_endpoint_t const*)ep)->bmAttributes.xfer) ? 1 : 0;
+    }
 #ifdef TUP_DCD_EDPT_ISO_ALLOC
     /* Allocate ISO endpoints */
     uint16_t ep_size = 0;
@@ -1348,6 +1865,9 @@ uint16_t videod_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uin
     }
   }
   self->len = (uint16_t) ((uintptr_t)cur - (uintptr_t)itf_desc);
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+  usbd_sof_enable(rhport, SOF_CONSUMER_VIDEO, true);
+#endif
   return (uint16_t) ((uintptr_t)cur - (uintptr_t)itf_desc);
 }
 
@@ -1392,6 +1912,21 @@ bool videod_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_
   return false;
 }
 
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+// SOF handler in ISR context: latch source time clock with SOF counter for SCR of payload headers.
+// One SOF is 1ms on Full-Speed and 125us (microframe) on High-Speed
+void videod_sof(uint8_t rhport, uint32_t frame_count) {
+  if (tud_video_stc_cb) {
+    _videod_scr.stc = tud_video_stc_cb();
+  } else {
+    uint32_t const sof_per_sec = (tud_rhport_speed_get(rhport) == TUSB_SPEED_HIGH) ? 8000u : 1000u;
+    _videod_scr.stc += VS_CLOCK_FREQUENCY / sof_per_sec;
+  }
+  _videod_scr.sof = (uint16_t) (frame_count & 0x7ffu);
+  _videod_scr.count++;
+}
+#endif
+
 bool videod_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes) {
   (void)result; (void)xferred_bytes;
 
@@ -1410,15 +1945,23 @@ bool videod_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint3
   TU_ASSERT(itf < CFG_TUD_VIDEO_STREAMING);
   videod_streaming_epbuf_t *stm_epbuf = &_videod_streaming_epbuf[itf];
 
-  if (stm->offset < stm->bufsize) {
+  if (stm->slice_state) {
+    if (VS_SLICE_LAST != stm->slice_state) return _slice_pump(rhport, stm);
+    stm->slice_state = VS_SLICE_NONE;
+    _frame_queue_pump(rhport, stm);
+    if (tud_video_frame_xfer_complete_cb) {
+      tud_video_frame_xfer_complete_cb(stm->index_vc, stm->index_vs);
+    }
+  } else if (stm->offset < stm->bufsize) {
     /* Claim the endpoint */
     TU_VERIFY( usbd_edpt_claim(rhport, ep_addr), 0);
-    uint_fast16_t pkt_len = _prepare_in_payload(stm, stm_epbuf->buf);
-    TU_ASSERT( usbd_edpt_xfer(rhport, ep_addr, stm_epbuf->buf, (uint16_t) pkt_len), 0);
+    TU_ASSERT( _submit_in_payload(rhport, ep_addr, stm, stm_epbuf->buf), 0);
   } else {
     stm->buffer  = NULL;
     stm->bufsize = 0;
     stm->offset  = 0;
+    /* start next frame before callback to keep the order with frames queued from it */
+    _frame_queue_pump(rhport, stm);
     if (tud_video_frame_xfer_complete_cb) {
       tud_video_frame_xfer_complete_cb(stm->index_vc, stm->index_vs);
     }
@@ -35,6 +35,59 @@
 extern "C" {
 #endif
 
+// Fill presentation time (PTS) and source clock reference (SCR) in payload headers. The source time clock runs at
+// dwClockFrequency (27 MHz), it is derived from SOF unless tud_video_stc_cb() is implemented. PTS is taken when the
+// frame is submitted, SCR is the clock latched together with the SOF counter on the last SOF
+#ifndef CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+  #define CFG_TUD_VIDEO_STREAMING_TIMESTAMP           0
+#endif
+
+// Byte size of the payload header written by the driver
+#if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+  #define TUD_VIDEO_PAYLOAD_HEADER_LEN  (sizeof(tusb_video_payload_header_t) + 10) // + dwPresentationTime, scrSourceClock
+#else
+  #define TUD_VIDEO_PAYLOAD_HEADER_LEN  sizeof(tusb_video_payload_header_t)
+#endif
+
+// Number of frames queued behind the one being transmitted for each streaming interface
+#ifndef CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE
+  #define CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE         0
+#endif
+
+// Number of format and frame descriptors of each streaming interface indexed for probe/commit negotiation.
+// Descriptors beyond these are still found by searching the configuration descriptor.
+#ifndef CFG_TUD_VIDEO_STREAMING_FORMAT_MAX
+  #define CFG_TUD_VIDEO_STREAMING_FORMAT_MAX          4
+#endif
+
+#ifndef CFG_TUD_VIDEO_STREAMING_FRAME_MAX
+  #define CFG_TUD_VIDEO_STREAMING_FRAME_MAX           16
+#endif
+
+// For bulk streaming interface, negotiate dwMaxPayloadTransferSize to hold a whole frame so that each frame is sent
+// as one payload with a single header, in transfers as large as the endpoint buffer (or frame buffer when in-place).
+// Frame slices (tud_video_n_frame_begin) are not available on such interface if the payload exceeds endpoint buffer.
+#ifndef CFG_TUD_VIDEO_STREAMING_BULK_FRAME_PAYLOAD
+  #define CFG_TUD_VIDEO_STREAMING_BULK_FRAME_PAYLOAD  0
+#endif
+
+// What to do with a new frame when the queue is full (or a frame is being transmitted without queue)
+typedef enum {
+  TUD_VIDEO_FRAME_QUEUE_BLOCK = 0,  // reject new frame, frame_xfer() returns false and caller retries later
+  TUD_VIDEO_FRAME_QUEUE_DROP_NEWEST, // drop new frame, frame_xfer() returns true
+  TUD_VIDEO_FRAME_QUEUE_DROP_OLDEST, // drop oldest queued frame to make room (newest if there is no queue)
+} tud_video_frame_queue_policy_t;
+
+#ifndef CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE_POLICY
+  #define CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE_POLICY  TUD_VIDEO_FRAME_QUEUE_BLOCK
+#endif
+
+typedef struct {
+  uint32_t dropped;   // number of frames dropped by the queue policy
+  uint8_t  count;     // number of frames waiting in queue, not including the one being transmitted
+  uint8_t  count_max; // high-water of count
+} tud_video_frame_queue_stats_t;
+
 //--------------------------------------------------------------------+
 // Application API (Multiple Ports)
 // CFG_TUD_VIDEO > 1
@@ -48,7 +101,8 @@ bool tud_video_n_connected(uint_fast8_t ctl_idx);
  * @param[in] stm_idx    Destination streaming interface index */
 bool tud_video_n_streaming(uint_fast8_t ctl_idx, uint_fast8_t stm_idx);
 
-/** Transfer a frame
+/** Transfer a frame. If a frame is being transmitted, it is queued (CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE)
+ *  or handled by the queue policy when there is no room.
  *
  * @param[in] ctl_idx    Destination control interface index
  * @param[in] stm_idx    Destination streaming interface index
@@ -56,6 +110,63 @@ bool tud_video_n_streaming(uint_fast8_t ctl_idx, uint_fast8_t stm_idx);
  * @param[in] bufsize    Byte size of the frame buffer */
 bool tud_video_n_frame_xfer(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, void *buffer, size_t bufsize);
 
+/** Return the byte size of each payload including its header (dwMaxPayloadTransferSize), 0 if not committed
+ *
+ * @param[in] ctl_idx    Destination control interface index
+ * @param[in] stm_idx    Destination streaming interface index */
+uint32_t tud_video_n_payload_size(uint_fast8_t ctl_idx, uint_fast8_t stm_idx);
+
+/** Transfer a frame whose buffer has space reserved for payload headers, data is sent without copying.
+ *  The buffer is a sequence of payloads of tud_video_n_payload_size() bytes (the last one can be shorter),
+ *  each starting with TUD_VIDEO_PAYLOAD_HEADER_LEN bytes which are filled by the driver. For bulk endpoint,
+ *  if payload size is multiple of packet size, multiple payloads are sent in one transfer, and a payload larger
+ *  than what can be submitted at once is sent in several transfers.
+ *  The buffer must be accessible by the USB controller DMA (CFG_TUD_MEM_SECTION, CFG_TUD_MEM_ALIGN).
+ *
+ * @param[in] ctl_idx    Destination control interface index
+ * @param[in] stm_idx    Destination streaming interface index
+ * @param[in] buffer     Frame buffer with reserved headers. The caller must not use this buffer until the operation is completed.
+ * @param[in] bufsize    Byte size of the frame buffer including headers */
+bool tud_video_n_frame_xfer_inplace(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, void *buffer, size_t bufsize);
+
+/** Begin a frame which is produced by slices while transmitting, e.g scanlines from a sensor.
+ *  Data is copied into payloads, a payload is sent once it is full, only one endpoint buffer is used.
+ *
+ * @param[in] ctl_idx    Destination control interface index
+ * @param[in] stm_idx    Destination streaming interface index */
+bool tud_video_n_frame_begin(uint_fast8_t ctl_idx, uint_fast8_t stm_idx);
+
+/** Append a slice to the frame begun by tud_video_n_frame_begin(). Only one slice can be pending,
+ *  tud_video_frame_append_complete_cb() is invoked when it is consumed and the next one can be appended.
+ *
+ * @param[in] ctl_idx    Destination control interface index
+ * @param[in] stm_idx    Destination streaming interface index
+ * @param[in] buffer     Slice data. The caller must not use this buffer until the slice is consumed.
+ * @param[in] bufsize    Byte size of the slice */
+bool tud_video_n_frame_append(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, void const *buffer, size_t bufsize);
+
+/** End the frame, remaining data is sent with EndOfFrame. tud_video_frame_xfer_complete_cb() is invoked
+ *  when the last payload is sent.
+ *
+ * @param[in] ctl_idx    Destination control interface index
+ * @param[in] stm_idx    Destination streaming interface index */
+bool tud_video_n_frame_end(uint_fast8_t ctl_idx, uint_fast8_t stm_idx);
+
+/** Set policy for a new frame when the frame queue is full, default is CFG_TUD_VIDEO_STREAMING_FRAME_QUEUE_POLICY
+ *
+ * @param[in] ctl_idx    Destination control interface index
+ * @param[in] stm_idx    Destination streaming interface index
+ * @param[in] policy     tud_video_frame_queue_policy_t */
+bool tud_video_n_frame_queue_policy(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, tud_video_frame_queue_policy_t policy);
+
+/** Get frame queue statistics, to tune queue depth for latency against smoothness
+ *
+ * @param[in]  ctl_idx    Destination control interface index
+ * @param[in]  stm_idx    Destination streaming interface index
+ * @param[out] stats      Statistics
+ * @param[in]  clear      Clear dropped and count_max after reading */
+bool tud_video_n_frame_queue_stats(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, tud_video_frame_queue_stats_t *stats, bool clear);
+
 /*------------- Optional callbacks -------------*/
 /** Invoked when compeletion of a frame transfer
  *
@@ -63,6 +174,25 @@ bool tud_video_n_frame_xfer(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, void *bu
  * @param[in] stm_idx    Destination streaming interface index */
 TU_ATTR_WEAK void tud_video_frame_xfer_complete_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx);
 
+/** Invoked when a frame is dropped by the queue policy, the buffer can be reused by the caller
+ *
+ * @param[in] ctl_idx    Destination control interface index
+ * @param[in] stm_idx    Destination streaming interface index
+ * @param[in] buffer     Frame buffer of the dropped frame */
+TU_ATTR_WEAK void tud_video_frame_dropped_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, void *buffer);
+
+/** Invoked when the slice appended by tud_video_n_frame_append() is consumed
+ *
+ * @param[in] ctl_idx    Destination control interface index
+ * @param[in] stm_idx    Destination streaming interface index */
+TU_ATTR_WEAK void tud_video_frame_append_complete_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx);
+
+/** Invoked to read the source time clock of 27 MHz for CFG_TUD_VIDEO_STREAMING_TIMESTAMP, also in SOF ISR.
+ *  If not implemented, the clock is advanced by the nominal (micro)frame period on each SOF.
+ *
+ * @return current value of the source time clock */
+TU_ATTR_WEAK TU_ATTR_FAST_FUNC uint32_t tud_video_stc_cb(void);
+
 //--------------------------------------------------------------------+
 // Application Callback API (weak is optional)
 //--------------------------------------------------------------------+
@@ -92,6 +222,7 @@ void     videod_reset          (uint8_t rhport);
 uint16_t videod_open           (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t max_len);
 bool     videod_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const * request);
 bool     videod_xfer_cb        (uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
+void     videod_sof            (uint8_t rhport, uint32_t frame_count);
 
 #ifdef __cplusplus
  }
@@ -0,0 +1,822 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (CFG_TUH_ENABLED && CFG_TUH_VIDEO)
+
+#include "host/usbh.h"
+#include "host/usbh_pvt.h"
+
+#include "video_host.h"
+
+// Level where CFG_TUSB_DEBUG must be at least for this driver is logged
+#ifndef CFG_TUH_VIDEO_LOG_LEVEL
+  #define CFG_TUH_VIDEO_LOG_LEVEL   CFG_TUH_LOG_LEVEL
+#endif
+
+#define TU_LOG_DRV(...)   TU_LOG(CFG_TUH_VIDEO_LOG_LEVEL, __VA_ARGS__)
+
+/* Video Class host driver
+ * - One Video Control interface and its first (input) streaming interface with bulk or isochronous endpoint.
+ * - Payloads are reassembled into frame buffers queued by application. With CFG_TUH_VIDEO_ZERO_COPY, a payload is
+ *   received right into the frame buffer so that its header lands over the tail of previous payload data: the few
+ *   overwritten bytes are saved before and restored after the transfer, avoiding a copy of payload data. The staging
+ *   buffer is used (and data copied) only for unaligned positions or when frame is dropped.
+ * - Frame ends with EOF bit of header, or a toggle of FID bit if device does not set EOF.
+ */
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+// Payload header bmHeaderInfo
+enum {
+  PAYLOAD_HEADER_FID = TU_BIT(0),
+  PAYLOAD_HEADER_EOF = TU_BIT(1),
+  PAYLOAD_HEADER_ERR = TU_BIT(6),
+};
+
+// largest standard payload header: 2 + PTS (4) + SCR (6)
+enum { PAYLOAD_HEADER_MAX = 12 };
+
+typedef struct {
+  uint8_t alt;
+  uint16_t packet_size;   // wMaxPacketSize x transactions per micro-frame
+} videoh_alt_t;
+
+typedef struct {
+  uint8_t* buffer;
+  uint32_t size;
+} videoh_frame_buf_t;
+
+typedef struct {
+  uint8_t daddr;
+  uint8_t vc_itf;
+  uint8_t vs_itf;
+  uint8_t itf_count;    // number of interfaces in this function, including Video Control
+  bool mounted;
+  bool running;
+  bool ep_opened;
+  bool is_iso;
+
+  uint8_t probe_len;    // 26 (1.0), 34 (1.1) or 48 (1.5) bytes depending on bcdUVC
+  uint8_t alt_count;
+  uint8_t frame_count;
+  uint16_t packet_size; // bulk: wMaxPacketSize, iso: packet size of selected alternate
+
+  uint32_t max_frame_size;
+  uint32_t max_payload;
+
+  tusb_desc_endpoint_t desc_ep; // bulk endpoint, or isochronous endpoint with largest packet size
+  videoh_alt_t alt[CFG_TUH_VIDEO_ALT_MAX];
+  tuh_video_frame_info_t frame[CFG_TUH_VIDEO_FRAME_MAX];
+
+  // application frame buffers
+  videoh_frame_buf_t fq[CFG_TUH_VIDEO_FRAME_QUEUE];
+  uint8_t fq_rd;
+  uint8_t fq_count;
+
+  // reassembly
+  struct {
+    videoh_frame_buf_t* frame; // frame being received, NULL if dropped
+    uint32_t write_pos;
+    uint32_t payload_rx;  // bytes of current (bulk) payload received so far
+
+    uint8_t* xfer_buf;
+    uint32_t xfer_len;
+    uint8_t* saved_owner; // frame buffer whose bytes are saved, NULL if none
+    uint8_t saved[PAYLOAD_HEADER_MAX];
+    uint8_t saved_len;
+
+    uint8_t hdr_len;      // header length of last payload, used to predict the next one
+    uint8_t fid;
+    bool in_frame;
+    bool discard;
+    bool error;
+    bool payload_cont;    // bulk payload continues in next transfer (without header)
+    bool payload_eof;
+  } rx;
+
+  tuh_video_stats_t stats;
+} videoh_interface_t;
+
+typedef struct {
+  TUH_EPBUF_DEF(staging, CFG_TUH_VIDEO_EP_BUFSIZE);
+  TUH_EPBUF_TYPE_DEF(video_probe_and_commit_control_t, probe);
+} videoh_epbuf_t;
+
+static videoh_interface_t videoh_data[CFG_TUH_VIDEO];
+CFG_TUH_MEM_SECTION static videoh_epbuf_t videoh_epbuf[CFG_TUH_VIDEO];
+
+// stages of tuh_video_stream_start(), carried in user_data with index
+enum {
+  START_STAGE_PROBE_GET = 0,
+  START_STAGE_COMMIT,
+  START_STAGE_SET_INTERFACE,
+  START_STAGE_RUN,
+};
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+
+static inline videoh_interface_t* get_itf(uint8_t idx) {
+  TU_ASSERT(idx < CFG_TUH_VIDEO, NULL);
+  videoh_interface_t* p_video = &videoh_data[idx];
+
+  return (p_video->daddr != 0) ? p_video : NULL;
+}
+
+static inline videoh_frame_buf_t* frame_queue_head(videoh_interface_t* p_video) {
+  return p_video->fq_count ? &p_video->fq[p_video->fq_rd] : NULL;
+}
+
+static inline void frame_queue_pop(videoh_interface_t* p_video) {
+  p_video->fq_rd = (uint8_t) ((p_video->fq_rd + 1) % CFG_TUH_VIDEO_FRAME_QUEUE);
+  p_video->fq_count--;
+}
+
+// wMaxPacketSize x transactions per micro-frame
+static inline uint16_t iso_packet_size(tusb_desc_endpoint_t const* desc_ep) {
+  uint16_t const mps = tu_le16toh(desc_ep->wMaxPacketSize);
+  return (uint16_t) ((mps & 0x7FF) * (1 + ((mps >> 11) & 0x03)));
+}
+
+static void start_process(tuh_xfer_t* xfer);
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+
+uint8_t tuh_video_itf_get_index(uint8_t daddr, uint8_t itf_num) {
+  for (uint8_t i = 0; i < CFG_TUH_VIDEO; i++) {
+    videoh_interface_t const* p_video = &videoh_data[i];
+    if (p_video->daddr == daddr && p_video->vc_itf == itf_num) return i;
+  }
+
+  return TUSB_INDEX_INVALID_8;
+}
+
+bool tuh_video_mounted(uint8_t idx) {
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_VERIFY(p_video);
+  return p_video->mounted;
+}
+
+uint8_t tuh_video_frame_count(uint8_t idx) {
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_VERIFY(p_video, 0);
+  return p_video->frame_count;
+}
+
+bool tuh_video_frame_get_info(uint8_t idx, uint8_t n, tuh_video_frame_info_t* info) {
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_VERIFY(p_video && info && n < p_video->frame_count);
+  *info = p_video->frame[n];
+  return true;
+}
+
+bool tuh_video_streaming(uint8_t idx) {
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_VERIFY(p_video);
+  return p_video->running;
+}
+
+uint32_t tuh_video_max_frame_size(uint8_t idx) {
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_VERIFY(p_video, 0);
+  return p_video->max_frame_size;
+}
+
+bool tuh_video_frame_queue(uint8_t idx, void* buffer, uint32_t bufsize) {
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_VERIFY(p_video && buffer && bufsize);
+  TU_VERIFY(p_video->fq_count < CFG_TUH_VIDEO_FRAME_QUEUE);
+
+  uint8_t const wr = (uint8_t) ((p_video->fq_rd + p_video->fq_count) % CFG_TUH_VIDEO_FRAME_QUEUE);
+  p_video->fq[wr].buffer = (uint8_t*) buffer;
+  p_video->fq[wr].size   = bufsize;
+  p_video->fq_count++;
+
+  return true;
+}
+
+bool tuh_video_get_stats(uint8_t idx, tuh_video_stats_t* stats) {
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_VERIFY(p_video && stats);
+  *stats = p_video->stats;
+  return true;
+}
+
+// Class request to streaming interface using probe/commit buffer, continue start process with next stage
+static bool vs_request(videoh_interface_t* p_video, uint8_t idx, uint8_t bRequest, uint8_t selector, uint8_t stage) {
+  tusb_control_request_t const request = {
+    .bmRequestType_bit = {
+      .recipient = TUSB_REQ_RCPT_INTERFACE,
+      .type      = TUSB_REQ_TYPE_CLASS,
+      .direction = (bRequest & 0x80) ? 1u : 0u
+    },
+    .bRequest = bRequest,
+    .wValue   = tu_htole16((uint16_t) (selector << 8)),
+    .wIndex   = tu_htole16((uint16_t) p_video->vs_itf),
+    .wLength  = tu_htole16(p_video->probe_len)
+  };
+
+  tuh_xfer_t xfer = {
+    .daddr       = p_video->daddr,
+    .ep_addr     = 0,
+    .setup       = &request,
+    .buffer      = (uint8_t*) &videoh_epbuf[idx].probe,
+    .complete_cb = start_process,
+    .user_data   = ((uintptr_t) idx << 8) | stage
+  };
+
+  return tuh_control_xfer(&xfer);
+}
+
+bool tuh_video_stream_start(uint8_t idx, uint8_t format_index, uint8_t frame_index, uint32_t interval) {
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_VERIFY(p_video && p_video->mounted && !p_video->running);
+
+  tuh_video_frame_info_t const* frame = NULL;
+  for (uint8_t i = 0; i < p_video->frame_count; i++) {
+    if (p_video->frame[i].format_index == format_index && p_video->frame[i].frame_index == frame_index) {
+      frame = &p_video->frame[i];
+      break;
+    }
+  }
+  TU_VERIFY(frame);
+
+  TU_LOG_DRV("[%u] Video start format %u frame %u (%ux%u)\r\n", p_video->daddr, format_index, frame_index,
+             frame->width, frame->height);
+
+  video_probe_and_commit_control_t* probe = &videoh_epbuf[idx].probe;
+  tu_memclr(probe, sizeof(video_probe_and_commit_control_t));
+  probe->bmHint          = 1; // keep dwFrameInterval
+  probe->bFormatIndex    = format_index;
+  probe->bFrameIndex     = frame_index;
+  probe->dwFrameInterval = tu_htole32(interval ? interval : frame->default_interval);
+
+  return vs_request(p_video, idx, VIDEO_REQUEST_SET_CUR, VIDEO_VS_CTL_PROBE, START_STAGE_PROBE_GET);
+}
+
+static void stop_complete(tuh_xfer_t* xfer) {
+  TU_LOG_DRV("[%u] Video stop: result = %u\r\n", xfer->daddr, xfer->result);
+  (void) xfer;
+}
+
+bool tuh_video_stream_stop(uint8_t idx) {
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_VERIFY(p_video && p_video->mounted);
+
+  // in-flight transfer is not re-submitted on completion
+  p_video->running = false;
+
+  if (p_video->is_iso) {
+    return tuh_interface_set(p_video->daddr, p_video->vs_itf, 0, stop_complete, 0);
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Reassembly
+//--------------------------------------------------------------------+
+
+static void frame_begin(videoh_interface_t* p_video, uint8_t fid) {
+  p_video->rx.in_frame  = true;
+  p_video->rx.fid       = fid;
+  p_video->rx.write_pos = 0;
+  p_video->rx.error     = false;
+  p_video->rx.frame     = frame_queue_head(p_video);
+  p_video->rx.discard   = (p_video->rx.frame == NULL);
+
+  if (p_video->rx.discard) {
+    p_video->stats.drop_no_buffer++;
+  }
+}
+
+// Finish current frame, return the complete frame (buffer is NULL if frame is dropped)
+static videoh_frame_buf_t frame_end(videoh_interface_t* p_video) {
+  videoh_frame_buf_t done = { .buffer = NULL, .size = 0 };
+
+  if (p_video->rx.in_frame && !p_video->rx.discard && p_video->rx.frame) {
+    if (p_video->rx.error) {
+      p_video->stats.drop_error++;
+    } else if (p_video->rx.write_pos) {
+      done.buffer = p_video->rx.frame->buffer;
+      done.size   = p_video->rx.write_pos;
+      frame_queue_pop(p_video);
+      p_video->stats.frames++;
+    }
+  }
+
+  p_video->rx.in_frame  = false;
+  p_video->rx.frame     = NULL;
+  p_video->rx.discard   = false;
+  p_video->rx.error     = false;
+  p_video->rx.write_pos = 0;
+
+  return done;
+}
+
+static void frame_deliver(uint8_t idx, videoh_frame_buf_t const* done) {
+  if (done->buffer && tuh_video_frame_cb) {
+    tuh_video_frame_cb(idx, done->buffer, done->size);
+  }
+}
+
+// Transfer length fitting avail bytes: single packet for isochronous, remaining payload in whole packets for bulk
+static uint32_t rx_xfer_len(videoh_interface_t const* p_video, uint32_t avail) {
+  if (p_video->is_iso) {
+    return (avail >= p_video->packet_size) ? p_video->packet_size : 0;
+  }
+
+  uint32_t const remaining = p_video->max_payload - (p_video->rx.payload_cont ? p_video->rx.payload_rx : 0);
+  avail = tu_min32(avail, UINT16_MAX);
+  return tu_min32(remaining, (avail / p_video->packet_size) * p_video->packet_size);
+}
+
+static void rx_submit(videoh_interface_t* p_video, uint8_t idx) {
+  uint8_t* dst = NULL;
+  uint32_t len = 0;
+  p_video->rx.saved_len = 0;
+
+  #if CFG_TUH_VIDEO_ZERO_COPY
+  // frame buffer that next payload is going to: current frame, or the one that would start
+  videoh_frame_buf_t const* fb = NULL;
+  if (p_video->rx.in_frame) {
+    fb = p_video->rx.discard ? NULL : p_video->rx.frame;
+  } else {
+    fb = frame_queue_head(p_video);
+  }
+
+  if (fb) {
+    uint32_t const pos = p_video->rx.write_pos;
+    uint8_t const hdr = p_video->rx.hdr_len;
+    uint8_t* candidate = NULL;
+
+    if (p_video->rx.payload_cont) {
+      candidate = fb->buffer + pos;         // no header
+    } else if (pos == 0) {
+      candidate = fb->buffer;               // data is moved down by header length once per frame
+    } else if (hdr && hdr <= PAYLOAD_HEADER_MAX && pos >= hdr) {
+      candidate = fb->buffer + pos - hdr;   // header lands over tail of previous payload
+    }
+
+    // DMA needs word-aligned buffer with most HCDs
+    if (candidate && (((uintptr_t) candidate) & 0x03) == 0) {
+      len = rx_xfer_len(p_video, fb->size - (uint32_t) (candidate - fb->buffer));
+      if (len) {
+        dst = candidate;
+        if (!p_video->rx.payload_cont && pos != 0) {
+          memcpy(p_video->rx.saved, candidate, hdr);
+          p_video->rx.saved_len   = hdr;
+          p_video->rx.saved_owner = fb->buffer;
+        }
+      }
+    }
+  }
+  #endif
+
+  if (dst == NULL) {
+    dst = videoh_epbuf[idx].staging;
+    len = rx_xfer_len(p_video, CFG_TUH_VIDEO_EP_BUFSIZE);
+  }
+
+  p_video->rx.xfer_buf = dst;
+  p_video->rx.xfer_len = len;
+  TU_ASSERT(len && usbh_edpt_xfer(p_video->daddr, p_video->desc_ep.bEndpointAddress, dst, len),);
+}
+
+static void rx_complete(videoh_interface_t* p_video, uint8_t idx, uint32_t xferred) {
+  uint8_t* const buf = p_video->rx.xfer_buf;
+  uint8_t* data = buf;
+  uint32_t dlen = xferred;
+  bool valid = p_video->rx.payload_cont; // continuation of bulk payload has no header
+  bool transition = false;
+  videoh_frame_buf_t done = { .buffer = NULL, .size = 0 };
+
+  if (!p_video->rx.payload_cont) {
+    // empty (e.g isochronous without data) or invalid payload
+    if (xferred < 2 || buf[0] < 2 || buf[0] > xferred) {
+      dlen = 0;
+    } else {
+      uint8_t const hdr_len = buf[0];
+      uint8_t const info = buf[1];
+      uint8_t const fid = info & PAYLOAD_HEADER_FID;
+
+      // FID toggle: previous frame is complete even without EOF
+      if (p_video->rx.in_frame && fid != p_video->rx.fid) {
+        done = frame_end(p_video);
+        transition = true;
+      }
+
+      if (!p_video->rx.in_frame) {
+        frame_begin(p_video, fid);
+      }
+
+      if (info & PAYLOAD_HEADER_ERR) {
+        p_video->rx.error = true;
+      }
+
+      valid = true;
+      p_video->rx.hdr_len     = hdr_len;
+      p_video->rx.payload_eof = (info & PAYLOAD_HEADER_EOF) ? true : false;
+      p_video->rx.payload_rx  = 0;
+      data = buf + hdr_len;
+      dlen = xferred - hdr_len;
+    }
+  }
+
+  if (valid) {
+    p_video->rx.payload_rx += xferred;
+    p_video->rx.payload_cont = !p_video->is_iso && (xferred == p_video->rx.xfer_len) &&
+                               (p_video->rx.payload_rx < p_video->max_payload);
+  }
+
+  // place data at write position, no-op if payload was received in place
+  if (dlen && p_video->rx.in_frame && !p_video->rx.discard) {
+    videoh_frame_buf_t* frame = p_video->rx.frame;
+    if (p_video->rx.write_pos + dlen > frame->size) {
+      p_video->rx.discard = true;
+      p_video->stats.drop_overflow++;
+    } else {
+      uint8_t* target = frame->buffer + p_video->rx.write_pos;
+      if (target != data) {
+        memmove(target, data, dlen);
+      }
+      p_video->rx.write_pos += dlen;
+    }
+  }
+
+  // restore bytes of previous payload overwritten by header if they are still part of a frame
+  if (p_video->rx.saved_len) {
+    uint8_t const* owner = p_video->rx.saved_owner;
+    bool const owner_valid = transition ? (owner == done.buffer)
+                                        : (p_video->rx.frame && owner == p_video->rx.frame->buffer);
+    if (owner_valid) {
+      memcpy(buf, p_video->rx.saved, p_video->rx.saved_len);
+    }
+    p_video->rx.saved_len = 0;
+  }
+
+  frame_deliver(idx, &done);
+
+  if (valid && p_video->rx.in_frame && p_video->rx.payload_eof && !p_video->rx.payload_cont) {
+    done = frame_end(p_video);
+    frame_deliver(idx, &done);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Start sequence
+//--------------------------------------------------------------------+
+
+static void start_complete(videoh_interface_t* p_video, uint8_t idx, bool success) {
+  TU_LOG_DRV("  Video start %s\r\n", success ? "OK" : "Failed");
+
+  if (success) {
+    p_video->running = true;
+
+    // a transfer may be still in-flight if stream is restarted quickly, its completion continues streaming
+    if (!usbh_edpt_busy(p_video->daddr, p_video->desc_ep.bEndpointAddress)) {
+      tu_memclr(&p_video->rx, sizeof(p_video->rx));
+      rx_submit(p_video, idx);
+    }
+  }
+
+  if (tuh_video_stream_start_cb) {
+    tuh_video_stream_start_cb(idx, success);
+  }
+}
+
+// select isochronous alternate: smallest one with enough bandwidth, or the largest fitting staging buffer
+static videoh_alt_t const* select_alt(videoh_interface_t const* p_video) {
+  videoh_alt_t const* best = NULL;
+  for (uint8_t i = 0; i < p_video->alt_count; i++) {
+    videoh_alt_t const* alt = &p_video->alt[i];
+    if (alt->packet_size > CFG_TUH_VIDEO_EP_BUFSIZE) continue;
+
+    if (best == NULL) {
+      best = alt;
+    } else if (best->packet_size < p_video->max_payload) {
+      if (alt->packet_size > best->packet_size) best = alt;
+    } else if (alt->packet_size >= p_video->max_payload && alt->packet_size < best->packet_size) {
+      best = alt;
+    }
+  }
+  return best;
+}
+
+static void start_process(tuh_xfer_t* xfer) {
+  uint8_t const idx = (uint8_t) (xfer->user_data >> 8);
+  uint8_t const stage = (uint8_t) (xfer->user_data & 0xFF);
+
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_VERIFY(p_video,);
+
+  if (xfer->result != XFER_RESULT_SUCCESS) {
+    start_complete(p_video, idx, false);
+    return;
+  }
+
+  bool ok = true;
+  switch (stage) {
+    case START_STAGE_PROBE_GET:
+      ok = vs_request(p_video, idx, VIDEO_REQUEST_GET_CUR, VIDEO_VS_CTL_PROBE, START_STAGE_COMMIT);
+      break;
+
+    case START_STAGE_COMMIT: {
+      video_probe_and_commit_control_t const* probe = &videoh_epbuf[idx].probe;
+      p_video->max_frame_size = tu_le32toh(probe->dwMaxVideoFrameSize);
+      p_video->max_payload    = tu_le32toh(probe->dwMaxPayloadTransferSize);
+      if (p_video->max_payload == 0) {
+        p_video->max_payload = CFG_TUH_VIDEO_EP_BUFSIZE;
+      }
+      TU_LOG_DRV("  Probe: max frame = %lu, max payload = %lu\r\n", (unsigned long) p_video->max_frame_size,
+                 (unsigned long) p_video->max_payload);
+
+      ok = vs_request(p_video, idx, VIDEO_REQUEST_SET_CUR, VIDEO_VS_CTL_COMMIT, START_STAGE_SET_INTERFACE);
+      break;
+    }
+
+    case START_STAGE_SET_INTERFACE:
+      if (p_video->is_iso) {
+        videoh_alt_t const* alt = select_alt(p_video);
+        ok = (alt != NULL);
+        if (ok) {
+          TU_LOG_DRV("  Select alt %u, packet size = %u\r\n", alt->alt, alt->packet_size);
+          p_video->packet_size = alt->packet_size;
+          ok = tuh_interface_set(p_video->daddr, p_video->vs_itf, alt->alt, start_process,
+                                 ((uintptr_t) idx << 8) | START_STAGE_RUN);
+        }
+        break;
+      }
+      TU_ATTR_FALLTHROUGH;
+
+    case START_STAGE_RUN:
+      // endpoint is opened once and kept open for all later start/stop
+      if (!p_video->ep_opened) {
+        p_video->ep_opened = tuh_edpt_open(p_video->daddr, &p_video->desc_ep);
+      }
+      start_complete(p_video, idx, p_video->ep_opened);
+      return;
+
+    default: return;
+  }
+
+  if (!ok) {
+    start_complete(p_video, idx, false);
+  }
+}
+
+//--------------------------------------------------------------------+
+// CLASS-USBH API
+//--------------------------------------------------------------------+
+
+bool videoh_init(void) {
+  TU_LOG_DRV("sizeof(videoh_interface_t) = %u\r\n", sizeof(videoh_interface_t));
+  tu_memclr(videoh_data, sizeof(videoh_data));
+  return true;
+}
+
+bool videoh_deinit(void) {
+  return true;
+}
+
+void videoh_close(uint8_t daddr) {
+  for (uint8_t idx = 0; idx < CFG_TUH_VIDEO; idx++) {
+    videoh_interface_t* p_video = &videoh_data[idx];
+    if (p_video->daddr == daddr) {
+      TU_LOG_DRV("  VIDEOh close addr = %u index = %u\r\n", daddr, idx);
+
+      if (p_video->mounted && tuh_video_umount_cb) {
+        tuh_video_umount_cb(idx);
+      }
+
+      tu_memclr(p_video, sizeof(videoh_interface_t));
+    }
+  }
+}
+
+bool videoh_xfer_cb(uint8_t daddr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes) {
+  for (uint8_t idx = 0; idx < CFG_TUH_VIDEO; idx++) {
+    videoh_interface_t* p_video = &videoh_data[idx];
+    if (p_video->daddr != daddr || ep_addr != p_video->desc_ep.bEndpointAddress) continue;
+
+    if (event != XFER_RESULT_SUCCESS) {
+      // isochronous error: packet is lost and streaming continues. Bulk error: stop streaming
+      xferred_bytes = 0;
+      if (!p_video->is_iso) {
+        TU_LOG_DRV("[%u] Video bulk transfer failed, stop streaming\r\n", daddr);
+        p_video->running = false;
+      }
+    }
+
+    rx_complete(p_video, idx, xferred_bytes);
+
+    if (p_video->running) {
+      rx_submit(p_video, idx);
+    }
+    return true;
+  }
+
+  return false;
+}
+
+//--------------------------------------------------------------------+
+// Enumeration
+//--------------------------------------------------------------------+
+
+static void parse_vs_cs_itf(videoh_interface_t* p_video, uint8_t const* p_desc, uint8_t* format_index,
+                            uint8_t* format_subtype) {
+  uint8_t const subtype = p_desc[2];
+
+  switch (subtype) {
+    case VIDEO_CS_ITF_VS_FORMAT_UNCOMPRESSED:
+    case VIDEO_CS_ITF_VS_FORMAT_MJPEG:
+    case VIDEO_CS_ITF_VS_FORMAT_FRAME_BASED:
+      *format_index   = p_desc[3]; // bFormatIndex is at same offset for all formats
+      *format_subtype = subtype;
+      break;
+
+    case VIDEO_CS_ITF_VS_FRAME_UNCOMPRESSED:
+    case VIDEO_CS_ITF_VS_FRAME_MJPEG:
+    case VIDEO_CS_ITF_VS_FRAME_FRAME_BASED: {
+      // frame descriptor subtype follows its format subtype
+      if (*format_subtype + 1 != subtype) break;
+      if (p_video->frame_count >= CFG_TUH_VIDEO_FRAME_MAX) {
+        TU_LOG_DRV("  Frame skipped, CFG_TUH_VIDEO_FRAME_MAX = %u\r\n", CFG_TUH_VIDEO_FRAME_MAX);
+        break;
+      }
+
+      tuh_video_frame_info_t* info = &p_video->frame[p_video->frame_count++];
+      info->format_index = *format_index;
+      info->format       = *format_subtype;
+
+      if (subtype == VIDEO_CS_ITF_VS_FRAME_FRAME_BASED) {
+        tusb_desc_video_frame_framebased_t const* desc = (tusb_desc_video_frame_framebased_t const*) p_desc;
+        info->frame_index      = desc->bFrameIndex;
+        info->width            = tu_le16toh(desc->wWidth);
+        info->height           = tu_le16toh(desc->wHeight);
+        info->default_interval = tu_le32toh(desc->dwDefaultFrameInterval);
+        info->max_frame_size   = 0;
+      } else {
+        // MJPEG frame has same layout as uncompressed
+        tusb_desc_video_frame_uncompressed_t const* desc = (tusb_desc_video_frame_uncompressed_t const*) p_desc;
+        info->frame_index      = desc->bFrameIndex;
+        info->width            = tu_le16toh(desc->wWidth);
+        info->height           = tu_le16toh(desc->wHeight);
+        info->default_interval = tu_le32toh(desc->dwDefaultFrameInterval);
+        info->max_frame_size   = tu_le32toh(desc->dwMaxVideoFrameBufferSize);
+      }
+
+      TU_LOG_DRV("  Format %u Frame %u: %ux%u\r\n", info->format_index, info->frame_index, info->width, info->height);
+      break;
+    }
+
+    default: break;
+  }
+}
+
+// Parse an alternate setting of streaming interface, return pointer to the next interface descriptor
+static uint8_t const* parse_vs_alt(videoh_interface_t* p_video, tusb_desc_interface_t const* desc_itf,
+                                   uint8_t const* p_end) {
+  uint8_t format_index = 0;
+  uint8_t format_subtype = VIDEO_CS_ITF_VS_UNDEFINED;
+  uint8_t const* p_desc = tu_desc_next(desc_itf);
+
+  while (p_desc < p_end && tu_desc_type(p_desc) != TUSB_DESC_INTERFACE && tu_desc_len(p_desc)) {
+    if (tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE && desc_itf->bAlternateSetting == 0) {
+      parse_vs_cs_itf(p_video, p_desc, &format_index, &format_subtype);
+    } else if (tu_desc_type(p_desc) == TUSB_DESC_ENDPOINT) {
+      tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+      uint16_t const mps = tu_le16toh(desc_ep->wMaxPacketSize);
+
+      if (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN) {
+        if (desc_ep->bmAttributes.xfer == TUSB_XFER_BULK && desc_itf->bAlternateSetting == 0) {
+          p_video->is_iso      = false;
+          p_video->desc_ep     = *desc_ep;
+          p_video->packet_size = mps & 0x7FF;
+        } else if (desc_ep->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS) {
+          uint16_t const packet_size = iso_packet_size(desc_ep);
+          if (p_video->alt_count < CFG_TUH_VIDEO_ALT_MAX) {
+            if (p_video->alt_count == 0 || packet_size > iso_packet_size(&p_video->desc_ep)) {
+              // keep descriptor of the largest packet, endpoint is opened once with it
+              p_video->desc_ep = *desc_ep;
+            }
+            p_video->is_iso = true;
+            p_video->alt[p_video->alt_count].alt         = desc_itf->bAlternateSetting;
+            p_video->alt[p_video->alt_count].packet_size = packet_size;
+            p_video->alt_count++;
+          }
+        }
+      }
+    }
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  return p_desc;
+}
+
+bool videoh_open(uint8_t rhport, uint8_t daddr, tusb_desc_interface_t const *itf_desc, uint16_t max_len) {
+  (void) rhport;
+  TU_VERIFY(TUSB_CLASS_VIDEO == itf_desc->bInterfaceClass && VIDEO_SUBCLASS_CONTROL == itf_desc->bInterfaceSubClass);
+
+  videoh_interface_t* p_video = NULL;
+  for (uint8_t i = 0; i < CFG_TUH_VIDEO; i++) {
+    if (videoh_data[i].daddr == 0) {
+      p_video = &videoh_data[i];
+      break;
+    }
+  }
+  TU_VERIFY(p_video);
+
+  TU_LOG_DRV("VIDEO opening Interface %u (addr = %u)\r\n", itf_desc->bInterfaceNumber, daddr);
+  tu_memclr(p_video, sizeof(videoh_interface_t));
+  p_video->daddr     = daddr;
+  p_video->vc_itf    = itf_desc->bInterfaceNumber;
+  p_video->itf_count = 1;
+  p_video->probe_len = 26;
+
+  uint8_t const* p_end  = ((uint8_t const*) itf_desc) + max_len;
+  uint8_t const* p_desc = tu_desc_next(itf_desc);
+
+  //------------- Video Control -------------//
+  while (p_desc < p_end && tu_desc_type(p_desc) != TUSB_DESC_INTERFACE && tu_desc_len(p_desc)) {
+    // interrupt endpoint and units are not used
+    if (tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE && p_desc[2] == VIDEO_CS_ITF_VC_HEADER) {
+      uint16_t const bcd_uvc = tu_le16toh(((tusb_desc_video_control_header_t const*) p_desc)->bcdUVC);
+      p_video->probe_len = (bcd_uvc >= 0x0150) ? 48 : (bcd_uvc >= 0x0110) ? 34 : 26;
+    }
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  //------------- Video Streaming -------------//
+  bool has_vs = false;
+  while (p_desc < p_end && tu_desc_len(p_desc)) {
+    if (tu_desc_type(p_desc) != TUSB_DESC_INTERFACE) {
+      p_desc = tu_desc_next(p_desc);
+      continue;
+    }
+
+    tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*) p_desc;
+    uint8_t const itf_offset = (uint8_t) (desc_itf->bInterfaceNumber - p_video->vc_itf);
+    p_video->itf_count = tu_max8(p_video->itf_count, (uint8_t) (itf_offset + 1));
+
+    // only the first streaming interface is used, the others are bound to this driver but ignored
+    if (TUSB_CLASS_VIDEO == desc_itf->bInterfaceClass && VIDEO_SUBCLASS_STREAMING == desc_itf->bInterfaceSubClass &&
+        (!has_vs || desc_itf->bInterfaceNumber == p_video->vs_itf)) {
+      has_vs = true;
+      p_video->vs_itf = desc_itf->bInterfaceNumber;
+      p_desc = parse_vs_alt(p_video, desc_itf, p_end);
+    } else {
+      p_desc = tu_desc_next(p_desc);
+    }
+  }
+
+  return true;
+}
+
+bool videoh_set_config(uint8_t daddr, uint8_t itf_num) {
+  uint8_t const idx = tuh_video_itf_get_index(daddr, itf_num);
+  videoh_interface_t* p_video = get_itf(idx);
+  TU_ASSERT(p_video);
+
+  TU_LOG_DRV("VIDEOh Set Configure complete\r\n");
+  p_video->mounted = true;
+  if (tuh_video_mount_cb) {
+    tuh_video_mount_cb(idx);
+  }
+
+  // notify usbh that driver enumeration is complete, skip all interfaces of this function
+  usbh_driver_set_config_complete(daddr, (uint8_t) (itf_num + p_video->itf_count - 1));
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_VIDEO_HOST_H_
+#define _TUSB_VIDEO_HOST_H_
+
+#include "video.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+
+// Max number of frame descriptors (of all formats) parsed from streaming interface, others are ignored
+#ifndef CFG_TUH_VIDEO_FRAME_MAX
+#define CFG_TUH_VIDEO_FRAME_MAX     8
+#endif
+
+// Max number of isochronous alternate settings parsed from streaming interface
+#ifndef CFG_TUH_VIDEO_ALT_MAX
+#define CFG_TUH_VIDEO_ALT_MAX       8
+#endif
+
+// Number of application frame buffers that can be queued
+#ifndef CFG_TUH_VIDEO_FRAME_QUEUE
+#define CFG_TUH_VIDEO_FRAME_QUEUE   2
+#endif
+
+// Staging endpoint buffer, used when a payload can not be received into frame buffer directly (or is dropped).
+// Must be at least the isochronous packet size (wMaxPacketSize x transactions) of the used alternate setting.
+#ifndef CFG_TUH_VIDEO_EP_BUFSIZE
+#define CFG_TUH_VIDEO_EP_BUFSIZE    1024
+#endif
+
+// Receive payloads directly into application frame buffer, header is parsed in place and overwritten bytes of
+// previous payload are restored. Should be disabled if HCD does DMA with cache maintenance on unaligned buffers.
+#ifndef CFG_TUH_VIDEO_ZERO_COPY
+#define CFG_TUH_VIDEO_ZERO_COPY     (CFG_TUH_MEM_DCACHE_ENABLE ? 0 : 1)
+#endif
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+
+// Frame descriptor information
+typedef struct {
+  uint8_t format_index;       // bFormatIndex
+  uint8_t frame_index;        // bFrameIndex
+  uint8_t format;             // format descriptor subtype e.g VIDEO_CS_ITF_VS_FORMAT_MJPEG
+  uint16_t width;
+  uint16_t height;
+  uint32_t default_interval;  // 100ns unit
+  uint32_t max_frame_size;    // dwMaxVideoFrameBufferSize, 0 if not available (frame based)
+} tuh_video_frame_info_t;
+
+typedef struct {
+  uint32_t frames;            // frames delivered to application
+  uint32_t drop_no_buffer;    // frames dropped since no buffer was queued
+  uint32_t drop_overflow;     // frames dropped since they are larger than queued buffer
+  uint32_t drop_error;        // frames dropped since device reported error in payload header
+} tuh_video_stats_t;
+
+// Get Interface index from device address + interface number (Video Control interface)
+// return TUSB_INDEX_INVALID_8 (0xFF) if not found
+uint8_t tuh_video_itf_get_index(uint8_t daddr, uint8_t itf_num);
+
+// Check if a interface is mounted
+bool tuh_video_mounted(uint8_t idx);
+
+// Number of parsed frame descriptors
+uint8_t tuh_video_frame_count(uint8_t idx);
+
+// Get n-th frame descriptor information
+bool tuh_video_frame_get_info(uint8_t idx, uint8_t n, tuh_video_frame_info_t* info);
+
+// Start streaming: probe/commit format, frame and interval (100ns unit, 0 for default) then select alternate setting
+// with enough bandwidth (isochronous). Requests are asynchronous, tuh_video_stream_start_cb() is invoked with result.
+bool tuh_video_stream_start(uint8_t idx, uint8_t format_index, uint8_t frame_index, uint32_t interval);
+
+// Stop streaming: transfers are not re-submitted, alternate setting 0 is selected for isochronous
+bool tuh_video_stream_stop(uint8_t idx);
+
+// Check if streaming is running
+bool tuh_video_streaming(uint8_t idx);
+
+// Max frame size negotiated by commit, use to allocate frame buffers. 0 if not started
+uint32_t tuh_video_max_frame_size(uint8_t idx);
+
+// Queue a frame buffer, which is owned by driver until returned with tuh_video_frame_cb() or device is unmounted.
+// Return false if queue is full
+bool tuh_video_frame_queue(uint8_t idx, void* buffer, uint32_t bufsize);
+
+// Get frame & drop counters
+bool tuh_video_get_stats(uint8_t idx, tuh_video_stats_t* stats);
+
+//--------------------------------------------------------------------+
+// VIDEO APPLICATION CALLBACKS
+//--------------------------------------------------------------------+
+
+// Invoked when a device with Video Class function is mounted
+TU_ATTR_WEAK extern void tuh_video_mount_cb(uint8_t idx);
+
+// Invoked when a device with Video Class function is unmounted
+TU_ATTR_WEAK extern void tuh_video_umount_cb(uint8_t idx);
+
+// Invoked when tuh_video_stream_start() is complete, streaming is running if success is true
+TU_ATTR_WEAK extern void tuh_video_stream_start_cb(uint8_t idx, bool success);
+
+// Invoked when a frame is complete, buffer is returned to application and can be queued again
+TU_ATTR_WEAK extern void tuh_video_frame_cb(uint8_t idx, uint8_t* buffer, uint32_t len);
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+bool videoh_init       (void);
+bool videoh_deinit     (void);
+bool videoh_open       (uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t max_len);
+bool videoh_set_config (uint8_t dev_addr, uint8_t itf_num);
+bool videoh_xfer_cb    (uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void videoh_close      (uint8_t dev_addr);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_VIDEO_HOST_H_ */
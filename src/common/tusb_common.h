@@ -77,6 +77,16 @@
 #include "tusb_types.h"
 #include "tusb_debug.h"
 
+//--------------------------------------------------------------------+
+// API Implemented by user
+//--------------------------------------------------------------------+
+
+// Get current milliseconds, required by some port/configuration without RTOS
+uint32_t tusb_time_millis_api(void);
+
+// Delay in milliseconds, use tusb_time_millis_api() by default. required by some port/configuration with no RTOS
+void tusb_time_delay_ms_api(uint32_t ms);
+
 //--------------------------------------------------------------------+
 // Optional API implemented by application if needed
 // TODO move to a more obvious place/file
@@ -120,6 +130,30 @@ TU_ATTR_ALWAYS_INLINE static inline int tu_memcpy_s(void *dest, size_t destsz, c
   return 0;
 }
 
+// Check if buffer lies within memory region [base, base + region_size)
+TU_ATTR_ALWAYS_INLINE static inline bool tu_mem_within(const void* addr, uint32_t size, uintptr_t base, uint32_t region_size) {
+  const uintptr_t addr_u = (uintptr_t) addr;
+  return region_size != 0 && addr_u >= base && size <= region_size && (addr_u - base) <= (region_size - size);
+}
+
+// Range of adjacent buffers, used to do a single cache maintenance on a chain of buffers
+typedef struct {
+  uintptr_t start;
+  uint32_t size;
+} tu_mem_range_t;
+
+// Append buffer to range if range is empty or buffer follows it directly, return false (range unchanged) otherwise
+TU_ATTR_ALWAYS_INLINE static inline bool tu_mem_range_append(tu_mem_range_t* range, const void* addr, uint32_t size) {
+  const uintptr_t addr_u = (uintptr_t) addr;
+  if (range->size == 0) {
+    range->start = addr_u;
+  } else if (addr_u != range->start + range->size) {
+    return false;
+  }
+  range->size += size;
+  return true;
+}
+
 
 //------------- Bytes -------------//
 TU_ATTR_ALWAYS_INLINE static inline uint32_t tu_u32(uint8_t b3, uint8_t b2, uint8_t b1, uint8_t b0) {
@@ -198,6 +232,14 @@ static inline bool tu_is_power_of_two(uint32_t value)
    return (value != 0) && ((value & (value - 1)) == 0);
 }
 
+//------------- Timer -------------//
+// Non-blocking timer polled by task: return time until timer started at start_ms expires, 0 if expired.
+// Clock such as frame number can tick right after timer is started, wait 1 more to have at least timer_ms
+TU_ATTR_ALWAYS_INLINE static inline uint32_t tu_timer_remaining(uint32_t start_ms, uint32_t timer_ms, uint32_t now_ms) {
+  uint32_t const elapsed = now_ms - start_ms;
+  return (elapsed <= timer_ms) ? (timer_ms + 1 - elapsed) : 0;
+}
+
 //------------- Unaligned Access -------------//
 #if TUP_ARCH_STRICT_ALIGN
 
@@ -164,6 +164,57 @@ static inline const char* tu_lookup_find(tu_lookup_table_t const* p_table, uint3
   #define TU_LOG3_HEX(...)
 #endif
 
+//--------------------------------------------------------------------+
+// Trace
+//--------------------------------------------------------------------+
+
+// Trace record ID. Keep in sync with tools/trace_decode.py
+enum {
+  TU_TRACE_DCD_EVENT = 1, // arg8: event id, arg16: ep_addr, arg32: xferred bytes or frame count
+  TU_TRACE_HCD_EVENT,     // arg8: event id, arg16: daddr << 8 | ep_addr, arg32: xferred bytes
+  TU_TRACE_DCD_XFER,      // arg8: 1 if fifo, arg16: ep_addr, arg32: total bytes
+  TU_TRACE_HCD_XFER,      // arg8: 0, arg16: daddr << 8 | ep_addr, arg32: total bytes
+  TU_TRACE_CB_ENTER,      // arg8: 1 if host, arg16: (daddr << 8) | ep_addr, arg32: xferred bytes
+  TU_TRACE_CB_EXIT,       // arg8: 1 if host, arg16: (daddr << 8) | ep_addr, arg32: 0
+  TU_TRACE_FIFO_LEVEL,    // arg8: 1 if host, arg16: (daddr << 8) | ep_addr, arg32: bytes in fifo
+  TU_TRACE_CTRL_ENTER,    // arg8: control stage, arg16: wIndex, arg32: (bmRequestType << 8) | bRequest
+  TU_TRACE_CTRL_EXIT,     // arg8: control stage, arg16: wIndex, arg32: 1 if request is accepted
+  TU_TRACE_USER = 0x80    // 0x80 - 0xFF can be used by application
+};
+
+typedef struct {
+  uint32_t timestamp; // from tusb_trace_timestamp_cb()
+  uint8_t  id;
+  uint8_t  arg8;
+  uint16_t arg16;
+  uint32_t arg32;
+} tu_trace_record_t;
+
+typedef struct {
+  uint32_t magic;          // TU_TRACE_MAGIC, to locate the buffer in a memory dump
+  uint16_t count;          // CFG_TUSB_TRACE_COUNT
+  uint16_t record_size;    // sizeof(tu_trace_record_t)
+  volatile uint32_t index; // number of records written, next one is at index % count
+  tu_trace_record_t records[CFG_TUSB_TRACE_COUNT];
+} tu_trace_buffer_t;
+
+#define TU_TRACE_MAGIC  0x52545554u // "TUTR"
+
+#if CFG_TUSB_TRACE
+extern tu_trace_buffer_t tu_trace_buf;
+
+// Invoked to timestamp a trace record e.g return DWT->CYCCNT on Cortex-M or current SOF frame number.
+// Default returns 0, records are still in order
+uint32_t tusb_trace_timestamp_cb(void);
+
+void tu_trace_record(uint8_t id, uint8_t arg8, uint16_t arg16, uint32_t arg32);
+
+  #define TU_TRACE(_id, _arg8, _arg16, _arg32) \
+    tu_trace_record(_id, (uint8_t) (_arg8), (uint16_t) (_arg16), (uint32_t) (_arg32))
+#else
+  #define TU_TRACE(_id, _arg8, _arg16, _arg32)
+#endif
+
 #ifdef __cplusplus
  }
 #endif
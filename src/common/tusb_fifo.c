@@ -36,7 +36,7 @@
 #pragma diag_suppress = Pa082
 #endif
 
-#if OSAL_MUTEX_REQUIRED
+#if OSAL_MUTEX_REQUIRED && !CFG_TUSB_FIFO_SPSC
 
 TU_ATTR_ALWAYS_INLINE static inline void _ff_lock(osal_mutex_t mutex)
 {
@@ -55,6 +55,16 @@ TU_ATTR_ALWAYS_INLINE static inline void _ff_unlock(osal_mutex_t mutex)
 
 #endif
 
+// In SPSC mode, the other side's index is loaded with acquire and own index is stored with release semantic
+// so that buffer access is not reordered across the index update. Without SPSC, mutexes provide the ordering.
+#if CFG_TUSB_FIFO_SPSC && defined(__GNUC__)
+  #define _ff_load_idx(_idx)        __atomic_load_n(&(_idx), __ATOMIC_ACQUIRE)
+  #define _ff_store_idx(_idx, _val) __atomic_store_n(&(_idx), _val, __ATOMIC_RELEASE)
+#else
+  #define _ff_load_idx(_idx)        (_idx)
+  #define _ff_store_idx(_idx, _val) ((_idx) = (_val))
+#endif
+
 /** \enum tu_fifo_copy_mode_t
  * \brief Write modes intended to allow special read and write functions to be able to
  *        copy data to and from USB hardware FIFOs as needed for e.g. STM32s and others
@@ -67,12 +77,12 @@ typedef enum
 #endif
 } tu_fifo_copy_mode_t;
 
-bool tu_fifo_config(tu_fifo_t *f, void* buffer, uint16_t depth, uint16_t item_size, bool overwritable)
+bool tu_fifo_config(tu_fifo_t *f, void* buffer, tu_fifo_size_t depth, uint16_t item_size, bool overwritable)
 {
   // Limit index space to 2*depth - this allows for a fast "modulo" calculation
-  // but limits the maximum depth to 2^16/2 = 2^15 and buffer overflows are detectable
-  // only if overflow happens once (important for unsupervised DMA applications)
-  if (depth > 0x8000) return false;
+  // but limits the maximum depth to 2^16/2 = 2^15 (2^30 with CFG_TUSB_FIFO_32BIT) and buffer overflows
+  // are detectable only if overflow happens once (important for unsupervised DMA applications)
+  if (depth > TU_FIFO_DEPTH_MAX) return false;
 
   _ff_lock(f->mutex_wr);
   _ff_lock(f->mutex_rd);
@@ -98,12 +108,12 @@ bool tu_fifo_config(tu_fifo_t *f, void* buffer, uint16_t depth, uint16_t item_si
 // Intended to be used to read from hardware USB FIFO in e.g. STM32 where all data is read from a constant address
 // Code adapted from dcd_synopsys.c
 // TODO generalize with configurable 1 byte or 4 byte each read
-static void _ff_push_const_addr(uint8_t * ff_buf, const void * app_buf, uint16_t len)
+TU_ATTR_FAST_FUNC static void _ff_push_const_addr(uint8_t * ff_buf, const void * app_buf, uint32_t len)
 {
   volatile const uint32_t * reg_rx = (volatile const uint32_t *) app_buf;
 
   // Reading full available 32 bit words from const app address
-  uint16_t full_words = len >> 2;
+  uint32_t full_words = len >> 2;
   while(full_words--)
   {
     tu_unaligned_write32(ff_buf, *reg_rx);
@@ -111,7 +121,7 @@ static void _ff_push_const_addr(uint8_t * ff_buf, const void * app_buf, uint16_t
   }
 
   // Read the remaining 1-3 bytes from const app address
-  uint8_t const bytes_rem = len & 0x03;
+  uint8_t const bytes_rem = (uint8_t) (len & 0x03);
   if ( bytes_rem )
   {
     uint32_t tmp32 = *reg_rx;
@@ -121,12 +131,12 @@ static void _ff_push_const_addr(uint8_t * ff_buf, const void * app_buf, uint16_t
 
 // Intended to be used to write to hardware USB FIFO in e.g. STM32
 // where all data is written to a constant address in full word copies
-static void _ff_pull_const_addr(void * app_buf, const uint8_t * ff_buf, uint16_t len)
+TU_ATTR_FAST_FUNC static void _ff_pull_const_addr(void * app_buf, const uint8_t * ff_buf, uint32_t len)
 {
   volatile uint32_t * reg_tx = (volatile uint32_t *) app_buf;
 
   // Write full available 32 bit words to const address
-  uint16_t full_words = len >> 2;
+  uint32_t full_words = len >> 2;
   while(full_words--)
   {
     *reg_tx = tu_unaligned_read32(ff_buf);
@@ -134,7 +144,7 @@ static void _ff_pull_const_addr(void * app_buf, const uint8_t * ff_buf, uint16_t
   }
 
   // Write the remaining 1-3 bytes into const address
-  uint8_t const bytes_rem = len & 0x03;
+  uint8_t const bytes_rem = (uint8_t) (len & 0x03);
   if ( bytes_rem )
   {
     uint32_t tmp32 = 0;
@@ -145,20 +155,66 @@ static void _ff_pull_const_addr(void * app_buf, const uint8_t * ff_buf, uint16_t
 }
 #endif
 
+// Copy using word (4 words burst) access if both buffers are word-aligned since memcpy() of some
+// libc e.g newlib-nano is byte by byte. Fixed size memcpy() compiles to word loads/stores without aliasing the caller's
+// buffer (e.g int16_t samples) as uint32_t. Remaining bytes and unaligned buffers use memcpy() with runtime length.
+TU_ATTR_FAST_FUNC static void _ff_memcpy(void* dst, void const* src, uint32_t len)
+{
+  if ( (len >= 4) && (0 == ((((uintptr_t) dst) | ((uintptr_t) src)) & 3u)) )
+  {
+    uint8_t* dst8 = (uint8_t*) dst;
+    uint8_t const* src8 = (uint8_t const*) src;
+
+    while (len >= 16)
+    {
+      memcpy(dst8, src8, 16);
+      dst8 += 16;
+      src8 += 16;
+      len -= 16;
+    }
+
+    while (len >= 4)
+    {
+      memcpy(dst8, src8, 4);
+      dst8 += 4;
+      src8 += 4;
+      len -= 4;
+    }
+
+    dst = dst8;
+    src = src8;
+  }
+
+  if (len) memcpy(dst, src, len);
+}
+
+// Copy one item. Common item sizes use fixed size copies that compile to a single load/store instead of a memcpy()
+// call with runtime length
+TU_ATTR_ALWAYS_INLINE static inline void _ff_copy_item(void* dst, void const* src, uint16_t item_size)
+{
+  switch (item_size)
+  {
+    case 1: *((uint8_t*) dst) = *((uint8_t const*) src); break;
+    case 2: memcpy(dst, src, 2); break;
+    case 4: memcpy(dst, src, 4); break;
+    default: memcpy(dst, src, item_size); break;
+  }
+}
+
 // send one item to fifo WITHOUT updating write pointer
-static inline void _ff_push(tu_fifo_t* f, void const * app_buf, uint16_t rel)
+static inline void _ff_push(tu_fifo_t* f, void const * app_buf, tu_fifo_size_t rel)
 {
-  memcpy(f->buffer + (rel * f->item_size), app_buf, f->item_size);
+  _ff_copy_item(f->buffer + (rel * f->item_size), app_buf, f->item_size);
 }
 
 // send n items to fifo WITHOUT updating write pointer
-static void _ff_push_n(tu_fifo_t* f, void const * app_buf, uint16_t n, uint16_t wr_ptr, tu_fifo_copy_mode_t copy_mode)
+TU_ATTR_FAST_FUNC static void _ff_push_n(tu_fifo_t* f, void const * app_buf, tu_fifo_size_t n, tu_fifo_size_t wr_ptr, tu_fifo_copy_mode_t copy_mode)
 {
-  uint16_t const lin_count = f->depth - wr_ptr;
-  uint16_t const wrap_count = n - lin_count;
+  tu_fifo_size_t const lin_count = f->depth - wr_ptr;
+  tu_fifo_size_t const wrap_count = n - lin_count;
 
-  uint16_t lin_bytes = lin_count * f->item_size;
-  uint16_t wrap_bytes = wrap_count * f->item_size;
+  uint32_t lin_bytes = lin_count * f->item_size;
+  uint32_t wrap_bytes = wrap_count * f->item_size;
 
   // current buffer of fifo
   uint8_t* ff_buf = f->buffer + (wr_ptr * f->item_size);
@@ -169,18 +225,18 @@ static void _ff_push_n(tu_fifo_t* f, void const * app_buf, uint16_t n, uint16_t
       if(n <= lin_count)
       {
         // Linear only
-        memcpy(ff_buf, app_buf, n*f->item_size);
+        _ff_memcpy(ff_buf, app_buf, (uint32_t) n * f->item_size);
       }
       else
       {
         // Wrap around
 
         // Write data to linear part of buffer
-        memcpy(ff_buf, app_buf, lin_bytes);
+        _ff_memcpy(ff_buf, app_buf, lin_bytes);
 
         // Write data wrapped around
         // TU_ASSERT(nWrap_bytes <= f->depth, );
-        memcpy(f->buffer, ((uint8_t const*) app_buf) + lin_bytes, wrap_bytes);
+        _ff_memcpy(f->buffer, ((uint8_t const*) app_buf) + lin_bytes, wrap_bytes);
       }
       break;
 #ifdef TUP_MEM_CONST_ADDR
@@ -189,24 +245,24 @@ static void _ff_push_n(tu_fifo_t* f, void const * app_buf, uint16_t n, uint16_t
       if(n <= lin_count)
       {
         // Linear only
-        _ff_push_const_addr(ff_buf, app_buf, n*f->item_size);
+        _ff_push_const_addr(ff_buf, app_buf, (uint32_t) n * f->item_size);
       }
       else
       {
         // Wrap around case
 
         // Write full words to linear part of buffer
-        uint16_t nLin_4n_bytes = lin_bytes & 0xFFFC;
+        uint32_t nLin_4n_bytes = lin_bytes & ~3u;
         _ff_push_const_addr(ff_buf, app_buf, nLin_4n_bytes);
         ff_buf += nLin_4n_bytes;
 
         // There could be odd 1-3 bytes before the wrap-around boundary
-        uint8_t rem = lin_bytes & 0x03;
+        uint8_t rem = (uint8_t) (lin_bytes & 0x03);
         if (rem > 0)
         {
           volatile const uint32_t * rx_fifo = (volatile const uint32_t *) app_buf;
 
-          uint8_t remrem = (uint8_t) tu_min16(wrap_bytes, 4-rem);
+          uint8_t remrem = (uint8_t) tu_min32(wrap_bytes, 4u-rem);
           wrap_bytes -= remrem;
 
           uint32_t tmp32 = *rx_fifo;
@@ -234,19 +290,19 @@ static void _ff_push_n(tu_fifo_t* f, void const * app_buf, uint16_t n, uint16_t
 }
 
 // get one item from fifo WITHOUT updating read pointer
-static inline void _ff_pull(tu_fifo_t* f, void * app_buf, uint16_t rel)
+static inline void _ff_pull(tu_fifo_t* f, void * app_buf, tu_fifo_size_t rel)
 {
-  memcpy(app_buf, f->buffer + (rel * f->item_size), f->item_size);
+  _ff_copy_item(app_buf, f->buffer + (rel * f->item_size), f->item_size);
 }
 
 // get n items from fifo WITHOUT updating read pointer
-static void _ff_pull_n(tu_fifo_t* f, void* app_buf, uint16_t n, uint16_t rd_ptr, tu_fifo_copy_mode_t copy_mode)
+TU_ATTR_FAST_FUNC static void _ff_pull_n(tu_fifo_t* f, void* app_buf, tu_fifo_size_t n, tu_fifo_size_t rd_ptr, tu_fifo_copy_mode_t copy_mode)
 {
-  uint16_t const lin_count = f->depth - rd_ptr;
-  uint16_t const wrap_count = n - lin_count; // only used if wrapped
+  tu_fifo_size_t const lin_count = f->depth - rd_ptr;
+  tu_fifo_size_t const wrap_count = n - lin_count; // only used if wrapped
 
-  uint16_t lin_bytes = lin_count * f->item_size;
-  uint16_t wrap_bytes = wrap_count * f->item_size;
+  uint32_t lin_bytes = lin_count * f->item_size;
+  uint32_t wrap_bytes = wrap_count * f->item_size;
 
   // current buffer of fifo
   uint8_t* ff_buf = f->buffer + (rd_ptr * f->item_size);
@@ -257,17 +313,17 @@ static void _ff_pull_n(tu_fifo_t* f, void* app_buf, uint16_t n, uint16_t rd_ptr,
       if ( n <= lin_count )
       {
         // Linear only
-        memcpy(app_buf, ff_buf, n*f->item_size);
+        _ff_memcpy(app_buf, ff_buf, (uint32_t) n * f->item_size);
       }
       else
       {
         // Wrap around
 
         // Read data from linear part of buffer
-        memcpy(app_buf, ff_buf, lin_bytes);
+        _ff_memcpy(app_buf, ff_buf, lin_bytes);
 
         // Read data wrapped part
-        memcpy((uint8_t*) app_buf + lin_bytes, f->buffer, wrap_bytes);
+        _ff_memcpy((uint8_t*) app_buf + lin_bytes, f->buffer, wrap_bytes);
       }
     break;
 #ifdef TUP_MEM_CONST_ADDR
@@ -275,24 +331,24 @@ static void _ff_pull_n(tu_fifo_t* f, void* app_buf, uint16_t n, uint16_t rd_ptr,
       if ( n <= lin_count )
       {
         // Linear only
-        _ff_pull_const_addr(app_buf, ff_buf, n*f->item_size);
+        _ff_pull_const_addr(app_buf, ff_buf, (uint32_t) n * f->item_size);
       }
       else
       {
         // Wrap around case
 
         // Read full words from linear part of buffer
-        uint16_t lin_4n_bytes = lin_bytes & 0xFFFC;
+        uint32_t lin_4n_bytes = lin_bytes & ~3u;
         _ff_pull_const_addr(app_buf, ff_buf, lin_4n_bytes);
         ff_buf += lin_4n_bytes;
 
         // There could be odd 1-3 bytes before the wrap-around boundary
-        uint8_t rem = lin_bytes & 0x03;
+        uint8_t rem = (uint8_t) (lin_bytes & 0x03);
         if (rem > 0)
         {
           volatile uint32_t * reg_tx = (volatile uint32_t *) app_buf;
 
-          uint8_t remrem = (uint8_t) tu_min16(wrap_bytes, 4-rem);
+          uint8_t remrem = (uint8_t) tu_min32(wrap_bytes, 4u-rem);
           wrap_bytes -= remrem;
 
           uint32_t tmp32=0;
@@ -325,25 +381,31 @@ static void _ff_pull_n(tu_fifo_t* f, void* app_buf, uint16_t n, uint16_t rd_ptr,
 // Helper
 //--------------------------------------------------------------------+
 
+#if CFG_TUSB_FIFO_32BIT
+  #define _ff_min   tu_min32
+#else
+  #define _ff_min   tu_min16
+#endif
+
 // return only the index difference and as such can be used to determine an overflow i.e overflowable count
 TU_ATTR_ALWAYS_INLINE static inline
-uint16_t _ff_count(uint16_t depth, uint16_t wr_idx, uint16_t rd_idx)
+tu_fifo_size_t _ff_count(tu_fifo_size_t depth, tu_fifo_size_t wr_idx, tu_fifo_size_t rd_idx)
 {
   // In case we have non-power of two depth we need a further modification
   if (wr_idx >= rd_idx)
   {
-    return (uint16_t) (wr_idx - rd_idx);
+    return (tu_fifo_size_t) (wr_idx - rd_idx);
   } else
   {
-    return (uint16_t) (2*depth - (rd_idx - wr_idx));
+    return (tu_fifo_size_t) (2*depth - (rd_idx - wr_idx));
   }
 }
 
 // return remaining slot in fifo
 TU_ATTR_ALWAYS_INLINE static inline
-uint16_t _ff_remaining(uint16_t depth, uint16_t wr_idx, uint16_t rd_idx)
+tu_fifo_size_t _ff_remaining(tu_fifo_size_t depth, tu_fifo_size_t wr_idx, tu_fifo_size_t rd_idx)
 {
-  uint16_t const count = _ff_count(depth, wr_idx, rd_idx);
+  tu_fifo_size_t const count = _ff_count(depth, wr_idx, rd_idx);
   return (depth > count) ? (depth - count) : 0;
 }
 
@@ -353,16 +415,16 @@ uint16_t _ff_remaining(uint16_t depth, uint16_t wr_idx, uint16_t rd_idx)
 
 // Advance an absolute index
 // "absolute" index is only in the range of [0..2*depth)
-static uint16_t advance_index(uint16_t depth, uint16_t idx, uint16_t offset)
+static tu_fifo_size_t advance_index(tu_fifo_size_t depth, tu_fifo_size_t idx, tu_fifo_size_t offset)
 {
   // We limit the index space of p such that a correct wrap around happens
   // Check for a wrap around or if we are in unused index space - This has to be checked first!!
   // We are exploiting the wrap around to the correct index
-  uint16_t new_idx = (uint16_t) (idx + offset);
+  tu_fifo_size_t new_idx = (tu_fifo_size_t) (idx + offset);
   if ( (idx > new_idx) || (new_idx >= 2*depth) )
   {
-    uint16_t const non_used_index_space = (uint16_t) (UINT16_MAX - (2*depth-1));
-    new_idx = (uint16_t) (new_idx + non_used_index_space);
+    tu_fifo_size_t const non_used_index_space = (tu_fifo_size_t) (TU_FIFO_SIZE_MAX - (2*depth-1));
+    new_idx = (tu_fifo_size_t) (new_idx + non_used_index_space);
   }
 
   return new_idx;
@@ -370,16 +432,16 @@ static uint16_t advance_index(uint16_t depth, uint16_t idx, uint16_t offset)
 
 #if 0 // not used but
 // Backward an absolute index
-static uint16_t backward_index(uint16_t depth, uint16_t idx, uint16_t offset)
+static tu_fifo_size_t backward_index(tu_fifo_size_t depth, tu_fifo_size_t idx, tu_fifo_size_t offset)
 {
   // We limit the index space of p such that a correct wrap around happens
   // Check for a wrap around or if we are in unused index space - This has to be checked first!!
   // We are exploiting the wrap around to the correct index
-  uint16_t new_idx = (uint16_t) (idx - offset);
+  tu_fifo_size_t new_idx = (tu_fifo_size_t) (idx - offset);
   if ( (idx < new_idx) || (new_idx >= 2*depth) )
   {
-    uint16_t const non_used_index_space = (uint16_t) (UINT16_MAX - (2*depth-1));
-    new_idx = (uint16_t) (new_idx - non_used_index_space);
+    tu_fifo_size_t const non_used_index_space = (tu_fifo_size_t) (TU_FIFO_SIZE_MAX - (2*depth-1));
+    new_idx = (tu_fifo_size_t) (new_idx - non_used_index_space);
   }
 
   return new_idx;
@@ -388,7 +450,7 @@ static uint16_t backward_index(uint16_t depth, uint16_t idx, uint16_t offset)
 
 // index to pointer, simply an modulo with minus.
 TU_ATTR_ALWAYS_INLINE static inline
-uint16_t idx2ptr(uint16_t depth, uint16_t idx)
+tu_fifo_size_t idx2ptr(tu_fifo_size_t depth, tu_fifo_size_t idx)
 {
   // Only run at most 3 times since index is limit in the range of [0..2*depth)
   while ( idx >= depth ) idx -= depth;
@@ -399,9 +461,9 @@ uint16_t idx2ptr(uint16_t depth, uint16_t idx)
 // When an overwritable fifo is overflowed, rd_idx will be re-index so that it forms
 // an full fifo i.e _ff_count() = depth
 TU_ATTR_ALWAYS_INLINE static inline
-uint16_t _ff_correct_read_index(tu_fifo_t* f, uint16_t wr_idx)
+tu_fifo_size_t _ff_correct_read_index(tu_fifo_t* f, tu_fifo_size_t wr_idx)
 {
-  uint16_t rd_idx;
+  tu_fifo_size_t rd_idx;
   if ( wr_idx >= f->depth )
   {
     rd_idx = wr_idx - f->depth;
@@ -417,9 +479,9 @@ uint16_t _ff_correct_read_index(tu_fifo_t* f, uint16_t wr_idx)
 
 // Works on local copies of w and r
 // Must be protected by mutexes since in case of an overflow read pointer gets modified
-static bool _tu_fifo_peek(tu_fifo_t* f, void * p_buffer, uint16_t wr_idx, uint16_t rd_idx)
+static bool _tu_fifo_peek(tu_fifo_t* f, void * p_buffer, tu_fifo_size_t wr_idx, tu_fifo_size_t rd_idx)
 {
-  uint16_t cnt = _ff_count(f->depth, wr_idx, rd_idx);
+  tu_fifo_size_t cnt = _ff_count(f->depth, wr_idx, rd_idx);
 
   // nothing to peek
   if ( cnt == 0 ) return false;
@@ -431,7 +493,7 @@ static bool _tu_fifo_peek(tu_fifo_t* f, void * p_buffer, uint16_t wr_idx, uint16
     cnt = f->depth;
   }
 
-  uint16_t rd_ptr = idx2ptr(f->depth, rd_idx);
+  tu_fifo_size_t rd_ptr = idx2ptr(f->depth, rd_idx);
 
   // Peek data
   _ff_pull(f, p_buffer, rd_ptr);
@@ -441,9 +503,9 @@ static bool _tu_fifo_peek(tu_fifo_t* f, void * p_buffer, uint16_t wr_idx, uint16
 
 // Works on local copies of w and r
 // Must be protected by mutexes since in case of an overflow read pointer gets modified
-static uint16_t _tu_fifo_peek_n(tu_fifo_t* f, void * p_buffer, uint16_t n, uint16_t wr_idx, uint16_t rd_idx, tu_fifo_copy_mode_t copy_mode)
+TU_ATTR_FAST_FUNC static tu_fifo_size_t _tu_fifo_peek_n(tu_fifo_t* f, void * p_buffer, tu_fifo_size_t n, tu_fifo_size_t wr_idx, tu_fifo_size_t rd_idx, tu_fifo_copy_mode_t copy_mode)
 {
-  uint16_t cnt = _ff_count(f->depth, wr_idx, rd_idx);
+  tu_fifo_size_t cnt = _ff_count(f->depth, wr_idx, rd_idx);
 
   // nothing to peek
   if ( cnt == 0 ) return 0;
@@ -458,7 +520,7 @@ static uint16_t _tu_fifo_peek_n(tu_fifo_t* f, void * p_buffer, uint16_t n, uint1
   // Check if we can read something at and after offset - if too less is available we read what remains
   if ( cnt < n ) n = cnt;
 
-  uint16_t rd_ptr = idx2ptr(f->depth, rd_idx);
+  tu_fifo_size_t rd_ptr = idx2ptr(f->depth, rd_idx);
 
   // Peek data
   _ff_pull_n(f, p_buffer, n, rd_ptr, copy_mode);
@@ -466,14 +528,14 @@ static uint16_t _tu_fifo_peek_n(tu_fifo_t* f, void * p_buffer, uint16_t n, uint1
   return n;
 }
 
-static uint16_t _tu_fifo_write_n(tu_fifo_t* f, const void * data, uint16_t n, tu_fifo_copy_mode_t copy_mode)
+TU_ATTR_FAST_FUNC static tu_fifo_size_t _tu_fifo_write_n(tu_fifo_t* f, const void * data, tu_fifo_size_t n, tu_fifo_copy_mode_t copy_mode)
 {
   if ( n == 0 ) return 0;
 
   _ff_lock(f->mutex_wr);
 
-  uint16_t wr_idx = f->wr_idx;
-  uint16_t rd_idx = f->rd_idx;
+  tu_fifo_size_t wr_idx = f->wr_idx;
+  tu_fifo_size_t rd_idx = _ff_load_idx(f->rd_idx);
 
   uint8_t const* buf8 = (uint8_t const*) data;
 
@@ -483,8 +545,8 @@ static uint16_t _tu_fifo_write_n(tu_fifo_t* f, const void * data, uint16_t n, tu
   if ( !f->overwritable )
   {
     // limit up to full
-    uint16_t const remain = _ff_remaining(f->depth, wr_idx, rd_idx);
-    n = tu_min16(n, remain);
+    tu_fifo_size_t const remain = _ff_remaining(f->depth, wr_idx, rd_idx);
+    n = _ff_min(n, remain);
   }
   else
   {
@@ -511,7 +573,7 @@ static uint16_t _tu_fifo_write_n(tu_fifo_t* f, const void * data, uint16_t n, tu
     }
     else
     {
-      uint16_t const overflowable_count = _ff_count(f->depth, wr_idx, rd_idx);
+      tu_fifo_size_t const overflowable_count = _ff_count(f->depth, wr_idx, rd_idx);
       if (overflowable_count + n >= 2*f->depth)
       {
         // Double overflowed
@@ -535,7 +597,7 @@ static uint16_t _tu_fifo_write_n(tu_fifo_t* f, const void * data, uint16_t n, tu
 
   if (n)
   {
-    uint16_t wr_ptr = idx2ptr(f->depth, wr_idx);
+    tu_fifo_size_t wr_ptr = idx2ptr(f->depth, wr_idx);
 
     TU_LOG(TU_FIFO_DBG, "actual_n = %u, wr_ptr = %u", n, wr_ptr);
 
@@ -543,7 +605,7 @@ static uint16_t _tu_fifo_write_n(tu_fifo_t* f, const void * data, uint16_t n, tu
     _ff_push_n(f, buf8, n, wr_ptr, copy_mode);
 
     // Advance index
-    f->wr_idx = advance_index(f->depth, wr_idx, n);
+    _ff_store_idx(f->wr_idx, advance_index(f->depth, wr_idx, n));
 
     TU_LOG(TU_FIFO_DBG, "\tnew_wr = %u\r\n", f->wr_idx);
   }
@@ -553,16 +615,16 @@ static uint16_t _tu_fifo_write_n(tu_fifo_t* f, const void * data, uint16_t n, tu
   return n;
 }
 
-static uint16_t _tu_fifo_read_n(tu_fifo_t* f, void * buffer, uint16_t n, tu_fifo_copy_mode_t copy_mode)
+TU_ATTR_FAST_FUNC static tu_fifo_size_t _tu_fifo_read_n(tu_fifo_t* f, void * buffer, tu_fifo_size_t n, tu_fifo_copy_mode_t copy_mode)
 {
   _ff_lock(f->mutex_rd);
 
   // Peek the data
   // f->rd_idx might get modified in case of an overflow so we can not use a local variable
-  n = _tu_fifo_peek_n(f, buffer, n, f->wr_idx, f->rd_idx, copy_mode);
+  n = _tu_fifo_peek_n(f, buffer, n, _ff_load_idx(f->wr_idx), f->rd_idx, copy_mode);
 
   // Advance read pointer
-  f->rd_idx = advance_index(f->depth, f->rd_idx, n);
+  _ff_store_idx(f->rd_idx, advance_index(f->depth, f->rd_idx, n));
 
   _ff_unlock(f->mutex_rd);
   return n;
@@ -587,9 +649,9 @@ static uint16_t _tu_fifo_read_n(tu_fifo_t* f, void * buffer, uint16_t n, tu_fifo
     @returns Number of items in FIFO
  */
 /******************************************************************************/
-uint16_t tu_fifo_count(tu_fifo_t* f)
+tu_fifo_size_t tu_fifo_count(tu_fifo_t* f)
 {
-  return tu_min16(_ff_count(f->depth, f->wr_idx, f->rd_idx), f->depth);
+  return _ff_min(_ff_count(f->depth, f->wr_idx, f->rd_idx), f->depth);
 }
 
 /******************************************************************************/
@@ -641,7 +703,7 @@ bool tu_fifo_full(tu_fifo_t* f)
     @returns Number of items in FIFO
  */
 /******************************************************************************/
-uint16_t tu_fifo_remaining(tu_fifo_t* f)
+tu_fifo_size_t tu_fifo_remaining(tu_fifo_t* f)
 {
   return _ff_remaining(f->depth, f->wr_idx, f->rd_idx);
 }
@@ -702,10 +764,10 @@ bool tu_fifo_read(tu_fifo_t* f, void * buffer)
 
   // Peek the data
   // f->rd_idx might get modified in case of an overflow so we can not use a local variable
-  bool ret = _tu_fifo_peek(f, buffer, f->wr_idx, f->rd_idx);
+  bool ret = _tu_fifo_peek(f, buffer, _ff_load_idx(f->wr_idx), f->rd_idx);
 
   // Advance pointer
-  f->rd_idx = advance_index(f->depth, f->rd_idx, ret);
+  _ff_store_idx(f->rd_idx, advance_index(f->depth, f->rd_idx, ret));
 
   _ff_unlock(f->mutex_rd);
   return ret;
@@ -727,7 +789,7 @@ bool tu_fifo_read(tu_fifo_t* f, void * buffer)
     @returns number of items read from the FIFO
  */
 /******************************************************************************/
-uint16_t tu_fifo_read_n(tu_fifo_t* f, void * buffer, uint16_t n)
+TU_ATTR_FAST_FUNC tu_fifo_size_t tu_fifo_read_n(tu_fifo_t* f, void * buffer, tu_fifo_size_t n)
 {
   return _tu_fifo_read_n(f, buffer, n, TU_FIFO_COPY_INC);
 }
@@ -750,7 +812,7 @@ uint16_t tu_fifo_read_n(tu_fifo_t* f, void * buffer, uint16_t n)
     @returns number of items read from the FIFO
  */
 /******************************************************************************/
-uint16_t tu_fifo_read_n_const_addr_full_words(tu_fifo_t* f, void * buffer, uint16_t n)
+TU_ATTR_FAST_FUNC tu_fifo_size_t tu_fifo_read_n_const_addr_full_words(tu_fifo_t* f, void * buffer, tu_fifo_size_t n)
 {
   return _tu_fifo_read_n(f, buffer, n, TU_FIFO_COPY_CST_FULL_WORDS);
 }
@@ -772,7 +834,7 @@ uint16_t tu_fifo_read_n_const_addr_full_words(tu_fifo_t* f, void * buffer, uint1
 bool tu_fifo_peek(tu_fifo_t* f, void * p_buffer)
 {
   _ff_lock(f->mutex_rd);
-  bool ret = _tu_fifo_peek(f, p_buffer, f->wr_idx, f->rd_idx);
+  bool ret = _tu_fifo_peek(f, p_buffer, _ff_load_idx(f->wr_idx), f->rd_idx);
   _ff_unlock(f->mutex_rd);
   return ret;
 }
@@ -792,10 +854,10 @@ bool tu_fifo_peek(tu_fifo_t* f, void * p_buffer)
     @returns Number of bytes written to p_buffer
  */
 /******************************************************************************/
-uint16_t tu_fifo_peek_n(tu_fifo_t* f, void * p_buffer, uint16_t n)
+tu_fifo_size_t tu_fifo_peek_n(tu_fifo_t* f, void * p_buffer, tu_fifo_size_t n)
 {
   _ff_lock(f->mutex_rd);
-  uint16_t ret = _tu_fifo_peek_n(f, p_buffer, n, f->wr_idx, f->rd_idx, TU_FIFO_COPY_INC);
+  tu_fifo_size_t ret = _tu_fifo_peek_n(f, p_buffer, n, _ff_load_idx(f->wr_idx), f->rd_idx, TU_FIFO_COPY_INC);
   _ff_unlock(f->mutex_rd);
   return ret;
 }
@@ -821,20 +883,21 @@ bool tu_fifo_write(tu_fifo_t* f, const void * data)
   _ff_lock(f->mutex_wr);
 
   bool ret;
-  uint16_t const wr_idx = f->wr_idx;
+  tu_fifo_size_t const wr_idx = f->wr_idx;
+  tu_fifo_size_t const rd_idx = _ff_load_idx(f->rd_idx);
 
-  if ( tu_fifo_full(f) && !f->overwritable )
+  if ( (_ff_count(f->depth, wr_idx, rd_idx) >= f->depth) && !f->overwritable )
   {
     ret = false;
   }else
   {
-    uint16_t wr_ptr = idx2ptr(f->depth, wr_idx);
+    tu_fifo_size_t wr_ptr = idx2ptr(f->depth, wr_idx);
 
     // Write data
     _ff_push(f, data, wr_ptr);
 
     // Advance pointer
-    f->wr_idx = advance_index(f->depth, wr_idx, 1);
+    _ff_store_idx(f->wr_idx, advance_index(f->depth, wr_idx, 1));
 
     ret = true;
   }
@@ -858,7 +921,7 @@ bool tu_fifo_write(tu_fifo_t* f, const void * data)
     @return Number of written elements
  */
 /******************************************************************************/
-uint16_t tu_fifo_write_n(tu_fifo_t* f, const void * data, uint16_t n)
+TU_ATTR_FAST_FUNC tu_fifo_size_t tu_fifo_write_n(tu_fifo_t* f, const void * data, tu_fifo_size_t n)
 {
   return _tu_fifo_write_n(f, data, n, TU_FIFO_COPY_INC);
 }
@@ -879,7 +942,7 @@ uint16_t tu_fifo_write_n(tu_fifo_t* f, const void * data, uint16_t n)
     @return Number of written elements
  */
 /******************************************************************************/
-uint16_t tu_fifo_write_n_const_addr_full_words(tu_fifo_t* f, const void * data, uint16_t n)
+TU_ATTR_FAST_FUNC tu_fifo_size_t tu_fifo_write_n_const_addr_full_words(tu_fifo_t* f, const void * data, tu_fifo_size_t n)
 {
   return _tu_fifo_write_n(f, data, n, TU_FIFO_COPY_CST_FULL_WORDS);
 }
@@ -945,9 +1008,9 @@ bool tu_fifo_set_overwritable(tu_fifo_t *f, bool overwritable)
                 Number of items the write pointer moves forward
  */
 /******************************************************************************/
-void tu_fifo_advance_write_pointer(tu_fifo_t *f, uint16_t n)
+void tu_fifo_advance_write_pointer(tu_fifo_t *f, tu_fifo_size_t n)
 {
-  f->wr_idx = advance_index(f->depth, f->wr_idx, n);
+  _ff_store_idx(f->wr_idx, advance_index(f->depth, f->wr_idx, n));
 }
 
 /******************************************************************************/
@@ -966,9 +1029,9 @@ void tu_fifo_advance_write_pointer(tu_fifo_t *f, uint16_t n)
                 Number of items the read pointer moves forward
  */
 /******************************************************************************/
-void tu_fifo_advance_read_pointer(tu_fifo_t *f, uint16_t n)
+void tu_fifo_advance_read_pointer(tu_fifo_t *f, tu_fifo_size_t n)
 {
-  f->rd_idx = advance_index(f->depth, f->rd_idx, n);
+  _ff_store_idx(f->rd_idx, advance_index(f->depth, f->rd_idx, n));
 }
 
 /******************************************************************************/
@@ -989,10 +1052,10 @@ void tu_fifo_advance_read_pointer(tu_fifo_t *f, uint16_t n)
 void tu_fifo_get_read_info(tu_fifo_t *f, tu_fifo_buffer_info_t *info)
 {
   // Operate on temporary values in case they change in between
-  uint16_t wr_idx = f->wr_idx;
-  uint16_t rd_idx = f->rd_idx;
+  tu_fifo_size_t wr_idx = _ff_load_idx(f->wr_idx);
+  tu_fifo_size_t rd_idx = f->rd_idx;
 
-  uint16_t cnt = _ff_count(f->depth, wr_idx, rd_idx);
+  tu_fifo_size_t cnt = _ff_count(f->depth, wr_idx, rd_idx);
 
   // Check overflow and correct if required - may happen in case a DMA wrote too fast
   if (cnt > f->depth)
@@ -1015,8 +1078,8 @@ void tu_fifo_get_read_info(tu_fifo_t *f, tu_fifo_buffer_info_t *info)
   }
 
   // Get relative pointers
-  uint16_t wr_ptr = idx2ptr(f->depth, wr_idx);
-  uint16_t rd_ptr = idx2ptr(f->depth, rd_idx);
+  tu_fifo_size_t wr_ptr = idx2ptr(f->depth, wr_idx);
+  tu_fifo_size_t rd_ptr = idx2ptr(f->depth, rd_idx);
 
   // Copy pointer to buffer to start reading from
   info->ptr_lin = &f->buffer[rd_ptr];
@@ -1056,9 +1119,9 @@ void tu_fifo_get_read_info(tu_fifo_t *f, tu_fifo_buffer_info_t *info)
 /******************************************************************************/
 void tu_fifo_get_write_info(tu_fifo_t *f, tu_fifo_buffer_info_t *info)
 {
-  uint16_t wr_idx = f->wr_idx;
-  uint16_t rd_idx = f->rd_idx;
-  uint16_t remain = _ff_remaining(f->depth, wr_idx, rd_idx);
+  tu_fifo_size_t wr_idx = f->wr_idx;
+  tu_fifo_size_t rd_idx = _ff_load_idx(f->rd_idx);
+  tu_fifo_size_t remain = _ff_remaining(f->depth, wr_idx, rd_idx);
 
   if (remain == 0)
   {
@@ -1070,8 +1133,8 @@ void tu_fifo_get_write_info(tu_fifo_t *f, tu_fifo_buffer_info_t *info)
   }
 
   // Get relative pointers
-  uint16_t wr_ptr = idx2ptr(f->depth, wr_idx);
-  uint16_t rd_ptr = idx2ptr(f->depth, rd_idx);
+  tu_fifo_size_t wr_ptr = idx2ptr(f->depth, wr_idx);
+  tu_fifo_size_t rd_ptr = idx2ptr(f->depth, rd_idx);
 
   // Copy pointer to buffer to start writing to
   info->ptr_lin = &f->buffer[wr_ptr];
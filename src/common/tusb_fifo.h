@@ -48,6 +48,30 @@ extern "C" {
 // for OS None, we don't get preempted
 #define CFG_FIFO_MUTEX      OSAL_MUTEX_REQUIRED
 
+// Single producer single consumer mode: configured mutexes are ignored, write/read is lock-free
+// using only atomic index load/store. Each fifo must have at most one writer and one reader
+// (e.g an ISR and a task); clear(), config() and set_overwritable() must not be called concurrently.
+#ifndef CFG_TUSB_FIFO_SPSC
+  #define CFG_TUSB_FIFO_SPSC  0
+#endif
+
+// 32-bit depth and indices, allow fifos deeper than 32768 items (e.g multichannel high sample rate audio or
+// logging over CDC on high speed). Applies to all fifos: costs 8 bytes more per fifo, item counts in the API
+// become 32-bit (tu_fifo_size_t)
+#ifndef CFG_TUSB_FIFO_32BIT
+  #define CFG_TUSB_FIFO_32BIT 0
+#endif
+
+#if CFG_TUSB_FIFO_32BIT
+typedef uint32_t tu_fifo_size_t;
+#define TU_FIFO_SIZE_MAX   UINT32_MAX
+#define TU_FIFO_DEPTH_MAX  0x40000000u
+#else
+typedef uint16_t tu_fifo_size_t;
+#define TU_FIFO_SIZE_MAX   UINT16_MAX
+#define TU_FIFO_DEPTH_MAX  0x8000u
+#endif
+
 /* Write/Read index is always in the range of:
  *      0 .. 2*depth-1
  * The extra window allow us to determine the fifo state of empty or full with only 2 indices
@@ -105,15 +129,15 @@ extern "C" {
  */
 typedef struct {
   uint8_t* buffer          ; // buffer pointer
-  uint16_t depth           ; // max items
+  tu_fifo_size_t depth     ; // max items
 
   struct TU_ATTR_PACKED {
     uint16_t item_size : 15; // size of each item
     bool overwritable  : 1 ; // ovwerwritable when full
   };
 
-  volatile uint16_t wr_idx ; // write index
-  volatile uint16_t rd_idx ; // read index
+  volatile tu_fifo_size_t wr_idx ; // write index
+  volatile tu_fifo_size_t rd_idx ; // read index
 
 #if OSAL_MUTEX_REQUIRED
   osal_mutex_t mutex_wr;
@@ -123,8 +147,8 @@ typedef struct {
 } tu_fifo_t;
 
 typedef struct {
-  uint16_t len_lin  ; ///< linear length in item size
-  uint16_t len_wrap ; ///< wrapped length in item size
+  tu_fifo_size_t len_lin  ; ///< linear length in item size
+  tu_fifo_size_t len_wrap ; ///< wrapped length in item size
   void * ptr_lin    ; ///< linear part start pointer
   void * ptr_wrap   ; ///< wrapped part start pointer
 } tu_fifo_buffer_info_t;
@@ -142,7 +166,7 @@ typedef struct {
 
 bool tu_fifo_set_overwritable(tu_fifo_t *f, bool overwritable);
 bool tu_fifo_clear(tu_fifo_t *f);
-bool tu_fifo_config(tu_fifo_t *f, void* buffer, uint16_t depth, uint16_t item_size, bool overwritable);
+bool tu_fifo_config(tu_fifo_t *f, void* buffer, tu_fifo_size_t depth, uint16_t item_size, bool overwritable);
 
 #if OSAL_MUTEX_REQUIRED
 TU_ATTR_ALWAYS_INLINE static inline
@@ -154,37 +178,37 @@ void tu_fifo_config_mutex(tu_fifo_t *f, osal_mutex_t wr_mutex, osal_mutex_t rd_m
 #define tu_fifo_config_mutex(_f, _wr_mutex, _rd_mutex)
 #endif
 
-bool     tu_fifo_write                  (tu_fifo_t* f, void const * data);
-uint16_t tu_fifo_write_n                (tu_fifo_t* f, void const * data, uint16_t n);
+bool           tu_fifo_write            (tu_fifo_t* f, void const * data);
+tu_fifo_size_t tu_fifo_write_n          (tu_fifo_t* f, void const * data, tu_fifo_size_t n);
 #ifdef TUP_MEM_CONST_ADDR
-uint16_t tu_fifo_write_n_const_addr_full_words    (tu_fifo_t* f, const void * data, uint16_t n);
+tu_fifo_size_t tu_fifo_write_n_const_addr_full_words (tu_fifo_t* f, const void * data, tu_fifo_size_t n);
 #endif
 
-bool     tu_fifo_read                   (tu_fifo_t* f, void * buffer);
-uint16_t tu_fifo_read_n                 (tu_fifo_t* f, void * buffer, uint16_t n);
+bool           tu_fifo_read             (tu_fifo_t* f, void * buffer);
+tu_fifo_size_t tu_fifo_read_n           (tu_fifo_t* f, void * buffer, tu_fifo_size_t n);
 #ifdef TUP_MEM_CONST_ADDR
-uint16_t tu_fifo_read_n_const_addr_full_words     (tu_fifo_t* f, void * buffer, uint16_t n);
+tu_fifo_size_t tu_fifo_read_n_const_addr_full_words  (tu_fifo_t* f, void * buffer, tu_fifo_size_t n);
 #endif
 
-bool     tu_fifo_peek                   (tu_fifo_t* f, void * p_buffer);
-uint16_t tu_fifo_peek_n                 (tu_fifo_t* f, void * p_buffer, uint16_t n);
+bool           tu_fifo_peek             (tu_fifo_t* f, void * p_buffer);
+tu_fifo_size_t tu_fifo_peek_n           (tu_fifo_t* f, void * p_buffer, tu_fifo_size_t n);
 
-uint16_t tu_fifo_count                  (tu_fifo_t* f);
-uint16_t tu_fifo_remaining              (tu_fifo_t* f);
+tu_fifo_size_t tu_fifo_count            (tu_fifo_t* f);
+tu_fifo_size_t tu_fifo_remaining        (tu_fifo_t* f);
 bool     tu_fifo_empty                  (tu_fifo_t* f);
 bool     tu_fifo_full                   (tu_fifo_t* f);
 bool     tu_fifo_overflowed             (tu_fifo_t* f);
 void     tu_fifo_correct_read_pointer   (tu_fifo_t* f);
 
 TU_ATTR_ALWAYS_INLINE static inline
-uint16_t tu_fifo_depth(tu_fifo_t* f) {
+tu_fifo_size_t tu_fifo_depth(tu_fifo_t* f) {
   return f->depth;
 }
 
 // Pointer modifications intended to be used in combinations with DMAs.
 // USE WITH CARE - NO SAFETY CHECKS CONDUCTED HERE! NOT MUTEX PROTECTED!
-void tu_fifo_advance_write_pointer(tu_fifo_t *f, uint16_t n);
-void tu_fifo_advance_read_pointer (tu_fifo_t *f, uint16_t n);
+void tu_fifo_advance_write_pointer(tu_fifo_t *f, tu_fifo_size_t n);
+void tu_fifo_advance_read_pointer (tu_fifo_t *f, tu_fifo_size_t n);
 
 // If you want to read/write from/to the FIFO by use of a DMA, you may need to conduct two copies
 // to handle a possible wrapping part. These functions deliver a pointer to start
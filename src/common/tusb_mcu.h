@@ -153,10 +153,23 @@
   #define TUP_RHPORT_HIGHSPEED    1
   #define TUD_ENDPOINT_ONE_DIRECTION_ONLY
 
+  // Number of DMA segments per endpoint transfer: first one is loaded into channel registers, the others are taken
+  // from the channel's descriptor list. 2 are needed to move both linear and wrapped part of a FIFO with DMA,
+  // with 1 a wrapped FIFO transfer completes after its linear part.
+  #ifndef CFG_TUD_SAMX7X_DMA_DESC_NUM
+  #define CFG_TUD_SAMX7X_DMA_DESC_NUM 2
+  #endif
+
 #elif TU_CHECK_MCU(OPT_MCU_PIC32MZ)
   #define TUP_DCD_ENDPOINT_MAX    8
   #define TUD_ENDPOINT_ONE_DIRECTION_ONLY
 
+  // Use USBHS integrated DMA controller for multi-packet bulk transfers. USB DMA interrupt (_USB_DMA_VECTOR) must
+  // also call tud_int_handler(), buffers are either uncached or maintained with dcd_dcache_clean/invalidate()
+  #ifndef CFG_TUD_PIC32MZ_DMA
+    #define CFG_TUD_PIC32MZ_DMA  0
+  #endif
+
 #elif TU_CHECK_MCU(OPT_MCU_PIC32MX, OPT_MCU_PIC32MM, OPT_MCU_PIC32MK) || \
       TU_CHECK_MCU(OPT_MCU_PIC24, OPT_MCU_DSPIC33)
   #define TUP_DCD_ENDPOINT_MAX    16
@@ -360,6 +373,12 @@
   #define TUP_DCD_ENDPOINT_MAX    12
   #define TUP_RHPORT_HIGHSPEED    1
 
+  // Use USBD DMA engine for bulk endpoint data. Only word-aligned chunks with a length multiple of 4 are moved by
+  // DMA, everything else still goes through EPDAT.
+  #ifndef CFG_TUD_NUC505_DMA
+  #define CFG_TUD_NUC505_DMA      0
+  #endif
+
 //--------------------------------------------------------------------+
 // Espressif
 //--------------------------------------------------------------------+
@@ -411,7 +430,7 @@
   #define TUP_DCD_EDPT_ISO_ALLOC
   #define TUP_DCD_ENDPOINT_MAX    16
 
-  #define TU_ATTR_FAST_FUNC       __attribute__((section(".time_critical.tinyusb")))
+  #define CFG_TUSB_FAST_FUNC_DEFAULT  __attribute__((section(".time_critical.tinyusb")))
 
 //--------------------------------------------------------------------+
 // Silabs
@@ -468,6 +487,19 @@
 #elif TU_CHECK_MCU(OPT_MCU_F1C100S)
   #define TUP_DCD_ENDPOINT_MAX    4
 
+  // Use NDMA channel CFG_TUD_SUNXI_DMA_CHANNEL with the USB DRQ for multi-packet bulk transfers. The driver takes the
+  // DMA interrupt. DRAM is cached (SDK MMU setup) so dcache maintenance is enabled along with it.
+  #ifndef CFG_TUD_SUNXI_DMA
+    #define CFG_TUD_SUNXI_DMA  0
+  #endif
+
+  #ifndef CFG_TUD_SUNXI_DMA_CHANNEL
+    #define CFG_TUD_SUNXI_DMA_CHANNEL  0
+  #endif
+
+  #define CFG_TUD_MEM_DCACHE_ENABLE_DEFAULT      CFG_TUD_SUNXI_DMA
+  #define CFG_TUSB_MEM_DCACHE_LINE_SIZE_DEFAULT  32
+
 //--------------------------------------------------------------------+
 // WCH
 //--------------------------------------------------------------------+
@@ -547,6 +579,11 @@
   #ifndef CFG_TUH_MAX3421_ENDPOINT_TOTAL
     #define CFG_TUH_MAX3421_ENDPOINT_TOTAL  (8 + 4*(CFG_TUH_DEVICE_MAX-1))
   #endif
+
+  // FIFO transfers within interrupt handler are done with tuh_max3421_spi_xfer_async_api()
+  #ifndef CFG_TUH_MAX3421_SPI_ASYNC
+    #define CFG_TUH_MAX3421_SPI_ASYNC  0
+  #endif
 #endif
 
 
@@ -568,9 +605,14 @@
   #define TUP_RHPORT_HIGHSPEED    0
 #endif
 
-// fast function, normally mean placing function in SRAM
+// fast function: ISR hot path, normally placed in SRAM/ITCM with CFG_TUSB_FAST_FUNC
 #ifndef TU_ATTR_FAST_FUNC
-  #define TU_ATTR_FAST_FUNC
+  #define TU_ATTR_FAST_FUNC       CFG_TUSB_FAST_FUNC
+#endif
+
+// fast data: control structures frequently accessed in ISR (not by usb DMA), placed with CFG_TUSB_FAST_DATA
+#ifndef TU_ATTR_FAST_DATA
+  #define TU_ATTR_FAST_DATA       CFG_TUSB_FAST_DATA
 #endif
 
 // USBIP that support ISO alloc & activate API
@@ -582,4 +624,46 @@
   #define TUP_MEM_CONST_ADDR
 #endif
 
+#if defined(TUP_USBIP_WCH_USBHS)
+  // Use USBHS buffer mode for bulk endpoints whose other direction is not opened: UEPn_RX_DMA and UEPn_TX_DMA are
+  // ping-pong buffers selected by data toggle, the next packet is armed while the current one is on the bus
+  #ifndef CFG_TUD_CH32_USBHS_BUF_MODE
+    #define CFG_TUD_CH32_USBHS_BUF_MODE  0
+  #endif
+#endif
+
+// Max bytes of a single dcd/hcd_edpt_xfer() submission (must be multiple of max packet size),
+// bigger transfer is split by usbd/usbh
+#if defined(TUP_USBIP_CHIPIDEA_HS)
+  // Number of dTDs chained for a transfer, 5-page dTD always covers 16KB regardless of buffer alignment
+  #ifndef CFG_TUD_CI_HS_QTD_PER_EP
+    #define CFG_TUD_CI_HS_QTD_PER_EP  4
+  #endif
+
+  // Interrupt threshold (USBCMD.ITC) in micro-frames: 0 (immediate), 1,2,4,8,16,32,64. Changed at runtime with
+  // tud_configure(TUD_CFGID_INTR_THRESHOLD)
+  #ifndef CFG_TUD_CI_HS_ITC
+    #define CFG_TUD_CI_HS_ITC  0
+  #endif
+
+  #if CFG_TUD_CI_HS_QTD_PER_EP >= 4
+    #define TUP_DCD_EDPT_XFER_MAX   0xFC00u
+  #else
+    #define TUP_DCD_EDPT_XFER_MAX   (CFG_TUD_CI_HS_QTD_PER_EP * 0x4000u)
+  #endif
+#endif
+
+#if defined(TUP_USBIP_EHCI)
+  // 5-page qTD always covers 16KB regardless of buffer alignment
+  #define TUP_HCD_EDPT_XFER_MAX   0x4000u
+#endif
+
+#ifndef TUP_DCD_EDPT_XFER_MAX
+  #define TUP_DCD_EDPT_XFER_MAX   0xFC00u // largest multiple of 1024 fit in uint16_t
+#endif
+
+#ifndef TUP_HCD_EDPT_XFER_MAX
+  #define TUP_HCD_EDPT_XFER_MAX   0xFC00u
+#endif
+
 #endif
@@ -0,0 +1,108 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+#include "tusb_mempool.h"
+
+TU_ATTR_ALWAYS_INLINE static inline bool map_test(const uint32_t* map, uint16_t i) {
+  return (map[i / 32] & TU_BIT(i % 32)) != 0;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void map_set(uint32_t* map, uint16_t i) {
+  map[i / 32] |= (uint32_t) TU_BIT(i % 32);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void map_clear(uint32_t* map, uint16_t i) {
+  map[i / 32] &= (uint32_t) ~TU_BIT(i % 32);
+}
+
+void tu_mempool_init(tu_mempool_t* pool, void* buffer, uint16_t unit_size, uint16_t unit_count,
+                     uint32_t* used_map, uint32_t* head_map) {
+  pool->buffer = (uint8_t*) buffer;
+  pool->used_map = used_map;
+  pool->head_map = head_map;
+  pool->unit_size = unit_size;
+  pool->unit_count = unit_count;
+  pool->used_units = 0;
+  pool->max_used_units = 0;
+
+  tu_memclr(used_map, sizeof(uint32_t) * TU_MEMPOOL_MAP_WORDS((uint32_t) unit_count));
+  tu_memclr(head_map, sizeof(uint32_t) * TU_MEMPOOL_MAP_WORDS((uint32_t) unit_count));
+}
+
+void* tu_mempool_alloc(tu_mempool_t* pool, uint32_t size) {
+  TU_VERIFY(size > 0 && pool->unit_size > 0, NULL);
+
+  const uint32_t units = TU_DIV_CEIL(size, pool->unit_size);
+  TU_VERIFY(units <= (uint32_t) (pool->unit_count - pool->used_units), NULL);
+
+  // first fit: find a run of free units
+  uint16_t start = 0;
+  uint32_t run = 0;
+  for (uint16_t i = 0; i < pool->unit_count; i++) {
+    if (map_test(pool->used_map, i)) {
+      run = 0;
+      start = (uint16_t) (i + 1);
+      continue;
+    }
+
+    if (++run == units) {
+      for (uint16_t u = start; u <= i; u++) {
+        map_set(pool->used_map, u);
+      }
+      map_set(pool->head_map, start);
+
+      pool->used_units = (uint16_t) (pool->used_units + units);
+      pool->max_used_units = tu_max16(pool->max_used_units, pool->used_units);
+
+      return pool->buffer + (uint32_t) start * pool->unit_size;
+    }
+  }
+
+  return NULL;
+}
+
+void tu_mempool_free(tu_mempool_t* pool, void* ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  const uint8_t* p8 = (const uint8_t*) ptr;
+  TU_ASSERT(p8 >= pool->buffer && p8 < pool->buffer + (uint32_t) pool->unit_count * pool->unit_size, );
+
+  const uint16_t start = (uint16_t) ((uint32_t) (p8 - pool->buffer) / pool->unit_size);
+  TU_ASSERT(map_test(pool->head_map, start), ); // not the beginning of a block, or freed twice
+
+  map_clear(pool->head_map, start);
+
+  // block ends at the next free unit or the beginning of the next block
+  uint16_t i = start;
+  do {
+    map_clear(pool->used_map, i);
+    pool->used_units--;
+    i++;
+  } while (i < pool->unit_count && map_test(pool->used_map, i) && !map_test(pool->head_map, i));
+}
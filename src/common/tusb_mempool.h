@@ -0,0 +1,78 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_MEMPOOL_H_
+#define _TUSB_MEMPOOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common/tusb_common.h"
+
+// Simple first-fit block allocator over a static buffer, used for endpoint buffers shared by class drivers.
+// Buffer is split into units of equal size; an allocation takes a run of contiguous units, so every block keeps
+// the alignment of the buffer as long as unit size is a multiple of it (e.g cache line size for DMA with dcache).
+// Allocation state is kept in two bitmaps provided by the caller: one for used units, one for the first unit of
+// each block. Not thread-safe, caller must serialize alloc/free (e.g usbd task only)
+
+#define TU_MEMPOOL_MAP_WORDS(_unit_count)  TU_DIV_CEIL(_unit_count, 32)
+
+typedef struct {
+  uint8_t* buffer;
+  uint32_t* used_map;     // bit set: unit is allocated
+  uint32_t* head_map;     // bit set: unit is the first one of a block
+  uint16_t unit_size;
+  uint16_t unit_count;
+  uint16_t used_units;
+  uint16_t max_used_units; // high watermark, useful for sizing the pool
+} tu_mempool_t;
+
+// Configure the pool with buffer of unit_count * unit_size bytes, each map must have TU_MEMPOOL_MAP_WORDS(unit_count) words
+void tu_mempool_init(tu_mempool_t* pool, void* buffer, uint16_t unit_size, uint16_t unit_count,
+                     uint32_t* used_map, uint32_t* head_map);
+
+// Allocate a block of at least size bytes, return NULL if there is no large enough contiguous free space
+void* tu_mempool_alloc(tu_mempool_t* pool, uint32_t size);
+
+// Release a block returned by tu_mempool_alloc(), NULL is ignored
+void tu_mempool_free(tu_mempool_t* pool, void* ptr);
+
+// Number of bytes currently allocated (in whole units)
+TU_ATTR_ALWAYS_INLINE static inline uint32_t tu_mempool_used(const tu_mempool_t* pool) {
+  return (uint32_t) pool->used_units * pool->unit_size;
+}
+
+// Highest number of bytes allocated at the same time since init
+TU_ATTR_ALWAYS_INLINE static inline uint32_t tu_mempool_watermark(const tu_mempool_t* pool) {
+  return (uint32_t) pool->max_used_units * pool->unit_size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
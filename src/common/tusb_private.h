@@ -46,17 +46,34 @@ typedef struct TU_ATTR_PACKED {
   volatile uint8_t claimed : 1;
 }tu_edpt_state_t;
 
+// Ping-pong reception needs endpoint transfer queue of the stack
+#define TU_EDPT_STREAM_PINGPONG   (CFG_TUD_EDPT_XFER_QUEUE || CFG_TUH_EDPT_XFER_QUEUE)
+
 typedef struct {
   struct TU_ATTR_PACKED  {
     uint8_t is_host   : 1; // 1: host, 0: device
     uint8_t is_mps512 : 1; // 1: 512, 0: 64 since stream is used for Bulk only
+    uint8_t zero_copy : 1; // 1: transfer directly from/to fifo linear region if possible
+    uint8_t zc_busy   : 1; // on-going transfer is using fifo buffer instead of ep_buf
+    uint8_t zc_stale  : 1; // fifo is cleared while zero-copy transfer is on-going
+    uint8_t pp_rd     : 1; // ping-pong: buffer of the oldest queued transfer, 0: ep_buf, 1: ep_buf2
+    uint8_t pp_count  : 2; // ping-pong: number of queued transfers
+    uint8_t is_tx     : 1; // 1: IN for device, OUT for host
   };
   uint8_t ep_addr;
   uint16_t ep_bufsize;
 
-  uint8_t* ep_buf; // TODO xfer_fifo can skip this buffer
+  uint16_t wm_level;       // fifo watermark in bytes, 0 if disabled
+  volatile bool wm_armed;  // watermark is reported once until fifo level is below it again
+
+  uint8_t* ep_buf; // skipped when zero-copy transfer is possible
   tu_fifo_t ff;
 
+  #if TU_EDPT_STREAM_PINGPONG
+  uint8_t* ep_buf2;      // spare buffer for ping-pong reception, NULL if not used
+  uint16_t pp_len[2];    // requested length of queued transfer of each buffer
+  #endif
+
   // mutex: read if rx, otherwise write
   OSAL_MUTEX_DEF(ff_mutexdef);
 
@@ -75,7 +92,7 @@ void tu_edpt_bind_driver(uint8_t ep2drv[][2], tusb_desc_interface_t const* p_des
 // Calculate total length of n interfaces (depending on IAD)
 uint16_t tu_desc_get_interface_total_len(tusb_desc_interface_t const* desc_itf, uint8_t itf_count, uint16_t max_len);
 
-// Claim an endpoint with provided mutex
+// Claim an endpoint with provided mutex, which is not used if TUP_EDPT_CLAIM_ATOMIC (lock-free compare-and-swap)
 bool tu_edpt_claim(tu_edpt_state_t* ep_state, osal_mutex_t mutex);
 
 // Release an endpoint with provided mutex
@@ -98,6 +115,10 @@ void tu_edpt_stream_open(tu_edpt_stream_t* s, tusb_desc_endpoint_t const *desc_e
   tu_fifo_clear(&s->ff);
   s->ep_addr = desc_ep->bEndpointAddress;
   s->is_mps512 = (tu_edpt_packet_size(desc_ep) == 512) ? 1 : 0;
+  s->zc_busy = 0;
+  s->zc_stale = 0;
+  s->pp_rd = 0;
+  s->pp_count = 0;
 }
 
 TU_ATTR_ALWAYS_INLINE static inline
@@ -108,9 +129,54 @@ void tu_edpt_stream_close(tu_edpt_stream_t* s) {
 // Clear fifo
 TU_ATTR_ALWAYS_INLINE static inline
 bool tu_edpt_stream_clear(tu_edpt_stream_t* s) {
+  if (s->zc_busy) {
+    s->zc_stale = 1; // drop on-going transfer on completion
+  }
+  if (!s->is_tx) {
+    s->wm_armed = true; // RX fifo is empty
+  }
   return tu_fifo_clear(&s->ff);
 }
 
+// Enable/Disable zero-copy transfer (enabled by default if CFG_TUSB_EDPT_STREAM_ZERO_COPY).
+// Should be disabled if driver needs to access transferred data via ep_buf
+TU_ATTR_ALWAYS_INLINE static inline
+void tu_edpt_stream_set_zero_copy(tu_edpt_stream_t* s, bool enabled) {
+  s->zero_copy = (CFG_TUSB_EDPT_STREAM_ZERO_COPY && enabled && tu_fifo_depth(&s->ff) &&
+                  !s->ff.overwritable) ? 1 : 0;
+}
+
+// Replace fifo buffer, data in fifo is discarded. Must be called when there is no on-going transfer
+TU_ATTR_ALWAYS_INLINE static inline
+bool tu_edpt_stream_set_fifo(tu_edpt_stream_t* s, void* ff_buf, uint16_t ff_bufsize) {
+  s->zc_busy = 0;
+  s->zc_stale = 0;
+  if (0 == ff_bufsize) {
+    s->zero_copy = 0;
+  }
+  return tu_fifo_config(&s->ff, ff_buf, ff_bufsize, 1, s->ff.overwritable);
+}
+
+// Set fifo watermark, 0 to disable. RX stream reaches it when fifo has at least level bytes to read, TX stream when
+// fifo has at least level bytes free. Reported once by tu_edpt_stream_watermark_reached() until fifo level falls below
+// watermark again by reading (RX) or writing (TX)
+TU_ATTR_ALWAYS_INLINE static inline
+bool tu_edpt_stream_set_watermark(tu_edpt_stream_t* s, uint16_t level) {
+  TU_VERIFY(level <= tu_fifo_depth(&s->ff));
+  s->wm_level = level;
+  s->wm_armed = true;
+  return true;
+}
+
+// Check watermark after fifo level is changed by a transfer, return true once when it is reached
+bool tu_edpt_stream_watermark_reached(tu_edpt_stream_t* s);
+
+// Receive with a second endpoint buffer of ep_bufsize (NULL to disable). Next transfer is queued on the spare buffer
+// with usbd/usbh_edpt_xfer_queue(), so that endpoint is re-armed in ISR as soon as a transfer completes instead of
+// NAKing until the completed buffer is copied into fifo by task. Requires fifo and CFG_TUD/TUH_EDPT_XFER_QUEUE, zero-copy
+// is not used while enabled. Must be called when there is no on-going transfer
+bool tu_edpt_stream_set_pingpong(tu_edpt_stream_t* s, uint8_t* ep_buf2);
+
 //--------------------------------------------------------------------+
 // Stream Write
 //--------------------------------------------------------------------+
@@ -121,6 +187,19 @@ uint32_t tu_edpt_stream_write(uint8_t hwid, tu_edpt_stream_t* s, void const *buf
 // Start an usb transfer if endpoint is not busy
 uint32_t tu_edpt_stream_write_xfer(uint8_t hwid, tu_edpt_stream_t* s);
 
+// Must be called in the transfer complete callback before starting next transfer
+TU_ATTR_ALWAYS_INLINE static inline
+void tu_edpt_stream_write_xfer_complete(tu_edpt_stream_t* s, uint32_t xferred_bytes) {
+  if (s->zc_busy) {
+    // data is sent directly from fifo, release it now
+    if (!s->zc_stale) {
+      tu_fifo_advance_read_pointer(&s->ff, (uint16_t) xferred_bytes);
+    }
+    s->zc_busy = 0;
+    s->zc_stale = 0;
+  }
+}
+
 // Start an zero-length packet if needed
 bool tu_edpt_stream_write_zlp_if_needed(uint8_t hwid, tu_edpt_stream_t* s, uint32_t last_xferred_bytes);
 
@@ -138,20 +217,17 @@ uint32_t tu_edpt_stream_read(uint8_t hwid, tu_edpt_stream_t* s, void* buffer, ui
 // Start an usb transfer if endpoint is not busy
 uint32_t tu_edpt_stream_read_xfer(uint8_t hwid, tu_edpt_stream_t* s);
 
+// Same as tu_edpt_stream_read_xfer_complete but skip the first n bytes
+void tu_edpt_stream_read_xfer_complete_offset(tu_edpt_stream_t* s, uint32_t xferred_bytes, uint32_t skip_offset);
+
+// Same as tu_edpt_stream_read_xfer_complete but skip the first n bytes of every packet of a multi-packet transfer
+// e.g status header prepended to each packet by FTDI
+void tu_edpt_stream_read_xfer_complete_strip(tu_edpt_stream_t* s, uint32_t xferred_bytes, uint16_t header_len);
+
 // Must be called in the transfer complete callback
 TU_ATTR_ALWAYS_INLINE static inline
 void tu_edpt_stream_read_xfer_complete(tu_edpt_stream_t* s, uint32_t xferred_bytes) {
-  if (tu_fifo_depth(&s->ff)) {
-    tu_fifo_write_n(&s->ff, s->ep_buf, (uint16_t) xferred_bytes);
-  }
-}
-
-// Same as tu_edpt_stream_read_xfer_complete but skip the first n bytes
-TU_ATTR_ALWAYS_INLINE static inline
-void tu_edpt_stream_read_xfer_complete_offset(tu_edpt_stream_t* s, uint32_t xferred_bytes, uint32_t skip_offset) {
-  if (tu_fifo_depth(&s->ff) && (skip_offset < xferred_bytes)) {
-    tu_fifo_write_n(&s->ff, s->ep_buf + skip_offset, (uint16_t) (xferred_bytes - skip_offset));
-  }
+  tu_edpt_stream_read_xfer_complete_offset(s, xferred_bytes, 0);
 }
 
 // Get the number of bytes available for reading
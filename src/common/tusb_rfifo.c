@@ -0,0 +1,174 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+
+#include "tusb_option.h"
+#include "tusb_rfifo.h"
+
+// Header value of the unused tail left when a record is placed at the beginning of the buffer
+#define RFIFO_PAD   0xFFFFFFFFu
+
+TU_ATTR_ALWAYS_INLINE static inline uint32_t hdr_read(const tu_rfifo_t* f, uint16_t idx) {
+  return tu_unaligned_read32(f->buffer + idx);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void hdr_write(tu_rfifo_t* f, uint16_t idx, uint32_t hdr) {
+  tu_unaligned_write32(f->buffer + idx, hdr);
+}
+
+bool tu_rfifo_config(tu_rfifo_t* f, void* buffer, uint16_t size) {
+  size = (uint16_t) (size & ~3u);
+  TU_ASSERT(buffer && size >= TU_RFIFO_RECORD_SIZE(1) * 2);
+
+  f->buffer = (uint8_t*) buffer;
+  f->size = size;
+  tu_rfifo_clear(f);
+
+  return true;
+}
+
+void tu_rfifo_clear(tu_rfifo_t* f) {
+  f->wr_idx = f->rd_idx = 0;
+  f->wr_count = f->rd_count = 0;
+  f->rsv_idx = f->rsv_size = 0;
+}
+
+//--------------------------------------------------------------------+
+// Producer
+//--------------------------------------------------------------------+
+
+void* tu_rfifo_reserve(tu_rfifo_t* f, uint16_t len) {
+  const uint32_t need = TU_RFIFO_RECORD_SIZE(len);
+  const uint16_t wr = f->wr_idx;
+  const uint16_t rd = f->rd_idx;
+  uint16_t start;
+
+  f->rsv_size = 0;
+
+  if (wr >= rd) {
+    // free space is wr..size then 0..rd
+    if (wr + need <= f->size) {
+      start = wr;
+    } else if (need < rd) {
+      start = 0; // wrap, write index must not catch up with read index
+    } else {
+      return NULL;
+    }
+  } else {
+    // free space is wr..rd
+    if (wr + need < rd) {
+      start = wr;
+    } else {
+      return NULL;
+    }
+  }
+
+  f->rsv_idx = start;
+  f->rsv_size = (uint16_t) need;
+
+  return f->buffer + start + 4;
+}
+
+bool tu_rfifo_commit(tu_rfifo_t* f, uint16_t len) {
+  TU_VERIFY(f->rsv_size && TU_RFIFO_RECORD_SIZE(len) <= f->rsv_size);
+
+  const uint16_t wr = f->wr_idx;
+  const uint16_t start = f->rsv_idx;
+
+  hdr_write(f, start, len);
+
+  // placed at the beginning: mark the tail so that reader skips it. Not needed if it is too short for a header
+  if (start != wr && wr + 4u <= f->size) {
+    hdr_write(f, wr, RFIFO_PAD);
+  }
+
+  f->rsv_size = 0;
+
+  // count first, so it never runs behind what reader can see
+  f->wr_count++;
+  f->wr_idx = (uint16_t) (start + TU_RFIFO_RECORD_SIZE(len));
+
+  return true;
+}
+
+bool tu_rfifo_write(tu_rfifo_t* f, const void* data, uint16_t len) {
+  void* dst = tu_rfifo_reserve(f, len);
+  TU_VERIFY(dst);
+
+  memcpy(dst, data, len);
+  return tu_rfifo_commit(f, len);
+}
+
+//--------------------------------------------------------------------+
+// Consumer
+//--------------------------------------------------------------------+
+
+// index of the oldest record with tail skipped, UINT16_MAX if fifo is empty
+static uint16_t rd_record(tu_rfifo_t* f) {
+  uint16_t rd = f->rd_idx;
+  if (rd == f->wr_idx) {
+    return UINT16_MAX;
+  }
+
+  // writer placed next record at the beginning, no record can start at the tail
+  if (rd + 4u > f->size || hdr_read(f, rd) == RFIFO_PAD) {
+    rd = 0;
+    f->rd_idx = 0;
+  }
+
+  return rd;
+}
+
+void* tu_rfifo_peek(tu_rfifo_t* f, uint16_t* len) {
+  const uint16_t rd = rd_record(f);
+  TU_VERIFY(rd != UINT16_MAX, NULL);
+
+  *len = (uint16_t) hdr_read(f, rd);
+  return f->buffer + rd + 4;
+}
+
+bool tu_rfifo_pop(tu_rfifo_t* f) {
+  const uint16_t rd = rd_record(f);
+  TU_VERIFY(rd != UINT16_MAX);
+
+  const uint16_t len = (uint16_t) hdr_read(f, rd);
+  f->rd_idx = (uint16_t) (rd + TU_RFIFO_RECORD_SIZE(len));
+  f->rd_count++;
+
+  return true;
+}
+
+bool tu_rfifo_read(tu_rfifo_t* f, void* buffer, uint16_t bufsize, uint16_t* len) {
+  uint16_t rec_len;
+  const void* rec = tu_rfifo_peek(f, &rec_len);
+  TU_VERIFY(rec);
+
+  const uint16_t count = tu_min16(rec_len, bufsize);
+  memcpy(buffer, rec, count);
+  *len = count;
+
+  return tu_rfifo_pop(f);
+}
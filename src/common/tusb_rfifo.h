@@ -0,0 +1,107 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+
+#ifndef _TUSB_RFIFO_H_
+#define _TUSB_RFIFO_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common/tusb_common.h"
+
+// Record fifo: variable length records (e.g HID reports, MIDI packets, network datagrams, USBTMC messages) that keep
+// their boundaries. Each record is a 4-byte length header followed by its payload padded to 4 bytes, and is always
+// contiguous in the buffer: a record that does not fit before the end of the buffer is placed at the beginning, the
+// writer leaves a pad marker so that the reader skips the tail. This allows the producer to reserve space and
+// receive/build a record in place, and the consumer to access a whole record in place (e.g as endpoint buffer).
+// Payload is 4-byte aligned if the buffer is.
+// Single producer, single consumer: reserve/commit must be called from one context, peek/pop from another.
+
+// Buffer bytes taken by a record of len payload bytes
+#define TU_RFIFO_RECORD_SIZE(_len)   (4u + (((uint32_t) (_len) + 3u) & ~3u))
+
+// Buffer size to hold _count records of up to _len bytes at once, including the space lost to wrap-around
+#define TU_RFIFO_BUFSIZE(_count, _len)   (((_count) + 1u) * TU_RFIFO_RECORD_SIZE(_len))
+
+typedef struct {
+  uint8_t* buffer;
+  uint16_t size;             // buffer size in bytes, multiple of 4
+  volatile uint16_t wr_idx;  // offset where next record is written, only changed by producer
+  volatile uint16_t rd_idx;  // offset of oldest record, only changed by consumer
+  uint16_t rsv_idx;          // offset of the reserved record
+  uint16_t rsv_size;         // buffer bytes of the reserved record, 0 if nothing is reserved
+  volatile uint16_t wr_count; // records written, free running
+  volatile uint16_t rd_count; // records read, free running
+} tu_rfifo_t;
+
+#define TU_RFIFO_INIT(_buffer, _size) { .buffer = (uint8_t*) (_buffer), .size = (uint16_t) ((_size) & ~3u) }
+
+// Configure fifo with buffer of size bytes (rounded down to multiple of 4), buffer should be 4-byte aligned
+bool tu_rfifo_config(tu_rfifo_t* f, void* buffer, uint16_t size);
+
+// Discard all records, must not be called while producer or consumer is active
+void tu_rfifo_clear(tu_rfifo_t* f);
+
+//------------- Producer -------------//
+
+// Reserve contiguous space for a record of up to len bytes, return NULL if fifo does not have room.
+// The record is not visible to the consumer until committed, reserving again drops the previous reservation
+void* tu_rfifo_reserve(tu_rfifo_t* f, uint16_t len);
+
+// Publish the reserved record with its actual length, which must not exceed the reserved length
+bool tu_rfifo_commit(tu_rfifo_t* f, uint16_t len);
+
+// Copy a record into fifo, return false if there is no room
+bool tu_rfifo_write(tu_rfifo_t* f, const void* data, uint16_t len);
+
+//------------- Consumer -------------//
+
+// Oldest record in place without removing it, return NULL if fifo is empty
+void* tu_rfifo_peek(tu_rfifo_t* f, uint16_t* len);
+
+// Remove the oldest record
+bool tu_rfifo_pop(tu_rfifo_t* f);
+
+// Copy and remove the oldest record, payload beyond bufsize is discarded. len is set to the number of bytes copied,
+// return false if fifo is empty
+bool tu_rfifo_read(tu_rfifo_t* f, void* buffer, uint16_t bufsize, uint16_t* len);
+
+// Number of records in fifo
+TU_ATTR_ALWAYS_INLINE static inline uint16_t tu_rfifo_count(const tu_rfifo_t* f) {
+  return (uint16_t) (f->wr_count - f->rd_count);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline bool tu_rfifo_empty(const tu_rfifo_t* f) {
+  return f->wr_idx == f->rd_idx;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
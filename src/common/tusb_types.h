@@ -278,6 +278,31 @@ typedef enum {
   XFER_RESULT_INVALID
 } xfer_result_t;
 
+// A buffer of scatter-gather transfer list
+typedef struct {
+  uint8_t* buffer;
+  uint32_t len;
+} tu_xfer_sg_t;
+
+// Packet of an isochronous transfer, one per service interval. Packets are back to back in the transfer buffer i.e
+// each starts at the sum of len of previous ones, actual_len and result are written on completion
+typedef struct {
+  uint16_t len;        // requested bytes, at most max packet size (x mult for highspeed high-bandwidth)
+  uint16_t actual_len; // transferred bytes
+  uint8_t  result;     // xfer_result_t of this packet
+} tu_iso_packet_t;
+
+// Start isochronous transfer as soon as possible: right after the previous one of the stream if it is still on time
+#define TU_ISO_START_ASAP  UINT32_MAX
+
+// Endpoint buffer of a static packet memory layout e.g computed at compile time by device/usbd_desc.hpp
+typedef struct {
+  uint8_t  ep_addr; // endpoint address, 0x00 is the shared RX FIFO of dwc2
+  uint8_t  dbuf;    // double buffered
+  uint16_t offset;  // byte offset in packet memory
+  uint16_t size;    // bytes, including the 2nd buffer if double buffered
+} tu_edpt_mem_t;
+
 // TODO remove
 enum {
   DESC_OFFSET_LEN  = 0,
@@ -553,6 +578,16 @@ TU_ATTR_ALWAYS_INLINE static inline uint16_t tu_edpt_packet_size(tusb_desc_endpo
   return tu_le16toh(desc_ep->wMaxPacketSize) & 0x7FF;
 }
 
+// Get number of transactions per micro-frame (1-3) for highspeed high-bandwidth periodic endpoint
+TU_ATTR_ALWAYS_INLINE static inline uint8_t tu_edpt_hs_mult(tusb_desc_endpoint_t const* desc_ep) {
+  return (uint8_t) (1 + ((tu_le16toh(desc_ep->wMaxPacketSize) >> 11) & 0x03));
+}
+
+// Get max bytes per service interval: packet size times transactions per micro-frame, up to 3072 for high-bandwidth
+TU_ATTR_ALWAYS_INLINE static inline uint16_t tu_edpt_interval_size(tusb_desc_endpoint_t const* desc_ep) {
+  return (uint16_t) (tu_edpt_hs_mult(desc_ep) * tu_edpt_packet_size(desc_ep));
+}
+
 #if CFG_TUSB_DEBUG
 TU_ATTR_ALWAYS_INLINE static inline const char *tu_edpt_type_str(tusb_xfer_type_t t) {
   tu_static const char *str[] = {"control", "isochronous", "bulk", "interrupt"};
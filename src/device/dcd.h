@@ -44,11 +44,14 @@ typedef enum {
   DCD_EVENT_BUS_RESET,      // 1
   DCD_EVENT_UNPLUGGED,      // 2
   DCD_EVENT_SOF,            // 3
-  DCD_EVENT_SUSPEND,        // 4 TODO LPM Sleep L1 support
+  DCD_EVENT_SUSPEND,        // 4 L2 suspend, LPM L1 sleep is DCD_EVENT_LPM_SLEEP
   DCD_EVENT_RESUME,         // 5
   DCD_EVENT_SETUP_RECEIVED, // 6
   DCD_EVENT_XFER_COMPLETE,  // 7
   USBD_EVENT_FUNC_CALL,     // 8 Not an DCD event, just a convenient way to defer ISR function
+  USBD_EVENT_PRIORITY,      // 9 Not an DCD event, wake up usbd task to process priority queue
+  DCD_EVENT_LPM_SLEEP,      // 10 LPM L1 sleep, exit is reported by DCD as DCD_EVENT_RESUME
+  USBD_EVENT_LPM_RESUME,    // 11 Not an DCD event, DCD_EVENT_RESUME while in L1 sleep
   DCD_EVENT_COUNT
 } dcd_eventid_t;
 
@@ -70,6 +73,12 @@ typedef struct TU_ATTR_ALIGNED(4) {
     // SETUP_RECEIVED
     tusb_control_request_t setup_received;
 
+    // LPM_SLEEP
+    struct {
+      uint8_t besl;          // BESL (or HIRD) from the LPM token
+      uint8_t remote_wakeup; // bRemoteWake from the LPM token
+    } lpm_sleep;
+
     // XFER_COMPLETE
     struct {
       uint8_t  ep_addr;
@@ -107,14 +116,21 @@ bool dcd_dcache_clean_invalidate(const void* addr, uint32_t data_size);
 // Controller API
 //--------------------------------------------------------------------+
 
+// optional dcd configuration, called by tud_configure()
+bool dcd_configure(uint8_t rhport, uint32_t cfg_id, const void* cfg_param);
+
 // Initialize controller to device mode
 bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init);
 
 // Deinitialize controller, unset device mode.
 bool dcd_deinit(uint8_t rhport);
 
+// Optional: continue controller bring-up started by dcd_init() e.g waiting for core reset or PHY clock, so that
+// dcd_init() can return early. Called by stack (also from tud_task()) until it returns true. Default returns true
+bool dcd_init_poll(uint8_t rhport);
+
 // Interrupt Handler
-void dcd_int_handler(uint8_t rhport);
+TU_ATTR_FAST_FUNC void dcd_int_handler(uint8_t rhport);
 
 // Enable device interrupt
 void dcd_int_enable (uint8_t rhport);
@@ -157,6 +173,15 @@ bool dcd_edpt_open            (uint8_t rhport, tusb_desc_endpoint_t const * desc
 // required for multiple configuration support.
 void dcd_edpt_close_all       (uint8_t rhport);
 
+// Invoked by SET_CONFIGURATION before any endpoint of the configuration is opened, with the whole configuration
+// descriptor including all alternate settings. May help DCD to plan its packet memory, this API is optional.
+void dcd_edpt_plan            (uint8_t rhport, tusb_desc_configuration_t const * desc_cfg) TU_ATTR_WEAK;
+
+// Invoked by SET_CONFIGURATION before any endpoint of the configuration is opened, with static packet memory layout
+// from tud_edpt_mem_plan_cb(). Return false if layout is not accepted, dcd_edpt_plan() is then invoked instead.
+// This API is optional.
+bool dcd_edpt_mem_plan        (uint8_t rhport, tu_edpt_mem_t const * mem, uint8_t count) TU_ATTR_WEAK;
+
 // Submit a transfer, When complete dcd_event_xfer_complete() is invoked to notify the stack
 bool dcd_edpt_xfer            (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes);
 
@@ -164,6 +189,16 @@ bool dcd_edpt_xfer            (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer
 // This API is optional, may be useful for register-based for transferring data.
 bool dcd_edpt_xfer_fifo       (uint8_t rhport, uint8_t ep_addr, tu_fifo_t * ff, uint16_t total_bytes) TU_ATTR_WEAK;
 
+// Submit a scatter-gather transfer of count buffers as one transfer e.g by chaining its DMA descriptors.
+// dcd_event_xfer_complete() is invoked once with total transferred bytes of the whole list. List must be
+// kept valid until transfer is complete. This API is optional, usbd submits each buffer sequentially otherwise.
+bool dcd_edpt_xfer_sg         (uint8_t rhport, uint8_t ep_addr, tu_xfer_sg_t const * sg_list, uint8_t count) TU_ATTR_WEAK;
+
+// Submit count isochronous packets (back to back in buffer) as one transfer, one packet per service interval in
+// consecutive (micro)frames. actual_len and result of each packet are written before dcd_event_xfer_complete() is
+// invoked once with the total. This API is optional, usbd submits each packet sequentially otherwise.
+bool dcd_edpt_iso_xfer        (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, tu_iso_packet_t * packets, uint16_t count) TU_ATTR_WEAK;
+
 // Stall endpoint, any queuing transfer should be removed from endpoint
 void dcd_edpt_stall           (uint8_t rhport, uint8_t ep_addr);
 
@@ -237,6 +272,26 @@ TU_ATTR_ALWAYS_INLINE static inline void dcd_event_sof(uint8_t rhport, uint32_t
   dcd_event_handler(&event, in_isr);
 }
 
+// helper to send LPM L1 sleep event, after the LPM token is ACKed
+TU_ATTR_ALWAYS_INLINE static inline void dcd_event_lpm_sleep(uint8_t rhport, uint8_t besl, bool remote_wakeup, bool in_isr) {
+  dcd_event_t event;
+  event.rhport = rhport;
+  event.event_id = DCD_EVENT_LPM_SLEEP;
+  event.lpm_sleep.besl = besl;
+  event.lpm_sleep.remote_wakeup = remote_wakeup ? 1 : 0;
+  dcd_event_handler(&event, in_isr);
+}
+
+// helper to defer remaining ISR work to device task e.g FIFO copy exceeding ISR budget, func is called with param
+TU_ATTR_ALWAYS_INLINE static inline void dcd_event_func_call(uint8_t rhport, void (*func)(void*), void* param, bool in_isr) {
+  dcd_event_t event;
+  event.rhport = rhport;
+  event.event_id = USBD_EVENT_FUNC_CALL;
+  event.func_call.func = func;
+  event.func_call.param = param;
+  dcd_event_handler(&event, in_isr);
+}
+
 #ifdef __cplusplus
  }
 #endif
@@ -42,6 +42,48 @@
   #define CFG_TUD_TASK_QUEUE_SZ   16
 #endif
 
+// Size of optional priority queue, 0 (default) to put all events in a single queue. When enabled, bus reset, unplugged,
+// SETUP and completions of control and interrupt/isochronous endpoints go to this queue, which is emptied before the
+// main queue is served, so that e.g HID reports or audio packets are not waiting behind a burst of bulk completions.
+// These events therefore overtake bulk completions and other events already in the main queue: a bus reset or SETUP
+// can be processed before a bulk completion that arrived earlier.
+#ifndef CFG_TUD_TASK_PRIORITY_QUEUE_SZ
+  #define CFG_TUD_TASK_PRIORITY_QUEUE_SZ   0
+#endif
+
+// Maximum number of events processed by one tud_task_ext() call before returning to application, remaining events
+// are processed on next call (see tud_task_event_ready()). Bounds main loop latency of a superloop under heavy
+// traffic. Events of main queue are served in arrival order, each endpoint has at most one completion per transfer
+// queued so endpoints are serviced round-robin. With CFG_TUD_TASK_PRIORITY_QUEUE_SZ, queued priority events are served
+// before the next main queue event and count against the same budget. 0 for no limit
+#ifndef CFG_TUD_TASK_EVENT_MAX
+  #define CFG_TUD_TASK_EVENT_MAX   0
+#endif
+
+// Merge events that arrive while a previous one of the same kind is still queued: SOF events only keep the latest
+// frame count, completions on a (non-control) endpoint are reported as one callback with the summed length
+#ifndef CFG_TUD_EVENT_COALESCE
+  #define CFG_TUD_EVENT_COALESCE   0
+#endif
+
+// Resolve class drivers at compile time: only built-in drivers enabled by CFG_TUD_* are used (usbd_app_driver_get_cb()
+// is ignored), so driver lookup is constant and with a single class its callbacks are called directly
+#ifndef CFG_TUD_DRIVER_STATIC
+  #define CFG_TUD_DRIVER_STATIC   0
+#endif
+
+// Number of configurations whose interface to driver binding is remembered, next SET_CONFIGURATION of the same
+// configuration opens the known driver directly instead of probing all drivers. BOS descriptor is also cached.
+// Cache is kept across bus reset, call tud_descriptor_cache_invalidate() if descriptors are changed at runtime
+#ifndef CFG_TUD_DESC_CACHE
+  #define CFG_TUD_DESC_CACHE   0
+#endif
+
+// Buffer to cache string descriptors (copied, since callback typically builds them in a shared buffer). 0 to disable
+#ifndef CFG_TUD_DESC_CACHE_STRING_BUFSIZE
+  #define CFG_TUD_DESC_CACHE_STRING_BUFSIZE   0
+#endif
+
 //--------------------------------------------------------------------+
 // Weak stubs: invoked if no strong implementation is available
 //--------------------------------------------------------------------+
@@ -53,6 +95,10 @@ TU_ATTR_WEAK void tud_sof_cb(uint32_t frame_count) {
   (void) frame_count;
 }
 
+TU_ATTR_WEAK uint32_t tud_stats_timestamp_cb(void) {
+  return 0;
+}
+
 TU_ATTR_WEAK uint8_t const* tud_descriptor_bos_cb(void) {
   return NULL;
 }
@@ -66,6 +112,19 @@ TU_ATTR_WEAK uint8_t const* tud_descriptor_other_speed_configuration_cb(uint8_t
   return NULL;
 }
 
+TU_ATTR_WEAK tud_desc_function_t const* tud_descriptor_configuration_layout_cb(uint8_t index, uint8_t* count) {
+  (void) index;
+  *count = 0;
+  return NULL;
+}
+
+TU_ATTR_WEAK tu_edpt_mem_t const* tud_edpt_mem_plan_cb(uint8_t rhport, uint8_t index, uint8_t* count) {
+  (void) rhport;
+  (void) index;
+  *count = 0;
+  return NULL;
+}
+
 TU_ATTR_WEAK void tud_mount_cb(void) {
 }
 
@@ -79,16 +138,33 @@ TU_ATTR_WEAK void tud_suspend_cb(bool remote_wakeup_en) {
 TU_ATTR_WEAK void tud_resume_cb(void) {
 }
 
+TU_ATTR_WEAK void tud_lpm_sleep_cb(uint8_t besl, bool remote_wakeup_en) {
+  (void) besl; (void) remote_wakeup_en;
+}
+
+TU_ATTR_WEAK void tud_lpm_resume_cb(void) {
+}
+
 TU_ATTR_WEAK bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const* request) {
   (void) rhport; (void) stage; (void) request;
   return false;
 }
 
+TU_ATTR_WEAK bool dcd_configure(uint8_t rhport, uint32_t cfg_id, const void* cfg_param) {
+  (void) rhport; (void) cfg_id; (void) cfg_param;
+  return false;
+}
+
 TU_ATTR_WEAK bool dcd_deinit(uint8_t rhport) {
   (void) rhport;
   return false;
 }
 
+TU_ATTR_WEAK bool dcd_init_poll(uint8_t rhport) {
+  (void) rhport;
+  return true;
+}
+
 TU_ATTR_WEAK void dcd_connect(uint8_t rhport) {
   (void) rhport;
 }
@@ -119,6 +195,50 @@ TU_ATTR_WEAK bool dcd_dcache_clean_invalidate(const void* addr, uint32_t data_si
 // Invalid driver ID in itf2drv[] ep2drv[][] mapping
 enum { DRVID_INVALID = 0xFFu };
 
+// usbd submits a transfer to dcd part by part for scatter-gather list (without dcd support) or
+// transfer larger than TUP_DCD_EDPT_XFER_MAX
+#define USBD_XFER_SPLIT   (CFG_TUD_EDPT_XFER_SG || CFG_TUD_EDPT_XFER_LARGE)
+
+#if USBD_XFER_SPLIT
+typedef struct {
+  tu_xfer_sg_t const* sg_next; // remaining scatter-gather buffers
+  uint8_t* buffer;             // current part
+  uint32_t remaining;          // remaining bytes of current buffer including current part
+  uint32_t xferred;            // total transferred bytes
+  uint16_t part_len;           // length of current part submitted to dcd
+  uint8_t sg_count;            // number of sg_next buffers
+  uint8_t active;
+} usbd_xfer_split_t;
+#endif
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+// Transfers queued behind the one on dcd with usbd_edpt_xfer_queue(), dcd_event_handler() submits the next one
+// as soon as the previous completes. Shared between usbd task and ISR, protected by _usbd_spin
+typedef struct {
+  struct {
+    uint8_t* buffer;
+    uint16_t len;
+  } entry[CFG_TUD_EDPT_XFER_QUEUE];
+  uint8_t rd;
+  uint8_t count;   // entries waiting for the transfer on dcd
+  uint8_t pending; // submitted transfers whose completion is not delivered to driver yet
+  uint8_t running; // a queued transfer is on dcd
+} usbd_xfer_queue_t;
+#endif
+
+#if CFG_TUD_EDPT_ISO_XFER
+// Packet list of usbd_edpt_iso_xfer() submitted packet by packet from dcd_event_handler(), for dcd without support
+typedef struct {
+  tu_iso_packet_t* packets;
+  uint8_t* buffer;    // current packet
+  uint32_t xferred;   // total transferred bytes
+  uint16_t count;
+  uint16_t idx;       // current packet
+  uint8_t result;     // failed if any packet failed
+  uint8_t active;
+} usbd_iso_xfer_t;
+#endif
+
 typedef struct {
   struct TU_ATTR_PACKED {
     volatile uint8_t connected    : 1;
@@ -128,6 +248,9 @@ typedef struct {
     uint8_t remote_wakeup_en      : 1; // enable/disable by host
     uint8_t remote_wakeup_support : 1; // configuration descriptor's attribute
     uint8_t self_powered          : 1; // configuration descriptor's attribute
+    volatile uint8_t lpm_sleep    : 1; // link is in LPM L1 sleep
+    uint8_t lpm_remote_wakeup     : 1; // bRemoteWake of the LPM token
+    volatile uint8_t wakeup_pending : 1; // remote wakeup is signaled, bus is not resumed yet
   };
   volatile uint8_t cfg_num; // current active configuration (0x00 is not configured)
   uint8_t speed;
@@ -135,13 +258,68 @@ typedef struct {
 
   uint8_t itf2drv[CFG_TUD_INTERFACE_MAX];   // map interface number to driver (0xff is invalid)
   uint8_t ep2drv[CFG_TUD_ENDPPOINT_MAX][2]; // map endpoint to driver ( 0xff is invalid ), can use only 4-bit each
+  uint8_t ep2inst[CFG_TUD_ENDPPOINT_MAX][2]; // driver instance set by usbd_edpt_instance_set() ( 0xff is invalid )
 
   tu_edpt_state_t ep_status[CFG_TUD_ENDPPOINT_MAX][2];
+  uint16_t ep_periodic[2]; // bitmap of interrupt/isochronous endpoints for each direction
+  uint16_t ep_isr_cb[2];   // bitmap of endpoints whose xfer_cb() is invoked directly in ISR
+
+#if USBD_XFER_SPLIT
+  usbd_xfer_split_t ep_split[CFG_TUD_ENDPPOINT_MAX][2];
+#endif
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+  usbd_xfer_queue_t ep_queue[CFG_TUD_ENDPPOINT_MAX][2];
+#endif
+
+#if CFG_TUD_EDPT_ISO_XFER
+  usbd_iso_xfer_t ep_iso[CFG_TUD_ENDPPOINT_MAX][2];
+#endif
 
 }usbd_device_t;
 
-tu_static usbd_device_t _usbd_dev;
-static volatile uint8_t _usbd_queued_setup;
+// one device stack for each controller running in device mode
+TU_ATTR_FAST_DATA tu_static usbd_device_t _usbd_dev[CFG_TUD_RHPORT_NUM];
+static volatile uint8_t _usbd_queued_setup[CFG_TUD_RHPORT_NUM];
+
+#if CFG_TUD_DESC_CACHE
+typedef struct {
+  uint8_t const* desc_cfg; // descriptor returned by tud_descriptor_configuration_cb(), 0 if entry is empty
+  uint16_t total_len;
+  uint8_t cfg_num;
+  uint8_t itf2drv[CFG_TUD_INTERFACE_MAX]; // binding result of this configuration
+} usbd_cfg_cache_t;
+
+// Not part of _usbd_dev since it must survive bus reset
+static struct {
+  usbd_cfg_cache_t cfg[CFG_TUD_DESC_CACHE];
+
+  uint8_t const* bos;
+  uint16_t bos_len;
+
+  #if CFG_TUD_DESC_CACHE_STRING_BUFSIZE
+  // entries of [index, langid (2 bytes), reserved] followed by string descriptor padded to 4 bytes
+  uint16_t str_used;
+  TU_ATTR_ALIGNED(4) uint8_t str_buf[CFG_TUD_DESC_CACHE_STRING_BUFSIZE];
+  #endif
+} _usbd_desc_cache[CFG_TUD_RHPORT_NUM];
+#endif
+
+#if CFG_TUD_EPBUF_POOL_SIZE
+// Endpoint buffer pool shared by class drivers, see usbd_epbuf_alloc()
+#define EPBUF_POOL_UNITS  (CFG_TUD_EPBUF_POOL_SIZE / CFG_TUD_EPBUF_POOL_UNIT)
+TU_VERIFY_STATIC(EPBUF_POOL_UNITS > 0 && EPBUF_POOL_UNITS <= UINT16_MAX, "invalid CFG_TUD_EPBUF_POOL_SIZE");
+TU_VERIFY_STATIC(CFG_TUD_EPBUF_POOL_UNIT % 4 == 0 && !(CFG_TUD_MEM_DCACHE_ENABLE &&
+                 CFG_TUD_EPBUF_POOL_UNIT % CFG_TUD_MEM_DCACHE_LINE_SIZE), "invalid CFG_TUD_EPBUF_POOL_UNIT");
+
+typedef struct {
+  TUD_EPBUF_DEF(buf, EPBUF_POOL_UNITS * CFG_TUD_EPBUF_POOL_UNIT);
+} usbd_epbuf_pool_mem_t;
+
+CFG_TUD_MEM_SECTION static usbd_epbuf_pool_mem_t _usbd_epbuf_pool_mem;
+static uint32_t _usbd_epbuf_pool_map[2][TU_MEMPOOL_MAP_WORDS(EPBUF_POOL_UNITS)];
+static tu_mempool_t _usbd_epbuf_pool;
+#endif
 
 //--------------------------------------------------------------------+
 // Class Driver
@@ -163,7 +341,11 @@ tu_static usbd_class_driver_t const _usbd_driver[] = {
         .open             = cdcd_open,
         .control_xfer_cb  = cdcd_control_xfer_cb,
         .xfer_cb          = cdcd_xfer_cb,
+      #if CFG_TUD_CDC_TX_FLUSH_IDLE_MS
+        .sof              = cdcd_sof
+      #else
         .sof              = NULL
+      #endif
     },
     #endif
 
@@ -189,7 +371,11 @@ tu_static usbd_class_driver_t const _usbd_driver[] = {
         .open             = hidd_open,
         .control_xfer_cb  = hidd_control_xfer_cb,
         .xfer_cb          = hidd_xfer_cb,
+      #if CFG_TUD_HID_SOF_SYNC
+        .sof              = hidd_sof
+      #else
         .sof              = NULL
+      #endif
     },
     #endif
 
@@ -215,7 +401,11 @@ tu_static usbd_class_driver_t const _usbd_driver[] = {
         .open             = videod_open,
         .control_xfer_cb  = videod_control_xfer_cb,
         .xfer_cb          = videod_xfer_cb,
+      #if CFG_TUD_VIDEO_STREAMING_TIMESTAMP
+        .sof              = videod_sof
+      #else
         .sof              = NULL
+      #endif
     },
     #endif
 
@@ -293,7 +483,11 @@ tu_static usbd_class_driver_t const _usbd_driver[] = {
         .open             = netd_open,
         .control_xfer_cb  = netd_control_xfer_cb,
         .xfer_cb          = netd_xfer_cb,
-        .sof                  = NULL,
+      #if CFG_TUD_NCM || (CFG_TUD_ECM_RNDIS && CFG_TUD_RNDIS_IN_FLUSH_TIMEOUT_US)
+        .sof              = netd_sof,
+      #else
+        .sof              = NULL,
+      #endif
     },
     #endif
 
@@ -313,6 +507,17 @@ tu_static usbd_class_driver_t const _usbd_driver[] = {
 
 enum { BUILTIN_DRIVER_COUNT = TU_ARRAY_SIZE(_usbd_driver) };
 
+#if CFG_TUD_DRIVER_STATIC
+TU_VERIFY_STATIC(BUILTIN_DRIVER_COUNT > 0, "CFG_TUD_DRIVER_STATIC requires at least one built-in class driver");
+
+#define TOTAL_DRIVER_COUNT    BUILTIN_DRIVER_COUNT
+
+// driver table is constant, compiler can fold the callback pointers e.g when there is only one driver
+TU_ATTR_ALWAYS_INLINE static inline usbd_class_driver_t const * get_driver(uint8_t drvid) {
+  return (drvid < BUILTIN_DRIVER_COUNT) ? &_usbd_driver[drvid] : NULL;
+}
+
+#else
 // Additional class drivers implemented by application
 tu_static usbd_class_driver_t const * _app_driver = NULL;
 tu_static uint8_t _app_driver_count = 0;
@@ -331,20 +536,120 @@ TU_ATTR_ALWAYS_INLINE static inline usbd_class_driver_t const * get_driver(uint8
   }
   return driver;
 }
-
+#endif
 
 //--------------------------------------------------------------------+
 // DCD Event
 //--------------------------------------------------------------------+
 
-enum { RHPORT_INVALID = 0xFFu };
-tu_static uint8_t _usbd_rhport = RHPORT_INVALID;
+TU_VERIFY_STATIC(CFG_TUD_RHPORT_NUM > 0 && CFG_TUD_RHPORT_NUM <= TUP_USBIP_CONTROLLER_NUM, "invalid CFG_TUD_RHPORT_NUM");
+
+tu_static uint8_t _usbd_rhport[CFG_TUD_RHPORT_NUM]; // controller of each device stack
+tu_static uint8_t _usbd_inited;                     // bitmap of initialized device stacks
+tu_static uint8_t _usbd_init_pending;               // bitmap of device stacks whose controller is not ready yet
+tu_static uint8_t _usbd_event_rhport;               // controller of event being processed by usbd task
+
+// Device stack index of a controller. Controller without device stack (e.g rhport hard-coded to 0 by class driver
+// API) refers to the first one, which is the only one with CFG_TUD_RHPORT_NUM = 1
+TU_ATTR_ALWAYS_INLINE static inline uint8_t get_index(uint8_t rhport) {
+#if CFG_TUD_RHPORT_NUM > 1
+  for (uint8_t i = 1; i < CFG_TUD_RHPORT_NUM; i++) {
+    if (tu_bit_test(_usbd_inited, i) && _usbd_rhport[i] == rhport) {
+      return i;
+    }
+  }
+#endif
+  (void) rhport;
+  return 0;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline usbd_device_t* get_device(uint8_t rhport) {
+  return &_usbd_dev[get_index(rhport)];
+}
+
+#if CFG_TUD_RHPORT_NUM > 1
+uint8_t usbd_rhport_index(uint8_t rhport) {
+  return get_index(rhport);
+}
+#endif
 
 // Event queue
 // usbd_int_set() is used as mutex in OS NONE config
 OSAL_QUEUE_DEF(usbd_int_set, _usbd_qdef, CFG_TUD_TASK_QUEUE_SZ, dcd_event_t);
 tu_static osal_queue_t _usbd_q;
 
+#if CFG_TUD_TASK_PRIORITY_QUEUE_SZ
+OSAL_QUEUE_DEF(usbd_int_set, _usbd_pqdef, CFG_TUD_TASK_PRIORITY_QUEUE_SZ, dcd_event_t);
+tu_static osal_queue_t _usbd_pq;
+#endif
+
+// events dropped due to full queue: main, priority
+tu_static uint32_t _usbd_event_dropped[2];
+
+// Protect data shared between usbd task and ISR, which may run on another core. Fallback to usbd_int_set()
+OSAL_SPINLOCK_DEF(_usbd_spin, usbd_int_set);
+
+// tud_sof_cb() is invoked once every interval SOFs, counted in ISR
+tu_static uint16_t _usbd_sof_cb_interval = 1;
+tu_static uint16_t _usbd_sof_cb_count;
+
+#if CFG_TUD_STATS
+tu_static tud_stats_t _usbd_stats; // ISR time and queue high-water, event counts are computed below
+tu_static tud_stats_edpt_t _usbd_stats_edpt[CFG_TUD_ENDPPOINT_MAX][2];
+
+// Events queued (written in ISR) and taken by usbd task (written in task) for main, priority queue. Never reset so
+// that their difference is number of waiting events, clearing statistics only moves the base
+tu_static uint32_t _usbd_stats_queued[2];
+tu_static uint32_t _usbd_stats_received[2];
+tu_static uint32_t _usbd_stats_queued_base[2];
+
+// Bring-up time of first controller, from tud_rhport_init() timestamp
+tu_static uint32_t _usbd_stats_init_start;
+tu_static uint32_t _usbd_stats_init_time;
+tu_static uint32_t _usbd_stats_mount_time;
+#endif
+
+#if CFG_TUD_EVENT_COALESCE
+// Completions merged into an XFER_COMPLETE event that is still queued. Not cleared by bus reset since it tracks
+// events in the queue, not endpoint state.
+typedef struct {
+  uint32_t len;
+  uint16_t count; // number of merged completions, 0 if no event is queued
+  uint8_t result;
+} usbd_xfer_coalesce_t;
+
+tu_static usbd_xfer_coalesce_t _usbd_xfer_coalesce[CFG_TUD_RHPORT_NUM][CFG_TUD_ENDPPOINT_MAX][2];
+tu_static volatile bool _usbd_sof_queued[CFG_TUD_RHPORT_NUM];
+tu_static volatile uint32_t _usbd_sof_frame[CFG_TUD_RHPORT_NUM];
+#endif
+
+#if CFG_TUD_CONTROL_FAST
+// Precomputed responses of IN control requests answered in dcd_event_handler(), entry is free if len = 0.
+// Written by usbd task and read in ISR, protected by _usbd_spin
+typedef struct {
+  uint8_t rhport;
+  uint8_t bmRequestType;
+  uint8_t bRequest;
+  uint8_t len;
+  uint16_t wValue;
+  uint16_t wIndex;
+  uint8_t data[CFG_TUD_CONTROL_FAST_SIZE];
+} usbd_control_fast_t;
+
+enum {
+  CONTROL_FAST_IDLE = 0,
+  CONTROL_FAST_DATA,
+  CONTROL_FAST_STATUS,
+};
+
+tu_static usbd_control_fast_t _usbd_ctrl_fast[CFG_TUD_CONTROL_FAST];
+tu_static volatile uint8_t _usbd_ctrl_fast_stage[CFG_TUD_RHPORT_NUM];
+
+CFG_TUD_MEM_SECTION static struct {
+  TUD_EPBUF_DEF(buf, CFG_TUD_CONTROL_FAST_SIZE);
+} _usbd_ctrl_fast_epbuf[CFG_TUD_RHPORT_NUM];
+#endif
+
 // Mutex for claiming endpoint
 #if OSAL_MUTEX_REQUIRED
   tu_static osal_mutex_def_t _ubsd_mutexdef;
@@ -353,8 +658,91 @@ tu_static osal_queue_t _usbd_q;
   #define _usbd_mutex   NULL
 #endif
 
+#if CFG_TUD_TASK_PRIORITY_QUEUE_SZ
+// Bus reset and unplugged must stay in order with SETUP, other bus events and bulk completions use main queue
+TU_ATTR_ALWAYS_INLINE static inline bool is_priority_event(dcd_event_t const * event) {
+  switch (event->event_id) {
+    case DCD_EVENT_BUS_RESET:
+    case DCD_EVENT_UNPLUGGED:
+    case DCD_EVENT_SETUP_RECEIVED:
+      return true;
+
+    case DCD_EVENT_XFER_COMPLETE: {
+      usbd_device_t const* p_dev = get_device(event->rhport);
+      uint8_t const ep_addr = event->xfer_complete.ep_addr;
+      uint8_t const epnum = tu_edpt_number(ep_addr);
+      return (epnum == 0) || tu_bit_test(p_dev->ep_periodic[tu_edpt_dir(ep_addr)], epnum);
+    }
+
+    default:
+      return false;
+  }
+}
+#endif
+
+TU_ATTR_ALWAYS_INLINE static inline void stats_event_queued(uint8_t lane) {
+#if CFG_TUD_STATS
+  _usbd_stats_queued[lane]++;
+  uint32_t const waiting = _usbd_stats_queued[lane] - _usbd_stats_received[lane];
+  if (waiting > _usbd_stats.queue_hwm[lane]) {
+    _usbd_stats.queue_hwm[lane] = (uint16_t) waiting;
+  }
+#else
+  (void) lane;
+#endif
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void stats_edpt_xfer(uint8_t ep_addr, uint8_t result, uint32_t len) {
+#if CFG_TUD_STATS
+  tud_stats_edpt_t* stats = &_usbd_stats_edpt[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)];
+  stats->xfer_count++;
+  stats->xfer_bytes += len;
+  if (result == XFER_RESULT_STALLED) {
+    stats->stall_count++;
+  } else if (result != XFER_RESULT_SUCCESS) {
+    stats->error_count++;
+  }
+#else
+  (void) ep_addr; (void) result; (void) len;
+#endif
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void stats_edpt_stall(uint8_t ep_addr) {
+#if CFG_TUD_STATS
+  _usbd_stats_edpt[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)].stall_count++;
+#else
+  (void) ep_addr;
+#endif
+}
+
 TU_ATTR_ALWAYS_INLINE static inline bool queue_event(dcd_event_t const * event, bool in_isr) {
-  TU_ASSERT(osal_queue_send(_usbd_q, event, in_isr));
+#if CFG_TUD_TASK_PRIORITY_QUEUE_SZ
+  if (is_priority_event(event)) {
+    bool const was_empty = osal_queue_empty(_usbd_pq);
+    if (!osal_queue_send(_usbd_pq, event, in_isr)) {
+      _usbd_event_dropped[1]++;
+      TU_ASSERT(false);
+    }
+    stats_event_queued(1);
+
+    // usbd task may be waiting on the main queue, wake it up. No need if a wake-up is already sent for queued events
+    if (was_empty) {
+      dcd_event_t const wakeup = { .rhport = event->rhport, .event_id = USBD_EVENT_PRIORITY };
+      if (osal_queue_send(_usbd_q, &wakeup, in_isr)) {
+        stats_event_queued(0);
+      }
+    }
+
+    tud_event_hook_cb(event->rhport, event->event_id, in_isr);
+    return true;
+  }
+#endif
+
+  if (!osal_queue_send(_usbd_q, event, in_isr)) {
+    _usbd_event_dropped[0]++;
+    TU_ASSERT(false);
+  }
+  stats_event_queued(0);
   tud_event_hook_cb(event->rhport, event->event_id, in_isr);
   return true;
 }
@@ -377,9 +765,9 @@ static bool process_test_mode_cb(uint8_t rhport, uint8_t stage, tusb_control_req
 #endif
 
 // from usbd_control.c
-void usbd_control_reset(void);
-void usbd_control_set_request(tusb_control_request_t const *request);
-void usbd_control_set_complete_callback( usbd_control_xfer_cb_t fp );
+void usbd_control_reset(uint8_t rhport);
+void usbd_control_set_request(uint8_t rhport, tusb_control_request_t const *request);
+void usbd_control_set_complete_callback(uint8_t rhport, usbd_control_xfer_cb_t fp);
 bool usbd_control_xfer_cb (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
 
 
@@ -396,7 +784,10 @@ tu_static char const* const _usbd_event_str[DCD_EVENT_COUNT] = {
     "Resume",
     "Setup Received",
     "Xfer Complete",
-    "Func Call"
+    "Func Call",
+    "Priority",
+    "LPM Sleep",
+    "LPM Resume"
 };
 
 // for usbd_control to print the name of control complete driver
@@ -415,65 +806,125 @@ void usbd_driver_print_control_complete_name(usbd_control_xfer_cb_t callback) {
 //--------------------------------------------------------------------+
 // Application API
 //--------------------------------------------------------------------+
+tusb_speed_t tud_rhport_speed_get(uint8_t rhport) {
+  return (tusb_speed_t) get_device(rhport)->speed;
+}
+
+bool tud_rhport_connected(uint8_t rhport) {
+  return get_device(rhport)->connected;
+}
+
+bool tud_rhport_mounted(uint8_t rhport) {
+  return get_device(rhport)->cfg_num ? true : false;
+}
+
+bool tud_rhport_suspended(uint8_t rhport) {
+  return get_device(rhport)->suspended;
+}
+
+bool tud_rhport_remote_wakeup(uint8_t rhport) {
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  // only wake up host if this feature is supported and enabled and we are suspended, or allowed by LPM token in L1
+  TU_VERIFY ((p_dev->suspended && p_dev->remote_wakeup_support && p_dev->remote_wakeup_en) ||
+             (p_dev->lpm_sleep && p_dev->lpm_remote_wakeup));
+  // drivers may arm endpoints from now on, data is sent with the first token after host resumes the bus.
+  // Set before signaling since resume can be detected (and flag cleared) while dcd_remote_wakeup() is running
+  p_dev->wakeup_pending = p_dev->suspended;
+  dcd_remote_wakeup(_usbd_rhport[idx]);
+  return true;
+}
+
+bool tud_rhport_disconnect(uint8_t rhport) {
+  dcd_disconnect(_usbd_rhport[get_index(rhport)]);
+  return true;
+}
+
+bool tud_rhport_connect(uint8_t rhport) {
+  dcd_connect(_usbd_rhport[get_index(rhport)]);
+  return true;
+}
+
+uint8_t tud_rhport_current(void) {
+  return _usbd_event_rhport;
+}
+
+// API without rhport works with the first device stack
 tusb_speed_t tud_speed_get(void) {
-  return (tusb_speed_t) _usbd_dev.speed;
+  return tud_rhport_speed_get(_usbd_rhport[0]);
 }
 
 bool tud_connected(void) {
-  return _usbd_dev.connected;
+  return tud_rhport_connected(_usbd_rhport[0]);
 }
 
 bool tud_mounted(void) {
-  return _usbd_dev.cfg_num ? true : false;
+  return tud_rhport_mounted(_usbd_rhport[0]);
 }
 
 bool tud_suspended(void) {
-  return _usbd_dev.suspended;
+  return tud_rhport_suspended(_usbd_rhport[0]);
 }
 
 bool tud_remote_wakeup(void) {
-  // only wake up host if this feature is supported and enabled and we are suspended
-  TU_VERIFY (_usbd_dev.suspended && _usbd_dev.remote_wakeup_support && _usbd_dev.remote_wakeup_en);
-  dcd_remote_wakeup(_usbd_rhport);
-  return true;
+  return tud_rhport_remote_wakeup(_usbd_rhport[0]);
 }
 
 bool tud_disconnect(void) {
-  dcd_disconnect(_usbd_rhport);
-  return true;
+  return tud_rhport_disconnect(_usbd_rhport[0]);
 }
 
 bool tud_connect(void) {
-  dcd_connect(_usbd_rhport);
-  return true;
+  return tud_rhport_connect(_usbd_rhport[0]);
 }
 
 void tud_sof_cb_enable(bool en) {
-  usbd_sof_enable(_usbd_rhport, SOF_CONSUMER_USER, en);
+  usbd_sof_enable(_usbd_rhport[0], SOF_CONSUMER_USER, en);
+}
+
+void tud_sof_cb_interval(uint16_t interval) {
+  _usbd_sof_cb_interval = interval ? interval : 1;
+  _usbd_sof_cb_count = 0;
+}
+
+uint32_t tud_task_next_wakeup_ms(void) {
+  if (!tud_inited()) {
+    return UINT32_MAX;
+  }
+  if (tud_task_event_ready()) {
+    return 0;
+  }
+  if (_usbd_init_pending) {
+    return 1; // controller bring-up is polled by tud_task()
+  }
+  // SOF interrupt fires every (micro)frame while any consumer needs it
+  for (uint8_t i = 0; i < CFG_TUD_RHPORT_NUM; i++) {
+    if (tu_bit_test(_usbd_inited, i) && _usbd_dev[i].sof_consumer) {
+      return 1;
+    }
+  }
+  return UINT32_MAX;
 }
 
 //--------------------------------------------------------------------+
 // USBD Task
 //--------------------------------------------------------------------+
 bool tud_inited(void) {
-  return _usbd_rhport != RHPORT_INVALID;
+  return _usbd_inited != 0;
 }
 
-bool tud_rhport_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
-  if (tud_inited()) {
-    return true; // skip if already initialized
-  }
-  TU_ASSERT(rh_init);
+bool tud_configure(uint8_t rhport, uint32_t cfg_id, const void* cfg_param) {
+  return dcd_configure(rhport, cfg_id, cfg_param);
+}
 
-  TU_LOG_USBD("USBD init on controller %u, speed = %s\r\n", rhport,
-    rh_init->speed == TUSB_SPEED_HIGH ? "High" : "Full");
-  TU_LOG_INT(CFG_TUD_LOG_LEVEL, sizeof(usbd_device_t));
-  TU_LOG_INT(CFG_TUD_LOG_LEVEL, sizeof(dcd_event_t));
-  TU_LOG_INT(CFG_TUD_LOG_LEVEL, sizeof(tu_fifo_t));
-  TU_LOG_INT(CFG_TUD_LOG_LEVEL, sizeof(tu_edpt_stream_t));
+static bool rhport_inited(uint8_t rhport) {
+  uint8_t const idx = get_index(rhport);
+  return tu_bit_test(_usbd_inited, idx) && _usbd_rhport[idx] == rhport;
+}
 
-  tu_varclr(&_usbd_dev);
-  _usbd_queued_setup = 0;
+// queue, mutex and class drivers are shared by all device stacks, initialized with the first one
+static bool usbd_shared_init(void) {
+  osal_spin_init(&_usbd_spin);
 
 #if OSAL_MUTEX_REQUIRED
   // Init device mutex
@@ -485,10 +936,31 @@ bool tud_rhport_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   _usbd_q = osal_queue_create(&_usbd_qdef);
   TU_ASSERT(_usbd_q);
 
+#if CFG_TUD_TASK_PRIORITY_QUEUE_SZ
+  _usbd_pq = osal_queue_create(&_usbd_pqdef);
+  TU_ASSERT(_usbd_pq);
+#endif
+  tu_memclr(_usbd_event_dropped, sizeof(_usbd_event_dropped));
+
+#if CFG_TUD_STATS
+  tu_varclr(&_usbd_stats);
+  tu_memclr(_usbd_stats_edpt, sizeof(_usbd_stats_edpt));
+  tu_memclr(_usbd_stats_queued, sizeof(_usbd_stats_queued));
+  tu_memclr(_usbd_stats_received, sizeof(_usbd_stats_received));
+  tu_memclr(_usbd_stats_queued_base, sizeof(_usbd_stats_queued_base));
+#endif
+
+#if CFG_TUD_EPBUF_POOL_SIZE
+  tu_mempool_init(&_usbd_epbuf_pool, _usbd_epbuf_pool_mem.buf, CFG_TUD_EPBUF_POOL_UNIT, EPBUF_POOL_UNITS,
+                  _usbd_epbuf_pool_map[0], _usbd_epbuf_pool_map[1]);
+#endif
+
+#if !CFG_TUD_DRIVER_STATIC
   // Get application driver if available
   if (usbd_app_driver_get_cb) {
     _app_driver = usbd_app_driver_get_cb(&_app_driver_count);
   }
+#endif
 
   // Init class drivers
   for (uint8_t i = 0; i < TOTAL_DRIVER_COUNT; i++) {
@@ -498,17 +970,81 @@ bool tud_rhport_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
     driver->init();
   }
 
-  _usbd_rhport = rhport;
+  return true;
+}
+
+// poll controllers that are not ready yet after dcd_init()
+static void init_poll(void) {
+  for (uint8_t i = 0; i < CFG_TUD_RHPORT_NUM; i++) {
+    if (tu_bit_test(_usbd_init_pending, i) && dcd_init_poll(_usbd_rhport[i])) {
+      _usbd_init_pending = (uint8_t) tu_bit_clear(_usbd_init_pending, i);
+      TU_LOG_USBD("USBD controller %u ready\r\n", _usbd_rhport[i]);
+#if CFG_TUD_STATS
+      if (i == 0) {
+        _usbd_stats_init_time = tu_max32(tud_stats_timestamp_cb() - _usbd_stats_init_start, 1);
+      }
+#endif
+    }
+  }
+}
+
+bool tud_rhport_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
+  // skip if already initialized, a single device stack stays on its controller
+  if (rhport_inited(rhport) || (CFG_TUD_RHPORT_NUM == 1 && tud_inited())) {
+    return true;
+  }
+  TU_ASSERT(rh_init);
+
+  // free device stack
+  uint8_t idx = 0;
+  while (idx < CFG_TUD_RHPORT_NUM && tu_bit_test(_usbd_inited, idx)) {
+    idx++;
+  }
+  TU_ASSERT(idx < CFG_TUD_RHPORT_NUM);
+
+  TU_LOG_USBD("USBD init on controller %u, speed = %s\r\n", rhport,
+    rh_init->speed == TUSB_SPEED_HIGH ? "High" : "Full");
+  TU_LOG_INT(CFG_TUD_LOG_LEVEL, sizeof(usbd_device_t));
+  TU_LOG_INT(CFG_TUD_LOG_LEVEL, sizeof(dcd_event_t));
+  TU_LOG_INT(CFG_TUD_LOG_LEVEL, sizeof(tu_fifo_t));
+  TU_LOG_INT(CFG_TUD_LOG_LEVEL, sizeof(tu_edpt_stream_t));
+
+  tu_varclr(&_usbd_dev[idx]);
+  _usbd_queued_setup[idx] = 0;
+#if CFG_TUD_EVENT_COALESCE
+  tu_memclr(_usbd_xfer_coalesce[idx], sizeof(_usbd_xfer_coalesce[idx]));
+  _usbd_sof_queued[idx] = false;
+#endif
+#if CFG_TUD_DESC_CACHE
+  tu_varclr(&_usbd_desc_cache[idx]);
+#endif
+
+  if (!tud_inited()) {
+    TU_ASSERT(usbd_shared_init());
+  }
+
+  _usbd_rhport[idx] = rhport;
+  _usbd_inited = (uint8_t) tu_bit_set(_usbd_inited, idx);
+
+#if CFG_TUD_STATS
+  if (idx == 0) {
+    _usbd_stats_init_start = tud_stats_timestamp_cb();
+    _usbd_stats_init_time = 0;
+    _usbd_stats_mount_time = 0;
+  }
+#endif
 
-  // Init device controller driver
+  // Init device controller driver, bring-up is completed by tud_task() if dcd_init() returns early
+  _usbd_init_pending = (uint8_t) tu_bit_set(_usbd_init_pending, idx);
   TU_ASSERT(dcd_init(rhport, rh_init));
   dcd_int_enable(rhport);
+  init_poll();
 
   return true;
 }
 
 bool tud_deinit(uint8_t rhport) {
-  if (!tud_inited()) {
+  if (!rhport_inited(rhport)) {
     return true; // skip if not initialized
   }
 
@@ -519,6 +1055,17 @@ bool tud_deinit(uint8_t rhport) {
   dcd_disconnect(rhport);
   dcd_deinit(rhport);
 
+  uint8_t const idx = get_index(rhport);
+  _usbd_inited = (uint8_t) tu_bit_clear(_usbd_inited, idx);
+  _usbd_init_pending = (uint8_t) tu_bit_clear(_usbd_init_pending, idx);
+#if CFG_TUD_DESC_CACHE
+  tu_varclr(&_usbd_desc_cache[idx]);
+#endif
+
+  if (tud_inited()) {
+    return true; // other device stack is still running
+  }
+
   // Deinit class drivers
   for (uint8_t i = 0; i < TOTAL_DRIVER_COUNT; i++) {
     usbd_class_driver_t const* driver = get_driver(i);
@@ -532,17 +1079,26 @@ bool tud_deinit(uint8_t rhport) {
   osal_queue_delete(_usbd_q);
   _usbd_q = NULL;
 
+#if CFG_TUD_TASK_PRIORITY_QUEUE_SZ
+  osal_queue_delete(_usbd_pq);
+  _usbd_pq = NULL;
+#endif
+
 #if OSAL_MUTEX_REQUIRED
   // TODO make sure there is no task waiting on this mutex
   osal_mutex_delete(_usbd_mutex);
   _usbd_mutex = NULL;
 #endif
 
-  _usbd_rhport = RHPORT_INVALID;
-
   return true;
 }
 
+void tud_descriptor_cache_invalidate(void) {
+#if CFG_TUD_DESC_CACHE
+  tu_memclr(_usbd_desc_cache, sizeof(_usbd_desc_cache));
+#endif
+}
+
 static void configuration_reset(uint8_t rhport) {
   for (uint8_t i = 0; i < TOTAL_DRIVER_COUNT; i++) {
     usbd_class_driver_t const* driver = get_driver(i);
@@ -550,46 +1106,336 @@ static void configuration_reset(uint8_t rhport) {
     driver->reset(rhport);
   }
 
-  tu_varclr(&_usbd_dev);
-  memset(_usbd_dev.itf2drv, DRVID_INVALID, sizeof(_usbd_dev.itf2drv)); // invalid mapping
-  memset(_usbd_dev.ep2drv, DRVID_INVALID, sizeof(_usbd_dev.ep2drv)); // invalid mapping
+  usbd_device_t* p_dev = get_device(rhport);
+  tu_varclr(p_dev);
+  memset(p_dev->itf2drv, DRVID_INVALID, sizeof(p_dev->itf2drv)); // invalid mapping
+  memset(p_dev->ep2drv, DRVID_INVALID, sizeof(p_dev->ep2drv)); // invalid mapping
+  memset(p_dev->ep2inst, TUSB_INDEX_INVALID_8, sizeof(p_dev->ep2inst));
+
+#if CFG_TUD_CONTROL_FAST
+  // drivers register their responses again when opened
+  osal_spin_lock(&_usbd_spin, false);
+  for (uint8_t i = 0; i < CFG_TUD_CONTROL_FAST; i++) {
+    if (_usbd_ctrl_fast[i].rhport == rhport) {
+      _usbd_ctrl_fast[i].len = 0;
+    }
+  }
+  osal_spin_unlock(&_usbd_spin, false);
+#endif
 }
 
 static void usbd_reset(uint8_t rhport) {
   configuration_reset(rhport);
-  usbd_control_reset();
+  usbd_control_reset(rhport);
 }
 
-bool tud_task_event_ready(void) {
-  // Skip if stack is not initialized
-  if (!tud_inited()) return false;
-  return !osal_queue_empty(_usbd_q);
-}
+bool tud_rhport_reconfigure(uint8_t rhport) {
+  TU_VERIFY(rhport_inited(rhport));
+  uint8_t const idx = get_index(rhport);
+  rhport = _usbd_rhport[idx];
+  bool const was_mounted = (_usbd_dev[idx].cfg_num != 0);
 
-/* USB Device Driver task
- * This top level thread manages all device controller event and delegates events to class-specific drivers.
- * This should be called periodically within the mainloop or rtos thread.
- *
-    int main(void) {
-      application_init();
-      tusb_init(0, TUSB_ROLE_DEVICE);
+  TU_LOG_USBD("USBD reconfigure on controller %u\r\n", rhport);
 
-      while(1) { // the mainloop
-        application_code();
-        tud_task(); // tinyusb device task
+  // host sees an unplug. Controller and its endpoints are re-initialized by bus reset of the next enumeration
+  dcd_int_disable(rhport);
+  dcd_disconnect(rhport);
+  usbd_reset(rhport);
+#if CFG_TUD_DESC_CACHE
+  tu_varclr(&_usbd_desc_cache[idx]);
+#endif
+
+#if !CFG_TUD_DRIVER_STATIC
+  // application drivers are shared by all device stacks, only swap them when this is the only one running
+  if (usbd_app_driver_get_cb && _usbd_inited == tu_bit_set(0, idx)) {
+    for (uint8_t i = 0; i < _app_driver_count; i++) {
+      if (_app_driver[i].deinit) {
+        _app_driver[i].deinit();
       }
     }
- */
-void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
-  (void) in_isr; // not implemented yet
 
-  // Skip if stack is not initialized
-  if (!tud_inited()) return;
+    _app_driver_count = 0;
+    _app_driver = usbd_app_driver_get_cb(&_app_driver_count);
 
-  // Loop until there is no more events in the queue
-  while (1) {
+    for (uint8_t i = 0; i < _app_driver_count; i++) {
+      TU_LOG_USBD("%s init\r\n", _app_driver[i].name);
+      _app_driver[i].init();
+    }
+  }
+#endif
+
+  dcd_int_enable(rhport);
+
+  if (was_mounted) {
+    tud_umount_cb();
+  }
+
+  return true;
+}
+
+bool tud_reconfigure(void) {
+  return tud_rhport_reconfigure(_usbd_rhport[0]);
+}
+
+bool tud_task_event_ready(void) {
+  // Skip if stack is not initialized
+  if (!tud_inited()) return false;
+#if CFG_TUD_TASK_PRIORITY_QUEUE_SZ
+  if (!osal_queue_empty(_usbd_pq)) return true;
+#endif
+  return !osal_queue_empty(_usbd_q);
+}
+
+uint32_t tud_task_event_dropped(bool priority) {
+  return _usbd_event_dropped[priority ? 1 : 0];
+}
+
+#if CFG_TUD_STATS
+void tud_stats_int_handler(uint8_t rhport) {
+  uint32_t const start = tud_stats_timestamp_cb();
+  dcd_int_handler(rhport);
+  uint32_t const elapsed = tud_stats_timestamp_cb() - start;
+
+  _usbd_stats.isr_count++;
+  _usbd_stats.isr_time_total += elapsed;
+  if (elapsed > _usbd_stats.isr_time_max) {
+    _usbd_stats.isr_time_max = elapsed;
+  }
+}
+#endif
+
+bool tud_stats_get(tud_stats_t* stats, bool clear) {
+#if CFG_TUD_STATS
+  TU_VERIFY(stats != NULL && tud_inited());
+
+  osal_spin_lock(&_usbd_spin, false);
+  *stats = _usbd_stats;
+  for (uint8_t i = 0; i < 2; i++) {
+    stats->event_count[i] = _usbd_stats_queued[i] - _usbd_stats_queued_base[i];
+    stats->event_dropped[i] = _usbd_event_dropped[i];
+    if (clear) {
+      _usbd_stats_queued_base[i] = _usbd_stats_queued[i];
+    }
+  }
+  if (clear) {
+    tu_varclr(&_usbd_stats);
+  }
+  osal_spin_unlock(&_usbd_spin, false);
+  stats->init_time = _usbd_stats_init_time;
+  stats->mount_time = _usbd_stats_mount_time;
+
+  return true;
+#else
+  (void) stats; (void) clear;
+  return false;
+#endif
+}
+
+bool tud_stats_edpt_get(uint8_t ep_addr, tud_stats_edpt_t* stats, bool clear) {
+#if CFG_TUD_STATS
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  TU_VERIFY(stats != NULL && epnum < CFG_TUD_ENDPPOINT_MAX);
+
+  osal_spin_lock(&_usbd_spin, false);
+  *stats = _usbd_stats_edpt[epnum][tu_edpt_dir(ep_addr)];
+  if (clear) {
+    tu_varclr(&_usbd_stats_edpt[epnum][tu_edpt_dir(ep_addr)]);
+  }
+  osal_spin_unlock(&_usbd_spin, false);
+
+  return true;
+#else
+  (void) ep_addr; (void) stats; (void) clear;
+  return false;
+#endif
+}
+
+#if USBD_XFER_SPLIT
+// Submit next part of a split transfer
+static bool xfer_split_submit(uint8_t rhport, uint8_t ep_addr, usbd_xfer_split_t* split) {
+  split->part_len = (uint16_t) tu_min32(split->remaining, TUP_DCD_EDPT_XFER_MAX);
+  return dcd_edpt_xfer(rhport, ep_addr, split->buffer, split->part_len);
+}
+
+// Submit next part of split transfer after a part is complete, return true if submitted.
+// Otherwise transfer is done (or it is not split) and event is updated with total bytes.
+static bool xfer_split_continue(uint8_t rhport, dcd_event_t* event) {
+  uint8_t const ep_addr = event->xfer_complete.ep_addr;
+  usbd_xfer_split_t* split = &get_device(rhport)->ep_split[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)];
+  TU_VERIFY(split->active);
+
+  uint32_t const len = event->xfer_complete.len;
+  split->xferred += len;
+
+  // stop at error or short packet
+  if ((event->xfer_complete.result == XFER_RESULT_SUCCESS) && (len == split->part_len)) {
+    split->buffer += len;
+    split->remaining -= len;
+
+    // move to next scatter-gather buffer, skip empty one
+    while ((split->remaining == 0) && split->sg_count) {
+      split->buffer = split->sg_next->buffer;
+      split->remaining = split->sg_next->len;
+      split->sg_next++;
+      split->sg_count--;
+    }
+
+    if (split->remaining) {
+      TU_LOG_USBD("  Queue next part with %u bytes\r\n", (unsigned int) tu_min32(split->remaining, TUP_DCD_EDPT_XFER_MAX));
+      if (xfer_split_submit(rhport, ep_addr, split)) {
+        return true;
+      }
+      event->xfer_complete.result = XFER_RESULT_FAILED;
+    }
+  }
+
+  event->xfer_complete.len = split->xferred;
+  split->active = 0;
+  return false;
+}
+#endif
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+// Transfer on dcd is complete: submit next queued transfer if any. A transfer that dcd refuses is completed
+// with failure so that driver still gets one xfer_cb() per queued transfer
+static void xfer_queue_advance(uint8_t rhport, uint8_t ep_addr, bool in_isr) {
+  usbd_xfer_queue_t* queue = &get_device(rhport)->ep_queue[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)];
+
+  while (1) {
+    uint8_t* buffer = NULL;
+    uint16_t len = 0;
+
+    osal_spin_lock(&_usbd_spin, in_isr);
+    bool const next = (queue->count > 0);
+    if (next) {
+      buffer = queue->entry[queue->rd].buffer;
+      len = queue->entry[queue->rd].len;
+      queue->rd = (uint8_t) ((queue->rd + 1) % CFG_TUD_EDPT_XFER_QUEUE);
+      queue->count--;
+    } else {
+      queue->running = 0;
+    }
+    osal_spin_unlock(&_usbd_spin, in_isr);
+
+    if (!next || dcd_edpt_xfer(rhport, ep_addr, buffer, len)) {
+      return;
+    }
+
+    dcd_event_t const event = {
+      .rhport = rhport,
+      .event_id = DCD_EVENT_XFER_COMPLETE,
+      .xfer_complete = {.ep_addr = ep_addr, .len = 0, .result = XFER_RESULT_FAILED}
+    };
+    queue_event(&event, in_isr);
+  }
+}
+
+// Completion of a transfer is delivered to driver, return true if endpoint still has queued transfers pending
+static bool xfer_queue_delivered(usbd_device_t* p_dev, uint8_t ep_addr, bool in_isr) {
+  usbd_xfer_queue_t* queue = &p_dev->ep_queue[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)];
+
+  osal_spin_lock(&_usbd_spin, in_isr);
+  if (queue->pending) {
+    queue->pending--;
+  }
+  bool const pending = (queue->pending > 0);
+  osal_spin_unlock(&_usbd_spin, in_isr);
+
+  return pending;
+}
+#endif
+
+#if CFG_TUD_EDPT_ISO_XFER
+// Packet of usbd_edpt_iso_xfer() is complete: record its status and submit the next one right away. Return true
+// if next packet is on dcd, otherwise event is updated with the total of the whole packet list
+static bool iso_xfer_advance(uint8_t rhport, usbd_iso_xfer_t* iso, dcd_event_t* event) {
+  tu_iso_packet_t* packet = &iso->packets[iso->idx];
+  packet->actual_len = (uint16_t) event->xfer_complete.len;
+  packet->result = event->xfer_complete.result;
+  iso->xferred += event->xfer_complete.len;
+  if (packet->result != XFER_RESULT_SUCCESS) {
+    iso->result = XFER_RESULT_FAILED;
+  }
+
+  while (++iso->idx < iso->count) {
+    iso->buffer += packet->len;
+    packet = &iso->packets[iso->idx];
+    if (dcd_edpt_xfer(rhport, event->xfer_complete.ep_addr, iso->buffer, packet->len)) {
+      return true;
+    }
+    packet->actual_len = 0; // dcd refused packet, skip it
+    packet->result = XFER_RESULT_FAILED;
+    iso->result = XFER_RESULT_FAILED;
+  }
+
+  event->xfer_complete.len = iso->xferred;
+  event->xfer_complete.result = iso->result;
+  iso->active = 0;
+  return false;
+}
+#endif
+
+// Drop queued transfers of an endpoint e.g when it is stalled or closed
+TU_ATTR_ALWAYS_INLINE static inline void xfer_queue_reset(usbd_device_t* p_dev, uint8_t epnum, uint8_t dir) {
+#if CFG_TUD_EDPT_XFER_QUEUE
+  osal_spin_lock(&_usbd_spin, false);
+  tu_varclr(&p_dev->ep_queue[epnum][dir]);
+  osal_spin_unlock(&_usbd_spin, false);
+#else
+  (void) p_dev; (void) epnum; (void) dir;
+#endif
+}
+
+/* USB Device Driver task
+ * This top level thread manages all device controller event and delegates events to class-specific drivers.
+ * This should be called periodically within the mainloop or rtos thread.
+ *
+    int main(void) {
+      application_init();
+      tusb_init(0, TUSB_ROLE_DEVICE);
+
+      while(1) { // the mainloop
+        application_code();
+        tud_task(); // tinyusb device task
+      }
+    }
+ */
+void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
+  (void) in_isr; // not implemented yet
+
+  // Skip if stack is not initialized
+  if (!tud_inited()) return;
+
+  if (_usbd_init_pending) {
+    init_poll();
+    if (_usbd_init_pending) {
+      timeout_ms = tu_min32(timeout_ms, 1); // keep polling controller bring-up
+    }
+  }
+
+#if CFG_TUD_TASK_EVENT_MAX
+  uint32_t event_count = 0;
+#endif
+
+  // Loop until there is no more events in the queue
+  while (1) {
     dcd_event_t event;
-    if (!osal_queue_receive(_usbd_q, &event, timeout_ms)) return;
+    bool has_event = false;
+
+#if CFG_TUD_TASK_PRIORITY_QUEUE_SZ
+    // priority events first, at most one other event is processed between them
+    has_event = osal_queue_receive(_usbd_pq, &event, 0);
+#endif
+
+    if (!has_event && !osal_queue_receive(_usbd_q, &event, timeout_ms)) return;
+
+#if CFG_TUD_STATS
+    _usbd_stats_received[has_event ? 1 : 0]++;
+#endif
+
+    uint8_t const idx = get_index(event.rhport);
+    usbd_device_t* p_dev = &_usbd_dev[idx];
+    _usbd_event_rhport = _usbd_rhport[idx];
 
 #if CFG_TUSB_DEBUG >= CFG_TUD_LOG_LEVEL
     if (event.event_id == DCD_EVENT_SETUP_RECEIVED) TU_LOG_USBD("\r\n"); // extra line for setup
@@ -600,7 +1446,7 @@ void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
       case DCD_EVENT_BUS_RESET:
         TU_LOG_USBD(": %s Speed\r\n", tu_str_speed[event.bus_reset.speed]);
         usbd_reset(event.rhport);
-        _usbd_dev.speed = event.bus_reset.speed;
+        p_dev->speed = event.bus_reset.speed;
         break;
 
       case DCD_EVENT_UNPLUGGED:
@@ -610,23 +1456,23 @@ void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
         break;
 
       case DCD_EVENT_SETUP_RECEIVED:
-        TU_ASSERT(_usbd_queued_setup > 0,);
-        _usbd_queued_setup--;
+        TU_ASSERT(_usbd_queued_setup[idx] > 0,);
+        _usbd_queued_setup[idx]--;
         TU_LOG_BUF(CFG_TUD_LOG_LEVEL, &event.setup_received, 8);
-        if (_usbd_queued_setup) {
+        if (_usbd_queued_setup[idx]) {
           TU_LOG_USBD("  Skipped since there is other SETUP in queue\r\n");
           break;
         }
 
         // Mark as connected after receiving 1st setup packet.
         // But it is easier to set it every time instead of wasting time to check then set
-        _usbd_dev.connected = 1;
+        p_dev->connected = 1;
 
         // mark both in & out control as free
-        _usbd_dev.ep_status[0][TUSB_DIR_OUT].busy = 0;
-        _usbd_dev.ep_status[0][TUSB_DIR_OUT].claimed = 0;
-        _usbd_dev.ep_status[0][TUSB_DIR_IN].busy = 0;
-        _usbd_dev.ep_status[0][TUSB_DIR_IN].claimed = 0;
+        p_dev->ep_status[0][TUSB_DIR_OUT].busy = 0;
+        p_dev->ep_status[0][TUSB_DIR_OUT].claimed = 0;
+        p_dev->ep_status[0][TUSB_DIR_IN].busy = 0;
+        p_dev->ep_status[0][TUSB_DIR_IN].claimed = 0;
 
         // Process control request
         if (!process_control_request(event.rhport, &event.setup_received)) {
@@ -634,6 +1480,8 @@ void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
           // Failed -> stall both control endpoint IN and OUT
           dcd_edpt_stall(event.rhport, 0);
           dcd_edpt_stall(event.rhport, 0 | TUSB_DIR_IN_MASK);
+          stats_edpt_stall(0);
+          stats_edpt_stall(0 | TUSB_DIR_IN_MASK);
         }
         break;
 
@@ -643,20 +1491,57 @@ void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
         uint8_t const epnum = tu_edpt_number(ep_addr);
         uint8_t const ep_dir = tu_edpt_dir(ep_addr);
 
+#if CFG_TUD_EVENT_COALESCE
+        if (epnum > 0) {
+          // take over completions merged into this event
+          osal_spin_lock(&_usbd_spin, false);
+          usbd_xfer_coalesce_t* coalesce = &_usbd_xfer_coalesce[idx][epnum][ep_dir];
+          uint16_t const count = coalesce->count;
+          if (count > 0) {
+            event.xfer_complete.len = coalesce->len;
+            event.xfer_complete.result = coalesce->result;
+            coalesce->count = 0;
+          }
+          osal_spin_unlock(&_usbd_spin, false);
+
+          if (count > 1) {
+            TU_LOG_USBD("%u coalesced completions ", count);
+          }
+        }
+#endif
+
         TU_LOG_USBD("on EP %02X with %u bytes\r\n", ep_addr, (unsigned int) event.xfer_complete.len);
 
-        _usbd_dev.ep_status[epnum][ep_dir].busy = 0;
-        _usbd_dev.ep_status[epnum][ep_dir].claimed = 0;
+#if USBD_XFER_SPLIT
+        // continue with next part of split transfer if any
+        if (xfer_split_continue(event.rhport, &event)) break;
+#endif
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+        // endpoint stays busy until completions of all queued transfers are delivered
+        if (!xfer_queue_delivered(p_dev, ep_addr, false))
+#endif
+        {
+          p_dev->ep_status[epnum][ep_dir].busy = 0;
+        }
+        p_dev->ep_status[epnum][ep_dir].claimed = 0;
+        stats_edpt_xfer(ep_addr, event.xfer_complete.result, event.xfer_complete.len);
 
         if (0 == epnum) {
           usbd_control_xfer_cb(event.rhport, ep_addr, (xfer_result_t) event.xfer_complete.result,
                                event.xfer_complete.len);
         } else {
-          usbd_class_driver_t const* driver = get_driver(_usbd_dev.ep2drv[epnum][ep_dir]);
-          TU_ASSERT(driver,);
+          usbd_class_driver_t const* driver = get_driver(p_dev->ep2drv[epnum][ep_dir]);
+          if (driver == NULL) {
+            // completion queued before a bus reset/unplug (which may overtake it via the priority queue)
+            TU_LOG_USBD("  Skipped, endpoint is closed\r\n");
+            break;
+          }
 
           TU_LOG_USBD("  %s xfer callback\r\n", driver->name);
+          TU_TRACE(TU_TRACE_CB_ENTER, 0, ep_addr, event.xfer_complete.len);
           driver->xfer_cb(event.rhport, ep_addr, (xfer_result_t) event.xfer_complete.result, event.xfer_complete.len);
+          TU_TRACE(TU_TRACE_CB_EXIT, 0, ep_addr, 0);
         }
         break;
       }
@@ -665,16 +1550,16 @@ void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
         // NOTE: When plugging/unplugging device, the D+/D- state are unstable and
         // can accidentally meet the SUSPEND condition ( Bus Idle for 3ms ), which result in a series of event
         // e.g suspend -> resume -> unplug/plug. Skip suspend/resume if not connected
-        if (_usbd_dev.connected) {
-          TU_LOG_USBD(": Remote Wakeup = %u\r\n", _usbd_dev.remote_wakeup_en);
-          tud_suspend_cb(_usbd_dev.remote_wakeup_en);
+        if (p_dev->connected) {
+          TU_LOG_USBD(": Remote Wakeup = %u\r\n", p_dev->remote_wakeup_en);
+          tud_suspend_cb(p_dev->remote_wakeup_en);
         } else {
           TU_LOG_USBD(" Skipped\r\n");
         }
         break;
 
       case DCD_EVENT_RESUME:
-        if (_usbd_dev.connected) {
+        if (p_dev->connected) {
           TU_LOG_USBD("\r\n");
           tud_resume_cb();
         } else {
@@ -682,13 +1567,35 @@ void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
         }
         break;
 
+      case DCD_EVENT_LPM_SLEEP:
+        TU_LOG_USBD(": BESL = %u, Remote Wakeup = %u\r\n", event.lpm_sleep.besl, event.lpm_sleep.remote_wakeup);
+        tud_lpm_sleep_cb(event.lpm_sleep.besl, event.lpm_sleep.remote_wakeup != 0);
+        break;
+
+      case USBD_EVENT_LPM_RESUME:
+        TU_LOG_USBD("\r\n");
+        tud_lpm_resume_cb();
+        break;
+
       case USBD_EVENT_FUNC_CALL:
         TU_LOG_USBD("\r\n");
         if (event.func_call.func) event.func_call.func(event.func_call.param);
         break;
 
+      case USBD_EVENT_PRIORITY:
+        // priority queue is checked on next loop
+        TU_LOG_USBD("\r\n");
+        break;
+
       case DCD_EVENT_SOF:
-        if (tu_bit_test(_usbd_dev.sof_consumer, SOF_CONSUMER_USER)) {
+#if CFG_TUD_EVENT_COALESCE
+        osal_spin_lock(&_usbd_spin, false);
+        _usbd_sof_queued[idx] = false;
+        event.sof.frame_count = _usbd_sof_frame[idx];
+        osal_spin_unlock(&_usbd_spin, false);
+#endif
+
+        if (tu_bit_test(p_dev->sof_consumer, SOF_CONSUMER_USER)) {
           TU_LOG_USBD("\r\n");
           tud_sof_cb(event.sof.frame_count);
         }
@@ -699,8 +1606,16 @@ void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
         break;
     }
 
+#if CFG_TUD_TASK_EVENT_MAX
+    // budget is used up, leave remaining events for next call
+    if (++event_count >= CFG_TUD_TASK_EVENT_MAX) return;
+#endif
+
 #if CFG_TUSB_OS != OPT_OS_NONE && CFG_TUSB_OS != OPT_OS_PICO
     // return if there is no more events, for application to run other background
+#if CFG_TUD_TASK_PRIORITY_QUEUE_SZ
+    if (!osal_queue_empty(_usbd_pq)) continue;
+#endif
     if (osal_queue_empty(_usbd_q)) return;
 #endif
   }
@@ -712,20 +1627,49 @@ void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
 
 // Helper to invoke class driver control request handler
 static bool invoke_class_control(uint8_t rhport, usbd_class_driver_t const * driver, tusb_control_request_t const * request) {
-  usbd_control_set_complete_callback(driver->control_xfer_cb);
+  usbd_control_set_complete_callback(rhport, driver->control_xfer_cb);
   TU_LOG_USBD("  %s control request\r\n", driver->name);
-  return driver->control_xfer_cb(rhport, CONTROL_STAGE_SETUP, request);
+  TU_TRACE(TU_TRACE_CTRL_ENTER, CONTROL_STAGE_SETUP, request->wIndex, (request->bmRequestType << 8) | request->bRequest);
+  bool const ret = driver->control_xfer_cb(rhport, CONTROL_STAGE_SETUP, request);
+  TU_TRACE(TU_TRACE_CTRL_EXIT, CONTROL_STAGE_SETUP, request->wIndex, ret);
+  return ret;
 }
 
 // This handles the actual request and its response.
 // Returns false if unable to complete the request, causing caller to stall control endpoints.
+// Device status bit mask
+// - Bit 0: Self Powered
+// - Bit 1: Remote Wakeup enabled
+TU_ATTR_ALWAYS_INLINE static inline uint16_t get_device_status(usbd_device_t const* p_dev) {
+  return (uint16_t) ((p_dev->self_powered ? 1u : 0u) | (p_dev->remote_wakeup_en ? 2u : 0u));
+}
+
+// Device GET_STATUS is polled by some hosts, keep it answered in ISR
+static void control_fast_status_update(uint8_t rhport, usbd_device_t const* p_dev) {
+#if CFG_TUD_CONTROL_FAST
+  tusb_control_request_t const request = {
+    .bmRequestType = 0x80, // standard device IN
+    .bRequest = TUSB_REQ_GET_STATUS,
+    .wValue = 0,
+    .wIndex = 0,
+    .wLength = 2
+  };
+  uint16_t const status = get_device_status(p_dev);
+  (void) usbd_control_fast_set(rhport, &request, &status, 2);
+#else
+  (void) rhport;
+  (void) p_dev;
+#endif
+}
+
 static bool process_control_request(uint8_t rhport, tusb_control_request_t const * p_request) {
-  usbd_control_set_complete_callback(NULL);
+  usbd_device_t* p_dev = get_device(rhport);
+  usbd_control_set_complete_callback(rhport, NULL);
   TU_ASSERT(p_request->bmRequestType_bit.type < TUSB_REQ_TYPE_INVALID);
 
   // Vendor request
   if ( p_request->bmRequestType_bit.type == TUSB_REQ_TYPE_VENDOR ) {
-    usbd_control_set_complete_callback(tud_vendor_control_xfer_cb);
+    usbd_control_set_complete_callback(rhport, tud_vendor_control_xfer_cb);
     return tud_vendor_control_xfer_cb(rhport, CONTROL_STAGE_SETUP, p_request);
   }
 
@@ -741,9 +1685,9 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
     case TUSB_REQ_RCPT_DEVICE:
       if ( TUSB_REQ_TYPE_CLASS == p_request->bmRequestType_bit.type ) {
         uint8_t const itf = tu_u16_low(p_request->wIndex);
-        TU_VERIFY(itf < TU_ARRAY_SIZE(_usbd_dev.itf2drv));
+        TU_VERIFY(itf < TU_ARRAY_SIZE(p_dev->itf2drv));
 
-        usbd_class_driver_t const * driver = get_driver(_usbd_dev.itf2drv[itf]);
+        usbd_class_driver_t const * driver = get_driver(p_dev->itf2drv[itf]);
         TU_VERIFY(driver);
 
         // forward to class driver: "non-STD request to Interface"
@@ -761,14 +1705,14 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
           // Depending on mcu, status phase could be sent either before or after changing device address,
           // or even require stack to not response with status at all
           // Therefore DCD must take full responsibility to response and include zlp status packet if needed.
-          usbd_control_set_request(p_request); // set request since DCD has no access to tud_control_status() API
+          usbd_control_set_request(rhport, p_request); // set request since DCD has no access to tud_control_status() API
           dcd_set_address(rhport, (uint8_t) p_request->wValue);
           // skip tud_control_status()
-          _usbd_dev.addressed = 1;
+          p_dev->addressed = 1;
         break;
 
         case TUSB_REQ_GET_CONFIGURATION: {
-          uint8_t cfg_num = _usbd_dev.cfg_num;
+          uint8_t cfg_num = p_dev->cfg_num;
           tud_control_xfer(rhport, p_request, &cfg_num, 1);
         }
         break;
@@ -777,10 +1721,10 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
           uint8_t const cfg_num = (uint8_t) p_request->wValue;
 
           // Only process if new configure is different
-          if (_usbd_dev.cfg_num != cfg_num) {
-            if ( _usbd_dev.cfg_num ) {
+          if (p_dev->cfg_num != cfg_num) {
+            if ( p_dev->cfg_num ) {
               // already configured: need to clear all endpoints and driver first
-              TU_LOG_USBD("  Clear current Configuration (%u) before switching\r\n", _usbd_dev.cfg_num);
+              TU_LOG_USBD("  Clear current Configuration (%u) before switching\r\n", p_dev->cfg_num);
 
               // disable SOF
               dcd_sof_enable(rhport, false);
@@ -789,13 +1733,13 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
               dcd_edpt_close_all(rhport);
 
               // close all drivers and current configured state except bus speed
-              uint8_t const speed = _usbd_dev.speed;
+              uint8_t const speed = p_dev->speed;
               configuration_reset(rhport);
 
-              _usbd_dev.speed = speed; // restore speed
+              p_dev->speed = speed; // restore speed
             }
 
-            _usbd_dev.cfg_num = cfg_num;
+            p_dev->cfg_num = cfg_num;
 
             // Handle the new configuration and execute the corresponding callback
             if ( cfg_num ) {
@@ -803,9 +1747,14 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
               if (!process_set_config(rhport, cfg_num)) {
                 TU_MESS_FAILED();
                 TU_BREAKPOINT();
-                _usbd_dev.cfg_num = 0;
+                p_dev->cfg_num = 0;
                 return false;
               }
+#if CFG_TUD_STATS
+              if (get_index(rhport) == 0 && _usbd_stats_mount_time == 0) {
+                _usbd_stats_mount_time = tu_max32(tud_stats_timestamp_cb() - _usbd_stats_init_start, 1);
+              }
+#endif
               tud_mount_cb();
             } else {
               tud_umount_cb();
@@ -825,7 +1774,8 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
             case TUSB_REQ_FEATURE_REMOTE_WAKEUP:
               TU_LOG_USBD("    Enable Remote Wakeup\r\n");
               // Host may enable remote wake up before suspending especially HID device
-              _usbd_dev.remote_wakeup_en = true;
+              p_dev->remote_wakeup_en = true;
+              control_fast_status_update(rhport, p_dev);
               tud_control_status(rhport, p_request);
             break;
 
@@ -837,7 +1787,7 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
               uint8_t const selector = tu_u16_high(p_request->wIndex);
               TU_VERIFY(TUSB_FEATURE_TEST_J <= selector && selector <= TUSB_FEATURE_TEST_FORCE_ENABLE);
 
-              usbd_control_set_complete_callback(process_test_mode_cb);
+              usbd_control_set_complete_callback(rhport, process_test_mode_cb);
               tud_control_status(rhport, p_request);
               break;
             }
@@ -855,15 +1805,13 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
           TU_LOG_USBD("    Disable Remote Wakeup\r\n");
 
           // Host may disable remote wake up after resuming
-          _usbd_dev.remote_wakeup_en = false;
+          p_dev->remote_wakeup_en = false;
+          control_fast_status_update(rhport, p_dev);
           tud_control_status(rhport, p_request);
         break;
 
         case TUSB_REQ_GET_STATUS: {
-          // Device status bit mask
-          // - Bit 0: Self Powered
-          // - Bit 1: Remote Wakeup enabled
-          uint16_t status = (uint16_t) ((_usbd_dev.self_powered ? 1u : 0u) | (_usbd_dev.remote_wakeup_en ? 2u : 0u));
+          uint16_t status = get_device_status(p_dev);
           tud_control_xfer(rhport, p_request, &status, 2);
           break;
         }
@@ -876,9 +1824,9 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
     //------------- Class/Interface Specific Request -------------//
     case TUSB_REQ_RCPT_INTERFACE: {
       uint8_t const itf = tu_u16_low(p_request->wIndex);
-      TU_VERIFY(itf < TU_ARRAY_SIZE(_usbd_dev.itf2drv));
+      TU_VERIFY(itf < TU_ARRAY_SIZE(p_dev->itf2drv));
 
-      usbd_class_driver_t const * driver = get_driver(_usbd_dev.itf2drv[itf]);
+      usbd_class_driver_t const * driver = get_driver(p_dev->itf2drv[itf]);
       TU_VERIFY(driver);
 
       // all requests to Interface (STD or Class) is forwarded to class driver.
@@ -892,7 +1840,7 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
           case TUSB_REQ_GET_INTERFACE:
           case TUSB_REQ_SET_INTERFACE:
             // Clear complete callback if driver set since it can also stall the request.
-            usbd_control_set_complete_callback(NULL);
+            usbd_control_set_complete_callback(rhport, NULL);
 
             if (TUSB_REQ_GET_INTERFACE == p_request->bRequest) {
               uint8_t alternate = 0;
@@ -914,8 +1862,8 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
       uint8_t const ep_num  = tu_edpt_number(ep_addr);
       uint8_t const ep_dir  = tu_edpt_dir(ep_addr);
 
-      TU_ASSERT(ep_num < TU_ARRAY_SIZE(_usbd_dev.ep2drv) );
-      usbd_class_driver_t const * driver = get_driver(_usbd_dev.ep2drv[ep_num][ep_dir]);
+      TU_ASSERT(ep_num < TU_ARRAY_SIZE(p_dev->ep2drv) );
+      usbd_class_driver_t const * driver = get_driver(p_dev->ep2drv[ep_num][ep_dir]);
 
       if ( TUSB_REQ_TYPE_STANDARD != p_request->bmRequestType_bit.type ) {
         // Forward class request to its driver
@@ -947,10 +1895,10 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
               // STD request must always be ACKed regardless of driver returned value
               // Also clear complete callback if driver set since it can also stall the request.
               (void) invoke_class_control(rhport, driver, p_request);
-              usbd_control_set_complete_callback(NULL);
+              usbd_control_set_complete_callback(rhport, NULL);
 
               // skip ZLP status if driver already did that
-              if ( !_usbd_dev.ep_status[0][TUSB_DIR_IN].busy ) tud_control_status(rhport, p_request);
+              if ( !p_dev->ep_status[0][TUSB_DIR_IN].busy ) tud_control_status(rhport, p_request);
             }
           }
           break;
@@ -973,21 +1921,116 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
   return true;
 }
 
+// open driver with interface, return length of descriptors claimed by driver or 0 if not supported
+static uint16_t driver_open(uint8_t rhport, uint8_t drv_id, tusb_desc_interface_t const* desc_itf, uint16_t max_len) {
+  usbd_class_driver_t const *driver = get_driver(drv_id);
+  TU_ASSERT(driver, 0);
+  uint16_t const drv_len = driver->open(rhport, desc_itf, max_len);
+  return ((sizeof(tusb_desc_interface_t) <= drv_len) && (drv_len <= max_len)) ? drv_len : 0;
+}
+
+#if CFG_TUD_DESC_CACHE
+// driver bound to interface by previous SET_CONFIGURATION with the same descriptor
+static uint8_t cached_driver(usbd_cfg_cache_t const* cfg_cache, uint8_t itf_num) {
+  return (cfg_cache && itf_num < CFG_TUD_INTERFACE_MAX) ? cfg_cache->itf2drv[itf_num] : DRVID_INVALID;
+}
+#else
+  #define cached_driver(_cache, _itf_num)   DRVID_INVALID
+#endif
+
+// find driver that opens interface, try hint_id first (if valid) then all drivers in order
+static uint8_t driver_find(uint8_t rhport, uint8_t hint_id, tusb_desc_interface_t const* desc_itf, uint16_t max_len,
+                           uint16_t* drv_len) {
+  if (hint_id < TOTAL_DRIVER_COUNT) {
+    *drv_len = driver_open(rhport, hint_id, desc_itf, max_len);
+    if (*drv_len) {
+      return hint_id;
+    }
+  }
+
+  for (uint8_t i = 0; i < TOTAL_DRIVER_COUNT; i++) {
+    *drv_len = driver_open(rhport, i, desc_itf, max_len);
+    if (*drv_len) {
+      return i;
+    }
+  }
+
+  return DRVID_INVALID;
+}
+
+// bind itf_count interfaces starting from itf_num to driver, interface number must not be used already
+static bool bind_interfaces(usbd_device_t* p_dev, uint8_t itf_num, uint8_t itf_count, uint8_t drv_id) {
+  for (uint8_t i = 0; i < itf_count; i++) {
+    uint8_t const num = (uint8_t) (itf_num + i);
+    TU_ASSERT(num < CFG_TUD_INTERFACE_MAX && DRVID_INVALID == p_dev->itf2drv[num]);
+    p_dev->itf2drv[num] = drv_id;
+  }
+  return true;
+}
+
 // Process Set Configure Request
 // This function parse configuration descriptor & open drivers accordingly
 static bool process_set_config(uint8_t rhport, uint8_t cfg_num)
 {
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+
   // index is cfg_num-1
   tusb_desc_configuration_t const * desc_cfg = (tusb_desc_configuration_t const *) tud_descriptor_configuration_cb(cfg_num-1);
   TU_ASSERT(desc_cfg != NULL && desc_cfg->bDescriptorType == TUSB_DESC_CONFIGURATION);
 
   // Parse configuration descriptor
-  _usbd_dev.remote_wakeup_support = (desc_cfg->bmAttributes & TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP) ? 1u : 0u;
-  _usbd_dev.self_powered          = (desc_cfg->bmAttributes & TUSB_DESC_CONFIG_ATT_SELF_POWERED ) ? 1u : 0u;
+  p_dev->remote_wakeup_support = (desc_cfg->bmAttributes & TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP) ? 1u : 0u;
+  p_dev->self_powered          = (desc_cfg->bmAttributes & TUSB_DESC_CONFIG_ATT_SELF_POWERED ) ? 1u : 0u;
+  control_fast_status_update(rhport, p_dev);
+
+  // let dcd plan its packet memory for all endpoints (and alternate settings) of this configuration, using the
+  // static layout from application if provided
+  uint8_t mem_count = 0;
+  tu_edpt_mem_t const* mem = tud_edpt_mem_plan_cb(rhport, cfg_num - 1, &mem_count);
+  if (!(mem && dcd_edpt_mem_plan && dcd_edpt_mem_plan(rhport, mem, mem_count)) && dcd_edpt_plan) {
+    dcd_edpt_plan(rhport, desc_cfg);
+  }
 
   // Parse interface descriptor
+  uint16_t const total_len = tu_le16toh(desc_cfg->wTotalLength);
   uint8_t const * p_desc   = ((uint8_t const*) desc_cfg) + sizeof(tusb_desc_configuration_t);
-  uint8_t const * desc_end = ((uint8_t const*) desc_cfg) + tu_le16toh(desc_cfg->wTotalLength);
+  uint8_t const * desc_end = ((uint8_t const*) desc_cfg) + total_len;
+
+  #if CFG_TUD_DESC_CACHE
+  // binding of previous SET_CONFIGURATION with the same descriptor
+  usbd_cfg_cache_t const* cfg_cache = &_usbd_desc_cache[idx].cfg[(cfg_num - 1) % CFG_TUD_DESC_CACHE];
+  if (cfg_cache->cfg_num != cfg_num || cfg_cache->desc_cfg != (uint8_t const*) desc_cfg ||
+      cfg_cache->total_len != total_len) {
+    cfg_cache = NULL;
+  }
+  #endif
+
+  // function layout computed at compile time e.g by usbd_desc.hpp, if provided there is no need to parse descriptor
+  uint8_t func_count = 0;
+  tud_desc_function_t const* func = tud_descriptor_configuration_layout_cb(cfg_num - 1, &func_count);
+  if (func) {
+    for (uint8_t f = 0; f < func_count; f++, func++) {
+      TU_ASSERT(func->offset + func->len <= total_len);
+      tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*) (((uint8_t const*) desc_cfg) + func->offset);
+      TU_ASSERT(TUSB_DESC_INTERFACE == desc_itf->bDescriptorType && func->itf_num == desc_itf->bInterfaceNumber);
+
+      uint16_t drv_len = 0;
+      uint8_t const drv_id = driver_find(rhport, cached_driver(cfg_cache, func->itf_num), desc_itf, func->len, &drv_len);
+      TU_ASSERT(drv_id < TOTAL_DRIVER_COUNT);
+      TU_LOG_USBD("  %s opened\r\n", get_driver(drv_id)->name);
+
+      TU_ASSERT(bind_interfaces(p_dev, func->itf_num, func->itf_count, drv_id));
+      for (uint8_t dir = 0; dir < 2; dir++) {
+        for (uint8_t epnum = 1; epnum < CFG_TUD_ENDPPOINT_MAX; epnum++) {
+          if (tu_bit_test(func->ep_bitmap[dir], epnum)) {
+            p_dev->ep2drv[epnum][dir] = drv_id;
+          }
+        }
+      }
+    }
+    p_desc = desc_end; // all functions are opened, skip parsing below
+  }
 
   while( p_desc < desc_end )
   {
@@ -1011,65 +2054,93 @@ static bool process_set_config(uint8_t rhport, uint8_t cfg_num)
 
     // Find driver for this interface
     uint16_t const remaining_len = (uint16_t) (desc_end-p_desc);
-    uint8_t drv_id;
-    for (drv_id = 0; drv_id < TOTAL_DRIVER_COUNT; drv_id++)
+    uint16_t drv_len = 0;
+    uint8_t const drv_id = driver_find(rhport, cached_driver(cfg_cache, desc_itf->bInterfaceNumber), desc_itf,
+                                       remaining_len, &drv_len);
+
+    // Failed if there is no supported drivers
+    TU_ASSERT(drv_id < TOTAL_DRIVER_COUNT);
+
+    TU_LOG_USBD("  %s opened\r\n", get_driver(drv_id)->name);
+
+    // Some drivers use 2 or more interfaces but may not have IAD e.g MIDI (always) or
+    // BTH (even CDC) with class in device descriptor (single interface)
+    if ( assoc_itf_count == 1)
     {
       usbd_class_driver_t const *driver = get_driver(drv_id);
-      TU_ASSERT(driver);
-      uint16_t const drv_len = driver->open(rhport, desc_itf, remaining_len);
+      (void) driver;
 
-      if ( (sizeof(tusb_desc_interface_t) <= drv_len)  && (drv_len <= remaining_len) )
-      {
-        // Open successfully
-        TU_LOG_USBD("  %s opened\r\n", driver->name);
+      #if CFG_TUD_CDC
+      if ( driver->open == cdcd_open ) assoc_itf_count = 2;
+      #endif
 
-        // Some drivers use 2 or more interfaces but may not have IAD e.g MIDI (always) or
-        // BTH (even CDC) with class in device descriptor (single interface)
-        if ( assoc_itf_count == 1)
-        {
-          #if CFG_TUD_CDC
-          if ( driver->open == cdcd_open ) assoc_itf_count = 2;
-          #endif
+      #if CFG_TUD_MIDI
+      if ( driver->open == midid_open ) assoc_itf_count = 2;
+      #endif
 
-          #if CFG_TUD_MIDI
-          if ( driver->open == midid_open ) assoc_itf_count = 2;
-          #endif
+      #if CFG_TUD_BTH && CFG_TUD_BTH_ISO_ALT_COUNT
+      if ( driver->open == btd_open ) assoc_itf_count = 2;
+      #endif
+    }
 
-          #if CFG_TUD_BTH && CFG_TUD_BTH_ISO_ALT_COUNT
-          if ( driver->open == btd_open ) assoc_itf_count = 2;
-          #endif
-        }
+    // bind (associated) interfaces to found driver
+    TU_ASSERT(bind_interfaces(p_dev, desc_itf->bInterfaceNumber, assoc_itf_count, drv_id));
 
-        // bind (associated) interfaces to found driver
-        for(uint8_t i=0; i<assoc_itf_count; i++)
-        {
-          uint8_t const itf_num = desc_itf->bInterfaceNumber+i;
+    // bind all endpoints to found driver
+    tu_edpt_bind_driver(p_dev->ep2drv, desc_itf, drv_len, drv_id);
 
-          // Interface number must not be used already
-          TU_ASSERT(DRVID_INVALID == _usbd_dev.itf2drv[itf_num]);
-          _usbd_dev.itf2drv[itf_num] = drv_id;
-        }
+    // next Interface
+    p_desc += drv_len;
+  }
 
-        // bind all endpoints to found driver
-        tu_edpt_bind_driver(_usbd_dev.ep2drv, desc_itf, drv_len, drv_id);
+  #if CFG_TUD_DESC_CACHE
+  // remember binding for next time this configuration is selected
+  usbd_cfg_cache_t* entry = &_usbd_desc_cache[idx].cfg[(cfg_num - 1) % CFG_TUD_DESC_CACHE];
+  entry->desc_cfg  = (uint8_t const*) desc_cfg;
+  entry->total_len = total_len;
+  entry->cfg_num   = cfg_num;
+  memcpy(entry->itf2drv, p_dev->itf2drv, sizeof(entry->itf2drv));
+  #endif
 
-        // next Interface
-        p_desc += drv_len;
+  return true;
+}
 
-        break; // exit driver find loop
-      }
+#if CFG_TUD_DESC_CACHE && CFG_TUD_DESC_CACHE_STRING_BUFSIZE
+static uint8_t const* string_cache_lookup(uint8_t idx, uint8_t index, uint16_t langid) {
+  uint16_t offset = 0;
+  while (offset < _usbd_desc_cache[idx].str_used) {
+    uint8_t const* entry = &_usbd_desc_cache[idx].str_buf[offset];
+    if (entry[0] == index && tu_u16(entry[2], entry[1]) == langid) {
+      return entry + 4;
     }
+    offset = (uint16_t) (offset + 4 + tu_round_up(entry[4], 4));
+  }
+  return NULL;
+}
 
-    // Failed if there is no supported drivers
-    TU_ASSERT(drv_id < TOTAL_DRIVER_COUNT);
+// copy string descriptor to cache if there is enough room, otherwise it is just not cached
+static void string_cache_add(uint8_t idx, uint8_t index, uint16_t langid, uint8_t const* desc_str) {
+  uint8_t const len = tu_desc_len(desc_str);
+  uint32_t const entry_len = 4 + tu_round_up(len, 4);
+  if (len < 2 || _usbd_desc_cache[idx].str_used + entry_len > CFG_TUD_DESC_CACHE_STRING_BUFSIZE) {
+    return;
   }
 
-  return true;
+  uint8_t* entry = &_usbd_desc_cache[idx].str_buf[_usbd_desc_cache[idx].str_used];
+  entry[0] = index;
+  entry[1] = tu_u16_low(langid);
+  entry[2] = tu_u16_high(langid);
+  entry[3] = 0;
+  memcpy(entry + 4, desc_str, len);
+  _usbd_desc_cache[idx].str_used = (uint16_t) (_usbd_desc_cache[idx].str_used + entry_len);
 }
+#endif
 
 // return descriptor's buffer and update desc_len
 static bool process_get_descriptor(uint8_t rhport, tusb_control_request_t const * p_request)
 {
+  uint8_t const idx = get_index(rhport);
+
   tusb_desc_type_t const desc_type = (tusb_desc_type_t) tu_u16_high(p_request->wValue);
   uint8_t const desc_index = tu_u16_low( p_request->wValue );
 
@@ -1083,7 +2154,7 @@ static bool process_get_descriptor(uint8_t rhport, tusb_control_request_t const
 
       // Only response with exactly 1 Packet if: not addressed and host requested more data than device descriptor has.
       // This only happens with the very first get device descriptor and EP0 size = 8 or 16.
-      if ((CFG_TUD_ENDPOINT0_SIZE < sizeof(tusb_desc_device_t)) && !_usbd_dev.addressed &&
+      if ((CFG_TUD_ENDPOINT0_SIZE < sizeof(tusb_desc_device_t)) && !_usbd_dev[idx].addressed &&
           ((tusb_control_request_t const*) p_request)->wLength > sizeof(tusb_desc_device_t)) {
         // Hack here: we modify the request length to prevent usbd_control response with zlp
         // since we are responding with 1 packet & less data than wLength.
@@ -1100,6 +2171,12 @@ static bool process_get_descriptor(uint8_t rhport, tusb_control_request_t const
     case TUSB_DESC_BOS: {
       TU_LOG_USBD(" BOS\r\n");
 
+      #if CFG_TUD_DESC_CACHE
+      if (_usbd_desc_cache[idx].bos) {
+        return tud_control_xfer(rhport, p_request, (void*) (uintptr_t) _usbd_desc_cache[idx].bos, _usbd_desc_cache[idx].bos_len);
+      }
+      #endif
+
       // requested by host if USB > 2.0 ( i.e 2.1 or 3.x )
       uintptr_t desc_bos = (uintptr_t) tud_descriptor_bos_cb();
       TU_VERIFY(desc_bos);
@@ -1107,6 +2184,11 @@ static bool process_get_descriptor(uint8_t rhport, tusb_control_request_t const
       // Use offsetof to avoid pointer to the odd/misaligned address
       uint16_t const total_len = tu_le16toh( tu_unaligned_read16((const void*) (desc_bos + offsetof(tusb_desc_bos_t, wTotalLength))) );
 
+      #if CFG_TUD_DESC_CACHE
+      _usbd_desc_cache[idx].bos     = (uint8_t const*) desc_bos;
+      _usbd_desc_cache[idx].bos_len = total_len;
+      #endif
+
       return tud_control_xfer(rhport, p_request, (void*) desc_bos, total_len);
     }
     // break; // unreachable
@@ -1137,10 +2219,23 @@ static bool process_get_descriptor(uint8_t rhport, tusb_control_request_t const
     {
       TU_LOG_USBD(" String[%u]\r\n", desc_index);
 
+      uint16_t const langid = tu_le16toh(p_request->wIndex);
+
+      #if CFG_TUD_DESC_CACHE && CFG_TUD_DESC_CACHE_STRING_BUFSIZE
+      uint8_t const* cached_str = string_cache_lookup(idx, desc_index, langid);
+      if (cached_str) {
+        return tud_control_xfer(rhport, p_request, (void*) (uintptr_t) cached_str, tu_desc_len(cached_str));
+      }
+      #endif
+
       // String Descriptor always uses the desc set from user
-      uint8_t const* desc_str = (uint8_t const*) tud_descriptor_string_cb(desc_index, tu_le16toh(p_request->wIndex));
+      uint8_t const* desc_str = (uint8_t const*) tud_descriptor_string_cb(desc_index, langid);
       TU_VERIFY(desc_str);
 
+      #if CFG_TUD_DESC_CACHE && CFG_TUD_DESC_CACHE_STRING_BUFSIZE
+      string_cache_add(idx, desc_index, langid, desc_str);
+      #endif
+
       // first byte of descriptor is its size
       return tud_control_xfer(rhport, p_request, (void*) (uintptr_t) desc_str, tu_desc_len(desc_str));
     }
@@ -1161,14 +2256,137 @@ static bool process_get_descriptor(uint8_t rhport, tusb_control_request_t const
 //--------------------------------------------------------------------+
 // DCD Event Handler
 //--------------------------------------------------------------------+
+
+// Bus is resumed: invoke drivers' resume() in ISR so that they can re-arm endpoints before the first token from
+// host, usbd task is only notified afterwards
+static void bus_resume(usbd_device_t* p_dev, uint8_t rhport) {
+  p_dev->suspended = 0;
+  p_dev->wakeup_pending = 0;
+  for (uint8_t i = 0; i < TOTAL_DRIVER_COUNT; i++) {
+    usbd_class_driver_t const* driver = get_driver(i);
+    if (driver && driver->resume) {
+      driver->resume(rhport);
+    }
+  }
+}
+
+// L1 sleep is exited: by host resume, remote wakeup or any bus activity (SOF)
+TU_ATTR_ALWAYS_INLINE static inline void lpm_resume(usbd_device_t* p_dev, uint8_t rhport, bool in_isr) {
+  p_dev->lpm_sleep = 0;
+  bus_resume(p_dev, rhport);
+  dcd_event_t const event_resume = {.rhport = rhport, .event_id = USBD_EVENT_LPM_RESUME};
+  queue_event(&event_resume, in_isr);
+}
+
+#if CFG_TUD_CONTROL_FAST
+TU_ATTR_ALWAYS_INLINE static inline bool control_fast_match(usbd_control_fast_t const* entry, uint8_t rhport,
+                                                          tusb_control_request_t const* request) {
+  return entry->len && entry->rhport == rhport && entry->bmRequestType == request->bmRequestType &&
+         entry->bRequest == request->bRequest && entry->wValue == request->wValue && entry->wIndex == request->wIndex;
+}
+
+bool usbd_control_fast_set(uint8_t rhport, tusb_control_request_t const* request, void const* data, uint16_t len) {
+  TU_ASSERT(request->bmRequestType_bit.direction == TUSB_DIR_IN && len > 0 && len <= CFG_TUD_CONTROL_FAST_SIZE);
+  usbd_control_fast_t* entry = NULL;
+
+  osal_spin_lock(&_usbd_spin, false);
+  for (uint8_t i = 0; i < CFG_TUD_CONTROL_FAST; i++) {
+    usbd_control_fast_t* p = &_usbd_ctrl_fast[i];
+    if (control_fast_match(p, rhport, request)) {
+      entry = p;
+      break;
+    }
+    if (entry == NULL && p->len == 0) {
+      entry = p;
+    }
+  }
+
+  if (entry) {
+    entry->rhport = rhport;
+    entry->bmRequestType = request->bmRequestType;
+    entry->bRequest = request->bRequest;
+    entry->wValue = request->wValue;
+    entry->wIndex = request->wIndex;
+    entry->len = (uint8_t) len;
+    memcpy(entry->data, data, len);
+  }
+  osal_spin_unlock(&_usbd_spin, false);
+
+  TU_ASSERT(entry);
+  return true;
+}
+
+void usbd_control_fast_clear(uint8_t rhport, tusb_control_request_t const* request) {
+  osal_spin_lock(&_usbd_spin, false);
+  for (uint8_t i = 0; i < CFG_TUD_CONTROL_FAST; i++) {
+    if (control_fast_match(&_usbd_ctrl_fast[i], rhport, request)) {
+      _usbd_ctrl_fast[i].len = 0;
+    }
+  }
+  osal_spin_unlock(&_usbd_spin, false);
+}
+
+// Answer SETUP with a registered response: data and status stages are driven from ISR, usbd task never sees
+// this request. Return false to let usbd task process it.
+static bool control_fast_setup(uint8_t rhport, uint8_t idx, tusb_control_request_t const* request, bool in_isr) {
+  if (request->bmRequestType_bit.direction != TUSB_DIR_IN || request->wLength == 0) {
+    return false;
+  }
+
+  uint8_t* buf = _usbd_ctrl_fast_epbuf[idx].buf;
+  uint16_t len = 0;
+  osal_spin_lock(&_usbd_spin, in_isr);
+  for (uint8_t i = 0; i < CFG_TUD_CONTROL_FAST; i++) {
+    usbd_control_fast_t const* entry = &_usbd_ctrl_fast[i];
+    if (control_fast_match(entry, rhport, request)) {
+      len = tu_min16(entry->len, request->wLength);
+      memcpy(buf, entry->data, len);
+      break;
+    }
+  }
+  osal_spin_unlock(&_usbd_spin, in_isr);
+
+  // short response of a full packet must be followed by ZLP, leave it to usbd task
+  if (len == 0 || (len < request->wLength && len == CFG_TUD_ENDPOINT0_SIZE)) {
+    return false;
+  }
+
+  _usbd_ctrl_fast_stage[idx] = CONTROL_FAST_DATA;
+  if (!dcd_edpt_xfer(rhport, TUSB_DIR_IN_MASK, buf, len)) {
+    _usbd_ctrl_fast_stage[idx] = CONTROL_FAST_IDLE;
+    return false;
+  }
+  return true;
+}
+
+// Data stage is complete: host acknowledges with a zero-length OUT status stage
+static void control_fast_xfer(uint8_t rhport, uint8_t idx, uint8_t ep_addr, uint8_t result) {
+  if (_usbd_ctrl_fast_stage[idx] == CONTROL_FAST_DATA && ep_addr == TUSB_DIR_IN_MASK &&
+      result == XFER_RESULT_SUCCESS) {
+    _usbd_ctrl_fast_stage[idx] = CONTROL_FAST_STATUS;
+    if (dcd_edpt_xfer(rhport, 0, NULL, 0)) {
+      return;
+    }
+  }
+  _usbd_ctrl_fast_stage[idx] = CONTROL_FAST_IDLE;
+}
+#endif
+
 TU_ATTR_FAST_FUNC void dcd_event_handler(dcd_event_t const* event, bool in_isr) {
+  TU_TRACE(TU_TRACE_DCD_EVENT, event->event_id,
+           event->event_id == DCD_EVENT_XFER_COMPLETE ? event->xfer_complete.ep_addr : 0,
+           event->event_id == DCD_EVENT_XFER_COMPLETE ? event->xfer_complete.len :
+           (event->event_id == DCD_EVENT_SOF ? event->sof.frame_count : 0));
+  uint8_t const idx = get_index(event->rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
   bool send = false;
   switch (event->event_id) {
     case DCD_EVENT_UNPLUGGED:
-      _usbd_dev.connected = 0;
-      _usbd_dev.addressed = 0;
-      _usbd_dev.cfg_num = 0;
-      _usbd_dev.suspended = 0;
+      p_dev->connected = 0;
+      p_dev->addressed = 0;
+      p_dev->cfg_num = 0;
+      p_dev->suspended = 0;
+      p_dev->lpm_sleep = 0;
       send = true;
       break;
 
@@ -1177,16 +2395,29 @@ TU_ATTR_FAST_FUNC void dcd_event_handler(dcd_event_t const* event, bool in_isr)
       // can accidentally meet the SUSPEND condition ( Bus Idle for 3ms ).
       // In addition, some MCUs such as SAMD or boards that haven no VBUS detection cannot distinguish
       // suspended vs disconnected. We will skip handling SUSPEND/RESUME event if not currently connected
-      if (_usbd_dev.connected) {
-        _usbd_dev.suspended = 1;
+      if (p_dev->connected) {
+        p_dev->suspended = 1;
+        p_dev->wakeup_pending = 0;
         send = true;
       }
       break;
 
     case DCD_EVENT_RESUME:
       // skip event if not connected (especially required for SAMD)
-      if (_usbd_dev.connected) {
-        _usbd_dev.suspended = 0;
+      if (p_dev->connected) {
+        if (p_dev->lpm_sleep) {
+          lpm_resume(p_dev, event->rhport, in_isr);
+        } else {
+          bus_resume(p_dev, event->rhport);
+          send = true;
+        }
+      }
+      break;
+
+    case DCD_EVENT_LPM_SLEEP:
+      if (p_dev->connected) {
+        p_dev->lpm_sleep = 1;
+        p_dev->lpm_remote_wakeup = event->lpm_sleep.remote_wakeup ? 1 : 0;
         send = true;
       }
       break;
@@ -1202,21 +2433,164 @@ TU_ATTR_FAST_FUNC void dcd_event_handler(dcd_event_t const* event, bool in_isr)
 
       // Some MCUs after running dcd_remote_wakeup() does not have way to detect the end of remote wakeup
       // which last 1-15 ms. DCD can use SOF as a clear indicator that bus is back to operational
-      if (_usbd_dev.suspended) {
-        _usbd_dev.suspended = 0;
+      if (p_dev->suspended) {
+        bus_resume(p_dev, event->rhport);
 
         dcd_event_t const event_resume = {.rhport = event->rhport, .event_id = DCD_EVENT_RESUME};
         queue_event(&event_resume, in_isr);
       }
+      if (p_dev->lpm_sleep) {
+        lpm_resume(p_dev, event->rhport, in_isr);
+      }
 
-      if (tu_bit_test(_usbd_dev.sof_consumer, SOF_CONSUMER_USER)) {
+      if (tu_bit_test(p_dev->sof_consumer, SOF_CONSUMER_USER)) {
+        // decimate user SOF so that usbd task is only woken up as often as application needs
+        if (_usbd_sof_cb_interval > 1) {
+          _usbd_sof_cb_count++;
+          if (_usbd_sof_cb_count < _usbd_sof_cb_interval) {
+            break;
+          }
+          _usbd_sof_cb_count = 0;
+        }
+
+#if CFG_TUD_EVENT_COALESCE
+        // previous SOF is not processed yet, only update its frame count
+        osal_spin_lock(&_usbd_spin, in_isr);
+        _usbd_sof_frame[idx] = event->sof.frame_count;
+        bool const sof_queued = _usbd_sof_queued[idx];
+        _usbd_sof_queued[idx] = true;
+        osal_spin_unlock(&_usbd_spin, in_isr);
+        if (sof_queued) {
+          break;
+        }
+#endif
         dcd_event_t const event_sof = {.rhport = event->rhport, .event_id = DCD_EVENT_SOF, .sof.frame_count = event->sof.frame_count};
+#if CFG_TUD_EVENT_COALESCE
+        if (!queue_event(&event_sof, in_isr)) {
+          _usbd_sof_queued[idx] = false;
+        }
+#else
         queue_event(&event_sof, in_isr);
+#endif
       }
       break;
 
     case DCD_EVENT_SETUP_RECEIVED:
-      _usbd_queued_setup++;
+#if CFG_TUD_CONTROL_FAST
+      // new SETUP aborts fast answered request. Only answer when configured and no SETUP is waiting for usbd task,
+      // since it would otherwise respond to the same control pipe
+      _usbd_ctrl_fast_stage[idx] = CONTROL_FAST_IDLE;
+      if (p_dev->cfg_num && _usbd_queued_setup[idx] == 0 &&
+          control_fast_setup(event->rhport, idx, &event->setup_received, in_isr)) {
+        break;
+      }
+#endif
+      _usbd_queued_setup[idx]++;
+      send = true;
+      break;
+
+    case DCD_EVENT_XFER_COMPLETE: {
+      uint8_t const ep_addr = event->xfer_complete.ep_addr;
+      uint8_t const epnum = tu_edpt_number(ep_addr);
+      uint8_t const ep_dir = tu_edpt_dir(ep_addr);
+      if (epnum == 0) {
+#if CFG_TUD_CONTROL_FAST
+        if (_usbd_ctrl_fast_stage[idx] != CONTROL_FAST_IDLE) {
+          control_fast_xfer(event->rhport, idx, ep_addr, event->xfer_complete.result);
+          break;
+        }
+#endif
+        send = true; // control stages must be processed one by one
+        break;
+      }
+
+#if CFG_TUD_EDPT_ISO_XFER
+      // packet list is reported as one completion once its last packet is done
+      dcd_event_t iso_event;
+      usbd_iso_xfer_t* iso = &p_dev->ep_iso[epnum][ep_dir];
+      if (iso->active) {
+        iso_event = *event;
+        if (iso_xfer_advance(event->rhport, iso, &iso_event)) {
+          break;
+        }
+        event = &iso_event;
+      }
+#endif
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+      // chain next queued transfer right away, endpoint does not wait for usbd task to be re-armed
+      bool const queued = p_dev->ep_queue[epnum][ep_dir].running;
+      if (queued) {
+        xfer_queue_advance(event->rhport, ep_addr, in_isr);
+      }
+#endif
+
+      if (tu_bit_test(p_dev->ep_isr_cb[ep_dir], epnum)) {
+#if USBD_XFER_SPLIT
+        // remaining parts of a split transfer are submitted by usbd task
+        if (p_dev->ep_split[epnum][ep_dir].active) {
+          send = true;
+          break;
+        }
+#endif
+        usbd_class_driver_t const* driver = get_driver(p_dev->ep2drv[epnum][ep_dir]);
+        if (driver != NULL) {
+#if CFG_TUD_EDPT_XFER_QUEUE
+          if (!xfer_queue_delivered(p_dev, ep_addr, in_isr))
+#endif
+          {
+            p_dev->ep_status[epnum][ep_dir].busy = 0;
+          }
+          p_dev->ep_status[epnum][ep_dir].claimed = 0;
+          stats_edpt_xfer(ep_addr, event->xfer_complete.result, event->xfer_complete.len);
+          TU_TRACE(TU_TRACE_CB_ENTER, 0, ep_addr, event->xfer_complete.len);
+          driver->xfer_cb(event->rhport, ep_addr, (xfer_result_t) event->xfer_complete.result, event->xfer_complete.len);
+          TU_TRACE(TU_TRACE_CB_EXIT, 0, ep_addr, 0);
+        }
+        break;
+      }
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+      if (queued) {
+        send = true; // driver gets one callback per queued transfer, never coalesced
+        break;
+      }
+#endif
+
+#if CFG_TUD_EVENT_COALESCE
+      usbd_xfer_coalesce_t* coalesce = &_usbd_xfer_coalesce[idx][epnum][ep_dir];
+      osal_spin_lock(&_usbd_spin, in_isr);
+      bool const coalesced = (coalesce->count > 0);
+      if (coalesced) {
+        // previous completion is still queued: merge into it, keep the first failure
+        coalesce->len += event->xfer_complete.len;
+        if (coalesce->count < UINT16_MAX) {
+          coalesce->count++;
+        }
+        if (coalesce->result == XFER_RESULT_SUCCESS) {
+          coalesce->result = event->xfer_complete.result;
+        }
+      } else {
+        coalesce->len = event->xfer_complete.len;
+        coalesce->result = event->xfer_complete.result;
+        coalesce->count = 1;
+      }
+      osal_spin_unlock(&_usbd_spin, in_isr);
+
+      // queue outside of spinlock since queue may take its own lock
+      if (!coalesced && !queue_event(event, in_isr)) {
+        coalesce->count = 0;
+      }
+#else
+      send = true;
+#endif
+      break;
+    }
+
+    case USBD_EVENT_FUNC_CALL:
+#if CFG_TUD_STATS
+      _usbd_stats.isr_deferred++;
+#endif
       send = true;
       break;
 
@@ -1234,14 +2608,21 @@ TU_ATTR_FAST_FUNC void dcd_event_handler(dcd_event_t const* event, bool in_isr)
 // USBD API For Class Driver
 //--------------------------------------------------------------------+
 
+bool usbd_rhport_armable(uint8_t rhport) {
+  usbd_device_t const* p_dev = get_device(rhport);
+  return p_dev->cfg_num && (!p_dev->suspended || p_dev->wakeup_pending);
+}
+
 void usbd_int_set(bool enabled)
 {
-  if (enabled)
-  {
-    dcd_int_enable(_usbd_rhport);
-  }else
-  {
-    dcd_int_disable(_usbd_rhport);
+  for (uint8_t i = 0; i < CFG_TUD_RHPORT_NUM; i++) {
+    if (tu_bit_test(_usbd_inited, i)) {
+      if (enabled) {
+        dcd_int_enable(_usbd_rhport[i]);
+      } else {
+        dcd_int_disable(_usbd_rhport[i]);
+      }
+    }
   }
 }
 
@@ -1285,40 +2666,69 @@ void usbd_defer_func(osal_task_func_t func, void* param, bool in_isr) {
 // USBD Endpoint API
 //--------------------------------------------------------------------+
 
+// remember interrupt/isochronous endpoints for priority queue
+static void edpt_mark_periodic(usbd_device_t* p_dev, tusb_desc_endpoint_t const* desc_ep) {
+  uint8_t const xfer_type = desc_ep->bmAttributes.xfer;
+  if (xfer_type == TUSB_XFER_INTERRUPT || xfer_type == TUSB_XFER_ISOCHRONOUS) {
+    p_dev->ep_periodic[tu_edpt_dir(desc_ep->bEndpointAddress)] |= (uint16_t) TU_BIT(tu_edpt_number(desc_ep->bEndpointAddress));
+  }
+}
+
 bool usbd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const* desc_ep) {
-  rhport = _usbd_rhport;
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
 
   TU_ASSERT(tu_edpt_number(desc_ep->bEndpointAddress) < CFG_TUD_ENDPPOINT_MAX);
-  TU_ASSERT(tu_edpt_validate(desc_ep, (tusb_speed_t) _usbd_dev.speed));
+  TU_ASSERT(tu_edpt_validate(desc_ep, (tusb_speed_t) p_dev->speed));
+  edpt_mark_periodic(p_dev, desc_ep);
+  p_dev->ep_isr_cb[tu_edpt_dir(desc_ep->bEndpointAddress)] &= (uint16_t) ~TU_BIT(tu_edpt_number(desc_ep->bEndpointAddress));
 
   return dcd_edpt_open(rhport, desc_ep);
 }
 
+bool usbd_edpt_isr_callback(uint8_t rhport, uint8_t ep_addr, bool enabled) {
+  usbd_device_t* p_dev = get_device(rhport);
+
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir = tu_edpt_dir(ep_addr);
+  TU_ASSERT(epnum > 0 && epnum < CFG_TUD_ENDPPOINT_MAX);
+
+  if (enabled) {
+    p_dev->ep_isr_cb[dir] |= (uint16_t) TU_BIT(epnum);
+  } else {
+    p_dev->ep_isr_cb[dir] &= (uint16_t) ~TU_BIT(epnum);
+  }
+  return true;
+}
+
 bool usbd_edpt_claim(uint8_t rhport, uint8_t ep_addr) {
-  (void) rhport;
+  usbd_device_t* p_dev = get_device(rhport);
 
   // TODO add this check later, also make sure we don't starve an out endpoint while suspending
   // TU_VERIFY(tud_ready());
 
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
-  tu_edpt_state_t* ep_state = &_usbd_dev.ep_status[epnum][dir];
+  tu_edpt_state_t* ep_state = &p_dev->ep_status[epnum][dir];
 
   return tu_edpt_claim(ep_state, _usbd_mutex);
 }
 
 bool usbd_edpt_release(uint8_t rhport, uint8_t ep_addr) {
-  (void) rhport;
+  usbd_device_t* p_dev = get_device(rhport);
 
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
-  tu_edpt_state_t* ep_state = &_usbd_dev.ep_status[epnum][dir];
+  tu_edpt_state_t* ep_state = &p_dev->ep_status[epnum][dir];
 
   return tu_edpt_release(ep_state, _usbd_mutex);
 }
 
-bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes) {
-  rhport = _usbd_rhport;
+bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint32_t total_bytes) {
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
 
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
@@ -1326,7 +2736,7 @@ bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t t
   // TODO skip ready() check for now since enumeration also use this API
   // TU_VERIFY(tud_ready());
 
-  TU_LOG_USBD("  Queue EP %02X with %u bytes ...\r\n", ep_addr, total_bytes);
+  TU_LOG_USBD("  Queue EP %02X with %u bytes ...\r\n", ep_addr, (unsigned int) total_bytes);
 #if CFG_TUD_LOG_LEVEL >= 3
   if(dir == TUSB_DIR_IN) {
     TU_LOG_MEM(CFG_TUD_LOG_LEVEL, buffer, total_bytes, 2);
@@ -1334,30 +2744,152 @@ bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t t
 #endif
 
   // Attempt to transfer on a busy endpoint, sound like an race condition !
-  TU_ASSERT(_usbd_dev.ep_status[epnum][dir].busy == 0);
+  TU_ASSERT(p_dev->ep_status[epnum][dir].busy == 0);
 
   // Set busy first since the actual transfer can be complete before dcd_edpt_xfer()
   // could return and USBD task can preempt and clear the busy
-  _usbd_dev.ep_status[epnum][dir].busy = 1;
+  p_dev->ep_status[epnum][dir].busy = 1;
+  TU_TRACE(TU_TRACE_DCD_XFER, 0, ep_addr, total_bytes);
+
+  bool ret;
+#if USBD_XFER_SPLIT
+  usbd_xfer_split_t* split = &p_dev->ep_split[epnum][dir];
+  split->active = 0;
+#endif
+
+#if CFG_TUD_EDPT_XFER_LARGE
+  if (total_bytes > TUP_DCD_EDPT_XFER_MAX) {
+    // submit 1st part, the rest is continued by usbd task on each completion
+    split->sg_next = NULL;
+    split->sg_count = 0;
+    split->buffer = buffer;
+    split->remaining = total_bytes;
+    split->xferred = 0;
+    split->active = 1;
+    ret = xfer_split_submit(rhport, ep_addr, split);
+  } else
+#endif
+  if (total_bytes <= UINT16_MAX) {
+    ret = dcd_edpt_xfer(rhport, ep_addr, buffer, (uint16_t) total_bytes);
+  } else {
+    TU_LOG_USBD("  Transfer larger than 64KB requires CFG_TUD_EDPT_XFER_LARGE\r\n");
+    ret = false;
+  }
 
-  if (dcd_edpt_xfer(rhport, ep_addr, buffer, total_bytes)) {
+  if (ret) {
     return true;
   } else {
     // DCD error, mark endpoint as ready to allow next transfer
-    _usbd_dev.ep_status[epnum][dir].busy = 0;
-    _usbd_dev.ep_status[epnum][dir].claimed = 0;
+#if USBD_XFER_SPLIT
+    split->active = 0;
+#endif
+    p_dev->ep_status[epnum][dir].busy = 0;
+    p_dev->ep_status[epnum][dir].claimed = 0;
     TU_LOG_USBD("FAILED\r\n");
     TU_BREAKPOINT();
     return false;
   }
 }
 
+#if CFG_TUD_EDPT_XFER_QUEUE
+bool usbd_edpt_xfer_queue(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes) {
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
+
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir = tu_edpt_dir(ep_addr);
+  TU_ASSERT(epnum > 0 && epnum < CFG_TUD_ENDPPOINT_MAX);
+  TU_ASSERT(total_bytes <= TUP_DCD_EDPT_XFER_MAX);
+
+  tu_edpt_state_t* ep_state = &p_dev->ep_status[epnum][dir];
+  usbd_xfer_queue_t* queue = &p_dev->ep_queue[epnum][dir];
+
+  osal_spin_lock(&_usbd_spin, false);
+  bool start = false;
+  bool accepted = true;
+  if (ep_state->stalled || (ep_state->busy && queue->pending == 0)) {
+    accepted = false; // stalled or busy with transfer of usbd_edpt_xfer()
+  } else if (!queue->running) {
+    queue->running = 1;
+    start = true;
+  } else if (queue->count < CFG_TUD_EDPT_XFER_QUEUE) {
+    uint8_t const wr = (uint8_t) ((queue->rd + queue->count) % CFG_TUD_EDPT_XFER_QUEUE);
+    queue->entry[wr].buffer = buffer;
+    queue->entry[wr].len = total_bytes;
+    queue->count++;
+  } else {
+    accepted = false; // queue is full
+  }
+  if (accepted) {
+    queue->pending++;
+    ep_state->busy = 1;
+  }
+  osal_spin_unlock(&_usbd_spin, false);
+
+  TU_LOG_USBD("  Queue EP %02X with %u bytes (%u pending) %s\r\n", ep_addr, total_bytes, queue->pending,
+              accepted ? "" : "FAILED");
+  TU_VERIFY(accepted);
+  TU_TRACE(TU_TRACE_DCD_XFER, 0, ep_addr, total_bytes);
+
+  if (start) {
+#if USBD_XFER_SPLIT
+    p_dev->ep_split[epnum][dir].active = 0;
+#endif
+    if (!dcd_edpt_xfer(rhport, ep_addr, buffer, total_bytes)) {
+      osal_spin_lock(&_usbd_spin, false);
+      queue->pending--;
+      if (queue->pending == 0) {
+        ep_state->busy = 0;
+      }
+      osal_spin_unlock(&_usbd_spin, false);
+
+      // start transfers queued meanwhile (by an ISR callback driver), or mark queue as idle
+      xfer_queue_advance(rhport, ep_addr, false);
+      TU_BREAKPOINT();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+uint8_t usbd_edpt_xfer_queue_pending(uint8_t rhport, uint8_t ep_addr) {
+  usbd_device_t* p_dev = get_device(rhport);
+  return p_dev->ep_queue[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)].pending;
+}
+#endif
+
+#if CFG_TUD_EPBUF_POOL_SIZE
+void* usbd_epbuf_alloc(uint32_t size) {
+  void* buf = tu_mempool_alloc(&_usbd_epbuf_pool, size);
+  TU_LOG_USBD("  Epbuf alloc %lu bytes %s, pool used %lu/%u\r\n", (unsigned long) size, buf ? "" : "FAILED",
+              (unsigned long) tu_mempool_used(&_usbd_epbuf_pool), (unsigned) CFG_TUD_EPBUF_POOL_SIZE);
+  return buf;
+}
+
+void usbd_epbuf_free(void* buf) {
+  tu_mempool_free(&_usbd_epbuf_pool, buf);
+}
+
+#endif
+
+uint32_t tud_epbuf_pool_watermark(void) {
+#if CFG_TUD_EPBUF_POOL_SIZE
+  return tu_mempool_watermark(&_usbd_epbuf_pool);
+#else
+  return 0;
+#endif
+}
+
 // The number of bytes has to be given explicitly to allow more flexible control of how many
 // bytes should be written and second to keep the return value free to give back a boolean
 // success message. If total_bytes is too big, the FIFO will copy only what is available
 // into the USB buffer!
 bool usbd_edpt_xfer_fifo(uint8_t rhport, uint8_t ep_addr, tu_fifo_t* ff, uint16_t total_bytes) {
-  rhport = _usbd_rhport;
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
 
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
@@ -1365,36 +2897,157 @@ bool usbd_edpt_xfer_fifo(uint8_t rhport, uint8_t ep_addr, tu_fifo_t* ff, uint16_
   TU_LOG_USBD("  Queue ISO EP %02X with %u bytes ... ", ep_addr, total_bytes);
 
   // Attempt to transfer on a busy endpoint, sound like an race condition !
-  TU_ASSERT(_usbd_dev.ep_status[epnum][dir].busy == 0);
+  TU_ASSERT(p_dev->ep_status[epnum][dir].busy == 0);
 
   // Set busy first since the actual transfer can be complete before dcd_edpt_xfer() could return
   // and usbd task can preempt and clear the busy
-  _usbd_dev.ep_status[epnum][dir].busy = 1;
+  p_dev->ep_status[epnum][dir].busy = 1;
+  TU_TRACE(TU_TRACE_DCD_XFER, 1, ep_addr, total_bytes);
+  TU_TRACE(TU_TRACE_FIFO_LEVEL, 0, ep_addr, tu_fifo_count(ff));
+
+#if USBD_XFER_SPLIT
+  p_dev->ep_split[epnum][dir].active = 0;
+#endif
 
   if (dcd_edpt_xfer_fifo(rhport, ep_addr, ff, total_bytes)) {
     TU_LOG_USBD("OK\r\n");
     return true;
   } else {
     // DCD error, mark endpoint as ready to allow next transfer
-    _usbd_dev.ep_status[epnum][dir].busy = 0;
-    _usbd_dev.ep_status[epnum][dir].claimed = 0;
+    p_dev->ep_status[epnum][dir].busy = 0;
+    p_dev->ep_status[epnum][dir].claimed = 0;
     TU_LOG_USBD("failed\r\n");
     TU_BREAKPOINT();
     return false;
   }
 }
 
+#if CFG_TUD_EDPT_XFER_SG
+bool usbd_edpt_xfer_sg(uint8_t rhport, uint8_t ep_addr, tu_xfer_sg_t const* sg_list, uint8_t count) {
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
+
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir = tu_edpt_dir(ep_addr);
+
+  TU_ASSERT(sg_list && count);
+  TU_LOG_USBD("  Queue EP %02X with %u SG buffers ...\r\n", ep_addr, count);
+
+  // Attempt to transfer on a busy endpoint, sound like an race condition !
+  TU_ASSERT(p_dev->ep_status[epnum][dir].busy == 0);
+
+  // Set busy first since the actual transfer can be complete before dcd_edpt_xfer()
+  // could return and USBD task can preempt and clear the busy
+  p_dev->ep_status[epnum][dir].busy = 1;
+
+  usbd_xfer_split_t* split = &p_dev->ep_split[epnum][dir];
+  bool ret;
+
+  if (dcd_edpt_xfer_sg) {
+    split->active = 0;
+    ret = dcd_edpt_xfer_sg(rhport, ep_addr, sg_list, count);
+  } else {
+    // submit 1st part, the rest is continued by usbd task on each completion
+    split->buffer = sg_list[0].buffer;
+    split->remaining = sg_list[0].len;
+    split->sg_next = sg_list + 1;
+    split->sg_count = (uint8_t) (count - 1);
+    split->xferred = 0;
+    split->active = 1;
+    ret = xfer_split_submit(rhport, ep_addr, split);
+  }
+
+  if (ret) {
+    return true;
+  } else {
+    // DCD error, mark endpoint as ready to allow next transfer
+    split->active = 0;
+    p_dev->ep_status[epnum][dir].busy = 0;
+    p_dev->ep_status[epnum][dir].claimed = 0;
+    TU_LOG_USBD("FAILED\r\n");
+    TU_BREAKPOINT();
+    return false;
+  }
+}
+#endif
+
+#if CFG_TUD_EDPT_ISO_XFER
+bool usbd_edpt_iso_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, tu_iso_packet_t* packets, uint16_t count) {
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
+
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir = tu_edpt_dir(ep_addr);
+
+  TU_ASSERT(packets && count);
+  TU_LOG_USBD("  Queue ISO EP %02X with %u packets ...\r\n", ep_addr, count);
+
+  // Attempt to transfer on a busy endpoint, sound like an race condition !
+  TU_ASSERT(p_dev->ep_status[epnum][dir].busy == 0);
+
+  // Set busy first since the actual transfer can be complete before dcd_edpt_xfer()
+  // could return and USBD task can preempt and clear the busy
+  p_dev->ep_status[epnum][dir].busy = 1;
+
+  usbd_iso_xfer_t* iso = &p_dev->ep_iso[epnum][dir];
+  bool ret;
+
+  if (dcd_edpt_iso_xfer) {
+    iso->active = 0;
+    ret = dcd_edpt_iso_xfer(rhport, ep_addr, buffer, packets, count);
+  } else {
+    // submit 1st packet, the rest is continued by dcd_event_handler() on each completion
+    iso->packets = packets;
+    iso->buffer = buffer;
+    iso->xferred = 0;
+    iso->count = count;
+    iso->idx = 0;
+    iso->result = XFER_RESULT_SUCCESS;
+    iso->active = 1;
+    ret = dcd_edpt_xfer(rhport, ep_addr, buffer, packets[0].len);
+  }
+
+  if (ret) {
+    return true;
+  } else {
+    // DCD error, mark endpoint as ready to allow next transfer
+    iso->active = 0;
+    p_dev->ep_status[epnum][dir].busy = 0;
+    p_dev->ep_status[epnum][dir].claimed = 0;
+    TU_LOG_USBD("FAILED\r\n");
+    TU_BREAKPOINT();
+    return false;
+  }
+}
+#endif
+
+void usbd_edpt_instance_set(uint8_t rhport, uint8_t ep_addr, uint8_t instance) {
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  TU_ASSERT(epnum < CFG_TUD_ENDPPOINT_MAX,);
+  get_device(rhport)->ep2inst[epnum][tu_edpt_dir(ep_addr)] = instance;
+}
+
+uint8_t usbd_edpt_instance(uint8_t rhport, uint8_t ep_addr) {
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  TU_VERIFY(epnum < CFG_TUD_ENDPPOINT_MAX, TUSB_INDEX_INVALID_8);
+  return get_device(rhport)->ep2inst[epnum][tu_edpt_dir(ep_addr)];
+}
+
 bool usbd_edpt_busy(uint8_t rhport, uint8_t ep_addr) {
-  (void) rhport;
+  usbd_device_t* p_dev = get_device(rhport);
 
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
 
-  return _usbd_dev.ep_status[epnum][dir].busy;
+  return p_dev->ep_status[epnum][dir].busy;
 }
 
 void usbd_edpt_stall(uint8_t rhport, uint8_t ep_addr) {
-  rhport = _usbd_rhport;
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
 
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
@@ -1402,12 +3055,19 @@ void usbd_edpt_stall(uint8_t rhport, uint8_t ep_addr) {
   // only stalled if currently cleared
   TU_LOG_USBD("    Stall EP %02X\r\n", ep_addr);
   dcd_edpt_stall(rhport, ep_addr);
-  _usbd_dev.ep_status[epnum][dir].stalled = 1;
-  _usbd_dev.ep_status[epnum][dir].busy = 1;
+  xfer_queue_reset(p_dev, epnum, dir);
+#if CFG_TUD_EDPT_ISO_XFER
+  p_dev->ep_iso[epnum][dir].active = 0;
+#endif
+  p_dev->ep_status[epnum][dir].stalled = 1;
+  p_dev->ep_status[epnum][dir].busy = 1;
+  stats_edpt_stall(ep_addr);
 }
 
 void usbd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr) {
-  rhport = _usbd_rhport;
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
 
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
@@ -1415,17 +3075,18 @@ void usbd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr) {
   // only clear if currently stalled
   TU_LOG_USBD("    Clear Stall EP %02X\r\n", ep_addr);
   dcd_edpt_clear_stall(rhport, ep_addr);
-  _usbd_dev.ep_status[epnum][dir].stalled = 0;
-  _usbd_dev.ep_status[epnum][dir].busy = 0;
+  xfer_queue_reset(p_dev, epnum, dir);
+  p_dev->ep_status[epnum][dir].stalled = 0;
+  p_dev->ep_status[epnum][dir].busy = 0;
 }
 
 bool usbd_edpt_stalled(uint8_t rhport, uint8_t ep_addr) {
-  (void) rhport;
+  usbd_device_t* p_dev = get_device(rhport);
 
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
 
-  return _usbd_dev.ep_status[epnum][dir].stalled;
+  return p_dev->ep_status[epnum][dir].stalled;
 }
 
 /**
@@ -1437,7 +3098,9 @@ void usbd_edpt_close(uint8_t rhport, uint8_t ep_addr) {
   (void) rhport; (void) ep_addr;
   // ISO alloc/activate Should be used instead
 #else
-  rhport = _usbd_rhport;
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
 
   TU_LOG_USBD("  CLOSING Endpoint: 0x%02X\r\n", ep_addr);
 
@@ -1445,34 +3108,48 @@ void usbd_edpt_close(uint8_t rhport, uint8_t ep_addr) {
   uint8_t const dir = tu_edpt_dir(ep_addr);
 
   dcd_edpt_close(rhport, ep_addr);
-  _usbd_dev.ep_status[epnum][dir].stalled = 0;
-  _usbd_dev.ep_status[epnum][dir].busy = 0;
-  _usbd_dev.ep_status[epnum][dir].claimed = 0;
+  xfer_queue_reset(p_dev, epnum, dir);
+  p_dev->ep_status[epnum][dir].stalled = 0;
+  p_dev->ep_status[epnum][dir].busy = 0;
+  p_dev->ep_status[epnum][dir].claimed = 0;
+#if USBD_XFER_SPLIT
+  p_dev->ep_split[epnum][dir].active = 0;
+#endif
+#if CFG_TUD_EDPT_ISO_XFER
+  p_dev->ep_iso[epnum][dir].active = 0;
+#endif
 #endif
 
   return;
 }
 
 void usbd_sof_enable(uint8_t rhport, sof_consumer_t consumer, bool en) {
-  rhport = _usbd_rhport;
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
+
+  // consumers can be enabled/disabled from different tasks
+  osal_spin_lock(&_usbd_spin, false);
 
-  uint8_t consumer_old = _usbd_dev.sof_consumer;
+  uint8_t consumer_old = p_dev->sof_consumer;
   // Keep track how many class instances need the SOF interrupt
   if (en) {
-    _usbd_dev.sof_consumer |= (uint8_t)(1 << consumer);
+    p_dev->sof_consumer |= (uint8_t)(1 << consumer);
   } else {
-    _usbd_dev.sof_consumer &= (uint8_t)(~(1 << consumer));
+    p_dev->sof_consumer &= (uint8_t)(~(1 << consumer));
   }
 
   // Test logically unequal
-  if(!_usbd_dev.sof_consumer != !consumer_old) {
-    dcd_sof_enable(rhport, _usbd_dev.sof_consumer);
+  if(!p_dev->sof_consumer != !consumer_old) {
+    dcd_sof_enable(rhport, p_dev->sof_consumer);
   }
+
+  osal_spin_unlock(&_usbd_spin, false);
 }
 
 bool usbd_edpt_iso_alloc(uint8_t rhport, uint8_t ep_addr, uint16_t largest_packet_size) {
 #ifdef TUP_DCD_EDPT_ISO_ALLOC
-  rhport = _usbd_rhport;
+  rhport = _usbd_rhport[get_index(rhport)];
 
   TU_ASSERT(tu_edpt_number(ep_addr) < CFG_TUD_ENDPPOINT_MAX);
   return dcd_edpt_iso_alloc(rhport, ep_addr, largest_packet_size);
@@ -1484,17 +3161,21 @@ bool usbd_edpt_iso_alloc(uint8_t rhport, uint8_t ep_addr, uint16_t largest_packe
 
 bool usbd_edpt_iso_activate(uint8_t rhport, tusb_desc_endpoint_t const* desc_ep) {
 #ifdef TUP_DCD_EDPT_ISO_ALLOC
-  rhport = _usbd_rhport;
+  uint8_t const idx = get_index(rhport);
+  usbd_device_t* p_dev = &_usbd_dev[idx];
+  rhport = _usbd_rhport[idx];
 
   uint8_t const epnum = tu_edpt_number(desc_ep->bEndpointAddress);
   uint8_t const dir = tu_edpt_dir(desc_ep->bEndpointAddress);
 
   TU_ASSERT(epnum < CFG_TUD_ENDPPOINT_MAX);
-  TU_ASSERT(tu_edpt_validate(desc_ep, (tusb_speed_t) _usbd_dev.speed));
+  TU_ASSERT(tu_edpt_validate(desc_ep, (tusb_speed_t) p_dev->speed));
 
-  _usbd_dev.ep_status[epnum][dir].stalled = 0;
-  _usbd_dev.ep_status[epnum][dir].busy = 0;
-  _usbd_dev.ep_status[epnum][dir].claimed = 0;
+  p_dev->ep_status[epnum][dir].stalled = 0;
+  p_dev->ep_status[epnum][dir].busy = 0;
+  p_dev->ep_status[epnum][dir].claimed = 0;
+  edpt_mark_periodic(p_dev, desc_ep);
+  p_dev->ep_isr_cb[dir] &= (uint16_t) ~TU_BIT(epnum);
   return dcd_edpt_iso_activate(rhport, desc_ep);
 #else
   (void) rhport; (void) desc_ep;
@@ -58,6 +58,29 @@ bool tud_deinit(uint8_t rhport);
 // Check if device stack is already initialized
 bool tud_inited(void);
 
+// ConfigID for tud_configure()
+enum {
+  TUD_CFGID_INVALID = 0,
+  TUD_CFGID_INTR_THRESHOLD = 1, // cfg_param: uint8_t, see below
+  TUD_CFGID_DWC2 = 2,           // cfg_param: tud_configure_dwc2_t
+};
+
+typedef struct {
+  uint8_t ahb_burst;           // DMA burst GAHBCFG.HBSTLEN: 0 single, 1 INCR, 3 INCR4 (default), 5 INCR8, 7 INCR16
+  uint8_t iso_in_thr_en    : 1; // DTHRCTL: IN transfer of ISO endpoint starts once tx_thr_len is in TxFIFO
+  uint8_t noniso_in_thr_en : 1; // DTHRCTL: same for non-ISO IN endpoints
+  uint8_t rx_thr_en        : 1; // DTHRCTL: DMA drains RxFIFO once rx_thr_len is received
+  uint16_t tx_thr_len;          // IN threshold in 32-bit words (1-511)
+  uint16_t rx_thr_len;          // OUT threshold in 32-bit words (1-511)
+} tud_configure_dwc2_t;
+
+// Configure controller driver, can be called before or after tud_rhport_init()
+// - TUD_CFGID_INTR_THRESHOLD: batch completion interrupts over 1-64 micro-frames (0 = immediate) for throughput of
+//   bulk-heavy workloads, at the cost of control/interrupt latency. Supported by ChipIdea HS: 0,1,2,4,8,16,32,64
+// - TUD_CFGID_DWC2: AHB burst and DMA thresholds of DWC2 in DMA mode, must be called before tud_rhport_init()
+// Return false if cfg_id or its value is not supported by controller
+bool tud_configure(uint8_t rhport, uint32_t cfg_id, const void* cfg_param);
+
 // Task function should be called in main/rtos loop, extended version of tud_task()
 // - timeout_ms: millisecond to wait, zero = no wait, 0xFFFFFFFF = wait forever
 // - in_isr: if function is called in ISR
@@ -72,12 +95,22 @@ void tud_task (void) {
 // Check if there is pending events need processing by tud_task()
 bool tud_task_event_ready(void);
 
+// Number of events dropped since init because event queue is full. priority selects the priority queue
+// (CFG_TUD_TASK_PRIORITY_QUEUE_SZ) instead of the main queue
+uint32_t tud_task_event_dropped(bool priority);
+
 #ifndef TUSB_DCD_H_
 extern void dcd_int_handler(uint8_t rhport);
 #endif
 
+#if CFG_TUD_STATS
+// Interrupt handler, call DCD and measure ISR time
+void tud_stats_int_handler(uint8_t rhport);
+#define tud_int_handler   tud_stats_int_handler
+#else
 // Interrupt handler, name alias to DCD
 #define tud_int_handler   dcd_int_handler
+#endif
 
 // Get current bus speed
 tusb_speed_t tud_speed_get(void);
@@ -98,7 +131,8 @@ bool tud_ready(void) {
   return tud_mounted() && !tud_suspended();
 }
 
-// Remote wake up host, only if suspended and enabled by host
+// Remote wake up host, only if suspended and enabled by host. Afterwards class drivers such as HID accept data
+// while still suspended, it is sent with the first token once host resumes the bus
 bool tud_remote_wakeup(void);
 
 // Enable pull-up resistor on D+ D-
@@ -109,9 +143,52 @@ bool tud_disconnect(void);
 // Return false on unsupported MCUs
 bool tud_connect(void);
 
+// Switch to another configuration (personality) without tud_deinit()/tud_init(): disconnect from host, reset class
+// drivers and re-query usbd_app_driver_get_cb() for the new application driver set, while controller, OSAL and
+// buffers are kept. Device stays disconnected: application prepares its new descriptors then calls tud_connect(),
+// preferably a few ms later so that host notices the unplug. Must be called from the same task as tud_task()
+bool tud_reconfigure(void);
+
+// API of a specific controller when multiple controllers run a device stack (CFG_TUD_RHPORT_NUM > 1),
+// above ones refer to the first initialized controller
+tusb_speed_t tud_rhport_speed_get(uint8_t rhport);
+bool tud_rhport_connected(uint8_t rhport);
+bool tud_rhport_mounted(uint8_t rhport);
+bool tud_rhport_suspended(uint8_t rhport);
+bool tud_rhport_remote_wakeup(uint8_t rhport);
+bool tud_rhport_disconnect(uint8_t rhport);
+bool tud_rhport_connect(uint8_t rhport);
+bool tud_rhport_reconfigure(uint8_t rhport);
+
+TU_ATTR_ALWAYS_INLINE static inline
+bool tud_rhport_ready(uint8_t rhport) {
+  return tud_rhport_mounted(rhport) && !tud_rhport_suspended(rhport);
+}
+
+// Controller of the event being processed by tud_task(). Callbacks without rhport argument e.g descriptor, mount
+// and suspend callbacks can use it to tell controllers apart
+uint8_t tud_rhport_current(void);
+
 // Enable or disable the Start Of Frame callback support
 void tud_sof_cb_enable(bool en);
 
+// Invoke tud_sof_cb() only once every interval SOFs (frames on Full-Speed, microframes on High-Speed), default 1.
+// Usbd task is then woken up less often when application only needs a coarse timebase
+void tud_sof_cb_interval(uint16_t interval);
+
+// Time in ms until device stack needs CPU again for low power/tickless idle: 0 if there are events to process,
+// 1 if SOF interrupt is enabled (by tud_sof_cb_enable() or class drivers e.g audio), UINT32_MAX if only a new
+// USB interrupt can wake it up
+uint32_t tud_task_next_wakeup_ms(void);
+
+// Drop cached descriptors and interface bindings (CFG_TUD_DESC_CACHE), must be called when application changes
+// descriptors at runtime. Should be called while disconnected or from the same task as tud_task()
+void tud_descriptor_cache_invalidate(void);
+
+// Most bytes allocated at the same time from endpoint buffer pool (CFG_TUD_EPBUF_POOL_SIZE) since init,
+// helpful to size the pool for all configurations
+uint32_t tud_epbuf_pool_watermark(void);
+
 // Carry out Data and Status stage of control transfer
 // - If len = 0, it is equivalent to sending status only
 // - If len > wLength : it will be truncated
@@ -120,6 +197,43 @@ bool tud_control_xfer(uint8_t rhport, tusb_control_request_t const * request, vo
 // Send STATUS (zero length) packet
 bool tud_control_status(uint8_t rhport, tusb_control_request_t const * request);
 
+//--------------------------------------------------------------------+
+// Statistics (CFG_TUD_STATS)
+//--------------------------------------------------------------------+
+typedef struct {
+  uint32_t xfer_count;  // completed transfers
+  uint32_t xfer_bytes;  // actual transferred bytes
+  uint32_t error_count; // transfers completed with failed/timeout result
+  uint32_t stall_count; // stalled by device or transfer completed with stall result
+} tud_stats_edpt_t;
+
+typedef struct {
+  uint32_t event_count[2];   // events queued to main, priority queue
+  uint32_t event_dropped[2]; // events dropped since queue is full, same as tud_task_event_dropped()
+  uint16_t queue_hwm[2];     // most events waiting in main, priority queue
+  uint32_t isr_count;        // number of tud_int_handler() calls
+  uint32_t isr_time_total;   // sum of ISR time in tud_stats_timestamp_cb() unit
+  uint32_t isr_time_max;     // longest ISR time in tud_stats_timestamp_cb() unit
+  uint32_t isr_deferred;     // ISR work deferred to tud_task() by controller driver e.g CFG_TUD_DWC2_SLAVE_ISR_BUDGET
+  uint32_t init_time;        // tud_rhport_init() until first controller is ready (at least 1), 0 if not yet. Not cleared
+  uint32_t mount_time;       // tud_rhport_init() until first controller is mounted (at least 1), 0 if not yet. Not cleared
+} tud_stats_t;
+
+// Get snapshot of stack statistics. If clear is true, counters (except dropped events) are reset afterward
+bool tud_stats_get(tud_stats_t* stats, bool clear);
+
+// Get snapshot of endpoint statistics. If clear is true, its counters are reset afterward
+bool tud_stats_edpt_get(uint8_t ep_addr, tud_stats_edpt_t* stats, bool clear);
+
+// Layout of a function in configuration descriptor i.e interfaces and endpoints opened by one class driver
+typedef struct {
+  uint16_t offset;        // offset of function's first interface descriptor (after IAD if any) in configuration
+  uint16_t len;           // length of function's descriptors from first interface descriptor
+  uint8_t  itf_num;       // first interface number
+  uint8_t  itf_count;     // number of interfaces
+  uint16_t ep_bitmap[2];  // endpoint numbers used by function for each direction
+} tud_desc_function_t;
+
 //--------------------------------------------------------------------+
 // Application Callbacks
 //--------------------------------------------------------------------+
@@ -132,6 +246,16 @@ uint8_t const * tud_descriptor_device_cb(void);
 // Application return pointer to descriptor, whose contents must exist long enough for transfer to complete
 uint8_t const * tud_descriptor_configuration_cb(uint8_t index);
 
+// Invoked when received SET CONFIGURATION request, optional. Application return function layout of configuration
+// 'index' and its number in count e.g computed at compile time by device/usbd_desc.hpp. Drivers are then opened and
+// bound directly from the layout instead of parsing the configuration descriptor. Default returns NULL (parse it)
+tud_desc_function_t const* tud_descriptor_configuration_layout_cb(uint8_t index, uint8_t* count);
+
+// Invoked when received SET CONFIGURATION request, optional. Application return static packet memory layout of
+// configuration 'index' for the port (e.g tud::desc::dwc2_fifo_plan() of device/usbd_desc.hpp) and entry number in
+// count. DCD that supports it uses the layout instead of its runtime allocator. Default returns NULL
+tu_edpt_mem_t const* tud_edpt_mem_plan_cb(uint8_t rhport, uint8_t index, uint8_t* count);
+
 // Invoked when received GET STRING DESCRIPTOR request
 // Application return pointer to descriptor, whose contents must exist long enough for transfer to complete
 uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid);
@@ -164,6 +288,14 @@ void tud_suspend_cb(bool remote_wakeup_en);
 // Invoked when usb bus is resumed
 void tud_resume_cb(void);
 
+// Invoked when host puts the link into LPM L1 sleep (CFG_TUD_LPM). L1 exit takes only tens of microseconds:
+// - besl: Best Effort Service Latency (USB 2.0 LPM ECN) the host allows for resume, 0 = 125 us .. 15 = 10 ms
+// - remote_wakeup_en: device may wake up host with tud_remote_wakeup()
+void tud_lpm_sleep_cb(uint8_t besl, bool remote_wakeup_en);
+
+// Invoked when link exits LPM L1 sleep
+void tud_lpm_resume_cb(void);
+
 // Invoked when there is a new usb event, which need to be processed by tud_task()/tud_task_ext()
 void tud_event_hook_cb(uint8_t rhport, uint32_t eventid, bool in_isr);
 
@@ -173,6 +305,10 @@ void tud_sof_cb(uint32_t frame_count);
 // Invoked when received control request with VENDOR TYPE
 bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const * request);
 
+// Invoked by tud_int_handler() to measure ISR time when CFG_TUD_STATS is enabled, e.g return DWT->CYCCNT on Cortex-M.
+// Default returns 0 i.e only ISR count is recorded
+uint32_t tud_stats_timestamp_cb(void);
+
 //--------------------------------------------------------------------+
 // Binary Device Object Store (BOS) Descriptor Templates
 //--------------------------------------------------------------------+
@@ -187,6 +323,16 @@ bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_requ
 #define TUD_BOS_PLATFORM_DESCRIPTOR(...) \
   4+TU_ARGS_NUM(__VA_ARGS__), TUSB_DESC_DEVICE_CAPABILITY, DEVICE_CAPABILITY_PLATFORM, 0x00, __VA_ARGS__
 
+//------------- USB 2.0 Extension (LPM) -------------//
+
+// Descriptor Length
+#define TUD_BOS_USB20_EXT_DESC_LEN      7
+
+// LPM with BESL support, baseline and deep BESL recommended by device (0-15), see USB 2.0 LPM ECN
+#define TUD_BOS_USB20_EXT_DESCRIPTOR(_baseline_besl, _deep_besl) \
+  TUD_BOS_USB20_EXT_DESC_LEN, TUSB_DESC_DEVICE_CAPABILITY, DEVICE_CAPABILITY_USB20_EXTENSION, \
+  U32_TO_U8S_LE(0x1Eu | (((_baseline_besl) & 0xFu) << 8) | (((_deep_besl) & 0xFu) << 12))
+
 //------------- WebUSB BOS Platform -------------//
 
 // Descriptor Length
@@ -268,6 +414,29 @@ bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_requ
   /* Endpoint In */\
   7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
 
+// Length of template descriptor: 76 bytes
+#define TUD_MSC_UAS_DESC_LEN    (TUD_MSC_DESC_LEN + 9 + 4*(7 + 4))
+
+// Mass Storage with USB Attached SCSI as alternate 1 (requires CFG_TUD_MSC_UAS), alternate 0 is Bulk-Only Transport.
+// Interface number, string index, BOT EP Out & EP In address, UAS command (Out), status (In), data-in (In) and
+// data-out (Out) EP address, EP size
+#define TUD_MSC_UAS_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epcmd, _epstatus, _epdatain, _epdataout, _epsize) \
+  TUD_MSC_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epsize),\
+  /* Interface alternate 1: UAS */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 1, 4, TUSB_CLASS_MSC, MSC_SUBCLASS_SCSI, MSC_PROTOCOL_UAS, _stridx,\
+  /* Command pipe */\
+  7, TUSB_DESC_ENDPOINT, _epcmd, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  4, MSC_UAS_DESC_PIPE_USAGE, MSC_UAS_PIPE_COMMAND, 0,\
+  /* Status pipe */\
+  7, TUSB_DESC_ENDPOINT, _epstatus, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  4, MSC_UAS_DESC_PIPE_USAGE, MSC_UAS_PIPE_STATUS, 0,\
+  /* Data-in pipe */\
+  7, TUSB_DESC_ENDPOINT, _epdatain, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  4, MSC_UAS_DESC_PIPE_USAGE, MSC_UAS_PIPE_DATA_IN, 0,\
+  /* Data-out pipe */\
+  7, TUSB_DESC_ENDPOINT, _epdataout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  4, MSC_UAS_DESC_PIPE_USAGE, MSC_UAS_PIPE_DATA_OUT, 0
+
 
 //--------------------------------------------------------------------+
 // HID Descriptor Templates
@@ -363,6 +532,38 @@ bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_requ
   TUD_MIDI_DESC_EP(_epin, _epsize, 1),\
   TUD_MIDI_JACKID_OUT_EMB(1)
 
+// USB MIDI 2.0: alternate setting 1 of MIDI Streaming interface carries Universal MIDI Packets (UMP) on the same
+// endpoints as alternate setting 0 (MIDI 1.0), which is used by hosts without MIDI 2.0 support
+#define TUD_MIDI2_DESC_ALT1_LEN (9 + 7 + (7 + 5) * 2)
+#define TUD_MIDI2_DESC_ALT1(_itfnum, _epout, _epin, _epsize) \
+  /* MIDI Streaming (MS) Interface, alternate 1 */\
+  9, TUSB_DESC_INTERFACE, (uint8_t)((_itfnum) + 1), 1, 2, TUSB_CLASS_AUDIO, AUDIO_SUBCLASS_MIDI_STREAMING, AUDIO_FUNC_PROTOCOL_CODE_UNDEF, 0,\
+  /* MS Header 2.0 */\
+  7, TUSB_DESC_CS_INTERFACE, MIDI_CS_INTERFACE_HEADER, U16_TO_U8S_LE(0x0200), U16_TO_U8S_LE(7),\
+  /* Endpoint Out and MS Endpoint 2.0 associated with group terminal block 1 */\
+  7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  5, TUSB_DESC_CS_ENDPOINT, MIDI_CS_ENDPOINT_GENERAL_2_0, 1, 1,\
+  /* Endpoint In and MS Endpoint 2.0 associated with group terminal block 1 */\
+  7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  5, TUSB_DESC_CS_ENDPOINT, MIDI_CS_ENDPOINT_GENERAL_2_0, 1, 1
+
+// Length of template descriptor (132 bytes)
+#define TUD_MIDI2_DESC_LEN (TUD_MIDI_DESC_LEN + TUD_MIDI2_DESC_ALT1_LEN)
+
+// MIDI 2.0 simple descriptor: MIDI 1.0 simple descriptor as alternate 0 and UMP as alternate 1
+#define TUD_MIDI2_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epsize) \
+  TUD_MIDI_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epsize),\
+  TUD_MIDI2_DESC_ALT1(_itfnum, _epout, _epin, _epsize)
+
+// Group Terminal Block descriptors (returned by tud_midi_descriptor_gtb_cb()) with a single block of id 1
+#define TUD_MIDI2_DESC_GTB_LEN (5 + 13)
+#define TUD_MIDI2_DESC_GTB(_stridx, _first_group, _num_groups, _protocol) \
+  /* Group Terminal Block Header */\
+  5, MIDI_DESC_TYPE_CS_GR_TRM_BLOCK, MIDI_GR_TRM_BLOCK_HEADER, U16_TO_U8S_LE(TUD_MIDI2_DESC_GTB_LEN),\
+  /* Bidirectional Group Terminal Block, bandwidth unknown */\
+  13, MIDI_DESC_TYPE_CS_GR_TRM_BLOCK, MIDI_GR_TRM_BLOCK, 1, MIDI_GR_TRM_BLOCK_TYPE_BIDIRECTIONAL, _first_group, _num_groups,\
+  _stridx, _protocol, U16_TO_U8S_LE(0), U16_TO_U8S_LE(0)
+
 //--------------------------------------------------------------------+
 // Audio v2.0 Descriptor Templates
 //--------------------------------------------------------------------+
@@ -601,6 +802,11 @@ bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_requ
 #define TUD_AUDIO_EP_SIZE(_maxFrequency, _nBytesPerSample, _nChannels) \
     ((((_maxFrequency + (TUD_OPT_HIGH_SPEED ? 7999 : 999)) / (TUD_OPT_HIGH_SPEED ? 8000 : 1000)) + 1) * _nBytesPerSample * _nChannels)
 
+// wMaxPacketSize of highspeed high-bandwidth endpoint carrying up to 3072 bytes per micro-frame e.g from
+// TUD_AUDIO_EP_SIZE(): bytes are split into 1-3 equal transactions, additional transactions are in bits 12..11
+#define TUD_AUDIO_EP_SIZE_HB(_size) \
+    (TU_DIV_CEIL(_size, TU_DIV_CEIL(_size, 1024)) | ((TU_DIV_CEIL(_size, 1024) - 1) << 11))
+
 
 //--------------------------------------------------------------------+
 // USBTMC/USB488 Descriptor Templates
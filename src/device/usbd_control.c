@@ -44,6 +44,14 @@ TU_ATTR_WEAK void dcd_edpt0_status_complete(uint8_t rhport, const tusb_control_r
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
 
+// Transfer data stage directly from/to application buffer with a single multi-packet transfer instead of copying
+// packet by packet through the internal EP0 buffer. Only used for word-aligned buffer without dcache. Requires DCD that
+// supports multi-packet transfer on EP0 (e.g dwc2), and (DMA) controller must be able to access application buffer
+// e.g descriptors that are placed in flash.
+#ifndef CFG_TUD_CONTROL_XFER_DIRECT
+  #define CFG_TUD_CONTROL_XFER_DIRECT   0
+#endif
+
 enum {
   EDPT_CTRL_OUT = 0x00,
   EDPT_CTRL_IN = 0x80
@@ -54,14 +62,26 @@ typedef struct {
   uint8_t* buffer;
   uint16_t data_len;
   uint16_t total_xferred;
+  uint16_t xact_len; // length of on-going data stage transaction
+  bool direct;       // on-going transaction uses application buffer
   usbd_control_xfer_cb_t complete_cb;
 } usbd_control_xfer_t;
 
-static usbd_control_xfer_t _ctrl_xfer;
+// one control pipe for each device stack
+static usbd_control_xfer_t _ctrl_xfer[CFG_TUD_RHPORT_NUM];
 
 CFG_TUD_MEM_SECTION static struct {
   TUD_EPBUF_DEF(buf, CFG_TUD_ENDPOINT0_SIZE);
-} _ctrl_epbuf;
+} _ctrl_epbuf[CFG_TUD_RHPORT_NUM];
+
+TU_ATTR_ALWAYS_INLINE static inline uint8_t ctrl_index(uint8_t rhport) {
+#if CFG_TUD_RHPORT_NUM > 1
+  return usbd_rhport_index(rhport);
+#else
+  (void) rhport;
+  return 0;
+#endif
+}
 
 //--------------------------------------------------------------------+
 // Application API
@@ -76,41 +96,55 @@ static inline bool status_stage_xact(uint8_t rhport, const tusb_control_request_
 
 // Status phase
 bool tud_control_status(uint8_t rhport, const tusb_control_request_t* request) {
-  _ctrl_xfer.request = (*request);
-  _ctrl_xfer.buffer = NULL;
-  _ctrl_xfer.total_xferred = 0;
-  _ctrl_xfer.data_len = 0;
+  usbd_control_xfer_t* p_ctrl = &_ctrl_xfer[ctrl_index(rhport)];
+  p_ctrl->request = (*request);
+  p_ctrl->buffer = NULL;
+  p_ctrl->total_xferred = 0;
+  p_ctrl->data_len = 0;
 
   return status_stage_xact(rhport, request);
 }
 
 // Queue a transaction in Data Stage
-// Each transaction has up to Endpoint0's max packet size.
+// Each transaction has up to Endpoint0's max packet size, or all remaining data if transferred directly.
 // This function can also transfer an zero-length packet
 static bool data_stage_xact(uint8_t rhport) {
-  const uint16_t xact_len = tu_min16(_ctrl_xfer.data_len - _ctrl_xfer.total_xferred, CFG_TUD_ENDPOINT0_SIZE);
-  uint8_t ep_addr = EDPT_CTRL_OUT;
+  uint8_t const idx = ctrl_index(rhport);
+  usbd_control_xfer_t* p_ctrl = &_ctrl_xfer[idx];
+  const uint16_t remaining = (uint16_t) (p_ctrl->data_len - p_ctrl->total_xferred);
+  const uint8_t ep_addr =
+    (p_ctrl->request.bmRequestType_bit.direction == TUSB_DIR_IN) ? EDPT_CTRL_IN : EDPT_CTRL_OUT;
+
+  #if CFG_TUD_CONTROL_XFER_DIRECT
+  if (remaining && !CFG_TUD_MEM_DCACHE_ENABLE && (0 == (((uintptr_t) p_ctrl->buffer) & 3u))) {
+    p_ctrl->xact_len = remaining;
+    p_ctrl->direct = true;
+    return usbd_edpt_xfer(rhport, ep_addr, p_ctrl->buffer, remaining);
+  }
+  #endif
 
-  if (_ctrl_xfer.request.bmRequestType_bit.direction == TUSB_DIR_IN) {
-    ep_addr = EDPT_CTRL_IN;
-    if (xact_len) {
-      TU_VERIFY(0 == tu_memcpy_s(_ctrl_epbuf.buf, CFG_TUD_ENDPOINT0_SIZE, _ctrl_xfer.buffer, xact_len));
-    }
+  const uint16_t xact_len = tu_min16(remaining, CFG_TUD_ENDPOINT0_SIZE);
+  p_ctrl->xact_len = xact_len;
+  p_ctrl->direct = false;
+
+  if (ep_addr == EDPT_CTRL_IN && xact_len) {
+    TU_VERIFY(0 == tu_memcpy_s(_ctrl_epbuf[idx].buf, CFG_TUD_ENDPOINT0_SIZE, p_ctrl->buffer, xact_len));
   }
 
-  return usbd_edpt_xfer(rhport, ep_addr, xact_len ? _ctrl_epbuf.buf : NULL, xact_len);
+  return usbd_edpt_xfer(rhport, ep_addr, xact_len ? _ctrl_epbuf[idx].buf : NULL, xact_len);
 }
 
 // Transmit data to/from the control endpoint.
 // If the request's wLength is zero, a status packet is sent instead.
 bool tud_control_xfer(uint8_t rhport, const tusb_control_request_t* request, void* buffer, uint16_t len) {
-  _ctrl_xfer.request = (*request);
-  _ctrl_xfer.buffer = (uint8_t*) buffer;
-  _ctrl_xfer.total_xferred = 0U;
-  _ctrl_xfer.data_len = tu_min16(len, request->wLength);
+  usbd_control_xfer_t* p_ctrl = &_ctrl_xfer[ctrl_index(rhport)];
+  p_ctrl->request = (*request);
+  p_ctrl->buffer = (uint8_t*) buffer;
+  p_ctrl->total_xferred = 0U;
+  p_ctrl->data_len = tu_min16(len, request->wLength);
 
   if (request->wLength > 0U) {
-    if (_ctrl_xfer.data_len > 0U) {
+    if (p_ctrl->data_len > 0U) {
       TU_ASSERT(buffer);
     }
     TU_ASSERT(data_stage_xact(rhport));
@@ -124,26 +158,27 @@ bool tud_control_xfer(uint8_t rhport, const tusb_control_request_t* request, voi
 //--------------------------------------------------------------------+
 // USBD API
 //--------------------------------------------------------------------+
-void usbd_control_reset(void);
-void usbd_control_set_request(const tusb_control_request_t* request);
-void usbd_control_set_complete_callback(usbd_control_xfer_cb_t fp);
+void usbd_control_reset(uint8_t rhport);
+void usbd_control_set_request(uint8_t rhport, const tusb_control_request_t* request);
+void usbd_control_set_complete_callback(uint8_t rhport, usbd_control_xfer_cb_t fp);
 bool usbd_control_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
 
-void usbd_control_reset(void) {
-  tu_varclr(&_ctrl_xfer);
+void usbd_control_reset(uint8_t rhport) {
+  tu_varclr(&_ctrl_xfer[ctrl_index(rhport)]);
 }
 
 // Set complete callback
-void usbd_control_set_complete_callback(usbd_control_xfer_cb_t fp) {
-  _ctrl_xfer.complete_cb = fp;
+void usbd_control_set_complete_callback(uint8_t rhport, usbd_control_xfer_cb_t fp) {
+  _ctrl_xfer[ctrl_index(rhport)].complete_cb = fp;
 }
 
 // for dcd_set_address where DCD is responsible for status response
-void usbd_control_set_request(const tusb_control_request_t* request) {
-  _ctrl_xfer.request = (*request);
-  _ctrl_xfer.buffer = NULL;
-  _ctrl_xfer.total_xferred = 0;
-  _ctrl_xfer.data_len = 0;
+void usbd_control_set_request(uint8_t rhport, const tusb_control_request_t* request) {
+  usbd_control_xfer_t* p_ctrl = &_ctrl_xfer[ctrl_index(rhport)];
+  p_ctrl->request = (*request);
+  p_ctrl->buffer = NULL;
+  p_ctrl->total_xferred = 0;
+  p_ctrl->data_len = 0;
 }
 
 // callback when a transaction complete on
@@ -151,50 +186,62 @@ void usbd_control_set_request(const tusb_control_request_t* request) {
 // - Status stage
 bool usbd_control_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes) {
   (void) result;
+  uint8_t const idx = ctrl_index(rhport);
+  usbd_control_xfer_t* p_ctrl = &_ctrl_xfer[idx];
 
   // Endpoint Address is opposite to direction bit, this is Status Stage complete event
-  if (tu_edpt_dir(ep_addr) != _ctrl_xfer.request.bmRequestType_bit.direction) {
+  if (tu_edpt_dir(ep_addr) != p_ctrl->request.bmRequestType_bit.direction) {
     TU_ASSERT(0 == xferred_bytes);
 
     // invoke optional dcd hook if available
-    dcd_edpt0_status_complete(rhport, &_ctrl_xfer.request);
+    dcd_edpt0_status_complete(rhport, &p_ctrl->request);
 
-    if (_ctrl_xfer.complete_cb) {
+    if (p_ctrl->complete_cb) {
       // TODO refactor with usbd_driver_print_control_complete_name
-      _ctrl_xfer.complete_cb(rhport, CONTROL_STAGE_ACK, &_ctrl_xfer.request);
+      TU_TRACE(TU_TRACE_CTRL_ENTER, CONTROL_STAGE_ACK, p_ctrl->request.wIndex,
+               (p_ctrl->request.bmRequestType << 8) | p_ctrl->request.bRequest);
+      p_ctrl->complete_cb(rhport, CONTROL_STAGE_ACK, &p_ctrl->request);
+      TU_TRACE(TU_TRACE_CTRL_EXIT, CONTROL_STAGE_ACK, p_ctrl->request.wIndex, 1);
     }
 
     return true;
   }
 
-  if (_ctrl_xfer.request.bmRequestType_bit.direction == TUSB_DIR_OUT) {
-    TU_VERIFY(_ctrl_xfer.buffer);
-    memcpy(_ctrl_xfer.buffer, _ctrl_epbuf.buf, xferred_bytes);
-    TU_LOG_MEM(CFG_TUD_LOG_LEVEL, _ctrl_xfer.buffer, xferred_bytes, 2);
+  if (p_ctrl->request.bmRequestType_bit.direction == TUSB_DIR_OUT) {
+    TU_VERIFY(p_ctrl->buffer);
+    if (!p_ctrl->direct) {
+      memcpy(p_ctrl->buffer, _ctrl_epbuf[idx].buf, xferred_bytes);
+    }
+    TU_LOG_MEM(CFG_TUD_LOG_LEVEL, p_ctrl->buffer, xferred_bytes, 2);
   }
 
-  _ctrl_xfer.total_xferred += (uint16_t) xferred_bytes;
-  _ctrl_xfer.buffer += xferred_bytes;
+  p_ctrl->total_xferred += (uint16_t) xferred_bytes;
+  p_ctrl->buffer += xferred_bytes;
 
   // Data Stage is complete when all request's length are transferred or
-  // a short packet is sent including zero-length packet.
-  if ((_ctrl_xfer.request.wLength == _ctrl_xfer.total_xferred) ||
-      (xferred_bytes < CFG_TUD_ENDPOINT0_SIZE)) {
+  // a short packet is sent including zero-length packet. With a multi-packet transaction, short packet is either
+  // received before its end or is its last packet.
+  if ((p_ctrl->request.wLength == p_ctrl->total_xferred) ||
+      (xferred_bytes < p_ctrl->xact_len) ||
+      (p_ctrl->xact_len % CFG_TUD_ENDPOINT0_SIZE) || (0 == p_ctrl->xact_len)) {
     // DATA stage is complete
     bool is_ok = true;
 
     // invoke complete callback if set
     // callback can still stall control in status phase e.g out data does not make sense
-    if (_ctrl_xfer.complete_cb) {
+    if (p_ctrl->complete_cb) {
       #if CFG_TUSB_DEBUG >= CFG_TUD_LOG_LEVEL
-      usbd_driver_print_control_complete_name(_ctrl_xfer.complete_cb);
+      usbd_driver_print_control_complete_name(p_ctrl->complete_cb);
       #endif
 
-      is_ok = _ctrl_xfer.complete_cb(rhport, CONTROL_STAGE_DATA, &_ctrl_xfer.request);
+      TU_TRACE(TU_TRACE_CTRL_ENTER, CONTROL_STAGE_DATA, p_ctrl->request.wIndex,
+               (p_ctrl->request.bmRequestType << 8) | p_ctrl->request.bRequest);
+      is_ok = p_ctrl->complete_cb(rhport, CONTROL_STAGE_DATA, &p_ctrl->request);
+      TU_TRACE(TU_TRACE_CTRL_EXIT, CONTROL_STAGE_DATA, p_ctrl->request.wIndex, is_ok);
     }
 
     if (is_ok) {
-      TU_ASSERT(status_stage_xact(rhport, &_ctrl_xfer.request));
+      TU_ASSERT(status_stage_xact(rhport, &p_ctrl->request));
     } else {
       // Stall both IN and OUT control endpoint
       dcd_edpt_stall(rhport, EDPT_CTRL_OUT);
@@ -0,0 +1,449 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_USBD_DESC_HPP_
+#define _TUSB_USBD_DESC_HPP_
+
+// Optional C++17 helper to build configuration descriptor at compile time from the TUD_*_DESCRIPTOR() templates.
+// Total length and number of interfaces are computed, endpoints are validated with static_assert, and the function
+// layout for tud_descriptor_configuration_layout_cb() is generated so that usbd does not parse the descriptor.
+//
+//   constexpr auto desc_cfg = tud::desc::configuration(1, 0, 0x00, 100,
+//       tud::desc::function(TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 4, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64)),
+//       tud::desc::function(TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, 5, EPNUM_MSC_OUT, EPNUM_MSC_IN, 64)));
+//   static_assert(tud::desc::check(desc_cfg, false) == tud::desc::result::ok, "invalid configuration descriptor");
+//
+//   uint8_t const* tud_descriptor_configuration_cb(uint8_t index) { (void) index; return desc_cfg.desc; }
+//   tud_desc_function_t const* tud_descriptor_configuration_layout_cb(uint8_t index, uint8_t* count) {
+//     (void) index; *count = desc_cfg.func_count; return desc_cfg.func;
+//   }
+//
+// Each function() must contain the descriptors of exactly one class driver, i.e what its open() claims.
+//
+// Static endpoint memory layout of the port can be planned as well and returned by tud_edpt_mem_plan_cb():
+//   constexpr auto mem_plan = tud::desc::pma_plan(desc_cfg, 1024);
+//   static_assert(mem_plan.fits, "endpoints do not fit in PMA");
+
+#if !defined(__cplusplus) || __cplusplus < 201703L
+  #error "usbd_desc.hpp requires C++17"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tusb.h"
+
+namespace tud::desc {
+
+// Descriptors of a function (optional IAD, interfaces and their endpoints) opened by one class driver
+template <size_t N>
+struct function_t {
+  uint8_t data[N] {};
+};
+
+// Configuration descriptor and its function layout
+template <size_t Len, size_t FuncCount>
+struct config_t {
+  uint8_t desc[Len] {};
+  tud_desc_function_t func[FuncCount] {};
+
+  static constexpr uint16_t total_len = (uint16_t) Len;
+  static constexpr uint8_t func_count = (uint8_t) FuncCount;
+};
+
+enum class result {
+  ok,
+  bad_length,           // descriptor length is 0 or beyond configuration
+  bad_interface_number, // interface number >= CFG_TUD_INTERFACE_MAX or shared by functions
+  bad_endpoint_number,  // endpoint 0 or >= CFG_TUD_ENDPPOINT_MAX
+  bad_packet_size,      // wMaxPacketSize not allowed for transfer type and speed
+  duplicated_endpoint,  // endpoint used by more than one interface
+};
+
+// Make a function from bytes of TUD_*_DESCRIPTOR(), e.g function(TUD_HID_DESCRIPTOR(...))
+template <typename... T>
+constexpr auto function(T... bytes) {
+  function_t<sizeof...(T)> f;
+  size_t i = 0;
+  ((f.data[i++] = static_cast<uint8_t>(bytes)), ...);
+  return f;
+}
+
+namespace detail {
+
+// copy function to configuration at offset and compute its layout
+template <size_t Len, size_t F, size_t N>
+constexpr void append(config_t<Len, F>& cfg, size_t& offset, size_t index, function_t<N> const& f) {
+  tud_desc_function_t& func = cfg.func[index];
+  size_t first_itf = N;
+
+  for (size_t i = 0; i < N; i++) {
+    cfg.desc[offset + i] = f.data[i];
+  }
+
+  for (size_t i = 0; i + 1 < N && f.data[i] != 0; i += f.data[i]) {
+    uint8_t const* d = &f.data[i];
+    if (d[1] == TUSB_DESC_INTERFACE) {
+      if (first_itf == N) {
+        first_itf = i;
+        func.itf_num = d[2];
+      }
+      if (d[3] == 0) {
+        func.itf_count++; // count alternate setting 0 only
+      }
+    } else if (d[1] == TUSB_DESC_ENDPOINT) {
+      func.ep_bitmap[(d[2] & TUSB_DIR_IN_MASK) ? 1 : 0] |= (uint16_t) (1u << (d[2] & 0x0f));
+    }
+  }
+
+  func.offset = (uint16_t) (offset + first_itf);
+  func.len = (uint16_t) (N - first_itf);
+  offset += N;
+}
+
+constexpr bool packet_size_valid(uint8_t xfer, uint16_t w_max_packet_size, bool high_speed) {
+  uint16_t const size = w_max_packet_size & 0x7ff;
+  if (((w_max_packet_size >> 11) & 0x03) == 3) {
+    return false; // reserved number of transactions per micro-frame
+  }
+
+  switch (xfer) {
+    case TUSB_XFER_ISOCHRONOUS: return size <= (high_speed ? 1024 : 1023);
+    case TUSB_XFER_BULK:        return high_speed ? (size == 512) : (size == 8 || size == 16 || size == 32 || size == 64);
+    case TUSB_XFER_INTERRUPT:   return size <= (high_speed ? 1024 : 64);
+    default:                    return false;
+  }
+}
+
+} // namespace detail
+
+// Build configuration descriptor from functions, wTotalLength and bNumInterfaces are computed
+template <size_t... N>
+constexpr auto configuration(uint8_t config_num, uint8_t stridx, uint8_t attribute, uint16_t power_ma,
+                             function_t<N> const&... funcs) {
+  constexpr size_t len = TUD_CONFIG_DESC_LEN + (N + ... + 0);
+  static_assert(sizeof...(N) > 0, "configuration requires at least one function");
+  static_assert(len <= UINT16_MAX, "configuration descriptor is too long");
+
+  config_t<len, sizeof...(N)> cfg;
+  size_t offset = TUD_CONFIG_DESC_LEN;
+  size_t index = 0;
+  (detail::append(cfg, offset, index++, funcs), ...);
+
+  uint8_t itf_count = 0;
+  for (size_t i = 0; i < sizeof...(N); i++) {
+    uint8_t const end = (uint8_t) (cfg.func[i].itf_num + cfg.func[i].itf_count);
+    itf_count = (end > itf_count) ? end : itf_count;
+  }
+
+  auto const header = function(TUD_CONFIG_DESCRIPTOR(config_num, itf_count, stridx, len, attribute, power_ma));
+  for (size_t i = 0; i < TUD_CONFIG_DESC_LEN; i++) {
+    cfg.desc[i] = header.data[i];
+  }
+
+  return cfg;
+}
+
+// Validate configuration for full speed or highspeed, use with static_assert()
+template <size_t Len, size_t F>
+constexpr result check(config_t<Len, F> const& cfg, bool high_speed) {
+  // interface numbers of functions must not overlap
+  uint32_t itf_used = 0;
+  for (size_t i = 0; i < F; i++) {
+    for (uint8_t n = 0; n < cfg.func[i].itf_count; n++) {
+      uint8_t const itf_num = (uint8_t) (cfg.func[i].itf_num + n);
+      if (itf_num >= CFG_TUD_INTERFACE_MAX || itf_num >= 32 || (itf_used & (1ul << itf_num))) {
+        return result::bad_interface_number;
+      }
+      itf_used |= 1ul << itf_num;
+    }
+  }
+
+  // interface owning each endpoint, alternate settings of the same interface can share endpoint
+  uint8_t ep_owner[2][16] {};
+  for (auto& dir : ep_owner) {
+    for (auto& owner : dir) {
+      owner = 0xff;
+    }
+  }
+
+  uint8_t itf_num = 0xff;
+  for (size_t i = 0; i < Len;) {
+    uint8_t const* d = &cfg.desc[i];
+    if (d[0] < 2 || i + d[0] > Len) {
+      return result::bad_length;
+    }
+
+    if (d[1] == TUSB_DESC_INTERFACE) {
+      itf_num = d[2];
+    } else if (d[1] == TUSB_DESC_ENDPOINT) {
+      uint8_t const epnum = d[2] & 0x0f;
+      uint8_t const dir = (d[2] & TUSB_DIR_IN_MASK) ? 1 : 0;
+      if (epnum == 0 || epnum >= CFG_TUD_ENDPPOINT_MAX) {
+        return result::bad_endpoint_number;
+      }
+      if (!detail::packet_size_valid(d[3] & 0x03, (uint16_t) (d[4] | (d[5] << 8)), high_speed)) {
+        return result::bad_packet_size;
+      }
+      if (ep_owner[dir][epnum] != 0xff && ep_owner[dir][epnum] != itf_num) {
+        return result::duplicated_endpoint;
+      }
+      ep_owner[dir][epnum] = itf_num;
+    }
+
+    i += d[0];
+  }
+
+  return result::ok;
+}
+
+//--------------------------------------------------------------------+
+// Endpoint Memory Planner
+// Static layout of endpoint packet memory for tud_edpt_mem_plan_cb(), computed for all endpoints of a configuration
+// with the largest packet of each endpoint across alternate settings. Bulk endpoints are double buffered where it
+// fits, lower endpoint number first. Use static_assert(plan.fits) to catch a configuration that does not fit.
+//--------------------------------------------------------------------+
+
+struct mem_plan_t {
+  tu_edpt_mem_t mem[2 * 16 + 1] {};
+  uint8_t count = 0;
+  bool fits = false;
+  uint32_t used = 0; // bytes of packet memory used by the layout
+};
+
+namespace detail {
+
+struct edpt_info_t {
+  uint8_t addr;
+  uint8_t xfer;
+  uint16_t size; // largest packet size
+  uint8_t mult;  // largest number of transactions per micro-frame
+};
+
+struct edpt_list_t {
+  edpt_info_t ep[2 * 16] {};
+  uint8_t count = 0;
+};
+
+// non-control endpoints of configuration sorted by number then direction (OUT first)
+template <size_t Len, size_t F>
+constexpr edpt_list_t edpt_list(config_t<Len, F> const& cfg) {
+  edpt_list_t list;
+  for (size_t i = 0; i + 1 < Len && cfg.desc[i] != 0; i += cfg.desc[i]) {
+    uint8_t const* d = &cfg.desc[i];
+    if (d[1] != TUSB_DESC_ENDPOINT || (d[2] & 0x0f) == 0) {
+      continue;
+    }
+
+    uint16_t const w_max = (uint16_t) (d[4] | (d[5] << 8));
+    uint16_t const size = w_max & 0x7ff;
+    uint8_t const mult = (uint8_t) (((d[3] & 0x03) == TUSB_XFER_BULK) ? 1 : (1 + ((w_max >> 11) & 0x03)));
+
+    uint8_t n = 0;
+    while (n < list.count && list.ep[n].addr != d[2]) {
+      n++;
+    }
+    if (n == list.count) {
+      list.ep[list.count++] = edpt_info_t { d[2], (uint8_t) (d[3] & 0x03), size, mult };
+    } else {
+      list.ep[n].size = (size > list.ep[n].size) ? size : list.ep[n].size;
+      list.ep[n].mult = (mult > list.ep[n].mult) ? mult : list.ep[n].mult;
+    }
+  }
+
+  auto const key = [](uint8_t addr) { return (uint8_t) (((addr & 0x0f) << 1) | (addr >> 7)); };
+  for (uint8_t i = 1; i < list.count; i++) {
+    for (uint8_t j = i; j > 0 && key(list.ep[j].addr) < key(list.ep[j - 1].addr); j--) {
+      edpt_info_t const tmp = list.ep[j];
+      list.ep[j] = list.ep[j - 1];
+      list.ep[j - 1] = tmp;
+    }
+  }
+
+  return list;
+}
+
+constexpr uint32_t round_up(uint32_t v, uint32_t f) {
+  return ((v + f - 1) / f) * f;
+}
+
+// fsdev buffer size: 2-byte blocks up to 62 bytes, 32-byte blocks above
+constexpr uint16_t pma_align(uint16_t size) {
+  return (uint16_t) ((size > 62) ? round_up(size, 32) : round_up(size, 2));
+}
+
+// fsdev hardware endpoint registers: exclusive endpoint (ISO or double buffered) uses one on its own, other
+// endpoints share one with the opposite direction of the same number and type
+constexpr uint8_t pma_register_count(edpt_list_t const& list, bool const dbuf[]) {
+  uint8_t count = 1; // EP0
+  for (uint8_t i = 0; i < list.count; i++) {
+    edpt_info_t const& ep = list.ep[i];
+    bool const exclusive = dbuf[i] || ep.xfer == TUSB_XFER_ISOCHRONOUS;
+    bool paired = false;
+    if (!exclusive && (ep.addr & TUSB_DIR_IN_MASK) && i > 0) {
+      edpt_info_t const& prev = list.ep[i - 1]; // OUT of same number is sorted right before IN
+      paired = ((prev.addr & 0x0f) == (ep.addr & 0x0f)) && prev.xfer == ep.xfer && !dbuf[i - 1];
+    }
+    if (!paired) {
+      count++;
+    }
+  }
+  return count;
+}
+
+} // namespace detail
+
+// Raspberry Pi RP2040/RP2350: 64-byte blocks of USB buffer space after EP0, bulk endpoints are always double buffered
+template <size_t Len, size_t F>
+constexpr mem_plan_t dpram_plan(config_t<Len, F> const& cfg, uint32_t dpram_size = 3712) {
+  mem_plan_t plan;
+  auto const list = detail::edpt_list(cfg);
+  uint32_t offset = 0;
+
+  for (uint8_t i = 0; i < list.count; i++) {
+    bool const dbuf = (list.ep[i].xfer == TUSB_XFER_BULK);
+    uint32_t const size = detail::round_up(list.ep[i].size, 64) * (dbuf ? 2 : 1);
+    plan.mem[plan.count++] = tu_edpt_mem_t { list.ep[i].addr, (uint8_t) dbuf, (uint16_t) offset, (uint16_t) size };
+    offset += size;
+  }
+
+  plan.used = offset;
+  plan.fits = (offset <= dpram_size);
+  return plan;
+}
+
+// STM32 fsdev (and compatible): btable and EP0 buffers come first. ISO endpoints use 2 buffers if PMA is larger than
+// 1024 bytes, bulk endpoints are double buffered if PMA and hardware endpoint registers allow.
+template <size_t Len, size_t F>
+constexpr mem_plan_t pma_plan(config_t<Len, F> const& cfg, uint16_t pma_size, bool double_buffer = true,
+                              uint8_t ep_count = 8) {
+  mem_plan_t plan;
+  auto const list = detail::edpt_list(cfg);
+  uint32_t const base = 8u * ep_count + 2u * detail::pma_align(CFG_TUD_ENDPOINT0_SIZE);
+
+  bool dbuf[2 * 16] {};
+  uint32_t used = base;
+  for (uint8_t i = 0; i < list.count; i++) {
+    dbuf[i] = (list.ep[i].xfer == TUSB_XFER_ISOCHRONOUS) && pma_size > 1024;
+    used += detail::pma_align(list.ep[i].size) * (dbuf[i] ? 2u : 1u);
+  }
+  plan.fits = (used <= pma_size) && (detail::pma_register_count(list, dbuf) <= ep_count);
+
+  for (uint8_t i = 0; plan.fits && double_buffer && i < list.count; i++) {
+    if (list.ep[i].xfer == TUSB_XFER_BULK && used + detail::pma_align(list.ep[i].size) <= pma_size) {
+      dbuf[i] = true;
+      if (detail::pma_register_count(list, dbuf) <= ep_count) {
+        used += detail::pma_align(list.ep[i].size);
+      } else {
+        dbuf[i] = false;
+      }
+    }
+  }
+
+  uint32_t offset = base;
+  for (uint8_t i = 0; i < list.count; i++) {
+    uint32_t const size = detail::pma_align(list.ep[i].size) * (dbuf[i] ? 2u : 1u);
+    plan.mem[plan.count++] = tu_edpt_mem_t { list.ep[i].addr, (uint8_t) dbuf[i], (uint16_t) offset, (uint16_t) size };
+    offset += size;
+  }
+
+  plan.used = used;
+  return plan;
+}
+
+// Synopsys DWC2: shared RX FIFO (entry 0x00) and a TX FIFO per IN endpoint, in bytes. epinfo_words is the FIFO used
+// by DMA per endpoint (0 for slave, 2 for buffer DMA, 8 for scatter/gather DMA), ep_in_count is the limit of
+// concurrently active IN endpoints (0 if unlimited). Bulk IN gets 2 packets if space allows.
+template <size_t Len, size_t F>
+constexpr mem_plan_t dwc2_fifo_plan(config_t<Len, F> const& cfg, uint32_t fifo_size, uint8_t ep_count,
+                                    uint8_t epinfo_words = 0, uint8_t ep_in_count = 0) {
+  mem_plan_t plan;
+  auto const list = detail::edpt_list(cfg);
+
+  // words below EP0 TX FIFO and DMA EPInfo which are placed at the top by dcd
+  uint32_t const top = fifo_size / 4 - (uint32_t) epinfo_words * ep_count - (CFG_TUD_ENDPOINT0_SIZE + 3) / 4;
+
+  uint32_t rx_largest = CFG_TUD_ENDPOINT0_SIZE;
+  uint32_t rx_hb = 0;
+  uint32_t tx_size[16] {};
+  uint32_t tx_total = 0;
+  uint8_t in_count = 1; // EP0
+
+  for (uint8_t i = 0; i < list.count; i++) {
+    detail::edpt_info_t const& ep = list.ep[i];
+    if ((ep.addr & 0x0f) >= ep_count) {
+      return plan; // does not fit
+    }
+    if (ep.addr & TUSB_DIR_IN_MASK) {
+      tx_size[ep.addr & 0x0f] = ep.mult * ((ep.size + 3) / 4u);
+      tx_total += tx_size[ep.addr & 0x0f];
+      in_count++;
+    } else {
+      rx_largest = (ep.size > rx_largest) ? ep.size : rx_largest;
+      if (ep.mult > 1) {
+        uint32_t const hb = ep.mult * (ep.size / 4u + 1);
+        rx_hb = (hb > rx_hb) ? hb : rx_hb;
+      }
+    }
+  }
+
+  uint32_t rx_size = 13 + 1 + 2 * (rx_largest / 4 + 1) + 2u * ep_count;
+  rx_size = (13 + 1 + rx_hb + 2u * ep_count > rx_size) ? (13 + 1 + rx_hb + 2u * ep_count) : rx_size;
+
+  plan.fits = (rx_size + tx_total <= top) && (ep_in_count == 0 || in_count <= ep_in_count);
+  if (!plan.fits) {
+    return plan;
+  }
+
+  // double buffer bulk IN with the remaining space, lower endpoint number first
+  uint32_t free_size = top - rx_size - tx_total;
+  bool dbuf[16] {};
+  for (uint8_t i = 0; i < list.count; i++) {
+    detail::edpt_info_t const& ep = list.ep[i];
+    uint32_t const extra = (ep.size + 3) / 4u;
+    if ((ep.addr & TUSB_DIR_IN_MASK) && ep.xfer == TUSB_XFER_BULK && extra <= free_size) {
+      tx_size[ep.addr & 0x0f] += extra;
+      dbuf[ep.addr & 0x0f] = true;
+      free_size -= extra;
+    }
+  }
+
+  plan.mem[plan.count++] = tu_edpt_mem_t { 0x00, 0, 0, (uint16_t) (rx_size * 4) };
+  uint32_t offset = top;
+  for (uint8_t epnum = 1; epnum < 16; epnum++) {
+    if (tx_size[epnum]) {
+      offset -= tx_size[epnum];
+      plan.mem[plan.count++] = tu_edpt_mem_t { (uint8_t) (0x80 | epnum), (uint8_t) dbuf[epnum], (uint16_t) (offset * 4),
+                                               (uint16_t) (tx_size[epnum] * 4) };
+    }
+  }
+
+  plan.used = (top - free_size) * 4;
+  return plan;
+}
+
+} // namespace tud::desc
+
+#endif
@@ -43,6 +43,11 @@
 typedef enum {
   SOF_CONSUMER_USER = 0,
   SOF_CONSUMER_AUDIO,
+  SOF_CONSUMER_NCM,
+  SOF_CONSUMER_CDC,
+  SOF_CONSUMER_VIDEO,
+  SOF_CONSUMER_RNDIS,
+  SOF_CONSUMER_HID,
 } sof_consumer_t;
 
 //--------------------------------------------------------------------+
@@ -58,6 +63,7 @@ typedef struct {
   bool     (* control_xfer_cb  ) (uint8_t rhport, uint8_t stage, tusb_control_request_t const * request);
   bool     (* xfer_cb          ) (uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
   void     (* sof              ) (uint8_t rhport, uint32_t frame_count); // optional
+  void     (* resume           ) (uint8_t rhport); // optional, invoked in ISR context when bus is resumed
 } usbd_class_driver_t;
 
 // Invoked when initializing device stack to get additional class drivers.
@@ -69,6 +75,10 @@ typedef bool (*usbd_control_xfer_cb_t)(uint8_t rhport, uint8_t stage, tusb_contr
 
 void usbd_int_set(bool enabled);
 
+// Check if endpoints can be armed: device is configured and not suspended, or remote wakeup is signaled. In the
+// latter case transfer is kept armed while suspended and completes with the first token after bus is resumed
+bool usbd_rhport_armable(uint8_t rhport);
+
 //--------------------------------------------------------------------+
 // USBD Endpoint API
 // Note: rhport should be 0 since device stack only support 1 rhport for now
@@ -80,12 +90,59 @@ bool usbd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * desc_ep);
 // Close an endpoint
 void usbd_edpt_close(uint8_t rhport, uint8_t ep_addr);
 
-// Submit a usb transfer
-bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes);
+// Submit a usb transfer. With CFG_TUD_EDPT_XFER_LARGE, transfer larger than TUP_DCD_EDPT_XFER_MAX is split
+// into multiple dcd submissions, otherwise it is limited to 64KB
+bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes);
 
 // Submit a usb ISO transfer by use of a FIFO (ring buffer) - all bytes in FIFO get transmitted
 bool usbd_edpt_xfer_fifo(uint8_t rhport, uint8_t ep_addr, tu_fifo_t * ff, uint16_t total_bytes);
 
+#if CFG_TUD_EDPT_XFER_SG
+// Submit a scatter-gather usb transfer of count buffers, driver's xfer_cb() is invoked once with the total
+// transferred bytes. Each buffer except the last must be multiple of endpoint packet size. A short OUT
+// packet completes the transfer early. List must be kept valid until transfer is complete.
+bool usbd_edpt_xfer_sg(uint8_t rhport, uint8_t ep_addr, tu_xfer_sg_t const * sg_list, uint8_t count);
+#endif
+
+#if CFG_TUD_EDPT_ISO_XFER
+// Submit count isochronous packets with individual length (back to back in buffer) to be transferred in consecutive
+// service intervals e.g fractional audio packet sizes. Driver's xfer_cb() is invoked once with the total transferred
+// bytes, actual_len and result of each packet are updated by then. Packet list must be kept valid until complete
+bool usbd_edpt_iso_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, tu_iso_packet_t * packets, uint16_t count);
+#endif
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+// Queue a transfer behind the one on the endpoint, up to CFG_TUD_EDPT_XFER_QUEUE. The next queued transfer is
+// submitted from dcd_event_handler() as soon as the previous one completes, driver's xfer_cb() is invoked once
+// per transfer in submission order. Endpoint stays busy until all are complete. Can not be mixed with a pending
+// usbd_edpt_xfer() and needs no claim. Queued transfers are dropped when endpoint is stalled or closed
+bool usbd_edpt_xfer_queue(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes);
+
+// Number of queued transfers (including the one on dcd) whose completion is not delivered to driver yet
+uint8_t usbd_edpt_xfer_queue_pending(uint8_t rhport, uint8_t ep_addr);
+#endif
+
+#if CFG_TUD_EPBUF_POOL_SIZE
+// Allocate an endpoint buffer of size bytes from the shared pool, aligned to CFG_TUD_EPBUF_POOL_UNIT and placed in
+// CFG_TUD_MEM_SECTION. Should be called from driver open() and released with usbd_epbuf_free() in reset(), so that
+// the pool only holds buffers of the active configuration. Return NULL if pool is exhausted
+void* usbd_epbuf_alloc(uint32_t size);
+
+// Return a buffer to the shared pool, NULL is ignored
+void usbd_epbuf_free(void* buf);
+#endif
+
+#if CFG_TUD_CONTROL_FAST
+// Register or update precomputed response of an IN control request (matched by bmRequestType, bRequest, wValue
+// and wIndex) which is then answered straight from dcd_event_handler() in ISR without going through usbd task.
+// Data is copied, at most CFG_TUD_CONTROL_FAST_SIZE bytes. Only used when configured, responses are cleared on bus
+// reset and configuration change so drivers should register them in open()
+bool usbd_control_fast_set(uint8_t rhport, tusb_control_request_t const* request, void const* data, uint16_t len);
+
+// Remove precomputed response, request is processed by usbd task again
+void usbd_control_fast_clear(uint8_t rhport, tusb_control_request_t const* request);
+#endif
+
 // Claim an endpoint before submitting a transfer.
 // If caller does not make any transfer, it must release endpoint for others.
 bool usbd_edpt_claim(uint8_t rhport, uint8_t ep_addr);
@@ -96,6 +153,17 @@ bool usbd_edpt_release(uint8_t rhport, uint8_t ep_addr);
 // Check if endpoint is busy transferring
 bool usbd_edpt_busy(uint8_t rhport, uint8_t ep_addr);
 
+// Record driver instance (e.g interface index) owning an endpoint, so that xfer_cb() can get it back with
+// usbd_edpt_instance() instead of searching all instances. Cleared on bus reset
+void usbd_edpt_instance_set(uint8_t rhport, uint8_t ep_addr, uint8_t instance);
+
+// Driver instance of endpoint, TUSB_INDEX_INVALID_8 if not set
+uint8_t usbd_edpt_instance(uint8_t rhport, uint8_t ep_addr);
+
+// Invoke driver xfer_cb() of an opened (non-control) endpoint directly from dcd_event_handler() i.e in ISR context,
+// skipping the usbd task round trip. The callback must be ISR-safe. Reset when the endpoint is opened.
+bool usbd_edpt_isr_callback(uint8_t rhport, uint8_t ep_addr, bool enabled);
+
 // Stall endpoint
 void usbd_edpt_stall(uint8_t rhport, uint8_t ep_addr);
 
@@ -117,7 +185,7 @@ bool usbd_edpt_ready(uint8_t rhport, uint8_t ep_addr) {
   return !usbd_edpt_busy(rhport, ep_addr) && !usbd_edpt_stalled(rhport, ep_addr);
 }
 
-// Enable SOF interrupt
+// Enable SOF interrupt, must be called from task context (not ISR)
 void usbd_sof_enable(uint8_t rhport, sof_consumer_t consumer, bool en);
 
 /*------------------------------------------------------------------*/
@@ -127,6 +195,11 @@ void usbd_sof_enable(uint8_t rhport, sof_consumer_t consumer, bool en);
 bool usbd_open_edpt_pair(uint8_t rhport, uint8_t const* p_desc, uint8_t ep_count, uint8_t xfer_type, uint8_t* ep_out, uint8_t* ep_in);
 void usbd_defer_func(osal_task_func_t func, void *param, bool in_isr);
 
+#if CFG_TUD_RHPORT_NUM > 1
+// Index of device stack running on rhport, 0 if rhport has none
+uint8_t usbd_rhport_index(uint8_t rhport);
+#endif
+
 
 #if CFG_TUSB_DEBUG >= CFG_TUD_LOG_LEVEL
 void usbd_driver_print_control_complete_name(usbd_control_xfer_cb_t callback);
@@ -59,6 +59,7 @@ typedef enum {
   HCD_EVENT_XFER_COMPLETE,
 
   USBH_EVENT_FUNC_CALL, // Not an HCD event
+  USBH_EVENT_PRIORITY,  // Not an HCD event: wake up usbh task to process priority queue
   HCD_EVENT_COUNT
 } hcd_eventid_t;
 
@@ -94,9 +95,17 @@ typedef struct {
   uint8_t rhport;
   uint8_t hub_addr;
   uint8_t hub_port;
+  uint8_t tt_port; // downstream port of multi-TT hub whose TT serves the device, 0 for single TT
   uint8_t speed;
 } hcd_devtree_info_t;
 
+// Split transaction schedule of a full/low speed periodic endpoint behind a highspeed hub.
+// Bit n of each mask is micro-frame n of the 1ms frame.
+typedef struct {
+  uint8_t smask; // micro-frames to issue start-split
+  uint8_t cmask; // micro-frames to issue complete-split
+} hcd_split_sched_t;
+
 //--------------------------------------------------------------------+
 // Memory API
 //--------------------------------------------------------------------+
@@ -127,7 +136,7 @@ bool hcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init);
 bool hcd_deinit(uint8_t rhport);
 
 // Interrupt Handler
-void hcd_int_handler(uint8_t rhport, bool in_isr);
+TU_ATTR_FAST_FUNC void hcd_int_handler(uint8_t rhport, bool in_isr);
 
 // Enable USB interrupt
 void hcd_int_enable (uint8_t rhport);
@@ -155,6 +164,12 @@ void hcd_port_reset_end(uint8_t rhport);
 // Get port link speed
 tusb_speed_t hcd_port_speed_get(uint8_t rhport);
 
+// Optional: send LPM token to put link of device on roothub port into L1 sleep, return true if device ACKed
+bool hcd_port_lpm_sleep(uint8_t rhport, uint8_t dev_addr, uint8_t besl, bool remote_wakeup);
+
+// Optional: resume link from L1 sleep
+bool hcd_port_lpm_resume(uint8_t rhport);
+
 // HCD closes all opened endpoints belong to this device
 void hcd_device_close(uint8_t rhport, uint8_t dev_addr);
 
@@ -178,6 +193,15 @@ bool hcd_setup_send(uint8_t rhport, uint8_t daddr, uint8_t const setup_packet[8]
 // clear stall, data toggle is also reset to DATA0
 bool hcd_edpt_clear_stall(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr);
 
+#if CFG_TUH_EDPT_ISO_XFER
+// Optional: submit an isochronous transfer of packet_count packets (contiguous in buffer), one per service interval
+// of the endpoint. start_frame is hcd_frame_number() of the first packet or TU_ISO_START_ASAP, updated with the
+// scheduled frame. actual_len and result of each packet must be written before hcd_event_xfer_complete() is invoked
+// with the total length.
+bool hcd_edpt_iso_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t* buffer,
+                       tu_iso_packet_t* packets, uint16_t packet_count, uint32_t* start_frame);
+#endif
+
 //--------------------------------------------------------------------+
 // USBH implemented API
 //--------------------------------------------------------------------+
@@ -187,6 +211,18 @@ bool hcd_edpt_clear_stall(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr);
 // needed topology info to carry out its work
 extern void hcd_devtree_get_info(uint8_t dev_addr, hcd_devtree_info_t* devtree_info);
 
+//------------- Split Transaction Planner -------------//
+
+// Reserve Transaction Translator (TT) time of hub (hub_addr = 0 for controller's embedded TT) for a full/low speed
+// periodic endpoint on hub_port and plan its start-split and complete-split micro-frames. Each downstream port of
+// a multi-TT hub has its own TT budget. Return false if TT budget is exhausted
+bool hcd_split_reserve(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port, uint8_t speed, uint8_t xfer_type,
+                       uint8_t ep_dir, uint16_t max_packet_size, hcd_split_sched_t* sched);
+
+// Release TT time reserved by hcd_split_reserve() with the same parameters and returned schedule
+void hcd_split_release(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port, uint8_t speed, uint8_t xfer_type,
+                       uint8_t ep_dir, uint16_t max_packet_size, hcd_split_sched_t const* sched);
+
 //------------- Event API -------------//
 
 // Called by HCD to notify stack
@@ -40,13 +40,28 @@
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
+// Hub (bit 0) + ports bitmap is processed as uint32_t
+#define HUB_PORT_MAX  31
+
 typedef struct
 {
   uint8_t itf_num;
   uint8_t ep_in;
   uint8_t port_count;
-
-  CFG_TUH_MEM_ALIGN uint8_t status_change;
+  uint8_t ep_size;
+  uint8_t power_port_last; // last port to set PORT_POWER: 1 for ganged power switching
+  uint16_t pwr_good_ms;    // bPwrOn2PwrGood
+  uint8_t tt_alt;          // alternate setting with multiple TT (bInterfaceProtocol = 2), 0 if not available
+  bool    multi_tt;        // multiple TT alternate setting is selected: each downstream port has its own TT
+
+  // changes reported by status endpoint are processed port by port (bit 0 is hub), status endpoint
+  // is polled again only after all of them are handled
+  uint32_t port_pending;
+  uint8_t  port;            // port being processed
+  uint8_t  port_change;     // change bits of port that are not cleared yet
+  bool     port_connection_changed;
+
+  CFG_TUH_MEM_ALIGN uint8_t status_change[(HUB_PORT_MAX + 1) / 8];
   CFG_TUH_MEM_ALIGN hub_port_status_response_t port_status;
   CFG_TUH_MEM_ALIGN hub_status_response_t hub_status;
 } hub_interface_t;
@@ -198,7 +213,7 @@ bool hub_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf
   TU_VERIFY(TUSB_CLASS_HUB == itf_desc->bInterfaceClass &&
             0              == itf_desc->bInterfaceSubClass);
 
-  // hub driver does not support multiple TT yet
+  // alternate 0 is single TT, multiple TT hub has it in alternate 1 (bInterfaceProtocol = 2)
   TU_VERIFY(itf_desc->bInterfaceProtocol <= 1);
 
   // msc driver length is fixed
@@ -211,12 +226,32 @@ bool hub_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf
   TU_ASSERT(TUSB_DESC_ENDPOINT  == desc_ep->bDescriptorType &&
             TUSB_XFER_INTERRUPT == desc_ep->bmAttributes.xfer, 0);
 
+  // look for multiple TT alternate, its status endpoint is used since the alternate is selected in set config
+  uint8_t tt_alt = 0;
+  uint8_t const* p_desc = tu_desc_next(desc_ep);
+  uint8_t const* desc_end = ((uint8_t const*) itf_desc) + max_len;
+  while (p_desc + sizeof(tusb_desc_interface_t) + sizeof(tusb_desc_endpoint_t) <= desc_end) {
+    tusb_desc_interface_t const* desc_alt = (tusb_desc_interface_t const*) p_desc;
+    uint8_t const* p_ep = tu_desc_next(p_desc);
+    if (TUSB_DESC_INTERFACE == desc_alt->bDescriptorType &&
+        itf_desc->bInterfaceNumber == desc_alt->bInterfaceNumber &&
+        2 == desc_alt->bInterfaceProtocol && TUSB_DESC_ENDPOINT == tu_desc_type(p_ep) &&
+        TUSB_XFER_INTERRUPT == ((tusb_desc_endpoint_t const*) p_ep)->bmAttributes.xfer) {
+      tt_alt = desc_alt->bAlternateSetting;
+      desc_ep = (tusb_desc_endpoint_t const*) p_ep;
+      break;
+    }
+    p_desc = tu_desc_next(p_desc);
+  }
+
   TU_ASSERT(tuh_edpt_open(dev_addr, desc_ep));
 
   hub_interface_t* p_hub = get_itf(dev_addr);
 
   p_hub->itf_num = itf_desc->bInterfaceNumber;
   p_hub->ep_in   = desc_ep->bEndpointAddress;
+  p_hub->ep_size = (uint8_t) tu_min16(tu_edpt_packet_size(desc_ep), sizeof(p_hub->status_change));
+  p_hub->tt_alt  = tt_alt;
 
   return true;
 }
@@ -235,7 +270,14 @@ void hub_close(uint8_t dev_addr)
 bool hub_edpt_status_xfer(uint8_t dev_addr)
 {
   hub_interface_t* hub_itf = get_itf(dev_addr);
-  return usbh_edpt_xfer(dev_addr, hub_itf->ep_in, &hub_itf->status_change, 1);
+
+  // still processing previous changes or already polling
+  if (hub_itf->port_pending || usbh_edpt_busy(dev_addr, hub_itf->ep_in)) return true;
+
+  // bitmap length is (port_count+1) bits rounded up, but not more than endpoint size to avoid waiting for next packet
+  uint16_t const len = tu_min16((uint16_t) ((hub_itf->port_count + 1 + 7) / 8), hub_itf->ep_size);
+  tu_memclr(hub_itf->status_change, sizeof(hub_itf->status_change));
+  return usbh_edpt_xfer(dev_addr, hub_itf->ep_in, hub_itf->status_change, tu_max16(len, 1));
 }
 
 
@@ -245,12 +287,41 @@ bool hub_edpt_status_xfer(uint8_t dev_addr)
 
 static void config_set_port_power (tuh_xfer_t* xfer);
 static void config_port_power_complete (tuh_xfer_t* xfer);
+static void config_power_good (tuh_xfer_t* xfer);
+static void hub_process_next(uint8_t daddr);
+static bool config_get_hub_desc(uint8_t dev_addr);
+
+bool hub_is_multi_tt(uint8_t hub_addr)
+{
+  TU_VERIFY(hub_addr > CFG_TUH_DEVICE_MAX && hub_addr <= CFG_TUH_DEVICE_MAX + CFG_TUH_HUB);
+  return get_itf(hub_addr)->multi_tt;
+}
+
+static void config_multi_tt_complete (tuh_xfer_t* xfer)
+{
+  // fall back to single TT if hub rejects the alternate
+  hub_interface_t* p_hub = get_itf(xfer->daddr);
+  p_hub->multi_tt = (XFER_RESULT_SUCCESS == xfer->result);
+  TU_LOG_DRV("  HUB %s TT\r\n", p_hub->multi_tt ? "multiple" : "single");
+
+  TU_ASSERT(config_get_hub_desc(xfer->daddr), );
+}
 
 bool hub_set_config(uint8_t dev_addr, uint8_t itf_num)
 {
   hub_interface_t* p_hub = get_itf(dev_addr);
   TU_ASSERT(itf_num == p_hub->itf_num);
 
+  // select multiple TT so that each downstream port gets its own TT budget
+  if (p_hub->tt_alt) {
+    return tuh_interface_set(dev_addr, itf_num, p_hub->tt_alt, config_multi_tt_complete, 0);
+  }
+
+  return config_get_hub_desc(dev_addr);
+}
+
+static bool config_get_hub_desc(uint8_t dev_addr)
+{
   // Get Hub Descriptor
   tusb_control_request_t const request =
   {
@@ -290,9 +361,13 @@ static void config_set_port_power (tuh_xfer_t* xfer)
 
   // only use number of ports in hub descriptor
   descriptor_hub_desc_t const* desc_hub = (descriptor_hub_desc_t const*) _hub_buffer;
-  p_hub->port_count = desc_hub->bNbrPorts;
+  p_hub->port_count = tu_min8(desc_hub->bNbrPorts, HUB_PORT_MAX);
+  p_hub->pwr_good_ms = (uint16_t) (2u * desc_hub->bPwrOn2PwrGood);
 
-  // May need to GET_STATUS
+  // Ganged power switching (D1..D0 = 00): powering any port powers all of them. Otherwise PORT_POWER requests are
+  // sent back to back, then there is a single power good wait for all ports
+  uint16_t const characteristics = tu_le16toh(desc_hub->wHubCharacteristics);
+  p_hub->power_port_last = ((characteristics & 0x03u) == 0) ? 1 : p_hub->port_count;
 
   // Set Port Power to be able to detect connection, starting with port 1
   uint8_t const hub_port = 1;
@@ -306,13 +381,13 @@ static void config_port_power_complete (tuh_xfer_t* xfer)
   uint8_t const daddr = xfer->daddr;
   hub_interface_t* p_hub = get_itf(daddr);
 
-  if (xfer->setup->wIndex == p_hub->port_count)
+  if (xfer->setup->wIndex >= p_hub->power_port_last)
   {
-    // All ports are power -> queue notification status endpoint and
-    // complete the SET CONFIGURATION
-    TU_ASSERT( usbh_edpt_xfer(daddr, p_hub->ep_in, &p_hub->status_change, 1), );
-
-    usbh_driver_set_config_complete(daddr, p_hub->itf_num);
+    // All ports are powered -> wait for power to be good on all of them at once
+    if (!usbh_enum_delay(daddr, p_hub->pwr_good_ms, config_power_good, 0))
+    {
+      config_power_good(xfer);
+    }
   }else
   {
     // power next port
@@ -321,25 +396,39 @@ static void config_port_power_complete (tuh_xfer_t* xfer)
   }
 }
 
+static void config_power_good (tuh_xfer_t* xfer)
+{
+  uint8_t const daddr = xfer->daddr;
+  hub_interface_t* p_hub = get_itf(daddr);
+
+  // complete the SET CONFIGURATION, then scan status of all ports in one batch so that devices already plugged in
+  // are detected without waiting for the status endpoint interval
+  usbh_driver_set_config_complete(daddr, p_hub->itf_num);
+
+  p_hub->port_pending = (uint32_t) (TU_BIT(p_hub->port_count + 1) - 2);
+  hub_process_next(daddr);
+}
+
 //--------------------------------------------------------------------+
 // Connection Changes
 //--------------------------------------------------------------------+
 
-static void hub_port_get_status_complete (tuh_xfer_t* xfer);
-static void hub_get_status_complete (tuh_xfer_t* xfer);
-static void connection_clear_conn_change_complete (tuh_xfer_t* xfer);
-static void connection_port_reset_complete (tuh_xfer_t* xfer);
+static void hub_get_status_complete(tuh_xfer_t* xfer);
+static void hub_clear_change_complete(tuh_xfer_t* xfer);
 
 // callback as response of interrupt endpoint polling
 bool hub_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes) {
-  (void) xferred_bytes; // TODO can be more than 1 for hub with lots of ports
   (void) ep_addr;
   TU_VERIFY(result == XFER_RESULT_SUCCESS);
 
   hub_interface_t* p_hub = get_itf(dev_addr);
 
-  uint8_t const status_change = p_hub->status_change;
-  TU_LOG2("  Hub Status Change = 0x%02X\r\n", status_change);
+  uint32_t status_change = 0;
+  for (uint32_t i = 0; i < tu_min32(xferred_bytes, sizeof(p_hub->status_change)); i++) {
+    status_change |= ((uint32_t) p_hub->status_change[i]) << (8 * i);
+  }
+  status_change &= (uint32_t) (TU_BIT(p_hub->port_count + 1) - 1);
+  TU_LOG2("  Hub Status Change = 0x%08lX\r\n", (unsigned long) status_change);
 
   if ( status_change == 0 ) {
     // The status change event was neither for the hub, nor for any of its ports.
@@ -348,157 +437,139 @@ bool hub_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t result, uint32
     return hub_edpt_status_xfer(dev_addr);
   }
 
-  if (tu_bit_test(status_change, 0)) {
-    // Hub bit 0 is for the hub device events
-    if (hub_port_get_status(dev_addr, 0, &p_hub->hub_status, hub_get_status_complete, 0) == false) {
-      //Hub status control transfer failed, retry
-      hub_edpt_status_xfer(dev_addr);
-    }
-  }
-  else {
-    // Hub bits 1 to n are hub port events
-    for (uint8_t port=1; port <= p_hub->port_count; port++) {
-      if ( tu_bit_test(status_change, port) ) {
-        if (hub_port_get_status(dev_addr, port, &p_hub->port_status, hub_port_get_status_complete, 0) == false) {
-          //Hub status control transfer failed, retry
-          hub_edpt_status_xfer(dev_addr);
-        }
-        break;
-      }
-    }
-  }
+  // process all changes in one go: hub first (bit 0) then ports in order
+  p_hub->port_pending = status_change;
+  hub_process_next(dev_addr);
 
-  // NOTE: next status transfer is queued by usbh.c after handling this request
   return true;
 }
 
-static void hub_clear_feature_complete_stub(tuh_xfer_t* xfer)
+// Get status of next port with pending change, poll status endpoint again when all are handled
+static void hub_process_next(uint8_t daddr)
 {
-  TU_ASSERT(xfer->result == XFER_RESULT_SUCCESS, );
-  hub_edpt_status_xfer(xfer->daddr);
-}
-
-static void hub_get_status_complete (tuh_xfer_t* xfer)
-{
-  TU_ASSERT(xfer->result == XFER_RESULT_SUCCESS, );
-
-  uint8_t const daddr = xfer->daddr;
   hub_interface_t* p_hub = get_itf(daddr);
-  uint8_t const port_num = (uint8_t) tu_le16toh(xfer->setup->wIndex);
-  TU_ASSERT(port_num == 0 , );
 
-  TU_LOG2("HUB Got hub status, addr = %u, status = %04x\r\n", daddr, p_hub->hub_status.change.value);
-
-  if (p_hub->hub_status.change.local_power_source)
-  {
-    TU_LOG2("HUB Local Power Change, addr = %u\r\n", daddr);
-    hub_port_clear_feature(daddr, port_num, HUB_FEATURE_HUB_LOCAL_POWER_CHANGE, hub_clear_feature_complete_stub, 0);
-  }
-  else if (p_hub->hub_status.change.over_current)
+  while (p_hub->port_pending)
   {
-    TU_LOG1("HUB Over Current, addr = %u\r\n", daddr);
-    hub_port_clear_feature(daddr, port_num, HUB_FEATURE_HUB_OVER_CURRENT_CHANGE, hub_clear_feature_complete_stub, 0);
-  }
-}
-
-static void hub_port_get_status_complete (tuh_xfer_t* xfer)
-{
-  TU_ASSERT(xfer->result == XFER_RESULT_SUCCESS, );
+    uint8_t port = 0;
+    while ( !tu_bit_test(p_hub->port_pending, port) ) port++;
 
-  uint8_t const daddr = xfer->daddr;
-  hub_interface_t* p_hub = get_itf(daddr);
-  uint8_t const port_num = (uint8_t) tu_le16toh(xfer->setup->wIndex);
-
-  // Connection change
-  if (p_hub->port_status.change.connection)
-  {
-    // Port is powered and enabled
-    //TU_VERIFY(port_status.status_current.port_power && port_status.status_current.port_enable, );
-
-    // Acknowledge Port Connection Change
-    hub_port_clear_feature(daddr, port_num, HUB_FEATURE_PORT_CONNECTION_CHANGE, connection_clear_conn_change_complete, 0);
-  }else
-  {
-    // Clear other port status change interrupts. TODO Not currently handled - just cleared.
-    if (p_hub->port_status.change.port_enable)
-    {
-      hub_port_clear_feature(daddr, port_num, HUB_FEATURE_PORT_ENABLE_CHANGE, hub_clear_feature_complete_stub, 0);
-    }
-    else if (p_hub->port_status.change.suspend)
+    // port reset & its change of device being enumerated are handled by enumeration
+    if ( port != 0 && usbh_enum_is_hub_port(daddr, port) )
     {
-      hub_port_clear_feature(daddr, port_num, HUB_FEATURE_PORT_SUSPEND_CHANGE, hub_clear_feature_complete_stub, 0);
+      p_hub->port_pending &= (uint32_t) ~TU_BIT(port);
+      continue;
     }
-    else if (p_hub->port_status.change.over_current)
-    {
-      hub_port_clear_feature(daddr, port_num, HUB_FEATURE_PORT_OVER_CURRENT_CHANGE, hub_clear_feature_complete_stub, 0);
-    }
-    else if (p_hub->port_status.change.reset)
-    {
-      hub_port_clear_feature(daddr, port_num, HUB_FEATURE_PORT_RESET_CHANGE, hub_clear_feature_complete_stub, 0);
-    }
-    // Other changes are: L1 state
-    // TODO clear change
 
-    else
-    {
-      // prepare for next hub status
-      // TODO continue with status_change, or maybe we can do it again with status
-      hub_edpt_status_xfer(daddr);
-    }
+    p_hub->port = port;
+    p_hub->port_change = 0;
+    p_hub->port_connection_changed = false;
+
+    void* resp = (port == 0) ? (void*) &p_hub->hub_status : (void*) &p_hub->port_status;
+    if ( hub_port_get_status(daddr, port, resp, hub_get_status_complete, 0) ) return;
+
+    // control pipe is busy e.g with enumeration: un-acknowledged changes are reported again on next status
+    p_hub->port_pending = 0;
   }
+
+  (void) hub_edpt_status_xfer(daddr);
 }
 
-static void connection_clear_conn_change_complete (tuh_xfer_t* xfer)
+// Current port is done: notify usbh of connection change and continue with next port
+static void hub_port_done(uint8_t daddr)
 {
-  TU_ASSERT(xfer->result == XFER_RESULT_SUCCESS, );
-
-  uint8_t const daddr = xfer->daddr;
   hub_interface_t* p_hub = get_itf(daddr);
-  uint8_t const port_num = (uint8_t) tu_le16toh(xfer->setup->wIndex);
+  uint8_t const port = p_hub->port;
 
-  if ( p_hub->port_status.status.connection )
+  if ( p_hub->port_connection_changed )
   {
-    // Reset port if attach event
-    hub_port_reset(daddr, port_num, connection_port_reset_complete, 0);
-  }else
-  {
-    // submit detach event
+    // submit attach/detach event. Port reset for attached device is done by usbh when its enumeration starts,
+    // so that only one device responds to address 0 at a time. Other ports are processed meanwhile.
     hcd_event_t event =
     {
       .rhport     = usbh_get_rhport(daddr),
-      .event_id   = HCD_EVENT_DEVICE_REMOVE,
+      .event_id   = p_hub->port_status.status.connection ? HCD_EVENT_DEVICE_ATTACH : HCD_EVENT_DEVICE_REMOVE,
       .connection =
        {
          .hub_addr = daddr,
-         .hub_port = port_num
+         .hub_port = port
        }
     };
 
     hcd_event_handler(&event, false);
   }
+
+  p_hub->port_pending &= (uint32_t) ~TU_BIT(port);
+  hub_process_next(daddr);
 }
 
-static void connection_port_reset_complete (tuh_xfer_t* xfer)
+// Acknowledge change bits of current port one after another, lowest (connection) first
+static void hub_clear_next_change(uint8_t daddr)
 {
-  TU_ASSERT(xfer->result == XFER_RESULT_SUCCESS, );
+  hub_interface_t* p_hub = get_itf(daddr);
+  uint8_t const port = p_hub->port;
+
+  if ( p_hub->port_change )
+  {
+    uint8_t bit = 0;
+    while ( !tu_bit_test(p_hub->port_change, bit) ) bit++;
+    p_hub->port_change = (uint8_t) (p_hub->port_change & ~TU_BIT(bit));
 
+    uint8_t feature;
+    if ( port == 0 )
+    {
+      feature = (uint8_t) (HUB_FEATURE_HUB_LOCAL_POWER_CHANGE + bit);
+      if ( feature == HUB_FEATURE_HUB_OVER_CURRENT_CHANGE )
+      {
+        TU_LOG1("HUB Over Current, addr = %u\r\n", daddr);
+      }
+    }
+    else
+    {
+      // Other changes (enable, suspend, over current, reset) are not currently handled - just cleared.
+      feature = (uint8_t) (HUB_FEATURE_PORT_CONNECTION_CHANGE + bit);
+      if ( feature == HUB_FEATURE_PORT_OVER_CURRENT_CHANGE )
+      {
+        TU_LOG1("HUB Port Over Current, addr = %u port = %u\r\n", daddr, port);
+      }
+    }
+
+    if ( hub_port_clear_feature(daddr, port, feature, hub_clear_change_complete, 0) ) return;
+
+    // control pipe busy: remaining changes are reported again on next status
+    p_hub->port_change = 0;
+  }
+
+  hub_port_done(daddr);
+}
+
+static void hub_get_status_complete (tuh_xfer_t* xfer)
+{
   uint8_t const daddr = xfer->daddr;
-  // hub_interface_t* p_hub = get_itf(daddr);
-  uint8_t const port_num = (uint8_t) tu_le16toh(xfer->setup->wIndex);
+  hub_interface_t* p_hub = get_itf(daddr);
 
-  // submit attach event
-  hcd_event_t event =
+  if ( xfer->result == XFER_RESULT_SUCCESS )
   {
-    .rhport     = usbh_get_rhport(daddr),
-    .event_id   = HCD_EVENT_DEVICE_ATTACH,
-    .connection =
+    if ( p_hub->port == 0 )
     {
-      .hub_addr = daddr,
-      .hub_port = port_num
+      TU_LOG2("HUB Got hub status, addr = %u, status = %04x\r\n", daddr, p_hub->hub_status.change.value);
+      p_hub->port_change = (uint8_t) (p_hub->hub_status.change.value & 0x03u);
     }
-  };
+    else
+    {
+      // connection, enable, suspend, over current, reset
+      p_hub->port_change = (uint8_t) (p_hub->port_status.change.value & 0x1Fu);
+      p_hub->port_connection_changed = p_hub->port_status.change.connection;
+    }
+  }
 
-  hcd_event_handler(&event, false);
+  hub_clear_next_change(daddr);
+}
+
+static void hub_clear_change_complete (tuh_xfer_t* xfer)
+{
+  // failure to clear is not fatal, change will be reported again
+  hub_clear_next_change(xfer->daddr);
 }
 
 #endif
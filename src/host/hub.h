@@ -186,6 +186,9 @@ bool hub_port_get_status    (uint8_t hub_addr, uint8_t hub_port, void* resp,
 // Get status from Interrupt endpoint
 bool hub_edpt_status_xfer(uint8_t dev_addr);
 
+// Check if hub has multiple TT selected i.e each downstream port has its own Transaction Translator
+bool hub_is_multi_tt(uint8_t hub_addr);
+
 // Reset a port
 TU_ATTR_ALWAYS_INLINE static inline
 bool hub_port_reset(uint8_t hub_addr, uint8_t hub_port, tuh_xfer_cb_t complete_cb, uintptr_t user_data) {
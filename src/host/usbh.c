@@ -40,10 +40,84 @@
   #define CFG_TUH_TASK_QUEUE_SZ   16
 #endif
 
+// Size of optional queue for completion of interrupt and isochronous endpoints, 0 (default) to put all events in the
+// same queue. When enabled, this queue is emptied before other events are served so that e.g HID reports are not
+// delayed by a burst of bulk completions, periodic completions therefore overtake events already queued.
+#ifndef CFG_TUH_TASK_PRIORITY_QUEUE_SZ
+  #define CFG_TUH_TASK_PRIORITY_QUEUE_SZ   0
+#endif
+
+// Maximum number of events processed by one tuh_task_ext() call before returning to application, remaining events
+// are processed on next call. Events of main queue are served in arrival order i.e round-robin between endpoints, with
+// CFG_TUH_TASK_PRIORITY_QUEUE_SZ queued priority events are served first and count against the same budget.
+// 0 for no limit
+#ifndef CFG_TUH_TASK_EVENT_MAX
+  #define CFG_TUH_TASK_EVENT_MAX   0
+#endif
+
 #ifndef CFG_TUH_INTERFACE_MAX
   #define CFG_TUH_INTERFACE_MAX   8
 #endif
 
+// Software periodic schedule for hcd without one, which starts a queued interrupt transfer right away and retries
+// NAKed token every frame (e.g MAX3421E): usbh holds transfers of interrupt endpoints and submits them to hcd once per
+// interval of endpoint. Value is number of slots (power of 2) of the timer wheel keyed by frame number, 0 to disable
+#ifndef CFG_TUH_PERIODIC_SCHED_SW
+  #define CFG_TUH_PERIODIC_SCHED_SW   (CFG_TUH_MAX3421 ? 32 : 0)
+#endif
+
+TU_VERIFY_STATIC((CFG_TUH_PERIODIC_SCHED_SW & (CFG_TUH_PERIODIC_SCHED_SW - 1)) == 0 && CFG_TUH_PERIODIC_SCHED_SW < 256,
+                 "CFG_TUH_PERIODIC_SCHED_SW must be power of 2 and less than 256");
+
+// Endpoint states of all devices are allocated from a shared pool. Each device takes one entry per non-control
+// endpoint found in its configuration (including alternate settings), a hub only needs one.
+#ifndef CFG_TUH_ENDPOINT_POOL_SIZE
+  #define CFG_TUH_ENDPOINT_POOL_SIZE   (CFG_TUH_DEVICE_MAX*8 + CFG_TUH_HUB)
+#endif
+
+TU_VERIFY_STATIC(CFG_TUH_ENDPOINT_POOL_SIZE > 0 && CFG_TUH_ENDPOINT_POOL_SIZE < 256,
+                 "CFG_TUH_ENDPOINT_POOL_SIZE must be in 1-255");
+
+// Number of attached devices waiting for enumeration. A hub reports connection changes of all its ports at once
+// while devices are enumerated one at a time, therefore up to one entry per device/hub plus root port
+#ifndef CFG_TUH_ENUM_PENDING_MAX
+  #define CFG_TUH_ENUM_PENDING_MAX   (CFG_TUH_DEVICE_MAX + CFG_TUH_HUB + 1)
+#endif
+
+// Default timeout of a control transfer if tuh_xfer_t.timeout_ms is zero. USB 2.0 9.2.6.4 allows up to 5 seconds for
+// a request with data stage to complete. OSAL_TIMEOUT_WAIT_FOREVER to disable
+#ifndef CFG_TUH_CONTROL_XFER_TIMEOUT_MS
+  #define CFG_TUH_CONTROL_XFER_TIMEOUT_MS   5000
+#endif
+
+// Number of asynchronous control transfers (with complete_cb) queued while control pipe is busy instead of failing.
+// They are started in order as soon as the current one is complete. 0 to disable
+#ifndef CFG_TUH_CONTROL_XFER_QUEUE
+  #define CFG_TUH_CONTROL_XFER_QUEUE   0
+#endif
+
+// Resolve class drivers at compile time: only built-in drivers enabled by CFG_TUH_* are used (usbh_app_driver_get_cb()
+// is ignored), so driver lookup is constant and callbacks can be folded to direct calls
+#ifndef CFG_TUH_DRIVER_STATIC
+  #define CFG_TUH_DRIVER_STATIC   0
+#endif
+
+// Number of devices whose descriptors are kept so that re-attaching skips reading the configuration descriptor. A
+// cached configuration descriptor can be up to CFG_TUH_DESC_CACHE_BUFSIZE, which can be larger than
+// CFG_TUH_ENUMERATION_BUFSIZE. 0 to disable
+#ifndef CFG_TUH_DESC_CACHE
+  #define CFG_TUH_DESC_CACHE   0
+#endif
+
+#ifndef CFG_TUH_DESC_CACHE_BUFSIZE
+  #define CFG_TUH_DESC_CACHE_BUFSIZE   CFG_TUH_ENUMERATION_BUFSIZE
+#endif
+
+// Abort enumeration if device does not complete its descriptors & set configuration within this time. 0 to disable
+#ifndef CFG_TUH_ENUM_TIMEOUT_MS
+  #define CFG_TUH_ENUM_TIMEOUT_MS    5000
+#endif
+
 //--------------------------------------------------------------------+
 // Weak stubs: invoked if no strong implementation is available
 //--------------------------------------------------------------------+
@@ -59,6 +133,32 @@ TU_ATTR_WEAK bool hcd_configure(uint8_t rhport, uint32_t cfg_id, const void* cfg
   return false;
 }
 
+TU_ATTR_WEAK bool hcd_port_lpm_sleep(uint8_t rhport, uint8_t dev_addr, uint8_t besl, bool remote_wakeup) {
+  (void) rhport;
+  (void) dev_addr;
+  (void) besl;
+  (void) remote_wakeup;
+  return false;
+}
+
+TU_ATTR_WEAK bool hcd_port_lpm_resume(uint8_t rhport) {
+  (void) rhport;
+  return false;
+}
+
+#if CFG_TUH_EDPT_ISO_XFER
+TU_ATTR_WEAK bool hcd_edpt_iso_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t* buffer,
+                                    tu_iso_packet_t* packets, uint16_t packet_count, uint32_t* start_frame) {
+  (void) rhport; (void) dev_addr; (void) ep_addr; (void) buffer;
+  (void) packets; (void) packet_count; (void) start_frame;
+  return false;
+}
+#endif
+
+TU_ATTR_WEAK uint32_t tuh_stats_timestamp_cb(void) {
+  return 0;
+}
+
 TU_ATTR_WEAK void tuh_event_hook_cb(uint8_t rhport, uint32_t eventid, bool in_isr) {
   (void) rhport;
   (void) eventid;
@@ -126,21 +226,79 @@ typedef struct {
   // Configuration Descriptor
   // uint8_t interface_count; // bNumInterfaces alias
 
-  // Endpoint & Interface
-  uint8_t itf2drv[CFG_TUH_INTERFACE_MAX];  // map interface number to driver (0xff is invalid)
-  uint8_t ep2drv[CFG_TUH_ENDPOINT_MAX][2]; // map endpoint to driver ( 0xff is invalid ), can use only 4-bit each
+  // Endpoint: range [ep_base, ep_base+ep_count) of _usbh_edpts
+  uint8_t ep_base;
+  uint8_t ep_count;
+  uint16_t ep_periodic[2]; // bitmap of interrupt/isochronous endpoints for each direction
+
+#if CFG_TUH_STATS
+  tuh_stats_edpt_t ep0_stats;
+#endif
+} usbh_device_t;
 
-  tu_edpt_state_t ep_status[CFG_TUH_ENDPOINT_MAX][2];
+// State of a non-control endpoint
+typedef struct {
+  uint8_t ep_addr; // 0 if entry is free
+  uint8_t drv_id;  // driver bound to this endpoint ( 0xff is invalid )
+  uint8_t drv_inst; // driver instance set by usbh_edpt_instance_set() ( 0xff is invalid )
+  tu_edpt_state_t state;
+
+#if CFG_TUH_PERIODIC_BUDGET
+  uint16_t bw;    // periodic time reserved on root port, see periodic_cost()
+  uint16_t tt_bw; // full speed bytes per frame on hub Transaction Translator
+#endif
 
 #if CFG_TUH_API_EDPT_XFER
-  // TODO array can be CFG_TUH_ENDPOINT_MAX-1
+  tuh_xfer_cb_t complete_cb;
+  uintptr_t user_data;
+#endif
+
+#if CFG_TUH_EDPT_ISO_XFER
+  tuh_iso_xfer_t* iso_xfer; // isochronous transfer on hcd submitted by tuh_edpt_iso_xfer()
+#endif
+
+#if CFG_TUH_EDPT_XFER_LARGE
+  // transfer larger than TUP_HCD_EDPT_XFER_MAX submitted part by part
   struct {
-    tuh_xfer_cb_t complete_cb;
-    uintptr_t user_data;
-  }ep_callback[CFG_TUH_ENDPOINT_MAX][2];
+    uint8_t* buffer;    // current part
+    uint32_t remaining; // remaining bytes including current part
+    uint32_t xferred;   // total transferred bytes
+    uint16_t part_len;  // length of current part submitted to hcd
+    uint8_t active;
+  } split;
 #endif
 
-} usbh_device_t;
+#if CFG_TUH_EDPT_XFER_QUEUE
+  // transfers queued behind the one on hcd with usbh_edpt_xfer_queue(), protected by _usbh_spin
+  struct {
+    struct {
+      uint8_t* buffer;
+      uint16_t len;
+    } entry[CFG_TUH_EDPT_XFER_QUEUE];
+    uint8_t rd;
+    uint8_t count;   // entries waiting for the transfer on hcd
+    uint8_t pending; // submitted transfers whose completion is not delivered to driver yet
+    uint8_t running; // a queued transfer is on hcd
+  } queue;
+#endif
+
+#if CFG_TUH_PERIODIC_SCHED_SW
+  // interrupt transfer held by software periodic schedule until one interval has passed since previous submission
+  struct {
+    uint8_t* buffer;
+    uint16_t len;
+    uint16_t start;    // frame number (16-bit) of previous submission
+    uint16_t interval; // in frames, 0 if endpoint is not scheduled by usbh
+    uint8_t daddr;
+    uint8_t next;      // index + 1 of next held endpoint in the same wheel slot, 0 for end of list
+    uint8_t held;
+  } psched;
+#endif
+
+#if CFG_TUH_STATS
+  tuh_stats_edpt_t stats;
+#endif
+} usbh_edpt_t;
 
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF
@@ -188,6 +346,30 @@ static usbh_class_driver_t const usbh_class_drivers[] = {
   },
   #endif
 
+  #if CFG_TUH_AUDIO
+  {
+      .name       = DRIVER_NAME("AUDIO"),
+      .init       = audioh_init,
+      .deinit     = audioh_deinit,
+      .open       = audioh_open,
+      .set_config = audioh_set_config,
+      .xfer_cb    = audioh_xfer_cb,
+      .close      = audioh_close
+  },
+  #endif
+
+  #if CFG_TUH_MIDI
+  {
+      .name       = DRIVER_NAME("MIDI"),
+      .init       = midih_init,
+      .deinit     = midih_deinit,
+      .open       = midih_open,
+      .set_config = midih_set_config,
+      .xfer_cb    = midih_xfer_cb,
+      .close      = midih_close
+  },
+  #endif
+
   #if CFG_TUH_HUB
   {
       .name       = DRIVER_NAME("HUB"),
@@ -202,20 +384,54 @@ static usbh_class_driver_t const usbh_class_drivers[] = {
 
   #if CFG_TUH_VENDOR
   {
-    .name       = DRIVER_NAME("VENDOR"),
-    .init       = cush_init,
-    .deinit     = cush_deinit,
-    .open       = cush_open,
-    .set_config = cush_set_config,
-    .xfer_cb    = cush_isr,
-    .close      = cush_close
-  }
+      .name       = DRIVER_NAME("VENDOR"),
+      .init       = vendorh_init,
+      .deinit     = vendorh_deinit,
+      .open       = vendorh_open,
+      .set_config = vendorh_set_config,
+      .xfer_cb    = vendorh_xfer_cb,
+      .close      = vendorh_close
+  },
+  #endif
+
+  #if CFG_TUH_VIDEO
+  {
+      .name       = DRIVER_NAME("VIDEO"),
+      .init       = videoh_init,
+      .deinit     = videoh_deinit,
+      .open       = videoh_open,
+      .set_config = videoh_set_config,
+      .xfer_cb    = videoh_xfer_cb,
+      .close      = videoh_close
+  },
+  #endif
+
+  #if CFG_TUH_NCM
+  {
+      .name       = DRIVER_NAME("NCM"),
+      .init       = ncmh_init,
+      .deinit     = ncmh_deinit,
+      .open       = ncmh_open,
+      .set_config = ncmh_set_config,
+      .xfer_cb    = ncmh_xfer_cb,
+      .close      = ncmh_close
+  },
   #endif
 };
 
 enum { BUILTIN_DRIVER_COUNT = TU_ARRAY_SIZE(usbh_class_drivers) };
 enum { CONFIG_NUM = 1 }; // default to use configuration 1
 
+#if CFG_TUH_DRIVER_STATIC
+TU_VERIFY_STATIC(BUILTIN_DRIVER_COUNT > 0, "CFG_TUH_DRIVER_STATIC requires at least one built-in class driver");
+
+#define TOTAL_DRIVER_COUNT    BUILTIN_DRIVER_COUNT
+
+TU_ATTR_ALWAYS_INLINE static inline usbh_class_driver_t const *get_driver(uint8_t drv_id) {
+  return (drv_id < BUILTIN_DRIVER_COUNT) ? &usbh_class_drivers[drv_id] : NULL;
+}
+
+#else
 // Additional class drivers implemented by application
 tu_static usbh_class_driver_t const * _app_driver = NULL;
 tu_static uint8_t _app_driver_count = 0;
@@ -233,6 +449,7 @@ static inline usbh_class_driver_t const *get_driver(uint8_t drv_id) {
 
   return driver;
 }
+#endif
 
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
@@ -241,15 +458,61 @@ static inline usbh_class_driver_t const *get_driver(uint8_t drv_id) {
 // sum of end device + hub
 #define TOTAL_DEVICES   (CFG_TUH_DEVICE_MAX + CFG_TUH_HUB)
 
-static uint8_t _usbh_controller = TUSB_INDEX_INVALID_8;
+TU_VERIFY_STATIC(CFG_TUH_RHPORT_NUM > 0 && CFG_TUH_RHPORT_NUM <= TUP_USBIP_CONTROLLER_NUM, "invalid CFG_TUH_RHPORT_NUM");
+
+// bitmap of controllers running host stack
+static uint8_t _usbh_controller = 0;
 
 // Device with address = 0 for enumeration
 static usbh_dev0_t _dev0;
 
+// Device attached while another one is enumerating
+typedef struct {
+  uint8_t rhport;
+  uint8_t hub_addr;
+  uint8_t hub_port;
+  uint32_t attach_ms; // frame number of attach event, debouncing is counted from here
+} usbh_enum_pending_t;
+
+// Enumeration timer and timeout use frame number as millisecond tick so that tuh_task() does not block while waiting
+static struct {
+  usbh_enum_pending_t pending[CFG_TUH_ENUM_PENDING_MAX];
+  uint8_t pending_count;
+
+  uint8_t daddr;        // address of enumerating device, 0 until SET_ADDRESS is complete
+  uint8_t failed_count;
+  uint8_t cache_idx;    // descriptor cache entry of enumerating device
+  uint16_t config_len;  // length of configuration descriptor in config_desc
+  uint8_t* config_desc; // enumeration buffer or descriptor cache entry
+
+  struct TU_ATTR_PACKED {
+    uint8_t timer_armed   : 1;
+    uint8_t timer_retry   : 1; // re-submit failed xfer when expired, otherwise continue with state in xfer.user_data
+    uint8_t timeout_armed : 1;
+    uint8_t root_reset    : 1; // roothub port is in reset, timer is clocked by tusb_time_millis_api()
+    uint8_t TU_RESERVED   : 4;
+  };
+
+  uint16_t timer_ms;
+  uint32_t timer_start;
+  uint32_t start_ms;    // frame number when enumeration starts, for CFG_TUH_ENUM_TIMEOUT_MS
+
+  tuh_xfer_t xfer;
+  tusb_control_request_t request;
+} _enum;
+
 // all devices excluding zero-address
 // hub address start from CFG_TUH_DEVICE_MAX+1
-// TODO: hub can has its own simpler struct to save memory
-static usbh_device_t _usbh_devices[TOTAL_DEVICES];
+TU_ATTR_FAST_DATA static usbh_device_t _usbh_devices[TOTAL_DEVICES];
+
+// map interface number to driver (0xff is invalid), hub only has one interface
+static uint8_t _usbh_itf2drv[CFG_TUH_DEVICE_MAX][CFG_TUH_INTERFACE_MAX];
+#if CFG_TUH_HUB
+static uint8_t _usbh_hub_itf2drv[CFG_TUH_HUB];
+#endif
+
+// endpoint pool shared by all devices
+TU_ATTR_FAST_DATA static usbh_edpt_t _usbh_edpts[CFG_TUH_ENDPOINT_POOL_SIZE];
 
 // Mutex for claiming endpoint
 #if OSAL_MUTEX_REQUIRED
@@ -259,11 +522,57 @@ static usbh_device_t _usbh_devices[TOTAL_DEVICES];
   #define _usbh_mutex   NULL
 #endif
 
+// Transaction Translator budget of root port embedded TT and highspeed hubs, entry is free if ep_count = 0.
+// Multi-TT hub has one TT per downstream port, tt_port is 0 for single TT.
+typedef struct {
+  uint8_t rhport;
+  uint8_t hub_addr;
+  uint8_t tt_port;
+  uint8_t ep_count;
+  uint16_t fs_bytes[8]; // full speed bytes on the downstream bus in each micro-frame
+} usbh_split_tt_t;
+
+static usbh_split_tt_t _split_tt[CFG_TUH_HUB + 1 + (CFG_TUH_HUB ? CFG_TUH_DEVICE_MAX : 0)];
+
+#if CFG_TUH_PERIODIC_BUDGET
+// periodic time reserved on each root port: bytes per micro-frame for highspeed, bytes per frame for full speed
+static uint16_t _periodic_bw[TUP_USBIP_CONTROLLER_NUM];
+#endif
+
+#if CFG_TUH_PERIODIC_SCHED_SW
+// Timer wheel of held interrupt transfers on each root port, protected by _usbh_spin
+typedef struct {
+  uint8_t slot[CFG_TUH_PERIODIC_SCHED_SW]; // index + 1 of first endpoint due in frame (modulo wheel size)
+  uint16_t frame;                          // next frame whose slot is not processed yet
+  uint8_t count;                           // number of held transfers
+} usbh_psched_t;
+
+static usbh_psched_t _psched[TUP_USBIP_CONTROLLER_NUM];
+#endif
+
 // Event queue
 // usbh_int_set is used as mutex in OS NONE config
 OSAL_QUEUE_DEF(usbh_int_set, _usbh_qdef, CFG_TUH_TASK_QUEUE_SZ, hcd_event_t);
 static osal_queue_t _usbh_q;
 
+#if CFG_TUH_TASK_PRIORITY_QUEUE_SZ
+OSAL_QUEUE_DEF(usbh_int_set, _usbh_pqdef, CFG_TUH_TASK_PRIORITY_QUEUE_SZ, hcd_event_t);
+static osal_queue_t _usbh_pq;
+#endif
+
+// Protect data shared between usbh task and ISR, which may run on another core. Fallback to usbh_int_set()
+OSAL_SPINLOCK_DEF(_usbh_spin, usbh_int_set);
+
+#if CFG_TUH_STATS
+static tuh_stats_t _usbh_stats; // ISR time, dropped events and queue high-water, event counts are computed below
+
+// Events queued (written in ISR) and taken by usbh task (written in task) for main, priority queue. Never reset so
+// that their difference is number of waiting events, clearing statistics only moves the base
+static uint32_t _usbh_stats_queued[2];
+static uint32_t _usbh_stats_received[2];
+static uint32_t _usbh_stats_queued_base[2];
+#endif
+
 // Control transfers: since most controllers do not support multiple control transfers
 // on multiple devices concurrently and control transfers are not used much except for
 // enumeration, we will only execute control transfers one at a time.
@@ -275,15 +584,54 @@ static struct {
   uint8_t daddr;
   volatile uint8_t stage;
   volatile uint16_t actual_len;
+
+  uint32_t start_ms;   // frame number when transfer is submitted
+  uint32_t timeout_ms;
 } _ctrl_xfer;
 
+#if CFG_TUH_CONTROL_XFER_QUEUE
+// Control transfers waiting for the on-going one, protected by _usbh_mutex
+static struct {
+  struct {
+    tusb_control_request_t setup;
+    uint8_t* buffer;
+    tuh_xfer_cb_t complete_cb;
+    uintptr_t user_data;
+    uint32_t timeout_ms;
+    uint8_t daddr;
+  } entry[CFG_TUH_CONTROL_XFER_QUEUE];
+  uint8_t rd;
+  uint8_t count;
+} _ctrl_queue;
+#endif
+
 typedef struct {
   TUH_EPBUF_TYPE_DEF(tusb_control_request_t, request);
   TUH_EPBUF_DEF(ctrl, CFG_TUH_ENUMERATION_BUFSIZE);
+
+  #if CFG_TUH_DESC_CACHE
+  struct {
+    TUH_EPBUF_DEF(config, CFG_TUH_DESC_CACHE_BUFSIZE);
+  } desc_cache[CFG_TUH_DESC_CACHE];
+  #endif
 } usbh_epbuf_t;
 
 CFG_TUH_MEM_SECTION static usbh_epbuf_t _usbh_epbuf;
 
+#if CFG_TUH_DESC_CACHE
+TU_VERIFY_STATIC(CFG_TUH_DESC_CACHE_BUFSIZE >= CFG_TUH_ENUMERATION_BUFSIZE, "cache buffer must not be smaller than enumeration buffer");
+
+// Descriptors of known devices, configuration descriptor is in _usbh_epbuf.desc_cache
+typedef struct {
+  tusb_desc_device_t desc_device; // key: whole device descriptor including VID, PID, bcdDevice and serial index
+  uint16_t config_len;            // 0 if entry is not valid
+  uint32_t last_used;
+} usbh_desc_cache_t;
+
+static usbh_desc_cache_t _desc_cache[CFG_TUH_DESC_CACHE];
+static uint32_t _desc_cache_tick;
+#endif
+
 //------------- Helper Function -------------//
 
 TU_ATTR_ALWAYS_INLINE static inline usbh_device_t* get_device(uint8_t dev_addr) {
@@ -291,16 +639,106 @@ TU_ATTR_ALWAYS_INLINE static inline usbh_device_t* get_device(uint8_t dev_addr)
   return &_usbh_devices[dev_addr-1];
 }
 
-static bool enum_new_device(hcd_event_t* event);
+TU_ATTR_ALWAYS_INLINE static inline bool is_hub_addr(uint8_t daddr) {
+  return (CFG_TUH_HUB > 0) && (daddr > CFG_TUH_DEVICE_MAX);
+}
+
+// Interface to driver map of a device, return number of entries
+static uint8_t get_itf2drv(uint8_t dev_addr, uint8_t** itf2drv) {
+#if CFG_TUH_HUB
+  if (is_hub_addr(dev_addr)) {
+    *itf2drv = &_usbh_hub_itf2drv[dev_addr - CFG_TUH_DEVICE_MAX - 1];
+    return 1;
+  }
+#endif
+  *itf2drv = _usbh_itf2drv[dev_addr - 1];
+  return CFG_TUH_INTERFACE_MAX;
+}
+
+// Find state of a non-control endpoint within device's range of the pool
+static usbh_edpt_t* get_edpt(usbh_device_t const* dev, uint8_t ep_addr) {
+  for (uint8_t i = 0; i < dev->ep_count; i++) {
+    usbh_edpt_t* ep = &_usbh_edpts[dev->ep_base + i];
+    if (ep->ep_addr == ep_addr) {
+      return ep;
+    }
+  }
+  return NULL;
+}
+
+#if CFG_TUH_PERIODIC_BUDGET
+typedef struct {
+  uint16_t root;
+  uint16_t tt;
+} periodic_cost_t;
+
+static uint16_t periodic_budget(uint8_t rhport);
+static periodic_cost_t periodic_cost(usbh_device_t const* dev, tusb_desc_endpoint_t const* desc_ep);
+static bool periodic_fits(usbh_device_t const* dev, uint32_t root, uint32_t root_free, uint32_t tt, uint32_t tt_free);
+static void periodic_release(uint8_t rhport, usbh_edpt_t* ep);
+static void periodic_release_all(usbh_device_t const* dev);
+#else
+  #define periodic_release_all(_dev)
+#endif
+
+#if CFG_TUH_PERIODIC_SCHED_SW
+static bool psched_xfer(uint8_t rhport, uint8_t daddr, usbh_edpt_t* ep, uint8_t* buffer, uint16_t len);
+static void psched_remove(uint8_t rhport, usbh_edpt_t* ep);
+static void psched_remove_all(usbh_device_t const* dev);
+static uint32_t psched_process(void);
+#else
+  #define psched_remove_all(_dev)
+#endif
+
+static void enum_pending_add(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port);
+static void enum_pending_remove(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port);
+static void enum_new_device(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port, uint32_t attach_ms);
+static uint32_t enum_process(void);
+static uint32_t control_xfer_timeout_process(bool abort);
+static bool enum_timer_pending(void);
 static void process_removing_device(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port);
+static void enum_full_complete(void);
 static bool usbh_edpt_control_open(uint8_t dev_addr, uint8_t max_packet_size);
 static bool usbh_control_xfer_cb (uint8_t daddr, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
 
+TU_ATTR_ALWAYS_INLINE static inline bool stats_event_sent(uint8_t lane, bool sent) {
+#if CFG_TUH_STATS
+  if (sent) {
+    _usbh_stats_queued[lane]++;
+    uint32_t const waiting = _usbh_stats_queued[lane] - _usbh_stats_received[lane];
+    if (waiting > _usbh_stats.queue_hwm[lane]) {
+      _usbh_stats.queue_hwm[lane] = (uint16_t) waiting;
+    }
+  } else {
+    _usbh_stats.event_dropped[lane]++;
+  }
+#else
+  (void) lane;
+#endif
+  return sent;
+}
+
 TU_ATTR_ALWAYS_INLINE static inline bool queue_event(hcd_event_t const * event, bool in_isr) {
-  TU_ASSERT(osal_queue_send(_usbh_q, event, in_isr));
+  TU_ASSERT(stats_event_sent(0, osal_queue_send(_usbh_q, event, in_isr)));
+  tuh_event_hook_cb(event->rhport, event->event_id, in_isr);
+  return true;
+}
+
+#if CFG_TUH_TASK_PRIORITY_QUEUE_SZ
+TU_ATTR_ALWAYS_INLINE static inline bool queue_event_priority(hcd_event_t const * event, bool in_isr) {
+  bool const was_empty = osal_queue_empty(_usbh_pq);
+  TU_ASSERT(stats_event_sent(1, osal_queue_send(_usbh_pq, event, in_isr)));
+
+  // usbh task may be waiting on the main queue, wake it up. No need if a wake-up is already sent for queued events
+  if (was_empty) {
+    hcd_event_t const wakeup = { .rhport = event->rhport, .event_id = USBH_EVENT_PRIORITY };
+    (void) stats_event_sent(0, osal_queue_send(_usbh_q, &wakeup, in_isr));
+  }
+
   tuh_event_hook_cb(event->rhport, event->event_id, in_isr);
   return true;
 }
+#endif
 
 //--------------------------------------------------------------------+
 // Device API
@@ -330,7 +768,20 @@ tusb_speed_t tuh_speed_get(uint8_t dev_addr) {
 }
 
 bool tuh_rhport_is_active(uint8_t rhport) {
-  return _usbh_controller == rhport;
+  return rhport < TUP_USBIP_CONTROLLER_NUM && tu_bit_test(_usbh_controller, rhport);
+}
+
+bool tuh_lpm_sleep(uint8_t daddr, uint8_t besl, bool remote_wakeup) {
+  usbh_device_t const* dev = get_device(daddr);
+  // LPM through hub is not supported, control pipe must be idle
+  TU_VERIFY(dev && dev->configured && dev->hub_addr == 0 && _ctrl_xfer.stage == CONTROL_STAGE_IDLE);
+  return hcd_port_lpm_sleep(dev->rhport, daddr, besl, remote_wakeup);
+}
+
+bool tuh_lpm_resume(uint8_t daddr) {
+  usbh_device_t const* dev = get_device(daddr);
+  TU_VERIFY(dev && dev->hub_addr == 0);
+  return hcd_port_lpm_resume(dev->rhport);
 }
 
 bool tuh_rhport_reset_bus(uint8_t rhport, bool active) {
@@ -351,20 +802,40 @@ bool tuh_configure(uint8_t rhport, uint32_t cfg_id, const void *cfg_param) {
   return hcd_configure(rhport, cfg_id, cfg_param);
 }
 
-static void clear_device(usbh_device_t* dev) {
+static void clear_device(uint8_t dev_addr) {
+  usbh_device_t* dev = get_device(dev_addr);
+
+  // return endpoints to pool
+  periodic_release_all(dev);
+  psched_remove_all(dev);
+  tu_memclr(&_usbh_edpts[dev->ep_base], dev->ep_count * sizeof(usbh_edpt_t));
   tu_memclr(dev, sizeof(usbh_device_t));
-  memset(dev->itf2drv, TUSB_INDEX_INVALID_8, sizeof(dev->itf2drv)); // invalid mapping
-  memset(dev->ep2drv , TUSB_INDEX_INVALID_8, sizeof(dev->ep2drv )); // invalid mapping
+
+  uint8_t* itf2drv;
+  uint8_t const itf_count = get_itf2drv(dev_addr, &itf2drv);
+  memset(itf2drv, TUSB_INDEX_INVALID_8, itf_count); // invalid mapping
 }
 
 bool tuh_inited(void) {
-  return _usbh_controller != TUSB_INDEX_INVALID_8;
+  return _usbh_controller != 0;
 }
 
 bool tuh_rhport_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   if (tuh_rhport_is_active(rhport)) {
     return true; // skip if already initialized
   }
+  TU_ASSERT(rhport < TUP_USBIP_CONTROLLER_NUM);
+  #if CFG_TUH_RHPORT_NUM == 1
+  TU_VERIFY(!tuh_inited()); // host stack is already running on another controller
+  #else
+  uint8_t active_count = 0;
+  for (uint8_t i = 0; i < TUP_USBIP_CONTROLLER_NUM; i++) {
+    if (tu_bit_test(_usbh_controller, i)) {
+      active_count++;
+    }
+  }
+  TU_ASSERT(active_count < CFG_TUH_RHPORT_NUM);
+  #endif
 
   TU_LOG_USBH("USBH init on controller %u, speed = %s\r\n", rhport,
     rh_init->speed == TUSB_SPEED_HIGH ? "High" : "Full");
@@ -372,6 +843,7 @@ bool tuh_rhport_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   // Init host stack if not already
   if (!tuh_inited()) {
     TU_LOG_INT_USBH(sizeof(usbh_device_t));
+    TU_LOG_INT_USBH(sizeof(usbh_edpt_t));
     TU_LOG_INT_USBH(sizeof(hcd_event_t));
     TU_LOG_INT_USBH(sizeof(_ctrl_xfer));
     TU_LOG_INT_USBH(sizeof(tuh_xfer_t));
@@ -381,6 +853,19 @@ bool tuh_rhport_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
     // Event queue
     _usbh_q = osal_queue_create(&_usbh_qdef);
     TU_ASSERT(_usbh_q != NULL);
+    osal_spin_init(&_usbh_spin);
+
+#if CFG_TUH_STATS
+    tu_varclr(&_usbh_stats);
+    tu_memclr(_usbh_stats_queued, sizeof(_usbh_stats_queued));
+    tu_memclr(_usbh_stats_received, sizeof(_usbh_stats_received));
+    tu_memclr(_usbh_stats_queued_base, sizeof(_usbh_stats_queued_base));
+#endif
+
+#if CFG_TUH_TASK_PRIORITY_QUEUE_SZ
+    _usbh_pq = osal_queue_create(&_usbh_pqdef);
+    TU_ASSERT(_usbh_pq != NULL);
+#endif
 
 #if OSAL_MUTEX_REQUIRED
     // Init mutex
@@ -388,18 +873,32 @@ bool tuh_rhport_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
     TU_ASSERT(_usbh_mutex);
 #endif
 
+    #if !CFG_TUH_DRIVER_STATIC
     // Get application driver if available
     if (usbh_app_driver_get_cb) {
       _app_driver = usbh_app_driver_get_cb(&_app_driver_count);
     }
+    #endif
 
     // Device
     tu_memclr(&_dev0, sizeof(_dev0));
+    tu_memclr(&_enum, sizeof(_enum));
     tu_memclr(_usbh_devices, sizeof(_usbh_devices));
+    tu_memclr(_usbh_edpts, sizeof(_usbh_edpts));
     tu_memclr(&_ctrl_xfer, sizeof(_ctrl_xfer));
+    #if CFG_TUH_CONTROL_XFER_QUEUE
+    tu_memclr(&_ctrl_queue, sizeof(_ctrl_queue));
+    #endif
+    tu_memclr(_split_tt, sizeof(_split_tt));
+    #if CFG_TUH_PERIODIC_BUDGET
+    tu_memclr(_periodic_bw, sizeof(_periodic_bw));
+    #endif
+    #if CFG_TUH_DESC_CACHE
+    tu_memclr(_desc_cache, sizeof(_desc_cache));
+    #endif
 
-    for (uint8_t i = 0; i < TOTAL_DEVICES; i++) {
-      clear_device(&_usbh_devices[i]);
+    for (uint8_t daddr = 1; daddr <= TOTAL_DEVICES; daddr++) {
+      clear_device(daddr);
     }
 
     // Class drivers
@@ -413,7 +912,7 @@ bool tuh_rhport_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   }
 
   // Init host controller
-  _usbh_controller = rhport;
+  _usbh_controller |= (uint8_t) TU_BIT(rhport);
   TU_ASSERT(hcd_init(rhport, rh_init));
   hcd_int_enable(rhport);
 
@@ -423,13 +922,20 @@ bool tuh_rhport_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
 bool tuh_deinit(uint8_t rhport) {
   if (!tuh_rhport_is_active(rhport)) return true;
 
+  // stop enumeration on this controller, other controllers can go on with their pending devices
+  if (_dev0.enumerating && _dev0.rhport == rhport) {
+    (void) tuh_edpt_abort_xfer(0, 0);
+    enum_full_complete();
+  }
+
   // deinit host controller
   hcd_int_disable(rhport);
   hcd_deinit(rhport);
-  _usbh_controller = TUSB_INDEX_INVALID_8;
+  _usbh_controller &= (uint8_t) ~TU_BIT(rhport);
 
   // "unplug" all devices on this rhport (hub_addr = 0, hub_port = 0)
   process_removing_device(rhport, 0, 0);
+  enum_pending_remove(rhport, 0, 0);
 
   // deinit host stack if no controller is active
   if (!tuh_inited()) {
@@ -445,6 +951,11 @@ bool tuh_deinit(uint8_t rhport) {
     osal_queue_delete(_usbh_q);
     _usbh_q = NULL;
 
+    #if CFG_TUH_TASK_PRIORITY_QUEUE_SZ
+    osal_queue_delete(_usbh_pq);
+    _usbh_pq = NULL;
+    #endif
+
     #if OSAL_MUTEX_REQUIRED
     // TODO make sure there is no task waiting on this mutex
     osal_mutex_delete(_usbh_mutex);
@@ -455,12 +966,127 @@ bool tuh_deinit(uint8_t rhport) {
   return true;
 }
 
+#if CFG_TUH_STATS
+void tuh_stats_int_handler(uint8_t rhport, bool in_isr) {
+  uint32_t const start = tuh_stats_timestamp_cb();
+  hcd_int_handler(rhport, in_isr);
+  uint32_t const elapsed = tuh_stats_timestamp_cb() - start;
+
+  _usbh_stats.isr_count++;
+  _usbh_stats.isr_time_total += elapsed;
+  if (elapsed > _usbh_stats.isr_time_max) {
+    _usbh_stats.isr_time_max = elapsed;
+  }
+}
+#endif
+
+bool tuh_stats_get(tuh_stats_t* stats, bool clear) {
+#if CFG_TUH_STATS
+  TU_VERIFY(stats != NULL && tuh_inited());
+
+  osal_spin_lock(&_usbh_spin, false);
+  *stats = _usbh_stats;
+  for (uint8_t i = 0; i < 2; i++) {
+    stats->event_count[i] = _usbh_stats_queued[i] - _usbh_stats_queued_base[i];
+    if (clear) {
+      _usbh_stats_queued_base[i] = _usbh_stats_queued[i];
+    }
+  }
+  if (clear) {
+    tu_varclr(&_usbh_stats);
+  }
+  osal_spin_unlock(&_usbh_spin, false);
+
+  return true;
+#else
+  (void) stats; (void) clear;
+  return false;
+#endif
+}
+
+bool tuh_stats_edpt_get(uint8_t daddr, uint8_t ep_addr, tuh_stats_edpt_t* stats, bool clear) {
+#if CFG_TUH_STATS
+  usbh_device_t* dev = get_device(daddr);
+  TU_VERIFY(dev != NULL && stats != NULL);
+
+  tuh_stats_edpt_t* ep_stats;
+  if (tu_edpt_number(ep_addr) == 0) {
+    ep_stats = &dev->ep0_stats;
+  } else {
+    usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+    TU_VERIFY(ep);
+    ep_stats = &ep->stats;
+  }
+
+  *stats = *ep_stats;
+  if (clear) {
+    tu_varclr(ep_stats);
+  }
+
+  return true;
+#else
+  (void) daddr; (void) ep_addr; (void) stats; (void) clear;
+  return false;
+#endif
+}
+
 bool tuh_task_event_ready(void) {
   if (!tuh_inited()) {
     return false; // Skip if stack is not initialized
   }
-  return !osal_queue_empty(_usbh_q);
+  #if CFG_TUH_TASK_PRIORITY_QUEUE_SZ
+  if (!osal_queue_empty(_usbh_pq)) return true;
+  #endif
+  return !osal_queue_empty(_usbh_q) || enum_timer_pending() || (control_xfer_timeout_process(false) == 0);
+}
+
+#if CFG_TUH_EDPT_XFER_LARGE
+// Submit next part of a large transfer
+static bool xfer_split_submit(usbh_device_t const* dev, usbh_edpt_t* ep, uint8_t daddr) {
+  ep->split.part_len = (uint16_t) tu_min32(ep->split.remaining, TUP_HCD_EDPT_XFER_MAX);
+  return hcd_edpt_xfer(dev->rhport, daddr, ep->ep_addr, ep->split.buffer, ep->split.part_len);
+}
+
+// Submit next part of large transfer after a part is complete, return true if submitted.
+// Otherwise transfer is done (or it is not split) and event is updated with total bytes.
+static bool xfer_split_continue(usbh_device_t const* dev, usbh_edpt_t* ep, hcd_event_t* event) {
+  TU_VERIFY(ep && ep->split.active);
+
+  uint32_t const len = event->xfer_complete.len;
+  ep->split.xferred += len;
+
+  // stop at error or short packet
+  if ((event->xfer_complete.result == XFER_RESULT_SUCCESS) && (len == ep->split.part_len)) {
+    ep->split.buffer += len;
+    ep->split.remaining -= len;
+
+    if (ep->split.remaining) {
+      if (xfer_split_submit(dev, ep, event->dev_addr)) {
+        return true;
+      }
+      event->xfer_complete.result = XFER_RESULT_FAILED;
+    }
+  }
+
+  event->xfer_complete.len = ep->split.xferred;
+  ep->split.active = 0;
+  return false;
+}
+#endif
+
+#if CFG_TUH_EDPT_XFER_QUEUE
+// Completion of a transfer is delivered to driver, return true if endpoint still has queued transfers pending
+static bool xfer_queue_delivered(usbh_edpt_t* ep) {
+  osal_spin_lock(&_usbh_spin, false);
+  if (ep->queue.pending) {
+    ep->queue.pending--;
+  }
+  bool const pending = (ep->queue.pending > 0);
+  osal_spin_unlock(&_usbh_spin, false);
+
+  return pending;
 }
+#endif
 
 /* USB Host Driver task
  * This top level thread manages all host controller event and delegates events to class-specific drivers.
@@ -486,59 +1112,64 @@ void tuh_task_ext(uint32_t timeout_ms, bool in_isr) {
   // Skip if stack is not initialized
   if (!tuh_inited()) return;
 
+  #if CFG_TUH_TASK_EVENT_MAX
+  uint32_t event_count = 0;
+  #endif
+
   // Loop until there is no more events in the queue
   while (1) {
+    // abort timed out control transfer, run enumeration timers and start next pending device.
+    // Do not wait for event longer than the next timer
+    uint32_t const ctrl_wait_ms = control_xfer_timeout_process(true);
+    uint32_t const enum_wait_ms = enum_process();
+    #if CFG_TUH_PERIODIC_SCHED_SW
+    uint32_t const sched_wait_ms = psched_process();
+    #else
+    uint32_t const sched_wait_ms = UINT32_MAX;
+    #endif
+
     hcd_event_t event;
-    if (!osal_queue_receive(_usbh_q, &event, timeout_ms)) return;
+    bool has_event = false;
+
+    #if CFG_TUH_TASK_PRIORITY_QUEUE_SZ
+    // periodic completions first, at most one other event is processed between them
+    has_event = osal_queue_receive(_usbh_pq, &event, 0);
+    #endif
+
+    if (!has_event && !osal_queue_receive(_usbh_q, &event, tu_min32(tu_min32(timeout_ms, sched_wait_ms), tu_min32(ctrl_wait_ms, enum_wait_ms)))) {
+      return;
+    }
+
+    #if CFG_TUH_STATS
+    _usbh_stats_received[has_event ? 1 : 0]++;
+    #endif
 
     switch (event.event_id) {
       case HCD_EVENT_DEVICE_ATTACH:
-        // due to the shared control buffer, we must complete enumerating one device before enumerating another one.
-        // TODO better to have an separated queue for newly attached devices
-        if (_dev0.enumerating) {
-          // Some device can cause multiple duplicated attach events
-          // drop current enumerating and start over for a proper port reset
-          if (event.rhport == _dev0.rhport && event.connection.hub_addr == _dev0.hub_addr &&
-              event.connection.hub_port == _dev0.hub_port) {
-            // abort/cancel current enumeration and start new one
-            TU_LOG1("[%u:] USBH Device Attach (duplicated)\r\n", event.rhport);
-            tuh_edpt_abort_xfer(0, 0);
-            enum_new_device(&event);
-          } else {
-            TU_LOG_USBH("[%u:] USBH Defer Attach until current enumeration complete\r\n", event.rhport);
-
-            bool is_empty = osal_queue_empty(_usbh_q);
-            queue_event(&event, in_isr);
-
-            if (is_empty) {
-              // Exit if this is the only event in the queue, otherwise we may loop forever
-              return;
-            }
-          }
-        } else {
-          TU_LOG1("[%u:] USBH Device Attach\r\n", event.rhport);
-          _dev0.enumerating = 1;
-          enum_new_device(&event);
-        }
-        break;
+        // Some device can cause multiple duplicated attach events
+        // drop current enumerating and start over for a proper port reset
+        if (_dev0.enumerating && event.rhport == _dev0.rhport && event.connection.hub_addr == _dev0.hub_addr &&
+            event.connection.hub_port == _dev0.hub_port) {
+          // abort/cancel current enumeration and start new one
+          TU_LOG1("[%u:] USBH Device Attach (duplicated)\r\n", event.rhport);
+          tuh_edpt_abort_xfer(0, 0);
+          enum_new_device(event.rhport, event.connection.hub_addr, event.connection.hub_port, hcd_frame_number(event.rhport));
+        } else {
+          // due to the shared address 0 and control buffer, devices are enumerated one at a time in attach order
+          TU_LOG1("[%u:%u:%u] USBH Device Attach\r\n", event.rhport, event.connection.hub_addr, event.connection.hub_port);
+          enum_pending_add(event.rhport, event.connection.hub_addr, event.connection.hub_port);
+        }
+        break;
 
       case HCD_EVENT_DEVICE_REMOVE:
         TU_LOG_USBH("[%u:%u:%u] USBH DEVICE REMOVED\r\n", event.rhport, event.connection.hub_addr, event.connection.hub_port);
         process_removing_device(event.rhport, event.connection.hub_addr, event.connection.hub_port);
-
-        #if CFG_TUH_HUB
-        // TODO remove
-        if (event.connection.hub_addr != 0 && event.connection.hub_port != 0) {
-          // done with hub, waiting for next data on status pipe
-          (void) hub_edpt_status_xfer(event.connection.hub_addr);
-        }
-        #endif
+        enum_pending_remove(event.rhport, event.connection.hub_addr, event.connection.hub_port);
         break;
 
       case HCD_EVENT_XFER_COMPLETE: {
         uint8_t const ep_addr = event.xfer_complete.ep_addr;
         uint8_t const epnum = tu_edpt_number(ep_addr);
-        uint8_t const ep_dir = (uint8_t) tu_edpt_dir(ep_addr);
 
         TU_LOG_USBH("on EP %02X with %u bytes: %s\r\n", ep_addr, (unsigned int) event.xfer_complete.len, tu_str_xfer_result[event.xfer_complete.result]);
 
@@ -550,16 +1181,61 @@ void tuh_task_ext(uint32_t timeout_ms, bool in_isr) {
           usbh_device_t* dev = get_device(event.dev_addr);
           TU_VERIFY(dev && dev->connected,);
 
-          dev->ep_status[epnum][ep_dir].busy = 0;
-          dev->ep_status[epnum][ep_dir].claimed = 0;
+          // control endpoint does not have an entry in endpoint pool
+          usbh_edpt_t* ep = NULL;
+          if (epnum) {
+            ep = get_edpt(dev, ep_addr);
+            TU_ASSERT(ep,);
+          }
+
+          #if CFG_TUH_EDPT_XFER_LARGE
+          // continue with next part of large transfer if any
+          if (xfer_split_continue(dev, ep, &event)) break;
+          #endif
+
+          if (ep) {
+            #if CFG_TUH_EDPT_XFER_QUEUE
+            // endpoint stays busy until completions of all queued transfers are delivered
+            if (!xfer_queue_delivered(ep))
+            #endif
+            {
+              ep->state.busy = 0;
+            }
+            ep->state.claimed = 0;
+          }
+
+          #if CFG_TUH_STATS
+          tuh_stats_edpt_t* ep_stats = ep ? &ep->stats : &dev->ep0_stats;
+          ep_stats->xfer_count++;
+          ep_stats->xfer_bytes += event.xfer_complete.len;
+          if (event.xfer_complete.result == XFER_RESULT_STALLED) {
+            ep_stats->stall_count++;
+          } else if (event.xfer_complete.result != XFER_RESULT_SUCCESS) {
+            ep_stats->error_count++;
+          }
+          #endif
 
           if (0 == epnum) {
             usbh_control_xfer_cb(event.dev_addr, ep_addr, (xfer_result_t) event.xfer_complete.result, event.xfer_complete.len);
           } else {
+            TU_TRACE(TU_TRACE_CB_ENTER, 1, (event.dev_addr << 8) | ep_addr, event.xfer_complete.len);
+
+            #if CFG_TUH_EDPT_ISO_XFER
+            tuh_iso_xfer_t* iso_xfer = ep->iso_xfer;
+            if (iso_xfer) {
+              // per-packet length and result are already written by hcd
+              ep->iso_xfer = NULL;
+              iso_xfer->result = (xfer_result_t) event.xfer_complete.result;
+              iso_xfer->actual_len = event.xfer_complete.len;
+              if (iso_xfer->complete_cb) {
+                iso_xfer->complete_cb(iso_xfer);
+              }
+            } else
+            #endif
             // Prefer application callback over built-in one if available. This occurs when tuh_edpt_xfer() is used
             // with enabled driver e.g HID endpoint
             #if CFG_TUH_API_EDPT_XFER
-            tuh_xfer_cb_t const complete_cb = dev->ep_callback[epnum][ep_dir].complete_cb;
+            tuh_xfer_cb_t const complete_cb = ep->complete_cb;
             if ( complete_cb ) {
               // re-construct xfer info
               tuh_xfer_t xfer = {
@@ -570,14 +1246,13 @@ void tuh_task_ext(uint32_t timeout_ms, bool in_isr) {
                   .buflen      = 0,    // not available
                   .buffer      = NULL, // not available
                   .complete_cb = complete_cb,
-                  .user_data   = dev->ep_callback[epnum][ep_dir].user_data
+                  .user_data   = ep->user_data
               };
               complete_cb(&xfer);
             }else
             #endif
             {
-              uint8_t drv_id = dev->ep2drv[epnum][ep_dir];
-              usbh_class_driver_t const* driver = get_driver(drv_id);
+              usbh_class_driver_t const* driver = get_driver(ep->drv_id);
               if (driver) {
                 TU_LOG_USBH("%s xfer callback\r\n", driver->name);
                 driver->xfer_cb(event.dev_addr, ep_addr, (xfer_result_t) event.xfer_complete.result,
@@ -587,6 +1262,8 @@ void tuh_task_ext(uint32_t timeout_ms, bool in_isr) {
                 TU_ASSERT(false,);
               }
             }
+
+            TU_TRACE(TU_TRACE_CB_EXIT, 1, (event.dev_addr << 8) | ep_addr, 0);
           }
         }
         break;
@@ -596,12 +1273,24 @@ void tuh_task_ext(uint32_t timeout_ms, bool in_isr) {
         if (event.func_call.func) event.func_call.func(event.func_call.param);
         break;
 
+      case USBH_EVENT_PRIORITY:
+        // priority queue is checked on next loop
+        break;
+
       default:
         break;
     }
 
+    #if CFG_TUH_TASK_EVENT_MAX
+    // budget is used up, leave remaining events for next call
+    if (++event_count >= CFG_TUH_TASK_EVENT_MAX) return;
+    #endif
+
 #if CFG_TUSB_OS != OPT_OS_NONE && CFG_TUSB_OS != OPT_OS_PICO
     // return if there is no more events, for application to run other background
+    #if CFG_TUH_TASK_PRIORITY_QUEUE_SZ
+    if (!osal_queue_empty(_usbh_pq)) continue;
+    #endif
     if (osal_queue_empty(_usbh_q)) return;
 #endif
   }
@@ -616,7 +1305,6 @@ static void _control_blocking_complete_cb(tuh_xfer_t* xfer) {
   *((xfer_result_t*) xfer->user_data) = xfer->result;
 }
 
-// TODO timeout_ms is not supported yet
 bool tuh_control_xfer (tuh_xfer_t* xfer) {
   // EP0 with setup packet
   TU_VERIFY(xfer->ep_addr == 0 && xfer->setup);
@@ -630,8 +1318,10 @@ bool tuh_control_xfer (tuh_xfer_t* xfer) {
     TU_VERIFY(dev && dev->connected);
   }
 
-  // pre-check to help reducing mutex lock
-  TU_VERIFY(_ctrl_xfer.stage == CONTROL_STAGE_IDLE);
+  // pre-check to help reducing mutex lock, only asynchronous transfer can be queued
+  TU_VERIFY(_ctrl_xfer.stage == CONTROL_STAGE_IDLE || (CFG_TUH_CONTROL_XFER_QUEUE && xfer->complete_cb));
+  const uint8_t rhport = usbh_get_rhport(daddr);
+  const uint32_t timeout_ms = xfer->timeout_ms ? xfer->timeout_ms : CFG_TUH_CONTROL_XFER_TIMEOUT_MS;
   (void) osal_mutex_lock(_usbh_mutex, OSAL_TIMEOUT_WAIT_FOREVER);
 
   bool const is_idle = (_ctrl_xfer.stage == CONTROL_STAGE_IDLE);
@@ -643,13 +1333,34 @@ bool tuh_control_xfer (tuh_xfer_t* xfer) {
     _ctrl_xfer.buffer      = xfer->buffer;
     _ctrl_xfer.complete_cb = xfer->complete_cb;
     _ctrl_xfer.user_data   = xfer->user_data;
+    _ctrl_xfer.start_ms    = hcd_frame_number(rhport);
+    _ctrl_xfer.timeout_ms  = timeout_ms;
     _usbh_epbuf.request    = (*xfer->setup);
   }
+#if CFG_TUH_CONTROL_XFER_QUEUE
+  bool queued = false;
+  if (!is_idle && xfer->complete_cb && _ctrl_queue.count < CFG_TUH_CONTROL_XFER_QUEUE) {
+    uint8_t const wr = (uint8_t) ((_ctrl_queue.rd + _ctrl_queue.count) % CFG_TUH_CONTROL_XFER_QUEUE);
+    _ctrl_queue.entry[wr].setup       = (*xfer->setup);
+    _ctrl_queue.entry[wr].buffer      = xfer->buffer;
+    _ctrl_queue.entry[wr].complete_cb = xfer->complete_cb;
+    _ctrl_queue.entry[wr].user_data   = xfer->user_data;
+    _ctrl_queue.entry[wr].timeout_ms  = timeout_ms;
+    _ctrl_queue.entry[wr].daddr       = daddr;
+    _ctrl_queue.count++;
+    queued = true;
+  }
+#endif
 
   (void) osal_mutex_unlock(_usbh_mutex);
 
+#if CFG_TUH_CONTROL_XFER_QUEUE
+  if (queued) {
+    TU_LOG_USBH("[%u:%u] Control transfer queued\r\n", rhport, daddr);
+    return true;
+  }
+#endif
   TU_VERIFY(is_idle);
-  const uint8_t rhport = usbh_get_rhport(daddr);
 
   TU_LOG_USBH("[%u:%u] %s: ", rhport, daddr,
               (xfer->setup->bmRequestType_bit.type == TUSB_REQ_TYPE_STANDARD && xfer->setup->bRequest <= TUSB_REQ_SYNCH_FRAME) ?
@@ -671,11 +1382,11 @@ bool tuh_control_xfer (tuh_xfer_t* xfer) {
 
     while (result == XFER_RESULT_INVALID) {
       // Note: this can be called within an callback ie. part of tuh_task()
-      // therefore event with RTOS tuh_task() still need to be invoked
+      // therefore event with RTOS tuh_task() still need to be invoked.
+      // tuh_task() also aborts the transfer with XFER_RESULT_TIMEOUT when timed out
       if (tuh_task_event_ready()) {
         tuh_task();
       }
-      // TODO probably some timeout to prevent hanged
     }
 
     // update transfer result, user_data is expected to point to xfer_result_t
@@ -695,6 +1406,47 @@ TU_ATTR_ALWAYS_INLINE static inline void _set_control_xfer_stage(uint8_t stage)
   (void) osal_mutex_unlock(_usbh_mutex);
 }
 
+static void _control_xfer_complete(uint8_t daddr, xfer_result_t result);
+
+// Set control pipe idle, then start the next queued transfer whose device is still there
+static void control_xfer_next(void) {
+  (void) osal_mutex_lock(_usbh_mutex, OSAL_TIMEOUT_WAIT_FOREVER);
+  _ctrl_xfer.stage = CONTROL_STAGE_IDLE;
+#if CFG_TUH_CONTROL_XFER_QUEUE
+  while (_ctrl_queue.count) {
+    uint8_t const rd = _ctrl_queue.rd;
+    _ctrl_queue.rd = (uint8_t) ((rd + 1) % CFG_TUH_CONTROL_XFER_QUEUE);
+    _ctrl_queue.count--;
+
+    uint8_t const daddr = _ctrl_queue.entry[rd].daddr;
+    usbh_device_t const* dev = get_device(daddr);
+    if (daddr ? (dev && dev->connected) : _dev0.enumerating) {
+      _ctrl_xfer.stage       = CONTROL_STAGE_SETUP;
+      _ctrl_xfer.daddr       = daddr;
+      _ctrl_xfer.actual_len  = 0;
+      _ctrl_xfer.buffer      = _ctrl_queue.entry[rd].buffer;
+      _ctrl_xfer.complete_cb = _ctrl_queue.entry[rd].complete_cb;
+      _ctrl_xfer.user_data   = _ctrl_queue.entry[rd].user_data;
+      _ctrl_xfer.start_ms    = hcd_frame_number(usbh_get_rhport(daddr));
+      _ctrl_xfer.timeout_ms  = _ctrl_queue.entry[rd].timeout_ms;
+      _usbh_epbuf.request    = _ctrl_queue.entry[rd].setup;
+      break;
+    }
+  }
+#endif
+  bool const started = (_ctrl_xfer.stage == CONTROL_STAGE_SETUP);
+  (void) osal_mutex_unlock(_usbh_mutex);
+
+  if (started) {
+    uint8_t const daddr = _ctrl_xfer.daddr;
+    TU_LOG_USBH("[%u:%u] Start queued control transfer\r\n", usbh_get_rhport(daddr), daddr);
+    TU_LOG_BUF_USBH(&_usbh_epbuf.request, 8);
+    if (!hcd_setup_send(usbh_get_rhport(daddr), daddr, (uint8_t const*) &_usbh_epbuf.request)) {
+      _control_xfer_complete(daddr, XFER_RESULT_FAILED);
+    }
+  }
+}
+
 static void _control_xfer_complete(uint8_t daddr, xfer_result_t result) {
   TU_LOG_USBH("\r\n");
 
@@ -711,13 +1463,47 @@ static void _control_xfer_complete(uint8_t daddr, xfer_result_t result) {
     .user_data   = _ctrl_xfer.user_data
   };
 
-  _set_control_xfer_stage(CONTROL_STAGE_IDLE);
+  // next queued transfer goes on the bus before callback, which may queue a follow-up request
+  control_xfer_next();
 
   if (xfer_temp.complete_cb) {
     xfer_temp.complete_cb(&xfer_temp);
   }
 }
 
+// endpoint address of current control stage
+static uint8_t control_stage_ep_addr(void) {
+  tusb_control_request_t const * request = &_usbh_epbuf.request;
+  switch (_ctrl_xfer.stage) {
+    case CONTROL_STAGE_DATA: return tu_edpt_addr(0, request->bmRequestType_bit.direction);
+    case CONTROL_STAGE_ACK:  return tu_edpt_addr(0, 1 - request->bmRequestType_bit.direction);
+    default:                 return 0; // setup
+  }
+}
+
+// Return remaining time in ms of on-going control transfer, 0 if timed out. If abort is true, timed out transfer is
+// aborted and completed with XFER_RESULT_TIMEOUT
+static uint32_t control_xfer_timeout_process(bool abort) {
+  if (_ctrl_xfer.stage == CONTROL_STAGE_IDLE || _ctrl_xfer.timeout_ms == OSAL_TIMEOUT_WAIT_FOREVER) {
+    return OSAL_TIMEOUT_WAIT_FOREVER;
+  }
+
+  const uint8_t daddr = _ctrl_xfer.daddr;
+  const uint8_t rhport = usbh_get_rhport(daddr);
+  const uint32_t remaining = tu_timer_remaining(_ctrl_xfer.start_ms, _ctrl_xfer.timeout_ms, hcd_frame_number(rhport));
+  if (remaining) {
+    return remaining;
+  }
+
+  if (abort) {
+    TU_LOG_USBH("[%u:%u] Control transfer timeout\r\n", rhport, daddr);
+    hcd_edpt_abort_xfer(rhport, daddr, control_stage_ep_addr());
+    _control_xfer_complete(daddr, XFER_RESULT_TIMEOUT);
+  }
+
+  return 0;
+}
+
 static bool usbh_control_xfer_cb (uint8_t daddr, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes) {
   (void) ep_addr;
 
@@ -758,10 +1544,10 @@ static bool usbh_control_xfer_cb (uint8_t daddr, uint8_t ep_addr, xfer_result_t
         // Abort all pending transfers if SET_CONFIGURATION request
         // NOTE: should we force closing all non-control endpoints in the future?
         if (request->bRequest == TUSB_REQ_SET_CONFIGURATION && request->bmRequestType == 0x00) {
-          for(uint8_t epnum=1; epnum<CFG_TUH_ENDPOINT_MAX; epnum++) {
-            for(uint8_t dir=0; dir<2; dir++) {
-              tuh_edpt_abort_xfer(daddr, tu_edpt_addr(epnum, dir));
-            }
+          usbh_device_t const* dev = get_device(daddr);
+          for (uint8_t i = 0; dev && i < dev->ep_count; i++) {
+            uint8_t const ep = _usbh_edpts[dev->ep_base + i].ep_addr;
+            if (ep) tuh_edpt_abort_xfer(daddr, ep);
           }
         }
 
@@ -787,7 +1573,7 @@ bool tuh_edpt_xfer(tuh_xfer_t* xfer) {
   TU_VERIFY(daddr && ep_addr);
   TU_VERIFY(usbh_edpt_claim(daddr, ep_addr));
 
-  if (!usbh_edpt_xfer_with_callback(daddr, ep_addr, xfer->buffer, (uint16_t) xfer->buflen,
+  if (!usbh_edpt_xfer_with_callback(daddr, ep_addr, xfer->buffer, xfer->buflen,
                                     xfer->complete_cb, xfer->user_data)) {
     usbh_edpt_release(daddr, ep_addr);
     return false;
@@ -796,11 +1582,47 @@ bool tuh_edpt_xfer(tuh_xfer_t* xfer) {
   return true;
 }
 
+#if CFG_TUH_EDPT_ISO_XFER
+bool tuh_edpt_iso_xfer(tuh_iso_xfer_t* xfer) {
+  uint8_t const daddr = xfer->daddr;
+  uint8_t const ep_addr = xfer->ep_addr;
+  TU_VERIFY(daddr && tu_edpt_number(ep_addr) && xfer->packet_count && xfer->packets);
+
+  usbh_device_t* dev = get_device(daddr);
+  TU_VERIFY(dev);
+  usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+  TU_VERIFY(ep);
+  TU_VERIFY(usbh_edpt_claim(daddr, ep_addr));
+
+  // set before submitting since transfer can complete before hcd returns
+  ep->state.busy = 1;
+  ep->iso_xfer = xfer;
+  xfer->result = XFER_RESULT_INVALID;
+  xfer->actual_len = 0;
+
+  TU_LOG_USBH("  Queue EP %02X with %u iso packets ... \r\n", ep_addr, xfer->packet_count);
+  if (!hcd_edpt_iso_xfer(dev->rhport, daddr, ep_addr, xfer->buffer, xfer->packets, xfer->packet_count,
+                         &xfer->start_frame)) {
+    TU_LOG_USBH("FAILED\r\n");
+    ep->iso_xfer = NULL;
+    ep->state.busy = 0;
+    usbh_edpt_release(daddr, ep_addr);
+    return false;
+  }
+
+  TU_LOG_USBH("OK\r\n");
+  return true;
+}
+
+uint32_t tuh_frame_number(uint8_t daddr) {
+  return hcd_frame_number(usbh_get_rhport(daddr));
+}
+#endif
+
 bool tuh_edpt_abort_xfer(uint8_t daddr, uint8_t ep_addr) {
   TU_LOG_USBH("[%u] Aborted transfer on EP %02X\r\n", daddr, ep_addr);
 
   const uint8_t epnum = tu_edpt_number(ep_addr);
-  const uint8_t dir   = tu_edpt_dir(ep_addr);
 
   if (epnum == 0) {
     // Also include dev0 for aborting enumerating
@@ -808,18 +1630,36 @@ bool tuh_edpt_abort_xfer(uint8_t daddr, uint8_t ep_addr) {
 
     // control transfer: only 1 control at a time, check if we are aborting the current one
     TU_VERIFY(daddr == _ctrl_xfer.daddr && _ctrl_xfer.stage != CONTROL_STAGE_IDLE);
-    hcd_edpt_abort_xfer(rhport, daddr, ep_addr);
-    _set_control_xfer_stage(CONTROL_STAGE_IDLE); // reset control transfer state to idle
+    hcd_edpt_abort_xfer(rhport, daddr, control_stage_ep_addr());
+    control_xfer_next(); // reset control transfer state to idle, queued ones continue
   } else {
     usbh_device_t* dev = get_device(daddr);
     TU_VERIFY(dev);
+    usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+    TU_VERIFY(ep);
 
-    TU_VERIFY(dev->ep_status[epnum][dir].busy); // non-control skip if not busy
+    TU_VERIFY(ep->state.busy); // non-control skip if not busy
     hcd_edpt_abort_xfer(dev->rhport, daddr, ep_addr);
+#if CFG_TUH_PERIODIC_SCHED_SW
+    psched_remove(dev->rhport, ep);
+#endif
+#if CFG_TUH_EDPT_XFER_LARGE
+    ep->split.active = 0;
+#endif
+#if CFG_TUH_EDPT_XFER_QUEUE
+    // queued transfers are dropped without completion
+    osal_spin_lock(&_usbh_spin, false);
+    tu_varclr(&ep->queue);
+    osal_spin_unlock(&_usbh_spin, false);
+#endif
+
+#if CFG_TUH_EDPT_ISO_XFER
+    ep->iso_xfer = NULL;
+#endif
 
     // mark as ready and release endpoint if transfer is aborted
-    dev->ep_status[epnum][dir].busy = false;
-    tu_edpt_release(&dev->ep_status[epnum][dir], _usbh_mutex);
+    ep->state.busy = false;
+    tu_edpt_release(&ep->state, _usbh_mutex);
   }
 
   return true;
@@ -839,11 +1679,15 @@ uint8_t *usbh_get_enum_buf(void) {
 }
 
 void usbh_int_set(bool enabled) {
-  // TODO all host controller if multiple are used since they shared the same event queue
-  if (enabled) {
-    hcd_int_enable(_usbh_controller);
-  } else {
-    hcd_int_disable(_usbh_controller);
+  // all active controllers since they share the same event queue
+  for (uint8_t rhport = 0; rhport < TUP_USBIP_CONTROLLER_NUM; rhport++) {
+    if (tu_bit_test(_usbh_controller, rhport)) {
+      if (enabled) {
+        hcd_int_enable(rhport);
+      } else {
+        hcd_int_disable(rhport);
+      }
+    }
   }
 }
 
@@ -865,11 +1709,10 @@ bool usbh_edpt_claim(uint8_t dev_addr, uint8_t ep_addr) {
   // Note: addr0 only use tuh_control_xfer
   usbh_device_t* dev = get_device(dev_addr);
   TU_ASSERT(dev && dev->connected);
+  usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+  TU_ASSERT(ep);
 
-  uint8_t const epnum = tu_edpt_number(ep_addr);
-  uint8_t const dir = tu_edpt_dir(ep_addr);
-
-  TU_VERIFY(tu_edpt_claim(&dev->ep_status[epnum][dir], _usbh_mutex));
+  TU_VERIFY(tu_edpt_claim(&ep->state, _usbh_mutex));
   TU_LOG_USBH("[%u] Claimed EP 0x%02x\r\n", dev_addr, ep_addr);
 
   return true;
@@ -880,11 +1723,10 @@ bool usbh_edpt_release(uint8_t dev_addr, uint8_t ep_addr) {
   // Note: addr0 only use tuh_control_xfer
   usbh_device_t* dev = get_device(dev_addr);
   TU_VERIFY(dev && dev->connected);
+  usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+  TU_VERIFY(ep);
 
-  uint8_t const epnum = tu_edpt_number(ep_addr);
-  uint8_t const dir = tu_edpt_dir(ep_addr);
-
-  TU_VERIFY(tu_edpt_release(&dev->ep_status[epnum][dir], _usbh_mutex));
+  TU_VERIFY(tu_edpt_release(&ep->state, _usbh_mutex));
   TU_LOG_USBH("[%u] Released EP 0x%02x\r\n", dev_addr, ep_addr);
 
   return true;
@@ -892,19 +1734,18 @@ bool usbh_edpt_release(uint8_t dev_addr, uint8_t ep_addr) {
 
 // Submit an transfer
 // TODO call usbh_edpt_release if failed
-bool usbh_edpt_xfer_with_callback(uint8_t dev_addr, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes,
+bool usbh_edpt_xfer_with_callback(uint8_t dev_addr, uint8_t ep_addr, uint8_t* buffer, uint32_t total_bytes,
                                   tuh_xfer_cb_t complete_cb, uintptr_t user_data) {
   (void) complete_cb;
   (void) user_data;
 
   usbh_device_t* dev = get_device(dev_addr);
   TU_VERIFY(dev);
+  usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+  TU_VERIFY(ep);
+  tu_edpt_state_t* ep_state = &ep->state;
 
-  uint8_t const epnum = tu_edpt_number(ep_addr);
-  uint8_t const dir = tu_edpt_dir(ep_addr);
-  tu_edpt_state_t* ep_state = &dev->ep_status[epnum][dir];
-
-  TU_LOG_USBH("  Queue EP %02X with %u bytes ... \r\n", ep_addr, total_bytes);
+  TU_LOG_USBH("  Queue EP %02X with %u bytes ... \r\n", ep_addr, (unsigned int) total_bytes);
 
   // Attempt to transfer on a busy endpoint, sound like an race condition !
   TU_ASSERT(ep_state->busy == 0);
@@ -912,17 +1753,44 @@ bool usbh_edpt_xfer_with_callback(uint8_t dev_addr, uint8_t ep_addr, uint8_t* bu
   // Set busy first since the actual transfer can be complete before hcd_edpt_xfer()
   // could return and USBH task can preempt and clear the busy
   ep_state->busy = 1;
+  TU_TRACE(TU_TRACE_HCD_XFER, 0, (dev_addr << 8) | ep_addr, total_bytes);
 
 #if CFG_TUH_API_EDPT_XFER
-  dev->ep_callback[epnum][dir].complete_cb = complete_cb;
-  dev->ep_callback[epnum][dir].user_data   = user_data;
+  ep->complete_cb = complete_cb;
+  ep->user_data   = user_data;
 #endif
 
-  if (hcd_edpt_xfer(dev->rhport, dev_addr, ep_addr, buffer, total_bytes)) {
+  bool ret;
+#if CFG_TUH_EDPT_XFER_LARGE
+  ep->split.active = 0;
+  if (total_bytes > TUP_HCD_EDPT_XFER_MAX) {
+    // submit 1st part, the rest is continued by usbh task on each completion
+    ep->split.buffer    = buffer;
+    ep->split.remaining = total_bytes;
+    ep->split.xferred   = 0;
+    ep->split.active    = 1;
+    ret = xfer_split_submit(dev, ep, dev_addr);
+  } else
+#endif
+  if (total_bytes <= UINT16_MAX) {
+#if CFG_TUH_PERIODIC_SCHED_SW
+    ret = psched_xfer(dev->rhport, dev_addr, ep, buffer, (uint16_t) total_bytes);
+#else
+    ret = hcd_edpt_xfer(dev->rhport, dev_addr, ep_addr, buffer, (uint16_t) total_bytes);
+#endif
+  } else {
+    TU_LOG_USBH("  Transfer larger than 64KB requires CFG_TUH_EDPT_XFER_LARGE\r\n");
+    ret = false;
+  }
+
+  if (ret) {
     TU_LOG_USBH("OK\r\n");
     return true;
   } else {
     // HCD error, mark endpoint as ready to allow next transfer
+#if CFG_TUH_EDPT_XFER_LARGE
+    ep->split.active = 0;
+#endif
     ep_state->busy = 0;
     ep_state->claimed = 0;
     TU_LOG1("Failed\r\n");
@@ -931,6 +1799,74 @@ bool usbh_edpt_xfer_with_callback(uint8_t dev_addr, uint8_t ep_addr, uint8_t* bu
   }
 }
 
+#if CFG_TUH_EDPT_XFER_QUEUE
+bool usbh_edpt_xfer_queue(uint8_t dev_addr, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes) {
+  usbh_device_t* dev = get_device(dev_addr);
+  TU_VERIFY(dev && tu_edpt_number(ep_addr));
+  usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+  TU_VERIFY(ep);
+  TU_ASSERT(total_bytes <= TUP_HCD_EDPT_XFER_MAX);
+
+  osal_spin_lock(&_usbh_spin, false);
+  bool start = false;
+  bool accepted = true;
+  if (ep->state.busy && ep->queue.pending == 0) {
+    accepted = false; // busy with transfer of usbh_edpt_xfer()
+  } else if (!ep->queue.running) {
+    ep->queue.running = 1;
+    start = true;
+  } else if (ep->queue.count < CFG_TUH_EDPT_XFER_QUEUE) {
+    uint8_t const wr = (uint8_t) ((ep->queue.rd + ep->queue.count) % CFG_TUH_EDPT_XFER_QUEUE);
+    ep->queue.entry[wr].buffer = buffer;
+    ep->queue.entry[wr].len = total_bytes;
+    ep->queue.count++;
+  } else {
+    accepted = false; // queue is full
+  }
+  if (accepted) {
+    ep->queue.pending++;
+    ep->state.busy = 1;
+  }
+  osal_spin_unlock(&_usbh_spin, false);
+
+  TU_LOG_USBH("  Queue EP %02X with %u bytes (%u pending) %s\r\n", ep_addr, total_bytes, ep->queue.pending,
+              accepted ? "" : "FAILED");
+  TU_VERIFY(accepted);
+  TU_TRACE(TU_TRACE_HCD_XFER, 0, (dev_addr << 8) | ep_addr, total_bytes);
+
+  if (start) {
+#if CFG_TUH_API_EDPT_XFER
+    ep->complete_cb = NULL; // completion goes to class driver
+#endif
+#if CFG_TUH_EDPT_XFER_LARGE
+    ep->split.active = 0;
+#endif
+    if (!hcd_edpt_xfer(dev->rhport, dev_addr, ep_addr, buffer, total_bytes)) {
+      // drop it together with transfers queued meanwhile, completions of earlier ones may still be pending
+      osal_spin_lock(&_usbh_spin, false);
+      ep->queue.pending = (uint8_t) (ep->queue.pending - 1 - ep->queue.count);
+      ep->queue.count = 0;
+      ep->queue.running = 0;
+      if (ep->queue.pending == 0) {
+        ep->state.busy = 0;
+      }
+      osal_spin_unlock(&_usbh_spin, false);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+uint8_t usbh_edpt_xfer_queue_pending(uint8_t dev_addr, uint8_t ep_addr) {
+  usbh_device_t* dev = get_device(dev_addr);
+  TU_VERIFY(dev, 0);
+  usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+  TU_VERIFY(ep, 0);
+  return ep->queue.pending;
+}
+#endif
+
 static bool usbh_edpt_control_open(uint8_t dev_addr, uint8_t max_packet_size) {
   TU_LOG_USBH("[%u:%u] Open EP0 with Size = %u\r\n", usbh_get_rhport(dev_addr), dev_addr, max_packet_size);
   tusb_desc_endpoint_t ep0_desc = {
@@ -942,44 +1878,484 @@ static bool usbh_edpt_control_open(uint8_t dev_addr, uint8_t max_packet_size) {
     .bInterval        = 0
   };
 
-  return hcd_edpt_open(usbh_get_rhport(dev_addr), dev_addr, &ep0_desc);
-}
+  return hcd_edpt_open(usbh_get_rhport(dev_addr), dev_addr, &ep0_desc);
+}
+
+bool tuh_edpt_open(uint8_t dev_addr, tusb_desc_endpoint_t const* desc_ep) {
+  TU_ASSERT(tu_edpt_validate(desc_ep, tuh_speed_get(dev_addr)));
+
+  usbh_device_t* dev = get_device(dev_addr);
+  uint8_t const xfer_type = desc_ep->bmAttributes.xfer;
+  bool const is_periodic = (xfer_type == TUSB_XFER_INTERRUPT || xfer_type == TUSB_XFER_ISOCHRONOUS);
+
+#if CFG_TUH_PERIODIC_BUDGET
+  // admission control on root port, hub TT is checked by hcd when planning split transactions
+  usbh_edpt_t* ep = dev ? get_edpt(dev, desc_ep->bEndpointAddress) : NULL;
+  periodic_cost_t const cost = dev ? periodic_cost(dev, desc_ep) : (periodic_cost_t) { 0, 0 };
+  if (ep && cost.root && !periodic_fits(dev, cost.root, ep->bw, 0, 0)) {
+    TU_LOG_USBH("[%u:%u] EP %02x: periodic bandwidth exceeded (%u + %u > %u)\r\n", dev->rhport, dev_addr,
+                desc_ep->bEndpointAddress, _periodic_bw[dev->rhport] - ep->bw, cost.root, periodic_budget(dev->rhport));
+    return false;
+  }
+#endif
+
+  TU_VERIFY(hcd_edpt_open(usbh_get_rhport(dev_addr), dev_addr, desc_ep));
+
+#if CFG_TUH_PERIODIC_BUDGET
+  if (ep) {
+    periodic_release(dev->rhport, ep);
+    ep->bw = cost.root;
+    ep->tt_bw = cost.tt;
+    _periodic_bw[dev->rhport] = (uint16_t) (_periodic_bw[dev->rhport] + cost.root);
+  }
+#endif
+
+  if (dev && is_periodic) {
+    dev->ep_periodic[tu_edpt_dir(desc_ep->bEndpointAddress)] |= (uint16_t) TU_BIT(tu_edpt_number(desc_ep->bEndpointAddress));
+  }
+
+#if CFG_TUH_PERIODIC_SCHED_SW
+  usbh_edpt_t* sched_ep = dev ? get_edpt(dev, desc_ep->bEndpointAddress) : NULL;
+  if (sched_ep) {
+    psched_remove(dev->rhport, sched_ep);
+    sched_ep->psched.interval = 0;
+    if (xfer_type == TUSB_XFER_INTERRUPT) {
+      // 2^(bInterval-1) micro-frames for highspeed, bInterval frames for full/low speed
+      uint8_t const binterval = tu_max8(desc_ep->bInterval, 1);
+      uint16_t const interval = (dev->speed == TUSB_SPEED_HIGH) ?
+          (uint16_t) (TU_BIT(tu_min8((uint8_t) (binterval - 1), 15)) >> 3) : binterval;
+      sched_ep->psched.interval = tu_max16(interval, 1);
+      sched_ep->psched.daddr = dev_addr;
+      // first transfer is submitted right away
+      sched_ep->psched.start = (uint16_t) (hcd_frame_number(dev->rhport) - sched_ep->psched.interval);
+    }
+  }
+#endif
+
+  return true;
+}
+
+bool usbh_edpt_instance_set(uint8_t dev_addr, uint8_t ep_addr, uint8_t instance) {
+  usbh_device_t* dev = get_device(dev_addr);
+  TU_VERIFY(dev);
+  usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+  TU_VERIFY(ep);
+
+  ep->drv_inst = instance;
+  return true;
+}
+
+uint8_t usbh_edpt_instance(uint8_t dev_addr, uint8_t ep_addr) {
+  usbh_device_t const* dev = get_device(dev_addr);
+  usbh_edpt_t const* ep = dev ? get_edpt(dev, ep_addr) : NULL;
+  return ep ? ep->drv_inst : TUSB_INDEX_INVALID_8;
+}
+
+bool usbh_edpt_busy(uint8_t dev_addr, uint8_t ep_addr) {
+  usbh_device_t* dev = get_device(dev_addr);
+  TU_VERIFY(dev);
+  usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+  TU_VERIFY(ep);
+
+  return ep->state.busy;
+}
+
+//--------------------------------------------------------------------+
+// HCD Event Handler
+//--------------------------------------------------------------------+
+
+// TT serving a device on hub_port: downstream port of a multi-TT hub, 0 for single TT hub or root port
+static uint8_t split_tt_port(uint8_t hub_addr, uint8_t hub_port) {
+#if CFG_TUH_HUB
+  if (hub_addr && hub_is_multi_tt(hub_addr)) {
+    return hub_port;
+  }
+#endif
+  (void) hub_addr;
+  (void) hub_port;
+  return 0;
+}
+
+void hcd_devtree_get_info(uint8_t dev_addr, hcd_devtree_info_t* devtree_info) {
+  usbh_device_t const* dev = get_device(dev_addr);
+  if (dev) {
+    devtree_info->rhport = dev->rhport;
+    devtree_info->hub_addr = dev->hub_addr;
+    devtree_info->hub_port = dev->hub_port;
+    devtree_info->tt_port = split_tt_port(dev->hub_addr, dev->hub_port);
+    devtree_info->speed = dev->speed;
+  } else {
+    devtree_info->rhport = _dev0.rhport;
+    devtree_info->hub_addr = _dev0.hub_addr;
+    devtree_info->hub_port = _dev0.hub_port;
+    devtree_info->tt_port = split_tt_port(_dev0.hub_addr, _dev0.hub_port);
+    devtree_info->speed = _dev0.speed;
+  }
+}
+
+//--------------------------------------------------------------------+
+// Split Transaction Planner
+// Best case budget of USB 2.0 11.18: full speed bus carries at most 188 bytes per micro-frame and 1157 bytes of
+// periodic transactions per frame. Transaction runs on the full speed bus starting at the micro-frame after its
+// start-split. Each TT of a multi-TT hub is budgeted separately, interval is not taken into account (worst case every
+// frame).
+//--------------------------------------------------------------------+
+enum {
+  SPLIT_UFRAME_BYTES   = 188,
+  SPLIT_FRAME_BYTES    = 1157,
+  SPLIT_ISO_OVERHEAD   = 9,  // token + data packet framing
+  SPLIT_INTR_OVERHEAD  = 13, // token + data + handshake framing
+};
+
+static usbh_split_tt_t* split_tt_get(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port, bool allocate) {
+  uint8_t const tt_port = split_tt_port(hub_addr, hub_port);
+  usbh_split_tt_t* free_tt = NULL;
+  for (uint8_t i = 0; i < TU_ARRAY_SIZE(_split_tt); i++) {
+    usbh_split_tt_t* tt = &_split_tt[i];
+    if (tt->ep_count == 0) {
+      if (free_tt == NULL) {
+        free_tt = tt;
+      }
+    } else if (tt->rhport == rhport && tt->hub_addr == hub_addr && tt->tt_port == tt_port) {
+      return tt;
+    }
+  }
+
+  if (allocate && free_tt) {
+    tu_memclr(free_tt, sizeof(usbh_split_tt_t));
+    free_tt->rhport = rhport;
+    free_tt->hub_addr = hub_addr;
+    free_tt->tt_port = tt_port;
+    return free_tt;
+  }
+  return NULL;
+}
+
+// full speed bytes of a transaction, low speed is 8 times slower
+static uint16_t split_cost(uint8_t speed, uint8_t xfer_type, uint16_t max_packet_size) {
+  uint16_t const overhead = (xfer_type == TUSB_XFER_ISOCHRONOUS) ? SPLIT_ISO_OVERHEAD : SPLIT_INTR_OVERHEAD;
+  uint16_t bytes = (uint16_t) (max_packet_size + overhead);
+  if (speed == TUSB_SPEED_LOW) {
+    bytes = (uint16_t) (bytes * 8u);
+  }
+  return bytes;
+}
+
+// Compute schedule for transaction that runs on full speed bus from micro-frame 'first' for 'count' micro-frames
+static hcd_split_sched_t split_sched_make(uint8_t xfer_type, uint8_t ep_dir, uint8_t first, uint8_t count) {
+  hcd_split_sched_t sched;
+  uint8_t const span = (uint8_t) (TU_BIT(count) - 1);
+
+  if (xfer_type == TUSB_XFER_ISOCHRONOUS) {
+    if (ep_dir == TUSB_DIR_OUT) {
+      // one start-split per micro-frame carrying up to 188 bytes, no complete-split
+      sched.smask = (uint8_t) (span << (first - 1));
+      sched.cmask = 0;
+    } else {
+      // complete-split from the micro-frame after data starts, one per micro-frame of data
+      sched.smask = (uint8_t) TU_BIT(first - 1);
+      sched.cmask = (uint8_t) (span << (first + 1));
+    }
+  } else {
+    // interrupt: complete-split in the 3 micro-frames following FS transaction (EHCI 4.12.2.1)
+    sched.smask = (uint8_t) TU_BIT(first - 1);
+    sched.cmask = (uint8_t) (0x07u << (first + 1));
+  }
+
+  return sched;
+}
+
+// Last micro-frame (inclusive) that data can occupy so that all start/complete-splits are within the frame
+static uint8_t split_last_uframe(uint8_t xfer_type, uint8_t ep_dir) {
+  if (xfer_type == TUSB_XFER_ISOCHRONOUS) {
+    return (ep_dir == TUSB_DIR_OUT) ? 7 : 6;
+  }
+  return 4; // interrupt complete-splits up to 3 micro-frames later
+}
+
+static void split_tt_update(usbh_split_tt_t* tt, uint8_t first, uint16_t cost, bool reserve) {
+  for (uint8_t u = first; cost > 0; u++) {
+    uint16_t const chunk = tu_min16(cost, SPLIT_UFRAME_BYTES);
+    if (reserve) {
+      tt->fs_bytes[u] = (uint16_t) (tt->fs_bytes[u] + chunk);
+    } else {
+      tt->fs_bytes[u] = (uint16_t) (tt->fs_bytes[u] - tu_min16(chunk, tt->fs_bytes[u]));
+    }
+    cost = (uint16_t) (cost - chunk);
+  }
+}
+
+bool hcd_split_reserve(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port, uint8_t speed, uint8_t xfer_type,
+                       uint8_t ep_dir, uint16_t max_packet_size, hcd_split_sched_t* sched) {
+  TU_VERIFY(xfer_type == TUSB_XFER_ISOCHRONOUS || xfer_type == TUSB_XFER_INTERRUPT);
+  usbh_split_tt_t* tt = split_tt_get(rhport, hub_addr, hub_port, true);
+  TU_VERIFY(tt);
+
+  uint16_t const cost = split_cost(speed, xfer_type, max_packet_size);
+  uint8_t const count = (uint8_t) tu_div_ceil(cost, SPLIT_UFRAME_BYTES);
+  uint8_t const last  = split_last_uframe(xfer_type, ep_dir);
+
+  uint32_t total = 0;
+  for (uint8_t u = 0; u < 8; u++) {
+    total += tt->fs_bytes[u];
+  }
+  TU_VERIFY(total + cost <= SPLIT_FRAME_BYTES);
+
+  // pick the micro-frame that results in the lowest peak load. Interrupt can only use early micro-frames,
+  // isochronous is searched from the end of frame to leave them available.
+  bool const is_iso = (xfer_type == TUSB_XFER_ISOCHRONOUS);
+  uint8_t best_first = 0;
+  uint16_t best_peak = UINT16_MAX;
+  for (uint8_t i = 1; i + count - 1 <= last; i++) {
+    uint8_t const first = is_iso ? (uint8_t) (last + 2 - count - i) : i;
+    uint16_t remain = cost;
+    uint16_t peak = 0;
+    bool fit = true;
+    for (uint8_t u = first; remain > 0; u++) {
+      uint16_t const chunk = tu_min16(remain, SPLIT_UFRAME_BYTES);
+      uint16_t const load = (uint16_t) (tt->fs_bytes[u] + chunk);
+      if (load > SPLIT_UFRAME_BYTES) {
+        fit = false;
+        break;
+      }
+      peak = tu_max16(peak, load);
+      remain = (uint16_t) (remain - chunk);
+    }
+
+    if (fit && peak < best_peak) {
+      best_peak = peak;
+      best_first = first;
+    }
+  }
+  TU_VERIFY(best_first);
+
+  split_tt_update(tt, best_first, cost, true);
+  tt->ep_count++;
+  *sched = split_sched_make(xfer_type, ep_dir, best_first, count);
+
+  return true;
+}
+
+void hcd_split_release(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port, uint8_t speed, uint8_t xfer_type,
+                       uint8_t ep_dir, uint16_t max_packet_size, hcd_split_sched_t const* sched) {
+  (void) ep_dir;
+  usbh_split_tt_t* tt = split_tt_get(rhport, hub_addr, hub_port, false);
+  TU_VERIFY(tt && sched->smask, );
+
+  // first start-split is in the micro-frame before transaction begins
+  uint8_t first = 1;
+  while (!(sched->smask & TU_BIT(first - 1))) {
+    first++;
+  }
+  split_tt_update(tt, first, split_cost(speed, xfer_type, max_packet_size), false);
+  tt->ep_count--;
+}
+
+//--------------------------------------------------------------------+
+// Periodic Bandwidth Budget
+// Admission control of interrupt/isochronous endpoints against the periodic limit of USB 2.0 5.6.4 and 5.7.4: 90% of
+// a full speed frame, 80% of a highspeed micro-frame. Cost is averaged over the endpoint interval (capped at 8), exact
+// placement in (micro)frames is up to hcd. Endpoints behind a TT are also checked against the frame budget of the
+// split transaction planner above.
+//--------------------------------------------------------------------+
+#if CFG_TUH_PERIODIC_BUDGET
+enum {
+  PERIODIC_FS_FRAME_BYTES   = 1350, // 90% of 1500 bytes
+  PERIODIC_HS_UFRAME_BYTES  = 6000, // 80% of 7500 bytes
+  PERIODIC_HS_ISO_OVERHEAD  = 38,   // token + data packet with inter-packet delay, USB 2.0 5.11.3
+  PERIODIC_HS_INTR_OVERHEAD = 55,   // token + data + handshake
+};
+
+static uint16_t periodic_budget(uint8_t rhport) {
+  return (hcd_port_speed_get(rhport) == TUSB_SPEED_HIGH) ? PERIODIC_HS_UFRAME_BYTES : PERIODIC_FS_FRAME_BYTES;
+}
+
+// Cost of endpoint on root port (in unit of periodic_budget()) and on hub TT (full speed bytes per frame)
+static periodic_cost_t periodic_cost(usbh_device_t const* dev, tusb_desc_endpoint_t const* desc_ep) {
+  periodic_cost_t cost = { 0, 0 };
+  uint8_t const xfer_type = desc_ep->bmAttributes.xfer;
+  if (xfer_type != TUSB_XFER_INTERRUPT && xfer_type != TUSB_XFER_ISOCHRONOUS) {
+    return cost;
+  }
+
+  uint16_t const mps = tu_edpt_packet_size(desc_ep);
+  uint8_t const binterval = tu_max8(desc_ep->bInterval, 1);
+
+  // (micro)frames between transactions: 2^(bInterval-1) for highspeed and isochronous, bInterval frames for full/low
+  // speed interrupt. Capped at 8 since longer interval does not lower the peak of a (micro)frame much
+  uint8_t interval;
+  if (dev->speed == TUSB_SPEED_HIGH || xfer_type == TUSB_XFER_ISOCHRONOUS) {
+    interval = (uint8_t) TU_BIT(tu_min8((uint8_t) (binterval - 1), 3));
+  } else {
+    interval = tu_min8(binterval, 8);
+  }
+
+  uint16_t const hs_overhead = (xfer_type == TUSB_XFER_ISOCHRONOUS) ? PERIODIC_HS_ISO_OVERHEAD : PERIODIC_HS_INTR_OVERHEAD;
+  if (dev->speed == TUSB_SPEED_HIGH) {
+    uint32_t const bytes = (uint32_t) tu_edpt_hs_mult(desc_ep) * (mps + hs_overhead);
+    cost.root = (uint16_t) tu_div_ceil(bytes, interval);
+  } else if (hcd_port_speed_get(dev->rhport) == TUSB_SPEED_HIGH) {
+    // split transaction: data crosses highspeed bus once per frame i.e 8 micro-frames
+    cost.root = (uint16_t) tu_div_ceil(mps + hs_overhead, 8u * interval);
+    cost.tt = split_cost(dev->speed, xfer_type, mps);
+  } else {
+    cost.root = (uint16_t) tu_div_ceil(split_cost(dev->speed, xfer_type, mps), interval);
+  }
+
+  return cost;
+}
+
+// Check if cost fits in root port and TT, where 'free' is the amount currently held that will be replaced
+static bool periodic_fits(usbh_device_t const* dev, uint32_t root, uint32_t root_free, uint32_t tt, uint32_t tt_free) {
+  TU_VERIFY(_periodic_bw[dev->rhport] - root_free + root <= periodic_budget(dev->rhport));
+
+  if (tt) {
+    usbh_split_tt_t const* split_tt = split_tt_get(dev->rhport, dev->hub_addr, dev->hub_port, false);
+    uint32_t total = 0;
+    if (split_tt) {
+      for (uint8_t u = 0; u < 8; u++) {
+        total += split_tt->fs_bytes[u];
+      }
+    }
+    TU_VERIFY(total - tu_min32(tt_free, total) + tt <= SPLIT_FRAME_BYTES);
+  }
+
+  return true;
+}
+
+static void periodic_release(uint8_t rhport, usbh_edpt_t* ep) {
+  _periodic_bw[rhport] = (uint16_t) (_periodic_bw[rhport] - tu_min16(ep->bw, _periodic_bw[rhport]));
+  ep->bw = 0;
+  ep->tt_bw = 0;
+}
+
+static void periodic_release_all(usbh_device_t const* dev) {
+  for (uint8_t i = 0; i < dev->ep_count; i++) {
+    periodic_release(dev->rhport, &_usbh_edpts[dev->ep_base + i]);
+  }
+}
+
+bool tuh_edpt_bandwidth_fits(uint8_t daddr, tusb_desc_endpoint_t const* desc_ep) {
+  usbh_device_t const* dev = get_device(daddr);
+  TU_VERIFY(dev);
+
+  periodic_cost_t const cost = periodic_cost(dev, desc_ep);
+  usbh_edpt_t const* ep = get_edpt(dev, desc_ep->bEndpointAddress);
+  return periodic_fits(dev, cost.root, ep ? ep->bw : 0, cost.tt, ep ? ep->tt_bw : 0);
+}
+
+uint8_t tuh_interface_alt_best(uint8_t daddr, tusb_desc_interface_t const* desc_itf, uint16_t max_len) {
+  usbh_device_t const* dev = get_device(daddr);
+  TU_VERIFY(dev, TUSB_INDEX_INVALID_8);
+
+  uint8_t const itf_num = desc_itf->bInterfaceNumber;
+  uint8_t const* p_desc = (uint8_t const*) desc_itf;
+  uint8_t const* desc_end = p_desc + max_len;
+
+  uint8_t best_alt = TUSB_INDEX_INVALID_8;
+  uint32_t best_bw = 0;
+
+  // accumulated cost of the alternate setting being parsed, and bandwidth its endpoints currently hold
+  uint8_t alt = TUSB_INDEX_INVALID_8;
+  uint32_t root = 0, root_free = 0, tt = 0, tt_free = 0;
+
+  while (1) {
+    bool const is_end = (p_desc >= desc_end) || (tu_desc_len(p_desc) == 0);
+    uint8_t const desc_type = is_end ? 0 : tu_desc_type(p_desc);
+    bool const next_itf = is_end || (desc_type == TUSB_DESC_INTERFACE_ASSOCIATION) || (desc_type == TUSB_DESC_INTERFACE);
+
+    if (next_itf && alt != TUSB_INDEX_INVALID_8) {
+      // finish previous alternate setting
+      if ((best_alt == TUSB_INDEX_INVALID_8 || root > best_bw) && periodic_fits(dev, root, root_free, tt, tt_free)) {
+        best_alt = alt;
+        best_bw = root;
+      }
+      alt = TUSB_INDEX_INVALID_8;
+    }
+
+    if (is_end || desc_type == TUSB_DESC_INTERFACE_ASSOCIATION) {
+      break;
+    }
+
+    if (desc_type == TUSB_DESC_INTERFACE) {
+      tusb_desc_interface_t const* itf = (tusb_desc_interface_t const*) p_desc;
+      if (itf->bInterfaceNumber != itf_num) {
+        break;
+      }
+      alt = itf->bAlternateSetting;
+      root = root_free = tt = tt_free = 0;
+    } else if (desc_type == TUSB_DESC_ENDPOINT && alt != TUSB_INDEX_INVALID_8) {
+      tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+      periodic_cost_t const cost = periodic_cost(dev, desc_ep);
+      usbh_edpt_t const* ep = get_edpt(dev, desc_ep->bEndpointAddress);
+      root += cost.root;
+      tt += cost.tt;
+      if (ep) {
+        root_free += ep->bw;
+        tt_free += ep->tt_bw;
+      }
+    }
+
+    p_desc = tu_desc_next(p_desc);
+  }
 
-bool tuh_edpt_open(uint8_t dev_addr, tusb_desc_endpoint_t const* desc_ep) {
-  TU_ASSERT(tu_edpt_validate(desc_ep, tuh_speed_get(dev_addr)));
-  return hcd_edpt_open(usbh_get_rhport(dev_addr), dev_addr, desc_ep);
+  return best_alt;
 }
+#endif
 
-bool usbh_edpt_busy(uint8_t dev_addr, uint8_t ep_addr) {
-  usbh_device_t* dev = get_device(dev_addr);
-  TU_VERIFY(dev);
+// Queue transfer complete event, periodic endpoints use priority queue if enabled
+TU_ATTR_ALWAYS_INLINE static inline void queue_xfer_event(usbh_device_t const* dev, hcd_event_t const* event, bool in_isr) {
+#if CFG_TUH_TASK_PRIORITY_QUEUE_SZ
+  uint8_t const ep_addr = event->xfer_complete.ep_addr;
+  if (dev && tu_bit_test(dev->ep_periodic[tu_edpt_dir(ep_addr)], tu_edpt_number(ep_addr))) {
+    queue_event_priority(event, in_isr);
+    return;
+  }
+#else
+  (void) dev;
+#endif
+  queue_event(event, in_isr);
+}
 
-  uint8_t const epnum = tu_edpt_number(ep_addr);
-  uint8_t const dir = tu_edpt_dir(ep_addr);
+#if CFG_TUH_EDPT_XFER_QUEUE
+// Queued transfer is complete (in ISR): report it, then submit next queued transfer right away. After an error
+// the remaining queued transfers are not submitted but completed with the same result (failed for hcd error)
+static void xfer_queue_complete(usbh_device_t* dev, usbh_edpt_t* ep, hcd_event_t const* event, bool in_isr) {
+  queue_xfer_event(dev, event, in_isr);
 
-  return dev->ep_status[epnum][dir].busy;
-}
+  bool const success = (event->xfer_complete.result == XFER_RESULT_SUCCESS);
+  hcd_event_t aborted = *event;
+  aborted.xfer_complete.len = 0;
+  aborted.xfer_complete.result = success ? XFER_RESULT_FAILED : event->xfer_complete.result;
 
-//--------------------------------------------------------------------+
-// HCD Event Handler
-//--------------------------------------------------------------------+
+  while (1) {
+    uint8_t* buffer = NULL;
+    uint16_t len = 0;
+
+    osal_spin_lock(&_usbh_spin, in_isr);
+    bool const next = (ep->queue.count > 0);
+    if (next) {
+      buffer = ep->queue.entry[ep->queue.rd].buffer;
+      len = ep->queue.entry[ep->queue.rd].len;
+      ep->queue.rd = (uint8_t) ((ep->queue.rd + 1) % CFG_TUH_EDPT_XFER_QUEUE);
+      ep->queue.count--;
+    } else {
+      ep->queue.running = 0;
+    }
+    osal_spin_unlock(&_usbh_spin, in_isr);
 
-void hcd_devtree_get_info(uint8_t dev_addr, hcd_devtree_info_t* devtree_info) {
-  usbh_device_t const* dev = get_device(dev_addr);
-  if (dev) {
-    devtree_info->rhport = dev->rhport;
-    devtree_info->hub_addr = dev->hub_addr;
-    devtree_info->hub_port = dev->hub_port;
-    devtree_info->speed = dev->speed;
-  } else {
-    devtree_info->rhport = _dev0.rhport;
-    devtree_info->hub_addr = _dev0.hub_addr;
-    devtree_info->hub_port = _dev0.hub_port;
-    devtree_info->speed = _dev0.speed;
+    if (!next || (success && hcd_edpt_xfer(dev->rhport, event->dev_addr, ep->ep_addr, buffer, len))) {
+      return;
+    }
+    queue_xfer_event(dev, &aborted, in_isr);
   }
 }
+#endif
 
 TU_ATTR_FAST_FUNC void hcd_event_handler(hcd_event_t const* event, bool in_isr) {
+  TU_TRACE(TU_TRACE_HCD_EVENT, event->event_id,
+           event->event_id == HCD_EVENT_XFER_COMPLETE ? ((event->dev_addr << 8) | event->xfer_complete.ep_addr) : 0,
+           event->event_id == HCD_EVENT_XFER_COMPLETE ? event->xfer_complete.len : 0);
   switch (event->event_id) {
     case HCD_EVENT_DEVICE_REMOVE:
       // FIXME device remove from a hub need an HCD API for hcd to free up endpoint
@@ -992,12 +2368,181 @@ TU_ATTR_FAST_FUNC void hcd_event_handler(hcd_event_t const* event, bool in_isr)
       }
       break;
 
+    #if CFG_TUH_TASK_PRIORITY_QUEUE_SZ || CFG_TUH_EDPT_XFER_QUEUE
+    case HCD_EVENT_XFER_COMPLETE: {
+      usbh_device_t* dev = get_device(event->dev_addr);
+      #if CFG_TUH_EDPT_XFER_QUEUE
+      uint8_t const ep_addr = event->xfer_complete.ep_addr;
+      usbh_edpt_t* ep = (dev && tu_edpt_number(ep_addr)) ? get_edpt(dev, ep_addr) : NULL;
+      if (ep && ep->queue.running) {
+        xfer_queue_complete(dev, ep, event, in_isr);
+        return;
+      }
+      #endif
+      queue_xfer_event(dev, event, in_isr);
+      return;
+    }
+    #endif
+
     default: break;
   }
 
   queue_event(event, in_isr);
 }
 
+//--------------------------------------------------------------------+
+// Software Periodic Schedule
+// For hcd that starts an interrupt transfer as soon as it is queued. Transfer on an interrupt endpoint is held in a
+// timer wheel until one interval has passed since previous submission, then submitted by usbh task. Entry of frame F
+// is in slot F modulo wheel size, entries of later turns share the slot and are skipped until due.
+//--------------------------------------------------------------------+
+#if CFG_TUH_PERIODIC_SCHED_SW
+enum {
+  PSCHED_SLOT_MASK = CFG_TUH_PERIODIC_SCHED_SW - 1
+};
+
+TU_ATTR_ALWAYS_INLINE static inline uint8_t psched_id(usbh_edpt_t const* ep) {
+  return (uint8_t) (ep - _usbh_edpts + 1);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline bool psched_due(usbh_edpt_t const* ep, uint16_t now) {
+  return (uint16_t) (now - ep->psched.start) >= ep->psched.interval;
+}
+
+// Advance start to submission at frame 'now'. Cadence is kept if submission is late by less than one interval,
+// otherwise restarted from now
+static void psched_advance(usbh_edpt_t* ep, uint16_t now) {
+  uint16_t const interval = ep->psched.interval;
+  uint16_t const elapsed = (uint16_t) (now - ep->psched.start);
+  ep->psched.start = (elapsed < 2u * interval) ? (uint16_t) (ep->psched.start + interval) : now;
+}
+
+// must be called with _usbh_spin locked
+static void psched_unlink(uint8_t rhport, usbh_edpt_t* ep) {
+  uint8_t const id = psched_id(ep);
+  uint8_t* link = &_psched[rhport].slot[(uint16_t) (ep->psched.start + ep->psched.interval) & PSCHED_SLOT_MASK];
+  while (*link && *link != id) {
+    link = &_usbh_edpts[*link - 1].psched.next;
+  }
+  if (*link) {
+    *link = ep->psched.next;
+    _psched[rhport].count--;
+  }
+  ep->psched.next = 0;
+  ep->psched.held = 0;
+}
+
+// Submit to hcd now or hold until one interval has passed since previous submission
+static bool psched_xfer(uint8_t rhport, uint8_t daddr, usbh_edpt_t* ep, uint8_t* buffer, uint16_t len) {
+  if (ep->psched.interval == 0) {
+    return hcd_edpt_xfer(rhport, daddr, ep->ep_addr, buffer, len);
+  }
+
+  uint16_t const now = (uint16_t) hcd_frame_number(rhport);
+  if (psched_due(ep, now)) {
+    psched_advance(ep, now);
+    return hcd_edpt_xfer(rhport, daddr, ep->ep_addr, buffer, len);
+  }
+
+  ep->psched.buffer = buffer;
+  ep->psched.len = len;
+
+  usbh_psched_t* psched = &_psched[rhport];
+  osal_spin_lock(&_usbh_spin, false);
+  bool const was_empty = (psched->count == 0);
+  if (was_empty) {
+    psched->frame = now;
+  }
+  uint8_t* head = &psched->slot[(uint16_t) (ep->psched.start + ep->psched.interval) & PSCHED_SLOT_MASK];
+  ep->psched.next = *head;
+  ep->psched.held = 1;
+  *head = psched_id(ep);
+  psched->count++;
+  osal_spin_unlock(&_usbh_spin, false);
+
+  #if CFG_TUSB_OS != OPT_OS_NONE
+  // caller may not be usbh task which can be blocked on event queue without timeout
+  if (was_empty) {
+    hcd_event_t const wakeup = { .rhport = rhport, .event_id = USBH_EVENT_PRIORITY };
+    (void) stats_event_sent(0, osal_queue_send(_usbh_q, &wakeup, false));
+  }
+  #endif
+
+  return true;
+}
+
+static void psched_remove(uint8_t rhport, usbh_edpt_t* ep) {
+  if (ep->psched.held) {
+    osal_spin_lock(&_usbh_spin, false);
+    psched_unlink(rhport, ep);
+    osal_spin_unlock(&_usbh_spin, false);
+  }
+}
+
+static void psched_remove_all(usbh_device_t const* dev) {
+  for (uint8_t i = 0; i < dev->ep_count; i++) {
+    psched_remove(dev->rhport, &_usbh_edpts[dev->ep_base + i]);
+  }
+}
+
+// Submit transfers of slots whose frame has passed since last call. Return ms until the next non-empty slot
+static uint32_t psched_process(void) {
+  uint32_t wait_ms = UINT32_MAX;
+
+  for (uint8_t rhport = 0; rhport < TUP_USBIP_CONTROLLER_NUM; rhport++) {
+    usbh_psched_t* psched = &_psched[rhport];
+    if (psched->count == 0) {
+      continue;
+    }
+
+    uint16_t const now = (uint16_t) hcd_frame_number(rhport);
+    // one turn visits every slot
+    uint32_t const frame_count = tu_min32((uint16_t) (now - psched->frame) + 1u, CFG_TUH_PERIODIC_SCHED_SW);
+
+    for (uint32_t f = 0; f < frame_count; f++) {
+      uint8_t* const head = &psched->slot[(psched->frame + f) & PSCHED_SLOT_MASK];
+
+      while (1) {
+        // take one due endpoint from slot then submit it without holding the lock
+        usbh_edpt_t* ep = NULL;
+        osal_spin_lock(&_usbh_spin, false);
+        for (uint8_t id = *head; id; id = _usbh_edpts[id - 1].psched.next) {
+          if (psched_due(&_usbh_edpts[id - 1], now)) {
+            ep = &_usbh_edpts[id - 1];
+            psched_unlink(rhport, ep);
+            psched_advance(ep, now);
+            break;
+          }
+        }
+        osal_spin_unlock(&_usbh_spin, false);
+
+        if (ep == NULL) {
+          break;
+        }
+
+        uint8_t const daddr = ep->psched.daddr;
+        if (!hcd_edpt_xfer(rhport, daddr, ep->ep_addr, ep->psched.buffer, ep->psched.len)) {
+          // driver is already told the transfer is queued, complete it as failed instead
+          TU_LOG1("[%u:%u] EP %02X: held transfer failed\r\n", rhport, daddr, ep->ep_addr);
+          hcd_event_xfer_complete(daddr, ep->ep_addr, 0, XFER_RESULT_FAILED, false);
+        }
+      }
+    }
+    psched->frame = (uint16_t) (now + 1);
+
+    // distance to the next slot with entries, entries of a later turn only cause an early wake-up
+    for (uint16_t d = 1; d <= CFG_TUH_PERIODIC_SCHED_SW && psched->count; d++) {
+      if (psched->slot[(uint16_t) (now + d) & PSCHED_SLOT_MASK]) {
+        wait_ms = tu_min32(wait_ms, d);
+        break;
+      }
+    }
+  }
+
+  return wait_ms;
+}
+#endif
+
 //--------------------------------------------------------------------+
 // Descriptors Async
 //--------------------------------------------------------------------+
@@ -1209,10 +2754,6 @@ uint8_t tuh_descriptor_get_serial_string_sync(uint8_t daddr, uint16_t language_i
 // Detaching
 //--------------------------------------------------------------------+
 
-TU_ATTR_ALWAYS_INLINE static inline bool is_hub_addr(uint8_t daddr) {
-  return (CFG_TUH_HUB > 0) && (daddr > CFG_TUH_DEVICE_MAX);
-}
-
 //static void mark_removing_device_isr(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port) {
 //  for (uint8_t dev_id = 0; dev_id < TOTAL_DEVICES; dev_id++) {
 //    usbh_device_t *dev = &_usbh_devices[dev_id];
@@ -1264,10 +2805,10 @@ static void process_removing_device(uint8_t rhport, uint8_t hub_addr, uint8_t hu
         }
 
         hcd_device_close(rhport, daddr);
-        clear_device(dev);
+        clear_device(daddr);
 
         // abort on-going control xfer on this device if any
-        if (_ctrl_xfer.daddr == daddr) _set_control_xfer_stage(CONTROL_STAGE_IDLE);
+        if (_ctrl_xfer.daddr == daddr) control_xfer_next();
       }
     }
 
@@ -1297,26 +2838,33 @@ static void process_removing_device(uint8_t rhport, uint8_t hub_addr, uint8_t hu
 // Enumeration Process
 // is a lengthy process with a series of control transfer to configure
 // newly attached device.
-// NOTE: due to the shared control buffer, we must complete enumerating
-// one device before enumerating another one.
+// NOTE: due to the shared address 0 and control buffer, we must complete
+// enumerating one device before enumerating another one. Devices attached
+// meanwhile are queued as pending and their debouncing overlaps with the
+// current enumeration. Delays are done with a timer serviced by tuh_task().
 //--------------------------------------------------------------------+
 
 enum {
   ENUM_RESET_DELAY_MS = 50,       // USB specs: 10 to 50ms
   ENUM_DEBOUNCING_DELAY_MS = 450, // when plug/unplug a device, physical connection can be bouncing and may
                                   // generate a series of attach/detach event. This delay wait for stable connection
+  ENUM_ADDR_RECOVERY_MS = 2,      // USB specs 9.2.6.3
 };
 
 enum {
   ENUM_IDLE,
-  ENUM_RESET_1,         // 1st reset when attached
-  //ENUM_HUB_GET_STATUS_1,
+  ENUM_RESET_1,         // 1st reset of hub port when connection is stable
+  ENUM_ROOT_RESET_END,  // end reset of roothub port
+  ENUM_HUB_RESET_DELAY_1,
+  ENUM_HUB_GET_STATUS_1,
   ENUM_HUB_CLEAR_RESET_1,
   ENUM_ADDR0_DEVICE_DESC,
   ENUM_RESET_2,         // 2nd reset before set address (not used)
+  ENUM_HUB_RESET_DELAY_2,
   ENUM_HUB_GET_STATUS_2,
   ENUM_HUB_CLEAR_RESET_2,
   ENUM_SET_ADDR,
+  ENUM_ADDR_RECOVERY,
 
   ENUM_GET_DEVICE_DESC,
   ENUM_GET_9BYTE_CONFIG_DESC,
@@ -1326,8 +2874,192 @@ enum {
 };
 
 static bool enum_request_set_addr(void);
-static bool _parse_configuration_descriptor (uint8_t dev_addr, tusb_desc_configuration_t const* desc_cfg);
-static void enum_full_complete(void);
+static bool _parse_configuration_descriptor (uint8_t dev_addr, tusb_desc_configuration_t const* desc_cfg, uint16_t len);
+static void process_enumeration(tuh_xfer_t* xfer);
+
+// frame number is not available while roothub port is in reset
+static uint32_t enum_timer_now(void) {
+  #if CFG_TUSB_OS == OPT_OS_NONE
+  if (_enum.root_reset) {
+    return tusb_time_millis_api();
+  }
+  #endif
+  return hcd_frame_number(_dev0.rhport);
+}
+
+static void enum_timer_start(uint16_t ms, bool retry) {
+  _enum.timer_start = enum_timer_now();
+  _enum.timer_ms = ms;
+  _enum.timer_retry = retry ? 1 : 0;
+  _enum.timer_armed = 1;
+}
+
+// continue enumeration with next_state after ms
+static void enum_delay(uint8_t daddr, uint16_t ms, uint8_t next_state) {
+  tu_memclr(&_enum.xfer, sizeof(tuh_xfer_t));
+  _enum.xfer.daddr = daddr;
+  _enum.xfer.result = XFER_RESULT_SUCCESS;
+  _enum.xfer.complete_cb = process_enumeration;
+  _enum.xfer.user_data = next_state;
+  enum_timer_start(ms, false);
+}
+
+// Class driver of enumerating device continues its set config with complete_cb after ms e.g hub power good.
+bool usbh_enum_delay(uint8_t daddr, uint16_t ms, tuh_xfer_cb_t complete_cb, uintptr_t user_data) {
+  TU_VERIFY(_dev0.enumerating && _enum.daddr == daddr && !_enum.timer_armed);
+  tu_memclr(&_enum.xfer, sizeof(tuh_xfer_t));
+  _enum.xfer.daddr = daddr;
+  _enum.xfer.result = XFER_RESULT_SUCCESS;
+  _enum.xfer.complete_cb = complete_cb;
+  _enum.xfer.user_data = user_data;
+  enum_timer_start(ms, false);
+  return true;
+}
+
+#if CFG_TUH_HUB
+bool usbh_enum_is_hub_port(uint8_t hub_addr, uint8_t hub_port) {
+  return _dev0.enumerating && _dev0.hub_addr == hub_addr && _dev0.hub_port == hub_port;
+}
+#endif
+
+static bool enum_timer_pending(void) {
+  return _enum.timer_armed || _enum.timeout_armed || (_enum.pending_count > 0);
+}
+
+static void enum_pending_add(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port) {
+  uint32_t const now = hcd_frame_number(rhport);
+
+  for (uint8_t i = 0; i < _enum.pending_count; i++) {
+    usbh_enum_pending_t* pending = &_enum.pending[i];
+    if (pending->rhport == rhport && pending->hub_addr == hub_addr && pending->hub_port == hub_port) {
+      pending->attach_ms = now; // duplicated attach, connection is bouncing: start debouncing over
+      return;
+    }
+  }
+
+  TU_ASSERT(_enum.pending_count < CFG_TUH_ENUM_PENDING_MAX,);
+  usbh_enum_pending_t* pending = &_enum.pending[_enum.pending_count++];
+  pending->rhport = rhport;
+  pending->hub_addr = hub_addr;
+  pending->hub_port = hub_port;
+  pending->attach_ms = now;
+}
+
+// drop pending devices under unplugged rhport:hub_addr:hub_port, hub_addr = 0 means roothub and hub_port = 0 means
+// all ports of the hub. Devices of a removed downstream hub are dropped when dequeued.
+static void enum_pending_remove(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port) {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < _enum.pending_count; i++) {
+    usbh_enum_pending_t const* pending = &_enum.pending[i];
+    bool const removed = (pending->rhport == rhport) &&
+                         (hub_addr == 0 || (pending->hub_addr == hub_addr && (hub_port == 0 || pending->hub_port == hub_port)));
+    if (!removed) {
+      _enum.pending[count++] = *pending;
+    }
+  }
+  _enum.pending_count = count;
+}
+
+// Run enumeration timer & timeout, start next pending device if idle.
+// Return time in ms until timer expires, tuh_task() should not wait for event longer than that.
+static uint32_t enum_process(void) {
+  bool const ctrl_idle = (_ctrl_xfer.stage == CONTROL_STAGE_IDLE);
+
+  if (!_dev0.enumerating) {
+    // enumeration is complete or device is unplugged
+    enum_full_complete();
+
+    // control pipe can be used by a mounted device, its completion will come as an event
+    while (_enum.pending_count > 0 && ctrl_idle) {
+      usbh_enum_pending_t const next = _enum.pending[0];
+      _enum.pending_count--;
+      memmove(&_enum.pending[0], &_enum.pending[1], _enum.pending_count * sizeof(usbh_enum_pending_t));
+
+      #if CFG_TUH_HUB
+      if (next.hub_addr != 0) {
+        usbh_device_t const* hub = get_device(next.hub_addr);
+        if (!(hub && hub->connected)) continue; // parent hub is unplugged
+      }
+      #endif
+
+      enum_new_device(next.rhport, next.hub_addr, next.hub_port, next.attach_ms);
+    }
+
+    if (!_dev0.enumerating) return OSAL_TIMEOUT_WAIT_FOREVER;
+  }
+
+  uint32_t const now = hcd_frame_number(_dev0.rhport);
+  uint32_t wait_ms = OSAL_TIMEOUT_WAIT_FOREVER;
+
+  #if CFG_TUH_ENUM_TIMEOUT_MS
+  if (_enum.timeout_armed && !_enum.root_reset) {
+    uint32_t const elapsed = now - _enum.start_ms;
+    if (elapsed >= CFG_TUH_ENUM_TIMEOUT_MS) {
+      TU_LOG1("[%u:%u:%u] Enumeration timeout\r\n", _dev0.rhport, _dev0.hub_addr, _dev0.hub_port);
+      (void) tuh_edpt_abort_xfer(_enum.daddr, 0);
+      enum_full_complete();
+      return 0; // next pending device can start right away
+    }
+    wait_ms = CFG_TUH_ENUM_TIMEOUT_MS - elapsed;
+  }
+  #endif
+
+  if (_enum.timer_armed) {
+    uint32_t const remaining = tu_timer_remaining(_enum.timer_start, _enum.timer_ms, enum_timer_now());
+    if (remaining) {
+      return tu_min32(wait_ms, remaining);
+    }
+
+    // next step requires control pipe, except ending roothub port reset
+    if (!ctrl_idle && !_enum.root_reset) return 1;
+
+    _enum.timer_armed = 0;
+    tuh_xfer_t xfer = _enum.xfer; // timer can be re-armed by this step
+    if (_enum.timer_retry) {
+      if (!tuh_control_xfer(&xfer)) {
+        enum_full_complete();
+      }
+    } else {
+      xfer.complete_cb(&xfer);
+    }
+    wait_ms = 0;
+  }
+
+  return wait_ms;
+}
+
+#if CFG_TUH_DESC_CACHE
+// Find cached descriptors of device. If not found, an entry (unused or least recently used) is prepared to store
+// descriptors read by this enumeration
+static bool desc_cache_lookup(tusb_desc_device_t const* desc_device) {
+  uint8_t victim = 0;
+  _desc_cache_tick++;
+
+  for (uint8_t i = 0; i < CFG_TUH_DESC_CACHE; i++) {
+    usbh_desc_cache_t* entry = &_desc_cache[i];
+    if (entry->config_len && 0 == memcmp(&entry->desc_device, desc_device, sizeof(tusb_desc_device_t))) {
+      entry->last_used = _desc_cache_tick;
+      _enum.cache_idx = i;
+      _enum.config_desc = _usbh_epbuf.desc_cache[i].config;
+      _enum.config_len = entry->config_len;
+      return true;
+    }
+
+    usbh_desc_cache_t const* candidate = &_desc_cache[victim];
+    if (candidate->config_len && (!entry->config_len || entry->last_used < candidate->last_used)) {
+      victim = i;
+    }
+  }
+
+  usbh_desc_cache_t* entry = &_desc_cache[victim];
+  entry->desc_device = *desc_device;
+  entry->config_len = 0;
+  entry->last_used = _desc_cache_tick;
+  _enum.cache_idx = victim;
+
+  return false;
+}
+#endif
 
 // process device enumeration
 static void process_enumeration(tuh_xfer_t* xfer) {
@@ -1336,32 +3068,60 @@ static void process_enumeration(tuh_xfer_t* xfer) {
     ATTEMPT_COUNT_MAX = 3,
     ATTEMPT_DELAY_MS = 100
   };
-  static uint8_t failed_count = 0;
 
   if (XFER_RESULT_SUCCESS != xfer->result) {
     // retry if not reaching max attempt
-    bool retry = _dev0.enumerating && (failed_count < ATTEMPT_COUNT_MAX);
-    if ( retry ) {
-      failed_count++;
-      tusb_time_delay_ms_api(ATTEMPT_DELAY_MS); // delay a bit
-      TU_LOG1("Enumeration attempt %u\r\n", failed_count);
-      retry = tuh_control_xfer(xfer);
-    }
-
-    if (!retry) {
+    if (_dev0.enumerating && (_enum.failed_count < ATTEMPT_COUNT_MAX)) {
+      _enum.failed_count++;
+      TU_LOG1("Enumeration attempt %u\r\n", _enum.failed_count);
+
+      // re-submit the same request after a bit of delay
+      _enum.request = *xfer->setup;
+      _enum.xfer = *xfer;
+      _enum.xfer.setup = &_enum.request;
+      enum_timer_start(ATTEMPT_DELAY_MS, true);
+    } else {
+      #if CFG_TUH_DESC_CACHE
+      // cached descriptor may be outdated
+      if (_enum.cache_idx < CFG_TUH_DESC_CACHE) {
+        _desc_cache[_enum.cache_idx].config_len = 0;
+      }
+      #endif
       enum_full_complete();
     }
 
     return;
   }
-  failed_count = 0;
+  _enum.failed_count = 0;
 
   uint8_t const daddr = xfer->daddr;
   uintptr_t const state = xfer->user_data;
 
   switch (state) {
+    case ENUM_ROOT_RESET_END:
+      _enum.root_reset = 0;
+      hcd_port_reset_end(_dev0.rhport);
+      _enum.start_ms = hcd_frame_number(_dev0.rhport); // enumeration timeout is counted after reset
+
+      // wait until device connection is stable
+      enum_delay(0, ENUM_DEBOUNCING_DELAY_MS, ENUM_ADDR0_DEVICE_DESC);
+      break;
+
     #if CFG_TUH_HUB
-    //case ENUM_HUB_GET_STATUS_1: break;
+    case ENUM_RESET_1:
+      TU_ASSERT(hub_port_reset(_dev0.hub_addr, _dev0.hub_port, process_enumeration, ENUM_HUB_RESET_DELAY_1),);
+      break;
+
+    case ENUM_HUB_RESET_DELAY_1:
+    case ENUM_HUB_RESET_DELAY_2:
+      // wait for hub to complete port reset
+      enum_delay(0, ENUM_RESET_DELAY_MS, (uint8_t) (state + 1));
+      break;
+
+    case ENUM_HUB_GET_STATUS_1:
+      TU_ASSERT(hub_port_get_status(_dev0.hub_addr, _dev0.hub_port, _usbh_epbuf.ctrl,
+                                    process_enumeration, ENUM_HUB_CLEAR_RESET_1),);
+      break;
 
     case ENUM_HUB_CLEAR_RESET_1: {
       hub_port_status_response_t port_status;
@@ -1376,16 +3136,20 @@ static void process_enumeration(tuh_xfer_t* xfer) {
       _dev0.speed = (port_status.status.high_speed) ? TUSB_SPEED_HIGH :
                     (port_status.status.low_speed) ? TUSB_SPEED_LOW : TUSB_SPEED_FULL;
 
-      // Acknowledge Port Reset Change
       if (port_status.change.reset) {
-        hub_port_clear_reset_change(_dev0.hub_addr, _dev0.hub_port,
-                                    process_enumeration, ENUM_ADDR0_DEVICE_DESC);
+        // Acknowledge Port Reset Change
+        TU_ASSERT(hub_port_clear_reset_change(_dev0.hub_addr, _dev0.hub_port,
+                                              process_enumeration, ENUM_ADDR0_DEVICE_DESC),);
+      } else if (port_status.status.port_enable) {
+        // reset change is already acknowledged
+        enum_delay(0, 0, ENUM_ADDR0_DEVICE_DESC);
+      } else {
+        enum_full_complete();
       }
       break;
     }
 
     case ENUM_HUB_GET_STATUS_2:
-      tusb_time_delay_ms_api(ENUM_RESET_DELAY_MS);
       TU_ASSERT(hub_port_get_status(_dev0.hub_addr, _dev0.hub_port, _usbh_epbuf.ctrl,
                                     process_enumeration, ENUM_HUB_CLEAR_RESET_2),);
       break;
@@ -1404,6 +3168,17 @@ static void process_enumeration(tuh_xfer_t* xfer) {
     #endif
 
     case ENUM_ADDR0_DEVICE_DESC: {
+      if (_dev0.hub_addr == 0) {
+        // device unplugged from roothub while debouncing
+        if (!hcd_port_connect_status(_dev0.rhport)) {
+          enum_full_complete();
+          return;
+        }
+
+        _dev0.speed = hcd_port_speed_get(_dev0.rhport);
+        TU_LOG_USBH("%s Speed\r\n", tu_str_speed[_dev0.speed]);
+      }
+
       // TODO probably doesn't need to open/close each enumeration
       uint8_t const addr0 = 0;
       TU_ASSERT(usbh_edpt_control_open(addr0, 8),);
@@ -1430,9 +3205,8 @@ static void process_enumeration(tuh_xfer_t* xfer) {
         }
 #if CFG_TUH_HUB
         else {
-          // after RESET_DELAY the hub_port_reset() already complete
           TU_ASSERT( hub_port_reset(_dev0.hub_addr, _dev0.hub_port,
-                                    process_enumeration, ENUM_HUB_GET_STATUS_2), );
+                                    process_enumeration, ENUM_HUB_RESET_DELAY_2), );
           break;
         }
 #endif
@@ -1443,25 +3217,32 @@ static void process_enumeration(tuh_xfer_t* xfer) {
       enum_request_set_addr();
       break;
 
-    case ENUM_GET_DEVICE_DESC: {
-      // Allow 2ms for address recovery time, Ref USB Spec 9.2.6.3
-      tusb_time_delay_ms_api(2);
-
+    case ENUM_ADDR_RECOVERY: {
       const uint8_t new_addr = (uint8_t) tu_le16toh(xfer->setup->wValue);
 
       usbh_device_t* new_dev = get_device(new_addr);
       TU_ASSERT(new_dev,);
       new_dev->addressed = 1;
+      _enum.daddr = new_addr;
 
       // Close device 0
       hcd_device_close(_dev0.rhport, 0);
 
+      // Allow 2ms for address recovery time, Ref USB Spec 9.2.6.3
+      enum_delay(new_addr, ENUM_ADDR_RECOVERY_MS, ENUM_GET_DEVICE_DESC);
+      break;
+    }
+
+    case ENUM_GET_DEVICE_DESC: {
+      usbh_device_t* new_dev = get_device(daddr);
+      TU_ASSERT(new_dev,);
+
       // open control pipe for new address
-      TU_ASSERT(usbh_edpt_control_open(new_addr, new_dev->ep0_size),);
+      TU_ASSERT(usbh_edpt_control_open(daddr, new_dev->ep0_size),);
 
       // Get full device descriptor
       TU_LOG_USBH("Get Device Descriptor\r\n");
-      TU_ASSERT(tuh_descriptor_get_device(new_addr, _usbh_epbuf.ctrl, sizeof(tusb_desc_device_t),
+      TU_ASSERT(tuh_descriptor_get_device(daddr, _usbh_epbuf.ctrl, sizeof(tusb_desc_device_t),
                                           process_enumeration, ENUM_GET_9BYTE_CONFIG_DESC),);
       break;
     }
@@ -1477,6 +3258,18 @@ static void process_enumeration(tuh_xfer_t* xfer) {
       dev->i_product = desc_device->iProduct;
       dev->i_serial = desc_device->iSerialNumber;
 
+      _enum.config_desc = _usbh_epbuf.ctrl;
+      _enum.config_len = 0;
+
+      #if CFG_TUH_DESC_CACHE
+      // known device: skip reading configuration descriptor
+      if (desc_cache_lookup(desc_device)) {
+        TU_LOG_USBH("Configuration Descriptor found in cache\r\n");
+        TU_ASSERT(tuh_configuration_set(daddr, CONFIG_NUM, process_enumeration, ENUM_CONFIG_DRIVER),);
+        break;
+      }
+      #endif
+
       // Get 9-byte for total length
       uint8_t const config_idx = CONFIG_NUM - 1;
       TU_LOG_USBH("Get Configuration[0] Descriptor (9 bytes)\r\n");
@@ -1492,18 +3285,39 @@ static void process_enumeration(tuh_xfer_t* xfer) {
       uint16_t const total_len = tu_le16toh(
           tu_unaligned_read16(desc_config + offsetof(tusb_desc_configuration_t, wTotalLength)));
 
-      // TODO not enough buffer to hold configuration descriptor
-      TU_ASSERT(total_len <= CFG_TUH_ENUMERATION_BUFSIZE,);
+      uint16_t bufsize = CFG_TUH_ENUMERATION_BUFSIZE;
+      #if CFG_TUH_DESC_CACHE
+      // read directly into cache entry, which can hold larger descriptor
+      if (_enum.cache_idx < CFG_TUH_DESC_CACHE) {
+        _enum.config_desc = _usbh_epbuf.desc_cache[_enum.cache_idx].config;
+        bufsize = CFG_TUH_DESC_CACHE_BUFSIZE;
+      }
+      #endif
+
+      // Descriptor does not fit: only read first part, interfaces within it are still usable
+      uint16_t const len = tu_min16(total_len, bufsize);
+      if (len < total_len) {
+        TU_LOG1("Configuration Descriptor (%u bytes) is larger than buffer (%u bytes)\r\n", total_len, bufsize);
+        _enum.cache_idx = TUSB_INDEX_INVALID_8; // do not cache partial descriptor
+      }
 
       // Get full configuration descriptor
       uint8_t const config_idx = CONFIG_NUM - 1;
       TU_LOG_USBH("Get Configuration[0] Descriptor\r\n");
-      TU_ASSERT(tuh_descriptor_get_configuration(daddr, config_idx, _usbh_epbuf.ctrl, total_len,
+      TU_ASSERT(tuh_descriptor_get_configuration(daddr, config_idx, _enum.config_desc, len,
                                                  process_enumeration, ENUM_SET_CONFIG),);
       break;
     }
 
     case ENUM_SET_CONFIG:
+      _enum.config_len = (uint16_t) xfer->actual_len;
+
+      #if CFG_TUH_DESC_CACHE
+      if (_enum.cache_idx < CFG_TUH_DESC_CACHE) {
+        _desc_cache[_enum.cache_idx].config_len = _enum.config_len;
+      }
+      #endif
+
       TU_ASSERT(tuh_configuration_set(daddr, CONFIG_NUM, process_enumeration, ENUM_CONFIG_DRIVER),);
       break;
 
@@ -1512,11 +3326,14 @@ static void process_enumeration(tuh_xfer_t* xfer) {
       usbh_device_t* dev = get_device(daddr);
       TU_ASSERT(dev,);
 
+      // class drivers can take their time with set_config
+      _enum.timeout_armed = 0;
+
       dev->configured = 1;
 
       // Parse configuration & set up drivers
       // driver_open() must not make any usb transfer
-      TU_ASSERT(_parse_configuration_descriptor(daddr, (tusb_desc_configuration_t*) _usbh_epbuf.ctrl),);
+      TU_ASSERT(_parse_configuration_descriptor(daddr, (tusb_desc_configuration_t*) _enum.config_desc, _enum.config_len),);
 
       // Start the Set Configuration process for interfaces (itf = TUSB_INDEX_INVALID_8)
       // Since driver can perform control transfer within its set_config, this is done asynchronously.
@@ -1535,54 +3352,49 @@ static void process_enumeration(tuh_xfer_t* xfer) {
 
 
 
-static bool enum_new_device(hcd_event_t* event) {
-  _dev0.rhport = event->rhport;
-  _dev0.hub_addr = event->connection.hub_addr;
-  _dev0.hub_port = event->connection.hub_port;
-
-  if (_dev0.hub_addr == 0) {
-    // connected directly to roothub
-    hcd_port_reset(_dev0.rhport);
-
-    // Since we are in middle of rhport reset, frame number is not available yet.
-    // need to depend on tusb_time_millis_api()
-    tusb_time_delay_ms_api(ENUM_RESET_DELAY_MS);
-
-    hcd_port_reset_end(_dev0.rhport);
+static void enum_new_device(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port, uint32_t attach_ms) {
+  _dev0.rhport = rhport;
+  _dev0.hub_addr = hub_addr;
+  _dev0.hub_port = hub_port;
+  _dev0.enumerating = 1;
 
-    // wait until device connection is stable TODO non blocking
-    tusb_time_delay_ms_api(ENUM_DEBOUNCING_DELAY_MS);
+  _enum.daddr = 0;
+  _enum.failed_count = 0;
+  _enum.timer_armed = 0;
+  _enum.cache_idx = TUSB_INDEX_INVALID_8;
 
-    // device unplugged while delaying
-    if (!hcd_port_connect_status(_dev0.rhport)) {
-      enum_full_complete();
-      return true;
-    }
+  if (hub_addr == 0) {
+    (void) attach_ms;
 
-    _dev0.speed = hcd_port_speed_get(_dev0.rhport);
-    TU_LOG_USBH("%s Speed\r\n", tu_str_speed[_dev0.speed]);
+    // connected directly to roothub
+    hcd_port_reset(rhport);
 
-    // fake transfer to kick-off the enumeration process
-    tuh_xfer_t xfer;
-    xfer.daddr = 0;
-    xfer.result = XFER_RESULT_SUCCESS;
-    xfer.user_data = ENUM_ADDR0_DEVICE_DESC;
+    #if CFG_TUSB_OS == OPT_OS_NONE
+    // Since we are in middle of rhport reset, frame number is not available yet. End reset with a timer clocked by
+    // tusb_time_millis_api() instead of busy waiting, so that other controllers and devices are serviced meanwhile.
+    _enum.root_reset = 1;
+    enum_delay(0, ENUM_RESET_DELAY_MS, ENUM_ROOT_RESET_END);
+    #else
+    // tusb_time_millis_api() may not be implemented with RTOS, host task is blocked while waiting
+    tusb_time_delay_ms_api(ENUM_RESET_DELAY_MS);
+    hcd_port_reset_end(rhport);
 
-    process_enumeration(&xfer);
+    // wait until device connection is stable
+    enum_delay(0, ENUM_DEBOUNCING_DELAY_MS, ENUM_ADDR0_DEVICE_DESC);
+    #endif
   }
 #if CFG_TUH_HUB
   else {
-    // connected via external hub
-    // wait until device connection is stable TODO non blocking
-    tusb_time_delay_ms_api(ENUM_DEBOUNCING_DELAY_MS);
-
-    // ENUM_HUB_GET_STATUS
-    TU_ASSERT(hub_port_get_status(_dev0.hub_addr, _dev0.hub_port, _usbh_epbuf.ctrl,
-                                  process_enumeration, ENUM_HUB_CLEAR_RESET_1));
+    // connected via external hub: port is reset once connection is stable. Debouncing is counted from the attach
+    // event, which may already be passed while waiting in pending queue
+    uint32_t const elapsed = hcd_frame_number(rhport) - attach_ms;
+    uint16_t const delay_ms = (elapsed < ENUM_DEBOUNCING_DELAY_MS) ? (uint16_t) (ENUM_DEBOUNCING_DELAY_MS - elapsed) : 0;
+    enum_delay(0, delay_ms, ENUM_RESET_1);
   }
 #endif // hub
 
-  return true;
+  _enum.start_ms = hcd_frame_number(rhport);
+  _enum.timeout_armed = (CFG_TUH_ENUM_TIMEOUT_MS > 0) ? 1 : 0;
 }
 
 static uint8_t get_new_address(bool is_hub) {
@@ -1637,21 +3449,106 @@ static bool enum_request_set_addr(void) {
       .setup       = &request,
       .buffer      = NULL,
       .complete_cb = process_enumeration,
-      .user_data   = ENUM_GET_DEVICE_DESC
+      .user_data   = ENUM_ADDR_RECOVERY
   };
 
   TU_ASSERT(tuh_control_xfer(&xfer));
   return true;
 }
 
-static bool _parse_configuration_descriptor(uint8_t dev_addr, tusb_desc_configuration_t const* desc_cfg) {
+// Allocate a contiguous range of endpoint pool for all non-control endpoints in configuration descriptor
+static bool edpt_alloc(usbh_device_t* dev, uint8_t const* p_desc, uint8_t const* desc_end) {
+  uint16_t ep_bitmap[2] = { 0, 0 };
+  uint8_t count = 0;
+
+  while (p_desc < desc_end && tu_desc_len(p_desc)) {
+    if (TUSB_DESC_ENDPOINT == tu_desc_type(p_desc)) {
+      uint8_t const ep_addr = ((tusb_desc_endpoint_t const*) p_desc)->bEndpointAddress;
+      uint8_t const epnum = tu_edpt_number(ep_addr);
+      uint8_t const dir = tu_edpt_dir(ep_addr);
+      // endpoint can appear in multiple alternate settings
+      if (epnum && !tu_bit_test(ep_bitmap[dir], epnum)) {
+        ep_bitmap[dir] |= (uint16_t) TU_BIT(epnum);
+        count++;
+      }
+    }
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // release previous range if any, then find first free range that fits
+  periodic_release_all(dev);
+  tu_memclr(&_usbh_edpts[dev->ep_base], dev->ep_count * sizeof(usbh_edpt_t));
+  dev->ep_base = 0;
+  dev->ep_count = 0;
+
+  uint8_t base = 0;
+  uint8_t run = 0;
+  for (uint8_t i = 0; i < CFG_TUH_ENDPOINT_POOL_SIZE && run < count; i++) {
+    if (_usbh_edpts[i].ep_addr) {
+      base = (uint8_t) (i + 1);
+      run = 0;
+    } else {
+      run++;
+    }
+  }
+
+  if (run < count) {
+    TU_LOG1("Not enough endpoint pool for %u endpoints, increase CFG_TUH_ENDPOINT_POOL_SIZE\r\n", count);
+    return false;
+  }
+
+  dev->ep_base = base;
+  dev->ep_count = count;
+
+  for (uint8_t dir = 0; dir < 2; dir++) {
+    for (uint8_t epnum = 1; epnum < 16; epnum++) {
+      if (tu_bit_test(ep_bitmap[dir], epnum)) {
+        usbh_edpt_t* ep = &_usbh_edpts[base++];
+        ep->ep_addr = tu_edpt_addr(epnum, dir);
+        ep->drv_id = TUSB_INDEX_INVALID_8;
+        ep->drv_inst = TUSB_INDEX_INVALID_8;
+      }
+    }
+  }
+
+  return true;
+}
+
+// Bind all endpoints of an interface to class driver
+static void edpt_bind_driver(usbh_device_t const* dev, tusb_desc_interface_t const* desc_itf, uint16_t desc_len,
+                             uint8_t drv_id) {
+  uint8_t const* p_desc = (uint8_t const*) desc_itf;
+  uint8_t const* desc_end = p_desc + desc_len;
+
+  while (p_desc < desc_end) {
+    if (TUSB_DESC_ENDPOINT == tu_desc_type(p_desc)) {
+      uint8_t const ep_addr = ((tusb_desc_endpoint_t const*) p_desc)->bEndpointAddress;
+      usbh_edpt_t* ep = get_edpt(dev, ep_addr);
+      if (ep) {
+        TU_LOG_USBH("  Bind EP %02x to driver id %u\r\n", ep_addr, drv_id);
+        ep->drv_id = drv_id;
+      }
+    }
+    p_desc = tu_desc_next(p_desc);
+  }
+}
+
+// len is the number of bytes read, which is less than wTotalLength if descriptor does not fit in buffer
+static bool _parse_configuration_descriptor(uint8_t dev_addr, tusb_desc_configuration_t const* desc_cfg, uint16_t len) {
   usbh_device_t* dev = get_device(dev_addr);
-  uint16_t const total_len = tu_le16toh(desc_cfg->wTotalLength);
+  uint16_t const total_len = tu_min16(tu_le16toh(desc_cfg->wTotalLength), len);
+  bool const truncated = (total_len < tu_le16toh(desc_cfg->wTotalLength));
   uint8_t const* desc_end = ((uint8_t const*) desc_cfg) + total_len;
   uint8_t const* p_desc   = tu_desc_next(desc_cfg);
 
   TU_LOG_USBH("Parsing Configuration descriptor (wTotalLength = %u)\r\n", total_len);
 
+  uint8_t* itf2drv;
+  uint8_t const itf_count = get_itf2drv(dev_addr, &itf2drv);
+
+  // endpoint states must be allocated before drivers open their endpoints
+  TU_ASSERT(edpt_alloc(dev, (uint8_t const*) desc_cfg, desc_end));
+
   // parse each interfaces
   while( p_desc < desc_end ) {
     if ( 0 == tu_desc_len(p_desc) ) {
@@ -1699,9 +3596,25 @@ static bool _parse_configuration_descriptor(uint8_t dev_addr, tusb_desc_configur
     }
 #endif
 
+#if CFG_TUH_NCM
+    // ECM/NCM adapters without IAD: combine communication and data interface
+    if (1                                           == assoc_itf_count              &&
+        TUSB_CLASS_CDC                              == desc_itf->bInterfaceClass    &&
+        (CDC_COMM_SUBCLASS_ETHERNET_CONTROL_MODEL   == desc_itf->bInterfaceSubClass ||
+         CDC_COMM_SUBCLASS_NETWORK_CONTROL_MODEL    == desc_itf->bInterfaceSubClass)) {
+      assoc_itf_count = 2;
+    }
+#endif
+
     uint16_t const drv_len = tu_desc_get_interface_total_len(desc_itf, assoc_itf_count, (uint16_t) (desc_end-p_desc));
     TU_ASSERT(drv_len >= sizeof(tusb_desc_interface_t));
 
+    if (truncated && (p_desc + drv_len >= desc_end)) {
+      // interface may continue past the part that is read, skip it and the rest
+      TU_LOG_USBH("Interface %u and later are not in buffer, skipped\r\n", desc_itf->bInterfaceNumber);
+      break;
+    }
+
     // Find driver for this interface
     for (uint8_t drv_id = 0; drv_id < TOTAL_DRIVER_COUNT; drv_id++) {
       usbh_class_driver_t const * driver = get_driver(drv_id);
@@ -1714,12 +3627,12 @@ static bool _parse_configuration_descriptor(uint8_t dev_addr, tusb_desc_configur
           uint8_t const itf_num = desc_itf->bInterfaceNumber+i;
 
           // Interface number must not be used already
-          TU_ASSERT( TUSB_INDEX_INVALID_8 == dev->itf2drv[itf_num] );
-          dev->itf2drv[itf_num] = drv_id;
+          TU_ASSERT(itf_num < itf_count && TUSB_INDEX_INVALID_8 == itf2drv[itf_num]);
+          itf2drv[itf_num] = drv_id;
         }
 
         // bind all endpoints to found driver
-        tu_edpt_bind_driver(dev->ep2drv, desc_itf, drv_len, drv_id);
+        edpt_bind_driver(dev, desc_itf, drv_len, drv_id);
 
         break; // exit driver find loop
       }
@@ -1738,13 +3651,14 @@ static bool _parse_configuration_descriptor(uint8_t dev_addr, tusb_desc_configur
 }
 
 void usbh_driver_set_config_complete(uint8_t dev_addr, uint8_t itf_num) {
-  usbh_device_t* dev = get_device(dev_addr);
+  uint8_t* itf2drv;
+  uint8_t const itf_count = get_itf2drv(dev_addr, &itf2drv);
 
-  for(itf_num++; itf_num < CFG_TUH_INTERFACE_MAX; itf_num++) {
+  for(itf_num++; itf_num < itf_count; itf_num++) {
     // continue with next valid interface
     // IAD binding interface such as CDCs should return itf_num + 1 when complete
     // with usbh_driver_set_config_complete()
-    uint8_t const drv_id = dev->itf2drv[itf_num];
+    uint8_t const drv_id = itf2drv[itf_num];
     usbh_class_driver_t const * driver = get_driver(drv_id);
     if (driver) {
       TU_LOG_USBH("%s set config: itf = %u\r\n", driver->name, itf_num);
@@ -1754,7 +3668,7 @@ void usbh_driver_set_config_complete(uint8_t dev_addr, uint8_t itf_num) {
   }
 
   // all interface are configured
-  if (itf_num == CFG_TUH_INTERFACE_MAX) {
+  if (itf_num == itf_count) {
     enum_full_complete();
 
     if (is_hub_addr(dev_addr)) {
@@ -1767,14 +3681,16 @@ void usbh_driver_set_config_complete(uint8_t dev_addr, uint8_t itf_num) {
 }
 
 static void enum_full_complete(void) {
+  // device is unplugged or enumeration is aborted while roothub port is in reset
+  if (_enum.root_reset) {
+    _enum.root_reset = 0;
+    hcd_port_reset_end(_dev0.rhport);
+  }
+
   // mark enumeration as complete
   _dev0.enumerating = 0;
-
-#if CFG_TUH_HUB
-  // get next hub status
-  if (_dev0.hub_addr) hub_edpt_status_xfer(_dev0.hub_addr);
-#endif
-
+  _enum.timer_armed = 0;
+  _enum.timeout_armed = 0;
 }
 
 #endif
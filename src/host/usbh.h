@@ -64,7 +64,7 @@ struct tuh_xfer_s {
   tuh_xfer_cb_t complete_cb;
   uintptr_t user_data;
 
-  // uint32_t timeout_ms;    // place holder, not supported yet
+  uint32_t timeout_ms;       // control transfer only: 0 for CFG_TUH_CONTROL_XFER_TIMEOUT_MS, OSAL_TIMEOUT_WAIT_FOREVER for none
 };
 
 // Subject to change
@@ -73,13 +73,43 @@ typedef struct {
   tusb_desc_interface_t desc;
 } tuh_itf_info_t;
 
+#if CFG_TUH_EDPT_ISO_XFER
+struct tuh_iso_xfer_s;
+typedef struct tuh_iso_xfer_s tuh_iso_xfer_t;
+
+typedef void (*tuh_iso_xfer_cb_t)(tuh_iso_xfer_t* xfer);
+
+// Isochronous transfer, must be kept valid with its buffer and packets until complete callback is invoked
+struct tuh_iso_xfer_s {
+  uint8_t daddr;
+  uint8_t ep_addr;
+  uint16_t packet_count;
+  xfer_result_t result;       // failed if any of packets failed, see per-packet result
+
+  uint32_t actual_len;        // sum of packets' actual_len
+  uint32_t start_frame;       // frame of first packet (tuh_frame_number() unit) or TU_ISO_START_ASAP, updated with
+                              // the scheduled one when submitted
+
+  uint8_t* buffer;
+  tu_iso_packet_t* packets;
+  tuh_iso_xfer_cb_t complete_cb;
+  uintptr_t user_data;
+};
+#endif
+
 // ConfigID for tuh_configure()
 enum {
   TUH_CFGID_INVALID = 0,
   TUH_CFGID_RPI_PIO_USB_CONFIGURATION = 100, // cfg_param: pio_usb_configuration_t
   TUH_CFGID_MAX3421 = 200,
+  TUH_CFGID_EHCI_INTR_THRESHOLD = 300, // cfg_param: uint8_t micro-frames 0,1,2,4,8,16,32,64. Can also be changed at runtime
+  TUH_CFGID_DWC2 = 400,                // cfg_param: tuh_configure_dwc2_t
 };
 
+typedef struct {
+  uint8_t ahb_burst; // DMA burst GAHBCFG.HBSTLEN: 0 single, 1 INCR, 3 INCR4 (default), 5 INCR8, 7 INCR16
+} tuh_configure_dwc2_t;
+
 typedef struct {
   uint8_t max_nak; // max NAK per endpoint per frame to save CPU/SPI bus usage
   uint8_t cpuctl; // R16: CPU Control Register
@@ -90,6 +120,7 @@ typedef union {
   // For TUH_CFGID_RPI_PIO_USB_CONFIGURATION use pio_usb_configuration_t
 
   tuh_configure_max3421_t max3421;
+  tuh_configure_dwc2_t dwc2;
 } tuh_configure_param_t;
 
 //--------------------------------------------------------------------+
@@ -108,6 +139,10 @@ TU_ATTR_WEAK void tuh_umount_cb(uint8_t daddr);
 // Invoked when there is a new usb event, which need to be processed by tuh_task()/tuh_task_ext()
 void tuh_event_hook_cb(uint8_t rhport, uint32_t eventid, bool in_isr);
 
+// Invoked by tuh_int_handler() to measure ISR time when CFG_TUH_STATS is enabled, e.g return DWT->CYCCNT on Cortex-M.
+// Default returns 0 i.e only ISR count is recorded
+uint32_t tuh_stats_timestamp_cb(void);
+
 //--------------------------------------------------------------------+
 // APPLICATION API
 //--------------------------------------------------------------------+
@@ -158,18 +193,35 @@ bool tuh_task_event_ready(void);
 extern void hcd_int_handler(uint8_t rhport, bool in_isr);
 #endif
 
+#if CFG_TUH_STATS
+// Interrupt handler, call HCD and measure ISR time
+void tuh_stats_int_handler(uint8_t rhport, bool in_isr);
+#define _tuh_int_handler_hcd   tuh_stats_int_handler
+#else
+#define _tuh_int_handler_hcd   hcd_int_handler
+#endif
+
 // Interrupt handler alias to HCD with in_isr as optional parameter
 #define _tuh_int_handler_arg0()                   TU_VERIFY_STATIC(false, "tuh_int_handler() must have 1 or 2 arguments")
-#define _tuh_int_handler_arg1(_rhport)            hcd_int_handler(_rhport, true)
-#define _tuh_int_handler_arg2(_rhport, _in_isr)   hcd_int_handler(_rhport, _in_isr)
+#define _tuh_int_handler_arg1(_rhport)            _tuh_int_handler_hcd(_rhport, true)
+#define _tuh_int_handler_arg2(_rhport, _in_isr)   _tuh_int_handler_hcd(_rhport, _in_isr)
 #define tuh_int_handler(...)   TU_FUNC_OPTIONAL_ARG(_tuh_int_handler, __VA_ARGS__)
 
-// Check if roothub port is initialized and active as a host
+// Check if roothub port is initialized and active as a host. Up to CFG_TUH_RHPORT_NUM ports can be active at a time
 bool tuh_rhport_is_active(uint8_t rhport);
 
 // Assert/de-assert Bus Reset signal to roothub port. USB specs: it should last 10-50ms
 bool tuh_rhport_reset_bus(uint8_t rhport, bool active);
 
+// Put link of a device attached to roothub port into LPM L1 sleep (USB 2.0 LPM ECN), return true if device ACKed.
+// Device must support LPM in USB 2.0 Extension capability of its BOS, and all its transfers must be idle.
+// - besl: Best Effort Service Latency (0-15) allowed to device for resume, e.g baseline BESL of the capability
+// - remote_wakeup: allow device to wake up host from L1
+bool tuh_lpm_sleep(uint8_t daddr, uint8_t besl, bool remote_wakeup);
+
+// Resume link of a device from LPM L1 sleep
+bool tuh_lpm_resume(uint8_t daddr);
+
 //--------------------------------------------------------------------+
 // Device API
 //--------------------------------------------------------------------+
@@ -197,6 +249,32 @@ bool tuh_ready(uint8_t daddr) {
   return tuh_mounted(daddr) && !tuh_suspended(daddr);
 }
 
+//--------------------------------------------------------------------+
+// Statistics (CFG_TUH_STATS)
+//--------------------------------------------------------------------+
+typedef struct {
+  uint32_t xfer_count;  // completed transfers
+  uint32_t xfer_bytes;  // actual transferred bytes
+  uint32_t error_count; // transfers completed with failed/timeout result
+  uint32_t stall_count; // transfers completed with stall result
+} tuh_stats_edpt_t;
+
+typedef struct {
+  uint32_t event_count[2];   // events queued to main, priority queue
+  uint32_t event_dropped[2]; // events dropped since queue is full
+  uint16_t queue_hwm[2];     // most events waiting in main, priority queue
+  uint32_t isr_count;        // number of tuh_int_handler() calls
+  uint32_t isr_time_total;   // sum of ISR time in tuh_stats_timestamp_cb() unit
+  uint32_t isr_time_max;     // longest ISR time in tuh_stats_timestamp_cb() unit
+} tuh_stats_t;
+
+// Get snapshot of stack statistics. If clear is true, counters are reset afterward
+bool tuh_stats_get(tuh_stats_t* stats, bool clear);
+
+// Get snapshot of endpoint statistics of a device, reset when device is removed. If clear is true, its counters are
+// reset afterward
+bool tuh_stats_edpt_get(uint8_t daddr, uint8_t ep_addr, tuh_stats_edpt_t* stats, bool clear);
+
 //--------------------------------------------------------------------+
 // Transfer API
 //--------------------------------------------------------------------+
@@ -204,6 +282,8 @@ bool tuh_ready(uint8_t daddr) {
 // Submit a control transfer
 //  - async: complete callback invoked when finished.
 //  - sync : blocking if complete callback is NULL.
+// Fails if the control pipe is busy, except for async transfer with CFG_TUH_CONTROL_XFER_QUEUE: it is queued and
+// started right after the on-going ones. Setup packet is copied, buffer must stay valid until complete.
 bool tuh_control_xfer(tuh_xfer_t* xfer);
 
 // Submit a bulk/interrupt transfer
@@ -214,6 +294,29 @@ bool tuh_edpt_xfer(tuh_xfer_t* xfer);
 // Open a non-control endpoint
 bool tuh_edpt_open(uint8_t daddr, tusb_desc_endpoint_t const * desc_ep);
 
+#if CFG_TUH_EDPT_ISO_XFER
+// Submit an isochronous transfer of packet_count packets, one per service interval starting at start_frame.
+// Complete callback is invoked once with per-packet actual length and result. Return false if hcd does not support
+// it, endpoint is busy or start frame is too late/far to be scheduled
+bool tuh_edpt_iso_xfer(tuh_iso_xfer_t* xfer);
+
+// Current frame number of the root port the device is attached to, used as start frame of isochronous transfer
+uint32_t tuh_frame_number(uint8_t daddr);
+#endif
+
+#if CFG_TUH_PERIODIC_BUDGET
+// Check if an interrupt/isochronous endpoint fits in the remaining periodic bandwidth of its root port and hub
+// Transaction Translator. Bandwidth held by the opened endpoint with the same address is counted as available.
+// Control and bulk endpoints always fit.
+bool tuh_edpt_bandwidth_fits(uint8_t daddr, tusb_desc_endpoint_t const * desc_ep);
+
+// Find the alternate setting of an interface that uses the most periodic bandwidth and still fits, e.g to pick the
+// highest sample rate/resolution of audio/video streaming. desc_itf is the first (alt 0) interface descriptor and
+// max_len the remaining length of the configuration descriptor.
+// Return bAlternateSetting, or TUSB_INDEX_INVALID_8 if none fits
+uint8_t tuh_interface_alt_best(uint8_t daddr, tusb_desc_interface_t const * desc_itf, uint16_t max_len);
+#endif
+
 // Abort a queued transfer. Note: it can only abort transfer that has not been started
 // Return true if a queued transfer is aborted, false if there is no transfer to abort
 bool tuh_edpt_abort_xfer(uint8_t daddr, uint8_t ep_addr);
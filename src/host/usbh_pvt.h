@@ -69,8 +69,14 @@ void usbh_driver_set_config_complete(uint8_t dev_addr, uint8_t itf_num);
 
 uint8_t usbh_get_rhport(uint8_t dev_addr);
 
+// Check if device attached to hub port is being enumerated, its port reset/status is handled by enumeration
+bool usbh_enum_is_hub_port(uint8_t hub_addr, uint8_t hub_port);
+
 uint8_t* usbh_get_enum_buf(void);
 
+// Delay set config of enumerating device: complete_cb is invoked after ms with xfer.user_data = user_data
+bool usbh_enum_delay(uint8_t daddr, uint16_t ms, tuh_xfer_cb_t complete_cb, uintptr_t user_data);
+
 void usbh_int_set(bool enabled);
 
 void usbh_defer_func(osal_task_func_t func, void *param, bool in_isr);
@@ -80,14 +86,27 @@ void usbh_defer_func(osal_task_func_t func, void *param, bool in_isr);
 //--------------------------------------------------------------------+
 
 // Submit a usb transfer with callback support, require CFG_TUH_API_EDPT_XFER
-bool usbh_edpt_xfer_with_callback(uint8_t dev_addr, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes,
+// With CFG_TUH_EDPT_XFER_LARGE, transfer larger than TUP_HCD_EDPT_XFER_MAX is split into multiple
+// hcd submissions, otherwise it is limited to 64KB
+bool usbh_edpt_xfer_with_callback(uint8_t dev_addr, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes,
                                   tuh_xfer_cb_t complete_cb, uintptr_t user_data);
 
 TU_ATTR_ALWAYS_INLINE
-static inline bool usbh_edpt_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes) {
+static inline bool usbh_edpt_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes) {
   return usbh_edpt_xfer_with_callback(dev_addr, ep_addr, buffer, total_bytes, NULL, 0);
 }
 
+#if CFG_TUH_EDPT_XFER_QUEUE
+// Queue a transfer behind the one on the endpoint, up to CFG_TUH_EDPT_XFER_QUEUE. The next queued transfer is
+// submitted from hcd_event_handler() as soon as the previous one completes, driver's xfer_cb() is invoked once
+// per transfer in submission order. Endpoint stays busy until all are complete. Can not be mixed with a pending
+// usbh_edpt_xfer() and needs no claim. After a failed transfer the remaining ones complete with the same result
+bool usbh_edpt_xfer_queue(uint8_t dev_addr, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes);
+
+// Number of queued transfers (including the one on hcd) whose completion is not delivered to driver yet
+uint8_t usbh_edpt_xfer_queue_pending(uint8_t dev_addr, uint8_t ep_addr);
+#endif
+
 // Claim an endpoint before submitting a transfer.
 // If caller does not make any transfer, it must release endpoint for others.
 bool usbh_edpt_claim(uint8_t dev_addr, uint8_t ep_addr);
@@ -98,6 +117,13 @@ bool usbh_edpt_release(uint8_t dev_addr, uint8_t ep_addr);
 // Check if endpoint transferring is complete
 bool usbh_edpt_busy(uint8_t dev_addr, uint8_t ep_addr);
 
+// Record driver instance (e.g interface index) owning an opened endpoint, so that xfer_cb() can get it back with
+// usbh_edpt_instance() instead of searching all instances
+bool usbh_edpt_instance_set(uint8_t dev_addr, uint8_t ep_addr, uint8_t instance);
+
+// Driver instance of endpoint, TUSB_INDEX_INVALID_8 if not set
+uint8_t usbh_edpt_instance(uint8_t dev_addr, uint8_t ep_addr);
+
 #ifdef __cplusplus
  }
 #endif
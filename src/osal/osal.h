@@ -69,6 +69,34 @@ typedef void (*osal_task_func_t)( void * );
   #error OS is not supported yet
 #endif
 
+// Spinlock: short critical section protecting stack data shared between task, ISR and other cores. Port without its
+// own implementation (OS None or single core RTOS) falls back to disabling the USB controller interrupt (_int_set),
+// which is enough as long as ISR and the code taking the lock run on the same core.
+#ifndef OSAL_SPINLOCK_DEF
+typedef struct {
+  void (* interrupt_set)(bool enabled);
+} osal_spinlock_t;
+
+#define OSAL_SPINLOCK_DEF(_name, _int_set) \
+  osal_spinlock_t _name = { .interrupt_set = _int_set }
+
+TU_ATTR_ALWAYS_INLINE static inline void osal_spin_init(osal_spinlock_t* ctx) {
+  (void) ctx;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void osal_spin_lock(osal_spinlock_t* ctx, bool in_isr) {
+  if (!in_isr) {
+    ctx->interrupt_set(false);
+  }
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void osal_spin_unlock(osal_spinlock_t* ctx, bool in_isr) {
+  if (!in_isr) {
+    ctx->interrupt_set(true);
+  }
+}
+#endif
+
 //--------------------------------------------------------------------+
 // OSAL Porting API
 // Should be implemented as static inline function in osal_port.h header
@@ -89,6 +117,12 @@ typedef void (*osal_task_func_t)( void * );
    bool osal_queue_receive(osal_queue_t qhdl, void* data, uint32_t msec);
    bool osal_queue_send(osal_queue_t qhdl, void const * data, bool in_isr);
    bool osal_queue_empty(osal_queue_t qhdl);
+
+   // optional, default to disable USB interrupt if not defined
+   OSAL_SPINLOCK_DEF(_name, _int_set);
+   void osal_spin_init(osal_spinlock_t* ctx);
+   void osal_spin_lock(osal_spinlock_t* ctx, bool in_isr);
+   void osal_spin_unlock(osal_spinlock_t* ctx, bool in_isr);
 */
 //--------------------------------------------------------------------+
 
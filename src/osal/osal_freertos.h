@@ -52,6 +52,55 @@ extern "C" {
 
 typedef SemaphoreHandle_t osal_semaphore_t;
 typedef SemaphoreHandle_t osal_mutex_t;
+
+// Spinlock is a kernel critical section: it also takes the kernel lock with SMP port. ESP-IDF requires its own mux
+typedef struct {
+#if TUSB_MCU_VENDOR_ESPRESSIF
+  portMUX_TYPE mux;
+#else
+  UBaseType_t isr_status; // interrupt mask saved by taskENTER_CRITICAL_FROM_ISR()
+#endif
+} osal_spinlock_t;
+
+#if TUSB_MCU_VENDOR_ESPRESSIF
+  #define _OSAL_SPINLOCK_INIT   { .mux = portMUX_INITIALIZER_UNLOCKED }
+#else
+  #define _OSAL_SPINLOCK_INIT   { .isr_status = 0 }
+#endif
+
+// _int_set is not used with an RTOS
+#define OSAL_SPINLOCK_DEF(_name, _int_set) osal_spinlock_t _name = _OSAL_SPINLOCK_INIT
+
+// Implement osal queue with a fifo and a direct-to-task notification instead of a FreeRTOS queue. Sending an event
+// is a short critical section copying it into fifo then notifying the waiting task, which takes much fewer cycles in
+// ISR than a queue round trip. Each queue must only have one receiving task, and sending to a full queue returns
+// false immediately (as OS None) instead of blocking. Uses the last notification index if there are more than one.
+#ifndef CFG_TUSB_OS_QUEUE_NOTIFY
+  #define CFG_TUSB_OS_QUEUE_NOTIFY   0
+#endif
+
+#if CFG_TUSB_OS_QUEUE_NOTIFY
+#include "common/tusb_fifo.h"
+
+typedef struct {
+  tu_fifo_t ff;
+  TaskHandle_t volatile waiter; // task blocked in osal_queue_receive(), notified by next send
+  osal_spinlock_t lock;
+} osal_queue_def_t;
+
+typedef osal_queue_def_t* osal_queue_t;
+
+// _int_set is not used with an RTOS
+#define OSAL_QUEUE_DEF(_int_set, _name, _depth, _type)     \
+  static uint8_t _name##_buf[_depth*sizeof(_type)];        \
+  osal_queue_def_t _name = {                               \
+    .ff = TU_FIFO_INIT(_name##_buf, _depth, _type, false), \
+    .waiter = NULL,                                        \
+    .lock = _OSAL_SPINLOCK_INIT                            \
+  }
+
+#else
+
 typedef QueueHandle_t osal_queue_t;
 
 typedef struct
@@ -80,6 +129,8 @@ typedef struct
   static _type _name##_##buf[_depth];\
   osal_queue_def_t _name = { .depth = _depth, .item_sz = sizeof(_type), .buf = _name##_##buf, _OSAL_Q_NAME(_name) }
 
+#endif
+
 //--------------------------------------------------------------------+
 // TASK API
 //--------------------------------------------------------------------+
@@ -171,10 +222,130 @@ TU_ATTR_ALWAYS_INLINE static inline bool osal_mutex_unlock(osal_mutex_t mutex_hd
   return xSemaphoreGive(mutex_hdl);
 }
 
+//--------------------------------------------------------------------+
+// Spinlock API
+//--------------------------------------------------------------------+
+
+TU_ATTR_ALWAYS_INLINE static inline void osal_spin_init(osal_spinlock_t* ctx) {
+#if TUSB_MCU_VENDOR_ESPRESSIF
+  portMUX_INITIALIZE(&ctx->mux);
+#else
+  ctx->isr_status = 0;
+#endif
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void osal_spin_lock(osal_spinlock_t* ctx, bool in_isr) {
+#if TUSB_MCU_VENDOR_ESPRESSIF
+  (void) in_isr;
+  portENTER_CRITICAL_SAFE(&ctx->mux);
+#else
+  if (in_isr) {
+    UBaseType_t const status = taskENTER_CRITICAL_FROM_ISR();
+    ctx->isr_status = status; // only written while holding the lock
+  } else {
+    taskENTER_CRITICAL();
+  }
+#endif
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void osal_spin_unlock(osal_spinlock_t* ctx, bool in_isr) {
+#if TUSB_MCU_VENDOR_ESPRESSIF
+  (void) in_isr;
+  portEXIT_CRITICAL_SAFE(&ctx->mux);
+#else
+  if (in_isr) {
+    taskEXIT_CRITICAL_FROM_ISR(ctx->isr_status);
+  } else {
+    taskEXIT_CRITICAL();
+  }
+#endif
+}
+
 //--------------------------------------------------------------------+
 // QUEUE API
 //--------------------------------------------------------------------+
 
+#if CFG_TUSB_OS_QUEUE_NOTIFY
+
+#if defined(configTASK_NOTIFICATION_ARRAY_ENTRIES) && (configTASK_NOTIFICATION_ARRAY_ENTRIES > 1)
+  #define _OSAL_Q_NOTIFY_INDEX   (configTASK_NOTIFICATION_ARRAY_ENTRIES - 1)
+  #define _osal_q_notify_take(_ticks)          ulTaskNotifyTakeIndexed(_OSAL_Q_NOTIFY_INDEX, pdTRUE, _ticks)
+  #define _osal_q_notify_give(_task)           xTaskNotifyGiveIndexed(_task, _OSAL_Q_NOTIFY_INDEX)
+  #define _osal_q_notify_give_isr(_task, _pw)  vTaskNotifyGiveIndexedFromISR(_task, _OSAL_Q_NOTIFY_INDEX, _pw)
+#else
+  #define _osal_q_notify_take(_ticks)          ulTaskNotifyTake(pdTRUE, _ticks)
+  #define _osal_q_notify_give(_task)           xTaskNotifyGive(_task)
+  #define _osal_q_notify_give_isr(_task, _pw)  vTaskNotifyGiveFromISR(_task, _pw)
+#endif
+
+TU_ATTR_ALWAYS_INLINE static inline osal_queue_t osal_queue_create(osal_queue_def_t* qdef) {
+  tu_fifo_clear(&qdef->ff);
+  qdef->waiter = NULL;
+  osal_spin_init(&qdef->lock);
+  return (osal_queue_t) qdef;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline bool osal_queue_delete(osal_queue_t qhdl) {
+  (void) qhdl;
+  return true; // nothing to do
+}
+
+TU_ATTR_ALWAYS_INLINE static inline bool osal_queue_receive(osal_queue_t qhdl, void* data, uint32_t msec) {
+  TickType_t ticks = _osal_ms2tick(msec);
+  TimeOut_t timeout;
+  vTaskSetTimeOutState(&timeout);
+
+  while (1) {
+    osal_spin_lock(&qhdl->lock, false);
+    bool const success = tu_fifo_read(&qhdl->ff, data);
+    qhdl->waiter = success ? NULL : xTaskGetCurrentTaskHandle();
+    osal_spin_unlock(&qhdl->lock, false);
+
+    if (success) {
+      return true;
+    }
+
+    if (ticks == 0 || xTaskCheckForTimeOut(&timeout, &ticks) != pdFALSE) {
+      qhdl->waiter = NULL;
+      return false;
+    }
+
+    // a notification left from an earlier send only causes fifo to be checked again
+    (void) _osal_q_notify_take(ticks);
+  }
+}
+
+TU_ATTR_ALWAYS_INLINE static inline bool osal_queue_send(osal_queue_t qhdl, void const *data, bool in_isr) {
+  osal_spin_lock(&qhdl->lock, in_isr);
+  bool const success = tu_fifo_write(&qhdl->ff, data);
+  TaskHandle_t const waiter = qhdl->waiter;
+  qhdl->waiter = NULL;
+  osal_spin_unlock(&qhdl->lock, in_isr);
+
+  if (waiter != NULL) {
+    if (!in_isr) {
+      (void) _osal_q_notify_give(waiter);
+    } else {
+      BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+      _osal_q_notify_give_isr(waiter, &xHigherPriorityTaskWoken);
+
+#if CFG_TUSB_MCU == OPT_MCU_ESP32S2 || CFG_TUSB_MCU == OPT_MCU_ESP32S3
+      if ( xHigherPriorityTaskWoken ) portYIELD_FROM_ISR();
+#else
+      portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+#endif
+    }
+  }
+
+  return success;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline bool osal_queue_empty(osal_queue_t qhdl) {
+  return tu_fifo_empty(&qhdl->ff);
+}
+
+#else
+
 TU_ATTR_ALWAYS_INLINE static inline osal_queue_t osal_queue_create(osal_queue_def_t* qdef) {
   osal_queue_t q;
 
@@ -222,6 +393,8 @@ TU_ATTR_ALWAYS_INLINE static inline bool osal_queue_empty(osal_queue_t qhdl) {
   return uxQueueMessagesWaiting(qhdl) == 0;
 }
 
+#endif
+
 #ifdef __cplusplus
 }
 #endif
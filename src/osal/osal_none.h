@@ -159,8 +159,59 @@ TU_ATTR_ALWAYS_INLINE static inline bool osal_queue_delete(osal_queue_t qhdl) {
   return true; // nothing to do
 }
 
+#if CFG_TUSB_OS_NONE_SLEEP
+// Mask all interrupts returning previous mask state / restore mask state / sleep until an interrupt is pending. Core
+// wakes up from WFI on a pending interrupt even while it is masked, its ISR runs once mask is restored. Saving the
+// state keeps interrupts masked if caller already masked them. Other architectures must define these.
+#ifndef osal_none_irq_save
+  #if defined(__arm__)
+    TU_ATTR_ALWAYS_INLINE static inline uint32_t osal_none_irq_save(void) {
+      uint32_t primask;
+      __asm volatile ("mrs %0, primask\n cpsid i" : "=r" (primask) :: "memory");
+      return primask;
+    }
+    #define osal_none_irq_restore(_state) __asm volatile ("msr primask, %0" :: "r" (_state) : "memory")
+    #define osal_none_wfi()               __asm volatile ("dsb 0xF\n wfi" ::: "memory")
+  #elif defined(__riscv)
+    // MIE is bit 3 of mstatus
+    TU_ATTR_ALWAYS_INLINE static inline uint32_t osal_none_irq_save(void) {
+      uint32_t mstatus;
+      __asm volatile ("csrrci %0, mstatus, 8" : "=r" (mstatus) :: "memory");
+      return mstatus & 8u;
+    }
+    #define osal_none_irq_restore(_state) __asm volatile ("csrs mstatus, %0" :: "r" (_state) : "memory")
+    #define osal_none_wfi()               __asm volatile ("wfi" ::: "memory")
+  #else
+    #error "CFG_TUSB_OS_NONE_SLEEP: define osal_none_irq_save(), osal_none_irq_restore() and osal_none_wfi()"
+  #endif
+#endif
+
+// Sleep until queue is not empty or timeout. Emptiness is checked with interrupts masked right before WFI, so that an
+// event queued by an ISR after the check leaves its interrupt pending and wakes the core instead of being missed.
+TU_ATTR_ALWAYS_INLINE static inline void _osal_q_sleep(osal_queue_t qhdl, uint32_t msec) {
+  uint32_t const start_ms = (msec == OSAL_TIMEOUT_WAIT_FOREVER) ? 0 : tusb_time_millis_api();
+
+  uint32_t const irq_state = osal_none_irq_save();
+  while (tu_fifo_empty(&qhdl->ff)) {
+    if (msec != OSAL_TIMEOUT_WAIT_FOREVER && (tusb_time_millis_api() - start_ms) >= msec) {
+      break;
+    }
+    osal_none_wfi();
+    osal_none_irq_restore(irq_state); // pending ISR runs here
+    (void) osal_none_irq_save();
+  }
+  osal_none_irq_restore(irq_state);
+}
+#endif
+
 TU_ATTR_ALWAYS_INLINE static inline bool osal_queue_receive(osal_queue_t qhdl, void* data, uint32_t msec) {
+#if CFG_TUSB_OS_NONE_SLEEP
+  if (msec != 0) {
+    _osal_q_sleep(qhdl, msec);
+  }
+#else
   (void) msec; // not used, always behave as msec = 0
+#endif
 
   _osal_q_lock(qhdl);
   bool success = tu_fifo_read(&qhdl->ff, data);
@@ -97,6 +97,31 @@ TU_ATTR_ALWAYS_INLINE static inline bool osal_mutex_unlock(osal_mutex_t mutex_hd
   return true;
 }
 
+//--------------------------------------------------------------------+
+// Spinlock API
+// critical section disables interrupts of current core and takes a hardware spin lock, safe against the other core
+//--------------------------------------------------------------------+
+typedef struct critical_section osal_spinlock_t;
+
+// _int_set is not used, critical section also covers USB interrupt
+#define OSAL_SPINLOCK_DEF(_name, _int_set) osal_spinlock_t _name
+
+TU_ATTR_ALWAYS_INLINE static inline void osal_spin_init(osal_spinlock_t* ctx) {
+  if (!critical_section_is_initialized(ctx)) {
+    critical_section_init(ctx);
+  }
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void osal_spin_lock(osal_spinlock_t* ctx, bool in_isr) {
+  (void) in_isr;
+  critical_section_enter_blocking(ctx);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void osal_spin_unlock(osal_spinlock_t* ctx, bool in_isr) {
+  (void) in_isr;
+  critical_section_exit(ctx);
+}
+
 //--------------------------------------------------------------------+
 // QUEUE API
 //--------------------------------------------------------------------+
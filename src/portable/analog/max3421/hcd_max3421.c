@@ -179,6 +179,14 @@ enum {
   EP_STATE_ATTEMPT_MAX = 15
 };
 
+// FIFO transfer in progress with tuh_max3421_spi_xfer_async_api()
+enum {
+  ASYNC_IDLE = 0,
+  ASYNC_RCVFIFO,
+  ASYNC_SNDFIFO,
+  ASYNC_SUDFIFO,
+};
+
 //--------------------------------------------------------------------+
 //
 //--------------------------------------------------------------------+
@@ -234,6 +242,20 @@ typedef struct {
   }sndfifo_owner;
 
   atomic_flag busy; // busy transferring
+  uint8_t ep_last; // index of last scheduled endpoint, for round-robin
+
+  // scratch buffers for FIFO access: command byte + 64 bytes data
+  uint8_t spi_tx[1 + 64];
+  uint8_t spi_rx[1 + 64];
+
+#if CFG_TUH_MAX3421_SPI_ASYNC
+  atomic_flag int_active;      // handler or its asynchronous continuation is using SPI
+  volatile bool int_pending;   // handler is invoked while active, need to process again
+  bool async_allowed;          // asynchronous FIFO transfer is only used within handler in isr
+  volatile uint8_t async_state;
+  uint8_t async_len;
+  max3421_ep_t* async_ep;
+#endif
 
 #if OSAL_MUTEX_REQUIRED
   OSAL_MUTEX_DEF(spi_mutexdef);
@@ -268,6 +290,16 @@ extern bool tuh_max3421_spi_xfer_api(uint8_t rhport, uint8_t const* tx_buf, uint
 // API to enable/disable MAX3421 INTR pin interrupt
 extern void tuh_max3421_int_api(uint8_t rhport, bool enabled);
 
+#if CFG_TUH_MAX3421_SPI_ASYNC
+// API to start an asynchronous SPI transfer (e.g DMA) with CS already asserted. Must return immediately, application
+// then invokes tuh_max3421_spi_xfer_done() when transfer is complete. Return false if transfer cannot be started,
+// tuh_max3421_spi_xfer_api() is used instead. Only used for FIFO access within hcd_int_handler(in_isr = true)
+extern bool tuh_max3421_spi_xfer_async_api(uint8_t rhport, uint8_t const* tx_buf, uint8_t* rx_buf, size_t xfer_bytes);
+
+// API to notify asynchronous transfer is complete, called by application in SPI/DMA ISR. Implemented by TinyUSB
+void tuh_max3421_spi_xfer_done(uint8_t rhport);
+#endif
+
 // API to read MAX3421's register. Implemented by TinyUSB
 uint8_t tuh_max3421_reg_read(uint8_t rhport, uint8_t reg, bool in_isr);
 
@@ -281,129 +313,155 @@ bool tuh_max3421_reg_write(uint8_t rhport, uint8_t reg, uint8_t data, bool in_is
 #define reg_read  tuh_max3421_reg_read
 #define reg_write tuh_max3421_reg_write
 
+// SPI lock: disable interrupt and mutex lock (for pre-emptive RTOS) if not in_isr.
+// A whole sequence of register/FIFO accesses is done within a single lock, each access is still framed by CS
+// since MAX3421E does not auto-increment register address.
 static void max3421_spi_lock(uint8_t rhport, bool in_isr) {
-  // disable interrupt and mutex lock (for pre-emptive RTOS) if not in_isr
   if (!in_isr) {
     (void) osal_mutex_lock(_hcd_data.spi_mutex, OSAL_TIMEOUT_WAIT_FOREVER);
     tuh_max3421_int_api(rhport, false);
-  }
 
-  // assert CS
-  tuh_max3421_spi_cs_api(rhport, true);
+    #if CFG_TUH_MAX3421_SPI_ASYNC
+    // wait for handler's asynchronous transfer, which is continued in SPI ISR
+    while (atomic_flag_test_and_set(&_hcd_data.int_active)) {}
+    #endif
+  }
 }
 
 static void max3421_spi_unlock(uint8_t rhport, bool in_isr) {
-  // de-assert CS
-  tuh_max3421_spi_cs_api(rhport, false);
-
   // mutex unlock and re-enable interrupt
   if (!in_isr) {
+    #if CFG_TUH_MAX3421_SPI_ASYNC
+    atomic_flag_clear(&_hcd_data.int_active);
+    #endif
     tuh_max3421_int_api(rhport, true);
     (void) osal_mutex_unlock(_hcd_data.spi_mutex);
   }
 }
 
-uint8_t tuh_max3421_reg_read(uint8_t rhport, uint8_t reg, bool in_isr) {
-  uint8_t tx_buf[2] = {reg, 0};
-  uint8_t rx_buf[2] = {0, 0};
-
-  max3421_spi_lock(rhport, in_isr);
-  bool ret = tuh_max3421_spi_xfer_api(rhport, tx_buf, rx_buf, 2);
-  max3421_spi_unlock(rhport, in_isr);
+// One CS framed SPI transaction: command byte followed by data. Must be called with SPI lock held.
+// First received byte is HIRQ register since we are in full-duplex mode
+static bool spi_xact(uint8_t rhport, uint8_t const* tx_buf, uint8_t* rx_buf, size_t xfer_bytes) {
+  tuh_max3421_spi_cs_api(rhport, true);
+  bool const ret = tuh_max3421_spi_xfer_api(rhport, tx_buf, rx_buf, xfer_bytes);
+  tuh_max3421_spi_cs_api(rhport, false);
 
   _hcd_data.hirq = rx_buf[0];
+  return ret;
+}
+
+static uint8_t spi_reg_read(uint8_t rhport, uint8_t reg) {
+  uint8_t tx_buf[2] = {reg, 0};
+  uint8_t rx_buf[2] = {0, 0};
+  bool const ret = spi_xact(rhport, tx_buf, rx_buf, 2);
   return ret ? rx_buf[1] : 0;
 }
 
-bool tuh_max3421_reg_write(uint8_t rhport, uint8_t reg, uint8_t data, bool in_isr) {
+static bool spi_reg_write(uint8_t rhport, uint8_t reg, uint8_t data) {
   uint8_t tx_buf[2] = {reg | CMDBYTE_WRITE, data};
   uint8_t rx_buf[2] = {0, 0};
+  return spi_xact(rhport, tx_buf, rx_buf, 2);
+}
 
+uint8_t tuh_max3421_reg_read(uint8_t rhport, uint8_t reg, bool in_isr) {
   max3421_spi_lock(rhport, in_isr);
-  bool ret = tuh_max3421_spi_xfer_api(rhport, tx_buf, rx_buf, 2);
+  uint8_t const value = spi_reg_read(rhport, reg);
   max3421_spi_unlock(rhport, in_isr);
+  return value;
+}
 
-  // HIRQ register since we are in full-duplex mode
-  _hcd_data.hirq = rx_buf[0];
-
+bool tuh_max3421_reg_write(uint8_t rhport, uint8_t reg, uint8_t data, bool in_isr) {
+  max3421_spi_lock(rhport, in_isr);
+  bool const ret = spi_reg_write(rhport, reg, data);
+  max3421_spi_unlock(rhport, in_isr);
   return ret;
 }
 
 //--------------------------------------------------------------------
-// Register helper
+// Register helper, SPI lock must be held
 //--------------------------------------------------------------------
-TU_ATTR_ALWAYS_INLINE static inline void hirq_write(uint8_t rhport, uint8_t data, bool in_isr) {
-  reg_write(rhport, HIRQ_ADDR, data, in_isr);
+TU_ATTR_ALWAYS_INLINE static inline void hirq_write(uint8_t rhport, uint8_t data) {
+  spi_reg_write(rhport, HIRQ_ADDR, data);
   // HIRQ write 1 is clear
   _hcd_data.hirq &= (uint8_t) ~data;
 }
 
-TU_ATTR_ALWAYS_INLINE static inline void hien_write(uint8_t rhport, uint8_t data, bool in_isr) {
+TU_ATTR_ALWAYS_INLINE static inline void hien_write(uint8_t rhport, uint8_t data) {
   _hcd_data.hien = data;
-  reg_write(rhport, HIEN_ADDR, data, in_isr);
+  spi_reg_write(rhport, HIEN_ADDR, data);
 }
 
-TU_ATTR_ALWAYS_INLINE static inline void mode_write(uint8_t rhport, uint8_t data, bool in_isr) {
+TU_ATTR_ALWAYS_INLINE static inline void mode_write(uint8_t rhport, uint8_t data) {
   _hcd_data.mode = data;
-  reg_write(rhport, MODE_ADDR, data, in_isr);
+  spi_reg_write(rhport, MODE_ADDR, data);
 }
 
-TU_ATTR_ALWAYS_INLINE static inline void peraddr_write(uint8_t rhport, uint8_t data, bool in_isr) {
+TU_ATTR_ALWAYS_INLINE static inline void peraddr_write(uint8_t rhport, uint8_t data) {
   if ( _hcd_data.peraddr == data ) return; // no need to change address
 
   _hcd_data.peraddr = data;
-  reg_write(rhport, PERADDR_ADDR, data, in_isr);
+  spi_reg_write(rhport, PERADDR_ADDR, data);
 }
 
-TU_ATTR_ALWAYS_INLINE static inline void hxfr_write(uint8_t rhport, uint8_t data, bool in_isr) {
+TU_ATTR_ALWAYS_INLINE static inline void hxfr_write(uint8_t rhport, uint8_t data) {
   _hcd_data.hxfr = data;
-  reg_write(rhport, HXFR_ADDR, data, in_isr);
+  spi_reg_write(rhport, HXFR_ADDR, data);
 }
 
-TU_ATTR_ALWAYS_INLINE static inline void sndbc_write(uint8_t rhport, uint8_t data, bool in_isr) {
+TU_ATTR_ALWAYS_INLINE static inline void sndbc_write(uint8_t rhport, uint8_t data) {
   _hcd_data.sndbc = data;
-  reg_write(rhport, SNDBC_ADDR, data, in_isr);
+  spi_reg_write(rhport, SNDBC_ADDR, data);
 }
 
 //--------------------------------------------------------------------
-// FIFO access (receive, send, setup)
+// FIFO access (receive, send, setup), SPI lock must be held
+// Command byte and data are sent in a single SPI transfer (one DMA transaction) using scratch buffers
 //--------------------------------------------------------------------
-static void hwfifo_write(uint8_t rhport, uint8_t reg, const uint8_t* buffer, uint8_t len, bool in_isr) {
-  uint8_t hirq;
-  reg |= CMDBYTE_WRITE;
-
-  max3421_spi_lock(rhport, in_isr);
-
-  tuh_max3421_spi_xfer_api(rhport, &reg, &hirq, 1);
-  _hcd_data.hirq = hirq;
-  tuh_max3421_spi_xfer_api(rhport, buffer, NULL, len);
 
-  max3421_spi_unlock(rhport, in_isr);
-}
+// Transfer scratch buffers. Within handler in isr, transfer is started asynchronously (if supported): return false
+// and the state machine is continued by tuh_max3421_spi_xfer_done(). Otherwise transfer is blocking and return true.
+static bool hwfifo_xact(uint8_t rhport, max3421_ep_t* ep, uint8_t len, uint8_t async_state) {
+#if CFG_TUH_MAX3421_SPI_ASYNC
+  if (_hcd_data.async_allowed) {
+    // set context first since transfer can complete before async api returns
+    _hcd_data.async_ep = ep;
+    _hcd_data.async_len = len;
+    _hcd_data.async_state = async_state;
+
+    tuh_max3421_spi_cs_api(rhport, true);
+    if (tuh_max3421_spi_xfer_async_api(rhport, _hcd_data.spi_tx, _hcd_data.spi_rx, 1u + len)) {
+      return false;
+    }
 
-// Write to SNDFIFO if len > 0 and update SNDBC
-TU_ATTR_ALWAYS_INLINE static inline void hwfifo_send(uint8_t rhport, const uint8_t* buffer, uint8_t len, bool in_isr) {
-  if (len) {
-    hwfifo_write(rhport, SNDFIFO_ADDR, buffer, len, in_isr);
+    // fall back to blocking transfer
+    tuh_max3421_spi_cs_api(rhport, false);
+    _hcd_data.async_state = ASYNC_IDLE;
   }
-  sndbc_write(rhport, len, in_isr);
-}
+#else
+  (void) ep;
+  (void) async_state;
+#endif
 
-TU_ATTR_ALWAYS_INLINE static inline void hwfifo_setup(uint8_t rhport, const uint8_t* buffer, bool in_isr) {
-  hwfifo_write(rhport, SUDFIFO_ADDR, buffer, 8, in_isr);
+  spi_xact(rhport, _hcd_data.spi_tx, _hcd_data.spi_rx, 1u + len);
+  return true;
 }
 
-static void hwfifo_receive(uint8_t rhport, uint8_t * buffer, uint16_t len, bool in_isr) {
-  uint8_t hirq;
-  uint8_t const reg = RCVVFIFO_ADDR;
-
-  max3421_spi_lock(rhport, in_isr);
-
-  tuh_max3421_spi_xfer_api(rhport, &reg, &hirq, 1);
-  _hcd_data.hirq = hirq;
-  tuh_max3421_spi_xfer_api(rhport, NULL, buffer, len);
+// Write SNDFIFO or SUDFIFO, return false if continued asynchronously
+static bool hwfifo_write(uint8_t rhport, uint8_t reg, max3421_ep_t* ep, uint8_t len) {
+  _hcd_data.spi_tx[0] = reg | CMDBYTE_WRITE;
+  memcpy(_hcd_data.spi_tx + 1, ep->buf, len);
+  return hwfifo_xact(rhport, ep, len, (reg == SNDFIFO_ADDR) ? ASYNC_SNDFIFO : ASYNC_SUDFIFO);
+}
 
-  max3421_spi_unlock(rhport, in_isr);
+// Read RCVFIFO to endpoint buffer, return false if continued asynchronously
+static bool hwfifo_receive(uint8_t rhport, max3421_ep_t* ep, uint8_t len) {
+  // data following command byte is don't care
+  _hcd_data.spi_tx[0] = RCVVFIFO_ADDR;
+  if (!hwfifo_xact(rhport, ep, len, ASYNC_RCVFIFO)) {
+    return false;
+  }
+  memcpy(ep->buf, _hcd_data.spi_rx + 1, len);
+  return true;
 }
 
 //--------------------------------------------------------------------+
@@ -521,26 +579,29 @@ bool hcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   TU_LOG2_HEX(revision);
   TU_ASSERT(revision == 0x01 || revision == 0x12 || revision == 0x13, false);
 
+  // INTR pin interrupt is re-enabled when unlocked
+  max3421_spi_lock(rhport, false);
+
   // reset
-  reg_write(rhport, USBCTL_ADDR, USBCTL_CHIPRES, false);
-  reg_write(rhport, USBCTL_ADDR, 0, false);
-  while( !(reg_read(rhport, USBIRQ_ADDR, false) & USBIRQ_OSCOK_IRQ) ) {
+  spi_reg_write(rhport, USBCTL_ADDR, USBCTL_CHIPRES);
+  spi_reg_write(rhport, USBCTL_ADDR, 0);
+  while( !(spi_reg_read(rhport, USBIRQ_ADDR) & USBIRQ_OSCOK_IRQ) ) {
     // wait for oscillator to stabilize
   }
 
   // Mode: Host and DP/DM pull down
-  mode_write(rhport, MODE_DPPULLDN | MODE_DMPULLDN | MODE_HOST, false);
+  mode_write(rhport, MODE_DPPULLDN | MODE_DMPULLDN | MODE_HOST);
 
   // frame reset & bus reset, this will trigger CONDET IRQ if device is already connected
-  reg_write(rhport, HCTL_ADDR, HCTL_BUSRST | HCTL_FRMRST, false);
+  spi_reg_write(rhport, HCTL_ADDR, HCTL_BUSRST | HCTL_FRMRST);
 
   // clear all previously pending IRQ
-  hirq_write(rhport, 0xff, false);
+  hirq_write(rhport, 0xff);
 
   // Enable IRQ
-  hien_write(rhport, DEFAULT_HIEN, false);
+  hien_write(rhport, DEFAULT_HIEN);
 
-  tuh_max3421_int_api(rhport, true);
+  max3421_spi_unlock(rhport, false);
 
   // Enable Interrupt pin
   reg_write(rhport, CPUCTL_ADDR, _tuh_cfg.cpuctl | CPUCTL_IE, false);
@@ -666,66 +727,76 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t daddr, tusb_desc_endpoint_t const * e
   Note: xact_out() is called when starting a new transfer, continue a transfer (isr) or retry a transfer (NAK)
         For NAK retry, we do not need to write to FIFO or SNDBC register again.
 */
-static void xact_out(uint8_t rhport, max3421_ep_t *ep, bool switch_ep, bool in_isr) {
+static void xact_out(uint8_t rhport, max3421_ep_t *ep, bool switch_ep) {
   // Page 12: Programming BULK-OUT Transfers
   // TODO: double buffering for ISO transfer
   if (switch_ep) {
-    peraddr_write(rhport, ep->daddr, in_isr);
+    peraddr_write(rhport, ep->daddr);
     const uint8_t hctl = (ep->data_toggle ? HCTL_SNDTOG1 : HCTL_SNDTOG0);
-    reg_write(rhport, HCTL_ADDR, hctl, in_isr);
+    spi_reg_write(rhport, HCTL_ADDR, hctl);
   }
 
   // Only write to sndfifo and sdnbc register if it is not a NAKed retry
-  if (!(ep->daddr == _hcd_data.sndfifo_owner.daddr && ep->hxfr == _hcd_data.sndfifo_owner.hxfr)) {
+  bool const is_retry = (ep->daddr == _hcd_data.sndfifo_owner.daddr && ep->hxfr == _hcd_data.sndfifo_owner.hxfr);
+  _hcd_data.sndfifo_owner.daddr = ep->daddr;
+  _hcd_data.sndfifo_owner.hxfr = ep->hxfr;
+
+  if (!is_retry) {
     // skip SNDBAV IRQ check, overwrite sndfifo if needed
     const uint8_t xact_len = (uint8_t) tu_min16(ep->total_len - ep->xferred_len, ep->packet_size);
-    hwfifo_send(rhport, ep->buf, xact_len, in_isr);
+    if (xact_len && !hwfifo_write(rhport, SNDFIFO_ADDR, ep, xact_len)) {
+      return; // SNDBC and HXFR are written in tuh_max3421_spi_xfer_done()
+    }
+    sndbc_write(rhport, xact_len);
   }
-  _hcd_data.sndfifo_owner.daddr = ep->daddr;
-  _hcd_data.sndfifo_owner.hxfr = ep->hxfr;
 
-  hxfr_write(rhport, ep->hxfr, in_isr);
+  hxfr_write(rhport, ep->hxfr);
 }
 
-static void xact_in(uint8_t rhport, max3421_ep_t *ep, bool switch_ep, bool in_isr) {
+static void xact_in(uint8_t rhport, max3421_ep_t *ep, bool switch_ep) {
   // Page 13: Programming BULK-IN Transfers
   if (switch_ep) {
-    peraddr_write(rhport, ep->daddr, in_isr);
+    peraddr_write(rhport, ep->daddr);
 
     uint8_t const hctl = (ep->data_toggle ? HCTL_RCVTOG1 : HCTL_RCVTOG0);
-    reg_write(rhport, HCTL_ADDR, hctl, in_isr);
+    spi_reg_write(rhport, HCTL_ADDR, hctl);
   }
 
-  hxfr_write(rhport, ep->hxfr, in_isr);
+  hxfr_write(rhport, ep->hxfr);
 }
 
-static void xact_setup(uint8_t rhport, max3421_ep_t *ep, bool in_isr) {
-  peraddr_write(rhport, ep->daddr, in_isr);
-  hwfifo_setup(rhport, ep->buf, in_isr);
-  hxfr_write(rhport, HXFR_SETUP, in_isr);
+static void xact_setup(uint8_t rhport, max3421_ep_t *ep) {
+  peraddr_write(rhport, ep->daddr);
+  if (!hwfifo_write(rhport, SUDFIFO_ADDR, ep, 8)) {
+    return; // HXFR is written in tuh_max3421_spi_xfer_done()
+  }
+  hxfr_write(rhport, HXFR_SETUP);
 }
 
-static void xact_generic(uint8_t rhport, max3421_ep_t *ep, bool switch_ep, bool in_isr) {
+// SPI lock must be held
+static void xact_generic(uint8_t rhport, max3421_ep_t *ep, bool switch_ep) {
+  _hcd_data.ep_last = (uint8_t) (ep - _hcd_data.ep);
+
   if (ep->hxfr_bm.ep_num == 0 ) {
     // setup
     if (ep->hxfr_bm.is_setup) {
-      xact_setup(rhport, ep, in_isr);
+      xact_setup(rhport, ep);
       return;
     }
 
     // status
     if (ep->buf == NULL || ep->total_len == 0) {
       const uint8_t hxfr = (uint8_t) (HXFR_HS | (ep->hxfr & HXFR_OUT_NIN));
-      peraddr_write(rhport, ep->daddr, in_isr);
-      hxfr_write(rhport, hxfr, in_isr);
+      peraddr_write(rhport, ep->daddr);
+      hxfr_write(rhport, hxfr);
       return;
     }
   }
 
   if (ep->hxfr_bm.is_out) {
-    xact_out(rhport, ep, switch_ep, in_isr);
+    xact_out(rhport, ep, switch_ep);
   }else {
-    xact_in(rhport, ep, switch_ep, in_isr);
+    xact_in(rhport, ep, switch_ep);
   }
 }
 
@@ -750,7 +821,9 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t daddr, uint8_t ep_addr, uint8_t * buf
 
   // carry out transfer if not busy
   if (!atomic_flag_test_and_set(&_hcd_data.busy)) {
-    xact_generic(rhport, ep, true, false);
+    max3421_spi_lock(rhport, false);
+    xact_generic(rhport, ep, true);
+    max3421_spi_unlock(rhport, false);
   }
 
   return true;
@@ -787,7 +860,9 @@ bool hcd_setup_send(uint8_t rhport, uint8_t daddr, uint8_t const setup_packet[8]
 
   // carry out transfer if not busy
   if (!atomic_flag_test_and_set(&_hcd_data.busy)) {
-    xact_setup(rhport, ep, false);
+    max3421_spi_lock(rhport, false);
+    xact_generic(rhport, ep, true);
+    max3421_spi_unlock(rhport, false);
   }
 
   return true;
@@ -807,7 +882,7 @@ bool hcd_edpt_clear_stall(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr) {
 //--------------------------------------------------------------------+
 
 static void handle_connect_irq(uint8_t rhport, bool in_isr) {
-  uint8_t const hrsl = reg_read(rhport, HRSL_ADDR, in_isr);
+  uint8_t const hrsl = spi_reg_read(rhport, HRSL_ADDR);
   uint8_t const jk = hrsl & (HRSL_JSTATUS | HRSL_KSTATUS);
 
   uint8_t new_mode = MODE_DPPULLDN | MODE_DMPULLDN | MODE_HOST;
@@ -816,12 +891,12 @@ static void handle_connect_irq(uint8_t rhport, bool in_isr) {
   switch(jk) {
     case 0x00:                          // SEO is disconnected
     case (HRSL_JSTATUS | HRSL_KSTATUS): // SE1 is illegal
-      mode_write(rhport, new_mode, in_isr);
+      mode_write(rhport, new_mode);
 
       // port reset anyway, this will help to stable bus signal for next connection
-      reg_write(rhport, HCTL_ADDR, HCTL_BUSRST, in_isr);
+      spi_reg_write(rhport, HCTL_ADDR, HCTL_BUSRST);
       hcd_event_device_remove(rhport, in_isr);
-      reg_write(rhport, HCTL_ADDR, 0, in_isr);
+      spi_reg_write(rhport, HCTL_ADDR, 0);
       break;
 
     default: {
@@ -839,7 +914,7 @@ static void handle_connect_irq(uint8_t rhport, bool in_isr) {
         TU_LOG3("Full speed\r\n");
       }
       new_mode |= MODE_SOFKAENAB;
-      mode_write(rhport, new_mode, in_isr);
+      mode_write(rhport, new_mode);
 
       // FIXME multiple MAX3421 rootdevice address is not 1
       uint8_t const daddr = 1;
@@ -868,7 +943,7 @@ static void xfer_complete_isr(uint8_t rhport, max3421_ep_t *ep, xfer_result_t re
   // Find next pending endpoint
   max3421_ep_t * next_ep = find_next_pending_ep(ep);
   if (next_ep) {
-    xact_generic(rhport, next_ep, true, in_isr);
+    xact_generic(rhport, next_ep, true);
   }else {
     // no more pending
     atomic_flag_clear(&_hcd_data.busy);
@@ -876,7 +951,7 @@ static void xfer_complete_isr(uint8_t rhport, max3421_ep_t *ep, xfer_result_t re
 }
 
 static void handle_xfer_done(uint8_t rhport, bool in_isr) {
-  const uint8_t hrsl = reg_read(rhport, HRSL_ADDR, in_isr);
+  const uint8_t hrsl = spi_reg_read(rhport, HRSL_ADDR);
   const uint8_t hresult = hrsl & HRSL_RESULT_MASK;
   const uint8_t ep_num = _hcd_data.hxfr_bm.ep_num;
   const uint8_t hxfr_type = _hcd_data.hxfr & 0xf0;
@@ -890,24 +965,18 @@ static void handle_xfer_done(uint8_t rhport, bool in_isr) {
     case HRSL_NAK:
       if (ep->state == EP_STATE_ABORTING) {
         ep->state = EP_STATE_IDLE;
-      } else {
-        if (ep_num == 0) {
-          // control endpoint -> retry immediately and return
-          hxfr_write(rhport, _hcd_data.hxfr, in_isr);
-          return;
-        }
-        if (EP_STATE_ATTEMPT_1 <= ep->state && ep->state < EP_STATE_ATTEMPT_MAX) {
-          ep->state++;
-        }
+      } else if (ep_num != 0 && EP_STATE_ATTEMPT_1 <= ep->state && ep->state < EP_STATE_ATTEMPT_MAX) {
+        // control endpoint is not limited by max NAK, but still gives other pending endpoints their turn
+        ep->state++;
       }
 
       max3421_ep_t * next_ep = find_next_pending_ep(ep);
       if (ep == next_ep) {
         // this endpoint is only one pending -> retry immediately
-        hxfr_write(rhport, _hcd_data.hxfr, in_isr);
+        hxfr_write(rhport, _hcd_data.hxfr);
       } else if (next_ep) {
         // switch to next pending endpoint
-        xact_generic(rhport, next_ep, true, in_isr);
+        xact_generic(rhport, next_ep, true);
       } else {
         // no more pending in this frame -> clear busy
         atomic_flag_clear(&_hcd_data.busy);
@@ -949,7 +1018,7 @@ static void handle_xfer_done(uint8_t rhport, bool in_isr) {
     if (ep->state == EP_STATE_COMPLETE) {
       xfer_complete_isr(rhport, ep, xfer_result, hrsl, in_isr);
     }else {
-      hxfr_write(rhport, _hcd_data.hxfr, in_isr); // more to transfer
+      hxfr_write(rhport, _hcd_data.hxfr); // more to transfer
     }
   } else {
     // SETUP or OUT transfer
@@ -974,7 +1043,7 @@ static void handle_xfer_done(uint8_t rhport, bool in_isr) {
     if (xact_len < ep->packet_size || ep->xferred_len >= ep->total_len) {
       xfer_complete_isr(rhport, ep, xfer_result, hrsl, in_isr);
     } else {
-      xact_out(rhport, ep, false, in_isr); // more to transfer
+      xact_out(rhport, ep, false); // more to transfer
     }
   }
 }
@@ -998,31 +1067,100 @@ void print_hirq(uint8_t hirq) {
   #define print_hirq(hirq)
 #endif
 
-// Interrupt handler
-void hcd_int_handler(uint8_t rhport, bool in_isr) {
-  uint8_t hirq = reg_read(rhport, HIRQ_ADDR, in_isr) & _hcd_data.hien;
-  if (!hirq) return;
+// Received data is copied to endpoint buffer: update transfer and ack RCVDAV IRQ. Return updated HIRQ
+static uint8_t handle_rcvdav_done(uint8_t rhport, max3421_ep_t* ep, uint8_t xact_len) {
+  ep->buf += xact_len;
+  ep->xferred_len += xact_len;
+
+  if (xact_len < ep->packet_size || ep->xferred_len >= ep->total_len) {
+    ep->state = EP_STATE_COMPLETE;
+  }
+
+  // ack RCVDVAV IRQ
+  hirq_write(rhport, HIRQ_RCVDAV_IRQ);
+  return spi_reg_read(rhport, HIRQ_ADDR);
+}
+
+// Process RCVDAV and HXFRDN IRQ until all are cleared.
+// Return false if suspended by an asynchronous FIFO transfer, which continues in tuh_max3421_spi_xfer_done()
+static bool handle_xfer_irq(uint8_t rhport, uint8_t hirq, bool in_isr) {
+#if CFG_TUH_MAX3421_SPI_ASYNC
+  _hcd_data.async_allowed = in_isr;
+#endif
+
+  // queue more transfer in handle_xfer_done() can cause hirq to be set again while external IRQ may not catch and/or
+  // not call this handler again. So we need to loop until all IRQ are cleared
+  while (hirq & (HIRQ_RCVDAV_IRQ | HIRQ_HXFRDN_IRQ)) {
+    // RCVDAV_IRQ can trigger 2 times (dual buffered), HIRQ is checked again before HXFRDN_IRQ
+    if (hirq & HIRQ_RCVDAV_IRQ) {
+      const uint8_t ep_num = _hcd_data.hxfr_bm.ep_num;
+      max3421_ep_t* ep = find_opened_ep(_hcd_data.peraddr, ep_num, 1);
+
+      const uint8_t rcvbc = spi_reg_read(rhport, RCVBC_ADDR);
+      const uint8_t xact_len = (uint8_t) tu_min16(rcvbc, ep->total_len - ep->xferred_len);
+      if (xact_len && !hwfifo_receive(rhport, ep, xact_len)) {
+        return false;
+      }
+
+      hirq = handle_rcvdav_done(rhport, ep, xact_len);
+      continue;
+    }
+
+    hirq_write(rhport, HIRQ_HXFRDN_IRQ);
+    handle_xfer_done(rhport, in_isr);
+
+#if CFG_TUH_MAX3421_SPI_ASYNC
+    if (_hcd_data.async_state != ASYNC_IDLE) {
+      return false; // next transaction is writing FIFO asynchronously
+    }
+#endif
+
+    hirq = spi_reg_read(rhport, HIRQ_ADDR);
+  }
+
+#if CFG_TUH_MAX3421_SPI_ASYNC
+  _hcd_data.async_allowed = false;
+#endif
+
+  // clear all interrupt except SNDBAV_IRQ (never clear by us). Note RCVDAV_IRQ, HXFRDN_IRQ already clear while processing
+  hirq &= (uint8_t) ~HIRQ_SNDBAV_IRQ;
+  if (hirq) {
+    hirq_write(rhport, hirq);
+  }
+
+  return true;
+}
+
+// Process all pending IRQ, return false if suspended by an asynchronous FIFO transfer
+static bool handle_int(uint8_t rhport, bool in_isr) {
+  uint8_t hirq = spi_reg_read(rhport, HIRQ_ADDR) & _hcd_data.hien;
+  if (!hirq) {
+    return true;
+  }
 //  print_hirq(hirq);
 
   if (hirq & HIRQ_FRAME_IRQ) {
     _hcd_data.frame_count++;
 
-    // reset all endpoints nak counter, retry with 1st pending ep.
-    max3421_ep_t* ep_retry = NULL;
+    // reset all endpoints nak counter
+    bool has_retry = false;
     for (size_t i = 0; i < CFG_TUH_MAX3421_ENDPOINT_TOTAL; i++) {
       max3421_ep_t* ep = &_hcd_data.ep[i];
       if (ep->packet_size && ep->state > EP_STATE_ATTEMPT_1) {
         ep->state = EP_STATE_ATTEMPT_1;
-
-        if (ep_retry == NULL) {
-          ep_retry = ep;
-        }
+        has_retry = true;
       }
     }
 
-    // start usb transfer if not busy
-    if (ep_retry != NULL && !atomic_flag_test_and_set(&_hcd_data.busy)) {
-      xact_generic(rhport, ep_retry, true, in_isr);
+    // start usb transfer if not busy, with the pending endpoint after the last scheduled one so that
+    // every endpoint gets the first slot of a frame in turn
+    if (has_retry && !atomic_flag_test_and_set(&_hcd_data.busy)) {
+      max3421_ep_t* ep_retry = find_next_pending_ep(&_hcd_data.ep[_hcd_data.ep_last]);
+      if (ep_retry) {
+        xact_generic(rhport, ep_retry, true);
+      } else {
+        atomic_flag_clear(&_hcd_data.busy);
+      }
     }
   }
 
@@ -1030,47 +1168,91 @@ void hcd_int_handler(uint8_t rhport, bool in_isr) {
     handle_connect_irq(rhport, in_isr);
   }
 
-  // queue more transfer in handle_xfer_done() can cause hirq to be set again while external IRQ may not catch and/or
-  // not call this handler again. So we need to loop until all IRQ are cleared
-  while (hirq & (HIRQ_RCVDAV_IRQ | HIRQ_HXFRDN_IRQ)) {
-    if (hirq & HIRQ_RCVDAV_IRQ) {
-      const uint8_t ep_num = _hcd_data.hxfr_bm.ep_num;
-      max3421_ep_t* ep = find_opened_ep(_hcd_data.peraddr, ep_num, 1);
-      uint8_t xact_len = 0;
-
-      // RCVDAV_IRQ can trigger 2 times (dual buffered)
-      while (hirq & HIRQ_RCVDAV_IRQ) {
-        const uint8_t rcvbc = reg_read(rhport, RCVBC_ADDR, in_isr);
-        xact_len = (uint8_t) tu_min16(rcvbc, ep->total_len - ep->xferred_len);
-        if (xact_len) {
-          hwfifo_receive(rhport, ep->buf, xact_len, in_isr);
-          ep->buf += xact_len;
-          ep->xferred_len += xact_len;
-        }
-
-        // ack RCVDVAV IRQ
-        hirq_write(rhport, HIRQ_RCVDAV_IRQ, in_isr);
-        hirq = reg_read(rhport, HIRQ_ADDR, in_isr);
-      }
+  return handle_xfer_irq(rhport, hirq, in_isr);
+}
 
-      if (xact_len < ep->packet_size || ep->xferred_len >= ep->total_len) {
-        ep->state = EP_STATE_COMPLETE;
-      }
+#if CFG_TUH_MAX3421_SPI_ASYNC
+// Handler in isr is complete: release SPI, and process again if handler is invoked in the meantime
+static void int_active_release(uint8_t rhport) {
+  while (1) {
+    atomic_flag_clear(&_hcd_data.int_active);
+
+    // nothing pending, or a new handler invocation has taken over
+    if (!_hcd_data.int_pending || atomic_flag_test_and_set(&_hcd_data.int_active)) {
+      return;
     }
 
-    if (hirq & HIRQ_HXFRDN_IRQ) {
-      hirq_write(rhport, HIRQ_HXFRDN_IRQ, in_isr);
-      handle_xfer_done(rhport, in_isr);
+    _hcd_data.int_pending = false;
+    if (!handle_int(rhport, true)) {
+      return;
     }
+  }
+}
+
+void tuh_max3421_spi_xfer_done(uint8_t rhport) {
+  tuh_max3421_spi_cs_api(rhport, false);
+  _hcd_data.hirq = _hcd_data.spi_rx[0];
 
-    hirq = reg_read(rhport, HIRQ_ADDR, in_isr);
+  max3421_ep_t* ep = _hcd_data.async_ep;
+  uint8_t const len = _hcd_data.async_len;
+  uint8_t const state = _hcd_data.async_state;
+  _hcd_data.async_state = ASYNC_IDLE;
+
+  // continue where the handler was suspended
+  uint8_t hirq;
+  switch (state) {
+    case ASYNC_RCVFIFO:
+      memcpy(ep->buf, _hcd_data.spi_rx + 1, len);
+      hirq = handle_rcvdav_done(rhport, ep, len);
+      break;
+
+    case ASYNC_SNDFIFO:
+      sndbc_write(rhport, len);
+      hxfr_write(rhport, ep->hxfr);
+      hirq = spi_reg_read(rhport, HIRQ_ADDR);
+      break;
+
+    case ASYNC_SUDFIFO:
+      hxfr_write(rhport, HXFR_SETUP);
+      hirq = spi_reg_read(rhport, HIRQ_ADDR);
+      break;
+
+    default: return; // spurious
   }
 
-  // clear all interrupt except SNDBAV_IRQ (never clear by us). Note RCVDAV_IRQ, HXFRDN_IRQ already clear while processing
-  hirq &= (uint8_t) ~HIRQ_SNDBAV_IRQ;
-  if (hirq) {
-    hirq_write(rhport, hirq, in_isr);
+  if (handle_xfer_irq(rhport, hirq, true)) {
+    int_active_release(rhport);
   }
 }
+#endif
+
+// Interrupt handler
+void hcd_int_handler(uint8_t rhport, bool in_isr) {
+#if CFG_TUH_MAX3421_SPI_ASYNC
+  if (in_isr) {
+    // SPI is used by an asynchronous transfer, this interrupt is processed when it is complete
+    _hcd_data.int_pending = true;
+    if (atomic_flag_test_and_set(&_hcd_data.int_active)) {
+      return;
+    }
+    _hcd_data.int_pending = false;
+  }
+#endif
+
+  // all register accesses of this handler are done within a single SPI lock
+  max3421_spi_lock(rhport, in_isr);
+
+  if (!handle_int(rhport, in_isr)) {
+    return; // continued in tuh_max3421_spi_xfer_done()
+  }
+
+#if CFG_TUH_MAX3421_SPI_ASYNC
+  if (in_isr) {
+    int_active_release(rhport);
+  }
+#endif
+
+  max3421_spi_unlock(rhport, in_isr);
+}
 
 #endif
@@ -48,6 +48,8 @@ enum {
   USBCMD_INTR_THRESHOLD_MASK = 0x00FF0000u, // Interrupt Threshold bit 23:16
 };
 
+#define USBCMD_INTR_THRESHOLD_POS  16
+
 // PORTSC1
 #define PORTSC1_PORT_SPEED_POS    26
 
@@ -29,22 +29,28 @@
 #if CFG_TUD_ENABLED && defined(TUP_USBIP_CHIPIDEA_HS)
 
 #include "device/dcd.h"
+#include "device/usbd.h"
 #include "ci_hs_type.h"
 
 #if CFG_TUSB_MCU == OPT_MCU_MIMXRT1XXX
   #include "ci_hs_imxrt.h"
 
 #if CFG_TUD_MEM_DCACHE_ENABLE
+// no maintenance needed for buffer in non-cacheable memory declared by application (TCM is checked by imxrt_dcache_*)
+TU_ATTR_ALWAYS_INLINE static inline bool dcache_skip(void const* addr, uint32_t data_size) {
+  return tu_mem_within(addr, data_size, CFG_TUD_MEM_NONCACHEABLE_ADDR, CFG_TUD_MEM_NONCACHEABLE_SIZE);
+}
+
 bool dcd_dcache_clean(void const* addr, uint32_t data_size) {
-  return imxrt_dcache_clean(addr, data_size);
+  return dcache_skip(addr, data_size) || imxrt_dcache_clean(addr, data_size);
 }
 
 bool dcd_dcache_invalidate(void const* addr, uint32_t data_size) {
-  return imxrt_dcache_invalidate(addr, data_size);
+  return dcache_skip(addr, data_size) || imxrt_dcache_invalidate(addr, data_size);
 }
 
 bool dcd_dcache_clean_invalidate(void const* addr, uint32_t data_size) {
-  return imxrt_dcache_clean_invalidate(addr, data_size);
+  return dcache_skip(addr, data_size) || imxrt_dcache_clean_invalidate(addr, data_size);
 }
 #endif
 
@@ -144,7 +150,9 @@ typedef struct
   // Therefore there are 16 bytes padding that we can use.
   //--------------------------------------------------------------------+
   tu_fifo_t * ff;
-  uint8_t reserved[12];
+  tu_iso_packet_t * iso_packets; // packet list of dcd_edpt_iso_xfer(), one qtd per packet
+  uint8_t qtd_count; // number of chained qtd of current transfer
+  uint8_t reserved[7];
 } dcd_qhd_t;
 
 TU_VERIFY_STATIC( sizeof(dcd_qhd_t) == 64, "size is not correct");
@@ -155,17 +163,29 @@ TU_VERIFY_STATIC( sizeof(dcd_qhd_t) == 64, "size is not correct");
 
 #define QTD_NEXT_INVALID 0x01
 
+// a qtd can hold 5 pages, maximum is 20KB if buffer is 4K aligned
+#define QTD_PAGE_COUNT   5
+
+TU_VERIFY_STATIC(CFG_TUD_CI_HS_QTD_PER_EP >= 1 && CFG_TUD_CI_HS_QTD_PER_EP <= 255, "invalid qtd count");
+
 typedef struct {
   // Must be at 2K alignment
   // Each endpoint with direction (IN/OUT) occupies a queue head
-  // for portability, TinyUSB only queue 1 TD for each Qhd
+  // A transfer is a chain of up to CFG_TUD_CI_HS_QTD_PER_EP TDs, only one transfer is queued for each Qhd
   dcd_qhd_t qhd[TUP_DCD_ENDPOINT_MAX][2] TU_ATTR_ALIGNED(64);
-  dcd_qtd_t qtd[TUP_DCD_ENDPOINT_MAX][2] TU_ATTR_ALIGNED(32);
+  dcd_qtd_t qtd[TUP_DCD_ENDPOINT_MAX][2][CFG_TUD_CI_HS_QTD_PER_EP] TU_ATTR_ALIGNED(32);
 }dcd_data_t;
 
 CFG_TUD_MEM_SECTION TU_ATTR_ALIGNED(2048)
 static dcd_data_t _dcd_data;
 
+// Interrupt threshold in micro-frames, kept across dcd_init() since it can be configured before
+static uint8_t _dcd_itc = CFG_TUD_CI_HS_ITC;
+
+TU_ATTR_ALWAYS_INLINE static inline uint32_t usbcmd_itc(uint32_t usbcmd) {
+  return (usbcmd & ~USBCMD_INTR_THRESHOLD_MASK) | ((uint32_t) _dcd_itc << USBCMD_INTR_THRESHOLD_POS);
+}
+
 //--------------------------------------------------------------------+
 // Prototypes and Helper Functions
 //--------------------------------------------------------------------+
@@ -222,6 +242,23 @@ static void bus_reset(uint8_t rhport)
   dcd_dcache_clean_invalidate(&_dcd_data, sizeof(dcd_data_t));
 }
 
+bool dcd_configure(uint8_t rhport, uint32_t cfg_id, const void* cfg_param) {
+  TU_VERIFY(cfg_id == TUD_CFGID_INTR_THRESHOLD && cfg_param != NULL);
+
+  // 0 or power of 2 up to 64 micro-frames
+  const uint8_t itc = *((const uint8_t*) cfg_param);
+  TU_VERIFY(itc <= 64 && (itc & (itc - 1)) == 0);
+  _dcd_itc = itc;
+
+  // threshold can be changed while running, applied to interrupts pending from now on
+  ci_hs_regs_t* dcd_reg = CI_HS_REG(rhport);
+  if (dcd_reg->USBCMD & USBCMD_RUN_STOP) {
+    dcd_reg->USBCMD = usbcmd_itc(dcd_reg->USBCMD);
+  }
+
+  return true;
+}
+
 bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   (void) rh_init;
   tu_memclr(&_dcd_data, sizeof(dcd_data_t));
@@ -251,8 +288,7 @@ bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   dcd_reg->USBSTS  = dcd_reg->USBSTS;
   dcd_reg->USBINTR = INTR_USB | INTR_ERROR | INTR_PORT_CHANGE | INTR_SUSPEND;
 
-  uint32_t usbcmd = dcd_reg->USBCMD;
-  usbcmd &= ~USBCMD_INTR_THRESHOLD_MASK; // Interrupt Threshold Interval = 0
+  uint32_t usbcmd = usbcmd_itc(dcd_reg->USBCMD);
   usbcmd |= USBCMD_RUN_STOP; // run
 
   dcd_reg->USBCMD = usbcmd;
@@ -288,7 +324,7 @@ void dcd_remote_wakeup(uint8_t rhport)
 void dcd_connect(uint8_t rhport)
 {
   ci_hs_regs_t* dcd_reg = CI_HS_REG(rhport);
-  dcd_reg->USBCMD |= USBCMD_RUN_STOP;
+  dcd_reg->USBCMD = usbcmd_itc(dcd_reg->USBCMD) | USBCMD_RUN_STOP;
 }
 
 void dcd_disconnect(uint8_t rhport)
@@ -339,6 +375,62 @@ static void qtd_init(dcd_qtd_t* p_qtd, void * data_ptr, uint16_t total_bytes)
   }
 }
 
+// ISO IN qtd carrying one micro-frame: send only as many transactions as needed so that PID sequence
+// (DATA2/DATA1/DATA0) matches the data, instead of MULT of qhd
+TU_ATTR_ALWAYS_INLINE static inline void qtd_iso_mult(dcd_qhd_t const* p_qhd, uint8_t dir, dcd_qtd_t* p_qtd,
+                                                      uint16_t len)
+{
+  uint16_t const mps = p_qhd->max_packet_size;
+  if (dir == TUSB_DIR_IN && p_qhd->iso_mult > 1 && len <= p_qhd->iso_mult * mps)
+  {
+    p_qtd->iso_mult_override = (len > mps) ? (tu_div_ceil(len, mps) & 0x03u) : 1u;
+  }
+}
+
+// Append buffer to qtd chain of endpoint. Each qtd covers up to 5 pages and, except the last one of the buffer,
+// ends at packet boundary since packet can not span multiple qtds. Return false if there is not enough qtd.
+static bool qtd_chain_append(uint8_t epnum, uint8_t dir, uint8_t* buffer, uint32_t total_bytes)
+{
+  dcd_qhd_t* p_qhd = &_dcd_data.qhd[epnum][dir];
+  dcd_qtd_t* qtd_list = _dcd_data.qtd[epnum][dir];
+  uint16_t const mps = p_qhd->max_packet_size;
+
+  do
+  {
+    TU_VERIFY(p_qhd->qtd_count < CFG_TUD_CI_HS_QTD_PER_EP);
+
+    uint32_t len = total_bytes;
+    uint32_t const qtd_max = QTD_PAGE_COUNT * 4096u - tu_offset4k((uint32_t) buffer);
+    if (len > qtd_max)
+    {
+      len = qtd_max - (qtd_max % mps);
+    }
+
+    dcd_qtd_t* p_qtd = &qtd_list[p_qhd->qtd_count];
+    qtd_init(p_qtd, buffer, (uint16_t) len);
+    qtd_iso_mult(p_qhd, dir, p_qtd, (uint16_t) len);
+
+    // IN only interrupts on the last qtd. OUT interrupts on each one to detect short packet, which retires the
+    // current qtd but not the rest of the chain
+    if (dir == TUSB_DIR_IN) p_qtd->int_on_complete = false;
+
+    if (p_qhd->qtd_count) qtd_list[p_qhd->qtd_count - 1].next = (uint32_t) p_qtd;
+    p_qhd->qtd_count++;
+
+    if (buffer) buffer += len;
+    total_bytes -= len;
+  } while (total_bytes);
+
+  return true;
+}
+
+// Interrupt on the last qtd of the chain
+TU_ATTR_ALWAYS_INLINE static inline void qtd_chain_end(uint8_t epnum, uint8_t dir)
+{
+  dcd_qhd_t* p_qhd = &_dcd_data.qhd[epnum][dir];
+  _dcd_data.qtd[epnum][dir][p_qhd->qtd_count - 1].int_on_complete = true;
+}
+
 //--------------------------------------------------------------------+
 // DCD Endpoint Port
 //--------------------------------------------------------------------+
@@ -383,7 +475,8 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc)
   p_qhd->max_packet_size         = tu_edpt_packet_size(p_endpoint_desc);
   if (p_endpoint_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS)
   {
-    p_qhd->iso_mult = 1;
+    // transactions per micro-frame, 2-3 for high-bandwidth endpoint
+    p_qhd->iso_mult = tu_edpt_hs_mult(p_endpoint_desc) & 0x03u;
   }
 
   p_qhd->qtd_overlay.next        = QTD_NEXT_INVALID;
@@ -442,10 +535,10 @@ static void qhd_start_xfer(uint8_t rhport, uint8_t epnum, uint8_t dir)
 {
   ci_hs_regs_t* dcd_reg = CI_HS_REG(rhport);
   dcd_qhd_t* p_qhd = &_dcd_data.qhd[epnum][dir];
-  dcd_qtd_t* p_qtd = &_dcd_data.qtd[epnum][dir];
+  dcd_qtd_t* p_qtd = &_dcd_data.qtd[epnum][dir][0];
 
   p_qhd->qtd_overlay.halted = false;            // clear any previous error
-  p_qhd->qtd_overlay.next   = (uint32_t) p_qtd; // link qtd to qhd
+  p_qhd->qtd_overlay.next   = (uint32_t) p_qtd; // link qtd chain to qhd
 
   // flush cache
   dcd_dcache_clean_invalidate(&_dcd_data, sizeof(dcd_data_t));
@@ -467,18 +560,82 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t t
   uint8_t const dir   = tu_edpt_dir(ep_addr);
 
   dcd_qhd_t* p_qhd = &_dcd_data.qhd[epnum][dir];
-  dcd_qtd_t* p_qtd = &_dcd_data.qtd[epnum][dir];
 
-  // Prepare qtd
-  qtd_init(p_qtd, buffer, total_bytes);
+  // Prepare qtd chain, TUP_DCD_EDPT_XFER_MAX always fits
+  p_qhd->qtd_count = 0;
+  TU_ASSERT(qtd_chain_append(epnum, dir, buffer, total_bytes));
+  qtd_chain_end(epnum, dir);
 
   // Start qhd transfer
   p_qhd->ff = NULL;
+  p_qhd->iso_packets = NULL;
   qhd_start_xfer(rhport, epnum, dir);
 
   return true;
 }
 
+#if CFG_TUD_EDPT_XFER_SG
+// Chain qtds of all buffers as one transfer. Non-last buffer must be multiple of packet size.
+bool dcd_edpt_xfer_sg(uint8_t rhport, uint8_t ep_addr, tu_xfer_sg_t const* sg_list, uint8_t count)
+{
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir   = tu_edpt_dir(ep_addr);
+
+  dcd_qhd_t* p_qhd = &_dcd_data.qhd[epnum][dir];
+  p_qhd->qtd_count = 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    // skip empty buffer, unless the whole list is a ZLP
+    if (sg_list[i].len == 0 && !(i == count - 1 && p_qhd->qtd_count == 0)) continue;
+
+    TU_ASSERT(i == count - 1 || (sg_list[i].len % p_qhd->max_packet_size) == 0);
+    TU_ASSERT(qtd_chain_append(epnum, dir, sg_list[i].buffer, sg_list[i].len));
+  }
+  qtd_chain_end(epnum, dir);
+
+  p_qhd->ff = NULL;
+  p_qhd->iso_packets = NULL;
+  qhd_start_xfer(rhport, epnum, dir);
+
+  return true;
+}
+#endif
+
+#if CFG_TUD_EDPT_ISO_XFER
+// One qtd per packet, each is retired in its own (micro)frame. Only the last qtd interrupts.
+bool dcd_edpt_iso_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, tu_iso_packet_t * packets, uint16_t count)
+{
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir   = tu_edpt_dir(ep_addr);
+
+  dcd_qhd_t* p_qhd = &_dcd_data.qhd[epnum][dir];
+  dcd_qtd_t* qtd_list = _dcd_data.qtd[epnum][dir];
+  TU_ASSERT(count && count <= CFG_TUD_CI_HS_QTD_PER_EP);
+
+  for (uint16_t i = 0; i < count; i++)
+  {
+    // qhd executes MULT transactions per (micro)frame
+    TU_ASSERT(packets[i].len <= p_qhd->max_packet_size * tu_max32(p_qhd->iso_mult, 1));
+
+    dcd_qtd_t* p_qtd = &qtd_list[i];
+    qtd_init(p_qtd, buffer, packets[i].len);
+    qtd_iso_mult(p_qhd, dir, p_qtd, packets[i].len);
+    p_qtd->int_on_complete = (i == count - 1);
+    if (i) qtd_list[i - 1].next = (uint32_t) p_qtd;
+
+    buffer += packets[i].len;
+  }
+  p_qhd->qtd_count = (uint8_t) count;
+
+  p_qhd->ff = NULL;
+  p_qhd->iso_packets = packets;
+  qhd_start_xfer(rhport, epnum, dir);
+
+  return true;
+}
+#endif
+
 #if !CFG_TUD_MEM_DCACHE_ENABLE
 // fifo has to be aligned to 4k boundary
 // It's incompatible with dcache enabled transfer, since neither address nor size is aligned to cache line
@@ -488,7 +645,8 @@ bool dcd_edpt_xfer_fifo (uint8_t rhport, uint8_t ep_addr, tu_fifo_t * ff, uint16
   uint8_t const dir   = tu_edpt_dir(ep_addr);
 
   dcd_qhd_t * p_qhd = &_dcd_data.qhd[epnum][dir];
-  dcd_qtd_t * p_qtd = &_dcd_data.qtd[epnum][dir];
+  dcd_qtd_t * p_qtd = &_dcd_data.qtd[epnum][dir][0];
+  p_qhd->qtd_count = 1;
 
   tu_fifo_buffer_info_t fifo_info;
 
@@ -537,6 +695,7 @@ bool dcd_edpt_xfer_fifo (uint8_t rhport, uint8_t ep_addr, tu_fifo_t * ff, uint16
 
   // Start qhd transfer
   p_qhd->ff = ff;
+  p_qhd->iso_packets = NULL;
   qhd_start_xfer(rhport, epnum, dir);
 
   return true;
@@ -550,32 +709,79 @@ bool dcd_edpt_xfer_fifo (uint8_t rhport, uint8_t ep_addr, tu_fifo_t * ff, uint16
 static void process_edpt_complete_isr(uint8_t rhport, uint8_t epnum, uint8_t dir)
 {
   dcd_qhd_t * p_qhd = &_dcd_data.qhd[epnum][dir];
-  dcd_qtd_t * p_qtd = &_dcd_data.qtd[epnum][dir];
+  dcd_qtd_t * qtd_list = _dcd_data.qtd[epnum][dir];
+
+  // Walk the retired qtds: transfer is complete with the last qtd, a short packet or an error
+  uint8_t result = XFER_RESULT_SUCCESS;
+  uint32_t xferred_bytes = 0;
+  bool is_done = false;
+  uint8_t i;
+
+#if CFG_TUD_EDPT_ISO_XFER
+  if (p_qhd->iso_packets)
+  {
+    // error or short packet does not stop an isochronous list, report each packet once the last one is retired
+    if (qtd_list[p_qhd->qtd_count - 1].active) return;
+
+    for (i = 0; i < p_qhd->qtd_count; i++)
+    {
+      dcd_qtd_t* p_qtd = &qtd_list[i];
+      tu_iso_packet_t* packet = &p_qhd->iso_packets[i];
+
+      packet->actual_len = (uint16_t) (p_qtd->expected_bytes - p_qtd->total_bytes);
+      packet->result     = (p_qtd->halted || p_qtd->xact_err || p_qtd->buffer_err) ? XFER_RESULT_FAILED : XFER_RESULT_SUCCESS;
+      if (packet->result != XFER_RESULT_SUCCESS) result = XFER_RESULT_FAILED;
+      xferred_bytes += packet->actual_len;
+    }
 
-  uint8_t result = p_qtd->halted ? XFER_RESULT_STALLED :
-      ( p_qtd->xact_err || p_qtd->buffer_err ) ? XFER_RESULT_FAILED : XFER_RESULT_SUCCESS;
+    p_qhd->iso_packets = NULL;
+    dcd_event_xfer_complete(rhport, tu_edpt_addr(epnum, dir), xferred_bytes, result, true);
+    return;
+  }
+#endif
 
-  if ( result != XFER_RESULT_SUCCESS )
+  for (i = 0; i < p_qhd->qtd_count; i++)
+  {
+    dcd_qtd_t* p_qtd = &qtd_list[i];
+
+    if (p_qtd->halted || p_qtd->xact_err || p_qtd->buffer_err)
+    {
+      result = p_qtd->halted ? XFER_RESULT_STALLED : XFER_RESULT_FAILED;
+      is_done = true;
+      break;
+    }
+
+    if (p_qtd->active) break; // interrupt of an intermediate OUT qtd
+
+    xferred_bytes += (uint32_t) (p_qtd->expected_bytes - p_qtd->total_bytes);
+    if (i == p_qhd->qtd_count - 1 || p_qtd->total_bytes)
+    {
+      is_done = true;
+      break;
+    }
+  }
+
+  if (!is_done) return;
+
+  if ( result != XFER_RESULT_SUCCESS || i < p_qhd->qtd_count - 1 )
   {
     ci_hs_regs_t* dcd_reg = CI_HS_REG(rhport);
-    // flush to abort error buffer
+    // flush to abort error buffer, or the rest of the chain after a short packet
     dcd_reg->ENDPTFLUSH = TU_BIT(epnum + (dir ? 16 : 0));
   }
 
-  uint16_t const xferred_bytes = p_qtd->expected_bytes - p_qtd->total_bytes;
-
   if (p_qhd->ff)
   {
     if (dir == TUSB_DIR_IN)
     {
-      tu_fifo_advance_read_pointer(p_qhd->ff, xferred_bytes);
+      tu_fifo_advance_read_pointer(p_qhd->ff, (uint16_t) xferred_bytes);
     } else
     {
-      tu_fifo_advance_write_pointer(p_qhd->ff, xferred_bytes);
+      tu_fifo_advance_write_pointer(p_qhd->ff, (uint16_t) xferred_bytes);
     }
   }
 
-  // only number of bytes in the IOC qtd
+  // total bytes of the qtd chain
   dcd_event_xfer_complete(rhport, tu_edpt_addr(epnum, dir), xferred_bytes, result, true);
 }
 
@@ -43,16 +43,21 @@
 #include "ci_hs_imxrt.h"
 
 #if CFG_TUH_MEM_DCACHE_ENABLE
+// no maintenance needed for buffer in non-cacheable memory declared by application (TCM is checked by imxrt_dcache_*)
+TU_ATTR_ALWAYS_INLINE static inline bool dcache_skip(void const* addr, uint32_t data_size) {
+  return tu_mem_within(addr, data_size, CFG_TUH_MEM_NONCACHEABLE_ADDR, CFG_TUH_MEM_NONCACHEABLE_SIZE);
+}
+
 bool hcd_dcache_clean(void const* addr, uint32_t data_size) {
-  return imxrt_dcache_clean(addr, data_size);
+  return dcache_skip(addr, data_size) || imxrt_dcache_clean(addr, data_size);
 }
 
 bool hcd_dcache_invalidate(void const* addr, uint32_t data_size) {
-  return imxrt_dcache_invalidate(addr, data_size);
+  return dcache_skip(addr, data_size) || imxrt_dcache_invalidate(addr, data_size);
 }
 
 bool hcd_dcache_clean_invalidate(void const* addr, uint32_t data_size) {
-  return imxrt_dcache_clean_invalidate(addr, data_size);
+  return dcache_skip(addr, data_size) || imxrt_dcache_clean_invalidate(addr, data_size);
 }
 #endif
 
@@ -148,6 +148,13 @@ typedef struct
 #ifndef TU_DA146XX_DMA_RX_CHANNEL
 #define TU_DA146XX_DMA_RX_CHANNEL 6
 #endif
+
+// DMA is always used for packets larger than FIFO (ISO endpoints). When set, full size packets of bulk
+// endpoints are moved by DMA too, so the CPU does not have to copy them byte by byte from interrupts.
+// DMA channel pair is still shared: endpoint that finds it busy falls back to CPU for that packet.
+#ifndef TU_DA146XX_DMA_BULK
+#define TU_DA146XX_DMA_BULK 0
+#endif
 #define DA146XX_DMA_USB_MUX       (0x6 << (TU_DA146XX_DMA_RX_CHANNEL * 2))
 #define DA146XX_DMA_USB_MUX_MASK  (0xF << (TU_DA146XX_DMA_RX_CHANNEL * 2))
 
@@ -225,6 +232,8 @@ typedef struct {
   uint8_t stall : 1;
   // ISO endpoint
   uint8_t iso : 1;
+  // Bulk endpoint
+  uint8_t bulk : 1;
 } xfer_ctl_t;
 
 static struct
@@ -340,6 +349,12 @@ static bool try_allocate_dma(uint8_t epnum, uint8_t dir)
   return _dcd.dma_ep[dir] == epnum;
 }
 
+// Packet of bulk endpoint that fits in FIFO is worth DMA when it is a full one.
+static inline bool bulk_packet_use_dma(xfer_ctl_t const *xfer, uint16_t remaining)
+{
+  return TU_DA146XX_DMA_BULK && xfer->bulk && remaining >= xfer->max_packet_size;
+}
+
 static void start_rx_dma(volatile void *src, void *dst, uint16_t size)
 {
   // Setup SRC and DST registers
@@ -379,6 +394,11 @@ static void start_rx_packet(xfer_ctl_t *xfer)
     // If max_packet_size would fit in FIFO no need for FIFO level warning interrupt.
     regs->rxc &= ~USB_USB_RXC1_REG_USB_RFWL_Msk;
     USB->USB_FWMSK_REG &= ~(1 << (epnum - 1 + USB_USB_FWMSK_REG_USB_M_RXWARN31_Pos));
+    if (bulk_packet_use_dma(xfer, remaining) && try_allocate_dma(epnum, TUSB_DIR_OUT))
+    {
+      // RX_LAST event stops DMA and reads whatever is left in FIFO.
+      start_rx_dma(&regs->rxd, xfer->buffer + xfer->transferred, size);
+    }
   }
   regs->rxc |= USB_USB_RXC1_REG_USB_RX_EN_Msk;
 }
@@ -407,7 +427,8 @@ static void start_tx_packet(xfer_ctl_t *xfer)
   regs->txc = USB_USB_TXC1_REG_USB_IGN_ISOMSK_Msk;
   if (xfer->data1) regs->txc |= USB_USB_TXC1_REG_USB_TOGGLE_TX_Msk;
 
-  if (xfer->max_packet_size > FIFO_SIZE && remaining > FIFO_SIZE && try_allocate_dma(epnum, TUSB_DIR_IN))
+  if (((xfer->max_packet_size > FIFO_SIZE && remaining > FIFO_SIZE) || bulk_packet_use_dma(xfer, remaining)) &&
+      try_allocate_dma(epnum, TUSB_DIR_IN))
   {
     // Whole packet will be put in FIFO by DMA. Set LAST bit before start.
     start_tx_dma(xfer->buffer + xfer->transferred, &regs->txd, size);
@@ -937,6 +958,7 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * desc_edpt)
   xfer->ep_addr = desc_edpt->bEndpointAddress;
   xfer->data1 = 0;
   xfer->iso = 0;
+  xfer->bulk = (epnum != 0 && desc_edpt->bmAttributes.xfer == TUSB_XFER_BULK);
 
   if (epnum != 0 && desc_edpt->bmAttributes.xfer == 1)
   {
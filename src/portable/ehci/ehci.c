@@ -34,6 +34,7 @@
 #include "osal/osal.h"
 
 #include "host/hcd.h"
+#include "host/usbh.h"
 #include "ehci_api.h"
 #include "ehci.h"
 
@@ -44,32 +45,96 @@
 // Debug level of EHCI
 #define EHCI_DBG     2
 
-// Framelist size as small as possible to save SRAM
-#ifdef TUP_USBIP_CHIPIDEA_HS
-  // NXP Transdimension: 8 elements
+// Framelist size, USBCMD encodes it as 1024 >> value
+#if CFG_TUH_EHCI_FRAMELIST_SIZE == 1024
+  #define FRAMELIST_SIZE_BIT_VALUE      0u
+#elif CFG_TUH_EHCI_FRAMELIST_SIZE == 512
+  #define FRAMELIST_SIZE_BIT_VALUE      1u
+#elif CFG_TUH_EHCI_FRAMELIST_SIZE == 256
+  #define FRAMELIST_SIZE_BIT_VALUE      2u
+#elif defined(TUP_USBIP_CHIPIDEA_HS) && CFG_TUH_EHCI_FRAMELIST_SIZE == 128
+  #define FRAMELIST_SIZE_BIT_VALUE      3u
+#elif defined(TUP_USBIP_CHIPIDEA_HS) && CFG_TUH_EHCI_FRAMELIST_SIZE == 64
+  #define FRAMELIST_SIZE_BIT_VALUE      4u
+#elif defined(TUP_USBIP_CHIPIDEA_HS) && CFG_TUH_EHCI_FRAMELIST_SIZE == 32
+  #define FRAMELIST_SIZE_BIT_VALUE      5u
+#elif defined(TUP_USBIP_CHIPIDEA_HS) && CFG_TUH_EHCI_FRAMELIST_SIZE == 16
+  #define FRAMELIST_SIZE_BIT_VALUE      6u
+#elif defined(TUP_USBIP_CHIPIDEA_HS) && CFG_TUH_EHCI_FRAMELIST_SIZE == 8
   #define FRAMELIST_SIZE_BIT_VALUE      7u
+#else
+  #error "CFG_TUH_EHCI_FRAMELIST_SIZE is not supported by this controller"
+#endif
+
+#ifdef TUP_USBIP_CHIPIDEA_HS
+  // NXP Transdimension: bit 2 of frame list size is located at bit 15
   #define FRAMELIST_SIZE_USBCMD_VALUE   (((FRAMELIST_SIZE_BIT_VALUE &  3) << EHCI_USBCMD_FRAMELIST_SIZE_SHIFT) | \
                                          ((FRAMELIST_SIZE_BIT_VALUE >> 2) << EHCI_USBCMD_CHIPIDEA_FRAMELIST_SIZE_MSB_SHIFT))
 #else
-  // STD EHCI: 256 elements
-  #define FRAMELIST_SIZE_BIT_VALUE      2u
-  #define FRAMELIST_SIZE_USBCMD_VALUE   ((FRAMELIST_SIZE_BIT_VALUE &  3) << EHCI_USBCMD_POS_FRAMELIST_SIZE)
+  #define FRAMELIST_SIZE_USBCMD_VALUE   ((FRAMELIST_SIZE_BIT_VALUE &  3) << EHCI_USBCMD_FRAMELIST_SIZE_SHIFT)
 #endif
 
 #define FRAMELIST_SIZE                  (1024 >> FRAMELIST_SIZE_BIT_VALUE)
 
-// Total queue head pool. TODO should be user configurable and more optimize memory usage in the future
-#define QHD_MAX      (CFG_TUH_DEVICE_MAX*CFG_TUH_ENDPOINT_MAX + CFG_TUH_HUB)
-#define QTD_MAX      QHD_MAX
+#define QHD_MAX      CFG_TUH_EHCI_QHD_MAX
+#define QTD_MAX      CFG_TUH_EHCI_QTD_MAX
+
+// free list index, the max value is used as end of list
+TU_VERIFY_STATIC(QHD_MAX < UINT8_MAX, "CFG_TUH_EHCI_QHD_MAX is too large");
+TU_VERIFY_STATIC(QTD_MAX < 1023, "CFG_TUH_EHCI_QTD_MAX is too large");
+TU_VERIFY_STATIC(CFG_TUH_EHCI_ASYNC_PARK_COUNT <= 3, "CFG_TUH_EHCI_ASYNC_PARK_COUNT must be 0-3");
+
+#define QHD_FREE_END   UINT8_MAX
+#define QTD_FREE_END   1023u
+
+// Polling interval tree has 4 levels: 1 ms (including sub-millisecond), 2 ms, 4 ms, 8 ms.
+// Longer interval is polled every 8 ms
+#define PERIOD_INTERVAL_MAX   8u
+#define PERIOD_LEVEL_COUNT    4u
+
+#define EHCI_ISO_ENABLED      (CFG_TUH_EHCI_ISO_ENDPOINT_MAX > 0)
+
+#if EHCI_ISO_ENABLED
+// Isochronous endpoint, serviced by iTD (highspeed) or siTD (full speed via TT) linked directly into framelist.
+// Note usbh only queues 1 transfer per endpoint, which can span up to EHCI_ISO_XFER_FRAME_MAX frames.
+typedef struct {
+  uint8_t used;
+  uint8_t active;        // transfer is scheduled
+  uint8_t dev_addr;
+  uint8_t ep_addr;
+
+  uint8_t speed;
+  uint8_t hub_addr;
+  uint8_t hub_port;
+  uint8_t mult;          // transactions per micro-frame (highspeed only)
+
+  uint8_t interval_log2; // service interval is 2^interval_log2 micro-frames
+  uint8_t smask;         // highspeed: micro-frames to transfer, full speed: start-split micro-frames
+  uint8_t cmask;         // full speed: complete-split micro-frames
+  uint8_t td_count;      // number of TDs of current transfer
+
+  uint16_t max_packet_size;
+  uint16_t pkt_count;    // packets of current transfer
+
+  uint8_t* buffer;
+  uint32_t buflen;
+#if CFG_TUH_EDPT_ISO_XFER
+  tu_iso_packet_t* packets; // per-packet descriptors of hcd_edpt_iso_xfer(), NULL for hcd_edpt_xfer()
+#endif
+  uint32_t start_frame;  // frame number of the first TD of current transfer
+  uint32_t next_frame;   // frame number to continue the stream with the next transfer
+
+  uint8_t td_idx[EHCI_ISO_XFER_FRAME_MAX]; // index into iTD/siTD pool
+} ehci_iso_ep_t;
+#endif
 
 typedef struct
 {
   ehci_link_t period_framelist[FRAMELIST_SIZE];
 
-  // TODO only implement 1 ms & 2 ms & 4 ms, 8 ms (framelist)
-  // [0] : 1ms, [1] : 2ms, [2] : 4ms, [3] : 8 ms
-  // TODO better implementation without dummy head to save SRAM
-  ehci_qhd_t period_head_arr[4];
+  // Link to first queue head of each polling interval level [0] : 1ms, [1] : 2ms, [2] : 4ms, [3] : 8 ms.
+  // Software only (not walked by HC), the tree is built with actual endpoint queue heads without dummy heads.
+  ehci_link_t period_level[PERIOD_LEVEL_COUNT];
 
   // Note control qhd of dev0 is used as head of async list
   struct {
@@ -80,6 +145,21 @@ typedef struct
   ehci_qhd_t qhd_pool[QHD_MAX];
   ehci_qtd_t qtd_pool[QTD_MAX] TU_ATTR_ALIGNED(32);
 
+  uint8_t  qhd_free;     // head of free queue head list
+  uint8_t  qhd_removing; // removed from async list, waiting for async advance to be freed
+  uint16_t qtd_free;     // head of free queue TD list
+
+#if EHCI_ISO_ENABLED
+  ehci_itd_t  itd_pool[CFG_TUH_EHCI_ITD_MAX];
+  ehci_sitd_t sitd_pool[CFG_TUH_EHCI_SITD_MAX];
+  uint8_t     itd_used[CFG_TUH_EHCI_ITD_MAX]; // iTD has no spare word for software
+  ehci_iso_ep_t iso_ep[CFG_TUH_EHCI_ISO_ENDPOINT_MAX];
+#endif
+
+  // Periodic bandwidth allocated, in byte times
+  uint16_t bw_hs_uframe[8]; // highspeed bus time in each micro-frame
+  uint16_t bw_fs_frame;     // full/low speed bus time per frame (behind TT)
+
   ehci_registers_t* regs;         // operational register
   ehci_cap_registers_t* cap_regs; // capability register
 
@@ -89,6 +169,11 @@ typedef struct
 // Periodic frame list must be 4K alignment
 CFG_TUH_MEM_SECTION TU_ATTR_ALIGNED(4096) static ehci_data_t ehci_data;
 
+// Interrupt threshold in micro-frames, kept across ehci_init() since it can be configured before.
+// Not part of ehci_data which may be placed in a noinit section
+static uint8_t ehci_itc = CFG_TUH_EHCI_ITC;
+static bool ehci_started = false;
+
 //--------------------------------------------------------------------+
 // Debug
 //--------------------------------------------------------------------+
@@ -134,22 +219,39 @@ TU_ATTR_WEAK bool hcd_dcache_clean_invalidate(void const* addr, uint32_t data_si
 
 TU_ATTR_ALWAYS_INLINE static inline ehci_qhd_t* qhd_control(uint8_t dev_addr);
 TU_ATTR_ALWAYS_INLINE static inline ehci_qhd_t* qhd_next (ehci_qhd_t const * p_qhd);
-TU_ATTR_ALWAYS_INLINE static inline ehci_qhd_t* qhd_find_free (void);
+static ehci_qhd_t* qhd_alloc(uint8_t rhport);
+static void qhd_free(ehci_qhd_t* qhd);
 static ehci_qhd_t* qhd_get_from_addr (uint8_t dev_addr, uint8_t ep_addr);
 static void qhd_init(ehci_qhd_t *p_qhd, uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc);
 static void qhd_attach_qtd(ehci_qhd_t *qhd, ehci_qtd_t *qtd);
 static void qhd_remove_qtd(ehci_qhd_t *qhd);
 
 TU_ATTR_ALWAYS_INLINE static inline ehci_qtd_t* qtd_control(uint8_t dev_addr);
-TU_ATTR_ALWAYS_INLINE static inline ehci_qtd_t* qtd_find_free (void);
+static ehci_qtd_t* qtd_alloc(uint8_t rhport);
+static void qtd_free(ehci_qtd_t* qtd);
 static void qtd_init (ehci_qtd_t* qtd, void const* buffer, uint16_t total_bytes);
 
-TU_ATTR_ALWAYS_INLINE static inline ehci_link_t* list_get_period_head(uint8_t rhport, uint32_t interval_ms);
+TU_ATTR_ALWAYS_INLINE static inline uint8_t period_qhd_level(ehci_qhd_t const* qhd);
+static void period_insert_qhd(ehci_qhd_t* qhd);
+static void period_remove_qhd_by_daddr(uint8_t rhport, uint8_t dev_addr);
 TU_ATTR_ALWAYS_INLINE static inline ehci_qhd_t* list_get_async_head(uint8_t rhport);
 TU_ATTR_ALWAYS_INLINE static inline void list_insert (ehci_link_t *current, ehci_link_t *new, uint8_t new_type);
 TU_ATTR_ALWAYS_INLINE static inline ehci_link_t* list_next (ehci_link_t const *p_link);
 static void list_remove_qhd_by_daddr(ehci_link_t* list_head, uint8_t dev_addr);
 
+static bool bw_update(uint8_t speed, bool is_iso, uint8_t smask, uint8_t cmask, uint16_t xact_bytes, bool reserve);
+static bool qhd_period_reserve(uint8_t rhport, ehci_qhd_t* qhd);
+static void qhd_period_release(uint8_t rhport, ehci_qhd_t* qhd);
+
+#if EHCI_ISO_ENABLED
+static ehci_iso_ep_t* iso_get_from_addr(uint8_t dev_addr, uint8_t ep_addr);
+static bool iso_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc);
+static bool iso_edpt_xfer(ehci_iso_ep_t* iso, uint8_t * buffer, uint32_t buflen, uint32_t* start_frame);
+static bool iso_edpt_abort(ehci_iso_ep_t* iso);
+static void iso_device_close(uint8_t rhport, uint8_t dev_addr);
+static void iso_xfer_complete_isr(void);
+#endif
+
 static void ehci_disable_schedule(ehci_registers_t* regs, bool is_period) {
   // maybe have a timeout for status
   if (is_period) {
@@ -179,7 +281,37 @@ static void ehci_enable_schedule(ehci_registers_t* regs, bool is_period) {
 uint32_t hcd_frame_number(uint8_t rhport)
 {
   (void) rhport;
-  return (ehci_data.uframe_number + ehci_data.regs->frame_index) >> 3;
+  // frame index keeps counting after framelist rollover, only its lower bits are within current framelist round
+  uint32_t const round_mask = (FRAMELIST_SIZE << 3) - 1;
+  uint32_t uframe = ehci_data.uframe_number;
+  uint32_t const frame_index = ehci_data.regs->frame_index & round_mask;
+
+  // rollover is pending and not yet counted by ISR: frame index is already in the new round
+  if ((ehci_data.regs->status & EHCI_INT_MASK_FRAMELIST_ROLLOVER) && frame_index < (FRAMELIST_SIZE << 2)) {
+    uframe += (FRAMELIST_SIZE << 3);
+  }
+
+  return (uframe + frame_index) >> 3;
+}
+
+bool hcd_configure(uint8_t rhport, uint32_t cfg_id, const void* cfg_param) {
+  (void) rhport;
+  TU_VERIFY(cfg_id == TUH_CFGID_EHCI_INTR_THRESHOLD && cfg_param != NULL);
+
+  // power of 2 up to 64 micro-frames, 0 (immediate) is only valid for ChipIdea
+  const uint8_t itc = *((const uint8_t*) cfg_param);
+  TU_VERIFY(itc <= 64 && (itc & (itc - 1)) == 0);
+  #ifndef TUP_USBIP_CHIPIDEA_HS
+  TU_VERIFY(itc != 0);
+  #endif
+  ehci_itc = itc;
+
+  // threshold can be changed while running, applied to interrupts pending from now on
+  if (ehci_started) {
+    ehci_data.regs->command_bm.int_threshold = itc;
+  }
+
+  return true;
 }
 
 void hcd_port_reset(uint8_t rhport)
@@ -241,13 +373,21 @@ void hcd_device_close(uint8_t rhport, uint8_t daddr)
     return;
   }
 
+  // pools are also modified by ISR
+  hcd_int_disable(rhport);
+
   // Remove from async list
   list_remove_qhd_by_daddr((ehci_link_t *) list_get_async_head(rhport), daddr);
 
-  // Remove from all interval period list
-  for(uint8_t i = 0; i < TU_ARRAY_SIZE(ehci_data.period_head_arr); i++) {
-    list_remove_qhd_by_daddr((ehci_link_t *) &ehci_data.period_head_arr[i], daddr);
-  }
+  // Remove from period tree
+  period_remove_qhd_by_daddr(rhport, daddr);
+
+#if EHCI_ISO_ENABLED
+  // Unlink isochronous TDs from framelist
+  iso_device_close(rhport, daddr);
+#endif
+
+  hcd_int_enable(rhport);
 
   // Async doorbell (EHCI 4.8.2 for operational details)
   ehci_data.regs->command_bm.async_adv_doorbell = 1;
@@ -256,40 +396,28 @@ void hcd_device_close(uint8_t rhport, uint8_t daddr)
 static void init_periodic_list(uint8_t rhport) {
   (void) rhport;
 
-  // Build the polling interval tree with 1 ms, 2 ms, 4 ms and 8 ms (framesize) only
-  for ( uint32_t i = 0; i < TU_ARRAY_SIZE(ehci_data.period_head_arr); i++ ) {
-    ehci_data.period_head_arr[i].int_smask          = 1; // queue head in period list must have smask non-zero
-    ehci_data.period_head_arr[i].qtd_overlay.halted = 1; // dummy node, always inactive
+  // Tree is empty: no queue head, all frames are terminated.
+  // Isochronous TDs and interrupt queue heads are linked when endpoints are opened.
+  for (uint32_t i = 0; i < PERIOD_LEVEL_COUNT; i++) {
+    ehci_data.period_level[i].terminate = 1;
   }
 
-  // TODO EHCI_FRAMELIST_SIZE with other size than 8
-  // all links --> period_head_arr[0] (1ms)
-  // 0, 2, 4, 6 etc --> period_head_arr[1] (2ms)
-  // 1, 5 --> period_head_arr[2] (4ms)
-  // 3 --> period_head_arr[3] (8ms)
-
-  ehci_link_t * const framelist  = ehci_data.period_framelist;
-  ehci_link_t * const head_1ms = (ehci_link_t *) &ehci_data.period_head_arr[0];
-  ehci_link_t * const head_2ms = (ehci_link_t *) &ehci_data.period_head_arr[1];
-  ehci_link_t * const head_4ms = (ehci_link_t *) &ehci_data.period_head_arr[2];
-  ehci_link_t * const head_8ms = (ehci_link_t *) &ehci_data.period_head_arr[3];
-
   for (uint32_t i = 0; i < FRAMELIST_SIZE; i++) {
-    framelist[i].address = (uint32_t) head_1ms;
-    framelist[i].type = EHCI_QTYPE_QHD;
+    ehci_data.period_framelist[i].terminate = 1;
   }
+}
 
-  for (uint32_t i = 0; i < FRAMELIST_SIZE; i += 2) {
-    list_insert(framelist + i, head_2ms, EHCI_QTYPE_QHD);
+static void init_pool(void) {
+  for (uint32_t i = 0; i < QHD_MAX; i++) {
+    ehci_data.qhd_pool[i].free_next = (uint8_t) (i + 1 < QHD_MAX ? i + 1 : QHD_FREE_END);
   }
+  ehci_data.qhd_free = (QHD_MAX > 0) ? 0 : QHD_FREE_END;
+  ehci_data.qhd_removing = QHD_FREE_END;
 
-  for (uint32_t i = 1; i < FRAMELIST_SIZE; i += 4) {
-    list_insert(framelist + i, head_4ms, EHCI_QTYPE_QHD);
+  for (uint32_t i = 0; i < QTD_MAX; i++) {
+    ehci_data.qtd_pool[i].free_next = (i + 1 < QTD_MAX ? i + 1 : QTD_FREE_END) & 0x3FFu;
   }
-
-  list_insert(framelist + 3, head_8ms, EHCI_QTYPE_QHD);
-
-  head_1ms->terminate = 1;
+  ehci_data.qtd_free = (QTD_MAX > 0) ? 0 : QTD_FREE_END;
 }
 
 bool ehci_init(uint8_t rhport, uint32_t capability_reg, uint32_t operatial_reg)
@@ -301,6 +429,9 @@ bool ehci_init(uint8_t rhport, uint32_t capability_reg, uint32_t operatial_reg)
 
   ehci_registers_t* regs = ehci_data.regs;
 
+  // Frame list size other than 1024 requires programmable frame list
+  TU_ASSERT(FRAMELIST_SIZE == 1024 || ehci_data.cap_regs->hccparams_bm.programmable_frame_list_flag);
+
   // EHCI 4.1 Host Controller Initialization
 
   //------------- CTRLDSSEGMENT Register (skip) -------------//
@@ -331,6 +462,7 @@ bool ehci_init(uint8_t rhport, uint32_t capability_reg, uint32_t operatial_reg)
 
   //------------- Periodic List -------------//
   init_periodic_list(rhport);
+  init_pool();
   regs->periodic_list_base = (uint32_t) ehci_data.period_framelist;
 
   hcd_dcache_clean(&ehci_data, sizeof(ehci_data_t));
@@ -339,8 +471,17 @@ bool ehci_init(uint8_t rhport, uint32_t capability_reg, uint32_t operatial_reg)
   regs->nxp_tt_control = 0;
 
   //------------- USB CMD Register -------------//
-  regs->command |= EHCI_USBCMD_RUN_STOP | EHCI_USBCMD_PERIOD_SCHEDULE_ENABLE | EHCI_USBCMD_ASYNC_SCHEDULE_ENABLE |
-                   FRAMELIST_SIZE_USBCMD_VALUE;
+  uint32_t command = EHCI_USBCMD_RUN_STOP | EHCI_USBCMD_PERIOD_SCHEDULE_ENABLE | EHCI_USBCMD_ASYNC_SCHEDULE_ENABLE |
+                     FRAMELIST_SIZE_USBCMD_VALUE;
+
+  // Park mode: execute multiple back-to-back transactions from the same highspeed bulk endpoint
+  if (CFG_TUH_EHCI_ASYNC_PARK_COUNT && ehci_data.cap_regs->hccparams_bm.async_park_cap) {
+    command |= EHCI_USBCMD_ASYNC_PARK_ENABLE | ((uint32_t) CFG_TUH_EHCI_ASYNC_PARK_COUNT << EHCI_USBCMD_ASYNC_PARK_COUNT_SHIFT);
+  }
+
+  regs->command |= command;
+  regs->command_bm.int_threshold = ehci_itc;
+  ehci_started = true;
 
   //------------- ConfigFlag Register (skip) -------------//
 
@@ -379,40 +520,41 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
 {
   (void) rhport;
 
-  // TODO not support ISO yet
-  TU_ASSERT (ep_desc->bmAttributes.xfer != TUSB_XFER_ISOCHRONOUS);
+  if (ep_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS) {
+#if EHCI_ISO_ENABLED
+    return iso_edpt_open(rhport, dev_addr, ep_desc);
+#else
+    TU_LOG1("EHCI: isochronous is not enabled (CFG_TUH_EHCI_ISO_ENDPOINT_MAX)\r\n");
+    return false;
+#endif
+  }
 
   //------------- Prepare Queue Head -------------//
-  ehci_qhd_t *p_qhd = (ep_desc->bEndpointAddress == 0) ? qhd_control(dev_addr) : qhd_find_free();
+  ehci_qhd_t *p_qhd = (ep_desc->bEndpointAddress == 0) ? qhd_control(dev_addr) : qhd_alloc(rhport);
   TU_ASSERT(p_qhd);
 
   qhd_init(p_qhd, dev_addr, ep_desc);
 
+  if (ep_desc->bmAttributes.xfer == TUSB_XFER_INTERRUPT) {
+    if (!qhd_period_reserve(rhport, p_qhd)) {
+      TU_LOG1("EHCI: not enough periodic bandwidth\r\n");
+      hcd_int_disable(rhport);
+      qhd_free(p_qhd);
+      hcd_int_enable(rhport);
+      return false;
+    }
+  }
+
   // control of dev0 is always present as async head
   if ( dev_addr == 0 ) return true;
 
   // Insert to list
-  ehci_link_t * list_head = NULL;
-
-  switch (ep_desc->bmAttributes.xfer)
-  {
-    case TUSB_XFER_CONTROL:
-    case TUSB_XFER_BULK:
-      list_head = (ehci_link_t*) list_get_async_head(rhport);
-    break;
-
-    case TUSB_XFER_INTERRUPT:
-      list_head = list_get_period_head(rhport, p_qhd->interval_ms);
-    break;
-
-    case TUSB_XFER_ISOCHRONOUS:
-      // TODO iso is not supported
-    break;
-
-    default: break;
+  if (ep_desc->bmAttributes.xfer == TUSB_XFER_INTERRUPT) {
+    period_insert_qhd(p_qhd);
+    return true;
   }
-  TU_ASSERT(list_head);
 
+  ehci_link_t * list_head = (ehci_link_t*) list_get_async_head(rhport);
   list_insert(list_head, (ehci_link_t*) p_qhd, EHCI_QTYPE_QHD);
 
   hcd_dcache_clean(p_qhd, sizeof(ehci_qhd_t));
@@ -451,7 +593,15 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir   = tu_edpt_dir(ep_addr);
 
+#if EHCI_ISO_ENABLED
+  ehci_iso_ep_t* iso = iso_get_from_addr(dev_addr, ep_addr);
+  if (iso) {
+    return iso_edpt_xfer(iso, buffer, buflen, NULL);
+  }
+#endif
+
   ehci_qhd_t* qhd = qhd_get_from_addr(dev_addr, ep_addr);
+  TU_ASSERT(qhd);
   ehci_qtd_t* qtd;
 
   if (epnum == 0) {
@@ -470,7 +620,7 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
     // skip if endpoint is halted
     TU_VERIFY(!qhd->qtd_overlay.halted);
 
-    qtd = qtd_find_free();
+    qtd = qtd_alloc(rhport);
     TU_ASSERT(qtd);
 
     qtd_init(qtd, buffer, buflen);
@@ -493,8 +643,15 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
 bool hcd_edpt_abort_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr) {
   (void) rhport;
 
-  // TODO ISO not supported yet
+#if EHCI_ISO_ENABLED
+  ehci_iso_ep_t* iso = iso_get_from_addr(dev_addr, ep_addr);
+  if (iso) {
+    return iso_edpt_abort(iso);
+  }
+#endif
+
   ehci_qhd_t* qhd = qhd_get_from_addr(dev_addr, ep_addr);
+  TU_VERIFY(qhd != NULL);
   ehci_qtd_t * volatile qtd = qhd->attached_qtd;
   TU_VERIFY(qtd != NULL); // no queued transfer
 
@@ -502,7 +659,7 @@ bool hcd_edpt_abort_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr) {
   TU_VERIFY(qtd->active); // transfer is already complete
 
   // HC is still processing, disable HC list schedule before making changes
-  bool const is_period = (qhd->interval_ms > 0);
+  bool const is_period = (qhd->int_smask != 0); // sub-millisecond interrupt has interval_ms = 0
 
   ehci_disable_schedule(ehci_data.regs, is_period);
 
@@ -513,8 +670,10 @@ bool hcd_edpt_abort_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr) {
     qhd->qtd_overlay.next.terminate = 1;
     hcd_dcache_clean(qhd, sizeof(ehci_qhd_t));
 
-    // remove TD from QH software list
+    // remove TD from QH software list, TD pool is also modified by ISR
+    hcd_int_disable(rhport);
     qhd_remove_qtd(qhd);
+    hcd_int_enable(rhport);
   }
 
   ehci_enable_schedule(ehci_data.regs, is_period);
@@ -525,6 +684,7 @@ bool hcd_edpt_abort_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr) {
 bool hcd_edpt_clear_stall(uint8_t rhport, uint8_t daddr, uint8_t ep_addr) {
   (void) rhport;
   ehci_qhd_t *qhd = qhd_get_from_addr(daddr, ep_addr);
+  TU_VERIFY(qhd != NULL); // isochronous endpoint has no halt
   qhd->qtd_overlay.halted = 0;
   qhd->qtd_overlay.data_toggle = 0;
   hcd_dcache_clean_invalidate(qhd, sizeof(ehci_qhd_t));
@@ -544,12 +704,14 @@ void async_advance_isr(uint8_t rhport)
 {
   (void) rhport;
 
-  ehci_qhd_t *qhd_pool = ehci_data.qhd_pool;
-  for (uint32_t i = 0; i < QHD_MAX; i++) {
-    if (qhd_pool[i].removing) {
-      qhd_pool[i].removing = 0;
-      qhd_pool[i].used = 0;
-    }
+  // free all queue heads waiting for async advance
+  uint8_t idx = ehci_data.qhd_removing;
+  ehci_data.qhd_removing = QHD_FREE_END;
+
+  while (idx != QHD_FREE_END) {
+    ehci_qhd_t* qhd = &ehci_data.qhd_pool[idx];
+    idx = qhd->free_next;
+    qhd_free(qhd);
   }
 }
 
@@ -623,35 +785,23 @@ void proccess_async_xfer_isr(ehci_qhd_t * const list_head)
 }
 
 TU_ATTR_ALWAYS_INLINE static inline
-void process_period_xfer_isr(uint8_t rhport, uint32_t interval_ms)
+void process_period_xfer_isr(uint8_t rhport)
 {
-  uint32_t const period_1ms_addr = (uint32_t) list_get_period_head(rhport, 1u);
-  ehci_link_t next_link = *list_get_period_head(rhport, interval_ms);
-
-  while (!next_link.terminate) {
-    if (interval_ms > 1 && period_1ms_addr == tu_align32(next_link.address)) {
-      // 1ms period list is end of list for all larger interval
-      break;
-    }
-
-    uintptr_t const entry_addr = tu_align32(next_link.address);
+  (void) rhport;
 
-    switch (next_link.type) {
-      case EHCI_QTYPE_QHD: {
-        ehci_qhd_t *qhd = (ehci_qhd_t *) entry_addr;
-        qhd_xfer_complete_isr(qhd);
-      }
-        break;
+  // isochronous TDs are not in the queue head tree, see iso_xfer_complete_isr()
+  for (uint8_t level = 0; level < PERIOD_LEVEL_COUNT; level++) {
+    ehci_link_t const* prev = &ehci_data.period_level[level];
 
-      // TODO support hs/fs ISO
-      case EHCI_QTYPE_ITD:
-      case EHCI_QTYPE_SITD:
-      case EHCI_QTYPE_FSTN:
-      default:
+    // a level ends when its last queue head links to the next (1ms) level
+    while (!prev->terminate && prev->type == EHCI_QTYPE_QHD) {
+      ehci_qhd_t* qhd = (ehci_qhd_t*) list_next(prev);
+      if (period_qhd_level(qhd) != level) {
         break;
+      }
+      qhd_xfer_complete_isr(qhd);
+      prev = &qhd->next;
     }
-
-    next_link = *list_next(&next_link);
   }
 }
 
@@ -691,9 +841,11 @@ void hcd_int_handler(uint8_t rhport, bool in_isr) {
   if (usb_int) {
     proccess_async_xfer_isr(list_get_async_head(rhport));
 
-    for ( uint32_t i = 1; i <= FRAMELIST_SIZE; i *= 2 ) {
-      process_period_xfer_isr(rhport, i);
-    }
+    process_period_xfer_isr(rhport);
+
+#if EHCI_ISO_ENABLED
+    iso_xfer_complete_isr();
+#endif
 
     regs->status = usb_int; // Acknowledge
   }
@@ -710,12 +862,6 @@ void hcd_int_handler(uint8_t rhport, bool in_isr) {
 // List Managing Helper
 //--------------------------------------------------------------------+
 
-// Get head of periodic list
-TU_ATTR_ALWAYS_INLINE static inline ehci_link_t* list_get_period_head(uint8_t rhport, uint32_t interval_ms) {
-  (void) rhport;
-  return (ehci_link_t*) &ehci_data.period_head_arr[ tu_log2( tu_min32(FRAMELIST_SIZE, interval_ms) ) ];
-}
-
 // Get head of async list
 TU_ATTR_ALWAYS_INLINE static inline ehci_qhd_t* list_get_async_head(uint8_t rhport) {
   (void) rhport;
@@ -732,7 +878,7 @@ TU_ATTR_ALWAYS_INLINE static inline void list_insert(ehci_link_t *current, ehci_
   current->address = ((uint32_t) new) | (new_type << 1);
 }
 
-// Remove all queue head belong to this device address
+// Remove all queue head belong to this device address from async list
 static void list_remove_qhd_by_daddr(ehci_link_t* list_head, uint8_t dev_addr) {
   ehci_link_t* prev = list_head;
 
@@ -751,16 +897,11 @@ static void list_remove_qhd_by_daddr(ehci_link_t* list_head, uint8_t dev_addr) {
       // EHCI 4.8.2 link the removed qhd's next to async head (which always reachable by Host Controller)
       qhd->next.address = ((uint32_t) list_head) | (EHCI_QTYPE_QHD << 1);
 
-      if ( qhd->int_smask )
-      {
-        // period list queue element is guarantee to be free in the next frame (1 ms)
-        qhd->used = 0;
-      }else
-      {
-        // async list use async advance handshake
-        // mark as removing, will completely re-usable when async advance isr occurs
-        qhd->removing = 1;
-      }
+      // async list use async advance handshake
+      // mark as removing, will completely re-usable when async advance isr occurs
+      qhd->removing = 1;
+      qhd->free_next = ehci_data.qhd_removing;
+      ehci_data.qhd_removing = (uint8_t) (qhd - ehci_data.qhd_pool);
 
       hcd_dcache_clean(qhd, sizeof(ehci_qhd_t));
       hcd_dcache_clean(prev, sizeof(ehci_qhd_t));
@@ -770,6 +911,109 @@ static void list_remove_qhd_by_daddr(ehci_link_t* list_head, uint8_t dev_addr) {
   }
 }
 
+//--------------------------------------------------------------------+
+// Period Tree Helper
+//--------------------------------------------------------------------+
+// Each level is a chain of queue heads with the same polling interval, whose last queue head links to the first
+// queue head of 1ms level. Each framelist entry links (after isochronous TDs) to the highest level polled in that
+// frame, or to 1ms level if that level is empty:
+//   0, 2, 4, 6 etc    --> 2ms
+//   1, 5, 9, 13 etc   --> 4ms
+//   3, 11, 19 etc     --> 8ms
+//   others            --> 1ms
+
+TU_ATTR_ALWAYS_INLINE static inline uint8_t period_qhd_level(ehci_qhd_t const* qhd) {
+  return (qhd->interval_ms == 0) ? 0 : tu_log2(tu_min32(PERIOD_INTERVAL_MAX, qhd->interval_ms));
+}
+
+TU_ATTR_ALWAYS_INLINE static inline uint8_t period_frame_level(uint32_t frame) {
+  if ((frame & 7) == 3) return 3;
+  if ((frame & 3) == 1) return 2;
+  if ((frame & 1) == 0) return 1;
+  return 0;
+}
+
+// Link to the first queue head that HC should visit for a level
+TU_ATTR_ALWAYS_INLINE static inline uint32_t period_level_entry(uint8_t level) {
+  ehci_link_t const link = ehci_data.period_level[level];
+  return link.terminate ? ehci_data.period_level[0].address : link.address;
+}
+
+// Update links into levels after a level's first queue head changed: tail of 2/4/8ms levels and framelist entries
+static void period_relink(void) {
+  uint32_t const entry_1ms = ehci_data.period_level[0].address;
+
+  for (uint8_t level = 1; level < PERIOD_LEVEL_COUNT; level++) {
+    ehci_link_t* prev = &ehci_data.period_level[level];
+    ehci_qhd_t* tail = NULL;
+
+    while (!prev->terminate) {
+      ehci_qhd_t* qhd = (ehci_qhd_t*) list_next(prev);
+      if (period_qhd_level(qhd) != level) break;
+      tail = qhd;
+      prev = &qhd->next;
+    }
+
+    if (tail) {
+      tail->next.address = entry_1ms;
+      hcd_dcache_clean(&tail->next, sizeof(ehci_link_t));
+    }
+  }
+
+  for (uint32_t frame = 0; frame < FRAMELIST_SIZE; frame++) {
+    // skip isochronous TDs which are always in front
+    ehci_link_t* prev = &ehci_data.period_framelist[frame];
+    while (!prev->terminate && prev->type != EHCI_QTYPE_QHD) {
+      prev = list_next(prev);
+    }
+
+    prev->address = period_level_entry(period_frame_level(frame));
+    hcd_dcache_clean(prev, sizeof(ehci_link_t));
+  }
+}
+
+static void period_insert_qhd(ehci_qhd_t* qhd) {
+  uint8_t const level = period_qhd_level(qhd);
+
+  // insert in front of its level
+  qhd->next.address = period_level_entry(level);
+  hcd_dcache_clean(qhd, sizeof(ehci_qhd_t));
+
+  ehci_data.period_level[level].address = ((uint32_t) qhd) | (EHCI_QTYPE_QHD << 1);
+  period_relink();
+}
+
+// Remove all queue head belong to this device address from period tree
+static void period_remove_qhd_by_daddr(uint8_t rhport, uint8_t dev_addr) {
+  bool removed = false;
+
+  for (uint8_t level = 0; level < PERIOD_LEVEL_COUNT; level++) {
+    ehci_link_t* prev = &ehci_data.period_level[level];
+
+    while (!prev->terminate) {
+      ehci_qhd_t* qhd = (ehci_qhd_t*) list_next(prev);
+      if (period_qhd_level(qhd) != level) break;
+
+      if (qhd->dev_addr == dev_addr) {
+        // keep removed qhd's next intact in case HC is currently processing it
+        prev->address = qhd->next.address;
+        hcd_dcache_clean(prev, sizeof(ehci_link_t));
+
+        qhd_period_release(rhport, qhd);
+
+        // period list queue element is guarantee to be free in the next frame (1 ms)
+        qhd_free(qhd);
+        removed = true;
+      } else {
+        prev = &qhd->next;
+      }
+    }
+  }
+
+  if (removed) {
+    period_relink();
+  }
+}
 
 //--------------------------------------------------------------------+
 // Queue Header helper
@@ -780,12 +1024,31 @@ TU_ATTR_ALWAYS_INLINE static inline ehci_qhd_t* qhd_control(uint8_t dev_addr) {
   return &ehci_data.control[dev_addr].qhd;
 }
 
-// Find a free queue head
-TU_ATTR_ALWAYS_INLINE static inline ehci_qhd_t *qhd_find_free(void) {
-  for ( uint32_t i = 0; i < QHD_MAX; i++ ) {
-    if ( !ehci_data.qhd_pool[i].used ) return &ehci_data.qhd_pool[i];
+// Allocate a queue head from pool, free list is also modified by ISR
+static ehci_qhd_t* qhd_alloc(uint8_t rhport) {
+  ehci_qhd_t* qhd = NULL;
+
+  hcd_int_disable(rhport);
+  if (ehci_data.qhd_free != QHD_FREE_END) {
+    qhd = &ehci_data.qhd_pool[ehci_data.qhd_free];
+    ehci_data.qhd_free = qhd->free_next;
   }
-  return NULL;
+  hcd_int_enable(rhport);
+
+  return qhd;
+}
+
+// Return queue head to pool, caller must make sure ISR is not running
+static void qhd_free(ehci_qhd_t* qhd) {
+  if (qhd->attached_qtd) {
+    qtd_free(qhd->attached_qtd);
+    qhd->attached_qtd = NULL;
+  }
+
+  qhd->used = 0;
+  qhd->removing = 0;
+  qhd->free_next = ehci_data.qhd_free;
+  ehci_data.qhd_free = (uint8_t) (qhd - ehci_data.qhd_pool);
 }
 
 // Next queue head link
@@ -802,7 +1065,7 @@ static ehci_qhd_t *qhd_get_from_addr(uint8_t dev_addr, uint8_t ep_addr) {
   ehci_qhd_t *qhd_pool = ehci_data.qhd_pool;
 
   for ( uint32_t i = 0; i < QHD_MAX; i++ ) {
-    if ( (qhd_pool[i].dev_addr == dev_addr) &&
+    if ( qhd_pool[i].used && (qhd_pool[i].dev_addr == dev_addr) &&
          ep_addr == tu_edpt_addr(qhd_pool[i].ep_number, qhd_pool[i].pid) ) {
       return &qhd_pool[i];
     }
@@ -855,7 +1118,8 @@ static void qhd_init(ehci_qhd_t *p_qhd, uint8_t dev_addr, tusb_desc_endpoint_t c
     }else
     {
       TU_ASSERT( 0 != interval, );
-      // Full/Low: 4.12.2.1 (EHCI) case 1 schedule start split at 1 us & complete split at 2,3,4 uframes
+      // Full/Low: 4.12.2.1 (EHCI) case 1 schedule start split at 1 us & complete split at 2,3,4 uframes.
+      // Actual micro-frames are planned within hub's TT budget when endpoint is opened
       p_qhd->int_smask    = 0x01;
       p_qhd->fl_int_cmask = TU_BIN8(11100);
       p_qhd->interval_ms  = interval;
@@ -867,7 +1131,9 @@ static void qhd_init(ehci_qhd_t *p_qhd, uint8_t dev_addr, tusb_desc_endpoint_t c
 
   p_qhd->fl_hub_addr  = devtree_info.hub_addr;
   p_qhd->fl_hub_port  = devtree_info.hub_port;
-  p_qhd->mult         = 1; // TODO not use high bandwidth/park mode yet
+  // high-bandwidth: highspeed interrupt endpoint can do up to 3 transactions per micro-frame
+  p_qhd->mult         = (TUSB_XFER_INTERRUPT == xfer_type && TUSB_SPEED_HIGH == p_qhd->ep_speed) ?
+                        tu_edpt_hs_mult(ep_desc) : 1;
 
   //------------- HCD Management Data -------------//
   p_qhd->used         = 1;
@@ -906,7 +1172,7 @@ static void qhd_remove_qtd(ehci_qhd_t *qhd) {
   qhd->attached_buffer = 0;
   hcd_dcache_clean(qhd, sizeof(ehci_qhd_t));
 
-  qtd->used = 0; // free QTD
+  qtd_free(qtd);
   hcd_dcache_clean(qtd, sizeof(ehci_qtd_t));
 }
 
@@ -919,11 +1185,29 @@ TU_ATTR_ALWAYS_INLINE static inline ehci_qtd_t* qtd_control(uint8_t dev_addr) {
   return &ehci_data.control[dev_addr].qtd;
 }
 
-TU_ATTR_ALWAYS_INLINE static inline ehci_qtd_t *qtd_find_free(void) {
-  for (uint32_t i = 0; i < QTD_MAX; i++) {
-    if (!ehci_data.qtd_pool[i].used) return &ehci_data.qtd_pool[i];
+// Allocate a TD from pool, free list is also modified by ISR
+static ehci_qtd_t* qtd_alloc(uint8_t rhport) {
+  ehci_qtd_t* qtd = NULL;
+
+  hcd_int_disable(rhport);
+  if (ehci_data.qtd_free != QTD_FREE_END) {
+    qtd = &ehci_data.qtd_pool[ehci_data.qtd_free];
+    ehci_data.qtd_free = qtd->free_next;
+    qtd->used = 1;
+  }
+  hcd_int_enable(rhport);
+
+  return qtd;
+}
+
+// Return TD to pool, control TDs are not part of pool
+static void qtd_free(ehci_qtd_t* qtd) {
+  qtd->used = 0;
+
+  if (qtd >= ehci_data.qtd_pool && qtd < ehci_data.qtd_pool + QTD_MAX) {
+    qtd->free_next = ehci_data.qtd_free & 0x3FFu;
+    ehci_data.qtd_free = (uint16_t) (qtd - ehci_data.qtd_pool);
   }
-  return NULL;
 }
 
 static void qtd_init(ehci_qtd_t* qtd, void const* buffer, uint16_t total_bytes) {
@@ -945,4 +1229,645 @@ static void qtd_init(ehci_qtd_t* qtd, void const* buffer, uint16_t total_bytes)
   }
 }
 
+
+//--------------------------------------------------------------------+
+// Periodic Bandwidth
+//--------------------------------------------------------------------+
+
+// Approximate bus time of a periodic transaction in byte times (USB 2.0 5.11.3), including bit stuffing
+TU_ATTR_ALWAYS_INLINE static inline uint16_t bw_hs_cost(uint32_t bytes) {
+  return (uint16_t) (38 + (bytes * 7) / 6);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline uint16_t bw_fs_cost(uint8_t speed, bool is_iso, uint32_t bytes) {
+  if (speed == TUSB_SPEED_LOW) {
+    return (uint16_t) (97 + (bytes * 28) / 3); // each low speed bit takes 8 full speed bit times
+  }
+  return (uint16_t) ((is_iso ? 14 : 20) + (bytes * 7) / 6);
+}
+
+// Reserve or release periodic bandwidth of an endpoint. Highspeed endpoint takes bus time in every micro-frame of
+// smask. Full/Low speed endpoint takes TT time once per frame, plus split transactions in every micro-frame of
+// smask | cmask (charged conservatively). Frames are assumed to be identical regardless of polling interval.
+static bool bw_update(uint8_t speed, bool is_iso, uint8_t smask, uint8_t cmask, uint16_t xact_bytes, bool reserve) {
+  uint16_t hs_cost;
+  uint16_t fs_cost = 0;
+  uint8_t uframe_mask;
+
+  if (speed == TUSB_SPEED_HIGH) {
+    hs_cost = bw_hs_cost(xact_bytes);
+    uframe_mask = smask;
+  } else {
+    fs_cost = bw_fs_cost(speed, is_iso, xact_bytes);
+    hs_cost = bw_hs_cost(tu_min16(xact_bytes, EHCI_SPLIT_XACT_MAX));
+    uframe_mask = smask | cmask;
+  }
+
+  if (reserve) {
+    TU_VERIFY(ehci_data.bw_fs_frame + fs_cost <= EHCI_BW_FS_FRAME_BUDGET);
+    for (uint8_t i = 0; i < 8; i++) {
+      if (uframe_mask & TU_BIT(i)) {
+        TU_VERIFY(ehci_data.bw_hs_uframe[i] + hs_cost <= EHCI_BW_HS_UFRAME_BUDGET);
+      }
+    }
+
+    ehci_data.bw_fs_frame = (uint16_t) (ehci_data.bw_fs_frame + fs_cost);
+    for (uint8_t i = 0; i < 8; i++) {
+      if (uframe_mask & TU_BIT(i)) {
+        ehci_data.bw_hs_uframe[i] = (uint16_t) (ehci_data.bw_hs_uframe[i] + hs_cost);
+      }
+    }
+  } else {
+    ehci_data.bw_fs_frame = (uint16_t) (ehci_data.bw_fs_frame - tu_min16(ehci_data.bw_fs_frame, fs_cost));
+    for (uint8_t i = 0; i < 8; i++) {
+      if (uframe_mask & TU_BIT(i)) {
+        ehci_data.bw_hs_uframe[i] = (uint16_t) (ehci_data.bw_hs_uframe[i] - tu_min16(ehci_data.bw_hs_uframe[i], hs_cost));
+      }
+    }
+  }
+
+  return true;
+}
+
+// Reserve periodic bandwidth for interrupt queue head. Split transaction also reserves hub's TT time, which
+// decides its start-split and complete-split micro-frames
+static bool qhd_period_reserve(uint8_t rhport, ehci_qhd_t* qhd) {
+  uint16_t const xact_bytes = (uint16_t) (qhd->max_packet_size * qhd->mult);
+  uint8_t const ep_dir = (qhd->pid == EHCI_PID_IN) ? TUSB_DIR_IN : TUSB_DIR_OUT;
+  bool const is_split = (qhd->ep_speed != TUSB_SPEED_HIGH);
+
+  if (is_split) {
+    hcd_split_sched_t sched;
+    TU_VERIFY(hcd_split_reserve(rhport, qhd->fl_hub_addr, qhd->fl_hub_port, qhd->ep_speed, TUSB_XFER_INTERRUPT, ep_dir,
+                                qhd->max_packet_size, &sched));
+    qhd->int_smask    = sched.smask;
+    qhd->fl_int_cmask = sched.cmask;
+  }
+
+  if (!bw_update(qhd->ep_speed, false, qhd->int_smask, qhd->fl_int_cmask, xact_bytes, true)) {
+    if (is_split) {
+      hcd_split_sched_t const sched = { .smask = qhd->int_smask, .cmask = qhd->fl_int_cmask };
+      hcd_split_release(rhport, qhd->fl_hub_addr, qhd->fl_hub_port, qhd->ep_speed, TUSB_XFER_INTERRUPT, ep_dir,
+                        qhd->max_packet_size, &sched);
+    }
+    return false;
+  }
+
+  return true;
+}
+
+static void qhd_period_release(uint8_t rhport, ehci_qhd_t* qhd) {
+  (void) bw_update(qhd->ep_speed, false, qhd->int_smask, qhd->fl_int_cmask,
+                   (uint16_t) (qhd->max_packet_size * qhd->mult), false);
+
+  if (qhd->ep_speed != TUSB_SPEED_HIGH) {
+    uint8_t const ep_dir = (qhd->pid == EHCI_PID_IN) ? TUSB_DIR_IN : TUSB_DIR_OUT;
+    hcd_split_sched_t const sched = { .smask = qhd->int_smask, .cmask = qhd->fl_int_cmask };
+    hcd_split_release(rhport, qhd->fl_hub_addr, qhd->fl_hub_port, qhd->ep_speed, TUSB_XFER_INTERRUPT, ep_dir,
+                      qhd->max_packet_size, &sched);
+  }
+}
+
+void ehci_periodic_bandwidth_get(uint8_t rhport, ehci_periodic_bw_t* bw) {
+  (void) rhport;
+  for (uint8_t i = 0; i < 8; i++) {
+    bw->hs_uframe[i] = ehci_data.bw_hs_uframe[i];
+  }
+  bw->hs_budget = EHCI_BW_HS_UFRAME_BUDGET;
+  bw->fs_frame  = ehci_data.bw_fs_frame;
+  bw->fs_budget = EHCI_BW_FS_FRAME_BUDGET;
+}
+
+#if EHCI_ISO_ENABLED
+
+//--------------------------------------------------------------------+
+// Isochronous helper
+//--------------------------------------------------------------------+
+
+enum {
+  SITD_TP_ALL   = 0, // entire payload in one start-split
+  SITD_TP_BEGIN = 1, // first of multiple start-splits
+};
+
+// Micro-frame mask of a highspeed endpoint serviced every 2^interval_log2 micro-frames, starting at phase
+TU_ATTR_ALWAYS_INLINE static inline uint8_t iso_hs_smask(uint8_t interval_log2, uint8_t phase) {
+  if (interval_log2 >= 3) {
+    return (uint8_t) TU_BIT(phase);
+  }
+
+  uint8_t smask = 0;
+  for (uint8_t uf = phase; uf < 8; uf = (uint8_t) (uf + (1u << interval_log2))) {
+    smask |= (uint8_t) TU_BIT(uf);
+  }
+  return smask;
+}
+
+// Pick the least loaded micro-frame phase for a highspeed endpoint
+static uint8_t iso_hs_smask_find(uint8_t interval_log2) {
+  uint8_t const phase_count = (interval_log2 >= 3) ? 8 : (uint8_t) (1u << interval_log2);
+  uint8_t best_smask = 0;
+  uint16_t best_load = UINT16_MAX;
+
+  for (uint8_t phase = 0; phase < phase_count; phase++) {
+    uint8_t const smask = iso_hs_smask(interval_log2, phase);
+    uint16_t load = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+      if (smask & TU_BIT(i)) {
+        load = tu_max16(load, ehci_data.bw_hs_uframe[i]);
+      }
+    }
+
+    if (load < best_load) {
+      best_load = load;
+      best_smask = smask;
+    }
+  }
+
+  return best_smask;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline uint32_t iso_packet_size(ehci_iso_ep_t const* iso) {
+  return (uint32_t) iso->max_packet_size * iso->mult;
+}
+
+// Number of packets per frame (iTD/siTD)
+TU_ATTR_ALWAYS_INLINE static inline uint32_t iso_packet_per_frame(ehci_iso_ep_t const* iso) {
+  return (iso->interval_log2 >= 3) ? 1u : (8u >> iso->interval_log2);
+}
+
+// Number of frames between two TDs of an endpoint
+TU_ATTR_ALWAYS_INLINE static inline uint32_t iso_frame_step(ehci_iso_ep_t const* iso) {
+  return (iso->interval_log2 >= 3) ? (1u << (iso->interval_log2 - 3)) : 1u;
+}
+
+// Expected length of packet index of current transfer
+static uint16_t iso_packet_len(ehci_iso_ep_t const* iso, uint32_t pkt_idx) {
+#if CFG_TUH_EDPT_ISO_XFER
+  if (iso->packets) {
+    return iso->packets[pkt_idx].len;
+  }
+#endif
+  uint32_t const offset = pkt_idx * iso_packet_size(iso);
+  return (uint16_t) tu_min32(iso_packet_size(iso), iso->buflen - offset);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline ehci_link_t* iso_td_link(ehci_iso_ep_t const* iso, uint8_t td_idx) {
+  return (iso->speed == TUSB_SPEED_HIGH) ? (ehci_link_t*) &ehci_data.itd_pool[td_idx] :
+                                           (ehci_link_t*) &ehci_data.sitd_pool[td_idx];
+}
+
+// Number of frames ahead of current frame that is safe to link an isochronous TD (EHCI 4.7.2.1)
+static uint32_t iso_schedule_lead(void) {
+  uint8_t const ist = ehci_data.cap_regs->hccparams_bm.iso_schedule_threshold;
+  if (ist & 0x08) {
+    return 2; // HC may cache a whole frame of isochronous data
+  }
+
+  uint32_t const uframe = ehci_data.regs->frame_index & 0x07;
+  return (uframe + ist < 8) ? 1 : 2;
+}
+
+static ehci_iso_ep_t* iso_get_from_addr(uint8_t dev_addr, uint8_t ep_addr) {
+  for (uint32_t i = 0; i < CFG_TUH_EHCI_ISO_ENDPOINT_MAX; i++) {
+    ehci_iso_ep_t* iso = &ehci_data.iso_ep[i];
+    if (iso->used && iso->dev_addr == dev_addr && iso->ep_addr == ep_addr) {
+      return iso;
+    }
+  }
+  return NULL;
+}
+
+static int td_alloc(ehci_iso_ep_t const* iso) {
+  if (iso->speed == TUSB_SPEED_HIGH) {
+    for (uint32_t i = 0; i < CFG_TUH_EHCI_ITD_MAX; i++) {
+      if (!ehci_data.itd_used[i]) {
+        ehci_data.itd_used[i] = 1;
+        return (int) i;
+      }
+    }
+  } else {
+    for (uint32_t i = 0; i < CFG_TUH_EHCI_SITD_MAX; i++) {
+      if (!ehci_data.sitd_pool[i].used) {
+        ehci_data.sitd_pool[i].used = 1;
+        return (int) i;
+      }
+    }
+  }
+  return -1;
+}
+
+static void td_free(ehci_iso_ep_t const* iso, uint8_t td_idx) {
+  if (iso->speed == TUSB_SPEED_HIGH) {
+    ehci_data.itd_used[td_idx] = 0;
+  } else {
+    ehci_data.sitd_pool[td_idx].used = 0;
+  }
+}
+
+// Insert TD in front of a frame's list, isochronous TDs are always placed before interrupt queue heads
+static void framelist_insert_td(uint32_t frame, ehci_link_t* td, uint8_t td_type) {
+  ehci_link_t* entry = &ehci_data.period_framelist[frame & (FRAMELIST_SIZE - 1)];
+  td->address = entry->address;
+  hcd_dcache_clean(td, sizeof(ehci_link_t));
+
+  entry->address = ((uint32_t) td) | ((uint32_t) td_type << 1);
+  hcd_dcache_clean(entry, sizeof(ehci_link_t));
+}
+
+static void framelist_remove_td(uint32_t frame, ehci_link_t const* td) {
+  ehci_link_t* prev = &ehci_data.period_framelist[frame & (FRAMELIST_SIZE - 1)];
+
+  // isochronous TDs are in front of interrupt queue heads
+  while (!prev->terminate && prev->type != EHCI_QTYPE_QHD) {
+    ehci_link_t* next = list_next(prev);
+    if (next == td) {
+      // keep removed TD's next link intact in case HC is currently processing it
+      prev->address = td->address;
+      hcd_dcache_clean(prev, sizeof(ehci_link_t));
+      return;
+    }
+    prev = next;
+  }
+}
+
+// Unlink and free all TDs of current transfer
+static void iso_td_remove_all(ehci_iso_ep_t* iso) {
+  uint32_t const step = iso_frame_step(iso);
+  for (uint8_t t = 0; t < iso->td_count; t++) {
+    framelist_remove_td(iso->start_frame + t * step, iso_td_link(iso, iso->td_idx[t]));
+    td_free(iso, iso->td_idx[t]);
+  }
+  iso->td_count = 0;
+  iso->active = 0;
+}
+
+// packets are contiguous in transfer buffer, offset is where first_pkt starts
+static void itd_init(ehci_iso_ep_t const* iso, ehci_itd_t* itd, uint32_t first_pkt, uint32_t pkt_count,
+                     uint32_t offset, bool ioc) {
+  tu_memclr(itd, sizeof(ehci_itd_t));
+
+  uint32_t const base = tu_align4k((uint32_t) (iso->buffer + offset));
+
+  // 7 pages cover up to 8 x 3072 bytes starting at any offset
+  for (uint8_t p = 0; p < 7; p++) {
+    itd->BufferPointer[p] = base + 4096u * p;
+  }
+  itd->BufferPointer[0] |= iso->dev_addr | ((uint32_t) tu_edpt_number(iso->ep_addr) << 8);
+  itd->BufferPointer[1] |= iso->max_packet_size | ((uint32_t) tu_edpt_dir(iso->ep_addr) << 11);
+  itd->BufferPointer[2] |= iso->mult;
+
+  uint8_t uframe = (uint8_t) tu_log2(iso->smask & (uint8_t) (-iso->smask)); // first scheduled micro-frame
+  for (uint32_t k = 0; k < pkt_count; k++) {
+    uint32_t const addr = (uint32_t) (iso->buffer + offset);
+    uint16_t const len = iso_packet_len(iso, first_pkt + k);
+
+    itd->xact[uframe].offset      = addr & 0xFFFu;
+    itd->xact[uframe].page_select = (uint8_t) ((addr - base) >> 12);
+    itd->xact[uframe].length      = len;
+    itd->xact[uframe].active      = 1;
+    offset += len;
+
+    if (ioc && k == pkt_count - 1) {
+      itd->xact[uframe].int_on_complete = 1;
+    }
+
+    uframe = (uint8_t) (uframe + (1u << iso->interval_log2));
+  }
+}
+
+static void sitd_init(ehci_iso_ep_t const* iso, ehci_sitd_t* sitd, uint8_t iso_idx, uint32_t pkt_idx,
+                      uint32_t offset, bool ioc) {
+  tu_memclr(sitd, sizeof(ehci_sitd_t));
+
+  uint16_t const len = iso_packet_len(iso, pkt_idx);
+  uint32_t const addr = (uint32_t) (iso->buffer + offset);
+
+  sitd->dev_addr     = iso->dev_addr;
+  sitd->ep_number    = tu_edpt_number(iso->ep_addr) & 0x0Fu;
+  sitd->hub_addr     = iso->hub_addr;
+  sitd->port_number  = iso->hub_port;
+  sitd->direction    = tu_edpt_dir(iso->ep_addr);
+
+  sitd->int_smask    = iso->smask;
+  sitd->fl_int_cmask = iso->cmask;
+
+  sitd->total_bytes     = len;
+  sitd->int_on_complete = ioc ? 1 : 0;
+  sitd->active          = 1;
+
+  sitd->buffer[0] = addr;
+  sitd->buffer[1] = tu_align4k(addr) + 4096;
+  if (sitd->direction == 0) {
+    // OUT: number of start-splits needed to send the payload
+    uint32_t const tcount = tu_max32(1, tu_div_ceil(len, EHCI_SPLIT_XACT_MAX));
+    sitd->buffer[1] |= tcount | ((uint32_t) (tcount == 1 ? SITD_TP_ALL : SITD_TP_BEGIN) << 3);
+  }
+
+  sitd->back.terminate = 1;
+
+  // software data
+  sitd->used    = 1;
+  sitd->ihd_idx = iso_idx;
+}
+
+// Release hub's TT time reserved by full speed endpoint
+static void iso_split_release(uint8_t rhport, ehci_iso_ep_t const* iso) {
+  if (iso->speed != TUSB_SPEED_HIGH) {
+    hcd_split_sched_t const sched = { .smask = iso->smask, .cmask = iso->cmask };
+    hcd_split_release(rhport, iso->hub_addr, iso->hub_port, iso->speed, TUSB_XFER_ISOCHRONOUS,
+                      tu_edpt_dir(iso->ep_addr), iso->max_packet_size, &sched);
+  }
+}
+
+static bool iso_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc) {
+  TU_ASSERT(ep_desc->bInterval >= 1 && ep_desc->bInterval <= 16);
+
+  ehci_iso_ep_t* iso = NULL;
+  for (uint32_t i = 0; i < CFG_TUH_EHCI_ISO_ENDPOINT_MAX; i++) {
+    if (!ehci_data.iso_ep[i].used) {
+      iso = &ehci_data.iso_ep[i];
+      break;
+    }
+  }
+  TU_ASSERT(iso);
+
+  hcd_devtree_info_t devtree_info;
+  hcd_devtree_get_info(dev_addr, &devtree_info);
+
+  tu_memclr(iso, sizeof(ehci_iso_ep_t));
+  iso->dev_addr        = dev_addr;
+  iso->ep_addr         = ep_desc->bEndpointAddress;
+  iso->speed           = devtree_info.speed;
+  iso->hub_addr        = devtree_info.hub_addr;
+  iso->hub_port        = devtree_info.hub_port;
+  iso->max_packet_size = tu_edpt_packet_size(ep_desc);
+
+  if (iso->speed == TUSB_SPEED_HIGH) {
+    iso->mult          = tu_edpt_hs_mult(ep_desc);
+    iso->interval_log2 = (uint8_t) (ep_desc->bInterval - 1);
+    iso->smask         = iso_hs_smask_find(iso->interval_log2);
+  } else {
+    // Full speed: interval is 2^(bInterval-1) frames
+    iso->mult          = 1;
+    iso->interval_log2 = (uint8_t) (ep_desc->bInterval - 1 + 3);
+
+    // IN: one start-split, complete-split in each micro-frame of data (EHCI 4.12.3.3.1)
+    // OUT: start-split of up to 188 bytes in each micro-frame, no complete-split
+    hcd_split_sched_t sched;
+    if (!hcd_split_reserve(rhport, iso->hub_addr, iso->hub_port, iso->speed, TUSB_XFER_ISOCHRONOUS,
+                           tu_edpt_dir(iso->ep_addr), iso->max_packet_size, &sched)) {
+      TU_LOG1("EHCI: not enough TT bandwidth\r\n");
+      return false;
+    }
+    iso->smask = sched.smask;
+    iso->cmask = sched.cmask;
+  }
+
+  if (!bw_update(iso->speed, true, iso->smask, iso->cmask, (uint16_t) iso_packet_size(iso), true)) {
+    TU_LOG1("EHCI: not enough periodic bandwidth\r\n");
+    iso_split_release(rhport, iso);
+    return false;
+  }
+
+  iso->used = 1;
+  return true;
+}
+
+// Schedule packets of current transfer starting at start_frame, or right after previous transfer if possible with
+// TU_ISO_START_ASAP. start_frame is NULL for hcd_edpt_xfer() whose buffer is split into max size packets
+static bool iso_edpt_xfer(ehci_iso_ep_t* iso, uint8_t * buffer, uint32_t buflen, uint32_t* start_frame) {
+  TU_VERIFY(!iso->active);
+
+  iso->buffer = buffer;
+  iso->buflen = buflen;
+  if (start_frame == NULL) {
+#if CFG_TUH_EDPT_ISO_XFER
+    iso->packets = NULL;
+#endif
+    iso->pkt_count = (uint16_t) tu_max32(1, tu_div_ceil(buflen, iso_packet_size(iso)));
+  }
+
+  uint32_t const pkt_count = iso->pkt_count;
+  uint32_t const pkt_per_frame = iso_packet_per_frame(iso);
+  uint32_t const td_count = tu_div_ceil(pkt_count, pkt_per_frame);
+  uint32_t const step = iso_frame_step(iso);
+  uint32_t const span = (td_count - 1) * step;
+  TU_ASSERT(td_count <= EHCI_ISO_XFER_FRAME_MAX);
+
+  // continue the stream if possible, otherwise (re)start with the nearest safe frame.
+  // All TDs must be within one framelist round from now.
+  uint32_t const now = hcd_frame_number(0);
+  uint32_t const lead = iso_schedule_lead();
+  uint32_t start;
+  if (start_frame == NULL || *start_frame == TU_ISO_START_ASAP) {
+    start = iso->next_frame;
+    if ((int32_t) (start - (now + lead)) < 0 || (start - now) + span >= FRAMELIST_SIZE) {
+      start = now + lead;
+    }
+  } else {
+    start = *start_frame;
+    TU_VERIFY((int32_t) (start - (now + lead)) >= 0 && (start - now) + span < FRAMELIST_SIZE);
+  }
+  TU_ASSERT(lead + span < FRAMELIST_SIZE);
+
+  // allocate all TDs first
+  for (uint32_t t = 0; t < td_count; t++) {
+    int const td_idx = td_alloc(iso);
+    if (td_idx < 0) {
+      for (uint32_t i = 0; i < t; i++) {
+        td_free(iso, iso->td_idx[i]);
+      }
+      TU_LOG1("EHCI: out of isochronous TD\r\n");
+      return false;
+    }
+    iso->td_idx[t] = (uint8_t) td_idx;
+  }
+
+  // IN transfer: invalidate buffer, OUT transfer: clean buffer
+  if (tu_edpt_dir(iso->ep_addr)) {
+    hcd_dcache_invalidate(buffer, buflen);
+  } else {
+    hcd_dcache_clean(buffer, buflen);
+  }
+
+  if (start_frame) {
+    *start_frame = start;
+  }
+  iso->td_count    = (uint8_t) td_count;
+  iso->start_frame = start;
+  iso->next_frame  = start + td_count * step;
+  iso->active      = 1;
+
+  uint8_t const iso_idx = (uint8_t) (iso - ehci_data.iso_ep);
+  uint32_t offset = 0;
+  for (uint32_t t = 0; t < td_count; t++) {
+    bool const ioc = (t == td_count - 1); // interrupt on the last TD only
+    uint32_t const first_pkt = t * pkt_per_frame;
+    uint32_t const td_pkt_count = tu_min32(pkt_per_frame, pkt_count - first_pkt);
+    uint8_t const td_idx = iso->td_idx[t];
+
+    if (iso->speed == TUSB_SPEED_HIGH) {
+      ehci_itd_t* itd = &ehci_data.itd_pool[td_idx];
+      itd_init(iso, itd, first_pkt, td_pkt_count, offset, ioc);
+      hcd_dcache_clean(itd, sizeof(ehci_itd_t));
+      framelist_insert_td(start + t * step, (ehci_link_t*) itd, EHCI_QTYPE_ITD);
+    } else {
+      ehci_sitd_t* sitd = &ehci_data.sitd_pool[td_idx];
+      sitd_init(iso, sitd, iso_idx, first_pkt, offset, ioc);
+      hcd_dcache_clean(sitd, sizeof(ehci_sitd_t));
+      framelist_insert_td(start + t * step, (ehci_link_t*) sitd, EHCI_QTYPE_SITD);
+    }
+
+    for (uint32_t k = 0; k < td_pkt_count; k++) {
+      offset += iso_packet_len(iso, first_pkt + k);
+    }
+  }
+
+  return true;
+}
+
+#if CFG_TUH_EDPT_ISO_XFER
+bool hcd_edpt_iso_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t* buffer,
+                       tu_iso_packet_t* packets, uint16_t packet_count, uint32_t* start_frame) {
+  (void) rhport;
+  ehci_iso_ep_t* iso = iso_get_from_addr(dev_addr, ep_addr);
+  TU_VERIFY(iso && !iso->active && packet_count);
+
+  // each packet is one transaction slot (micro-frame) of iTD or one siTD
+  uint32_t buflen = 0;
+  for (uint16_t i = 0; i < packet_count; i++) {
+    TU_VERIFY(packets[i].len <= iso_packet_size(iso));
+    buflen += packets[i].len;
+  }
+
+  iso->packets   = packets;
+  iso->pkt_count = packet_count;
+  return iso_edpt_xfer(iso, buffer, buflen, start_frame);
+}
+#endif
+
+static bool iso_edpt_abort(ehci_iso_ep_t* iso) {
+  TU_VERIFY(iso->active);
+
+  // HC may be processing, disable period schedule before making changes
+  ehci_disable_schedule(ehci_data.regs, true);
+  iso_td_remove_all(iso);
+  ehci_enable_schedule(ehci_data.regs, true);
+
+  return true;
+}
+
+static void iso_device_close(uint8_t rhport, uint8_t dev_addr) {
+  for (uint32_t i = 0; i < CFG_TUH_EHCI_ISO_ENDPOINT_MAX; i++) {
+    ehci_iso_ep_t* iso = &ehci_data.iso_ep[i];
+    if (iso->used && iso->dev_addr == dev_addr) {
+      // removed TDs are guaranteed to be free in the next frame (1 ms)
+      iso_td_remove_all(iso);
+      (void) bw_update(iso->speed, true, iso->smask, iso->cmask, (uint16_t) iso_packet_size(iso), false);
+      iso_split_release(rhport, iso);
+      iso->used = 0;
+    }
+  }
+}
+
+// Check TDs of a transfer, return false if any of them is still active
+static bool iso_xfer_retired(ehci_iso_ep_t const* iso) {
+  for (uint8_t t = 0; t < iso->td_count; t++) {
+    uint8_t const td_idx = iso->td_idx[t];
+    if (iso->speed == TUSB_SPEED_HIGH) {
+      ehci_itd_t const* itd = &ehci_data.itd_pool[td_idx];
+      hcd_dcache_invalidate(itd, sizeof(ehci_itd_t));
+      for (uint8_t uf = 0; uf < 8; uf++) {
+        if (itd->xact[uf].active) {
+          return false;
+        }
+      }
+    } else {
+      ehci_sitd_t const* sitd = &ehci_data.sitd_pool[td_idx];
+      hcd_dcache_invalidate(sitd, sizeof(ehci_sitd_t));
+      if (sitd->active) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Complete retired isochronous transfers. Received packets can be shorter than max packet size, IN data is
+// compacted in place so that buffer holds contiguous data of xferred bytes.
+static void iso_xfer_complete_isr(void) {
+  for (uint32_t i = 0; i < CFG_TUH_EHCI_ISO_ENDPOINT_MAX; i++) {
+    ehci_iso_ep_t* iso = &ehci_data.iso_ep[i];
+    if (!(iso->used && iso->active && iso_xfer_retired(iso))) {
+      continue;
+    }
+
+    bool const is_in = (tu_edpt_dir(iso->ep_addr) == 1);
+    uint32_t const pkt_per_frame = iso_packet_per_frame(iso);
+    uint32_t const pkt_count = iso->pkt_count;
+    xfer_result_t xfer_result = XFER_RESULT_SUCCESS;
+    uint32_t xferred = 0;
+    uint32_t offset = 0;
+
+    if (is_in && iso->buflen) {
+      hcd_dcache_invalidate(iso->buffer, iso->buflen);
+    }
+
+    for (uint32_t pkt = 0; pkt < pkt_count; pkt++) {
+      uint8_t const td_idx = iso->td_idx[pkt / pkt_per_frame];
+      uint16_t len = iso_packet_len(iso, pkt);
+      bool failed;
+
+      if (iso->speed == TUSB_SPEED_HIGH) {
+        uint8_t const first_uf = (uint8_t) tu_log2(iso->smask & (uint8_t) (-iso->smask));
+        uint8_t const uf = (uint8_t) (first_uf + (pkt % pkt_per_frame) * (1u << iso->interval_log2));
+        ehci_itd_t const* itd = &ehci_data.itd_pool[td_idx];
+
+        failed = itd->xact[uf].error || itd->xact[uf].babble_err || itd->xact[uf].buffer_err;
+        if (is_in) {
+          len = (uint16_t) tu_min16(len, itd->xact[uf].length); // HC writes back received bytes
+        }
+      } else {
+        ehci_sitd_t const* sitd = &ehci_data.sitd_pool[td_idx];
+
+        failed = sitd->error || sitd->xact_err || sitd->babble_err || sitd->buffer_err || sitd->missed_uframe;
+        if (is_in) {
+          len = (uint16_t) (len - tu_min16(len, sitd->total_bytes)); // total_bytes is remaining bytes
+        }
+      }
+
+      if (failed) {
+        xfer_result = XFER_RESULT_FAILED;
+      }
+
+#if CFG_TUH_EDPT_ISO_XFER
+      if (iso->packets) {
+        // packets stay in place, their actual length tell where data is
+        tu_iso_packet_t* packet = &iso->packets[pkt];
+        packet->actual_len = len;
+        packet->result = failed ? XFER_RESULT_FAILED : XFER_RESULT_SUCCESS;
+        xferred += len;
+        continue;
+      }
+#endif
+
+      if (is_in && len) {
+        uint8_t const* pkt_buf = iso->buffer + offset;
+        if (pkt_buf != iso->buffer + xferred) {
+          memmove(iso->buffer + xferred, pkt_buf, len);
+        }
+      }
+      offset += iso_packet_size(iso);
+      xferred += len;
+    }
+
+    // HC already moved to the next frame since interrupt is raised at frame boundary by default threshold
+    iso_td_remove_all(iso);
+
+    hcd_event_xfer_complete(iso->dev_addr, iso->ep_addr, xferred, xfer_result, true);
+  }
+}
+
+#endif
+
 #endif
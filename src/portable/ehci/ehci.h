@@ -47,10 +47,63 @@
 // EHCI CONFIGURATION & CONSTANTS
 //--------------------------------------------------------------------+
 
-// TODO merge OHCI with EHCI
+// Periodic frame list size (number of 1 ms frames): 1024, 512, 256 for standard EHCI. ChipIdea (NXP Transdimension)
+// also supports 128, 64, 32, 16, 8. Smaller list saves SRAM but limits how far ahead isochronous TDs can be scheduled
+#ifndef CFG_TUH_EHCI_FRAMELIST_SIZE
+  #ifdef TUP_USBIP_CHIPIDEA_HS
+    #define CFG_TUH_EHCI_FRAMELIST_SIZE   8
+  #else
+    #define CFG_TUH_EHCI_FRAMELIST_SIZE   256
+  #endif
+#endif
+
+// Queue head pool for bulk/interrupt endpoints (control endpoints have their own queue head per device).
+// Each pool element takes 64 bytes, size it to the actual number of endpoints in use.
+#ifndef CFG_TUH_EHCI_QHD_MAX
+  #define CFG_TUH_EHCI_QHD_MAX    (CFG_TUH_DEVICE_MAX*CFG_TUH_ENDPOINT_MAX + CFG_TUH_HUB)
+#endif
+
+// Queue TD pool, usbh queues at most 1 TD per bulk/interrupt endpoint at a time. Each element takes 32 bytes
+#ifndef CFG_TUH_EHCI_QTD_MAX
+  #define CFG_TUH_EHCI_QTD_MAX    CFG_TUH_EHCI_QHD_MAX
+#endif
+
+// Async schedule park mode: number of successive transactions (1-3) the controller executes from a highspeed
+// bulk/control queue head before moving to the next one. Only applied if controller supports park mode, 0 to disable
+#ifndef CFG_TUH_EHCI_ASYNC_PARK_COUNT
+  #define CFG_TUH_EHCI_ASYNC_PARK_COUNT   3
+#endif
+
+// Interrupt threshold (USBCMD.ITC) in micro-frames: 0 (immediate, ChipIdea only), 1,2,4,8,16,32,64. Default 8 is the
+// EHCI reset value. Changed at runtime with tuh_configure(TUH_CFGID_EHCI_INTR_THRESHOLD)
+#ifndef CFG_TUH_EHCI_ITC
+  #define CFG_TUH_EHCI_ITC   8
+#endif
+
+// Number of isochronous endpoints that can be opened at the same time, 0 means isochronous is not supported.
+// Highspeed endpoints (including high-bandwidth mult 2-3) use iTD, full speed endpoints use siTD split through
+// hub's TT. Full speed device on ChipIdea root port goes through its embedded TT (hub address 0, TTCTRL.TTHA = 0)
+#ifndef CFG_TUH_EHCI_ISO_ENDPOINT_MAX
+  #define CFG_TUH_EHCI_ISO_ENDPOINT_MAX   0
+#endif
+
+// Max number of frames a single isochronous transfer can span
+#define EHCI_ISO_XFER_FRAME_MAX   8
+
+// Highspeed isochronous TD pool, each iTD serves one frame (up to 8 micro-frames) of an endpoint
+#ifndef CFG_TUH_EHCI_ITD_MAX
+  #define CFG_TUH_EHCI_ITD_MAX    (CFG_TUH_EHCI_ISO_ENDPOINT_MAX * EHCI_ISO_XFER_FRAME_MAX)
+#endif
+
+// Split (full-speed) isochronous TD pool, each siTD serves one frame of an endpoint
+#ifndef CFG_TUH_EHCI_SITD_MAX
+  #define CFG_TUH_EHCI_SITD_MAX   (CFG_TUH_EHCI_ISO_ENDPOINT_MAX * EHCI_ISO_XFER_FRAME_MAX)
+#endif
+
 enum {
-  EHCI_MAX_ITD  = 4,
-  EHCI_MAX_SITD = 16
+  EHCI_BW_HS_UFRAME_BUDGET = 6000, // 80% of 7500 byte times per micro-frame can be allocated to periodic (USB 2.0 5.7.4)
+  EHCI_BW_FS_FRAME_BUDGET  = 1350, // 90% of 1500 byte times per frame for full/low speed periodic
+  EHCI_SPLIT_XACT_MAX      = 188,  // max full-speed bytes transferred through TT per micro-frame (EHCI 4.12.3)
 };
 
 //--------------------------------------------------------------------+
@@ -96,7 +149,7 @@ typedef struct
 	  struct {
 	    uint32_t                : 5;
 	    uint32_t used           : 1;
-	    uint32_t                : 10;
+	    uint32_t free_next      : 10; ///< next free TD in pool, only valid when not used
 	    uint32_t expected_bytes : 16;
 	  };
 	};
@@ -164,7 +217,8 @@ typedef struct TU_ATTR_ALIGNED(32)
 	uint8_t pid;
 	uint8_t interval_ms; // polling interval in frames (or millisecond)
 
-	uint8_t TU_RESERVED[4];
+	uint8_t free_next; // next element in pool's free (or removing) list
+	uint8_t TU_RESERVED[3];
 
   // Attached TD management, note usbh will only queue 1 TD per QHD.
   // buffer for dcache invalidate since td's buffer is modified by HC and finding initial buffer address is not trivial
@@ -195,6 +249,9 @@ typedef struct TU_ATTR_ALIGNED(32) {
 	} xact[8];
 
 	// Word 9-15  Buffer Page Pointer List (Plus)
+	// [0] bit 0-6: device address, bit 8-11: endpoint number
+	// [1] bit 0-10: max packet size, bit 11: direction (1 = IN)
+	// [2] bit 0-1: mult (transactions per micro-frame)
 	uint32_t BufferPointer[7];
 
 //	// FIXME: Store meta data into buffer pointer reserved for saving memory
@@ -246,7 +303,7 @@ typedef struct TU_ATTR_ALIGNED(32)
 					 uint32_t                 : 0  ; // padding to the end of current storage unit
 
 	/// Word 4-5: Buffer Pointer List
-	uint32_t buffer[2];		// buffer[1] TP: Transaction Position - T-Count: Transaction Count
+	uint32_t buffer[2];		// buffer[1] bit 0-2 T-Count: Transaction Count, bit 3-4 TP: Transaction Position
 
 	/*---------- Word 6 ----------*/
 	ehci_link_t back;
@@ -286,6 +343,7 @@ enum {
 
 enum {
   EHCI_USBCMD_FRAMELIST_SIZE_SHIFT              = 2, // [2..3]
+  EHCI_USBCMD_ASYNC_PARK_COUNT_SHIFT            = 8, // [8..9]
   EHCI_USBCMD_CHIPIDEA_FRAMELIST_SIZE_MSB_SHIFT = 15,
   EHCI_USBCMD_INTERRUPT_THRESHOLD_SHIFT         = 16
 };
@@ -296,6 +354,7 @@ enum {
   EHCI_USBCMD_PERIOD_SCHEDULE_ENABLE         = TU_BIT(4), // [4..4] Enable periodic schedule
   EHCI_USBCMD_ASYNC_SCHEDULE_ENABLE          = TU_BIT(5), // [5..5] Enable async schedule
   EHCI_USBCMD_INTR_ON_ASYNC_ADVANCE_DOORBELL = TU_BIT(6), // [6..6] Tell HC to interrupt next time it advances async list. Clear by HC
+  EHCI_USBCMD_ASYNC_PARK_ENABLE              = TU_BIT(11), // [11..11] Enable async schedule park mode
 };
 
 enum {
@@ -328,9 +387,9 @@ typedef volatile struct
       uint32_t async_enable           : 1 ; ///< This bit controls whether the host controller skips processing the Asynchronous Schedule. Values mean: 0b Do not process the Asynchronous Schedule 1b Use the ASYNCLISTADDR register to access the Asynchronous Schedule.
       uint32_t async_adv_doorbell     : 1 ; ///< Tell HC to interrupt next time it advances async list. Clear by HC
       uint32_t light_reset            : 1 ; ///< Reset HC without affecting ports state
-      uint32_t async_park_count       : 2 ; ///< not used by tinyusb
+      uint32_t async_park_count       : 2 ; ///< Number of successive transactions in park mode
       uint32_t                        : 1 ;
-      uint32_t async_park_enable      : 1 ; ///< Enable park mode, not used by tinyusb
+      uint32_t async_park_enable      : 1 ; ///< Enable park mode
       uint32_t                        : 3 ;
       uint32_t nxp_framelist_size_msb : 1 ; ///< NXP customized : Bit 2 of the Frame List Size bits \n 011b: 128 elements \n 100b: 64 elements \n 101b: 32 elements \n 110b: 16 elements \n 111b: 8 elements
       uint32_t int_threshold          : 8 ; ///< Default 08h. Interrupt rate in unit of micro frame
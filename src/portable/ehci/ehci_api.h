@@ -38,6 +38,17 @@
 // Initialize EHCI driver
 bool ehci_init(uint8_t rhport, uint32_t capability_reg, uint32_t operatial_reg);
 
+// Periodic (interrupt + isochronous) bandwidth allocated, in byte times
+typedef struct {
+  uint16_t hs_uframe[8]; // highspeed bus time allocated in each micro-frame
+  uint16_t hs_budget;    // highspeed periodic budget per micro-frame
+  uint16_t fs_frame;     // full/low speed bus time allocated per frame (behind TT)
+  uint16_t fs_budget;    // full/low speed periodic budget per frame
+} ehci_periodic_bw_t;
+
+// Get periodic bandwidth usage, useful to check how many more streams can fit
+void ehci_periodic_bandwidth_get(uint8_t rhport, ehci_periodic_bw_t* bw);
+
 #ifdef __cplusplus
  }
 #endif
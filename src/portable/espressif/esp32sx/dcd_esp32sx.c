@@ -63,9 +63,15 @@
 // Max number of IN EP FIFOs
 #define EP_FIFO_NUM 5
 
+// RX FIFO size (in words) for control endpoint, see bus_reset()
+#define EP_RX_FIFO_DEFAULT 52
+
+// Control IN FIFO 0 size (in words)
+#define EP0_TX_FIFO_SIZE  16
+
 typedef struct {
     uint8_t *buffer;
-    // tu_fifo_t * ff; // TODO support dcd_edpt_xfer_fifo API
+    tu_fifo_t * ff;
     uint16_t total_len;
     uint16_t queued_len;
     uint16_t max_size;
@@ -85,6 +91,15 @@ static xfer_ctl_t xfer_status[EP_MAX][2];
 // Keep count of how many FIFOs are in use
 static uint8_t _allocated_fifos = 1; //FIFO0 is always in use
 
+// Top of free FIFO RAM (in words): IN FIFOs are allocated from the top down, RX FIFO grows from the bottom up
+static uint16_t _dfifo_top = EP_FIFO_SIZE/4 - EP0_TX_FIFO_SIZE;
+
+// RX FIFO size (in words) needed to receive packets of mps bytes, see bus_reset()
+static inline uint16_t calc_grxfsiz(uint16_t mps)
+{
+  return (uint16_t) (10 + 1 + 2 * (tu_div_ceil(mps, 4) + 2));
+}
+
 // Will either return an unused FIFO number, or 0 if all are used.
 static uint8_t get_free_fifo(void)
 {
@@ -110,15 +125,13 @@ static void bus_reset(void)
   // Peripheral FIFO architecture
   //
   // --------------- 320 or 1024 ( 1280 or 4096 bytes )
-  // | IN FIFO MAX |
+  // | IN FIFO 0   |
+  // --------------- FIFO_SIZE - 16
+  // | IN FIFO 1   |
   // ---------------
   // |    ...      |
-  // --------------- y + x + 16 + GRXFSIZ
-  // | IN FIFO 2   |
-  // --------------- x + 16 + GRXFSIZ
-  // | IN FIFO 1   |
-  // --------------- 16 + GRXFSIZ
-  // | IN FIFO 0   |
+  // --------------- _dfifo_top
+  // |    free     |
   // --------------- GRXFSIZ
   // | OUT FIFO    |
   // | ( Shared )  |
@@ -130,16 +143,18 @@ static void bus_reset(void)
   // - All EP OUT shared a unique OUT FIFO which uses
   //   * 10 locations in hardware for setup packets + setup control words (up to 3 setup packets).
   //   * 2 locations for OUT endpoint control words.
-  //   * 16 for largest packet size of 64 bytes. ( TODO Highspeed is 512 bytes)
+  //   * 16 for largest packet size of 64 bytes.
   //   * 1 location for global NAK (not required/used here).
   //   * It is recommended to allocate 2 times the largest packet size, therefore
   //   Recommended value = 10 + 1 + 2 x (16+2) = 47 --> Let's make it 52
+  // OUT FIFO is enlarged when an endpoint with larger packet (e.g isochronous up to 1023 bytes) is opened.
   USB0.grstctl |= 0x10 << USB_TXFNUM_S; // fifo 0x10,
   USB0.grstctl |= USB_TXFFLSH_M;        // Flush fifo
-  USB0.grxfsiz = 52;
+  USB0.grxfsiz = EP_RX_FIFO_DEFAULT;
 
-  // Control IN uses FIFO 0 with 64 bytes ( 16 32-bit word )
-  USB0.gnptxfsiz = (16 << USB_NPTXFDEP_S) | (USB0.grxfsiz & 0x0000ffffUL);
+  // Control IN uses FIFO 0 with 64 bytes ( 16 32-bit word ) at the top of FIFO RAM
+  _dfifo_top = EP_FIFO_SIZE/4 - EP0_TX_FIFO_SIZE;
+  USB0.gnptxfsiz = (EP0_TX_FIFO_SIZE << USB_NPTXFDEP_S) | _dfifo_top;
 
   // Ready to receive SETUP packet
   USB0.out_ep_reg[0].doeptsiz |= USB_SUPCNT0_M;
@@ -284,34 +299,24 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const *desc_edpt)
   xfer->interval = desc_edpt->bInterval;
 
   if (dir == TUSB_DIR_OUT) {
+    // OUT FIFO is shared by all OUT endpoints, enlarge it if this endpoint has larger packet
+    uint16_t const rx_size = calc_grxfsiz(xfer->max_size);
+    if ((USB0.grxfsiz & 0x0000ffff) < rx_size) {
+      TU_ASSERT(rx_size <= _dfifo_top);
+      USB0.grxfsiz = rx_size;
+    }
+
     out_ep[epnum].doepctl |= USB_USBACTEP1_M |
                              desc_edpt->bmAttributes.xfer << USB_EPTYPE1_S |
                              (desc_edpt->bmAttributes.xfer != TUSB_XFER_ISOCHRONOUS ? USB_DO_SETD0PID1_M : 0) |
                              xfer->max_size << USB_MPS1_S;
     USB0.daintmsk |= (1 << (16 + epnum));
   } else {
-    // "USB Data FIFOs" section in reference manual
-    // Peripheral FIFO architecture
-    //
-    // --------------- 320 or 1024 ( 1280 or 4096 bytes )
-    // | IN FIFO MAX |
-    // ---------------
-    // |    ...      |
-    // --------------- y + x + 16 + GRXFSIZ
-    // | IN FIFO 2   |
-    // --------------- x + 16 + GRXFSIZ
-    // | IN FIFO 1   |
-    // --------------- 16 + GRXFSIZ
-    // | IN FIFO 0   |
-    // --------------- GRXFSIZ
-    // | OUT FIFO    |
-    // | ( Shared )  |
-    // --------------- 0
-    //
-    // Since OUT FIFO = GRXFSIZ, FIFO 0 = 16, for simplicity, we equally allocated for the rest of endpoints
-    // - Size  : (FIFO_SIZE/4 - GRXFSIZ - 16) / (EP_MAX-1)
-    // - Offset: GRXFSIZ + 16 + Size*(epnum-1)
-    // - IN EP 1 gets FIFO 1, IN EP "n" gets FIFO "n".
+    // IN FIFOs are allocated from the top of FIFO RAM (see bus_reset()) with the endpoint's packet size, so that
+    // large isochronous packets fit and the remaining space is left to the OUT FIFO.
+    // Since only one packet is written per TX FIFO empty interrupt, a single packet is sufficient.
+    uint16_t const fifo_size = tu_max16(EP0_TX_FIFO_SIZE, (uint16_t) tu_div_ceil(xfer->max_size, 4));
+    TU_ASSERT(_dfifo_top >= fifo_size + (USB0.grxfsiz & 0x0000ffff));
 
     uint8_t fifo_num = get_free_fifo();
     TU_ASSERT(fifo_num != 0);
@@ -326,13 +331,10 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const *desc_edpt)
     USB0.daintmsk |= (1 << (0 + epnum));
 
     // Both TXFD and TXSA are in unit of 32-bit words.
-    // IN FIFO 0 was configured during enumeration, hence the "+ 16".
-    uint16_t const allocated_size = (USB0.grxfsiz & 0x0000ffff) + 16;
-    uint16_t const fifo_size = (EP_FIFO_SIZE/4 - allocated_size) / (EP_FIFO_NUM-1);
-    uint32_t const fifo_offset = allocated_size + fifo_size*(fifo_num-1);
+    _dfifo_top -= fifo_size;
 
     // DIEPTXF starts at FIFO #1.
-    USB0.dieptxf[epnum - 1] = (fifo_size << USB_NPTXFDEP_S) | fifo_offset;
+    USB0.dieptxf[fifo_num - 1] = (fifo_size << USB_NPTXFDEP_S) | _dfifo_top;
   }
   return true;
 }
@@ -359,24 +361,20 @@ void dcd_edpt_close_all(uint8_t rhport)
   }
 
   _allocated_fifos = 1;
+  _dfifo_top = EP_FIFO_SIZE/4 - EP0_TX_FIFO_SIZE;
+  USB0.grxfsiz = EP_RX_FIFO_DEFAULT;
 }
 
-bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t total_bytes)
+// Schedule transfer, buffer or ff of xfer must be set by caller
+static bool edpt_xfer(uint8_t epnum, uint8_t dir, uint16_t total_bytes)
 {
-  (void)rhport;
-
-  uint8_t const epnum = tu_edpt_number(ep_addr);
-  uint8_t const dir   = tu_edpt_dir(ep_addr);
-
   xfer_ctl_t * xfer = XFER_CTL_BASE(epnum, dir);
-  xfer->buffer       = buffer;
-  // xfer->ff           = NULL; // TODO support dcd_edpt_xfer_fifo API
   xfer->total_len    = total_bytes;
   xfer->queued_len   = 0;
   xfer->short_packet = false;
 
   uint16_t num_packets = (total_bytes / xfer->max_size);
-  uint8_t short_packet_size = total_bytes % xfer->max_size;
+  uint16_t short_packet_size = total_bytes % xfer->max_size;
 
   // Zero-size packet is special case.
   if (short_packet_size > 0 || (total_bytes == 0)) {
@@ -420,12 +418,40 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t to
   return true;
 }
 
-#if 0 // TODO support dcd_edpt_xfer_fifo API
-bool dcd_edpt_xfer_fifo (uint8_t rhport, uint8_t ep_addr, tu_fifo_t * ff, uint16_t total_bytes)
+bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t total_bytes)
 {
   (void)rhport;
+
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir   = tu_edpt_dir(ep_addr);
+
+  xfer_ctl_t * xfer = XFER_CTL_BASE(epnum, dir);
+  xfer->buffer = buffer;
+  xfer->ff     = NULL;
+
+  return edpt_xfer(epnum, dir, total_bytes);
+}
+
+// The number of bytes has to be given explicitly to allow more flexible control of how many
+// bytes should be written and second to keep the return value free to give back a boolean
+// success message. If total_bytes is too big, the FIFO will copy only what is available
+// into the USB buffer!
+bool dcd_edpt_xfer_fifo(uint8_t rhport, uint8_t ep_addr, tu_fifo_t * ff, uint16_t total_bytes)
+{
+  (void)rhport;
+
+  // USB buffers always work in bytes so to avoid unnecessary divisions we demand item_size = 1
+  TU_ASSERT(ff->item_size == 1);
+
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir   = tu_edpt_dir(ep_addr);
+
+  xfer_ctl_t * xfer = XFER_CTL_BASE(epnum, dir);
+  xfer->buffer = NULL;
+  xfer->ff     = ff;
+
+  return edpt_xfer(epnum, dir, total_bytes);
 }
-#endif
 
 void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr)
 {
@@ -536,14 +562,12 @@ static void receive_packet(xfer_ctl_t *xfer, /* usb_out_endpoint_t * out_ep, */
   }
 
   // Common buffer read
-#if 0 // TODO support dcd_edpt_xfer_fifo API
   if (xfer->ff)
   {
     // Ring buffer
-    tu_fifo_write_n_const_addr_full_words(xfer->ff, (const void *) rx_fifo, to_recv_size);
+    tu_fifo_write_n_const_addr_full_words(xfer->ff, (const void *) (uintptr_t) rx_fifo, to_recv_size);
   }
   else
-#endif
   {
     uint8_t to_recv_rem = to_recv_size % 4;
     uint16_t to_recv_size_aligned = to_recv_size - to_recv_rem;
@@ -595,13 +619,11 @@ static void transmit_packet(xfer_ctl_t *xfer, volatile usb_in_endpoint_t *in_ep,
 
   uint16_t to_xfer_size = (remaining > xfer->max_size) ? xfer->max_size : remaining;
 
-#if 0 // TODO support dcd_edpt_xfer_fifo API
   if (xfer->ff)
   {
-    tu_fifo_read_n_const_addr_full_words(xfer->ff, (void *) tx_fifo, to_xfer_size);
+    tu_fifo_read_n_const_addr_full_words(xfer->ff, (void *) (uintptr_t) tx_fifo, to_xfer_size);
   }
   else
-#endif
   {
     uint8_t to_xfer_rem = to_xfer_size % 4;
     uint16_t to_xfer_size_aligned = to_xfer_size - to_xfer_rem;
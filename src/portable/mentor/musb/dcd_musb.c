@@ -79,6 +79,13 @@ typedef struct
   pipe_state_t pipe0;
   pipe_state_t pipe[2][TUP_DCD_ENDPOINT_MAX-1];   /* pipe[direction][endpoint number - 1] */
   uint16_t     pipe_buf_is_fifo[2]; /* Bitmap. Each bit means whether 1:TU_FIFO or 0:POD. */
+#if MUSB_CFG_DMA
+  uint8_t      dma_count;  /* Number of DMA channels reported by hardware */
+  uint8_t      dma_active; /* Bitmap. Each bit means DMA channel is transferring */
+  uint8_t      dma_ep[MUSB_DMA_CHANNEL_MAX];        /* Endpoint address of each DMA channel, 0 if free */
+  uint8_t      pipe_dma[2][TUP_DCD_ENDPOINT_MAX-1]; /* DMA channel + 1 assigned to pipe, 0 if none */
+  uint16_t     pipe_dma_busy[2]; /* Bitmap. Each bit means endpoint interrupts belong to the DMA transfer, not PIO */
+#endif
 } dcd_data_t;
 
 static dcd_data_t _dcd;
@@ -270,6 +277,9 @@ static bool handle_xfer_in(uint8_t rhport, uint_fast8_t ep_addr)
 
   musb_regs_t* musb_regs = MUSB_REGS(rhport);
   musb_ep_csr_t* ep_csr = get_ep_csr(musb_regs, epnum);
+  if (ep_csr->tx_csrl & MUSB_TXCSRL1_TXRDY) {
+    return false; // previous packet (e.g last one loaded by DMA) is not sent yet, continue on next TX interrupt
+  }
   const unsigned mps = ep_csr->tx_maxp;
   const unsigned len = TU_MIN(mps, rem);
   void          *buf = pipe->buf;
@@ -323,6 +333,130 @@ static bool handle_xfer_out(uint8_t rhport, uint_fast8_t ep_addr)
   return false;
 }
 
+//--------------------------------------------------------------------
+// DMA
+// Bulk endpoints are assigned a DMA channel (if available) when opened. Transfer with word-aligned buffer and more than
+// one packet uses DMA mode 1, other transfers and tu_fifo use PIO.
+// - IN : AutoSet sends each full packet, the last short packet is set by software. Transfer is complete when DMA is.
+// - OUT: AutoClear receives each full packet except the last one, which is read by PIO so that RXRDY is left set at
+//   the end of transfer as with PIO. A short packet stops DMA early and is also read by PIO.
+//--------------------------------------------------------------------
+#if MUSB_CFG_DMA
+
+static void dma_reset_all(musb_regs_t* musb) {
+  for (unsigned ch = 0; ch < _dcd.dma_count; ch++) {
+    musb_dma_stop(musb, ch);
+  }
+  _dcd.dma_active = 0;
+  tu_memclr(_dcd.dma_ep, sizeof(_dcd.dma_ep));
+  tu_memclr(_dcd.pipe_dma, sizeof(_dcd.pipe_dma));
+  _dcd.pipe_dma_busy[0] = _dcd.pipe_dma_busy[1] = 0;
+}
+
+static void dma_channel_alloc(uint8_t ep_addr) {
+  unsigned const epnum  = tu_edpt_number(ep_addr);
+  unsigned const dir_in = tu_edpt_dir(ep_addr);
+  if (_dcd.pipe_dma[dir_in][epnum - 1]) return; // already assigned
+
+  for (unsigned ch = 0; ch < _dcd.dma_count; ch++) {
+    if (!_dcd.dma_ep[ch]) {
+      _dcd.dma_ep[ch] = ep_addr;
+      _dcd.pipe_dma[dir_in][epnum - 1] = (uint8_t) (ch + 1);
+      return;
+    }
+  }
+  // out of channel, endpoint uses PIO
+}
+
+static bool dma_xfer_start(musb_regs_t* musb, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes) {
+  unsigned const epnum  = tu_edpt_number(ep_addr);
+  unsigned const dir_in = tu_edpt_dir(ep_addr);
+  unsigned const ch_plus1 = _dcd.pipe_dma[dir_in][epnum - 1];
+  if (!ch_plus1 || ((uintptr_t) buffer & 3)) return false;
+  unsigned const ch = ch_plus1 - 1;
+
+  musb_ep_csr_t* ep_csr = get_ep_csr(musb, epnum);
+  if (dir_in) {
+    if (total_bytes <= ep_csr->tx_maxp) return false; // single packet, PIO is faster
+    ep_csr->tx_csrh |= MUSB_TXCSRH1_AUTOSET | MUSB_TXCSRH1_DMAEN | MUSB_TXCSRH1_DMAMOD;
+    musb_dma_start(musb, ch, epnum, 1, buffer, total_bytes);
+  } else {
+    const unsigned mps = ep_csr->rx_maxp;
+    if (total_bytes < 2*mps || (total_bytes % mps)) return false;
+    ep_csr->rx_csrh |= MUSB_RXCSRH1_AUTOCL | MUSB_RXCSRH1_DMAEN | MUSB_RXCSRH1_DMAMOD;
+    musb_dma_start(musb, ch, epnum, 0, buffer, total_bytes - mps);
+    if (ep_csr->rx_csrl & MUSB_RXCSRL1_RXRDY) ep_csr->rx_csrl = 0; /* Clear RXRDY bit of previous packet */
+  }
+
+  _dcd.dma_active |= TU_BIT(ch);
+  _dcd.pipe_dma_busy[dir_in] |= TU_BIT(epnum - 1);
+  return true;
+}
+
+// Stop OUT DMA and hand the rest of transfer over to PIO. Note: index register is already set by caller
+static void dma_xfer_out_stop(musb_regs_t* musb, musb_ep_csr_t* ep_csr, unsigned epnum, unsigned ch) {
+  pipe_state_t *pipe = &_dcd.pipe[TUSB_DIR_OUT][epnum - 1];
+
+  musb_dma_stop(musb, ch);
+  _dcd.dma_active &= (uint8_t) ~TU_BIT(ch);
+  _dcd.pipe_dma_busy[TUSB_DIR_OUT] &= (uint16_t) ~TU_BIT(epnum - 1);
+
+  ep_csr->rx_csrh &= ~(MUSB_RXCSRH1_AUTOCL | MUSB_RXCSRH1_DMAEN);
+  ep_csr->rx_csrh &= ~MUSB_RXCSRH1_DMAMOD; // must be cleared after DMAEN
+
+  const uint32_t xferred = musb_dma_xferred(musb, ch, pipe->buf);
+  pipe->buf        = (uint8_t*) pipe->buf + xferred;
+  pipe->remaining -= (uint16_t) xferred;
+}
+
+// A packet is received while OUT DMA is active: full packet is left to DMA, short packet stops DMA.
+// Return true if the packet should be read by PIO
+static bool dma_xfer_out_packet(musb_regs_t* musb, musb_ep_csr_t* ep_csr, unsigned epnum) {
+  if (!(ep_csr->rx_csrl & MUSB_RXCSRL1_RXRDY) || ep_csr->rx_count >= ep_csr->rx_maxp) return false;
+  dma_xfer_out_stop(musb, ep_csr, epnum, _dcd.pipe_dma[TUSB_DIR_OUT][epnum - 1] - 1u);
+  return true;
+}
+
+static void process_edpt_n(uint8_t rhport, uint_fast8_t ep_addr);
+
+static void process_dma(uint8_t rhport, unsigned ch) {
+  musb_regs_t* musb = MUSB_REGS(rhport);
+  if (!(_dcd.dma_active & TU_BIT(ch))) return; // already stopped by short packet
+
+  uint8_t const ep_addr = _dcd.dma_ep[ch];
+  unsigned const epnum  = tu_edpt_number(ep_addr);
+  pipe_state_t *pipe = &_dcd.pipe[tu_edpt_dir(ep_addr)][epnum - 1];
+  musb_ep_csr_t* ep_csr = get_ep_csr(musb, epnum);
+  bool const is_error = musb_dma_is_error(musb, ch);
+
+  if (tu_edpt_dir(ep_addr)) {
+    musb_dma_stop(musb, ch);
+    _dcd.dma_active &= (uint8_t) ~TU_BIT(ch);
+
+    ep_csr->tx_csrh &= ~(MUSB_TXCSRH1_AUTOSET | MUSB_TXCSRH1_DMAEN);
+    ep_csr->tx_csrh &= ~MUSB_TXCSRH1_DMAMOD; // must be cleared after DMAEN
+    if (!is_error && (pipe->length % ep_csr->tx_maxp)) {
+      ep_csr->tx_csrl = MUSB_TXCSRL1_TXRDY; // AutoSet does not apply to short packet
+    }
+
+    // TX interrupts of packets loaded by DMA are still ignored (pipe_dma_busy) until the next transfer
+    pipe->buf       = NULL;
+    pipe->remaining = 0;
+    dcd_event_xfer_complete(rhport, ep_addr, pipe->length, is_error ? XFER_RESULT_FAILED : XFER_RESULT_SUCCESS, true);
+  } else {
+    dma_xfer_out_stop(musb, ep_csr, epnum, ch);
+    if (is_error) {
+      pipe->buf = NULL;
+      dcd_event_xfer_complete(rhport, ep_addr, pipe->length - pipe->remaining, XFER_RESULT_FAILED, true);
+    } else if (musb_dma_edpt_event_pending(ep_csr->rx_csrl, false)) {
+      // full packet received before DMA was stopped is left to DMA by dma_xfer_out_packet(), read it now
+      process_edpt_n(rhport, ep_addr);
+    }
+  }
+}
+
+#endif
+
 static bool edpt_n_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t total_bytes)
 {
   unsigned epnum = tu_edpt_number(ep_addr);
@@ -334,6 +468,14 @@ static bool edpt_n_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16
   pipe->length       = total_bytes;
   pipe->remaining    = total_bytes;
 
+#if MUSB_CFG_DMA
+  _dcd.pipe_dma_busy[dir_in] &= (uint16_t) ~TU_BIT(epnum_minus1);
+  if (!(_dcd.pipe_buf_is_fifo[dir_in] & TU_BIT(epnum_minus1)) &&
+      dma_xfer_start(MUSB_REGS(rhport), ep_addr, buffer, total_bytes)) {
+    return true;
+  }
+#endif
+
   if (dir_in) {
     handle_xfer_in(rhport, ep_addr);
   } else {
@@ -512,6 +654,9 @@ static void process_edpt_n(uint8_t rhport, uint_fast8_t ep_addr)
       ep_csr->tx_csrl &= ~(MUSB_TXCSRL1_STALLED | MUSB_TXCSRL1_UNDRN);
       return;
     }
+#if MUSB_CFG_DMA
+    if (_dcd.pipe_dma_busy[TUSB_DIR_IN] & TU_BIT(epn_minus1)) return; // packet sent by DMA
+#endif
     completed = handle_xfer_in(rhport, ep_addr);
   } else {
     // TU_LOG1(" RX CSRL%d = %x\r\n", epn, ep_csr->rx_csrl);
@@ -519,6 +664,11 @@ static void process_edpt_n(uint8_t rhport, uint_fast8_t ep_addr)
       ep_csr->rx_csrl &= ~(MUSB_RXCSRL1_STALLED | MUSB_RXCSRL1_OVER);
       return;
     }
+#if MUSB_CFG_DMA
+    if ((_dcd.pipe_dma_busy[TUSB_DIR_OUT] & TU_BIT(epn_minus1)) && !dma_xfer_out_packet(musb_regs, ep_csr, epn)) {
+      return; // full packet received by DMA
+    }
+#endif
     completed = handle_xfer_out(rhport, ep_addr);
   }
 
@@ -539,6 +689,10 @@ static void process_bus_reset(uint8_t rhport) {
   alloced_fifo_bytes = CFG_TUD_ENDPOINT0_SIZE;
 #endif
 
+#if MUSB_CFG_DMA
+  dma_reset_all(musb);
+#endif
+
   /* When bmRequestType is REQUEST_TYPE_INVALID(0xFF), a control transfer state is SETUP or STATUS stage. */
   _dcd.setup_packet.bmRequestType = REQUEST_TYPE_INVALID;
   _dcd.status_out = 0;
@@ -590,6 +744,11 @@ bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   print_musb_info(musb_regs);
 #endif
 
+#if MUSB_CFG_DMA
+  _dcd.dma_count = tu_min8(musb_regs->raminfo_bit.dma_channel, MUSB_DMA_CHANNEL_MAX);
+  dma_reset_all(musb_regs);
+#endif
+
   musb_regs->intr_usben |= MUSB_IE_SUSPND;
   musb_dcd_int_clear(rhport);
   musb_dcd_phy_init(rhport);
@@ -691,6 +850,12 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * ep_desc) {
   TU_ASSERT(hwfifo_config(musb, epn, is_rx, mps, false));
   musb->intren_ep[is_rx] |= TU_BIT(epn);
 
+#if MUSB_CFG_DMA
+  if (ep_desc->bmAttributes.xfer == TUSB_XFER_BULK) {
+    dma_channel_alloc(ep_addr);
+  }
+#endif
+
   return true;
 }
 
@@ -768,6 +933,10 @@ void dcd_edpt_close_all(uint8_t rhport)
   alloced_fifo_bytes = CFG_TUD_ENDPOINT0_SIZE;
 #endif
 
+#if MUSB_CFG_DMA
+  dma_reset_all(musb);
+#endif
+
   if (ie) musb_dcd_int_enable(rhport);
 }
 
@@ -859,6 +1028,11 @@ void dcd_int_handler(uint8_t rhport) {
   //Part specific ISR setup/entry
   musb_dcd_int_handler_enter(rhport);
 
+#if MUSB_CFG_DMA
+  // read DMA first: endpoint interrupts raised after DMA completion must be processed afterward
+  uint_fast8_t intr_dma = _dcd.dma_count ? musb_regs->dma_intr : 0; // a read will clear this interrupt status
+#endif
+
   uint_fast8_t intr_usb = musb_regs->intr_usb; // a read will clear this interrupt status
   uint_fast8_t intr_tx = musb_regs->intr_tx; // a read will clear this interrupt status
   uint_fast8_t intr_rx = musb_regs->intr_rx; // a read will clear this interrupt status
@@ -880,6 +1054,14 @@ void dcd_int_handler(uint8_t rhport) {
     dcd_event_bus_signal(rhport, DCD_EVENT_SUSPEND, true);
   }
 
+#if MUSB_CFG_DMA
+  while (intr_dma) {
+    unsigned const ch = __builtin_ctz(intr_dma);
+    process_dma(rhport, ch);
+    intr_dma &= ~TU_BIT(ch);
+  }
+#endif
+
   intr_tx &= musb_regs->intr_txen; /* Clear disabled interrupts */
   if (intr_tx & TU_BIT(0)) {
     process_ep0(rhport);
@@ -112,6 +112,13 @@ typedef struct
   pipe_state_t pipe0;
   pipe_state_t pipe[7][2];   /* pipe[pipe number - 1][direction 0:RX 1:TX] */
   pipe_addr_t  addr[7][2];   /* addr[pipe number - 1][direction 0:RX 1:TX] */
+#if MUSB_CFG_DMA
+  uint8_t      dma_count;    /* Number of DMA channels reported by hardware */
+  uint8_t      dma_active;   /* Bitmap. Each bit means DMA channel is transferring */
+  uint8_t      dma_pipe[MUSB_DMA_CHANNEL_MAX]; /* (pipe number << 1 | dir_tx) of each DMA channel, 0 if free */
+  uint8_t      pipe_dma[7][2]; /* DMA channel + 1 assigned to pipe, 0 if none */
+  uint16_t     pipe_dma_busy[2]; /* Bitmap[dir_tx]. Each bit means pipe interrupts belong to the DMA transfer, not PIO */
+#endif
 } hcd_data_t;
 
 /*------------------------------------------------------------------
@@ -346,12 +353,15 @@ static bool edpt0_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_
 static bool pipe_xfer_out(uint_fast8_t pipenum)
 {
   pipe_state_t *pipe = &_hcd.pipe[pipenum - 1][1];
+  hw_endpoint_t volatile *regs = edpt_regs(pipenum - 1);
+  if (regs->TXCSRL & USB_TXCSRL1_TXRDY) {
+    return false; /* previous packet (e.g loaded by DMA) is not sent yet, continue on next TX interrupt */
+  }
   unsigned const rem = pipe->remaining;
   if (!rem) {
     pipe->buf = NULL;
     return true;
   }
-  hw_endpoint_t volatile *regs = edpt_regs(pipenum - 1);
   unsigned const mps = regs->TXMAXP;
   unsigned const len = TU_MIN(rem, mps);
   void          *buf = pipe->buf;
@@ -389,6 +399,133 @@ static bool pipe_xfer_in(uint_fast8_t pipenum)
   return false;
 }
 
+/*------------------------------------------------------------------
+ * DMA
+ * Bulk pipes are assigned a DMA channel (if available) when opened. Transfer with word-aligned buffer and more than
+ * one packet uses DMA mode 1, with the last packet of transfer always sent/received by PIO interrupt:
+ * - OUT: AutoSet sends each full packet, the last short packet is set by software when DMA completes.
+ * - IN : AutoReq/AutoClear requests and receives each full packet except the last one. A short packet stops DMA
+ *   early and is read by PIO.
+ *------------------------------------------------------------------*/
+#if MUSB_CFG_DMA
+
+#define MUSB_REGS(rhport)   ((musb_regs_t*) MUSB_BASES[rhport])
+
+static void dma_channel_alloc(unsigned pipenum, unsigned dir_tx)
+{
+  if (_hcd.pipe_dma[pipenum - 1][dir_tx]) return; /* already assigned */
+  for (unsigned ch = 0; ch < _hcd.dma_count; ++ch) {
+    if (!_hcd.dma_pipe[ch]) {
+      _hcd.dma_pipe[ch] = (uint8_t)((pipenum << 1) | dir_tx);
+      _hcd.pipe_dma[pipenum - 1][dir_tx] = (uint8_t)(ch + 1);
+      return;
+    }
+  }
+  /* out of channel, pipe uses PIO */
+}
+
+static void dma_channel_free(musb_regs_t *musb, unsigned pipenum, unsigned dir_tx)
+{
+  unsigned const ch_plus1 = _hcd.pipe_dma[pipenum - 1][dir_tx];
+  if (!ch_plus1) return;
+  musb_dma_stop(musb, ch_plus1 - 1);
+  _hcd.dma_active &= (uint8_t)~TU_BIT(ch_plus1 - 1);
+  _hcd.dma_pipe[ch_plus1 - 1] = 0;
+  _hcd.pipe_dma[pipenum - 1][dir_tx] = 0;
+  _hcd.pipe_dma_busy[dir_tx] &= (uint16_t)~TU_BIT(pipenum);
+}
+
+static bool dma_xfer_start(musb_regs_t *musb, unsigned pipenum, unsigned dir_tx, uint8_t *buffer, uint16_t buflen)
+{
+  unsigned const ch_plus1 = _hcd.pipe_dma[pipenum - 1][dir_tx];
+  if (!ch_plus1 || ((uintptr_t)buffer & 3)) return false;
+  unsigned const ch = ch_plus1 - 1;
+
+  volatile hw_endpoint_t *regs = edpt_regs(pipenum - 1);
+  if (dir_tx) {
+    if (buflen <= regs->TXMAXP) return false; /* single packet, PIO is faster */
+    regs->TXCSRH |= MUSB_TXCSRH1_AUTOSET | MUSB_TXCSRH1_DMAEN | MUSB_TXCSRH1_DMAMOD;
+    musb_dma_start(musb, ch, pipenum, 1, buffer, buflen);
+  } else {
+    unsigned const mps = regs->RXMAXP;
+    if (buflen < 2 * mps || (buflen % mps)) return false;
+    regs->RXCSRH |= MUSB_RXCSRH1_AUTOCL | MUSB_RXCSRH1_AUTORQ | MUSB_RXCSRH1_DMAEN | MUSB_RXCSRH1_DMAMOD;
+    musb->req_packet[pipenum - 1].count = (uint16_t)(buflen / mps - 1);
+    musb_dma_start(musb, ch, pipenum, 0, buffer, buflen - mps);
+    regs->RXCSRL = USB_RXCSRL1_REQPKT;
+  }
+
+  _hcd.dma_active |= TU_BIT(ch);
+  _hcd.pipe_dma_busy[dir_tx] |= TU_BIT(pipenum);
+  return true;
+}
+
+/* Stop DMA and hand the rest of transfer over to PIO */
+static void dma_xfer_stop(musb_regs_t *musb, unsigned pipenum, unsigned dir_tx)
+{
+  unsigned const ch = _hcd.pipe_dma[pipenum - 1][dir_tx] - 1u;
+  pipe_state_t *pipe = &_hcd.pipe[pipenum - 1][dir_tx];
+  volatile hw_endpoint_t *regs = edpt_regs(pipenum - 1);
+
+  musb_dma_stop(musb, ch);
+  _hcd.dma_active &= (uint8_t)~TU_BIT(ch);
+  _hcd.pipe_dma_busy[dir_tx] &= (uint16_t)~TU_BIT(pipenum);
+
+  if (dir_tx) {
+    regs->TXCSRH &= ~(MUSB_TXCSRH1_AUTOSET | MUSB_TXCSRH1_DMAEN);
+    regs->TXCSRH &= ~MUSB_TXCSRH1_DMAMOD; /* must be cleared after DMAEN */
+  } else {
+    regs->RXCSRH &= ~(MUSB_RXCSRH1_AUTOCL | MUSB_RXCSRH1_AUTORQ | MUSB_RXCSRH1_DMAEN);
+    regs->RXCSRH &= ~MUSB_RXCSRH1_DMAMOD; /* must be cleared after DMAEN */
+  }
+
+  uint32_t const xferred = musb_dma_xferred(musb, ch, pipe->buf);
+  pipe->buf        = (uint8_t*)pipe->buf + xferred;
+  pipe->remaining -= (uint16_t)xferred;
+}
+
+static void process_pipe_tx(uint8_t rhport, uint_fast8_t pipenum);
+static void process_pipe_rx(uint8_t rhport, uint_fast8_t pipenum);
+
+static void process_dma(uint8_t rhport, unsigned ch)
+{
+  if (!(_hcd.dma_active & TU_BIT(ch))) return; /* already stopped by short packet or error */
+  musb_regs_t *musb = MUSB_REGS(rhport);
+  unsigned const pipenum = _hcd.dma_pipe[ch] >> 1;
+  unsigned const dir_tx  = _hcd.dma_pipe[ch] & 1;
+  bool const is_error    = musb_dma_is_error(musb, ch);
+  volatile hw_endpoint_t *regs = edpt_regs(pipenum - 1);
+
+  dma_xfer_stop(musb, pipenum, dir_tx);
+
+  if (is_error) {
+    pipe_addr_t  *addr = &_hcd.addr[pipenum - 1][dir_tx];
+    pipe_state_t *pipe = &_hcd.pipe[pipenum - 1][dir_tx];
+    pipe->buf = NULL;
+    hcd_event_xfer_complete(addr->dev, addr->ep, pipe->length - pipe->remaining, XFER_RESULT_FAILED, true);
+    return;
+  }
+
+  if (dir_tx) {
+    if (!musb_dma_edpt_event_pending(regs->TXCSRL, true)) {
+      /* last full packet is waiting to be sent, its interrupt completes the transfer */
+      return;
+    }
+    if (_hcd.pipe[pipenum - 1][1].length % regs->TXMAXP) {
+      regs->TXCSRL = USB_TXCSRL1_TXRDY; /* AutoSet does not apply to short packet */
+    } else {
+      /* TX interrupt of last packet came while pipe was still marked DMA busy and was ignored, complete it here */
+      process_pipe_tx(rhport, pipenum);
+      _hcd.pipe_dma_busy[1] |= TU_BIT(pipenum); /* ignore the interrupt in case it is raised */
+    }
+  } else {
+    /* request the last packet */
+    regs->RXCSRL = USB_RXCSRL1_REQPKT;
+  }
+}
+
+#endif
+
 static bool edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *buffer, uint16_t buflen)
 {
   (void)rhport;
@@ -398,6 +535,12 @@ static bool edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t
   pipe->buf          = buffer;
   pipe->length       = buflen;
   pipe->remaining    = buflen;
+
+#if MUSB_CFG_DMA
+  _hcd.pipe_dma_busy[dir_tx] &= (uint16_t)~TU_BIT(pipenum);
+  if (dma_xfer_start(MUSB_REGS(rhport), pipenum, dir_tx, buffer, buflen)) return true;
+#endif
+
   if (dir_tx) {
     pipe_xfer_out(pipenum);
   } else {
@@ -503,6 +646,14 @@ static void process_pipe_tx(uint8_t rhport, uint_fast8_t pipenum)
   volatile hw_endpoint_t *regs = edpt_regs(pipenum - 1);
   unsigned const csrl = regs->TXCSRL;
   // TU_LOG1(" TXCSRL%d = %x\r\n", pipenum, csrl);
+#if MUSB_CFG_DMA
+  if (_hcd.pipe_dma_busy[1] & TU_BIT(pipenum)) {
+    if (!(csrl & (USB_TXCSRL1_STALLED | USB_TXCSRL1_ERROR))) return; /* packet sent by DMA */
+    if (_hcd.dma_active & TU_BIT(_hcd.pipe_dma[pipenum - 1][1] - 1u)) {
+      dma_xfer_stop(MUSB_REGS(rhport), pipenum, 1);
+    }
+  }
+#endif
   if (csrl & (USB_TXCSRL1_STALLED | USB_TXCSRL1_ERROR)) {
     if (csrl & USB_TXCSRL1_TXRDY)
       regs->TXCSRL = (csrl & ~(USB_TXCSRL1_STALLED | USB_TXCSRL1_ERROR)) | USB_TXCSRL1_FLUSH;
@@ -532,6 +683,16 @@ static void process_pipe_rx(uint8_t rhport, uint_fast8_t pipenum)
   volatile hw_endpoint_t *regs = edpt_regs(pipenum - 1);
   unsigned const csrl = regs->RXCSRL;
   // TU_LOG1(" RXCSRL%d = %x\r\n", pipenum, csrl);
+#if MUSB_CFG_DMA
+  if (_hcd.pipe_dma_busy[0] & TU_BIT(pipenum)) {
+    /* full packet is received by DMA, short packet or error stops DMA */
+    if (!(csrl & (USB_RXCSRL1_STALLED | USB_RXCSRL1_ERROR)) &&
+        (!(csrl & USB_RXCSRL1_RXRDY) || regs->RXCOUNT >= regs->RXMAXP)) {
+      return;
+    }
+    dma_xfer_stop(MUSB_REGS(rhport), pipenum, 0);
+  }
+#endif
   if (csrl & (USB_RXCSRL1_STALLED | USB_RXCSRL1_ERROR)) {
     if (csrl & USB_RXCSRL1_RXRDY)
       regs->RXCSRL = (csrl & ~(USB_RXCSRL1_STALLED | USB_RXCSRL1_ERROR)) | USB_RXCSRL1_FLUSH;
@@ -562,6 +723,9 @@ bool hcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
 
   NVIC_ClearPendingIRQ(USB0_IRQn);
   _hcd.bmRequestType = REQUEST_TYPE_INVALID;
+#if MUSB_CFG_DMA
+  _hcd.dma_count = tu_min8(MUSB_REGS(rhport)->raminfo_bit.dma_channel, MUSB_DMA_CHANNEL_MAX);
+#endif
   USB0->DEVCTL |= USB_DEVCTL_SESSION;
   USB0->IE = USB_IE_DISCON | USB_IE_CONN | USB_IE_BABBLE | USB_IE_RESUME;
   return true;
@@ -640,6 +804,9 @@ void hcd_device_close(uint8_t rhport, uint8_t dev_addr)
   for (unsigned i = 0; i < sizeof(_hcd.addr)/sizeof(_hcd.addr[0]); ++i) {
     for (unsigned j = 0; j < 2; ++j, ++p) {
       if (dev_addr != p->dev) continue;
+#if MUSB_CFG_DMA
+      dma_channel_free(MUSB_REGS(rhport), i + 1, j);
+#endif
       hw_addr_t volatile     *fadr = (hw_addr_t volatile*)&USB0->TXFUNCADDR0 + i + 1;
       hw_endpoint_t volatile *regs = edpt_regs(i);
       USB0->EPIDX = i + 1;
@@ -801,6 +968,10 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
     USB0->RXFIFOADD = addr;
     USB0->RXFIFOSZ  = size_in_log2_minus3;
   }
+
+#if MUSB_CFG_DMA
+  if (TUSB_XFER_BULK == xfer) dma_channel_alloc(pipenum, dir_tx);
+#endif
   return true;
 }
 
@@ -847,6 +1018,11 @@ void hcd_int_handler(uint8_t rhport, bool in_isr)
 
   uint_fast8_t is, txis, rxis;
 
+#if MUSB_CFG_DMA
+  /* read DMA first: pipe interrupts raised after DMA completion must be processed afterward */
+  uint_fast8_t dmais = _hcd.dma_count ? MUSB_REGS(rhport)->dma_intr : 0; /* read and clear interrupt status */
+#endif
+
   is   = USB0->IS;   /* read and clear interrupt status */
   txis = USB0->TXIS; /* read and clear interrupt status */
   rxis = USB0->RXIS; /* read and clear interrupt status */
@@ -864,6 +1040,13 @@ void hcd_int_handler(uint8_t rhport, bool in_isr)
   }
   if (is & USB_IS_BABBLE) {
   }
+#if MUSB_CFG_DMA
+  while (dmais) {
+    unsigned const ch = __builtin_ctz(dmais);
+    process_dma(rhport, ch);
+    dmais &= ~TU_BIT(ch);
+  }
+#endif
   txis &= USB0->TXIE; /* Clear disabled interrupts */
   if (txis & USB_TXIE_EP0) {
     process_ep0(rhport);
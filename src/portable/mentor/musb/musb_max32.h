@@ -36,6 +36,7 @@ extern "C" {
 
 #define MUSB_CFG_SHARED_FIFO   1 // shared FIFO for TX and RX endpoints
 #define MUSB_CFG_DYNAMIC_FIFO  0 // dynamic EP FIFO sizing
+#define MUSB_CFG_DMA           1 // integrated DMA controller, number of channels is read from RAMINFO
 
 const uintptr_t MUSB_BASES[] = { MXC_BASE_USBHS };
 
@@ -35,9 +35,11 @@
   #include "TM4C123.h"
   #define FIFO0_WORD FIFO0
   #define FIFO1_WORD FIFO1
+  #define MUSB_CFG_DMA 0 // only has request lines to system uDMA, no integrated DMA controller
 //#elif CFG_TUSB_MCU == OPT_MCU_TM4C129
 #elif CFG_TUSB_MCU == OPT_MCU_MSP432E4
   #include "msp.h"
+  #define MUSB_CFG_DMA 1 // integrated DMA controller with 8 channels
 #else
   #error "Unsupported MCUs"
 #endif
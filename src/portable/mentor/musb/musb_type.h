@@ -749,6 +749,42 @@ TU_ATTR_ALWAYS_INLINE static inline musb_ep_csr_t* get_ep_csr(musb_regs_t* musb_
 #define MUSB_HSBT_HSBT_M         0x000F  // High Speed Timeout Adder
 #define MUSB_HSBT_HSBT_S         0
 
+//--------------------------------------------------------------------+
+// DMA Controller (optional)
+// Mode 1 moves multiple packets of an endpoint with a single request and only interrupts when the whole DMA transfer
+// is complete. Address must be word-aligned.
+//--------------------------------------------------------------------+
+#define MUSB_DMA_CHANNEL_MAX 8
+
+TU_ATTR_ALWAYS_INLINE static inline void musb_dma_start(musb_regs_t* musb_regs, unsigned ch, unsigned epnum,
+                                                        unsigned mem_to_fifo, void const* buf, uint32_t len) {
+  musb_regs->dma[ch].addr  = (uint32_t) (uintptr_t) buf;
+  musb_regs->dma[ch].count = len;
+  musb_regs->dma[ch].cntl  = (uint16_t) (MUSB_DMACTL0_BRSTM_INC16 | (epnum << MUSB_DMACTL0_EP_S) | MUSB_DMACTL0_IE |
+                                         MUSB_DMACTL0_MODE | (mem_to_fifo ? MUSB_DMACTL0_DIR : 0) | MUSB_DMACTL0_ENABLE);
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void musb_dma_stop(musb_regs_t* musb_regs, unsigned ch) {
+  musb_regs->dma[ch].cntl = 0;
+}
+
+// Number of bytes transferred since musb_dma_start()
+TU_ATTR_ALWAYS_INLINE static inline uint32_t musb_dma_xferred(musb_regs_t* musb_regs, unsigned ch, void const* buf) {
+  return musb_regs->dma[ch].addr - (uint32_t) (uintptr_t) buf;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline unsigned musb_dma_is_error(musb_regs_t* musb_regs, unsigned ch) {
+  return musb_regs->dma[ch].cntl & MUSB_DMACTL0_ERR;
+}
+
+// While DMA owns an endpoint, dcd/hcd leave its packet interrupts to DMA. A packet completing between the last DMA
+// burst and musb_dma_stop() therefore has no one to handle it: check with endpoint CSRL (after DMA is stopped) whether
+// a received packet is waiting in FIFO, or transmit FIFO is empty i.e last packet loaded by DMA is already sent.
+// Caller then processes the endpoint as its interrupt would do.
+TU_ATTR_ALWAYS_INLINE static inline bool musb_dma_edpt_event_pending(uint8_t csrl, bool is_tx) {
+  return is_tx ? !(csrl & MUSB_TXCSRL1_TXRDY) : ((csrl & MUSB_RXCSRL1_RXRDY) != 0);
+}
+
 #ifdef __cplusplus
  }
 #endif
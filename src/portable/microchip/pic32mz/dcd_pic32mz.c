@@ -41,6 +41,12 @@
 #define EP_MAX            8
 #endif
 
+#if CFG_TUD_PIC32MZ_DMA
+#ifndef KVA_TO_PA
+#define KVA_TO_PA(kva)    ((uint32_t)(kva) & 0x1fffffff)
+#endif
+#endif
+
 
 typedef enum {
   EP0_STAGE_NONE,
@@ -69,6 +75,11 @@ typedef struct {
   // FIFO size.
   uint16_t last_packet_size;
   uint8_t ep_addr;
+#if CFG_TUD_PIC32MZ_DMA
+  // Bulk endpoint, multi-packet transfers use DMA channel (epnum - 1)
+  bool dma_capable;
+  bool dma_active;
+#endif
 } xfer_ctl_t;
 
 static struct
@@ -137,6 +148,9 @@ void dcd_int_enable(uint8_t rhport)
   (void) rhport;
 
   USBCRCONbits.USBIE = 1;
+#if CFG_TUD_PIC32MZ_DMA
+  IEC4SET = _IEC4_USBDMAIE_MASK;
+#endif
 }
 
 void dcd_int_disable(uint8_t rhport)
@@ -144,6 +158,9 @@ void dcd_int_disable(uint8_t rhport)
   (void) rhport;
 
   USBCRCONbits.USBIE = 0;
+#if CFG_TUD_PIC32MZ_DMA
+  IEC4CLR = _IEC4_USBDMAIE_MASK;
+#endif
 }
 
 void dcd_set_address(uint8_t rhport, uint8_t dev_addr)
@@ -359,6 +376,142 @@ static void epn_fill_tx(xfer_ctl_t * xfer_in, uint8_t epnum)
   USB_REGS->EPCSR[epnum].TXCSRL_DEVICEbits.TXPKTRDY = 1;
 }
 
+#if CFG_TUD_PIC32MZ_DMA
+/*------------------------------------------------------------------*/
+/* DMA
+ * Endpoint numbers are unique (one direction only), bulk endpoint n uses DMA channel n-1. Transfer with word-aligned
+ * buffer and more than one packet is done with DMA mode 1 except for the last packet, which is written/read by CPU
+ * so that transfer completion is detected by the endpoint interrupt as without DMA.
+ * - IN : AutoSet sends each packet loaded by DMA.
+ * - OUT: AutoClear releases each full packet read by DMA. A short packet stops DMA early and is read by CPU.
+ *------------------------------------------------------------------*/
+#define DMA_CH(_epnum)  (USB_REGS->DMA_CHANNEL[(_epnum) - 1])
+
+static bool dma_xfer_start(xfer_ctl_t * xfer, uint8_t epnum, uint8_t dir)
+{
+  uint16_t const mps = xfer->max_packet_size;
+  uint16_t dma_len;
+  __USBHS_DMACNTL_t cntl = { .w = 0 };
+
+  if (!xfer->dma_capable || ((uintptr_t) xfer->buffer & 3) || xfer->total_len <= mps)
+  {
+    return false;
+  }
+
+  if (dir == TUSB_DIR_IN)
+  {
+    uint16_t const last = (xfer->total_len % mps) ? (xfer->total_len % mps) : mps;
+    dma_len = xfer->total_len - last;
+    dcd_dcache_clean(xfer->buffer, dma_len);
+
+    USB_REGS->EPCSR[epnum].TXCSRH_DEVICEbits.AUTOSET = 1;
+    USB_REGS->EPCSR[epnum].TXCSRH_DEVICEbits.DMAREQMD = 1;
+    USB_REGS->EPCSR[epnum].TXCSRH_DEVICEbits.DMAREQENL = 1;
+    cntl.DMADIR = 1;
+  }
+  else
+  {
+    // short packet could end transfer anywhere, last packet is left to CPU
+    if (xfer->total_len % mps) return false;
+    dma_len = xfer->total_len - mps;
+    dcd_dcache_invalidate(xfer->buffer, dma_len);
+
+    USB_REGS->EPCSR[epnum].RXCSRH_DEVICEbits.AUTOCLR = 1;
+    USB_REGS->EPCSR[epnum].RXCSRH_DEVICEbits.DMAREQMODE = 1;
+    USB_REGS->EPCSR[epnum].RXCSRH_DEVICEbits.DMAREQEN = 1;
+  }
+
+  DMA_CH(epnum).DMAADDR = KVA_TO_PA(xfer->buffer);
+  DMA_CH(epnum).DMACOUNT = dma_len;
+  cntl.DMAEN = 1;
+  cntl.DMAMODE = 1;
+  cntl.DMAIE = 1;
+  cntl.DMAEP = epnum;
+  cntl.DMABRSTM = 3; // INCR16
+  xfer->dma_active = true;
+  DMA_CH(epnum).DMACNTLbits.w = cntl.w;
+
+  return true;
+}
+
+// Stop DMA and account bytes it has transferred, rest of transfer continues with CPU
+static void dma_xfer_stop(xfer_ctl_t * xfer, uint8_t epnum, uint8_t dir)
+{
+  DMA_CH(epnum).DMACNTLbits.w = 0;
+  xfer->dma_active = false;
+
+  if (dir == TUSB_DIR_IN)
+  {
+    USB_REGS->EPCSR[epnum].TXCSRH_DEVICEbits.AUTOSET = 0;
+    USB_REGS->EPCSR[epnum].TXCSRH_DEVICEbits.DMAREQENL = 0;
+    USB_REGS->EPCSR[epnum].TXCSRH_DEVICEbits.DMAREQMD = 0; // must be cleared after DMAREQENL
+  }
+  else
+  {
+    USB_REGS->EPCSR[epnum].RXCSRH_DEVICEbits.AUTOCLR = 0;
+    USB_REGS->EPCSR[epnum].RXCSRH_DEVICEbits.DMAREQEN = 0;
+    USB_REGS->EPCSR[epnum].RXCSRH_DEVICEbits.DMAREQMODE = 0; // must be cleared after DMAREQEN
+  }
+
+  xfer->transferred = (uint16_t) (DMA_CH(epnum).DMAADDR - KVA_TO_PA(xfer->buffer));
+  if (dir == TUSB_DIR_OUT)
+  {
+    dcd_dcache_invalidate(xfer->buffer, xfer->transferred);
+  }
+}
+
+static void dma_reset_all(void)
+{
+  for (uint8_t epnum = 1; epnum < EP_MAX; epnum++)
+  {
+    for (uint8_t dir = 0; dir < 2; dir++)
+    {
+      xfer_ctl_t * xfer = XFER_CTL_BASE(epnum, dir);
+      if (xfer->dma_active) dma_xfer_stop(xfer, epnum, dir);
+    }
+  }
+}
+
+static void epn_handle_rx_int(uint8_t epnum);
+
+static void dma_handle_int(uint8_t epnum)
+{
+  uint8_t const dir = DMA_CH(epnum).DMACNTLbits.DMADIR ? TUSB_DIR_IN : TUSB_DIR_OUT;
+  bool const is_error = DMA_CH(epnum).DMACNTLbits.DMAERR;
+  xfer_ctl_t * xfer = XFER_CTL_BASE(epnum, dir);
+
+  if (!xfer->dma_active) return; // already stopped by short packet
+
+  dma_xfer_stop(xfer, epnum, dir);
+  if (is_error)
+  {
+    if (dir == TUSB_DIR_OUT) USB_REGS->INTRRXEbits.w &= ~(1u << epnum);
+    xfer_complete(xfer, XFER_RESULT_FAILED, true);
+    return;
+  }
+
+  if (dir == TUSB_DIR_IN)
+  {
+    if (USB_REGS->EPCSR[epnum].TXCSRL_DEVICEbits.TXPKTRDY)
+    {
+      // last packet loaded by DMA is still in FIFO, its TX interrupt fills the last packet
+      xfer->last_packet_size = xfer->max_packet_size;
+      xfer->transferred -= xfer->max_packet_size;
+    }
+    else
+    {
+      epn_fill_tx(xfer, epnum);
+    }
+  }
+  else if (USB_REGS->EPCSR[epnum].RXCSRL_DEVICEbits.w & USBHS_EP0_HOST_RXPKTRDY)
+  {
+    // last packet is for CPU, but epn_handle_rx_int() ignores a full packet while dma_active is set. Its RX interrupt
+    // may have been serviced before this DMA interrupt, read it now
+    epn_handle_rx_int(epnum);
+  }
+}
+#endif
+
 static bool ep0_xfer(xfer_ctl_t * xfer, int dir)
 {
   if (dir == TUSB_DIR_OUT)
@@ -415,6 +568,11 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * desc_edpt)
   xfer->max_packet_size = tu_edpt_packet_size(desc_edpt);
   xfer->fifo_size = xfer->max_packet_size;
   xfer->ep_addr = desc_edpt->bEndpointAddress;
+#if CFG_TUD_PIC32MZ_DMA
+  xfer->dma_capable = (desc_edpt->bmAttributes.xfer == TUSB_XFER_BULK) && (epnum != 0) &&
+                      (epnum <= TU_ARRAY_SIZE(USB_REGS->DMA_CHANNEL));
+  xfer->dma_active = false;
+#endif
 
   if (epnum != 0)
   {
@@ -466,6 +624,13 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t t
   {
     return ep0_xfer(xfer, dir);
   }
+#if CFG_TUD_PIC32MZ_DMA
+  if (dma_xfer_start(xfer, epnum, dir))
+  {
+    if (dir == TUSB_DIR_OUT) USB_REGS->INTRRXEbits.w |= (1u << epnum);
+    return true;
+  }
+#endif
   if (dir == TUSB_DIR_OUT)
   {
     USB_REGS->INTRRXEbits.w |= (1u << epnum);
@@ -566,6 +731,14 @@ static void epn_handle_rx_int(uint8_t epnum)
   if (ep_status & USBHS_EP0_HOST_RXPKTRDY)
   {
     TU_ASSERT(xfer->buffer != NULL,);
+#if CFG_TUD_PIC32MZ_DMA
+    if (xfer->dma_active)
+    {
+      // full packet is left to DMA, short packet ends the transfer early
+      if (USB_REGS->EPCSR[epnum].RXCOUNTbits.RXCNT >= xfer->max_packet_size) return;
+      dma_xfer_stop(xfer, epnum, TUSB_DIR_OUT);
+    }
+#endif
 
     transferred = rx_fifo_read(epnum, xfer->buffer + xfer->transferred);
     USB_REGS->EPCSR[epnum].RXCSRL_HOSTbits.RXPKTRDY = 0;
@@ -590,6 +763,10 @@ static void epn_handle_tx_int(uint8_t epnum)
   }
   else
   {
+#if CFG_TUD_PIC32MZ_DMA
+    // packet loaded by DMA, or last one of DMA still in FIFO: wait for the interrupt of the packet actually sent
+    if (xfer->dma_active || USB_REGS->EPCSR[epnum].TXCSRL_DEVICEbits.TXPKTRDY) return;
+#endif
     xfer->transferred += xfer->last_packet_size;
     TU_ASSERT(xfer->transferred <= xfer->total_len,);
     if (xfer->last_packet_size < xfer->max_packet_size || xfer->transferred == xfer->total_len)
@@ -708,6 +885,10 @@ void dcd_int_handler(uint8_t rhport)
   (void) rhport;
 
   IFS4CLR = _IFS4_USBIF_MASK;
+#if CFG_TUD_PIC32MZ_DMA
+  uint32_t const dmaints = USB_REGS->DMA_INTR; // cleared by read
+  IFS4CLR = _IFS4_USBDMAIF_MASK;
+#endif
 
   if (csr2_bits.SOFIF && csr2_bits.SOFIE)
   {
@@ -715,6 +896,9 @@ void dcd_int_handler(uint8_t rhport)
   }
   if (csr2_bits.RESETIF)
   {
+#if CFG_TUD_PIC32MZ_DMA
+    dma_reset_all();
+#endif
     dcd_edpt_open(0, &ep0OUT_desc);
     dcd_edpt_open(0, &ep0IN_desc);
     dcd_event_bus_reset(0, USB_REGS->POWERbits.HSMODE ? TUSB_SPEED_HIGH : TUSB_SPEED_FULL, true);
@@ -727,6 +911,15 @@ void dcd_int_handler(uint8_t rhport)
   {
     dcd_event_bus_signal(0, DCD_EVENT_RESUME, true);
   }
+#if CFG_TUD_PIC32MZ_DMA
+  for (i = 1; i < EP_MAX && i <= (int) TU_ARRAY_SIZE(USB_REGS->DMA_CHANNEL); ++i)
+  {
+    if (dmaints & (1u << (i - 1)))
+    {
+      dma_handle_int(i);
+    }
+  }
+#endif
   // INTRTX has bit for EP0
   if (txints & 1)
   {
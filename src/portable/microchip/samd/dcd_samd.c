@@ -257,15 +257,36 @@ bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * desc_edpt)
 
 void dcd_edpt_close (uint8_t rhport, uint8_t ep_addr) {
   (void) rhport;
-  (void) ep_addr;
 
-  // TODO: implement if necessary?
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  UsbDeviceEndpoint* ep = &USB->DEVICE.DeviceEndpoint[epnum];
+
+  // Disabling the bank type aborts any pending transfer on it
+  if (tu_edpt_dir(ep_addr) == TUSB_DIR_OUT) {
+    ep->EPINTENCLR.reg = USB_DEVICE_EPINTENCLR_TRCPT0 | USB_DEVICE_EPINTENCLR_TRFAIL0;
+    ep->EPCFG.bit.EPTYPE0 = 0;
+    ep->EPSTATUSCLR.reg = USB_DEVICE_EPSTATUSCLR_BK0RDY;
+    ep->EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_TRCPT0 | USB_DEVICE_EPINTFLAG_TRFAIL0;
+  } else {
+    ep->EPINTENCLR.reg = USB_DEVICE_EPINTENCLR_TRCPT1 | USB_DEVICE_EPINTENCLR_TRFAIL1;
+    ep->EPCFG.bit.EPTYPE1 = 0;
+    ep->EPSTATUSCLR.reg = USB_DEVICE_EPSTATUSCLR_BK1RDY;
+    ep->EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_TRCPT1 | USB_DEVICE_EPINTFLAG_TRFAIL1;
+  }
 }
 
 void dcd_edpt_close_all (uint8_t rhport)
 {
   (void) rhport;
-  // TODO implement dcd_edpt_close_all()
+
+  // Disable all non-control endpoints, used by usbd when switching configuration
+  for (uint8_t epnum = 1; epnum < USB_EPT_NUM; epnum++) {
+    UsbDeviceEndpoint* ep = &USB->DEVICE.DeviceEndpoint[epnum];
+    ep->EPINTENCLR.reg = USB_DEVICE_EPINTENCLR_MASK;
+    ep->EPCFG.reg = 0;
+    ep->EPSTATUSCLR.reg = USB_DEVICE_EPSTATUSCLR_BK0RDY | USB_DEVICE_EPSTATUSCLR_BK1RDY;
+    ep->EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_MASK;
+  }
 }
 
 bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes)
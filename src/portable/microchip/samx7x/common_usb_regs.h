@@ -2099,6 +2099,7 @@ typedef struct
 
 // Errata: The DMA feature is not available for Pipe/Endpoint 7
 #define EP_DMA_SUPPORT(epnum) (epnum >= 1 && epnum <= 6)
+#define EP_DMA_CHANNEL_NUM 6
 
 #else // TODO : SAM3U
 
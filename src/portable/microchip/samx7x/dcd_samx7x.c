@@ -63,6 +63,14 @@ typedef struct {
   uint32_t padding;
 } dma_desc_t;
 
+// DMA Channel transfer state, segments are described by dma_desc[channel][]
+typedef struct {
+  uint8_t seg_count;
+  uint8_t seg_index;
+  uint16_t total_len;   // sum of all segments
+  uint16_t done_len;    // bytes of completed segments (OUT only)
+} dma_ctl_t;
+
 // Transfer control context
 typedef struct {
   uint8_t * buffer;
@@ -76,8 +84,11 @@ typedef struct {
 static tusb_speed_t get_speed(void);
 static void dcd_transmit_packet(xfer_ctl_t * xfer, uint8_t ep_ix);
 
+TU_VERIFY_STATIC(CFG_TUD_SAMX7X_DMA_DESC_NUM >= 1, "CFG_TUD_SAMX7X_DMA_DESC_NUM must be at least 1");
+
 // DMA descriptors shouldn't be placed in ITCM !
-CFG_TUD_MEM_SECTION static dma_desc_t dma_desc[6];
+CFG_TUD_MEM_SECTION static dma_desc_t dma_desc[EP_DMA_CHANNEL_NUM][CFG_TUD_SAMX7X_DMA_DESC_NUM];
+static dma_ctl_t dma_ctl[EP_DMA_CHANNEL_NUM];
 
 static xfer_ctl_t xfer_status[EP_MAX];
 
@@ -347,23 +358,55 @@ static void dcd_ep_handler(uint8_t ep_ix)
 
 static void dcd_dma_handler(uint8_t ep_ix)
 {
-  uint32_t status = USB_REG->DEVDMA[ep_ix - 1].DEVDMASTATUS;
+  uint8_t const ch = ep_ix - 1;
+  uint32_t status = USB_REG->DEVDMA[ch].DEVDMASTATUS;
   if (status & DEVDMASTATUS_CHANN_ENB)
   {
     return; // Ignore EOT_STA interrupt
   }
-  // Disable DMA interrupt
-  USB_REG->DEVIDR = DEVIDR_DMA_1 << (ep_ix - 1);
 
-  xfer_ctl_t *xfer = &xfer_status[ep_ix];
-  uint16_t count = xfer->total_len - ((status & DEVDMASTATUS_BUFF_COUNT) >> DEVDMASTATUS_BUFF_COUNT_Pos);
-  if(USB_REG->DEVEPTCFG[ep_ix] & DEVEPTCFG_EPDIR)
+  dma_ctl_t *ctl = &dma_ctl[ch];
+  uint16_t const remaining = (status & DEVDMASTATUS_BUFF_COUNT) >> DEVDMASTATUS_BUFF_COUNT_Pos;
+  uint16_t count;
+  bool const is_in = (USB_REG->DEVEPTCFG[ep_ix] & DEVEPTCFG_EPDIR) != 0;
+
+  if (is_in)
   {
-    dcd_event_xfer_complete(0, 0x80 + ep_ix, count, XFER_RESULT_SUCCESS, true);
+    // IN segments are chained by hardware, interrupt comes from the last one
+    count = ctl->total_len - remaining;
   } else
   {
-    dcd_event_xfer_complete(0, ep_ix, count, XFER_RESULT_SUCCESS, true);
+    dma_desc_t const *desc = &dma_desc[ch][ctl->seg_index];
+    ctl->done_len += ((desc->chnl_ctrl & DEVDMACONTROL_BUFF_LENGTH) >> DEVDMACONTROL_BUFF_LENGTH_Pos) - remaining;
+
+    if (!(status & DEVDMASTATUS_END_TR_ST) && (ctl->seg_index + 1 < ctl->seg_count))
+    {
+      // Segment filled up without short packet, continue with the next one
+      ctl->seg_index++;
+      desc++;
+      USB_REG->DEVDMA[ch].DEVDMAADDRESS = desc->buff_addr;
+      USB_REG->DEVDMA[ch].DEVDMACONTROL = desc->chnl_ctrl;
+      return;
+    }
+    count = ctl->done_len;
   }
+
+  // Disable DMA interrupt
+  USB_REG->DEVIDR = DEVIDR_DMA_1 << ch;
+
+  xfer_ctl_t *xfer = &xfer_status[ep_ix];
+  if (xfer->fifo)
+  {
+    if (is_in)
+    {
+      tu_fifo_advance_read_pointer(xfer->fifo, count);
+    } else
+    {
+      tu_fifo_advance_write_pointer(xfer->fifo, count);
+    }
+  }
+
+  dcd_event_xfer_complete(0, is_in ? (0x80 + ep_ix) : ep_ix, count, XFER_RESULT_SUCCESS, true);
 }
 
 void dcd_int_handler(uint8_t rhport)
@@ -604,6 +647,77 @@ static void dcd_transmit_packet(xfer_ctl_t * xfer, uint8_t ep_ix)
   USB_REG->DEVEPTIER[ep_ix] = DEVEPTIER_TXINES;
 }
 
+// Describe a DMA segment of an endpoint transfer in dma_desc[channel][seg]
+static void dma_seg_set(uint8_t epnum, uint8_t dir, uint8_t seg, void *buffer, uint16_t len, bool last)
+{
+  dma_desc_t *desc = &dma_desc[epnum - 1][seg];
+  uint32_t ctrl = DEVDMACONTROL_CHANN_ENB | ((uint32_t) len << DEVDMACONTROL_BUFF_LENGTH_Pos);
+
+  if (dir == TUSB_DIR_OUT)
+  {
+    // OUT segments are reloaded by dcd_dma_handler() so that a short packet ends the transfer in any of them
+    ctrl |= DEVDMACONTROL_END_TR_IT | DEVDMACONTROL_END_TR_EN | DEVDMACONTROL_END_BUFFIT;
+  } else if (last)
+  {
+    ctrl |= DEVDMACONTROL_END_B_EN | DEVDMACONTROL_END_BUFFIT;
+  } else
+  {
+    // Let the controller load the next descriptor, continuing the same bank
+    ctrl |= DEVDMACONTROL_LDNXT_DSC;
+  }
+
+  // Force the CPU to flush the buffer. We increase the size by 32 because the call aligns the
+  // address to 32-byte boundaries.
+  CleanInValidateCache((uint32_t*) tu_align((uint32_t) buffer, 4), len + 31);
+
+  desc->next_desc = (dir == TUSB_DIR_IN && !last) ? (uint32_t) (desc + 1) : 0;
+  desc->buff_addr = (uint32_t) buffer;
+  desc->chnl_ctrl = ctrl;
+}
+
+// Start DMA transfer of an endpoint with its first seg_count segments
+static bool dma_xfer_start(uint8_t epnum, uint8_t dir, uint8_t seg_count)
+{
+  uint8_t const ch = epnum - 1;
+  dma_desc_t *desc = dma_desc[ch];
+  dma_ctl_t *ctl = &dma_ctl[ch];
+
+  ctl->seg_count = seg_count;
+  ctl->seg_index = 0;
+  ctl->done_len = 0;
+  ctl->total_len = 0;
+  for (uint8_t i = 0; i < seg_count; i++)
+  {
+    ctl->total_len += (desc[i].chnl_ctrl & DEVDMACONTROL_BUFF_LENGTH) >> DEVDMACONTROL_BUFF_LENGTH_Pos;
+  }
+
+  if (dir == TUSB_DIR_IN && seg_count > 1)
+  {
+    // Clean cache of chained DMA descriptors, first one is written to channel registers directly
+    CleanInValidateCache((uint32_t*) &desc[1], (seg_count - 1) * sizeof(dma_desc_t));
+    USB_REG->DEVDMA[ch].DEVDMANXTDSC = desc[0].next_desc;
+  }
+  USB_REG->DEVDMA[ch].DEVDMAADDRESS = desc[0].buff_addr;
+
+  // Disable IRQs to have a short sequence
+  // between read of EOT_STA and DMA enable
+  uint32_t irq_state = __get_PRIMASK();
+  __disable_irq();
+  if (!(USB_REG->DEVDMA[ch].DEVDMASTATUS & DEVDMASTATUS_END_TR_ST))
+  {
+    USB_REG->DEVDMA[ch].DEVDMACONTROL = desc[0].chnl_ctrl;
+    USB_REG->DEVIER = DEVIER_DMA_1 << ch;
+    __set_PRIMASK(irq_state);
+    return true;
+  }
+  __set_PRIMASK(irq_state);
+
+  // Here a ZLP has been received
+  // and the DMA transfer must be not started.
+  // It is the end of transfer
+  return false;
+}
+
 // Submit a transfer, When complete dcd_event_xfer_complete() is invoked to notify the stack
 bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes)
 {
@@ -620,35 +734,8 @@ bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t
 
   if (EP_DMA_SUPPORT(epnum) && total_bytes != 0)
   {
-    // Force the CPU to flush the buffer. We increase the size by 32 because the call aligns the
-    // address to 32-byte boundaries.
-    CleanInValidateCache((uint32_t*) tu_align((uint32_t) buffer, 4), total_bytes + 31);
-    uint32_t udd_dma_ctrl = total_bytes << DEVDMACONTROL_BUFF_LENGTH_Pos;
-    if (dir == TUSB_DIR_OUT)
-    {
-      udd_dma_ctrl |= DEVDMACONTROL_END_TR_IT | DEVDMACONTROL_END_TR_EN;
-    } else {
-      udd_dma_ctrl |= DEVDMACONTROL_END_B_EN;
-    }
-    USB_REG->DEVDMA[epnum - 1].DEVDMAADDRESS = (uint32_t)buffer;
-    udd_dma_ctrl |= DEVDMACONTROL_END_BUFFIT | DEVDMACONTROL_CHANN_ENB;
-    // Disable IRQs to have a short sequence
-    // between read of EOT_STA and DMA enable
-    uint32_t irq_state = __get_PRIMASK();
-    __disable_irq();
-    if (!(USB_REG->DEVDMA[epnum - 1].DEVDMASTATUS & DEVDMASTATUS_END_TR_ST))
-    {
-      USB_REG->DEVDMA[epnum - 1].DEVDMACONTROL = udd_dma_ctrl;
-      USB_REG->DEVIER = DEVIER_DMA_1 << (epnum - 1);
-      __set_PRIMASK(irq_state);
-      return true;
-    }
-    __set_PRIMASK(irq_state);
-
-    // Here a ZLP has been received
-    // and the DMA transfer must be not started.
-    // It is the end of transfer
-    return false;
+    dma_seg_set(epnum, dir, 0, buffer, total_bytes, true);
+    return dma_xfer_start(epnum, dir, 1);
   } else
   {
     if (dir == TUSB_DIR_OUT)
@@ -684,61 +771,24 @@ bool dcd_edpt_xfer_fifo (uint8_t rhport, uint8_t ep_addr, tu_fifo_t * ff, uint16
   if (EP_DMA_SUPPORT(epnum) && total_bytes != 0)
   {
     tu_fifo_buffer_info_t info;
-    uint32_t udd_dma_ctrl_lin = DEVDMACONTROL_CHANN_ENB;
-    uint32_t udd_dma_ctrl_wrap = DEVDMACONTROL_CHANN_ENB | DEVDMACONTROL_END_BUFFIT;
     if (dir == TUSB_DIR_OUT)
     {
       tu_fifo_get_write_info(ff, &info);
-      udd_dma_ctrl_lin |= DEVDMACONTROL_END_TR_IT | DEVDMACONTROL_END_TR_EN;
-      udd_dma_ctrl_wrap |= DEVDMACONTROL_END_TR_IT | DEVDMACONTROL_END_TR_EN;
     } else {
       tu_fifo_get_read_info(ff, &info);
-      if(info.len_wrap == 0)
-      {
-        udd_dma_ctrl_lin |= DEVDMACONTROL_END_B_EN;
-      }
-      udd_dma_ctrl_wrap |= DEVDMACONTROL_END_B_EN;
     }
 
-    // Clean invalidate cache of linear part
-    CleanInValidateCache((uint32_t*) tu_align((uint32_t) info.ptr_lin, 4), info.len_lin + 31);
+    // Linear part first, then wrapped part if there are enough descriptors
+    uint16_t const len_lin = tu_min16(info.len_lin, total_bytes);
+    uint16_t const len_wrap = (CFG_TUD_SAMX7X_DMA_DESC_NUM > 1) ? tu_min16(info.len_wrap, total_bytes - len_lin) : 0;
+    TU_VERIFY(len_lin);
 
-    USB_REG->DEVDMA[epnum - 1].DEVDMAADDRESS = (uint32_t)info.ptr_lin;
-    if (info.len_wrap)
+    dma_seg_set(epnum, dir, 0, info.ptr_lin, len_lin, len_wrap == 0);
+    if (len_wrap)
     {
-      // Clean invalidate cache of wrapped part
-      CleanInValidateCache((uint32_t*) tu_align((uint32_t) info.ptr_wrap, 4), info.len_wrap + 31);
-
-      dma_desc[epnum - 1].next_desc = 0;
-      dma_desc[epnum - 1].buff_addr = (uint32_t)info.ptr_wrap;
-      dma_desc[epnum - 1].chnl_ctrl =
-        udd_dma_ctrl_wrap | (info.len_wrap << DEVDMACONTROL_BUFF_LENGTH_Pos);
-      // Clean cache of wrapped DMA descriptor
-      CleanInValidateCache((uint32_t*)&dma_desc[epnum - 1], sizeof(dma_desc_t));
-
-      udd_dma_ctrl_lin |= DEVDMASTATUS_DESC_LDST;
-      USB_REG->DEVDMA[epnum - 1].DEVDMANXTDSC = (uint32_t)&dma_desc[epnum - 1];
-    } else {
-      udd_dma_ctrl_lin |= DEVDMACONTROL_END_BUFFIT;
+      dma_seg_set(epnum, dir, 1, info.ptr_wrap, len_wrap, true);
     }
-    udd_dma_ctrl_lin |= (info.len_lin << DEVDMACONTROL_BUFF_LENGTH_Pos);
-    // Disable IRQs to have a short sequence
-    // between read of EOT_STA and DMA enable
-    uint32_t irq_state = __get_PRIMASK();
-    __disable_irq();
-    if (!(USB_REG->DEVDMA[epnum - 1].DEVDMASTATUS & DEVDMASTATUS_END_TR_ST))
-    {
-      USB_REG->DEVDMA[epnum - 1].DEVDMACONTROL = udd_dma_ctrl_lin;
-      USB_REG->DEVIER = DEVIER_DMA_1 << (epnum - 1);
-      __set_PRIMASK(irq_state);
-      return true;
-    }
-    __set_PRIMASK(irq_state);
-
-    // Here a ZLP has been received
-    // and the DMA transfer must be not started.
-    // It is the end of transfer
-    return false;
+    return dma_xfer_start(epnum, dir, len_wrap ? 2 : 1);
   } else
   {
     if (dir == TUSB_DIR_OUT)
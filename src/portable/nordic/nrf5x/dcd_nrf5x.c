@@ -28,8 +28,6 @@
 
 #if CFG_TUD_ENABLED && CFG_TUSB_MCU == OPT_MCU_NRF5X
 
-#include <stdatomic.h>
-
 // Suppress warning caused by nrfx driver
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -48,10 +46,6 @@
 
 #include "device/dcd.h"
 
-// TODO remove later
-#include "device/usbd.h"
-#include "device/usbd_pvt.h" // to use defer function helper
-
 #if CFG_TUSB_OS == OPT_OS_MYNEWT
 #include "mcu/mcu.h"
 #endif
@@ -94,6 +88,18 @@ enum {
   EP_CBI_COUNT = 8  // Control Bulk Interrupt endpoints count
 };
 
+// EasyDMA request, used as bit position in dma_pending bitmap
+// - IN  endpoint n (including ISO): n
+// - OUT endpoint n (including ISO): 16 + n
+enum {
+  DMA_REQ_OUT_OFFSET = 16,
+  DMA_REQ_EP0STATUS  = 30, // TASKS_EP0STATUS
+  DMA_REQ_EP0RCVOUT  = 31, // TASKS_EP0RCVOUT
+
+  // ISO request is serviced first since it must complete within the frame
+  DMA_REQ_ISO_MASK = TU_BIT(EP_ISO_NUM) | TU_BIT(DMA_REQ_OUT_OFFSET + EP_ISO_NUM)
+};
+
 // Transfer Descriptor
 typedef struct {
   uint8_t* buffer;
@@ -118,8 +124,10 @@ static struct {
   // +1 for ISO endpoints
   xfer_td_t xfer[EP_CBI_COUNT + 1][2];
 
-  // nRF can only carry one DMA at a time, this is used to guard the access to EasyDMA
-  atomic_flag dma_running;
+  // nRF can only carry one DMA at a time: requests of other endpoints are queued in dma_pending bitmap
+  // and serviced when ENDED event of the running one occurs.
+  volatile uint32_t dma_pending;
+  volatile bool dma_running;
 
   // Track whether sof has been manually enabled
   bool sof_enabled;
@@ -134,43 +142,18 @@ TU_ATTR_ALWAYS_INLINE static inline bool is_in_isr(void) {
   return (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) ? true : false;
 }
 
-// helper to start DMA
-static void start_dma(volatile uint32_t* reg_startep) {
-  (*reg_startep) = 1;
-  __ISB();
-  __DSB();
-
-  // TASKS_EP0STATUS, TASKS_EP0RCVOUT seem to need EasyDMA to be available
-  // However these don't trigger any DMA transfer and got ENDED event subsequently
-  // Therefore dma_pending is corrected right away
-  if ((reg_startep == &NRF_USBD->TASKS_EP0STATUS) || (reg_startep == &NRF_USBD->TASKS_EP0RCVOUT)) {
-    atomic_flag_clear(&_dcd.dma_running);
-  }
-}
-
-static void edpt_dma_start(volatile uint32_t* reg_startep) {
-  if (atomic_flag_test_and_set(&_dcd.dma_running)) {
-    usbd_defer_func((osal_task_func_t)(uintptr_t ) edpt_dma_start, (void*) (uintptr_t) reg_startep, is_in_isr());
-  } else {
-    start_dma(reg_startep);
-  }
-}
-
-// DMA is complete
-static void edpt_dma_end(void) {
-  atomic_flag_clear(&_dcd.dma_running);
-}
-
 // helper getting td
 static inline xfer_td_t* get_td(uint8_t epnum, uint8_t dir) {
   return &_dcd.xfer[epnum][dir];
 }
 
-static void xact_out_dma(uint8_t epnum);
+// helper to start DMA
+static void start_dma(volatile uint32_t* reg_startep) {
+  _dcd.dma_running = true;
 
-// Function wraps xact_out_dma which wants uint8_t while usbd_defer_func wants void (*)(void *)
-static void xact_out_dma_wrapper(void* epnum) {
-  xact_out_dma((uint8_t) ((uintptr_t) epnum));
+  (*reg_startep) = 1;
+  __ISB();
+  __DSB();
 }
 
 // Start DMA to move data from Endpoint -> RAM
@@ -178,29 +161,19 @@ static void xact_out_dma(uint8_t epnum) {
   xfer_td_t* xfer = get_td(epnum, TUSB_DIR_OUT);
   uint32_t xact_len;
 
-  // DMA can't be active during read of SIZE.EPOUT or SIZE.ISOOUT, so try to lock,
-  // If already running defer call regardless if it was called from ISR or task,
-  if (atomic_flag_test_and_set(&_dcd.dma_running)) {
-    usbd_defer_func((osal_task_func_t) xact_out_dma_wrapper, (void*) (uint32_t) epnum, is_in_isr());
-    return;
-  }
+  // DMA can't be active during read of SIZE.EPOUT or SIZE.ISOOUT, this is guaranteed by DMA queue
   if (epnum == EP_ISO_NUM) {
     xact_len = NRF_USBD->SIZE.ISOOUT;
     // If ZERO bit is set, ignore ISOOUT length
-    if (xact_len & USBD_SIZE_ISOOUT_ZERO_Msk) {
-      xact_len = 0;
-      atomic_flag_clear(&_dcd.dma_running);
-    } else {
-      if (xfer->started) {
-        // Trigger DMA move data from Endpoint -> SRAM
-        NRF_USBD->ISOOUT.PTR = (uint32_t) xfer->buffer;
-        NRF_USBD->ISOOUT.MAXCNT = xact_len;
-
-        start_dma(&NRF_USBD->TASKS_STARTISOOUT);
-      } else {
-        atomic_flag_clear(&_dcd.dma_running);
-      }
+    if ((xact_len & USBD_SIZE_ISOOUT_ZERO_Msk) || !xfer->started) {
+      return;
     }
+
+    // Trigger DMA move data from Endpoint -> SRAM
+    NRF_USBD->ISOOUT.PTR = (uint32_t) xfer->buffer;
+    NRF_USBD->ISOOUT.MAXCNT = xact_len;
+
+    start_dma(&NRF_USBD->TASKS_STARTISOOUT);
   } else {
     // limit xact len to remaining length
     xact_len = tu_min16((uint16_t) NRF_USBD->SIZE.EPOUT[epnum], xfer->total_len - xfer->actual_len);
@@ -213,8 +186,7 @@ static void xact_out_dma(uint8_t epnum) {
   }
 }
 
-// Prepare for a CBI transaction IN, call at the start
-// it start DMA to transfer data from RAM -> Endpoint
+// Start DMA to move data from RAM -> Endpoint
 static void xact_in_dma(uint8_t epnum) {
   xfer_td_t* xfer = get_td(epnum, TUSB_DIR_IN);
 
@@ -224,7 +196,49 @@ static void xact_in_dma(uint8_t epnum) {
   NRF_USBD->EPIN[epnum].PTR = (uint32_t) xfer->buffer;
   NRF_USBD->EPIN[epnum].MAXCNT = xact_len;
 
-  edpt_dma_start(&NRF_USBD->TASKS_STARTEPIN[epnum]);
+  start_dma(&NRF_USBD->TASKS_STARTEPIN[epnum]);
+}
+
+// Start queued DMA requests until EasyDMA is busy. Must be called from ISR or with USBD interrupt disabled
+static void dma_service(void) {
+  while (!_dcd.dma_running && _dcd.dma_pending) {
+    uint32_t const pending = _dcd.dma_pending;
+    uint32_t const iso_pending = pending & DMA_REQ_ISO_MASK;
+    uint8_t const req = (uint8_t) __builtin_ctz(iso_pending ? iso_pending : pending);
+    _dcd.dma_pending = pending & ~TU_BIT(req);
+
+    if (req == DMA_REQ_EP0STATUS || req == DMA_REQ_EP0RCVOUT) {
+      // TASKS_EP0STATUS, TASKS_EP0RCVOUT seem to need EasyDMA to be available
+      // However these don't trigger any DMA transfer and got no ENDED event subsequently
+      if (req == DMA_REQ_EP0STATUS) {
+        NRF_USBD->TASKS_EP0STATUS = 1;
+      } else {
+        NRF_USBD->TASKS_EP0RCVOUT = 1;
+      }
+      __ISB();
+      __DSB();
+    } else if (req >= DMA_REQ_OUT_OFFSET) {
+      xact_out_dma(req - DMA_REQ_OUT_OFFSET);
+    } else {
+      xact_in_dma(req);
+    }
+  }
+}
+
+// Queue a DMA request, it is started right away if EasyDMA is available
+static void dma_request(uint8_t req) {
+  // ISR also services the queue: mask it (if not already) while updating from thread context
+  bool const irq_enabled = !is_in_isr() && NVIC_GetEnableIRQ(USBD_IRQn);
+  if (irq_enabled) {
+    NVIC_DisableIRQ(USBD_IRQn);
+  }
+
+  _dcd.dma_pending |= TU_BIT(req);
+  dma_service();
+
+  if (irq_enabled) {
+    NVIC_EnableIRQ(USBD_IRQn);
+  }
 }
 
 //--------------------------------------------------------------------+
@@ -447,12 +461,12 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t to
     dcd_event_xfer_complete(0, ep_addr, 0, XFER_RESULT_SUCCESS, is_in_isr());
 
     // Status Phase also requires EasyDMA has to be available as well !!!!
-    edpt_dma_start(&NRF_USBD->TASKS_EP0STATUS);
+    dma_request(DMA_REQ_EP0STATUS);
   } else if (dir == TUSB_DIR_OUT) {
     xfer->started = true;
     if (epnum == 0) {
       // Accept next Control Out packet. TASKS_EP0RCVOUT also require EasyDMA
-      edpt_dma_start(&NRF_USBD->TASKS_EP0RCVOUT);
+      dma_request(DMA_REQ_EP0RCVOUT);
     } else {
       // started just set, it could start DMA transfer if interrupt was trigger after this line
       // code only needs to start transfer (from Endpoint to RAM) when data_received was set
@@ -465,7 +479,7 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t to
         // Data is already received previously
         // start DMA to copy to SRAM
         xfer->data_received = false;
-        xact_out_dma(epnum);
+        dma_request(DMA_REQ_OUT_OFFSET + epnum);
       } else {
         // nRF auto accept next Bulk/Interrupt OUT packet
         // nothing to do
@@ -473,7 +487,7 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t to
     }
   } else {
     // Start DMA to copy data from RAM -> Endpoint
-    xact_in_dma(epnum);
+    dma_request(epnum);
   }
 
   return true;
@@ -496,7 +510,7 @@ void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr) {
     // There maybe data in endpoint fifo already, we need to pull it out
     if ((dir == TUSB_DIR_OUT) && xfer->data_received) {
       xfer->data_received = false;
-      xact_out_dma(epnum);
+      dma_request(DMA_REQ_OUT_OFFSET + epnum);
     }
   }
 
@@ -601,7 +615,7 @@ void dcd_int_handler(uint8_t rhport) {
       // Transfer from endpoint to RAM only if data is not corrupted
       if ((int_status & USBD_INTEN_USBEVENT_Msk) == 0 ||
           (NRF_USBD->EVENTCAUSE & USBD_EVENTCAUSE_ISOOUTCRC_Msk) == 0) {
-        xact_out_dma(EP_ISO_NUM);
+        dma_request(DMA_REQ_OUT_OFFSET + EP_ISO_NUM);
       }
     }
 
@@ -682,8 +696,8 @@ void dcd_int_handler(uint8_t rhport) {
 
   if (int_status & EDPT_END_ALL_MASK) {
     // DMA complete move data from SRAM <-> Endpoint
-    // Must before endpoint transfer handling
-    edpt_dma_end();
+    // Must before endpoint transfer handling. Next queued request is started at the end of ISR
+    _dcd.dma_running = false;
   }
 
   //--------------------------------------------------------------------+
@@ -734,7 +748,7 @@ void dcd_int_handler(uint8_t rhport) {
       if ((epnum != EP_ISO_NUM) && (xact_len == xfer->mps) && (xfer->actual_len < xfer->total_len)) {
         if (epnum == 0) {
           // Accept next Control Out packet. TASKS_EP0RCVOUT also require EasyDMA
-          edpt_dma_start(&NRF_USBD->TASKS_EP0RCVOUT);
+          _dcd.dma_pending |= TU_BIT(DMA_REQ_EP0RCVOUT);
         } else {
           // nRF auto accept next Bulk/Interrupt OUT packet
           // nothing to do
@@ -776,7 +790,7 @@ void dcd_int_handler(uint8_t rhport) {
 
         if (xfer->actual_len < xfer->total_len) {
           // Start DMA to copy next data packet
-          xact_in_dma(epnum);
+          _dcd.dma_pending |= TU_BIT(epnum);
         } else {
           // CBI IN complete
           dcd_event_xfer_complete(0, epnum | TUSB_DIR_IN_MASK, xfer->actual_len, XFER_RESULT_SUCCESS, true);
@@ -790,7 +804,7 @@ void dcd_int_handler(uint8_t rhport) {
         xfer_td_t* xfer = get_td(epnum, TUSB_DIR_OUT);
 
         if (xfer->started && xfer->actual_len < xfer->total_len) {
-          xact_out_dma(epnum);
+          _dcd.dma_pending |= TU_BIT(DMA_REQ_OUT_OFFSET + epnum);
         } else {
           // Data overflow !!! Nah, nRF will auto accept next Bulk/Interrupt OUT packet
           // Mark this endpoint with data received
@@ -799,6 +813,9 @@ void dcd_int_handler(uint8_t rhport) {
       }
     }
   }
+
+  // Start queued DMA requests (ISO first) now that EasyDMA may have been released
+  dma_service();
 }
 
 //--------------------------------------------------------------------+
@@ -43,9 +43,10 @@
 /*
  * The DMA functionality of the USBD peripheral does not appear to succeed with
  * transfer lengths that are longer (> 64 bytes) and are not a multiple of 4.
- * Keep disabled for now.
+ * When enabled with CFG_TUD_NUC505_DMA, DMA is therefore only used on bulk endpoints
+ * for word-aligned chunks whose length is a multiple of 4; the rest is copied by the CPU.
  */
-#define USE_DMA     0
+#define USE_DMA     CFG_TUD_NUC505_DMA
 
 /* rather important info unfortunately not provided by device include files */
 #define USBD_BUF_SIZE          2048 /* how much USB buffer space there is */
@@ -101,8 +102,11 @@ static struct xfer_ctl_t
   };
   uint16_t max_packet_size;  /* needed since device driver only finds out this at runtime */
   uint16_t total_bytes;      /* quantity needed to pass as argument to dcd_event_xfer_complete() (for IN endpoints) */
+  uint16_t dma_len;          /* length of the queued or ongoing DMA chunk */
   uint8_t ep_addr;
+  bool dma_capable;          /* bulk endpoint, may use DMA */
   bool dma_requested;
+  bool dma_rx_pending;       /* OUT packet was received while dma_requested */
 } xfer_table[PERIPH_MAX_EP];
 
 /* in addition to xfer_table, additional bespoke bookkeeping is maintained for control EP0 IN */
@@ -163,9 +167,32 @@ static USBD_EP_T *ep_entry(uint8_t ep_addr, bool add)
   return NULL;
 }
 
+#if USE_DMA
+static void service_dma(void);
+
+/* see the note on USE_DMA for which chunks the DMA engine can be trusted with */
+static inline bool dma_usable(struct xfer_ctl_t const *xfer, uint16_t len)
+{
+  return xfer->dma_capable && len && !(len & 3) && !(((uintptr_t)xfer->data_ptr) & 3) && (len <= USBD_MAX_DMA_LEN);
+}
+
+/* queue a chunk for the DMA engine, which moves it when it becomes free */
+static void dma_request(struct xfer_ctl_t *xfer, uint16_t len)
+{
+  xfer->dma_len = len;
+  xfer->dma_requested = true;
+  service_dma();
+}
+#endif
+
 /* perform a non-control IN endpoint transfer; this is called by the ISR  */
 static void dcd_userEP_in_xfer(struct xfer_ctl_t *xfer, USBD_EP_T *ep)
 {
+#if USE_DMA
+  /* previous packet is still waiting for (or being moved by) DMA */
+  if (xfer->dma_requested) return;
+#endif
+
   uint16_t const bytes_now = tu_min16(xfer->in_remaining_bytes, xfer->max_packet_size);
 
   /* precompute what amount of data will be left */
@@ -181,6 +208,16 @@ static void dcd_userEP_in_xfer(struct xfer_ctl_t *xfer, USBD_EP_T *ep)
     ep->EPINTEN = USBD_EPINTEN_TXPKIEN_Msk;
   }
 
+#if USE_DMA
+  if (dma_usable(xfer, bytes_now))
+  {
+    /* endpoint interrupts are restored once the DMA has filled the buffer */
+    ep->EPINTEN = 0;
+    dma_request(xfer, bytes_now);
+    return;
+  }
+#endif
+
   /* provided buffers are thankfully 32-bit aligned, allowing most data to be transferred as 32-bit */
 #if 0 // TODO support dcd_edpt_xfer_fifo API
   if (xfer->ff)
@@ -207,6 +244,51 @@ static void dcd_userEP_in_xfer(struct xfer_ctl_t *xfer, USBD_EP_T *ep)
   if (bytes_now != xfer->max_packet_size) ep->EPRSPCTL = USBD_EPRSPCTL_SHORTTXEN_Msk;
 }
 
+/* perform a non-control OUT endpoint transfer of the received packet; this is called by the ISR */
+static void dcd_userEP_out_xfer(struct xfer_ctl_t *xfer, USBD_EP_T *ep)
+{
+#if USE_DMA
+  /* previous packet is still waiting for (or being moved by) DMA, dma_done() comes back for this one */
+  if (xfer->dma_requested)
+  {
+    xfer->dma_rx_pending = true;
+    return;
+  }
+#endif
+
+  uint16_t const available_bytes = ep->EPDATCNT & USBD_EPDATCNT_DATCNT_Msk;
+
+#if USE_DMA
+  uint16_t const len = tu_min16(available_bytes, xfer->total_bytes - xfer->out_bytes_so_far);
+  if (dma_usable(xfer, len))
+  {
+    dma_request(xfer, len);
+    return;
+  }
+#endif
+
+  /* copy the data from the PC to the previously provided buffer */
+#if 0 // TODO support dcd_edpt_xfer_fifo API
+  if (xfer->ff)
+  {
+    tu_fifo_write_n_const_addr_full_words(xfer->ff, (const void *) &ep->EPDAT_BYTE, tu_min16(available_bytes, xfer->total_bytes - xfer->out_bytes_so_far));
+  }
+  else
+#endif
+  {
+    for (int count = 0; (count < available_bytes) && (xfer->out_bytes_so_far < xfer->total_bytes); count++, xfer->out_bytes_so_far++)
+    {
+      *xfer->data_ptr++ = ep->EPDAT_BYTE;
+    }
+  }
+
+  /* when the transfer is finished, alert TinyUSB; otherwise, continue accepting more data */
+  if ( (xfer->total_bytes == xfer->out_bytes_so_far) || (available_bytes < xfer->max_packet_size) )
+  {
+    dcd_event_xfer_complete(0, xfer->ep_addr, xfer->out_bytes_so_far, XFER_RESULT_SUCCESS, true);
+  }
+}
+
 /* called by dcd_init() as well as by the ISR during a USB bus reset */
 static void bus_reset(void)
 {
@@ -214,6 +296,7 @@ static void bus_reset(void)
   {
     USBD->EP[ep_index].EPCFG = 0;
     xfer_table[ep_index].dma_requested = false;
+    xfer_table[ep_index].dma_rx_pending = false;
   }
 
   USBD->DMACNT = 0;
@@ -243,30 +326,66 @@ static void service_dma(void)
 
   enum ep_enum ep_index;
   struct xfer_ctl_t *xfer;
-  USBD_EP_T *ep;
 
-  for (ep_index = PERIPH_EPA, xfer = &xfer_table[PERIPH_EPA], ep = &USBD->EP[PERIPH_EPA]; ep_index < PERIPH_MAX_EP; ep_index++, xfer++, ep++)
+  for (ep_index = PERIPH_EPA, xfer = &xfer_table[PERIPH_EPA]; ep_index < PERIPH_MAX_EP; ep_index++, xfer++)
   {
-    uint16_t const available_bytes = ep->EPDATCNT & USBD_EPDATCNT_DATCNT_Msk;
-
-    if (!xfer->dma_requested || !available_bytes)
+    if (!xfer->dma_requested)
       continue;
 
     /*
-    instruct DMA to copy the data from the PC to the previously provided buffer
+    instruct DMA to copy the chunk between the USB buffer and the previously provided buffer (DMARD: memory to USB for IN)
     when the bus interrupt DMADONEIEN subsequently fires, the transfer will have finished
     */
-    USBD->DMACTL = xfer->ep_addr & USBD_DMACTL_EPNUM_Msk;
+    uint32_t dmactl = xfer->ep_addr & USBD_DMACTL_EPNUM_Msk;
+    if (xfer->ep_addr & TUSB_DIR_IN_MASK) dmactl |= USBD_DMACTL_DMARD_Msk;
+
+    USBD->DMACTL = dmactl;
     USBD->DMAADDR = (uint32_t)xfer->data_ptr;
-    USBD->DMACNT = available_bytes;
+    USBD->DMACNT = xfer->dma_len;
     USBD->BUSINTSTS = USBD_BUSINTSTS_DMADONEIF_Msk;
-    xfer->out_bytes_so_far += available_bytes;
     current_dma_xfer = xfer;
     USBD->DMACTL |= USBD_DMACTL_DMAEN_Msk;
 
     return;
   }
 }
+
+/* this must only be called by the ISR when the DMA of current_dma_xfer is done */
+static void dma_done(void)
+{
+  struct xfer_ctl_t *xfer = (struct xfer_ctl_t *) current_dma_xfer;
+  USBD_EP_T *ep = &USBD->EP[xfer - xfer_table];
+  uint16_t const len = xfer->dma_len;
+
+  current_dma_xfer = NULL;
+  xfer->dma_requested = false;
+  xfer->data_ptr += len;
+
+  if (xfer->ep_addr & TUSB_DIR_IN_MASK)
+  {
+    /* for short packets, we must nudge the peripheral to say 'that's all folks' */
+    if (len != xfer->max_packet_size) ep->EPRSPCTL = USBD_EPRSPCTL_SHORTTXEN_Msk;
+    ep->EPINTEN = xfer->in_remaining_bytes ? USBD_EPINTEN_BUFEMPTYIEN_Msk : USBD_EPINTEN_TXPKIEN_Msk;
+  }
+  else
+  {
+    xfer->out_bytes_so_far += len;
+
+    /* if the most recent DMA finishes the transfer, alert TinyUSB; otherwise, wait for the next packet */
+    if ( (xfer->total_bytes == xfer->out_bytes_so_far) || (len < xfer->max_packet_size) )
+    {
+      dcd_event_xfer_complete(0, xfer->ep_addr, xfer->out_bytes_so_far, XFER_RESULT_SUCCESS, true);
+    }
+    else if (xfer->dma_rx_pending)
+    {
+      /* next packet was received while the DMA was running */
+      xfer->dma_rx_pending = false;
+      dcd_userEP_out_xfer(xfer, ep);
+    }
+  }
+
+  service_dma();
+}
 #endif
 
 /* centralized location for USBD interrupt enable bit masks */
@@ -353,6 +472,9 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc)
   /* make a note of the endpoint particulars */
   xfer->max_packet_size = size;
   xfer->ep_addr = p_endpoint_desc->bEndpointAddress;
+  xfer->dma_capable = (TUSB_XFER_BULK == type);
+  xfer->dma_requested = false;
+  xfer->dma_rx_pending = false;
 
   return true;
 }
@@ -416,6 +538,7 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t to
     else
     {
       xfer->out_bytes_so_far = 0;
+      xfer->dma_rx_pending = false;
       ep->EPINTEN = USBD_EPINTEN_RXPKIEN_Msk;
     }
   }
@@ -534,18 +657,7 @@ void dcd_int_handler(uint8_t rhport)
 #if USE_DMA
       if (current_dma_xfer)
       {
-        current_dma_xfer->dma_requested = false;
-
-        uint16_t available_bytes = USBD->DMACNT & USBD_DMACNT_DMACNT_Msk;
-
-        /* if the most recent DMA finishes the transfer, alert TinyUSB; otherwise, the next RXPKIF/INTKIF endpoint interrupt will prompt the next DMA */
-        if ( (current_dma_xfer->total_bytes == current_dma_xfer->out_bytes_so_far) || (available_bytes < current_dma_xfer->max_packet_size) )
-        {
-          dcd_event_xfer_complete(0, current_dma_xfer->ep_addr, current_dma_xfer->out_bytes_so_far, XFER_RESULT_SUCCESS, true);
-        }
-
-        current_dma_xfer = NULL;
-        service_dma();
+        dma_done();
       }
 #endif
     }
@@ -664,33 +776,7 @@ void dcd_int_handler(uint8_t rhport)
 
         if (out_ep)
         {
-#if USE_DMA
-          xfer->dma_requested = true;
-          service_dma();
-#else
-          uint16_t const available_bytes = ep->EPDATCNT & USBD_EPDATCNT_DATCNT_Msk;
-          /* copy the data from the PC to the previously provided buffer */
-#if 0 // TODO support dcd_edpt_xfer_fifo API
-          if (xfer->ff)
-          {
-            tu_fifo_write_n_const_addr_full_words(xfer->ff, (const void *) &ep->EPDAT_BYTE, tu_min16(available_bytes, xfer->total_bytes - xfer->out_bytes_so_far));
-          }
-          else
-#endif
-          {
-            for (int count = 0; (count < available_bytes) && (xfer->out_bytes_so_far < xfer->total_bytes); count++, xfer->out_bytes_so_far++)
-            {
-              *xfer->data_ptr++ = ep->EPDAT_BYTE;
-            }
-          }
-
-          /* when the transfer is finished, alert TinyUSB; otherwise, continue accepting more data */
-          if ( (xfer->total_bytes == xfer->out_bytes_so_far) || (available_bytes < xfer->max_packet_size) )
-          {
-            dcd_event_xfer_complete(0, ep_addr, xfer->out_bytes_so_far, XFER_RESULT_SUCCESS, true);
-          }
-#endif
-
+          dcd_userEP_out_xfer(xfer, ep);
         }
         else if (ep_state & USBD_EPINTSTS_BUFEMPTYIF_Msk)
         {
@@ -190,6 +190,16 @@ static void process_tokdne(uint8_t rhport)
     }
     return;
   }
+  if (0 == dir) {
+    /* A short packet ended the OUT transfer while the other BD is still armed for the
+     * packet after it. Take it back so that the next transfer can start on that BD
+     * (ep->odd) with the correct data toggle, instead of receiving into the old buffer. */
+    buffer_descriptor_t *next = odd ? bd - 1: bd + 1;
+    if (next->own) {
+      next->own = 0;
+      __DSB();
+    }
+  }
   const unsigned length = ep->length;
   dcd_event_xfer_complete(rhport,
                           tu_edpt_addr(epnum, dir),
@@ -189,16 +189,14 @@ static int prepare_packets(int pipenum)
   return num_tokens;
 }
 
+/* Round-robin: pick the first pipe after pipenum that has a transfer in progress and
+ * has not been NAKed in this frame, wrapping around to the lowest one. */
 static int select_next_pipenum(int pipenum)
 {
-  unsigned wip  = _hcd.in_progress & ~_hcd.pending;
+  unsigned const wip = _hcd.in_progress & ~_hcd.pending;
   if (!wip) return -1;
-  unsigned msk  = TU_GENMASK(31, pipenum);
-  int      next = __builtin_ctz(wip & msk);
-  if (next) return next;
-  msk  = TU_GENMASK(pipenum, 0);
-  next = __builtin_ctz(wip & msk);
-  return next;
+  unsigned const after = (pipenum < 31) ? (wip & TU_GENMASK(31, pipenum + 1)) : 0;
+  return __builtin_ctz(after ? after : wip);
 }
 
 /* When transfer is completed, return true. */
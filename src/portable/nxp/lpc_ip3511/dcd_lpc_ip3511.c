@@ -82,12 +82,15 @@ typedef struct {
   __I  uint32_t EPTOGGLE;      // Endpoint toggle register, offset: 0x34
 } dcd_registers_t;
 
-// Max nbytes for each control/bulk/interrupt transfer
+// Max nbytes for each command/status entry. Control/bulk/interrupt endpoint can burst multiple packets with one
+// entry, limited by nbytes field (10-bit for FS, 15-bit for HS layout). A burst which does not complete the transfer
+// must be multiple of max packet size (64 FS, 512 HS) to avoid short packet in the middle of transfer, and multiple
+// of 64 since buffer offset is in unit of 64 bytes and advanced by hardware for the next entry.
 enum {
-  NBYTES_ISO_FS_MAX = 1023, // FS ISO
-  NBYTES_ISO_HS_MAX = 1024, // HS ISO
-  NBYTES_CBI_FS_MAX = 64,   // FS control/bulk/interrupt. TODO some FS can do burst with higher size e.g 1024. Need to test
-  NBYTES_CBI_HS_MAX = 32767 // can be up to all 15-bit, but only tested with 4096
+  NBYTES_ISO_FS_MAX = 1023,  // FS ISO
+  NBYTES_ISO_HS_MAX = 1024,  // HS ISO
+  NBYTES_CBI_FS_MAX = 960,   // FS control/bulk/interrupt: 1023 rounded down to multiple of 64
+  NBYTES_CBI_HS_MAX = 32256  // HS control/bulk/interrupt: 32767 rounded down to multiple of 512
 };
 
 enum {
@@ -130,8 +133,7 @@ enum {
 typedef union TU_ATTR_PACKED
 {
   // Full and High speed has different bit layout for buffer_offset and nbytes
-  // TODO FS/HS layout depends on the max speed of controller e.g
-  // lpc55s69 PORT0 is only FS but actually has the same layout as HS on port1
+  // Layout depends on the max speed of controller (not the negotiated link speed), selected by is_highspeed
 
   // Buffer (aligned 64) = DATABUFSTART [31:22]  | buffer_offset [21:6]
   volatile struct {
@@ -172,10 +174,18 @@ typedef struct
   uint16_t TU_RESERVED;
 }xfer_dma_t;
 
+#if defined(FSL_FEATURE_SOC_USBHSD_COUNT) && FSL_FEATURE_SOC_USBHSD_COUNT
+  #define IP3511_HAS_HIGHSPEED
+#endif
+
 // Absolute max of endpoints pairs for all port
 // - 11 13 15 51 54 has 5x2 endpoints
 // - 55 usb0 (FS) has 5x2 endpoints, usb1 (HS) has 6x2 endpoints
-#define MAX_EP_PAIRS  6
+#ifdef IP3511_HAS_HIGHSPEED
+  #define MAX_EP_PAIRS  6
+#else
+  #define MAX_EP_PAIRS  5
+#endif
 
 // NOTE data will be transferred as soon as dcd get request by dcd_pipe(_queue)_xfer using double buffering.
 // current_td is used to keep track of number of remaining & xferred bytes of the current request.
@@ -187,6 +197,10 @@ typedef struct
   xfer_dma_t dma[2*MAX_EP_PAIRS];
 
   TU_ATTR_ALIGNED(64) uint8_t setup_packet[8];
+
+  // Dummy buffer to fix ZLPs overwriting the buffer (probably an USB/DMA controller bug).
+  // Placed within the same section as EP list so that it is always addressable from DATABUFSTART.
+  TU_ATTR_ALIGNED(64) uint8_t dummy[8];
 }dcd_data_t;
 
 // EP list must be 256-byte aligned
@@ -195,10 +209,6 @@ typedef struct
 //    Use CFG_TUD_MEM_SECTION to place it accordingly.
 CFG_TUD_MEM_SECTION TU_ATTR_ALIGNED(256) static dcd_data_t _dcd;
 
-// Dummy buffer to fix ZLPs overwriting the buffer (probably an USB/DMA controller bug)
-// TODO find way to save memory
-CFG_TUD_MEM_SECTION TU_ATTR_ALIGNED(64) static uint8_t dummy[8];
-
 //--------------------------------------------------------------------+
 // Multiple Controllers
 //--------------------------------------------------------------------+
@@ -228,10 +238,6 @@ static const dcd_controller_t _dcd_controller[] = {
 
 #endif
 
-#if defined(FSL_FEATURE_SOC_USBHSD_COUNT) && FSL_FEATURE_SOC_USBHSD_COUNT
-  #define IP3511_HAS_HIGHSPEED
-#endif
-
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
 //--------------------------------------------------------------------+
@@ -470,7 +476,7 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t to
   if (!buffer || total_bytes == 0) {
     // Although having no data, ZLPs can cause buffer overwritten to zeroes. Probably due to USB/DMA controller side
     // effect/bug. Assigned buffer offset to (valid) dummy to prevent overwriting to DATABUFSTART
-    buffer = (uint8_t *) (uint32_t) dummy;
+    buffer = _dcd.dummy;
   }
 
   tu_memclr(&_dcd.dma[ep_id], sizeof(xfer_dma_t));
@@ -142,6 +142,17 @@ enum {
   PID_FROM_TD = 0,
 };
 
+enum {
+  GTD_XFER_MAX = 8192, // a general TD can span 2 consecutive 4KB pages
+  ITD_PKT_MAX  = 8,    // frame_count is 3 bits
+  ITD_PSW_SIZE_MASK = 0x07FF,
+};
+
+enum {
+  OHCI_ISO_SCHEDULE_LEAD = 2,  // number of frames ahead of current frame to start a new isochronous stream
+  OHCI_ISO_SCHEDULE_MAX  = 64, // stream is restarted if it is scheduled too far from current frame
+};
+
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
 //--------------------------------------------------------------------+
@@ -152,12 +163,13 @@ static ohci_ed_t * const p_ed_head[] =
     [TUSB_XFER_CONTROL]     = &ohci_data.control[0].ed,
     [TUSB_XFER_BULK   ]     = &ohci_data.bulk_head_ed,
     [TUSB_XFER_INTERRUPT]   = &ohci_data.period_head_ed,
-    [TUSB_XFER_ISOCHRONOUS] = NULL // TODO Isochronous
+    [TUSB_XFER_ISOCHRONOUS] = &ohci_data.period_head_ed // isochronous EDs are placed after all interrupt EDs
 };
 
 static void ed_list_insert(ohci_ed_t * p_pre, ohci_ed_t * p_ed);
 static void ed_list_remove_by_addr(ohci_ed_t * p_head, uint8_t dev_addr);
 static gtd_extra_data_t *gtd_get_extra_data(ohci_gtd_t const * const gtd);
+static void td_list_free(ohci_td_item_t* td);
 
 //--------------------------------------------------------------------+
 // USBH-HCD API
@@ -231,7 +243,8 @@ bool hcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
       OHCI_INT_MASTER_ENABLE_MASK;
 
   OHCI_REG->control = OHCI_CONTROL_CONTROL_BULK_RATIO | OHCI_CONTROL_LIST_CONTROL_ENABLE_MASK |
-       OHCI_CONTROL_LIST_BULK_ENABLE_MASK | OHCI_CONTROL_LIST_PERIODIC_ENABLE_MASK; // TODO Isochronous
+       OHCI_CONTROL_LIST_BULK_ENABLE_MASK | OHCI_CONTROL_LIST_PERIODIC_ENABLE_MASK |
+       (ITD_MAX ? OHCI_CONTROL_LIST_ISOCHRONOUS_ENABLE_MASK : 0);
 
   OHCI_REG->frame_interval = (OHCI_FMINTERVAL_FSMPS << 16) | OHCI_FMINTERVAL_FI;
   OHCI_REG->frame_interval ^= (1 << 31); //Must toggle when frame_interval is updated.
@@ -297,10 +310,8 @@ void hcd_device_close(uint8_t rhport, uint8_t dev_addr)
     // remove bulk
     ed_list_remove_by_addr(p_ed_head[TUSB_XFER_BULK], dev_addr);
 
-    // remove interrupt
+    // remove interrupt and isochronous, both are on periodic list
     ed_list_remove_by_addr(p_ed_head[TUSB_XFER_INTERRUPT], dev_addr);
-
-    // TODO remove ISO
   }
 }
 
@@ -416,6 +427,15 @@ static void ed_list_remove_by_addr(ohci_ed_t * p_head, uint8_t dev_addr)
 
       // point the removed ED's next pointer to list head to make sure HC can always safely move away from this ED
       ed->next = (uint32_t) _phys_addr(p_head);
+
+      // release TDs still queued on this ED
+      uint32_t const td_head = tu_align16(ed->td_head.address);
+      if (td_head) {
+        td_list_free((ohci_td_item_t*) _virt_addr((void *) td_head));
+      }
+      ed->td_head.address = 0;
+      ed->td_tail = 0;
+
       ed->used = 0;
       ed->skip = 0;
     }else
@@ -435,19 +455,171 @@ static ohci_gtd_t * gtd_find_free(void)
   return NULL;
 }
 
-static void td_insert_to_ed(ohci_ed_t* p_ed, ohci_gtd_t * p_gtd)
+#if ITD_MAX
+TU_ATTR_ALWAYS_INLINE static inline bool td_is_iso(ohci_td_item_t const * const td)
+{
+  return ((uintptr_t) td >= (uintptr_t) ohci_data.itd_pool) && ((uintptr_t) td < (uintptr_t) (ohci_data.itd_pool + ITD_MAX));
+}
+
+static ochi_itd_t * itd_find_free(void)
+{
+  for(uint8_t i=0; i < ITD_MAX; i++)
+  {
+    if ( !ohci_data.itd_pool[i].used ) return &ohci_data.itd_pool[i];
+  }
+
+  return NULL;
+}
+#endif
+
+static void td_free(ohci_td_item_t* td)
+{
+#if ITD_MAX
+  if ( td_is_iso(td) )
+  {
+    ((ochi_itd_t*) td)->used = 0;
+    return;
+  }
+#endif
+  ((ohci_gtd_t*) td)->used = 0;
+}
+
+// free a TD list, next pointer is physical address
+static void td_list_free(ohci_td_item_t* td)
+{
+  while ( td != NULL )
+  {
+    uint32_t const next = td->next;
+    td_free(td);
+    td = next ? (ohci_td_item_t*) _virt_addr((void *) next) : NULL;
+  }
+}
+
+// Append a list of TDs (null terminated, linked with physical address) to ED's queue.
+static void td_insert_to_ed(ohci_ed_t* p_ed, ohci_td_item_t * p_td)
 {
   // tail is always NULL
-  if ( tu_align16(p_ed->td_head.address) == 0 )
-  { // TD queue is empty --> head = TD
-    p_ed->td_head.address |= (uint32_t) _phys_addr(p_gtd);
+  uint32_t const td_head = tu_align16(p_ed->td_head.address);
+  if ( td_head == 0 )
+  { // TD queue is empty --> head = TD, keep halted & toggle carry bits
+    p_ed->td_head.address |= (uint32_t) _phys_addr(p_td);
   }
   else
-  { // TODO currently only support queue up to 2 TD each endpoint at a time
-    ((ohci_gtd_t*) tu_align16((uint32_t)_virt_addr((void *)p_ed->td_head.address)))->next = (uint32_t) _phys_addr(p_gtd);
+  { // walk to the last queued TD
+    ohci_td_item_t* p_last = (ohci_td_item_t*) _virt_addr((void *) td_head);
+    while ( p_last->next ) p_last = (ohci_td_item_t*) _virt_addr((void *) p_last->next);
+    p_last->next = (uint32_t) _phys_addr(p_td);
   }
 }
 
+// Retire remaining TDs of current transfer (up to the one with interrupt on complete) from a halted ED.
+// HC does not process a halted ED, thus its TD queue can be modified safely.
+static void ed_retire_xfer(ohci_ed_t* p_ed)
+{
+  uint32_t td_head = tu_align16(p_ed->td_head.address);
+
+  while ( td_head )
+  {
+    ohci_gtd_t* gtd = (ohci_gtd_t*) _virt_addr((void *) td_head);
+    bool const is_last = (gtd->delay_interrupt == OHCI_INT_ON_COMPLETE_YES);
+
+    td_head = gtd->next;
+    gtd->used = 0;
+
+    if ( is_last ) break;
+  }
+
+  p_ed->td_head.address = (p_ed->td_head.address & 0x0Ful) | td_head;
+}
+
+#if ITD_MAX
+// Queue an isochronous transfer as a chain of iTDs. Each packet occupies one max packet size slot of buffer,
+// each iTD takes up to 8 packets (frames) as long as they are within 2 pages.
+static bool itd_xfer(ohci_ed_t* ed, uint8_t ed_idx, uint8_t * buffer, uint16_t buflen)
+{
+  TU_ASSERT(buflen > 0);
+
+  ed_extra_data_t* ed_extra = &ohci_data.ed_extra[ed_idx];
+  uint16_t const mps = ed->max_packet_size;
+  uint32_t const pkt_count = tu_div_ceil(buflen, mps);
+
+  // continue the stream if possible, otherwise (re)start with the nearest safe frame
+  uint16_t const now = (uint16_t) OHCI_REG->frame_number;
+  uint16_t frame = ed_extra->iso_next_frame;
+  if ( ((int16_t) (frame - now) < OHCI_ISO_SCHEDULE_LEAD) || ((uint16_t) (frame - now) > OHCI_ISO_SCHEDULE_MAX) )
+  {
+    frame = (uint16_t) (now + OHCI_ISO_SCHEDULE_LEAD);
+  }
+
+  ochi_itd_t* first = NULL;
+  ochi_itd_t* last  = NULL;
+  uint32_t pkt = 0;
+
+  while ( pkt < pkt_count )
+  {
+    ochi_itd_t* itd = itd_find_free();
+    if ( itd == NULL )
+    {
+      td_list_free((ohci_td_item_t*) first);
+      TU_LOG1("OHCI: out of isochronous TD\r\n");
+      return false;
+    }
+
+    tu_memclr(itd, sizeof(ochi_itd_t));
+    itd->used = 1;
+
+    uint32_t const page0 = tu_align4k((uint32_t) _phys_addr(buffer + pkt * mps));
+    uint32_t buf_end = 0;
+    uint16_t bytes = 0;
+    uint8_t n = 0;
+
+    do
+    {
+      uint32_t const offset = (pkt + n) * mps;
+      uint16_t const len = (uint16_t) tu_min32(mps, buflen - offset);
+      uint32_t const addr = (uint32_t) _phys_addr(buffer + offset);
+      uint32_t const end = (uint32_t) _phys_addr(buffer + offset + len - 1);
+
+      if ( end - page0 >= GTD_XFER_MAX ) break; // beyond 2 pages
+
+      // Offset: CC (NOT_ACCESSED), page select (bit 12) and offset within page
+      itd->offset_packetstatus[n] = (uint16_t) ((OHCI_CCODE_NOT_ACCESSED << 12) |
+                                                (tu_align4k(addr) != page0 ? TU_BIT(12) : 0) | tu_offset4k(addr));
+      buf_end = end;
+      bytes = (uint16_t) (bytes + len);
+      n++;
+    } while ( (n < ITD_PKT_MAX) && (pkt + n < pkt_count) );
+
+    itd->starting_frame  = frame;
+    itd->frame_count     = (uint8_t) (n - 1);
+    itd->delay_interrupt = (pkt + n < pkt_count) ? OHCI_INT_ON_COMPLETE_NO : OHCI_INT_ON_COMPLETE_YES;
+    itd->condition_code  = OHCI_CCODE_NOT_ACCESSED;
+    itd->buffer_page0    = page0 | ed_idx;
+    itd->buffer_end      = buf_end;
+
+    itd_extra_data_t* itd_extra = &ohci_data.itd_extra[itd - ohci_data.itd_pool];
+    itd_extra->expected_bytes = bytes;
+    itd_extra->first_pkt      = (uint16_t) pkt;
+
+    if ( last ) last->next = (uint32_t) _phys_addr(itd);
+    else first = itd;
+    last = itd;
+
+    frame = (uint16_t) (frame + n);
+    pkt += n;
+  }
+
+  ed_extra->iso_next_frame = frame;
+  ed_extra->iso_buffer     = buffer;
+  ed_extra->iso_failed     = 0;
+  ed_extra->xferred_bytes  = 0;
+
+  td_insert_to_ed(ed, (ohci_td_item_t*) first);
+
+  return true;
+}
+#endif
+
 //--------------------------------------------------------------------+
 // Endpoint API
 //--------------------------------------------------------------------+
@@ -456,8 +628,11 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
 {
   (void) rhport;
 
-  // TODO iso support
-  TU_ASSERT(ep_desc->bmAttributes.xfer != TUSB_XFER_ISOCHRONOUS);
+  if ( ep_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS )
+  {
+    // iTD serves consecutive frames, only interval of 1 frame is supported
+    TU_ASSERT(ITD_MAX && ep_desc->bInterval == 1);
+  }
 
   //------------- Prepare Queue Head -------------//
   ohci_ed_t * p_ed;
@@ -481,7 +656,15 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
     return true;
   }
 
-  ed_list_insert( p_ed_head[ep_desc->bmAttributes.xfer], p_ed );
+  ohci_ed_t * p_pre = p_ed_head[ep_desc->bmAttributes.xfer];
+  if ( ep_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS )
+  {
+    // isochronous EDs must be after all interrupt EDs on periodic list (OHCI 4.2.1)
+    while ( p_pre->next ) p_pre = (ohci_ed_t*) _virt_addr((void *) p_pre->next);
+
+    ohci_data.ed_extra[p_ed - ohci_data.ed_pool] = (ed_extra_data_t) { 0 };
+  }
+  ed_list_insert( p_pre, p_ed );
 
   return true;
 }
@@ -532,17 +715,60 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
   }else
   {
     ohci_ed_t * ed = ed_from_addr(dev_addr, ep_addr);
-    ohci_gtd_t* gtd = gtd_find_free();
+    TU_ASSERT(ed);
 
-    TU_ASSERT(gtd);
+    uint8_t const ed_idx = (uint8_t) (ed - ohci_data.ed_pool);
 
-    gtd_init(gtd, buffer, buflen);
-    gtd->index = ed-ohci_data.ed_pool;
-    gtd->delay_interrupt = OHCI_INT_ON_COMPLETE_YES;
+#if ITD_MAX
+    if ( ed->is_iso ) return itd_xfer(ed, ed_idx, buffer, buflen);
+#endif
+
+    // split transfer into a chain of TDs, each TD covers up to 2 pages. Non-last TDs must be multiple of
+    // packet size, IN non-last TDs do not allow buffer rounding so that short packet halts the ED instead of
+    // continuing to next TD (which is handled in done queue).
+    uint16_t const mps = ed->max_packet_size;
+    ohci_gtd_t* first = NULL;
+    ohci_gtd_t* last  = NULL;
+    uint16_t remain = buflen;
+
+    do
+    {
+      ohci_gtd_t* gtd = gtd_find_free();
+      if ( gtd == NULL )
+      {
+        td_list_free((ohci_td_item_t*) first);
+        TU_LOG1("OHCI: out of general TD\r\n");
+        return false;
+      }
+
+      uint16_t len = (uint16_t) tu_min32(remain, GTD_XFER_MAX - tu_offset4k((uint32_t) _phys_addr(buffer)));
+      if ( len < remain ) len = (uint16_t) (len - (len % mps));
+
+      gtd_init(gtd, buffer, len);
+      gtd->index = ed_idx;
+
+      buffer += len;
+      remain = (uint16_t) (remain - len);
+
+      if ( remain )
+      {
+        if ( dir ) gtd->buffer_rounding = 0;
+      }else
+      {
+        gtd->delay_interrupt = OHCI_INT_ON_COMPLETE_YES;
+      }
 
-    td_insert_to_ed(ed, gtd);
+      if ( last ) last->next = (uint32_t) _phys_addr(gtd);
+      else first = gtd;
+      last = gtd;
+    } while ( remain );
 
-    tusb_xfer_type_t xfer_type = ed_get_xfer_type( ed_from_addr(dev_addr, ep_addr) );
+    // usbh queues at most 1 transfer per endpoint, byte accumulation is per ED
+    ohci_data.ed_extra[ed_idx].xferred_bytes = 0;
+
+    td_insert_to_ed(ed, (ohci_td_item_t*) first);
+
+    tusb_xfer_type_t xfer_type = ed_get_xfer_type(ed);
     if (TUSB_XFER_BULK == xfer_type) OHCI_REG->command_status_bit.bulk_list_filled = 1;
   }
 
@@ -631,6 +857,53 @@ static inline uint32_t gtd_xfer_byte_left(uint32_t buffer_end, uint32_t current_
       tu_offset4k(buffer_end) - tu_offset4k(current_buffer) + 1;
 }
 
+#if ITD_MAX
+// Complete a retired iTD. Received packets can be shorter than max packet size, IN data is compacted in place so
+// that buffer holds contiguous data of xferred bytes. Transfer is reported with the last iTD.
+static void itd_complete_isr(ochi_itd_t* itd)
+{
+  uint8_t const ed_idx = (uint8_t) (itd->buffer_page0 & 0xFFu);
+  ohci_ed_t const * ed = &ohci_data.ed_pool[ed_idx];
+  ed_extra_data_t* ed_extra = &ohci_data.ed_extra[ed_idx];
+  itd_extra_data_t const * itd_extra = &ohci_data.itd_extra[itd - ohci_data.itd_pool];
+  bool const is_in = (ed->pid == PID_IN);
+  uint16_t const mps = ed->max_packet_size;
+
+  for (uint8_t i = 0; i <= itd->frame_count; i++)
+  {
+    uint16_t const psw = itd->offset_packetstatus[i];
+    uint8_t const cc = (uint8_t) (psw >> 12);
+
+    // short IN packet is reported as data underrun, which is not an error
+    if ( !(cc == OHCI_CCODE_NO_ERROR || (is_in && cc == OHCI_CCODE_DATA_UNDERRUN)) )
+    {
+      ed_extra->iso_failed = 1;
+    }
+
+    if ( is_in && cc < OHCI_CCODE_NOT_ACCESSED )
+    {
+      uint16_t const len = psw & ITD_PSW_SIZE_MASK;
+      uint8_t* pkt_buf = ed_extra->iso_buffer + (itd_extra->first_pkt + i) * mps;
+      uint8_t* dst = ed_extra->iso_buffer + ed_extra->xferred_bytes;
+
+      if ( len && (pkt_buf != dst) ) memmove(dst, pkt_buf, len);
+      ed_extra->xferred_bytes = (uint16_t) (ed_extra->xferred_bytes + len);
+    }
+  }
+
+  if ( !is_in ) ed_extra->xferred_bytes = (uint16_t) (ed_extra->xferred_bytes + itd_extra->expected_bytes);
+
+  bool const is_last = (itd->delay_interrupt == OHCI_INT_ON_COMPLETE_YES);
+  itd->used = 0; // free TD
+
+  if ( is_last )
+  {
+    hcd_event_xfer_complete(ed->dev_addr, tu_edpt_addr(ed->ep_number, is_in), ed_extra->xferred_bytes,
+                            ed_extra->iso_failed ? XFER_RESULT_FAILED : XFER_RESULT_SUCCESS, true);
+  }
+}
+#endif
+
 static void done_queue_isr(uint8_t hostid)
 {
   (void) hostid;
@@ -641,37 +914,75 @@ static void done_queue_isr(uint8_t hostid)
 
   while( td_head != NULL )
   {
-    // TODO check if td_head is iso td
+#if ITD_MAX
+    if ( td_is_iso(td_head) )
+    {
+      itd_complete_isr((ochi_itd_t*) td_head);
+      td_head = (ohci_td_item_t*) _virt_addr((void *)td_head->next);
+      continue;
+    }
+#endif
+
     //------------- Non ISO transfer -------------//
     ohci_gtd_t * const qtd = (ohci_gtd_t *) td_head;
-    xfer_result_t const event = (qtd->condition_code == OHCI_CCODE_NO_ERROR) ? XFER_RESULT_SUCCESS :
-                                (qtd->condition_code == OHCI_CCODE_STALL) ? XFER_RESULT_STALLED : XFER_RESULT_FAILED;
+    xfer_result_t event = (qtd->condition_code == OHCI_CCODE_NO_ERROR) ? XFER_RESULT_SUCCESS :
+                          (qtd->condition_code == OHCI_CCODE_STALL) ? XFER_RESULT_STALLED : XFER_RESULT_FAILED;
+    bool const is_last = (qtd->delay_interrupt == OHCI_INT_ON_COMPLETE_YES);
+    ohci_ed_t * const ed = gtd_get_ed(qtd);
+    uint32_t xferred_bytes = gtd_get_extra_data(qtd)->expected_bytes - gtd_xfer_byte_left((uint32_t) qtd->buffer_end, (uint32_t) qtd->current_buffer_pointer);
 
     qtd->used = 0; // free TD
-    if ( (qtd->delay_interrupt == OHCI_INT_ON_COMPLETE_YES) || (event != XFER_RESULT_SUCCESS) )
+
+    if ( !gtd_is_control(qtd) )
     {
-      ohci_ed_t * const ed  = gtd_get_ed(qtd);
-      uint32_t const xferred_bytes = gtd_get_extra_data(qtd)->expected_bytes - gtd_xfer_byte_left((uint32_t) qtd->buffer_end, (uint32_t) qtd->current_buffer_pointer);
-
-      // NOTE Assuming the current list is BULK and there is no other EDs in the list has queued TDs.
-      // When there is a error resulting this ED is halted, and this EP still has other queued TD
-      // --> the Bulk list only has this halted EP queueing TDs (remaining)
-      // --> Bulk list will be considered as not empty by HC !!! while there is no attempt transaction on this list
-      // --> HC will not process Control list (due to service ratio when Bulk list not empty)
-      // To walk-around this, the halted ED will have TailP = HeadP (empty list condition), when clearing halt
-      // the TailP must be set back to NULL for processing remaining TDs
-      if (event != XFER_RESULT_SUCCESS)
+      uint16_t* acc_bytes = &ohci_data.ed_extra[qtd->index].xferred_bytes;
+
+      if ( !is_last )
       {
-        ed->td_tail &= 0x0Ful;
-        ed->td_tail |= tu_align16(ed->td_head.address); // mark halted EP as empty queue
-        if ( event == XFER_RESULT_STALLED ) ed->is_stalled = 1;
+        if ( event == XFER_RESULT_SUCCESS )
+        {
+          // middle of a chained transfer: accumulate and wait for the rest
+          *acc_bytes = (uint16_t) (*acc_bytes + xferred_bytes);
+          td_head = (ohci_td_item_t*) _virt_addr((void *)td_head->next);
+          continue;
+        }
+
+        // transfer ends early, remaining TDs of this transfer will not be processed
+        ed_retire_xfer(ed);
+
+        if ( qtd->condition_code == OHCI_CCODE_DATA_UNDERRUN )
+        {
+          // short packet on IN non-last TD: transfer is complete, resume the ED
+          event = XFER_RESULT_SUCCESS;
+          ed->td_head.halted = 0;
+          if ( tu_align16(ed->td_head.address) && (TUSB_XFER_BULK == ed_get_xfer_type(ed)) )
+          {
+            OHCI_REG->command_status_bit.bulk_list_filled = 1;
+          }
+        }
       }
 
-      uint8_t dir = (ed->ep_number == 0) ? (qtd->pid == PID_IN) : (ed->pid == PID_IN);
+      xferred_bytes += *acc_bytes;
+    }
 
-      hcd_event_xfer_complete(ed->dev_addr, tu_edpt_addr(ed->ep_number, dir), xferred_bytes, event, true);
+    // NOTE Assuming the current list is BULK and there is no other EDs in the list has queued TDs.
+    // When there is a error resulting this ED is halted, and this EP still has other queued TD
+    // --> the Bulk list only has this halted EP queueing TDs (remaining)
+    // --> Bulk list will be considered as not empty by HC !!! while there is no attempt transaction on this list
+    // --> HC will not process Control list (due to service ratio when Bulk list not empty)
+    // To walk-around this, the halted ED will have TailP = HeadP (empty list condition), when clearing halt
+    // the TailP must be set back to NULL for processing remaining TDs
+    if (event != XFER_RESULT_SUCCESS)
+    {
+      ed->td_tail &= 0x0Ful;
+      ed->td_tail |= tu_align16(ed->td_head.address); // mark halted EP as empty queue
+      if ( event == XFER_RESULT_STALLED ) ed->is_stalled = 1;
     }
 
+    uint8_t dir = (ed->ep_number == 0) ? (qtd->pid == PID_IN) : (ed->pid == PID_IN);
+
+    hcd_event_xfer_complete(ed->dev_addr, tu_edpt_addr(ed->ep_number, dir), xferred_bytes, event, true);
+
     td_head = (ohci_td_item_t*) _virt_addr((void *)td_head->next);
   }
 }
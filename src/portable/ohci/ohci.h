@@ -37,16 +37,27 @@
 #define HOST_HCD_XFER_INTERRUPT // TODO interrupt is used widely, should always be enabled
 #define OHCI_PERIODIC_LIST (defined HOST_HCD_XFER_INTERRUPT || defined HOST_HCD_XFER_ISOCHRONOUS)
 
-// TODO merge OHCI with EHCI
-enum {
-  OHCI_MAX_ITD = 4
-};
-
 #define ED_MAX       (CFG_TUH_DEVICE_MAX*CFG_TUH_ENDPOINT_MAX)
-#define GTD_MAX      ED_MAX
+
+// General TD pool for bulk/interrupt endpoints (control endpoints have their own TD per device). A transfer is
+// split into a chain of TDs of up to 8KB each, queued on the ED at once so that HC can process the whole transfer
+// without CPU intervention. Each element takes 16 bytes, increase it for large (e.g MSC) transfers.
+#ifndef CFG_TUH_OHCI_GTD_MAX
+  #define CFG_TUH_OHCI_GTD_MAX   ED_MAX
+#endif
+
+// Isochronous TD pool, each iTD serves up to 8 consecutive frames of an endpoint. Each element takes 32 bytes,
+// 0 means isochronous is not supported
+#ifndef CFG_TUH_OHCI_ITD_MAX
+  #define CFG_TUH_OHCI_ITD_MAX   0
+#endif
+
+#define GTD_MAX      CFG_TUH_OHCI_GTD_MAX
+#define ITD_MAX      CFG_TUH_OHCI_ITD_MAX
 
 // tinyUSB's OHCI implementation caps number of EDs to 8 bits
 TU_VERIFY_STATIC (ED_MAX <= 256, "Reduce CFG_TUH_DEVICE_MAX or CFG_TUH_ENDPOINT_MAX");
+TU_VERIFY_STATIC (GTD_MAX <= 255 && ITD_MAX <= 255, "TD pool index is 8 bits");
 
 //--------------------------------------------------------------------+
 // OHCI Data Structure
@@ -133,14 +144,15 @@ typedef struct TU_ATTR_ALIGNED(32)
 {
 	/*---------- Word 1 ----------*/
   uint32_t starting_frame          : 16;
-  uint32_t                         : 5; // can be used
+  uint32_t used                    : 1;
+  uint32_t                         : 4; // can be used
   uint32_t delay_interrupt         : 3;
   uint32_t frame_count             : 3;
   uint32_t                         : 1; // can be used
   volatile uint32_t condition_code : 4;
 
 	/*---------- Word 2 ----------*/
-	uint32_t buffer_page0;	// 12 lsb bits can be used
+	uint32_t buffer_page0;	// 12 lsb bits can be used: HCD stores endpoint index in 8 lsb bits
 
 	/*---------- Word 3 ----------*/
 	volatile uint32_t next;
@@ -158,6 +170,20 @@ typedef struct {
   uint16_t expected_bytes; // up to 8192 bytes so max is 13 bits
 } gtd_extra_data_t;
 
+typedef struct {
+  uint16_t expected_bytes; // total bytes of (up to 8) packets
+  uint16_t first_pkt;      // index of the first packet within transfer
+} itd_extra_data_t;
+
+typedef struct {
+  uint16_t xferred_bytes;  // accumulated bytes of completed TDs of current transfer
+#if ITD_MAX
+  uint16_t iso_next_frame; // frame to continue isochronous stream
+  uint8_t  iso_failed;     // any packet of current isochronous transfer failed
+  uint8_t* iso_buffer;
+#endif
+} ed_extra_data_t;
+
 // structure with member alignment required from large to small
 typedef struct TU_ATTR_ALIGNED(256) {
   ohci_hcca_t hcca;
@@ -171,13 +197,19 @@ typedef struct TU_ATTR_ALIGNED(256) {
     ohci_gtd_t gtd;
   } control[CFG_TUH_DEVICE_MAX + CFG_TUH_HUB + 1];
 
-  //  ochi_itd_t itd[OHCI_MAX_ITD]; // itd requires alignment of 32
+#if ITD_MAX
+  ochi_itd_t itd_pool[ITD_MAX]; // itd requires alignment of 32
+#endif
   ohci_ed_t ed_pool[ED_MAX];
   ohci_gtd_t gtd_pool[GTD_MAX];
 
-  // extra data needed by TDs that can't fit in the TD struct
+  // extra data needed by TDs and EDs that can't fit in the struct
   gtd_extra_data_t gtd_extra_control[CFG_TUH_DEVICE_MAX + CFG_TUH_HUB + 1];
   gtd_extra_data_t gtd_extra[GTD_MAX];
+  ed_extra_data_t ed_extra[ED_MAX];
+#if ITD_MAX
+  itd_extra_data_t itd_extra[ITD_MAX];
+#endif
 
   volatile uint16_t frame_number_hi;
 } ohci_data_t;
@@ -164,13 +164,14 @@ static void __no_inline_not_in_flash_func(handle_endpoint_irq)(root_port_t *rpor
   (void) rport;
   const uint32_t ep_all = *ep_reg;
 
-  for ( uint8_t ep_idx = 0; ep_idx < PIO_USB_EP_POOL_CNT; ep_idx++ ) {
-    uint32_t const mask = (1u << ep_idx);
-
-    if ( ep_all & mask ) {
-      endpoint_t * ep = PIO_USB_ENDPOINT(ep_idx);
-      hcd_event_xfer_complete(ep->dev_addr, ep->ep_num, ep->actual_len, result, true);
-    }
+  // only visit endpoints with pending event, this runs in frame interrupt and takes time from bus transactions
+  uint32_t pending = ep_all;
+  while (pending) {
+    uint8_t const ep_idx = (uint8_t) __builtin_ctz(pending);
+    pending &= pending - 1;
+
+    endpoint_t * ep = PIO_USB_ENDPOINT(ep_idx);
+    hcd_event_xfer_complete(ep->dev_addr, ep->ep_num, ep->actual_len, result, true);
   }
 
   // clear all
@@ -46,12 +46,22 @@
 /*------------------------------------------------------------------*/
 /* Low level controller
  *------------------------------------------------------------------*/
-// Init these in dcd_init
-static uint8_t* next_buffer_ptr;
-
 // USB_MAX_ENDPOINTS Endpoints, direction TUSB_DIR_OUT for out and TUSB_DIR_IN for in.
 static struct hw_endpoint hw_endpoints[USB_MAX_ENDPOINTS][2];
 
+// Buffer space of non-control endpoints is allocated in 64-byte blocks: bit set if block is in use and number of
+// blocks owned by each endpoint. Reopened endpoint gives back its blocks first, dcd_edpt_close_all() frees all
+#define DPRAM_BLOCK_SIZE   64u
+#define DPRAM_BLOCK_COUNT  (sizeof(usb_dpram->epx_data) / DPRAM_BLOCK_SIZE)
+TU_VERIFY_STATIC(DPRAM_BLOCK_COUNT <= 64, "dpram block bitmap is too small");
+
+static uint64_t _dpram_used;
+static uint8_t _dpram_blocks[USB_MAX_ENDPOINTS][2];
+
+// static layout of current configuration from dcd_edpt_mem_plan(), offsets are relative to epx_data
+static tu_edpt_mem_t const* _dpram_plan;
+static uint8_t _dpram_plan_count;
+
 // SOF may be used by remote wakeup as RESUME, this indicate whether SOF is actually used by usbd
 static bool _sof_enable = false;
 
@@ -65,22 +75,59 @@ TU_ATTR_ALWAYS_INLINE static inline struct hw_endpoint* hw_endpoint_get_by_addr(
   return hw_endpoint_get_by_num(num, dir);
 }
 
-// Allocate from the USB buffer space (max 3840 bytes)
-static void hw_endpoint_alloc(struct hw_endpoint* ep, size_t size) {
-  // round up size to multiple of 64
-  size = tu_round_up(ep->wMaxPacketSize, 64);
+// Return endpoint buffer blocks to the USB buffer space
+static void hw_endpoint_free(struct hw_endpoint* ep) {
+  uint8_t* blocks = &_dpram_blocks[tu_edpt_number(ep->ep_addr)][tu_edpt_dir(ep->ep_addr)];
+  if (*blocks == 0) {
+    return;
+  }
+
+  uint32_t const first = (uint32_t) (ep->hw_data_buf - usb_dpram->epx_data) / DPRAM_BLOCK_SIZE;
+  _dpram_used &= ~((((uint64_t) 1u << *blocks) - 1u) << first);
+  *blocks = 0;
+  ep->hw_data_buf = NULL;
+}
+
+// First block of endpoint in static layout if it is large enough, DPRAM_BLOCK_COUNT otherwise
+static uint32_t dpram_plan_find(uint8_t ep_addr, uint32_t count) {
+  for (uint8_t i = 0; i < _dpram_plan_count; i++) {
+    tu_edpt_mem_t const* mem = &_dpram_plan[i];
+    if (mem->ep_addr == ep_addr && mem->size >= count * DPRAM_BLOCK_SIZE) {
+      return mem->offset / DPRAM_BLOCK_SIZE;
+    }
+  }
+  return DPRAM_BLOCK_COUNT;
+}
+
+// Allocate from the USB buffer space (max 3712 bytes), at the offset of static layout if any otherwise first fit of
+// contiguous 64-byte blocks
+static bool hw_endpoint_alloc(struct hw_endpoint* ep, uint16_t size) {
+  hw_endpoint_free(ep);
+
+  uint32_t count = tu_div_ceil(size, DPRAM_BLOCK_SIZE);
 
   // double buffered Bulk endpoint
   if (ep->transfer_type == TUSB_XFER_BULK) {
-    size *= 2u;
+    count *= 2u;
+  }
+  TU_ASSERT(count > 0 && count <= DPRAM_BLOCK_COUNT);
+
+  uint64_t const mask = ((uint64_t) 1u << count) - 1u;
+  uint32_t const planned = dpram_plan_find(ep->ep_addr, count);
+  for (uint32_t i = 0; i <= DPRAM_BLOCK_COUNT; i++) {
+    // try planned block first, then first fit
+    uint32_t const first = (i == 0) ? planned : (i - 1);
+    if (first + count <= DPRAM_BLOCK_COUNT && (_dpram_used & (mask << first)) == 0) {
+      _dpram_used |= (mask << first);
+      _dpram_blocks[tu_edpt_number(ep->ep_addr)][tu_edpt_dir(ep->ep_addr)] = (uint8_t) count;
+      ep->hw_data_buf = &usb_dpram->epx_data[first * DPRAM_BLOCK_SIZE];
+      pico_info("  Allocated %lu bytes (0x%p)\r\n", count * DPRAM_BLOCK_SIZE, ep->hw_data_buf);
+      return true;
+    }
   }
 
-  // assign buffer
-  ep->hw_data_buf = next_buffer_ptr;
-  next_buffer_ptr += size;
-
-  hard_assert(next_buffer_ptr < usb_dpram->epx_data + sizeof(usb_dpram->epx_data));
-  pico_info("  Allocated %d bytes (0x%p)\r\n", size,  ep->hw_data_buf);
+  TU_LOG1("DPRAM: no space for %lu bytes\r\n", count * DPRAM_BLOCK_SIZE);
+  return false;
 }
 
 // Enable endpoint
@@ -114,6 +161,8 @@ static void hw_endpoint_init(uint8_t ep_addr, uint16_t wMaxPacketSize, uint8_t t
 
   // Clear existing buffer control state
   *ep->buffer_control = 0;
+  ep->db_armed = 0;
+  ep->db_carry = 0;
 
   if (num == 0) {
     // EP0 has no endpoint control register because the buffer offsets are fixed
@@ -132,20 +181,25 @@ static void hw_endpoint_init(uint8_t ep_addr, uint16_t wMaxPacketSize, uint8_t t
 }
 
 // Init, allocate buffer and enable endpoint
-static void hw_endpoint_open(uint8_t ep_addr, uint16_t wMaxPacketSize, uint8_t transfer_type) {
+static bool hw_endpoint_open(uint8_t ep_addr, uint16_t wMaxPacketSize, uint8_t transfer_type) {
   struct hw_endpoint* ep = hw_endpoint_get_by_addr(ep_addr);
   hw_endpoint_init(ep_addr, wMaxPacketSize, transfer_type);
   const uint8_t num = tu_edpt_number(ep_addr);
   if (num != 0) {
     // EP0 is already enabled
-    hw_endpoint_alloc(ep, ep->wMaxPacketSize);
+    TU_ASSERT(hw_endpoint_alloc(ep, ep->wMaxPacketSize));
     hw_endpoint_enable(ep);
   }
+  return true;
 }
 
 static void hw_endpoint_xfer(uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes) {
   struct hw_endpoint* ep = hw_endpoint_get_by_addr(ep_addr);
-  hw_endpoint_xfer_start(ep, buffer, total_bytes);
+  if (hw_endpoint_xfer_start(ep, buffer, total_bytes)) {
+    // completed by packet received before the transfer was queued (double buffered bulk OUT)
+    dcd_event_xfer_complete(0, ep->ep_addr, ep->xferred_len, XFER_RESULT_SUCCESS, false);
+    hw_endpoint_reset_transfer(ep);
+  }
 }
 
 static void __tusb_irq_path_func(hw_handle_buff_status)(void) {
@@ -210,8 +264,11 @@ static void __tusb_irq_path_func(reset_non_control_endpoints)(void) {
   // clear non-control hw endpoints
   tu_memclr(hw_endpoints[1], sizeof(hw_endpoints) - 2 * sizeof(hw_endpoint_t));
 
-  // reclaim buffer space
-  next_buffer_ptr = &usb_dpram->epx_data[0];
+  // reclaim buffer space, endpoints opened afterward are packed from the start
+  _dpram_used = 0;
+  tu_memclr(_dpram_blocks, sizeof(_dpram_blocks));
+  _dpram_plan = NULL;
+  _dpram_plan_count = 0;
 }
 
 static void __tusb_irq_path_func(dcd_rp2040_irq)(void) {
@@ -478,8 +535,7 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const* desc_edpt) {
   (void) rhport;
   const uint8_t xfer_type = desc_edpt->bmAttributes.xfer;
   TU_VERIFY(xfer_type != TUSB_XFER_ISOCHRONOUS);
-  hw_endpoint_open(desc_edpt->bEndpointAddress, tu_edpt_packet_size(desc_edpt), xfer_type);
-  return true;
+  return hw_endpoint_open(desc_edpt->bEndpointAddress, tu_edpt_packet_size(desc_edpt), xfer_type);
 }
 
 // New API: Allocate packet buffer used by ISO endpoints
@@ -488,8 +544,7 @@ bool dcd_edpt_iso_alloc(uint8_t rhport, uint8_t ep_addr, uint16_t largest_packet
   (void) rhport;
   struct hw_endpoint* ep = hw_endpoint_get_by_addr(ep_addr);
   hw_endpoint_init(ep_addr, largest_packet_size, TUSB_XFER_ISOCHRONOUS);
-  hw_endpoint_alloc(ep, largest_packet_size);
-  return true;
+  return hw_endpoint_alloc(ep, largest_packet_size);
 }
 
 // New API: Configure and enable an ISO endpoint according to descriptor
@@ -512,6 +567,18 @@ void dcd_edpt_close_all(uint8_t rhport) {
   reset_non_control_endpoints();
 }
 
+// Static layout of buffer space, endpoints are allocated at their planned offset when opened
+bool dcd_edpt_mem_plan(uint8_t rhport, tu_edpt_mem_t const* mem, uint8_t count) {
+  (void) rhport;
+  for (uint8_t i = 0; i < count; i++) {
+    TU_VERIFY((mem[i].offset % DPRAM_BLOCK_SIZE) == 0 && mem[i].offset + mem[i].size <= DPRAM_BLOCK_COUNT * DPRAM_BLOCK_SIZE);
+  }
+
+  _dpram_plan = mem;
+  _dpram_plan_count = count;
+  return true;
+}
+
 bool dcd_edpt_xfer(__unused uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes) {
   assert(rhport == 0);
   hw_endpoint_xfer(ep_addr, buffer, total_bytes);
@@ -529,9 +596,10 @@ void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr) {
 
   struct hw_endpoint* ep = hw_endpoint_get_by_addr(ep_addr);
 
-  // stall and clear current pending buffer
+  // stall and clear current pending buffer, including packet received in advance for next transfer
   // may need to use EP_ABORT
   _hw_endpoint_buffer_control_set_value32(ep, USB_BUF_CTRL_STALL);
+  ep->db_carry = 0;
 }
 
 void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr) {
@@ -30,6 +30,7 @@
 #if CFG_TUH_ENABLED && (CFG_TUSB_MCU == OPT_MCU_RP2040) && !CFG_TUH_RPI_PIO_USB && !CFG_TUH_MAX3421
 
 #include "pico.h"
+#include "hardware/sync.h"
 #include "rp2040_usb.h"
 
 //--------------------------------------------------------------------+
@@ -52,10 +53,45 @@
 #endif
 static_assert(PICO_USB_HOST_INTERRUPT_ENDPOINTS <= USB_MAX_ENDPOINTS, "");
 
+// Route bulk endpoints to shared EPX (multiple packets per frame, double buffered OUT) instead of
+// "interrupt" endpoints which are polled by hardware at most once per frame
+#ifndef CFG_TUH_RP2040_EPX_BULK
+#define CFG_TUH_RP2040_EPX_BULK 0
+#endif
+
+// Number of bulk and isochronous endpoints scheduled on EPX
+#ifndef CFG_TUH_RP2040_EPX_ENDPOINTS
+#define CFG_TUH_RP2040_EPX_ENDPOINTS 8
+#endif
+
+// Max bytes a bulk endpoint transfers on EPX per turn before the next pending endpoint is served
+#ifndef CFG_TUH_RP2040_EPX_CHUNK_SIZE
+#define CFG_TUH_RP2040_EPX_CHUNK_SIZE 512
+#endif
+
+// EPX data buffer: up to 1023 bytes ISO packet or 2x64 for double buffered, interrupt endpoints follow
+#define EPX_DATA_SIZE 1024
+
 // Host mode uses one shared endpoint register for non-interrupt endpoint
 static struct hw_endpoint ep_pool[1 + PICO_USB_HOST_INTERRUPT_ENDPOINTS];
 #define epx (ep_pool[0])
 
+// Bulk/ISO endpoints which take turn on EPX with control endpoint (epx)
+static struct hw_endpoint epx_pool[CFG_TUH_RP2040_EPX_ENDPOINTS];
+
+// Endpoint currently using EPX hardware, NULL if idle
+static struct hw_endpoint* epx_owner;
+
+// Index of epx_pool last served for round-robin
+static uint8_t epx_rr;
+
+// values of hw_endpoint.pending for endpoint waiting for EPX
+enum {
+  EPX_PENDING_NONE = 0,
+  EPX_PENDING_XFER,
+  EPX_PENDING_SETUP
+};
+
 // Flags we set by default in sie_ctrl (we add other bits on top)
 enum {
   SIE_CTRL_BASE = USB_SIE_CTRL_SOF_EN_BITS      | USB_SIE_CTRL_KEEP_ALIVE_EN_BITS |
@@ -73,9 +109,26 @@ static struct hw_endpoint *get_dev_ep(uint8_t dev_addr, uint8_t ep_addr)
     if ( ep->configured && (ep->dev_addr == dev_addr) && (ep->ep_addr == ep_addr) ) return ep;
   }
 
+  for ( uint32_t i = 0; i < TU_ARRAY_SIZE(epx_pool); i++ )
+  {
+    struct hw_endpoint *ep = &epx_pool[i];
+    if ( ep->configured && (ep->dev_addr == dev_addr) && (ep->ep_addr == ep_addr) ) return ep;
+  }
+
   return NULL;
 }
 
+// endpoint transfers using EPX hardware
+TU_ATTR_ALWAYS_INLINE static inline bool ep_is_epx(struct hw_endpoint *ep)
+{
+  return ep->buffer_control == &usbh_dpram->epx_buf_ctrl;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline uint16_t frame_number(void)
+{
+  return (uint16_t) (usb_hw->sof_rd & USB_SOF_RD_BITS);
+}
+
 TU_ATTR_ALWAYS_INLINE static inline uint8_t dev_speed(void)
 {
   return (usb_hw->sie_status & USB_SIE_STATUS_SPEED_BITS) >> USB_SIE_STATUS_SPEED_LSB;
@@ -88,19 +141,56 @@ TU_ATTR_ALWAYS_INLINE static inline bool need_pre(uint8_t dev_addr)
   return hcd_port_speed_get(0) != tuh_speed_get(dev_addr);
 }
 
+static void epx_schedule(void);
+
 static void __tusb_irq_path_func(hw_xfer_complete)(struct hw_endpoint *ep, xfer_result_t xfer_result)
 {
   // Mark transfer as done before we tell the tinyusb stack
   uint8_t dev_addr = ep->dev_addr;
   uint8_t ep_addr = ep->ep_addr;
   uint xferred_len = ep->xferred_len;
-  hw_endpoint_reset_transfer(ep);
+
+  if ( ep_is_epx(ep) )
+  {
+    uint8_t* user_buf = ep->user_buf;
+    xferred_len += ep->epx_xferred;
+
+    // turn is done without short packet, wait for next turn to continue the rest
+    bool const more = (xfer_result == XFER_RESULT_SUCCESS) && ep->epx_remaining && (ep->xferred_len == ep->epx_chunk);
+
+    hw_endpoint_reset_transfer(ep);
+    epx_owner = NULL;
+
+    if ( more )
+    {
+      ep->user_buf = user_buf;
+      ep->epx_xferred = (uint16_t) xferred_len;
+      ep->pending = EPX_PENDING_XFER;
+    }
+    else
+    {
+      ep->epx_remaining = 0;
+      ep->epx_xferred = 0;
+    }
+
+    epx_schedule();
+    if ( more ) return;
+  }
+  else
+  {
+    hw_endpoint_reset_transfer(ep);
+  }
+
   hcd_event_xfer_complete(dev_addr, ep_addr, xferred_len, xfer_result, true);
 }
 
 static void __tusb_irq_path_func(_handle_buff_status_bit)(uint bit, struct hw_endpoint *ep)
 {
   usb_hw_clear->buf_status = bit;
+
+  // EPX turn may have been preempted
+  if ( ep == NULL ) return;
+
   // EP may have been stalled?
   assert(ep->active);
   bool done = hw_endpoint_xfer_continue(ep);
@@ -120,9 +210,9 @@ static void __tusb_irq_path_func(hw_handle_buff_status)(void)
   if ( remaining_buffers & bit )
   {
     remaining_buffers &= ~bit;
-    struct hw_endpoint * ep = &epx;
+    struct hw_endpoint * ep = epx_owner;
 
-    uint32_t ep_ctrl = *ep->endpoint_control;
+    uint32_t ep_ctrl = usbh_dpram->epx_ctrl;
     if ( ep_ctrl & EP_CTRL_DOUBLE_BUFFERED_BITS )
     {
       TU_LOG(3, "Double Buffered: ");
@@ -166,7 +256,7 @@ static void __tusb_irq_path_func(hw_handle_buff_status)(void)
 
 static void __tusb_irq_path_func(hw_trans_complete)(void)
 {
-  if (usb_hw->sie_ctrl & USB_SIE_CTRL_SEND_SETUP_BITS)
+  if ((usb_hw->sie_ctrl & USB_SIE_CTRL_SEND_SETUP_BITS) && epx_owner == &epx)
   {
     pico_trace("Sent setup packet\n");
     struct hw_endpoint *ep = &epx;
@@ -182,6 +272,153 @@ static void __tusb_irq_path_func(hw_trans_complete)(void)
   }
 }
 
+//--------------------------------------------------------------------+
+// EPX scheduler
+// Control, bulk (if CFG_TUH_RP2040_EPX_BULK) and isochronous transfers share EPX. Pending control transfer is
+// served first, others are served round-robin: bulk for up to CFG_TUH_RP2040_EPX_CHUNK_SIZE bytes per turn,
+// isochronous for one packet per frame. A bulk turn lasting over a frame boundary (e.g device keeps NAKing)
+// is stopped at SOF when other endpoint is pending, and continues in its next turn.
+//--------------------------------------------------------------------+
+static struct hw_endpoint* __tusb_irq_path_func(epx_next)(void)
+{
+  if ( epx.pending ) return &epx;
+
+  uint16_t const frame = frame_number();
+  for ( uint8_t i = 1; i <= TU_ARRAY_SIZE(epx_pool); i++ )
+  {
+    uint8_t const idx = (uint8_t) ((epx_rr + i) % TU_ARRAY_SIZE(epx_pool));
+    struct hw_endpoint *ep = &epx_pool[idx];
+
+    // isochronous is limited to one packet per frame
+    if ( ep->configured && ep->pending &&
+         !(ep->transfer_type == TUSB_XFER_ISOCHRONOUS && ep->epx_frame == frame) )
+    {
+      epx_rr = idx;
+      return ep;
+    }
+  }
+
+  return NULL;
+}
+
+static void __tusb_irq_path_func(epx_start)(struct hw_endpoint *ep)
+{
+  uint8_t const ep_num = tu_edpt_number(ep->ep_addr);
+  tusb_dir_t const ep_dir = tu_edpt_dir(ep->ep_addr);
+  uint8_t const pending = ep->pending;
+
+  epx_owner = ep;
+  ep->pending = EPX_PENDING_NONE;
+  ep->epx_frame = frame_number();
+
+  // EPX is shared: endpoint control is set per turn
+  usbh_dpram->epx_ctrl = EP_CTRL_ENABLE_BITS | EP_CTRL_INTERRUPT_PER_BUFFER |
+                         ((uint32_t) ep->transfer_type << EP_CTRL_BUFFER_TYPE_LSB) | hw_data_offset(ep->hw_data_buf);
+
+  uint32_t flags = USB_SIE_CTRL_START_TRANS_BITS | SIE_CTRL_BASE |
+                   (need_pre(ep->dev_addr) ? USB_SIE_CTRL_PREAMBLE_EN_BITS : 0);
+
+  if ( pending == EPX_PENDING_SETUP )
+  {
+    ep->remaining_len = 8;
+    ep->active = true;
+
+    usb_hw->dev_addr_ctrl = ep->dev_addr;
+    flags |= USB_SIE_CTRL_SEND_SETUP_BITS;
+  }
+  else
+  {
+    uint16_t chunk = ep->epx_remaining;
+    if ( ep->transfer_type == TUSB_XFER_ISOCHRONOUS )
+    {
+      chunk = tu_min16(chunk, ep->wMaxPacketSize);
+    }
+    else if ( ep->transfer_type == TUSB_XFER_BULK )
+    {
+      chunk = tu_min16(chunk, CFG_TUH_RP2040_EPX_CHUNK_SIZE);
+    }
+    ep->epx_chunk = chunk;
+    ep->epx_remaining = (uint16_t) (ep->epx_remaining - chunk);
+
+    hw_endpoint_xfer_start(ep, ep->user_buf, chunk);
+
+    // That has set up buffer control, endpoint control etc
+    // for host we have to initiate the transfer
+    usb_hw->dev_addr_ctrl = (uint32_t) (ep->dev_addr | (ep_num << USB_ADDR_ENDP_ENDPOINT_LSB));
+    flags |= (ep_dir ? USB_SIE_CTRL_RECEIVE_DATA_BITS : USB_SIE_CTRL_SEND_DATA_BITS);
+  }
+
+  // START_TRANS bit on SIE_CTRL seems to exhibit the same behavior as the AVAILABLE bit
+  // described in RP2040 Datasheet, release 2.1, section "4.1.2.5.1. Concurrent access".
+  // We write everything except the START_TRANS bit first, then wait some cycles.
+  usb_hw->sie_ctrl = flags & ~USB_SIE_CTRL_START_TRANS_BITS;
+  busy_wait_at_least_cycles(12);
+  usb_hw->sie_ctrl = flags;
+}
+
+// start next pending endpoint if EPX is idle
+static void __tusb_irq_path_func(epx_schedule)(void)
+{
+  if ( epx_owner ) return;
+
+  struct hw_endpoint *ep = epx_next();
+  if ( ep ) epx_start(ep);
+}
+
+// stop current turn on EPX
+static void __tusb_irq_path_func(epx_stop)(void)
+{
+  usb_hw_set->sie_ctrl = USB_SIE_CTRL_STOP_TRANS_BITS;
+
+  // let a transaction already on the bus finish: longest full speed bulk packet is about 50 us
+  busy_wait_us_32(60);
+
+  usb_hw_clear->buf_status = 0b1;
+  epx_owner = NULL;
+}
+
+// preempt bulk turn which has lasted over a frame boundary while other endpoint is waiting for EPX
+static void __tusb_irq_path_func(epx_sof)(uint16_t frame)
+{
+  struct hw_endpoint *ep = epx_owner;
+
+  if ( ep && ep->transfer_type == TUSB_XFER_BULK && ep->epx_frame != frame && epx_next() )
+  {
+    epx_stop();
+
+    uint8_t* user_buf;
+    uint16_t xferred;
+    bool const short_packet = hw_endpoint_xfer_rewind(ep);
+
+    user_buf = ep->user_buf;
+    xferred = (uint16_t) (ep->epx_xferred + ep->xferred_len);
+
+    if ( short_packet )
+    {
+      // transfer is actually complete
+      uint8_t const dev_addr = ep->dev_addr;
+      uint8_t const ep_addr = ep->ep_addr;
+      hw_endpoint_reset_transfer(ep);
+      ep->epx_remaining = 0;
+      ep->epx_xferred = 0;
+      hcd_event_xfer_complete(dev_addr, ep_addr, xferred, XFER_RESULT_SUCCESS, true);
+    }
+    else
+    {
+      // give the rest of this turn back, continue in next turn
+      uint16_t const remaining = (uint16_t) (ep->epx_remaining + ep->remaining_len);
+      hw_endpoint_reset_transfer(ep);
+      ep->user_buf = user_buf;
+      ep->epx_remaining = remaining;
+      ep->epx_xferred = xferred;
+      ep->pending = EPX_PENDING_XFER;
+    }
+  }
+
+  // isochronous endpoint may be waiting for new frame
+  epx_schedule();
+}
+
 static void __tusb_irq_path_func(hcd_rp2040_irq)(void)
 {
   uint32_t status = usb_hw->ints;
@@ -204,6 +441,13 @@ static void __tusb_irq_path_func(hcd_rp2040_irq)(void)
     usb_hw_clear->sie_status = USB_SIE_STATUS_SPEED_BITS;
   }
 
+  if ( status & USB_INTS_HOST_SOF_BITS )
+  {
+    handled |= USB_INTS_HOST_SOF_BITS;
+    // reading sof_rd clears the interrupt
+    epx_sof(frame_number());
+  }
+
   if ( status & USB_INTS_STALL_BITS )
   {
     // We have rx'd a stall from the device
@@ -213,7 +457,7 @@ static void __tusb_irq_path_func(hcd_rp2040_irq)(void)
     pico_trace("Stall REC\n");
     handled |= USB_INTS_STALL_BITS;
     usb_hw_clear->sie_status = USB_SIE_STATUS_STALL_REC_BITS;
-    hw_xfer_complete(&epx, XFER_RESULT_STALLED);
+    if ( epx_owner ) hw_xfer_complete(epx_owner, XFER_RESULT_STALLED);
   }
 
   if ( status & USB_INTS_BUFF_STATUS_BITS )
@@ -278,20 +522,37 @@ static struct hw_endpoint *_hw_endpoint_allocate(uint8_t transfer_type)
 {
   struct hw_endpoint * ep = NULL;
 
-  if ( transfer_type != TUSB_XFER_CONTROL )
+  if ( transfer_type == TUSB_XFER_ISOCHRONOUS || (CFG_TUH_RP2040_EPX_BULK && transfer_type == TUSB_XFER_BULK) )
+  {
+    // scheduled on EPX
+    for ( uint i = 0; i < TU_ARRAY_SIZE(epx_pool); i++ )
+    {
+      if ( !epx_pool[i].configured )
+      {
+        ep = &epx_pool[i];
+        ep->buffer_control = &usbh_dpram->epx_buf_ctrl;
+        ep->endpoint_control = &usbh_dpram->epx_ctrl;
+        ep->hw_data_buf = &usbh_dpram->epx_data[0];
+
+        // SOF is needed for frame based scheduling
+        usb_hw_set->inte = USB_INTE_HOST_SOF_BITS;
+        break;
+      }
+    }
+    pico_info("Allocate %s ep on EPX\n", tu_edpt_type_str(transfer_type));
+  }
+  else if ( transfer_type != TUSB_XFER_CONTROL )
   {
     // Note: even though datasheet name these "Interrupt" endpoints. These are actually
-    // "Asynchronous" endpoints and can be used for other type such as: Bulk  (ISO need confirmation)
+    // "Asynchronous" endpoints and can be used for other type such as: Bulk
     ep = _next_free_interrupt_ep();
     pico_info("Allocate %s ep %d\n", tu_edpt_type_str(transfer_type), ep->interrupt_num);
     assert(ep);
     ep->buffer_control = &usbh_dpram->int_ep_buffer_ctrl[ep->interrupt_num].ctrl;
     ep->endpoint_control = &usbh_dpram->int_ep_ctrl[ep->interrupt_num].ctrl;
-    // 0 for epx (double buffered): TODO increase to 1024 for ISO
-    // 2x64 for intep0
-    // 3x64 for intep1
-    // etc
-    ep->hw_data_buf = &usbh_dpram->epx_data[64 * (ep->interrupt_num + 2)];
+    // EPX_DATA_SIZE for epx (ISO or double buffered)
+    // then 64 bytes for each intep
+    ep->hw_data_buf = &usbh_dpram->epx_data[EPX_DATA_SIZE + 64 * ep->interrupt_num];
   }
   else
   {
@@ -331,6 +592,11 @@ static void _hw_endpoint_init(struct hw_endpoint *ep, uint8_t dev_addr, uint8_t
   // Bits 0-5 should be 0
   assert(!(dpram_offset & 0b111111));
 
+  ep->configured = true;
+
+  // EPX is shared, its endpoint control is set when endpoint starts its turn
+  if ( ep_is_epx(ep) ) return;
+
   // Fill in endpoint control register with buffer offset
   uint32_t ep_reg = EP_CTRL_ENABLE_BITS
                     | EP_CTRL_INTERRUPT_PER_BUFFER
@@ -342,34 +608,30 @@ static void _hw_endpoint_init(struct hw_endpoint *ep, uint8_t dev_addr, uint8_t
   }
   *ep->endpoint_control = ep_reg;
   pico_trace("endpoint control (0x%p) <- 0x%lx\n", ep->endpoint_control, ep_reg);
-  ep->configured = true;
 
-  if ( ep != &epx )
-  {
-    // Endpoint has its own addr_endp and interrupt bits to be setup!
-    // This is an interrupt/async endpoint. so need to set up ADDR_ENDP register with:
-    // - device address
-    // - endpoint number / direction
-    // - preamble
-    uint32_t reg = (uint32_t) (dev_addr | (num << USB_ADDR_ENDP1_ENDPOINT_LSB));
+  // Endpoint has its own addr_endp and interrupt bits to be setup!
+  // This is an interrupt/async endpoint. so need to set up ADDR_ENDP register with:
+  // - device address
+  // - endpoint number / direction
+  // - preamble
+  uint32_t reg = (uint32_t) (dev_addr | (num << USB_ADDR_ENDP1_ENDPOINT_LSB));
 
-    if ( dir == TUSB_DIR_OUT )
-    {
-      reg |= USB_ADDR_ENDP1_INTEP_DIR_BITS;
-    }
+  if ( dir == TUSB_DIR_OUT )
+  {
+    reg |= USB_ADDR_ENDP1_INTEP_DIR_BITS;
+  }
 
-    if ( need_pre(dev_addr) )
-    {
-      reg |= USB_ADDR_ENDP1_INTEP_PREAMBLE_BITS;
-    }
-    usb_hw->int_ep_addr_ctrl[ep->interrupt_num] = reg;
+  if ( need_pre(dev_addr) )
+  {
+    reg |= USB_ADDR_ENDP1_INTEP_PREAMBLE_BITS;
+  }
+  usb_hw->int_ep_addr_ctrl[ep->interrupt_num] = reg;
 
-    // Finally, enable interrupt that endpoint
-    usb_hw_set->int_ep_ctrl = 1 << (ep->interrupt_num + 1);
+  // Finally, enable interrupt that endpoint
+  usb_hw_set->int_ep_ctrl = 1 << (ep->interrupt_num + 1);
 
-    // If it's an interrupt endpoint we need to set up the buffer control
-    // register
-  }
+  // If it's an interrupt endpoint we need to set up the buffer control
+  // register
 }
 
 //--------------------------------------------------------------------+
@@ -394,6 +656,9 @@ bool hcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
 
   // clear epx and interrupt eps
   memset(&ep_pool, 0, sizeof(ep_pool));
+  memset(&epx_pool, 0, sizeof(epx_pool));
+  epx_owner = NULL;
+  epx_rr = 0;
 
   // Enable in host mode with SOF / Keep alive on
   usb_hw->main_ctrl = USB_MAIN_CTRL_CONTROLLER_EN_BITS | USB_MAIN_CTRL_HOST_NDEVICE_BITS;
@@ -483,6 +748,25 @@ void hcd_device_close(uint8_t rhport, uint8_t dev_addr)
       hw_endpoint_reset_transfer(ep);
     }
   }
+
+  uint32_t const irq_state = save_and_disable_interrupts();
+
+  for (size_t i = 0; i < TU_ARRAY_SIZE(epx_pool); i++)
+  {
+    hw_endpoint_t* ep = &epx_pool[i];
+
+    if (ep->dev_addr == dev_addr && ep->configured)
+    {
+      if (epx_owner == ep) epx_stop();
+
+      ep->configured = false;
+      ep->pending = EPX_PENDING_NONE;
+      hw_endpoint_reset_transfer(ep);
+    }
+  }
+
+  epx_schedule();
+  restore_interrupts(irq_state);
 }
 
 uint32_t hcd_frame_number(uint8_t rhport)
@@ -537,7 +821,6 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
   pico_trace("hcd_edpt_xfer dev_addr %d, ep_addr 0x%x, len %d\n", dev_addr, ep_addr, buflen);
 
   uint8_t const ep_num = tu_edpt_number(ep_addr);
-  tusb_dir_t const ep_dir = tu_edpt_dir(ep_addr);
 
   // Get appropriate ep. Either EPX or interrupt endpoint
   struct hw_endpoint *ep = get_dev_ep(dev_addr, ep_addr);
@@ -545,7 +828,7 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
   TU_ASSERT(ep);
 
   // EP should be inactive
-  assert(!ep->active);
+  assert(!ep->active && !ep->pending);
 
   // Control endpoint can change direction 0x00 <-> 0x80
   if ( ep_addr != ep->ep_addr )
@@ -556,26 +839,20 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
     _hw_endpoint_init(ep, dev_addr, ep_addr, ep->wMaxPacketSize, ep->transfer_type, 0);
   }
 
-  // If a normal transfer (non-interrupt) then initiate using
-  // sie ctrl registers. Otherwise interrupt ep registers should
+  // If a normal transfer (non-interrupt) then queue it for EPX which initiates
+  // using sie ctrl registers. Otherwise interrupt ep registers should
   // already be configured
-  if ( ep == &epx )
+  if ( ep_is_epx(ep) )
   {
-    hw_endpoint_xfer_start(ep, buffer, buflen);
+    uint32_t const irq_state = save_and_disable_interrupts();
 
-    // That has set up buffer control, endpoint control etc
-    // for host we have to initiate the transfer
-    usb_hw->dev_addr_ctrl = (uint32_t) (dev_addr | (ep_num << USB_ADDR_ENDP_ENDPOINT_LSB));
-
-    uint32_t flags = USB_SIE_CTRL_START_TRANS_BITS | SIE_CTRL_BASE |
-                     (ep_dir ? USB_SIE_CTRL_RECEIVE_DATA_BITS : USB_SIE_CTRL_SEND_DATA_BITS) |
-                     (need_pre(dev_addr) ? USB_SIE_CTRL_PREAMBLE_EN_BITS : 0);
-    // START_TRANS bit on SIE_CTRL seems to exhibit the same behavior as the AVAILABLE bit
-    // described in RP2040 Datasheet, release 2.1, section "4.1.2.5.1. Concurrent access".
-    // We write everything except the START_TRANS bit first, then wait some cycles.
-    usb_hw->sie_ctrl = flags & ~USB_SIE_CTRL_START_TRANS_BITS;
-    busy_wait_at_least_cycles(12);
-    usb_hw->sie_ctrl = flags;
+    ep->user_buf = buffer;
+    ep->epx_remaining = buflen;
+    ep->epx_xferred = 0;
+    ep->pending = EPX_PENDING_XFER;
+    epx_schedule();
+
+    restore_interrupts(irq_state);
   }else
   {
     hw_endpoint_xfer_start(ep, buffer, buflen);
@@ -586,10 +863,24 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
 
 bool hcd_edpt_abort_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr) {
   (void) rhport;
-  (void) dev_addr;
-  (void) ep_addr;
-  // TODO not implemented yet
-  return false;
+
+  struct hw_endpoint *ep = get_dev_ep(dev_addr, ep_addr);
+  TU_VERIFY(ep && ep_is_epx(ep));
+
+  // only transfer still waiting for its turn on EPX can be aborted
+  // TODO abort active transfer
+  uint32_t const irq_state = save_and_disable_interrupts();
+  bool const ret = (ep->pending != EPX_PENDING_NONE) && (epx_owner != ep);
+  if ( ret )
+  {
+    ep->pending = EPX_PENDING_NONE;
+    hw_endpoint_reset_transfer(ep);
+    ep->epx_remaining = 0;
+    ep->epx_xferred = 0;
+  }
+  restore_interrupts(irq_state);
+
+  return ret;
 }
 
 bool hcd_setup_send(uint8_t rhport, uint8_t dev_addr, uint8_t const setup_packet[8])
@@ -613,22 +904,13 @@ bool hcd_setup_send(uint8_t rhport, uint8_t dev_addr, uint8_t const setup_packet
   _hw_endpoint_init(ep, dev_addr, 0x00, ep->wMaxPacketSize, 0, 0);
   assert(ep->configured);
 
-  ep->remaining_len = 8;
-  ep->active = true;
-
-  // Set device address
-  usb_hw->dev_addr_ctrl = dev_addr;
-
-  // Set pre if we are a low speed device on full speed hub
-  uint32_t const flags = SIE_CTRL_BASE | USB_SIE_CTRL_SEND_SETUP_BITS | USB_SIE_CTRL_START_TRANS_BITS |
-                         (need_pre(dev_addr) ? USB_SIE_CTRL_PREAMBLE_EN_BITS : 0);
-
-  // START_TRANS bit on SIE_CTRL seems to exhibit the same behavior as the AVAILABLE bit
-  // described in RP2040 Datasheet, release 2.1, section "4.1.2.5.1. Concurrent access".
-  // We write everything except the START_TRANS bit first, then wait some cycles.
-  usb_hw->sie_ctrl = flags & ~USB_SIE_CTRL_START_TRANS_BITS;
-  busy_wait_at_least_cycles(12);
-  usb_hw->sie_ctrl = flags;
+  // Sent when EPX is free, pre is set if we are a low speed device on full speed hub
+  uint32_t const irq_state = save_and_disable_interrupts();
+  ep->epx_remaining = 0;
+  ep->epx_xferred = 0;
+  ep->pending = EPX_PENDING_SETUP;
+  epx_schedule();
+  restore_interrupts(irq_state);
 
   return true;
 }
@@ -32,11 +32,19 @@
 #include <stdlib.h>
 #include "rp2040_usb.h"
 
+#if CFG_TUSB_RP2040_DMA_COPY
+  #include "hardware/dma.h"
+  #include "hardware/sync.h"
+#endif
+
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF PROTOTYPE
 //--------------------------------------------------------------------+
 static void _hw_endpoint_xfer_sync(struct hw_endpoint* ep);
 
+// Device bulk OUT double buffered requires EP_ABORT which is only usable on B2 and later (Errata RP2040-E2)
+static bool _db_out_supported = false;
+
 #if TUD_OPT_RP2040_USB_DEVICE_UFRAME_FIX
   static bool e15_is_bulkin_ep(struct hw_endpoint* ep);
   static bool e15_is_critical_frame_period(struct hw_endpoint* ep);
@@ -53,10 +61,49 @@ TU_ATTR_ALWAYS_INLINE static inline bool is_host_mode(void) {
 //--------------------------------------------------------------------+
 // Implementation
 //--------------------------------------------------------------------+
-// Provide own byte by byte memcpy as not all copies are aligned
-static void unaligned_memcpy(void *dst, const void *src, size_t n) {
+#if CFG_TUSB_RP2040_DMA_COPY
+static int _dpram_dma_ch = -1;
+#endif
+
+// Copy between user buffer and DPRAM. Provide own memcpy as not all copies are aligned and Cortex-M0+ does not do
+// unaligned access: words are copied when both have the same alignment, otherwise byte by byte
+static void __tusb_irq_path_func(dpram_memcpy)(void *dst, const void *src, size_t n) {
   uint8_t *dst_byte = (uint8_t*)dst;
   const uint8_t *src_byte = (const uint8_t*)src;
+
+#if CFG_TUSB_RP2040_DMA_COPY
+  if (_dpram_dma_ch >= 0 && n >= 16) {
+    const uint ch = (uint) _dpram_dma_ch;
+    const bool is_word = (((uintptr_t) dst | (uintptr_t) src | n) & 3u) == 0;
+    dma_channel_config cfg = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&cfg, is_word ? DMA_SIZE_32 : DMA_SIZE_8);
+    channel_config_set_read_increment(&cfg, true);
+    channel_config_set_write_increment(&cfg, true);
+
+    const uint32_t irq_state = save_and_disable_interrupts();
+    dma_channel_configure(ch, &cfg, dst, src, is_word ? (n >> 2) : n, true);
+    dma_channel_wait_for_finish_blocking(ch);
+    restore_interrupts(irq_state);
+    return;
+  }
+#endif
+
+  if ((((uintptr_t) dst_byte ^ (uintptr_t) src_byte) & 3u) == 0) {
+    while (n && ((uintptr_t) dst_byte & 3u)) {
+      *dst_byte++ = *src_byte++;
+      n--;
+    }
+
+    uint32_t *dst_word = (uint32_t*) (uintptr_t) dst_byte;
+    const uint32_t *src_word = (const uint32_t*) (uintptr_t) src_byte;
+    while (n >= 4) {
+      *dst_word++ = *src_word++;
+      n -= 4;
+    }
+    dst_byte = (uint8_t*) dst_word;
+    src_byte = (const uint8_t*) src_word;
+  }
+
   while (n--) {
     *dst_byte++ = *src_byte++;
   }
@@ -83,6 +130,15 @@ void rp2040_usb_init(void) {
   // Mux the controller to the onboard usb phy
   usb_hw->muxing = USB_USB_MUXING_TO_PHY_BITS | USB_USB_MUXING_SOFTCON_BITS;
 
+  _db_out_supported = (rp2040_chip_version() >= 2);
+
+#if CFG_TUSB_RP2040_DMA_COPY
+  // fall back to CPU copy if all channels are in use
+  if (_dpram_dma_ch < 0) {
+    _dpram_dma_ch = dma_claim_unused_channel(false);
+  }
+#endif
+
   TU_LOG2_INT(sizeof(hw_endpoint_t));
 }
 
@@ -132,7 +188,7 @@ static uint32_t __tusb_irq_path_func(prepare_ep_buffer)(struct hw_endpoint* ep,
 
   if (!ep->rx) {
     // Copy data from user buffer to hw buffer
-    unaligned_memcpy(ep->hw_data_buf + buf_id * 64, ep->user_buf, buflen);
+    dpram_memcpy(ep->hw_data_buf + buf_id * 64, ep->user_buf, buflen);
     ep->user_buf += buflen;
 
     // Mark as full
@@ -151,6 +207,150 @@ static uint32_t __tusb_irq_path_func(prepare_ep_buffer)(struct hw_endpoint* ep,
   return buf_ctrl;
 }
 
+//--------------------------------------------------------------------+
+// Device bulk OUT double buffered
+//
+// Both buffers are armed and interrupt is raised per buffer. Buffers are handled in order by db_next and the
+// consumed one is re-armed while controller is receiving into the other. When host ends the transfer with a short
+// packet, the other buffer is still armed and could already receive the first packet of next transfer. It is
+// aborted and if it got filled in the mean time, the packet is kept in dpram (carry) for the next transfer.
+//--------------------------------------------------------------------+
+static bool __tusb_irq_path_func(db_out_enabled)(struct hw_endpoint* ep) {
+  return _db_out_supported && ep->rx && !is_host_mode() && ep->transfer_type == TUSB_XFER_BULK &&
+         tu_edpt_number(ep->ep_addr) != 0;
+}
+
+// arm a single buffer while the other one may be in use by controller
+static void __tusb_irq_path_func(db_out_arm)(struct hw_endpoint* ep, uint8_t buf_id) {
+  uint32_t buf_ctrl = prepare_ep_buffer(ep, buf_id);
+  if (buf_id) buf_ctrl >>= 16;
+
+  io_rw_16* half = _hw_endpoint_buffer_control_half(ep, buf_id);
+  *half = (uint16_t) (buf_ctrl & ~USB_BUF_CTRL_AVAIL);
+  // 4.1.2.5.1 Con-current access: 12 cycles after write to buffer control
+  busy_wait_at_least_cycles(12);
+  *half = (uint16_t) buf_ctrl;
+
+  ep->db_armed++;
+}
+
+// copy received packet to user buffer, return its length
+static uint16_t __tusb_irq_path_func(db_out_read)(struct hw_endpoint* ep, uint8_t buf_id, uint16_t max_len) {
+  io_rw_16* half = _hw_endpoint_buffer_control_half(ep, buf_id);
+  uint16_t len = (uint16_t) (*half & USB_BUF_CTRL_LEN_MASK);
+
+  if (len > max_len) {
+    TU_LOG(1, "WARN: ep %02X drop %u bytes exceeding transfer length\r\n", ep->ep_addr, len - max_len);
+    len = max_len;
+  }
+
+  dpram_memcpy(ep->user_buf, ep->hw_data_buf + buf_id * 64, len);
+  ep->user_buf += len;
+  ep->xferred_len = (uint16_t) (ep->xferred_len + len);
+
+  // release buffer
+  *half = 0;
+
+  return len;
+}
+
+// abort buffer armed for current transfer after short packet
+static void __tusb_irq_path_func(db_out_abort_armed)(struct hw_endpoint* ep) {
+  if (!ep->db_armed) return;
+
+  uint8_t const buf_id = ep->db_next;
+  uint32_t const ep_mask = TU_BIT(2 * tu_edpt_number(ep->ep_addr) + 1);
+
+  usb_hw_set->abort = ep_mask;
+  while ((usb_hw->abort_done & ep_mask) != ep_mask) {}
+
+  io_rw_16* half = _hw_endpoint_buffer_control_half(ep, buf_id);
+  if (*half & USB_BUF_CTRL_FULL) {
+    // packet of next transfer is already received and ACKed
+    ep->db_carry = (uint8_t) (1 + buf_id);
+  } else {
+    // not used, revert its data toggle
+    *half = 0;
+    ep->next_pid ^= 1u;
+  }
+
+  // buffer status of aborted buffer is handled here
+  usb_hw_clear->buf_status = ep_mask;
+  usb_hw_clear->abort_done = ep_mask;
+  usb_hw_clear->abort = ep_mask;
+
+  ep->db_armed = 0;
+}
+
+// return true if transfer is complete with packet carried from previous transfer
+static bool db_out_xfer_start(struct hw_endpoint* ep) {
+  uint32_t ep_ctrl = *ep->endpoint_control;
+  ep_ctrl &= ~EP_CTRL_INTERRUPT_PER_DOUBLE_BUFFER;
+  ep_ctrl |= EP_CTRL_DOUBLE_BUFFERED_BITS | EP_CTRL_INTERRUPT_PER_BUFFER;
+  *ep->endpoint_control = ep_ctrl;
+
+  if (ep->db_carry) {
+    uint16_t const len = db_out_read(ep, (uint8_t) (ep->db_carry - 1), ep->remaining_len);
+    ep->remaining_len = (uint16_t) (ep->remaining_len - len);
+    ep->db_carry = 0;
+
+    if (len < ep->wMaxPacketSize || ep->remaining_len == 0) {
+      ep->remaining_len = 0;
+      return true;
+    }
+  }
+
+  ep->active = true;
+  ep->db_next = 0;
+  ep->db_armed = 1;
+
+  // start with buffer 0 (reset buffer select), use buffer 1 if there is still data
+  uint32_t buf_ctrl = prepare_ep_buffer(ep, 0) | USB_BUF_CTRL_SEL;
+  if (ep->remaining_len) {
+    buf_ctrl |= prepare_ep_buffer(ep, 1);
+    ep->db_armed++;
+  }
+
+  TU_LOG(3, "  Prepare BufCtrl: [0] = 0x%04x  [1] = 0x%04x\r\n", tu_u32_low16(buf_ctrl), tu_u32_high16(buf_ctrl));
+
+  *ep->buffer_control = buf_ctrl & ~(USB_BUF_CTRL_AVAIL | (USB_BUF_CTRL_AVAIL << 16));
+  busy_wait_at_least_cycles(12);
+  *ep->buffer_control = buf_ctrl;
+
+  return false;
+}
+
+// return true if transfer is complete
+static bool __tusb_irq_path_func(db_out_xfer_continue)(struct hw_endpoint* ep) {
+  // both buffers can be handled in one interrupt, the status of the second one is then stale
+  if (!ep->active) return false;
+
+  while (ep->db_armed) {
+    uint8_t const buf_id = ep->db_next;
+    if (!(*_hw_endpoint_buffer_control_half(ep, buf_id) & USB_BUF_CTRL_FULL)) break;
+
+    uint16_t const len = db_out_read(ep, buf_id, ep->wMaxPacketSize);
+    ep->db_armed--;
+    ep->db_next ^= 1u;
+
+    if (len < ep->wMaxPacketSize) {
+      // short packet: transfer is complete, drop not yet armed length
+      pico_trace("  Short packet on buffer %d with %u bytes\r\n", buf_id, len);
+      ep->remaining_len = 0;
+      db_out_abort_armed(ep);
+      return true;
+    }
+
+    if (ep->remaining_len) {
+      db_out_arm(ep, buf_id);
+    } else if (!ep->db_armed) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 // Prepare buffer control register value
 void __tusb_irq_path_func(hw_endpoint_start_next_buffer)(struct hw_endpoint* ep) {
   uint32_t ep_ctrl = *ep->endpoint_control;
@@ -158,14 +358,17 @@ void __tusb_irq_path_func(hw_endpoint_start_next_buffer)(struct hw_endpoint* ep)
   // always compute and start with buffer 0
   uint32_t buf_ctrl = prepare_ep_buffer(ep, 0) | USB_BUF_CTRL_SEL;
 
-  // For now: skip double buffered for OUT endpoint in Device mode, since
-  // host could send < 64 bytes and cause short packet on buffer0
+  // Skip double buffered for OUT endpoint in Device mode here, since host could send < 64 bytes and cause
+  // short packet on buffer0. Bulk OUT is double buffered by db_out_xfer_start() if supported by chip.
   // NOTE: this could happen to Host mode IN endpoint
   // Also, Host mode "interrupt" endpoint hardware is only single buffered,
   // NOTE2: Currently Host bulk is implemented using "interrupt" endpoint
+  // NOTE3: Host bulk OUT scheduled on EPX can be double buffered since host decides when the transfer ends
   bool const is_host = is_host_mode();
   bool const force_single = (!is_host && !tu_edpt_dir(ep->ep_addr)) ||
-                            (is_host && tu_edpt_number(ep->ep_addr) != 0);
+                            (is_host && tu_edpt_number(ep->ep_addr) != 0 &&
+                             (ep->rx || ep->transfer_type != TUSB_XFER_BULK ||
+                              ep->buffer_control != &usbh_dpram->epx_buf_ctrl));
 
   if (ep->remaining_len && !force_single) {
     // Use buffer 1 (double buffered) if there is still data
@@ -191,7 +394,8 @@ void __tusb_irq_path_func(hw_endpoint_start_next_buffer)(struct hw_endpoint* ep)
   _hw_endpoint_buffer_control_set_value32(ep, buf_ctrl);
 }
 
-void hw_endpoint_xfer_start(struct hw_endpoint* ep, uint8_t* buffer, uint16_t total_len) {
+// Return true if transfer is already complete (device bulk OUT with packet received in advance)
+bool hw_endpoint_xfer_start(struct hw_endpoint* ep, uint8_t* buffer, uint16_t total_len) {
   hw_endpoint_lock_update(ep, 1);
 
   if (ep->active) {
@@ -203,9 +407,16 @@ void hw_endpoint_xfer_start(struct hw_endpoint* ep, uint8_t* buffer, uint16_t to
   // Fill in info now that we're kicking off the hw
   ep->remaining_len = total_len;
   ep->xferred_len = 0;
-  ep->active = true;
   ep->user_buf = buffer;
 
+  if (db_out_enabled(ep)) {
+    bool const done = db_out_xfer_start(ep);
+    hw_endpoint_lock_update(ep, -1);
+    return done;
+  }
+
+  ep->active = true;
+
   if (e15_is_bulkin_ep(ep)) {
     usb_hw_set->inte = USB_INTS_DEV_SOF_BITS;
   }
@@ -217,6 +428,7 @@ void hw_endpoint_xfer_start(struct hw_endpoint* ep, uint8_t* buffer, uint16_t to
   }
 
   hw_endpoint_lock_update(ep, -1);
+  return false;
 }
 
 // sync endpoint buffer and return transferred bytes
@@ -237,7 +449,7 @@ static uint16_t __tusb_irq_path_func(sync_ep_buffer)(struct hw_endpoint* ep, uin
     // we have received AFTER we have copied it to the user buffer at the appropriate offset
     assert(buf_ctrl & USB_BUF_CTRL_FULL);
 
-    unaligned_memcpy(ep->user_buf, ep->hw_data_buf + buf_id * 64, xferred_bytes);
+    dpram_memcpy(ep->user_buf, ep->hw_data_buf + buf_id * 64, xferred_bytes);
     ep->xferred_len = (uint16_t) (ep->xferred_len + xferred_bytes);
     ep->user_buf += xferred_bytes;
   }
@@ -268,40 +480,58 @@ static void __tusb_irq_path_func(_hw_endpoint_xfer_sync)(struct hw_endpoint* ep)
       // sync buffer 1 if not short packet
       sync_ep_buffer(ep, 1);
     } else {
-      // short packet on buffer 0
-      // TODO couldn't figure out how to handle this case which happen with net_lwip_webserver example
-      // At this time (currently trigger per 2 buffer), the buffer1 is probably filled with data from
-      // the next transfer (not current one). For now we disable double buffered for device OUT
-      // NOTE this could happen to Host IN
-#if 0
-      uint8_t const ep_num = tu_edpt_number(ep->ep_addr);
-      uint8_t const dir =  (uint8_t) tu_edpt_dir(ep->ep_addr);
-      uint8_t const ep_id = 2*ep_num + (dir ? 0 : 1);
-
-      // abort queued transfer on buffer 1
-      usb_hw->abort |= TU_BIT(ep_id);
-
-      while ( !(usb_hw->abort_done & TU_BIT(ep_id)) ) {}
-
-      uint32_t ep_ctrl = *ep->endpoint_control;
-      ep_ctrl &= ~(EP_CTRL_DOUBLE_BUFFERED_BITS | EP_CTRL_INTERRUPT_PER_DOUBLE_BUFFER);
-      ep_ctrl |= EP_CTRL_INTERRUPT_PER_BUFFER;
-
-      _hw_endpoint_buffer_control_set_value32(ep, 0);
-
-      usb_hw->abort &= ~TU_BIT(ep_id);
+      // short packet on buffer 0: only possible for rx which is single buffered here (device OUT is handled
+      // by db_out_xfer_continue(), host IN is single buffered except EP0)
+    }
+  }
+}
 
-      TU_LOG(3, "----SHORT PACKET buffer0 on EP %02X:\r\n", ep->ep_addr);
-      TU_LOG(3, "  BufCtrl: [0] = 0x%04x  [1] = 0x%04x\r\n", tu_u32_low16(buf_ctrl), tu_u32_high16(buf_ctrl));
-#endif
+// Revert armed buffers of a transfer stopped part way, e.g preempted by host scheduler. Transferred buffers
+// are synced, the others are given back to remaining_len with their data toggle.
+// Return true if a short packet is received i.e transfer is complete
+bool __tusb_irq_path_func(hw_endpoint_xfer_rewind)(struct hw_endpoint* ep) {
+  uint32_t const buf_ctrl = _hw_endpoint_buffer_control_get_value32(ep);
+  uint8_t const buf_count = ((*ep->endpoint_control) & EP_CTRL_DOUBLE_BUFFERED_BITS) ? 2 : 1;
+  bool short_packet = false;
+
+  TU_LOG(3, "  Rewind BufCtrl: [0] = 0x%04x  [1] = 0x%04x\r\n", tu_u32_low16(buf_ctrl), tu_u32_high16(buf_ctrl));
+
+  for (uint8_t buf_id = 0; buf_id < buf_count; buf_id++) {
+    uint16_t const half = buf_id ? tu_u32_high16(buf_ctrl) : tu_u32_low16(buf_ctrl);
+    uint16_t const len = half & USB_BUF_CTRL_LEN_MASK;
+
+    if (!(half & USB_BUF_CTRL_AVAIL) && !short_packet) {
+      // transferred: controller uses buffer 0 first, tx data is already accounted when prepared
+      if (ep->rx) {
+        dpram_memcpy(ep->user_buf, ep->hw_data_buf + buf_id * 64, len);
+        ep->user_buf += len;
+        short_packet = (len < ep->wMaxPacketSize);
+      }
+      ep->xferred_len = (uint16_t) (ep->xferred_len + len);
+    } else {
+      // not transferred
+      ep->remaining_len = (uint16_t) (ep->remaining_len + len);
+      ep->next_pid ^= 1u;
+      if (!ep->rx) ep->user_buf -= len;
     }
   }
+
+  _hw_endpoint_buffer_control_set_value32(ep, 0);
+  if (short_packet) ep->remaining_len = 0;
+
+  return short_packet;
 }
 
 // Returns true if transfer is complete
 bool __tusb_irq_path_func(hw_endpoint_xfer_continue)(struct hw_endpoint* ep) {
   hw_endpoint_lock_update(ep, 1);
 
+  if (db_out_enabled(ep)) {
+    bool const done = db_out_xfer_continue(ep);
+    hw_endpoint_lock_update(ep, -1);
+    return done;
+  }
+
   // Part way through a transfer
   if (!ep->active) {
     panic("Can't continue xfer on inactive ep %02X", ep->ep_addr);
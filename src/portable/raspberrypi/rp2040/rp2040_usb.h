@@ -36,6 +36,12 @@
 #define __tusb_irq_path_func(x) x
 #endif
 
+// Copy packets between user buffer and USB DPRAM with a DMA channel claimed at init instead of CPU, only packets
+// of at least 16 bytes. The channel is used with interrupts disabled since copies happen in both task and ISR
+#ifndef CFG_TUSB_RP2040_DMA_COPY
+#define CFG_TUSB_RP2040_DMA_COPY 0
+#endif
+
 #define usb_hw_set    ((usb_hw_t *) hw_set_alias_untyped(usb_hw))
 #define usb_hw_clear  ((usb_hw_t *) hw_clear_alias_untyped(usb_hw))
 
@@ -83,12 +89,25 @@ typedef struct hw_endpoint
     // Transfer scheduled but not active
     uint8_t pending;
 
+    // Device bulk OUT double buffered: buffer id to be handled next, number of armed buffers
+    // and (1 + buffer id) holding a packet received for the next transfer, 0 if none
+    uint8_t db_next;
+    uint8_t db_armed;
+    uint8_t db_carry;
+
 #if CFG_TUH_ENABLED
     // Only needed for host
     uint8_t dev_addr;
 
     // If interrupt endpoint
     uint8_t interrupt_num;
+
+    // Endpoint scheduled on shared EPX: length not started yet, length done in previous turns,
+    // length of current turn and frame number when current turn is started
+    uint16_t epx_remaining;
+    uint16_t epx_xferred;
+    uint16_t epx_chunk;
+    uint16_t epx_frame;
 #endif
 
 } hw_endpoint_t;
@@ -99,10 +118,11 @@ extern volatile uint32_t e15_last_sof;
 
 void rp2040_usb_init(void);
 
-void hw_endpoint_xfer_start(struct hw_endpoint *ep, uint8_t *buffer, uint16_t total_len);
+bool hw_endpoint_xfer_start(struct hw_endpoint *ep, uint8_t *buffer, uint16_t total_len);
 bool hw_endpoint_xfer_continue(struct hw_endpoint *ep);
 void hw_endpoint_reset_transfer(struct hw_endpoint *ep);
 void hw_endpoint_start_next_buffer(struct hw_endpoint *ep);
+bool hw_endpoint_xfer_rewind(struct hw_endpoint *ep);
 
 TU_ATTR_ALWAYS_INLINE static inline void hw_endpoint_lock_update(__unused struct hw_endpoint * ep, __unused int delta) {
   // todo add critsec as necessary to prevent issues between worker and IRQ...
@@ -132,6 +152,13 @@ TU_ATTR_ALWAYS_INLINE static inline void _hw_endpoint_buffer_control_clear_mask3
   _hw_endpoint_buffer_control_update32(ep, ~value, 0);
 }
 
+// 16-bit access to buffer control of a single buffer, so that the other one which may be updated
+// by controller at the same time is not touched
+TU_ATTR_ALWAYS_INLINE static inline io_rw_16* _hw_endpoint_buffer_control_half (struct hw_endpoint *ep, uint8_t buf_id)
+{
+  return ((io_rw_16*) ep->buffer_control) + buf_id;
+}
+
 static inline uintptr_t hw_data_offset (uint8_t *buf)
 {
   // Remove usb base from buffer pointer
@@ -30,24 +30,16 @@
 #if CFG_TUD_ENABLED && defined(TUP_USBIP_RUSB2)
 
 #include "device/dcd.h"
-#include "rusb2_type.h"
-
-#if TU_CHECK_MCU(OPT_MCU_RX63X, OPT_MCU_RX65X, OPT_MCU_RX72N)
-  #include "rusb2_rx.h"
-#elif TU_CHECK_MCU(OPT_MCU_RAXXX)
-  #include "rusb2_ra.h"
-  #if defined(RENESAS_CORTEX_M23)
-    #define D0FIFO CFIFO
-    #define D0FIFOSEL CFIFOSEL
-    #define D0FIFOSEL_b CFIFOSEL_b
-    #define D1FIFOSEL CFIFOSEL
-    #define D1FIFOSEL_b CFIFOSEL_b
-    #define D0FIFOCTR CFIFOCTR
-    #define D0FIFOCTR_b CFIFOCTR_b
-  #endif
-
-#else
-  #error "Unsupported MCU"
+#include "rusb2_common.h"
+
+#if TU_CHECK_MCU(OPT_MCU_RAXXX) && defined(RENESAS_CORTEX_M23)
+  #define D0FIFO CFIFO
+  #define D0FIFOSEL CFIFOSEL
+  #define D0FIFOSEL_b CFIFOSEL_b
+  #define D1FIFOSEL CFIFOSEL
+  #define D1FIFOSEL_b CFIFOSEL_b
+  #define D0FIFOCTR CFIFOCTR
+  #define D0FIFOCTR_b CFIFOCTR_b
 #endif
 
 //--------------------------------------------------------------------+
@@ -160,90 +152,6 @@ static inline void pipe_wait_for_ready(rusb2_reg_t * rusb, unsigned num) {
   while ( !rusb->D0FIFOCTR_b.FRDY ) {}
 }
 
-//--------------------------------------------------------------------+
-// Pipe FIFO
-//--------------------------------------------------------------------+
-
-// Write data buffer --> hw fifo
-static void pipe_write_packet(rusb2_reg_t * rusb, void *buf, volatile void *fifo, unsigned len)
-{
-  (void) rusb;
-
-  volatile uint16_t *ff16;
-  volatile uint8_t *ff8;
-
-  // Highspeed FIFO is 32-bit
-  if ( rusb2_is_highspeed_reg(rusb) ) {
-    // TODO 32-bit access for better performance
-    ff16 = (volatile uint16_t*) ((uintptr_t) fifo+2);
-    ff8  = (volatile uint8_t *) ((uintptr_t) fifo+3);
-  }else {
-    ff16 = (volatile uint16_t*) fifo;
-    ff8  = ((volatile uint8_t*) fifo);
-  }
-
-  uint8_t const* buf8 = (uint8_t const*) buf;
-
-  while (len >= 2) {
-    *ff16 = tu_unaligned_read16(buf8);
-    buf8 += 2;
-    len  -= 2;
-  }
-
-  if (len > 0) {
-    *ff8 = *buf8;
-    ++buf8;
-  }
-}
-
-// Read data buffer <-- hw fifo
-static void pipe_read_packet(rusb2_reg_t * rusb, void *buf, volatile void *fifo, unsigned len)
-{
-  (void) rusb;
-
-  // TODO 16/32-bit access for better performance
-
-  uint8_t *p = (uint8_t*)buf;
-  volatile uint8_t *reg = (volatile uint8_t*)fifo;  /* byte access is always at base register address */
-  while (len--) *p++ = *reg;
-}
-
-// Write data sw fifo --> hw fifo
-static void pipe_write_packet_ff(rusb2_reg_t * rusb, tu_fifo_t *f, volatile void *fifo, uint16_t total_len) {
-  tu_fifo_buffer_info_t info;
-  tu_fifo_get_read_info(f, &info);
-
-  uint16_t count = tu_min16(total_len, info.len_lin);
-  pipe_write_packet(rusb, info.ptr_lin, fifo, count);
-
-  uint16_t rem = total_len - count;
-  if (rem) {
-    rem = tu_min16(rem, info.len_wrap);
-    pipe_write_packet(rusb, info.ptr_wrap, fifo, rem);
-    count += rem;
-  }
-
-  tu_fifo_advance_read_pointer(f, count);
-}
-
-// Read data sw fifo <-- hw fifo
-static void pipe_read_packet_ff(rusb2_reg_t * rusb, tu_fifo_t *f, volatile void *fifo, uint16_t total_len) {
-  tu_fifo_buffer_info_t info;
-  tu_fifo_get_write_info(f, &info);
-
-  uint16_t count = tu_min16(total_len, info.len_lin);
-  pipe_read_packet(rusb, info.ptr_lin, fifo, count);
-
-  uint16_t rem = total_len - count;
-  if (rem) {
-    rem = tu_min16(rem, info.len_wrap);
-    pipe_read_packet(rusb, info.ptr_wrap, fifo, rem);
-    count += rem;
-  }
-
-  tu_fifo_advance_write_pointer(f, count);
-}
-
 //--------------------------------------------------------------------+
 // Pipe Transfer
 //--------------------------------------------------------------------+
@@ -264,9 +172,9 @@ static bool pipe0_xfer_in(rusb2_reg_t* rusb)
 
   if (len) {
     if (pipe->ff) {
-      pipe_write_packet_ff(rusb, (tu_fifo_t*)buf, (volatile void*)&rusb->CFIFO, len);
+      rusb2_fifo_write_ff(rusb, &rusb->CFIFOSEL, (volatile void*)&rusb->CFIFO, (tu_fifo_t*)buf, len);
     } else {
-      pipe_write_packet(rusb, buf, (volatile void*)&rusb->CFIFO, len);
+      rusb2_fifo_write(rusb, &rusb->CFIFOSEL, (volatile void*)&rusb->CFIFO, buf, len);
       pipe->buf = (uint8_t*)buf + len;
     }
   }
@@ -291,9 +199,9 @@ static bool pipe0_xfer_out(rusb2_reg_t* rusb)
 
   if (len) {
     if (pipe->ff) {
-      pipe_read_packet_ff(rusb, (tu_fifo_t*)buf, (volatile void*)&rusb->CFIFO, len);
+      rusb2_fifo_read_ff(rusb, (volatile void*)&rusb->CFIFO, (tu_fifo_t*)buf, len);
     } else {
-      pipe_read_packet(rusb, buf, (volatile void*)&rusb->CFIFO, len);
+      rusb2_fifo_read(rusb, (volatile void*)&rusb->CFIFO, buf, len);
       pipe->buf = (uint8_t*)buf + len;
     }
   }
@@ -321,7 +229,7 @@ static bool pipe_xfer_in(rusb2_reg_t* rusb, unsigned num)
     return true;
   }
 
-  rusb->D0FIFOSEL = num | RUSB2_FIFOSEL_MBW_16BIT | (TU_BYTE_ORDER == TU_BIG_ENDIAN ? RUSB2_FIFOSEL_BIGEND : 0);
+  rusb->D0FIFOSEL = num | rusb2_fifo_mbw(rusb);
   const uint16_t mps  = edpt_max_packet_size(rusb, num);
   pipe_wait_for_ready(rusb, num);
   const uint16_t len  = tu_min16(rem, mps);
@@ -329,9 +237,9 @@ static bool pipe_xfer_in(rusb2_reg_t* rusb, unsigned num)
 
   if (len) {
     if (pipe->ff) {
-      pipe_write_packet_ff(rusb, (tu_fifo_t*)buf, (volatile void*)&rusb->D0FIFO, len);
+      rusb2_fifo_write_ff(rusb, &rusb->D0FIFOSEL, (volatile void*)&rusb->D0FIFO, (tu_fifo_t*)buf, len);
     } else {
-      pipe_write_packet(rusb, buf, (volatile void*)&rusb->D0FIFO, len);
+      rusb2_fifo_write(rusb, &rusb->D0FIFOSEL, (volatile void*)&rusb->D0FIFO, buf, len);
       pipe->buf = (uint8_t*)buf + len;
     }
   }
@@ -353,7 +261,7 @@ static bool pipe_xfer_out(rusb2_reg_t* rusb, unsigned num)
   pipe_state_t  *pipe = &_dcd.pipe[num];
   const uint16_t rem  = pipe->remaining;
 
-  rusb->D0FIFOSEL = num | RUSB2_FIFOSEL_MBW_8BIT;
+  rusb->D0FIFOSEL = num | rusb2_fifo_mbw(rusb);
   const uint16_t mps = edpt_max_packet_size(rusb, num);
   pipe_wait_for_ready(rusb, num);
 
@@ -363,9 +271,9 @@ static bool pipe_xfer_out(rusb2_reg_t* rusb, unsigned num)
 
   if (len) {
     if (pipe->ff) {
-      pipe_read_packet_ff(rusb, (tu_fifo_t*)buf, (volatile void*)&rusb->D0FIFO, len);
+      rusb2_fifo_read_ff(rusb, (volatile void*)&rusb->D0FIFO, (tu_fifo_t*)buf, len);
     } else {
-      pipe_read_packet(rusb, buf, (volatile void*)&rusb->D0FIFO, len);
+      rusb2_fifo_read(rusb, (volatile void*)&rusb->D0FIFO, buf, len);
       pipe->buf = (uint8_t*)buf + len;
     }
   }
@@ -423,13 +331,12 @@ static bool process_pipe0_xfer(rusb2_reg_t* rusb, int buffer_type, uint8_t ep_ad
 {
   /* configure fifo direction and access unit settings */
   if ( ep_addr ) {
-    /* IN, 2 bytes */
-    rusb->CFIFOSEL = RUSB2_CFIFOSEL_ISEL_WRITE | RUSB2_FIFOSEL_MBW_16BIT |
-                     (TU_BYTE_ORDER == TU_BIG_ENDIAN ? RUSB2_FIFOSEL_BIGEND : 0);
+    /* IN */
+    rusb->CFIFOSEL = RUSB2_CFIFOSEL_ISEL_WRITE | rusb2_fifo_mbw(rusb);
     while ( !(rusb->CFIFOSEL & RUSB2_CFIFOSEL_ISEL_WRITE) ) {}
   } else {
-    /* OUT, a byte */
-    rusb->CFIFOSEL = RUSB2_FIFOSEL_MBW_8BIT;
+    /* OUT */
+    rusb->CFIFOSEL = rusb2_fifo_mbw(rusb);
     while ( rusb->CFIFOSEL & RUSB2_CFIFOSEL_ISEL_WRITE ) {}
   }
 
@@ -28,14 +28,11 @@
 
 #if defined(TUP_USBIP_RUSB2) && (CFG_TUH_ENABLED || CFG_TUD_ENABLED)
 
-#include "rusb2_type.h"
-
-#if TU_CHECK_MCU(OPT_MCU_RX63X, OPT_MCU_RX65X, OPT_MCU_RX72N)
-#include "rusb2_rx.h"
-
-#elif TU_CHECK_MCU(OPT_MCU_RAXXX)
-#include "rusb2_ra.h"
+#include "device/dcd.h"
+#include "host/hcd.h"
+#include "rusb2_common.h"
 
+#if TU_CHECK_MCU(OPT_MCU_RAXXX)
 // USBFS_INT_IRQn and USBHS_USB_INT_RESUME_IRQn are generated by FSP
 rusb2_controller_t rusb2_controller[] = {
     { .reg_base = R_USB_FS0_BASE, .irqnum = USBFS_INT_IRQn },
@@ -53,10 +50,150 @@ void tusb_rusb2_set_irqnum(uint8_t rhport, int32_t irqnum) {
 //  void osal_task_delay(uint32_t msec) {
 //    R_BSP_SoftwareDelay(msec, BSP_DELAY_UNITS_MILLISECONDS);
 //  }
-
-#else
-  #error "Unsupported MCU"
 #endif
 
+//--------------------------------------------------------------------+
+// Pipe FIFO
+//--------------------------------------------------------------------+
+// Data is moved with the full port width (32-bit for highspeed, 16-bit for fullspeed). For highspeed 32-bit port,
+// narrower access of trailing bytes uses the upper address: FIFOH (16-bit) and FIFOHH (8-bit), and MBW can only be
+// reduced while writing. Reading is always done with full width, extra bytes of the last word are discarded.
+
+TU_ATTR_ALWAYS_INLINE static inline uint8_t fifo_width(rusb2_reg_t* rusb) {
+  (void) rusb;
+  return rusb2_is_highspeed_reg(rusb) ? 4 : 2;
+}
+
+void rusb2_fifo_write(rusb2_reg_t* rusb, volatile uint16_t* fifosel, volatile void* fifo, void const* buf, uint16_t len) {
+  uint8_t const* buf8 = (uint8_t const*) buf;
+  volatile uint16_t* ff16;
+  volatile uint8_t* ff8;
+
+  if (fifo_width(rusb) == 4) {
+    volatile uint32_t* ff32 = (volatile uint32_t*) fifo;
+    while (len >= 4) {
+      *ff32 = tu_unaligned_read32(buf8);
+      buf8 += 4;
+      len -= 4;
+    }
+
+    if (len == 0) {
+      return;
+    }
+
+    // switch to 16-bit access for the remaining bytes
+    *fifosel = (uint16_t) ((*fifosel & ~RUSB2_CFIFOSEL_MBW_Msk) | RUSB2_FIFOSEL_MBW_16BIT);
+    ff16 = (volatile uint16_t*) ((uintptr_t) fifo + 2);
+    ff8  = (volatile uint8_t*) ((uintptr_t) fifo + 3);
+  } else {
+    ff16 = (volatile uint16_t*) fifo;
+    ff8  = (volatile uint8_t*) fifo;
+  }
+
+  while (len >= 2) {
+    *ff16 = tu_unaligned_read16(buf8);
+    buf8 += 2;
+    len -= 2;
+  }
+
+  if (len > 0) {
+    *ff8 = *buf8;
+  }
+}
+
+void rusb2_fifo_read(rusb2_reg_t* rusb, volatile void* fifo, void* buf, uint16_t len) {
+  uint8_t* buf8 = (uint8_t*) buf;
+
+  if (fifo_width(rusb) == 4) {
+    volatile uint32_t* ff32 = (volatile uint32_t*) fifo;
+    while (len >= 4) {
+      tu_unaligned_write32(buf8, *ff32);
+      buf8 += 4;
+      len -= 4;
+    }
+
+    if (len > 0) {
+      uint32_t const word = *ff32;
+      memcpy(buf8, &word, len);
+    }
+  } else {
+    volatile uint16_t* ff16 = (volatile uint16_t*) fifo;
+    while (len >= 2) {
+      tu_unaligned_write16(buf8, *ff16);
+      buf8 += 2;
+      len -= 2;
+    }
+
+    if (len > 0) {
+      uint16_t const word = *ff16;
+      memcpy(buf8, &word, len);
+    }
+  }
+}
+
+// For sw fifo, the word on the wrap boundary is assembled/split through a temporary buffer so that hw fifo is
+// always accessed with full width except for the very last bytes.
+void rusb2_fifo_write_ff(rusb2_reg_t* rusb, volatile uint16_t* fifosel, volatile void* fifo, tu_fifo_t* ff, uint16_t len) {
+  tu_fifo_buffer_info_t info;
+  tu_fifo_get_read_info(ff, &info);
+
+  uint16_t const lin_len  = tu_min16(len, info.len_lin);
+  uint16_t const wrap_len = tu_min16((uint16_t) (len - lin_len), info.len_wrap);
+
+  if (wrap_len == 0) {
+    rusb2_fifo_write(rusb, fifosel, fifo, info.ptr_lin, lin_len);
+  } else {
+    uint8_t const width = fifo_width(rusb);
+    uint16_t const lin_aligned = (uint16_t) (lin_len - (lin_len % width));
+    uint16_t const spill = (uint16_t) (lin_len - lin_aligned);
+    uint16_t taken = 0;
+
+    rusb2_fifo_write(rusb, fifosel, fifo, info.ptr_lin, lin_aligned);
+
+    if (spill) {
+      uint8_t tmp[4];
+      taken = tu_min16((uint16_t) (width - spill), wrap_len);
+      memcpy(tmp, (uint8_t*) info.ptr_lin + lin_aligned, spill);
+      memcpy(tmp + spill, info.ptr_wrap, taken);
+      rusb2_fifo_write(rusb, fifosel, fifo, tmp, (uint16_t) (spill + taken));
+    }
+
+    rusb2_fifo_write(rusb, fifosel, fifo, (uint8_t*) info.ptr_wrap + taken, (uint16_t) (wrap_len - taken));
+  }
+
+  tu_fifo_advance_read_pointer(ff, (uint16_t) (lin_len + wrap_len));
+}
+
+void rusb2_fifo_read_ff(rusb2_reg_t* rusb, volatile void* fifo, tu_fifo_t* ff, uint16_t len) {
+  tu_fifo_buffer_info_t info;
+  tu_fifo_get_write_info(ff, &info);
+
+  uint16_t const lin_len  = tu_min16(len, info.len_lin);
+  uint16_t const wrap_len = tu_min16((uint16_t) (len - lin_len), info.len_wrap);
+
+  if (wrap_len == 0) {
+    rusb2_fifo_read(rusb, fifo, info.ptr_lin, lin_len);
+  } else {
+    uint8_t const width = fifo_width(rusb);
+    uint16_t const lin_aligned = (uint16_t) (lin_len - (lin_len % width));
+    uint16_t const spill = (uint16_t) (lin_len - lin_aligned);
+    uint16_t taken = 0;
+
+    rusb2_fifo_read(rusb, fifo, info.ptr_lin, lin_aligned);
+
+    if (spill) {
+      uint8_t tmp[4];
+      taken = tu_min16((uint16_t) (width - spill), wrap_len);
+      rusb2_fifo_read(rusb, fifo, tmp, (uint16_t) (spill + taken));
+      memcpy((uint8_t*) info.ptr_lin + lin_aligned, tmp, spill);
+      memcpy(info.ptr_wrap, tmp + spill, taken);
+    }
+
+    rusb2_fifo_read(rusb, fifo, (uint8_t*) info.ptr_wrap + taken, (uint16_t) (wrap_len - taken));
+  }
+
+  tu_fifo_advance_write_pointer(ff, (uint16_t) (lin_len + wrap_len));
+}
+
 
 #endif
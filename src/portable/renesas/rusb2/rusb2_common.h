@@ -0,0 +1,73 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef TUSB_RUSB2_COMMON_H
+#define TUSB_RUSB2_COMMON_H
+
+#include "common/tusb_common.h"
+#include "rusb2_type.h"
+
+#if TU_CHECK_MCU(OPT_MCU_RX63X, OPT_MCU_RX65X, OPT_MCU_RX72N)
+  #include "rusb2_rx.h"
+#elif TU_CHECK_MCU(OPT_MCU_RAXXX)
+  #include "rusb2_ra.h"
+#else
+  #error "Unsupported MCU"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Pipe FIFO
+//--------------------------------------------------------------------+
+
+// FIFO port access width used for data transfer: highspeed FIFO port is 32-bit, fullspeed is 16-bit.
+// FIFOSEL must be configured with this width before calling FIFO read/write.
+TU_ATTR_ALWAYS_INLINE static inline uint16_t rusb2_fifo_mbw(rusb2_reg_t* rusb) {
+  (void) rusb;
+  return (uint16_t) ((rusb2_is_highspeed_reg(rusb) ? RUSB2_FIFOSEL_MBW_32BIT : RUSB2_FIFOSEL_MBW_16BIT) |
+                     (TU_BYTE_ORDER == TU_BIG_ENDIAN ? RUSB2_FIFOSEL_BIGEND : 0));
+}
+
+// Write data buffer --> hw fifo. Trailing bytes are written with narrower access, which changes MBW of fifosel.
+void rusb2_fifo_write(rusb2_reg_t* rusb, volatile uint16_t* fifosel, volatile void* fifo, void const* buf, uint16_t len);
+
+// Read data buffer <-- hw fifo
+void rusb2_fifo_read(rusb2_reg_t* rusb, volatile void* fifo, void* buf, uint16_t len);
+
+// Write data sw fifo --> hw fifo
+void rusb2_fifo_write_ff(rusb2_reg_t* rusb, volatile uint16_t* fifosel, volatile void* fifo, tu_fifo_t* ff, uint16_t len);
+
+// Read data sw fifo <-- hw fifo
+void rusb2_fifo_read_ff(rusb2_reg_t* rusb, volatile void* fifo, tu_fifo_t* ff, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -76,8 +76,8 @@
  * - Packet buffer memory is copied in the interrupt.
  *   - This is better for performance, but means interrupts are disabled for longer
  *   - DMA may be the best choice, but it could also be pushed to the USBD task.
- * - No double-buffering
- * - No DMA
+ * - Double-buffering for bulk endpoints is optional (CFG_TUD_FSDEV_DOUBLE_BUFFER)
+ * - No DMA, though PMA copy of large packets can be offloaded with dcd_fsdev_dma_copy()
  * - Minimal error handling
  *   - Perhaps error interrupts should be reported to the stack, or cause a device reset?
  * - Assumes a single USB peripheral; I think that no hardware has multiple so this is fine.
@@ -101,9 +101,9 @@
  * - Tiny (saves RAM, assumes a single USB peripheral)
  *
  * Notes:
- * - The buffer table is allocated as endpoints are opened. The allocation is only
- *   cleared when the device is reset. This may be bad if the USB device needs
- *   to be reconfigured.
+ * - The buffer table is allocated as endpoints are opened. Re-opening an endpoint (e.g when switching
+ *   alternate setting) reuses its packet memory if large enough, otherwise it is freed and allocated again.
+ *   All endpoints except EP0 are released when the configuration changes.
  */
 
 #include "tusb_option.h"
@@ -127,6 +127,19 @@
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
 
+// Double buffering for bulk endpoints: hardware can receive/transmit the next packet while the CPU copies
+// the other buffer. A double buffered endpoint uses a hardware endpoint register (EPnR) on its own and twice
+// the packet memory. Endpoint falls back to single buffering if there is no free register left.
+#ifndef CFG_TUD_FSDEV_DOUBLE_BUFFER
+  #define CFG_TUD_FSDEV_DOUBLE_BUFFER 0
+#endif
+
+// Packets of at least this size are copied to/from PMA with dcd_fsdev_dma_copy(), which can be implemented by
+// application/bsp using a memory-to-memory DMA channel. 0 to always copy with CPU.
+#ifndef CFG_TUD_FSDEV_DMA_THRESHOLD
+  #define CFG_TUD_FSDEV_DMA_THRESHOLD 0
+#endif
+
 // One of these for every EP IN & OUT, uses a bit of RAM....
 typedef struct {
   uint8_t *buffer;
@@ -136,6 +149,9 @@ typedef struct {
   uint16_t max_packet_size;
   uint8_t ep_idx;   // index for USB_EPnR register
   bool iso_in_sending; // Workaround for ISO IN EP doesn't have interrupt mask
+  bool dbuf;           // double buffered bulk endpoint
+  bool dbuf_pending;   // IN: next packet is in PMA but not handed to hardware, OUT: packet received without transfer
+  bool active;         // transfer in progress, only tracked for double buffered OUT
 } xfer_ctl_t;
 
 // EP allocator
@@ -143,10 +159,19 @@ typedef struct {
   uint8_t ep_num;
   uint8_t ep_type;
   bool allocated[2];
+  bool exclusive;       // EPnR is used by one direction only (ISO or double buffered bulk)
+  uint16_t pma_addr[2]; // PMA buffer of each btable entry
+  uint16_t pma_len[2];  // 0 if not allocated
 } ep_alloc_t;
 
 static xfer_ctl_t xfer_status[CFG_TUD_ENDPPOINT_MAX][2];
 static ep_alloc_t ep_alloc_status[FSDEV_EP_COUNT];
+
+// static PMA layout of current configuration from dcd_edpt_mem_plan()
+static tu_edpt_mem_t const* _pma_plan;
+static uint8_t _pma_plan_count;
+
+enum { PMA_ADDR_NONE = 0xFFFFu };
 static uint8_t remoteWakeCountdown; // When wake is requested
 
 //--------------------------------------------------------------------+
@@ -156,12 +181,13 @@ static uint8_t remoteWakeCountdown; // When wake is requested
 // into the stack.
 static void handle_bus_reset(uint8_t rhport);
 static void dcd_transmit_packet(xfer_ctl_t *xfer, uint16_t ep_ix);
+static void dcd_transmit_packet_dbuf(xfer_ctl_t *xfer, uint16_t ep_ix);
 static bool edpt_xfer(uint8_t rhport, uint8_t ep_num, tusb_dir_t dir);
 
 // PMA allocation/access
-static uint16_t ep_buf_ptr; ///< Points to first free memory location
-static uint32_t dcd_pma_alloc(uint16_t len, bool dbuf);
-static uint8_t dcd_ep_alloc(uint8_t ep_addr, uint8_t ep_type);
+static uint16_t dcd_pma_alloc(uint8_t ep_idx, uint8_t buf_id, uint16_t len, uint16_t planned);
+static void dcd_pma_free(uint8_t ep_idx);
+static uint8_t dcd_ep_alloc(uint8_t ep_addr, uint8_t ep_type, bool exclusive);
 static bool dcd_write_packet_memory(uint16_t dst, const void *__restrict src, uint16_t nbytes);
 static bool dcd_read_packet_memory(void *__restrict dst, uint16_t src, uint16_t nbytes);
 
@@ -259,6 +285,8 @@ void dcd_remote_wakeup(uint8_t rhport) {
 
 static void handle_bus_reset(uint8_t rhport) {
   FSDEV_REG->DADDR = 0u; // disable USB Function
+  _pma_plan = NULL;
+  _pma_plan_count = 0;
 
   for (uint32_t i = 0; i < FSDEV_EP_COUNT; i++) {
     // Clear EP allocation status
@@ -266,11 +294,10 @@ static void handle_bus_reset(uint8_t rhport) {
     ep_alloc_status[i].ep_type = 0xFF;
     ep_alloc_status[i].allocated[0] = false;
     ep_alloc_status[i].allocated[1] = false;
+    ep_alloc_status[i].exclusive = false;
+    dcd_pma_free((uint8_t) i);
   }
 
-  // Reset PMA allocation
-  ep_buf_ptr = FSDEV_BTABLE_BASE + 8 * FSDEV_EP_COUNT;
-
   edpt0_open(rhport); // open control endpoint (both IN & OUT)
 
   FSDEV_REG->DADDR = USB_DADDR_EF; // Enable USB Function
@@ -295,6 +322,16 @@ static void handle_ctr_tx(uint32_t ep_id) {
     btable_set_count(ep_id, buf_id, 0);
   }
 
+  if (xfer->dbuf) {
+    // hardware is now waiting for the buffer prepared while previous packet was sent
+    if (xfer->dbuf_pending) {
+      dcd_transmit_packet_dbuf(xfer, ep_id);
+    } else {
+      dcd_event_xfer_complete(0, ep_num | TUSB_DIR_IN_MASK, xfer->queued_len, XFER_RESULT_SUCCESS, true);
+    }
+    return;
+  }
+
   if (xfer->total_len != xfer->queued_len) {
     dcd_transmit_packet(xfer, ep_id);
   } else {
@@ -323,6 +360,33 @@ static void handle_ctr_setup(uint32_t ep_id) {
   }
 }
 
+// Double buffered OUT: hardware NAKs once it has filled the buffer next to the one owned by software.
+// Toggle SW_BUF first to release the previously consumed buffer, hardware can then receive the next packet
+// while this one is copied.
+static void handle_rx_dbuf(xfer_ctl_t *xfer, uint32_t ep_id, bool in_isr) {
+  uint32_t const ep_reg = ep_read(ep_id);
+  uint8_t const ep_num = ep_reg & USB_EPADDR_FIELD;
+  uint8_t const buf_id = ep_dbuf_sw_buf(ep_reg, TUSB_DIR_OUT) ^ 1; // buffer just filled by hardware
+
+  ep_dbuf_toggle_sw_buf(ep_id, TUSB_DIR_OUT);
+
+  uint16_t const rx_count = btable_get_count(ep_id, buf_id);
+  uint16_t const pma_addr = (uint16_t) btable_get_addr(ep_id, buf_id);
+  uint16_t const len = tu_min16(rx_count, xfer->total_len - xfer->queued_len);
+
+  if (xfer->ff) {
+    dcd_read_packet_memory_ff(xfer->ff, pma_addr, len);
+  } else {
+    dcd_read_packet_memory(xfer->buffer + xfer->queued_len, pma_addr, len);
+  }
+  xfer->queued_len += len;
+
+  if ((rx_count < xfer->max_packet_size) || (xfer->queued_len >= xfer->total_len)) {
+    xfer->active = false;
+    dcd_event_xfer_complete(0, ep_num, xfer->queued_len, XFER_RESULT_SUCCESS, in_isr);
+  }
+}
+
 // Handle CTR interrupt for the RX/OUT direction
 static void handle_ctr_rx(uint32_t ep_id) {
   uint32_t ep_reg = ep_read(ep_id) | USB_EP_CTR_TX | USB_EP_CTR_RX;
@@ -330,6 +394,16 @@ static void handle_ctr_rx(uint32_t ep_id) {
   bool const is_iso = ep_is_iso(ep_reg);
   xfer_ctl_t* xfer = xfer_ctl_ptr(ep_num, TUSB_DIR_OUT);
 
+  if (xfer->dbuf) {
+    if (xfer->active) {
+      handle_rx_dbuf(xfer, ep_id, true);
+    } else {
+      // no transfer queued: keep packet in PMA, hardware NAKs until it is consumed by next transfer
+      xfer->dbuf_pending = true;
+    }
+    return;
+  }
+
   uint8_t buf_id;
   if (is_iso) {
     buf_id = (ep_reg & USB_EP_DTOG_RX) ? 0 : 1; // ISO are double buffered
@@ -485,59 +559,119 @@ void dcd_edpt0_status_complete(uint8_t rhport, tusb_control_request_t const *req
   edpt0_prepare_setup();
 }
 
+// End of a buffer overlapping with [addr, addr+len), 0 if there is none
+static uint16_t pma_overlap_end(uint16_t addr, uint16_t len) {
+  for (uint8_t i = 0; i < FSDEV_EP_COUNT; i++) {
+    for (uint8_t b = 0; b < 2; b++) {
+      uint16_t const blk_addr = ep_alloc_status[i].pma_addr[b];
+      uint16_t const blk_len = ep_alloc_status[i].pma_len[b];
+      if (blk_len && (addr < blk_addr + blk_len) && (blk_addr < addr + len)) {
+        return (uint16_t) (blk_addr + blk_len);
+      }
+    }
+  }
+  return 0;
+}
+
+// Static layout entry of endpoint, NULL if there is none
+static tu_edpt_mem_t const* pma_plan_find(uint8_t ep_addr) {
+  for (uint8_t i = 0; i < _pma_plan_count; i++) {
+    if (_pma_plan[i].ep_addr == ep_addr) {
+      return &_pma_plan[i];
+    }
+  }
+  return NULL;
+}
+
+// Planned address of buffer 'index' (0 or 1) of endpoint, 2nd buffer is in the upper half of a double buffered entry
+static uint16_t pma_plan_addr(tu_edpt_mem_t const* mem, uint8_t index) {
+  if (mem == NULL || (index && !mem->dbuf)) {
+    return PMA_ADDR_NONE;
+  }
+  return (uint16_t) (mem->offset + (index ? mem->size / 2 : 0));
+}
+
 /***
- * Allocate a section of PMA
- * In case of double buffering, high 16bit is the address of 2nd buffer
+ * Allocate a section of PMA for btable entry buf_id of hardware endpoint ep_idx
+ * Buffer already allocated to this entry is reused if large enough, otherwise it is freed and allocated again
+ * at the planned address (if free) or the first free gap that fits (first fit). Since all buffers are tracked by
+ * their btable entries, PMA can be reused when alternate settings are switched.
  * During failure, TU_ASSERT is used. If this happens, rework/reallocate memory manually.
  */
-static uint32_t dcd_pma_alloc(uint16_t len, bool dbuf)
+static uint16_t dcd_pma_alloc(uint8_t ep_idx, uint8_t buf_id, uint16_t len, uint16_t planned)
 {
   uint8_t blsize, num_block;
-  uint16_t aligned_len = pma_align_buffer_size(len, &blsize, &num_block);
+  uint16_t const aligned_len = pma_align_buffer_size(len, &blsize, &num_block);
   (void) blsize;
   (void) num_block;
 
-  uint32_t addr = ep_buf_ptr;
-  ep_buf_ptr = (uint16_t)(ep_buf_ptr + aligned_len); // increment buffer pointer
+  ep_alloc_t* ep_alloc = &ep_alloc_status[ep_idx];
+  if (ep_alloc->pma_len[buf_id] >= aligned_len) {
+    return ep_alloc->pma_addr[buf_id];
+  }
+  ep_alloc->pma_len[buf_id] = 0;
 
-  if (dbuf) {
-    addr |= ((uint32_t)ep_buf_ptr) << 16;
-    ep_buf_ptr = (uint16_t)(ep_buf_ptr + aligned_len); // increment buffer pointer
+  uint16_t addr = FSDEV_BTABLE_BASE + 8 * FSDEV_EP_COUNT;
+  if (planned != PMA_ADDR_NONE && planned >= addr && planned + aligned_len <= FSDEV_PMA_SIZE &&
+      pma_overlap_end(planned, aligned_len) == 0) {
+    addr = planned;
+  } else {
+    // move past any buffer overlapping with candidate address until a free gap is found
+    for (uint16_t end = pma_overlap_end(addr, aligned_len); end; end = pma_overlap_end(addr, aligned_len)) {
+      addr = end;
+    }
   }
 
   // Verify packet buffer is not overflowed
-  TU_ASSERT(ep_buf_ptr <= FSDEV_PMA_SIZE, 0xFFFF);
+  TU_ASSERT(addr + aligned_len <= FSDEV_PMA_SIZE, 0xFFFF);
+
+  ep_alloc->pma_addr[buf_id] = addr;
+  ep_alloc->pma_len[buf_id] = aligned_len;
 
   return addr;
 }
 
+/***
+ * Free all PMA buffers of hardware endpoint
+ */
+static void dcd_pma_free(uint8_t ep_idx)
+{
+  ep_alloc_status[ep_idx].pma_len[0] = 0;
+  ep_alloc_status[ep_idx].pma_len[1] = 0;
+}
+
 /***
  * Allocate hardware endpoint
+ * Exclusive endpoint (ISO or double buffered bulk) uses both directions of hardware endpoint.
+ * Return FSDEV_EP_COUNT if there is no suitable endpoint.
  */
-static uint8_t dcd_ep_alloc(uint8_t ep_addr, uint8_t ep_type)
+static uint8_t ep_alloc_find(uint8_t ep_addr, uint8_t ep_type, bool exclusive)
 {
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
 
   for (uint8_t i = 0; i < FSDEV_EP_COUNT; i++) {
+    ep_alloc_t* ep_alloc = &ep_alloc_status[i];
+
     // Check if already allocated
-    if (ep_alloc_status[i].allocated[dir] &&
-        ep_alloc_status[i].ep_type == ep_type &&
-        ep_alloc_status[i].ep_num == epnum) {
+    if (ep_alloc->allocated[dir] &&
+        ep_alloc->ep_type == ep_type &&
+        ep_alloc->ep_num == epnum) {
       return i;
     }
 
     // If EP of current direction is not allocated
-    // Except for ISO endpoint, both direction should be free
-    if (!ep_alloc_status[i].allocated[dir] &&
-        (ep_type != TUSB_XFER_ISOCHRONOUS || !ep_alloc_status[i].allocated[dir ^ 1])) {
+    // For exclusive endpoint, both direction should be free
+    if (!ep_alloc->allocated[dir] && !ep_alloc->exclusive &&
+        (!exclusive || !ep_alloc->allocated[dir ^ 1])) {
       // Check if EP number is the same
-      if (ep_alloc_status[i].ep_num == 0xFF || ep_alloc_status[i].ep_num == epnum) {
+      if (ep_alloc->ep_num == 0xFF || ep_alloc->ep_num == epnum) {
         // One EP pair has to be the same type
-        if (ep_alloc_status[i].ep_type == 0xFF || ep_alloc_status[i].ep_type == ep_type) {
-          ep_alloc_status[i].ep_num = epnum;
-          ep_alloc_status[i].ep_type = ep_type;
-          ep_alloc_status[i].allocated[dir] = true;
+        if (ep_alloc->ep_type == 0xFF || ep_alloc->ep_type == ep_type) {
+          ep_alloc->ep_num = epnum;
+          ep_alloc->ep_type = ep_type;
+          ep_alloc->allocated[dir] = true;
+          ep_alloc->exclusive = exclusive;
 
           return i;
         }
@@ -545,15 +679,29 @@ static uint8_t dcd_ep_alloc(uint8_t ep_addr, uint8_t ep_type)
     }
   }
 
+  return FSDEV_EP_COUNT;
+}
+
+static uint8_t dcd_ep_alloc(uint8_t ep_addr, uint8_t ep_type, bool exclusive)
+{
+  uint8_t ep_idx = ep_alloc_find(ep_addr, ep_type, exclusive);
+
+  // double buffered bulk can fall back to share an endpoint with other direction
+  if (ep_idx == FSDEV_EP_COUNT && exclusive && ep_type == TUSB_XFER_BULK) {
+    ep_idx = ep_alloc_find(ep_addr, ep_type, false);
+  }
+
   // Allocation failed
-  TU_ASSERT(0);
+  TU_ASSERT(ep_idx < FSDEV_EP_COUNT, FSDEV_EP_COUNT);
+
+  return ep_idx;
 }
 
 void edpt0_open(uint8_t rhport) {
   (void) rhport;
 
-  dcd_ep_alloc(0x0, TUSB_XFER_CONTROL);
-  dcd_ep_alloc(0x80, TUSB_XFER_CONTROL);
+  dcd_ep_alloc(0x0, TUSB_XFER_CONTROL, false);
+  dcd_ep_alloc(0x80, TUSB_XFER_CONTROL, false);
 
   xfer_status[0][0].max_packet_size = CFG_TUD_ENDPOINT0_SIZE;
   xfer_status[0][0].ep_idx = 0;
@@ -561,8 +709,8 @@ void edpt0_open(uint8_t rhport) {
   xfer_status[0][1].max_packet_size = CFG_TUD_ENDPOINT0_SIZE;
   xfer_status[0][1].ep_idx = 0;
 
-  uint16_t pma_addr0 = dcd_pma_alloc(CFG_TUD_ENDPOINT0_SIZE, false);
-  uint16_t pma_addr1 = dcd_pma_alloc(CFG_TUD_ENDPOINT0_SIZE, false);
+  uint16_t pma_addr0 = dcd_pma_alloc(0, BTABLE_BUF_RX, CFG_TUD_ENDPOINT0_SIZE, PMA_ADDR_NONE);
+  uint16_t pma_addr1 = dcd_pma_alloc(0, BTABLE_BUF_TX, CFG_TUD_ENDPOINT0_SIZE, PMA_ADDR_NONE);
 
   btable_set_addr(0, BTABLE_BUF_RX, pma_addr0);
   btable_set_addr(0, BTABLE_BUF_TX, pma_addr1);
@@ -583,8 +731,12 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const *desc_ep) {
   uint8_t const ep_num = tu_edpt_number(ep_addr);
   tusb_dir_t const dir = tu_edpt_dir(ep_addr);
   const uint16_t packet_size = tu_edpt_packet_size(desc_ep);
-  uint8_t const ep_idx = dcd_ep_alloc(ep_addr, desc_ep->bmAttributes.xfer);
+  tu_edpt_mem_t const* planned = pma_plan_find(ep_addr);
+  bool const want_dbuf = (desc_ep->bmAttributes.xfer == TUSB_XFER_BULK) &&
+                         (planned ? (planned->dbuf != 0) : CFG_TUD_FSDEV_DOUBLE_BUFFER);
+  uint8_t const ep_idx = dcd_ep_alloc(ep_addr, desc_ep->bmAttributes.xfer, want_dbuf);
   TU_ASSERT(ep_idx < FSDEV_EP_COUNT);
+  bool const dbuf = ep_alloc_status[ep_idx].exclusive;
 
   uint32_t ep_reg = ep_read(ep_idx) & ~USB_EPREG_MASK;
   ep_reg |= tu_edpt_number(ep_addr) | USB_EP_CTR_TX | USB_EP_CTR_RX;
@@ -603,22 +755,48 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const *desc_ep) {
       TU_ASSERT(false);
   }
 
-  /* Create a packet memory buffer area. */
-  uint16_t pma_addr = dcd_pma_alloc(packet_size, false);
-  btable_set_addr(ep_idx, dir == TUSB_DIR_IN ? BTABLE_BUF_TX : BTABLE_BUF_RX, pma_addr);
-
   xfer_ctl_t *xfer = xfer_ctl_ptr(ep_num, dir);
   xfer->max_packet_size = packet_size;
   xfer->ep_idx = ep_idx;
+  xfer->dbuf = dbuf;
+  xfer->dbuf_pending = false;
+  xfer->active = false;
 
-  ep_change_status(&ep_reg, dir, EP_STAT_NAK);
-  ep_change_dtog(&ep_reg, dir, 0);
+  if (dbuf) {
+    /* Both btable entries are used by this direction. Status stays VALID, flow control is done by hardware
+     * comparing its DTOG with SW_BUF (DTOG of the other direction). */
+    for (uint8_t buf_id = 0; buf_id < 2; buf_id++) {
+      uint16_t pma_addr = dcd_pma_alloc(ep_idx, buf_id, packet_size, pma_plan_addr(planned, buf_id));
+      btable_set_addr(ep_idx, buf_id, pma_addr);
+      if (dir == TUSB_DIR_IN) {
+        btable_set_count(ep_idx, buf_id, 0);
+      } else {
+        btable_set_rx_bufsize(ep_idx, buf_id, packet_size);
+      }
+    }
 
-  // reserve other direction toggle bits
-  if (dir == TUSB_DIR_IN) {
-    ep_reg &= ~(USB_EPRX_STAT | USB_EP_DTOG_RX);
+    ep_reg |= USB_EP_KIND; // DBL_BUF
+    ep_change_status(&ep_reg, dir, EP_STAT_VALID);
+    ep_change_dtog(&ep_reg, dir, 0);
+    ep_change_status(&ep_reg, (tusb_dir_t) (1 - dir), EP_STAT_DISABLED);
+    // IN : software owns buffer 0 which hardware is about to send -> NAK until first packet is written
+    // OUT: software owns buffer 1, hardware can receive into buffer 0
+    ep_change_dtog(&ep_reg, (tusb_dir_t) (1 - dir), dir == TUSB_DIR_IN ? 0 : 1);
   } else {
-    ep_reg &= ~(USB_EPTX_STAT | USB_EP_DTOG_TX);
+    /* Create a packet memory buffer area. */
+    uint8_t const buf_id = (dir == TUSB_DIR_IN) ? BTABLE_BUF_TX : BTABLE_BUF_RX;
+    uint16_t pma_addr = dcd_pma_alloc(ep_idx, buf_id, packet_size, pma_plan_addr(planned, 0));
+    btable_set_addr(ep_idx, buf_id, pma_addr);
+
+    ep_change_status(&ep_reg, dir, EP_STAT_NAK);
+    ep_change_dtog(&ep_reg, dir, 0);
+
+    // reserve other direction toggle bits
+    if (dir == TUSB_DIR_IN) {
+      ep_reg &= ~(USB_EPRX_STAT | USB_EP_DTOG_RX);
+    } else {
+      ep_reg &= ~(USB_EPTX_STAT | USB_EP_DTOG_TX);
+    }
   }
 
   ep_write(ep_idx, ep_reg, true);
@@ -637,12 +815,27 @@ void dcd_edpt_close_all(uint8_t rhport) {
     ep_alloc_status[i].ep_type = 0xFF;
     ep_alloc_status[i].allocated[0] = false;
     ep_alloc_status[i].allocated[1] = false;
+    ep_alloc_status[i].exclusive = false;
+    // Release PMA, EP0 buffers are kept
+    dcd_pma_free((uint8_t) i);
   }
+  _pma_plan = NULL;
+  _pma_plan_count = 0;
 
   dcd_int_enable(rhport);
+}
 
-  // Reset PMA allocation
-  ep_buf_ptr = FSDEV_BTABLE_BASE + 8 * CFG_TUD_ENDPPOINT_MAX + 2 * CFG_TUD_ENDPOINT0_SIZE;
+// Static PMA layout, endpoints are allocated at their planned address when opened. Double buffering of bulk
+// endpoints follows the layout instead of CFG_TUD_FSDEV_DOUBLE_BUFFER
+bool dcd_edpt_mem_plan(uint8_t rhport, tu_edpt_mem_t const* mem, uint8_t count) {
+  (void) rhport;
+  for (uint8_t i = 0; i < count; i++) {
+    TU_VERIFY(mem[i].offset >= FSDEV_BTABLE_BASE + 8 * FSDEV_EP_COUNT && mem[i].offset + mem[i].size <= FSDEV_PMA_SIZE);
+  }
+
+  _pma_plan = mem;
+  _pma_plan_count = count;
+  return true;
 }
 
 bool dcd_edpt_iso_alloc(uint8_t rhport, uint8_t ep_addr, uint16_t largest_packet_size) {
@@ -650,15 +843,16 @@ bool dcd_edpt_iso_alloc(uint8_t rhport, uint8_t ep_addr, uint16_t largest_packet
 
   uint8_t const ep_num = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
-  uint8_t const ep_idx = dcd_ep_alloc(ep_addr, TUSB_XFER_ISOCHRONOUS);
+  uint8_t const ep_idx = dcd_ep_alloc(ep_addr, TUSB_XFER_ISOCHRONOUS, true);
+  TU_ASSERT(ep_idx < FSDEV_EP_COUNT);
 
   /* Create a packet memory buffer area. Enable double buffering for devices with 2048 bytes PMA,
      for smaller devices double buffering occupy too much space. */
+  tu_edpt_mem_t const* planned = pma_plan_find(ep_addr);
+  uint16_t pma_addr = dcd_pma_alloc(ep_idx, 0, largest_packet_size, pma_plan_addr(planned, 0));
 #if FSDEV_PMA_SIZE > 1024u
-  uint32_t pma_addr = dcd_pma_alloc(largest_packet_size, true);
-  uint16_t pma_addr2 = pma_addr >> 16;
+  uint16_t pma_addr2 = dcd_pma_alloc(ep_idx, 1, largest_packet_size, pma_plan_addr(planned, 1));
 #else
-  uint32_t pma_addr = dcd_pma_alloc(largest_packet_size, false);
   uint16_t pma_addr2 = pma_addr;
 #endif
 
@@ -667,6 +861,7 @@ bool dcd_edpt_iso_alloc(uint8_t rhport, uint8_t ep_addr, uint16_t largest_packet
 
   xfer_ctl_t* xfer = xfer_ctl_ptr(ep_num, dir);
   xfer->ep_idx = ep_idx;
+  xfer->dbuf = false;
 
   return true;
 }
@@ -694,9 +889,42 @@ bool dcd_edpt_iso_activate(uint8_t rhport, tusb_desc_endpoint_t const *desc_ep)
   return true;
 }
 
-// Currently, single-buffered, and only 64 bytes at a time (max)
-static void dcd_transmit_packet(xfer_ctl_t *xfer, uint16_t ep_ix) {
+// Write next packet of transfer to PMA buffer of btable entry buf_id
+static void dcd_write_next_packet(xfer_ctl_t *xfer, uint16_t ep_ix, uint8_t buf_id) {
   uint16_t len = tu_min16(xfer->total_len - xfer->queued_len, xfer->max_packet_size);
+  uint16_t addr_ptr = (uint16_t) btable_get_addr(ep_ix, buf_id);
+
+  if (xfer->ff) {
+    dcd_write_packet_memory_ff(xfer->ff, addr_ptr, len);
+  } else {
+    dcd_write_packet_memory(addr_ptr, &(xfer->buffer[xfer->queued_len]), len);
+  }
+  xfer->queued_len += len;
+
+  btable_set_count(ep_ix, buf_id, len);
+}
+
+// Double buffered IN: hardware is waiting for the buffer owned by software (SW_BUF). Hand it over then
+// prepare the next packet in the other buffer so that it is ready as soon as the current one is sent.
+static void dcd_transmit_packet_dbuf(xfer_ctl_t *xfer, uint16_t ep_ix) {
+  uint8_t const buf_id = ep_dbuf_sw_buf(ep_read(ep_ix), TUSB_DIR_IN);
+
+  if (!xfer->dbuf_pending) {
+    // start of transfer, nothing is prepared yet
+    dcd_write_next_packet(xfer, ep_ix, buf_id);
+  }
+
+  ep_dbuf_toggle_sw_buf(ep_ix, TUSB_DIR_IN);
+  xfer->dbuf_pending = false;
+
+  if (xfer->queued_len < xfer->total_len) {
+    dcd_write_next_packet(xfer, ep_ix, buf_id ^ 1);
+    xfer->dbuf_pending = true;
+  }
+}
+
+// Single-buffered, one packet at a time
+static void dcd_transmit_packet(xfer_ctl_t *xfer, uint16_t ep_ix) {
   uint32_t ep_reg = ep_read(ep_ix) | USB_EP_CTR_TX | USB_EP_CTR_RX; // reserve CTR
 
   bool const is_iso = ep_is_iso(ep_reg);
@@ -707,16 +935,8 @@ static void dcd_transmit_packet(xfer_ctl_t *xfer, uint16_t ep_ix) {
   } else {
     buf_id = BTABLE_BUF_TX;
   }
-  uint16_t addr_ptr = (uint16_t) btable_get_addr(ep_ix, buf_id);
 
-  if (xfer->ff) {
-    dcd_write_packet_memory_ff(xfer->ff, addr_ptr, len);
-  } else {
-    dcd_write_packet_memory(addr_ptr, &(xfer->buffer[xfer->queued_len]), len);
-  }
-  xfer->queued_len += len;
-
-  btable_set_count(ep_ix, buf_id, len);
+  dcd_write_next_packet(xfer, ep_ix, buf_id);
   ep_change_status(&ep_reg, TUSB_DIR_IN, EP_STAT_VALID);
 
   if (is_iso) {
@@ -727,12 +947,26 @@ static void dcd_transmit_packet(xfer_ctl_t *xfer, uint16_t ep_ix) {
 }
 
 static bool edpt_xfer(uint8_t rhport, uint8_t ep_num, tusb_dir_t dir) {
-  (void) rhport;
 
   xfer_ctl_t *xfer = xfer_ctl_ptr(ep_num, dir);
   uint8_t const ep_idx = xfer->ep_idx;
 
-  if (dir == TUSB_DIR_IN) {
+  if (xfer->dbuf) {
+    // endpoint is always VALID, interrupt can fire as soon as a buffer is handed to hardware
+    dcd_int_disable(rhport);
+    if (dir == TUSB_DIR_IN) {
+      xfer->dbuf_pending = false;
+      dcd_transmit_packet_dbuf(xfer, ep_idx);
+    } else {
+      xfer->active = true;
+      if (xfer->dbuf_pending) {
+        // packet received before this transfer is queued
+        xfer->dbuf_pending = false;
+        handle_rx_dbuf(xfer, ep_idx, false);
+      }
+    }
+    dcd_int_enable(rhport);
+  } else if (dir == TUSB_DIR_IN) {
     dcd_transmit_packet(xfer, ep_idx);
   } else {
     uint32_t ep_reg = ep_read(ep_idx) | USB_EP_CTR_TX | USB_EP_CTR_RX; // reserve CTR
@@ -792,6 +1026,12 @@ void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr) {
   ep_change_status(&ep_reg, dir, EP_STAT_STALL);
 
   ep_write(ep_idx, ep_reg, true);
+
+  if (xfer->dbuf) {
+    // data left in PMA is dropped
+    xfer->dbuf_pending = false;
+    xfer->active = false;
+  }
 }
 
 void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr) {
@@ -805,7 +1045,14 @@ void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr) {
   uint32_t ep_reg = ep_read(ep_idx) | USB_EP_CTR_TX | USB_EP_CTR_RX; // reserve CTR bits
   ep_reg &= USB_EPREG_MASK | EP_STAT_MASK(dir) | EP_DTOG_MASK(dir);
 
-  if (!ep_is_iso(ep_reg)) {
+  if (xfer->dbuf) {
+    // back to VALID with initial buffer ownership, see dcd_edpt_open()
+    tusb_dir_t const other_dir = (tusb_dir_t) (1 - dir);
+    ep_reg &= USB_EPREG_MASK | EP_STAT_MASK(dir) | EP_DTOG_MASK(dir) | EP_DTOG_MASK(other_dir);
+    ep_change_status(&ep_reg, dir, EP_STAT_VALID);
+    ep_change_dtog(&ep_reg, other_dir, dir == TUSB_DIR_IN ? 0 : 1);
+    xfer->dbuf_pending = false;
+  } else if (!ep_is_iso(ep_reg)) {
     ep_change_status(&ep_reg, dir, EP_STAT_NAK);
   }
   ep_change_dtog(&ep_reg, dir, 0); // Reset to DATA0
@@ -816,6 +1063,16 @@ void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr) {
 // PMA read/write
 //--------------------------------------------------------------------+
 
+#if CFG_TUD_FSDEV_DMA_THRESHOLD
+// Copy n_word bus words between PMA and memory aligned to FSDEV_BUS_SIZE, with DMA.
+// PMA must be accessed with FSDEV_BUS_SIZE width and words are sizeof(fsdev_pma_buf_t) apart (every other
+// 16-bit on 512-byte devices). Copy must be complete when returned, return false to fall back to CPU copy.
+TU_ATTR_WEAK bool dcd_fsdev_dma_copy(fsdev_pma_buf_t* pma_buf, void* mem, uint16_t n_word, bool to_pma) {
+  (void) pma_buf; (void) mem; (void) n_word; (void) to_pma;
+  return false;
+}
+#endif
+
 // Write to packet memory area (PMA) from user memory
 // - Packet memory must be either strictly 16-bit or 32-bit depending on FSDEV_BUS_32BIT
 // - Uses unaligned for RAM (since M0 cannot access unaligned address)
@@ -826,10 +1083,37 @@ static bool dcd_write_packet_memory(uint16_t dst, const void *__restrict src, ui
   fsdev_pma_buf_t* pma_buf = PMA_BUF_AT(dst);
   const uint8_t *src8 = src;
 
-  while (n_write--) {
-    pma_buf->value = fsdevbus_unaligned_read(src8);
-    src8 += FSDEV_BUS_SIZE;
-    pma_buf++;
+  if (((uintptr_t) src8 & (FSDEV_BUS_SIZE - 1)) == 0) {
+#if CFG_TUD_FSDEV_DMA_THRESHOLD
+    if (nbytes >= CFG_TUD_FSDEV_DMA_THRESHOLD && dcd_fsdev_dma_copy(pma_buf, (void*) (uintptr_t) src8, (uint16_t) n_write, true)) {
+      pma_buf += n_write;
+      src8 += n_write * FSDEV_BUS_SIZE;
+      n_write = 0;
+    }
+#endif
+
+    // aligned source: bus width load, unrolled since this runs in ISR for every packet
+    fsdev_bus_t const* src_bus = (fsdev_bus_t const*) (uintptr_t) src8;
+    while (n_write >= 4) {
+      pma_buf[0].value = src_bus[0];
+      pma_buf[1].value = src_bus[1];
+      pma_buf[2].value = src_bus[2];
+      pma_buf[3].value = src_bus[3];
+      pma_buf += 4;
+      src_bus += 4;
+      n_write -= 4;
+    }
+    while (n_write--) {
+      pma_buf->value = *src_bus++;
+      pma_buf++;
+    }
+    src8 = (const uint8_t*) src_bus;
+  } else {
+    while (n_write--) {
+      pma_buf->value = fsdevbus_unaligned_read(src8);
+      src8 += FSDEV_BUS_SIZE;
+      pma_buf++;
+    }
   }
 
   // odd bytes e.g 1 for 16-bit or 1-3 for 32-bit
@@ -855,10 +1139,37 @@ static bool dcd_read_packet_memory(void *__restrict dst, uint16_t src, uint16_t
   fsdev_pma_buf_t* pma_buf = PMA_BUF_AT(src);
   uint8_t *dst8 = (uint8_t *)dst;
 
-  while (n_read--) {
-    fsdevbus_unaligned_write(dst8, (fsdev_bus_t ) pma_buf->value);
-    dst8 += FSDEV_BUS_SIZE;
-    pma_buf++;
+  if (((uintptr_t) dst8 & (FSDEV_BUS_SIZE - 1)) == 0) {
+#if CFG_TUD_FSDEV_DMA_THRESHOLD
+    if (nbytes >= CFG_TUD_FSDEV_DMA_THRESHOLD && dcd_fsdev_dma_copy(pma_buf, dst8, (uint16_t) n_read, false)) {
+      pma_buf += n_read;
+      dst8 += n_read * FSDEV_BUS_SIZE;
+      n_read = 0;
+    }
+#endif
+
+    // aligned destination: bus width store, unrolled since this runs in ISR for every packet
+    fsdev_bus_t* dst_bus = (fsdev_bus_t*) (uintptr_t) dst8;
+    while (n_read >= 4) {
+      dst_bus[0] = pma_buf[0].value;
+      dst_bus[1] = pma_buf[1].value;
+      dst_bus[2] = pma_buf[2].value;
+      dst_bus[3] = pma_buf[3].value;
+      pma_buf += 4;
+      dst_bus += 4;
+      n_read -= 4;
+    }
+    while (n_read--) {
+      *dst_bus++ = pma_buf->value;
+      pma_buf++;
+    }
+    dst8 = (uint8_t*) dst_bus;
+  } else {
+    while (n_read--) {
+      fsdevbus_unaligned_write(dst8, (fsdev_bus_t ) pma_buf->value);
+      dst8 += FSDEV_BUS_SIZE;
+      pma_buf++;
+    }
   }
 
   // odd bytes e.g 1 for 16-bit or 1-3 for 32-bit
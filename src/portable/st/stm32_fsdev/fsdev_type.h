@@ -116,6 +116,9 @@ typedef struct {
 
 #define PMA_BUF_AT(_addr) ((fsdev_pma_buf_t*) (FSDEV_PMA_BASE + FSDEV_PMA_STRIDE*(_addr)))
 
+// Optional DMA copy of packet memory, used when CFG_TUD_FSDEV_DMA_THRESHOLD > 0 (weak default returns false)
+bool dcd_fsdev_dma_copy(fsdev_pma_buf_t* pma_buf, void* mem, uint16_t n_word, bool to_pma);
+
 //--------------------------------------------------------------------+
 // Registers Typedef
 //--------------------------------------------------------------------+
@@ -216,6 +219,19 @@ TU_ATTR_ALWAYS_INLINE static inline bool ep_is_iso(uint32_t reg) {
   return (reg & USB_EP_TYPE_MASK) == USB_EP_ISOCHRONOUS;
 }
 
+// Double buffered bulk: DTOG of the unused direction is the SW_BUF flag i.e buffer owned by software.
+// Hardware NAKs when the buffer it is about to use (its DTOG) is owned by software.
+TU_ATTR_ALWAYS_INLINE static inline uint8_t ep_dbuf_sw_buf(uint32_t reg, tusb_dir_t dir) {
+  return (reg & EP_DTOG_MASK(dir == TUSB_DIR_IN ? TUSB_DIR_OUT : TUSB_DIR_IN)) ? 1 : 0;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void ep_dbuf_toggle_sw_buf(uint32_t ep_id, tusb_dir_t dir) {
+  uint32_t reg = ep_read(ep_id) | USB_EP_CTR_TX | USB_EP_CTR_RX; // reserve CTR
+  reg &= USB_EPREG_MASK;
+  reg |= EP_DTOG_MASK(dir == TUSB_DIR_IN ? TUSB_DIR_OUT : TUSB_DIR_IN);
+  ep_write(ep_id, reg, false);
+}
+
 //--------------------------------------------------------------------+
 // BTable Helper
 //--------------------------------------------------------------------+
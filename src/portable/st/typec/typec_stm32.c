@@ -66,6 +66,7 @@ static uint8_t const* _rx_buf;
 static uint8_t const* _tx_pending_buf;
 static uint16_t _tx_pending_bytes;
 static uint16_t _tx_xferring_bytes;
+static bool _tx_good_crc; // GoodCRC is in flight, its completion is not reported to stack
 
 static pd_header_t _good_crc = {
     .msg_type   = PD_CTRL_GOOD_CRC,
@@ -229,6 +230,7 @@ bool tcd_msg_send(uint8_t rhport, uint8_t const* buffer, uint16_t total_bytes) {
     _tx_pending_bytes = 0;
 
     _tx_xferring_bytes = total_bytes;
+    _tx_good_crc = false;
     dma_tx_start(rhport, buffer, total_bytes);
   }
 
@@ -311,6 +313,7 @@ void tcd_int_handler(uint8_t rhport) {
       // TODO move this to usbc stack
       if (_rx_buf) {
         _good_crc.msg_id = ((pd_header_t const *) _rx_buf)->msg_id;
+        _tx_good_crc = true;
         dma_tx_start(rhport, &_good_crc, 2);
       }
 
@@ -340,6 +343,7 @@ void tcd_int_handler(uint8_t rhport) {
     dma_tx_stop(rhport);
 
     uint16_t const xferred_bytes = _tx_xferring_bytes - UCPD1->TX_PAYSZ;
+    bool const was_good_crc = _tx_good_crc;
     uint8_t result;
 
     if ( sr & UCPD_SR_TXMSGSENT ) {
@@ -357,15 +361,21 @@ void tcd_int_handler(uint8_t rhport) {
     // start pending TX if any
     if (_tx_pending_buf && _tx_pending_bytes ) {
       // Start the pending TX
+      _tx_xferring_bytes = _tx_pending_bytes;
+      _tx_good_crc = false;
       dma_tx_start(rhport, _tx_pending_buf, _tx_pending_bytes);
 
       // clear pending
       _tx_pending_buf = NULL;
       _tx_pending_bytes = 0;
+    } else {
+      _tx_good_crc = false;
     }
 
-    // notify stack
-    tcd_event_tx_complete(rhport, xferred_bytes, result, true);
+    // notify stack, GoodCRC is sent by driver on its own
+    if (!was_good_crc) {
+      tcd_event_tx_complete(rhport, xferred_bytes, result, true);
+    }
   }
 }
 
@@ -66,6 +66,11 @@ typedef struct
   pipe_state_t pipe0;
   pipe_state_t pipe[2][7];   /* pipe[direction][endpoint number - 1] */
   uint16_t     pipe_buf_is_fifo[2]; /* Bitmap. Each bit means whether 1:TU_FIFO or 0:POD. */
+#if CFG_TUD_SUNXI_DMA
+  uint16_t     pipe_is_bulk[2]; /* Bitmap. Each bit means pipe may use DMA */
+  uint8_t      dma_ep;  /* Endpoint address owning the USB DRQ and NDMA channel, 0 if none */
+  uint16_t     dma_len; /* Number of bytes programmed into NDMA */
+#endif
 } dcd_data_t;
 
 /*------------------------------------------------------------------
@@ -556,6 +561,164 @@ static void pipe_read_write_packet_ff(tu_fifo_t *f, volatile void *fifo, unsigne
   ops[dir].tu_fifo_advance(f, total_len - rem);
 }
 
+/*------------------------------------------------------------------
+ * DCACHE
+ *------------------------------------------------------------------*/
+#if CFG_TUD_MEM_DCACHE_ENABLE
+// ARM926EJ-S maintenance by MVA of each 32-byte line, followed by drain write buffer
+#define DCACHE_LINE_SIZE  32u
+
+#define DCACHE_OP_RANGE(_crm, _addr, _size)                                                   \
+  do {                                                                                        \
+    uintptr_t _p = (uintptr_t) (_addr) & ~(uintptr_t) (DCACHE_LINE_SIZE - 1);                  \
+    for (; _p < (uintptr_t) (_addr) + (_size); _p += DCACHE_LINE_SIZE) {                       \
+      __asm__ volatile("mcr p15, 0, %0, c7, " #_crm ", 1" : : "r"(_p) : "memory");            \
+    }                                                                                         \
+    __asm__ volatile("mcr p15, 0, %0, c7, c10, 4" : : "r"(0) : "memory");                     \
+  } while (0)
+
+bool dcd_dcache_clean(const void* addr, uint32_t data_size) {
+  DCACHE_OP_RANGE(c10, addr, data_size);
+  return true;
+}
+
+bool dcd_dcache_invalidate(const void* addr, uint32_t data_size) {
+  DCACHE_OP_RANGE(c6, addr, data_size);
+  return true;
+}
+
+bool dcd_dcache_clean_invalidate(const void* addr, uint32_t data_size) {
+  DCACHE_OP_RANGE(c14, addr, data_size);
+  return true;
+}
+#endif
+
+/*------------------------------------------------------------------
+ * DMA
+ * The controller has a single DRQ, routed by VEND0 to one endpoint at a time and served by NDMA channel
+ * CFG_TUD_SUNXI_DMA_CHANNEL. A bulk transfer with word-aligned buffer and more than one packet takes it if it
+ * is free, other transfers and tu_fifo use PIO. DMA moves all packets but the last one in request mode 1 (AutoSet /
+ * AutoClear), the last one is written/read by CPU so that completion is handled as with PIO. A short OUT packet stops
+ * DMA early and is also read by CPU.
+ *------------------------------------------------------------------*/
+#if CFG_TUD_SUNXI_DMA
+
+static void process_edpt_n(uint8_t rhport, uint_fast8_t ep_addr);
+
+// Note: index register is already set by caller
+static bool dma_xfer_start(uint8_t ep_addr, uint8_t *buffer, uint16_t total_bytes)
+{
+  unsigned const epnum  = tu_edpt_number(ep_addr);
+  unsigned const dir_in = tu_edpt_dir(ep_addr);
+  unsigned const ch     = CFG_TUD_SUNXI_DMA_CHANNEL;
+
+  if (_dcd.dma_ep || !(_dcd.pipe_is_bulk[dir_in] & TU_BIT(epnum - 1)) || ((uintptr_t) buffer & 3)) return false;
+
+  u32 const fifo = USBC_REG_EPFIFO1(USBC0_BASE) + ((epnum - 1) << 2);
+  u32 cfg = NDMA_CFG_LOADING | NDMA_CFG_BC_REMAIN |
+            NDMA_CFG_SRC_BURST_4 | NDMA_CFG_SRC_WIDTH_32 | NDMA_CFG_DST_BURST_4 | NDMA_CFG_DST_WIDTH_32;
+  u32 src, dst;
+  unsigned dma_len;
+
+  if (dir_in) {
+    unsigned const mps = USBC_Readw(USBC_REG_TXMAXP(USBC0_BASE));
+    if (total_bytes <= mps) return false; // single packet, PIO is faster
+    dma_len = total_bytes - ((total_bytes % mps) ? (total_bytes % mps) : mps);
+    dcd_dcache_clean(buffer, dma_len);
+
+    USBC_REG_set_bit_w(USBC_BP_TXCSR_D_AUTOSET, USBC_REG_TXCSR(USBC0_BASE));
+    USBC_REG_set_bit_w(USBC_BP_TXCSR_D_DMA_REQ_MODE, USBC_REG_TXCSR(USBC0_BASE));
+    USBC_REG_set_bit_w(USBC_BP_TXCSR_D_DMA_REQ_EN, USBC_REG_TXCSR(USBC0_BASE));
+    USBC_SelectBus(USBC_IO_TYPE_DMA, USBC_EP_TYPE_TX, epnum);
+
+    src  = (u32) (uintptr_t) buffer;
+    dst  = fifo;
+    cfg |= NDMA_CFG_SRC_DRQ(NDMA_DRQ_SDRAM) | NDMA_CFG_DST_DRQ(NDMA_DRQ_USB) | NDMA_CFG_DST_ADDR_IO;
+  } else {
+    unsigned const mps = USBC_Readw(USBC_REG_RXMAXP(USBC0_BASE));
+    if (total_bytes < 2*mps || (total_bytes % mps)) return false;
+    dma_len = total_bytes - mps;
+    dcd_dcache_invalidate(buffer, dma_len);
+
+    USBC_REG_set_bit_w(USBC_BP_RXCSR_D_AUTO_CLEAR, USBC_REG_RXCSR(USBC0_BASE));
+    USBC_REG_set_bit_w(USBC_BP_RXCSR_D_DMA_REQ_MODE, USBC_REG_RXCSR(USBC0_BASE));
+    USBC_REG_set_bit_w(USBC_BP_RXCSR_D_DMA_REQ_EN, USBC_REG_RXCSR(USBC0_BASE));
+    USBC_SelectBus(USBC_IO_TYPE_DMA, USBC_EP_TYPE_RX, epnum);
+
+    src  = fifo;
+    dst  = (u32) (uintptr_t) buffer;
+    cfg |= NDMA_CFG_SRC_DRQ(NDMA_DRQ_USB) | NDMA_CFG_SRC_ADDR_IO | NDMA_CFG_DST_DRQ(NDMA_DRQ_SDRAM);
+  }
+
+  _dcd.dma_ep  = ep_addr;
+  _dcd.dma_len = (uint16_t) dma_len;
+
+  USBC_Writel(NDMA_INT_END(ch), NDMA_INT_STA_REG);
+  USBC_Writel(USBC_Readl(NDMA_INT_CTRL_REG) | NDMA_INT_END(ch), NDMA_INT_CTRL_REG);
+  USBC_Writel(src, NDMA_SRC_ADR_REG(ch));
+  USBC_Writel(dst, NDMA_DES_ADR_REG(ch));
+  USBC_Writel(dma_len, NDMA_BYTE_CNT_REG(ch));
+  USBC_Writel(cfg, NDMA_CFG_REG(ch));
+
+  return true;
+}
+
+// Stop DMA and hand the rest of transfer over to CPU. Note: index register is already set by caller
+static void dma_xfer_stop(void)
+{
+  uint8_t const  ep_addr = _dcd.dma_ep;
+  unsigned const dir_in  = tu_edpt_dir(ep_addr);
+  unsigned const ch      = CFG_TUD_SUNXI_DMA_CHANNEL;
+  pipe_state_t  *pipe    = &_dcd.pipe[dir_in][tu_edpt_number(ep_addr) - 1];
+
+  unsigned const remain = USBC_Readl(NDMA_BYTE_CNT_REG(ch)) & 0x3FFFF;
+  USBC_Writel(0, NDMA_CFG_REG(ch));
+  USBC_Writel(USBC_Readl(NDMA_INT_CTRL_REG) & ~NDMA_INT_END(ch), NDMA_INT_CTRL_REG);
+  USBC_Writel(NDMA_INT_END(ch), NDMA_INT_STA_REG);
+
+  if (dir_in) {
+    USBC_REG_clear_bit_w(USBC_BP_TXCSR_D_AUTOSET, USBC_REG_TXCSR(USBC0_BASE));
+    USBC_REG_clear_bit_w(USBC_BP_TXCSR_D_DMA_REQ_EN, USBC_REG_TXCSR(USBC0_BASE));
+    USBC_REG_clear_bit_w(USBC_BP_TXCSR_D_DMA_REQ_MODE, USBC_REG_TXCSR(USBC0_BASE)); // must be cleared after DMA_REQ_EN
+  } else {
+    USBC_REG_clear_bit_w(USBC_BP_RXCSR_D_AUTO_CLEAR, USBC_REG_RXCSR(USBC0_BASE));
+    USBC_REG_clear_bit_w(USBC_BP_RXCSR_D_DMA_REQ_EN, USBC_REG_RXCSR(USBC0_BASE));
+    USBC_REG_clear_bit_w(USBC_BP_RXCSR_D_DMA_REQ_MODE, USBC_REG_RXCSR(USBC0_BASE)); // must be cleared after DMA_REQ_EN
+  }
+  USBC_SelectBus(USBC_IO_TYPE_PIO, 0, 0);
+
+  unsigned const xferred = _dcd.dma_len - TU_MIN(remain, _dcd.dma_len);
+  if (!dir_in) dcd_dcache_invalidate(pipe->buf, xferred);
+  pipe->buf        = (uint8_t*) pipe->buf + xferred;
+  pipe->remaining -= (uint16_t) xferred;
+  _dcd.dma_ep      = 0;
+}
+
+static void dma_isr_handler(void)
+{
+  unsigned const ch = CFG_TUD_SUNXI_DMA_CHANNEL;
+  if (!(USBC_Readl(NDMA_INT_STA_REG) & NDMA_INT_END(ch))) return;
+  USBC_Writel(NDMA_INT_END(ch), NDMA_INT_STA_REG);
+
+  uint8_t const ep_addr = _dcd.dma_ep;
+  if (!ep_addr) return; // already stopped by short packet
+
+  u8 const old_ep = USBC_GetActiveEp();
+  USBC_SelectActiveEp(tu_edpt_number(ep_addr));
+  dma_xfer_stop();
+  if (tu_edpt_dir(ep_addr)) {
+    // last packet is written once the one loaded by DMA has left the FIFO
+    if (!USBC_REG_test_bit_w(USBC_BP_TXCSR_D_TX_READY, USBC_REG_TXCSR(USBC0_BASE))) process_edpt_n(0, ep_addr);
+  } else if (__USBC_Dev_Rx_IsReadDataReady()) {
+    // NDMA end interrupt is raised once its byte count is read from FIFO, but endpoint keeps DRQ until dma_xfer_stop().
+    // RX interrupt of the last packet arriving in between is left to DMA by process_edpt_n(), read it now
+    process_edpt_n(0, ep_addr);
+  }
+  USBC_SelectActiveEp(old_ep);
+}
+
+#endif
+
 /*------------------------------------------------------------------
  * TRANSFER FUNCTION DECLARATION
  *------------------------------------------------------------------*/
@@ -653,6 +816,14 @@ static bool edpt_n_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16
 
   USBC_SelectActiveEp(tu_edpt_number(ep_addr));
 
+#if CFG_TUD_SUNXI_DMA
+  if (!(_dcd.pipe_buf_is_fifo[dir_in] & TU_BIT(epnum_minus1)) && dma_xfer_start(ep_addr, buffer, total_bytes)) {
+    if (!dir_in && __USBC_Dev_Rx_IsReadDataReady())
+      __USBC_Dev_Rx_ReadDataComplete();
+    return true;
+  }
+#endif
+
   if (dir_in) {
     handle_xfer_in(ep_addr);
   } else {
@@ -826,6 +997,10 @@ static void process_edpt_n(uint8_t rhport, uint_fast8_t ep_addr)
 	  __USBC_Dev_Tx_ClearStall();
       return;
     }
+#if CFG_TUD_SUNXI_DMA
+    // packets are loaded by DMA, or the last one of DMA is not sent yet
+    if (_dcd.dma_ep == ep_addr || USBC_REG_test_bit_w(USBC_BP_TXCSR_D_TX_READY, USBC_REG_TXCSR(USBC0_BASE))) return;
+#endif
     completed = handle_xfer_in(ep_addr);
   } else {
     // TU_LOG1(" RXCSRL%d = %x\r\n", epn_minus1 + 1, regs->RXCSRL);
@@ -833,6 +1008,14 @@ static void process_edpt_n(uint8_t rhport, uint_fast8_t ep_addr)
 	    __USBC_Dev_Rx_ClearStall();
       return;
     }
+#if CFG_TUD_SUNXI_DMA
+    if (_dcd.dma_ep == ep_addr) {
+      // full packet is left to DMA, short packet stops it and is read by CPU
+      if (!__USBC_Dev_Rx_IsReadDataReady() ||
+          USBC_Readw(USBC_REG_RXCOUNT(USBC0_BASE)) >= USBC_Readw(USBC_REG_RXMAXP(USBC0_BASE))) return;
+      dma_xfer_stop();
+    }
+#endif
     completed = handle_xfer_out(ep_addr);
   }
 
@@ -856,6 +1039,14 @@ static void process_bus_reset(uint8_t rhport)
   USBC_Writew(1, USBC_REG_INTTxE(USBC0_BASE)); /* Enable only EP0 */
   USBC_Writew(0, USBC_REG_INTRxE(USBC0_BASE));
 
+#if CFG_TUD_SUNXI_DMA
+  if (_dcd.dma_ep) {
+    USBC_SelectActiveEp(tu_edpt_number(_dcd.dma_ep));
+    dma_xfer_stop();
+    USBC_SelectActiveEp(0);
+  }
+#endif
+
   dcd_event_bus_reset(rhport, USBC_Dev_QueryTransferMode(), true);
 }
 
@@ -894,6 +1085,10 @@ bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
     , USBC_REG_INTUSBE(USBC0_BASE));
   f1c100s_intc_clear_pend(F1C100S_IRQ_USBOTG);
   f1c100s_intc_set_isr(F1C100S_IRQ_USBOTG, usb_isr_handler);
+#if CFG_TUD_SUNXI_DMA
+  f1c100s_intc_clear_pend(F1C100S_IRQ_DMA);
+  f1c100s_intc_set_isr(F1C100S_IRQ_DMA, dma_isr_handler);
+#endif
 
   dcd_connect(rhport);
 
@@ -926,22 +1121,34 @@ void dcd_int_enable(uint8_t rhport)
 {
   (void)rhport;
   f1c100s_intc_enable_irq(F1C100S_IRQ_USBOTG);
+#if CFG_TUD_SUNXI_DMA
+  f1c100s_intc_enable_irq(F1C100S_IRQ_DMA);
+#endif
 }
 
 static void musb_int_mask(void)
 {
   f1c100s_intc_mask_irq(F1C100S_IRQ_USBOTG);
+#if CFG_TUD_SUNXI_DMA
+  f1c100s_intc_mask_irq(F1C100S_IRQ_DMA);
+#endif
 }
 
 void dcd_int_disable(uint8_t rhport)
 {
   (void)rhport;
   f1c100s_intc_disable_irq(F1C100S_IRQ_USBOTG);
+#if CFG_TUD_SUNXI_DMA
+  f1c100s_intc_disable_irq(F1C100S_IRQ_DMA);
+#endif
 }
 
 static void musb_int_unmask(void)
 {
   f1c100s_intc_unmask_irq(F1C100S_IRQ_USBOTG);
+#if CFG_TUD_SUNXI_DMA
+  f1c100s_intc_unmask_irq(F1C100S_IRQ_DMA);
+#endif
 }
 
 // Receive Set Address request, mcu port must also include status IN response
@@ -996,6 +1203,14 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * ep_desc)
 
   musb_int_mask();
 
+#if CFG_TUD_SUNXI_DMA
+  if (xfer == TUSB_XFER_BULK) {
+    _dcd.pipe_is_bulk[dir_in] |= TU_BIT(epn - 1);
+  } else {
+    _dcd.pipe_is_bulk[dir_in] &= ~TU_BIT(epn - 1);
+  }
+#endif
+
   // volatile hw_endpoint_t *regs = edpt_regs(epn - 1);
   USBC_SelectActiveEp(epn);
   if (dir_in) {
@@ -1046,6 +1261,12 @@ void dcd_edpt_close_all(uint8_t rhport)
   musb_int_mask();
   USBC_Writew(1, USBC_REG_INTTxE(USBC0_BASE)); /* Enable only EP0 */
   USBC_Writew(0, USBC_REG_INTRxE(USBC0_BASE));
+#if CFG_TUD_SUNXI_DMA
+  if (_dcd.dma_ep) {
+    USBC_SelectActiveEp(tu_edpt_number(_dcd.dma_ep));
+    dma_xfer_stop();
+  }
+#endif
   for (unsigned i = 1; i < TUP_DCD_ENDPOINT_MAX; ++i) {
     USBC_SelectActiveEp(i);
     USBC_Writew(0, USBC_REG_TXMAXP(USBC0_BASE));
@@ -1072,6 +1293,9 @@ void dcd_edpt_close(uint8_t rhport, uint8_t ep_addr)
 
   musb_int_mask();
   USBC_SelectActiveEp(epn);
+#if CFG_TUD_SUNXI_DMA
+  if (_dcd.dma_ep == ep_addr) dma_xfer_stop();
+#endif
   if (dir_in) {
     USBC_INT_DisableTxEp(epn);
     USBC_Writew(0, USBC_REG_TXMAXP(USBC0_BASE));
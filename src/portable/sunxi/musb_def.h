@@ -106,7 +106,30 @@
 
 //#define USB_INTR
 
-#define NDMA_CFG_REG
+// Normal DMA (NDMA) controller, used with the USB DRQ for bulk transfers
+#define NDMA_BASE                  0x01C02000
+#define NDMA_INT_CTRL_REG          (NDMA_BASE + 0x00)
+#define NDMA_INT_STA_REG           (NDMA_BASE + 0x04)
+#define NDMA_CFG_REG(ch)           (NDMA_BASE + 0x100 + (ch) * 0x20)
+#define NDMA_SRC_ADR_REG(ch)       (NDMA_BASE + 0x104 + (ch) * 0x20)
+#define NDMA_DES_ADR_REG(ch)       (NDMA_BASE + 0x108 + (ch) * 0x20)
+#define NDMA_BYTE_CNT_REG(ch)      (NDMA_BASE + 0x10C + (ch) * 0x20)
+
+#define NDMA_INT_END(ch)           (1u << ((ch) * 2 + 1))
+
+#define NDMA_CFG_SRC_DRQ(type)     ((type) << 0)
+#define NDMA_CFG_SRC_ADDR_IO       (1u << 5)
+#define NDMA_CFG_SRC_BURST_4       (1u << 8)
+#define NDMA_CFG_SRC_WIDTH_32      (2u << 9)
+#define NDMA_CFG_BC_REMAIN         (1u << 15) // byte counter reads back remaining bytes
+#define NDMA_CFG_DST_DRQ(type)     ((type) << 16)
+#define NDMA_CFG_DST_ADDR_IO       (1u << 21)
+#define NDMA_CFG_DST_BURST_4       (1u << 24)
+#define NDMA_CFG_DST_WIDTH_32      (2u << 25)
+#define NDMA_CFG_LOADING           (1u << 31)
+
+#define NDMA_DRQ_USB               0x04
+#define NDMA_DRQ_SDRAM             0x11
 //-----------------------------------------------------------------------
 //   musb reg offset
 //-----------------------------------------------------------------------
@@ -35,10 +35,15 @@
 #error DWC2 require either CFG_TUD_DWC2_SLAVE_ENABLE or CFG_TUD_DWC2_DMA_ENABLE to be enabled
 #endif
 
+#if CFG_TUD_DWC2_DMA_DESC_ENABLE && !CFG_TUD_DWC2_DMA_ENABLE
+#error CFG_TUD_DWC2_DMA_DESC_ENABLE require CFG_TUD_DWC2_DMA_ENABLE
+#endif
+
 // Debug level for DWC2
 #define DWC2_DEBUG    2
 
 #include "device/dcd.h"
+#include "device/usbd.h"
 #include "dwc2_common.h"
 
 #if TU_CHECK_MCU(OPT_MCU_GD32VF103)
@@ -56,46 +61,108 @@ typedef struct {
   uint16_t total_len;
   uint16_t max_size;
   uint8_t interval;
+  uint8_t mult; // transactions per micro-frame, more than 1 for high-bandwidth periodic endpoint
 } xfer_ctl_t;
 
-static xfer_ctl_t xfer_status[DWC2_EP_MAX][2];
+TU_ATTR_FAST_DATA static xfer_ctl_t xfer_status[DWC2_EP_MAX][2];
 #define XFER_CTL_BASE(_ep, _dir) (&xfer_status[_ep][_dir])
 
 typedef struct {
   // EP0 transfers are limited to 1 packet - larger sizes has to be split
   uint16_t ep0_pending[2];  // Index determines direction as tusb_dir_t type
   uint16_t dfifo_top;      // top free location in DFIFO in words
+  uint16_t dfifo_planned;  // bitmap of IN endpoints whose TX FIFO is allocated by dcd_edpt_plan()
 
   // Number of IN endpoints active
   uint8_t allocated_epin_count;
 
   // SOF enabling flag - required for SOF to not get disabled in ISR when SOF was enabled by
   bool sof_en;
+
+#if CFG_TUD_DWC2_ASYNC_INIT
+  // core init is waiting for soft reset, dcd_disconnect() meanwhile is applied when init is complete
+  bool init_pending;
+  bool init_disconnected;
+#endif
+
+#if CFG_TUD_DWC2_DMA_DESC_ENABLE
+  // direction of control status stage, setup packet is re-armed when it is complete
+  uint8_t ep0_status_dir;
+#endif
+
+#if CFG_TUD_DWC2_SUSPEND_CLOCK_GATE
+  bool clock_gated; // PHY clock is stopped and HCLK gated during suspend
+#endif
+
+#if CFG_TUD_DWC2_SLAVE_ENABLE && CFG_TUD_DWC2_SLAVE_ISR_BUDGET
+  // packets left to be moved by current dcd_int_handler(), the rest is deferred to slave_fifo_deferred()
+  uint16_t isr_budget;
+  uint16_t txfe_deferred; // bitmap of IN endpoints whose TXFE interrupt is masked until deferred FIFO write
+  bool rxflvl_deferred;   // RXFLVL interrupt is masked until deferred FIFO read
+  bool fifo_deferred;     // slave_fifo_deferred() is queued
+#endif
 } dcd_data_t;
 
-static dcd_data_t _dcd_data;
+TU_ATTR_FAST_DATA static dcd_data_t _dcd_data;
+
+// DTHRCTL value set by dcd_configure(), programmed by device_init() in DMA mode
+static uint32_t _dcd_dthrctl;
 
 CFG_TUD_MEM_SECTION static struct {
   TUD_EPBUF_DEF(setup_packet, 8);
 } _dcd_usbbuf;
 
+#if CFG_TUD_DWC2_DMA_DESC_ENABLE
+// Scatter/Gather DMA: a descriptor list per endpoint direction. 2 descriptors are enough for the largest transfer
+// (64KB) since non-last descriptor (and OUT descriptor) size must be multiple of packet size. dcd_edpt_xfer_sg()
+// needs at least one descriptor per buffer.
+#ifndef CFG_TUD_DWC2_DMA_DESC_PER_EP
+  #define CFG_TUD_DWC2_DMA_DESC_PER_EP  (CFG_TUD_EDPT_XFER_SG ? 8 : 2)
+#endif
+
+TU_VERIFY_STATIC(CFG_TUD_DWC2_DMA_DESC_PER_EP >= 2 && CFG_TUD_DWC2_DMA_DESC_PER_EP <= 255, "invalid descriptor count");
+
+typedef struct {
+  dwc2_ddma_desc_t desc[CFG_TUD_DWC2_DMA_DESC_PER_EP];
+} ddma_desc_list_t;
+
+// each list is in its own cache line since it is written by both CPU and DMA
+typedef TUD_EPBUF_TYPE_DEF(ddma_desc_list_t, list) ddma_epbuf_t;
+
+CFG_TUD_MEM_SECTION static ddma_epbuf_t _dcd_ddma[DWC2_EP_MAX][2];
+
+// queued bytes of each descriptor since hardware overwrites it with remaining bytes
+typedef struct {
+  uint32_t total_len;
+  uint16_t nbytes[CFG_TUD_DWC2_DMA_DESC_PER_EP];
+  uint8_t count;
+} ddma_xfer_t;
+
+static ddma_xfer_t _ddma_xfer[DWC2_EP_MAX][2];
+#endif
+
 //--------------------------------------------------------------------
 // DMA
 //--------------------------------------------------------------------
 #if CFG_TUD_MEM_DCACHE_ENABLE
+// no maintenance needed for buffer in non-cacheable memory
+TU_ATTR_ALWAYS_INLINE static inline bool dcache_skip(const void* addr, uint32_t data_size) {
+  return tu_mem_within(addr, data_size, CFG_TUD_MEM_NONCACHEABLE_ADDR, CFG_TUD_MEM_NONCACHEABLE_SIZE);
+}
+
 bool dcd_dcache_clean(const void* addr, uint32_t data_size) {
   TU_VERIFY(addr && data_size);
-  return dwc2_dcache_clean(addr, data_size);
+  return dcache_skip(addr, data_size) || dwc2_dcache_clean(addr, data_size);
 }
 
 bool dcd_dcache_invalidate(const void* addr, uint32_t data_size) {
   TU_VERIFY(addr && data_size);
-  return dwc2_dcache_invalidate(addr, data_size);
+  return dcache_skip(addr, data_size) || dwc2_dcache_invalidate(addr, data_size);
 }
 
 bool dcd_dcache_clean_invalidate(const void* addr, uint32_t data_size) {
   TU_VERIFY(addr && data_size);
-  return dwc2_dcache_clean_invalidate(addr, data_size);
+  return dcache_skip(addr, data_size) || dwc2_dcache_clean_invalidate(addr, data_size);
 }
 #endif
 
@@ -105,15 +172,35 @@ TU_ATTR_ALWAYS_INLINE static inline bool dma_device_enabled(const dwc2_regs_t* d
   return CFG_TUD_DWC2_DMA_ENABLE && dwc2->ghwcfg2_bm.arch == GHWCFG2_ARCH_INTERNAL_DMA;
 }
 
+// Scatter/Gather DMA, only if configured in core
+TU_ATTR_ALWAYS_INLINE static inline bool dma_desc_enabled(const dwc2_regs_t* dwc2) {
+  return CFG_TUD_DWC2_DMA_DESC_ENABLE && dma_device_enabled(dwc2) && dwc2->ghwcfg4_bm.dma_desc_enabled;
+}
+
 static void dma_setup_prepare(uint8_t rhport) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
-  if (dwc2->gsnpsid >= DWC2_CORE_REV_3_00a) {
+  if (dwc2->gsnpsid >= DWC2_CORE_REV_3_00a || dma_desc_enabled(dwc2)) {
     if(dwc2->epout[0].doepctl & DOEPCTL_EPENA) {
       return;
     }
   }
 
+#if CFG_TUD_DWC2_DMA_DESC_ENABLE
+  if (dma_desc_enabled(dwc2)) {
+    // single descriptor for setup packet
+    dwc2_ddma_desc_t* desc = _dcd_ddma[0][TUSB_DIR_OUT].list.desc;
+    desc->buf = (uint32_t) (uintptr_t) _dcd_usbbuf.setup_packet;
+    desc->status = DDMA_DESC_BS_HOST_READY | DDMA_DESC_L | DDMA_DESC_IOC | 8;
+    dcd_dcache_clean(desc, sizeof(dwc2_ddma_desc_t));
+
+    dwc2->epout[0].doeptsiz = (1 << DOEPTSIZ_STUPCNT_Pos);
+    dwc2->epout[0].doepdma = (uintptr_t) desc;
+    dwc2->epout[0].doepctl |= DOEPCTL_EPENA | DOEPCTL_USBAEP;
+    return;
+  }
+#endif
+
   // Receive only 1 packet
   dwc2->epout[0].doeptsiz = (1 << DOEPTSIZ_STUPCNT_Pos) | (1 << DOEPTSIZ_PKTCNT_Pos) | (8 << DOEPTSIZ_XFRSIZ_Pos);
   dwc2->epout[0].doepdma = (uintptr_t) _dcd_usbbuf.setup_packet;
@@ -165,6 +252,11 @@ static void dma_setup_prepare(uint8_t rhport) {
     - 2 for each used OUT endpoint
 
     Therefore GRXFSIZ = 13 + 1 + 2 x (Largest-EPsize/4 + 1) + 2 x EPOUTnum
+
+  When SET_CONFIGURATION is received, dcd_edpt_plan() sizes the FIFOs for the whole configuration at once, using the
+  largest packet of each endpoint across all alternate settings. Bulk IN gets 2 packets if space allows, high-bandwidth
+  ISO/Interrupt gets all transactions of a microframe. Endpoints re-opened by SET_INTERFACE then reuse their planned
+  TX FIFO. If the configuration does not fit, FIFOs are allocated on open as above.
 */
 
 TU_ATTR_ALWAYS_INLINE static inline uint16_t calc_device_grxfsiz(uint16_t largest_ep_size, uint8_t ep_count) {
@@ -182,8 +274,14 @@ static bool dfifo_alloc(uint8_t rhport, uint8_t ep_addr, uint16_t packet_size) {
 
   uint16_t fifo_size = tu_div_ceil(packet_size, 4);
   if (dir == TUSB_DIR_OUT) {
-    // Calculate required size of RX FIFO
-    const uint16_t new_sz = calc_device_grxfsiz(4 * fifo_size, ep_count);
+    // Calculate required size of RX FIFO. Larger than 1024 is a high-bandwidth micro-frame: room for all of its
+    // transactions (and their status words) instead of 2 packets, same as dcd_edpt_plan()
+    uint16_t new_sz;
+    if (packet_size > 1024) {
+      new_sz = tu_max16(calc_device_grxfsiz(1024, ep_count), (uint16_t) (13 + 1 + fifo_size + 3 + 2 * ep_count));
+    } else {
+      new_sz = calc_device_grxfsiz(4 * fifo_size, ep_count);
+    }
 
     // If size_rx needs to be extended check if there is enough free space
     if (dwc2->grxfsiz < new_sz) {
@@ -191,17 +289,23 @@ static bool dfifo_alloc(uint8_t rhport, uint8_t ep_addr, uint16_t packet_size) {
       dwc2->grxfsiz = new_sz; // Enlarge RX FIFO
     }
   } else {
+    // If The TXFELVL is configured as half empty, the fifo must be twice the max_size.
+    if ((dwc2->gahbcfg & GAHBCFG_TX_FIFO_EPMTY_LVL) == 0) {
+      fifo_size *= 2;
+    }
+
+    // TX FIFO is already allocated (and counted) by planner
+    if (tu_bit_test(_dcd_data.dfifo_planned, epnum)) {
+      TU_ASSERT(fifo_size <= (dwc2->dieptxf[epnum - 1] >> DIEPTXF_INEPTXFD_Pos));
+      return true;
+    }
+
     // Check IN endpoints concurrently active limit
     if(dwc2_controller->ep_in_count) {
       TU_ASSERT(_dcd_data.allocated_epin_count < dwc2_controller->ep_in_count);
       _dcd_data.allocated_epin_count++;
     }
 
-    // If The TXFELVL is configured as half empty, the fifo must be twice the max_size.
-    if ((dwc2->gahbcfg & GAHBCFG_TX_FIFO_EPMTY_LVL) == 0) {
-      fifo_size *= 2;
-    }
-
     // Check if free space is available
     TU_ASSERT(_dcd_data.dfifo_top >= fifo_size + dwc2->grxfsiz);
     _dcd_data.dfifo_top -= fifo_size;
@@ -224,18 +328,147 @@ static void dfifo_device_init(uint8_t rhport) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
   dwc2->grxfsiz = calc_device_grxfsiz(CFG_TUD_ENDPOINT0_SIZE, dwc2_controller->ep_count);
 
-  // Scatter/Gather DMA mode is not yet supported. Buffer DMA only need 1 words per endpoint direction
+  // EPInfo: Buffer DMA need 1 word, Scatter/Gather DMA need 4 words per endpoint direction
   const bool is_dma = dma_device_enabled(dwc2);
   _dcd_data.dfifo_top = dwc2_controller->ep_fifo_size/4;
   if (is_dma) {
-    _dcd_data.dfifo_top -= 2 * dwc2_controller->ep_count;
+    _dcd_data.dfifo_top -= (dma_desc_enabled(dwc2) ? 8 : 2) * dwc2_controller->ep_count;
   }
   dwc2->gdfifocfg = (_dcd_data.dfifo_top << GDFIFOCFG_EPINFOBASE_SHIFT) | _dcd_data.dfifo_top;
+  _dcd_data.dfifo_planned = 0;
 
   // Allocate FIFO for EP0 IN
   dfifo_alloc(rhport, 0x80, CFG_TUD_ENDPOINT0_SIZE);
 }
 
+// Program RX FIFO size and TX FIFO of IN endpoints (in words) below EP0 TX FIFO, return false if they do not fit
+static bool dfifo_plan_apply(uint8_t rhport, uint16_t rx_size, uint16_t const tx_size[DWC2_EP_MAX]) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  const dwc2_controller_t* dwc2_controller = &_dwc2_controller[rhport];
+  const uint8_t ep_count = dwc2_controller->ep_count;
+
+  uint32_t tx_total = 0;
+  uint8_t epin_count = 0;
+  for (uint8_t epnum = 1; epnum < ep_count; epnum++) {
+    if (tx_size[epnum]) {
+      tx_total += tx_size[epnum];
+      epin_count++;
+    }
+  }
+
+  TU_VERIFY(!dwc2_controller->ep_in_count || _dcd_data.allocated_epin_count + epin_count <= dwc2_controller->ep_in_count);
+  TU_VERIFY(rx_size + tx_total <= _dcd_data.dfifo_top);
+
+  dwc2->grxfsiz = rx_size;
+  for (uint8_t epnum = 1; epnum < ep_count; epnum++) {
+    if (tx_size[epnum]) {
+      _dcd_data.dfifo_top -= tx_size[epnum];
+      dwc2->dieptxf[epnum - 1] = ((uint32_t) tx_size[epnum] << DIEPTXF_INEPTXFD_Pos) | _dcd_data.dfifo_top;
+      _dcd_data.dfifo_planned |= TU_BIT(epnum);
+      _dcd_data.allocated_epin_count++;
+    }
+  }
+
+  return true;
+}
+
+// Allocate DFIFO from static layout of application: entry 0x00 is RX FIFO, IN entries are TX FIFOs. Offsets are not
+// used since EP0 TX FIFO and DMA EPInfo are placed by dcd, TX FIFOs are stacked below them in endpoint order.
+bool dcd_edpt_mem_plan(uint8_t rhport, tu_edpt_mem_t const* mem, uint8_t count) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  const uint8_t ep_count = _dwc2_controller[rhport].ep_count;
+  uint16_t tx_size[DWC2_EP_MAX] = {0};
+  uint16_t rx_size = dwc2->grxfsiz;
+
+  for (uint8_t i = 0; i < count; i++) {
+    const uint8_t epnum = tu_edpt_number(mem[i].ep_addr);
+    TU_VERIFY(epnum < ep_count);
+    if (mem[i].ep_addr == 0x00) {
+      rx_size = tu_max16(rx_size, tu_div_ceil(mem[i].size, 4));
+    } else if (tu_edpt_dir(mem[i].ep_addr) == TUSB_DIR_IN && epnum) {
+      tx_size[epnum] = tu_div_ceil(mem[i].size, 4);
+    }
+  }
+
+  if (!dfifo_plan_apply(rhport, rx_size, tx_size)) {
+    TU_LOG(DWC2_DEBUG, "  DFIFO static plan does not fit\r\n");
+    return false;
+  }
+  return true;
+}
+
+// Allocate DFIFO for all endpoints of configuration, called before any of its endpoints is opened
+void dcd_edpt_plan(uint8_t rhport, tusb_desc_configuration_t const* desc_cfg) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  const dwc2_controller_t* dwc2_controller = &_dwc2_controller[rhport];
+  const uint8_t ep_count = dwc2_controller->ep_count;
+
+  uint16_t tx_size[DWC2_EP_MAX] = {0}; // in words
+  uint16_t tx_extra[DWC2_EP_MAX] = {0}; // 2nd packet for bulk
+  uint16_t rx_largest = CFG_TUD_ENDPOINT0_SIZE;
+  uint16_t rx_hb_size = 0; // all transactions of a microframe for high-bandwidth OUT
+
+  // largest packet of each endpoint across all interfaces and alternate settings
+  uint8_t const* p_desc = (uint8_t const*) desc_cfg;
+  uint8_t const* desc_end = p_desc + tu_le16toh(desc_cfg->wTotalLength);
+  for (; p_desc < desc_end; p_desc = tu_desc_next(p_desc)) {
+    if (tu_desc_type(p_desc) != TUSB_DESC_ENDPOINT) {
+      continue;
+    }
+    tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+    const uint8_t epnum = tu_edpt_number(desc_ep->bEndpointAddress);
+    const uint16_t packet_size = tu_edpt_packet_size(desc_ep);
+    const bool is_bulk = (desc_ep->bmAttributes.xfer == TUSB_XFER_BULK);
+    const uint8_t mult = is_bulk ? 1 : tu_edpt_hs_mult(desc_ep);
+
+    if (epnum == 0 || epnum >= ep_count) {
+      continue; // opening it will fail anyway
+    }
+
+    if (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_OUT) {
+      rx_largest = tu_max16(rx_largest, packet_size);
+      if (mult > 1) {
+        rx_hb_size = tu_max16(rx_hb_size, mult * (packet_size / 4 + 1));
+      }
+    } else {
+      uint16_t fifo_size = tu_div_ceil(packet_size, 4);
+      if ((dwc2->gahbcfg & GAHBCFG_TX_FIFO_EPMTY_LVL) == 0) {
+        fifo_size *= 2; // same as dfifo_alloc()
+      }
+      tx_size[epnum] = tu_max16(tx_size[epnum], mult * fifo_size);
+      if (is_bulk) {
+        tx_extra[epnum] = tu_max16(tx_extra[epnum], fifo_size);
+      }
+    }
+  }
+
+  uint16_t rx_size = calc_device_grxfsiz(rx_largest, ep_count);
+  rx_size = tu_max16(rx_size, 13 + 1 + rx_hb_size + 2 * ep_count);
+  rx_size = tu_max16(rx_size, dwc2->grxfsiz);
+
+  uint32_t tx_total = 0;
+  for (uint8_t epnum = 1; epnum < ep_count; epnum++) {
+    tx_total += tx_size[epnum];
+  }
+
+  // double buffer bulk IN with the remaining space, lower endpoint number first
+  if (rx_size + tx_total <= _dcd_data.dfifo_top) {
+    uint16_t free_size = (uint16_t) (_dcd_data.dfifo_top - rx_size - tx_total);
+    for (uint8_t epnum = 1; epnum < ep_count; epnum++) {
+      if (tx_extra[epnum] && tx_extra[epnum] <= free_size) {
+        tx_size[epnum] += tx_extra[epnum];
+        free_size -= tx_extra[epnum];
+      }
+    }
+  }
+
+  // does not fit: allocated on open instead, which will fail on the endpoint that is out of space
+  if (!dfifo_plan_apply(rhport, rx_size, tx_size)) {
+    TU_LOG(DWC2_DEBUG, "  DFIFO plan: %lu words needed, %u available\r\n", (unsigned long) (rx_size + tx_total),
+           _dcd_data.dfifo_top);
+  }
+}
+
 
 //--------------------------------------------------------------------
 // Endpoint
@@ -248,6 +481,7 @@ static void edpt_activate(uint8_t rhport, const tusb_desc_endpoint_t* p_endpoint
   xfer_ctl_t* xfer = XFER_CTL_BASE(epnum, dir);
   xfer->max_size = tu_edpt_packet_size(p_endpoint_desc);
   xfer->interval = p_endpoint_desc->bInterval;
+  xfer->mult = (p_endpoint_desc->bmAttributes.xfer == TUSB_XFER_BULK) ? 1 : tu_edpt_hs_mult(p_endpoint_desc);
 
   // Endpoint control
   union {
@@ -297,6 +531,9 @@ static void edpt_disable(uint8_t rhport, uint8_t ep_addr, bool stall) {
 
     // Flush the FIFO, and wait until we have confirmed it cleared.
     dfifo_flush_tx(dwc2, epnum);
+#if CFG_TUD_DWC2_SLAVE_ENABLE && CFG_TUD_DWC2_SLAVE_ISR_BUDGET
+    _dcd_data.txfe_deferred &= (uint16_t) ~(1u << epnum);
+#endif
   } else {
     // Only disable currently enabled non-control endpoint
     if ((epnum == 0) || !(dep->doepctl & DOEPCTL_EPENA)) {
@@ -321,11 +558,108 @@ static void edpt_disable(uint8_t rhport, uint8_t ep_addr, bool stall) {
   }
 }
 
-static void edpt_schedule_packets(uint8_t rhport, const uint8_t epnum, const uint8_t dir) {
+#if CFG_TUD_DWC2_DMA_DESC_ENABLE
+// Append a buffer to endpoint descriptor list, split into descriptors of multiple of packet size.
+// OUT size is rounded up to multiple of packet size.
+static bool ddma_desc_append(uint8_t epnum, uint8_t dir, uint8_t* buf, uint32_t len, uint16_t mps) {
+  dwc2_ddma_desc_t* desc = _dcd_ddma[epnum][dir].list.desc;
+  ddma_xfer_t* ddma_xfer = &_ddma_xfer[epnum][dir];
+  const uint32_t desc_max = (DDMA_DESC_NBYTES_Msk / mps) * mps;
+  uint32_t queued = (dir == TUSB_DIR_OUT) ? tu_div_ceil(len, mps) * mps : len;
+
+  ddma_xfer->total_len += len;
+  do {
+    TU_ASSERT(ddma_xfer->count < CFG_TUD_DWC2_DMA_DESC_PER_EP);
+    const uint16_t nbytes = (uint16_t) tu_min32(queued, desc_max);
+
+    // OUT: short packet can end the transfer in any descriptor
+    desc[ddma_xfer->count].status = DDMA_DESC_BS_HOST_READY | nbytes | (dir == TUSB_DIR_OUT ? DDMA_DESC_IOC : 0);
+    desc[ddma_xfer->count].buf = (uint32_t) (uintptr_t) buf;
+    ddma_xfer->nbytes[ddma_xfer->count] = nbytes;
+    ddma_xfer->count++;
+
+    buf += nbytes;
+    queued -= nbytes;
+  } while (queued);
+
+  return true;
+}
+
+// Mark last descriptor then start endpoint, interrupt only when it is complete
+static void ddma_edpt_start(uint8_t rhport, const uint8_t epnum, const uint8_t dir) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  dwc2_dep_t* dep = &dwc2->ep[dir == TUSB_DIR_IN ? 0 : 1][epnum];
+  dwc2_ddma_desc_t* desc = _dcd_ddma[epnum][dir].list.desc;
+  const ddma_xfer_t* ddma_xfer = &_ddma_xfer[epnum][dir];
+  const uint8_t last = ddma_xfer->count - 1;
+
+  desc[last].status |= DDMA_DESC_L | DDMA_DESC_IOC;
+  if (dir == TUSB_DIR_IN && (ddma_xfer->nbytes[last] % XFER_CTL_BASE(epnum, dir)->max_size)) {
+    desc[last].status |= DDMA_DESC_SP;
+  }
+  dcd_dcache_clean(desc, sizeof(ddma_desc_list_t));
+
+  dep->diepdma = (uintptr_t) desc;
+  dep->ctl |= EPCTL_CNAK | EPCTL_EPENA;
+}
+
+// Fill endpoint descriptor list with the whole transfer (EP0 is also not limited to 1 packet)
+static void ddma_schedule_xfer(uint8_t rhport, const uint8_t epnum, const uint8_t dir) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  xfer_ctl_t* const xfer = XFER_CTL_BASE(epnum, dir);
+  dwc2_dep_t* dep = &dwc2->ep[dir == TUSB_DIR_IN ? 0 : 1][epnum];
+  ddma_xfer_t* ddma_xfer = &_ddma_xfer[epnum][dir];
+
+  _dcd_data.ep0_pending[dir] = 0;
+  ddma_xfer->count = 0;
+  ddma_xfer->total_len = 0;
+
+  const uint16_t mps = xfer->max_size;
+  uint8_t* buf = (xfer->buffer != NULL) ? xfer->buffer : _dcd_usbbuf.setup_packet; // ZLP still need a valid address
+
+  if (dir == TUSB_DIR_IN && xfer->total_len != 0) {
+    dcd_dcache_clean(xfer->buffer, xfer->total_len);
+  }
+
+  if (dep->ctl_bm.type == DEPCTL_EPTYPE_ISOCHRONOUS) {
+    // Isochronous: single packet per transfer
+    dwc2_ddma_desc_t* desc = _dcd_ddma[epnum][dir].list.desc;
+    const uint16_t len = xfer->total_len;
+    uint32_t status = DDMA_DESC_BS_HOST_READY;
+    if (dir == TUSB_DIR_IN) {
+      // transmit in next (micro)frame
+      const uint32_t frame = dwc2->dsts_bm.frame_number + 1u;
+      status |= (len & DDMA_DESC_ISO_IN_NBYTES_Msk) |
+                ((frame << DDMA_DESC_ISO_FRNUM_Pos) & DDMA_DESC_ISO_FRNUM_Msk) |
+                ((uint32_t) tu_div_ceil(len, mps) << DDMA_DESC_ISO_PID_Pos);
+    } else {
+      status |= (len & DDMA_DESC_ISO_OUT_NBYTES_Msk);
+    }
+    desc[0].buf = (uint32_t) (uintptr_t) buf;
+    desc[0].status = status;
+    ddma_xfer->nbytes[0] = len;
+    ddma_xfer->total_len = len;
+    ddma_xfer->count = 1;
+  } else {
+    (void) ddma_desc_append(epnum, dir, buf, xfer->total_len, mps); // always fit
+  }
+
+  ddma_edpt_start(rhport, epnum, dir);
+}
+#endif
+
+TU_ATTR_FAST_FUNC static void edpt_schedule_packets(uint8_t rhport, const uint8_t epnum, const uint8_t dir) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
   xfer_ctl_t* const xfer = XFER_CTL_BASE(epnum, dir);
   dwc2_dep_t* dep = &dwc2->ep[dir == TUSB_DIR_IN ? 0 : 1][epnum];
 
+#if CFG_TUD_DWC2_DMA_DESC_ENABLE
+  if (dma_desc_enabled(dwc2)) {
+    ddma_schedule_xfer(rhport, epnum, dir);
+    return;
+  }
+#endif
+
   uint16_t num_packets;
   uint16_t total_bytes;
 
@@ -351,6 +685,12 @@ static void edpt_schedule_packets(uint8_t rhport, const uint8_t epnum, const uin
   deptsiz.bm.xfer_size =  total_bytes;
   deptsiz.bm.packet_count = num_packets;
 
+  // Periodic IN: packets sent per micro-frame (MC), core sequences PID DATA2/DATA1/DATA0 for high-bandwidth
+  const uint8_t ep_type = dep->ctl_bm.type;
+  if (dir == TUSB_DIR_IN && (ep_type == DEPCTL_EPTYPE_ISOCHRONOUS || ep_type == DEPCTL_EPTYPE_INTERRUPT)) {
+    deptsiz.bm.mc_pid = tu_min16(num_packets, xfer->mult) & 0x03u;
+  }
+
   dep->tsiz = deptsiz.value;
 
   // control
@@ -391,17 +731,10 @@ static void edpt_schedule_packets(uint8_t rhport, const uint8_t epnum, const uin
 //--------------------------------------------------------------------
 // Controller API
 //--------------------------------------------------------------------
-bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
-  (void) rh_init;
+// Device init after core init is complete
+static void device_init(uint8_t rhport, bool is_highspeed) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
-  tu_memclr(&_dcd_data, sizeof(_dcd_data));
-
-  // Core Initialization
-  const bool is_highspeed = dwc2_core_is_highspeed(dwc2, TUSB_ROLE_DEVICE);
-  const bool is_dma = dma_device_enabled(dwc2);
-  TU_ASSERT(dwc2_core_init(rhport, is_highspeed, is_dma));
-
   //------------- 7.1 Device Initialization -------------//
   // Set device max speed
   uint32_t dcfg = dwc2->dcfg & ~DCFG_DSPD_Msk;
@@ -418,6 +751,9 @@ bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   }
 
   dcfg |= DCFG_NZLSOHSK; // send STALL back and discard if host send non-zlp during control status
+  if (dma_desc_enabled(dwc2)) {
+    dcfg |= DCFG_DESCDMA;
+  }
   dwc2->dcfg = dcfg;
 
   dcd_disconnect(rhport);
@@ -431,16 +767,100 @@ bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   // Enable required interrupts
   dwc2->gintmsk |= GINTMSK_OTGINT | GINTMSK_USBSUSPM | GINTMSK_USBRST | GINTMSK_ENUMDNEM | GINTMSK_WUIM;
 
+#if CFG_TUD_LPM
+  // ACK LPM token to enter L1 sleep, BESL and bRemoteWake of token are latched in GLPMCFG. L1 exit triggers WKUINT
+  if (dwc2->ghwcfg3_bm.lpm_mode) {
+    dwc2->glpmcfg = GLPMCFG_LPMEN | GLPMCFG_LPMACK | GLPMCFG_ENBESL;
+    dwc2->gintsts = GINTSTS_LPMINT;
+    dwc2->gintmsk |= GINTMSK_LPMINTM;
+  }
+#endif
+
+  // thresholded DMA transfer, only valid in (buffer) DMA mode
+  if (dma_device_enabled(dwc2)) {
+    dwc2->dthrctl = _dcd_dthrctl;
+  }
+
   // TX FIFO empty level for interrupt is complete empty
   uint32_t gahbcfg = dwc2->gahbcfg;
   gahbcfg |= GAHBCFG_TX_FIFO_EPMTY_LVL;
   gahbcfg |= GAHBCFG_GINT; // Enable global interrupt
   dwc2->gahbcfg = gahbcfg;
 
+#if CFG_TUD_DWC2_ASYNC_INIT
+  if (_dcd_data.init_disconnected) {
+    return;
+  }
+#endif
   dcd_connect(rhport);
+}
+
+bool dcd_configure(uint8_t rhport, uint32_t cfg_id, const void* cfg_param) {
+  TU_VERIFY(cfg_id == TUD_CFGID_DWC2 && cfg_param != NULL);
+  const tud_configure_dwc2_t* cfg = (const tud_configure_dwc2_t*) cfg_param;
+
+  const bool thr_en = cfg->iso_in_thr_en || cfg->noniso_in_thr_en || cfg->rx_thr_en;
+  TU_VERIFY(!thr_en || CFG_TUD_DWC2_DMA_ENABLE);
+  TU_VERIFY(!(cfg->iso_in_thr_en || cfg->noniso_in_thr_en) || (cfg->tx_thr_len > 0 && cfg->tx_thr_len <= 511));
+  TU_VERIFY(!cfg->rx_thr_en || (cfg->rx_thr_len > 0 && cfg->rx_thr_len <= 511));
+  TU_VERIFY(dwc2_core_set_ahb_burst(rhport, cfg->ahb_burst));
+
+  uint32_t dthrctl = 0;
+  if (cfg->noniso_in_thr_en) {
+    dthrctl |= DTHRCTL_NONISOTHREN;
+  }
+  if (cfg->iso_in_thr_en) {
+    dthrctl |= DTHRCTL_ISOTHREN;
+  }
+  if (cfg->iso_in_thr_en || cfg->noniso_in_thr_en) {
+    dthrctl |= ((uint32_t) cfg->tx_thr_len << DTHRCTL_TXTHRLEN_Pos);
+  }
+  if (cfg->rx_thr_en) {
+    dthrctl |= DTHRCTL_RXTHREN | ((uint32_t) cfg->rx_thr_len << DTHRCTL_RXTHRLEN_Pos);
+  }
+  _dcd_dthrctl = dthrctl;
+
   return true;
 }
 
+bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
+  (void) rh_init;
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+
+  tu_memclr(&_dcd_data, sizeof(_dcd_data));
+
+  // Core Initialization
+  const bool is_highspeed = dwc2_core_is_highspeed(dwc2, TUSB_ROLE_DEVICE);
+#if CFG_TUD_DWC2_ASYNC_INIT
+  // only start core reset, init is completed by dcd_init_poll()
+  TU_ASSERT(dwc2_core_init_start(rhport, is_highspeed));
+  _dcd_data.init_pending = true;
+#else
+  TU_ASSERT(dwc2_core_init(rhport, is_highspeed, dma_device_enabled(dwc2)));
+  device_init(rhport, is_highspeed);
+#endif
+
+  return true;
+}
+
+#if CFG_TUD_DWC2_ASYNC_INIT
+bool dcd_init_poll(uint8_t rhport) {
+  if (!_dcd_data.init_pending) {
+    return true;
+  }
+
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  const bool is_highspeed = dwc2_core_is_highspeed(dwc2, TUSB_ROLE_DEVICE);
+  if (!dwc2_core_init_poll(rhport, is_highspeed, dma_device_enabled(dwc2))) {
+    return false;
+  }
+
+  _dcd_data.init_pending = false;
+  device_init(rhport, is_highspeed);
+  return true;
+}
+#endif
+
 void dcd_int_enable(uint8_t rhport) {
   dwc2_dcd_int_enable(rhport);
 }
@@ -457,11 +877,43 @@ void dcd_set_address(uint8_t rhport, uint8_t dev_addr) {
   dcd_edpt_xfer(rhport, tu_edpt_addr(0, TUSB_DIR_IN), NULL, 0);
 }
 
+#if CFG_TUD_DWC2_SUSPEND_CLOCK_GATE
+// Only wakeup logic is clocked until clocks are restored: stop PHY clock first then gate HCLK, restore in reverse
+static void suspend_clock_gate(dwc2_regs_t* dwc2) {
+  dwc2->pcgcctl |= PCGCCTL_STOPPCLK;
+  dwc2->pcgcctl |= PCGCCTL_GATEHCLK;
+  _dcd_data.clock_gated = true;
+}
+
+static void suspend_clock_ungate(dwc2_regs_t* dwc2) {
+  if (_dcd_data.clock_gated) {
+    dwc2->pcgcctl &= ~PCGCCTL_GATEHCLK;
+    dwc2->pcgcctl &= ~PCGCCTL_STOPPCLK;
+    _dcd_data.clock_gated = false;
+  }
+}
+#endif
+
 void dcd_remote_wakeup(uint8_t rhport) {
   (void) rhport;
 
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
+#if CFG_TUD_DWC2_SUSPEND_CLOCK_GATE
+  // core must be clocked to signal resume
+  suspend_clock_ungate(dwc2);
+#endif
+
+#if CFG_TUD_LPM
+  if (dwc2->glpmcfg & GLPMCFG_SLPSTS) {
+    // L1 sleep: core drives resume signal for 50us and clears RWUSIG by itself
+    if (dwc2->glpmcfg & GLPMCFG_L1RSMOK) {
+      dwc2->dctl |= DCTL_RWUSIG;
+    }
+    return;
+  }
+#endif
+
   // set remote wakeup
   dwc2->dctl |= DCTL_RWUSIG;
 
@@ -479,6 +931,13 @@ void dcd_connect(uint8_t rhport) {
   (void) rhport;
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
+#if CFG_TUD_DWC2_ASYNC_INIT
+  if (_dcd_data.init_pending) {
+    _dcd_data.init_disconnected = false;
+    return;
+  }
+#endif
+
 #ifdef TUP_USBIP_DWC2_ESP32
   usb_wrap_otg_conf_reg_t conf = USB_WRAP.otg_conf;
   conf.pad_pull_override = 0;
@@ -496,6 +955,17 @@ void dcd_disconnect(uint8_t rhport) {
   (void) rhport;
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
+#if CFG_TUD_DWC2_SUSPEND_CLOCK_GATE
+  suspend_clock_ungate(dwc2);
+#endif
+
+#if CFG_TUD_DWC2_ASYNC_INIT
+  if (_dcd_data.init_pending) {
+    _dcd_data.init_disconnected = true;
+    return;
+  }
+#endif
+
 #ifdef TUP_USBIP_DWC2_ESP32
   usb_wrap_otg_conf_reg_t conf = USB_WRAP.otg_conf;
   conf.pad_pull_override = 1;
@@ -529,7 +999,8 @@ void dcd_sof_enable(uint8_t rhport, bool en) {
  *------------------------------------------------------------------*/
 
 bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const* desc_edpt) {
-  TU_ASSERT(dfifo_alloc(rhport, desc_edpt->bEndpointAddress, tu_edpt_packet_size(desc_edpt)));
+  // high-bandwidth endpoint needs fifo for all transactions of a micro-frame
+  TU_ASSERT(dfifo_alloc(rhport, desc_edpt->bEndpointAddress, tu_edpt_interval_size(desc_edpt)));
   edpt_activate(rhport, desc_edpt);
   return true;
 }
@@ -615,6 +1086,54 @@ bool dcd_edpt_xfer_fifo(uint8_t rhport, uint8_t ep_addr, tu_fifo_t* ff, uint16_t
   return true;
 }
 
+#if CFG_TUD_DWC2_DMA_DESC_ENABLE && CFG_TUD_EDPT_XFER_SG
+// Chain all buffers in endpoint descriptor list, only supported with Scatter/Gather DMA.
+// Non-last buffer must be multiple of packet size since each descriptor ends at packet boundary.
+bool dcd_edpt_xfer_sg(uint8_t rhport, uint8_t ep_addr, tu_xfer_sg_t const* sg_list, uint8_t count) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir = tu_edpt_dir(ep_addr);
+  xfer_ctl_t* xfer = XFER_CTL_BASE(epnum, dir);
+  ddma_xfer_t* ddma_xfer = &_ddma_xfer[epnum][dir];
+
+  TU_ASSERT(dma_desc_enabled(dwc2) && epnum != 0);
+  TU_ASSERT(dwc2->ep[dir == TUSB_DIR_IN ? 0 : 1][epnum].ctl_bm.type != DEPCTL_EPTYPE_ISOCHRONOUS);
+
+  xfer->buffer = NULL;
+  xfer->ff = NULL;
+  ddma_xfer->count = 0;
+  ddma_xfer->total_len = 0;
+
+  // adjacent IN buffers are cleaned with one call
+  tu_mem_range_t range = {0, 0};
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t* buf = sg_list[i].buffer;
+    const uint32_t len = sg_list[i].len;
+    const bool is_last = (i == count - 1);
+
+    // skip empty buffer, unless the whole list is a ZLP
+    if (len == 0 && !(is_last && ddma_xfer->count == 0)) {
+      continue;
+    }
+    TU_ASSERT(is_last || (len % xfer->max_size) == 0);
+
+    if (dir == TUSB_DIR_IN && len != 0 && !tu_mem_range_append(&range, buf, len)) {
+      dcd_dcache_clean((void*) range.start, range.size);
+      range.start = (uintptr_t) buf;
+      range.size = len;
+    }
+    TU_ASSERT(ddma_desc_append(epnum, dir, (buf != NULL) ? buf : _dcd_usbbuf.setup_packet, len, xfer->max_size));
+  }
+  if (range.size) {
+    dcd_dcache_clean((void*) range.start, range.size);
+  }
+
+  ddma_edpt_start(rhport, epnum, dir);
+  return true;
+}
+#endif
+
 void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
   edpt_disable(rhport, ep_addr, true);
@@ -647,6 +1166,9 @@ static void handle_bus_reset(uint8_t rhport) {
 
   _dcd_data.sof_en = false;
   _dcd_data.allocated_epin_count = 0;
+#if CFG_TUD_DWC2_SLAVE_ENABLE && CFG_TUD_DWC2_SLAVE_ISR_BUDGET
+  _dcd_data.txfe_deferred = 0; // TX FIFOs are flushed below
+#endif
 
   // 1. NAK for all OUT endpoints
   for (uint8_t n = 0; n < ep_count; n++) {
@@ -664,6 +1186,11 @@ static void handle_bus_reset(uint8_t rhport) {
   dwc2->daintmsk = TU_BIT(DAINTMSK_OEPM_Pos) | TU_BIT(DAINTMSK_IEPM_Pos);
   dwc2->doepmsk = DOEPMSK_STUPM | DOEPMSK_XFRCM;
   dwc2->diepmsk = DIEPMSK_TOM | DIEPMSK_XFRCM;
+  if (dma_desc_enabled(dwc2)) {
+    // buffer not available: descriptor is not ready, should not happen
+    dwc2->doepmsk |= DOEPMSK_BOIM;
+    dwc2->diepmsk |= DIEPMSK_BIM;
+  }
 
   // 4. Set up DFIFO
   dfifo_flush_tx(dwc2, 0x10); // all tx fifo
@@ -731,8 +1258,25 @@ TU_ATTR_ALWAYS_INLINE static inline void print_doepint(uint32_t doepint) {
 #endif
 
 #if CFG_TUD_DWC2_SLAVE_ENABLE
+#if CFG_TUD_DWC2_SLAVE_ISR_BUDGET
+static void slave_fifo_deferred(void* param);
+
+// Take a packet from ISR budget, false if it is used up: caller masks its interrupt and defers the rest
+TU_ATTR_ALWAYS_INLINE static inline bool slave_budget_take(uint8_t rhport) {
+  if (_dcd_data.isr_budget == 0) {
+    if (!_dcd_data.fifo_deferred) {
+      _dcd_data.fifo_deferred = true;
+      dcd_event_func_call(rhport, slave_fifo_deferred, (void*) (uintptr_t) rhport, true);
+    }
+    return false;
+  }
+  _dcd_data.isr_budget--;
+  return true;
+}
+#endif
+
 // Process shared receive FIFO, this interrupt is only used in Slave mode
-static void handle_rxflvl_irq(uint8_t rhport) {
+TU_ATTR_FAST_FUNC static void handle_rxflvl_irq(uint8_t rhport) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
   const volatile uint32_t* rx_fifo = dwc2->fifo[0];
 
@@ -798,7 +1342,7 @@ static void handle_rxflvl_irq(uint8_t rhport) {
   }
 }
 
-static void handle_epout_slave(uint8_t rhport, uint8_t epnum, dwc2_doepint_t doepint_bm) {
+TU_ATTR_FAST_FUNC static void handle_epout_slave(uint8_t rhport, uint8_t epnum, dwc2_doepint_t doepint_bm) {
   if (doepint_bm.setup_phase_done) {
     dcd_event_setup_received(rhport, _dcd_usbbuf.setup_packet, true);
     return;
@@ -822,10 +1366,51 @@ static void handle_epout_slave(uint8_t rhport, uint8_t epnum, dwc2_doepint_t doe
   }
 }
 
-static void handle_epin_slave(uint8_t rhport, uint8_t epnum, dwc2_diepint_t diepint_bm) {
+// Write as many whole packets of IN transfer as TX FIFO space (and ISR budget) allows
+TU_ATTR_FAST_FUNC static void epin_write_packets(uint8_t rhport, uint8_t epnum) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
   dwc2_dep_t* epin = &dwc2->epin[epnum];
   xfer_ctl_t* xfer = XFER_CTL_BASE(epnum, TUSB_DIR_IN);
+  const uint16_t remain_packets = epin->tsiz_bm.packet_count;
+
+  // Process every single packet (only whole packets can be written to fifo)
+  for (uint16_t i = 0; i < remain_packets; i++) {
+    const uint16_t remain_bytes = (uint16_t) epin->tsiz_bm.xfer_size;
+    const uint16_t xact_bytes = tu_min16(remain_bytes, xfer->max_size);
+
+    // Check if dtxfsts has enough space available
+    if (xact_bytes > ((epin->dtxfsts & DTXFSTS_INEPTFSAV_Msk) << 2)) {
+      break;
+    }
+
+#if CFG_TUD_DWC2_SLAVE_ISR_BUDGET
+    if (!slave_budget_take(rhport)) {
+      // TXFE is level triggered, mask it until deferred write
+      dwc2->diepempmsk &= ~(1 << epnum);
+      _dcd_data.txfe_deferred |= (uint16_t) (1u << epnum);
+      return;
+    }
+#endif
+
+    // Push packet to Tx-FIFO
+    if (xfer->ff) {
+      volatile uint32_t* tx_fifo = dwc2->fifo[epnum];
+      tu_fifo_read_n_const_addr_full_words(xfer->ff, (void*)(uintptr_t)tx_fifo, xact_bytes);
+    } else {
+      dfifo_write_packet(dwc2, epnum, xfer->buffer, xact_bytes);
+      xfer->buffer += xact_bytes;
+    }
+  }
+
+  // Turn off TXFE if all bytes are written.
+  if (epin->tsiz_bm.xfer_size == 0) {
+    dwc2->diepempmsk &= ~(1 << epnum);
+  }
+}
+
+TU_ATTR_FAST_FUNC static void handle_epin_slave(uint8_t rhport, uint8_t epnum, dwc2_diepint_t diepint_bm) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  xfer_ctl_t* xfer = XFER_CTL_BASE(epnum, TUSB_DIR_IN);
 
   if (diepint_bm.xfer_complete) {
     if ((epnum == 0) && _dcd_data.ep0_pending[TUSB_DIR_IN]) {
@@ -840,38 +1425,45 @@ static void handle_epin_slave(uint8_t rhport, uint8_t epnum, dwc2_diepint_t diep
   // - 64 bytes or
   // - Half/Empty of TX FIFO size (configured by GAHBCFG.TXFELVL)
   if (diepint_bm.txfifo_empty && (dwc2->diepempmsk & (1 << epnum))) {
-    const uint16_t remain_packets = epin->tsiz_bm.packet_count;
+    epin_write_packets(rhport, epnum);
+  }
+}
 
-    // Process every single packet (only whole packets can be written to fifo)
-    for (uint16_t i = 0; i < remain_packets; i++) {
-      const uint16_t remain_bytes = (uint16_t) epin->tsiz_bm.xfer_size;
-      const uint16_t xact_bytes = tu_min16(remain_bytes, xfer->max_size);
+#if CFG_TUD_DWC2_SLAVE_ISR_BUDGET
+// Move FIFO packets left over by dcd_int_handler(), called by tud_task() with USB interrupt disabled (no budget)
+static void slave_fifo_deferred(void* param) {
+  const uint8_t rhport = (uint8_t) (uintptr_t) param;
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
-      // Check if dtxfsts has enough space available
-      if (xact_bytes > ((epin->dtxfsts & DTXFSTS_INEPTFSAV_Msk) << 2)) {
-        break;
-      }
+  dcd_int_disable(rhport);
+  _dcd_data.fifo_deferred = false;
+  _dcd_data.isr_budget = UINT16_MAX;
 
-      // Push packet to Tx-FIFO
-      if (xfer->ff) {
-        volatile uint32_t* tx_fifo = dwc2->fifo[epnum];
-        tu_fifo_read_n_const_addr_full_words(xfer->ff, (void*)(uintptr_t)tx_fifo, xact_bytes);
-      } else {
-        dfifo_write_packet(dwc2, epnum, xfer->buffer, xact_bytes);
-        xfer->buffer += xact_bytes;
-      }
+  if (_dcd_data.rxflvl_deferred) {
+    _dcd_data.rxflvl_deferred = false;
+    while (dwc2->gintsts & GINTSTS_RXFLVL) {
+      handle_rxflvl_irq(rhport);
     }
+    dwc2->gintmsk |= GINTMSK_RXFLVLM;
+  }
 
-    // Turn off TXFE if all bytes are written.
-    if (epin->tsiz_bm.xfer_size == 0) {
-      dwc2->diepempmsk &= ~(1 << epnum);
+  const uint16_t txfe_deferred = _dcd_data.txfe_deferred;
+  _dcd_data.txfe_deferred = 0;
+  for (uint8_t epnum = 0; epnum < DWC2_EP_MAX; epnum++) {
+    if (txfe_deferred & (1u << epnum)) {
+      // re-enable TXFE first, epin_write_packets() turns it off if all bytes are written
+      dwc2->diepempmsk |= (1 << epnum);
+      epin_write_packets(rhport, epnum);
     }
   }
+
+  dcd_int_enable(rhport);
 }
 #endif
+#endif
 
 #if CFG_TUD_DWC2_DMA_ENABLE
-static void handle_epout_dma(uint8_t rhport, uint8_t epnum, dwc2_doepint_t doepint_bm) {
+TU_ATTR_FAST_FUNC static void handle_epout_dma(uint8_t rhport, uint8_t epnum, dwc2_doepint_t doepint_bm) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
   if (doepint_bm.setup_phase_done) {
@@ -910,7 +1502,7 @@ static void handle_epout_dma(uint8_t rhport, uint8_t epnum, dwc2_doepint_t doepi
   }
 }
 
-static void handle_epin_dma(uint8_t rhport, uint8_t epnum, dwc2_diepint_t diepint_bm) {
+TU_ATTR_FAST_FUNC static void handle_epin_dma(uint8_t rhport, uint8_t epnum, dwc2_diepint_t diepint_bm) {
   xfer_ctl_t* xfer = XFER_CTL_BASE(epnum, TUSB_DIR_IN);
 
   if (diepint_bm.xfer_complete) {
@@ -927,7 +1519,96 @@ static void handle_epin_dma(uint8_t rhport, uint8_t epnum, dwc2_diepint_t diepin
 }
 #endif
 
-static void handle_ep_irq(uint8_t rhport, uint8_t dir) {
+#if CFG_TUD_DWC2_DMA_DESC_ENABLE
+TU_ATTR_FAST_FUNC static void handle_epout_ddma(uint8_t rhport, uint8_t epnum, dwc2_doepint_t doepint_bm) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  dwc2_ddma_desc_t* desc = _dcd_ddma[epnum][TUSB_DIR_OUT].list.desc;
+
+  if (doepint_bm.setup_phase_done) {
+    dcd_dcache_invalidate(desc, sizeof(ddma_desc_list_t));
+
+    // setup packet can also be received by descriptor of data/status stage
+    const uint8_t* setup_buf = (const uint8_t*) (uintptr_t) desc[0].buf;
+    dcd_dcache_invalidate(setup_buf, 8);
+    if (setup_buf != _dcd_usbbuf.setup_packet) {
+      memcpy(_dcd_usbbuf.setup_packet, setup_buf, 8);
+    }
+
+    const tusb_control_request_t* request = (const tusb_control_request_t*) (uintptr_t) _dcd_usbbuf.setup_packet;
+    _dcd_data.ep0_status_dir = (request->wLength == 0 || request->bmRequestType_bit.direction == TUSB_DIR_OUT) ?
+                               TUSB_DIR_IN : TUSB_DIR_OUT;
+
+    dcd_event_setup_received(rhport, _dcd_usbbuf.setup_packet, true);
+    return;
+  }
+
+  if (doepint_bm.xfer_complete && !doepint_bm.setup_packet_rx) {
+    dcd_dcache_invalidate(desc, sizeof(ddma_desc_list_t));
+    if (desc[0].status & DDMA_DESC_SR) {
+      return; // setup packet, wait for setup_phase_done
+    }
+
+    const ddma_xfer_t* ddma_xfer = &_ddma_xfer[epnum][TUSB_DIR_OUT];
+    const bool is_iso = (dwc2->epout[epnum].ctl_bm.type == DEPCTL_EPTYPE_ISOCHRONOUS);
+    const uint32_t nbytes_mask = is_iso ? DDMA_DESC_ISO_OUT_NBYTES_Msk : DDMA_DESC_NBYTES_Msk;
+
+    // actual received bytes: queued minus remaining bytes of each descriptor.
+    // Transfer is complete when last descriptor is done or a short packet is received.
+    // Descriptors usually cover adjacent memory, cache is invalidated once per contiguous range
+    uint32_t received = 0;
+    tu_mem_range_t range = {0, 0};
+    for (uint8_t i = 0; i < ddma_xfer->count; i++) {
+      const uint32_t status = desc[i].status;
+      if ((status & DDMA_DESC_BS_Msk) != DDMA_DESC_BS_DMA_DONE) {
+        return; // not yet complete
+      }
+
+      const uint32_t desc_remain = status & nbytes_mask;
+      const uint32_t desc_received = ddma_xfer->nbytes[i] - desc_remain;
+      if (!tu_mem_range_append(&range, (void*) (uintptr_t) desc[i].buf, desc_received)) {
+        dcd_dcache_invalidate((void*) range.start, range.size);
+        range.start = desc[i].buf;
+        range.size = desc_received;
+      }
+      received += desc_received;
+
+      if ((status & DDMA_DESC_L) || desc_remain) {
+        break;
+      }
+    }
+    if (range.size) {
+      dcd_dcache_invalidate((void*) range.start, range.size);
+    }
+    received = tu_min32(received, ddma_xfer->total_len);
+
+    if (epnum == 0 && _dcd_data.ep0_status_dir == TUSB_DIR_OUT) {
+      dma_setup_prepare(rhport);
+    }
+
+    dcd_event_xfer_complete(rhport, epnum, received, XFER_RESULT_SUCCESS, true);
+  }
+
+  if (doepint_bm.bna) {
+    TU_LOG(DWC2_DEBUG, "EP%u OUT buffer not available\r\n", epnum);
+  }
+}
+
+TU_ATTR_FAST_FUNC static void handle_epin_ddma(uint8_t rhport, uint8_t epnum, dwc2_diepint_t diepint_bm) {
+  if (diepint_bm.xfer_complete) {
+    if (epnum == 0 && _dcd_data.ep0_status_dir == TUSB_DIR_IN) {
+      dma_setup_prepare(rhport);
+    }
+    dcd_event_xfer_complete(rhport, epnum | TUSB_DIR_IN_MASK, _ddma_xfer[epnum][TUSB_DIR_IN].total_len,
+                            XFER_RESULT_SUCCESS, true);
+  }
+
+  if (diepint_bm.bna) {
+    TU_LOG(DWC2_DEBUG, "EP%u IN buffer not available\r\n", epnum);
+  }
+}
+#endif
+
+TU_ATTR_FAST_FUNC static void handle_ep_irq(uint8_t rhport, uint8_t dir) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
   const bool is_dma = dma_device_enabled(dwc2);
   const uint8_t ep_count = DWC2_EP_COUNT(dwc2);
@@ -949,6 +1630,17 @@ static void handle_ep_irq(uint8_t rhport, uint8_t dir) {
       epout->intr = intr.value; // Clear interrupt
 
       if (is_dma) {
+        #if CFG_TUD_DWC2_DMA_DESC_ENABLE
+        if (dma_desc_enabled(dwc2)) {
+          if (dir == TUSB_DIR_IN) {
+            handle_epin_ddma(rhport, epnum, intr.diepint_bm);
+          } else {
+            handle_epout_ddma(rhport, epnum, intr.doepint_bm);
+          }
+          continue;
+        }
+        #endif
+
         #if CFG_TUD_DWC2_DMA_ENABLE
         if (dir == TUSB_DIR_IN) {
           handle_epin_dma(rhport, epnum, intr.diepint_bm);
@@ -976,7 +1668,7 @@ static void handle_ep_irq(uint8_t rhport, uint8_t dir) {
                       DAINT
                      /     \
                     /       \
-     GINTSTS:    OEPInt    IEPInt | USBReset | EnumDone | USBSusp | WkUpInt | OTGInt | SOF | RXFLVL
+     GINTSTS:    OEPInt    IEPInt | USBReset | EnumDone | USBSusp | WkUpInt | LPMInt | OTGInt | SOF | RXFLVL
 
   Note: when OTG_MULTI_PROC_INTRPT = 1, Device Each endpoint interrupt deachint/deachmsk/diepeachmsk/doepeachmsk
   are combined to generate dedicated interrupt line for each endpoint.
@@ -984,8 +1676,20 @@ static void handle_ep_irq(uint8_t rhport, uint8_t dir) {
 void dcd_int_handler(uint8_t rhport) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
+#if CFG_TUD_DWC2_SUSPEND_CLOCK_GATE
+  // any interrupt after suspend (resume, reset or session change) comes from wakeup logic: restore clocks first
+  suspend_clock_ungate(dwc2);
+#endif
+
   const uint32_t gintmask = dwc2->gintmsk;
   const uint32_t gintsts = dwc2->gintsts & gintmask;
+#if CFG_TUD_DWC2_SUSPEND_CLOCK_GATE
+  bool suspend_gate = false;
+#endif
+
+#if CFG_TUD_DWC2_SLAVE_ENABLE && CFG_TUD_DWC2_SLAVE_ISR_BUDGET
+  _dcd_data.isr_budget = CFG_TUD_DWC2_SLAVE_ISR_BUDGET;
+#endif
 
   if (gintsts & GINTSTS_USBRST) {
     // USBRST is start of reset.
@@ -1002,6 +1706,13 @@ void dcd_int_handler(uint8_t rhport) {
   if (gintsts & GINTSTS_USBSUSP) {
     dwc2->gintsts = GINTSTS_USBSUSP;
     dcd_event_bus_signal(rhport, DCD_EVENT_SUSPEND, true);
+
+#if CFG_TUD_DWC2_SUSPEND_CLOCK_GATE
+    // gate only when still in suspend, and after everything else of this interrupt is handled
+    if (dwc2->dsts & DSTS_SUSPSTS) {
+      suspend_gate = true;
+    }
+#endif
   }
 
   if (gintsts & GINTSTS_WKUINT) {
@@ -1009,6 +1720,16 @@ void dcd_int_handler(uint8_t rhport) {
     dcd_event_bus_signal(rhport, DCD_EVENT_RESUME, true);
   }
 
+#if CFG_TUD_LPM
+  if (gintsts & GINTSTS_LPMINT) {
+    // LPM token is ACKed, link enters L1
+    dwc2->gintsts = GINTSTS_LPMINT;
+    const uint32_t glpmcfg = dwc2->glpmcfg;
+    dcd_event_lpm_sleep(rhport, (uint8_t) ((glpmcfg & GLPMCFG_BESL) >> GLPMCFG_BESL_Pos),
+                        (glpmcfg & GLPMCFG_REMWAKE) != 0, true);
+  }
+#endif
+
   // TODO check GINTSTS_DISCINT for disconnect detection
   // if(int_status & GINTSTS_DISCINT)
 
@@ -1041,11 +1762,25 @@ void dcd_int_handler(uint8_t rhport) {
     // RXFLVL bit is read-only
     dwc2->gintmsk &= ~GINTMSK_RXFLVLM; // disable RXFLVL interrupt while reading
 
+  #if CFG_TUD_DWC2_SLAVE_ISR_BUDGET
+    do {
+      if (!slave_budget_take(rhport)) {
+        _dcd_data.rxflvl_deferred = true; // keep RXFLVL masked until deferred read
+        break;
+      }
+      handle_rxflvl_irq(rhport);
+    } while(dwc2->gintsts & GINTSTS_RXFLVL);
+
+    if (!_dcd_data.rxflvl_deferred) {
+      dwc2->gintmsk |= GINTMSK_RXFLVLM;
+    }
+  #else
     do {
       handle_rxflvl_irq(rhport); // read all packets
     } while(dwc2->gintsts & GINTSTS_RXFLVL);
 
     dwc2->gintmsk |= GINTMSK_RXFLVLM;
+  #endif
   }
 #endif
 
@@ -1060,6 +1795,12 @@ void dcd_int_handler(uint8_t rhport) {
     // IEPINT bit read-only, clear using DIEPINTn
     handle_ep_irq(rhport, TUSB_DIR_IN);
   }
+
+#if CFG_TUD_DWC2_SUSPEND_CLOCK_GATE
+  if (suspend_gate) {
+    suspend_clock_gate(dwc2);
+  }
+#endif
 }
 
 #if CFG_TUD_TEST_MODE
@@ -40,27 +40,40 @@
 
 #include "dwc2_common.h"
 
+// gusbcfg with PHY selection, written before core reset and restored after since reset clears some of its fields
+static uint32_t _core_gusbcfg[DWC2_CONTROLLER_COUNT];
+
+// DMA burst configured by dwc2_core_set_ahb_burst(), bit 7 marks it as set, otherwise INCR4 is used
+static uint8_t _core_ahb_burst[DWC2_CONTROLLER_COUNT];
+
 //--------------------------------------------------------------------
 //
 //--------------------------------------------------------------------
-static void reset_core(dwc2_regs_t* dwc2) {
-  // reset core
+static void reset_core_start(dwc2_regs_t* dwc2) {
   dwc2->grstctl |= GRSTCTL_CSRST;
+}
 
+// Non-blocking check of core soft reset started by reset_core_start()
+static bool reset_core_done(dwc2_regs_t* dwc2) {
   if ((dwc2->gsnpsid & DWC2_CORE_REV_MASK) < (DWC2_CORE_REV_4_20a & DWC2_CORE_REV_MASK)) {
     // prior v42.0 CSRST is self-clearing
-    while (dwc2->grstctl & GRSTCTL_CSRST) {}
+    if (dwc2->grstctl & GRSTCTL_CSRST) {
+      return false;
+    }
   } else {
     // From v4.20a CSRST bit is write only, CSRT_DONE (w1c) is introduced for checking.
     // CSRST must also be explicitly cleared
-    while (!(dwc2->grstctl & GRSTCTL_CSRST_DONE)) {}
+    if (!(dwc2->grstctl & GRSTCTL_CSRST_DONE)) {
+      return false;
+    }
     dwc2->grstctl =  (dwc2->grstctl & ~GRSTCTL_CSRST) | GRSTCTL_CSRST_DONE;
   }
 
-  while (!(dwc2->grstctl & GRSTCTL_AHBIDL)) {} // wait for AHB master IDLE
+  while (!(dwc2->grstctl & GRSTCTL_AHBIDL)) {} // wait for AHB master IDLE, short once reset is done
+  return true;
 }
 
-static void phy_fs_init(dwc2_regs_t* dwc2) {
+static uint32_t phy_fs_select(dwc2_regs_t* dwc2) {
   TU_LOG(DWC2_COMMON_DEBUG, "Fullspeed PHY init\r\n");
 
   uint32_t gusbcfg = dwc2->gusbcfg;
@@ -72,9 +85,10 @@ static void phy_fs_init(dwc2_regs_t* dwc2) {
   // MCU specific PHY init before reset
   dwc2_phy_init(dwc2, GHWCFG2_HSPHY_NOT_SUPPORTED);
 
-  // Reset core after selecting PHY
-  reset_core(dwc2);
+  return gusbcfg;
+}
 
+static void phy_fs_update(dwc2_regs_t* dwc2, uint32_t gusbcfg) {
   // USB turnaround time is critical for certification where long cables and 5-Hubs are used.
   // So if you need the AHB to run at less than 30 MHz, and if USB turnaround time is not critical,
   // these bits can be programmed to a larger value. Default is 5
@@ -86,7 +100,7 @@ static void phy_fs_init(dwc2_regs_t* dwc2) {
   dwc2_phy_update(dwc2, GHWCFG2_HSPHY_NOT_SUPPORTED);
 }
 
-static void phy_hs_init(dwc2_regs_t* dwc2) {
+static uint32_t phy_hs_select(dwc2_regs_t* dwc2) {
   uint32_t gusbcfg = dwc2->gusbcfg;
 
   // De-select FS PHY
@@ -129,9 +143,10 @@ static void phy_hs_init(dwc2_regs_t* dwc2) {
   // mcu specific phy init
   dwc2_phy_init(dwc2, dwc2->ghwcfg2_bm.hs_phy_type);
 
-  // Reset core after selecting PHY
-  reset_core(dwc2);
+  return gusbcfg;
+}
 
+static void phy_hs_update(dwc2_regs_t* dwc2, uint32_t gusbcfg) {
   // Set turn-around, must after core reset otherwise it will be clear
   // - 9 if using 8-bit PHY interface
   // - 5 if using 16-bit PHY interface
@@ -194,7 +209,7 @@ bool dwc2_core_is_highspeed(dwc2_regs_t* dwc2, tusb_role_t role) {
  * In addition, UTMI+/ULPI can be shared to run at fullspeed mode with 48Mhz
  *
 */
-bool dwc2_core_init(uint8_t rhport, bool is_highspeed, bool is_dma) {
+bool dwc2_core_init_start(uint8_t rhport, bool is_highspeed) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
   // Check Synopsys ID register, failed if controller clock/power is not enabled
@@ -203,10 +218,25 @@ bool dwc2_core_init(uint8_t rhport, bool is_highspeed, bool is_dma) {
   // disable global interrupt
   dwc2->gahbcfg &= ~GAHBCFG_GINT;
 
+  // Reset core after selecting PHY
+  _core_gusbcfg[rhport < DWC2_CONTROLLER_COUNT ? rhport : 0] = is_highspeed ? phy_hs_select(dwc2) :
+                                                                              phy_fs_select(dwc2);
+  reset_core_start(dwc2);
+
+  return true;
+}
+
+bool dwc2_core_init_poll(uint8_t rhport, bool is_highspeed, bool is_dma) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  if (!reset_core_done(dwc2)) {
+    return false;
+  }
+
+  const uint32_t gusbcfg = _core_gusbcfg[rhport < DWC2_CONTROLLER_COUNT ? rhport : 0];
   if (is_highspeed) {
-    phy_hs_init(dwc2);
+    phy_hs_update(dwc2, gusbcfg);
   } else {
-    phy_fs_init(dwc2);
+    phy_fs_update(dwc2, gusbcfg);
   }
 
   /* Set HS/FS Timeout Calibration to 7 (max available value).
@@ -218,7 +248,7 @@ bool dwc2_core_init(uint8_t rhport, bool is_highspeed, bool is_dma) {
    * can vary from one PHY to another. */
   dwc2->gusbcfg |= (7ul << GUSBCFG_TOCAL_Pos);
 
-  // Enable PHY clock TODO stop/gate clock when suspended mode
+  // Enable PHY clock, device stops it while suspended with CFG_TUD_DWC2_SUSPEND_CLOCK_GATE
   dwc2->pcgcctl &= ~(PCGCCTL_STOPPCLK | PCGCCTL_GATEHCLK | PCGCCTL_PWRCLMP | PCGCCTL_RSTPDWNMODULE);
 
   dfifo_flush_tx(dwc2, 0x10); // all tx fifo
@@ -233,7 +263,10 @@ bool dwc2_core_init(uint8_t rhport, bool is_highspeed, bool is_dma) {
 
   if (is_dma) {
     // DMA seems to be only settable after a core reset, and not possible to switch on-the-fly
-    dwc2->gahbcfg |= GAHBCFG_DMAEN | GAHBCFG_HBSTLEN_2;
+    const uint8_t burst = _core_ahb_burst[rhport < DWC2_CONTROLLER_COUNT ? rhport : 0];
+    const uint32_t hbstlen = (burst & TU_BIT(7)) ? ((uint32_t) (burst & 0x0Fu) << GAHBCFG_HBSTLEN_Pos) :
+                                                   GAHBCFG_HBSTLEN_2;
+    dwc2->gahbcfg = (dwc2->gahbcfg & ~GAHBCFG_HBSTLEN_Msk) | GAHBCFG_DMAEN | hbstlen;
   } else {
     dwc2->gintmsk |= GINTSTS_RXFLVL;
   }
@@ -241,6 +274,19 @@ bool dwc2_core_init(uint8_t rhport, bool is_highspeed, bool is_dma) {
   return true;
 }
 
+bool dwc2_core_set_ahb_burst(uint8_t rhport, uint8_t hbstlen) {
+  // single, INCR, INCR4, INCR8, INCR16
+  TU_VERIFY(hbstlen == 0 || hbstlen == 1 || hbstlen == 3 || hbstlen == 5 || hbstlen == 7);
+  _core_ahb_burst[rhport < DWC2_CONTROLLER_COUNT ? rhport : 0] = (uint8_t) (TU_BIT(7) | hbstlen);
+  return true;
+}
+
+bool dwc2_core_init(uint8_t rhport, bool is_highspeed, bool is_dma) {
+  TU_ASSERT(dwc2_core_init_start(rhport, is_highspeed));
+  while (!dwc2_core_init_poll(rhport, is_highspeed, is_dma)) {}
+  return true;
+}
+
 // void dwc2_core_handle_common_irq(uint8_t rhport, bool in_isr) {
 //   (void) in_isr;
 //   dwc2_regs_t * const dwc2 = DWC2_REG(rhport);
@@ -74,8 +74,16 @@ TU_ATTR_ALWAYS_INLINE static inline dwc2_regs_t* DWC2_REG(uint8_t rhport) {
 
 bool dwc2_core_is_highspeed(dwc2_regs_t* dwc2, tusb_role_t role);
 bool dwc2_core_init(uint8_t rhport, bool is_highspeed, bool is_dma);
+
+// Non-blocking core init: select PHY and start core soft reset, then call dwc2_core_init_poll() until it returns true
+// to complete the init once reset is done
+bool dwc2_core_init_start(uint8_t rhport, bool is_highspeed);
+bool dwc2_core_init_poll(uint8_t rhport, bool is_highspeed, bool is_dma);
 void dwc2_core_handle_common_irq(uint8_t rhport, bool in_isr);
 
+// Set DMA burst (GAHBCFG.HBSTLEN) applied by next core init, false if not a valid burst type
+bool dwc2_core_set_ahb_burst(uint8_t rhport, uint8_t hbstlen);
+
 //--------------------------------------------------------------------+
 // DFIFO
 //--------------------------------------------------------------------+
@@ -91,8 +99,8 @@ TU_ATTR_ALWAYS_INLINE static inline void dfifo_flush_rx(dwc2_regs_t* dwc2) {
   while (dwc2->grstctl & GRSTCTL_RXFFLSH_Msk) {}
 }
 
-void dfifo_read_packet(dwc2_regs_t* dwc2, uint8_t* dst, uint16_t len);
-void dfifo_write_packet(dwc2_regs_t* dwc2, uint8_t fifo_num, uint8_t const* src, uint16_t len);
+TU_ATTR_FAST_FUNC void dfifo_read_packet(dwc2_regs_t* dwc2, uint8_t* dst, uint16_t len);
+TU_ATTR_FAST_FUNC void dfifo_write_packet(dwc2_regs_t* dwc2, uint8_t fifo_num, uint8_t const* src, uint16_t len);
 
 //--------------------------------------------------------------------+
 // DMA
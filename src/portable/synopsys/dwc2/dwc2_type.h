@@ -148,6 +148,14 @@ enum {
   HCTSIZ_PID_MDATA = 3,
 };
 
+// Split transaction position of isochronous OUT payload
+enum {
+  HCSPLT_XACTPOS_MID   = 0, // 00b
+  HCSPLT_XACTPOS_END   = 1, // 01b
+  HCSPLT_XACTPOS_BEGIN = 2, // 10b
+  HCSPLT_XACTPOS_ALL   = 3, // 11b
+};
+
 enum {
   GRXSTS_PKTSTS_GLOBAL_OUT_NAK      = 1,
   GRXSTS_PKTSTS_RX_DATA             = 2,
@@ -632,6 +640,14 @@ typedef struct {
 
 TU_VERIFY_STATIC(sizeof(dwc2_dep_t) == 0x20, "incorrect size");
 
+// Device Scatter/Gather DMA descriptor, DxEPDMA points to a list of these. Status bits are DDMA_DESC_*
+typedef struct {
+  volatile uint32_t status;
+  volatile uint32_t buf;
+} dwc2_ddma_desc_t;
+
+TU_VERIFY_STATIC(sizeof(dwc2_ddma_desc_t) == 8, "incorrect size");
+
 //--------------------------------------------------------------------
 // CSR Register Map
 //--------------------------------------------------------------------
@@ -936,6 +952,10 @@ TU_VERIFY_STATIC(offsetof(dwc2_regs_t, fifo   ) == 0x1000, "incorrect size");
 #define DCFG_XCVRDLY_Msk                 (0x1UL << DCFG_XCVRDLY_Pos)             // 0x00004000
 #define DCFG_XCVRDLY                     DCFG_XCVRDLY_Msk                        // Enables delay between xcvr_sel and txvalid during device chirp
 
+#define DCFG_DESCDMA_Pos                 (23U)
+#define DCFG_DESCDMA_Msk                 (0x1UL << DCFG_DESCDMA_Pos)              // 0x00800000
+#define DCFG_DESCDMA                     DCFG_DESCDMA_Msk                         // Enable Scatter/Gather DMA
+
 #define DCFG_PERSCHIVL_Pos               (24U)
 #define DCFG_PERSCHIVL_Msk               (0x3UL << DCFG_PERSCHIVL_Pos)            // 0x03000000
 #define DCFG_PERSCHIVL                   DCFG_PERSCHIVL_Msk                       // Periodic scheduling interval
@@ -2280,6 +2300,32 @@ TU_VERIFY_STATIC(offsetof(dwc2_regs_t, fifo   ) == 0x1000, "incorrect size");
 #define PCGCTL1_TIMER                   (0x3ul << 1)
 #define PCGCTL1_GATEEN                  TU_BIT(0)
 
+/********************  Device Scatter/Gather DMA descriptor status  ********************/
+#define DDMA_DESC_BS_Pos                 (30U)
+#define DDMA_DESC_BS_Msk                 (0x3UL << DDMA_DESC_BS_Pos)              // 0xC0000000
+#define DDMA_DESC_BS_HOST_READY          (0x0UL << DDMA_DESC_BS_Pos)              // Buffer is ready for DMA
+#define DDMA_DESC_BS_DMA_BUSY            (0x1UL << DDMA_DESC_BS_Pos)              // DMA is in progress
+#define DDMA_DESC_BS_DMA_DONE            (0x2UL << DDMA_DESC_BS_Pos)              // DMA is done
+#define DDMA_DESC_BS_HOST_BUSY           (0x3UL << DDMA_DESC_BS_Pos)              // Buffer is not ready
+#define DDMA_DESC_STS_Pos                (28U)
+#define DDMA_DESC_STS_Msk                (0x3UL << DDMA_DESC_STS_Pos)             // 0x30000000
+#define DDMA_DESC_STS_SUCCESS            (0x0UL << DDMA_DESC_STS_Pos)             // Tx/Rx status success
+#define DDMA_DESC_STS_BUF_ERR            (0x3UL << DDMA_DESC_STS_Pos)             // Tx/Rx status buffer error
+#define DDMA_DESC_L                      TU_BIT(27)                               // Last descriptor of list
+#define DDMA_DESC_SP                     TU_BIT(26)                               // Short packet
+#define DDMA_DESC_IOC                    TU_BIT(25)                               // Interrupt on complete
+#define DDMA_DESC_SR                     TU_BIT(24)                               // OUT: setup packet received
+#define DDMA_DESC_MTRF                   TU_BIT(23)                               // OUT: multiple transfer
+#define DDMA_DESC_NBYTES_Pos             (0U)
+#define DDMA_DESC_NBYTES_Msk             (0xFFFFUL << DDMA_DESC_NBYTES_Pos)       // Bytes to transfer, remaining when done
+
+#define DDMA_DESC_ISO_PID_Pos            (23U)
+#define DDMA_DESC_ISO_PID_Msk            (0x3UL << DDMA_DESC_ISO_PID_Pos)         // IN: number of packets in (micro)frame
+#define DDMA_DESC_ISO_FRNUM_Pos          (12U)
+#define DDMA_DESC_ISO_FRNUM_Msk          (0x7FFUL << DDMA_DESC_ISO_FRNUM_Pos)     // (Micro)frame number
+#define DDMA_DESC_ISO_IN_NBYTES_Msk      (0xFFFUL)                                // ISO IN bytes
+#define DDMA_DESC_ISO_OUT_NBYTES_Msk     (0x7FFUL)                                // ISO OUT bytes
+
 #ifdef __cplusplus
  }
 #endif
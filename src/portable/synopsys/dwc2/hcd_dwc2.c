@@ -36,6 +36,7 @@
 #define DWC2_DEBUG    2
 
 #include "host/hcd.h"
+#include "host/usbh.h"
 #include "dwc2_common.h"
 
 // Max number of endpoints application can open, can be larger than DWC2_CHANNEL_COUNT_MAX
@@ -43,6 +44,12 @@
 #define CFG_TUH_DWC2_ENDPOINT_MAX 16
 #endif
 
+// Number of (micro)frames a non-periodic transfer keeps its channel while other endpoints are waiting for one.
+// Slave mode also gives up the channel whenever it is NAKed, DMA mode is halted once this time slice is used up.
+#ifndef CFG_TUH_DWC2_CHANNEL_TIMESLICE
+#define CFG_TUH_DWC2_CHANNEL_TIMESLICE 4
+#endif
+
 #define DWC2_CHANNEL_COUNT_MAX    16 // absolute max channel count
 #define DWC2_CHANNEL_COUNT(_dwc2) tu_min8((_dwc2)->ghwcfg2_bm.num_host_ch + 1, DWC2_CHANNEL_COUNT_MAX)
 
@@ -60,6 +67,17 @@ enum {
   HCD_XFER_PERIOD_SPLIT_NYET_MAX = 3
 };
 
+enum {
+  HCD_SPLIT_ISO_XACT_MAX = 188 // max bytes of a start-split for isochronous OUT (USB 2.0 11.18.4)
+};
+
+// HFNUM frame number is 14-bit and counts SOFs (micro-frames for highspeed root port). Due frames are compared
+// modulo its range, so at most half of it can be waited at once, longer intervals are waited in steps.
+enum {
+  HCD_SOF_FRNUM_MASK = 0x3FFF,
+  HCD_SOF_WAIT_MAX   = (HCD_SOF_FRNUM_MASK + 1) / 2 - 1
+};
+
 //--------------------------------------------------------------------
 //
 //--------------------------------------------------------------------
@@ -80,13 +98,30 @@ typedef struct {
     uint32_t speed    : 2;
     uint32_t next_pid : 2;
     uint32_t do_ping  : 1;
-    // uint32_t : 9;
+    uint32_t pending  : 1; // transfer is waiting for a free channel
+    uint32_t sof_wait : 1; // periodic transfer is waiting for its due frame sof_due
+    // uint32_t : 7;
   };
 
-  uint32_t uframe_countdown; // micro-frame count down to transfer for periodic, only need 18-bit
+  hcd_split_sched_t split_sched; // micro-frames of start/complete-split planned for periodic split endpoint
+
+  uint16_t sof_due;       // frame number (HFNUM) when periodic transfer is started
+  uint16_t sof_wait_more; // SOFs to wait after sof_due for interval longer than HCD_SOF_WAIT_MAX
 
   uint8_t* buffer;
   uint16_t buflen;
+  uint16_t xferred_prev; // bytes transferred by previous channels of this transfer (channel is time-multiplexed)
+
+#if CFG_TUH_EDPT_ISO_XFER
+  // hcd_edpt_iso_xfer(): each packet is a channel transfer started in its service interval
+  tu_iso_packet_t* iso_packets; // NULL if not in progress
+  uint8_t* iso_buffer;
+  uint32_t iso_offset;   // offset of current packet in iso_buffer
+  uint32_t iso_xferred;  // total bytes of completed packets
+  uint16_t iso_count;
+  uint16_t iso_idx;      // current packet
+  uint8_t  iso_result;   // failed if any packet failed
+#endif
 } hcd_endpoint_t;
 
 // Additional info for each channel when it is active
@@ -100,6 +135,8 @@ typedef struct {
     uint8_t halted_sof_schedule : 1;
   };
   uint8_t result;
+  uint8_t sof_count; // (micro)frames channel is used while other endpoints are pending
+  bool preempt;      // channel is disabled to give it to a pending endpoint
 
   uint16_t xferred_bytes;  // bytes that accumulate transferred though USB bus for the whole hcd_edpt_xfer(), which can
                            // be composed of multiple channel_xfer_start() (retry with NAK/NYET)
@@ -109,9 +146,13 @@ typedef struct {
 typedef struct {
   hcd_xfer_t xfer[DWC2_CHANNEL_COUNT_MAX];
   hcd_endpoint_t edpt[CFG_TUH_DWC2_ENDPOINT_MAX];
+  uint8_t pending_count; // number of endpoints waiting for a channel
+  uint8_t sched_next;    // round-robin start for pending non-periodic endpoints
+  bool sof_due_valid;    // some periodic endpoints are waiting, earliest is due at sof_due_next
+  uint16_t sof_due_next;
 } hcd_data_t;
 
-hcd_data_t _hcd_data;
+TU_ATTR_FAST_DATA hcd_data_t _hcd_data;
 
 //--------------------------------------------------------------------
 //
@@ -137,24 +178,29 @@ TU_ATTR_ALWAYS_INLINE static inline bool dma_host_enabled(const dwc2_regs_t* dwc
 }
 
 #if CFG_TUH_MEM_DCACHE_ENABLE
+// no maintenance needed for buffer in non-cacheable memory
+TU_ATTR_ALWAYS_INLINE static inline bool dcache_skip(const void* addr, uint32_t data_size) {
+  return tu_mem_within(addr, data_size, CFG_TUH_MEM_NONCACHEABLE_ADDR, CFG_TUH_MEM_NONCACHEABLE_SIZE);
+}
+
 bool hcd_dcache_clean(const void* addr, uint32_t data_size) {
   TU_VERIFY(addr && data_size);
-  return dwc2_dcache_clean(addr, data_size);
+  return dcache_skip(addr, data_size) || dwc2_dcache_clean(addr, data_size);
 }
 
 bool hcd_dcache_invalidate(const void* addr, uint32_t data_size) {
   TU_VERIFY(addr && data_size);
-  return dwc2_dcache_invalidate(addr, data_size);
+  return dcache_skip(addr, data_size) || dwc2_dcache_invalidate(addr, data_size);
 }
 
 bool hcd_dcache_clean_invalidate(const void* addr, uint32_t data_size) {
   TU_VERIFY(addr && data_size);
-  return dwc2_dcache_clean_invalidate(addr, data_size);
+  return dcache_skip(addr, data_size) || dwc2_dcache_clean_invalidate(addr, data_size);
 }
 #endif
 
 // Allocate a channel for new transfer
-TU_ATTR_ALWAYS_INLINE static inline uint8_t channel_alloc(dwc2_regs_t* dwc2) {
+static uint8_t channel_alloc(dwc2_regs_t* dwc2) {
   const uint8_t max_channel = DWC2_CHANNEL_COUNT(dwc2);
   for (uint8_t ch_id = 0; ch_id < max_channel; ch_id++) {
     hcd_xfer_t* xfer = &_hcd_data.xfer[ch_id];
@@ -242,6 +288,56 @@ TU_ATTR_ALWAYS_INLINE static inline uint8_t edpt_find_opened(uint8_t dev_addr, u
   return TUSB_INDEX_INVALID_8;
 }
 
+// Transfer is waiting for a channel, started by channel_schedule() when one is free. SOF is enabled to make sure
+// it is picked up even if no channel is released in the meantime
+static void edpt_pending_set(dwc2_regs_t* dwc2, hcd_endpoint_t* edpt) {
+  if (!edpt->pending) {
+    edpt->pending = 1;
+    _hcd_data.pending_count++;
+  }
+  dwc2->gintmsk |= GINTSTS_SOF;
+}
+
+// Frame number (HFNUM) has reached due frame
+TU_ATTR_ALWAYS_INLINE static inline bool sof_due_reached(uint16_t frnum, uint16_t due) {
+  return ((uint16_t) (frnum - due) & HCD_SOF_FRNUM_MASK) <= HCD_SOF_WAIT_MAX;
+}
+
+// Due frame a is earlier than b
+TU_ATTR_ALWAYS_INLINE static inline bool sof_due_before(uint16_t a, uint16_t b) {
+  return a != b && sof_due_reached(b, a);
+}
+
+// Periodic transfer waits for its interval or planned micro-frame. Instead of counting down each endpoint in every
+// SOF, the due frame is stored and SOF interrupt only walks endpoints once the earliest due frame is reached.
+static void edpt_sof_schedule(dwc2_regs_t* dwc2, hcd_endpoint_t* edpt, uint32_t uframes) {
+  // SOF is every micro-frame on highspeed root port, every frame otherwise
+  uint32_t sof_count = (hprt_speed_get(dwc2) == TUSB_SPEED_HIGH) ? uframes : tu_div_ceil(uframes, 8);
+  if (sof_count > HCD_SOF_WAIT_MAX) {
+    edpt->sof_wait_more = (uint16_t) (sof_count - HCD_SOF_WAIT_MAX);
+    sof_count = HCD_SOF_WAIT_MAX;
+  } else {
+    edpt->sof_wait_more = 0;
+  }
+
+  const uint16_t due = (uint16_t) ((dwc2->hfnum + sof_count) & HCD_SOF_FRNUM_MASK);
+  edpt->sof_due = due;
+  edpt->sof_wait = 1;
+
+  if (!_hcd_data.sof_due_valid || sof_due_before(due, _hcd_data.sof_due_next)) {
+    _hcd_data.sof_due_next = due;
+    _hcd_data.sof_due_valid = true;
+  }
+  dwc2->gintmsk |= GINTSTS_SOF;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void edpt_pending_clear(hcd_endpoint_t* edpt) {
+  if (edpt->pending) {
+    edpt->pending = 0;
+    _hcd_data.pending_count--;
+  }
+}
+
 TU_ATTR_ALWAYS_INLINE static inline uint16_t cal_packet_count(uint16_t len, uint16_t ep_size) {
   if (len == 0) {
     return 1;
@@ -258,6 +354,64 @@ TU_ATTR_ALWAYS_INLINE static inline uint8_t cal_next_pid(uint8_t pid, uint8_t pa
   }
 }
 
+// Isochronous has no data toggle, PID is determined by number of transactions per micro-frame (USB 2.0 5.9.2).
+// multi_count is 0 for full/low speed (no high-bandwidth) which uses DATA0 as well
+TU_ATTR_ALWAYS_INLINE static inline uint8_t cal_iso_pid(uint8_t multi_count, uint8_t ep_dir, uint16_t packet_count) {
+  if (ep_dir == TUSB_DIR_IN) {
+    // start PID expected from device: DATA2 for 3, DATA1 for 2 transactions
+    return (multi_count == 3) ? HCTSIZ_PID_DATA2 : (multi_count == 2) ? HCTSIZ_PID_DATA1 : HCTSIZ_PID_DATA0;
+  } else {
+    // core sends MDATA for all except the last transaction of the micro-frame
+    return (multi_count > 1 && packet_count > 1) ? HCTSIZ_PID_MDATA : HCTSIZ_PID_DATA0;
+  }
+}
+
+TU_ATTR_ALWAYS_INLINE static inline bool edpt_is_split_iso_out(const hcd_endpoint_t* edpt) {
+  return edpt->hcsplt_bm.split_en && edpt->hcchar_bm.ep_type == TUSB_XFER_ISOCHRONOUS &&
+         edpt->hcchar_bm.ep_dir == TUSB_DIR_OUT;
+}
+
+// Bytes to transfer with next channel start: split isochronous OUT is sent as up to 188-byte pieces,
+// one start-split per micro-frame. Otherwise the whole buffer is transferred by a channel as multiple packets, limited
+// by width of hctsiz transfer size and packet count (split into full-packet pieces if larger)
+static uint16_t edpt_channel_len(const dwc2_regs_t* dwc2, const hcd_endpoint_t* edpt) {
+  if (edpt_is_split_iso_out(edpt)) {
+    return tu_min16(edpt->buflen, HCD_SPLIT_ISO_XACT_MAX);
+  }
+
+  const uint16_t ep_size = edpt->hcchar_bm.ep_size;
+  const uint32_t packet_max = TU_BIT(4 + dwc2->ghwcfg3_bm.packet_size_width) - 1;
+  const uint32_t xfer_size_max = TU_BIT(11 + dwc2->ghwcfg3_bm.xfer_size_width) - 1;
+  const uint32_t len_max = tu_min32(packet_max * ep_size, (xfer_size_max / ep_size) * ep_size);
+  return (uint16_t) tu_min32(edpt->buflen, len_max);
+}
+
+// Micro-frames to wait so that start-split of a periodic split endpoint is issued in its planned micro-frame.
+// Channel enabled now is scheduled for the next micro-frame (root port is highspeed when split is used).
+static uint8_t edpt_split_uframe_wait(dwc2_regs_t* dwc2, const hcd_endpoint_t* edpt) {
+  const uint8_t smask = edpt->split_sched.smask;
+  if (!edpt->hcsplt_bm.split_en || smask == 0) {
+    return 0;
+  }
+
+  uint8_t ss_uframe = 0;
+  while (!(smask & TU_BIT(ss_uframe))) {
+    ss_uframe++;
+  }
+
+  const uint8_t next_uframe = (uint8_t) ((dwc2->hfnum + 1) & 0x07u);
+  return (uint8_t) ((ss_uframe - next_uframe) & 0x07u);
+}
+
+// Max complete-split retries on NYET: one per planned complete-split micro-frame
+TU_ATTR_ALWAYS_INLINE static inline uint8_t edpt_split_nyet_max(const hcd_endpoint_t* edpt) {
+  uint8_t count = 0;
+  for (uint8_t cmask = edpt->split_sched.cmask; cmask; cmask >>= 1) {
+    count += (cmask & 1u);
+  }
+  return tu_max8(count, HCD_XFER_PERIOD_SPLIT_NYET_MAX);
+}
+
 //--------------------------------------------------------------------
 //
 //--------------------------------------------------------------------
@@ -341,9 +495,11 @@ static void dfifo_host_init(uint8_t rhport) {
 
 // optional hcd configuration, called by tuh_configure()
 bool hcd_configure(uint8_t rhport, uint32_t cfg_id, const void* cfg_param) {
-  (void) rhport;
-  (void) cfg_id;
-  (void) cfg_param;
+  if (cfg_id == TUH_CFGID_DWC2) {
+    TU_VERIFY(cfg_param != NULL);
+    const tuh_configure_dwc2_t* cfg = (const tuh_configure_dwc2_t*) cfg_param;
+    return dwc2_core_set_ahb_burst(rhport, cfg->ahb_burst);
+  }
 
   return true;
 }
@@ -441,12 +597,60 @@ tusb_speed_t hcd_port_speed_get(uint8_t rhport) {
   return speed;
 }
 
+// Send LPM token to device on roothub port to put link into L1 sleep. Return true if device ACKed it.
+// Token is sent on a free channel addressed to control endpoint of the device, all channels must be idle.
+bool hcd_port_lpm_sleep(uint8_t rhport, uint8_t dev_addr, uint8_t besl, bool remote_wakeup) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  TU_VERIFY(dwc2->ghwcfg3_bm.lpm_mode && !(dwc2->glpmcfg & GLPMCFG_SLPSTS));
+
+  const uint8_t max_channel = DWC2_CHANNEL_COUNT(dwc2);
+  for (uint8_t i = 0; i < max_channel; i++) {
+    TU_VERIFY(!_hcd_data.xfer[i].allocated);
+  }
+  const uint8_t ch_id = channel_alloc(dwc2);
+  TU_VERIFY(ch_id < 16); // LPMCHIDX is 4-bit
+
+  dwc2_channel_t* channel = &dwc2->channel[ch_id];
+  channel->hcchar = ((uint32_t) dev_addr << HCCHAR_DAD_Pos) | ((uint32_t) HCCHAR_EPTYPE_CONTROL << HCCHAR_EPTYP_Pos) | 64u;
+
+  // 3 retries, LPMRCNTSTS and LPMRSP are updated when core clears SNDLPM
+  dwc2->glpmcfg = GLPMCFG_LPMEN | GLPMCFG_ENBESL | (((uint32_t) besl & 0xFu) << GLPMCFG_BESL_Pos) |
+                  (remote_wakeup ? GLPMCFG_REMWAKE : 0) | ((uint32_t) ch_id << GLPMCFG_LPMCHIDX_Pos) |
+                  (3u << GLPMCFG_LPMRCNT_Pos) | GLPMCFG_SNDLPM;
+
+  // LPM transaction takes a few microseconds: wait at most a couple of frames
+  const uint32_t start = hcd_frame_number(rhport);
+  while ((dwc2->glpmcfg & GLPMCFG_SNDLPM) && ((hcd_frame_number(rhport) - start) & HFNUM_FRNUM_Msk) < 3) {}
+
+  const uint32_t glpmcfg = dwc2->glpmcfg;
+  dwc2->gintsts = GINTSTS_LPMINT;
+  channel_dealloc(dwc2, ch_id);
+
+  // LPMRSP: 0 = no response, 1 = STALL, 2 = NYET, 3 = ACK
+  return !(glpmcfg & GLPMCFG_SNDLPM) && ((glpmcfg & GLPMCFG_LPMRSP) >> GLPMCFG_LPMRSP_Pos) == 3u;
+}
+
+// Resume link from L1 sleep: core drives resume signal for BESL duration then clears PRES by itself
+bool hcd_port_lpm_resume(uint8_t rhport) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  TU_VERIFY(dwc2->glpmcfg & GLPMCFG_SLPSTS);
+  uint32_t hprt = dwc2->hprt & ~HPRT_W1_MASK;
+  hprt |= HPRT_RESUME;
+  dwc2->hprt = hprt;
+  return true;
+}
+
 // HCD closes all opened endpoints belong to this device
 void hcd_device_close(uint8_t rhport, uint8_t dev_addr) {
-  (void) rhport;
   for (uint8_t i = 0; i < (uint8_t) CFG_TUH_DWC2_ENDPOINT_MAX; i++) {
     hcd_endpoint_t* edpt = &_hcd_data.edpt[i];
     if (edpt->hcchar_bm.enable && edpt->hcchar_bm.dev_addr == dev_addr) {
+      if (edpt->split_sched.smask) {
+        hcd_split_release(rhport, edpt->hcsplt_bm.hub_addr, edpt->hcsplt_bm.hub_port, edpt->speed,
+                          edpt->hcchar_bm.ep_type, edpt->hcchar_bm.ep_dir, edpt->hcchar_bm.ep_size,
+                          &edpt->split_sched);
+      }
+      edpt_pending_clear(edpt);
       tu_memclr(edpt, sizeof(hcd_endpoint_t));
     }
   }
@@ -477,6 +681,10 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, const tusb_desc_endpoint_t*
   hcchar_bm->ep_type         = desc_ep->bmAttributes.xfer; // ep_type matches TUSB_XFER_*
   hcchar_bm->err_multi_count = 0;
   hcchar_bm->dev_addr        = dev_addr;
+  if (edpt_is_periodic(desc_ep->bmAttributes.xfer) && devtree_info.speed == TUSB_SPEED_HIGH) {
+    // high-bandwidth: multi count is number of transactions per micro-frame
+    hcchar_bm->err_multi_count = tu_edpt_hs_mult(desc_ep);
+  }
   hcchar_bm->odd_frame       = 0;
   hcchar_bm->disable         = 0;
   hcchar_bm->enable          = 1;
@@ -490,6 +698,16 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, const tusb_desc_endpoint_t*
 
   edpt->speed = devtree_info.speed;
   edpt->next_pid = HCTSIZ_PID_DATA0;
+
+  // periodic split: reserve hub's TT time and get micro-frames of start/complete-split
+  if (hcsplt_bm->split_en && edpt_is_periodic(desc_ep->bmAttributes.xfer)) {
+    if (!hcd_split_reserve(rhport, devtree_info.hub_addr, devtree_info.hub_port, devtree_info.speed,
+                           desc_ep->bmAttributes.xfer, hcchar_bm->ep_dir, hcchar_bm->ep_size, &edpt->split_sched)) {
+      TU_LOG1("DWC2: not enough TT bandwidth for EP %02X\r\n", desc_ep->bEndpointAddress);
+      tu_memclr(edpt, sizeof(hcd_endpoint_t));
+      return false;
+    }
+  }
   if (desc_ep->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS) {
     edpt->uframe_interval = 1 << (desc_ep->bInterval - 1);
     if (devtree_info.speed == TUSB_SPEED_FULL) {
@@ -547,8 +765,12 @@ static bool channel_xfer_start(dwc2_regs_t* dwc2, uint8_t ch_id) {
   channel->hcchar = (edpt->hcchar & ~HCCHAR_CHENA);
 
   // hctsiz: zero length packet still count as 1
-  const uint16_t packet_count = cal_packet_count(edpt->buflen, hcchar_bm->ep_size);
-  uint32_t hctsiz = (edpt->next_pid << HCTSIZ_PID_Pos) | (packet_count << HCTSIZ_PKTCNT_Pos) | edpt->buflen;
+  const uint16_t xfer_len = edpt_channel_len(dwc2, edpt);
+  const uint16_t packet_count = cal_packet_count(xfer_len, hcchar_bm->ep_size);
+  if (hcchar_bm->ep_type == TUSB_XFER_ISOCHRONOUS) {
+    edpt->next_pid = cal_iso_pid(hcchar_bm->err_multi_count, hcchar_bm->ep_dir, packet_count);
+  }
+  uint32_t hctsiz = (edpt->next_pid << HCTSIZ_PID_Pos) | (packet_count << HCTSIZ_PKTCNT_Pos) | xfer_len;
   if (edpt->do_ping && edpt->speed == TUSB_SPEED_HIGH &&
      edpt->next_pid != HCTSIZ_PID_SETUP && hcchar_bm->ep_dir == TUSB_DIR_OUT) {
     hctsiz |= HCTSIZ_DOPING;
@@ -564,6 +786,13 @@ static bool channel_xfer_start(dwc2_regs_t* dwc2, uint8_t ch_id) {
   }
 
   channel->hcsplt = edpt->hcsplt;
+  if (edpt_is_split_iso_out(edpt)) {
+    // position of this piece within the packet
+    const bool is_first = (xfer->xferred_bytes == 0);
+    const bool is_last = (xfer_len == edpt->buflen);
+    channel->hcsplt_bm.xact_pos = is_first ? (is_last ? HCSPLT_XACTPOS_ALL : HCSPLT_XACTPOS_BEGIN) :
+                                             (is_last ? HCSPLT_XACTPOS_END : HCSPLT_XACTPOS_MID);
+  }
   channel->hcint = 0xFFFFFFFFU; // clear all channel interrupts
 
   if (dma_host_enabled(dwc2)) {
@@ -576,7 +805,7 @@ static bool channel_xfer_start(dwc2_regs_t* dwc2, uint8_t ch_id) {
     if (hcchar_bm->ep_dir == TUSB_DIR_IN) {
       channel_send_in_token(dwc2, channel);
     } else {
-      hcd_dcache_clean(edpt->buffer, edpt->buflen);
+      hcd_dcache_clean(edpt->buffer, xfer_len);
       channel->hcchar |= HCCHAR_CHENA;
     }
   } else {
@@ -601,7 +830,7 @@ static bool channel_xfer_start(dwc2_regs_t* dwc2, uint8_t ch_id) {
       channel_send_in_token(dwc2, channel);
     } else {
       channel->hcchar |= HCCHAR_CHENA;
-      if (edpt->buflen > 0) {
+      if (xfer_len > 0) {
         // To prevent conflict with other channel, we will enable periodic/non-periodic FIFO empty interrupt accordingly
         // And write packet in the interrupt handler
         dwc2->gintmsk |= (is_period ? GINTSTS_PTX_FIFO_EMPTY : GINTSTS_NPTX_FIFO_EMPTY);
@@ -612,10 +841,10 @@ static bool channel_xfer_start(dwc2_regs_t* dwc2, uint8_t ch_id) {
   return true;
 }
 
-// kick-off transfer with an endpoint
+// kick-off transfer with an endpoint, return false if all channels are in used
 static bool edpt_xfer_kickoff(dwc2_regs_t* dwc2, uint8_t ep_id) {
   uint8_t ch_id = channel_alloc(dwc2);
-  TU_ASSERT(ch_id < 16); // all channel are in used
+  TU_VERIFY(ch_id < 16); // all channel are in used
   hcd_xfer_t* xfer = &_hcd_data.xfer[ch_id];
   xfer->ep_id = ep_id;
   xfer->result = XFER_RESULT_INVALID;
@@ -623,6 +852,67 @@ static bool edpt_xfer_kickoff(dwc2_regs_t* dwc2, uint8_t ep_id) {
   return channel_xfer_start(dwc2, ch_id);
 }
 
+// Give up channel of a transfer that is not complete yet, it is continued later when a channel is free.
+// Caller must already advance edpt buffer with xferred_bytes of this channel
+static void channel_xfer_requeue(dwc2_regs_t* dwc2, uint8_t ch_id) {
+  hcd_xfer_t* xfer = &_hcd_data.xfer[ch_id];
+  dwc2_channel_t* channel = &dwc2->channel[ch_id];
+  hcd_endpoint_t* edpt = &_hcd_data.edpt[xfer->ep_id];
+
+  edpt->next_pid = channel->hctsiz_bm.pid; // save PID
+  edpt->xferred_prev += xfer->xferred_bytes;
+  _hcd_data.sched_next = (uint8_t) (xfer->ep_id + 1); // other pending endpoints go first
+  channel_dealloc(dwc2, ch_id);
+  edpt_pending_set(dwc2, edpt);
+}
+
+// Start pending transfers on free channels: periodic endpoints first, then non-periodic in round-robin order
+static void channel_schedule(dwc2_regs_t* dwc2) {
+  for (uint8_t pass = 0; pass < 2; pass++) {
+    const bool is_period = (pass == 0);
+    for (uint8_t i = 0; i < CFG_TUH_DWC2_ENDPOINT_MAX && _hcd_data.pending_count; i++) {
+      const uint8_t ep_id = (uint8_t) (is_period ? i : (_hcd_data.sched_next + i) % CFG_TUH_DWC2_ENDPOINT_MAX);
+      hcd_endpoint_t* edpt = &_hcd_data.edpt[ep_id];
+      if (!edpt->pending || edpt_is_periodic(edpt->hcchar_bm.ep_type) != is_period) {
+        continue;
+      }
+
+      const uint8_t uframe_wait = edpt_split_uframe_wait(dwc2, edpt);
+      if (uframe_wait) {
+        // not yet planned start-split micro-frame, continue in SOF
+        edpt_pending_clear(edpt);
+        edpt_sof_schedule(dwc2, edpt, uframe_wait);
+        continue;
+      }
+
+      if (!edpt_xfer_kickoff(dwc2, ep_id)) {
+        return; // no more free channel
+      }
+      edpt_pending_clear(edpt);
+      if (!is_period) {
+        _hcd_data.sched_next = (uint8_t) (ep_id + 1);
+      }
+    }
+  }
+}
+
+// Start transfer of endpoint now, or in SOF interrupt for planned start-split micro-frame of periodic split
+static void edpt_xfer_begin(dwc2_regs_t* dwc2, uint8_t ep_id) {
+  hcd_endpoint_t* edpt = &_hcd_data.edpt[ep_id];
+
+  // periodic split: wait for planned start-split micro-frame in SOF interrupt
+  const uint8_t uframe_wait = edpt_split_uframe_wait(dwc2, edpt);
+  if (uframe_wait) {
+    edpt_sof_schedule(dwc2, edpt, uframe_wait);
+    return;
+  }
+
+  // all channels are in used: wait for one, periodic transfers are served first
+  if (!edpt_xfer_kickoff(dwc2, ep_id)) {
+    edpt_pending_set(dwc2, edpt);
+  }
+}
+
 // Submit a transfer, when complete hcd_event_xfer_complete() must be invoked
 bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t * buffer, uint16_t buflen) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
@@ -635,15 +925,93 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
 
   edpt->buffer = buffer;
   edpt->buflen = buflen;
+  edpt->xferred_prev = 0;
 
   if (ep_num == 0) {
     // update ep_dir since control endpoint can switch direction
     edpt->hcchar_bm.ep_dir = ep_dir;
   }
 
-  return edpt_xfer_kickoff(dwc2, ep_id);
+  edpt_xfer_begin(dwc2, ep_id);
+  return true;
+}
+
+#if CFG_TUH_EDPT_ISO_XFER
+bool hcd_edpt_iso_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t* buffer,
+                       tu_iso_packet_t* packets, uint16_t packet_count, uint32_t* start_frame) {
+  dwc2_regs_t* dwc2 = DWC2_REG(rhport);
+  const uint8_t ep_id = edpt_find_opened(dev_addr, tu_edpt_number(ep_addr), tu_edpt_dir(ep_addr));
+  TU_VERIFY(ep_id < CFG_TUH_DWC2_ENDPOINT_MAX && packet_count);
+  hcd_endpoint_t* edpt = &_hcd_data.edpt[ep_id];
+  TU_VERIFY(edpt->hcchar_bm.ep_type == HCCHAR_EPTYPE_ISOCHRONOUS && edpt->iso_packets == NULL);
+
+  const uint32_t pkt_max = (uint32_t) edpt->hcchar_bm.ep_size * tu_max8(1, edpt->hcchar_bm.err_multi_count);
+  for (uint16_t i = 0; i < packet_count; i++) {
+    TU_VERIFY(packets[i].len <= pkt_max);
+  }
+
+  // frame number counts SOFs, channel enabled now transfers in the next one
+  const uint16_t now = (uint16_t) (hcd_frame_number(rhport) & HCD_SOF_FRNUM_MASK);
+  uint16_t delay = 1;
+  if (*start_frame != TU_ISO_START_ASAP) {
+    delay = (uint16_t) ((*start_frame - now) & HCD_SOF_FRNUM_MASK);
+    TU_VERIFY(delay >= 1 && delay <= HCD_SOF_WAIT_MAX);
+  }
+  *start_frame = (uint16_t) ((now + delay) & HCD_SOF_FRNUM_MASK);
+
+  edpt->iso_packets  = packets;
+  edpt->iso_buffer   = buffer;
+  edpt->iso_offset   = 0;
+  edpt->iso_xferred  = 0;
+  edpt->iso_count    = packet_count;
+  edpt->iso_idx      = 0;
+  edpt->iso_result   = XFER_RESULT_SUCCESS;
+  edpt->buffer       = buffer;
+  edpt->buflen       = packets[0].len;
+  edpt->xferred_prev = 0;
+
+  if (delay > 1) {
+    const bool is_highspeed = (hprt_speed_get(dwc2) == TUSB_SPEED_HIGH);
+    edpt_sof_schedule(dwc2, edpt, (uint32_t) (delay - 1) * (is_highspeed ? 1u : 8u));
+  } else {
+    edpt_xfer_begin(dwc2, ep_id);
+  }
+  return true;
 }
 
+// Record completed packet of hcd_edpt_iso_xfer() and schedule the next one in its service interval.
+// Return false if it was the last packet.
+static bool edpt_iso_packet_done(dwc2_regs_t* dwc2, hcd_endpoint_t* edpt, uint32_t xferred_bytes, uint8_t result) {
+  tu_iso_packet_t* packet = &edpt->iso_packets[edpt->iso_idx];
+  packet->actual_len = (uint16_t) xferred_bytes;
+  packet->result     = result;
+  edpt->iso_xferred += xferred_bytes;
+  if (result != XFER_RESULT_SUCCESS) {
+    edpt->iso_result = XFER_RESULT_FAILED;
+  }
+
+  edpt->iso_offset += packet->len;
+  edpt->iso_idx++;
+  if (edpt->iso_idx >= edpt->iso_count) {
+    edpt->iso_packets = NULL;
+    return false;
+  }
+
+  edpt->buffer       = edpt->iso_buffer + edpt->iso_offset;
+  edpt->buflen       = edpt->iso_packets[edpt->iso_idx].len;
+  edpt->xferred_prev = 0;
+
+  // next packet is due one interval after this one, channel enabled now transfers in the next (micro)frame
+  const uint32_t sof_uframes = (hprt_speed_get(dwc2) == TUSB_SPEED_HIGH) ? 1u : 8u;
+  if (edpt->uframe_interval > sof_uframes) {
+    edpt_sof_schedule(dwc2, edpt, edpt->uframe_interval - sof_uframes);
+  } else {
+    edpt_pending_set(dwc2, edpt); // started by channel_schedule() once this channel is released
+  }
+  return true;
+}
+#endif
+
 // Abort a queued transfer. Note: it can only abort transfer that has not been started
 // Return true if a queued transfer is aborted, false if there is no transfer to abort
 bool hcd_edpt_abort_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr) {
@@ -652,9 +1020,20 @@ bool hcd_edpt_abort_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr) {
   const uint8_t ep_dir = tu_edpt_dir(ep_addr);
   const uint8_t ep_id = edpt_find_opened(dev_addr, ep_num, ep_dir);
   TU_VERIFY(ep_id < CFG_TUH_DWC2_ENDPOINT_MAX);
+  hcd_endpoint_t* edpt = &_hcd_data.edpt[ep_id];
 
   // hcd_int_disable(rhport);
 
+  // transfer is waiting for a channel, not started yet
+  edpt_pending_clear(edpt);
+
+#if CFG_TUH_EDPT_ISO_XFER
+  if (edpt->iso_packets) {
+    edpt->iso_packets = NULL;
+    edpt->sof_wait = 0; // next packet is waiting for its interval
+  }
+#endif
+
   // Find enabled channeled and disable it, channel will be de-allocated in the interrupt handler
   const uint8_t ch_id = channel_find_enabled(dwc2, dev_addr, ep_num, ep_dir);
   if (ch_id < 16) {
@@ -704,7 +1083,7 @@ static void channel_xfer_in_retry(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hci
     if (channel->hcsplt_bm.split_en && channel->hcsplt_bm.split_compl && (hcint & HCINT_NYET || xfer->halted_nyet)) {
       xfer->period_split_nyet_count++;
       xfer->halted_nyet = 0;
-      if (xfer->period_split_nyet_count < HCD_XFER_PERIOD_SPLIT_NYET_MAX) {
+      if (xfer->period_split_nyet_count < edpt_split_nyet_max(edpt)) {
         channel->hcchar_bm.odd_frame = 1 - (dwc2->hfnum & 1); // transfer on next frame
         channel_send_in_token(dwc2, channel);
         return;
@@ -714,10 +1093,9 @@ static void channel_xfer_in_retry(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hci
       }
     }
 
-    // for periodic, de-allocate channel, enable SOF set frame counter for later transfer
+    // for periodic, de-allocate channel, enable SOF and set due frame for later transfer
     edpt->next_pid = channel->hctsiz_bm.pid; // save PID
-    edpt->uframe_countdown = edpt->uframe_interval;
-    dwc2->gintmsk |= GINTSTS_SOF;
+    edpt_sof_schedule(dwc2, edpt, edpt->uframe_interval);
 
     if (hcint & HCINT_HALTED) {
       // already halted, de-allocate channel (called from DMA isr)
@@ -752,7 +1130,7 @@ TU_ATTR_ALWAYS_INLINE static inline void print_hcint(uint32_t hcint) {
 #endif
 
 #if CFG_TUH_DWC2_SLAVE_ENABLE
-static void handle_rxflvl_irq(uint8_t rhport) {
+TU_ATTR_FAST_FUNC static void handle_rxflvl_irq(uint8_t rhport) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
   // Pop control word off FIFO
@@ -785,8 +1163,8 @@ static void handle_rxflvl_irq(uint8_t rhport) {
       break;
 
     case GRXSTS_PKTSTS_HOST_CHANNEL_HALTED:
-      // triggered when channel.hcchar_bm.disable is set
-      // TODO handle later
+      // triggered when channel.hcchar_bm.disable is set. Nothing to read, halted interrupt is handled by
+      // handle_channel_irq()
       break;
 
     default: break; // ignore other status
@@ -794,7 +1172,7 @@ static void handle_rxflvl_irq(uint8_t rhport) {
 }
 
 // return true if there is still pending data and need more ISR
-static bool handle_txfifo_empty(dwc2_regs_t* dwc2, bool is_periodic) {
+TU_ATTR_FAST_FUNC static bool handle_txfifo_empty(dwc2_regs_t* dwc2, bool is_periodic) {
   // Use period txsts for both p/np to get request queue space available (1-bit difference, it is small enough)
   volatile dwc2_hptxsts_t* txsts_bm = (volatile dwc2_hptxsts_t*) (is_periodic ? &dwc2->hptxsts : &dwc2->hnptxsts);
 
@@ -809,7 +1187,7 @@ static bool handle_txfifo_empty(dwc2_regs_t* dwc2, bool is_periodic) {
 
       const uint16_t remain_packets = channel->hctsiz_bm.packet_count;
       for (uint16_t i = 0; i < remain_packets; i++) {
-        const uint16_t remain_bytes = edpt->buflen - xfer->fifo_bytes;
+        const uint16_t remain_bytes = edpt_channel_len(dwc2, edpt) - xfer->fifo_bytes;
         const uint16_t xact_bytes = tu_min16(remain_bytes, channel->hcchar_bm.ep_size);
 
         // skip if there is not enough space in FIFO and RequestQueue.
@@ -827,7 +1205,7 @@ static bool handle_txfifo_empty(dwc2_regs_t* dwc2, bool is_periodic) {
   return false; // no channel has pending data
 }
 
-static bool handle_channel_in_slave(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hcint) {
+TU_ATTR_FAST_FUNC static bool handle_channel_in_slave(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hcint) {
   hcd_xfer_t* xfer = &_hcd_data.xfer[ch_id];
   dwc2_channel_t* channel = &dwc2->channel[ch_id];
   hcd_endpoint_t* edpt = &_hcd_data.edpt[xfer->ep_id];
@@ -845,9 +1223,16 @@ static bool handle_channel_in_slave(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t h
     }
 
     const uint16_t remain_packets = channel->hctsiz_bm.packet_count;
+    const uint16_t xfer_len = edpt_channel_len(dwc2, edpt);
     if (channel->hcsplt_bm.split_en && remain_packets && xfer->fifo_bytes == edpt->hcchar_bm.ep_size) {
       // Split can only complete 1 transaction (up to 1 packet) at a time, schedule more
       channel->hcsplt_bm.split_compl = 0;
+    } else if (xfer->xferred_bytes == xfer_len && xfer_len < edpt->buflen) {
+      // buffer is larger than a channel can transfer, start next piece when halted
+      edpt->buffer += xfer_len;
+      edpt->buflen -= xfer_len;
+      edpt->xferred_prev += xfer_len;
+      xfer->xferred_bytes = 0;
     } else {
       xfer->result = XFER_RESULT_SUCCESS;
     }
@@ -907,6 +1292,14 @@ static bool handle_channel_in_slave(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t h
     } else if (xfer->err_count == HCD_XFER_ERROR_MAX) {
       xfer->result = XFER_RESULT_FAILED;
       is_done = true;
+    } else if (channel->hctsiz_bm.packet_count == 0) {
+      // next piece of a large transfer
+      channel_xfer_start(dwc2, ch_id);
+    } else if (_hcd_data.pending_count && !xfer->halted_nyet && !edpt_is_periodic(channel->hcchar_bm.ep_type)) {
+      // NAKed while other endpoints are waiting: give up channel, data is read to buffer + xferred_bytes
+      edpt->buffer += xfer->xferred_bytes;
+      edpt->buflen -= xfer->xferred_bytes;
+      channel_xfer_requeue(dwc2, ch_id);
     } else {
       // got here due to NAK or NYET
       channel_xfer_in_retry(dwc2, ch_id, hcint);
@@ -918,16 +1311,26 @@ static bool handle_channel_in_slave(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t h
   return is_done;
 }
 
-static bool handle_channel_out_slave(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hcint) {
+TU_ATTR_FAST_FUNC static bool handle_channel_out_slave(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hcint) {
   hcd_xfer_t* xfer = &_hcd_data.xfer[ch_id];
   dwc2_channel_t* channel = &dwc2->channel[ch_id];
   hcd_endpoint_t* edpt = &_hcd_data.edpt[xfer->ep_id];
   bool is_done = false;
 
   if (hcint & HCINT_XFER_COMPLETE) {
-    is_done = true;
-    xfer->result = XFER_RESULT_SUCCESS;
     channel->hcintmsk &= ~HCINT_ACK;
+    if (xfer->fifo_bytes < edpt->buflen) {
+      // send next piece of split isochronous OUT in next micro-frame (or next piece of large transfer), restarted
+      // when channel is halted
+      xfer->xferred_bytes += xfer->fifo_bytes;
+      edpt->buffer += xfer->fifo_bytes;
+      edpt->buflen -= xfer->fifo_bytes;
+      xfer->fifo_bytes = 0;
+      channel_disable(dwc2, channel);
+    } else {
+      is_done = true;
+      xfer->result = XFER_RESULT_SUCCESS;
+    }
   } else if (hcint & HCINT_STALL) {
     xfer->result = XFER_RESULT_STALLED;
     channel_disable(dwc2, channel);
@@ -961,6 +1364,9 @@ static bool handle_channel_out_slave(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t
     } else if (xfer->err_count == HCD_XFER_ERROR_MAX) {
       xfer->result = XFER_RESULT_FAILED;
       is_done = true;
+    } else if (_hcd_data.pending_count && !edpt_is_periodic(channel->hcchar_bm.ep_type)) {
+      // Got here due to NAK or NYET while other endpoints are waiting: give up channel (already wrapped up)
+      channel_xfer_requeue(dwc2, ch_id);
     } else {
       // Got here due to NAK or NYET
       TU_ASSERT(channel_xfer_start(dwc2, ch_id));
@@ -985,7 +1391,7 @@ static bool handle_channel_out_slave(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t
 #endif
 
 #if CFG_TUH_DWC2_DMA_ENABLE
-static bool handle_channel_in_dma(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hcint) {
+TU_ATTR_FAST_FUNC static bool handle_channel_in_dma(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hcint) {
   hcd_xfer_t* xfer = &_hcd_data.xfer[ch_id];
   dwc2_channel_t* channel = &dwc2->channel[ch_id];
   hcd_endpoint_t* edpt = &_hcd_data.edpt[xfer->ep_id];
@@ -995,10 +1401,11 @@ static bool handle_channel_in_dma(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hci
   // TU_LOG1("in  hcint = %02lX\r\n", hcint);
 
   if (hcint & HCINT_HALTED) {
+    const uint16_t xfer_len = edpt_channel_len(dwc2, edpt);
     if (hcint & (HCINT_XFER_COMPLETE | HCINT_STALL | HCINT_BABBLE_ERR)) {
       const uint16_t remain_bytes = (uint16_t) channel->hctsiz_bm.xfer_size;
       const uint16_t remain_packets = channel->hctsiz_bm.packet_count;
-      const uint16_t actual_len = edpt->buflen - remain_bytes;
+      const uint16_t actual_len = xfer_len - remain_bytes;
       xfer->xferred_bytes += actual_len;
 
       is_done = true;
@@ -1015,12 +1422,26 @@ static bool handle_channel_in_dma(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hci
 
         channel->hcsplt_bm.split_compl = 0;
         channel_xfer_in_retry(dwc2, ch_id, hcint);
+      } else if (actual_len == xfer_len && xfer_len < edpt->buflen) {
+        // buffer is larger than a channel can transfer: receive next piece as another multi-packet transfer
+        is_done = false;
+        edpt->buffer += actual_len;
+        edpt->buflen -= actual_len;
+        channel_xfer_start(dwc2, ch_id);
       } else {
         xfer->result = XFER_RESULT_SUCCESS;
       }
 
       xfer->err_count = 0;
       channel->hcintmsk &= ~HCINT_ACK;
+    } else if (xfer->preempt) {
+      // halted to give channel to a pending endpoint, save what is received so far
+      const uint16_t actual_len = xfer_len - (uint16_t) channel->hctsiz_bm.xfer_size;
+      hcd_dcache_invalidate(edpt->buffer, actual_len);
+      xfer->xferred_bytes += actual_len;
+      edpt->buffer += actual_len;
+      edpt->buflen -= actual_len;
+      channel_xfer_requeue(dwc2, ch_id);
     } else if (hcint & HCINT_XACT_ERR) {
       xfer->err_count++;
       if (xfer->err_count >=  HCD_XFER_ERROR_MAX) {
@@ -1065,7 +1486,7 @@ static bool handle_channel_in_dma(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hci
   return is_done;
 }
 
-static bool handle_channel_out_dma(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hcint) {
+TU_ATTR_FAST_FUNC static bool handle_channel_out_dma(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hcint) {
   hcd_xfer_t* xfer = &_hcd_data.xfer[ch_id];
   dwc2_channel_t* channel = &dwc2->channel[ch_id];
   hcd_endpoint_t* edpt = &_hcd_data.edpt[xfer->ep_id];
@@ -1079,13 +1500,26 @@ static bool handle_channel_out_dma(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hc
       is_done = true;
       xfer->err_count = 0;
       if (hcint & HCINT_XFER_COMPLETE) {
-        xfer->result = XFER_RESULT_SUCCESS;
-        xfer->xferred_bytes += edpt->buflen;
+        const uint16_t xfer_len = edpt_channel_len(dwc2, edpt);
+        xfer->xferred_bytes += xfer_len;
+        if (xfer_len < edpt->buflen) {
+          // next piece of split isochronous OUT in next micro-frame
+          is_done = false;
+          edpt->buffer += xfer_len;
+          edpt->buflen -= xfer_len;
+          channel_xfer_start(dwc2, ch_id);
+        } else {
+          xfer->result = XFER_RESULT_SUCCESS;
+        }
       } else {
         xfer->result = XFER_RESULT_STALLED;
         channel_xfer_out_wrapup(dwc2, ch_id);
       }
       channel->hcintmsk &= ~HCINT_ACK;
+    } else if (xfer->preempt) {
+      // halted to give channel to a pending endpoint
+      channel_xfer_out_wrapup(dwc2, ch_id);
+      channel_xfer_requeue(dwc2, ch_id);
     } else if (hcint & HCINT_XACT_ERR) {
      if (hcint & (HCINT_NAK | HCINT_NYET | HCINT_ACK)) {
        xfer->err_count = 0;
@@ -1126,7 +1560,7 @@ static bool handle_channel_out_dma(dwc2_regs_t* dwc2, uint8_t ch_id, uint32_t hc
 }
 #endif
 
-static void handle_channel_irq(uint8_t rhport, bool in_isr) {
+TU_ATTR_FAST_FUNC static void handle_channel_irq(uint8_t rhport, bool in_isr) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
   const bool is_dma = dma_host_enabled(dwc2);
   const uint8_t max_channel = DWC2_CHANNEL_COUNT(dwc2);
@@ -1166,35 +1600,102 @@ static void handle_channel_irq(uint8_t rhport, bool in_isr) {
 
       if (is_done) {
         const uint8_t ep_addr = tu_edpt_addr(hcchar_bm.ep_num, hcchar_bm.ep_dir);
-        hcd_event_xfer_complete(hcchar_bm.dev_addr, ep_addr, xfer->xferred_bytes, xfer->result, in_isr);
+        uint32_t xferred_bytes = _hcd_data.edpt[xfer->ep_id].xferred_prev + xfer->xferred_bytes;
+        uint8_t result = xfer->result;
+        #if CFG_TUH_EDPT_ISO_XFER
+        hcd_endpoint_t* edpt = &_hcd_data.edpt[xfer->ep_id];
+        if (edpt->iso_packets) {
+          if (edpt_iso_packet_done(dwc2, edpt, xferred_bytes, result)) {
+            channel_dealloc(dwc2, ch_id);
+            continue;
+          }
+          xferred_bytes = edpt->iso_xferred;
+          result = edpt->iso_result;
+        }
+        #endif
+        hcd_event_xfer_complete(hcchar_bm.dev_addr, ep_addr, xferred_bytes, (xfer_result_t) result, in_isr);
         channel_dealloc(dwc2, ch_id);
       }
     }
   }
+
+  // released channels are given to pending endpoints
+  channel_schedule(dwc2);
 }
 
-// SOF is enabled for scheduled periodic transfer
+#if CFG_TUH_DWC2_DMA_ENABLE
+// DMA mode retries NAKed bulk/control transfer by itself and never halts the channel. Disable a channel that has used
+// up its time slice so that it can be given to a pending endpoint, halted interrupt requeues its transfer.
+// Control and split transfers are not preempted since they are short or have split state in the hub.
+static void channel_timeslice_expire(dwc2_regs_t* dwc2) {
+  const uint8_t max_channel = DWC2_CHANNEL_COUNT(dwc2);
+  for (uint8_t ch_id = 0; ch_id < max_channel; ch_id++) {
+    hcd_xfer_t* xfer = &_hcd_data.xfer[ch_id];
+    dwc2_channel_t* channel = &dwc2->channel[ch_id];
+    const dwc2_channel_char_t hcchar_bm = channel->hcchar_bm;
+    if (!xfer->allocated || xfer->preempt || edpt_is_periodic(hcchar_bm.ep_type) || hcchar_bm.ep_num == 0 ||
+        channel->hcsplt_bm.split_en) {
+      continue;
+    }
+
+    if (++xfer->sof_count >= CFG_TUH_DWC2_CHANNEL_TIMESLICE && hcchar_bm.enable) {
+      xfer->preempt = true;
+      channel_disable(dwc2, channel);
+      return; // one at a time
+    }
+  }
+}
+#endif
+
+// SOF is enabled for scheduled periodic transfer, and for transfers waiting for a channel
 static bool handle_sof_irq(uint8_t rhport, bool in_isr) {
   (void) in_isr;
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
 
-  bool more_isr = false;
+  const uint16_t frnum = (uint16_t) (dwc2->hfnum & HCD_SOF_FRNUM_MASK);
+
+  // nothing is due yet: this is the common case, keep it cheap
+  if (_hcd_data.sof_due_valid && sof_due_reached(frnum, _hcd_data.sof_due_next)) {
+    _hcd_data.sof_due_valid = false;
+
+    for(uint8_t ep_id = 0; ep_id < CFG_TUH_DWC2_ENDPOINT_MAX; ep_id++) {
+      hcd_endpoint_t* edpt = &_hcd_data.edpt[ep_id];
+      if (!edpt->hcchar_bm.enable || !edpt->sof_wait) {
+        continue;
+      }
 
-  // If highspeed then SOF is 125us, else 1ms
-  const uint32_t ucount = (hprt_speed_get(dwc2) == TUSB_SPEED_HIGH ? 1 : 8);
+      if (sof_due_reached(frnum, edpt->sof_due)) {
+        edpt->sof_wait = 0;
+        if (edpt->sof_wait_more) {
+          // rest of a long interval, convert SOF count back to micro-frames
+          const bool is_highspeed = (hprt_speed_get(dwc2) == TUSB_SPEED_HIGH);
+          edpt_sof_schedule(dwc2, edpt, is_highspeed ? edpt->sof_wait_more : 8u * edpt->sof_wait_more);
+          continue;
+        }
 
-  for(uint8_t ep_id = 0; ep_id < CFG_TUH_DWC2_ENDPOINT_MAX; ep_id++) {
-    hcd_endpoint_t* edpt = &_hcd_data.edpt[ep_id];
-    if (edpt->hcchar_bm.enable && edpt_is_periodic(edpt->hcchar_bm.ep_type) && edpt->uframe_countdown > 0) {
-      edpt->uframe_countdown -= tu_min32(ucount, edpt->uframe_countdown);
-      if (edpt->uframe_countdown == 0) {
-        if (!edpt_xfer_kickoff(dwc2, ep_id)) {
-          edpt->uframe_countdown = ucount; // failed to start, try again next frame
+        const uint8_t uframe_wait = edpt_split_uframe_wait(dwc2, edpt);
+        if (uframe_wait) {
+          edpt_sof_schedule(dwc2, edpt, uframe_wait); // not yet planned start-split micro-frame
+        } else if (!edpt_xfer_kickoff(dwc2, ep_id)) {
+          edpt_pending_set(dwc2, edpt); // no free channel, served before non-periodic ones
         }
+      } else if (!_hcd_data.sof_due_valid || sof_due_before(edpt->sof_due, _hcd_data.sof_due_next)) {
+        _hcd_data.sof_due_next = edpt->sof_due;
+        _hcd_data.sof_due_valid = true;
       }
+    }
+  }
+
+  bool more_isr = _hcd_data.sof_due_valid;
 
-      more_isr = true;
+  if (_hcd_data.pending_count) {
+    channel_schedule(dwc2);
+    #if CFG_TUH_DWC2_DMA_ENABLE
+    if (_hcd_data.pending_count && dma_host_enabled(dwc2)) {
+      channel_timeslice_expire(dwc2);
     }
+    #endif
+    more_isr = true;
   }
 
   return more_isr;
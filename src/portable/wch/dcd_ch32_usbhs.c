@@ -42,6 +42,11 @@ typedef struct {
   uint16_t max_size;
   bool is_last_packet;
   bool is_iso;
+#if CFG_TUD_CH32_USBHS_BUF_MODE
+  bool opened;
+  bool buf_mode;
+  uint16_t armed_len; // bytes of buffer already armed in the DMA ping-pong buffers
+#endif
 } xfer_ctl_t;
 
 typedef enum {
@@ -131,6 +136,87 @@ static void xfer_data_packet(uint8_t ep_num, tusb_dir_t ep_dir, xfer_ctl_t* xfer
   ep_set_response_and_toggle(ep_num, ep_dir, USBHS_EP_R_RES_ACK);
 }
 
+#if CFG_TUD_CH32_USBHS_BUF_MODE
+// Data toggle of the next packet, which also selects the DMA buffer in buffer mode
+static inline uint8_t ep_next_toggle(uint8_t ep_num, tusb_dir_t ep_dir) {
+  uint8_t const ctrl = (ep_dir == TUSB_DIR_IN) ? EP_TX_CTRL(ep_num) : EP_RX_CTRL(ep_num);
+  return (ctrl & USBHS_EP_T_TOG_1) ? 1 : 0;
+}
+
+// Arm the next packet of transfer into the buffer selected by toggle: DATA0 uses the endpoint's own DMA buffer,
+// DATA1 the one of the unused direction. Both share UEPn_T_LEN/UEPn_MAX_LEN, therefore only a full packet can be
+// armed behind the one already on the bus (idle = false).
+static bool buf_mode_arm(uint8_t ep_num, tusb_dir_t ep_dir, xfer_ctl_t* xfer, uint8_t toggle, bool idle) {
+  uint16_t const len = TU_MIN(xfer->total_len - xfer->armed_len, xfer->max_size);
+  if (!idle && len < xfer->max_size) {
+    return false;
+  }
+
+  uint32_t const addr = (uint32_t) &xfer->buffer[xfer->armed_len];
+  if ((ep_dir == TUSB_DIR_IN) == (toggle == 0)) {
+    EP_TX_DMA_ADDR(ep_num) = addr;
+  } else {
+    EP_RX_DMA_ADDR(ep_num) = addr;
+  }
+
+  if (idle) {
+    if (ep_dir == TUSB_DIR_IN) {
+      EP_TX_LEN(ep_num) = len;
+    } else {
+      EP_RX_MAX_LEN(ep_num) = len;
+    }
+  }
+
+  xfer->armed_len += len;
+  return true;
+}
+
+// Packet done on a buffer mode endpoint, return true if transfer is complete. The next packet is already armed in
+// the other buffer, the one just used is re-armed here before the interrupt flag is cleared (USBHS_INT_BUSY_EN
+// NAKs the bus until then).
+static bool buf_mode_xfer_isr(uint8_t ep_num, tusb_dir_t ep_dir, xfer_ctl_t* xfer, uint16_t rx_len) {
+  uint16_t const len = (ep_dir == TUSB_DIR_IN) ? TU_MIN(xfer->total_len - xfer->queued_len, xfer->max_size) : rx_len;
+  xfer->queued_len += len;
+
+  if (xfer->queued_len == xfer->total_len || len < xfer->max_size) {
+    xfer->is_last_packet = true;
+    return true;
+  }
+
+  uint8_t const toggle = ep_next_toggle(ep_num, ep_dir);
+  if (xfer->armed_len == xfer->queued_len) {
+    // nothing in flight: remaining is a short packet or a full one that could not be armed earlier
+    buf_mode_arm(ep_num, ep_dir, xfer, toggle, true);
+  }
+  buf_mode_arm(ep_num, ep_dir, xfer, toggle ^ 1, false);
+
+  return false;
+}
+
+// Other direction of the endpoint is opened and needs its DMA buffer back, continue any transfer single-buffered
+static void buf_mode_disable(uint8_t ep_num, tusb_dir_t ep_dir) {
+  xfer_ctl_t* xfer = XFER_CTL_BASE(ep_num, ep_dir);
+
+  dcd_int_disable(0);
+  USBHSD->BUF_MODE &= ~(USBHS_EP0_BUF_MOD << ep_num);
+  xfer->buf_mode = false;
+  if (!xfer->is_last_packet) {
+    xfer_data_packet(ep_num, ep_dir, xfer);
+  }
+  dcd_int_enable(0);
+}
+
+static void buf_mode_reset(void) {
+  USBHSD->BUF_MODE = 0;
+  for (uint8_t ep = 1; ep < EP_MAX; ep++) {
+    for (uint8_t dir = 0; dir < 2; dir++) {
+      xfer_status[ep][dir].opened = false;
+      xfer_status[ep][dir].buf_mode = false;
+    }
+  }
+}
+#endif
+
 bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
   (void) rhport;
   (void) rh_init;
@@ -197,6 +283,9 @@ void dcd_edpt_close_all(uint8_t rhport) {
   }
 
   USBHSD->ENDP_CONFIG = USBHS_EP0_T_EN | USBHS_EP0_R_EN;
+#if CFG_TUD_CH32_USBHS_BUF_MODE
+  buf_mode_reset();
+#endif
 }
 
 void dcd_set_address(uint8_t rhport, uint8_t dev_addr) {
@@ -248,6 +337,21 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const* desc_edpt) {
   xfer->max_size = tu_edpt_packet_size(desc_edpt);
 
   xfer->is_iso = (desc_edpt->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS);
+
+#if CFG_TUD_CH32_USBHS_BUF_MODE
+  // buffer mode borrows the DMA buffer of the other direction, only possible while that one is not opened
+  xfer_ctl_t* xfer_other = XFER_CTL_BASE(ep_num, 1 - dir);
+  xfer->opened = true;
+  xfer->buf_mode = false;
+  if (xfer_other->buf_mode) {
+    buf_mode_disable(ep_num, (tusb_dir_t) (1 - dir));
+  } else if (!xfer_other->opened && desc_edpt->bmAttributes.xfer == TUSB_XFER_BULK) {
+    xfer->buf_mode = true;
+    xfer->is_last_packet = true;
+    USBHSD->BUF_MODE |= (USBHS_EP0_BUF_MOD << ep_num);
+  }
+#endif
+
   if (dir == TUSB_DIR_OUT) {
     USBHSD->ENDP_CONFIG |= (USBHS_EP0_R_EN << ep_num);
     EP_RX_CTRL(ep_num) = USBHS_EP_R_AUTOTOG | USBHS_EP_R_RES_NAK;
@@ -286,6 +390,15 @@ void dcd_edpt_close(uint8_t rhport, uint8_t ep_addr) {
     USBHSD->ENDP_TYPE &= ~(USBHS_EP0_T_TYP << ep_num);
     USBHSD->ENDP_CONFIG &= ~(USBHS_EP0_T_EN << ep_num);
   }
+
+#if CFG_TUD_CH32_USBHS_BUF_MODE
+  xfer_ctl_t* xfer = XFER_CTL_BASE(ep_num, dir);
+  if (xfer->buf_mode) {
+    USBHSD->BUF_MODE &= ~(USBHS_EP0_BUF_MOD << ep_num);
+  }
+  xfer->opened = false;
+  xfer->buf_mode = false;
+#endif
 }
 
 void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr) {
@@ -326,6 +439,17 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t to
   xfer->queued_len = 0;
   xfer->is_last_packet = false;
 
+#if CFG_TUD_CH32_USBHS_BUF_MODE
+  if (xfer->buf_mode) {
+    uint8_t const toggle = ep_next_toggle(ep_num, dir);
+    xfer->armed_len = 0;
+    buf_mode_arm(ep_num, dir, xfer, toggle, true);
+    buf_mode_arm(ep_num, dir, xfer, toggle ^ 1, false);
+    ep_set_response_and_toggle(ep_num, dir, EP_RESPONSE_ACK);
+    return true;
+  }
+#endif
+
   xfer_data_packet(ep_num, dir, xfer);
 
   return true;
@@ -349,6 +473,23 @@ void dcd_int_handler(uint8_t rhport) {
       uint8_t const ep_addr = tu_edpt_addr(ep_num, ep_dir);
       xfer_ctl_t* xfer = XFER_CTL_BASE(ep_num, ep_dir);
 
+#if CFG_TUD_CH32_USBHS_BUF_MODE
+      if (xfer->buf_mode) {
+        uint16_t const rx_len = (token == USBHS_TOKEN_PID_OUT) ? USBHSD->RX_LEN : 0;
+        bool const complete = buf_mode_xfer_isr(ep_num, ep_dir, xfer, rx_len);
+        if (complete) {
+          ep_set_response_and_toggle(ep_num, ep_dir, EP_RESPONSE_NAK);
+        }
+
+        // release the bus as early as possible, next packet is already armed
+        USBHSD->INT_FG = (int_flag & (USBHS_ISO_ACT_FLAG | USBHS_TRANSFER_FLAG)); /* Clear flag */
+        if (complete) {
+          dcd_event_xfer_complete(0, ep_addr, xfer->queued_len, XFER_RESULT_SUCCESS, true);
+        }
+        return;
+      }
+#endif
+
       if (token == USBHS_TOKEN_PID_OUT) {
         uint16_t rx_len = USBHSD->RX_LEN;
 
@@ -408,6 +549,9 @@ void dcd_int_handler(uint8_t rhport) {
     dcd_event_bus_reset(0, TUSB_SPEED_HIGH, true);
 
     USBHSD->DEV_AD = 0;
+#if CFG_TUD_CH32_USBHS_BUF_MODE
+    buf_mode_reset();
+#endif
     EP_RX_CTRL(0) = USBHS_EP_R_RES_ACK | USBHS_EP_R_TOG_0;
     EP_TX_CTRL(0) = USBHS_EP_T_RES_NAK | USBHS_EP_T_TOG_0;
 
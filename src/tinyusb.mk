@@ -2,6 +2,8 @@
 TINYUSB_SRC_C += \
 	src/tusb.c \
 	src/common/tusb_fifo.c \
+	src/common/tusb_mempool.c \
+	src/common/tusb_rfifo.c \
 	src/device/usbd.c \
 	src/device/usbd_control.c \
 	src/typec/usbc.c \
@@ -19,8 +21,12 @@ TINYUSB_SRC_C += \
 	src/class/vendor/vendor_device.c \
   src/host/usbh.c \
   src/host/hub.c \
+  src/class/audio/audio_host.c \
   src/class/cdc/cdc_host.c \
   src/class/hid/hid_host.c \
+  src/class/midi/midi_host.c \
   src/class/msc/msc_host.c \
+  src/class/net/ncm_host.c \
   src/class/vendor/vendor_host.c \
+  src/class/video/video_host.c \
   src/typec/usbc.c \
@@ -45,6 +45,33 @@ tusb_role_t _tusb_rhport_role[TUP_USBIP_CONTROLLER_NUM] = { TUSB_ROLE_INVALID };
 // Weak/Default API, can be overwritten by Application
 //--------------------------------------------------------------------
 
+#if CFG_TUSB_TRACE
+TU_VERIFY_STATIC((CFG_TUSB_TRACE_COUNT & (CFG_TUSB_TRACE_COUNT - 1)) == 0, "CFG_TUSB_TRACE_COUNT must be power of 2");
+
+tu_trace_buffer_t tu_trace_buf = {
+  .magic = TU_TRACE_MAGIC,
+  .count = CFG_TUSB_TRACE_COUNT,
+  .record_size = sizeof(tu_trace_record_t),
+  .index = 0
+};
+
+TU_ATTR_WEAK uint32_t tusb_trace_timestamp_cb(void) {
+  return 0;
+}
+
+// Can be called from both ISR and task. Index is not incremented atomically: a record may be overwritten when an ISR
+// preempts at exactly this point, which is acceptable for tracing compared to disabling interrupts.
+void tu_trace_record(uint8_t id, uint8_t arg8, uint16_t arg16, uint32_t arg32) {
+  uint32_t const idx = tu_trace_buf.index++;
+  tu_trace_record_t* rec = &tu_trace_buf.records[idx & (CFG_TUSB_TRACE_COUNT - 1)];
+  rec->timestamp = tusb_trace_timestamp_cb();
+  rec->id = id;
+  rec->arg8 = arg8;
+  rec->arg16 = arg16;
+  rec->arg32 = arg32;
+}
+#endif
+
 TU_ATTR_WEAK void tusb_time_delay_ms_api(uint32_t ms) {
 #if CFG_TUSB_OS != OPT_OS_NONE
   osal_task_delay(ms);
@@ -125,13 +152,13 @@ void tusb_int_handler(uint8_t rhport, bool in_isr) {
   #if CFG_TUD_ENABLED
   if (_tusb_rhport_role[rhport] == TUSB_ROLE_DEVICE) {
     (void) in_isr;
-    dcd_int_handler(rhport);
+    tud_int_handler(rhport);
   }
   #endif
 
   #if CFG_TUH_ENABLED
   if (_tusb_rhport_role[rhport] == TUSB_ROLE_HOST) {
-    hcd_int_handler(rhport, in_isr);
+    tuh_int_handler(rhport, in_isr);
   }
   #endif
 }
@@ -168,9 +195,50 @@ uint8_t const* tu_desc_find3(uint8_t const* desc, uint8_t const* end, uint8_t by
 // Endpoint Helper for both Host and Device stack
 //--------------------------------------------------------------------+
 
+// Claim/release with compare-and-swap on endpoint state if core has lock-free byte atomics (e.g LDREXB/STREXB),
+// mutex is only used as fallback e.g on Cortex-M0 or RISC-V without A extension
+#ifndef TUP_EDPT_CLAIM_ATOMIC
+  #if defined(__GNUC__) && defined(__GCC_ATOMIC_CHAR_LOCK_FREE) && (__GCC_ATOMIC_CHAR_LOCK_FREE == 2)
+    #define TUP_EDPT_CLAIM_ATOMIC   1
+  #else
+    #define TUP_EDPT_CLAIM_ATOMIC   0
+  #endif
+#endif
+
+#if TUP_EDPT_CLAIM_ATOMIC
+typedef union {
+  tu_edpt_state_t state;
+  uint8_t value;
+} edpt_state_value_t;
+
+TU_VERIFY_STATIC(sizeof(tu_edpt_state_t) == 1, "endpoint state must fit in a byte");
+
+// Set claimed bit to claimed if endpoint is not busy and claimed bit is not already set so. Other bits are kept
+static bool edpt_claim_cas(tu_edpt_state_t* ep_state, bool claimed) {
+  uint8_t* const p_value = (uint8_t*) ep_state;
+  edpt_state_value_t cur;
+  edpt_state_value_t next;
+
+  cur.value = __atomic_load_n(p_value, __ATOMIC_RELAXED);
+  do {
+    if (cur.state.busy || (cur.state.claimed == claimed)) {
+      return false;
+    }
+    next.value = cur.value;
+    next.state.claimed = claimed ? 1 : 0;
+  } while (!__atomic_compare_exchange_n(p_value, &cur.value, next.value, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+  return true;
+}
+#endif
+
 bool tu_edpt_claim(tu_edpt_state_t* ep_state, osal_mutex_t mutex) {
   (void) mutex;
 
+#if TUP_EDPT_CLAIM_ATOMIC
+  // can only claim the endpoint if it is not busy and not claimed yet.
+  return edpt_claim_cas(ep_state, true);
+#else
   // pre-check to help reducing mutex lock
   TU_VERIFY((ep_state->busy == 0) && (ep_state->claimed == 0));
   (void) osal_mutex_lock(mutex, OSAL_TIMEOUT_WAIT_FOREVER);
@@ -183,10 +251,16 @@ bool tu_edpt_claim(tu_edpt_state_t* ep_state, osal_mutex_t mutex) {
 
   (void) osal_mutex_unlock(mutex);
   return available;
+#endif
 }
 
 bool tu_edpt_release(tu_edpt_state_t* ep_state, osal_mutex_t mutex) {
   (void) mutex;
+
+#if TUP_EDPT_CLAIM_ATOMIC
+  // can only release the endpoint if it is claimed and not busy
+  return edpt_claim_cas(ep_state, false);
+#else
   (void) osal_mutex_lock(mutex, OSAL_TIMEOUT_WAIT_FOREVER);
 
   // can only release the endpoint if it is claimed and not busy
@@ -197,12 +271,16 @@ bool tu_edpt_release(tu_edpt_state_t* ep_state, osal_mutex_t mutex) {
 
   (void) osal_mutex_unlock(mutex);
   return ret;
+#endif
 }
 
 bool tu_edpt_validate(tusb_desc_endpoint_t const* desc_ep, tusb_speed_t speed) {
   uint16_t const max_packet_size = tu_edpt_packet_size(desc_ep);
   TU_LOG2("  Open EP %02X with Size = %u\r\n", desc_ep->bEndpointAddress, max_packet_size);
 
+  // additional transactions per micro-frame: 11b is reserved
+  TU_ASSERT(tu_edpt_hs_mult(desc_ep) <= 3);
+
   switch (desc_ep->bmAttributes.xfer) {
     case TUSB_XFER_ISOCHRONOUS: {
       uint16_t const spec_size = (speed == TUSB_SPEED_HIGH ? 1024 : 1023);
@@ -285,9 +363,9 @@ uint16_t tu_desc_get_interface_total_len(tusb_desc_interface_t const* desc_itf,
 
 bool tu_edpt_stream_init(tu_edpt_stream_t* s, bool is_host, bool is_tx, bool overwritable,
                          void* ff_buf, uint16_t ff_bufsize, uint8_t* ep_buf, uint16_t ep_bufsize) {
-  (void) is_tx;
-
   s->is_host = is_host;
+  s->is_tx = is_tx;
+  s->wm_level = 0;
   tu_fifo_config(&s->ff, ff_buf, ff_bufsize, 1, overwritable);
 
   #if OSAL_MUTEX_REQUIRED
@@ -299,10 +377,31 @@ bool tu_edpt_stream_init(tu_edpt_stream_t* s, bool is_host, bool is_tx, bool ove
 
   s->ep_buf = ep_buf;
   s->ep_bufsize = ep_bufsize;
+  #if TU_EDPT_STREAM_PINGPONG
+  s->ep_buf2 = NULL;
+  #endif
+  tu_edpt_stream_set_zero_copy(s, true);
 
   return true;
 }
 
+bool tu_edpt_stream_set_pingpong(tu_edpt_stream_t* s, uint8_t* ep_buf2) {
+  #if TU_EDPT_STREAM_PINGPONG
+  if (ep_buf2) {
+    const bool has_queue = s->is_host ? (CFG_TUH_EDPT_XFER_QUEUE > 0) : (CFG_TUD_EDPT_XFER_QUEUE > 0);
+    TU_VERIFY(has_queue && tu_fifo_depth(&s->ff));
+    s->zero_copy = 0;
+  }
+  s->ep_buf2 = ep_buf2;
+  s->pp_rd = 0;
+  s->pp_count = 0;
+  return true;
+  #else
+  (void) s;
+  return ep_buf2 == NULL;
+  #endif
+}
+
 bool tu_edpt_stream_deinit(tu_edpt_stream_t* s) {
   (void) s;
   #if OSAL_MUTEX_REQUIRED
@@ -325,19 +424,61 @@ TU_ATTR_ALWAYS_INLINE static inline bool stream_claim(uint8_t hwid, tu_edpt_stre
   return false;
 }
 
-TU_ATTR_ALWAYS_INLINE static inline bool stream_xfer(uint8_t hwid, tu_edpt_stream_t* s, uint16_t count) {
+TU_ATTR_ALWAYS_INLINE static inline bool stream_xfer_buf(uint8_t hwid, tu_edpt_stream_t* s, uint8_t* buf, uint16_t count) {
+  TU_TRACE(TU_TRACE_FIFO_LEVEL, s->is_host, (hwid << 8) | s->ep_addr, tu_fifo_count(&s->ff));
   if (s->is_host) {
     #if CFG_TUH_ENABLED
-    return usbh_edpt_xfer(hwid, s->ep_addr, count ? s->ep_buf : NULL, count);
+    return usbh_edpt_xfer(hwid, s->ep_addr, count ? buf : NULL, count);
     #endif
   } else {
     #if CFG_TUD_ENABLED
-    return usbd_edpt_xfer(hwid, s->ep_addr, count ? s->ep_buf : NULL, count);
+    return usbd_edpt_xfer(hwid, s->ep_addr, count ? buf : NULL, count);
     #endif
   }
   return false;
 }
 
+TU_ATTR_ALWAYS_INLINE static inline bool stream_xfer(uint8_t hwid, tu_edpt_stream_t* s, uint16_t count) {
+  return stream_xfer_buf(hwid, s, s->ep_buf, count);
+}
+
+#if CFG_TUSB_EDPT_STREAM_ZERO_COPY
+// Fifo linear region can be used for transfer if it is word-aligned and dcache is not enabled
+// (fifo buffer is not necessarily cache line aligned)
+TU_ATTR_ALWAYS_INLINE static inline bool stream_zc_capable(tu_edpt_stream_t const* s, void const* ptr) {
+  const bool dcache = s->is_host ? CFG_TUH_MEM_DCACHE_ENABLE : CFG_TUD_MEM_DCACHE_ENABLE;
+  return s->zero_copy && !dcache && (ptr != NULL) && (0 == (((uintptr_t) ptr) & 3u));
+}
+
+// Get fifo linear region to send directly, return number of bytes, 0 if not possible
+static uint16_t stream_write_zc_region(tu_edpt_stream_t* s, uint8_t** buf) {
+  tu_fifo_buffer_info_t info;
+  tu_fifo_get_read_info(&s->ff, &info);
+  TU_VERIFY(stream_zc_capable(s, info.ptr_lin), 0);
+  *buf = (uint8_t*) info.ptr_lin;
+
+  // only send whole linear region, or multiple of packet size if data is wrapped (or region is larger than a
+  // transfer) to avoid short packet in the middle of the stream
+  const uint16_t mps = s->is_mps512 ? TUSB_EPSIZE_BULK_HS : TUSB_EPSIZE_BULK_FS;
+  if (!info.len_wrap && info.len_lin <= UINT16_MAX) {
+    return (uint16_t) info.len_lin;
+  }
+  return (uint16_t) (tu_min32(info.len_lin, UINT16_MAX) & ~(uint32_t) (mps - 1));
+}
+
+// Get fifo linear region to receive directly, return number of bytes, 0 if not possible
+static uint16_t stream_read_zc_region(tu_edpt_stream_t* s, uint8_t** buf) {
+  tu_fifo_buffer_info_t info;
+  tu_fifo_get_write_info(&s->ff, &info);
+  TU_VERIFY(stream_zc_capable(s, info.ptr_lin), 0);
+  *buf = (uint8_t*) info.ptr_lin;
+
+  // multiple of packet size, limited by transfer length
+  const uint16_t mps = s->is_mps512 ? TUSB_EPSIZE_BULK_HS : TUSB_EPSIZE_BULK_FS;
+  return (uint16_t) (tu_min32(info.len_lin, UINT16_MAX) & ~(uint32_t) (mps - 1));
+}
+#endif
+
 TU_ATTR_ALWAYS_INLINE static inline bool stream_release(uint8_t hwid, tu_edpt_stream_t* s) {
   if (s->is_host) {
     #if CFG_TUH_ENABLED
@@ -351,6 +492,123 @@ TU_ATTR_ALWAYS_INLINE static inline bool stream_release(uint8_t hwid, tu_edpt_st
   return false;
 }
 
+// fifo level compared against watermark: bytes to read for RX, free space for TX
+TU_ATTR_ALWAYS_INLINE static inline uint32_t stream_wm_count(tu_edpt_stream_t* s) {
+  return s->is_tx ? (uint32_t) tu_fifo_remaining(&s->ff) : (uint32_t) tu_fifo_count(&s->ff);
+}
+
+// re-arm watermark once application moves fifo level below it
+TU_ATTR_ALWAYS_INLINE static inline void stream_wm_rearm(tu_edpt_stream_t* s) {
+  if (s->wm_level && !s->wm_armed && stream_wm_count(s) < s->wm_level) {
+    s->wm_armed = true;
+  }
+}
+
+bool tu_edpt_stream_watermark_reached(tu_edpt_stream_t* s) {
+  TU_VERIFY(s->wm_level && s->wm_armed && tu_fifo_depth(&s->ff));
+  TU_VERIFY(stream_wm_count(s) >= s->wm_level);
+  s->wm_armed = false;
+  return true;
+}
+
+#if TU_EDPT_STREAM_PINGPONG
+TU_ATTR_ALWAYS_INLINE static inline bool stream_pp_enabled(tu_edpt_stream_t const* s) {
+  return s->ep_buf2 != NULL;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline uint8_t* stream_pp_buf(tu_edpt_stream_t const* s, uint8_t idx) {
+  return idx ? s->ep_buf2 : s->ep_buf;
+}
+
+// queue state is accessed by both read() of application and xfer callback of usb task
+TU_ATTR_ALWAYS_INLINE static inline void stream_pp_lock(tu_edpt_stream_t* s) {
+  #if OSAL_MUTEX_REQUIRED
+  if (s->ff.mutex_rd) {
+    osal_mutex_lock(s->ff.mutex_rd, OSAL_TIMEOUT_WAIT_FOREVER);
+  }
+  #else
+  (void) s;
+  #endif
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void stream_pp_unlock(tu_edpt_stream_t* s) {
+  #if OSAL_MUTEX_REQUIRED
+  if (s->ff.mutex_rd) {
+    osal_mutex_unlock(s->ff.mutex_rd);
+  }
+  #else
+  (void) s;
+  #endif
+}
+
+TU_ATTR_ALWAYS_INLINE static inline bool stream_xfer_queue(uint8_t hwid, tu_edpt_stream_t* s, uint8_t* buf, uint16_t count) {
+  TU_TRACE(TU_TRACE_FIFO_LEVEL, s->is_host, (hwid << 8) | s->ep_addr, tu_fifo_count(&s->ff));
+  if (s->is_host) {
+    #if CFG_TUH_ENABLED && CFG_TUH_EDPT_XFER_QUEUE
+    return usbh_edpt_xfer_queue(hwid, s->ep_addr, buf, count);
+    #endif
+  } else {
+    #if CFG_TUD_ENABLED && CFG_TUD_EDPT_XFER_QUEUE
+    return usbd_edpt_xfer_queue(hwid, s->ep_addr, buf, count);
+    #endif
+  }
+  (void) buf; (void) count;
+  return false;
+}
+
+// Queue transfers on free buffers as long as fifo has room for data of all of them
+static uint32_t stream_pp_read_xfer(uint8_t hwid, tu_edpt_stream_t* s) {
+  const uint16_t mps = s->is_mps512 ? TUSB_EPSIZE_BULK_HS : TUSB_EPSIZE_BULK_FS;
+  uint32_t total = 0;
+
+  stream_pp_lock(s);
+  while (s->pp_count < 2) {
+    uint32_t available = tu_fifo_remaining(&s->ff);
+    if (s->pp_count) {
+      available -= tu_min32(available, s->pp_len[s->pp_rd]);
+    }
+    if (available < mps) {
+      break;
+    }
+
+    const uint8_t idx = (uint8_t) (s->pp_rd ^ s->pp_count);
+    const uint16_t count = (uint16_t) tu_min32(available & ~(uint32_t) (mps - 1), s->ep_bufsize);
+    if (!stream_xfer_queue(hwid, s, stream_pp_buf(s, idx), count)) {
+      break;
+    }
+
+    s->pp_len[idx] = count;
+    s->pp_count++;
+    total += count;
+  }
+  stream_pp_unlock(s);
+
+  return total;
+}
+
+// Buffer of the completed transfer, must be released with stream_pp_done() once data is copied
+TU_ATTR_ALWAYS_INLINE static inline uint8_t* stream_rx_buf(tu_edpt_stream_t* s) {
+  if (stream_pp_enabled(s)) {
+    stream_pp_lock(s);
+    return stream_pp_buf(s, s->pp_rd);
+  }
+  return s->ep_buf;
+}
+
+TU_ATTR_ALWAYS_INLINE static inline void stream_pp_done(tu_edpt_stream_t* s) {
+  if (stream_pp_enabled(s)) {
+    if (s->pp_count) {
+      s->pp_count--;
+      s->pp_rd ^= 1;
+    }
+    stream_pp_unlock(s);
+  }
+}
+#else
+#define stream_rx_buf(_s)   ((_s)->ep_buf)
+#define stream_pp_done(_s)
+#endif
+
 //--------------------------------------------------------------------+
 // Stream Write
 //--------------------------------------------------------------------+
@@ -369,11 +627,22 @@ uint32_t tu_edpt_stream_write_xfer(uint8_t hwid, tu_edpt_stream_t* s) {
 
   TU_VERIFY(stream_claim(hwid, s), 0);
 
+  #if CFG_TUSB_EDPT_STREAM_ZERO_COPY
+  // Send directly from FIFO if possible, data is released by tu_edpt_stream_write_xfer_complete()
+  uint8_t* zc_buf = NULL;
+  const uint16_t zc_count = stream_write_zc_region(s, &zc_buf);
+  if (zc_count) {
+    s->zc_busy = 1;
+    TU_ASSERT(stream_xfer_buf(hwid, s, zc_buf, zc_count), 0);
+    return zc_count;
+  }
+  #endif
+
   // Pull data from FIFO -> EP buf
-  uint16_t const count = tu_fifo_read_n(&s->ff, s->ep_buf, s->ep_bufsize);
+  const tu_fifo_size_t count = tu_fifo_read_n(&s->ff, s->ep_buf, s->ep_bufsize);
 
   if (count) {
-    TU_ASSERT(stream_xfer(hwid, s, count), 0);
+    TU_ASSERT(stream_xfer(hwid, s, (uint16_t) count), 0); // at most ep_bufsize
     return count;
   } else {
     // Release endpoint since we don't make any transfer
@@ -394,7 +663,8 @@ uint32_t tu_edpt_stream_write(uint8_t hwid, tu_edpt_stream_t* s, void const* buf
     TU_ASSERT(stream_xfer(hwid, s, (uint16_t) xact_len), 0);
     return xact_len;
   } else {
-    const uint16_t ret = tu_fifo_write_n(&s->ff, buffer, (uint16_t) bufsize);
+    const tu_fifo_size_t ret = tu_fifo_write_n(&s->ff, buffer, (tu_fifo_size_t) tu_min32(bufsize, TU_FIFO_SIZE_MAX));
+    stream_wm_rearm(s);
 
     // flush if fifo has more than packet size or
     // in rare case: fifo depth is configured too small (which never reach packet size)
@@ -434,8 +704,14 @@ uint32_t tu_edpt_stream_read_xfer(uint8_t hwid, tu_edpt_stream_t* s) {
     TU_ASSERT(stream_xfer(hwid, s, s->ep_bufsize), 0);
     return s->ep_bufsize;
   } else {
+    #if TU_EDPT_STREAM_PINGPONG
+    if (stream_pp_enabled(s)) {
+      return stream_pp_read_xfer(hwid, s);
+    }
+    #endif
+
     const uint16_t mps = s->is_mps512 ? TUSB_EPSIZE_BULK_HS : TUSB_EPSIZE_BULK_FS;
-    uint16_t available = tu_fifo_remaining(&s->ff);
+    uint32_t available = tu_fifo_remaining(&s->ff);
 
     // Prepare for incoming data but only allow what we can store in the ring buffer.
     // TODO Actually we can still carry out the transfer, keeping count of received bytes
@@ -449,9 +725,19 @@ uint32_t tu_edpt_stream_read_xfer(uint8_t hwid, tu_edpt_stream_t* s) {
     available = tu_fifo_remaining(&s->ff);
 
     if (available >= mps) {
+      #if CFG_TUSB_EDPT_STREAM_ZERO_COPY
+      // Receive directly into FIFO if possible, data is committed by tu_edpt_stream_read_xfer_complete()
+      uint8_t* zc_buf = NULL;
+      const uint16_t zc_count = stream_read_zc_region(s, &zc_buf);
+      if (zc_count) {
+        s->zc_busy = 1;
+        TU_ASSERT(stream_xfer_buf(hwid, s, zc_buf, zc_count), 0);
+        return zc_count;
+      }
+      #endif
+
       // multiple of packet size limit by ep bufsize
-      uint16_t count = (uint16_t) (available & ~(mps - 1));
-      count = tu_min16(count, s->ep_bufsize);
+      const uint16_t count = (uint16_t) tu_min32(available & ~(uint32_t) (mps - 1), s->ep_bufsize);
       TU_ASSERT(stream_xfer(hwid, s, count), 0);
       return count;
     } else {
@@ -462,8 +748,66 @@ uint32_t tu_edpt_stream_read_xfer(uint8_t hwid, tu_edpt_stream_t* s) {
   }
 }
 
+void tu_edpt_stream_read_xfer_complete_offset(tu_edpt_stream_t* s, uint32_t xferred_bytes, uint32_t skip_offset) {
+  if (s->zc_busy) {
+    // data is received directly into fifo linear region
+    if (!s->zc_stale && (skip_offset < xferred_bytes)) {
+      if (skip_offset) {
+        tu_fifo_buffer_info_t info;
+        tu_fifo_get_write_info(&s->ff, &info);
+        uint8_t* ptr = (uint8_t*) info.ptr_lin;
+        memmove(ptr, ptr + skip_offset, xferred_bytes - skip_offset);
+      }
+      tu_fifo_advance_write_pointer(&s->ff, (tu_fifo_size_t) (xferred_bytes - skip_offset));
+    }
+    s->zc_busy = 0;
+    s->zc_stale = 0;
+  } else if (tu_fifo_depth(&s->ff)) {
+    uint8_t* ep_buf = stream_rx_buf(s);
+    if (skip_offset < xferred_bytes) {
+      tu_fifo_write_n(&s->ff, ep_buf + skip_offset, (tu_fifo_size_t) (xferred_bytes - skip_offset));
+    }
+    stream_pp_done(s);
+  }
+}
+
+void tu_edpt_stream_read_xfer_complete_strip(tu_edpt_stream_t* s, uint32_t xferred_bytes, uint16_t header_len) {
+  const uint16_t mps = s->is_mps512 ? TUSB_EPSIZE_BULK_HS : TUSB_EPSIZE_BULK_FS;
+
+  if (s->zc_busy) {
+    // data is received directly into fifo linear region: move payload of each packet together
+    if (!s->zc_stale) {
+      tu_fifo_buffer_info_t info;
+      tu_fifo_get_write_info(&s->ff, &info);
+      uint8_t* ptr = (uint8_t*) info.ptr_lin;
+      uint32_t count = 0;
+
+      for (uint32_t offset = 0; offset < xferred_bytes; offset += mps) {
+        const uint32_t pkt_len = tu_min32(mps, xferred_bytes - offset);
+        if (pkt_len > header_len) {
+          memmove(ptr + count, ptr + offset + header_len, pkt_len - header_len);
+          count += pkt_len - header_len;
+        }
+      }
+      tu_fifo_advance_write_pointer(&s->ff, (tu_fifo_size_t) count);
+    }
+    s->zc_busy = 0;
+    s->zc_stale = 0;
+  } else if (tu_fifo_depth(&s->ff)) {
+    uint8_t* ep_buf = stream_rx_buf(s);
+    for (uint32_t offset = 0; offset < xferred_bytes; offset += mps) {
+      const uint32_t pkt_len = tu_min32(mps, xferred_bytes - offset);
+      if (pkt_len > header_len) {
+        tu_fifo_write_n(&s->ff, ep_buf + offset + header_len, (tu_fifo_size_t) (pkt_len - header_len));
+      }
+    }
+    stream_pp_done(s);
+  }
+}
+
 uint32_t tu_edpt_stream_read(uint8_t hwid, tu_edpt_stream_t* s, void* buffer, uint32_t bufsize) {
-  uint32_t num_read = tu_fifo_read_n(&s->ff, buffer, (uint16_t) bufsize);
+  uint32_t num_read = tu_fifo_read_n(&s->ff, buffer, (tu_fifo_size_t) tu_min32(bufsize, TU_FIFO_SIZE_MAX));
+  stream_wm_rearm(s);
   tu_edpt_stream_read_xfer(hwid, s);
   return num_read;
 }
@@ -37,6 +37,8 @@
 #include "common/tusb_common.h"
 #include "osal/osal.h"
 #include "common/tusb_fifo.h"
+#include "common/tusb_mempool.h"
+#include "common/tusb_rfifo.h"
 
 //------------- TypeC -------------//
 #if CFG_TUC_ENABLED
@@ -59,9 +61,25 @@
     #include "class/cdc/cdc_host.h"
   #endif
 
+  #if CFG_TUH_AUDIO
+    #include "class/audio/audio_host.h"
+  #endif
+
+  #if CFG_TUH_MIDI
+    #include "class/midi/midi_host.h"
+  #endif
+
+  #if CFG_TUH_NCM
+    #include "class/net/ncm_host.h"
+  #endif
+
   #if CFG_TUH_VENDOR
     #include "class/vendor/vendor_host.h"
   #endif
+
+  #if CFG_TUH_VIDEO
+    #include "class/video/video_host.h"
+  #endif
 #else
   #ifndef tuh_int_handler
   #define tuh_int_handler(...)
@@ -165,16 +183,6 @@ void tusb_int_handler(uint8_t rhport, bool in_isr);
 
 #endif
 
-//--------------------------------------------------------------------+
-// API Implemented by user
-//--------------------------------------------------------------------+
-
-// Get current milliseconds, required by some port/configuration without RTOS
-uint32_t tusb_time_millis_api(void);
-
-// Delay in milliseconds, use tusb_time_millis_api() by default. required by some port/configuration with no RTOS
-void tusb_time_delay_ms_api(uint32_t ms);
-
 #ifdef __cplusplus
  }
 #endif
@@ -257,6 +257,12 @@
   #define CFG_TUD_DWC2_SLAVE_ENABLE CFG_TUD_DWC2_SLAVE_ENABLE_DEFAULT
 #endif
 
+// DWC2 Slave mode: max packets read from RxFIFO/written to TxFIFOs per dcd_int_handler(), the remaining packets are
+// moved by tud_task() with USB interrupt disabled, which bounds ISR time. 0 means no limit, see tud_stats_t isr_deferred
+#ifndef CFG_TUD_DWC2_SLAVE_ISR_BUDGET
+  #define CFG_TUD_DWC2_SLAVE_ISR_BUDGET 0
+#endif
+
 // Enable DWC2 DMA for device
 #ifndef CFG_TUD_DWC2_DMA_ENABLE
   #ifndef CFG_TUD_DWC2_DMA_ENABLE_DEFAULT
@@ -266,6 +272,23 @@
   #define CFG_TUD_DWC2_DMA_ENABLE CFG_TUD_DWC2_DMA_ENABLE_DEFAULT
 #endif
 
+// Use Scatter/Gather (descriptor) DMA for device if supported by core, require CFG_TUD_DWC2_DMA_ENABLE
+#ifndef CFG_TUD_DWC2_DMA_DESC_ENABLE
+  #define CFG_TUD_DWC2_DMA_DESC_ENABLE 0
+#endif
+
+// Stop PHY clock and gate HCLK of DWC2 device core while bus is suspended to cut suspend current, clocks are restored
+// on the first interrupt after suspend (resume, reset) or by dcd_remote_wakeup()
+#ifndef CFG_TUD_DWC2_SUSPEND_CLOCK_GATE
+  #define CFG_TUD_DWC2_SUSPEND_CLOCK_GATE 0
+#endif
+
+// Non-blocking DWC2 device bring-up: dcd_init() only starts core soft reset and returns, the rest of init and D+
+// pull-up is done by tud_task() once reset is complete, see tud_stats_t init_time
+#ifndef CFG_TUD_DWC2_ASYNC_INIT
+  #define CFG_TUD_DWC2_ASYNC_INIT 0
+#endif
+
 // Enable DWC2 Slave mode for host
 #ifndef CFG_TUH_DWC2_SLAVE_ENABLE
   #ifndef CFG_TUH_DWC2_SLAVE_ENABLE_DEFAULT
@@ -394,6 +417,17 @@
   #define CFG_TUD_LOG_LEVEL   2
 #endif
 
+// Binary trace of stack events into a RAM ring buffer (tu_trace_buf), decoded by tools/trace_decode.py.
+// Unlike logging, recording an event only takes a few stores so it does not change timing much
+#ifndef CFG_TUSB_TRACE
+  #define CFG_TUSB_TRACE      0
+#endif
+
+// Number of trace records, must be power of 2
+#ifndef CFG_TUSB_TRACE_COUNT
+  #define CFG_TUSB_TRACE_COUNT 256
+#endif
+
 // Memory section for placing buffer used for usb transferring. If MEM_SECTION is different for
 // host and device use: CFG_TUD_MEM_SECTION, CFG_TUH_MEM_SECTION instead
 #ifndef CFG_TUSB_MEM_SECTION
@@ -406,6 +440,23 @@
   #define CFG_TUSB_MEM_ALIGN      TU_ATTR_ALIGNED(4)
 #endif
 
+// Attribute to place ISR hot path code (marked with TU_ATTR_FAST_FUNC) e.g in ITCM or SRAM:
+//   #define CFG_TUSB_FAST_FUNC  __attribute__((section(".itcm_text")))
+// Default is MCU specific e.g .time_critical on RP2040, otherwise code stays in flash
+#ifndef CFG_TUSB_FAST_FUNC
+  #ifndef CFG_TUSB_FAST_FUNC_DEFAULT
+  #define CFG_TUSB_FAST_FUNC_DEFAULT
+  #endif
+
+  #define CFG_TUSB_FAST_FUNC CFG_TUSB_FAST_FUNC_DEFAULT
+#endif
+
+// Attribute to place control structures used by ISR (marked with TU_ATTR_FAST_DATA) e.g in DTCM. These are never
+// accessed by the usb controller, buffers used for transferring are placed with CFG_TUD/TUH_MEM_SECTION instead
+#ifndef CFG_TUSB_FAST_DATA
+  #define CFG_TUSB_FAST_DATA
+#endif
+
 #ifndef CFG_TUSB_MEM_DCACHE_LINE_SIZE
   #ifndef CFG_TUSB_MEM_DCACHE_LINE_SIZE_DEFAULT
   #define CFG_TUSB_MEM_DCACHE_LINE_SIZE_DEFAULT 32
@@ -414,11 +465,27 @@
   #define CFG_TUSB_MEM_DCACHE_LINE_SIZE CFG_TUSB_MEM_DCACHE_LINE_SIZE_DEFAULT
 #endif
 
+// Allow endpoint stream (bulk) to transfer directly from/to its FIFO linear region instead of
+// copying through the endpoint buffer. Only enable if FIFO buffers of class drivers are accessible
+// by the usb controller (e.g. its DMA can access all RAM). Region that is not word-aligned falls back
+// to copying, zero-copy is also skipped when DCache is enabled.
+#ifndef CFG_TUSB_EDPT_STREAM_ZERO_COPY
+  #define CFG_TUSB_EDPT_STREAM_ZERO_COPY 0
+#endif
+
 // OS selection
 #ifndef CFG_TUSB_OS
   #define CFG_TUSB_OS             OPT_OS_NONE
 #endif
 
+// OS None: sleep (WFI) in osal_queue_receive() instead of returning immediately, until an interrupt queues an event
+// or timeout expires. tud_task()/tuh_task() then block until there is an event, bare-metal main loop doing other work
+// should call tud_task_ext()/tuh_task_ext() with a finite timeout, which requires tusb_time_millis_api() and a periodic
+// interrupt (e.g SysTick) to wake up the core.
+#ifndef CFG_TUSB_OS_NONE_SLEEP
+  #define CFG_TUSB_OS_NONE_SLEEP  0
+#endif
+
 #ifndef CFG_TUSB_OS_INC_PATH
   #ifndef CFG_TUSB_OS_INC_PATH_DEFAULT
   #define CFG_TUSB_OS_INC_PATH_DEFAULT
@@ -453,6 +520,16 @@
   #define CFG_TUD_MEM_DCACHE_LINE_SIZE CFG_TUSB_MEM_DCACHE_LINE_SIZE
 #endif
 
+// Memory region that is not cached e.g mapped as non-cacheable by MPU to hold CFG_TUD_MEM_SECTION. Cache
+// maintenance is skipped for buffers within it. Size 0 (default) means all memory is treated as cacheable
+#ifndef CFG_TUD_MEM_NONCACHEABLE_ADDR
+  #define CFG_TUD_MEM_NONCACHEABLE_ADDR 0
+#endif
+
+#ifndef CFG_TUD_MEM_NONCACHEABLE_SIZE
+  #define CFG_TUD_MEM_NONCACHEABLE_SIZE 0
+#endif
+
 #ifndef CFG_TUD_ENDPOINT0_SIZE
   #define CFG_TUD_ENDPOINT0_SIZE  64
 #endif
@@ -461,6 +538,13 @@
   #define CFG_TUD_INTERFACE_MAX   16
 #endif
 
+// Number of controllers that can run device stack at the same time (tud_rhport_init() on each), each with its own
+// device state and descriptors (see tud_rhport_current()). Class driver instances are shared: an instance is bound to
+// the controller that opens it. API without rhport e.g tud_mounted() refers to the first initialized controller
+#ifndef CFG_TUD_RHPORT_NUM
+  #define CFG_TUD_RHPORT_NUM      1
+#endif
+
 // default to max hardware endpoint, but can be smaller to save RAM
 #ifndef CFG_TUD_ENDPPOINT_MAX
   #define CFG_TUD_ENDPPOINT_MAX   TUP_DCD_ENDPOINT_MAX
@@ -470,11 +554,74 @@
   #error "CFG_TUD_ENDPPOINT_MAX must be less than or equal to TUP_DCD_ENDPOINT_MAX"
 #endif
 
+// Enable scatter-gather transfer usbd_edpt_xfer_sg(). If dcd does not support it natively,
+// usbd submits each buffer sequentially which requires some RAM per endpoint
+#ifndef CFG_TUD_EDPT_XFER_SG
+  #define CFG_TUD_EDPT_XFER_SG    0
+#endif
+
+// Allow usbd_edpt_xfer() larger than what dcd can submit at once (TUP_DCD_EDPT_XFER_MAX), usbd splits
+// it into multiple submissions which requires some RAM per endpoint
+#ifndef CFG_TUD_EDPT_XFER_LARGE
+  #define CFG_TUD_EDPT_XFER_LARGE 0
+#endif
+
+// Number of transfers that can be queued per endpoint with usbd_edpt_xfer_queue() behind the one on dcd. The next
+// one is submitted in ISR when a transfer completes, leaving no un-armed window. Requires some RAM per endpoint
+#ifndef CFG_TUD_EDPT_XFER_QUEUE
+  #define CFG_TUD_EDPT_XFER_QUEUE 0
+#endif
+
+// Enable isochronous packet list transfer usbd_edpt_iso_xfer(). If dcd does not support it natively, usbd submits
+// the packets one by one from dcd_event_handler() in ISR, which requires some RAM per endpoint
+#ifndef CFG_TUD_EDPT_ISO_XFER
+  #define CFG_TUD_EDPT_ISO_XFER 0
+#endif
+
+// Size of endpoint buffer pool shared by class drivers, 0 to disable. Drivers supporting it allocate their
+// endpoint buffers from the pool when opened and release them on bus reset/configuration change, so that RAM is
+// only needed for interfaces of the active configuration instead of every instance. Placed in CFG_TUD_MEM_SECTION
+#ifndef CFG_TUD_EPBUF_POOL_SIZE
+  #define CFG_TUD_EPBUF_POOL_SIZE 0
+#endif
+
+// Allocation unit of endpoint buffer pool, each buffer is aligned to it. Must be a multiple of the alignment
+// required by dcd (CFG_TUD_MEM_ALIGN), default to cache line size when dcache is enabled
+#ifndef CFG_TUD_EPBUF_POOL_UNIT
+  #define CFG_TUD_EPBUF_POOL_UNIT (CFG_TUD_MEM_DCACHE_ENABLE ? CFG_TUD_MEM_DCACHE_LINE_SIZE : 32)
+#endif
+
+// Number of precomputed control responses registered with usbd_control_fast_set(), 0 to disable. Frequently polled
+// IN requests such as GET_STATUS, HID GET_REPORT or audio GET_CUR are then answered in ISR instead of usbd task
+#ifndef CFG_TUD_CONTROL_FAST
+  #define CFG_TUD_CONTROL_FAST 0
+#endif
+
+// Max data length of a precomputed control response, must not exceed CFG_TUD_ENDPOINT0_SIZE
+#ifndef CFG_TUD_CONTROL_FAST_SIZE
+  #define CFG_TUD_CONTROL_FAST_SIZE 8
+#endif
+
+#if CFG_TUD_CONTROL_FAST && CFG_TUD_CONTROL_FAST_SIZE > CFG_TUD_ENDPOINT0_SIZE
+  #error "CFG_TUD_CONTROL_FAST_SIZE must be less than or equal to CFG_TUD_ENDPOINT0_SIZE"
+#endif
+
 // USB 2.0 7.1.20: compliance test mode support
 #ifndef CFG_TUD_TEST_MODE
   #define CFG_TUD_TEST_MODE       0
 #endif
 
+// USB 2.0 LPM ECN: ACK LPM token to enter L1 sleep (see tud_lpm_sleep_cb()), if supported by DCD. Device descriptor
+// bcdUSB must be 0x0201 and BOS must have the USB 2.0 Extension capability, see TUD_BOS_USB20_EXT_DESCRIPTOR()
+#ifndef CFG_TUD_LPM
+  #define CFG_TUD_LPM             0
+#endif
+
+// Runtime statistics: per-endpoint transfer counters, event queue high-water and ISR time, see tud_stats_get()
+#ifndef CFG_TUD_STATS
+  #define CFG_TUD_STATS           0
+#endif
+
 //------------- Device Class Driver -------------//
 #ifndef CFG_TUD_BTH
   #define CFG_TUD_BTH             0
@@ -545,6 +692,13 @@
     #define CFG_TUH_DEVICE_MAX 1
   #endif
 
+  // Number of controllers that can run host stack at the same time (tuh_rhport_init() on each). They share the event
+  // queue, the device pool (CFG_TUH_DEVICE_MAX and CFG_TUH_HUB are total of all controllers) and enumeration,
+  // which is done one device at a time. Transfers of enumerated devices run concurrently on their own controller.
+  #ifndef CFG_TUH_RHPORT_NUM
+    #define CFG_TUH_RHPORT_NUM 1
+  #endif
+
   #ifndef CFG_TUH_ENUMERATION_BUFSIZE
     #define CFG_TUH_ENUMERATION_BUFSIZE 256
   #endif
@@ -572,12 +726,26 @@
   #define CFG_TUH_MEM_DCACHE_LINE_SIZE CFG_TUSB_MEM_DCACHE_LINE_SIZE
 #endif
 
+// Memory region that is not cached e.g mapped as non-cacheable by MPU to hold CFG_TUH_MEM_SECTION. Cache
+// maintenance is skipped for buffers within it. Size 0 (default) means all memory is treated as cacheable
+#ifndef CFG_TUH_MEM_NONCACHEABLE_ADDR
+  #define CFG_TUH_MEM_NONCACHEABLE_ADDR 0
+#endif
+
+#ifndef CFG_TUH_MEM_NONCACHEABLE_SIZE
+  #define CFG_TUH_MEM_NONCACHEABLE_SIZE 0
+#endif
+
 //------------- CLASS -------------//
 
 #ifndef CFG_TUH_HUB
   #define CFG_TUH_HUB    0
 #endif
 
+#ifndef CFG_TUH_AUDIO
+  #define CFG_TUH_AUDIO  0
+#endif
+
 #ifndef CFG_TUH_CDC
   #define CFG_TUH_CDC    0
 #endif
@@ -635,14 +803,51 @@
   #define CFG_TUH_MSC    0
 #endif
 
+#ifndef CFG_TUH_NCM
+  #define CFG_TUH_NCM    0
+#endif
+
 #ifndef CFG_TUH_VENDOR
   #define CFG_TUH_VENDOR 0
 #endif
 
+#ifndef CFG_TUH_VIDEO
+  #define CFG_TUH_VIDEO  0
+#endif
+
 #ifndef CFG_TUH_API_EDPT_XFER
   #define CFG_TUH_API_EDPT_XFER 0
 #endif
 
+// Allow usbh_edpt_xfer() larger than what hcd can submit at once (TUP_HCD_EDPT_XFER_MAX), usbh splits
+// it into multiple submissions which requires some RAM per endpoint of each device
+#ifndef CFG_TUH_EDPT_XFER_LARGE
+  #define CFG_TUH_EDPT_XFER_LARGE 0
+#endif
+
+// Number of transfers that can be queued per endpoint with usbh_edpt_xfer_queue() behind the one on hcd. The next
+// one is submitted in ISR when a transfer completes, keeping bulk endpoints busy. Requires some RAM per endpoint
+#ifndef CFG_TUH_EDPT_XFER_QUEUE
+  #define CFG_TUH_EDPT_XFER_QUEUE 0
+#endif
+
+// Isochronous transfer with per-packet descriptors and start frame: tuh_edpt_iso_xfer(). Requires hcd support
+// (EHCI and DWC2), some RAM per endpoint of each device
+#ifndef CFG_TUH_EDPT_ISO_XFER
+  #define CFG_TUH_EDPT_ISO_XFER 0
+#endif
+
+// Runtime statistics: per-endpoint transfer counters, event queue high-water and ISR time, see tuh_stats_get()
+#ifndef CFG_TUH_STATS
+  #define CFG_TUH_STATS 0
+#endif
+
+// Periodic bandwidth admission control: tuh_edpt_open() fails when an interrupt/isochronous endpoint does not fit in
+// the periodic budget of its root port, see tuh_edpt_bandwidth_fits() and tuh_interface_alt_best()
+#ifndef CFG_TUH_PERIODIC_BUDGET
+  #define CFG_TUH_PERIODIC_BUDGET 1
+#endif
+
 //--------------------------------------------------------------------+
 // TypeC Options (Default)
 //--------------------------------------------------------------------+
@@ -28,8 +28,8 @@
 
 #if CFG_TUC_ENABLED
 
+#include "tusb.h"
 #include "tcd.h"
-#include "usbc.h"
 
 //--------------------------------------------------------------------+
 //
@@ -45,6 +45,9 @@ void usbc_int_set(bool enabled);
 OSAL_QUEUE_DEF(usbc_int_set, _usbc_qdef, CFG_TUC_TASK_QUEUE_SZ, tcd_event_t);
 tu_static osal_queue_t _usbc_q;
 
+// Protect message queues shared between task and ISR (fast path reply, tx complete)
+static OSAL_SPINLOCK_DEF(_usbc_spin, usbc_int_set);
+
 // if stack is initialized
 static bool _usbc_inited = false;
 
@@ -52,13 +55,54 @@ static bool _usbc_inited = false;
 static bool _port_inited[TUP_TYPEC_RHPORTS_NUM];
 
 // Max possible PD size is 262 bytes
-static uint8_t _rx_buf[64] TU_ATTR_ALIGNED(4);
-static uint8_t _tx_buf[64] TU_ATTR_ALIGNED(4);
+#define USBC_MSG_BUFSIZE  64
+
+typedef struct {
+  uint8_t data[USBC_MSG_BUFSIZE] TU_ATTR_ALIGNED(4);
+  uint8_t rhport;
+  uint16_t len;
+  uint32_t time_ms;
+} usbc_msg_t;
+
+// Received messages, slot at wr index is armed for reception while queued ones wait for tuc_task()
+typedef struct {
+  usbc_msg_t msg[CFG_TUC_RX_MSG_COUNT];
+  uint8_t wr;
+  uint8_t rd;
+  volatile uint8_t count;
+  volatile bool stalled; // all slots are queued, reception is paused until one is processed
+} usbc_rx_queue_t;
+
+// Messages to transmit, head is passed to TCD; one message in flight at a time
+typedef struct {
+  usbc_msg_t msg[CFG_TUC_TX_MSG_COUNT];
+  uint8_t wr;
+  uint8_t rd;
+  volatile uint8_t count;
+} usbc_tx_queue_t;
+
+static usbc_rx_queue_t _usbc_rx;
+static usbc_tx_queue_t _usbc_tx;
+static tuc_pd_stats_t _usbc_stats[TUP_TYPEC_RHPORTS_NUM];
+
+// reception time of message being processed by callbacks
+static uint32_t _usbc_rx_time_ms;
+
+// set while tuc_pd_msg_received_isr_cb() is invoked from ISR, message sent by callback takes spinlock in ISR mode
+static volatile bool _usbc_cb_in_isr = false;
 
 bool usbc_msg_send(uint8_t rhport, pd_header_t const* header, void const* data);
 bool parse_msg_data(uint8_t rhport, pd_header_t const* header, uint8_t const* dobj, uint8_t const* p_end);
 bool parse_msg_control(uint8_t rhport, pd_header_t const* header);
 
+TU_ATTR_ALWAYS_INLINE static inline uint32_t usbc_time_ms(void) {
+#if CFG_TUC_MSG_TIMESTAMP
+  return tusb_time_millis_api();
+#else
+  return 0;
+#endif
+}
+
 //--------------------------------------------------------------------+
 //
 //--------------------------------------------------------------------+
@@ -70,10 +114,15 @@ bool tuc_init(uint8_t rhport, uint32_t port_type) {
   // Initialize stack
   if (!_usbc_inited) {
     tu_memclr(_port_inited, sizeof(_port_inited));
+    tu_memclr(&_usbc_rx, sizeof(_usbc_rx));
+    tu_memclr(&_usbc_tx, sizeof(_usbc_tx));
+    tu_memclr(_usbc_stats, sizeof(_usbc_stats));
 
     _usbc_q = osal_queue_create(&_usbc_qdef);
     TU_ASSERT(_usbc_q != NULL);
 
+    osal_spin_init(&_usbc_spin);
+
     _usbc_inited = true;
   }
 
@@ -92,6 +141,37 @@ bool tuc_init(uint8_t rhport, uint32_t port_type) {
   return true;
 }
 
+void tuc_pd_stats_get(uint8_t rhport, tuc_pd_stats_t* stats) {
+  osal_spin_lock(&_usbc_spin, false);
+  *stats = _usbc_stats[rhport];
+  osal_spin_unlock(&_usbc_spin, false);
+}
+
+void tuc_pd_stats_clear(uint8_t rhport) {
+  osal_spin_lock(&_usbc_spin, false);
+  tu_memclr(&_usbc_stats[rhport], sizeof(tuc_pd_stats_t));
+  osal_spin_unlock(&_usbc_spin, false);
+}
+
+uint32_t tuc_msg_rx_time(uint8_t rhport) {
+  (void) rhport;
+  return _usbc_rx_time_ms;
+}
+
+// Invoke received callback for message
+static void process_rx_msg(usbc_msg_t const* msg) {
+  pd_header_t const* header = (pd_header_t const*) msg->data;
+
+  if (header->n_data_obj == 0) {
+    parse_msg_control(msg->rhport, header);
+  } else {
+    uint8_t const* p_end = msg->data + msg->len;
+    uint8_t const* dobj = msg->data + sizeof(pd_header_t);
+
+    parse_msg_data(msg->rhport, header, dobj, p_end);
+  }
+}
+
 void tuc_task_ext(uint32_t timeout_ms, bool in_isr) {
   (void) in_isr; // not implemented yet
 
@@ -108,23 +188,33 @@ void tuc_task_ext(uint32_t timeout_ms, bool in_isr) {
         break;
 
       case TCD_EVENT_RX_COMPLETE:
-        // TODO process message here in ISR, move to thread later
-        if (event.xfer_complete.result == XFER_RESULT_SUCCESS) {
-          pd_header_t const* header = (pd_header_t const*) _rx_buf;
-
-          if (header->n_data_obj == 0) {
-            parse_msg_control(event.rhport, header);
+        // Only successful message not handled by ISR fast path is queued. Drain all of them so that a dropped
+        // event does not leave message behind
+        while (_usbc_rx.count) {
+          usbc_msg_t const* msg = &_usbc_rx.msg[_usbc_rx.rd];
+          _usbc_rx_time_ms = msg->time_ms;
+
+#if CFG_TUC_MSG_TIMESTAMP
+          uint32_t const latency = usbc_time_ms() - msg->time_ms;
+          tuc_pd_stats_t* stats = &_usbc_stats[msg->rhport];
+          if (latency > stats->rx_latency_max_ms) {
+            stats->rx_latency_max_ms = latency;
+          }
+#endif
 
-          }else {
-            uint8_t const* p_end = _rx_buf + event.xfer_complete.xferred_bytes;
-            uint8_t const * dobj = _rx_buf + sizeof(pd_header_t);
+          process_rx_msg(msg);
 
-            parse_msg_data(event.rhport, header, dobj, p_end);
+          // release slot, resume reception if it was paused
+          osal_spin_lock(&_usbc_spin, false);
+          _usbc_rx.rd = (uint8_t) ((_usbc_rx.rd + 1) % CFG_TUC_RX_MSG_COUNT);
+          _usbc_rx.count--;
+          if (_usbc_rx.stalled) {
+            _usbc_rx.stalled = false;
+            _usbc_rx.wr = (uint8_t) ((_usbc_rx.wr + 1) % CFG_TUC_RX_MSG_COUNT);
+            tcd_msg_receive(msg->rhport, _usbc_rx.msg[_usbc_rx.wr].data, USBC_MSG_BUFSIZE);
           }
+          osal_spin_unlock(&_usbc_spin, false);
         }
-
-        // prepare for next message
-        tcd_msg_receive(event.rhport, _rx_buf, sizeof(_rx_buf));
         break;
 
       case TCD_EVENT_TX_COMPLETE:
@@ -155,17 +245,55 @@ bool parse_msg_control(uint8_t rhport, pd_header_t const* header) {
 //
 //--------------------------------------------------------------------+
 
+// Pass head of tx queue to TCD, must be called with spinlock held
+static void tx_queue_start(void) {
+  usbc_msg_t const* msg = &_usbc_tx.msg[_usbc_tx.rd];
+  if (!tcd_msg_send(msg->rhport, msg->data, msg->len)) {
+    // complete with failure, the rest of queue is kicked by next message
+    _usbc_stats[msg->rhport].tx_failed++;
+    _usbc_tx.rd = (uint8_t) ((_usbc_tx.rd + 1) % CFG_TUC_TX_MSG_COUNT);
+    _usbc_tx.count--;
+  }
+}
+
 bool usbc_msg_send(uint8_t rhport, pd_header_t const* header, void const* data) {
+  bool const in_isr = _usbc_cb_in_isr;
+  uint16_t const n_data_obj = header->n_data_obj;
+  uint16_t const len = (uint16_t) (sizeof(pd_header_t) + n_data_obj * 4);
+  TU_ASSERT(len <= USBC_MSG_BUFSIZE);
+
+  osal_spin_lock(&_usbc_spin, in_isr);
+
+  if (_usbc_tx.count >= CFG_TUC_TX_MSG_COUNT) {
+    _usbc_stats[rhport].tx_queue_full++;
+    osal_spin_unlock(&_usbc_spin, in_isr);
+    return false;
+  }
+
+  usbc_msg_t* msg = &_usbc_tx.msg[_usbc_tx.wr];
+  msg->rhport = rhport;
+  msg->len = len;
+  msg->time_ms = usbc_time_ms();
+
   // copy header
-  memcpy(_tx_buf, header, sizeof(pd_header_t));
+  memcpy(msg->data, header, sizeof(pd_header_t));
 
   // copy data objcet if available
-  uint16_t const n_data_obj = header->n_data_obj;
   if (n_data_obj > 0) {
-    memcpy(_tx_buf + sizeof(pd_header_t), data, n_data_obj * 4);
+    memcpy(msg->data + sizeof(pd_header_t), data, n_data_obj * 4);
+  }
+
+  _usbc_tx.wr = (uint8_t) ((_usbc_tx.wr + 1) % CFG_TUC_TX_MSG_COUNT);
+  _usbc_tx.count++;
+
+  // start now if nothing is in flight, otherwise it is sent on completion of previous one
+  if (_usbc_tx.count == 1) {
+    tx_queue_start();
   }
 
-  return tcd_msg_send(rhport, _tx_buf, sizeof(pd_header_t) + n_data_obj * 4);
+  osal_spin_unlock(&_usbc_spin, in_isr);
+
+  return true;
 }
 
 bool tuc_msg_request(uint8_t rhport, void const* rdo) {
@@ -182,22 +310,117 @@ bool tuc_msg_request(uint8_t rhport, void const* rdo) {
   return usbc_msg_send(rhport, &header, rdo);
 }
 
+// Received message in ISR: try fast path, otherwise queue for task and arm next slot.
+// Return true if message is queued for tuc_task()
+static bool rx_complete_isr(tcd_event_t const* event, bool in_isr) {
+  uint8_t const rhport = event->rhport;
+  tuc_pd_stats_t* stats = &_usbc_stats[rhport];
+  usbc_msg_t* msg = &_usbc_rx.msg[_usbc_rx.wr];
+  bool queued = false;
+
+  osal_spin_lock(&_usbc_spin, in_isr);
+
+  if (event->xfer_complete.result != XFER_RESULT_SUCCESS) {
+    stats->rx_failed++;
+  } else {
+    stats->rx_count++;
+    msg->rhport = rhport;
+    msg->len = event->xfer_complete.xferred_bytes;
+    msg->time_ms = usbc_time_ms();
+
+    if (tuc_pd_msg_received_isr_cb) {
+      pd_header_t const* header = (pd_header_t const*) msg->data;
+      uint8_t const* dobj = msg->data + sizeof(pd_header_t);
+
+      osal_spin_unlock(&_usbc_spin, in_isr);
+      _usbc_rx_time_ms = msg->time_ms;
+      _usbc_cb_in_isr = in_isr;
+      bool const handled = tuc_pd_msg_received_isr_cb(rhport, header, dobj, msg->data + msg->len);
+      _usbc_cb_in_isr = false;
+      osal_spin_lock(&_usbc_spin, in_isr);
+
+      if (handled) {
+        stats->rx_isr_handled++;
+      } else {
+        queued = true;
+      }
+    } else {
+      queued = true;
+    }
+  }
+
+  if (queued) {
+    _usbc_rx.count++;
+    if (_usbc_rx.count < CFG_TUC_RX_MSG_COUNT) {
+      _usbc_rx.wr = (uint8_t) ((_usbc_rx.wr + 1) % CFG_TUC_RX_MSG_COUNT);
+    } else {
+      // no free slot, tuc_task() resumes reception after processing one
+      _usbc_rx.stalled = true;
+      stats->rx_stalled++;
+    }
+  }
+
+  // prepare for next message
+  if (!_usbc_rx.stalled) {
+    tcd_msg_receive(rhport, _usbc_rx.msg[_usbc_rx.wr].data, USBC_MSG_BUFSIZE);
+  }
+
+  osal_spin_unlock(&_usbc_spin, in_isr);
+
+  return queued;
+}
+
+// Message in flight is complete, start next one
+static void tx_complete_isr(tcd_event_t const* event, bool in_isr) {
+  osal_spin_lock(&_usbc_spin, in_isr);
+
+  if (_usbc_tx.count) {
+    tuc_pd_stats_t* stats = &_usbc_stats[event->rhport];
+    if (event->xfer_complete.result == XFER_RESULT_SUCCESS) {
+      stats->tx_count++;
+    } else {
+      stats->tx_failed++;
+    }
+
+    _usbc_tx.rd = (uint8_t) ((_usbc_tx.rd + 1) % CFG_TUC_TX_MSG_COUNT);
+    _usbc_tx.count--;
+
+    if (_usbc_tx.count) {
+      tx_queue_start();
+    }
+  }
+
+  osal_spin_unlock(&_usbc_spin, in_isr);
+}
+
 void tcd_event_handler(tcd_event_t const * event, bool in_isr) {
-  (void) in_isr;
   switch(event->event_id) {
     case TCD_EVENT_CC_CHANGED:
       if (event->cc_changed.cc_state[0] || event->cc_changed.cc_state[1]) {
         // Attach, start receiving
-        tcd_msg_receive(event->rhport, _rx_buf, sizeof(_rx_buf));
+        if (!_usbc_rx.stalled) {
+          tcd_msg_receive(event->rhport, _usbc_rx.msg[_usbc_rx.wr].data, USBC_MSG_BUFSIZE);
+        }
       }else {
         // Detach
       }
       break;
 
+    case TCD_EVENT_RX_COMPLETE:
+      // handled in ISR, only queued message is forwarded to task
+      if (!rx_complete_isr(event, in_isr)) return;
+      break;
+
+    case TCD_EVENT_TX_COMPLETE:
+      tx_complete_isr(event, in_isr);
+      break;
+
     default: break;
   }
 
-  osal_queue_send(_usbc_q, event, in_isr);
+  if (!osal_queue_send(_usbc_q, event, in_isr)) {
+    _usbc_stats[event->rhport].event_dropped++;
+  }
 }
 
 //--------------------------------------------------------------------+
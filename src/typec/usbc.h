@@ -42,6 +42,34 @@ extern "C" {
 #define CFG_TUC_TASK_QUEUE_SZ   8
 #endif
 
+// Number of received messages that can be queued for tuc_task(). One slot is always armed for reception, with all of
+// them waiting to be processed reception is paused (sender retries without GoodCRC).
+#ifndef CFG_TUC_RX_MSG_COUNT
+#define CFG_TUC_RX_MSG_COUNT    2
+#endif
+
+// Number of messages that can be queued for transmission, sent one after another by ISR
+#ifndef CFG_TUC_TX_MSG_COUNT
+#define CFG_TUC_TX_MSG_COUNT    2
+#endif
+
+// Timestamp messages with tusb_time_millis_api(), used by tuc_msg_rx_time() and latency statistics
+#ifndef CFG_TUC_MSG_TIMESTAMP
+#define CFG_TUC_MSG_TIMESTAMP   0
+#endif
+
+typedef struct {
+  uint32_t rx_count;          // messages received without error
+  uint32_t rx_failed;         // messages received with CRC error
+  uint32_t rx_isr_handled;    // messages consumed by tuc_pd_msg_received_isr_cb()
+  uint32_t rx_stalled;        // times reception was paused since all rx slots were waiting for tuc_task()
+  uint32_t rx_latency_max_ms; // longest time from reception to processing in tuc_task() (CFG_TUC_MSG_TIMESTAMP)
+  uint32_t tx_count;          // messages sent successfully
+  uint32_t tx_failed;         // messages failed to send (discarded, aborted)
+  uint32_t tx_queue_full;     // messages rejected since tx queue is full
+  uint32_t event_dropped;     // events dropped due to full event queue
+} tuc_pd_stats_t;
+
 //--------------------------------------------------------------------+
 // Application API
 //--------------------------------------------------------------------+
@@ -77,12 +105,26 @@ extern void tcd_int_handler(uint8_t rhport);
 TU_ATTR_WEAK bool tuc_pd_data_received_cb(uint8_t rhport, pd_header_t const* header, uint8_t const* dobj, uint8_t const* p_end);
 TU_ATTR_WEAK bool tuc_pd_control_received_cb(uint8_t rhport, pd_header_t const* header);
 
+// Invoked in tcd_event_handler() context (typically ISR) as soon as a message is received, before it is queued for
+// tuc_task(). Time-critical reply (within tReceiverResponse) can be sent here e.g with tuc_msg_request(), keeping
+// contract negotiation latency independent of task load. Return true if the message is fully handled and should not
+// be passed to tuc_pd_data_received_cb()/tuc_pd_control_received_cb().
+TU_ATTR_WEAK bool tuc_pd_msg_received_isr_cb(uint8_t rhport, pd_header_t const* header, uint8_t const* dobj, uint8_t const* p_end);
+
 //--------------------------------------------------------------------+
 //
 //--------------------------------------------------------------------+
 
 bool tuc_msg_request(uint8_t rhport, void const* rdo);
 
+// Reception time (tusb_time_millis_api) of the message being processed by received callbacks, 0 if
+// CFG_TUC_MSG_TIMESTAMP is not enabled
+uint32_t tuc_msg_rx_time(uint8_t rhport);
+
+// Get/Clear message statistics
+void tuc_pd_stats_get(uint8_t rhport, tuc_pd_stats_t* stats);
+void tuc_pd_stats_clear(uint8_t rhport);
+
 
 #ifdef __cplusplus
 }
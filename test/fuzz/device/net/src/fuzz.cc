@@ -60,7 +60,7 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
       return 0;
     }
     tud_int_handler(provider.ConsumeIntegral<uint8_t>());
-    tud_task(); // tinyusb device task
+    fuzz_tud_task(); // tinyusb device task
     net_task(&provider);
   }
 
@@ -24,6 +24,7 @@
  */
 
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -32,6 +33,9 @@ extern "C" {
 
 int fuzz_init(const uint8_t *data, size_t size);
 
+// Run tud_task(), also record its worst-case cost when built with FUZZ_LATENCY=1
+void fuzz_tud_task(void);
+
 #ifdef __cplusplus
 }
 #endif
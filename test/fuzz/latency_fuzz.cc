@@ -0,0 +1,230 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Worst-case latency recorder, enabled with FUZZ_LATENCY=1 (make).
+// Cost is the number of user-space instructions retired (perf counter), or nanoseconds if the counter is not
+// available. tud_task() is measured as a whole, class callbacks are measured from the TU_TRACE enter/exit records
+// (CFG_TUSB_TRACE) timestamped with the same counter. Maximum is reported on exit, and the fuzzer aborts (saving the
+// input as crash) when a cost exceeds the limit set with environment variable:
+// - FUZZ_LATENCY_TASK_LIMIT: single tud_task() call
+// - FUZZ_LATENCY_CB_LIMIT  : single class control request stage or transfer callback
+// Note: costs are inflated by sanitizer/coverage instrumentation, limits are only comparable within the same build.
+
+#include "fuzz/fuzz.h"
+#include "tusb.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if FUZZ_LATENCY
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if !CFG_TUSB_TRACE
+  #error "FUZZ_LATENCY requires CFG_TUSB_TRACE"
+#endif
+#endif
+
+extern "C" {
+
+#if !FUZZ_LATENCY
+
+void fuzz_tud_task(void) {
+  tud_task();
+}
+
+#else
+
+//--------------------------------------------------------------------+
+// Cost counter
+//--------------------------------------------------------------------+
+static int _perf_fd = -2; // -2: not opened yet, -1: not available
+
+static uint64_t latency_counter(void) {
+  if (_perf_fd == -2) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    _perf_fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (_perf_fd < 0) {
+      _perf_fd = -1;
+    }
+  }
+
+  uint64_t count;
+  if (_perf_fd >= 0 && read(_perf_fd, &count, sizeof(count)) == (ssize_t) sizeof(count)) {
+    return count;
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+uint32_t tusb_trace_timestamp_cb(void) {
+  return (uint32_t) latency_counter();
+}
+
+//--------------------------------------------------------------------+
+// Maximum tracking
+//--------------------------------------------------------------------+
+typedef struct {
+  uint32_t cost;
+  uint32_t arg; // control: stage << 16 | bmRequestType << 8 | bRequest, xfer: xferred bytes
+} latency_max_t;
+
+static struct {
+  uint64_t task_max;
+  uint64_t task_count;
+  latency_max_t ctrl[256]; // indexed by wIndex low byte (interface or endpoint)
+  latency_max_t xfer[32];  // indexed by epnum + 16 * dir
+  uint32_t trace_index;    // next trace record to process
+  uint32_t trace_lost;
+
+  uint64_t task_limit;
+  uint32_t cb_limit;
+} _latency;
+
+static void latency_report(void) {
+  fprintf(stderr, "LATENCY unit: %s\n", _perf_fd >= 0 ? "instructions" : "ns");
+  fprintf(stderr, "LATENCY tud_task: max %llu over %llu calls\n", (unsigned long long) _latency.task_max,
+          (unsigned long long) _latency.task_count);
+
+  for (unsigned i = 0; i < TU_ARRAY_SIZE(_latency.ctrl); i++) {
+    latency_max_t const *m = &_latency.ctrl[i];
+    if (m->cost) {
+      fprintf(stderr, "LATENCY control wIndex %3u: max %u (stage %u, bmRequestType 0x%02X, bRequest 0x%02X)\n", i,
+              m->cost, (unsigned) (m->arg >> 16), (unsigned) ((m->arg >> 8) & 0xff), (unsigned) (m->arg & 0xff));
+    }
+  }
+
+  for (unsigned i = 0; i < TU_ARRAY_SIZE(_latency.xfer); i++) {
+    latency_max_t const *m = &_latency.xfer[i];
+    if (m->cost) {
+      fprintf(stderr, "LATENCY xfer ep 0x%02X: max %u (%u bytes)\n", (i & 0x0f) | ((i & 0x10) << 3), m->cost, m->arg);
+    }
+  }
+
+  if (_latency.trace_lost) {
+    fprintf(stderr, "LATENCY %u trace records lost, increase CFG_TUSB_TRACE_COUNT\n", _latency.trace_lost);
+  }
+}
+
+static void latency_check(char const *what, uint64_t cost, uint64_t limit) {
+  if (limit && cost > limit) {
+    fprintf(stderr, "LATENCY %s cost %llu exceeds limit %llu\n", what, (unsigned long long) cost,
+            (unsigned long long) limit);
+    latency_report();
+    abort();
+  }
+}
+
+static void latency_update(latency_max_t *m, uint32_t cost, uint32_t arg) {
+  if (cost > m->cost) {
+    m->cost = cost;
+    m->arg = arg;
+  }
+}
+
+// Match enter/exit trace records written since last call
+static void latency_process_trace(void) {
+  tu_trace_record_t const *enter[4];
+  uint8_t depth = 0;
+
+  uint32_t const end = tu_trace_buf.index;
+  if (end - _latency.trace_index > CFG_TUSB_TRACE_COUNT) {
+    _latency.trace_lost += end - _latency.trace_index - CFG_TUSB_TRACE_COUNT;
+    _latency.trace_index = end - CFG_TUSB_TRACE_COUNT;
+  }
+
+  for (; _latency.trace_index != end; _latency.trace_index++) {
+    tu_trace_record_t const *rec = &tu_trace_buf.records[_latency.trace_index & (CFG_TUSB_TRACE_COUNT - 1)];
+
+    if (rec->id == TU_TRACE_CTRL_ENTER || rec->id == TU_TRACE_CB_ENTER) {
+      if (depth < TU_ARRAY_SIZE(enter)) {
+        enter[depth] = rec;
+      }
+      depth++;
+    } else if ((rec->id == TU_TRACE_CTRL_EXIT || rec->id == TU_TRACE_CB_EXIT) && depth > 0) {
+      depth--;
+      if (depth >= TU_ARRAY_SIZE(enter)) {
+        continue;
+      }
+
+      tu_trace_record_t const *start = enter[depth];
+      uint32_t const cost = rec->timestamp - start->timestamp;
+
+      if (rec->id == TU_TRACE_CTRL_EXIT && start->id == TU_TRACE_CTRL_ENTER) {
+        latency_update(&_latency.ctrl[start->arg16 & 0xff], cost, ((uint32_t) start->arg8 << 16) | start->arg32);
+        latency_check("control handler", cost, _latency.cb_limit);
+      } else if (rec->id == TU_TRACE_CB_EXIT && start->id == TU_TRACE_CB_ENTER) {
+        uint8_t const ep_addr = (uint8_t) start->arg16;
+        latency_update(&_latency.xfer[tu_edpt_number(ep_addr) + 16 * tu_edpt_dir(ep_addr)], cost, start->arg32);
+        latency_check("xfer callback", cost, _latency.cb_limit);
+      }
+    }
+  }
+}
+
+static void latency_init(void) {
+  char const *env = getenv("FUZZ_LATENCY_TASK_LIMIT");
+  _latency.task_limit = env ? strtoull(env, NULL, 0) : 0;
+  env = getenv("FUZZ_LATENCY_CB_LIMIT");
+  _latency.cb_limit = env ? (uint32_t) strtoul(env, NULL, 0) : 0;
+
+  (void) latency_counter(); // open counter before first timestamp
+  _latency.trace_index = tu_trace_buf.index;
+  atexit(latency_report);
+}
+
+void fuzz_tud_task(void) {
+  static bool initialized = false;
+  if (!initialized) {
+    initialized = true;
+    latency_init();
+  }
+
+  uint64_t const start = latency_counter();
+  tud_task();
+  uint64_t const cost = latency_counter() - start;
+
+  _latency.task_count++;
+  if (cost > _latency.task_max) {
+    _latency.task_max = cost;
+  }
+
+  latency_process_trace();
+  latency_check("tud_task", cost, _latency.task_limit);
+}
+
+#endif
+
+}
@@ -69,6 +69,11 @@ SANITIZER_FLAGS ?= -fsanitize=fuzzer \
 
 CFLAGS += $(COVERAGE_FLAGS) $(SANITIZER_FLAGS)
 
+# Record worst-case cost of tud_task() and class callbacks, see latency_fuzz.cc
+ifeq ($(FUZZ_LATENCY), 1)
+  CFLAGS += -DFUZZ_LATENCY=1 -DCFG_TUSB_TRACE=1 -DCFG_TUSB_TRACE_COUNT=4096
+endif
+
 #-------------- Source files and compiler flags --------------
 INC += $(TOP)/test
 
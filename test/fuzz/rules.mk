@@ -22,6 +22,8 @@ endif
 SRC_C += \
 	src/tusb.c \
 	src/common/tusb_fifo.c \
+	src/common/tusb_mempool.c \
+	src/common/tusb_rfifo.c \
 	src/device/usbd.c \
 	src/device/usbd_control.c \
 	src/class/audio/audio_device.c \
@@ -42,6 +44,7 @@ SRC_C += \
 SRC_CXX += \
 	test/fuzz/dcd_fuzz.cc \
 	test/fuzz/fuzz.cc \
+	test/fuzz/latency_fuzz.cc \
 	test/fuzz/msc_fuzz.cc \
 	test/fuzz/net_fuzz.cc \
 	test/fuzz/usbd_fuzz.cc
@@ -0,0 +1,580 @@
+#!/usr/bin/env python3
+#
+# The MIT License (MIT)
+#
+# Copyright (c) 2024 Ha Thach (tinyusb.org)
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+# Host side of examples/device/benchmark: measure CDC, Vendor and MSC throughput, echo latency and
+# device cpu load. Result is printed as JSON, can be used standalone or imported by hil_test.py
+#   $ benchmark.py <usb serial number> [-d seconds] [-o result.json]
+# Also used by hil_test.py for other examples: NCM throughput (net_lwip_webserver, iperf), HID round-trip
+# latency (hid_generic_inout), audio feedback stability (uac2_speaker_fb) and the benchmark history.
+# Require: pyserial, pyusb and read/write permission to device (see udev rules in hil_test.py),
+# iperf (version 2) for NCM and alsa-utils (aplay) for audio
+
+import argparse
+import fcntl
+import glob
+import json
+import mmap
+import os
+import select
+import statistics
+import struct
+import subprocess
+import sys
+import time
+import serial
+import usb.core
+import usb.util
+
+USB_VID = 0xCafe
+VENDOR_STR = 'TinyUSB'
+PRODUCT_STR = 'TinyUSB Benchmark'
+ITF_NUM_VENDOR = 2
+ENUM_TIMEOUT = 30
+
+# Keep in sync with examples/device/benchmark/src/benchmark.h
+REQ_SET_MODE = 0x01
+REQ_GET_STATS = 0x02
+
+MODE_ECHO = 0
+MODE_SINK = 1
+MODE_SOURCE = 2
+
+TARGET_CDC = 0
+TARGET_VENDOR = 1
+
+STATS_FMT = '<8I'
+STATS_FIELDS = ['time_ms', 'loop_count', 'cdc_rx', 'cdc_tx', 'vendor_rx', 'vendor_tx', 'msc_rx', 'msc_tx']
+
+DISK_FS_BLOCKS = 16  # blocks covered by FAT12 filesystem, never written
+LATENCY_COUNT = 200
+
+
+class Device:
+    def __init__(self, uid):
+        self.uid = uid
+        self.dev = None
+        timeout = ENUM_TIMEOUT
+        while timeout > 0 and self.dev is None:
+            self.dev = usb.core.find(idVendor=USB_VID, custom_match=lambda d: self._match(d))
+            if self.dev is None:
+                time.sleep(0.5)
+                timeout -= 0.5
+        assert self.dev is not None, f'Benchmark device {uid} not found'
+
+        itf = self.dev.get_active_configuration()[(ITF_NUM_VENDOR, 0)]
+        self.ep_out = usb.util.find_descriptor(itf, custom_match=lambda e: usb.util.endpoint_direction(
+            e.bEndpointAddress) == usb.util.ENDPOINT_OUT)
+        self.ep_in = usb.util.find_descriptor(itf, custom_match=lambda e: usb.util.endpoint_direction(
+            e.bEndpointAddress) == usb.util.ENDPOINT_IN)
+        self.speed = 'high' if self.ep_in.wMaxPacketSize == 512 else 'full'
+
+    def _match(self, d):
+        try:
+            return d.serial_number == self.uid
+        except (ValueError, usb.core.USBError):
+            return False
+
+    def set_mode(self, target, mode):
+        req_type = usb.util.build_request_type(usb.util.CTRL_OUT, usb.util.CTRL_TYPE_VENDOR, usb.util.CTRL_RECIPIENT_DEVICE)
+        self.dev.ctrl_transfer(req_type, REQ_SET_MODE, mode, target, None)
+
+    def get_stats(self):
+        req_type = usb.util.build_request_type(usb.util.CTRL_IN, usb.util.CTRL_TYPE_VENDOR, usb.util.CTRL_RECIPIENT_DEVICE)
+        data = self.dev.ctrl_transfer(req_type, REQ_GET_STATS, 0, 0, struct.calcsize(STATS_FMT))
+        return dict(zip(STATS_FIELDS, struct.unpack(STATS_FMT, bytes(data))))
+
+    def close(self):
+        usb.util.dispose_resources(self.dev)
+
+
+def stats_delta(s0, s1):
+    return {k: (s1[k] - s0[k]) & 0xFFFFFFFF for k in STATS_FIELDS}
+
+
+def loop_rate(delta):
+    return delta['loop_count'] * 1000 / delta['time_ms'] if delta['time_ms'] else 0
+
+
+def measure(dev, idle_rate, func):
+    """run func() which returns transferred bytes, return throughput and device cpu load"""
+    s0 = dev.get_stats()
+    t0 = time.monotonic()
+    nbytes = func()
+    elapsed = time.monotonic() - t0
+    delta = stats_delta(s0, dev.get_stats())
+
+    load = 1 - loop_rate(delta) / idle_rate if idle_rate else 0
+    return {
+        'kBps': round(nbytes / elapsed / 1000, 1),
+        'cpu_load': round(min(max(load, 0), 1), 3),
+    }
+
+
+def percentile(samples, p):
+    samples = sorted(samples)
+    return samples[min(len(samples) - 1, int(len(samples) * p / 100))]
+
+
+def latency_summary(samples_us):
+    return {
+        'p50_us': round(percentile(samples_us, 50), 1),
+        'p90_us': round(percentile(samples_us, 90), 1),
+        'p99_us': round(percentile(samples_us, 99), 1),
+        'max_us': round(max(samples_us), 1),
+    }
+
+
+# -------------------------------------------------------------
+# CDC
+# -------------------------------------------------------------
+def get_serial_port(uid):
+    return f'/dev/serial/by-id/usb-{VENDOR_STR}_{PRODUCT_STR.replace(" ", "_")}_{uid}-if00'
+
+
+def bench_cdc(dev, idle_rate, duration):
+    port = get_serial_port(dev.uid)
+    timeout = ENUM_TIMEOUT
+    while not os.path.exists(port) and timeout > 0:
+        time.sleep(0.5)
+        timeout -= 0.5
+    # slight delay since kernel may occupy the port briefly
+    time.sleep(0.5)
+    ser = serial.Serial(port, baudrate=115200, timeout=1)
+    chunk = 16 * 1024
+    result = {}
+
+    def run_out():
+        data = bytes(chunk)
+        total = 0
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            total += ser.write(data)
+        ser.flush()
+        return total
+
+    def run_in():
+        total = 0
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            total += len(ser.read(chunk))
+        return total
+
+    try:
+        dev.set_mode(TARGET_CDC, MODE_SINK)
+        result['out'] = measure(dev, idle_rate, run_out)
+
+        ser.reset_input_buffer()
+        dev.set_mode(TARGET_CDC, MODE_SOURCE)
+        result['in'] = measure(dev, idle_rate, run_in)
+
+        # drain data still buffered by device
+        dev.set_mode(TARGET_CDC, MODE_ECHO)
+        time.sleep(0.1)
+        while ser.read(chunk):
+            pass
+
+        samples = []
+        payload = b'tinyusb!'
+        for _ in range(LATENCY_COUNT):
+            t0 = time.perf_counter()
+            ser.write(payload)
+            rd = ser.read(len(payload))
+            samples.append((time.perf_counter() - t0) * 1e6)
+            assert rd == payload, f'CDC wrong echo: expected {payload} was {rd}'
+        result['latency'] = latency_summary(samples)
+    finally:
+        ser.close()
+
+    return result
+
+
+# -------------------------------------------------------------
+# Vendor
+# -------------------------------------------------------------
+def bench_vendor(dev, idle_rate, duration):
+    chunk = 16 * 1024
+    result = {}
+
+    def run_out():
+        data = bytes(chunk)
+        total = 0
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            total += dev.ep_out.write(data, timeout=1000)
+        return total
+
+    def run_in():
+        total = 0
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            total += len(dev.ep_in.read(chunk, timeout=1000))
+        return total
+
+    def drain():
+        try:
+            while dev.ep_in.read(chunk, timeout=100):
+                pass
+        except usb.core.USBTimeoutError:
+            pass
+
+    dev.set_mode(TARGET_VENDOR, MODE_SINK)
+    result['out'] = measure(dev, idle_rate, run_out)
+
+    dev.set_mode(TARGET_VENDOR, MODE_SOURCE)
+    result['in'] = measure(dev, idle_rate, run_in)
+
+    dev.set_mode(TARGET_VENDOR, MODE_ECHO)
+    drain()
+
+    samples = []
+    payload = b'tinyusb!'
+    for _ in range(LATENCY_COUNT):
+        t0 = time.perf_counter()
+        dev.ep_out.write(payload, timeout=1000)
+        rd = bytes(dev.ep_in.read(dev.ep_in.wMaxPacketSize, timeout=1000))
+        samples.append((time.perf_counter() - t0) * 1e6)
+        assert rd == payload, f'Vendor wrong echo: expected {payload} was {rd}'
+    result['latency'] = latency_summary(samples)
+
+    return result
+
+
+# -------------------------------------------------------------
+# MSC
+# -------------------------------------------------------------
+def get_disk_dev(uid):
+    return f'/dev/disk/by-id/usb-{VENDOR_STR}_Mass_Storage_{uid}-0:0'
+
+
+def bench_msc(dev, idle_rate, duration):
+    disk = get_disk_dev(dev.uid)
+    timeout = ENUM_TIMEOUT
+    while not os.path.exists(disk) and timeout > 0:
+        time.sleep(0.5)
+        timeout -= 0.5
+    assert os.path.exists(disk), f'Storage {disk} not existed'
+
+    chunk = 64 * 1024
+    # O_DIRECT bypasses page cache and requires aligned buffer, mmap is page aligned
+    buf = mmap.mmap(-1, chunk)
+    result = {}
+
+    # logical block size of the disk (BENCH_MSC_BLOCK_SIZE of firmware) for comparing 512 vs 4096 blocks
+    with open(f'/sys/class/block/{os.path.basename(os.path.realpath(disk))}/queue/logical_block_size') as f:
+        block_size = int(f.read())
+    result['block_size'] = block_size
+
+    def run(fd, io):
+        disk_size = os.lseek(fd, 0, os.SEEK_END)
+        start = DISK_FS_BLOCKS * block_size
+        offset = start
+        total = 0
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            if offset + chunk > disk_size:
+                offset = start
+            total += io(fd, [buf], offset)
+            offset += chunk
+        return total
+
+    fd = os.open(disk, os.O_RDONLY | os.O_DIRECT)
+    try:
+        result['in'] = measure(dev, idle_rate, lambda: run(fd, os.preadv))
+    finally:
+        os.close(fd)
+
+    # write can be refused e.g kernel does not allow writing to a mounted block device
+    try:
+        fd = os.open(disk, os.O_WRONLY | os.O_DIRECT)
+        try:
+            result['out'] = measure(dev, idle_rate, lambda: run(fd, os.pwritev))
+        finally:
+            os.close(fd)
+    except OSError as e:
+        result['out'] = {'error': str(e)}
+
+    buf.close()
+    return result
+
+
+# -------------------------------------------------------------
+# HID: report echo of examples/device/hid_generic_inout
+# -------------------------------------------------------------
+HID_REPORT_SIZE = 64
+
+
+def get_hidraw_dev(uid, timeout=ENUM_TIMEOUT):
+    """hidraw node of the (first) HID interface of device with serial number uid"""
+    while timeout > 0:
+        for path in sorted(glob.glob('/sys/class/hidraw/hidraw*')):
+            # hidrawN/device is the hid device, its parent the usb interface then the usb device
+            try:
+                with open(os.path.realpath(f'{path}/device/../../serial')) as f:
+                    if f.read().strip() == uid:
+                        return f'/dev/{os.path.basename(path)}'
+            except OSError:
+                pass
+        time.sleep(0.5)
+        timeout -= 0.5
+    assert False, f'HID device {uid} not found'
+
+
+def hidraw_read(fd, size, timeout=1.0):
+    r, _, _ = select.select([fd], [], [], timeout)
+    assert r, 'HID read timeout'
+    return os.read(fd, size)
+
+
+def bench_hid(uid, count=LATENCY_COUNT):
+    """round trip of a 64 byte output report echoed back as input report, bounded by bInterval"""
+    fd = os.open(get_hidraw_dev(uid), os.O_RDWR)
+    samples = []
+    try:
+        for i in range(count):
+            payload = bytes([(i + n) & 0xff for n in range(HID_REPORT_SIZE)])
+            t0 = time.perf_counter()
+            # first byte is report ID, 0 since hid_generic_inout does not use report ID
+            os.write(fd, b'\x00' + payload)
+            rd = hidraw_read(fd, HID_REPORT_SIZE)
+            samples.append((time.perf_counter() - t0) * 1e6)
+            assert rd == payload, f'HID wrong echo: expected {payload} was {rd}'
+    finally:
+        os.close(fd)
+
+    return {'latency': latency_summary(samples)}
+
+
+# -------------------------------------------------------------
+# NCM: iperf against lwiperf of examples/device/net_lwip_webserver
+# Device runs a DHCP server for host interface. Note: all devices use the same address, only one network device
+# should be attached to a HIL runner
+# -------------------------------------------------------------
+NET_DEVICE_IP = '192.168.7.1'
+
+
+def bench_ncm(duration):
+    timeout = ENUM_TIMEOUT
+    while timeout > 0:
+        if subprocess.run(['ping', '-c', '1', '-W', '1', NET_DEVICE_IP], stdout=subprocess.DEVNULL,
+                          stderr=subprocess.DEVNULL).returncode == 0:
+            break
+        time.sleep(0.5)
+        timeout -= 1.5
+    assert timeout > 0, f'Network device {NET_DEVICE_IP} not reachable'
+
+    # -r: tradeoff test, device connects back after host -> device test. CSV line per direction:
+    # timestamp,src_ip,src_port,dst_ip,dst_port,id,interval,bytes,bits_per_second
+    cmd = ['iperf', '-c', NET_DEVICE_IP, '-t', str(duration), '-l', '8192', '-r', '-y', 'C']
+    r = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, timeout=4 * duration + 30)
+    output = r.stdout.decode('utf-8')
+    assert r.returncode == 0, f'iperf failed: {output}'
+
+    result = {}
+    for line in output.splitlines():
+        fields = line.split(',')
+        if len(fields) < 9:
+            continue
+        direction = 'in' if fields[1] == NET_DEVICE_IP else 'out'
+        result[direction] = {'kBps': round(int(fields[8]) / 8 / 1000, 1)}
+    assert 'in' in result and 'out' in result, f'iperf has no result: {output}'
+    return result
+
+
+# -------------------------------------------------------------
+# Audio: feedback stability of examples/device/uac2_speaker_fb (CFG_AUDIO_DEBUG)
+# While host plays at nominal rate, feedback endpoint keeps device fifo level near half full. Fifo level is
+# read from debug HID reports (audio_debug_info_t, sent every 1ms)
+# -------------------------------------------------------------
+AUDIO_DEBUG_FMT = '<IB3b3hHHH'
+AUDIO_DEBUG_FIELDS = ['sample_rate', 'alt_settings', 'mute0', 'mute1', 'mute2', 'vol0', 'vol1', 'vol2', 'fifo_size',
+                      'fifo_count', 'fifo_count_avg']
+AUDIO_SETTLE_TIME = 1.0
+
+
+def get_alsa_card(uid, timeout=ENUM_TIMEOUT):
+    while timeout > 0:
+        for path in glob.glob('/sys/class/sound/card*'):
+            try:
+                with open(os.path.realpath(f'{path}/device/../serial')) as f:
+                    if f.read().strip() == uid:
+                        return int(path[len('/sys/class/sound/card'):])
+            except OSError:
+                pass
+        time.sleep(0.5)
+        timeout -= 0.5
+    assert False, f'Audio device {uid} not found'
+
+
+def bench_audio(uid, duration, sample_rate=48000):
+    card = get_alsa_card(uid)
+    fd = os.open(get_hidraw_dev(uid), os.O_RDONLY)
+    size = struct.calcsize(AUDIO_DEBUG_FMT)
+    play_time = int(AUDIO_SETTLE_TIME + duration + 1)
+    aplay = subprocess.Popen(['aplay', '-q', '-D', f'plughw:{card},0', '-t', 'raw', '-f', 'S16_LE', '-c', '2',
+                              '-r', str(sample_rate), '-d', str(play_time), '/dev/zero'],
+                             stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    reports = []
+    try:
+        # skip reports until streaming is started and fifo level settled
+        end = time.monotonic() + AUDIO_SETTLE_TIME
+        while time.monotonic() < end:
+            hidraw_read(fd, HID_REPORT_SIZE)
+
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            rd = hidraw_read(fd, HID_REPORT_SIZE)
+            reports.append(dict(zip(AUDIO_DEBUG_FIELDS, struct.unpack_from(AUDIO_DEBUG_FMT, rd[:size]))))
+    finally:
+        os.close(fd)
+        aplay.wait(timeout=play_time + 5)
+
+    assert aplay.returncode == 0, f'aplay failed: {aplay.stderr.read().decode("utf-8")}'
+    assert reports, 'No audio debug report'
+    assert reports[-1]['alt_settings'] != 0, 'Audio streaming is not active'
+
+    fifo_size = reports[-1]['fifo_size']
+    count = [r['fifo_count'] * 100 / fifo_size for r in reports]
+    avg = [r['fifo_count_avg'] * 100 / fifo_size for r in reports]
+    quarter = max(len(avg) // 4, 1)
+    return {
+        'sample_rate': reports[-1]['sample_rate'],
+        'fifo_size': fifo_size,
+        'fifo_avg_pct': round(statistics.mean(avg), 1),
+        'fifo_avg_stdev_pct': round(statistics.pstdev(avg), 2),
+        # change of average level over the run, should be close to 0 when feedback is correct
+        'fifo_drift_pct': round(statistics.mean(avg[-quarter:]) - statistics.mean(avg[:quarter]), 2),
+        'fifo_min_pct': round(min(count), 1),
+        'fifo_max_pct': round(max(count), 1),
+        # fifo empty (underrun) or full (overrun) while streaming
+        'xrun': sum(1 for r in reports if r['fifo_count'] == 0 or r['fifo_count'] == fifo_size),
+    }
+
+
+# -------------------------------------------------------------
+# History: results per board, firmware flags and commit, to spot performance regressions
+# -------------------------------------------------------------
+# change larger than this (relative) is reported as regression
+HISTORY_TOLERANCE = 0.1
+
+
+def history_regressions(prev, flat):
+    """compare flattened result with previous one: throughput (kBps) should not drop, latency (_us) not rise"""
+    regressions = []
+    for key, value in flat.items():
+        old = prev.get(key)
+        if not isinstance(value, (int, float)) or not isinstance(old, (int, float)) or not old:
+            continue
+        change = (value - old) / old
+        if (key.endswith('kBps') and change < -HISTORY_TOLERANCE) or \
+                (key.endswith('_us') and change > HISTORY_TOLERANCE):
+            regressions.append(f'{key} {old} -> {value} ({change * 100:+.1f}%)')
+    return regressions
+
+
+def history_append(path, entry):
+    """
+    Append entry {board, flags, test, commit, date, result} to JSON history file (list of entries), safe to be
+    called by multiple processes. Return regressions against the latest entry of same board/flags/test from another commit
+    """
+    with open(path, 'a+') as f:
+        fcntl.flock(f, fcntl.LOCK_EX)
+        f.seek(0)
+        text = f.read()
+        history = json.loads(text) if text.strip() else []
+
+        regressions = []
+        for prev in reversed(history):
+            # compare with the latest run of an other commit
+            if all(prev.get(k) == entry.get(k) for k in ('board', 'flags', 'test')) and \
+                    prev.get('commit') != entry.get('commit'):
+                regressions = [f'{r} vs {prev.get("commit")}' for r in
+                               history_regressions(prev['result'], entry['result'])]
+                break
+
+        history.append(entry)
+        f.seek(0)
+        f.truncate()
+        json.dump(history, f, indent=1)
+        f.write('\n')
+    return regressions
+
+
+# -------------------------------------------------------------
+# Main
+# -------------------------------------------------------------
+def run(uid, duration=2.0):
+    """Run all benchmarks on device with serial number uid, return result as dict"""
+    dev = Device(uid)
+    try:
+        # idle loop rate as reference for cpu load: bulk interfaces accept but do nothing
+        dev.set_mode(TARGET_CDC, MODE_SINK)
+        dev.set_mode(TARGET_VENDOR, MODE_SINK)
+        s0 = dev.get_stats()
+        time.sleep(1)
+        idle_rate = loop_rate(stats_delta(s0, dev.get_stats()))
+
+        result = {
+            'uid': uid,
+            'speed': dev.speed,
+            'idle_loop_rate': round(idle_rate),
+            'duration': duration,
+        }
+        result['vendor'] = bench_vendor(dev, idle_rate, duration)
+        result['cdc'] = bench_cdc(dev, idle_rate, duration)
+        result['msc'] = bench_msc(dev, idle_rate, duration)
+    finally:
+        dev.close()
+
+    return result
+
+
+def flatten(result, prefix=''):
+    """flatten nested result e.g {'cdc': {'in': {'kBps': 1}}} to {'cdc.in.kBps': 1}"""
+    flat = {}
+    for k, v in result.items():
+        if isinstance(v, dict):
+            flat.update(flatten(v, f'{prefix}{k}.'))
+        else:
+            flat[f'{prefix}{k}'] = v
+    return flat
+
+
+def main():
+    parser = argparse.ArgumentParser(description='TinyUSB device throughput benchmark')
+    parser.add_argument('uid', help='USB serial number of benchmark device')
+    parser.add_argument('-d', '--duration', type=float, default=2.0, help='seconds per measurement')
+    parser.add_argument('-o', '--output', help='write JSON result to file')
+    args = parser.parse_args()
+
+    result = run(args.uid, args.duration)
+    text = json.dumps(result, indent=2)
+    print(text)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text + '\n')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -39,12 +39,15 @@ from multiprocessing import Pool
 import fs
 
 ENUM_TIMEOUT = 30
+BENCHMARK_DURATION = 2
+MSC_BENCH_TIMEOUT = 120
 
 STATUS_OK = "\033[32mOK\033[0m"
 STATUS_FAILED = "\033[31mFailed\033[0m"
 STATUS_SKIPPED = "\033[33mSkipped\033[0m"
 
 verbose = False
+history_file = None
 
 WCH_RISCV_CONTENT = """
 adapter driver wlinke
@@ -357,6 +360,36 @@ def test_host_device_info(board):
     return 0
 
 
+def test_host_msc_bench(board):
+    # parse output of examples/host/msc_bench, one case per line:
+    #   msc_bench test=seq_read size=4096 qd=1 bytes=1093632 ms=1000 kBps=1093 iops=267
+    flasher = board['flasher']
+    port = get_serial_dev(flasher["uid"], None, None, 0)
+    ser = open_serial_dev(port)
+
+    ret = globals()[f'reset_{flasher["name"].lower()}'](board)
+    assert ret.returncode == 0, 'Failed to reset device'
+
+    result = {}
+    errors = None
+    timeout = time.time() + MSC_BENCH_TIMEOUT
+    while errors is None and time.time() < timeout:
+        line = ser.readline().decode('utf-8', errors='ignore').strip()
+        if not line.startswith('msc_bench '):
+            continue
+        fields = dict(f.split('=', 1) for f in line.split()[1:] if '=' in f)
+        if 'test' in fields:
+            case = result.setdefault(fields['test'], {}).setdefault(fields['size'], {})
+            case[f'qd{fields["qd"]}'] = {'kBps': int(fields['kBps']), 'iops': int(fields['iops'])}
+        elif line.startswith('msc_bench end'):
+            errors = int(fields['errors'])
+    ser.close()
+
+    assert errors is not None, 'Benchmark did not complete, is a drive attached?'
+    assert errors == 0, f'Benchmark has {errors} failed command(s)'
+    record_benchmark(board, 'msc_host', {'msc_host': result})
+
+
 # -------------------------------------------------------------
 # Tests: device
 # -------------------------------------------------------------
@@ -487,6 +520,74 @@ def test_device_hid_boot_interface(board):
     assert timeout, 'HID device not available'
 
 
+def import_benchmark():
+    # import here so that pyusb is only required for boards running benchmark
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    import benchmark
+    return benchmark
+
+
+def get_commit():
+    r = subprocess.run(['git', '-C', TINYUSB_ROOT, 'rev-parse', '--short', 'HEAD'], stdout=subprocess.PIPE,
+                       stderr=subprocess.DEVNULL)
+    return r.stdout.decode('utf-8').strip() if r.returncode == 0 else 'unknown'
+
+
+def record_benchmark(board, test, result):
+    benchmark = import_benchmark()
+    name = board['name']
+    fname = f'benchmark_{name}.json' if test == 'benchmark' else f'benchmark_{name}_{test}.json'
+    with open(fname, 'w') as f:
+        json.dump(dict(result, board=name), f, indent=2)
+
+    flat = benchmark.flatten(result)
+    if history_file:
+        entry = {
+            'board': name,
+            'flags': board.get('build_flags', ''),
+            'test': test,
+            'commit': get_commit(),
+            'date': time.strftime('%Y-%m-%dT%H:%M:%S'),
+            'result': flat,
+        }
+        for r in benchmark.history_append(history_file, entry):
+            print(f'\n  Benchmark regression: {r}', end='')
+
+    # optional limits e.g "benchmark": { "cdc.in.kBps": 800, "hid.latency.p99_us": [null, 2500] }
+    # number is the minimum, [min, max] with null for no limit. Only checked for groups measured by this test
+    limits = board['tests']['benchmark']
+    if isinstance(limits, dict):
+        for key, limit in limits.items():
+            if key.split('.')[0] not in result:
+                continue
+            assert key in flat, f'Benchmark has no result for {key}'
+            min_value, max_value = limit if isinstance(limit, list) else (limit, None)
+            if min_value is not None:
+                assert flat[key] >= min_value, f'Benchmark {key} = {flat[key]} is less than {min_value}'
+            if max_value is not None:
+                assert flat[key] <= max_value, f'Benchmark {key} = {flat[key]} is more than {max_value}'
+
+
+def test_device_benchmark(board):
+    benchmark = import_benchmark()
+    record_benchmark(board, 'benchmark', benchmark.run(board['uid']))
+
+
+def test_device_net_lwip_webserver(board):
+    benchmark = import_benchmark()
+    record_benchmark(board, 'ncm', {'ncm': benchmark.bench_ncm(BENCHMARK_DURATION)})
+
+
+def test_device_hid_generic_inout(board):
+    benchmark = import_benchmark()
+    record_benchmark(board, 'hid', {'hid': benchmark.bench_hid(board['uid'])})
+
+
+def test_device_uac2_speaker_fb(board):
+    benchmark = import_benchmark()
+    record_benchmark(board, 'audio', {'audio': benchmark.bench_audio(board['uid'], BENCHMARK_DURATION * 5)})
+
+
 def test_device_hid_composite_freertos(id):
     # TODO implement later
     pass
@@ -514,6 +615,19 @@ host_test = [
     'host/device_info',
 ]
 
+# benchmark is opt-in per board since it takes a while and requires pyusb, iperf and aplay
+benchmark_test = [
+    'device/benchmark',
+    'device/hid_generic_inout',
+    'device/net_lwip_webserver',
+    'device/uac2_speaker_fb',
+]
+
+# host benchmark requires a mass storage drive attached to host port, opt-in with both 'host' and 'benchmark'
+host_benchmark_test = [
+    'host/msc_bench',
+]
+
 
 def test_board(board):
     name = board['name']
@@ -530,6 +644,10 @@ def test_board(board):
             test_list += dual_tests
         if 'host' in board_tests and board_tests['host'] == True:
             test_list += host_test
+        if 'benchmark' in board_tests and board_tests['benchmark']:
+            test_list += benchmark_test
+            if board_tests.get('host') == True:
+                test_list += host_benchmark_test
         if 'only' in board_tests:
             test_list = board_tests['only']
         if 'skip' in board_tests:
@@ -567,7 +685,7 @@ def test_board(board):
                 ret = globals()[f'flash_{flasher["name"].lower()}'](board, fw_name)
                 if ret.returncode == 0:
                     try:
-                        globals()[f'test_{test.replace("/", "_")}'](board)
+                        globals()[f'test_{test.replace("/", "_")}'](dict(board, build_flags=f1))
                         print('OK')
                         break
                     except Exception as e:
@@ -595,6 +713,7 @@ def main():
     Hardware test on specified boards
     """
     global verbose
+    global history_file
 
     duration = time.time()
 
@@ -602,11 +721,14 @@ def main():
     parser.add_argument('config_file', help='Configuration JSON file')
     parser.add_argument('-b', '--board', action='append', default=[], help='Boards to test, all if not specified')
     parser.add_argument('-v', '--verbose', action='store_true', help='Verbose output')
+    parser.add_argument('--history', help='Append benchmark results per board and commit to this JSON file')
     args = parser.parse_args()
 
     config_file = args.config_file
     boards = args.board
     verbose = args.verbose
+    if args.history:
+        history_file = os.path.abspath(args.history)
 
     # if config file is not found, try to find it in the same directory as this script
     if not os.path.exists(config_file):
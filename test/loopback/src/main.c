@@ -0,0 +1,224 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2026, hathach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+/* Native end-to-end benchmark: tinyusb host enumerates tinyusb CDC device through the in-memory loopback controller
+ * (vusb_loopback.c), then streams a pattern host -> device and device -> host. Data is verified on the receiving side,
+ * wall-clock throughput and cpu time per bulk packet are reported. Exit code is non-zero on any failure so that it can
+ * be run on CI.
+ *
+ * Usage: loopback [total_bytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tusb.h"
+#include "vusb_loopback.h"
+
+#define BENCH_DEFAULT_SIZE   (4u * 1024u * 1024u)
+#define BENCH_PACKET_SIZE    64u
+
+// frames before giving up on enumeration or a stalled stream
+#define BENCH_TIMEOUT_FRAMES 100000u
+
+static volatile bool cdc_mounted = false;
+static uint8_t cdc_idx = 0;
+
+//--------------------------------------------------------------------+
+// Time
+//--------------------------------------------------------------------+
+
+// Bus time: one loop iteration is one frame. Stack timeout and delays are relative to bus activity instead of
+// wall-clock so that results do not depend on host machine load.
+uint32_t tusb_time_millis_api(void) {
+  return vusb_loopback_frame_number();
+}
+
+void tusb_time_delay_ms_api(uint32_t ms) {
+  while (ms--) {
+    vusb_loopback_frame();
+  }
+}
+
+static double wall_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static double cpu_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static void run_once(void) {
+  tud_task();
+  tuh_task();
+  vusb_loopback_frame();
+}
+
+TU_ATTR_ALWAYS_INLINE static inline uint8_t pattern(uint32_t offset) {
+  return (uint8_t) ((offset * 7u) ^ (offset >> 8));
+}
+
+//--------------------------------------------------------------------+
+// Benchmark
+//--------------------------------------------------------------------+
+
+static void report(const char* name, uint32_t total, double wall, double cpu) {
+  uint32_t const packets = (total + BENCH_PACKET_SIZE - 1) / BENCH_PACKET_SIZE;
+  printf("%-14s %10lu bytes  %8.2f MB/s  %8.1f ns cpu/packet\r\n", name, (unsigned long) total,
+         (double) total / wall / 1e6, cpu * 1e9 / (double) packets);
+}
+
+// host writes, device reads
+static bool bench_host_to_device(uint32_t total) {
+  uint8_t buf[512];
+  uint32_t tx_count = 0;
+  uint32_t rx_count = 0;
+  uint32_t idle = 0;
+
+  double const wall_start = wall_sec();
+  double const cpu_start = cpu_sec();
+
+  while (rx_count < total) {
+    if (tx_count < total) {
+      uint32_t count = tu_min32(tu_min32((uint32_t) sizeof(buf), total - tx_count), tuh_cdc_write_available(cdc_idx));
+      for (uint32_t i = 0; i < count; i++) {
+        buf[i] = pattern(tx_count + i);
+      }
+      count = tuh_cdc_write(cdc_idx, buf, count);
+      tx_count += count;
+      tuh_cdc_write_flush(cdc_idx);
+    }
+
+    uint32_t const count = tud_cdc_read(buf, sizeof(buf));
+    for (uint32_t i = 0; i < count; i++) {
+      if (buf[i] != pattern(rx_count + i)) {
+        printf("host -> device: mismatch at offset %lu\r\n", (unsigned long) (rx_count + i));
+        return false;
+      }
+    }
+    rx_count += count;
+    idle = count ? 0 : idle + 1;
+    if (idle > BENCH_TIMEOUT_FRAMES) {
+      printf("host -> device: stalled at %lu bytes\r\n", (unsigned long) rx_count);
+      return false;
+    }
+
+    run_once();
+  }
+
+  report("host -> device", total, wall_sec() - wall_start, cpu_sec() - cpu_start);
+  return true;
+}
+
+// device writes, host reads
+static bool bench_device_to_host(uint32_t total) {
+  uint8_t buf[512];
+  uint32_t tx_count = 0;
+  uint32_t rx_count = 0;
+  uint32_t idle = 0;
+
+  double const wall_start = wall_sec();
+  double const cpu_start = cpu_sec();
+
+  while (rx_count < total) {
+    if (tx_count < total) {
+      uint32_t count = tu_min32(tu_min32((uint32_t) sizeof(buf), total - tx_count), tud_cdc_write_available());
+      for (uint32_t i = 0; i < count; i++) {
+        buf[i] = pattern(tx_count + i);
+      }
+      count = tud_cdc_write(buf, count);
+      tx_count += count;
+      tud_cdc_write_flush();
+    }
+
+    uint32_t const count = tuh_cdc_read(cdc_idx, buf, sizeof(buf));
+    for (uint32_t i = 0; i < count; i++) {
+      if (buf[i] != pattern(rx_count + i)) {
+        printf("device -> host: mismatch at offset %lu\r\n", (unsigned long) (rx_count + i));
+        return false;
+      }
+    }
+    rx_count += count;
+    idle = count ? 0 : idle + 1;
+    if (idle > BENCH_TIMEOUT_FRAMES) {
+      printf("device -> host: stalled at %lu bytes\r\n", (unsigned long) rx_count);
+      return false;
+    }
+
+    run_once();
+  }
+
+  report("device -> host", total, wall_sec() - wall_start, cpu_sec() - cpu_start);
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  uint32_t const total = (argc > 1) ? (uint32_t) strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_SIZE;
+
+  tusb_rhport_init_t const dev_init = {
+    .role = TUSB_ROLE_DEVICE,
+    .speed = TUSB_SPEED_FULL
+  };
+  tusb_rhport_init_t const host_init = {
+    .role = TUSB_ROLE_HOST,
+    .speed = TUSB_SPEED_FULL
+  };
+
+  if (!tusb_init(BOARD_TUD_RHPORT, &dev_init) || !tusb_init(BOARD_TUH_RHPORT, &host_init)) {
+    printf("init failed\r\n");
+    return 1;
+  }
+
+  for (uint32_t frame = 0; !cdc_mounted; frame++) {
+    if (frame > BENCH_TIMEOUT_FRAMES) {
+      printf("enumeration timed out\r\n");
+      return 1;
+    }
+    run_once();
+  }
+
+  bool const ok = bench_host_to_device(total) && bench_device_to_host(total);
+  return ok ? 0 : 1;
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB Callbacks
+//--------------------------------------------------------------------+
+
+void tuh_cdc_mount_cb(uint8_t idx) {
+  cdc_idx = idx;
+  cdc_mounted = true;
+}
+
+void tuh_cdc_umount_cb(uint8_t idx) {
+  (void) idx;
+  cdc_mounted = false;
+}
@@ -0,0 +1,103 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2026, hathach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_CONFIG_H_
+#define _TUSB_CONFIG_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------
+// Common Configuration
+//--------------------------------------------------------------------
+
+// Device on rhport 0 and host on rhport 1, both served by vusb_loopback.c
+#define BOARD_TUD_RHPORT      0
+#define BOARD_TUH_RHPORT      1
+
+#ifndef CFG_TUSB_MCU
+#define CFG_TUSB_MCU          OPT_MCU_NONE
+#endif
+
+#define CFG_TUSB_OS           OPT_OS_NONE
+
+// loopback controller has no hardware limit, use all endpoint numbers
+#define TUP_DCD_ENDPOINT_MAX  16
+
+#ifndef CFG_TUSB_DEBUG
+#define CFG_TUSB_DEBUG        0
+#endif
+
+#define CFG_TUSB_MEM_SECTION
+#define CFG_TUSB_MEM_ALIGN    __attribute__ ((aligned(4)))
+
+//--------------------------------------------------------------------
+// Device Configuration
+//--------------------------------------------------------------------
+
+#define CFG_TUD_ENABLED       1
+#define CFG_TUD_MAX_SPEED     OPT_MODE_FULL_SPEED
+
+#define CFG_TUD_ENDPOINT0_SIZE    64
+
+#define CFG_TUD_CDC               1
+
+#ifndef CFG_TUD_CDC_RX_BUFSIZE
+#define CFG_TUD_CDC_RX_BUFSIZE    1024
+#endif
+
+#ifndef CFG_TUD_CDC_TX_BUFSIZE
+#define CFG_TUD_CDC_TX_BUFSIZE    1024
+#endif
+
+#define CFG_TUD_CDC_EP_BUFSIZE    64
+
+//--------------------------------------------------------------------
+// Host Configuration
+//--------------------------------------------------------------------
+
+#define CFG_TUH_ENABLED       1
+#define CFG_TUH_MAX_SPEED     OPT_MODE_FULL_SPEED
+
+#define CFG_TUH_ENUMERATION_BUFSIZE 256
+
+#define CFG_TUH_DEVICE_MAX    1
+#define CFG_TUH_CDC           1
+
+#ifndef CFG_TUH_CDC_RX_BUFSIZE
+#define CFG_TUH_CDC_RX_BUFSIZE    1024
+#endif
+
+#ifndef CFG_TUH_CDC_TX_BUFSIZE
+#define CFG_TUH_CDC_TX_BUFSIZE    1024
+#endif
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif
@@ -0,0 +1,450 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2026, hathach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if CFG_TUD_ENABLED && CFG_TUH_ENABLED && CFG_TUSB_MCU == OPT_MCU_NONE
+
+#include "device/dcd.h"
+#include "host/hcd.h"
+#include "vusb_loopback.h"
+
+//--------------------------------------------------------------------+
+// MACRO TYPEDEF CONSTANT ENUM DECLARATION
+//--------------------------------------------------------------------+
+
+// Device endpoint: transfer submitted by usbd, packet size is decided by device
+typedef struct {
+  uint8_t* buffer;
+  uint16_t total_len;
+  uint16_t xferred_len;
+  uint16_t packet_size;
+  uint8_t opened  : 1;
+  uint8_t busy    : 1;
+  uint8_t stalled : 1;
+} vusb_dcd_ep_t;
+
+// Host endpoint: transfer submitted by usbh
+typedef struct {
+  uint8_t* buffer;
+  uint16_t total_len;
+  uint16_t xferred_len;
+  uint8_t daddr;
+  uint8_t busy : 1;
+} vusb_hcd_ep_t;
+
+typedef struct {
+  uint32_t frame;
+
+  uint8_t dcd_rhport;
+  uint8_t hcd_rhport;
+  bool dcd_inited;
+  bool hcd_inited;
+  bool connected;     // device pull-up
+  bool host_attached; // connection seen by host port
+  bool sof_enabled;
+
+  uint8_t dev_addr;
+  uint8_t dev_addr_pending; // applied after status stage of SET_ADDRESS, 0 if none
+  bool set_addr_status;
+
+  vusb_dcd_ep_t dcd_ep[16][2];
+  vusb_hcd_ep_t hcd_ep[16][2];
+} vusb_loopback_t;
+
+static vusb_loopback_t _vusb;
+
+//--------------------------------------------------------------------+
+// Bus
+//--------------------------------------------------------------------+
+
+TU_ATTR_ALWAYS_INLINE static inline bool device_addressed(uint8_t daddr) {
+  return _vusb.connected && _vusb.host_attached && daddr == _vusb.dev_addr;
+}
+
+static void dcd_ep_reset_all(void) {
+  tu_memclr(_vusb.dcd_ep, sizeof(_vusb.dcd_ep));
+  for (uint8_t dir = 0; dir < 2; dir++) {
+    _vusb.dcd_ep[0][dir].opened = 1;
+    _vusb.dcd_ep[0][dir].packet_size = CFG_TUD_ENDPOINT0_SIZE;
+  }
+}
+
+// Complete host transfer on a stalled device endpoint
+static void stall_host(uint8_t epnum, uint8_t dir) {
+  vusb_hcd_ep_t* hep = &_vusb.hcd_ep[epnum][dir];
+  if (hep->busy && device_addressed(hep->daddr)) {
+    hep->busy = 0;
+    hcd_event_xfer_complete(hep->daddr, tu_edpt_addr(epnum, dir), hep->xferred_len, XFER_RESULT_STALLED, false);
+  }
+}
+
+// Move packets between host and device transfer of an endpoint while both are pending. Completion events are sent
+// after the endpoint state is updated since stack may submit next transfer right from event handler
+static void bus_run(uint8_t epnum, uint8_t dir) {
+  vusb_dcd_ep_t* dep = &_vusb.dcd_ep[epnum][dir];
+  vusb_hcd_ep_t* hep = &_vusb.hcd_ep[epnum][dir];
+  uint8_t const ep_addr = tu_edpt_addr(epnum, dir);
+
+  while (hep->busy && device_addressed(hep->daddr) && dep->opened) {
+    if (dep->stalled) {
+      stall_host(epnum, dir);
+      return;
+    }
+    if (!dep->busy) {
+      return; // NAK
+    }
+
+    uint16_t const mps = dep->packet_size;
+    uint16_t pkt_len;
+    bool dcd_done;
+    bool hcd_done;
+    bool overflow = false;
+
+    if (dir == TUSB_DIR_IN) {
+      pkt_len = tu_min16(mps, dep->total_len - dep->xferred_len);
+      if (pkt_len > hep->total_len - hep->xferred_len) {
+        overflow = true; // babble
+        pkt_len = hep->total_len - hep->xferred_len;
+      }
+      if (pkt_len) {
+        memcpy(hep->buffer + hep->xferred_len, dep->buffer + dep->xferred_len, pkt_len);
+      }
+      dep->xferred_len += pkt_len;
+      hep->xferred_len += pkt_len;
+      dcd_done = (dep->xferred_len == dep->total_len);
+      hcd_done = overflow || (pkt_len < mps) || (hep->xferred_len == hep->total_len);
+    } else {
+      pkt_len = tu_min16(mps, hep->total_len - hep->xferred_len);
+      if (pkt_len > dep->total_len - dep->xferred_len) {
+        overflow = true;
+        pkt_len = dep->total_len - dep->xferred_len;
+      }
+      if (pkt_len) {
+        memcpy(dep->buffer + dep->xferred_len, hep->buffer + hep->xferred_len, pkt_len);
+      }
+      dep->xferred_len += pkt_len;
+      hep->xferred_len += pkt_len;
+      hcd_done = overflow || (hep->xferred_len == hep->total_len);
+      dcd_done = overflow || (pkt_len < mps) || (dep->xferred_len == dep->total_len);
+    }
+
+    uint8_t const daddr = hep->daddr;
+    uint16_t const dcd_len = dep->xferred_len;
+    uint16_t const hcd_len = hep->xferred_len;
+    if (dcd_done) {
+      dep->busy = 0;
+    }
+    if (hcd_done) {
+      hep->busy = 0;
+    }
+
+    // new address takes effect after status stage of SET_ADDRESS
+    if (dcd_done && epnum == 0 && dir == TUSB_DIR_IN && _vusb.set_addr_status) {
+      _vusb.set_addr_status = false;
+      _vusb.dev_addr = _vusb.dev_addr_pending;
+    }
+
+    if (dcd_done) {
+      dcd_event_xfer_complete(_vusb.dcd_rhport, ep_addr, dcd_len, overflow ? XFER_RESULT_FAILED : XFER_RESULT_SUCCESS, false);
+    }
+    if (hcd_done) {
+      hcd_event_xfer_complete(daddr, ep_addr, hcd_len, overflow ? XFER_RESULT_FAILED : XFER_RESULT_SUCCESS, false);
+    }
+  }
+}
+
+void vusb_loopback_frame(void) {
+  _vusb.frame++;
+
+  if (_vusb.hcd_inited && _vusb.connected != _vusb.host_attached) {
+    _vusb.host_attached = _vusb.connected;
+    if (_vusb.connected) {
+      hcd_event_device_attach(_vusb.hcd_rhport, false);
+    } else {
+      hcd_event_device_remove(_vusb.hcd_rhport, false);
+    }
+  }
+
+  if (_vusb.dcd_inited && _vusb.sof_enabled && _vusb.host_attached) {
+    dcd_event_sof(_vusb.dcd_rhport, _vusb.frame & 0x7ff, false);
+  }
+}
+
+uint32_t vusb_loopback_frame_number(void) {
+  return _vusb.frame;
+}
+
+//--------------------------------------------------------------------+
+// Device API
+//--------------------------------------------------------------------+
+
+bool dcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
+  (void) rh_init;
+  _vusb.dcd_rhport = rhport;
+  _vusb.dcd_inited = true;
+  _vusb.dev_addr = 0;
+  dcd_ep_reset_all();
+  dcd_connect(rhport);
+  return true;
+}
+
+void dcd_int_handler(uint8_t rhport) {
+  (void) rhport;
+}
+
+void dcd_int_enable(uint8_t rhport) {
+  (void) rhport;
+}
+
+void dcd_int_disable(uint8_t rhport) {
+  (void) rhport;
+}
+
+// Receive Set Address request, mcu port must also include status IN response
+void dcd_set_address(uint8_t rhport, uint8_t dev_addr) {
+  _vusb.dev_addr_pending = dev_addr;
+  _vusb.set_addr_status = true;
+  dcd_edpt_xfer(rhport, tu_edpt_addr(0, TUSB_DIR_IN), NULL, 0);
+}
+
+void dcd_remote_wakeup(uint8_t rhport) {
+  (void) rhport;
+}
+
+void dcd_connect(uint8_t rhport) {
+  (void) rhport;
+  _vusb.connected = true;
+}
+
+void dcd_disconnect(uint8_t rhport) {
+  (void) rhport;
+  _vusb.connected = false;
+}
+
+void dcd_sof_enable(uint8_t rhport, bool en) {
+  (void) rhport;
+  _vusb.sof_enabled = en;
+}
+
+//--------------------------------------------------------------------+
+// Device Endpoint API
+//--------------------------------------------------------------------+
+
+bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const* ep_desc) {
+  (void) rhport;
+  uint8_t const epnum = tu_edpt_number(ep_desc->bEndpointAddress);
+  uint8_t const dir = tu_edpt_dir(ep_desc->bEndpointAddress);
+  TU_ASSERT(epnum < 16);
+
+  vusb_dcd_ep_t* dep = &_vusb.dcd_ep[epnum][dir];
+  tu_memclr(dep, sizeof(vusb_dcd_ep_t));
+  dep->packet_size = tu_edpt_packet_size(ep_desc);
+  dep->opened = 1;
+  return true;
+}
+
+void dcd_edpt_close(uint8_t rhport, uint8_t ep_addr) {
+  (void) rhport;
+  tu_memclr(&_vusb.dcd_ep[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)], sizeof(vusb_dcd_ep_t));
+}
+
+void dcd_edpt_close_all(uint8_t rhport) {
+  (void) rhport;
+  for (uint8_t epnum = 1; epnum < 16; epnum++) {
+    tu_memclr(_vusb.dcd_ep[epnum], sizeof(_vusb.dcd_ep[epnum]));
+  }
+}
+
+bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes) {
+  (void) rhport;
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir = tu_edpt_dir(ep_addr);
+
+  vusb_dcd_ep_t* dep = &_vusb.dcd_ep[epnum][dir];
+  TU_ASSERT(dep->opened && !dep->busy);
+  dep->buffer = buffer;
+  dep->total_len = total_bytes;
+  dep->xferred_len = 0;
+  dep->busy = 1;
+
+  bus_run(epnum, dir);
+  return true;
+}
+
+void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr) {
+  (void) rhport;
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir = tu_edpt_dir(ep_addr);
+
+  _vusb.dcd_ep[epnum][dir].stalled = 1;
+  _vusb.dcd_ep[epnum][dir].busy = 0;
+  stall_host(epnum, dir);
+}
+
+void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr) {
+  (void) rhport;
+  _vusb.dcd_ep[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)].stalled = 0;
+}
+
+//--------------------------------------------------------------------+
+// Host Controller API
+//--------------------------------------------------------------------+
+
+bool hcd_init(uint8_t rhport, const tusb_rhport_init_t* rh_init) {
+  (void) rh_init;
+  _vusb.hcd_rhport = rhport;
+  _vusb.hcd_inited = true;
+  _vusb.host_attached = false; // connection is detected on next frame
+  tu_memclr(_vusb.hcd_ep, sizeof(_vusb.hcd_ep));
+  return true;
+}
+
+void hcd_int_handler(uint8_t rhport, bool in_isr) {
+  (void) rhport;
+  (void) in_isr;
+}
+
+void hcd_int_enable(uint8_t rhport) {
+  (void) rhport;
+}
+
+void hcd_int_disable(uint8_t rhport) {
+  (void) rhport;
+}
+
+uint32_t hcd_frame_number(uint8_t rhport) {
+  (void) rhport;
+  return _vusb.frame;
+}
+
+//--------------------------------------------------------------------+
+// Port API
+//--------------------------------------------------------------------+
+
+bool hcd_port_connect_status(uint8_t rhport) {
+  (void) rhport;
+  return _vusb.connected;
+}
+
+void hcd_port_reset(uint8_t rhport) {
+  (void) rhport;
+  tu_memclr(_vusb.hcd_ep, sizeof(_vusb.hcd_ep));
+  if (_vusb.connected && _vusb.dcd_inited) {
+    _vusb.dev_addr = 0;
+    _vusb.set_addr_status = false;
+    dcd_ep_reset_all();
+    dcd_event_bus_reset(_vusb.dcd_rhport, TUSB_SPEED_FULL, false);
+  }
+}
+
+void hcd_port_reset_end(uint8_t rhport) {
+  (void) rhport;
+}
+
+tusb_speed_t hcd_port_speed_get(uint8_t rhport) {
+  (void) rhport;
+  return TUSB_SPEED_FULL;
+}
+
+void hcd_device_close(uint8_t rhport, uint8_t dev_addr) {
+  (void) rhport;
+  for (uint8_t epnum = 0; epnum < 16; epnum++) {
+    for (uint8_t dir = 0; dir < 2; dir++) {
+      if (_vusb.hcd_ep[epnum][dir].daddr == dev_addr) {
+        _vusb.hcd_ep[epnum][dir].busy = 0;
+      }
+    }
+  }
+}
+
+//--------------------------------------------------------------------+
+// Host Endpoint API
+//--------------------------------------------------------------------+
+
+bool hcd_edpt_open(uint8_t rhport, uint8_t daddr, tusb_desc_endpoint_t const* ep_desc) {
+  (void) rhport;
+  (void) daddr;
+  return tu_edpt_number(ep_desc->bEndpointAddress) < 16;
+}
+
+bool hcd_edpt_xfer(uint8_t rhport, uint8_t daddr, uint8_t ep_addr, uint8_t* buffer, uint16_t buflen) {
+  (void) rhport;
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir = tu_edpt_dir(ep_addr);
+
+  vusb_hcd_ep_t* hep = &_vusb.hcd_ep[epnum][dir];
+  TU_ASSERT(!hep->busy);
+  hep->buffer = buffer;
+  hep->total_len = buflen;
+  hep->xferred_len = 0;
+  hep->daddr = daddr;
+  hep->busy = 1;
+
+  // transfer to a device that is not attached or addressed is NAKed forever (host times out)
+  bus_run(epnum, dir);
+  return true;
+}
+
+bool hcd_edpt_abort_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr) {
+  (void) rhport;
+  vusb_hcd_ep_t* hep = &_vusb.hcd_ep[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)];
+  TU_VERIFY(hep->busy && hep->daddr == dev_addr);
+  hep->busy = 0;
+  return true;
+}
+
+bool hcd_setup_send(uint8_t rhport, uint8_t daddr, uint8_t const setup_packet[8]) {
+  (void) rhport;
+
+  // pending control transfer on both sides is replaced by the new one
+  for (uint8_t dir = 0; dir < 2; dir++) {
+    _vusb.hcd_ep[0][dir].busy = 0;
+  }
+
+  if (!device_addressed(daddr)) {
+    return true; // no response, host times out
+  }
+
+  // SETUP is always ACKed and clears EP0 stall
+  for (uint8_t dir = 0; dir < 2; dir++) {
+    _vusb.dcd_ep[0][dir].busy = 0;
+    _vusb.dcd_ep[0][dir].stalled = 0;
+  }
+
+  dcd_event_setup_received(_vusb.dcd_rhport, setup_packet, false);
+  hcd_event_xfer_complete(daddr, 0x00, 8, XFER_RESULT_SUCCESS, false);
+  return true;
+}
+
+bool hcd_edpt_clear_stall(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr) {
+  (void) rhport;
+  (void) dev_addr;
+  (void) ep_addr;
+  return true;
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+
+#include <string.h>
+#include "unity.h"
+#include "bench.h"
+
+#include "tusb_common.h"
+#include "tusb_types.h"
+
+// Cost of walking a configuration descriptor with tu_desc_next() as class drivers do in open()
+// and usbd/usbh do when binding interfaces: composite of interfaces with class-specific descriptors
+// and endpoints, similar to CDC + MSC + HID + Audio devices.
+
+#define ITF_COUNT      8
+#define DESC_MAX       1024
+#define WALK_COUNT     200
+
+static uint8_t desc_cfg[DESC_MAX];
+static uint16_t desc_len;
+static uint32_t ep_found;
+
+static void add_desc(uint8_t len, uint8_t type) {
+  TEST_ASSERT_LESS_OR_EQUAL(DESC_MAX, desc_len + len);
+  memset(desc_cfg + desc_len, 0, len);
+  desc_cfg[desc_len] = len;
+  desc_cfg[desc_len + 1] = type;
+  desc_len = (uint16_t) (desc_len + len);
+}
+
+static void build_config(void) {
+  desc_len = 0;
+  add_desc(sizeof(tusb_desc_configuration_t), TUSB_DESC_CONFIGURATION);
+
+  for (uint8_t i = 0; i < ITF_COUNT; i++) {
+    uint8_t* itf = desc_cfg + desc_len;
+    add_desc(sizeof(tusb_desc_interface_t), TUSB_DESC_INTERFACE);
+    itf[2] = i;    // bInterfaceNumber
+    itf[4] = 2;    // bNumEndpoints
+
+    // class-specific descriptors (e.g CDC functional, Audio units) between interface and endpoints
+    for (uint8_t cs = 0; cs < 4; cs++) {
+      add_desc(5, TUSB_DESC_CS_INTERFACE);
+    }
+
+    add_desc(sizeof(tusb_desc_endpoint_t), TUSB_DESC_ENDPOINT);
+    add_desc(sizeof(tusb_desc_endpoint_t), TUSB_DESC_ENDPOINT);
+  }
+
+  tu_unaligned_write16(desc_cfg + offsetof(tusb_desc_configuration_t, wTotalLength), desc_len);
+}
+
+static void run_walk(void) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < WALK_COUNT; i++) {
+    uint8_t const* p_desc = desc_cfg;
+    uint8_t const* desc_end = desc_cfg + desc_len;
+
+    while (p_desc < desc_end) {
+      if (TUSB_DESC_ENDPOINT == tu_desc_type(p_desc)) {
+        count++;
+      }
+      p_desc = tu_desc_next(p_desc);
+    }
+    __asm__ volatile("" : : "r"(p_desc) : "memory");
+  }
+  ep_found = count;
+}
+
+// find the last interface by number, same as looking up an interface for SET_INTERFACE
+static void run_find_interface(void) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < WALK_COUNT; i++) {
+    uint8_t const* p_desc = desc_cfg;
+    uint8_t const* desc_end = desc_cfg + desc_len;
+
+    while (p_desc < desc_end) {
+      if (TUSB_DESC_INTERFACE == tu_desc_type(p_desc) &&
+          ((tusb_desc_interface_t const*) p_desc)->bInterfaceNumber == ITF_COUNT - 1) {
+        count++;
+        break;
+      }
+      p_desc = tu_desc_next(p_desc);
+    }
+  }
+  ep_found = count;
+}
+
+void setUp(void) {
+  build_config();
+  ep_found = 0;
+}
+
+void tearDown(void) {
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+void test_bench_desc_walk(void) {
+  uint32_t const result = bench_run(run_walk, WALK_COUNT * desc_len);
+  bench_report("descriptor walk (count endpoints)", result);
+  TEST_ASSERT_EQUAL_UINT32(WALK_COUNT * ITF_COUNT * 2, ep_found);
+}
+
+void test_bench_desc_find_interface(void) {
+  uint32_t const result = bench_run(run_find_interface, WALK_COUNT * desc_len);
+  bench_report("descriptor find last interface", result);
+  TEST_ASSERT_EQUAL_UINT32(WALK_COUNT, ep_found);
+}
@@ -0,0 +1,192 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+
+#include <string.h>
+#include "unity.h"
+#include "bench.h"
+
+#include "osal/osal.h"
+#include "tusb_fifo.h"
+
+// Throughput of tu_fifo copy paths, plain memcpy() of the same chunk size is reported as reference.
+// Each run moves BENCH_BYTES through the fifo with write_n() followed by read_n() of CHUNK bytes.
+
+#define BENCH_BYTES   (256 * 1024)
+#define FIFO_BYTES    4096
+#define CHUNK_BYTES   1024
+#define CHUNK_WRAP    (CHUNK_BYTES - 128) // not a divisor of fifo size: every few chunks are split by wrap around
+
+static uint8_t ff_buf[FIFO_BYTES];
+static tu_fifo_t ff;
+
+static uint8_t src_buf[CHUNK_BYTES];
+static uint8_t dst_buf[CHUNK_BYTES];
+
+static uint16_t chunk_items; // items of ff per write_n/read_n
+static bool ref_done;
+
+static void fifo_setup(uint16_t item_size, bool overwritable, uint16_t chunk_bytes) {
+  tu_fifo_config(&ff, ff_buf, FIFO_BYTES / item_size, item_size, overwritable);
+  chunk_items = chunk_bytes / item_size;
+}
+
+static void run_memcpy(void) {
+  for (uint32_t i = 0; i < BENCH_BYTES / CHUNK_BYTES; i++) {
+    memcpy(dst_buf, src_buf, CHUNK_BYTES);
+    __asm__ volatile("" : : "r"(dst_buf) : "memory");
+  }
+}
+
+static void run_write_read(void) {
+  uint32_t const count = BENCH_BYTES / (chunk_items * ff.item_size);
+  for (uint32_t i = 0; i < count; i++) {
+    tu_fifo_write_n(&ff, src_buf, chunk_items);
+    tu_fifo_read_n(&ff, dst_buf, chunk_items);
+  }
+}
+
+// one item per call e.g MIDI event packets, queue of structures
+static void run_write_read_item(void) {
+  uint32_t const count = BENCH_BYTES / (chunk_items * ff.item_size);
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint16_t j = 0; j < chunk_items; j++) {
+      tu_fifo_write(&ff, src_buf + j * ff.item_size);
+    }
+    for (uint16_t j = 0; j < chunk_items; j++) {
+      tu_fifo_read(&ff, dst_buf + j * ff.item_size);
+    }
+  }
+}
+
+// fifo is kept full: each write overwrites oldest data, read gets the most recent chunk
+static void run_overwrite(void) {
+  uint32_t const count = BENCH_BYTES / (chunk_items * ff.item_size);
+  for (uint32_t i = 0; i < count; i++) {
+    tu_fifo_write_n(&ff, src_buf, chunk_items);
+    tu_fifo_write_n(&ff, src_buf, chunk_items);
+    tu_fifo_peek_n(&ff, dst_buf, chunk_items);
+  }
+}
+
+static void bench_run_items(char const* name, bench_func_t func, uint16_t item_size, uint16_t chunk_bytes) {
+  fifo_setup(item_size, false, chunk_bytes);
+  uint32_t const result = bench_run(func, (BENCH_BYTES / chunk_bytes) * chunk_bytes);
+  bench_report(name, result);
+
+  // data must still be intact
+  TEST_ASSERT_EQUAL_MEMORY(src_buf, dst_buf, chunk_items * item_size);
+}
+
+static void bench_write_read(char const* name, uint16_t item_size, uint16_t chunk_bytes) {
+  bench_run_items(name, run_write_read, item_size, chunk_bytes);
+}
+
+void setUp(void) {
+  for (uint32_t i = 0; i < sizeof(src_buf); i++) {
+    src_buf[i] = (uint8_t) i;
+  }
+  memset(dst_buf, 0, sizeof(dst_buf));
+
+  if (!ref_done) {
+    bench_report("memcpy (reference)", bench_run(run_memcpy, BENCH_BYTES));
+    ref_done = true;
+  }
+}
+
+void tearDown(void) {
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+void test_bench_write_read_n_item1(void) {
+  bench_write_read("write_n/read_n item 1", 1, CHUNK_BYTES);
+}
+
+void test_bench_write_read_n_item2(void) {
+  bench_write_read("write_n/read_n item 2", 2, CHUNK_BYTES);
+}
+
+void test_bench_write_read_n_item4(void) {
+  bench_write_read("write_n/read_n item 4", 4, CHUNK_BYTES);
+}
+
+void test_bench_write_read_n_wrap_item1(void) {
+  bench_write_read("write_n/read_n wrap item 1", 1, CHUNK_WRAP);
+}
+
+void test_bench_write_read_n_wrap_item4(void) {
+  bench_write_read("write_n/read_n wrap item 4", 4, CHUNK_WRAP);
+}
+
+void test_bench_write_read_item1(void) {
+  bench_run_items("write/read single item 1", run_write_read_item, 1, CHUNK_BYTES);
+}
+
+void test_bench_write_read_item4(void) {
+  bench_run_items("write/read single item 4", run_write_read_item, 4, CHUNK_BYTES);
+}
+
+void test_bench_write_read_n_small(void) {
+  // per call overhead e.g HID/CDC single packet
+  bench_write_read("write_n/read_n 64 bytes", 1, 64);
+}
+
+void test_bench_overwritable(void) {
+  fifo_setup(1, true, CHUNK_BYTES);
+  uint32_t const result = bench_run(run_overwrite, 2 * BENCH_BYTES);
+  bench_report("write_n overwritable + peek_n", result);
+
+  TEST_ASSERT_TRUE(tu_fifo_full(&ff));
+  TEST_ASSERT_EQUAL_MEMORY(src_buf, dst_buf, CHUNK_BYTES);
+}
+
+#ifdef TUP_MEM_CONST_ADDR
+// emulated hardware FIFO register: full words are pushed/pulled at a constant address
+static volatile uint32_t hw_fifo_reg;
+
+static void run_const_addr(void) {
+  uint32_t const count = BENCH_BYTES / CHUNK_WRAP;
+  for (uint32_t i = 0; i < count; i++) {
+    tu_fifo_write_n_const_addr_full_words(&ff, (void const*) (uintptr_t) &hw_fifo_reg, CHUNK_WRAP);
+    tu_fifo_read_n_const_addr_full_words(&ff, (void*) (uintptr_t) &hw_fifo_reg, CHUNK_WRAP);
+  }
+}
+#endif
+
+void test_bench_const_addr_full_words(void) {
+#ifdef TUP_MEM_CONST_ADDR
+  fifo_setup(1, false, CHUNK_WRAP);
+  hw_fifo_reg = 0x04030201;
+  uint32_t const result = bench_run(run_const_addr, (BENCH_BYTES / CHUNK_WRAP) * CHUNK_WRAP);
+  bench_report("write_n/read_n const addr full words", result);
+
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff));
+#else
+  TEST_IGNORE_MESSAGE("TUP_MEM_CONST_ADDR is not defined");
+#endif
+}
@@ -200,6 +200,7 @@ void setUp(void)
 {
   dcd_int_disable_Ignore();
   dcd_int_enable_Ignore();
+  dcd_init_poll_IgnoreAndReturn(true);
 
   if ( !tud_inited() ) {
     tusb_rhport_init_t dev_init = {
@@ -123,6 +123,7 @@ uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
 void setUp(void) {
   dcd_int_disable_Ignore();
   dcd_int_enable_Ignore();
+  dcd_init_poll_IgnoreAndReturn(true);
 
   if ( !tud_inited() ) {
     tusb_rhport_init_t dev_init = {
@@ -0,0 +1,86 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+// Helper for host-native micro benchmarks in test/benchmark, they are part of test:all and can be run alone with
+//   ceedling test:pattern[bench]
+// Results are printed as ticks per byte: CPU cycles (TSC) on x86, nanoseconds otherwise. Timing depends on host and
+// build flags, so numbers are only reported (compare them between changes), tests assert data integrity only.
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "unity.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_TICK_UNIT "cycles"
+#else
+#define BENCH_TICK_UNIT "ns"
+#endif
+
+// Each measurement is repeated and the best run is reported to filter out scheduling noise
+#ifndef BENCH_REPEAT
+#define BENCH_REPEAT 7
+#endif
+
+static inline uint64_t bench_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+typedef void (*bench_func_t)(void);
+
+// Run func BENCH_REPEAT times, return best ticks per byte (x1000 to keep integer precision)
+static inline uint32_t bench_run(bench_func_t func, uint32_t bytes_per_run) {
+  uint64_t best = UINT64_MAX;
+  func(); // warm up cache
+  for (int i = 0; i < BENCH_REPEAT; i++) {
+    uint64_t const start = bench_ticks();
+    func();
+    uint64_t const ticks = bench_ticks() - start;
+    if (ticks < best) {
+      best = ticks;
+    }
+  }
+  return (uint32_t) ((best * 1000u) / bytes_per_run);
+}
+
+static inline void bench_report(char const* name, uint32_t milli_ticks_per_byte) {
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%-40s %6u.%03u %s/byte", name,
+           (unsigned) (milli_ticks_per_byte / 1000), (unsigned) (milli_ticks_per_byte % 1000), BENCH_TICK_UNIT);
+  TEST_MESSAGE(msg);
+}
+
+#endif
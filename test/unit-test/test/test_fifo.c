@@ -143,6 +143,66 @@ void test_write_n(void)
   TEST_ASSERT_EQUAL(24, tu_fifo_count(ff));
 }
 
+void test_write_read_n_word_copy(void)
+{
+  // word-aligned fifo buffer and app buffers with all alignment combinations, lengths crossing wrap boundary
+  uint32_t ff32_buf[FIFO_SIZE/4];
+  tu_fifo_t ff32 = TU_FIFO_INIT((uint8_t*) ff32_buf, FIFO_SIZE, uint8_t, false);
+
+  uint32_t src32[(FIFO_SIZE+8)/4];
+  uint32_t dst32[(FIFO_SIZE+8)/4];
+
+  for (uint8_t src_ofs = 0; src_ofs < 4; src_ofs++)
+  {
+    for (uint8_t dst_ofs = 0; dst_ofs < 4; dst_ofs++)
+    {
+      uint8_t* src = ((uint8_t*) src32) + src_ofs;
+      uint8_t* dst = ((uint8_t*) dst32) + dst_ofs;
+
+      tu_fifo_clear(&ff32);
+      uint32_t pos = 0;
+
+      for (uint16_t len = 1; len <= FIFO_SIZE; len += 7)
+      {
+        for (uint16_t i = 0; i < len; i++) src[i] = (uint8_t) (pos + i + src_ofs);
+        memset(dst32, 0, sizeof(dst32));
+
+        TEST_ASSERT_EQUAL(len, tu_fifo_write_n(&ff32, src, len));
+        TEST_ASSERT_EQUAL(len, tu_fifo_read_n(&ff32, dst, len));
+        TEST_ASSERT_EQUAL_MEMORY(src, dst, len);
+        TEST_ASSERT_TRUE(tu_fifo_empty(&ff32));
+
+        pos += len;
+      }
+    }
+  }
+}
+
+void test_spsc_dma_style(void)
+{
+  // producer uses write_n(), consumer drains linear regions via get_read_info() + advance_read_pointer()
+  uint32_t rd_pos = 0;
+  uint32_t wr_pos = 0;
+
+  while (rd_pos < sizeof(test_data))
+  {
+    uint16_t const wr_len = (uint16_t) tu_min32(13, sizeof(test_data) - wr_pos);
+    wr_pos += tu_fifo_write_n(ff, test_data + wr_pos, wr_len);
+
+    tu_fifo_get_read_info(ff, &info);
+    TEST_ASSERT_EQUAL(tu_fifo_count(ff), info.len_lin + info.len_wrap);
+
+    // consume linear part only, similar to a DMA transfer
+    uint16_t const rd_len = tu_min16(info.len_lin, 11);
+    TEST_ASSERT_EQUAL_MEMORY(test_data + rd_pos, info.ptr_lin, rd_len);
+    tu_fifo_advance_read_pointer(ff, rd_len);
+    rd_pos += rd_len;
+  }
+
+  TEST_ASSERT_EQUAL(sizeof(test_data), wr_pos);
+  TEST_ASSERT_TRUE(tu_fifo_empty(ff));
+}
+
 void test_write_double_overflowed(void)
 {
   tu_fifo_set_overwritable(ff, true);
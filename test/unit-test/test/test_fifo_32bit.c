@@ -0,0 +1,176 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+// Built with CFG_TUSB_FIFO_32BIT=1 (see project.yml), fifo deeper than 16-bit index space
+
+#include <string.h>
+#include "unity.h"
+
+#include "osal/osal.h"
+#include "tusb_fifo.h"
+
+// not a power of 2, more than 64K items
+#define FIFO_SIZE   0x18000u
+#define EXTRA_SIZE  0x10010u
+
+uint8_t tu_ff_buf[FIFO_SIZE];
+tu_fifo_t tu_ff = TU_FIFO_INIT(tu_ff_buf, FIFO_SIZE, uint8_t, false);
+
+tu_fifo_t* ff = &tu_ff;
+tu_fifo_buffer_info_t info;
+
+uint8_t test_data[FIFO_SIZE + EXTRA_SIZE];
+uint8_t rd_buf[FIFO_SIZE];
+
+void setUp(void)
+{
+  tu_fifo_clear(ff);
+  tu_fifo_set_overwritable(ff, false);
+  memset(&info, 0, sizeof(tu_fifo_buffer_info_t));
+
+  // period of 251 so that an offset of 64K does not read back the same pattern
+  for(uint32_t i=0; i<sizeof(test_data); i++) test_data[i] = (uint8_t) (i % 251);
+  memset(rd_buf, 0, sizeof(rd_buf));
+}
+
+void tearDown(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+void test_config_depth(void)
+{
+  TEST_ASSERT_EQUAL_UINT32(4, sizeof(tu_fifo_size_t));
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE, tu_fifo_depth(ff));
+  TEST_ASSERT_EQUAL_UINT32(0, tu_fifo_count(ff));
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE, tu_fifo_remaining(ff));
+}
+
+void test_write_read_n_large(void)
+{
+  uint32_t const len = 0x12345;
+
+  TEST_ASSERT_EQUAL_UINT32(len, tu_fifo_write_n(ff, test_data, len));
+  TEST_ASSERT_EQUAL_UINT32(len, tu_fifo_count(ff));
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE - len, tu_fifo_remaining(ff));
+
+  TEST_ASSERT_EQUAL_UINT32(len, tu_fifo_read_n(ff, rd_buf, len));
+  TEST_ASSERT_EQUAL_MEMORY(test_data, rd_buf, len);
+  TEST_ASSERT_TRUE(tu_fifo_empty(ff));
+
+  // request more than available, limited to count
+  tu_fifo_write_n(ff, test_data, 0x10001);
+  TEST_ASSERT_EQUAL_UINT32(0x10001, tu_fifo_read_n(ff, rd_buf, FIFO_SIZE));
+  TEST_ASSERT_EQUAL_MEMORY(test_data, rd_buf, 0x10001);
+}
+
+void test_write_n_limited_to_remaining(void)
+{
+  // non-overwritable fifo only accepts up to depth
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE, tu_fifo_write_n(ff, test_data, FIFO_SIZE + EXTRA_SIZE));
+  TEST_ASSERT_TRUE(tu_fifo_full(ff));
+  TEST_ASSERT_EQUAL_UINT32(0, tu_fifo_write_n(ff, test_data, 1));
+
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE, tu_fifo_read_n(ff, rd_buf, FIFO_SIZE));
+  TEST_ASSERT_EQUAL_MEMORY(test_data, rd_buf, FIFO_SIZE);
+}
+
+void test_wrap_around_large(void)
+{
+  // move read/write pointer past 64K, next write wraps around end of buffer
+  tu_fifo_write_n(ff, test_data, 0x10000);
+  tu_fifo_read_n(ff, rd_buf, 0x10000);
+  TEST_ASSERT_TRUE(tu_fifo_empty(ff));
+
+  TEST_ASSERT_EQUAL_UINT32(0x10000, tu_fifo_write_n(ff, test_data, 0x10000));
+  TEST_ASSERT_EQUAL_UINT32(0x10000, tu_fifo_count(ff));
+
+  tu_fifo_get_read_info(ff, &info);
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE - 0x10000, info.len_lin);
+  TEST_ASSERT_EQUAL_UINT32(0x10000 - (FIFO_SIZE - 0x10000), info.len_wrap);
+  TEST_ASSERT_EQUAL_PTR(ff->buffer + 0x10000, info.ptr_lin);
+  TEST_ASSERT_EQUAL_PTR(ff->buffer, info.ptr_wrap);
+
+  TEST_ASSERT_EQUAL_UINT32(0x10000, tu_fifo_read_n(ff, rd_buf, 0x10000));
+  TEST_ASSERT_EQUAL_MEMORY(test_data, rd_buf, 0x10000);
+
+  // indices wrap around 2*depth as well
+  for (uint32_t i = 0; i < 4; i++)
+  {
+    uint32_t const len = FIFO_SIZE - 1 - i;
+    TEST_ASSERT_EQUAL_UINT32(len, tu_fifo_write_n(ff, test_data + i, len));
+    TEST_ASSERT_EQUAL_UINT32(len, tu_fifo_read_n(ff, rd_buf, len));
+    TEST_ASSERT_EQUAL_MEMORY(test_data + i, rd_buf, len);
+  }
+  TEST_ASSERT_TRUE(tu_fifo_empty(ff));
+}
+
+void test_count_remaining_near_full(void)
+{
+  tu_fifo_write_n(ff, test_data, FIFO_SIZE - 1);
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE - 1, tu_fifo_count(ff));
+  TEST_ASSERT_EQUAL_UINT32(1, tu_fifo_remaining(ff));
+  TEST_ASSERT_FALSE(tu_fifo_full(ff));
+
+  TEST_ASSERT_EQUAL_UINT32(1, tu_fifo_write_n(ff, test_data + FIFO_SIZE - 1, 2));
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE, tu_fifo_count(ff));
+  TEST_ASSERT_EQUAL_UINT32(0, tu_fifo_remaining(ff));
+  TEST_ASSERT_TRUE(tu_fifo_full(ff));
+
+  tu_fifo_read_n(ff, rd_buf, 1);
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE - 1, tu_fifo_count(ff));
+  TEST_ASSERT_EQUAL_UINT32(1, tu_fifo_remaining(ff));
+}
+
+void test_write_overwritable_large(void)
+{
+  tu_fifo_set_overwritable(ff, true);
+
+  // full, then overflow by more than 64K: fifo holds last FIFO_SIZE bytes
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE, tu_fifo_write_n(ff, test_data, FIFO_SIZE));
+  TEST_ASSERT_EQUAL_UINT32(EXTRA_SIZE, tu_fifo_write_n(ff, test_data + FIFO_SIZE, EXTRA_SIZE));
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE, tu_fifo_count(ff));
+  TEST_ASSERT_EQUAL_UINT32(0, tu_fifo_remaining(ff));
+
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE, tu_fifo_read_n(ff, rd_buf, FIFO_SIZE));
+  TEST_ASSERT_EQUAL_MEMORY(test_data + EXTRA_SIZE, rd_buf, FIFO_SIZE);
+  TEST_ASSERT_TRUE(tu_fifo_empty(ff));
+}
+
+void test_write_overwritable_more_than_depth(void)
+{
+  tu_fifo_set_overwritable(ff, true);
+
+  // single write larger than depth only copies its last FIFO_SIZE bytes
+  tu_fifo_write_n(ff, test_data, 0x100);
+  tu_fifo_write_n(ff, test_data, FIFO_SIZE + EXTRA_SIZE);
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE, tu_fifo_count(ff));
+
+  TEST_ASSERT_EQUAL_UINT32(FIFO_SIZE, tu_fifo_read_n(ff, rd_buf, FIFO_SIZE));
+  TEST_ASSERT_EQUAL_MEMORY(test_data + EXTRA_SIZE, rd_buf, FIFO_SIZE);
+}
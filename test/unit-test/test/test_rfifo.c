@@ -0,0 +1,192 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+
+#include <string.h>
+#include "unity.h"
+
+#include "tusb_rfifo.h"
+
+#define REC_MAX   20
+#define REC_COUNT 4
+
+uint32_t rf_buf[TU_RFIFO_BUFSIZE(REC_COUNT, REC_MAX) / 4];
+tu_rfifo_t rf;
+
+uint8_t test_data[512];
+uint8_t rd_buf[REC_MAX];
+
+void setUp(void)
+{
+  TEST_ASSERT(tu_rfifo_config(&rf, rf_buf, sizeof(rf_buf)));
+
+  for(int i=0; i<sizeof(test_data); i++) test_data[i] = i;
+  memset(rd_buf, 0, sizeof(rd_buf));
+}
+
+void tearDown(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+void test_empty(void)
+{
+  uint16_t len;
+
+  TEST_ASSERT_TRUE(tu_rfifo_empty(&rf));
+  TEST_ASSERT_EQUAL(0, tu_rfifo_count(&rf));
+  TEST_ASSERT_NULL(tu_rfifo_peek(&rf, &len));
+  TEST_ASSERT_FALSE(tu_rfifo_pop(&rf));
+  TEST_ASSERT_FALSE(tu_rfifo_read(&rf, rd_buf, sizeof(rd_buf), &len));
+}
+
+void test_boundaries(void)
+{
+  // records of different length come out as written
+  for(uint16_t i=0; i < REC_COUNT; i++)
+  {
+    TEST_ASSERT_TRUE(tu_rfifo_write(&rf, test_data + i, (uint16_t) (i*5)));
+  }
+  TEST_ASSERT_EQUAL(REC_COUNT, tu_rfifo_count(&rf));
+
+  for(uint16_t i=0; i < REC_COUNT; i++)
+  {
+    uint16_t len;
+    TEST_ASSERT_TRUE(tu_rfifo_read(&rf, rd_buf, sizeof(rd_buf), &len));
+    TEST_ASSERT_EQUAL(i*5, len);
+    TEST_ASSERT_EQUAL_MEMORY(test_data + i, rd_buf, len);
+  }
+
+  TEST_ASSERT_TRUE(tu_rfifo_empty(&rf));
+}
+
+void test_zero_length(void)
+{
+  uint16_t len = 1;
+
+  TEST_ASSERT_TRUE(tu_rfifo_write(&rf, test_data, 0));
+  TEST_ASSERT_FALSE(tu_rfifo_empty(&rf));
+  TEST_ASSERT_NOT_NULL(tu_rfifo_peek(&rf, &len));
+  TEST_ASSERT_EQUAL(0, len);
+  TEST_ASSERT_TRUE(tu_rfifo_pop(&rf));
+  TEST_ASSERT_TRUE(tu_rfifo_empty(&rf));
+}
+
+void test_read_truncate(void)
+{
+  uint16_t len;
+
+  tu_rfifo_write(&rf, test_data, REC_MAX);
+  tu_rfifo_write(&rf, test_data + 100, 3);
+
+  // rest of the record is dropped, next record is intact
+  TEST_ASSERT_TRUE(tu_rfifo_read(&rf, rd_buf, 8, &len));
+  TEST_ASSERT_EQUAL(8, len);
+  TEST_ASSERT_EQUAL_MEMORY(test_data, rd_buf, 8);
+
+  TEST_ASSERT_TRUE(tu_rfifo_read(&rf, rd_buf, sizeof(rd_buf), &len));
+  TEST_ASSERT_EQUAL(3, len);
+  TEST_ASSERT_EQUAL_MEMORY(test_data + 100, rd_buf, 3);
+}
+
+void test_reserve_commit(void)
+{
+  uint16_t len;
+
+  uint8_t* p = (uint8_t*) tu_rfifo_reserve(&rf, REC_MAX);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_EQUAL(0, ((uintptr_t) p) % 4);
+
+  // not visible before commit
+  memcpy(p, test_data, 10);
+  TEST_ASSERT_TRUE(tu_rfifo_empty(&rf));
+
+  // commit with less than reserved
+  TEST_ASSERT_TRUE(tu_rfifo_commit(&rf, 10));
+  TEST_ASSERT_EQUAL(1, tu_rfifo_count(&rf));
+
+  // peek is in place
+  TEST_ASSERT_EQUAL_PTR(p, tu_rfifo_peek(&rf, &len));
+  TEST_ASSERT_EQUAL(10, len);
+
+  // commit without reservation, or more than reserved
+  TEST_ASSERT_FALSE(tu_rfifo_commit(&rf, 1));
+  TEST_ASSERT_NOT_NULL(tu_rfifo_reserve(&rf, 4));
+  TEST_ASSERT_FALSE(tu_rfifo_commit(&rf, 5));
+}
+
+void test_full(void)
+{
+  for(uint16_t i=0; i < REC_COUNT; i++)
+  {
+    TEST_ASSERT_TRUE(tu_rfifo_write(&rf, test_data, REC_MAX));
+  }
+
+  // buffer has one record of spare room for wrap-around, fill it
+  while ( tu_rfifo_write(&rf, test_data, 1) ) {}
+  TEST_ASSERT_NULL(tu_rfifo_reserve(&rf, 1));
+
+  TEST_ASSERT_TRUE(tu_rfifo_pop(&rf));
+  TEST_ASSERT_NOT_NULL(tu_rfifo_reserve(&rf, 1));
+}
+
+void test_wrap_contiguous(void)
+{
+  // run many times around the buffer with odd lengths, every record must be contiguous and intact
+  uint16_t len;
+  uint8_t seq_wr = 0, seq_rd = 0;
+
+  for(int i=0; i < 1000; i++)
+  {
+    while ( tu_rfifo_count(&rf) < REC_COUNT )
+    {
+      uint16_t const n = (uint16_t) (1 + (seq_wr % REC_MAX));
+      TEST_ASSERT_TRUE(tu_rfifo_write(&rf, test_data + seq_wr, n));
+      seq_wr++;
+    }
+
+    uint8_t const* p = (uint8_t const*) tu_rfifo_peek(&rf, &len);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL(1 + (seq_rd % REC_MAX), len);
+    TEST_ASSERT(p + len <= (uint8_t const*) rf_buf + sizeof(rf_buf));
+    TEST_ASSERT_EQUAL_MEMORY(test_data + seq_rd, p, len);
+
+    TEST_ASSERT_TRUE(tu_rfifo_pop(&rf));
+    seq_rd++;
+  }
+}
+
+void test_clear(void)
+{
+  tu_rfifo_write(&rf, test_data, 5);
+  tu_rfifo_write(&rf, test_data, 5);
+
+  tu_rfifo_clear(&rf);
+  TEST_ASSERT_TRUE(tu_rfifo_empty(&rf));
+  TEST_ASSERT_EQUAL(0, tu_rfifo_count(&rf));
+}
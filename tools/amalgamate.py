@@ -0,0 +1,344 @@
+#!/usr/bin/env python3
+import argparse
+import os
+import re
+import sys
+
+# Generate tinyusb_all.c: a single translation unit containing the configured tinyusb sources (core, classes and
+# the port driver) so the compiler can inline hot helpers such as tu_fifo_*, usbd_edpt_xfer and queue_event into
+# the DCD/HCD ISR without relying on LTO.
+#
+# Sources are pasted with #line markers so diagnostics and debug info still point at the original files. To make
+# the sources co-exist in one unit:
+# - file-local names (static functions/variables, enum constants, typedefs and struct tags declared in a .c) that are
+#   also used by another source are prefixed with the file name
+# - macros defined by a .c (and not by any header) are #undef at the end of that file
+# - a TU_ATTR_WEAK default implementation is skipped when another source provides the strong definition. The strong
+#   definition is tagged with a marker macro, so a definition excluded by the preprocessor does not count.
+#
+# Usage: amalgamate.py -o tinyusb_all.c src/tusb.c src/device/usbd.c ... src/portable/vendor/port/dcd_port.c
+
+TOKEN_RE = re.compile(r'''
+    (?P<comment>//[^\n]*|/\*.*?\*/)
+  | (?P<pp>^[ \t]*\#(?:\\\n|[^\n])*)
+  | (?P<string>"(?:\\.|[^"\\\n])*"|'(?:\\.|[^'\\\n])*')
+  | (?P<ident>[A-Za-z_]\w*)
+  | (?P<number>\d[\w.]*)
+  | (?P<punct>->|\S)
+''', re.S | re.M | re.X)
+
+DEFINE_RE = re.compile(r'^[ \t]*#[ \t]*define[ \t]+(\w+)', re.M)
+INCLUDE_RE = re.compile(r'^([ \t]*#[ \t]*include[ \t]*)"([^"]+)"', re.M)
+
+KEYWORDS = {'static', 'tu_static', 'inline', 'const', 'volatile', 'extern', 'typedef', 'struct', 'union', 'enum',
+            'void', 'char', 'short', 'int', 'long', 'signed', 'unsigned', 'float', 'double', 'bool', 'if', 'while',
+            'for', 'return', 'sizeof'}
+
+
+def tokenize(text):
+    """Yield (kind, value, start) for code tokens, comments and preprocessor lines are skipped"""
+    for m in TOKEN_RE.finditer(text):
+        kind = m.lastgroup
+        if kind not in ('comment', 'pp'):
+            yield kind, m.group(kind), m.start()
+
+
+def is_macro_like(name):
+    return name.isupper() or name.startswith('TU_ATTR') or name.startswith('CFG_')
+
+
+class Source:
+    def __init__(self, path, root):
+        self.path = path
+        self.name = os.path.relpath(path, root) if root else path
+        self.prefix = re.sub(r'\W', '_', os.path.splitext(os.path.basename(path))[0])
+        with open(path, encoding='utf-8') as f:
+            self.text = f.read()
+        self.locals = set()   # file-scope names private to this file
+        self.strong = {}      # name -> offset of non-static function definition
+        self.weak = {}        # name -> (start, end) offset of weak function definition
+        self.idents = set()
+        self.macros = set(DEFINE_RE.findall(self.text))
+        self.parse()
+
+    def parse(self):
+        """Split file into top-level statements and record what each of them declares"""
+        stmt = []
+        brace = 0
+        paren = 0
+        is_enum_body = []
+        enum_expect = False
+
+        for kind, val, pos in tokenize(self.text):
+            if kind == 'ident':
+                self.idents.add(val)
+
+            if brace == 0:
+                stmt.append((kind, val, pos))
+
+            if val == '{':
+                # enum body: collect enumerators
+                prev = [t[1] for t in stmt[-3:]] if brace == 0 else []
+                is_enum_body.append(brace == 0 and ('enum' in prev))
+                brace += 1
+                enum_expect = True
+            elif val == '}':
+                brace -= 1
+                is_enum_body.pop()
+                if brace == 0:
+                    if self.is_function(stmt):
+                        self.record_function(stmt, pos + 1)
+                        stmt = []
+                    else:
+                        stmt.append((kind, val, pos))
+            elif brace == 1 and is_enum_body and is_enum_body[0]:
+                if val == '(':
+                    paren += 1
+                elif val == ')':
+                    paren -= 1
+                elif paren == 0:
+                    if kind == 'ident' and enum_expect:
+                        self.locals.add(val)
+                        enum_expect = False
+                    elif val == ',':
+                        enum_expect = True
+            elif brace == 0 and val == ';':
+                self.record_declaration(stmt)
+                stmt = []
+
+    @staticmethod
+    def is_function(stmt):
+        # statement is "<decl-specifiers> name ( params ) {" ; the '{' is the last token
+        vals = [t[1] for t in stmt]
+        if len(vals) < 4 or vals[-2] != ')' or '=' in vals:
+            return False
+        return not any(v in ('struct', 'union', 'enum') and i + 2 < len(vals) and vals[i + 2] == '{'
+                       for i, v in enumerate(vals))
+
+    @staticmethod
+    def declarator_name(stmt):
+        """first identifier at paren depth 0 followed by ( [ = ; , and not looking like an attribute macro"""
+        depth = 0
+        for i, (kind, val, _) in enumerate(stmt[:-1]):
+            nxt = stmt[i + 1][1]
+            if val == '(':
+                depth += 1
+            elif val == ')':
+                depth -= 1
+            elif kind == 'ident' and depth == 0 and nxt in ('(', '[', '=', ';', ',') and val not in KEYWORDS:
+                if nxt == '(' and is_macro_like(val):
+                    continue
+                # section wrapper macro e.g __tusb_irq_path_func(name)(args)
+                vals = [t[1] for t in stmt[i + 1:i + 5]]
+                if len(vals) == 4 and vals[0] == '(' and vals[2] == ')' and vals[3] == '(':
+                    return vals[1]
+                return val
+        return None
+
+    def record_function(self, stmt, end):
+        vals = [t[1] for t in stmt]
+        name = self.declarator_name(stmt)
+        if name is None:
+            return
+        if 'static' in vals or 'tu_static' in vals:
+            self.locals.add(name)
+        elif 'TU_ATTR_WEAK' in vals:
+            self.weak[name] = (stmt[0][2], end)
+        else:
+            self.strong[name] = stmt[0][2]
+
+    def record_declaration(self, stmt):
+        vals = [t[1] for t in stmt]
+        if not vals:
+            return
+        # struct/union/enum tags for types defined here
+        for i, v in enumerate(vals[:-2]):
+            if v in ('struct', 'union', 'enum') and stmt[i + 1][0] == 'ident' and vals[i + 2] == '{':
+                self.locals.add(vals[i + 1])
+        if vals[0] == 'typedef':
+            # function pointer typedef: typedef ret (*name)(...)
+            for i, v in enumerate(vals[:-2]):
+                if v == '(' and vals[i + 1] == '*' and stmt[i + 2][0] == 'ident':
+                    self.locals.add(vals[i + 2])
+                    return
+            # name is the last identifier before ';' outside of an array bound
+            depth = 0
+            for kind, val, _ in reversed(stmt):
+                if val == ']':
+                    depth += 1
+                elif val == '[':
+                    depth -= 1
+                elif kind == 'ident' and depth == 0:
+                    self.locals.add(val)
+                    break
+        elif 'static' in vals or 'tu_static' in vals:
+            name = self.declarator_name(stmt)
+            if name:
+                self.locals.add(name)
+
+
+def rename(text, names):
+    """Rename identifiers in text (code and preprocessor lines), skipping comments, strings and member access"""
+    if not names:
+        return text
+    out = []
+    last = 0
+    prev = ''
+    for m in TOKEN_RE.finditer(text):
+        kind = m.lastgroup
+        if kind == 'comment' or kind == 'string':
+            continue
+        if kind == 'pp':
+            line = rename_pp(m.group(kind), names)
+            out.append(text[last:m.start()])
+            out.append(line)
+            last = m.end()
+            prev = ''
+            continue
+        val = m.group(kind)
+        if kind == 'ident' and val in names and prev not in ('.', '->'):
+            out.append(text[last:m.start()])
+            out.append(names[val])
+            last = m.end()
+        prev = val
+    out.append(text[last:])
+    return ''.join(out)
+
+
+def rename_pp(line, names):
+    # don't touch #include paths
+    if re.match(r'[ \t]*#[ \t]*include', line):
+        return line
+    return re.sub(r'(?<![\w.>])([A-Za-z_]\w*)', lambda m: names.get(m.group(1), m.group(1)), line)
+
+
+def header_macros(dirs):
+    macros = set()
+    for d in dirs:
+        for root, _, files in os.walk(d):
+            for fn in files:
+                if fn.endswith('.h'):
+                    with open(os.path.join(root, fn), encoding='utf-8', errors='ignore') as f:
+                        macros.update(DEFINE_RE.findall(f.read()))
+    return macros
+
+
+def order_sources(sources):
+    """Sources providing a strong definition must come before those with the weak default, keep order otherwise"""
+    ordered = []
+    pending = list(sources)
+    while pending:
+        for s in pending:
+            blocked = any(o is not s and any(n in s.weak for n in o.strong) for o in pending)
+            if not blocked:
+                break
+        else:
+            s = pending[0]
+        ordered.append(s)
+        pending.remove(s)
+    return ordered
+
+
+def line_of(text, pos):
+    return text.count('\n', 0, pos) + 1
+
+
+def emit(src, names, overridden, hdr_macros, outdir):
+    text = src.text
+
+    # resolve quoted includes relative to the original file
+    def fix_include(m):
+        inc = os.path.join(os.path.dirname(src.path), m.group(2))
+        if os.path.isfile(inc):
+            return '{}"{}"'.format(m.group(1), os.path.relpath(inc, outdir).replace(os.sep, '/'))
+        return m.group(0)
+
+    # marker before strong definitions, guard around overridden weak definitions. Work on lines from the bottom up
+    # so offsets stay valid.
+    inserts = []  # (line, text), inserted before 'line'
+    for name, pos in src.strong.items():
+        inserts.append((line_of(text, pos), '#define TU_AMALGAMATE_HAS_{}\n'.format(name)))
+    for name in overridden:
+        start, end = src.weak[name]
+        inserts.append((line_of(text, start), '#ifndef TU_AMALGAMATE_HAS_{}\n'.format(name)))
+        inserts.append((line_of(text, end) + 1, '#endif\n'))
+
+    lines = text.splitlines(keepends=True)
+    if lines and not lines[-1].endswith('\n'):
+        lines[-1] += '\n'
+    for line, ins in sorted(inserts, key=lambda x: x[0], reverse=True):
+        lines.insert(line - 1, '{}#line {} "{}"\n'.format(ins, line, src.name))
+    text = ''.join(lines)
+
+    text = INCLUDE_RE.sub(fix_include, text)
+    text = rename(text, names)
+
+    out = ['//--------------------------------------------------------------------+\n',
+           '// {}\n'.format(src.name),
+           '//--------------------------------------------------------------------+\n',
+           '#line 1 "{}"\n'.format(src.name),
+           text]
+    undef = sorted(m for m in src.macros if m not in hdr_macros)
+    out.extend('#undef {}\n'.format(m) for m in undef)
+    out.append('\n')
+    return ''.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate amalgamated tinyusb source')
+    parser.add_argument('-o', '--output', required=True, help='output file e.g tinyusb_all.c')
+    parser.add_argument('-r', '--root', default=None, help='root for file names in #line, default to cwd')
+    parser.add_argument('-I', '--include', action='append', default=[],
+                        help='header directory whose macros must be kept, default to tinyusb src')
+    parser.add_argument('sources', nargs='+', help='source files')
+    args = parser.parse_args()
+
+    # ignore duplicated source e.g typec/usbc.c listed twice
+    paths = []
+    for p in args.sources:
+        if os.path.abspath(p) not in [os.path.abspath(x) for x in paths]:
+            paths.append(p)
+
+    root = args.root if args.root else os.getcwd()
+    sources = [Source(p, root) for p in paths]
+    outdir = os.path.dirname(os.path.abspath(args.output))
+    inc_dirs = args.include if args.include else [os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'src')]
+    hdr_macros = header_macros(inc_dirs)
+
+    # a local name needs prefix if any other source also uses that identifier
+    renames = {}
+    for s in sources:
+        used_elsewhere = set()
+        for o in sources:
+            if o is not s:
+                used_elsewhere |= o.idents
+        renames[s.path] = {n: '{}_{}'.format(s.prefix, n) for n in s.locals if n in used_elsewhere}
+
+    strong = set()
+    for s in sources:
+        strong.update(s.strong)
+
+    result = ['// Generated by tools/amalgamate.py, do not edit\n',
+              '// Single translation unit build of tinyusb, see tools/amalgamate.py\n\n',
+              '#if defined(__GNUC__)\n',
+              '// extern prototypes private to each source are repeated once they share the unit\n',
+              '#pragma GCC diagnostic ignored "-Wredundant-decls"\n',
+              '#endif\n\n']
+    for s in order_sources(sources):
+        overridden = [n for n in s.weak if n in strong]
+        result.append(emit(s, renames[s.path], overridden, hdr_macros, outdir))
+
+    content = ''.join(result)
+    # only touch output if changed to avoid needless rebuild
+    if os.path.isfile(args.output):
+        with open(args.output, encoding='utf-8') as f:
+            if f.read() == content:
+                return 0
+    os.makedirs(outdir, exist_ok=True)
+    with open(args.output, 'w', encoding='utf-8') as f:
+        f.write(content)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
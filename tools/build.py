@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 import argparse
+import json
 import random
 import os
 import sys
@@ -9,6 +10,7 @@ from pathlib import Path
 from multiprocessing import Pool
 
 import build_utils
+import footprint
 
 STATUS_OK = "\033[32mOK\033[0m"
 STATUS_FAILED = "\033[31mFailed\033[0m"
@@ -21,8 +23,10 @@ RET_SKIPPED = 2
 build_format = '| {:30} | {:40} | {:16} | {:5} |'
 build_separator = '-' * 95
 build_status = [STATUS_OK, STATUS_FAILED, STATUS_SKIPPED]
+footprint_format = '| {:30} | {:40} | RAM {:>7} | Flash {:>7} |'
 
 verbose = False
+report_footprint = False
 
 # -----------------------------
 # Helper
@@ -122,9 +126,23 @@ def cmake_board(board, toolchain, build_flags_on):
 
     example = 'all'
     print_build_result(board, example, 0 if ret[1] == 0 else 1, time.monotonic() - start_time)
+    if report_footprint:
+        print_footprint(board, build_dir)
     return ret
 
 
+def print_footprint(board, build_dir):
+    """TinyUSB static RAM/flash of each example from its linker map, saved to <build_dir>/footprint.json"""
+    result = {}
+    for map_file in sorted(Path(build_dir).glob('**/*.map')):
+        example = str(map_file.parent.relative_to(build_dir))
+        result[example] = footprint.footprint(str(map_file))
+        total = result[example]['total']
+        print(footprint_format.format(board, example, total['ram'], total['flash']))
+    with open(f'{build_dir}/footprint.json', 'w') as f:
+        json.dump(result, f, indent=2)
+
+
 # -----------------------------
 # Make
 # -----------------------------
@@ -206,6 +224,7 @@ def build_family(family, toolchain, build_system, build_flags_on, one_per_family
 # -----------------------------
 def main():
     global verbose
+    global report_footprint
 
     parser = argparse.ArgumentParser()
     parser.add_argument('families', nargs='*', default=[], help='Families to build')
@@ -215,6 +234,8 @@ def main():
     parser.add_argument('-f1', '--build-flags-on', action='append', default=[], help='Build flag to pass to build system')
     parser.add_argument('-1', '--one-per-family', action='store_true', default=False, help='Build only one random board inside a family')
     parser.add_argument('-v', '--verbose', action='store_true', help='Verbose output')
+    parser.add_argument('--footprint', action='store_true', default=False,
+                        help='Report tinyusb static RAM/flash per example (cmake, see tools/footprint.py)')
     args = parser.parse_args()
 
     families = args.families
@@ -224,6 +245,7 @@ def main():
     build_flags_on = args.build_flags_on
     one_per_family = args.one_per_family
     verbose = args.verbose
+    report_footprint = args.footprint
 
     if len(families) == 0 and len(boards) == 0:
         print("Please specify families or board to build")
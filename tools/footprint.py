@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""
+Static memory footprint of TinyUSB per module and per object, parsed from the GNU ld/lld linker map file.
+Each example is linked with -Map and compiled with -ffunction-sections -fdata-sections, so every function and
+variable has its own input section, which is attributed to the tinyusb source file it comes from.
+
+    $ footprint.py cmake-build/cmake-build-<board>/device/cdc_msc/cdc_msc.elf.map [-n 20] [-j footprint.json]
+
+RAM is .bss (including noinit) + .data, flash is .text + .rodata + .data (initial values). Sections with other names
+e.g from CFG_TUSB_MEM_SECTION or CFG_TUSB_FAST_FUNC are counted as .bss if they contain 'bss' or 'noinit', as .data
+if they contain 'data', 'ram' or 'tcm', otherwise as .text.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+# tinyusb source directories, to tell tinyusb objects from example/bsp objects built into src/ as well
+TINYUSB_DIRS = ('class', 'common', 'device', 'host', 'osal', 'portable', 'typec')
+
+# input section line: ' .bss._cdcd_itf' optionally followed on the same line by address, size and object
+RE_INPUT = re.compile(r'^ (\.\S+|COMMON)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*))?$')
+RE_CONT = re.compile(r'^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$')
+# lld map: '<vma> <lma> <size> <align>         file.o:(.bss._cdcd_itf)'
+RE_LLD = re.compile(r'^\s*[0-9a-fA-F]+\s+[0-9a-fA-F]+\s+([0-9a-fA-F]+)\s+\d+\s+(\S.*):\((\.\S+|COMMON)\)$')
+
+SKIP_SECTIONS = ('.debug', '.comment', '.ARM.attributes', '.note', '.stab', '.riscv.attributes', '.gnu.attributes')
+
+
+def get_module(obj):
+    """tinyusb module name (source file stem) of an object, None if object is not part of tinyusb"""
+    # static library built by cmake: .../lib<example>-tinyusb.a(cdc_device.c.obj)
+    m = re.search(r'tinyusb[^/\\]*\.a\((.+)\)$', obj)
+    if m:
+        name = m.group(1)
+    else:
+        # object of make build or library member with path: .../src/class/cdc/cdc_device.o
+        path = obj.replace('\\', '/')
+        m = re.search(r'(?:^|/)src/((?:' + '|'.join(TINYUSB_DIRS) + r')/.+|tusb\.c(?:\.obj|\.o)|tusb\.o)$', path)
+        if not m:
+            return None
+        name = os.path.basename(m.group(1))
+    return re.sub(r'(\.c)?\.(obj|o)$', '', name)
+
+
+def get_kind(section):
+    name = section.lower()
+    if name.startswith(('.bss', '.sbss', '.tbss', 'common')):
+        return 'bss'
+    if name.startswith(('.text', '.rodata', '.srodata', '.data.rel.ro', '.eh_frame', '.gcc_except_table',
+                        '.init_array', '.fini_array', '.arm.ex')):
+        return 'text'
+    if name.startswith(('.data', '.sdata', '.tdata')):
+        return 'data'
+    # custom section e.g CFG_TUSB_MEM_SECTION, CFG_TUSB_FAST_FUNC
+    if 'bss' in name or 'noinit' in name:
+        return 'bss'
+    if 'data' in name or 'ram' in name or 'tcm' in name:
+        return 'data'
+    return 'text'
+
+
+def get_symbol(section):
+    """symbol name from per-function/data section name e.g .bss._cdcd_itf -> _cdcd_itf"""
+    m = re.match(r'^\.(?:s?bss|s?data|s?rodata|text|tbss|tdata)(?:\.rel\.ro)?(?:\.str1\.\d+|\.cst\d+)?\.(.+)$', section)
+    return m.group(1) if m else section
+
+
+def parse_map(fname):
+    """return list of (module, kind, symbol, size) for tinyusb input sections"""
+    entries = []
+    with open(fname, errors='replace') as f:
+        lines = f.read().splitlines()
+
+    # GNU ld: only parse after discarded sections
+    start = 0
+    for i, line in enumerate(lines):
+        if line.startswith('Linker script and memory map'):
+            start = i + 1
+            break
+
+    def add(section, size, obj):
+        module = get_module(obj.strip())
+        if module is None or size == 0 or section.startswith(SKIP_SECTIONS):
+            return
+        entries.append((module, get_kind(section), get_symbol(section), size))
+
+    pending = None
+    for line in lines[start:]:
+        m = RE_LLD.match(line)
+        if m:
+            add(m.group(3), int(m.group(1), 16), m.group(2))
+            continue
+
+        if pending is not None:
+            m = RE_CONT.match(line)
+            if m:
+                add(pending, int(m.group(2), 16), m.group(3))
+            pending = None
+            continue
+
+        m = RE_INPUT.match(line)
+        if m:
+            if m.group(4) is None:
+                pending = m.group(1)  # address, size and object on next line
+            else:
+                add(m.group(1), int(m.group(3), 16), m.group(4))
+            continue
+
+    return entries
+
+
+def summarize(entries):
+    modules = {}
+    for module, kind, symbol, size in entries:
+        m = modules.setdefault(module, {'bss': 0, 'data': 0, 'text': 0, 'symbols': {}})
+        m[kind] += size
+        if kind != 'text':
+            m['symbols'][symbol] = m['symbols'].get(symbol, 0) + size
+    for m in modules.values():
+        m['ram'] = m['bss'] + m['data']
+        m['flash'] = m['text'] + m['data']
+    return modules
+
+
+def footprint(fname):
+    """footprint of a map file: {'total': {...}, 'modules': {module: {...}}}"""
+    modules = summarize(parse_map(fname))
+    total = {k: sum(m[k] for m in modules.values()) for k in ('bss', 'data', 'text', 'ram', 'flash')}
+    return {'total': total, 'modules': modules}
+
+
+def print_report(name, modules, top):
+    row = '| {:24} | {:>8} | {:>8} | {:>8} | {:>8} | {:>8} |'
+    separator = '-' * 85
+    print(name)
+    print(separator)
+    print(row.format('Module', '.bss', '.data', '.text', 'RAM', 'Flash'))
+    print(separator)
+    total = {k: sum(m[k] for m in modules.values()) for k in ('bss', 'data', 'text', 'ram', 'flash')}
+    for module, m in sorted(modules.items(), key=lambda kv: (-kv[1]['ram'], -kv[1]['flash'])):
+        print(row.format(module, m['bss'], m['data'], m['text'], m['ram'], m['flash']))
+    print(separator)
+    print(row.format('Total', total['bss'], total['data'], total['text'], total['ram'], total['flash']))
+    print(separator)
+
+    if top:
+        symbols = [(size, sym, module) for module, m in modules.items() for sym, size in m['symbols'].items()]
+        symbols.sort(reverse=True)
+        print(f'Top {top} RAM objects')
+        for size, sym, module in symbols[:top]:
+            print(f'  {size:8}  {sym:40} {module}')
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='TinyUSB static RAM/flash footprint from linker map file')
+    parser.add_argument('map_files', nargs='+', help='linker map file(s), e.g <example>.elf.map')
+    parser.add_argument('-n', '--top', type=int, default=10, help='number of largest RAM objects to list')
+    parser.add_argument('-j', '--json', help='write result of all map files to JSON file')
+    args = parser.parse_args()
+
+    result = {}
+    for fname in args.map_files:
+        result[fname] = footprint(fname)
+        print_report(fname, result[fname]['modules'], args.top)
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump(result, f, indent=2)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+import argparse
+import struct
+import sys
+
+# Decoder for the binary trace buffer (tu_trace_buf) recorded with CFG_TUSB_TRACE = 1.
+# Dump the buffer from target e.g with gdb:
+#   dump binary value trace.bin tu_trace_buf
+# or dump a whole RAM region, the buffer is located by its magic.
+
+TRACE_MAGIC = 0x52545554  # "TUTR"
+HEADER_FMT = '<IHHI'
+RECORD_FMT = '<IBBHI'
+
+# Keep in sync with src/common/tusb_debug.h
+TRACE_ID = {
+    1: 'DCD_EVENT',
+    2: 'HCD_EVENT',
+    3: 'DCD_XFER',
+    4: 'HCD_XFER',
+    5: 'CB_ENTER',
+    6: 'CB_EXIT',
+    7: 'FIFO_LEVEL',
+    8: 'CTRL_ENTER',
+    9: 'CTRL_EXIT',
+}
+CONTROL_STAGE = ['IDLE', 'SETUP', 'DATA', 'ACK']
+
+DCD_EVENT = ['INVALID', 'BUS_RESET', 'UNPLUGGED', 'SOF', 'SUSPEND', 'RESUME', 'SETUP', 'XFER_COMPLETE',
+             'FUNC_CALL', 'PRIORITY']
+HCD_EVENT = ['ATTACH', 'REMOVE', 'XFER_COMPLETE', 'FUNC_CALL', 'PRIORITY']
+
+
+def find_buffer(data, offset):
+    """Return offset of trace buffer header, search for magic if not specified"""
+    if offset is not None:
+        return offset
+    magic = struct.pack('<I', TRACE_MAGIC)
+    pos = data.find(magic)
+    while pos >= 0 and pos % 4 != 0:
+        pos = data.find(magic, pos + 1)
+    if pos < 0:
+        sys.exit('Trace buffer not found (magic mismatch)')
+    return pos
+
+
+def parse_records(data, offset):
+    magic, count, record_size, index = struct.unpack_from(HEADER_FMT, data, offset)
+    if magic != TRACE_MAGIC:
+        sys.exit(f'Invalid magic 0x{magic:08X} at offset {offset}')
+    if record_size != struct.calcsize(RECORD_FMT):
+        sys.exit(f'Unsupported record size {record_size}')
+
+    base = offset + struct.calcsize(HEADER_FMT)
+    if len(data) < base + count * record_size:
+        sys.exit('Dump is shorter than trace buffer')
+
+    # oldest record first: ring buffer is only full after count records are written
+    total = min(index, count)
+    first = index - total
+    records = []
+    for seq in range(first, index):
+        records.append((seq,) + struct.unpack_from(RECORD_FMT, data, base + (seq % count) * record_size))
+    return index, records
+
+
+def describe(rid, arg8, arg16, arg32):
+    name = TRACE_ID.get(rid, f'USER_{rid:02X}' if rid >= 0x80 else f'ID_{rid:02X}')
+    if rid == 1:
+        event = DCD_EVENT[arg8] if arg8 < len(DCD_EVENT) else f'{arg8}'
+        if event == 'XFER_COMPLETE':
+            return name, f'{event} ep 0x{arg16 & 0xff:02X} len {arg32}'
+        if event == 'SOF':
+            return name, f'{event} frame {arg32}'
+        return name, event
+    if rid == 2:
+        event = HCD_EVENT[arg8] if arg8 < len(HCD_EVENT) else f'{arg8}'
+        if event == 'XFER_COMPLETE':
+            return name, f'{event} dev {arg16 >> 8} ep 0x{arg16 & 0xff:02X} len {arg32}'
+        return name, event
+    if rid == 3:
+        return name, f'ep 0x{arg16 & 0xff:02X} len {arg32}' + (' fifo' if arg8 else '')
+    if rid == 4:
+        return name, f'dev {arg16 >> 8} ep 0x{arg16 & 0xff:02X} len {arg32}'
+    if rid in (5, 6, 7):
+        where = f'dev {arg16 >> 8} ep 0x{arg16 & 0xff:02X}' if arg8 else f'ep 0x{arg16 & 0xff:02X}'
+        if rid == 5:
+            return name, f'{where} len {arg32}'
+        if rid == 7:
+            return name, f'{where} count {arg32}'
+        return name, where
+    if rid in (8, 9):
+        stage = CONTROL_STAGE[arg8] if arg8 < len(CONTROL_STAGE) else f'{arg8}'
+        if rid == 8:
+            return name, f'{stage} bmRequestType 0x{arg32 >> 8:02X} bRequest 0x{arg32 & 0xff:02X} wIndex 0x{arg16:04X}'
+        return name, f'{stage} wIndex 0x{arg16:04X}' + ('' if arg32 else ' stall')
+    return name, f'arg8 0x{arg8:02X} arg16 0x{arg16:04X} arg32 0x{arg32:08X}'
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode TinyUSB binary trace buffer dump')
+    parser.add_argument('dump', help='binary dump containing tu_trace_buf')
+    parser.add_argument('-o', '--offset', type=lambda x: int(x, 0), default=None,
+                        help='offset of tu_trace_buf in dump, default: search for magic')
+    parser.add_argument('-c', '--csv', action='store_true', help='output as csv')
+    args = parser.parse_args()
+
+    with open(args.dump, 'rb') as f:
+        data = f.read()
+
+    index, records = parse_records(data, find_buffer(data, args.offset))
+    if index > len(records):
+        print(f'# {index - len(records)} older records are overwritten', file=sys.stderr)
+
+    prev_ts = records[0][1] if records else 0
+    if args.csv:
+        print('seq,timestamp,delta,id,arg8,arg16,arg32,description')
+    for seq, ts, rid, arg8, arg16, arg32 in records:
+        delta = (ts - prev_ts) & 0xFFFFFFFF
+        prev_ts = ts
+        name, desc = describe(rid, arg8, arg16, arg32)
+        if args.csv:
+            print(f'{seq},{ts},{delta},{name},{arg8},{arg16},{arg32},{desc}')
+        else:
+            print(f'{seq:8} {ts:10} +{delta:<8} {name:10} {desc}')
+
+
+if __name__ == '__main__':
+    main()